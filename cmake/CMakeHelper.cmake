@@ -174,6 +174,18 @@ macro(COLMAP_ADD_TEST TARGET_NAME)
     endif()
 endmacro(COLMAP_ADD_TEST)
 
+# Wrapper for benchmark executables, which are not registered as tests, since
+# they run for a long time and their results depend on the machine.
+macro(COLMAP_ADD_BENCHMARK TARGET_NAME)
+    if(BENCHMARKS_ENABLED)
+        # ${ARGN} will store the list of source files passed to this function.
+        add_executable(${TARGET_NAME} ${ARGN})
+        set_target_properties(${TARGET_NAME} PROPERTIES FOLDER
+            ${COLMAP_TARGETS_ROOT_FOLDER}/${FOLDER_NAME})
+        target_link_libraries(${TARGET_NAME} colmap)
+    endif()
+endmacro(COLMAP_ADD_BENCHMARK)
+
 # Wrapper for CUDA test executables.
 macro(COLMAP_ADD_CUDA_TEST TARGET_NAME)
     if(TESTS_ENABLED)
@@ -16,8 +16,8 @@
 /*************************************************************************
 * The following macro returns a random number in the specified range
 **************************************************************************/
-#define RandomInRange(u) ((rand()>>3)%(u))
-#define RandomInRangeFast(u) ((rand()>>3)%(u))
+#define RandomInRange(u) ((RandomNumber()>>3)%(u))
+#define RandomInRangeFast(u) ((RandomNumber()>>3)%(u))
 
 
 
@@ -410,6 +410,7 @@
 #define RandomPermute			__RandomPermute
 #define ispow2				__ispow2
 #define InitRandom			__InitRandom
+#define RandomNumber			__RandomNumber
 #define log2_metis			__log2_metis
 
 
@@ -585,7 +585,7 @@ void RandomPermute(int n, idxtype *p, int flag)
 
   for(i = 1; i < n; i++)
   {
-    j = rand() % (i+1);
+    j = RandomNumber() % (i+1);
     tmp = p[i];
     p[i] = p[j];
     p[j] = tmp;
@@ -644,19 +644,79 @@ int ispow2(int a)
 }
 
 
+/*************************************************************************
+* The state of the random number generator is thread-local, such that
+* graphs can be partitioned concurrently with deterministic results. The
+* generator is the additive feedback generator of the C library's rand(),
+* such that the partitions are the same as with the global generator.
+**************************************************************************/
+#define RANDOM_STATE_SIZE 34
+
+typedef struct {
+  int r[RANDOM_STATE_SIZE];
+  int i;
+} RandomState;
+
+#if defined(_MSC_VER)
+static __declspec(thread) RandomState random_state;
+static __declspec(thread) int random_state_initialized = 0;
+#else
+static __thread RandomState random_state;
+static __thread int random_state_initialized = 0;
+#endif
+
+static void SeedRandomState(unsigned int seed)
+{
+  int i;
+  long long word;
+
+  random_state.r[0] = (int)(seed == 0 ? 1 : seed);
+  for (i = 1; i < 31; i++) {
+    word = (16807LL * random_state.r[i-1]) % 2147483647LL;
+    if (word < 0)
+      word += 2147483647LL;
+    random_state.r[i] = (int)word;
+  }
+  for (i = 31; i < RANDOM_STATE_SIZE; i++)
+    random_state.r[i] = random_state.r[i-31];
+  random_state.i = 0;
+  random_state_initialized = 1;
+
+  /* Discard the initial outputs, as done by the C library. */
+  for (i = 0; i < 310; i++)
+    RandomNumber();
+}
+
 /*************************************************************************
 * This function initializes the random number generator
 **************************************************************************/
 void InitRandom(int seed)
 {
   if (seed == -1) {
-    srand(4321);
+    SeedRandomState(4321);
   }
   else {
-    srand(seed);
+    SeedRandomState((unsigned int)seed);
   }
 }
 
+/*************************************************************************
+* This function returns a random number in the range [0, 2^31)
+**************************************************************************/
+int RandomNumber(void)
+{
+  unsigned int value;
+
+  if (!random_state_initialized)
+    SeedRandomState(1);
+
+  value = (unsigned int)random_state.r[(random_state.i + 3) % RANDOM_STATE_SIZE] +
+          (unsigned int)random_state.r[(random_state.i + 31) % RANDOM_STATE_SIZE];
+  random_state.r[(random_state.i + RANDOM_STATE_SIZE) % RANDOM_STATE_SIZE] = (int)value;
+  random_state.i = (random_state.i + 1) % RANDOM_STATE_SIZE;
+  return (int)(value >> 1);
+}
+
 /*************************************************************************
 * This function returns the log2(x)
 **************************************************************************/
@@ -40,6 +40,8 @@ from pyntcloud import PyntCloud
 from read_write_model import read_next_bytes, write_next_bytes
 
 
+POINTS_VISIBILITY_MAGIC = 0x3153495650414D43
+
 MeshPoint = collections.namedtuple(
     "MeshingPoint", ["position", "color", "normal", "num_visible_images", "visible_image_idxs"])
 
@@ -57,23 +59,70 @@ def read_fused(path_to_fused_ply, path_to_fused_ply_vis):
     normal_arr = point_cloud.points.loc[:, ["nx", "ny", "nz"]].to_numpy()
     color_arr = point_cloud.points.loc[:, ["red", "green", "blue"]].to_numpy()
 
+    points_visibility = read_fused_ply_vis(path_to_fused_ply_vis)
+    num_points = len(points_visibility)
+    mesh_points = [0] * num_points
+    for i in range(num_points):
+        visible_image_idxs = points_visibility[i]
+        mesh_point = MeshPoint(
+            position=xyz_arr[i],
+            color=color_arr[i],
+            normal=normal_arr[i],
+            num_visible_images=len(visible_image_idxs),
+            visible_image_idxs=visible_image_idxs)
+        mesh_points[i] = mesh_point
+    return mesh_points
+
+
+def read_fused_ply_vis(path_to_fused_ply_vis):
+    """
+    see: src/mvs/fusion.cc
+        PointsVisibility ReadPointsVisibility(const std::string& path, ...)
+    """
     with open(path_to_fused_ply_vis, "rb") as fid:
-        num_points = read_next_bytes(fid, 8, "Q")[0]
-        mesh_points = [0] * num_points
-        for i in range(num_points):
-            num_visible_images = read_next_bytes(fid, 4, "I")[0]
-            visible_image_idxs = read_next_bytes(
-                fid, num_bytes=4*num_visible_images,
-                format_char_sequence="I"*num_visible_images)
-            visible_image_idxs = np.array(tuple(map(int, visible_image_idxs)))
-            mesh_point = MeshPoint(
-                position=xyz_arr[i],
-                color=color_arr[i],
-                normal=normal_arr[i],
-                num_visible_images=num_visible_images,
-                visible_image_idxs=visible_image_idxs)
-            mesh_points[i] = mesh_point
-        return mesh_points
+        magic = read_next_bytes(fid, 8, "Q")[0]
+        if magic != POINTS_VISIBILITY_MAGIC:
+            num_points = magic
+            points_visibility = [0] * num_points
+            for i in range(num_points):
+                num_visible_images = read_next_bytes(fid, 4, "I")[0]
+                visible_image_idxs = read_next_bytes(
+                    fid, num_bytes=4*num_visible_images,
+                    format_char_sequence="I"*num_visible_images)
+                points_visibility[i] = \
+                    np.array(tuple(map(int, visible_image_idxs)))
+            return points_visibility
+
+        num_points, _, chunk_table_offset = read_next_bytes(fid, 24, "QQQ")
+        # The chunks are stored back to back, so they can be decoded in order
+        # without consulting the chunk table.
+        data = fid.read(chunk_table_offset - fid.tell())
+
+    pos = 0
+
+    def decode_varint():
+        nonlocal pos
+        value = 0
+        shift = 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            if byte < 0x80:
+                return value
+            shift += 7
+
+    points_visibility = [0] * num_points
+    for i in range(num_points):
+        num_visible_images = decode_varint()
+        visible_image_idxs = np.zeros(num_visible_images, dtype=int)
+        image_idx = 0
+        for j in range(num_visible_images):
+            value = decode_varint()
+            image_idx += (value >> 1) ^ -(value & 1)
+            visible_image_idxs[j] = image_idx
+        points_visibility[i] = visible_image_idxs
+    return points_visibility
 
 
 def write_fused_ply(mesh_points, path_to_fused_ply):
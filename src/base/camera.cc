@@ -39,6 +39,47 @@
 
 namespace colmap {
 
+// The inverse distortion at the nodes (i * step_x, j * step_y) of a regular
+// grid over the image, together with the state of the camera it belongs to.
+struct Camera::UndistortionGrid {
+  int model_id;
+  size_t width;
+  size_t height;
+  std::vector<double> params;
+  size_t num_cells_x;
+  size_t num_cells_y;
+  double step_x;
+  double step_y;
+  // The world points of the grid nodes in row-major order.
+  std::vector<Eigen::Vector2d> world_points;
+
+  // Bilinearly interpolate the world point of the given image point. Returns
+  // false if the image point lies outside of the grid.
+  bool Interpolate(const Eigen::Vector2d& image_point,
+                   Eigen::Vector2d* world_point) const;
+};
+
+bool Camera::UndistortionGrid::Interpolate(const Eigen::Vector2d& image_point,
+                                           Eigen::Vector2d* world_point) const {
+  const double x = image_point(0) / step_x;
+  const double y = image_point(1) / step_y;
+  // Written as negation to also reject NaN coordinates.
+  if (!(x >= 0 && y >= 0 && x <= num_cells_x && y <= num_cells_y)) {
+    return false;
+  }
+
+  const size_t i = std::min(static_cast<size_t>(x), num_cells_x - 1);
+  const size_t j = std::min(static_cast<size_t>(y), num_cells_y - 1);
+  const double dx = x - i;
+  const double dy = y - j;
+  const size_t stride = num_cells_x + 1;
+  const Eigen::Vector2d* node = &world_points[j * stride + i];
+  *world_point = (1 - dy) * ((1 - dx) * node[0] + dx * node[1]) +
+                 dy * ((1 - dx) * node[stride] + dx * node[stride + 1]);
+
+  return true;
+}
+
 Camera::Camera()
     : camera_id_(kInvalidCameraId),
       model_id_(kInvalidCameraModelId),
@@ -209,6 +250,14 @@ void Camera::InitializeWithName(const std::string& model_name,
 
 Eigen::Vector2d Camera::ImageToWorld(const Eigen::Vector2d& image_point) const {
   Eigen::Vector2d world_point;
+  if (HasUndistortionGrid() &&
+      undistortion_grid_->Interpolate(image_point, &world_point)) {
+    CameraModelRefineImageToWorld(model_id_, params_, image_point(0),
+                                  image_point(1), &world_point(0),
+                                  &world_point(1));
+    return world_point;
+  }
+
   CameraModelImageToWorld(model_id_, params_, image_point(0), image_point(1),
                           &world_point(0), &world_point(1));
   return world_point;
@@ -225,6 +274,86 @@ Eigen::Vector2d Camera::WorldToImage(const Eigen::Vector2d& world_point) const {
   return image_point;
 }
 
+void Camera::ImageToWorld(const std::vector<Eigen::Vector2d>& image_points,
+                          std::vector<Eigen::Vector2d>* world_points) const {
+  if (!HasUndistortionGrid()) {
+    CameraModelImageToWorldBatch(model_id_, params_, image_points,
+                                 world_points);
+    return;
+  }
+
+  // Points outside of the grid are computed exactly, for which the Newton
+  // step of the refinement does not change anything.
+  std::vector<Eigen::Vector2d> grid_world_points(image_points.size());
+  for (size_t i = 0; i < image_points.size(); ++i) {
+    if (!undistortion_grid_->Interpolate(image_points[i],
+                                         &grid_world_points[i])) {
+      CameraModelImageToWorld(model_id_, params_, image_points[i](0),
+                              image_points[i](1), &grid_world_points[i](0),
+                              &grid_world_points[i](1));
+    }
+  }
+
+  CameraModelRefineImageToWorldBatch(model_id_, params_, image_points,
+                                     &grid_world_points);
+
+  *world_points = std::move(grid_world_points);
+}
+
+void Camera::WorldToImage(const std::vector<Eigen::Vector2d>& world_points,
+                          std::vector<Eigen::Vector2d>* image_points) const {
+  CameraModelWorldToImageBatch(model_id_, params_, world_points, image_points);
+}
+
+void Camera::ComputeUndistortionGrid(const int num_cells) {
+  CHECK_GT(num_cells, 0);
+  CHECK_GT(width_, 0);
+  CHECK_GT(height_, 0);
+
+  undistortion_grid_.reset();
+
+  // These camera models have a closed-form inverse.
+  if (model_id_ == SimplePinholeCameraModel::model_id ||
+      model_id_ == PinholeCameraModel::model_id ||
+      model_id_ == FOVCameraModel::model_id) {
+    return;
+  }
+
+  auto grid = std::make_shared<UndistortionGrid>();
+  grid->model_id = model_id_;
+  grid->width = width_;
+  grid->height = height_;
+  grid->params = params_;
+
+  const double max_size = std::max(width_, height_);
+  grid->num_cells_x = std::max<size_t>(
+      1, static_cast<size_t>(std::round(num_cells * width_ / max_size)));
+  grid->num_cells_y = std::max<size_t>(
+      1, static_cast<size_t>(std::round(num_cells * height_ / max_size)));
+  grid->step_x = width_ / static_cast<double>(grid->num_cells_x);
+  grid->step_y = height_ / static_cast<double>(grid->num_cells_y);
+
+  std::vector<Eigen::Vector2d> image_points;
+  image_points.reserve((grid->num_cells_x + 1) * (grid->num_cells_y + 1));
+  for (size_t j = 0; j <= grid->num_cells_y; ++j) {
+    for (size_t i = 0; i <= grid->num_cells_x; ++i) {
+      image_points.emplace_back(i * grid->step_x, j * grid->step_y);
+    }
+  }
+
+  CameraModelImageToWorldBatch(model_id_, params_, image_points,
+                               &grid->world_points);
+
+  undistortion_grid_ = grid;
+}
+
+bool Camera::HasUndistortionGrid() const {
+  return undistortion_grid_ && undistortion_grid_->model_id == model_id_ &&
+         undistortion_grid_->width == width_ &&
+         undistortion_grid_->height == height_ &&
+         undistortion_grid_->params == params_;
+}
+
 void Camera::Rescale(const double scale) {
   CHECK_GT(scale, 0.0);
   const double scale_x =
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_CAMERA_H_
 #define COLMAP_SRC_BASE_CAMERA_H_
 
+#include <memory>
 #include <vector>
 
 #include "util/types.h"
@@ -136,6 +137,25 @@ class Camera {
   // Project point from world / infinity to image plane.
   Eigen::Vector2d WorldToImage(const Eigen::Vector2d& world_point) const;
 
+  // Batch versions of `ImageToWorld` and `WorldToImage`, which are faster than
+  // projecting the points one by one. The output may be the input vector.
+  void ImageToWorld(const std::vector<Eigen::Vector2d>& image_points,
+                    std::vector<Eigen::Vector2d>* world_points) const;
+  void WorldToImage(const std::vector<Eigen::Vector2d>& world_points,
+                    std::vector<Eigen::Vector2d>* image_points) const;
+
+  // Precompute the inverse distortion on a regular grid over the image, such
+  // that `ImageToWorld` interpolates an initial estimate in the grid and
+  // refines it with a single Newton step instead of running the iterative
+  // undistortion of distorted camera models. This pays off if many points of
+  // the same camera are normalized, e.g., during feature matching. The grid
+  // is ignored once the model, dimensions, or parameters of the camera change
+  // and does nothing for camera models with a closed-form inverse.
+  //
+  // @param num_cells    The number of grid cells along the larger dimension.
+  void ComputeUndistortionGrid(const int num_cells = 64);
+  bool HasUndistortionGrid() const;
+
   // Rescale camera dimensions and accordingly the focal length and
   // and the principal point.
   void Rescale(const double scale);
@@ -161,6 +181,11 @@ class Camera {
   // Whether there is a safe prior for the focal length,
   // e.g. manually provided or extracted from EXIF
   bool prior_focal_length_;
+
+  // The optional inverse distortion grid, which is shared between copies of
+  // the camera, since it is immutable once computed.
+  struct UndistortionGrid;
+  std::shared_ptr<const UndistortionGrid> undistortion_grid_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -31,14 +31,29 @@
 
 #include "base/camera_database.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "util/string.h"
 
 namespace colmap {
+namespace {
+
+struct CameraSpecMakeLess {
+  bool operator()(const CameraSpec& spec, const std::string& make) const {
+    return std::strcmp(spec.make, make.c_str()) < 0;
+  }
+  bool operator()(const std::string& make, const CameraSpec& spec) const {
+    return std::strcmp(make.c_str(), spec.make) < 0;
+  }
+};
 
-const camera_specs_t CameraDatabase::specs_ = InitializeCameraSpecs();
+}  // namespace
 
 CameraDatabase::CameraDatabase() {}
 
+size_t CameraDatabase::NumEntries() const { return kNumCameraSpecs; }
+
 bool CameraDatabase::QuerySensorWidth(const std::string& make,
                                       const std::string& model,
                                       double* sensor_width) {
@@ -55,17 +70,26 @@ bool CameraDatabase::QuerySensorWidth(const std::string& make,
   // Make sure that make name is not duplicated.
   cleaned_model = StringReplace(cleaned_model, cleaned_make, "");
 
+  const CameraSpec* specs_begin = kCameraSpecs;
+  const CameraSpec* specs_end = kCameraSpecs + kNumCameraSpecs;
+
   // Check if cleaned_make exists in database: Test whether EXIF string is
-  // substring of database entry and vice versa.
+  // substring of database entry and vice versa. The models of a make are found
+  // by binary search in the sorted specs.
   size_t spec_matches = 0;
-  for (const auto& make_elem : specs_) {
-    if (StringContains(cleaned_make, make_elem.first) ||
-        StringContains(make_elem.first, cleaned_make)) {
-      for (const auto& model_elem : make_elem.second) {
-        if (StringContains(cleaned_model, model_elem.first) ||
-            StringContains(model_elem.first, cleaned_model)) {
-          *sensor_width = model_elem.second;
-          if (cleaned_model == model_elem.first) {
+  const CameraSpec* make_begin = specs_begin;
+  while (make_begin != specs_end) {
+    const std::string make_name = make_begin->make;
+    const CameraSpec* make_end =
+        std::upper_bound(make_begin, specs_end, make_name, CameraSpecMakeLess());
+    if (StringContains(cleaned_make, make_name) ||
+        StringContains(make_name, cleaned_make)) {
+      for (auto spec = make_begin; spec != make_end; ++spec) {
+        const std::string model_name = spec->model;
+        if (StringContains(cleaned_model, model_name) ||
+            StringContains(model_name, cleaned_model)) {
+          *sensor_width = spec->sensor_width;
+          if (cleaned_model == model_name) {
             // Model exactly matches, return immediately.
             return true;
           }
@@ -76,6 +100,7 @@ bool CameraDatabase::QuerySensorWidth(const std::string& make,
         }
       }
     }
+    make_begin = make_end;
   }
 
   // Only return unique results, if model does not exactly match.
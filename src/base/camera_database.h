@@ -44,13 +44,11 @@ class CameraDatabase {
  public:
   CameraDatabase();
 
-  size_t NumEntries() const { return specs_.size(); }
+  // The number of camera models in the database.
+  size_t NumEntries() const;
 
   bool QuerySensorWidth(const std::string& make, const std::string& model,
                         double* sensor_width);
-
- private:
-  static const camera_specs_t specs_;
 };
 
 }  // namespace colmap
@@ -38,8 +38,12 @@ using namespace colmap;
 
 BOOST_AUTO_TEST_CASE(TestInitialization) {
   CameraDatabase database;
-  camera_specs_t specs = InitializeCameraSpecs();
-  BOOST_CHECK_EQUAL(database.NumEntries(), specs.size());
+  BOOST_CHECK_EQUAL(database.NumEntries(), kNumCameraSpecs);
+  BOOST_CHECK_GT(database.NumEntries(), 0);
+  for (size_t i = 1; i < kNumCameraSpecs; ++i) {
+    BOOST_CHECK_LE(std::string(kCameraSpecs[i - 1].make),
+                   std::string(kCameraSpecs[i].make));
+  }
 }
 
 BOOST_AUTO_TEST_CASE(TestExactMatch) {
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_CAMERA_MODELS_H_
 #define COLMAP_SRC_BASE_CAMERA_MODELS_H_
 
+#include <algorithm>
 #include <cfloat>
 #include <string>
 #include <vector>
@@ -41,6 +42,8 @@
 
 #include <ceres/ceres.h>
 
+#include "util/alignment.h"
+
 namespace colmap {
 
 // This file defines several different camera models and arbitrary new camera
@@ -173,6 +176,23 @@ struct BaseCameraModel {
 
   template <typename T>
   static inline void IterativeUndistortion(const T* params, T* u, T* v);
+
+  // Transform multiple points given as consecutive (u, v) or (x, y) pairs.
+  // The input and output arrays may be the same.
+  template <typename T>
+  static inline void WorldToImageBatch(const T* params, const size_t num_points,
+                                       const T* world_points, T* image_points);
+  template <typename T>
+  static inline void ImageToWorldBatch(const T* params, const size_t num_points,
+                                       const T* image_points, T* world_points);
+
+  // Refine approximate world points of the image points with one Newton step
+  // using a forward difference Jacobian of the projection.
+  template <typename T>
+  static inline void RefineImageToWorldBatch(const T* params,
+                                             const size_t num_points,
+                                             const T* image_points,
+                                             T* world_points);
 };
 
 // Simple Pinhole camera model.
@@ -449,6 +469,42 @@ inline void CameraModelImageToWorld(const int model_id,
                                     const double x, const double y, double* u,
                                     double* v);
 
+// Batch versions of `CameraModelWorldToImage` and `CameraModelImageToWorld`,
+// which dispatch the camera model only once for all points instead of once per
+// point, so that the projection is inlined into a tight loop and vectorized by
+// the compiler. The output vector is resized and may be the input vector.
+//
+// @param model_id      Unique identifier of camera model.
+// @param params        Array of camera parameters.
+// @param world_points  Coordinates in camera system as (u, v, 1).
+// @param image_points  Image coordinates in pixels.
+inline void CameraModelWorldToImageBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& world_points,
+    std::vector<Eigen::Vector2d>* image_points);
+inline void CameraModelImageToWorldBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& image_points,
+    std::vector<Eigen::Vector2d>* world_points);
+
+// Refine approximate world points, e.g., interpolated from a precomputed
+// undistortion grid, with one Newton step on their projection to the given
+// image points. This is much cheaper than the full iterative undistortion of
+// distorted camera models if the initial world points are accurate.
+//
+// @param model_id      Unique identifier of camera model.
+// @param params        Array of camera parameters.
+// @param image_points  Image coordinates in pixels.
+// @param world_points  Initial and refined coordinates in camera system.
+inline void CameraModelRefineImageToWorld(const int model_id,
+                                          const std::vector<double>& params,
+                                          const double x, const double y,
+                                          double* u, double* v);
+inline void CameraModelRefineImageToWorldBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& image_points,
+    std::vector<Eigen::Vector2d>* world_points);
+
 // Convert pixel threshold in image plane to world space by dividing
 // the threshold through the mean focal length.
 //
@@ -587,6 +643,65 @@ void BaseCameraModel<CameraModel>::IterativeUndistortion(const T* params, T* u,
   *v = x(1);
 }
 
+template <typename CameraModel>
+template <typename T>
+void BaseCameraModel<CameraModel>::WorldToImageBatch(const T* params,
+                                                     const size_t num_points,
+                                                     const T* world_points,
+                                                     T* image_points) {
+  // Copy the parameters, so that the compiler can keep them in registers
+  // without having to assume that they alias with the output.
+  T local_params[CameraModel::kNumParams];
+  std::copy(params, params + CameraModel::kNumParams, local_params);
+  for (size_t i = 0; i < 2 * num_points; i += 2) {
+    CameraModel::WorldToImage(local_params, world_points[i],
+                              world_points[i + 1], &image_points[i],
+                              &image_points[i + 1]);
+  }
+}
+
+template <typename CameraModel>
+template <typename T>
+void BaseCameraModel<CameraModel>::RefineImageToWorldBatch(
+    const T* params, const size_t num_points, const T* image_points,
+    T* world_points) {
+  const T kStep = T(1e-6);
+  T local_params[CameraModel::kNumParams];
+  std::copy(params, params + CameraModel::kNumParams, local_params);
+  for (size_t i = 0; i < 2 * num_points; i += 2) {
+    const T u = world_points[i];
+    const T v = world_points[i + 1];
+    T x, y, x_du, y_du, x_dv, y_dv;
+    CameraModel::WorldToImage(local_params, u, v, &x, &y);
+    CameraModel::WorldToImage(local_params, u + kStep, v, &x_du, &y_du);
+    CameraModel::WorldToImage(local_params, u, v + kStep, &x_dv, &y_dv);
+    const T J00 = (x_du - x) / kStep;
+    const T J01 = (x_dv - x) / kStep;
+    const T J10 = (y_du - y) / kStep;
+    const T J11 = (y_dv - y) / kStep;
+    const T det = J00 * J11 - J01 * J10;
+    const T dx = x - image_points[i];
+    const T dy = y - image_points[i + 1];
+    world_points[i] = u - (J11 * dx - J01 * dy) / det;
+    world_points[i + 1] = v - (J00 * dy - J10 * dx) / det;
+  }
+}
+
+template <typename CameraModel>
+template <typename T>
+void BaseCameraModel<CameraModel>::ImageToWorldBatch(const T* params,
+                                                     const size_t num_points,
+                                                     const T* image_points,
+                                                     T* world_points) {
+  T local_params[CameraModel::kNumParams];
+  std::copy(params, params + CameraModel::kNumParams, local_params);
+  for (size_t i = 0; i < 2 * num_points; i += 2) {
+    CameraModel::ImageToWorld(local_params, image_points[i],
+                              image_points[i + 1], &world_points[i],
+                              &world_points[i + 1]);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SimplePinholeCameraModel
 
@@ -1512,6 +1627,95 @@ void CameraModelImageToWorld(const int model_id,
   }
 }
 
+void CameraModelWorldToImageBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& world_points,
+    std::vector<Eigen::Vector2d>* image_points) {
+  image_points->resize(world_points.size());
+  if (world_points.empty()) {
+    return;
+  }
+
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                   \
+  case CameraModel::kModelId:                                            \
+    CameraModel::WorldToImageBatch(params.data(), world_points.size(),   \
+                                   world_points.data()->data(),          \
+                                   image_points->data()->data());        \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+void CameraModelImageToWorldBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& image_points,
+    std::vector<Eigen::Vector2d>* world_points) {
+  world_points->resize(image_points.size());
+  if (image_points.empty()) {
+    return;
+  }
+
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                   \
+  case CameraModel::kModelId:                                            \
+    CameraModel::ImageToWorldBatch(params.data(), image_points.size(),   \
+                                   image_points.data()->data(),          \
+                                   world_points->data()->data());        \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+void CameraModelRefineImageToWorld(const int model_id,
+                                   const std::vector<double>& params,
+                                   const double x, const double y, double* u,
+                                   double* v) {
+  const double image_point[2] = {x, y};
+  double world_point[2] = {*u, *v};
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                  \
+  case CameraModel::kModelId:                                           \
+    CameraModel::RefineImageToWorldBatch(params.data(), 1, image_point, \
+                                         world_point);                  \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+  *u = world_point[0];
+  *v = world_point[1];
+}
+
+void CameraModelRefineImageToWorldBatch(
+    const int model_id, const std::vector<double>& params,
+    const std::vector<Eigen::Vector2d>& image_points,
+    std::vector<Eigen::Vector2d>* world_points) {
+  if (image_points.empty()) {
+    return;
+  }
+
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                       \
+  case CameraModel::kModelId:                                                \
+    CameraModel::RefineImageToWorldBatch(params.data(), image_points.size(), \
+                                         image_points.data()->data(),        \
+                                         world_points->data()->data());      \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
 double CameraModelImageToWorldThreshold(const int model_id,
                                         const std::vector<double>& params,
                                         const double threshold) {
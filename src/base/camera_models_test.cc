@@ -62,6 +62,43 @@ void TestImageToWorldToImage(const std::vector<double> params, const double x0,
   BOOST_CHECK_LT(std::abs(y - y0), 1e-6);
 }
 
+template <typename CameraModel>
+void TestBatch(const std::vector<double> params) {
+  std::vector<Eigen::Vector2d> world_points;
+  for (double u = -0.5; u <= 0.5; u += 0.1) {
+    for (double v = -0.5; v <= 0.5; v += 0.1) {
+      world_points.emplace_back(u, v);
+    }
+  }
+
+  std::vector<Eigen::Vector2d> image_points;
+  CameraModelWorldToImageBatch(CameraModel::model_id, params, world_points,
+                               &image_points);
+  BOOST_CHECK_EQUAL(image_points.size(), world_points.size());
+  for (size_t i = 0; i < world_points.size(); ++i) {
+    double x, y;
+    CameraModelWorldToImage(CameraModel::model_id, params, world_points[i](0),
+                            world_points[i](1), &x, &y);
+    BOOST_CHECK_EQUAL(image_points[i](0), x);
+    BOOST_CHECK_EQUAL(image_points[i](1), y);
+  }
+
+  std::vector<Eigen::Vector2d> points = image_points;
+  CameraModelImageToWorldBatch(CameraModel::model_id, params, points, &points);
+  BOOST_CHECK_EQUAL(points.size(), world_points.size());
+  for (size_t i = 0; i < world_points.size(); ++i) {
+    double u, v;
+    CameraModelImageToWorld(CameraModel::model_id, params, image_points[i](0),
+                            image_points[i](1), &u, &v);
+    BOOST_CHECK_EQUAL(points[i](0), u);
+    BOOST_CHECK_EQUAL(points[i](1), v);
+  }
+
+  CameraModelWorldToImageBatch(CameraModel::model_id, params,
+                               std::vector<Eigen::Vector2d>(), &points);
+  BOOST_CHECK(points.empty());
+}
+
 template <typename CameraModel>
 void TestModel(const std::vector<double>& params) {
   BOOST_CHECK(CameraModelVerifyParams(CameraModel::model_id, params));
@@ -128,6 +165,8 @@ void TestModel(const std::vector<double>& params) {
   const auto pp_idxs = CameraModel::principal_point_idxs;
   TestImageToWorldToImage<CameraModel>(params, params[pp_idxs.at(0)],
                                        params[pp_idxs.at(1)]);
+
+  TestBatch<CameraModel>(params);
 }
 
 BOOST_AUTO_TEST_CASE(TestSimplePinhole) {
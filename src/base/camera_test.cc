@@ -284,6 +284,53 @@ BOOST_AUTO_TEST_CASE(TestImageToWorld) {
   BOOST_CHECK_EQUAL(camera.ImageToWorld(Eigen::Vector2d(0.5, 0.5))(1), 0.0);
 }
 
+BOOST_AUTO_TEST_CASE(TestUndistortionGrid) {
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 100.0, 100, 80);
+  camera.ComputeUndistortionGrid();
+  BOOST_CHECK(!camera.HasUndistortionGrid());
+
+  camera.InitializeWithName("OPENCV", 100.0, 100, 80);
+  camera.SetParams({100.0, 110.0, 50.0, 40.0, 0.1, -0.05, 0.01, 0.02});
+  Camera camera_without_grid = camera;
+  camera.ComputeUndistortionGrid();
+  BOOST_CHECK(camera.HasUndistortionGrid());
+
+  std::vector<Eigen::Vector2d> image_points;
+  for (double x = -10; x <= 110; x += 2.5) {
+    for (double y = -10; y <= 90; y += 2.5) {
+      image_points.emplace_back(x, y);
+    }
+  }
+
+  std::vector<Eigen::Vector2d> world_points;
+  camera.ImageToWorld(image_points, &world_points);
+  BOOST_CHECK_EQUAL(world_points.size(), image_points.size());
+  for (size_t i = 0; i < image_points.size(); ++i) {
+    const Eigen::Vector2d world_point =
+        camera_without_grid.ImageToWorld(image_points[i]);
+    BOOST_CHECK_LT((camera.ImageToWorld(image_points[i]) - world_point).norm(),
+                   1e-8);
+    BOOST_CHECK_LT((world_points[i] - world_point).norm(), 1e-8);
+    BOOST_CHECK_LT(
+        (camera.WorldToImage(world_points[i]) - image_points[i]).norm(), 1e-6);
+  }
+
+  const Camera camera_copy = camera;
+  BOOST_CHECK(camera_copy.HasUndistortionGrid());
+
+  camera.Params(4) = 0.2;
+  BOOST_CHECK(!camera.HasUndistortionGrid());
+  camera_without_grid.Params(4) = 0.2;
+  BOOST_CHECK_EQUAL(camera.ImageToWorld(image_points[0]),
+                    camera_without_grid.ImageToWorld(image_points[0]));
+
+  camera.ComputeUndistortionGrid();
+  BOOST_CHECK(camera.HasUndistortionGrid());
+  camera.SetWidth(200);
+  BOOST_CHECK(!camera.HasUndistortionGrid());
+}
+
 BOOST_AUTO_TEST_CASE(TestImageToWorldThreshold) {
   Camera camera;
   BOOST_CHECK_THROW(camera.ImageToWorldThreshold(0), std::domain_error);
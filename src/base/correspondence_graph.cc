@@ -31,7 +31,7 @@
 
 #include "base/correspondence_graph.h"
 
-#include <unordered_set>
+#include <algorithm>
 
 #include "base/pose.h"
 #include "util/string.h"
@@ -52,26 +52,85 @@ CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
 }
 
 void CorrespondenceGraph::Finalize() {
+  if (finalized_) {
+    return;
+  }
+
+  size_t num_points2D = 0;
+  size_t num_corrs = 0;
+  std::vector<image_t> image_ids;
+  image_ids.reserve(images_.size());
+
   for (auto it = images_.begin(); it != images_.end();) {
     it->second.num_observations = 0;
-    for (auto& corr : it->second.corrs) {
-      corr.shrink_to_fit();
+    for (const auto& corr : it->second.corrs) {
       if (corr.size() > 0) {
         it->second.num_observations += 1;
+        num_corrs += corr.size();
       }
     }
     if (it->second.num_observations == 0) {
       images_.erase(it++);
     } else {
+      num_points2D += it->second.corrs.size();
+      image_ids.push_back(it->first);
       ++it;
     }
   }
+
+  // Store the images in a deterministic order, so that the correspondences
+  // of neighboring image identifiers are close in memory.
+  std::sort(image_ids.begin(), image_ids.end());
+
+  point_corrs_offsets_.clear();
+  point_corrs_offsets_.reserve(num_points2D + 1);
+  corrs_.clear();
+  corrs_.reserve(num_corrs);
+
+  for (const image_t image_id : image_ids) {
+    struct Image& image = images_.at(image_id);
+    image.point2D_offset = point_corrs_offsets_.size();
+    for (const auto& corr : image.corrs) {
+      point_corrs_offsets_.push_back(corrs_.size());
+      corrs_.insert(corrs_.end(), corr.begin(), corr.end());
+    }
+    // Release the per-point vectors immediately to limit the peak memory.
+    std::vector<std::vector<Correspondence>>().swap(image.corrs);
+  }
+
+  point_corrs_offsets_.push_back(corrs_.size());
+
+  finalized_ = true;
+}
+
+void CorrespondenceGraph::Unfinalize() {
+  if (!finalized_) {
+    return;
+  }
+
+  for (auto& image : images_) {
+    image.second.corrs.resize(image.second.num_points2D);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.num_points2D;
+         ++point2D_idx) {
+      const CorrespondenceRange corrs =
+          PointCorrespondences(image.second, point2D_idx);
+      image.second.corrs[point2D_idx].assign(corrs.begin(), corrs.end());
+    }
+  }
+
+  finalized_ = false;
+
+  std::vector<size_t>().swap(point_corrs_offsets_);
+  std::vector<Correspondence>().swap(corrs_);
 }
 
 void CorrespondenceGraph::AddImage(const image_t image_id,
                                    const size_t num_points) {
   CHECK(!ExistsImage(image_id));
-  images_[image_id].corrs.resize(num_points);
+  Unfinalize();
+  struct Image& image = images_[image_id];
+  image.num_points2D = static_cast<point2D_t>(num_points);
+  image.corrs.resize(num_points);
 }
 
 void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
@@ -84,6 +143,8 @@ void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
     return;
   }
 
+  Unfinalize();
+
   // Corresponding images.
   struct Image& image1 = images_.at(image_id1);
   struct Image& image2 = images_.at(image_id2);
@@ -160,12 +221,102 @@ void CorrespondenceGraph::AddCorrespondences(const image_t image_id1,
   }
 }
 
+void CorrespondenceGraph::UpdateNumObservations(const image_t image_id) {
+  struct Image& image = images_.at(image_id);
+  image.num_observations = 0;
+  for (point2D_t point2D_idx = 0; point2D_idx < image.num_points2D;
+       ++point2D_idx) {
+    if (!PointCorrespondences(image, point2D_idx).empty()) {
+      image.num_observations += 1;
+    }
+  }
+}
+
+CorrespondenceGraph CorrespondenceGraph::ExtractSubgraph(
+    const std::unordered_set<image_t>& image_ids) const {
+  CorrespondenceGraph subgraph;
+
+  // Count the correspondences of every image to the other given images.
+  size_t num_points2D = 0;
+  size_t num_corrs = 0;
+  std::vector<image_t> subgraph_image_ids;
+  subgraph_image_ids.reserve(image_ids.size());
+
+  for (const image_t image_id : image_ids) {
+    const auto image_it = images_.find(image_id);
+    if (image_it == images_.end()) {
+      continue;
+    }
+
+    const struct Image& image = image_it->second;
+    struct Image subgraph_image;
+    subgraph_image.num_points2D = image.num_points2D;
+    for (point2D_t point2D_idx = 0; point2D_idx < image.num_points2D;
+         ++point2D_idx) {
+      point2D_t num_point_corrs = 0;
+      for (const auto& corr : PointCorrespondences(image, point2D_idx)) {
+        if (image_ids.count(corr.image_id) > 0) {
+          num_point_corrs += 1;
+        }
+      }
+      if (num_point_corrs > 0) {
+        subgraph_image.num_observations += 1;
+        subgraph_image.num_correspondences += num_point_corrs;
+      }
+    }
+
+    if (subgraph_image.num_observations > 0) {
+      num_points2D += subgraph_image.num_points2D;
+      num_corrs += subgraph_image.num_correspondences;
+      subgraph_image_ids.push_back(image_id);
+      subgraph.images_.emplace(image_id, std::move(subgraph_image));
+    }
+  }
+
+  // Compact the correspondences in the same order as in `Finalize`.
+  std::sort(subgraph_image_ids.begin(), subgraph_image_ids.end());
+
+  subgraph.point_corrs_offsets_.reserve(num_points2D + 1);
+  subgraph.corrs_.reserve(num_corrs);
+
+  for (const image_t image_id : subgraph_image_ids) {
+    const struct Image& image = images_.at(image_id);
+    struct Image& subgraph_image = subgraph.images_.at(image_id);
+    subgraph_image.point2D_offset = subgraph.point_corrs_offsets_.size();
+    for (point2D_t point2D_idx = 0; point2D_idx < image.num_points2D;
+         ++point2D_idx) {
+      subgraph.point_corrs_offsets_.push_back(subgraph.corrs_.size());
+      for (const auto& corr : PointCorrespondences(image, point2D_idx)) {
+        if (image_ids.count(corr.image_id) > 0) {
+          subgraph.corrs_.push_back(corr);
+        }
+      }
+    }
+  }
+
+  subgraph.point_corrs_offsets_.push_back(subgraph.corrs_.size());
+  subgraph.finalized_ = true;
+
+  for (const auto& image_pair : image_pairs_) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(image_pair.first, &image_id1, &image_id2);
+    if (subgraph.ExistsImage(image_id1) && subgraph.ExistsImage(image_id2)) {
+      subgraph.image_pairs_.emplace(image_pair.first, image_pair.second);
+    }
+  }
+
+  return subgraph;
+}
+
 std::vector<CorrespondenceGraph::Correspondence>
 CorrespondenceGraph::FindTransitiveCorrespondences(
     const image_t image_id, const point2D_t point2D_idx,
     const size_t transitivity) const {
   if (transitivity == 1) {
-    return FindCorrespondences(image_id, point2D_idx);
+    const CorrespondenceRange corrs =
+        FindCorrespondences(image_id, point2D_idx);
+    return std::vector<Correspondence>(corrs.begin(), corrs.end());
   }
 
   std::vector<Correspondence> found_corrs;
@@ -187,9 +338,9 @@ CorrespondenceGraph::FindTransitiveCorrespondences(
     for (size_t i = corr_queue_begin; i < corr_queue_end; ++i) {
       const Correspondence ref_corr = found_corrs[i];
 
-      const Image& image = images_.at(ref_corr.image_id);
-      const std::vector<Correspondence>& ref_corrs =
-          image.corrs[ref_corr.point2D_idx];
+      const CorrespondenceRange ref_corrs =
+          PointCorrespondences(images_.at(ref_corr.image_id),
+                               ref_corr.point2D_idx);
 
       for (const Correspondence corr : ref_corrs) {
         // Check if correspondence already collected, otherwise collect.
@@ -235,9 +386,10 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
 
   const struct Image& image1 = images_.at(image_id1);
 
-  for (point2D_t point2D_idx1 = 0; point2D_idx1 < image1.corrs.size();
+  for (point2D_t point2D_idx1 = 0; point2D_idx1 < image1.num_points2D;
        ++point2D_idx1) {
-    for (const Correspondence& corr1 : image1.corrs[point2D_idx1]) {
+    for (const Correspondence& corr1 :
+         PointCorrespondences(image1, point2D_idx1)) {
       if (corr1.image_id == image_id2) {
         found_corrs.emplace_back(point2D_idx1, corr1.point2D_idx);
       }
@@ -249,15 +401,12 @@ FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
 
 bool CorrespondenceGraph::IsTwoViewObservation(
     const image_t image_id, const point2D_t point2D_idx) const {
-  const struct Image& image = images_.at(image_id);
-  const std::vector<Correspondence>& corrs = image.corrs.at(point2D_idx);
+  const CorrespondenceRange corrs = FindCorrespondences(image_id, point2D_idx);
   if (corrs.size() != 1) {
     return false;
   }
-  const struct Image& other_image = images_.at(corrs[0].image_id);
-  const std::vector<Correspondence>& other_corrs =
-      other_image.corrs.at(corrs[0].point2D_idx);
-  return other_corrs.size() == 1;
+  return FindCorrespondences(corrs[0].image_id, corrs[0].point2D_idx).size() ==
+         1;
 }
 
 }  // namespace colmap
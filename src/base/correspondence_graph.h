@@ -33,9 +33,11 @@
 #define COLMAP_SRC_BASE_CORRESPONDENCE_GRAPH_H_
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "base/database.h"
+#include "util/logging.h"
 #include "util/types.h"
 
 namespace colmap {
@@ -57,6 +59,31 @@ class CorrespondenceGraph {
     point2D_t point2D_idx;
   };
 
+  // Contiguous range of correspondences, which remains valid until the graph
+  // is modified or finalized.
+  class CorrespondenceRange {
+   public:
+    CorrespondenceRange() : begin_(nullptr), end_(nullptr) {}
+    CorrespondenceRange(const Correspondence* begin, const Correspondence* end)
+        : begin_(begin), end_(end) {}
+
+    inline const Correspondence* begin() const { return begin_; }
+    inline const Correspondence* end() const { return end_; }
+    inline size_t size() const { return static_cast<size_t>(end_ - begin_); }
+    inline bool empty() const { return begin_ == end_; }
+    inline const Correspondence& operator[](const size_t idx) const {
+      return begin_[idx];
+    }
+    inline const Correspondence& at(const size_t idx) const {
+      CHECK_LT(idx, size());
+      return begin_[idx];
+    }
+
+   private:
+    const Correspondence* begin_;
+    const Correspondence* end_;
+  };
+
   CorrespondenceGraph();
 
   // Number of added images.
@@ -88,10 +115,13 @@ class CorrespondenceGraph {
   // - Calculates the number of observations per image by counting the number
   //   of image points that have at least one correspondence.
   // - Deletes images without observations, as they are useless for SfM.
-  // - Shrinks the correspondence vectors to their size to save memory.
+  // - Compacts the correspondences into a compressed sparse row layout, in
+  //   which the correspondences of all image points are stored contiguously.
   void Finalize();
 
-  // Add new image to the correspondence graph.
+  // Add new image to the correspondence graph. Adding images or
+  // correspondences to a finalized graph expands the compacted layout again,
+  // so the graph should be finalized again after all changes.
   void AddImage(const image_t image_id, const size_t num_points2D);
 
   // Add correspondences between images. This function ignores invalid
@@ -101,8 +131,19 @@ class CorrespondenceGraph {
   void AddCorrespondences(const image_t image_id1, const image_t image_id2,
                           const FeatureMatches& matches);
 
+  // Recalculate the number of observations of a single image. This is
+  // otherwise only done in `Finalize`, but enables to keep the graph up-to-date
+  // when correspondences are added incrementally without finalizing it.
+  void UpdateNumObservations(const image_t image_id);
+
+  // Extract the finalized subgraph of the correspondences between the given
+  // images. As in `Finalize`, images without any correspondence to the other
+  // given images are not part of the subgraph.
+  CorrespondenceGraph ExtractSubgraph(
+      const std::unordered_set<image_t>& image_ids) const;
+
   // Find the correspondence of an image observation to all other images.
-  inline const std::vector<Correspondence>& FindCorrespondences(
+  inline CorrespondenceRange FindCorrespondences(
       const image_t image_id, const point2D_t point2D_idx) const;
 
   // Find correspondences to the given observation.
@@ -140,7 +181,13 @@ class CorrespondenceGraph {
     // to find a good initial pair, that is connected to many images.
     point2D_t num_correspondences = 0;
 
-    // Correspondences to other images per image point.
+    // Number of 2D points in the image.
+    point2D_t num_points2D = 0;
+
+    // Index of the first image point in `point_corrs_offsets_`, if finalized.
+    size_t point2D_offset = 0;
+
+    // Correspondences to other images per image point, if not finalized.
     std::vector<std::vector<Correspondence>> corrs;
   };
 
@@ -149,8 +196,23 @@ class CorrespondenceGraph {
     point2D_t num_correspondences = 0;
   };
 
+  // Expand the compacted layout of a finalized graph for modification.
+  void Unfinalize();
+
+  // Get the correspondences of an image point.
+  inline CorrespondenceRange PointCorrespondences(
+      const Image& image, const point2D_t point2D_idx) const;
+
   EIGEN_STL_UMAP(image_t, Image) images_;
   std::unordered_map<image_pair_t, ImagePair> image_pairs_;
+
+  // Compressed sparse row layout of the finalized graph. The correspondences
+  // of the global image point index `i` are stored in `corrs_` in the range
+  // `[point_corrs_offsets_[i], point_corrs_offsets_[i + 1])`, where the points
+  // of an image are indexed from `Image::point2D_offset` onward.
+  bool finalized_ = false;
+  std::vector<size_t> point_corrs_offsets_;
+  std::vector<Correspondence> corrs_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -189,15 +251,29 @@ point2D_t CorrespondenceGraph::NumCorrespondencesBetweenImages(
   }
 }
 
-const std::vector<CorrespondenceGraph::Correspondence>&
+CorrespondenceGraph::CorrespondenceRange
 CorrespondenceGraph::FindCorrespondences(const image_t image_id,
                                          const point2D_t point2D_idx) const {
-  return images_.at(image_id).corrs.at(point2D_idx);
+  return PointCorrespondences(images_.at(image_id), point2D_idx);
 }
 
 bool CorrespondenceGraph::HasCorrespondences(
     const image_t image_id, const point2D_t point2D_idx) const {
-  return !images_.at(image_id).corrs.at(point2D_idx).empty();
+  return !FindCorrespondences(image_id, point2D_idx).empty();
+}
+
+CorrespondenceGraph::CorrespondenceRange
+CorrespondenceGraph::PointCorrespondences(const Image& image,
+                                          const point2D_t point2D_idx) const {
+  if (finalized_) {
+    CHECK_LT(point2D_idx, image.num_points2D);
+    const size_t idx = image.point2D_offset + point2D_idx;
+    return CorrespondenceRange(corrs_.data() + point_corrs_offsets_[idx],
+                               corrs_.data() + point_corrs_offsets_[idx + 1]);
+  } else {
+    const std::vector<Correspondence>& corrs = image.corrs.at(point2D_idx);
+    return CorrespondenceRange(corrs.data(), corrs.data() + corrs.size());
+  }
 }
 
 }  // namespace colmap
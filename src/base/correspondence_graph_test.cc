@@ -371,3 +371,143 @@ BOOST_AUTO_TEST_CASE(TestDuplicate) {
   BOOST_CHECK_EQUAL(
       correspondence_graph.NumCorrespondencesBetweenImages().at(pair_id), 3);
 }
+
+BOOST_AUTO_TEST_CASE(TestFinalize) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 10);
+  FeatureMatches matches01;
+  FeatureMatches matches12;
+  for (point2D_t i = 0; i < 5; ++i) {
+    matches01.emplace_back(i, i + 1);
+    matches12.emplace_back(i + 3, 9 - i);
+  }
+  correspondence_graph.AddCorrespondences(0, 1, matches01);
+  correspondence_graph.AddCorrespondences(1, 2, matches12);
+
+  std::vector<std::vector<CorrespondenceGraph::Correspondence>> corrs;
+  for (image_t image_id = 0; image_id < 3; ++image_id) {
+    for (point2D_t point2D_idx = 0; point2D_idx < 10; ++point2D_idx) {
+      const auto point_corrs =
+          correspondence_graph.FindCorrespondences(image_id, point2D_idx);
+      corrs.emplace_back(point_corrs.begin(), point_corrs.end());
+    }
+  }
+
+  const auto CheckCorrespondences = [&]() {
+    size_t i = 0;
+    for (image_t image_id = 0; image_id < 3; ++image_id) {
+      for (point2D_t point2D_idx = 0; point2D_idx < 10; ++point2D_idx) {
+        const auto point_corrs =
+            correspondence_graph.FindCorrespondences(image_id, point2D_idx);
+        BOOST_CHECK_EQUAL(point_corrs.size(), corrs[i].size());
+        BOOST_CHECK_EQUAL(
+            correspondence_graph.HasCorrespondences(image_id, point2D_idx),
+            !corrs[i].empty());
+        for (size_t j = 0; j < point_corrs.size(); ++j) {
+          BOOST_CHECK_EQUAL(point_corrs[j].image_id, corrs[i][j].image_id);
+          BOOST_CHECK_EQUAL(point_corrs[j].point2D_idx,
+                            corrs[i][j].point2D_idx);
+        }
+        i += 1;
+      }
+    }
+  };
+
+  correspondence_graph.Finalize();
+  CheckCorrespondences();
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindTransitiveCorrespondences(0, 3, 2).size(), 2);
+  BOOST_CHECK_EQUAL(
+      correspondence_graph.FindCorrespondencesBetweenImages(1, 2).size(), 5);
+  BOOST_CHECK(correspondence_graph.IsTwoViewObservation(1, 6));
+  BOOST_CHECK(!correspondence_graph.IsTwoViewObservation(1, 3));
+
+  // Modifying a finalized graph expands and compacts it again.
+  correspondence_graph.AddCorrespondences(0, 2, {FeatureMatch(9, 0)});
+  corrs[9].emplace_back(2, 0);
+  corrs[20].emplace_back(0, 9);
+  CheckCorrespondences();
+  correspondence_graph.Finalize();
+  CheckCorrespondences();
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(0), 6);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(2), 6);
+}
+
+BOOST_AUTO_TEST_CASE(TestUpdateNumObservations) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddCorrespondences(
+      0, 1, {FeatureMatch(0, 0), FeatureMatch(1, 2)});
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(0), 0);
+  correspondence_graph.UpdateNumObservations(0);
+  correspondence_graph.UpdateNumObservations(1);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(0), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(1), 2);
+  correspondence_graph.Finalize();
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddCorrespondences(
+      0, 2, {FeatureMatch(0, 0), FeatureMatch(5, 1)});
+  correspondence_graph.UpdateNumObservations(0);
+  correspondence_graph.UpdateNumObservations(2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(0), 3);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(1), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(2), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestExtractSubgraph) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddImage(3, 10);
+  FeatureMatches matches01;
+  FeatureMatches matches12;
+  for (point2D_t i = 0; i < 5; ++i) {
+    matches01.emplace_back(i, i + 1);
+    matches12.emplace_back(i + 3, 9 - i);
+  }
+  correspondence_graph.AddCorrespondences(0, 1, matches01);
+  correspondence_graph.AddCorrespondences(1, 2, matches12);
+  correspondence_graph.AddCorrespondences(2, 3, {FeatureMatch(0, 0)});
+  correspondence_graph.Finalize();
+
+  const CorrespondenceGraph subgraph =
+      correspondence_graph.ExtractSubgraph({1, 2, 4});
+  BOOST_CHECK_EQUAL(subgraph.NumImages(), 2);
+  BOOST_CHECK(!subgraph.ExistsImage(0));
+  BOOST_CHECK(subgraph.ExistsImage(1));
+  BOOST_CHECK(subgraph.ExistsImage(2));
+  BOOST_CHECK(!subgraph.ExistsImage(3));
+  BOOST_CHECK_EQUAL(subgraph.NumImagePairs(), 1);
+  BOOST_CHECK_EQUAL(subgraph.NumCorrespondencesBetweenImages(1, 2), 5);
+  BOOST_CHECK_EQUAL(subgraph.NumCorrespondencesBetweenImages(0, 1), 0);
+  BOOST_CHECK_EQUAL(subgraph.NumObservationsForImage(1), 5);
+  BOOST_CHECK_EQUAL(subgraph.NumCorrespondencesForImage(1), 5);
+  BOOST_CHECK_EQUAL(subgraph.NumObservationsForImage(2), 5);
+  BOOST_CHECK_EQUAL(subgraph.NumCorrespondencesForImage(2), 5);
+  for (point2D_t point2D_idx = 0; point2D_idx < 10; ++point2D_idx) {
+    for (const image_t image_id : {1, 2}) {
+      const auto graph_corrs =
+          correspondence_graph.FindCorrespondences(image_id, point2D_idx);
+      std::vector<CorrespondenceGraph::Correspondence> expected_corrs;
+      for (const auto& corr : graph_corrs) {
+        if (corr.image_id == 1 || corr.image_id == 2) {
+          expected_corrs.push_back(corr);
+        }
+      }
+      const auto subgraph_corrs =
+          subgraph.FindCorrespondences(image_id, point2D_idx);
+      BOOST_CHECK_EQUAL(subgraph_corrs.size(), expected_corrs.size());
+      for (size_t i = 0; i < subgraph_corrs.size(); ++i) {
+        BOOST_CHECK_EQUAL(subgraph_corrs[i].image_id,
+                          expected_corrs[i].image_id);
+        BOOST_CHECK_EQUAL(subgraph_corrs[i].point2D_idx,
+                          expected_corrs[i].point2D_idx);
+      }
+    }
+  }
+  BOOST_CHECK(subgraph.IsTwoViewObservation(1, 3));
+}
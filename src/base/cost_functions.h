@@ -32,13 +32,483 @@
 #ifndef COLMAP_SRC_BASE_COST_FUNCTIONS_H_
 #define COLMAP_SRC_BASE_COST_FUNCTIONS_H_
 
+#include <type_traits>
+
 #include <Eigen/Core>
 
 #include <ceres/ceres.h>
 #include <ceres/rotation.h>
 
+#include "base/camera_models.h"
+
 namespace colmap {
 
+// Projection of normalized image coordinates to pixel coordinates with
+// analytic Jacobians w.r.t. the normalized coordinates (2x2, row-major) and
+// w.r.t. the camera parameters (2xkNumParams, row-major). The specializations
+// below are used by the standard bundle adjustment cost functions instead of
+// automatic differentiation, which is used for all other camera models.
+template <typename CameraModel>
+struct AnalyticCameraModel : std::false_type {};
+
+template <>
+struct AnalyticCameraModel<SimplePinholeCameraModel> : std::true_type {
+  static void WorldToImage(const double* params, const double u,
+                           const double v, double* x, double* y,
+                           double* J_uv, double* J_params) {
+    const double f = params[0];
+    *x = f * u + params[1];
+    *y = f * v + params[2];
+
+    J_uv[0] = f;
+    J_uv[1] = 0;
+    J_uv[2] = 0;
+    J_uv[3] = f;
+
+    J_params[0] = u;
+    J_params[1] = 1;
+    J_params[2] = 0;
+    J_params[3] = v;
+    J_params[4] = 0;
+    J_params[5] = 1;
+  }
+};
+
+template <>
+struct AnalyticCameraModel<PinholeCameraModel> : std::true_type {
+  static void WorldToImage(const double* params, const double u,
+                           const double v, double* x, double* y,
+                           double* J_uv, double* J_params) {
+    const double f1 = params[0];
+    const double f2 = params[1];
+    *x = f1 * u + params[2];
+    *y = f2 * v + params[3];
+
+    J_uv[0] = f1;
+    J_uv[1] = 0;
+    J_uv[2] = 0;
+    J_uv[3] = f2;
+
+    J_params[0] = u;
+    J_params[1] = 0;
+    J_params[2] = 1;
+    J_params[3] = 0;
+    J_params[4] = 0;
+    J_params[5] = v;
+    J_params[6] = 0;
+    J_params[7] = 1;
+  }
+};
+
+template <>
+struct AnalyticCameraModel<SimpleRadialCameraModel> : std::true_type {
+  static void WorldToImage(const double* params, const double u,
+                           const double v, double* x, double* y,
+                           double* J_uv, double* J_params) {
+    const double f = params[0];
+    const double k = params[3];
+
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double radial = 1 + k * r2;
+    const double xd = u * radial;
+    const double yd = v * radial;
+    *x = f * xd + params[1];
+    *y = f * yd + params[2];
+
+    J_uv[0] = f * (radial + 2 * k * u2);
+    J_uv[1] = f * 2 * k * uv;
+    J_uv[2] = J_uv[1];
+    J_uv[3] = f * (radial + 2 * k * v2);
+
+    J_params[0] = xd;
+    J_params[1] = 1;
+    J_params[2] = 0;
+    J_params[3] = f * u * r2;
+    J_params[4] = yd;
+    J_params[5] = 0;
+    J_params[6] = 1;
+    J_params[7] = f * v * r2;
+  }
+};
+
+template <>
+struct AnalyticCameraModel<RadialCameraModel> : std::true_type {
+  static void WorldToImage(const double* params, const double u,
+                           const double v, double* x, double* y,
+                           double* J_uv, double* J_params) {
+    const double f = params[0];
+    const double k1 = params[3];
+    const double k2 = params[4];
+
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double r4 = r2 * r2;
+    const double radial = 1 + k1 * r2 + k2 * r4;
+    const double d_radial = 2 * (k1 + 2 * k2 * r2);
+    const double xd = u * radial;
+    const double yd = v * radial;
+    *x = f * xd + params[1];
+    *y = f * yd + params[2];
+
+    J_uv[0] = f * (radial + u2 * d_radial);
+    J_uv[1] = f * uv * d_radial;
+    J_uv[2] = J_uv[1];
+    J_uv[3] = f * (radial + v2 * d_radial);
+
+    J_params[0] = xd;
+    J_params[1] = 1;
+    J_params[2] = 0;
+    J_params[3] = f * u * r2;
+    J_params[4] = f * u * r4;
+    J_params[5] = yd;
+    J_params[6] = 0;
+    J_params[7] = 1;
+    J_params[8] = f * v * r2;
+    J_params[9] = f * v * r4;
+  }
+};
+
+template <>
+struct AnalyticCameraModel<OpenCVCameraModel> : std::true_type {
+  static void WorldToImage(const double* params, const double u,
+                           const double v, double* x, double* y,
+                           double* J_uv, double* J_params) {
+    const double f1 = params[0];
+    const double f2 = params[1];
+    const double k1 = params[4];
+    const double k2 = params[5];
+    const double p1 = params[6];
+    const double p2 = params[7];
+
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double r4 = r2 * r2;
+    const double radial = 1 + k1 * r2 + k2 * r4;
+    const double d_radial = 2 * (k1 + 2 * k2 * r2);
+    const double xd = u * radial + 2 * p1 * uv + p2 * (r2 + 2 * u2);
+    const double yd = v * radial + 2 * p2 * uv + p1 * (r2 + 2 * v2);
+    *x = f1 * xd + params[2];
+    *y = f2 * yd + params[3];
+
+    J_uv[0] = f1 * (radial + u2 * d_radial + 2 * p1 * v + 6 * p2 * u);
+    J_uv[1] = f1 * (uv * d_radial + 2 * p1 * u + 2 * p2 * v);
+    J_uv[2] = f2 * (uv * d_radial + 2 * p2 * v + 2 * p1 * u);
+    J_uv[3] = f2 * (radial + v2 * d_radial + 2 * p2 * u + 6 * p1 * v);
+
+    J_params[0] = xd;
+    J_params[1] = 0;
+    J_params[2] = 1;
+    J_params[3] = 0;
+    J_params[4] = f1 * u * r2;
+    J_params[5] = f1 * u * r4;
+    J_params[6] = f1 * 2 * uv;
+    J_params[7] = f1 * (r2 + 2 * u2);
+    J_params[8] = 0;
+    J_params[9] = yd;
+    J_params[10] = 0;
+    J_params[11] = 1;
+    J_params[12] = f2 * v * r2;
+    J_params[13] = f2 * v * r4;
+    J_params[14] = f2 * (r2 + 2 * v2);
+    J_params[15] = f2 * 2 * uv;
+  }
+};
+
+// Compute the derivatives of `ceres::UnitQuaternionRotatePoint` w.r.t. the
+// point (3x3, row-major), which equals the rotation matrix for unit
+// quaternions, and optionally w.r.t. the quaternion (3x4, row-major).
+inline void UnitQuaternionRotatePointJacobians(const double* qvec,
+                                               const double* point,
+                                               double* J_point,
+                                               double* J_qvec) {
+  const double qw = qvec[0];
+  const double qx = qvec[1];
+  const double qy = qvec[2];
+  const double qz = qvec[3];
+
+  J_point[0] = 1 - 2 * (qy * qy + qz * qz);
+  J_point[1] = 2 * (qx * qy - qw * qz);
+  J_point[2] = 2 * (qw * qy + qx * qz);
+  J_point[3] = 2 * (qw * qz + qx * qy);
+  J_point[4] = 1 - 2 * (qx * qx + qz * qz);
+  J_point[5] = 2 * (qy * qz - qw * qx);
+  J_point[6] = 2 * (qx * qz - qw * qy);
+  J_point[7] = 2 * (qw * qx + qy * qz);
+  J_point[8] = 1 - 2 * (qx * qx + qy * qy);
+
+  if (J_qvec == nullptr) {
+    return;
+  }
+
+  const double p0 = point[0];
+  const double p1 = point[1];
+  const double p2 = point[2];
+
+  J_qvec[0] = 2 * (qy * p2 - qz * p1);
+  J_qvec[1] = 2 * (qy * p1 + qz * p2);
+  J_qvec[2] = 2 * (-2 * qy * p0 + qx * p1 + qw * p2);
+  J_qvec[3] = 2 * (-2 * qz * p0 - qw * p1 + qx * p2);
+  J_qvec[4] = 2 * (qz * p0 - qx * p2);
+  J_qvec[5] = 2 * (qy * p0 - 2 * qx * p1 - qw * p2);
+  J_qvec[6] = 2 * (qx * p0 + qz * p2);
+  J_qvec[7] = 2 * (qw * p0 - 2 * qz * p1 + qy * p2);
+  J_qvec[8] = 2 * (qx * p1 - qy * p0);
+  J_qvec[9] = 2 * (qz * p0 + qw * p1 - 2 * qx * p2);
+  J_qvec[10] = 2 * (qz * p1 - qw * p0 - 2 * qy * p2);
+  J_qvec[11] = 2 * (qx * p0 + qy * p1);
+}
+
+// Multiply the row-major matrices A (2xN) and B (NxM) into C (2xM).
+template <int N, int M>
+inline void MultiplyJacobians(const double* A, const double* B, double* C) {
+  for (int r = 0; r < 2; ++r) {
+    for (int c = 0; c < M; ++c) {
+      double value = 0;
+      for (int k = 0; k < N; ++k) {
+        value += A[N * r + k] * B[M * k + c];
+      }
+      C[M * r + c] = value;
+    }
+  }
+}
+
+// Project the point X in the camera frame and evaluate the re-projection error
+// and its derivatives w.r.t. the point X (2x3, row-major) and optionally the
+// camera parameters (2xkNumParams, row-major).
+template <typename CameraModel>
+inline void EvaluateAnalyticProjection(const double* X,
+                                       const double* camera_params,
+                                       const double observed_x,
+                                       const double observed_y,
+                                       double* residuals, double* J_X,
+                                       double* J_camera_params) {
+  // Project to image plane.
+  const double inv_z = 1 / X[2];
+  const double u = X[0] * inv_z;
+  const double v = X[1] * inv_z;
+
+  // Distort and transform to pixel space.
+  double J_uv[4];
+  double J_params[2 * CameraModel::kNumParams];
+  AnalyticCameraModel<CameraModel>::WorldToImage(
+      camera_params, u, v, &residuals[0], &residuals[1], J_uv, J_params);
+
+  // Re-projection error.
+  residuals[0] -= observed_x;
+  residuals[1] -= observed_y;
+
+  if (J_camera_params != nullptr) {
+    for (size_t i = 0; i < 2 * CameraModel::kNumParams; ++i) {
+      J_camera_params[i] = J_params[i];
+    }
+  }
+
+  J_X[0] = J_uv[0] * inv_z;
+  J_X[1] = J_uv[1] * inv_z;
+  J_X[2] = -(J_uv[0] * u + J_uv[1] * v) * inv_z;
+  J_X[3] = J_uv[2] * inv_z;
+  J_X[4] = J_uv[3] * inv_z;
+  J_X[5] = -(J_uv[2] * u + J_uv[3] * v) * inv_z;
+}
+
+// Evaluate the re-projection error of a point for the given (not necessarily
+// normalized) quaternion, translation, and camera parameters, and optionally
+// the Jacobians w.r.t. the quaternion (2x4), the translation (2x3), the point
+// (2x3), and the camera parameters (2xkNumParams). All Jacobians are row-major
+// and may be null. The Jacobians are identical to the automatic derivatives
+// of `ceres::UnitQuaternionRotatePoint` followed by the camera projection.
+template <typename CameraModel>
+void EvaluateAnalyticReprojectionError(
+    const double* qvec, const double* tvec, const double* point3D,
+    const double* camera_params, const double observed_x,
+    const double observed_y, double* residuals, double* J_qvec,
+    double* J_tvec, double* J_point3D, double* J_camera_params) {
+  double R[9];
+  double J_rot[12];
+  UnitQuaternionRotatePointJacobians(qvec, point3D, R,
+                                     J_qvec == nullptr ? nullptr : J_rot);
+
+  const double X[3] = {
+      R[0] * point3D[0] + R[1] * point3D[1] + R[2] * point3D[2] + tvec[0],
+      R[3] * point3D[0] + R[4] * point3D[1] + R[5] * point3D[2] + tvec[1],
+      R[6] * point3D[0] + R[7] * point3D[1] + R[8] * point3D[2] + tvec[2]};
+
+  double J_X[6];
+  EvaluateAnalyticProjection<CameraModel>(X, camera_params, observed_x,
+                                          observed_y, residuals, J_X,
+                                          J_camera_params);
+
+  if (J_tvec != nullptr) {
+    for (int i = 0; i < 6; ++i) {
+      J_tvec[i] = J_X[i];
+    }
+  }
+
+  if (J_point3D != nullptr) {
+    MultiplyJacobians<3, 3>(J_X, R, J_point3D);
+  }
+
+  if (J_qvec != nullptr) {
+    MultiplyJacobians<3, 4>(J_X, J_rot, J_qvec);
+  }
+}
+
+// Evaluate the re-projection error of a point in a camera rig, analogous to
+// `RigBundleAdjustmentCostFunction`, and optionally the Jacobians w.r.t. the
+// rig quaternion (2x4), the rig translation (2x3), the relative quaternion
+// (2x4), the relative translation (2x3), the point (2x3), and the camera
+// parameters (2xkNumParams). All Jacobians are row-major and may be null.
+template <typename CameraModel>
+void EvaluateAnalyticRigReprojectionError(
+    const double* rig_qvec, const double* rig_tvec, const double* rel_qvec,
+    const double* rel_tvec, const double* point3D, const double* camera_params,
+    const double observed_x, const double observed_y, double* residuals,
+    double* J_rig_qvec, double* J_rig_tvec, double* J_rel_qvec,
+    double* J_rel_tvec, double* J_point3D, double* J_camera_params) {
+  // Concatenate rotations.
+  double qvec[4];
+  ceres::QuaternionProduct(rel_qvec, rig_qvec, qvec);
+
+  double R[9];
+  double J_rot[12];
+  UnitQuaternionRotatePointJacobians(qvec, point3D, R, J_rot);
+
+  double R_rel[9];
+  double J_rel_rot[12];
+  UnitQuaternionRotatePointJacobians(rel_qvec, rig_tvec, R_rel, J_rel_rot);
+
+  // Rotate and translate with the concatenated pose.
+  double X[3];
+  for (int i = 0; i < 3; ++i) {
+    X[i] = R[3 * i] * point3D[0] + R[3 * i + 1] * point3D[1] +
+           R[3 * i + 2] * point3D[2] + R_rel[3 * i] * rig_tvec[0] +
+           R_rel[3 * i + 1] * rig_tvec[1] + R_rel[3 * i + 2] * rig_tvec[2] +
+           rel_tvec[i];
+  }
+
+  double J_X[6];
+  EvaluateAnalyticProjection<CameraModel>(X, camera_params, observed_x,
+                                          observed_y, residuals, J_X,
+                                          J_camera_params);
+
+  if (J_rel_tvec != nullptr) {
+    for (int i = 0; i < 6; ++i) {
+      J_rel_tvec[i] = J_X[i];
+    }
+  }
+
+  if (J_rig_tvec != nullptr) {
+    MultiplyJacobians<3, 3>(J_X, R_rel, J_rig_tvec);
+  }
+
+  if (J_point3D != nullptr) {
+    MultiplyJacobians<3, 3>(J_X, R, J_point3D);
+  }
+
+  if (J_rig_qvec == nullptr && J_rel_qvec == nullptr) {
+    return;
+  }
+
+  // Derivative w.r.t. the concatenated quaternion.
+  double J_qvec[8];
+  MultiplyJacobians<3, 4>(J_X, J_rot, J_qvec);
+
+  if (J_rig_qvec != nullptr) {
+    // Derivative of the quaternion product w.r.t. the right quaternion.
+    const double* z = rel_qvec;
+    const double J_product[16] = {z[0], -z[1], -z[2], -z[3],  //
+                                  z[1], z[0],  -z[3], z[2],   //
+                                  z[2], z[3],  z[0],  -z[1],  //
+                                  z[3], -z[2], z[1],  z[0]};
+    MultiplyJacobians<4, 4>(J_qvec, J_product, J_rig_qvec);
+  }
+
+  if (J_rel_qvec != nullptr) {
+    // Derivative of the quaternion product w.r.t. the left quaternion.
+    const double* w = rig_qvec;
+    const double J_product[16] = {w[0], -w[1], -w[2], -w[3],  //
+                                  w[1], w[0],  w[3],  -w[2],  //
+                                  w[2], -w[3], w[0],  w[1],   //
+                                  w[3], w[2],  -w[1], w[0]};
+    MultiplyJacobians<4, 4>(J_qvec, J_product, J_rel_qvec);
+    double J_rel_tvec_rot[8];
+    MultiplyJacobians<3, 4>(J_X, J_rel_rot, J_rel_tvec_rot);
+    for (int i = 0; i < 8; ++i) {
+      J_rel_qvec[i] += J_rel_tvec_rot[i];
+    }
+  }
+}
+
+// Analytic version of `BundleAdjustmentCostFunction`.
+template <typename CameraModel>
+class AnalyticBundleAdjustmentCostFunction
+    : public ceres::SizedCostFunction<2, 4, 3, 3, CameraModel::kNumParams> {
+ public:
+  explicit AnalyticBundleAdjustmentCostFunction(const Eigen::Vector2d& point2D)
+      : observed_x_(point2D(0)), observed_y_(point2D(1)) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    if (jacobians == nullptr) {
+      EvaluateAnalyticReprojectionError<CameraModel>(
+          parameters[0], parameters[1], parameters[2], parameters[3],
+          observed_x_, observed_y_, residuals, nullptr, nullptr, nullptr,
+          nullptr);
+    } else {
+      EvaluateAnalyticReprojectionError<CameraModel>(
+          parameters[0], parameters[1], parameters[2], parameters[3],
+          observed_x_, observed_y_, residuals, jacobians[0], jacobians[1],
+          jacobians[2], jacobians[3]);
+    }
+    return true;
+  }
+
+ private:
+  const double observed_x_;
+  const double observed_y_;
+};
+
+// Analytic version of `BundleAdjustmentConstantPoseCostFunction`.
+template <typename CameraModel>
+class AnalyticBundleAdjustmentConstantPoseCostFunction
+    : public ceres::SizedCostFunction<2, 3, CameraModel::kNumParams> {
+ public:
+  AnalyticBundleAdjustmentConstantPoseCostFunction(
+      const Eigen::Vector4d& qvec, const Eigen::Vector3d& tvec,
+      const Eigen::Vector2d& point2D)
+      : qvec_{qvec(0), qvec(1), qvec(2), qvec(3)},
+        tvec_{tvec(0), tvec(1), tvec(2)},
+        observed_x_(point2D(0)),
+        observed_y_(point2D(1)) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    if (jacobians == nullptr) {
+      EvaluateAnalyticReprojectionError<CameraModel>(
+          qvec_, tvec_, parameters[0], parameters[1], observed_x_, observed_y_,
+          residuals, nullptr, nullptr, nullptr, nullptr);
+    } else {
+      EvaluateAnalyticReprojectionError<CameraModel>(
+          qvec_, tvec_, parameters[0], parameters[1], observed_x_, observed_y_,
+          residuals, nullptr, nullptr, jacobians[0], jacobians[1]);
+    }
+    return true;
+  }
+
+ private:
+  const double qvec_[4];
+  const double tvec_[3];
+  const double observed_x_;
+  const double observed_y_;
+};
+
 // Standard bundle adjustment cost function for variable
 // camera pose and calibration and point parameters.
 template <typename CameraModel>
@@ -47,7 +517,14 @@ class BundleAdjustmentCostFunction {
   explicit BundleAdjustmentCostFunction(const Eigen::Vector2d& point2D)
       : observed_x_(point2D(0)), observed_y_(point2D(1)) {}
 
+  // Creates the analytic cost function for models with an
+  // `AnalyticCameraModel` specialization and otherwise uses automatic
+  // differentiation.
   static ceres::CostFunction* Create(const Eigen::Vector2d& point2D) {
+    return Create(point2D, AnalyticCameraModel<CameraModel>());
+  }
+
+  static ceres::CostFunction* CreateAutoDiff(const Eigen::Vector2d& point2D) {
     return (new ceres::AutoDiffCostFunction<
             BundleAdjustmentCostFunction<CameraModel>, 2, 4, 3, 3,
             CameraModel::kNumParams>(
@@ -81,6 +558,16 @@ class BundleAdjustmentCostFunction {
   }
 
  private:
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D,
+                                     std::true_type) {
+    return new AnalyticBundleAdjustmentCostFunction<CameraModel>(point2D);
+  }
+
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D,
+                                     std::false_type) {
+    return CreateAutoDiff(point2D);
+  }
+
   const double observed_x_;
   const double observed_y_;
 };
@@ -103,9 +590,18 @@ class BundleAdjustmentConstantPoseCostFunction {
         observed_x_(point2D(0)),
         observed_y_(point2D(1)) {}
 
+  // Creates the analytic cost function for models with an
+  // `AnalyticCameraModel` specialization and otherwise uses automatic
+  // differentiation.
   static ceres::CostFunction* Create(const Eigen::Vector4d& qvec,
                                      const Eigen::Vector3d& tvec,
                                      const Eigen::Vector2d& point2D) {
+    return Create(qvec, tvec, point2D, AnalyticCameraModel<CameraModel>());
+  }
+
+  static ceres::CostFunction* CreateAutoDiff(const Eigen::Vector4d& qvec,
+                                             const Eigen::Vector3d& tvec,
+                                             const Eigen::Vector2d& point2D) {
     return (new ceres::AutoDiffCostFunction<
             BundleAdjustmentConstantPoseCostFunction<CameraModel>, 2, 3,
             CameraModel::kNumParams>(
@@ -140,6 +636,21 @@ class BundleAdjustmentConstantPoseCostFunction {
   }
 
  private:
+  static ceres::CostFunction* Create(const Eigen::Vector4d& qvec,
+                                     const Eigen::Vector3d& tvec,
+                                     const Eigen::Vector2d& point2D,
+                                     std::true_type) {
+    return new AnalyticBundleAdjustmentConstantPoseCostFunction<CameraModel>(
+        qvec, tvec, point2D);
+  }
+
+  static ceres::CostFunction* Create(const Eigen::Vector4d& qvec,
+                                     const Eigen::Vector3d& tvec,
+                                     const Eigen::Vector2d& point2D,
+                                     std::false_type) {
+    return CreateAutoDiff(qvec, tvec, point2D);
+  }
+
   const double qw_;
   const double qx_;
   const double qy_;
@@ -151,6 +662,38 @@ class BundleAdjustmentConstantPoseCostFunction {
   const double observed_y_;
 };
 
+// Analytic version of `RigBundleAdjustmentCostFunction`.
+template <typename CameraModel>
+class AnalyticRigBundleAdjustmentCostFunction
+    : public ceres::SizedCostFunction<2, 4, 3, 4, 3, 3,
+                                      CameraModel::kNumParams> {
+ public:
+  explicit AnalyticRigBundleAdjustmentCostFunction(
+      const Eigen::Vector2d& point2D)
+      : observed_x_(point2D(0)), observed_y_(point2D(1)) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals,
+                double** jacobians) const override {
+    if (jacobians == nullptr) {
+      EvaluateAnalyticRigReprojectionError<CameraModel>(
+          parameters[0], parameters[1], parameters[2], parameters[3],
+          parameters[4], parameters[5], observed_x_, observed_y_, residuals,
+          nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    } else {
+      EvaluateAnalyticRigReprojectionError<CameraModel>(
+          parameters[0], parameters[1], parameters[2], parameters[3],
+          parameters[4], parameters[5], observed_x_, observed_y_, residuals,
+          jacobians[0], jacobians[1], jacobians[2], jacobians[3], jacobians[4],
+          jacobians[5]);
+    }
+    return true;
+  }
+
+ private:
+  const double observed_x_;
+  const double observed_y_;
+};
+
 // Rig bundle adjustment cost function for variable camera pose and calibration
 // and point parameters. Different from the standard bundle adjustment function,
 // this cost function is suitable for camera rigs with consistent relative poses
@@ -163,7 +706,14 @@ class RigBundleAdjustmentCostFunction {
   explicit RigBundleAdjustmentCostFunction(const Eigen::Vector2d& point2D)
       : observed_x_(point2D(0)), observed_y_(point2D(1)) {}
 
+  // Creates the analytic cost function for models with an
+  // `AnalyticCameraModel` specialization and otherwise uses automatic
+  // differentiation.
   static ceres::CostFunction* Create(const Eigen::Vector2d& point2D) {
+    return Create(point2D, AnalyticCameraModel<CameraModel>());
+  }
+
+  static ceres::CostFunction* CreateAutoDiff(const Eigen::Vector2d& point2D) {
     return (new ceres::AutoDiffCostFunction<
             RigBundleAdjustmentCostFunction<CameraModel>, 2, 4, 3, 4, 3, 3,
             CameraModel::kNumParams>(
@@ -209,6 +759,16 @@ class RigBundleAdjustmentCostFunction {
   }
 
  private:
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D,
+                                     std::true_type) {
+    return new AnalyticRigBundleAdjustmentCostFunction<CameraModel>(point2D);
+  }
+
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D,
+                                     std::false_type) {
+    return CreateAutoDiff(point2D);
+  }
+
   const double observed_x_;
   const double observed_y_;
 };
@@ -267,6 +827,44 @@ class RelativePoseCostFunction {
   const double y2_;
 };
 
+// Cost function for a prior on the position of the projection center of an
+// image, e.g. from GPS, whose residual is the difference of the projection
+// center -R^T * t to the prior position scaled by the given weight.
+class PositionPriorCostFunction {
+ public:
+  PositionPriorCostFunction(const Eigen::Vector3d& position,
+                            const double weight)
+      : x_(position(0)), y_(position(1)), z_(position(2)), weight_(weight) {}
+
+  static ceres::CostFunction* Create(const Eigen::Vector3d& position,
+                                     const double weight) {
+    return (
+        new ceres::AutoDiffCostFunction<PositionPriorCostFunction, 3, 4, 3>(
+            new PositionPriorCostFunction(position, weight)));
+  }
+
+  template <typename T>
+  bool operator()(const T* const qvec, const T* const tvec,
+                  T* residuals) const {
+    // Rotate the translation by the inverse rotation.
+    const T inv_qvec[4] = {qvec[0], -qvec[1], -qvec[2], -qvec[3]};
+    T proj_center[3];
+    ceres::UnitQuaternionRotatePoint(inv_qvec, tvec, proj_center);
+
+    residuals[0] = T(weight_) * (-proj_center[0] - T(x_));
+    residuals[1] = T(weight_) * (-proj_center[1] - T(y_));
+    residuals[2] = T(weight_) * (-proj_center[2] - T(z_));
+
+    return true;
+  }
+
+ private:
+  const double x_;
+  const double y_;
+  const double z_;
+  const double weight_;
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_BASE_COST_FUNCTIONS_H_
@@ -35,9 +35,101 @@
 #include "base/camera_models.h"
 #include "base/cost_functions.h"
 #include "base/pose.h"
+#include "util/random.h"
 
 using namespace colmap;
 
+namespace {
+
+void CheckEqualJacobians(ceres::CostFunction* cost_function1,
+                         ceres::CostFunction* cost_function2,
+                         const std::vector<double*>& parameters) {
+  const auto& block_sizes = cost_function1->parameter_block_sizes();
+  BOOST_CHECK(block_sizes == cost_function2->parameter_block_sizes());
+  BOOST_CHECK_EQUAL(block_sizes.size(), parameters.size());
+
+  std::vector<std::vector<double>> jacobians1(block_sizes.size());
+  std::vector<std::vector<double>> jacobians2(block_sizes.size());
+  std::vector<double*> jacobian_ptrs1(block_sizes.size());
+  std::vector<double*> jacobian_ptrs2(block_sizes.size());
+  for (size_t i = 0; i < block_sizes.size(); ++i) {
+    jacobians1[i].resize(2 * block_sizes[i]);
+    jacobians2[i].resize(2 * block_sizes[i]);
+    jacobian_ptrs1[i] = jacobians1[i].data();
+    jacobian_ptrs2[i] = jacobians2[i].data();
+  }
+
+  double residuals1[2];
+  double residuals2[2];
+  BOOST_CHECK(cost_function1->Evaluate(parameters.data(), residuals1,
+                                       jacobian_ptrs1.data()));
+  BOOST_CHECK(cost_function2->Evaluate(parameters.data(), residuals2,
+                                       jacobian_ptrs2.data()));
+
+  BOOST_CHECK_CLOSE(residuals1[0], residuals2[0], 1e-6);
+  BOOST_CHECK_CLOSE(residuals1[1], residuals2[1], 1e-6);
+  for (size_t i = 0; i < block_sizes.size(); ++i) {
+    for (size_t j = 0; j < jacobians1[i].size(); ++j) {
+      BOOST_CHECK_LE(std::abs(jacobians1[i][j] - jacobians2[i][j]),
+                     1e-8 * std::max(1.0, std::abs(jacobians2[i][j])));
+    }
+  }
+
+  delete cost_function1;
+  delete cost_function2;
+}
+
+template <typename CameraModel>
+void CheckAnalyticBundleAdjustmentCostFunctions() {
+  SetPRNGSeed(0);
+
+  const Eigen::Vector4d qvec = NormalizeQuaternion(Eigen::Vector4d(
+      1, RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2)));
+  const Eigen::Vector3d tvec(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                             RandomReal(-1.0, 1.0));
+  const Eigen::Vector2d point2D(RandomReal(0.0, 1000.0),
+                                RandomReal(0.0, 1000.0));
+
+  double qvec_data[4] = {qvec(0), qvec(1), qvec(2), qvec(3)};
+  double tvec_data[3] = {tvec(0), tvec(1), tvec(2)};
+  double point3D[3] = {RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                       RandomReal(5.0, 10.0)};
+  std::vector<double> camera_params =
+      CameraModel::InitializeParams(800, 1000, 1000);
+  for (const size_t idx : CameraModel::extra_params_idxs) {
+    camera_params[idx] = RandomReal(-0.1, 0.1);
+  }
+
+  BOOST_CHECK(AnalyticCameraModel<CameraModel>::value);
+
+  CheckEqualJacobians(
+      BundleAdjustmentCostFunction<CameraModel>::Create(point2D),
+      BundleAdjustmentCostFunction<CameraModel>::CreateAutoDiff(point2D),
+      {qvec_data, tvec_data, point3D, camera_params.data()});
+
+  CheckEqualJacobians(
+      BundleAdjustmentConstantPoseCostFunction<CameraModel>::Create(
+          qvec, tvec, point2D),
+      BundleAdjustmentConstantPoseCostFunction<CameraModel>::CreateAutoDiff(
+          qvec, tvec, point2D),
+      {point3D, camera_params.data()});
+
+  const Eigen::Vector4d rel_qvec = NormalizeQuaternion(Eigen::Vector4d(
+      1, RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2)));
+  double rel_qvec_data[4] = {rel_qvec(0), rel_qvec(1), rel_qvec(2),
+                             rel_qvec(3)};
+  double rel_tvec_data[3] = {RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                             RandomReal(-1.0, 1.0)};
+
+  CheckEqualJacobians(
+      RigBundleAdjustmentCostFunction<CameraModel>::Create(point2D),
+      RigBundleAdjustmentCostFunction<CameraModel>::CreateAutoDiff(point2D),
+      {qvec_data, tvec_data, rel_qvec_data, rel_tvec_data, point3D,
+       camera_params.data()});
+}
+
+}  // namespace
+
 BOOST_AUTO_TEST_CASE(TestBundleAdjustmentCostFunction) {
   ceres::CostFunction* cost_function =
       BundleAdjustmentCostFunction<SimplePinholeCameraModel>::Create(
@@ -97,6 +189,15 @@ BOOST_AUTO_TEST_CASE(TestBundleAdjustmentConstantPoseCostFunction) {
   BOOST_CHECK_EQUAL(residuals[1], 2);
 }
 
+BOOST_AUTO_TEST_CASE(TestAnalyticBundleAdjustmentCostFunctions) {
+  CheckAnalyticBundleAdjustmentCostFunctions<SimplePinholeCameraModel>();
+  CheckAnalyticBundleAdjustmentCostFunctions<PinholeCameraModel>();
+  CheckAnalyticBundleAdjustmentCostFunctions<SimpleRadialCameraModel>();
+  CheckAnalyticBundleAdjustmentCostFunctions<RadialCameraModel>();
+  CheckAnalyticBundleAdjustmentCostFunctions<OpenCVCameraModel>();
+  BOOST_CHECK(!AnalyticCameraModel<FullOpenCVCameraModel>::value);
+}
+
 BOOST_AUTO_TEST_CASE(TestRigBundleAdjustmentCostFunction) {
   ceres::CostFunction* cost_function =
       RigBundleAdjustmentCostFunction<SimplePinholeCameraModel>::Create(
@@ -150,3 +251,35 @@ BOOST_AUTO_TEST_CASE(TestRelativePoseCostFunction) {
   BOOST_CHECK(cost_function->Evaluate(parameters, residuals, nullptr));
   BOOST_CHECK_EQUAL(residuals[0], 0.5);
 }
+
+BOOST_AUTO_TEST_CASE(TestPositionPriorCostFunction) {
+  ceres::CostFunction* cost_function =
+      PositionPriorCostFunction::Create(Eigen::Vector3d(0, 0, 1), 1);
+  double qvec[4] = {1, 0, 0, 0};
+  double tvec[3] = {0, 0, -1};
+  double residuals[3];
+  const double* parameters[2] = {qvec, tvec};
+  BOOST_CHECK(cost_function->Evaluate(parameters, residuals, nullptr));
+  BOOST_CHECK_EQUAL(residuals[0], 0);
+  BOOST_CHECK_EQUAL(residuals[1], 0);
+  BOOST_CHECK_EQUAL(residuals[2], 0);
+
+  cost_function =
+      PositionPriorCostFunction::Create(Eigen::Vector3d(1, 0, 1), 2);
+  BOOST_CHECK(cost_function->Evaluate(parameters, residuals, nullptr));
+  BOOST_CHECK_EQUAL(residuals[0], -2);
+  BOOST_CHECK_EQUAL(residuals[1], 0);
+  BOOST_CHECK_EQUAL(residuals[2], 0);
+
+  // Rotation by 90 degrees around the z-axis.
+  qvec[0] = std::sqrt(0.5);
+  qvec[3] = std::sqrt(0.5);
+  tvec[0] = 1;
+  tvec[2] = 0;
+  cost_function =
+      PositionPriorCostFunction::Create(Eigen::Vector3d(0, 1, 0), 1);
+  BOOST_CHECK(cost_function->Evaluate(parameters, residuals, nullptr));
+  BOOST_CHECK_SMALL(residuals[0], 1e-12);
+  BOOST_CHECK_SMALL(residuals[1], 1e-12);
+  BOOST_CHECK_SMALL(residuals[2], 1e-12);
+}
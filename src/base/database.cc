@@ -32,9 +32,13 @@
 #include "base/database.h"
 
 #include <fstream>
+#include <functional>
+#include <unordered_set>
 
+#include "util/misc.h"
 #include "util/sqlite3_utils.h"
 #include "util/string.h"
+#include "util/threading.h"
 #include "util/version.h"
 
 namespace colmap {
@@ -107,6 +111,138 @@ FeatureMatches FeatureMatchesFromBlob(const FeatureMatchesBlob& blob) {
   return matches;
 }
 
+// Encodings of the match blobs in the matches and two_view_geometries tables.
+enum MatchesBlobEncoding {
+  // Row-major matrix of point2D_idx1 and point2D_idx2.
+  kRawMatchesBlob = 0,
+  // Matches sorted by point2D_idx1, where point2D_idx1 is delta-coded and both
+  // indices are stored as variable-length integers.
+  kDeltaVarintMatchesBlob = 1,
+  // Bitmap over the matches of the same image pair in the matches table. Only
+  // used for the inlier matches in the two_view_geometries table.
+  kInlierBitmapMatchesBlob = 2,
+};
+
+void AppendVarint(uint32_t value, std::string* data) {
+  while (value >= 0x80) {
+    data->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  data->push_back(static_cast<char>(value));
+}
+
+uint32_t ReadVarint(const uint8_t** data, const uint8_t* data_end) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    CHECK_LT(*data, data_end) << "Corrupt matches blob";
+    const uint8_t byte = **data;
+    *data += 1;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  LOG(FATAL) << "Corrupt matches blob";
+  return value;
+}
+
+// Sorts the matches by point2D_idx1 and encodes them.
+std::string EncodeDeltaVarintMatchesBlob(const FeatureMatchesBlob& blob) {
+  std::vector<std::pair<point2D_t, point2D_t>> matches(blob.rows());
+  for (FeatureMatchesBlob::Index i = 0; i < blob.rows(); ++i) {
+    matches[i] = std::make_pair(blob(i, 0), blob(i, 1));
+  }
+  std::sort(matches.begin(), matches.end());
+
+  std::string data;
+  data.reserve(3 * matches.size());
+  point2D_t prev_point2D_idx1 = 0;
+  for (const auto& match : matches) {
+    AppendVarint(match.first - prev_point2D_idx1, &data);
+    AppendVarint(match.second, &data);
+    prev_point2D_idx1 = match.first;
+  }
+
+  return data;
+}
+
+FeatureMatchesBlob DecodeDeltaVarintMatchesBlob(const void* data,
+                                                const size_t num_bytes,
+                                                const size_t num_matches) {
+  const uint8_t* data_ptr = static_cast<const uint8_t*>(data);
+  const uint8_t* data_end = data_ptr + num_bytes;
+
+  FeatureMatchesBlob blob(num_matches, 2);
+  point2D_t point2D_idx1 = 0;
+  for (size_t i = 0; i < num_matches; ++i) {
+    point2D_idx1 += ReadVarint(&data_ptr, data_end);
+    blob(i, 0) = point2D_idx1;
+    blob(i, 1) = ReadVarint(&data_ptr, data_end);
+  }
+  CHECK_EQ(data_ptr, data_end) << "Corrupt matches blob";
+
+  return blob;
+}
+
+// Encodes the inlier matches as a bitmap over the given matches. Returns false,
+// if the inlier matches are not a subset of the matches.
+bool EncodeInlierBitmapMatchesBlob(const FeatureMatchesBlob& matches,
+                                   const FeatureMatchesBlob& inlier_matches,
+                                   std::string* data) {
+  if (inlier_matches.rows() == 0 || inlier_matches.rows() > matches.rows()) {
+    return false;
+  }
+
+  std::unordered_map<uint64_t, size_t> match_idxs;
+  match_idxs.reserve(matches.rows());
+  for (FeatureMatchesBlob::Index i = 0; i < matches.rows(); ++i) {
+    const uint64_t key = (static_cast<uint64_t>(matches(i, 0)) << 32) |
+                         static_cast<uint64_t>(matches(i, 1));
+    match_idxs.emplace(key, static_cast<size_t>(i));
+  }
+
+  data->assign((matches.rows() + 7) / 8, 0);
+  for (FeatureMatchesBlob::Index i = 0; i < inlier_matches.rows(); ++i) {
+    const uint64_t key = (static_cast<uint64_t>(inlier_matches(i, 0)) << 32) |
+                         static_cast<uint64_t>(inlier_matches(i, 1));
+    const auto match_idx = match_idxs.find(key);
+    if (match_idx == match_idxs.end()) {
+      return false;
+    }
+    char& byte = (*data)[match_idx->second / 8];
+    const char bit = static_cast<char>(1 << (match_idx->second % 8));
+    if (byte & bit) {
+      // Duplicate inlier matches cannot be represented as a bitmap.
+      return false;
+    }
+    byte |= bit;
+  }
+
+  return true;
+}
+
+FeatureMatchesBlob DecodeInlierBitmapMatchesBlob(
+    const FeatureMatchesBlob& matches, const void* data,
+    const size_t num_bytes, const size_t num_inlier_matches) {
+  CHECK_EQ(num_bytes, static_cast<size_t>((matches.rows() + 7) / 8))
+      << "Inlier matches do not match the matches of the image pair";
+
+  const uint8_t* bitmap = static_cast<const uint8_t*>(data);
+
+  FeatureMatchesBlob blob(num_inlier_matches, 2);
+  size_t num_decoded = 0;
+  for (FeatureMatchesBlob::Index i = 0; i < matches.rows(); ++i) {
+    if (bitmap[i / 8] & (1 << (i % 8))) {
+      CHECK_LT(num_decoded, num_inlier_matches) << "Corrupt matches blob";
+      blob.row(num_decoded) = matches.row(i);
+      num_decoded += 1;
+    }
+  }
+  CHECK_EQ(num_decoded, num_inlier_matches) << "Corrupt matches blob";
+
+  return blob;
+}
+
 template <typename MatrixType>
 MatrixType ReadStaticMatrixBlob(sqlite3_stmt* sql_stmt, const int rc,
                                 const int col) {
@@ -193,6 +329,69 @@ void WriteDynamicMatrixBlob(sqlite3_stmt* sql_stmt, const MatrixType& matrix,
                                  static_cast<int>(num_bytes), SQLITE_STATIC));
 }
 
+// Read the matches blob starting at the column `col` with the number of rows,
+// followed by the columns with the number of columns and the data. The inlier
+// bitmap encoding is decoded relative to the matches returned by
+// `read_matches`.
+FeatureMatchesBlob ReadMatchesBlob(
+    sqlite3_stmt* sql_stmt, const int rc, const int col, const int encoding_col,
+    const std::function<FeatureMatchesBlob()>& read_matches = nullptr) {
+  if (rc != SQLITE_ROW) {
+    return ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt, rc, col);
+  }
+
+  const int encoding = sqlite3_column_int(sql_stmt, encoding_col);
+  if (encoding == kRawMatchesBlob) {
+    return ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt, rc, col);
+  }
+
+  const size_t rows =
+      static_cast<size_t>(sqlite3_column_int64(sql_stmt, col + 0));
+  const size_t num_bytes =
+      static_cast<size_t>(sqlite3_column_bytes(sql_stmt, col + 2));
+  const void* data = sqlite3_column_blob(sql_stmt, col + 2);
+
+  if (encoding == kDeltaVarintMatchesBlob) {
+    return DecodeDeltaVarintMatchesBlob(data, num_bytes, rows);
+  } else if (encoding == kInlierBitmapMatchesBlob) {
+    CHECK(read_matches) << "Inlier bitmap encoding requires matches";
+    // Copy the blob, since reading the matches might invalidate it.
+    const std::string bitmap(static_cast<const char*>(data), num_bytes);
+    return DecodeInlierBitmapMatchesBlob(read_matches(), bitmap.data(),
+                                         bitmap.size(), rows);
+  }
+
+  LOG(FATAL) << "Matches encoding not supported";
+  return FeatureMatchesBlob();
+}
+
+FeatureMatchesBlob ReadMatchesBlobForPair(sqlite3_stmt* sql_stmt,
+                                          const image_pair_t pair_id) {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, pair_id));
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  const FeatureMatchesBlob blob = ReadMatchesBlob(sql_stmt, rc, 0, 3);
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  return blob;
+}
+
+void WriteEncodedMatchesBlob(sqlite3_stmt* sql_stmt, const size_t num_matches,
+                             const std::string& data, const int col) {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 0, num_matches));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 1, 2));
+  SQLITE3_CALL(sqlite3_bind_blob(sql_stmt, col + 2, data.data(),
+                                 static_cast<int>(data.size()),
+                                 SQLITE_STATIC));
+}
+
+// Encodings of the descriptor blobs in the descriptors table.
+enum DescriptorsBlobEncoding {
+  // Row-major matrix of the full descriptors.
+  kRawDescriptorsBlob = 0,
+  // Row-major matrix of the product-quantized codes of the descriptors with
+  // one column per subspace of the descriptor codebook.
+  kProductQuantizedDescriptorsBlob = 1,
+};
+
 Camera ReadCameraRow(sqlite3_stmt* sql_stmt) {
   Camera camera;
 
@@ -254,15 +453,25 @@ Database::~Database() { Close(); }
 void Database::Open(const std::string& path) {
   Close();
 
+  path_ = path;
+
   // SQLITE_OPEN_NOMUTEX specifies that the connection should not have a
   // mutex (so that we don't serialize the connection's operations).
   // Modifications to the database will still be serialized, but multiple
   // connections can read concurrently.
   SQLITE3_CALL(sqlite3_open_v2(
       path.c_str(), &database_,
-      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX |
+          SQLITE_OPEN_URI,
       nullptr));
 
+  // The connections to a shared in-memory database use table locks, which
+  // fail instead of waiting for each other. Reading uncommitted data avoids
+  // conflicts between the concurrent readers and the writer.
+  if (path.find("mode=memory") != std::string::npos) {
+    SQLITE3_EXEC(database_, "PRAGMA read_uncommitted=ON", nullptr);
+  }
+
   // Don't wait for the operating system to write the changes to disk
   SQLITE3_EXEC(database_, "PRAGMA synchronous=OFF", nullptr);
 
@@ -285,9 +494,46 @@ void Database::Close() {
     FinalizeSQLStatements();
     sqlite3_close_v2(database_);
     database_ = nullptr;
+    path_.clear();
+    descriptor_quantizer_.reset();
   }
 }
 
+const std::string& Database::Path() const { return path_; }
+
+int64_t Database::DataVersion() const {
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(
+      sqlite3_prepare_v2(database_, "PRAGMA data_version;", -1, &sql_stmt, 0));
+
+  int64_t data_version = 0;
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  if (rc == SQLITE_ROW) {
+    data_version = sqlite3_column_int64(sql_stmt, 0);
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return data_version;
+}
+
+std::string Database::InMemoryPath(const std::string& name) {
+  return "file:" + name + "?mode=memory&cache=shared";
+}
+
+void Database::Backup(const std::string& path) const {
+  sqlite3* backup_database = nullptr;
+  SQLITE3_CALL(sqlite3_open(path.c_str(), &backup_database));
+
+  sqlite3_backup* backup =
+      sqlite3_backup_init(backup_database, "main", database_, "main");
+  CHECK(backup != nullptr) << sqlite3_errmsg(backup_database);
+  SQLITE3_CALL(sqlite3_backup_step(backup, -1));
+  SQLITE3_CALL(sqlite3_backup_finish(backup));
+
+  SQLITE3_CALL(sqlite3_close(backup_database));
+}
+
 bool Database::ExistsCamera(const camera_t camera_id) const {
   return ExistsRowId(sql_stmt_exists_camera_, camera_id);
 }
@@ -346,6 +592,25 @@ size_t Database::NumDescriptorsForImage(const image_t image_id) const {
   return CountRowsForEntry(sql_stmt_num_descriptors_, image_id);
 }
 
+size_t Database::NumCompressedDescriptorImages() const {
+  const std::string sql = StringPrintf(
+      "SELECT COUNT(*) FROM descriptors WHERE encoding = %d;",
+      static_cast<int>(kProductQuantizedDescriptorsBlob));
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+
+  size_t count = 0;
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  if (rc == SQLITE_ROW) {
+    count = static_cast<size_t>(sqlite3_column_int64(sql_stmt, 0));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return count;
+}
+
 size_t Database::NumMatches() const { return SumColumn("rows", "matches"); }
 
 size_t Database::NumInlierMatches() const {
@@ -441,29 +706,70 @@ FeatureKeypoints Database::ReadKeypoints(const image_t image_id) const {
   return FeatureKeypointsFromBlob(blob);
 }
 
+std::vector<Eigen::Vector2d> Database::ReadKeypointCoordinates(
+    const image_t image_id) const {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_keypoints_, 1, image_id));
+
+  std::vector<Eigen::Vector2d> points;
+
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_keypoints_));
+  if (rc == SQLITE_ROW) {
+    const size_t rows =
+        static_cast<size_t>(sqlite3_column_int64(sql_stmt_read_keypoints_, 0));
+    const size_t cols =
+        static_cast<size_t>(sqlite3_column_int64(sql_stmt_read_keypoints_, 1));
+    CHECK(cols == 2 || cols == 4 || cols == 6)
+        << "Keypoint format not supported";
+
+    const size_t num_bytes = static_cast<size_t>(
+        sqlite3_column_bytes(sql_stmt_read_keypoints_, 2));
+    CHECK_EQ(rows * cols * sizeof(float), num_bytes);
+
+    // The coordinates are the first two columns of the row-major blob.
+    const char* data = reinterpret_cast<const char*>(
+        sqlite3_column_blob(sql_stmt_read_keypoints_, 2));
+    points.resize(rows);
+    for (size_t i = 0; i < rows; ++i) {
+      float xy[2];
+      memcpy(xy, data + i * cols * sizeof(float), sizeof(xy));
+      points[i] = Eigen::Vector2d(xy[0], xy[1]);
+    }
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_keypoints_));
+
+  return points;
+}
+
 FeatureDescriptors Database::ReadDescriptors(const image_t image_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_descriptors_, 1, image_id));
 
   const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_descriptors_));
-  const FeatureDescriptors descriptors =
-      ReadDynamicMatrixBlob<FeatureDescriptors>(sql_stmt_read_descriptors_, rc,
-                                                0);
+  FeatureDescriptors descriptors = ReadDynamicMatrixBlob<FeatureDescriptors>(
+      sql_stmt_read_descriptors_, rc, 0);
+  const int encoding =
+      rc == SQLITE_ROW ? sqlite3_column_int(sql_stmt_read_descriptors_, 3)
+                       : kRawDescriptorsBlob;
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_descriptors_));
 
+  if (encoding == kProductQuantizedDescriptorsBlob) {
+    const ProductQuantizer* quantizer = GetDescriptorQuantizer();
+    CHECK_NOTNULL(quantizer);
+    return quantizer->Decode(descriptors);
+  }
+
+  CHECK_EQ(encoding, kRawDescriptorsBlob)
+      << "Descriptors encoding not supported";
+
   return descriptors;
 }
 
 FeatureMatches Database::ReadMatches(image_t image_id1,
                                      image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
-  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_matches_, 1, pair_id));
-
-  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_));
   FeatureMatchesBlob blob =
-      ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt_read_matches_, rc, 0);
-
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_));
+      ReadMatchesBlobForPair(sql_stmt_read_matches_, pair_id);
 
   if (SwapImagePair(image_id1, image_id2)) {
     SwapFeatureMatchesBlob(&blob);
@@ -475,20 +781,27 @@ FeatureMatches Database::ReadMatches(image_t image_id1,
 std::vector<std::pair<image_pair_t, FeatureMatches>> Database::ReadAllMatches()
     const {
   std::vector<std::pair<image_pair_t, FeatureMatches>> all_matches;
+  ReadAllMatches([&](const image_pair_t pair_id, FeatureMatches* matches) {
+    all_matches.emplace_back(pair_id, std::move(*matches));
+  });
+  return all_matches;
+}
 
+void Database::ReadAllMatches(
+    const std::function<void(const image_pair_t pair_id,
+                             FeatureMatches* matches)>& callback) const {
   int rc;
   while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_all_))) ==
          SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_matches_all_, 0));
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_matches_all_, rc, 1);
-    all_matches.emplace_back(pair_id, FeatureMatchesFromBlob(blob));
+    const FeatureMatchesBlob blob =
+        ReadMatchesBlob(sql_stmt_read_matches_all_, rc, 1, 4);
+    FeatureMatches matches = FeatureMatchesFromBlob(blob);
+    callback(pair_id, &matches);
   }
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_all_));
-
-  return all_matches;
 }
 
 TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
@@ -501,8 +814,10 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 
   TwoViewGeometry two_view_geometry;
 
-  FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-      sql_stmt_read_two_view_geometry_, rc, 0);
+  FeatureMatchesBlob blob =
+      ReadMatchesBlob(sql_stmt_read_two_view_geometry_, rc, 0, 7, [&]() {
+        return ReadMatchesBlobForPair(sql_stmt_read_matches_, pair_id);
+      });
 
   two_view_geometry.config = static_cast<int>(
       sqlite3_column_int64(sql_stmt_read_two_view_geometry_, 3));
@@ -531,37 +846,110 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 void Database::ReadTwoViewGeometries(
     std::vector<image_pair_t>* image_pair_ids,
     std::vector<TwoViewGeometry>* two_view_geometries) const {
+  ReadTwoViewGeometries(
+      [&](const image_pair_t pair_id, TwoViewGeometry* two_view_geometry) {
+        image_pair_ids->push_back(pair_id);
+        two_view_geometries->push_back(std::move(*two_view_geometry));
+      });
+}
+
+void Database::ReadTwoViewGeometries(
+    const std::function<void(const image_pair_t pair_id,
+                             TwoViewGeometry* two_view_geometry)>& callback)
+    const {
   int rc;
   while ((rc = SQLITE3_CALL(sqlite3_step(
               sql_stmt_read_two_view_geometries_))) == SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 0));
-    image_pair_ids->push_back(pair_id);
+    TwoViewGeometry two_view_geometry =
+        ReadTwoViewGeometryRow(sql_stmt_read_two_view_geometries_, rc, pair_id);
+    callback(pair_id, &two_view_geometry);
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometries_));
+}
+
+void Database::ReadImageMatches(
+    const image_t image_id,
+    const std::function<void(const image_t other_image_id,
+                             FeatureMatches* matches)>& callback) const {
+  const sqlite3_int64 min_pair_id =
+      static_cast<sqlite3_int64>(kMaxNumImages) * image_id;
+  const sqlite3_int64 max_pair_id =
+      min_pair_id + static_cast<sqlite3_int64>(kMaxNumImages);
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_matches_, 1,
+                                  min_pair_id));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_matches_, 2,
+                                  max_pair_id));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_matches_, 3, image_id));
+
+  int rc;
+  while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_image_matches_))) ==
+         SQLITE_ROW) {
+    const image_pair_t pair_id = static_cast<image_pair_t>(
+        sqlite3_column_int64(sql_stmt_read_image_matches_, 0));
+    image_t image_id1;
+    image_t image_id2;
+    PairIdToImagePair(pair_id, &image_id1, &image_id2);
 
-    TwoViewGeometry two_view_geometry;
+    FeatureMatchesBlob blob =
+        ReadMatchesBlob(sql_stmt_read_image_matches_, rc, 1, 4);
+    if (image_id2 == image_id) {
+      SwapFeatureMatchesBlob(&blob);
+    }
 
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_two_view_geometries_, rc, 1);
-    two_view_geometry.inlier_matches = FeatureMatchesFromBlob(blob);
+    FeatureMatches matches = FeatureMatchesFromBlob(blob);
+    callback(image_id1 == image_id ? image_id2 : image_id1, &matches);
+  }
 
-    two_view_geometry.config = static_cast<int>(
-        sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 4));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_matches_));
+}
 
-    two_view_geometry.F = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 5);
-    two_view_geometry.E = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 6);
-    two_view_geometry.H = ReadStaticMatrixBlob<Eigen::Matrix3d>(
-        sql_stmt_read_two_view_geometries_, rc, 7);
+void Database::ReadImageTwoViewGeometries(
+    const image_t image_id,
+    const std::function<void(const image_t other_image_id,
+                             TwoViewGeometry* two_view_geometry)>& callback)
+    const {
+  const sqlite3_int64 min_pair_id =
+      static_cast<sqlite3_int64>(kMaxNumImages) * image_id;
+  const sqlite3_int64 max_pair_id =
+      min_pair_id + static_cast<sqlite3_int64>(kMaxNumImages);
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_two_view_geometries_, 1,
+                                  min_pair_id));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_two_view_geometries_, 2,
+                                  max_pair_id));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_image_two_view_geometries_, 3,
+                                  image_id));
+
+  int rc;
+  while ((rc = SQLITE3_CALL(sqlite3_step(
+              sql_stmt_read_image_two_view_geometries_))) == SQLITE_ROW) {
+    const image_pair_t pair_id = static_cast<image_pair_t>(
+        sqlite3_column_int64(sql_stmt_read_image_two_view_geometries_, 0));
+    image_t image_id1;
+    image_t image_id2;
+    PairIdToImagePair(pair_id, &image_id1, &image_id2);
 
-    two_view_geometry.F.transposeInPlace();
-    two_view_geometry.E.transposeInPlace();
-    two_view_geometry.H.transposeInPlace();
+    TwoViewGeometry two_view_geometry = ReadTwoViewGeometryRow(
+        sql_stmt_read_image_two_view_geometries_, rc, pair_id);
+    if (image_id2 == image_id) {
+      two_view_geometry.Invert();
+    }
 
-    two_view_geometries->push_back(two_view_geometry);
+    callback(image_id1 == image_id ? image_id2 : image_id1,
+             &two_view_geometry);
   }
 
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometries_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_two_view_geometries_));
+}
+
+std::vector<image_pair_t> Database::ReadMatchedImagePairIds() const {
+  return ReadPairIds("matches");
+}
+
+std::vector<image_pair_t> Database::ReadVerifiedImagePairIds() const {
+  return ReadPairIds("two_view_geometries");
 }
 
 void Database::ReadTwoViewGeometryNumInliers(
@@ -664,10 +1052,7 @@ void Database::WriteKeypoints(const image_t image_id,
 void Database::WriteDescriptors(const image_t image_id,
                                 const FeatureDescriptors& descriptors) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_descriptors_, 1, image_id));
-  WriteDynamicMatrixBlob(sql_stmt_write_descriptors_, descriptors, 2);
-
-  SQLITE3_CALL(sqlite3_step(sql_stmt_write_descriptors_));
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_write_descriptors_));
+  WriteDescriptorsBlob(sql_stmt_write_descriptors_, descriptors, 2);
 }
 
 void Database::WriteMatches(const image_t image_id1, const image_t image_id2,
@@ -679,9 +1064,19 @@ void Database::WriteMatches(const image_t image_id1, const image_t image_id2,
   FeatureMatchesBlob blob = FeatureMatchesToBlob(matches);
   if (SwapImagePair(image_id1, image_id2)) {
     SwapFeatureMatchesBlob(&blob);
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
+  }
+
+  std::string encoded_blob;
+  if (compress_matches_ && blob.rows() > 0) {
+    encoded_blob = EncodeDeltaVarintMatchesBlob(blob);
+    WriteEncodedMatchesBlob(sql_stmt_write_matches_, blob.rows(),
+                            encoded_blob, 2);
+    SQLITE3_CALL(sqlite3_bind_int(sql_stmt_write_matches_, 5,
+                                  kDeltaVarintMatchesBlob));
   } else {
     WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
+    SQLITE3_CALL(
+        sqlite3_bind_int(sql_stmt_write_matches_, 5, kRawMatchesBlob));
   }
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_matches_));
@@ -708,7 +1103,29 @@ void Database::WriteTwoViewGeometry(
 
   const FeatureMatchesBlob inlier_matches =
       FeatureMatchesToBlob(two_view_geometry_ptr->inlier_matches);
-  WriteDynamicMatrixBlob(sql_stmt_write_two_view_geometry_, inlier_matches, 2);
+
+  // Important: the encoded data must live until the query is executed.
+  std::string encoded_inlier_matches;
+  if (compress_matches_ && inlier_matches.rows() > 0) {
+    // Inlier matches are normally a subset of the matches of the image pair,
+    // so they can reference the matches instead of duplicating them.
+    int encoding = kInlierBitmapMatchesBlob;
+    if (!EncodeInlierBitmapMatchesBlob(
+            ReadMatchesBlobForPair(sql_stmt_read_matches_, pair_id),
+            inlier_matches, &encoded_inlier_matches)) {
+      encoding = kDeltaVarintMatchesBlob;
+      encoded_inlier_matches = EncodeDeltaVarintMatchesBlob(inlier_matches);
+    }
+    WriteEncodedMatchesBlob(sql_stmt_write_two_view_geometry_,
+                            inlier_matches.rows(), encoded_inlier_matches, 2);
+    SQLITE3_CALL(
+        sqlite3_bind_int(sql_stmt_write_two_view_geometry_, 9, encoding));
+  } else {
+    WriteDynamicMatrixBlob(sql_stmt_write_two_view_geometry_, inlier_matches,
+                           2);
+    SQLITE3_CALL(sqlite3_bind_int(sql_stmt_write_two_view_geometry_, 9,
+                                  kRawMatchesBlob));
+  }
 
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_two_view_geometry_, 5,
                                   two_view_geometry_ptr->config));
@@ -786,13 +1203,21 @@ void Database::UpdateImage(const Image& image) const {
   SQLITE3_CALL(sqlite3_reset(sql_stmt_update_image_));
 }
 
+void Database::UpdateDescriptors(const image_t image_id,
+                                 const FeatureDescriptors& descriptors) const {
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_update_descriptors_, 5, image_id));
+  WriteDescriptorsBlob(sql_stmt_update_descriptors_, descriptors, 1);
+}
+
 void Database::DeleteMatches(const image_t image_id1,
                              const image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
+  const auto two_view_geometries = ReadInlierBitmapTwoViewGeometries(pair_id);
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_delete_matches_, 1,
                                   static_cast<sqlite3_int64>(pair_id)));
   SQLITE3_CALL(sqlite3_step(sql_stmt_delete_matches_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_delete_matches_));
+  RewriteTwoViewGeometries(two_view_geometries);
 }
 
 void Database::DeleteInlierMatches(const image_t image_id1,
@@ -805,8 +1230,119 @@ void Database::DeleteInlierMatches(const image_t image_id1,
 }
 
 void Database::ClearMatches() const {
+  const auto two_view_geometries =
+      ReadInlierBitmapTwoViewGeometries(kInvalidImagePairId);
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_matches_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_matches_));
+  RewriteTwoViewGeometries(two_view_geometries);
+}
+
+void Database::SetCompressMatches(const bool compress_matches) {
+  compress_matches_ = compress_matches;
+}
+
+void Database::SetCompressDescriptors(const bool compress_descriptors) {
+  compress_descriptors_ = compress_descriptors;
+}
+
+bool Database::ExistsDescriptorCodebook() const {
+  return CountRows("descriptor_codebook") > 0;
+}
+
+ProductQuantizer Database::ReadDescriptorCodebook() const {
+  const ProductQuantizer* quantizer = GetDescriptorQuantizer();
+  CHECK_NOTNULL(quantizer);
+  return *quantizer;
+}
+
+void Database::WriteDescriptorCodebook(const ProductQuantizer& quantizer) {
+  CHECK(quantizer.IsTrained());
+  CHECK_EQ(NumCompressedDescriptorImages(), 0)
+      << "The descriptor codebook cannot be replaced, since there are "
+         "descriptors compressed with it";
+
+  const std::string sql =
+      "INSERT OR REPLACE INTO descriptor_codebook(codebook_id, rows, cols, "
+      "data) VALUES(1, ?, ?, ?);";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  WriteDynamicMatrixBlob(sql_stmt, quantizer.GetCodebook(), 1);
+  SQLITE3_CALL(sqlite3_step(sql_stmt));
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  descriptor_quantizer_.reset(new ProductQuantizer(quantizer));
+}
+
+bool Database::ExistsGlobalDescriptor(const image_t image_id) const {
+  const std::string sql =
+      "SELECT 1 FROM global_descriptors WHERE image_id = ?;";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  const bool exists = ExistsRowId(sql_stmt, image_id);
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return exists;
+}
+
+size_t Database::NumGlobalDescriptors() const {
+  return CountRows("global_descriptors");
+}
+
+Eigen::VectorXf Database::ReadGlobalDescriptor(const image_t image_id) const {
+  const std::string sql =
+      "SELECT rows, cols, data FROM global_descriptors WHERE image_id = ?;";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, image_id));
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  const Eigen::VectorXf descriptor =
+      ReadDynamicMatrixBlob<Eigen::VectorXf>(sql_stmt, rc, 0);
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return descriptor;
+}
+
+std::vector<std::pair<image_t, Eigen::VectorXf>>
+Database::ReadAllGlobalDescriptors() const {
+  const std::string sql =
+      "SELECT image_id, rows, cols, data FROM global_descriptors;";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+
+  std::vector<std::pair<image_t, Eigen::VectorXf>> descriptors;
+  int rc;
+  while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt))) == SQLITE_ROW) {
+    const image_t image_id =
+        static_cast<image_t>(sqlite3_column_int64(sql_stmt, 0));
+    descriptors.emplace_back(
+        image_id, ReadDynamicMatrixBlob<Eigen::VectorXf>(sql_stmt, rc, 1));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return descriptors;
+}
+
+void Database::WriteGlobalDescriptor(const image_t image_id,
+                                     const Eigen::VectorXf& descriptor) const {
+  const std::string sql =
+      "INSERT OR REPLACE INTO global_descriptors(image_id, rows, cols, data) "
+      "VALUES(?, ?, ?, ?);";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, image_id));
+  WriteDynamicMatrixBlob(sql_stmt, descriptor, 2);
+  SQLITE3_CALL(sqlite3_step(sql_stmt));
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+}
+
+void Database::ClearGlobalDescriptors() const {
+  SQLITE3_EXEC(database_, "DELETE FROM global_descriptors;", nullptr);
 }
 
 void Database::ClearTwoViewGeometries() const {
@@ -845,6 +1381,10 @@ void Database::Merge(const Database& database1, const Database& database2,
     const auto descriptors = database1.ReadDescriptors(image.ImageId());
     merged_database->WriteKeypoints(new_image_id, keypoints);
     merged_database->WriteDescriptors(new_image_id, descriptors);
+    if (database1.ExistsGlobalDescriptor(image.ImageId())) {
+      merged_database->WriteGlobalDescriptor(
+          new_image_id, database1.ReadGlobalDescriptor(image.ImageId()));
+    }
   }
 
   std::unordered_map<image_t, image_t> new_image_ids2;
@@ -860,6 +1400,10 @@ void Database::Merge(const Database& database1, const Database& database2,
     const auto descriptors = database2.ReadDescriptors(image.ImageId());
     merged_database->WriteKeypoints(new_image_id, keypoints);
     merged_database->WriteDescriptors(new_image_id, descriptors);
+    if (database2.ExistsGlobalDescriptor(image.ImageId())) {
+      merged_database->WriteGlobalDescriptor(
+          new_image_id, database2.ReadGlobalDescriptor(image.ImageId()));
+    }
   }
 
   // Merge the matches.
@@ -921,6 +1465,104 @@ void Database::Merge(const Database& database1, const Database& database2,
   }
 }
 
+void Database::Merge(const std::vector<std::string>& database_paths,
+                     Database* merged_database, const int num_threads) {
+  CHECK_NOTNULL(merged_database);
+
+  // Open the databases in parallel, which also brings their schema up to date,
+  // and collect their image names for validation.
+  std::vector<std::vector<std::string>> image_names(database_paths.size());
+  {
+    ThreadPool thread_pool(num_threads);
+    for (size_t i = 0; i < database_paths.size(); ++i) {
+      thread_pool.AddTask([&, i]() {
+        CHECK(ExistsFile(database_paths[i])) << database_paths[i];
+        const Database database(database_paths[i]);
+        CHECK_EQ(database.NumCompressedDescriptorImages(), 0)
+            << "Databases with compressed descriptors cannot be merged: "
+            << database_paths[i];
+        for (const auto& image : database.ReadAllImages()) {
+          image_names[i].push_back(image.Name());
+        }
+      });
+    }
+    thread_pool.Wait();
+  }
+
+  const bool check_merged_names = merged_database->NumImages() > 0;
+  std::unordered_set<std::string> unique_image_names;
+  for (const auto& database_image_names : image_names) {
+    for (const auto& image_name : database_image_names) {
+      CHECK(unique_image_names.insert(image_name).second &&
+            !(check_merged_names &&
+              merged_database->ExistsImageWithName(image_name)))
+          << "The databases must not contain images with the same name, but "
+             "there are multiple images with name "
+          << image_name;
+    }
+  }
+
+  sqlite3* database = merged_database->database_;
+
+  for (const auto& database_path : database_paths) {
+    // Attaching a database is not possible inside a transaction.
+    sqlite3_stmt* attach_stmt;
+    SQLITE3_CALL(sqlite3_prepare_v2(
+        database, "ATTACH DATABASE ? AS merge_source;", -1, &attach_stmt, 0));
+    SQLITE3_CALL(sqlite3_bind_text(attach_stmt, 1, database_path.c_str(),
+                                   static_cast<int>(database_path.size()),
+                                   SQLITE_TRANSIENT));
+    SQLITE3_CALL(sqlite3_step(attach_stmt));
+    SQLITE3_CALL(sqlite3_finalize(attach_stmt));
+
+    const size_t camera_id_offset =
+        merged_database->MaxColumn("camera_id", "cameras");
+    const size_t image_id_offset =
+        merged_database->MaxColumn("image_id", "images");
+
+    // Shifting both images of a pair by the same offset preserves their order,
+    // so the new pair identifier is computed directly from the old one.
+    const std::string pair_id_sql = StringPrintf(
+        "(pair_id / %d + %d) * %d + pair_id %% %d + %d", kMaxNumImages,
+        image_id_offset, kMaxNumImages, kMaxNumImages, image_id_offset);
+
+    const std::string sql = StringPrintf(
+        "BEGIN TRANSACTION;"
+        "INSERT INTO cameras"
+        "  (camera_id, model, width, height, params, prior_focal_length)"
+        "  SELECT camera_id + %d, model, width, height, params,"
+        "  prior_focal_length FROM merge_source.cameras;"
+        "INSERT INTO images"
+        "  (image_id, name, camera_id, prior_qw, prior_qx, prior_qy,"
+        "  prior_qz, prior_tx, prior_ty, prior_tz)"
+        "  SELECT image_id + %d, name, camera_id + %d, prior_qw, prior_qx,"
+        "  prior_qy, prior_qz, prior_tx, prior_ty, prior_tz"
+        "  FROM merge_source.images;"
+        "INSERT INTO keypoints (image_id, rows, cols, data)"
+        "  SELECT image_id + %d, rows, cols, data FROM merge_source.keypoints;"
+        "INSERT INTO descriptors (image_id, rows, cols, data, encoding)"
+        "  SELECT image_id + %d, rows, cols, data, encoding"
+        "  FROM merge_source.descriptors;"
+        "INSERT INTO global_descriptors (image_id, rows, cols, data)"
+        "  SELECT image_id + %d, rows, cols, data"
+        "  FROM merge_source.global_descriptors;"
+        "INSERT INTO matches (pair_id, rows, cols, data, encoding)"
+        "  SELECT %s, rows, cols, data, encoding FROM merge_source.matches;"
+        "INSERT INTO two_view_geometries"
+        "  (pair_id, rows, cols, data, config, F, E, H, encoding)"
+        "  SELECT %s, rows, cols, data, config, F, E, H, encoding"
+        "  FROM merge_source.two_view_geometries;"
+        "COMMIT;",
+        camera_id_offset, image_id_offset, camera_id_offset, image_id_offset,
+        image_id_offset, image_id_offset, pair_id_sql.c_str(),
+        pair_id_sql.c_str());
+    SQLITE3_CALL(sqlite3_exec(database, sql.c_str(), nullptr, nullptr, 0));
+
+    SQLITE3_CALL(sqlite3_exec(database, "DETACH DATABASE merge_source;",
+                              nullptr, nullptr, 0));
+  }
+}
+
 void Database::BeginTransaction() const {
   SQLITE3_EXEC(database_, "BEGIN TRANSACTION", nullptr);
 }
@@ -1021,6 +1663,13 @@ void Database::PrepareSQLStatements() {
                                   &sql_stmt_update_image_, 0));
   sql_stmts_.push_back(sql_stmt_update_image_);
 
+  sql =
+      "UPDATE descriptors SET rows=?, cols=?, data=?, encoding=? WHERE "
+      "image_id=?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
+                                  &sql_stmt_update_descriptors_, 0));
+  sql_stmts_.push_back(sql_stmt_update_descriptors_);
+
   //////////////////////////////////////////////////////////////////////////////
   // read_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1054,33 +1703,62 @@ void Database::PrepareSQLStatements() {
                                   &sql_stmt_read_keypoints_, 0));
   sql_stmts_.push_back(sql_stmt_read_keypoints_);
 
-  sql = "SELECT rows, cols, data FROM descriptors WHERE image_id = ?;";
+  sql =
+      "SELECT rows, cols, data, encoding FROM descriptors WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_read_descriptors_);
 
-  sql = "SELECT rows, cols, data FROM matches WHERE pair_id = ?;";
+  sql = "SELECT rows, cols, data, encoding FROM matches WHERE pair_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_matches_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_);
 
-  sql = "SELECT * FROM matches WHERE rows > 0;";
+  sql =
+      "SELECT pair_id, rows, cols, data, encoding FROM matches WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_matches_all_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_all_);
 
   sql =
-      "SELECT rows, cols, data, config, F, E, H FROM two_view_geometries WHERE "
-      "pair_id = ?;";
+      "SELECT rows, cols, data, config, F, E, H, encoding FROM "
+      "two_view_geometries WHERE pair_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometry_);
 
-  sql = "SELECT * FROM two_view_geometries WHERE rows > 0;";
+  sql =
+      "SELECT pair_id, rows, cols, data, config, F, E, H, encoding FROM "
+      "two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_two_view_geometries_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometries_);
 
+  // The pairs of an image are the pairs in the primary key range of the image
+  // as the first image and the pairs found through the index on the second
+  // image, see `UpdateSchema`. Since the first image of a pair is smaller than
+  // the second, the two subsets are disjoint.
+  sql = StringPrintf(
+      "SELECT pair_id, rows, cols, data, encoding FROM matches "
+      "WHERE pair_id >= ?1 AND pair_id < ?2 AND rows > 0 UNION ALL "
+      "SELECT pair_id, rows, cols, data, encoding FROM matches "
+      "WHERE pair_id %% %zu = ?3 AND rows > 0;",
+      kMaxNumImages);
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
+                                  &sql_stmt_read_image_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_read_image_matches_);
+
+  sql = StringPrintf(
+      "SELECT pair_id, rows, cols, data, config, F, E, H, encoding FROM "
+      "two_view_geometries WHERE pair_id >= ?1 AND pair_id < ?2 AND rows > 0 "
+      "UNION ALL SELECT pair_id, rows, cols, data, config, F, E, H, encoding "
+      "FROM two_view_geometries WHERE pair_id %% %zu = ?3 AND rows > 0;",
+      kMaxNumImages);
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
+                                  &sql_stmt_read_image_two_view_geometries_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_read_image_two_view_geometries_);
+
   sql = "SELECT pair_id, rows FROM two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_read_two_view_geometry_num_inliers_,
@@ -1096,19 +1774,22 @@ void Database::PrepareSQLStatements() {
   sql_stmts_.push_back(sql_stmt_write_keypoints_);
 
   sql =
-      "INSERT INTO descriptors(image_id, rows, cols, data) VALUES(?, ?, ?, ?);";
+      "INSERT INTO descriptors(image_id, rows, cols, data, encoding) "
+      "VALUES(?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_write_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_write_descriptors_);
 
-  sql = "INSERT INTO matches(pair_id, rows, cols, data) VALUES(?, ?, ?, ?);";
+  sql =
+      "INSERT INTO matches(pair_id, rows, cols, data, encoding) "
+      "VALUES(?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_write_matches_, 0));
   sql_stmts_.push_back(sql_stmt_write_matches_);
 
   sql =
       "INSERT INTO two_view_geometries(pair_id, rows, cols, data, config, F, "
-      "E, H) VALUES(?, ?, ?, ?, ?, ?, ?, ?);";
+      "E, H, encoding) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1,
                                   &sql_stmt_write_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_write_two_view_geometry_);
@@ -1151,6 +1832,8 @@ void Database::CreateTables() const {
   CreateImageTable();
   CreateKeypointsTable();
   CreateDescriptorsTable();
+  CreateDescriptorCodebookTable();
+  CreateGlobalDescriptorsTable();
   CreateMatchesTable();
   CreateTwoViewGeometriesTable();
 }
@@ -1208,6 +1891,30 @@ void Database::CreateDescriptorsTable() const {
       "    rows      INTEGER               NOT NULL,"
       "    cols      INTEGER               NOT NULL,"
       "    data      BLOB,"
+      "    encoding  INTEGER     DEFAULT 0 NOT NULL,"
+      "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+}
+
+void Database::CreateDescriptorCodebookTable() const {
+  const std::string sql =
+      "CREATE TABLE IF NOT EXISTS descriptor_codebook"
+      "   (codebook_id  INTEGER  PRIMARY KEY  NOT NULL,"
+      "    rows         INTEGER               NOT NULL,"
+      "    cols         INTEGER               NOT NULL,"
+      "    data         BLOB);";
+
+  SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+}
+
+void Database::CreateGlobalDescriptorsTable() const {
+  const std::string sql =
+      "CREATE TABLE IF NOT EXISTS global_descriptors"
+      "   (image_id  INTEGER  PRIMARY KEY  NOT NULL,"
+      "    rows      INTEGER               NOT NULL,"
+      "    cols      INTEGER               NOT NULL,"
+      "    data      BLOB,"
       "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
 
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
@@ -1219,7 +1926,8 @@ void Database::CreateMatchesTable() const {
       "   (pair_id  INTEGER  PRIMARY KEY  NOT NULL,"
       "    rows     INTEGER               NOT NULL,"
       "    cols     INTEGER               NOT NULL,"
-      "    data     BLOB);";
+      "    data     BLOB,"
+      "    encoding INTEGER     DEFAULT 0 NOT NULL);";
 
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
 }
@@ -1239,7 +1947,8 @@ void Database::CreateTwoViewGeometriesTable() const {
         "    config   INTEGER               NOT NULL,"
         "    F        BLOB,"
         "    E        BLOB,"
-        "    H        BLOB);";
+        "    H        BLOB,"
+        "    encoding INTEGER     DEFAULT 0 NOT NULL);";
     SQLITE3_EXEC(database_, sql.c_str(), nullptr);
   }
 }
@@ -1260,6 +1969,38 @@ void Database::UpdateSchema() const {
                  "ALTER TABLE two_view_geometries ADD COLUMN H BLOB;", nullptr);
   }
 
+  if (!ExistsColumn("matches", "encoding")) {
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE matches ADD COLUMN encoding INTEGER DEFAULT 0 "
+                 "NOT NULL;",
+                 nullptr);
+  }
+
+  if (!ExistsColumn("descriptors", "encoding")) {
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE descriptors ADD COLUMN encoding INTEGER "
+                 "DEFAULT 0 NOT NULL;",
+                 nullptr);
+  }
+
+  if (!ExistsColumn("two_view_geometries", "encoding")) {
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE two_view_geometries ADD COLUMN encoding INTEGER "
+                 "DEFAULT 0 NOT NULL;",
+                 nullptr);
+  }
+
+  // Index the image pairs by their second image, which is encoded in the
+  // remainder of the pair identifier. Together with the primary key range of
+  // the pairs by their first image, this finds all pairs of an image without
+  // scanning the table. SQLite maintains the index on every write and delete.
+  for (const std::string table : {"matches", "two_view_geometries"}) {
+    const std::string create_index_sql = StringPrintf(
+        "CREATE INDEX IF NOT EXISTS %s_image_id2 ON %s(pair_id %% %zu);",
+        table.c_str(), table.c_str(), kMaxNumImages);
+    SQLITE3_EXEC(database_, create_index_sql.c_str(), nullptr);
+  }
+
   // Update user version number.
   std::unique_lock<std::mutex> lock(update_schema_mutex_);
   const std::string update_user_version_sql =
@@ -1267,6 +2008,79 @@ void Database::UpdateSchema() const {
   SQLITE3_EXEC(database_, update_user_version_sql.c_str(), nullptr);
 }
 
+TwoViewGeometry Database::ReadTwoViewGeometryRow(
+    sqlite3_stmt* sql_stmt, const int rc, const image_pair_t pair_id) const {
+  TwoViewGeometry two_view_geometry;
+
+  const FeatureMatchesBlob blob = ReadMatchesBlob(sql_stmt, rc, 1, 8, [&]() {
+    return ReadMatchesBlobForPair(sql_stmt_read_matches_, pair_id);
+  });
+  two_view_geometry.inlier_matches = FeatureMatchesFromBlob(blob);
+
+  two_view_geometry.config =
+      static_cast<int>(sqlite3_column_int64(sql_stmt, 4));
+
+  two_view_geometry.F = ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 5);
+  two_view_geometry.E = ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 6);
+  two_view_geometry.H = ReadStaticMatrixBlob<Eigen::Matrix3d>(sql_stmt, rc, 7);
+
+  two_view_geometry.F.transposeInPlace();
+  two_view_geometry.E.transposeInPlace();
+  two_view_geometry.H.transposeInPlace();
+
+  return two_view_geometry;
+}
+
+std::vector<std::pair<image_pair_t, TwoViewGeometry>>
+Database::ReadInlierBitmapTwoViewGeometries(const image_pair_t pair_id) const {
+  std::string sql = StringPrintf(
+      "SELECT pair_id FROM two_view_geometries WHERE encoding = %d",
+      static_cast<int>(kInlierBitmapMatchesBlob));
+  if (pair_id != kInvalidImagePairId) {
+    sql += " AND pair_id = ?";
+  }
+  sql += ";";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  if (pair_id != kInvalidImagePairId) {
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1,
+                                    static_cast<sqlite3_int64>(pair_id)));
+  }
+
+  std::vector<image_pair_t> pair_ids;
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    pair_ids.push_back(
+        static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0)));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  std::vector<std::pair<image_pair_t, TwoViewGeometry>> two_view_geometries;
+  two_view_geometries.reserve(pair_ids.size());
+  for (const auto bitmap_pair_id : pair_ids) {
+    image_t image_id1;
+    image_t image_id2;
+    PairIdToImagePair(bitmap_pair_id, &image_id1, &image_id2);
+    two_view_geometries.emplace_back(
+        bitmap_pair_id, ReadTwoViewGeometry(image_id1, image_id2));
+  }
+
+  return two_view_geometries;
+}
+
+void Database::RewriteTwoViewGeometries(
+    const std::vector<std::pair<image_pair_t, TwoViewGeometry>>&
+        two_view_geometries) const {
+  for (const auto& two_view_geometry : two_view_geometries) {
+    image_t image_id1;
+    image_t image_id2;
+    PairIdToImagePair(two_view_geometry.first, &image_id1, &image_id2);
+    DeleteInlierMatches(image_id1, image_id2);
+    WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry.second);
+  }
+}
+
 bool Database::ExistsTable(const std::string& table_name) const {
   const std::string sql =
       "SELECT name FROM sqlite_master WHERE type='table' AND name = ?;";
@@ -1404,6 +2218,120 @@ size_t Database::MaxColumn(const std::string& column,
   return max;
 }
 
+void Database::WriteDescriptorsBlob(sqlite3_stmt* sql_stmt,
+                                    const FeatureDescriptors& descriptors,
+                                    const int col) const {
+  const ProductQuantizer* quantizer =
+      compress_descriptors_ ? GetDescriptorQuantizer() : nullptr;
+
+  // Important: the codes must live until the query is executed.
+  if (quantizer != nullptr && descriptors.rows() > 0) {
+    const FeatureDescriptors codes = quantizer->Encode(descriptors);
+    WriteDynamicMatrixBlob(sql_stmt, codes, col);
+    SQLITE3_CALL(sqlite3_bind_int(sql_stmt, col + 3,
+                                  kProductQuantizedDescriptorsBlob));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+  } else {
+    WriteDynamicMatrixBlob(sql_stmt, descriptors, col);
+    SQLITE3_CALL(sqlite3_bind_int(sql_stmt, col + 3, kRawDescriptorsBlob));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt));
+}
+
+const ProductQuantizer* Database::GetDescriptorQuantizer() const {
+  if (descriptor_quantizer_) {
+    return descriptor_quantizer_.get();
+  }
+
+  const std::string sql =
+      "SELECT rows, cols, data FROM descriptor_codebook WHERE codebook_id = 1;";
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt));
+  if (rc == SQLITE_ROW) {
+    descriptor_quantizer_.reset(new ProductQuantizer(
+        ReadDynamicMatrixBlob<ProductQuantizer::Codebook>(sql_stmt, rc, 0)));
+  }
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return descriptor_quantizer_.get();
+}
+
+std::vector<image_pair_t> Database::ReadPairIds(
+    const std::string& table) const {
+  const std::string sql =
+      StringPrintf("SELECT pair_id FROM %s;", table.c_str());
+
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+
+  std::vector<image_pair_t> pair_ids;
+  pair_ids.reserve(CountRows(table));
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+    pair_ids.push_back(
+        static_cast<image_pair_t>(sqlite3_column_int64(sql_stmt, 0)));
+  }
+
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  return pair_ids;
+}
+
+DatabaseReaderPool::Reader::Reader(DatabaseReaderPool* pool,
+                                   const Database* database)
+    : pool_(pool), database_(database) {}
+
+DatabaseReaderPool::Reader::Reader(Reader&& other)
+    : pool_(other.pool_), database_(other.database_) {
+  other.pool_ = nullptr;
+  other.database_ = nullptr;
+}
+
+DatabaseReaderPool::Reader::~Reader() {
+  if (pool_ != nullptr) {
+    pool_->Release(database_);
+  }
+}
+
+DatabaseReaderPool::DatabaseReaderPool(const std::string& path,
+                                       const int num_connections) {
+  if (path.empty() || path == ":memory:") {
+    return;
+  }
+
+  connections_.reserve(num_connections);
+  available_connections_.reserve(num_connections);
+  for (int i = 0; i < num_connections; ++i) {
+    connections_.emplace_back(new Database(path));
+    available_connections_.push_back(connections_.back().get());
+  }
+}
+
+size_t DatabaseReaderPool::NumConnections() const {
+  return connections_.size();
+}
+
+DatabaseReaderPool::Reader DatabaseReaderPool::Acquire() {
+  CHECK(!connections_.empty());
+  std::unique_lock<std::mutex> lock(mutex_);
+  available_condition_.wait(
+      lock, [this]() { return !available_connections_.empty(); });
+  const Database* database = available_connections_.back();
+  available_connections_.pop_back();
+  return Reader(this, database);
+}
+
+void DatabaseReaderPool::Release(const Database* database) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    available_connections_.push_back(database);
+  }
+  available_condition_.notify_one();
+}
+
 DatabaseTransaction::DatabaseTransaction(Database* database)
     : database_(database), database_lock_(database->transaction_mutex_) {
   CHECK_NOTNULL(database_);
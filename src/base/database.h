@@ -32,7 +32,11 @@
 #ifndef COLMAP_SRC_BASE_DATABASE_H_
 #define COLMAP_SRC_BASE_DATABASE_H_
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -42,6 +46,7 @@
 #include "base/camera.h"
 #include "base/image.h"
 #include "estimators/two_view_geometry.h"
+#include "feature/product_quantizer.h"
 #include "feature/types.h"
 #include "util/types.h"
 
@@ -49,12 +54,13 @@ namespace colmap {
 
 // Database class to read and write images, features, cameras, matches, etc.
 // from a SQLite database. The class is not thread-safe and must not be accessed
-// concurrently. The class is optimized for single-thread speed and for optimal
-// performance, wrap multiple method calls inside a leading `BeginTransaction`
-// and trailing `EndTransaction`.
+// concurrently, see `DatabaseReaderPool` to read from multiple threads. The
+// class is optimized for single-thread speed and for optimal performance, wrap
+// multiple method calls inside a leading `BeginTransaction` and trailing
+// `EndTransaction`.
 class Database {
  public:
-  const static int kSchemaVersion = 1;
+  const static int kSchemaVersion = 2;
 
   // The maximum number of images, that can be stored in the database.
   // This limitation arises due to the fact, that we generate unique IDs for
@@ -66,11 +72,31 @@ class Database {
   explicit Database(const std::string& path);
   ~Database();
 
-  // Open and close database. The same database should not be opened
-  // concurrently in multiple threads or processes.
+  // Open and close database. The same database should not be opened for
+  // writing concurrently in multiple threads or processes.
   void Open(const std::string& path);
   void Close();
 
+  // Path of the currently opened database. Multiple connections to the same
+  // database file may be opened to read concurrently from it.
+  const std::string& Path() const;
+
+  // Version of the database contents, which changes whenever another
+  // connection commits changes to the database, but not for the changes of
+  // this connection. Can be used to detect external modifications between
+  // two calls, e.g., to invalidate cached data.
+  int64_t DataVersion() const;
+
+  // Path of a named in-memory database, which can be opened by multiple
+  // connections in the same process, e.g., to pass the features and matches
+  // between the stages of a pipeline without writing them to disk. The
+  // database is deleted once its last connection is closed.
+  static std::string InMemoryPath(const std::string& name);
+
+  // Write a copy of the opened database to the given file, whose previous
+  // contents are replaced, e.g., to persist an in-memory database.
+  void Backup(const std::string& path) const;
+
   // Check if entry already exists in database. For image pairs, the order of
   // `image_id1` and `image_id2` does not matter.
   bool ExistsCamera(const camera_t camera_id) const;
@@ -107,6 +133,9 @@ class Database {
   // Number of descriptors for specific image.
   size_t NumDescriptorsForImage(const image_t image_id) const;
 
+  // Number of images, whose descriptors are stored as product-quantized codes.
+  size_t NumCompressedDescriptorImages() const;
+
   // Sum of `rows` column in `matches` table, i.e. number of total matches.
   size_t NumMatches() const;
 
@@ -147,18 +176,59 @@ class Database {
   std::vector<Image> ReadAllImages() const;
 
   FeatureKeypoints ReadKeypoints(const image_t image_id) const;
+  // Read only the coordinates of the keypoints, which avoids materializing
+  // their affine shapes, e.g., when loading the 2D points for SfM.
+  std::vector<Eigen::Vector2d> ReadKeypointCoordinates(
+      const image_t image_id) const;
   FeatureDescriptors ReadDescriptors(const image_t image_id) const;
 
   FeatureMatches ReadMatches(const image_t image_id1,
                              const image_t image_id2) const;
   std::vector<std::pair<image_pair_t, FeatureMatches>> ReadAllMatches() const;
 
+  // Read all matches one by one, which avoids holding all of them in memory
+  // at the same time. The callback may move from the matches, which are not
+  // used after the callback returns.
+  void ReadAllMatches(
+      const std::function<void(const image_pair_t pair_id,
+                               FeatureMatches* matches)>& callback) const;
+
   TwoViewGeometry ReadTwoViewGeometry(const image_t image_id1,
                                       const image_t image_id2) const;
   void ReadTwoViewGeometries(
       std::vector<image_pair_t>* image_pair_ids,
       std::vector<TwoViewGeometry>* two_view_geometries) const;
 
+  // Read all two-view geometries one by one, which avoids holding all of them
+  // in memory at the same time. The callback may move from the two-view
+  // geometry, which is not used after the callback returns.
+  void ReadTwoViewGeometries(
+      const std::function<void(const image_pair_t pair_id,
+                               TwoViewGeometry* two_view_geometry)>& callback)
+      const;
+
+  // Read the matches or two-view geometries of all image pairs of an image
+  // with at least one match, oriented such that `image_id` is the first image
+  // of the pair. The pairs are found through the primary key range of the
+  // pairs with `image_id` as their first image and through an index on the
+  // second image of the pairs, such that the cost is proportional to the
+  // number of pairs of the image and not to the total number of pairs.
+  void ReadImageMatches(
+      const image_t image_id,
+      const std::function<void(const image_t other_image_id,
+                               FeatureMatches* matches)>& callback) const;
+  void ReadImageTwoViewGeometries(
+      const image_t image_id,
+      const std::function<void(const image_t other_image_id,
+                               TwoViewGeometry* two_view_geometry)>& callback)
+      const;
+
+  // Read the identifiers of all image pairs with an entry in the `matches` or
+  // `two_view_geometries` table, respectively, without reading the matches.
+  // In contrast to the functions above, this includes pairs without matches.
+  std::vector<image_pair_t> ReadMatchedImagePairIds() const;
+  std::vector<image_pair_t> ReadVerifiedImagePairIds() const;
+
   // Read all image pairs that have an entry in the `NumVerifiedImagePairs`
   // table with at least one inlier match and their number of inlier matches.
   void ReadTwoViewGeometryNumInliers(
@@ -194,6 +264,12 @@ class Database {
   // making sure that the entry already exists.
   void UpdateImage(const Image& image) const;
 
+  // Update the existing descriptors of an image in the database, e.g. to
+  // re-encode them. The user is responsible for making sure that the entry
+  // already exists.
+  void UpdateDescriptors(const image_t image_id,
+                         const FeatureDescriptors& descriptors) const;
+
   // Delete matches of an image pair.
   void DeleteMatches(const image_t image_id1, const image_t image_id2) const;
 
@@ -207,10 +283,57 @@ class Database {
   // Clear the entire inlier matches table.
   void ClearTwoViewGeometries() const;
 
+  // Whether to store newly written matches and inlier matches in a compact
+  // encoding instead of raw matrices. Matches are sorted and delta-coded, and
+  // inlier matches reference the matches of the same image pair through a
+  // bitmap, if possible. Reading decodes all encodings transparently, so
+  // databases may contain a mix of encodings.
+  void SetCompressMatches(const bool compress_matches);
+
+  // Whether to store newly written descriptors as product-quantized codes
+  // with one byte per subspace instead of the full descriptors, which requires
+  // a descriptor codebook in the database. Reading decodes the codes
+  // transparently to approximate descriptors, so all consumers of the
+  // descriptors work unchanged at reduced matching recall, which can be
+  // measured with `ComputeProductQuantizerRecall`.
+  void SetCompressDescriptors(const bool compress_descriptors);
+
+  // The codebook of the product quantizer, which encodes the compressed
+  // descriptors. The codebook cannot be replaced, once descriptors have been
+  // compressed with it.
+  bool ExistsDescriptorCodebook() const;
+  ProductQuantizer ReadDescriptorCodebook() const;
+  void WriteDescriptorCodebook(const ProductQuantizer& quantizer);
+
+  // The compact global descriptors of the images for the retrieval of image
+  // pairs by dense matrix products, see `retrieval::GlobalDescriptorModel`.
+  // They are computed once per image and reused by later retrievals, so all
+  // descriptors in the database must be computed with the same model.
+  bool ExistsGlobalDescriptor(const image_t image_id) const;
+  size_t NumGlobalDescriptors() const;
+  Eigen::VectorXf ReadGlobalDescriptor(const image_t image_id) const;
+  std::vector<std::pair<image_t, Eigen::VectorXf>> ReadAllGlobalDescriptors()
+      const;
+  void WriteGlobalDescriptor(const image_t image_id,
+                             const Eigen::VectorXf& descriptor) const;
+  void ClearGlobalDescriptors() const;
+
   // Merge two databases into a single, new database.
   static void Merge(const Database& database1, const Database& database2,
                     Database* merged_database);
 
+  // Merge any number of database files, e.g. the shards of a distributed
+  // feature extraction, into the given database. Each database is attached to
+  // the merged database and its rows are copied with bulk SQL statements, so
+  // that keypoints, descriptors, and matches are copied as raw BLOBs without
+  // decoding. The camera and image identifiers of each database are shifted
+  // by the current maximum identifiers of the merged database, which keeps
+  // the order of the image pairs and thus allows to remap the pair
+  // identifiers in the same pass. The databases are opened and validated in
+  // parallel, while the copies into the single merged file are serialized.
+  static void Merge(const std::vector<std::string>& database_paths,
+                    Database* merged_database, const int num_threads = -1);
+
  private:
   friend class DatabaseTransaction;
 
@@ -233,11 +356,24 @@ class Database {
   void CreateImageTable() const;
   void CreateKeypointsTable() const;
   void CreateDescriptorsTable() const;
+  void CreateDescriptorCodebookTable() const;
+  void CreateGlobalDescriptorsTable() const;
   void CreateMatchesTable() const;
   void CreateTwoViewGeometriesTable() const;
 
   void UpdateSchema() const;
 
+  // Inlier matches encoded as a bitmap over the matches of an image pair must
+  // be re-encoded when the matches are deleted. The first method reads the
+  // affected two-view geometries before the deletion for a single image pair
+  // or, for `kInvalidImagePairId`, for all image pairs. The second method
+  // writes them back after the deletion.
+  std::vector<std::pair<image_pair_t, TwoViewGeometry>>
+  ReadInlierBitmapTwoViewGeometries(const image_pair_t pair_id) const;
+  void RewriteTwoViewGeometries(
+      const std::vector<std::pair<image_pair_t, TwoViewGeometry>>&
+          two_view_geometries) const;
+
   bool ExistsTable(const std::string& table_name) const;
   bool ExistsColumn(const std::string& table_name,
                     const std::string& column_name) const;
@@ -251,9 +387,32 @@ class Database {
                            const sqlite3_int64 row_id) const;
   size_t SumColumn(const std::string& column, const std::string& table) const;
   size_t MaxColumn(const std::string& column, const std::string& table) const;
-
+  std::vector<image_pair_t> ReadPairIds(const std::string& table) const;
+
+  // Read the two-view geometry in the current row of a statement, whose
+  // columns start with the pair identifier followed by the columns of the
+  // `two_view_geometries` table.
+  TwoViewGeometry ReadTwoViewGeometryRow(sqlite3_stmt* sql_stmt, const int rc,
+                                         const image_pair_t pair_id) const;
+
+  // Bind the descriptors, starting at the column `col` with the number of
+  // rows, followed by the number of columns, the data, and the encoding, and
+  // execute the statement.
+  void WriteDescriptorsBlob(sqlite3_stmt* sql_stmt,
+                            const FeatureDescriptors& descriptors,
+                            const int col) const;
+
+  // The quantizer of the descriptor codebook, which is loaded on first use.
+  // Returns null if the database has no descriptor codebook.
+  const ProductQuantizer* GetDescriptorQuantizer() const;
+
+  std::string path_;
   sqlite3* database_ = nullptr;
 
+  bool compress_matches_ = false;
+  bool compress_descriptors_ = false;
+  mutable std::unique_ptr<ProductQuantizer> descriptor_quantizer_;
+
   // Ensure that only one database object at a time updates the schema of a
   // database. Since the schema is updated every time a database is opened, this
   // is to ensure that there are no race conditions ("database locked" error
@@ -287,6 +446,7 @@ class Database {
   // update_*
   sqlite3_stmt* sql_stmt_update_camera_ = nullptr;
   sqlite3_stmt* sql_stmt_update_image_ = nullptr;
+  sqlite3_stmt* sql_stmt_update_descriptors_ = nullptr;
 
   // read_*
   sqlite3_stmt* sql_stmt_read_camera_ = nullptr;
@@ -300,6 +460,8 @@ class Database {
   sqlite3_stmt* sql_stmt_read_matches_all_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometries_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_matches_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_two_view_geometries_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_num_inliers_ = nullptr;
 
   // write_*
@@ -317,6 +479,56 @@ class Database {
   sqlite3_stmt* sql_stmt_clear_two_view_geometries_ = nullptr;
 };
 
+// Pool of connections to read concurrently from a database file, while the
+// primary connection of the database performs all writes. Every connection
+// has its own prepared statements, such that readers in different threads do
+// not contend for a single connection. In WAL mode, the readers are not
+// blocked by the writer but only see its committed transactions, so reads
+// that must observe uncommitted writes have to use the primary connection.
+// The pool must be created outside of a transaction of the primary connection,
+// since opening a connection updates the schema. In-memory databases cannot
+// be shared between connections, so the pool is empty for them.
+class DatabaseReaderPool {
+ public:
+  // Scoped access to a connection, which is returned to the pool when the
+  // reader is destructed.
+  class Reader {
+   public:
+    Reader(Reader&& other);
+    ~Reader();
+
+    const Database& operator*() const { return *database_; }
+    const Database* operator->() const { return database_; }
+
+   private:
+    friend class DatabaseReaderPool;
+    Reader(DatabaseReaderPool* pool, const Database* database);
+    NON_COPYABLE(Reader)
+
+    DatabaseReaderPool* pool_;
+    const Database* database_;
+  };
+
+  DatabaseReaderPool(const std::string& path, const int num_connections);
+
+  size_t NumConnections() const;
+
+  // Acquire a connection and wait, if all connections are in use. The pool
+  // must not be empty.
+  Reader Acquire();
+
+ private:
+  NON_COPYABLE(DatabaseReaderPool)
+  NON_MOVABLE(DatabaseReaderPool)
+
+  void Release(const Database* database);
+
+  std::vector<std::unique_ptr<Database>> connections_;
+  std::vector<const Database*> available_connections_;
+  std::mutex mutex_;
+  std::condition_variable available_condition_;
+};
+
 // This class automatically manages the scope of a database transaction by
 // calling `BeginTransaction` and `EndTransaction` during construction and
 // destruction, respectively.
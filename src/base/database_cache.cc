@@ -33,13 +33,39 @@
 
 #include <unordered_set>
 
-#include "feature/utils.h"
+#include "util/misc.h"
 #include "util/string.h"
+#include "util/threading.h"
 #include "util/timer.h"
 
 namespace colmap {
+namespace {
 
-DatabaseCache::DatabaseCache() {}
+std::string FormatPeakMemoryUsage() {
+  const size_t peak_memory_usage = GetPeakMemoryUsage();
+  if (peak_memory_usage == 0) {
+    return "";
+  }
+  return StringPrintf(" [peak memory %.1fMB]",
+                      peak_memory_usage / (1024.0 * 1024.0));
+}
+
+}  // namespace
+
+DatabaseCache::DatabaseCache() : parent_cache_(nullptr) {}
+
+std::vector<image_t> DatabaseCache::ImageIds() const {
+  std::vector<image_t> image_ids;
+  if (parent_cache_ == nullptr) {
+    image_ids.reserve(images_.size());
+    for (const auto& image : images_) {
+      image_ids.push_back(image.first);
+    }
+  } else {
+    image_ids.assign(subset_image_ids_.begin(), subset_image_ids_.end());
+  }
+  return image_ids;
+}
 
 void DatabaseCache::AddCamera(const class Camera& camera) {
   CHECK(!ExistsCamera(camera.CameraId()));
@@ -48,13 +74,22 @@ void DatabaseCache::AddCamera(const class Camera& camera) {
 
 void DatabaseCache::AddImage(const class Image& image) {
   CHECK(!ExistsImage(image.ImageId()));
-  images_.emplace(image.ImageId(), image);
+  images_.emplace(image.ImageId(), image).first->second.SharePoints2D();
   correspondence_graph_.AddImage(image.ImageId(), image.NumPoints2D());
 }
 
+void DatabaseCache::AddCorrespondences(const image_t image_id1,
+                                       const image_t image_id2,
+                                       const FeatureMatches& matches) {
+  correspondence_graph_.AddCorrespondences(image_id1, image_id2, matches);
+  correspondence_graph_.UpdateNumObservations(image_id1);
+  correspondence_graph_.UpdateNumObservations(image_id2);
+}
+
 void DatabaseCache::Load(const Database& database, const size_t min_num_matches,
                          const bool ignore_watermarks,
-                         const std::unordered_set<std::string>& image_names) {
+                         const std::unordered_set<std::string>& image_names,
+                         const int num_threads) {
   //////////////////////////////////////////////////////////////////////////////
   // Load cameras
   //////////////////////////////////////////////////////////////////////////////
@@ -72,139 +107,260 @@ void DatabaseCache::Load(const Database& database, const size_t min_num_matches,
     }
   }
 
-  std::cout << StringPrintf(" %d in %.3fs", cameras_.size(),
-                            timer.ElapsedSeconds())
+  std::cout << StringPrintf(" %d in %.3fs%s", cameras_.size(),
+                            timer.ElapsedSeconds(),
+                            FormatPeakMemoryUsage().c_str())
             << std::endl;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Load matches
+  // Load images
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  std::cout << "Loading matches..." << std::flush;
+  std::cout << "Loading images..." << std::flush;
 
-  std::vector<image_pair_t> image_pair_ids;
-  std::vector<TwoViewGeometry> two_view_geometries;
-  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  std::vector<class Image> images = database.ReadAllImages();
 
-  std::cout << StringPrintf(" %d in %.3fs", image_pair_ids.size(),
-                            timer.ElapsedSeconds())
-            << std::endl;
+  // Determines for which images data should be loaded.
+  std::unordered_set<image_t> image_ids;
+  if (image_names.empty()) {
+    for (const auto& image : images) {
+      image_ids.insert(image.ImageId());
+    }
+  } else {
+    for (const auto& image : images) {
+      if (image_names.count(image.Name()) > 0) {
+        image_ids.insert(image.ImageId());
+      }
+    }
+  }
 
-  auto UseInlierMatchesCheck = [min_num_matches, ignore_watermarks](
-                                   const TwoViewGeometry& two_view_geometry) {
-    return static_cast<size_t>(two_view_geometry.inlier_matches.size()) >=
-               min_num_matches &&
-           (!ignore_watermarks ||
-            two_view_geometry.config != TwoViewGeometry::WATERMARK);
-  };
+  std::cout << StringPrintf(" %d in %.3fs%s", images.size(),
+                            timer.ElapsedSeconds(),
+                            FormatPeakMemoryUsage().c_str())
+            << std::endl;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Load images
+  // Load matches
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  std::cout << "Loading images..." << std::flush;
-
-  std::unordered_set<image_t> image_ids;
-
-  {
-    const std::vector<class Image> images = database.ReadAllImages();
+  std::cout << "Loading matches..." << std::flush;
 
-    // Determines for which images data should be loaded.
-    if (image_names.empty()) {
-      for (const auto& image : images) {
-        image_ids.insert(image.ImageId());
-      }
-    } else {
-      for (const auto& image : images) {
-        if (image_names.count(image.Name()) > 0) {
-          image_ids.insert(image.ImageId());
+  // Only keep the inlier matches of the used image pairs for the
+  // correspondence graph and the matrices from which their relative poses can
+  // be recovered, so that the initial image pair does not have to be verified
+  // again by the mapper.
+  std::vector<std::pair<image_pair_t, FeatureMatches>> inlier_matches;
+  std::unordered_set<image_t> connected_image_ids;
+  connected_image_ids.reserve(image_ids.size());
+  size_t num_image_pairs = 0;
+  size_t num_ignored_image_pairs = 0;
+  database.ReadTwoViewGeometries(
+      [&](const image_pair_t pair_id, TwoViewGeometry* two_view_geometry) {
+        num_image_pairs += 1;
+
+        if (two_view_geometry->inlier_matches.size() < min_num_matches ||
+            (ignore_watermarks &&
+             two_view_geometry->config == TwoViewGeometry::WATERMARK)) {
+          num_ignored_image_pairs += 1;
+          return;
         }
-      }
-    }
 
-    // Collect all images that are connected in the correspondence graph.
-    std::unordered_set<image_t> connected_image_ids;
-    connected_image_ids.reserve(image_ids.size());
-    for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-      if (UseInlierMatchesCheck(two_view_geometries[i])) {
         image_t image_id1;
         image_t image_id2;
-        Database::PairIdToImagePair(image_pair_ids[i], &image_id1, &image_id2);
-        if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-          connected_image_ids.insert(image_id1);
-          connected_image_ids.insert(image_id2);
+        Database::PairIdToImagePair(pair_id, &image_id1, &image_id2);
+        if (image_ids.count(image_id1) == 0 ||
+            image_ids.count(image_id2) == 0) {
+          num_ignored_image_pairs += 1;
+          return;
         }
-      }
-    }
 
-    // Load images with correspondences and discard images without
-    // correspondences, as those images are useless for SfM.
-    images_.reserve(connected_image_ids.size());
-    for (const auto& image : images) {
-      if (image_ids.count(image.ImageId()) > 0 &&
-          connected_image_ids.count(image.ImageId()) > 0) {
-        images_.emplace(image.ImageId(), image);
-        const FeatureKeypoints keypoints =
-            database.ReadKeypoints(image.ImageId());
-        const std::vector<Eigen::Vector2d> points =
-            FeatureKeypointsToPointsVector(keypoints);
-        images_[image.ImageId()].SetPoints2D(points);
-      }
-    }
+        connected_image_ids.insert(image_id1);
+        connected_image_ids.insert(image_id2);
+
+        const int config = two_view_geometry->config;
+        if (config == TwoViewGeometry::CALIBRATED ||
+            config == TwoViewGeometry::PLANAR ||
+            config == TwoViewGeometry::PANORAMIC ||
+            config == TwoViewGeometry::PLANAR_OR_PANORAMIC) {
+          PairGeometry& pair_geometry = pair_geometries_[pair_id];
+          pair_geometry.config = config;
+          pair_geometry.matrix = config == TwoViewGeometry::CALIBRATED
+                                     ? two_view_geometry->E
+                                     : two_view_geometry->H;
+        }
 
-    std::cout << StringPrintf(" %d in %.3fs (connected %d)", images.size(),
-                              timer.ElapsedSeconds(),
-                              connected_image_ids.size())
-              << std::endl;
-  }
+        inlier_matches.emplace_back(
+            pair_id, std::move(two_view_geometry->inlier_matches));
+      });
+
+  std::cout << StringPrintf(" %d in %.3fs%s", num_image_pairs,
+                            timer.ElapsedSeconds(),
+                            FormatPeakMemoryUsage().c_str())
+            << std::endl;
 
   //////////////////////////////////////////////////////////////////////////////
-  // Build correspondence graph
+  // Load features and build correspondence graph
   //////////////////////////////////////////////////////////////////////////////
 
   timer.Restart();
-  std::cout << "Building correspondence graph..." << std::flush;
-
-  for (const auto& image : images_) {
-    correspondence_graph_.AddImage(image.first, image.second.NumPoints2D());
+  std::cout << "Loading features and building correspondence graph..."
+            << std::flush;
+
+  // Load images with correspondences and discard images without
+  // correspondences, as those images are useless for SfM. The correspondence
+  // graph only requires the number of features per image, so that it can be
+  // built while the features are read.
+  std::vector<image_t> connected_image_ids_vector;
+  connected_image_ids_vector.reserve(connected_image_ids.size());
+  images_.reserve(connected_image_ids.size());
+  for (auto& image : images) {
+    const image_t image_id = image.ImageId();
+    if (connected_image_ids.count(image_id) > 0) {
+      connected_image_ids_vector.push_back(image_id);
+      images_.emplace(image_id, std::move(image));
+      correspondence_graph_.AddImage(image_id,
+                                     database.NumKeypointsForImage(image_id));
+    }
   }
 
-  size_t num_ignored_image_pairs = 0;
-  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-    if (UseInlierMatchesCheck(two_view_geometries[i])) {
-      image_t image_id1;
-      image_t image_id2;
-      Database::PairIdToImagePair(image_pair_ids[i], &image_id1, &image_id2);
-      if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-        correspondence_graph_.AddCorrespondences(
-            image_id1, image_id2, two_view_geometries[i].inlier_matches);
-      } else {
-        num_ignored_image_pairs += 1;
-      }
-    } else {
-      num_ignored_image_pairs += 1;
+  images.clear();
+  images.shrink_to_fit();
+
+  // Only the keypoint locations are read, since the affine shapes are not
+  // needed for SfM. Every reader uses a separate database connection and
+  // writes to distinct, already existing entries in the images map.
+  const auto ReadPoints2D = [this](const Database& reader_database,
+                                   const std::vector<image_t>& image_ids,
+                                   const size_t begin, const size_t step) {
+    for (size_t i = begin; i < image_ids.size(); i += step) {
+      images_.at(image_ids[i])
+          .SetPoints2D(reader_database.ReadKeypointCoordinates(image_ids[i]));
     }
+  };
+
+  const std::string& database_path = database.Path();
+  const bool is_file_database =
+      !database_path.empty() && database_path != ":memory:";
+  const int num_readers =
+      is_file_database
+          ? std::min(GetEffectiveNumThreads(num_threads),
+                     static_cast<int>(connected_image_ids_vector.size()))
+          : 0;
+
+  std::unique_ptr<ThreadPool> thread_pool;
+  std::vector<std::future<void>> futures;
+  if (num_readers > 0) {
+    thread_pool.reset(new ThreadPool(num_readers));
+    futures.reserve(num_readers);
+    for (int i = 0; i < num_readers; ++i) {
+      futures.push_back(thread_pool->AddTask(
+          [&ReadPoints2D, &database_path, &connected_image_ids_vector,
+           num_readers, i]() {
+            const Database reader_database(database_path);
+            ReadPoints2D(reader_database, connected_image_ids_vector, i,
+                         num_readers);
+          }));
+    }
+  } else {
+    ReadPoints2D(database, connected_image_ids_vector, 0, 1);
+  }
+
+  for (auto& image_pair_matches : inlier_matches) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(image_pair_matches.first, &image_id1,
+                                &image_id2);
+    correspondence_graph_.AddCorrespondences(image_id1, image_id2,
+                                             image_pair_matches.second);
+    // Release the matches as soon as they are in the graph.
+    FeatureMatches().swap(image_pair_matches.second);
   }
 
+  inlier_matches.clear();
+  inlier_matches.shrink_to_fit();
+
   correspondence_graph_.Finalize();
 
-  // Set number of observations and correspondences per image.
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  // Set number of observations and correspondences per image. The points are
+  // shared with the images of the reconstructions loaded from the cache, which
+  // only copy them once they triangulate them.
   for (auto& image : images_) {
+    image.second.SharePoints2D();
     image.second.SetNumObservations(
         correspondence_graph_.NumObservationsForImage(image.first));
     image.second.SetNumCorrespondences(
         correspondence_graph_.NumCorrespondencesForImage(image.first));
   }
 
-  std::cout << StringPrintf(" in %.3fs (ignored %d)", timer.ElapsedSeconds(),
-                            num_ignored_image_pairs)
+  std::cout << StringPrintf(" %d images in %.3fs (ignored %d pairs)%s",
+                            images_.size(), timer.ElapsedSeconds(),
+                            num_ignored_image_pairs,
+                            FormatPeakMemoryUsage().c_str())
+            << std::endl;
+}
+
+std::unique_ptr<const DatabaseCache> DatabaseCache::CreateSubset(
+    const DatabaseCache& database_cache,
+    const std::unordered_set<std::string>& image_names) {
+  std::unique_ptr<DatabaseCache> subset_cache(new DatabaseCache());
+  subset_cache->LoadSubset(database_cache, image_names);
+  return subset_cache;
+}
+
+void DatabaseCache::LoadSubset(
+    const DatabaseCache& database_cache,
+    const std::unordered_set<std::string>& image_names) {
+  Timer timer;
+  timer.Start();
+  std::cout << "Extracting subset of images and correspondences..."
+            << std::flush;
+
+  // Share the data of the cache that owns it.
+  parent_cache_ = database_cache.parent_cache_ == nullptr
+                      ? &database_cache
+                      : database_cache.parent_cache_;
+
+  std::unordered_set<image_t> image_ids;
+  for (const image_t image_id : database_cache.ImageIds()) {
+    if (image_names.empty() ||
+        image_names.count(parent_cache_->Image(image_id).Name()) > 0) {
+      image_ids.insert(image_id);
+    }
+  }
+
+  correspondence_graph_ =
+      database_cache.CorrespondenceGraph().ExtractSubgraph(image_ids);
+
+  for (const image_t image_id : image_ids) {
+    if (correspondence_graph_.ExistsImage(image_id)) {
+      subset_image_ids_.insert(image_id);
+    }
+  }
+
+  std::cout << StringPrintf(" %d images in %.3fs%s", subset_image_ids_.size(),
+                            timer.ElapsedSeconds(),
+                            FormatPeakMemoryUsage().c_str())
             << std::endl;
 }
 
 const class Image* DatabaseCache::FindImageWithName(
     const std::string& name) const {
+  if (parent_cache_ != nullptr) {
+    for (const image_t image_id : subset_image_ids_) {
+      const class Image& image = parent_cache_->Image(image_id);
+      if (image.Name() == name) {
+        return &image;
+      }
+    }
+    return nullptr;
+  }
+
   for (const auto& image : images_) {
     if (image.second.Name() == name) {
       return &image.second;
@@ -213,4 +369,34 @@ const class Image* DatabaseCache::FindImageWithName(
   return nullptr;
 }
 
+bool DatabaseCache::FindTwoViewGeometry(
+    const image_t image_id1, const image_t image_id2,
+    TwoViewGeometry* two_view_geometry) const {
+  if (parent_cache_ != nullptr) {
+    return ExistsImage(image_id1) && ExistsImage(image_id2) &&
+           parent_cache_->FindTwoViewGeometry(image_id1, image_id2,
+                                              two_view_geometry);
+  }
+
+  const auto pair_geometry =
+      pair_geometries_.find(Database::ImagePairToPairId(image_id1, image_id2));
+  if (pair_geometry == pair_geometries_.end()) {
+    return false;
+  }
+
+  // The geometries are stored in the order of the image pair identifier.
+  const PairGeometry& geometry = pair_geometry->second;
+  const bool swapped = Database::SwapImagePair(image_id1, image_id2);
+  two_view_geometry->config = geometry.config;
+  if (geometry.config == TwoViewGeometry::CALIBRATED) {
+    two_view_geometry->E =
+        swapped ? Eigen::Matrix3d(geometry.matrix.transpose()) : geometry.matrix;
+  } else {
+    two_view_geometry->H =
+        swapped ? Eigen::Matrix3d(geometry.matrix.inverse()) : geometry.matrix;
+  }
+
+  return true;
+}
+
 }  // namespace colmap
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_DATABASE_CACHE_H_
 #define COLMAP_SRC_BASE_DATABASE_CACHE_H_
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -51,6 +52,13 @@ namespace colmap {
 
 // A class that caches the contents of the database in memory, used to quickly
 // create new reconstruction instances when multiple models are reconstructed.
+//
+// A cache can also be a read-only subset of another cache, which shares the
+// cameras and images of the other cache and only owns the correspondence graph
+// between its images. This allows to reconstruct multiple overlapping subsets
+// of the images concurrently without loading the database multiple times. A
+// subset is only accessible as a const cache, see `CreateSubset`, such that it
+// cannot be modified.
 class DatabaseCache {
  public:
   DatabaseCache();
@@ -67,18 +75,24 @@ class DatabaseCache {
 
   // Get all objects.
   inline const EIGEN_STL_UMAP(camera_t, class Camera) & Cameras() const;
-  inline const EIGEN_STL_UMAP(image_t, class Image) & Images() const;
+  std::vector<image_t> ImageIds() const;
 
   // Check whether specific object exists.
   inline bool ExistsCamera(const camera_t camera_id) const;
   inline bool ExistsImage(const image_t image_id) const;
 
-  // Get reference to correspondence graph.
+  // Get reference to correspondence graph. The number of observations and
+  // correspondences per image should be taken from the correspondence graph,
+  // since the images shared by a subset refer to the full graph.
   inline const class CorrespondenceGraph& CorrespondenceGraph() const;
 
-  // Manually add data to cache.
+  // Manually add data to cache. The correspondences are added to the
+  // correspondence graph and the number of observations of both images is
+  // updated, so that images can be added incrementally after loading.
   void AddCamera(const class Camera& camera);
   void AddImage(const class Image& image);
+  void AddCorrespondences(const image_t image_id1, const image_t image_id2,
+                          const FeatureMatches& matches);
 
   // Load cameras, images, features, and matches from database.
   //
@@ -88,33 +102,83 @@ class DatabaseCache {
   // @param ignore_watermarks     Whether to ignore watermark image pairs.
   // @param image_names           Whether to use only load the data for a subset
   //                              of the images. All images are used if empty.
+  // @param num_threads           Number of threads to read the features over
+  //                              separate database connections, while the
+  //                              correspondence graph is built concurrently.
   void Load(const Database& database, const size_t min_num_matches,
             const bool ignore_watermarks,
-            const std::unordered_set<std::string>& image_names);
+            const std::unordered_set<std::string>& image_names,
+            const int num_threads = -1);
+
+  // Create a subset of the images of another loaded cache without reading the
+  // database again. The cameras and images are shared with `database_cache`,
+  // which must outlive the subset and must not be modified while the subset is
+  // used. Only the correspondence graph between the subset of the images is
+  // allocated. As in `Load`, images without correspondences are discarded.
+  //
+  // @param database_cache        Source cache from which to share the data.
+  // @param image_names           The names of the subset of the images. All
+  //                              images are used if empty.
+  static std::unique_ptr<const DatabaseCache> CreateSubset(
+      const DatabaseCache& database_cache,
+      const std::unordered_set<std::string>& image_names);
 
   // Find specific image by name. Note that this uses linear search.
   const class Image* FindImageWithName(const std::string& name) const;
 
+  // Get the two-view geometry of an image pair as verified during matching,
+  // expressed in the order of the given images. Only the configuration and the
+  // essential or homography matrix are cached, for the pairs whose geometry
+  // allows to recover a relative pose. The inlier matches are contained in the
+  // correspondence graph and are not set. Returns false if no geometry is
+  // cached for the pair.
+  bool FindTwoViewGeometry(const image_t image_id1, const image_t image_id2,
+                           TwoViewGeometry* two_view_geometry) const;
+
  private:
+  // The configuration and the matrix from which the relative pose of an image
+  // pair is recovered, i.e. the essential matrix for calibrated pairs and the
+  // homography matrix for planar or panoramic pairs.
+  struct PairGeometry {
+    int config = TwoViewGeometry::UNDEFINED;
+    Eigen::Matrix3d matrix;
+  };
+
+  void LoadSubset(const DatabaseCache& database_cache,
+                  const std::unordered_set<std::string>& image_names);
+
   class CorrespondenceGraph correspondence_graph_;
 
   EIGEN_STL_UMAP(camera_t, class Camera) cameras_;
   EIGEN_STL_UMAP(image_t, class Image) images_;
+  std::unordered_map<image_pair_t, PairGeometry> pair_geometries_;
+
+  // The cache that owns the cameras and images, if this cache is a subset of
+  // it, and the identifiers of the images in the subset.
+  const DatabaseCache* parent_cache_;
+  std::unordered_set<image_t> subset_image_ids_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t DatabaseCache::NumCameras() const { return cameras_.size(); }
-size_t DatabaseCache::NumImages() const { return images_.size(); }
+size_t DatabaseCache::NumCameras() const {
+  return parent_cache_ == nullptr ? cameras_.size()
+                                  : parent_cache_->NumCameras();
+}
+
+size_t DatabaseCache::NumImages() const {
+  return parent_cache_ == nullptr ? images_.size() : subset_image_ids_.size();
+}
 
 class Camera& DatabaseCache::Camera(const camera_t camera_id) {
   return cameras_.at(camera_id);
 }
 
 const class Camera& DatabaseCache::Camera(const camera_t camera_id) const {
-  return cameras_.at(camera_id);
+  return parent_cache_ == nullptr ? cameras_.at(camera_id)
+                                  : parent_cache_->Camera(camera_id);
 }
 
 class Image& DatabaseCache::Image(const image_t image_id) {
@@ -122,23 +186,25 @@ class Image& DatabaseCache::Image(const image_t image_id) {
 }
 
 const class Image& DatabaseCache::Image(const image_t image_id) const {
-  return images_.at(image_id);
+  if (parent_cache_ == nullptr) {
+    return images_.at(image_id);
+  }
+  CHECK(ExistsImage(image_id));
+  return parent_cache_->Image(image_id);
 }
 
 const EIGEN_STL_UMAP(camera_t, class Camera) & DatabaseCache::Cameras() const {
-  return cameras_;
-}
-
-const EIGEN_STL_UMAP(image_t, class Image) & DatabaseCache::Images() const {
-  return images_;
+  return parent_cache_ == nullptr ? cameras_ : parent_cache_->Cameras();
 }
 
 bool DatabaseCache::ExistsCamera(const camera_t camera_id) const {
-  return cameras_.find(camera_id) != cameras_.end();
+  return parent_cache_ == nullptr ? cameras_.find(camera_id) != cameras_.end()
+                                  : parent_cache_->ExistsCamera(camera_id);
 }
 
 bool DatabaseCache::ExistsImage(const image_t image_id) const {
-  return images_.find(image_id) != images_.end();
+  return parent_cache_ == nullptr ? images_.find(image_id) != images_.end()
+                                  : subset_image_ids_.count(image_id) > 0;
 }
 
 inline const class CorrespondenceGraph& DatabaseCache::CorrespondenceGraph()
@@ -84,3 +84,147 @@ BOOST_AUTO_TEST_CASE(TestAddImage) {
   BOOST_CHECK_EQUAL(
       cache.CorrespondenceGraph().NumObservationsForImage(image.ImageId()), 0);
 }
+
+BOOST_AUTO_TEST_CASE(TestAddCorrespondences) {
+  DatabaseCache cache;
+  for (image_t image_id = 1; image_id <= 2; ++image_id) {
+    Image image;
+    image.SetImageId(image_id);
+    image.SetPoints2D(std::vector<Eigen::Vector2d>(10));
+    cache.AddImage(image);
+  }
+  cache.AddCorrespondences(1, 2, {FeatureMatch(0, 1), FeatureMatch(3, 4)});
+  const auto& correspondence_graph = cache.CorrespondenceGraph();
+  BOOST_CHECK_EQUAL(correspondence_graph.NumCorrespondencesForImage(1), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumCorrespondencesForImage(2), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(1), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumObservationsForImage(2), 2);
+  BOOST_CHECK_EQUAL(correspondence_graph.NumCorrespondencesBetweenImages(1, 2),
+                    2);
+}
+
+BOOST_AUTO_TEST_CASE(TestLoad) {
+  Database database(":memory:");
+
+  Camera camera;
+  camera.InitializeWithId(SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 4; ++i) {
+    Image image;
+    image.SetName(std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+
+  // Only the first three images are connected with enough inliers.
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+  for (point2D_t i = 0; i < 5; ++i) {
+    two_view_geometry.inlier_matches.emplace_back(i, i);
+  }
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  two_view_geometry.inlier_matches.resize(2);
+  database.WriteTwoViewGeometry(image_ids[2], image_ids[3], two_view_geometry);
+
+  DatabaseCache cache;
+  cache.Load(database, 3, false, {});
+  BOOST_CHECK_EQUAL(cache.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(cache.NumImages(), 3);
+  BOOST_CHECK(!cache.ExistsImage(image_ids[3]));
+  BOOST_CHECK_EQUAL(cache.Image(image_ids[0]).NumPoints2D(), 10);
+  BOOST_CHECK_EQUAL(cache.Image(image_ids[1]).NumCorrespondences(), 10);
+  BOOST_CHECK_EQUAL(cache.CorrespondenceGraph().NumImagePairs(), 2);
+  BOOST_CHECK_EQUAL(cache.CorrespondenceGraph().NumCorrespondencesBetweenImages(
+                        image_ids[0], image_ids[1]),
+                    5);
+
+  DatabaseCache subset_cache;
+  subset_cache.Load(database, 3, false, {"0", "1"});
+  BOOST_CHECK_EQUAL(subset_cache.NumImages(), 2);
+  BOOST_CHECK_EQUAL(subset_cache.CorrespondenceGraph().NumImagePairs(), 1);
+
+  const std::unique_ptr<const DatabaseCache> shared_subset_cache =
+      DatabaseCache::CreateSubset(cache, {"0", "1", "3"});
+  BOOST_CHECK_EQUAL(shared_subset_cache->NumCameras(), 1);
+  BOOST_CHECK_EQUAL(shared_subset_cache->NumImages(), 2);
+  BOOST_CHECK(shared_subset_cache->ExistsImage(image_ids[0]));
+  BOOST_CHECK(shared_subset_cache->ExistsImage(image_ids[1]));
+  BOOST_CHECK(!shared_subset_cache->ExistsImage(image_ids[2]));
+  BOOST_CHECK(!shared_subset_cache->ExistsImage(image_ids[3]));
+  BOOST_CHECK_EQUAL(&shared_subset_cache->Image(image_ids[0]),
+                    &cache.Image(image_ids[0]));
+  BOOST_CHECK_EQUAL(shared_subset_cache->ImageIds().size(), 2);
+  BOOST_CHECK_EQUAL(
+      shared_subset_cache->CorrespondenceGraph().NumImagePairs(), 1);
+  BOOST_CHECK_EQUAL(
+      shared_subset_cache->CorrespondenceGraph().NumCorrespondencesForImage(
+          image_ids[1]),
+      5);
+  BOOST_CHECK(shared_subset_cache->FindImageWithName("1") != nullptr);
+  BOOST_CHECK(shared_subset_cache->FindImageWithName("2") == nullptr);
+
+  // A subset of a subset shares the data of the original cache.
+  const std::unique_ptr<const DatabaseCache> nested_subset_cache =
+      DatabaseCache::CreateSubset(*shared_subset_cache, {"0", "1"});
+  BOOST_CHECK_EQUAL(nested_subset_cache->NumImages(), 2);
+  BOOST_CHECK_EQUAL(&nested_subset_cache->Image(image_ids[1]),
+                    &cache.Image(image_ids[1]));
+}
+
+BOOST_AUTO_TEST_CASE(TestFindTwoViewGeometry) {
+  Database database(":memory:");
+
+  Camera camera;
+  camera.InitializeWithId(SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName(std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+
+  TwoViewGeometry two_view_geometry;
+  for (point2D_t i = 0; i < 5; ++i) {
+    two_view_geometry.inlier_matches.emplace_back(i, i);
+  }
+  two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+  two_view_geometry.E << 0, 1, 2, 3, 4, 5, 6, 7, 8;
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+
+  DatabaseCache cache;
+  cache.Load(database, 0, false, {});
+
+  TwoViewGeometry cached_geometry;
+  BOOST_CHECK(
+      cache.FindTwoViewGeometry(image_ids[0], image_ids[1], &cached_geometry));
+  BOOST_CHECK_EQUAL(cached_geometry.config, TwoViewGeometry::CALIBRATED);
+  BOOST_CHECK_EQUAL(cached_geometry.E, two_view_geometry.E);
+  BOOST_CHECK(cached_geometry.inlier_matches.empty());
+  BOOST_CHECK(
+      cache.FindTwoViewGeometry(image_ids[1], image_ids[0], &cached_geometry));
+  BOOST_CHECK_EQUAL(cached_geometry.E,
+                    Eigen::Matrix3d(two_view_geometry.E.transpose()));
+
+  // Uncalibrated pairs have no essential matrix to recover the pose from.
+  BOOST_CHECK(
+      !cache.FindTwoViewGeometry(image_ids[1], image_ids[2], &cached_geometry));
+  BOOST_CHECK(
+      !cache.FindTwoViewGeometry(image_ids[0], image_ids[2], &cached_geometry));
+
+  const std::unique_ptr<const DatabaseCache> shared_subset_cache =
+      DatabaseCache::CreateSubset(cache, {"0", "1"});
+  BOOST_CHECK(shared_subset_cache->FindTwoViewGeometry(
+      image_ids[0], image_ids[1], &cached_geometry));
+  BOOST_CHECK(!shared_subset_cache->FindTwoViewGeometry(
+      image_ids[1], image_ids[2], &cached_geometry));
+}
@@ -32,8 +32,12 @@
 #define TEST_NAME "base/database"
 #include "util/testing.h"
 
+#include <algorithm>
+#include <map>
 #include <thread>
 
+#include <boost/filesystem.hpp>
+
 #include "base/database.h"
 
 using namespace colmap;
@@ -71,6 +75,96 @@ BOOST_AUTO_TEST_CASE(TestTransactionMultiThreaded) {
   thread2.join();
 }
 
+BOOST_AUTO_TEST_CASE(TestReaderPoolMemory) {
+  Database database(kMemoryDatabasePath);
+  DatabaseReaderPool reader_pool(kMemoryDatabasePath, 2);
+  BOOST_CHECK_EQUAL(reader_pool.NumConnections(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestReaderPool) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_database_%%%%-%%%%.db"))
+          .string();
+
+  {
+    Database database(path);
+    Camera camera;
+    camera.SetCameraId(database.WriteCamera(camera));
+    const image_t kNumImages = 10;
+    for (image_t image_id = 1; image_id <= kNumImages + 1; ++image_id) {
+      Image image;
+      image.SetName(std::to_string(image_id));
+      image.SetCameraId(camera.CameraId());
+      image.SetImageId(image_id);
+      database.WriteImage(image, true);
+      if (image_id <= kNumImages) {
+        database.WriteKeypoints(image_id, FeatureKeypoints(image_id));
+      }
+    }
+
+    DatabaseReaderPool reader_pool(path, 2);
+    BOOST_CHECK_EQUAL(reader_pool.NumConnections(), 2);
+
+    std::vector<std::thread> threads;
+    std::vector<size_t> num_keypoints(kNumImages, 0);
+    for (image_t image_id = 1; image_id <= kNumImages; ++image_id) {
+      threads.emplace_back([&reader_pool, &num_keypoints, image_id]() {
+        const auto reader = reader_pool.Acquire();
+        num_keypoints[image_id - 1] = reader->ReadKeypoints(image_id).size();
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    for (image_t image_id = 1; image_id <= kNumImages; ++image_id) {
+      BOOST_CHECK_EQUAL(num_keypoints[image_id - 1], image_id);
+    }
+
+    // The readers only see the committed writes of the primary connection.
+    {
+      DatabaseTransaction database_transaction(&database);
+      database.WriteKeypoints(kNumImages + 1, FeatureKeypoints(1));
+      BOOST_CHECK(database.ExistsKeypoints(kNumImages + 1));
+      BOOST_CHECK(!reader_pool.Acquire()->ExistsKeypoints(kNumImages + 1));
+    }
+    BOOST_CHECK(reader_pool.Acquire()->ExistsKeypoints(kNumImages + 1));
+  }
+
+  boost::filesystem::remove(path);
+  boost::filesystem::remove(path + "-wal");
+  boost::filesystem::remove(path + "-shm");
+}
+
+BOOST_AUTO_TEST_CASE(TestDataVersion) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_database_%%%%-%%%%.db"))
+          .string();
+
+  {
+    Database database(path);
+    Database other_database(path);
+    const int64_t data_version = database.DataVersion();
+
+    // Own changes do not change the version.
+    Camera camera;
+    camera.SetCameraId(database.WriteCamera(camera));
+    BOOST_CHECK_EQUAL(database.DataVersion(), data_version);
+
+    // Changes of other connections change the version.
+    const int64_t other_data_version = other_database.DataVersion();
+    other_database.WriteCamera(camera);
+    BOOST_CHECK_EQUAL(other_database.DataVersion(), other_data_version);
+    BOOST_CHECK_NE(database.DataVersion(), data_version);
+  }
+
+  boost::filesystem::remove(path);
+  boost::filesystem::remove(path + "-wal");
+  boost::filesystem::remove(path + "-shm");
+}
+
 BOOST_AUTO_TEST_CASE(TestEmpty) {
   Database database(kMemoryDatabasePath);
   BOOST_CHECK_EQUAL(database.NumCameras(), 0);
@@ -246,6 +340,28 @@ BOOST_AUTO_TEST_CASE(TestKeypoints) {
   BOOST_CHECK_EQUAL(database.NumKeypointsForImage(image.ImageId()), 20);
 }
 
+BOOST_AUTO_TEST_CASE(TestKeypointCoordinates) {
+  Database database(kMemoryDatabasePath);
+  Camera camera;
+  camera.SetCameraId(database.WriteCamera(camera));
+  Image image;
+  image.SetName("test");
+  image.SetCameraId(camera.CameraId());
+  image.SetImageId(database.WriteImage(image));
+  BOOST_CHECK(database.ReadKeypointCoordinates(image.ImageId()).empty());
+  FeatureKeypoints keypoints;
+  keypoints.emplace_back(1.5f, 2.5f, 3.0f, 4.0f, 5.0f, 6.0f);
+  keypoints.emplace_back(7.25f, 8.75f);
+  database.WriteKeypoints(image.ImageId(), keypoints);
+  const std::vector<Eigen::Vector2d> points =
+      database.ReadKeypointCoordinates(image.ImageId());
+  BOOST_CHECK_EQUAL(points.size(), keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    BOOST_CHECK_EQUAL(points[i].x(), keypoints[i].x);
+    BOOST_CHECK_EQUAL(points[i].y(), keypoints[i].y);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestDescriptors) {
   Database database(kMemoryDatabasePath);
   Camera camera;
@@ -296,8 +412,22 @@ BOOST_AUTO_TEST_CASE(TestMatches) {
   BOOST_CHECK_EQUAL(database.ReadAllMatches()[0].first,
                     Database::ImagePairToPairId(image_id1, image_id2));
   BOOST_CHECK_EQUAL(database.NumMatches(), 1000);
+  database.WriteMatches(image_id1, 3, FeatureMatches());
+  BOOST_CHECK_EQUAL(database.ReadAllMatches().size(), 1);
+  const std::vector<image_pair_t> pair_ids =
+      database.ReadMatchedImagePairIds();
+  BOOST_CHECK_EQUAL(pair_ids.size(), 2);
+  BOOST_CHECK_EQUAL(
+      std::count(pair_ids.begin(), pair_ids.end(),
+                 Database::ImagePairToPairId(image_id1, image_id2)),
+      1);
+  BOOST_CHECK_EQUAL(std::count(pair_ids.begin(), pair_ids.end(),
+                               Database::ImagePairToPairId(image_id1, 3)),
+                    1);
+  database.DeleteMatches(image_id1, 3);
   database.DeleteMatches(image_id1, image_id2);
   BOOST_CHECK_EQUAL(database.NumMatches(), 0);
+  BOOST_CHECK_EQUAL(database.ReadMatchedImagePairIds().size(), 0);
   database.WriteMatches(image_id1, image_id2, matches);
   BOOST_CHECK_EQUAL(database.NumMatches(), 1000);
   database.ClearMatches();
@@ -373,6 +503,9 @@ BOOST_AUTO_TEST_CASE(TestTwoViewGeometry) {
   BOOST_CHECK_EQUAL(image_pairs[0].first, image_id1);
   BOOST_CHECK_EQUAL(image_pairs[0].second, image_id2);
   BOOST_CHECK_EQUAL(num_inliers[0], two_view_geometry.inlier_matches.size());
+  BOOST_CHECK_EQUAL(database.ReadVerifiedImagePairIds().size(), 1);
+  BOOST_CHECK_EQUAL(database.ReadVerifiedImagePairIds()[0],
+                    Database::ImagePairToPairId(image_id1, image_id2));
   BOOST_CHECK_EQUAL(database.NumInlierMatches(), 1000);
   database.DeleteInlierMatches(image_id1, image_id2);
   BOOST_CHECK_EQUAL(database.NumInlierMatches(), 0);
@@ -382,6 +515,180 @@ BOOST_AUTO_TEST_CASE(TestTwoViewGeometry) {
   BOOST_CHECK_EQUAL(database.NumInlierMatches(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestImageMatches) {
+  Database database(kMemoryDatabasePath);
+  FeatureMatches matches(2);
+  matches[0].point2D_idx1 = 0;
+  matches[0].point2D_idx2 = 1;
+  matches[1].point2D_idx1 = 2;
+  matches[1].point2D_idx2 = 3;
+  database.WriteMatches(2, 1, matches);
+  database.WriteMatches(2, 3, matches);
+  database.WriteMatches(2, 4, FeatureMatches());
+  database.WriteMatches(1, 3, matches);
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = matches;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  two_view_geometry.F = Eigen::Matrix3d::Random();
+  two_view_geometry.E = Eigen::Matrix3d::Random();
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+  database.WriteTwoViewGeometry(2, 1, two_view_geometry);
+  database.WriteTwoViewGeometry(1, 3, two_view_geometry);
+
+  size_t num_all_matches = 0;
+  database.ReadAllMatches(
+      [&](const image_pair_t pair_id, FeatureMatches* matches_read) {
+        BOOST_CHECK_EQUAL(matches_read->size(), matches.size());
+        BOOST_CHECK(pair_id != Database::ImagePairToPairId(2, 4));
+        num_all_matches += 1;
+      });
+  BOOST_CHECK_EQUAL(num_all_matches, 3);
+
+  std::map<image_t, FeatureMatches> image_matches;
+  database.ReadImageMatches(
+      2, [&](const image_t other_image_id, FeatureMatches* matches_read) {
+        BOOST_CHECK_EQUAL(image_matches.count(other_image_id), 0);
+        image_matches.emplace(other_image_id, std::move(*matches_read));
+      });
+  BOOST_CHECK_EQUAL(image_matches.size(), 2);
+  for (const auto& other_image_id : {image_t(1), image_t(3)}) {
+    const FeatureMatches& matches_read = image_matches.at(other_image_id);
+    const FeatureMatches matches_expected =
+        database.ReadMatches(2, other_image_id);
+    BOOST_CHECK_EQUAL(matches_read.size(), matches_expected.size());
+    for (size_t i = 0; i < matches_read.size(); ++i) {
+      BOOST_CHECK_EQUAL(matches_read[i].point2D_idx1,
+                        matches_expected[i].point2D_idx1);
+      BOOST_CHECK_EQUAL(matches_read[i].point2D_idx2,
+                        matches_expected[i].point2D_idx2);
+    }
+  }
+
+  image_matches.clear();
+  database.ReadImageMatches(
+      4, [&](const image_t other_image_id, FeatureMatches* matches_read) {
+        image_matches.emplace(other_image_id, std::move(*matches_read));
+      });
+  BOOST_CHECK_EQUAL(image_matches.size(), 0);
+
+  std::map<image_t, TwoViewGeometry> two_view_geometries;
+  database.ReadImageTwoViewGeometries(
+      1, [&](const image_t other_image_id,
+             TwoViewGeometry* two_view_geometry_read) {
+        two_view_geometries.emplace(other_image_id,
+                                    std::move(*two_view_geometry_read));
+      });
+  BOOST_CHECK_EQUAL(two_view_geometries.size(), 2);
+  for (const auto& other_image_id : {image_t(2), image_t(3)}) {
+    const TwoViewGeometry& two_view_geometry_read =
+        two_view_geometries.at(other_image_id);
+    const TwoViewGeometry two_view_geometry_expected =
+        database.ReadTwoViewGeometry(1, other_image_id);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.config,
+                      two_view_geometry_expected.config);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.F, two_view_geometry_expected.F);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.E, two_view_geometry_expected.E);
+    BOOST_CHECK_EQUAL(two_view_geometry_read.inlier_matches.size(),
+                      two_view_geometry_expected.inlier_matches.size());
+    for (size_t i = 0; i < two_view_geometry_read.inlier_matches.size(); ++i) {
+      BOOST_CHECK_EQUAL(
+          two_view_geometry_read.inlier_matches[i].point2D_idx1,
+          two_view_geometry_expected.inlier_matches[i].point2D_idx1);
+      BOOST_CHECK_EQUAL(
+          two_view_geometry_read.inlier_matches[i].point2D_idx2,
+          two_view_geometry_expected.inlier_matches[i].point2D_idx2);
+    }
+  }
+
+  database.DeleteMatches(1, 2);
+  image_matches.clear();
+  database.ReadImageMatches(
+      1, [&](const image_t other_image_id, FeatureMatches* matches_read) {
+        image_matches.emplace(other_image_id, std::move(*matches_read));
+      });
+  BOOST_CHECK_EQUAL(image_matches.size(), 1);
+  BOOST_CHECK_EQUAL(image_matches.count(3), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestCompressedMatches) {
+  Database database(kMemoryDatabasePath);
+  database.SetCompressMatches(true);
+  const image_t image_id1 = 1;
+  const image_t image_id2 = 2;
+  FeatureMatches matches(1000);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    matches[i].point2D_idx1 = static_cast<point2D_t>(3 * i);
+    matches[i].point2D_idx2 = static_cast<point2D_t>(100000 - 7 * i);
+  }
+  database.WriteMatches(image_id1, image_id2, matches);
+  const FeatureMatches matches_read =
+      database.ReadMatches(image_id1, image_id2);
+  BOOST_CHECK_EQUAL(matches.size(), matches_read.size());
+  for (size_t i = 0; i < matches.size(); ++i) {
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx1, matches_read[i].point2D_idx1);
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx2, matches_read[i].point2D_idx2);
+  }
+  BOOST_CHECK_EQUAL(database.ReadAllMatches()[0].second.size(), 1000);
+  BOOST_CHECK_EQUAL(database.NumMatches(), 1000);
+
+  const FeatureMatches matches_read_inv =
+      database.ReadMatches(image_id2, image_id1);
+  BOOST_CHECK_EQUAL(matches_read_inv.size(), 1000);
+  BOOST_CHECK_EQUAL(matches_read_inv[0].point2D_idx1, matches[0].point2D_idx2);
+  BOOST_CHECK_EQUAL(matches_read_inv[0].point2D_idx2, matches[0].point2D_idx1);
+
+  // Inlier matches that are a subset of the matches reference the matches.
+  TwoViewGeometry two_view_geometry;
+  for (size_t i = 0; i < matches.size(); i += 2) {
+    two_view_geometry.inlier_matches.push_back(matches[i]);
+  }
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  BOOST_CHECK_EQUAL(database.NumInlierMatches(), 500);
+
+  const auto CheckInlierMatches = [&](const FeatureMatches& inlier_matches) {
+    BOOST_CHECK_EQUAL(inlier_matches.size(),
+                      two_view_geometry.inlier_matches.size());
+    for (size_t i = 0; i < inlier_matches.size(); ++i) {
+      BOOST_CHECK_EQUAL(inlier_matches[i].point2D_idx1,
+                        two_view_geometry.inlier_matches[i].point2D_idx1);
+      BOOST_CHECK_EQUAL(inlier_matches[i].point2D_idx2,
+                        two_view_geometry.inlier_matches[i].point2D_idx2);
+    }
+  };
+
+  CheckInlierMatches(
+      database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches);
+  std::vector<image_pair_t> image_pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  BOOST_CHECK_EQUAL(two_view_geometries.size(), 1);
+  CheckInlierMatches(two_view_geometries[0].inlier_matches);
+
+  // Deleting the matches must preserve the inlier matches.
+  database.DeleteMatches(image_id1, image_id2);
+  BOOST_CHECK_EQUAL(database.NumMatches(), 0);
+  BOOST_CHECK_EQUAL(database.NumInlierMatches(), 500);
+  CheckInlierMatches(
+      database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches);
+
+  database.WriteMatches(image_id1, image_id2, matches);
+  database.DeleteInlierMatches(image_id1, image_id2);
+  database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  database.ClearMatches();
+  BOOST_CHECK_EQUAL(database.NumMatches(), 0);
+  CheckInlierMatches(
+      database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches);
+
+  // Uncompressed and compressed matches can be mixed.
+  database.SetCompressMatches(false);
+  database.WriteMatches(image_id1, image_id2, matches);
+  BOOST_CHECK_EQUAL(database.ReadMatches(image_id1, image_id2).size(), 1000);
+  CheckInlierMatches(
+      database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches);
+}
+
 BOOST_AUTO_TEST_CASE(TestMerge) {
   Database database1(kMemoryDatabasePath);
   Database database2(kMemoryDatabasePath);
@@ -431,6 +738,10 @@ BOOST_AUTO_TEST_CASE(TestMerge) {
   database2.WriteMatches(image_id3, image_id4, FeatureMatches(10));
   database1.WriteTwoViewGeometry(image_id1, image_id2, TwoViewGeometry());
   database2.WriteTwoViewGeometry(image_id3, image_id4, TwoViewGeometry());
+  const Eigen::VectorXf global_descriptor1 = Eigen::VectorXf::Random(16);
+  const Eigen::VectorXf global_descriptor4 = Eigen::VectorXf::Random(16);
+  database1.WriteGlobalDescriptor(image_id1, global_descriptor1);
+  database2.WriteGlobalDescriptor(image_id4, global_descriptor4);
 
   Database merged_database(kMemoryDatabasePath);
   Database::Merge(database1, database2, &merged_database);
@@ -464,4 +775,228 @@ BOOST_AUTO_TEST_CASE(TestMerge) {
   BOOST_CHECK(!merged_database.ExistsMatches(2, 3));
   BOOST_CHECK(!merged_database.ExistsMatches(2, 4));
   BOOST_CHECK(merged_database.ExistsMatches(3, 4));
+  BOOST_CHECK_EQUAL(merged_database.NumGlobalDescriptors(), 2);
+  BOOST_CHECK_EQUAL(merged_database.ReadGlobalDescriptor(1),
+                    global_descriptor1);
+  BOOST_CHECK(!merged_database.ExistsGlobalDescriptor(2));
+  BOOST_CHECK(!merged_database.ExistsGlobalDescriptor(3));
+  BOOST_CHECK_EQUAL(merged_database.ReadGlobalDescriptor(4),
+                    global_descriptor4);
+}
+
+BOOST_AUTO_TEST_CASE(TestMergeFiles) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < 3; ++i) {
+    paths.push_back((boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path(
+                         "colmap_database_merge_%%%%-%%%%.db"))
+                        .string());
+    Database database(paths.back());
+
+    Camera camera;
+    camera.InitializeWithName("SIMPLE_PINHOLE", 1.0 + i, 1, 1);
+    camera.SetCameraId(database.WriteCamera(camera));
+
+    Image image;
+    image.SetCameraId(camera.CameraId());
+    image.SetName("test" + std::to_string(2 * i));
+    const image_t image_id1 = database.WriteImage(image);
+    image.SetName("test" + std::to_string(2 * i + 1));
+    const image_t image_id2 = database.WriteImage(image);
+
+    auto keypoints = FeatureKeypoints(10 + i);
+    keypoints[0].x = 100 * i;
+    database.WriteKeypoints(image_id1, keypoints);
+    database.WriteKeypoints(image_id2, keypoints);
+    database.WriteDescriptors(image_id1, FeatureDescriptors(10 + i, 128));
+    database.WriteDescriptors(image_id2, FeatureDescriptors(10 + i, 128));
+
+    FeatureMatches matches(5 + i);
+    for (size_t j = 0; j < matches.size(); ++j) {
+      matches[j].point2D_idx1 = j;
+      matches[j].point2D_idx2 = j + 1;
+    }
+    database.WriteMatches(image_id2, image_id1, matches);
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+    two_view_geometry.inlier_matches = matches;
+    database.WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+    database.WriteGlobalDescriptor(image_id2,
+                                   Eigen::VectorXf::Constant(8, 1.0f + i));
+  }
+
+  Database merged_database(kMemoryDatabasePath);
+  Database::Merge(paths, &merged_database);
+  BOOST_CHECK_EQUAL(merged_database.NumCameras(), 3);
+  BOOST_CHECK_EQUAL(merged_database.NumImages(), 6);
+  BOOST_CHECK_EQUAL(merged_database.NumKeypoints(), 66);
+  BOOST_CHECK_EQUAL(merged_database.NumMatches(), 18);
+  BOOST_CHECK_EQUAL(merged_database.NumInlierMatches(), 18);
+  BOOST_CHECK_EQUAL(merged_database.NumGlobalDescriptors(), 3);
+
+  for (int i = 0; i < 3; ++i) {
+    const Image image1 =
+        merged_database.ReadImageWithName("test" + std::to_string(2 * i));
+    const Image image2 =
+        merged_database.ReadImageWithName("test" + std::to_string(2 * i + 1));
+    BOOST_CHECK_EQUAL(image1.CameraId(), image2.CameraId());
+    BOOST_CHECK_EQUAL(
+        merged_database.ReadCamera(image1.CameraId()).FocalLength(), 1.0 + i);
+    BOOST_CHECK_EQUAL(merged_database.ReadKeypoints(image1.ImageId())[0].x,
+                      100 * i);
+    BOOST_CHECK_EQUAL(
+        merged_database.ReadDescriptors(image2.ImageId()).rows(), 10 + i);
+    BOOST_CHECK(!merged_database.ExistsGlobalDescriptor(image1.ImageId()));
+    BOOST_CHECK_EQUAL(merged_database.ReadGlobalDescriptor(image2.ImageId()),
+                      Eigen::VectorXf::Constant(8, 1.0f + i));
+
+    const FeatureMatches matches =
+        merged_database.ReadMatches(image2.ImageId(), image1.ImageId());
+    BOOST_CHECK_EQUAL(matches.size(), 5 + i);
+    BOOST_CHECK_EQUAL(matches[1].point2D_idx1, 1);
+    BOOST_CHECK_EQUAL(matches[1].point2D_idx2, 2);
+
+    const TwoViewGeometry two_view_geometry =
+        merged_database.ReadTwoViewGeometry(image1.ImageId(),
+                                            image2.ImageId());
+    BOOST_CHECK_EQUAL(two_view_geometry.config, TwoViewGeometry::CALIBRATED);
+    BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 5 + i);
+  }
+
+  for (const auto& path : paths) {
+    boost::filesystem::remove(path);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestInMemoryBackup) {
+  const std::string memory_path =
+      Database::InMemoryPath("colmap_database_test_in_memory_backup");
+  Database database(memory_path);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.SetCameraId(database.WriteCamera(camera));
+  Image image;
+  image.SetCameraId(camera.CameraId());
+  image.SetName("test");
+  const image_t image_id = database.WriteImage(image);
+  database.WriteKeypoints(image_id, FeatureKeypoints(10));
+
+  {
+    Database connection(memory_path);
+    BOOST_CHECK_EQUAL(connection.NumImages(), 1);
+    BOOST_CHECK_EQUAL(connection.NumKeypoints(), 10);
+  }
+
+  const std::string path = (boost::filesystem::temp_directory_path() /
+                            boost::filesystem::unique_path(
+                                "colmap_database_backup_%%%%-%%%%.db"))
+                               .string();
+  database.Backup(path);
+  database.Close();
+
+  BOOST_CHECK_EQUAL(Database(memory_path).NumImages(), 0);
+
+  Database backup_database(path);
+  BOOST_CHECK_EQUAL(backup_database.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(backup_database.NumImages(), 1);
+  BOOST_CHECK_EQUAL(backup_database.ReadImageWithName("test").ImageId(),
+                    image_id);
+  BOOST_CHECK_EQUAL(backup_database.NumKeypoints(), 10);
+  backup_database.Close();
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestCompressDescriptors) {
+  Database database(kMemoryDatabasePath);
+  Camera camera;
+  camera.SetCameraId(database.WriteCamera(camera));
+  Image image;
+  image.SetCameraId(camera.CameraId());
+  image.SetName("test1");
+  const image_t image_id1 = database.WriteImage(image);
+  image.SetName("test2");
+  const image_t image_id2 = database.WriteImage(image);
+  image.SetName("test3");
+  const image_t image_id3 = database.WriteImage(image);
+
+  FeatureDescriptors descriptors(512, 128);
+  for (int i = 0; i < descriptors.rows(); ++i) {
+    descriptors.row(i).setConstant(i % 256);
+  }
+
+  BOOST_CHECK(!database.ExistsDescriptorCodebook());
+
+  // Without a codebook, the descriptors are stored in full.
+  database.SetCompressDescriptors(true);
+  database.WriteDescriptors(image_id1, descriptors);
+  BOOST_CHECK_EQUAL(database.NumCompressedDescriptorImages(), 0);
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id1), descriptors);
+
+  ProductQuantizer quantizer;
+  quantizer.Train(descriptors, 16);
+  database.WriteDescriptorCodebook(quantizer);
+  BOOST_CHECK(database.ExistsDescriptorCodebook());
+  BOOST_CHECK_EQUAL(database.ReadDescriptorCodebook().GetCodebook(),
+                    quantizer.GetCodebook());
+
+  database.WriteDescriptors(image_id2, descriptors);
+  database.WriteDescriptors(image_id3, FeatureDescriptors(0, 128));
+  BOOST_CHECK_EQUAL(database.NumCompressedDescriptorImages(), 1);
+  BOOST_CHECK_EQUAL(database.NumDescriptors(), 1024);
+  BOOST_CHECK_EQUAL(database.NumDescriptorsForImage(image_id2), 512);
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id2),
+                    quantizer.Decode(quantizer.Encode(descriptors)));
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id3).rows(), 0);
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id3).cols(), 128);
+
+  database.UpdateDescriptors(image_id1, descriptors);
+  BOOST_CHECK_EQUAL(database.NumCompressedDescriptorImages(), 2);
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id1),
+                    database.ReadDescriptors(image_id2));
+
+  database.SetCompressDescriptors(false);
+  database.UpdateDescriptors(image_id1, descriptors);
+  BOOST_CHECK_EQUAL(database.NumCompressedDescriptorImages(), 1);
+  BOOST_CHECK_EQUAL(database.ReadDescriptors(image_id1), descriptors);
+}
+
+BOOST_AUTO_TEST_CASE(TestGlobalDescriptors) {
+  Database database(kMemoryDatabasePath);
+  Camera camera;
+  camera.SetCameraId(database.WriteCamera(camera));
+  Image image;
+  image.SetCameraId(camera.CameraId());
+  image.SetName("test1");
+  const image_t image_id1 = database.WriteImage(image);
+  image.SetName("test2");
+  const image_t image_id2 = database.WriteImage(image);
+
+  BOOST_CHECK_EQUAL(database.NumGlobalDescriptors(), 0);
+  BOOST_CHECK(!database.ExistsGlobalDescriptor(image_id1));
+
+  const Eigen::VectorXf descriptor1 = Eigen::VectorXf::Random(256);
+  database.WriteGlobalDescriptor(image_id1, descriptor1);
+  BOOST_CHECK(database.ExistsGlobalDescriptor(image_id1));
+  BOOST_CHECK(!database.ExistsGlobalDescriptor(image_id2));
+  BOOST_CHECK_EQUAL(database.ReadGlobalDescriptor(image_id1), descriptor1);
+  BOOST_CHECK_EQUAL(database.ReadGlobalDescriptor(image_id2).size(), 0);
+
+  // Writing a descriptor again replaces the previous descriptor.
+  const Eigen::VectorXf descriptor2 = Eigen::VectorXf::Random(256);
+  database.WriteGlobalDescriptor(image_id1, descriptor2);
+  database.WriteGlobalDescriptor(image_id2, descriptor1);
+  BOOST_CHECK_EQUAL(database.NumGlobalDescriptors(), 2);
+  BOOST_CHECK_EQUAL(database.ReadGlobalDescriptor(image_id1), descriptor2);
+
+  const auto descriptors = database.ReadAllGlobalDescriptors();
+  BOOST_CHECK_EQUAL(descriptors.size(), 2);
+  BOOST_CHECK_EQUAL(descriptors[0].first, image_id1);
+  BOOST_CHECK_EQUAL(descriptors[0].second, descriptor2);
+  BOOST_CHECK_EQUAL(descriptors[1].first, image_id2);
+  BOOST_CHECK_EQUAL(descriptors[1].second, descriptor1);
+
+  database.ClearGlobalDescriptors();
+  BOOST_CHECK_EQUAL(database.NumGlobalDescriptors(), 0);
 }
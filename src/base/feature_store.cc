@@ -0,0 +1,302 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "base/feature_store.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "util/endian.h"
+#include "util/logging.h"
+#include "util/misc.h"
+
+namespace colmap {
+namespace {
+
+// Each record starts with the image identifier, the number of rows, the
+// number of columns, and the number of bytes per element, all stored as
+// little-endian uint32.
+const size_t kRecordHeaderNumBytes = 4 * sizeof(uint32_t);
+
+// The keypoints are stored with their full affine shape.
+const size_t kKeypointsNumCols = 6;
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, kKeypointsNumCols,
+                      Eigen::RowMajor>
+    FeatureKeypointsBlob;
+
+size_t DataNumBytes(const size_t rows, const size_t cols,
+                    const size_t elem_num_bytes) {
+  return rows * cols * elem_num_bytes;
+}
+
+}  // namespace
+
+FeatureStore::FeatureStore() {}
+
+FeatureStore::FeatureStore(const std::string& path) : FeatureStore() {
+  Open(path);
+}
+
+FeatureStore::~FeatureStore() { Close(); }
+
+void FeatureStore::Open(const std::string& path) {
+  CHECK(IsLittleEndian()) << "Feature store requires little-endian host";
+  Close();
+  OpenFile(path + ".keypoints", kKeypointsNumCols, sizeof(float),
+           &keypoints_file_);
+  OpenFile(path + ".descriptors", 0, sizeof(uint8_t), &descriptors_file_);
+}
+
+void FeatureStore::Close() {
+  keypoints_file_ = File();
+  descriptors_file_ = File();
+}
+
+bool FeatureStore::ExistsKeypoints(const image_t image_id) const {
+  return keypoints_file_.records.count(image_id) > 0;
+}
+
+bool FeatureStore::ExistsDescriptors(const image_t image_id) const {
+  return descriptors_file_.records.count(image_id) > 0;
+}
+
+size_t FeatureStore::NumKeypointImages() const {
+  return keypoints_file_.records.size();
+}
+
+size_t FeatureStore::NumDescriptorImages() const {
+  return descriptors_file_.records.size();
+}
+
+size_t FeatureStore::NumKeypointsForImage(const image_t image_id) const {
+  const auto record = keypoints_file_.records.find(image_id);
+  if (record == keypoints_file_.records.end()) {
+    return 0;
+  }
+  return record->second.rows;
+}
+
+size_t FeatureStore::NumDescriptorsForImage(const image_t image_id) const {
+  const auto record = descriptors_file_.records.find(image_id);
+  if (record == descriptors_file_.records.end()) {
+    return 0;
+  }
+  return record->second.rows;
+}
+
+FeatureKeypoints FeatureStore::ReadKeypoints(const image_t image_id) const {
+  const KeypointsMap blob = MapKeypoints(image_id);
+  FeatureKeypoints keypoints(static_cast<size_t>(blob.rows()));
+  for (KeypointsMap::Index i = 0; i < blob.rows(); ++i) {
+    keypoints[i] = FeatureKeypoint(blob(i, 0), blob(i, 1), blob(i, 2),
+                                   blob(i, 3), blob(i, 4), blob(i, 5));
+  }
+  return keypoints;
+}
+
+FeatureDescriptors FeatureStore::ReadDescriptors(
+    const image_t image_id) const {
+  return MapDescriptors(image_id);
+}
+
+FeatureStore::KeypointsMap FeatureStore::MapKeypoints(
+    const image_t image_id) const {
+  const auto record = keypoints_file_.records.find(image_id);
+  if (record == keypoints_file_.records.end()) {
+    return KeypointsMap(nullptr, 0, kKeypointsNumCols);
+  }
+  return KeypointsMap(
+      reinterpret_cast<const float*>(
+          MapRecord(keypoints_file_, record->second)),
+      record->second.rows, kKeypointsNumCols);
+}
+
+FeatureStore::DescriptorsMap FeatureStore::MapDescriptors(
+    const image_t image_id) const {
+  const auto record = descriptors_file_.records.find(image_id);
+  if (record == descriptors_file_.records.end()) {
+    return DescriptorsMap(nullptr, 0, 0);
+  }
+  return DescriptorsMap(
+      reinterpret_cast<const uint8_t*>(
+          MapRecord(descriptors_file_, record->second)),
+      record->second.rows, record->second.cols);
+}
+
+void FeatureStore::WriteKeypoints(const image_t image_id,
+                                  const FeatureKeypoints& keypoints) {
+  FeatureKeypointsBlob blob(keypoints.size(), kKeypointsNumCols);
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    blob(i, 0) = keypoints[i].x;
+    blob(i, 1) = keypoints[i].y;
+    blob(i, 2) = keypoints[i].a11;
+    blob(i, 3) = keypoints[i].a12;
+    blob(i, 4) = keypoints[i].a21;
+    blob(i, 5) = keypoints[i].a22;
+  }
+  AppendRecord(image_id, blob.rows(), blob.cols(),
+               reinterpret_cast<const char*>(blob.data()), &keypoints_file_);
+}
+
+void FeatureStore::WriteDescriptors(const image_t image_id,
+                                    const FeatureDescriptors& descriptors) {
+  AppendRecord(image_id, descriptors.rows(), descriptors.cols(),
+               reinterpret_cast<const char*>(descriptors.data()),
+               &descriptors_file_);
+}
+
+void FeatureStore::OpenFile(const std::string& path, const size_t cols,
+                            const size_t elem_num_bytes, File* file) {
+  file->path = path;
+  file->cols = cols;
+  file->elem_num_bytes = elem_num_bytes;
+  file->records.clear();
+  file->num_bytes = 0;
+  file->region.reset();
+
+  if (!ExistsFile(path)) {
+    std::ofstream create_file(path, std::ios::binary);
+    CHECK(create_file.is_open()) << path;
+    return;
+  }
+
+  const size_t file_num_bytes =
+      static_cast<size_t>(boost::filesystem::file_size(path));
+
+  std::ifstream stream(path, std::ios::binary);
+  CHECK(stream.is_open()) << path;
+
+  // Scan the record headers to build the index. Later records for the same
+  // image supersede earlier ones.
+  size_t offset = 0;
+  while (offset + kRecordHeaderNumBytes <= file_num_bytes) {
+    stream.seekg(offset);
+    const image_t image_id = ReadBinaryLittleEndian<uint32_t>(&stream);
+    const size_t rows = ReadBinaryLittleEndian<uint32_t>(&stream);
+    const size_t record_cols = ReadBinaryLittleEndian<uint32_t>(&stream);
+    const size_t record_elem_num_bytes =
+        ReadBinaryLittleEndian<uint32_t>(&stream);
+    if (!stream) {
+      break;
+    }
+
+    // Records of another format cannot be viewed with the types of this file.
+    CHECK_EQ(record_elem_num_bytes, elem_num_bytes)
+        << "Invalid record for image " << image_id << " in " << path;
+    CHECK(cols == 0 || record_cols == cols)
+        << "Invalid record for image " << image_id << " in " << path;
+
+    const size_t data_offset = offset + kRecordHeaderNumBytes;
+    const size_t data_num_bytes =
+        DataNumBytes(rows, record_cols, elem_num_bytes);
+    if (data_offset + data_num_bytes > file_num_bytes) {
+      break;
+    }
+
+    Record& record = file->records[image_id];
+    record.offset = data_offset;
+    record.rows = rows;
+    record.cols = record_cols;
+
+    offset = data_offset + data_num_bytes;
+  }
+
+  stream.close();
+
+  if (offset < file_num_bytes) {
+    LOG(WARNING) << "Discarding incomplete record at the end of " << path;
+    boost::filesystem::resize_file(path, offset);
+  }
+
+  file->num_bytes = offset;
+
+  MapFile(file);
+}
+
+void FeatureStore::AppendRecord(const image_t image_id, const size_t rows,
+                                const size_t cols, const char* data,
+                                File* file) {
+  CHECK(!file->path.empty()) << "Feature store is not open";
+  CHECK(file->cols == 0 || cols == file->cols);
+
+  const size_t num_bytes = DataNumBytes(rows, cols, file->elem_num_bytes);
+
+  // The existing views into the file must not be used after a write.
+  file->region.reset();
+
+  std::ofstream stream(file->path, std::ios::binary | std::ios::app);
+  CHECK(stream.is_open()) << file->path;
+  WriteBinaryLittleEndian<uint32_t>(&stream, image_id);
+  WriteBinaryLittleEndian<uint32_t>(&stream, static_cast<uint32_t>(rows));
+  WriteBinaryLittleEndian<uint32_t>(&stream, static_cast<uint32_t>(cols));
+  WriteBinaryLittleEndian<uint32_t>(
+      &stream, static_cast<uint32_t>(file->elem_num_bytes));
+  stream.write(data, num_bytes);
+  stream.close();
+  CHECK(stream.good()) << file->path;
+
+  Record& record = file->records[image_id];
+  record.offset = file->num_bytes + kRecordHeaderNumBytes;
+  record.rows = rows;
+  record.cols = cols;
+
+  file->num_bytes = record.offset + num_bytes;
+
+  MapFile(file);
+}
+
+void FeatureStore::MapFile(File* file) {
+  file->region.reset();
+  if (file->num_bytes == 0) {
+    return;
+  }
+
+  const boost::interprocess::file_mapping mapping(
+      file->path.c_str(), boost::interprocess::read_only);
+  file->region.reset(new boost::interprocess::mapped_region(
+      mapping, boost::interprocess::read_only, 0, file->num_bytes));
+}
+
+const char* FeatureStore::MapRecord(const File& file, const Record& record) {
+  if (record.rows == 0 || record.cols == 0) {
+    return nullptr;
+  }
+
+  CHECK(file.region);
+  return static_cast<const char*>(file.region->get_address()) + record.offset;
+}
+
+}  // namespace colmap
@@ -0,0 +1,146 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_BASE_FEATURE_STORE_H_
+#define COLMAP_SRC_BASE_FEATURE_STORE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <Eigen/Core>
+
+#include "feature/types.h"
+#include "util/types.h"
+
+namespace boost {
+namespace interprocess {
+class mapped_region;
+}  // namespace interprocess
+}  // namespace boost
+
+namespace colmap {
+
+// Append-only storage of feature keypoints and descriptors in memory-mapped
+// files, as an alternative to the BLOB columns of the SQLite database for very
+// large datasets. The keypoints and descriptors are stored in the two files
+// `path.keypoints` and `path.descriptors`, where each file contains a sequence
+// of records with a small header followed by the row-major data. The offsets
+// of the records are indexed by image identifier when opening the store.
+// Rewriting the features of an image appends a new record, which supersedes
+// the previous record. Keypoints are always stored with their full affine
+// shape, i.e., in the same 6-column format as in the database.
+//
+// The `Map*` methods return zero-copy views into the memory-mapped files,
+// which remain valid until the next write or until the store is closed. The
+// files are mapped when the store is opened and after every write, so the
+// class is not thread-safe for writing, but concurrent reads are safe if no
+// writes happen at the same time.
+class FeatureStore {
+ public:
+  typedef Eigen::Map<
+      const Eigen::Matrix<float, Eigen::Dynamic, 6, Eigen::RowMajor>>
+      KeypointsMap;
+  typedef Eigen::Map<const FeatureDescriptors> DescriptorsMap;
+
+  FeatureStore();
+  explicit FeatureStore(const std::string& path);
+  ~FeatureStore();
+
+  // Open and close the store. Creates the files, if they do not exist. An
+  // incomplete trailing record, e.g., after a crash during writing, is
+  // discarded when opening the store.
+  void Open(const std::string& path);
+  void Close();
+
+  // Check if features for the given image exist.
+  bool ExistsKeypoints(const image_t image_id) const;
+  bool ExistsDescriptors(const image_t image_id) const;
+
+  // Number of stored images with keypoints / descriptors.
+  size_t NumKeypointImages() const;
+  size_t NumDescriptorImages() const;
+
+  // Number of features for the given image.
+  size_t NumKeypointsForImage(const image_t image_id) const;
+  size_t NumDescriptorsForImage(const image_t image_id) const;
+
+  // Read the features of an image by copying them out of the store.
+  FeatureKeypoints ReadKeypoints(const image_t image_id) const;
+  FeatureDescriptors ReadDescriptors(const image_t image_id) const;
+
+  // Zero-copy views of the features of an image. Each row of the keypoints
+  // contains the values x, y, a11, a12, a21, a22.
+  KeypointsMap MapKeypoints(const image_t image_id) const;
+  DescriptorsMap MapDescriptors(const image_t image_id) const;
+
+  // Append the features of an image to the store.
+  void WriteKeypoints(const image_t image_id,
+                      const FeatureKeypoints& keypoints);
+  void WriteDescriptors(const image_t image_id,
+                        const FeatureDescriptors& descriptors);
+
+ private:
+  struct Record {
+    // Byte offset of the data in the file.
+    size_t offset = 0;
+    size_t rows = 0;
+    size_t cols = 0;
+  };
+
+  struct File {
+    std::string path;
+    // The number of columns of all records or zero for a variable number,
+    // and the number of bytes per element of all records.
+    size_t cols = 0;
+    size_t elem_num_bytes = 0;
+    std::unordered_map<image_t, Record> records;
+    size_t num_bytes = 0;
+    // Mapping of the whole file, which is renewed on every write.
+    std::unique_ptr<boost::interprocess::mapped_region> region;
+  };
+
+  // Open the file and index its records, which must all have the given format.
+  static void OpenFile(const std::string& path, const size_t cols,
+                       const size_t elem_num_bytes, File* file);
+  static void AppendRecord(const image_t image_id, const size_t rows,
+                           const size_t cols, const char* data, File* file);
+  static void MapFile(File* file);
+  static const char* MapRecord(const File& file, const Record& record);
+
+  File keypoints_file_;
+  File descriptors_file_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_BASE_FEATURE_STORE_H_
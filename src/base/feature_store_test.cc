@@ -0,0 +1,219 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "base/feature_store"
+#include "util/testing.h"
+
+#include <fstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "base/feature_store.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+std::string CreateTemporaryPath() {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("feature_store_%%%%-%%%%-%%%%"))
+      .string();
+}
+
+void RemoveStore(const std::string& path) {
+  boost::filesystem::remove(path + ".keypoints");
+  boost::filesystem::remove(path + ".descriptors");
+}
+
+FeatureKeypoints CreateRandomKeypoints(const size_t num_keypoints) {
+  FeatureKeypoints keypoints(num_keypoints);
+  for (auto& keypoint : keypoints) {
+    keypoint = FeatureKeypoint(RandomReal(0.0f, 100.0f),
+                               RandomReal(0.0f, 100.0f), RandomReal(0.0f, 1.0f),
+                               RandomReal(0.0f, 1.0f), RandomReal(0.0f, 1.0f),
+                               RandomReal(0.0f, 1.0f));
+  }
+  return keypoints;
+}
+
+void CheckKeypointsEqual(const FeatureKeypoints& keypoints1,
+                         const FeatureKeypoints& keypoints2) {
+  BOOST_REQUIRE_EQUAL(keypoints1.size(), keypoints2.size());
+  for (size_t i = 0; i < keypoints1.size(); ++i) {
+    BOOST_CHECK_EQUAL(keypoints1[i].x, keypoints2[i].x);
+    BOOST_CHECK_EQUAL(keypoints1[i].y, keypoints2[i].y);
+    BOOST_CHECK_EQUAL(keypoints1[i].a11, keypoints2[i].a11);
+    BOOST_CHECK_EQUAL(keypoints1[i].a12, keypoints2[i].a12);
+    BOOST_CHECK_EQUAL(keypoints1[i].a21, keypoints2[i].a21);
+    BOOST_CHECK_EQUAL(keypoints1[i].a22, keypoints2[i].a22);
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  const std::string path = CreateTemporaryPath();
+  {
+    FeatureStore store(path);
+    BOOST_CHECK_EQUAL(store.NumKeypointImages(), 0);
+    BOOST_CHECK_EQUAL(store.NumDescriptorImages(), 0);
+    BOOST_CHECK(!store.ExistsKeypoints(1));
+    BOOST_CHECK(!store.ExistsDescriptors(1));
+    BOOST_CHECK_EQUAL(store.NumKeypointsForImage(1), 0);
+    BOOST_CHECK_EQUAL(store.ReadKeypoints(1).size(), 0);
+    BOOST_CHECK_EQUAL(store.ReadDescriptors(1).size(), 0);
+  }
+  RemoveStore(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  SetPRNGSeed(0);
+  const std::string path = CreateTemporaryPath();
+
+  const FeatureKeypoints keypoints1 = CreateRandomKeypoints(10);
+  const FeatureKeypoints keypoints2 = CreateRandomKeypoints(20);
+  const FeatureDescriptors descriptors1 = FeatureDescriptors::Random(10, 128);
+  const FeatureDescriptors descriptors2 = FeatureDescriptors::Random(20, 64);
+
+  {
+    FeatureStore store(path);
+    store.WriteKeypoints(1, keypoints1);
+    store.WriteDescriptors(1, descriptors1);
+    store.WriteKeypoints(2, keypoints2);
+    BOOST_CHECK(store.ExistsKeypoints(1));
+    BOOST_CHECK(store.ExistsKeypoints(2));
+    BOOST_CHECK(store.ExistsDescriptors(1));
+    BOOST_CHECK(!store.ExistsDescriptors(2));
+    CheckKeypointsEqual(store.ReadKeypoints(1), keypoints1);
+    BOOST_CHECK(store.ReadDescriptors(1) == descriptors1);
+    store.WriteDescriptors(2, descriptors2);
+    BOOST_CHECK(store.ReadDescriptors(2) == descriptors2);
+    BOOST_CHECK_EQUAL(store.MapKeypoints(2).rows(), 20);
+    BOOST_CHECK_EQUAL(store.MapKeypoints(2)(3, 0), keypoints2[3].x);
+    BOOST_CHECK_EQUAL(store.MapDescriptors(2).cols(), 64);
+  }
+
+  {
+    FeatureStore store(path);
+    BOOST_CHECK_EQUAL(store.NumKeypointImages(), 2);
+    BOOST_CHECK_EQUAL(store.NumDescriptorImages(), 2);
+    BOOST_CHECK_EQUAL(store.NumKeypointsForImage(1), 10);
+    BOOST_CHECK_EQUAL(store.NumDescriptorsForImage(2), 20);
+    CheckKeypointsEqual(store.ReadKeypoints(1), keypoints1);
+    CheckKeypointsEqual(store.ReadKeypoints(2), keypoints2);
+    BOOST_CHECK(store.ReadDescriptors(1) == descriptors1);
+    BOOST_CHECK(store.ReadDescriptors(2) == descriptors2);
+
+    // Rewriting the features supersedes the previous record.
+    store.WriteKeypoints(1, keypoints2);
+    CheckKeypointsEqual(store.ReadKeypoints(1), keypoints2);
+  }
+
+  {
+    FeatureStore store(path);
+    BOOST_CHECK_EQUAL(store.NumKeypointImages(), 2);
+    CheckKeypointsEqual(store.ReadKeypoints(1), keypoints2);
+  }
+
+  RemoveStore(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestIncompleteRecord) {
+  SetPRNGSeed(0);
+  const std::string path = CreateTemporaryPath();
+
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+
+  {
+    FeatureStore store(path);
+    store.WriteDescriptors(1, descriptors);
+  }
+
+  {
+    std::ofstream file(path + ".descriptors",
+                       std::ios::binary | std::ios::app);
+    const char partial_record[6] = {2, 0, 0, 0, 10, 0};
+    file.write(partial_record, sizeof(partial_record));
+  }
+
+  {
+    FeatureStore store(path);
+    BOOST_CHECK_EQUAL(store.NumDescriptorImages(), 1);
+    BOOST_CHECK(store.ReadDescriptors(1) == descriptors);
+    store.WriteDescriptors(2, descriptors);
+  }
+
+  {
+    FeatureStore store(path);
+    BOOST_CHECK_EQUAL(store.NumDescriptorImages(), 2);
+    BOOST_CHECK(store.ReadDescriptors(2) == descriptors);
+  }
+
+  RemoveStore(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentReads) {
+  SetPRNGSeed(0);
+  const std::string path = CreateTemporaryPath();
+
+  const int kNumImages = 8;
+  std::vector<FeatureDescriptors> descriptors;
+  {
+    FeatureStore store(path);
+    for (int i = 0; i < kNumImages; ++i) {
+      descriptors.push_back(FeatureDescriptors::Random(10 + i, 128));
+      store.WriteDescriptors(i + 1, descriptors.back());
+    }
+  }
+
+  // The store is mapped on opening, such that the first reads of multiple
+  // threads do not race on creating the mapping.
+  {
+    FeatureStore store(path);
+    std::vector<std::thread> threads;
+    std::vector<char> equal(kNumImages, 0);
+    for (int i = 0; i < kNumImages; ++i) {
+      threads.emplace_back([&store, &descriptors, &equal, i]() {
+        equal[i] = store.MapDescriptors(i + 1) == descriptors[i];
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    for (int i = 0; i < kNumImages; ++i) {
+      BOOST_CHECK(equal[i]);
+    }
+  }
+
+  RemoveStore(path);
+}
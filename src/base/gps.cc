@@ -31,6 +31,8 @@
 
 #include "base/gps.h"
 
+#include <cmath>
+
 #include "util/math.h"
 
 namespace colmap {
@@ -61,22 +63,25 @@ std::vector<Eigen::Vector3d> GPSTransform::EllToXYZ(
     const std::vector<Eigen::Vector3d>& ell) const {
   std::vector<Eigen::Vector3d> xyz(ell.size());
 
+  const double one_minus_e2 = 1 - e2_;
+
   for (size_t i = 0; i < ell.size(); ++i) {
     const double lat = DegToRad(ell[i](0));
     const double lon = DegToRad(ell[i](1));
     const double alt = ell[i](2);
 
-    const double sin_lat = sin(lat);
-    const double sin_lon = sin(lon);
-    const double cos_lat = cos(lat);
-    const double cos_lon = cos(lon);
+    const double sin_lat = std::sin(lat);
+    const double sin_lon = std::sin(lon);
+    const double cos_lat = std::cos(lat);
+    const double cos_lon = std::cos(lon);
 
     // Normalized radius
-    const double N = a_ / sqrt(1 - e2_ * sin_lat * sin_lat);
+    const double N = a_ / std::sqrt(1 - e2_ * sin_lat * sin_lat);
 
-    xyz[i](0) = (N + alt) * cos_lat * cos_lon;
-    xyz[i](1) = (N + alt) * cos_lat * sin_lon;
-    xyz[i](2) = (N * (1 - e2_) + alt) * sin_lat;
+    const double radius_xy = (N + alt) * cos_lat;
+    xyz[i](0) = radius_xy * cos_lon;
+    xyz[i](1) = radius_xy * sin_lon;
+    xyz[i](2) = (N * one_minus_e2 + alt) * sin_lat;
   }
 
   return xyz;
@@ -86,41 +91,79 @@ std::vector<Eigen::Vector3d> GPSTransform::XYZToEll(
     const std::vector<Eigen::Vector3d>& xyz) const {
   std::vector<Eigen::Vector3d> ell(xyz.size());
 
+  // Closed-form solution of H. Vermeille, "Direct transformation from
+  // geocentric coordinates to geodetic coordinates", Journal of Geodesy, 2002.
+  // In contrast to the iterative latitude solve, the cost per point is
+  // constant and the solution is exact for all points outside the evolute of
+  // the ellipsoid, i.e., for all points not deeper than ~6300km below the
+  // surface.
+  const double inv_a2 = 1 / (a_ * a_);
+  const double e4 = e2_ * e2_;
+
   for (size_t i = 0; i < ell.size(); ++i) {
     const double x = xyz[i](0);
     const double y = xyz[i](1);
     const double z = xyz[i](2);
 
-    const double xx = x * x;
-    const double yy = y * y;
-
-    const double kEps = 1e-12;
+    const double xx_yy = x * x + y * y;
+    const double zz = z * z;
+    const double radius_xy = std::sqrt(xx_yy);
+
+    const double p = xx_yy * inv_a2;
+    const double q = (1 - e2_) * zz * inv_a2;
+    const double r = (p + q - e4) / 6;
+    const double s = e4 * p * q / (4 * r * r * r);
+    const double t = std::cbrt(1 + s + std::sqrt(s * (2 + s)));
+    const double u = r * (1 + t + 1 / t);
+    const double v = std::sqrt(u * u + e4 * q);
+    const double w = e2_ * (u + v - q) / (2 * v);
+    const double k = std::sqrt(u + v + w * w) - w;
+    const double D = k * radius_xy / (k + e2_);
+    const double D_z_norm = std::sqrt(D * D + zz);
 
     // Latitude
-    double lat = atan2(z, sqrt(xx + yy));
-    double alt;
-
-    for (size_t j = 0; j < 100; ++j) {
-      const double sin_lat0 = sin(lat);
-      const double N = a_ / sqrt(1 - e2_ * sin_lat0 * sin_lat0);
-      alt = sqrt(xx + yy) / cos(lat) - N;
-      const double prev_lat = lat;
-      lat = atan((z / sqrt(xx + yy)) * 1 / (1 - e2_ * N / (N + alt)));
-
-      if (std::abs(prev_lat - lat) < kEps) {
-        break;
-      }
-    }
-
-    ell[i](0) = RadToDeg(lat);
-
+    ell[i](0) = RadToDeg(2 * std::atan2(z, D + D_z_norm));
     // Longitude
-    ell[i](1) = RadToDeg(atan2(y, x));
+    ell[i](1) = RadToDeg(std::atan2(y, x));
     // Alt
-    ell[i](2) = alt;
+    ell[i](2) = (k + e2_ - 1) / k * D_z_norm;
   }
 
   return ell;
 }
 
+std::vector<Eigen::Vector3d> GPSTransform::EllToENU(
+    const std::vector<Eigen::Vector3d>& ell, const double lat0,
+    const double lon0) const {
+  return XYZToENU(EllToXYZ(ell), lat0, lon0);
+}
+
+std::vector<Eigen::Vector3d> GPSTransform::XYZToENU(
+    const std::vector<Eigen::Vector3d>& xyz, const double lat0,
+    const double lon0) const {
+  const double lat0_rad = DegToRad(lat0);
+  const double lon0_rad = DegToRad(lon0);
+
+  const double sin_lat0 = sin(lat0_rad);
+  const double sin_lon0 = sin(lon0_rad);
+  const double cos_lat0 = cos(lat0_rad);
+  const double cos_lon0 = cos(lon0_rad);
+
+  // Rotation from the Earth-centered frame to the local tangent frame.
+  Eigen::Matrix3d R;
+  R << -sin_lon0, cos_lon0, 0,
+       -sin_lat0 * cos_lon0, -sin_lat0 * sin_lon0, cos_lat0,
+       cos_lat0 * cos_lon0, cos_lat0 * sin_lon0, sin_lat0;
+
+  const Eigen::Vector3d origin =
+      EllToXYZ({Eigen::Vector3d(lat0, lon0, 0)})[0];
+
+  std::vector<Eigen::Vector3d> enu(xyz.size());
+  for (size_t i = 0; i < xyz.size(); ++i) {
+    enu[i] = R * (xyz[i] - origin);
+  }
+
+  return enu;
+}
+
 }  // namespace colmap
@@ -55,6 +55,18 @@ class GPSTransform {
   std::vector<Eigen::Vector3d> XYZToEll(
       const std::vector<Eigen::Vector3d>& xyz) const;
 
+  // Convert ellipsoidal GPS coordinates to a local East-North-Up frame whose
+  // origin is at (lat0, lon0) on the ellipsoid surface. In contrast to the
+  // Earth-centered XYZ frame, the resulting coordinates are small in magnitude
+  // and can be stored in single precision without loss of accuracy.
+  std::vector<Eigen::Vector3d> EllToENU(const std::vector<Eigen::Vector3d>& ell,
+                                        const double lat0,
+                                        const double lon0) const;
+
+  std::vector<Eigen::Vector3d> XYZToENU(const std::vector<Eigen::Vector3d>& xyz,
+                                        const double lat0,
+                                        const double lon0) const;
+
  private:
   // Semimajor axis.
   double a_;
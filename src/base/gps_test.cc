@@ -165,3 +165,71 @@ BOOST_AUTO_TEST_CASE(TestXYZToEllToXYZ_WGS84) {
     BOOST_CHECK(std::abs(xyz[i](2) - xyz2[i](2)) < 1e-5);
   }
 }
+
+BOOST_AUTO_TEST_CASE(TestEllToXYZToEll) {
+  std::vector<Eigen::Vector3d> ell;
+  for (double lat = -90; lat <= 90; lat += 7.5) {
+    for (double lon = -180; lon < 180; lon += 15) {
+      for (const double alt : {-400.0, 0.0, 561.1851, 8848.0, 4e5, 3.6e7}) {
+        ell.emplace_back(lat, lon, alt);
+      }
+    }
+  }
+
+  GPSTransform gps_tform(GPSTransform::WGS84);
+
+  const auto ell2 = gps_tform.XYZToEll(gps_tform.EllToXYZ(ell));
+
+  for (size_t i = 0; i < ell.size(); ++i) {
+    BOOST_CHECK_LT(std::abs(ell[i](0) - ell2[i](0)), 1e-10);
+    if (std::abs(ell[i](0)) < 90) {
+      BOOST_CHECK_LT(std::abs(ell[i](1) - ell2[i](1)), 1e-10);
+    }
+    BOOST_CHECK_LT(std::abs(ell[i](2) - ell2[i](2)), 1e-6);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestEllToENU) {
+  std::vector<Eigen::Vector3d> ell;
+  ell.emplace_back(48, 11, 0);
+  ell.emplace_back(48.001, 11, 0);
+  ell.emplace_back(48, 11.001, 0);
+  ell.emplace_back(48, 11, 10);
+
+  GPSTransform gps_tform(GPSTransform::GRS80);
+
+  const auto enu = gps_tform.EllToENU(ell, 48, 11);
+
+  BOOST_CHECK_LT(enu[0].norm(), 1e-6);
+
+  // North.
+  BOOST_CHECK_LT(std::abs(enu[1](0)), 1e-6);
+  BOOST_CHECK_GT(enu[1](1), 110);
+  BOOST_CHECK_LT(enu[1](1), 112);
+  BOOST_CHECK_LT(std::abs(enu[1](2)), 1e-2);
+
+  // East.
+  BOOST_CHECK_GT(enu[2](0), 74);
+  BOOST_CHECK_LT(enu[2](0), 75);
+  BOOST_CHECK_LT(std::abs(enu[2](2)), 1e-2);
+
+  // Up.
+  BOOST_CHECK_LT(std::abs(enu[3](0)), 1e-6);
+  BOOST_CHECK_LT(std::abs(enu[3](1)), 1e-6);
+  BOOST_CHECK_CLOSE(enu[3](2), 10, 1e-6);
+
+  // The local frame preserves Euclidean distances.
+  const auto xyz = gps_tform.EllToXYZ(ell);
+  for (size_t i = 0; i < ell.size(); ++i) {
+    for (size_t j = 0; j < ell.size(); ++j) {
+      BOOST_CHECK_LT(std::abs((enu[i] - enu[j]).norm() -
+                              (xyz[i] - xyz[j]).norm()),
+                     1e-6);
+    }
+  }
+
+  const auto enu2 = gps_tform.XYZToENU(xyz, 48, 11);
+  for (size_t i = 0; i < ell.size(); ++i) {
+    BOOST_CHECK_LT((enu[i] - enu2[i]).norm(), 1e-12);
+  }
+}
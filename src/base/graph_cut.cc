@@ -53,38 +53,38 @@ class GraclusGraph {
                const std::vector<int>& weights) {
     CHECK_EQ(edges.size(), weights.size());
 
-    std::unordered_map<int, std::vector<std::pair<int, int>>> adjacency_list;
+    // Build the compressed adjacency list directly, where the neighbors of
+    // each vertex are stored in the order of the edges.
+    std::vector<int> vertex_idxs(2 * edges.size());
     for (size_t i = 0; i < edges.size(); ++i) {
-      const auto& edge = edges[i];
-      const auto weight = weights[i];
-      const int vertex_idx1 = GetVertexIdx(edge.first);
-      const int vertex_idx2 = GetVertexIdx(edge.second);
-      adjacency_list[vertex_idx1].emplace_back(vertex_idx2, weight);
-      adjacency_list[vertex_idx2].emplace_back(vertex_idx1, weight);
+      vertex_idxs[2 * i] = GetVertexIdx(edges[i].first);
+      vertex_idxs[2 * i + 1] = GetVertexIdx(edges[i].second);
     }
 
-    xadj_.reserve(vertex_id_to_idx_.size() + 1);
-    adjncy_.reserve(2 * edges.size());
-    adjwgt_.reserve(2 * edges.size());
-
-    idxtype edge_idx = 0;
-    for (size_t i = 0; i < vertex_id_to_idx_.size(); ++i) {
-      xadj_.push_back(edge_idx);
-
-      if (adjacency_list.count(i) == 0) {
-        continue;
-      }
-
-      for (const auto& edge : adjacency_list[i]) {
-        edge_idx += 1;
-        adjncy_.push_back(edge.first);
-        adjwgt_.push_back(edge.second);
-      }
+    const size_t num_vertices = vertex_idx_to_id_.size();
+    xadj_.resize(num_vertices + 1, 0);
+    for (const int vertex_idx : vertex_idxs) {
+      xadj_[vertex_idx + 1] += 1;
+    }
+    for (size_t i = 0; i < num_vertices; ++i) {
+      xadj_[i + 1] += xadj_[i];
     }
 
-    xadj_.push_back(edge_idx);
+    adjncy_.resize(2 * edges.size());
+    adjwgt_.resize(2 * edges.size());
+    std::vector<idxtype> next_edge_idxs(xadj_.begin(), xadj_.end() - 1);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      const int vertex_idx1 = vertex_idxs[2 * i];
+      const int vertex_idx2 = vertex_idxs[2 * i + 1];
+      const idxtype edge_idx1 = next_edge_idxs[vertex_idx1]++;
+      adjncy_[edge_idx1] = vertex_idx2;
+      adjwgt_[edge_idx1] = weights[i];
+      const idxtype edge_idx2 = next_edge_idxs[vertex_idx2]++;
+      adjncy_[edge_idx2] = vertex_idx1;
+      adjwgt_[edge_idx2] = weights[i];
+    }
 
-    CHECK_EQ(edge_idx, 2 * edges.size());
+    CHECK_EQ(xadj_.back(), 2 * edges.size());
     CHECK_EQ(xadj_.size(), vertex_id_to_idx_.size() + 1);
     CHECK_EQ(adjncy_.size(), 2 * edges.size());
     CHECK_EQ(adjwgt_.size(), 2 * edges.size());
@@ -124,9 +124,9 @@ class GraclusGraph {
   int GetVertexIdx(const int id) {
     const auto it = vertex_id_to_idx_.find(id);
     if (it == vertex_id_to_idx_.end()) {
-      const int idx = vertex_id_to_idx_.size();
+      const int idx = vertex_idx_to_id_.size();
       vertex_id_to_idx_.emplace(id, idx);
-      vertex_idx_to_id_.emplace(idx, id);
+      vertex_idx_to_id_.push_back(id);
       return idx;
     } else {
       return it->second;
@@ -139,7 +139,7 @@ class GraclusGraph {
 
  private:
   std::unordered_map<int, int> vertex_id_to_idx_;
-  std::unordered_map<int, int> vertex_idx_to_id_;
+  std::vector<int> vertex_idx_to_id_;
   std::vector<idxtype> xadj_;
   std::vector<idxtype> adjncy_;
   std::vector<idxtype> adjwgt_;
@@ -32,6 +32,9 @@
 #ifndef COLMAP_SRC_BASE_GRAPH_CUT_H_
 #define COLMAP_SRC_BASE_GRAPH_CUT_H_
 
+#include <cstdint>
+#include <deque>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
@@ -107,6 +110,99 @@ class MinSTGraphCut {
   std::vector<boost::default_color_type> colors_;
 };
 
+// Compute the minimum graph cut of a directed S-T graph using the same
+// Boykov-Kolmogorov algorithm as `MinSTGraphCut`, but on a compact graph for
+// large problems. The nodes and edges are stored in contiguous arrays with
+// 32-bit indices, the reverse edge of an edge is implicitly its neighbor in
+// the edge array, and the source and sink edges are merged into a single
+// residual terminal capacity per node. This requires about 12 bytes per
+// directed edge and 28 bytes per node, a fraction of the adjacency list graph
+// of `MinSTGraphCut`. The search trees are reused between augmentations as
+// described in:
+//   "An Experimental Comparison of Min-Cut/Max-Flow Algorithms for Energy
+//    Minimization in Vision". Yuri Boykov and Vladimir Kolmogorov. PAMI, 2004.
+template <typename node_t, typename value_t>
+class CompactMinSTGraphCut {
+ public:
+  // The number of edges is only used to reserve memory for the edges.
+  CompactMinSTGraphCut(const size_t num_nodes, const size_t num_edges = 0);
+
+  // Count the number of nodes and edges in the graph, where every source and
+  // sink capacity of a node counts as an edge and its reverse edge.
+  size_t NumNodes() const;
+  size_t NumEdges() const;
+
+  // Add node to the graph.
+  void AddNode(const node_t node_idx, const value_t source_capacity,
+               const value_t sink_capacity);
+
+  // Add edge to the graph.
+  void AddEdge(const node_t node_idx1, const node_t node_idx2,
+               const value_t capacity, const value_t reverse_capacity);
+
+  // Compute the min-cut using the max-flow algorithm. Returns the flow.
+  value_t Compute();
+
+  // Check whether node is connected to source or sink after computing the cut.
+  bool IsConnectedToSource(const node_t node_idx) const;
+  bool IsConnectedToSink(const node_t node_idx) const;
+
+ private:
+  typedef uint32_t index_t;
+
+  // Special values of the edge and node indices.
+  static const index_t kInvalidIdx = std::numeric_limits<index_t>::max();
+  static const index_t kTerminalIdx = kInvalidIdx - 1;
+  static const index_t kOrphanIdx = kInvalidIdx - 2;
+
+  struct Node {
+    // The first outgoing edge of the node.
+    index_t first_edge_idx;
+    // The edge to the parent in the search tree, or one of the special values
+    // for free nodes, the children of the terminals, and orphans.
+    index_t parent_edge_idx;
+    // The next node in the list of active nodes. The last node refers to
+    // itself and nodes that are not in the list are invalid.
+    index_t next_active_idx;
+    // The time when the distance to the terminal was last computed.
+    index_t timestamp;
+    index_t distance;
+    // The residual capacity from the source if positive or to the sink if
+    // negative.
+    value_t terminal_capacity;
+    bool is_sink;
+  };
+
+  struct Edge {
+    index_t head_idx;
+    // The next outgoing edge of the same node.
+    index_t next_edge_idx;
+    value_t residual;
+  };
+
+  // The reverse edges are stored next to each other.
+  static index_t ReverseEdge(const index_t edge_idx) { return edge_idx ^ 1; }
+
+  void SetActive(const index_t node_idx);
+  index_t NextActive();
+  void SetOrphanFront(const index_t node_idx);
+  void SetOrphanRear(const index_t node_idx);
+
+  void Augment(const index_t middle_edge_idx);
+  void ProcessSourceOrphan(const index_t node_idx);
+  void ProcessSinkOrphan(const index_t node_idx);
+
+  std::vector<Node> nodes_;
+  std::vector<Edge> edges_;
+  size_t num_edges_;
+  value_t flow_;
+
+  index_t queue_first_idx_;
+  index_t queue_last_idx_;
+  std::deque<index_t> orphans_;
+  index_t time_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -204,6 +300,506 @@ bool MinSTGraphCut<node_t, value_t>::IsConnectedToSink(
   return colors_.at(node_idx) == boost::white_color;
 }
 
+template <typename node_t, typename value_t>
+const typename CompactMinSTGraphCut<node_t, value_t>::index_t
+    CompactMinSTGraphCut<node_t, value_t>::kInvalidIdx;
+
+template <typename node_t, typename value_t>
+const typename CompactMinSTGraphCut<node_t, value_t>::index_t
+    CompactMinSTGraphCut<node_t, value_t>::kTerminalIdx;
+
+template <typename node_t, typename value_t>
+const typename CompactMinSTGraphCut<node_t, value_t>::index_t
+    CompactMinSTGraphCut<node_t, value_t>::kOrphanIdx;
+
+template <typename node_t, typename value_t>
+CompactMinSTGraphCut<node_t, value_t>::CompactMinSTGraphCut(
+    const size_t num_nodes, const size_t num_edges)
+    : num_edges_(0),
+      flow_(0),
+      queue_first_idx_(kInvalidIdx),
+      queue_last_idx_(kInvalidIdx),
+      time_(0) {
+  CHECK_LT(num_nodes, kOrphanIdx);
+  Node node;
+  node.first_edge_idx = kInvalidIdx;
+  node.parent_edge_idx = kInvalidIdx;
+  node.next_active_idx = kInvalidIdx;
+  node.timestamp = 0;
+  node.distance = 0;
+  node.terminal_capacity = 0;
+  node.is_sink = false;
+  nodes_.resize(num_nodes, node);
+  edges_.reserve(2 * num_edges);
+}
+
+template <typename node_t, typename value_t>
+size_t CompactMinSTGraphCut<node_t, value_t>::NumNodes() const {
+  return nodes_.size();
+}
+
+template <typename node_t, typename value_t>
+size_t CompactMinSTGraphCut<node_t, value_t>::NumEdges() const {
+  return num_edges_;
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::AddNode(
+    const node_t node_idx, const value_t source_capacity,
+    const value_t sink_capacity) {
+  CHECK_GE(node_idx, 0);
+  CHECK_LT(node_idx, nodes_.size());
+  CHECK_GE(source_capacity, 0);
+  CHECK_GE(sink_capacity, 0);
+
+  if (source_capacity > 0) {
+    num_edges_ += 2;
+  }
+  if (sink_capacity > 0) {
+    num_edges_ += 2;
+  }
+
+  // Only the difference of the source and sink capacities remains as residual
+  // capacity, since the common part directly flows from source to sink.
+  value_t& terminal_capacity = nodes_[node_idx].terminal_capacity;
+  value_t total_source_capacity = source_capacity;
+  value_t total_sink_capacity = sink_capacity;
+  if (terminal_capacity > 0) {
+    total_source_capacity += terminal_capacity;
+  } else {
+    total_sink_capacity -= terminal_capacity;
+  }
+  flow_ += std::min(total_source_capacity, total_sink_capacity);
+  terminal_capacity = total_source_capacity - total_sink_capacity;
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::AddEdge(
+    const node_t node_idx1, const node_t node_idx2, const value_t capacity,
+    const value_t reverse_capacity) {
+  CHECK_GE(node_idx1, 0);
+  CHECK_LT(node_idx1, nodes_.size());
+  CHECK_GE(node_idx2, 0);
+  CHECK_LT(node_idx2, nodes_.size());
+  CHECK_NE(node_idx1, node_idx2);
+  CHECK_GE(capacity, 0);
+  CHECK_GE(reverse_capacity, 0);
+  CHECK_LT(edges_.size() + 2, kOrphanIdx);
+
+  const index_t edge_idx = static_cast<index_t>(edges_.size());
+  Node& node1 = nodes_[node_idx1];
+  Node& node2 = nodes_[node_idx2];
+  edges_.push_back({static_cast<index_t>(node_idx2), node1.first_edge_idx,
+                    capacity});
+  edges_.push_back({static_cast<index_t>(node_idx1), node2.first_edge_idx,
+                    reverse_capacity});
+  node1.first_edge_idx = edge_idx;
+  node2.first_edge_idx = ReverseEdge(edge_idx);
+
+  num_edges_ += 2;
+}
+
+template <typename node_t, typename value_t>
+value_t CompactMinSTGraphCut<node_t, value_t>::Compute() {
+  // Initialize the search trees with the nodes connected to the terminals.
+  queue_first_idx_ = kInvalidIdx;
+  queue_last_idx_ = kInvalidIdx;
+  orphans_.clear();
+  time_ = 0;
+  for (index_t node_idx = 0; node_idx < nodes_.size(); ++node_idx) {
+    Node& node = nodes_[node_idx];
+    node.next_active_idx = kInvalidIdx;
+    node.timestamp = time_;
+    if (node.terminal_capacity != 0) {
+      node.is_sink = node.terminal_capacity < 0;
+      node.parent_edge_idx = kTerminalIdx;
+      node.distance = 1;
+      SetActive(node_idx);
+    } else {
+      node.parent_edge_idx = kInvalidIdx;
+    }
+  }
+
+  index_t current_node_idx = kInvalidIdx;
+  while (true) {
+    index_t node_idx = current_node_idx;
+    if (node_idx != kInvalidIdx) {
+      nodes_[node_idx].next_active_idx = kInvalidIdx;
+      if (nodes_[node_idx].parent_edge_idx == kInvalidIdx) {
+        node_idx = kInvalidIdx;
+      }
+    }
+    if (node_idx == kInvalidIdx) {
+      node_idx = NextActive();
+      if (node_idx == kInvalidIdx) {
+        break;
+      }
+    }
+
+    // Grow the search tree of the active node until it touches the other
+    // search tree, which yields the middle edge of an augmenting path from
+    // the source to the sink.
+    const Node& node = nodes_[node_idx];
+    index_t middle_edge_idx = kInvalidIdx;
+    for (index_t edge_idx = node.first_edge_idx; edge_idx != kInvalidIdx;
+         edge_idx = edges_[edge_idx].next_edge_idx) {
+      const index_t tree_edge_idx =
+          node.is_sink ? ReverseEdge(edge_idx) : edge_idx;
+      if (edges_[tree_edge_idx].residual == 0) {
+        continue;
+      }
+      const index_t neighbor_idx = edges_[edge_idx].head_idx;
+      Node& neighbor = nodes_[neighbor_idx];
+      if (neighbor.parent_edge_idx == kInvalidIdx) {
+        neighbor.is_sink = node.is_sink;
+        neighbor.parent_edge_idx = ReverseEdge(edge_idx);
+        neighbor.timestamp = node.timestamp;
+        neighbor.distance = node.distance + 1;
+        SetActive(neighbor_idx);
+      } else if (neighbor.is_sink != node.is_sink) {
+        middle_edge_idx = tree_edge_idx;
+        break;
+      } else if (neighbor.timestamp <= node.timestamp &&
+                 neighbor.distance > node.distance) {
+        // Shorten the path of the neighbor to its terminal.
+        neighbor.parent_edge_idx = ReverseEdge(edge_idx);
+        neighbor.timestamp = node.timestamp;
+        neighbor.distance = node.distance + 1;
+      }
+    }
+
+    time_ += 1;
+
+    if (middle_edge_idx == kInvalidIdx) {
+      current_node_idx = kInvalidIdx;
+      continue;
+    }
+
+    // Continue to grow from the same node after the augmentation.
+    nodes_[node_idx].next_active_idx = node_idx;
+    current_node_idx = node_idx;
+
+    Augment(middle_edge_idx);
+
+    // Adopt the orphans that lost their parent by the augmentation.
+    while (!orphans_.empty()) {
+      const index_t orphan_idx = orphans_.front();
+      orphans_.pop_front();
+      if (nodes_[orphan_idx].is_sink) {
+        ProcessSinkOrphan(orphan_idx);
+      } else {
+        ProcessSourceOrphan(orphan_idx);
+      }
+    }
+  }
+
+  return flow_;
+}
+
+template <typename node_t, typename value_t>
+bool CompactMinSTGraphCut<node_t, value_t>::IsConnectedToSource(
+    const node_t node_idx) const {
+  return !IsConnectedToSink(node_idx);
+}
+
+template <typename node_t, typename value_t>
+bool CompactMinSTGraphCut<node_t, value_t>::IsConnectedToSink(
+    const node_t node_idx) const {
+  const Node& node = nodes_.at(node_idx);
+  return node.parent_edge_idx != kInvalidIdx && node.is_sink;
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::SetActive(const index_t node_idx) {
+  Node& node = nodes_[node_idx];
+  if (node.next_active_idx != kInvalidIdx) {
+    return;
+  }
+  if (queue_last_idx_ == kInvalidIdx) {
+    queue_first_idx_ = node_idx;
+  } else {
+    nodes_[queue_last_idx_].next_active_idx = node_idx;
+  }
+  queue_last_idx_ = node_idx;
+  node.next_active_idx = node_idx;
+}
+
+template <typename node_t, typename value_t>
+typename CompactMinSTGraphCut<node_t, value_t>::index_t
+CompactMinSTGraphCut<node_t, value_t>::NextActive() {
+  while (queue_first_idx_ != kInvalidIdx) {
+    const index_t node_idx = queue_first_idx_;
+    Node& node = nodes_[node_idx];
+    if (node.next_active_idx == node_idx) {
+      queue_first_idx_ = kInvalidIdx;
+      queue_last_idx_ = kInvalidIdx;
+    } else {
+      queue_first_idx_ = node.next_active_idx;
+    }
+    node.next_active_idx = kInvalidIdx;
+    // Nodes that became free since they were activated are skipped.
+    if (node.parent_edge_idx != kInvalidIdx) {
+      return node_idx;
+    }
+  }
+  return kInvalidIdx;
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::SetOrphanFront(
+    const index_t node_idx) {
+  nodes_[node_idx].parent_edge_idx = kOrphanIdx;
+  orphans_.push_front(node_idx);
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::SetOrphanRear(
+    const index_t node_idx) {
+  nodes_[node_idx].parent_edge_idx = kOrphanIdx;
+  orphans_.push_back(node_idx);
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::Augment(
+    const index_t middle_edge_idx) {
+  // The middle edge leads from the source tree into the sink tree. In the
+  // source tree, the flow runs along the reverse of the parent edges and in
+  // the sink tree along the parent edges.
+  const index_t source_tree_idx =
+      edges_[ReverseEdge(middle_edge_idx)].head_idx;
+  const index_t sink_tree_idx = edges_[middle_edge_idx].head_idx;
+
+  // Find the bottleneck capacity of the path.
+  value_t bottleneck = edges_[middle_edge_idx].residual;
+  index_t node_idx = source_tree_idx;
+  while (nodes_[node_idx].parent_edge_idx != kTerminalIdx) {
+    const index_t edge_idx = nodes_[node_idx].parent_edge_idx;
+    bottleneck = std::min(bottleneck, edges_[ReverseEdge(edge_idx)].residual);
+    node_idx = edges_[edge_idx].head_idx;
+  }
+  bottleneck = std::min(bottleneck, nodes_[node_idx].terminal_capacity);
+  node_idx = sink_tree_idx;
+  while (nodes_[node_idx].parent_edge_idx != kTerminalIdx) {
+    const index_t edge_idx = nodes_[node_idx].parent_edge_idx;
+    bottleneck = std::min(bottleneck, edges_[edge_idx].residual);
+    node_idx = edges_[edge_idx].head_idx;
+  }
+  bottleneck = std::min(bottleneck, -nodes_[node_idx].terminal_capacity);
+
+  // Push the flow along the path. Nodes, whose edge to the parent is
+  // saturated, become orphans.
+  edges_[ReverseEdge(middle_edge_idx)].residual += bottleneck;
+  edges_[middle_edge_idx].residual -= bottleneck;
+  node_idx = source_tree_idx;
+  while (nodes_[node_idx].parent_edge_idx != kTerminalIdx) {
+    const index_t edge_idx = nodes_[node_idx].parent_edge_idx;
+    edges_[edge_idx].residual += bottleneck;
+    edges_[ReverseEdge(edge_idx)].residual -= bottleneck;
+    if (edges_[ReverseEdge(edge_idx)].residual == 0) {
+      SetOrphanFront(node_idx);
+    }
+    node_idx = edges_[edge_idx].head_idx;
+  }
+  nodes_[node_idx].terminal_capacity -= bottleneck;
+  if (nodes_[node_idx].terminal_capacity == 0) {
+    SetOrphanFront(node_idx);
+  }
+  node_idx = sink_tree_idx;
+  while (nodes_[node_idx].parent_edge_idx != kTerminalIdx) {
+    const index_t edge_idx = nodes_[node_idx].parent_edge_idx;
+    edges_[ReverseEdge(edge_idx)].residual += bottleneck;
+    edges_[edge_idx].residual -= bottleneck;
+    if (edges_[edge_idx].residual == 0) {
+      SetOrphanFront(node_idx);
+    }
+    node_idx = edges_[edge_idx].head_idx;
+  }
+  nodes_[node_idx].terminal_capacity += bottleneck;
+  if (nodes_[node_idx].terminal_capacity == 0) {
+    SetOrphanFront(node_idx);
+  }
+
+  flow_ += bottleneck;
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::ProcessSourceOrphan(
+    const index_t node_idx) {
+  const index_t kInfiniteDistance = std::numeric_limits<index_t>::max();
+
+  // Find the new parent with the shortest path to the source among the
+  // neighbors in the source tree, whose origin is not an orphan.
+  index_t min_edge_idx = kInvalidIdx;
+  index_t min_distance = kInfiniteDistance;
+  for (index_t edge_idx = nodes_[node_idx].first_edge_idx;
+       edge_idx != kInvalidIdx; edge_idx = edges_[edge_idx].next_edge_idx) {
+    if (edges_[ReverseEdge(edge_idx)].residual == 0) {
+      continue;
+    }
+    index_t neighbor_idx = edges_[edge_idx].head_idx;
+    if (nodes_[neighbor_idx].is_sink ||
+        nodes_[neighbor_idx].parent_edge_idx == kInvalidIdx) {
+      continue;
+    }
+
+    index_t distance = 0;
+    while (true) {
+      Node& neighbor = nodes_[neighbor_idx];
+      if (neighbor.timestamp == time_) {
+        distance += neighbor.distance;
+        break;
+      }
+      const index_t parent_edge_idx = neighbor.parent_edge_idx;
+      distance += 1;
+      if (parent_edge_idx == kTerminalIdx) {
+        neighbor.timestamp = time_;
+        neighbor.distance = 1;
+        break;
+      }
+      if (parent_edge_idx == kOrphanIdx) {
+        distance = kInfiniteDistance;
+        break;
+      }
+      neighbor_idx = edges_[parent_edge_idx].head_idx;
+    }
+
+    if (distance == kInfiniteDistance) {
+      continue;
+    }
+
+    if (distance < min_distance) {
+      min_edge_idx = edge_idx;
+      min_distance = distance;
+    }
+
+    // Cache the distances along the path for the following searches.
+    for (neighbor_idx = edges_[edge_idx].head_idx;
+         nodes_[neighbor_idx].timestamp != time_;
+         neighbor_idx =
+             edges_[nodes_[neighbor_idx].parent_edge_idx].head_idx) {
+      nodes_[neighbor_idx].timestamp = time_;
+      nodes_[neighbor_idx].distance = distance;
+      distance -= 1;
+    }
+  }
+
+  Node& node = nodes_[node_idx];
+  node.parent_edge_idx = min_edge_idx;
+  if (min_edge_idx != kInvalidIdx) {
+    node.timestamp = time_;
+    node.distance = min_distance + 1;
+    return;
+  }
+
+  // The node becomes free, so its neighbors in the source tree are
+  // activated to grow into it and its children become orphans.
+  for (index_t edge_idx = node.first_edge_idx; edge_idx != kInvalidIdx;
+       edge_idx = edges_[edge_idx].next_edge_idx) {
+    const index_t neighbor_idx = edges_[edge_idx].head_idx;
+    const Node& neighbor = nodes_[neighbor_idx];
+    const index_t parent_edge_idx = neighbor.parent_edge_idx;
+    if (neighbor.is_sink || parent_edge_idx == kInvalidIdx) {
+      continue;
+    }
+    if (edges_[ReverseEdge(edge_idx)].residual != 0) {
+      SetActive(neighbor_idx);
+    }
+    if (parent_edge_idx != kTerminalIdx && parent_edge_idx != kOrphanIdx &&
+        edges_[parent_edge_idx].head_idx == node_idx) {
+      SetOrphanRear(neighbor_idx);
+    }
+  }
+}
+
+template <typename node_t, typename value_t>
+void CompactMinSTGraphCut<node_t, value_t>::ProcessSinkOrphan(
+    const index_t node_idx) {
+  const index_t kInfiniteDistance = std::numeric_limits<index_t>::max();
+
+  // Find the new parent with the shortest path to the sink among the
+  // neighbors in the sink tree, whose origin is not an orphan.
+  index_t min_edge_idx = kInvalidIdx;
+  index_t min_distance = kInfiniteDistance;
+  for (index_t edge_idx = nodes_[node_idx].first_edge_idx;
+       edge_idx != kInvalidIdx; edge_idx = edges_[edge_idx].next_edge_idx) {
+    if (edges_[edge_idx].residual == 0) {
+      continue;
+    }
+    index_t neighbor_idx = edges_[edge_idx].head_idx;
+    if (!nodes_[neighbor_idx].is_sink ||
+        nodes_[neighbor_idx].parent_edge_idx == kInvalidIdx) {
+      continue;
+    }
+
+    index_t distance = 0;
+    while (true) {
+      Node& neighbor = nodes_[neighbor_idx];
+      if (neighbor.timestamp == time_) {
+        distance += neighbor.distance;
+        break;
+      }
+      const index_t parent_edge_idx = neighbor.parent_edge_idx;
+      distance += 1;
+      if (parent_edge_idx == kTerminalIdx) {
+        neighbor.timestamp = time_;
+        neighbor.distance = 1;
+        break;
+      }
+      if (parent_edge_idx == kOrphanIdx) {
+        distance = kInfiniteDistance;
+        break;
+      }
+      neighbor_idx = edges_[parent_edge_idx].head_idx;
+    }
+
+    if (distance == kInfiniteDistance) {
+      continue;
+    }
+
+    if (distance < min_distance) {
+      min_edge_idx = edge_idx;
+      min_distance = distance;
+    }
+
+    // Cache the distances along the path for the following searches.
+    for (neighbor_idx = edges_[edge_idx].head_idx;
+         nodes_[neighbor_idx].timestamp != time_;
+         neighbor_idx =
+             edges_[nodes_[neighbor_idx].parent_edge_idx].head_idx) {
+      nodes_[neighbor_idx].timestamp = time_;
+      nodes_[neighbor_idx].distance = distance;
+      distance -= 1;
+    }
+  }
+
+  Node& node = nodes_[node_idx];
+  node.parent_edge_idx = min_edge_idx;
+  if (min_edge_idx != kInvalidIdx) {
+    node.timestamp = time_;
+    node.distance = min_distance + 1;
+    return;
+  }
+
+  // The node becomes free, so its neighbors in the sink tree are activated
+  // to grow into it and its children become orphans.
+  for (index_t edge_idx = node.first_edge_idx; edge_idx != kInvalidIdx;
+       edge_idx = edges_[edge_idx].next_edge_idx) {
+    const index_t neighbor_idx = edges_[edge_idx].head_idx;
+    const Node& neighbor = nodes_[neighbor_idx];
+    const index_t parent_edge_idx = neighbor.parent_edge_idx;
+    if (!neighbor.is_sink || parent_edge_idx == kInvalidIdx) {
+      continue;
+    }
+    if (edges_[edge_idx].residual != 0) {
+      SetActive(neighbor_idx);
+    }
+    if (parent_edge_idx != kTerminalIdx && parent_edge_idx != kOrphanIdx &&
+        edges_[parent_edge_idx].head_idx == node_idx) {
+      SetOrphanRear(neighbor_idx);
+    }
+  }
+}
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_BASE_GRAPH_CUT_H_
@@ -33,6 +33,7 @@
 #include "util/testing.h"
 
 #include "base/graph_cut.h"
+#include "util/random.h"
 
 using namespace colmap;
 
@@ -188,3 +189,97 @@ BOOST_AUTO_TEST_CASE(TestMinSTGraphCut3) {
   BOOST_CHECK(graph.IsConnectedToSink(1));
   BOOST_CHECK(graph.IsConnectedToSink(2));
 }
+
+BOOST_AUTO_TEST_CASE(TestCompactMinSTGraphCut1) {
+  CompactMinSTGraphCut<int, int> graph(2);
+  BOOST_CHECK_EQUAL(graph.NumNodes(), 2);
+  BOOST_CHECK_EQUAL(graph.NumEdges(), 0);
+  graph.AddNode(0, 5, 1);
+  graph.AddNode(1, 2, 6);
+  graph.AddEdge(0, 1, 3, 4);
+  BOOST_CHECK_EQUAL(graph.NumEdges(), 10);
+  BOOST_CHECK_EQUAL(graph.Compute(), 6);
+  BOOST_CHECK(graph.IsConnectedToSource(0));
+  BOOST_CHECK(graph.IsConnectedToSink(1));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactMinSTGraphCut2) {
+  CompactMinSTGraphCut<int, int> graph(2);
+  graph.AddNode(0, 1, 5);
+  graph.AddNode(1, 2, 6);
+  graph.AddEdge(0, 1, 3, 4);
+  BOOST_CHECK_EQUAL(graph.NumEdges(), 10);
+  BOOST_CHECK_EQUAL(graph.Compute(), 3);
+  BOOST_CHECK(graph.IsConnectedToSink(0));
+  BOOST_CHECK(graph.IsConnectedToSink(1));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactMinSTGraphCut3) {
+  CompactMinSTGraphCut<int, int> graph(3);
+  graph.AddNode(0, 6, 4);
+  graph.AddNode(2, 3, 6);
+  graph.AddEdge(0, 1, 2, 4);
+  graph.AddEdge(1, 2, 3, 5);
+  BOOST_CHECK_EQUAL(graph.NumEdges(), 12);
+  BOOST_CHECK_EQUAL(graph.Compute(), 9);
+  BOOST_CHECK(graph.IsConnectedToSource(0));
+  BOOST_CHECK(graph.IsConnectedToSink(1));
+  BOOST_CHECK(graph.IsConnectedToSink(2));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactMinSTGraphCutRandom) {
+  SetPRNGSeed(0);
+  const int kNumNodes = 200;
+  for (int i = 0; i < 20; ++i) {
+    MinSTGraphCut<int, int> graph(kNumNodes);
+    CompactMinSTGraphCut<int, int> compact_graph(kNumNodes);
+    std::vector<std::pair<int, int>> terminal_capacities;
+    for (int node_idx = 0; node_idx < kNumNodes; ++node_idx) {
+      const int source_capacity = std::max(0, RandomInteger(-20, 20));
+      const int sink_capacity = std::max(0, RandomInteger(-20, 20));
+      graph.AddNode(node_idx, source_capacity, sink_capacity);
+      compact_graph.AddNode(node_idx, source_capacity, sink_capacity);
+      terminal_capacities.emplace_back(source_capacity, sink_capacity);
+    }
+
+    std::vector<std::pair<std::pair<int, int>, int>> edges;
+    for (int edge_idx = 0; edge_idx < 4 * kNumNodes; ++edge_idx) {
+      const int node_idx1 = RandomInteger(0, kNumNodes - 1);
+      const int node_idx2 = RandomInteger(0, kNumNodes - 1);
+      if (node_idx1 == node_idx2) {
+        continue;
+      }
+      const int capacity = RandomInteger(0, 10);
+      const int reverse_capacity = RandomInteger(0, 10);
+      graph.AddEdge(node_idx1, node_idx2, capacity, reverse_capacity);
+      compact_graph.AddEdge(node_idx1, node_idx2, capacity, reverse_capacity);
+      edges.emplace_back(std::make_pair(node_idx1, node_idx2), capacity);
+      edges.emplace_back(std::make_pair(node_idx2, node_idx1),
+                         reverse_capacity);
+    }
+
+    BOOST_CHECK_EQUAL(compact_graph.NumEdges(), graph.NumEdges());
+    const int flow = compact_graph.Compute();
+    BOOST_CHECK_EQUAL(flow, graph.Compute());
+
+    // The capacity of the cut between the source and sink nodes must equal
+    // the maximum flow.
+    int cut_capacity = 0;
+    for (int node_idx = 0; node_idx < kNumNodes; ++node_idx) {
+      BOOST_CHECK_NE(compact_graph.IsConnectedToSource(node_idx),
+                     compact_graph.IsConnectedToSink(node_idx));
+      if (compact_graph.IsConnectedToSource(node_idx)) {
+        cut_capacity += terminal_capacities[node_idx].second;
+      } else {
+        cut_capacity += terminal_capacities[node_idx].first;
+      }
+    }
+    for (const auto& edge : edges) {
+      if (compact_graph.IsConnectedToSource(edge.first.first) &&
+          compact_graph.IsConnectedToSink(edge.first.second)) {
+        cut_capacity += edge.second;
+      }
+    }
+    BOOST_CHECK_EQUAL(cut_capacity, flow);
+  }
+}
@@ -61,14 +61,46 @@ void Image::SetUp(const class Camera& camera) {
   CHECK_EQ(camera_id_, camera.CameraId());
   point3D_visibility_pyramid_ = VisibilityPyramid(
       kNumPoint3DVisibilityPyramidLevels, camera.Width(), camera.Height());
+  CHECK_LE(point3D_visibility_pyramid_.NumCells(),
+           std::numeric_limits<uint16_t>::max() + size_t(1));
+
+  // The pyramid cells of the image points are looked up once, since the
+  // points are repeatedly set and reset during the reconstruction.
+  const std::vector<class Point2D>& points2D = Points2D();
+  point3D_visibility_pyramid_cells_.resize(points2D.size());
+  for (point2D_t point2D_idx = 0; point2D_idx < points2D.size();
+       ++point2D_idx) {
+    const class Point2D& point2D = points2D[point2D_idx];
+    point3D_visibility_pyramid_cells_[point2D_idx] = static_cast<uint16_t>(
+        point3D_visibility_pyramid_.CellIndex(point2D.X(), point2D.Y()));
+  }
+
+  // Restore the visible points, in case the image was set up before.
+  visible_point2D_idxs_.clear();
+  visible_point2D_positions_.assign(num_correspondences_have_point3D_.size(),
+                                    kInvalidPoint2DIdx);
+  for (point2D_t point2D_idx = 0;
+       point2D_idx < num_correspondences_have_point3D_.size(); ++point2D_idx) {
+    if (num_correspondences_have_point3D_[point2D_idx] > 0) {
+      point3D_visibility_pyramid_.SetCell(
+          point3D_visibility_pyramid_cells_[point2D_idx]);
+      visible_point2D_positions_[point2D_idx] =
+          static_cast<point2D_t>(visible_point2D_idxs_.size());
+      visible_point2D_idxs_.push_back(point2D_idx);
+    }
+  }
 }
 
 void Image::TearDown() {
   point3D_visibility_pyramid_ = VisibilityPyramid(0, 0, 0);
+  point3D_visibility_pyramid_cells_ = std::vector<uint16_t>();
+  visible_point2D_idxs_ = std::vector<point2D_t>();
+  visible_point2D_positions_ = std::vector<point2D_t>();
 }
 
 void Image::SetPoints2D(const std::vector<Eigen::Vector2d>& points) {
-  CHECK(points2D_.empty());
+  CHECK_EQ(NumPoints2D(), 0);
+  shared_points2D_.reset();
   points2D_.resize(points.size());
   num_correspondences_have_point3D_.resize(points.size(), 0);
   for (point2D_t point2D_idx = 0; point2D_idx < points.size(); ++point2D_idx) {
@@ -77,15 +109,31 @@ void Image::SetPoints2D(const std::vector<Eigen::Vector2d>& points) {
 }
 
 void Image::SetPoints2D(const std::vector<class Point2D>& points) {
-  CHECK(points2D_.empty());
+  CHECK_EQ(NumPoints2D(), 0);
+  shared_points2D_.reset();
   points2D_ = points;
   num_correspondences_have_point3D_.resize(points.size(), 0);
 }
 
+void Image::SharePoints2D() {
+  if (!shared_points2D_) {
+    shared_points2D_ = std::make_shared<const std::vector<class Point2D>>(
+        std::move(points2D_));
+    points2D_ = std::vector<class Point2D>();
+  }
+}
+
+void Image::DetachPoints2D() {
+  if (shared_points2D_) {
+    points2D_ = *shared_points2D_;
+    shared_points2D_.reset();
+  }
+}
+
 void Image::SetPoint3DForPoint2D(const point2D_t point2D_idx,
                                  const point3D_t point3D_id) {
   CHECK_NE(point3D_id, kInvalidPoint3DId);
-  class Point2D& point2D = points2D_.at(point2D_idx);
+  class Point2D& point2D = Point2D(point2D_idx);
   if (!point2D.HasPoint3D()) {
     num_points3D_ += 1;
   }
@@ -93,7 +141,7 @@ void Image::SetPoint3DForPoint2D(const point2D_t point2D_idx,
 }
 
 void Image::ResetPoint3DForPoint2D(const point2D_t point2D_idx) {
-  class Point2D& point2D = points2D_.at(point2D_idx);
+  class Point2D& point2D = Point2D(point2D_idx);
   if (point2D.HasPoint3D()) {
     point2D.SetPoint3DId(kInvalidPoint3DId);
     num_points3D_ -= 1;
@@ -101,35 +149,46 @@ void Image::ResetPoint3DForPoint2D(const point2D_t point2D_idx) {
 }
 
 bool Image::HasPoint3D(const point3D_t point3D_id) const {
-  return std::find_if(points2D_.begin(), points2D_.end(),
+  const std::vector<class Point2D>& points2D = Points2D();
+  return std::find_if(points2D.begin(), points2D.end(),
                       [point3D_id](const class Point2D& point2D) {
                         return point2D.Point3DId() == point3D_id;
-                      }) != points2D_.end();
+                      }) != points2D.end();
 }
 
 void Image::IncrementCorrespondenceHasPoint3D(const point2D_t point2D_idx) {
-  const class Point2D& point2D = points2D_.at(point2D_idx);
+  num_correspondences_have_point3D_.at(point2D_idx) += 1;
 
-  num_correspondences_have_point3D_[point2D_idx] += 1;
+  // The pyramid only captures whether an image point is visible, which only
+  // changes for its first triangulated correspondence.
   if (num_correspondences_have_point3D_[point2D_idx] == 1) {
     num_visible_points3D_ += 1;
+    point3D_visibility_pyramid_.SetCell(
+        point3D_visibility_pyramid_cells_[point2D_idx]);
+    visible_point2D_positions_[point2D_idx] =
+        static_cast<point2D_t>(visible_point2D_idxs_.size());
+    visible_point2D_idxs_.push_back(point2D_idx);
   }
 
-  point3D_visibility_pyramid_.SetPoint(point2D.X(), point2D.Y());
-
   assert(num_visible_points3D_ <= num_observations_);
 }
 
 void Image::DecrementCorrespondenceHasPoint3D(const point2D_t point2D_idx) {
-  const class Point2D& point2D = points2D_.at(point2D_idx);
+  num_correspondences_have_point3D_.at(point2D_idx) -= 1;
 
-  num_correspondences_have_point3D_[point2D_idx] -= 1;
   if (num_correspondences_have_point3D_[point2D_idx] == 0) {
     num_visible_points3D_ -= 1;
+    point3D_visibility_pyramid_.ResetCell(
+        point3D_visibility_pyramid_cells_[point2D_idx]);
+    // Move the last visible point into the position of the removed point.
+    const point2D_t position = visible_point2D_positions_[point2D_idx];
+    const point2D_t last_point2D_idx = visible_point2D_idxs_.back();
+    visible_point2D_idxs_[position] = last_point2D_idx;
+    visible_point2D_positions_[last_point2D_idx] = position;
+    visible_point2D_idxs_.pop_back();
+    visible_point2D_positions_[point2D_idx] = kInvalidPoint2DIdx;
   }
 
-  point3D_visibility_pyramid_.ResetPoint(point2D.X(), point2D.Y());
-
   assert(num_visible_points3D_ <= num_observations_);
 }
 
@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_BASE_IMAGE_H_
 #define COLMAP_SRC_BASE_IMAGE_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -102,6 +103,11 @@ class Image {
   // triangulated point in another image.
   inline point2D_t NumVisiblePoints3D() const;
 
+  // Get the indices of the image points that see a triangulated point, in
+  // arbitrary order. These are the candidates for 2D-3D correspondences, which
+  // are maintained as points are triangulated after `SetUp`.
+  inline const std::vector<point2D_t>& VisiblePoints2D() const;
+
   // Get the score of triangulated observations. In contrast to
   // `NumVisiblePoints3D`, this score also captures the distribution
   // of triangulated observations in the image. This is useful to select
@@ -148,6 +154,13 @@ class Image {
   void SetPoints2D(const std::vector<Eigen::Vector2d>& points);
   void SetPoints2D(const std::vector<class Point2D>& points);
 
+  // Make the image points immutable and share them with all copies of this
+  // image, e.g. the images of a database cache with the images of the
+  // reconstructions loaded from it. A copy gets its own points when it
+  // modifies them or when `DetachPoints2D` is called.
+  void SharePoints2D();
+  void DetachPoints2D();
+
   // Set the point as triangulated, i.e. it is part of a 3D point track.
   void SetPoint3DForPoint2D(const point2D_t point2D_idx,
                             const point3D_t point3D_id);
@@ -234,14 +247,26 @@ class Image {
   Eigen::Vector3d tvec_prior_;
 
   // All image points, including points that are not part of a 3D point track.
+  // If the points are shared with other copies of the image, they are stored
+  // in `shared_points2D_` and `points2D_` is empty.
   std::vector<class Point2D> points2D_;
+  std::shared_ptr<const std::vector<class Point2D>> shared_points2D_;
 
   // Per image point, the number of correspondences that have a 3D point.
   std::vector<image_t> num_correspondences_have_point3D_;
 
   // Data structure to compute the distribution of triangulated correspondences
   // in the image. Note that this structure is only usable after `SetUp`.
+  // Each visible image point populates the cell of the finest pyramid level,
+  // which is precomputed per image point in `SetUp`.
   VisibilityPyramid point3D_visibility_pyramid_;
+  std::vector<uint16_t> point3D_visibility_pyramid_cells_;
+
+  // The visible image points and, per image point, its position in the list
+  // of visible image points, or `kInvalidPoint2DIdx` if it is not visible.
+  // Note that these are only maintained after `SetUp`.
+  std::vector<point2D_t> visible_point2D_idxs_;
+  std::vector<point2D_t> visible_point2D_positions_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -272,7 +297,7 @@ bool Image::IsRegistered() const { return registered_; }
 void Image::SetRegistered(const bool registered) { registered_ = registered; }
 
 point2D_t Image::NumPoints2D() const {
-  return static_cast<point2D_t>(points2D_.size());
+  return static_cast<point2D_t>(Points2D().size());
 }
 
 point2D_t Image::NumPoints3D() const { return num_points3D_; }
@@ -291,6 +316,10 @@ void Image::SetNumCorrespondences(const point2D_t num_correspondences) {
 
 point2D_t Image::NumVisiblePoints3D() const { return num_visible_points3D_; }
 
+const std::vector<point2D_t>& Image::VisiblePoints2D() const {
+  return visible_point2D_idxs_;
+}
+
 size_t Image::Point3DVisibilityScore() const {
   return point3D_visibility_pyramid_.Score();
 }
@@ -344,14 +373,17 @@ inline bool Image::HasTvecPrior() const { return !IsNaN(tvec_prior_.sum()); }
 void Image::SetTvecPrior(const Eigen::Vector3d& tvec) { tvec_prior_ = tvec; }
 
 const class Point2D& Image::Point2D(const point2D_t point2D_idx) const {
-  return points2D_.at(point2D_idx);
+  return Points2D().at(point2D_idx);
 }
 
 class Point2D& Image::Point2D(const point2D_t point2D_idx) {
+  DetachPoints2D();
   return points2D_.at(point2D_idx);
 }
 
-const std::vector<class Point2D>& Image::Points2D() const { return points2D_; }
+const std::vector<class Point2D>& Image::Points2D() const {
+  return shared_points2D_ ? *shared_points2D_ : points2D_;
+}
 
 bool Image::IsPoint3DVisible(const point2D_t point2D_idx) const {
   return num_correspondences_have_point3D_.at(point2D_idx) > 0;
@@ -31,13 +31,32 @@
 
 #include "base/image_reader.h"
 
+#include <fstream>
+#include <sstream>
+
 #include "base/camera_models.h"
 #include "util/misc.h"
 
 namespace colmap {
+namespace {
+
+// Read the contents of the file or an empty string, if the file cannot be
+// read, in which case decoding the image fails.
+std::string ReadFileContents(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return "";
+  }
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+}  // namespace
 
 bool ImageReaderOptions::Check() const {
   CHECK_OPTION_GT(default_focal_length_factor, 0.0);
+  CHECK_OPTION_GE(num_prefetch_images, 0);
   CHECK_OPTION(ExistsCameraModelWithName(camera_model));
   const int model_id = CameraModelNameToId(camera_model);
   if (!camera_params.empty()) {
@@ -48,9 +67,17 @@ bool ImageReaderOptions::Check() const {
 }
 
 ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
-    : options_(options), database_(database), image_index_(0) {
+    : options_(options),
+      database_(database),
+      image_index_(0),
+      prefetch_index_(0),
+      has_peeked_image_data_(false) {
   CHECK(options_.Check());
 
+  if (options_.num_prefetch_images > 0) {
+    prefetch_thread_pool_.reset(new ThreadPool(options_.num_prefetch_images));
+  }
+
   // Ensure trailing slash, so that we can build the correct image name.
   options_.image_path =
       EnsureTrailingSlash(StringReplace(options_.image_path, "\\", "/"));
@@ -84,15 +111,28 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
 }
 
 ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
-                                      Bitmap* bitmap, Bitmap* mask) {
+                                      Bitmap* bitmap, Bitmap* mask,
+                                      const bool read_bitmap) {
   CHECK_NOTNULL(camera);
   CHECK_NOTNULL(image);
   CHECK_NOTNULL(bitmap);
 
-  image_index_ += 1;
-  CHECK_LE(image_index_, options_.image_list.size());
+  CHECK_LT(image_index_, options_.image_list.size());
 
-  const std::string image_path = options_.image_list.at(image_index_ - 1);
+  const std::string image_path = options_.image_list.at(image_index_);
+
+  // The contents of the current image are always taken, even if it is
+  // skipped, to keep the order of the images that are read ahead.
+  std::string image_data;
+  const bool read_from_memory = has_peeked_image_data_ || prefetch_thread_pool_;
+  if (has_peeked_image_data_) {
+    image_data = std::move(peeked_image_data_);
+    has_peeked_image_data_ = false;
+  } else if (prefetch_thread_pool_) {
+    image_data = ReadNextImageData();
+  }
+
+  image_index_ += 1;
 
   DatabaseTransaction database_transaction(database_);
 
@@ -129,15 +169,46 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
   // Read image.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!bitmap->Read(image_path, false)) {
+  // The bitmap from which the original image dimensions and EXIF data are
+  // read. If the image is decoded at reduced resolution, only the header of
+  // the image is read separately without decoding its pixels.
+  Bitmap header;
+  const Bitmap* metadata = bitmap;
+
+  const auto ReadHeader = [&](Bitmap* target) {
+    return read_from_memory ? target->ReadHeaderFromMemory(image_data)
+                            : target->ReadHeader(image_path);
+  };
+
+  const auto ReadBitmap = [&](Bitmap* target, const int max_size) {
+    return read_from_memory
+               ? target->ReadFromMemory(image_data, false, max_size)
+               : target->Read(image_path, false, max_size);
+  };
+
+  if (!read_bitmap) {
+    if (!ReadHeader(&header)) {
+      return Status::BITMAP_ERROR;
+    }
+    metadata = &header;
+  } else if (options_.max_image_size > 0) {
+    if (!ReadHeader(&header) ||
+        !ReadBitmap(bitmap, options_.max_image_size)) {
+      return Status::BITMAP_ERROR;
+    }
+    metadata = &header;
+  } else if (!ReadBitmap(bitmap, -1)) {
     return Status::BITMAP_ERROR;
   }
 
+  const size_t width = static_cast<size_t>(metadata->Width());
+  const size_t height = static_cast<size_t>(metadata->Height());
+
   //////////////////////////////////////////////////////////////////////////////
   // Read mask.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (mask && !options_.mask_path.empty()) {
+  if (mask && read_bitmap && !options_.mask_path.empty()) {
     const std::string mask_path =
         JoinPaths(options_.mask_path,
                   GetRelativePath(options_.image_path, image_path) + ".png");
@@ -160,8 +231,7 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
-    if (static_cast<size_t>(bitmap->Width()) != current_camera.Width() ||
-        static_cast<size_t>(bitmap->Height()) != current_camera.Height()) {
+    if (width != current_camera.Width() || height != current_camera.Height()) {
       return Status::CAMERA_EXIST_DIM_ERROR;
     }
 
@@ -176,8 +246,7 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
         ((options_.single_camera && !options_.single_camera_per_folder) ||
          (options_.single_camera_per_folder &&
           image_folder == prev_image_folder_)) &&
-        (prev_camera_.Width() != static_cast<size_t>(bitmap->Width()) ||
-         prev_camera_.Height() != static_cast<size_t>(bitmap->Height()))) {
+        (prev_camera_.Width() != width || prev_camera_.Height() != height)) {
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
@@ -194,20 +263,20 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
       if (options_.camera_params.empty()) {
         // Extract focal length.
         double focal_length = 0.0;
-        if (bitmap->ExifFocalLength(&focal_length)) {
+        if (metadata->ExifFocalLength(&focal_length)) {
           prev_camera_.SetPriorFocalLength(true);
         } else {
           focal_length = options_.default_focal_length_factor *
-                         std::max(bitmap->Width(), bitmap->Height());
+                         std::max(width, height);
           prev_camera_.SetPriorFocalLength(false);
         }
 
         prev_camera_.InitializeWithId(prev_camera_.ModelId(), focal_length,
-                                      bitmap->Width(), bitmap->Height());
+                                      width, height);
       }
 
-      prev_camera_.SetWidth(static_cast<size_t>(bitmap->Width()));
-      prev_camera_.SetHeight(static_cast<size_t>(bitmap->Height()));
+      prev_camera_.SetWidth(width);
+      prev_camera_.SetHeight(height);
 
       if (!prev_camera_.VerifyParams()) {
         return Status::CAMERA_PARAM_ERROR;
@@ -222,9 +291,9 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
     // Extract GPS data.
     //////////////////////////////////////////////////////////////////////////////
 
-    if (!bitmap->ExifLatitude(&image->TvecPrior(0)) ||
-        !bitmap->ExifLongitude(&image->TvecPrior(1)) ||
-        !bitmap->ExifAltitude(&image->TvecPrior(2))) {
+    if (!metadata->ExifLatitude(&image->TvecPrior(0)) ||
+        !metadata->ExifLongitude(&image->TvecPrior(1)) ||
+        !metadata->ExifAltitude(&image->TvecPrior(2))) {
       image->TvecPrior().setConstant(std::numeric_limits<double>::quiet_NaN());
     }
   }
@@ -237,8 +306,39 @@ ImageReader::Status ImageReader::Next(Camera* camera, Image* image,
   return Status::SUCCESS;
 }
 
+const std::string& ImageReader::PeekImageData() {
+  CHECK_LT(image_index_, options_.image_list.size());
+  if (!has_peeked_image_data_) {
+    peeked_image_data_ = ReadNextImageData();
+    has_peeked_image_data_ = true;
+  }
+  return peeked_image_data_;
+}
+
 size_t ImageReader::NextIndex() const { return image_index_; }
 
 size_t ImageReader::NumImages() const { return options_.image_list.size(); }
 
+void ImageReader::AddImage(const std::string& image_name) {
+  options_.image_list.push_back(JoinPaths(options_.image_path, image_name));
+}
+
+std::string ImageReader::ReadNextImageData() {
+  if (!prefetch_thread_pool_) {
+    return ReadFileContents(options_.image_list.at(image_index_));
+  }
+
+  // Read the files of the following images ahead.
+  while (prefetch_index_ < options_.image_list.size() &&
+         prefetch_index_ <= image_index_ + options_.num_prefetch_images) {
+    prefetched_images_.push_back(prefetch_thread_pool_->AddTask(
+        ReadFileContents, options_.image_list[prefetch_index_]));
+    prefetch_index_ += 1;
+  }
+
+  std::string image_data = prefetched_images_.front().get();
+  prefetched_images_.pop_front();
+  return image_data;
+}
+
 }  // namespace colmap
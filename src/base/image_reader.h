@@ -32,6 +32,9 @@
 #ifndef COLMAP_SRC_BASE_IMAGE_READER_H_
 #define COLMAP_SRC_BASE_IMAGE_READER_H_
 
+#include <deque>
+#include <future>
+#include <memory>
 #include <unordered_set>
 
 #include "base/database.h"
@@ -82,11 +85,24 @@ struct ImageReaderOptions {
   // value `default_focal_length_factor * max(width, height)`.
   double default_focal_length_factor = 1.2;
   
+  // If positive, JPEG images are decoded directly at a reduced resolution,
+  // such that their larger dimension is not smaller than this value. The
+  // camera and its EXIF focal length prior are always determined at the
+  // original resolution, i.e., the bitmap can be smaller than the camera.
+  int max_image_size = -1;
+
   // Optional path to an image file specifying a mask for all images. No
   // features will be extracted in regions where the mask is black (pixel
   // intensity value 0 in grayscale).
   std::string camera_mask_path = "";
 
+  // Number of images after the current image, whose files are read ahead in
+  // parallel in the order of traversal, while the current image is decoded.
+  // The images are decoded from memory. This hides the latency of remote file
+  // systems, e.g., object storage mounted through FUSE, where each file is
+  // read with many sequential requests. Zero disables reading ahead.
+  int num_prefetch_images = 0;
+
   bool Check() const;
 };
 
@@ -107,11 +123,28 @@ class ImageReader {
 
   ImageReader(const ImageReaderOptions& options, Database* database);
 
-  Status Next(Camera* camera, Image* image, Bitmap* bitmap, Bitmap* mask);
+  // Read the next image. If `read_bitmap` is false, only the header of the
+  // image is read to determine its camera, while the bitmap and the mask are
+  // not read, e.g., if the features of the image are already known.
+  Status Next(Camera* camera, Image* image, Bitmap* bitmap, Bitmap* mask,
+              const bool read_bitmap = true);
+
+  // Read the contents of the file of the next image without decoding them,
+  // e.g., to identify the image by its contents before it is decoded. The
+  // contents are reused by the following call to `Next`.
+  const std::string& PeekImageData();
+
   size_t NextIndex() const;
   size_t NumImages() const;
 
+  // Append an image to the images to read, e.g., for images that only arrive
+  // in the image path while reading. The name is relative to the image path.
+  void AddImage(const std::string& image_name);
+
  private:
+  // Read the contents of the file of the next image, possibly read ahead.
+  std::string ReadNextImageData();
+
   // Image reader options.
   ImageReaderOptions options_;
   Database* database_;
@@ -122,6 +155,14 @@ class ImageReader {
   // Names of image sub-folders.
   std::string prev_image_folder_;
   std::unordered_set<std::string> image_folders_;
+  // File contents of the images that are read ahead, starting at the current
+  // image, and the index of the next image to read ahead.
+  std::unique_ptr<ThreadPool> prefetch_thread_pool_;
+  std::deque<std::future<std::string>> prefetched_images_;
+  size_t prefetch_index_;
+  // File contents of the next image, if they were read by `PeekImageData`.
+  std::string peeked_image_data_;
+  bool has_peeked_image_data_;
 };
 
 }  // namespace colmap
@@ -32,6 +32,8 @@
 #define TEST_NAME "base/image"
 #include "util/testing.h"
 
+#include <algorithm>
+
 #include "base/image.h"
 
 using namespace colmap;
@@ -154,6 +156,39 @@ BOOST_AUTO_TEST_CASE(TestNumVisiblePoints3D) {
   BOOST_CHECK_EQUAL(image.NumVisiblePoints3D(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestVisiblePoints2D) {
+  Image image;
+  image.SetPoints2D(std::vector<Eigen::Vector2d>(10));
+  image.SetNumObservations(10);
+  Camera camera;
+  camera.SetWidth(10);
+  camera.SetHeight(10);
+  image.SetUp(camera);
+  BOOST_CHECK(image.VisiblePoints2D().empty());
+  image.IncrementCorrespondenceHasPoint3D(3);
+  image.IncrementCorrespondenceHasPoint3D(3);
+  image.IncrementCorrespondenceHasPoint3D(5);
+  image.IncrementCorrespondenceHasPoint3D(7);
+  BOOST_CHECK_EQUAL(image.VisiblePoints2D().size(), 3);
+  image.DecrementCorrespondenceHasPoint3D(3);
+  BOOST_CHECK_EQUAL(image.VisiblePoints2D().size(), 3);
+  image.DecrementCorrespondenceHasPoint3D(3);
+  std::vector<point2D_t> visible_point2D_idxs = image.VisiblePoints2D();
+  std::sort(visible_point2D_idxs.begin(), visible_point2D_idxs.end());
+  BOOST_CHECK_EQUAL(visible_point2D_idxs.size(), 2);
+  BOOST_CHECK_EQUAL(visible_point2D_idxs[0], 5);
+  BOOST_CHECK_EQUAL(visible_point2D_idxs[1], 7);
+
+  // The visible points are restored after setting up the image again.
+  image.TearDown();
+  BOOST_CHECK(image.VisiblePoints2D().empty());
+  image.SetUp(camera);
+  BOOST_CHECK_EQUAL(image.VisiblePoints2D().size(), 2);
+  image.DecrementCorrespondenceHasPoint3D(7);
+  BOOST_CHECK_EQUAL(image.VisiblePoints2D().size(), 1);
+  BOOST_CHECK_EQUAL(image.VisiblePoints2D()[0], 5);
+}
+
 BOOST_AUTO_TEST_CASE(TestPoint3DVisibilityScore) {
   Image image;
   std::vector<Eigen::Vector2d> points2D;
@@ -290,6 +325,29 @@ BOOST_AUTO_TEST_CASE(TestPoints2D) {
   BOOST_CHECK_EQUAL(image.Point2D(0).Y(), 2.0);
 }
 
+BOOST_AUTO_TEST_CASE(TestSharePoints2D) {
+  Image image;
+  std::vector<Eigen::Vector2d> points2D(2);
+  points2D[0] = Eigen::Vector2d(1.0, 2.0);
+  image.SetPoints2D(points2D);
+  image.SharePoints2D();
+  BOOST_CHECK_EQUAL(image.NumPoints2D(), 2);
+  Image image_copy = image;
+  const Image& const_image = image;
+  const Image& const_image_copy = image_copy;
+  BOOST_CHECK_EQUAL(&const_image.Points2D(), &const_image_copy.Points2D());
+  image_copy.SetPoint3DForPoint2D(0, 1);
+  BOOST_CHECK_NE(&const_image.Points2D(), &const_image_copy.Points2D());
+  BOOST_CHECK(!const_image.Point2D(0).HasPoint3D());
+  BOOST_CHECK(const_image_copy.Point2D(0).HasPoint3D());
+  BOOST_CHECK_EQUAL(const_image_copy.Point2D(0).X(), 1.0);
+  BOOST_CHECK_EQUAL(const_image_copy.Point2D(0).Y(), 2.0);
+  Image image_copy2 = image;
+  image_copy2.DetachPoints2D();
+  BOOST_CHECK_NE(&const_image.Points2D(), &image_copy2.Points2D());
+  BOOST_CHECK_EQUAL(image_copy2.NumPoints2D(), 2);
+}
+
 BOOST_AUTO_TEST_CASE(TestPoint3D) {
   Image image;
   image.SetPoints2D(std::vector<Eigen::Vector2d>(2));
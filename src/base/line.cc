@@ -31,6 +31,8 @@
 
 #include "base/line.h"
 
+#include <algorithm>
+
 #include "util/logging.h"
 
 extern "C" {
@@ -43,16 +45,20 @@ std::vector<LineSegment> DetectLineSegments(const Bitmap& bitmap,
                                             const double min_length) {
   const double min_length_squared = min_length * min_length;
 
-  std::vector<uint8_t> bitmap_data;
-  if (bitmap.IsGrey()) {
-    bitmap_data = bitmap.ConvertToRowMajorArray();
-  } else {
-    const Bitmap bitmap_gray = bitmap.CloneAsGrey();
-    bitmap_data = bitmap_gray.ConvertToRowMajorArray();
+  Bitmap bitmap_gray_clone;
+  if (!bitmap.IsGrey()) {
+    bitmap_gray_clone = bitmap.CloneAsGrey();
   }
+  const Bitmap& bitmap_gray = bitmap.IsGrey() ? bitmap : bitmap_gray_clone;
 
-  std::vector<double> bitmap_data_double(bitmap_data.begin(),
-                                         bitmap_data.end());
+  // Convert the scanlines directly to avoid an intermediate copy of the image.
+  std::vector<double> bitmap_data_double(
+      static_cast<size_t>(bitmap.Width()) * bitmap.Height());
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    const uint8_t* line = bitmap_gray.GetScanline(y);
+    std::copy(line, line + bitmap.Width(),
+              bitmap_data_double.begin() + y * bitmap.Width());
+  }
 
   int num_segments;
   std::unique_ptr<double> segments_data(lsd(&num_segments,
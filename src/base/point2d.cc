@@ -33,7 +33,13 @@
 
 namespace colmap {
 
+#ifdef COMPACT_POINT2D_ENABLED
+const uint32_t Point2D::kInvalidCompactPoint3DId;
+
+Point2D::Point2D() : x_(0), y_(0), point3D_id_(kInvalidCompactPoint3DId) {}
+#else
 Point2D::Point2D()
     : xy_(Eigen::Vector2d::Zero()), point3D_id_(kInvalidPoint3DId) {}
+#endif
 
 }  // namespace colmap
@@ -32,15 +32,22 @@
 #ifndef COLMAP_SRC_BASE_POINT2D_H_
 #define COLMAP_SRC_BASE_POINT2D_H_
 
+#include <limits>
+
 #include <Eigen/Core>
 
 #include "util/alignment.h"
+#include "util/logging.h"
 #include "util/types.h"
 
 namespace colmap {
 
 // 2D point class corresponds to a feature in an image. It may or may not have a
-// corresponding 3D point if it is part of a triangulated track.
+// corresponding 3D point if it is part of a triangulated track. If compiled with
+// COMPACT_POINT2D_ENABLED, the coordinates are stored in single precision and
+// the 3D point identifiers in 32 bits, which halves the memory of the 2D points
+// of large reconstructions. The coordinates of the feature keypoints are in
+// single precision anyway, so that only refined coordinates lose precision.
 class Point2D {
  public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -48,34 +55,79 @@ class Point2D {
   Point2D();
 
   // The coordinate in image space in pixels.
-  inline const Eigen::Vector2d& XY() const;
-  inline Eigen::Vector2d& XY();
+  inline Eigen::Vector2d XY() const;
   inline double X() const;
   inline double Y() const;
   inline void SetXY(const Eigen::Vector2d& xy);
 
   // The identifier of the observed 3D point. If the image point does not
-  // observe a 3D point, the identifier is `kInvalidPoint3Did`.
+  // observe a 3D point, the identifier is `kInvalidPoint3Did`. In the compact
+  // mode, the identifiers must be smaller than 2^32 - 1.
   inline point3D_t Point3DId() const;
   inline bool HasPoint3D() const;
   inline void SetPoint3DId(const point3D_t point3D_id);
 
  private:
+#ifdef COMPACT_POINT2D_ENABLED
+  // The invalid 3D point identifier in compact storage.
+  const static uint32_t kInvalidCompactPoint3DId =
+      std::numeric_limits<uint32_t>::max();
+
+  // The image coordinates in pixels, starting at upper left corner with 0.
+  float x_;
+  float y_;
+
+  // The identifier of the 3D point, which is `kInvalidCompactPoint3DId` if the
+  // 2D point is not part of a 3D point track.
+  uint32_t point3D_id_;
+#else
   // The image coordinates in pixels, starting at upper left corner with 0.
   Eigen::Vector2d xy_;
 
   // The identifier of the 3D point. If the 2D point is not part of a 3D point
   // track the identifier is `kInvalidPoint3DId` and `HasPoint3D() = false`.
   point3D_t point3D_id_;
+#endif
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-const Eigen::Vector2d& Point2D::XY() const { return xy_; }
+#ifdef COMPACT_POINT2D_ENABLED
+
+Eigen::Vector2d Point2D::XY() const { return Eigen::Vector2d(x_, y_); }
+
+double Point2D::X() const { return x_; }
+
+double Point2D::Y() const { return y_; }
+
+void Point2D::SetXY(const Eigen::Vector2d& xy) {
+  x_ = static_cast<float>(xy.x());
+  y_ = static_cast<float>(xy.y());
+}
+
+point3D_t Point2D::Point3DId() const {
+  return point3D_id_ == kInvalidCompactPoint3DId ? kInvalidPoint3DId
+                                                 : point3D_id_;
+}
 
-Eigen::Vector2d& Point2D::XY() { return xy_; }
+bool Point2D::HasPoint3D() const {
+  return point3D_id_ != kInvalidCompactPoint3DId;
+}
+
+void Point2D::SetPoint3DId(const point3D_t point3D_id) {
+  if (point3D_id == kInvalidPoint3DId) {
+    point3D_id_ = kInvalidCompactPoint3DId;
+  } else {
+    CHECK_LT(point3D_id, kInvalidCompactPoint3DId);
+    point3D_id_ = static_cast<uint32_t>(point3D_id);
+  }
+}
+
+#else
+
+Eigen::Vector2d Point2D::XY() const { return xy_; }
 
 double Point2D::X() const { return xy_.x(); }
 
@@ -91,6 +143,8 @@ void Point2D::SetPoint3DId(const point3D_t point3D_id) {
   point3D_id_ = point3D_id;
 }
 
+#endif
+
 }  // namespace colmap
 
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION_CUSTOM(colmap::Point2D)
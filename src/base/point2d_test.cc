@@ -53,8 +53,13 @@ BOOST_AUTO_TEST_CASE(TestXY) {
   BOOST_CHECK_EQUAL(point2D.XY()[0], point2D.X());
   BOOST_CHECK_EQUAL(point2D.XY()[1], point2D.Y());
   point2D.SetXY(Eigen::Vector2d(0.1, 0.2));
+#ifdef COMPACT_POINT2D_ENABLED
+  BOOST_CHECK_EQUAL(point2D.X(), 0.1f);
+  BOOST_CHECK_EQUAL(point2D.Y(), 0.2f);
+#else
   BOOST_CHECK_EQUAL(point2D.X(), 0.1);
   BOOST_CHECK_EQUAL(point2D.Y(), 0.2);
+#endif
   BOOST_CHECK_EQUAL(point2D.XY()[0], point2D.X());
   BOOST_CHECK_EQUAL(point2D.XY()[1], point2D.Y());
 }
@@ -69,4 +74,8 @@ BOOST_AUTO_TEST_CASE(TestPoint3DId) {
   point2D.SetPoint3DId(kInvalidPoint3DId);
   BOOST_CHECK_EQUAL(point2D.Point3DId(), kInvalidPoint3DId);
   BOOST_CHECK_EQUAL(point2D.HasPoint3D(), false);
+  point2D.SetPoint3DId(std::numeric_limits<uint32_t>::max() - 1);
+  BOOST_CHECK_EQUAL(point2D.Point3DId(),
+                    std::numeric_limits<uint32_t>::max() - 1);
+  BOOST_CHECK_EQUAL(point2D.HasPoint3D(), true);
 }
@@ -0,0 +1,133 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "base/point3d_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/logging.h"
+
+namespace colmap {
+namespace {
+
+// Number of bits per voxel coordinate in the folded voxel key.
+const int kNumVoxelKeyBits = 21;
+
+}  // namespace
+
+Point3DIndex::Point3DIndex() : Point3DIndex(0) {}
+
+Point3DIndex::Point3DIndex(const double voxel_size)
+    : voxel_size_(voxel_size) {}
+
+void Point3DIndex::Update(const point3D_t point3D_id,
+                          const Eigen::Vector3d& xyz) {
+  CHECK(IsEnabled());
+
+  const uint64_t key = VoxelKey(xyz);
+  const auto point_voxel = point_voxels_.emplace(point3D_id, key);
+  if (!point_voxel.second) {
+    if (point_voxel.first->second == key) {
+      return;
+    }
+    Remove(point3D_id);
+    point_voxels_.emplace(point3D_id, key);
+  }
+
+  voxels_[key].push_back(point3D_id);
+}
+
+void Point3DIndex::Remove(const point3D_t point3D_id) {
+  const auto point_voxel = point_voxels_.find(point3D_id);
+  if (point_voxel == point_voxels_.end()) {
+    return;
+  }
+
+  const auto voxel = voxels_.find(point_voxel->second);
+  auto& point3D_ids = voxel->second;
+  const auto it = std::find(point3D_ids.begin(), point3D_ids.end(), point3D_id);
+  *it = point3D_ids.back();
+  point3D_ids.pop_back();
+  if (point3D_ids.empty()) {
+    voxels_.erase(voxel);
+  }
+
+  point_voxels_.erase(point_voxel);
+}
+
+void Point3DIndex::Clear() {
+  voxels_.clear();
+  point_voxels_.clear();
+}
+
+std::vector<point3D_t> Point3DIndex::FindCandidates(
+    const Eigen::Vector3d& xyz, const double radius) const {
+  CHECK(IsEnabled());
+  CHECK_GE(radius, 0);
+
+  const Eigen::Vector3d min_xyz = (xyz.array() - radius) / voxel_size_;
+  const Eigen::Vector3d max_xyz = (xyz.array() + radius) / voxel_size_;
+
+  std::vector<point3D_t> point3D_ids;
+  for (int64_t x = std::floor(min_xyz(0)); x <= std::floor(max_xyz(0)); ++x) {
+    for (int64_t y = std::floor(min_xyz(1)); y <= std::floor(max_xyz(1));
+         ++y) {
+      for (int64_t z = std::floor(min_xyz(2)); z <= std::floor(max_xyz(2));
+           ++z) {
+        const auto voxel = voxels_.find(VoxelKey(x, y, z));
+        if (voxel != voxels_.end()) {
+          point3D_ids.insert(point3D_ids.end(), voxel->second.begin(),
+                             voxel->second.end());
+        }
+      }
+    }
+  }
+
+  return point3D_ids;
+}
+
+uint64_t Point3DIndex::VoxelKey(const Eigen::Vector3d& xyz) const {
+  return VoxelKey(static_cast<int64_t>(std::floor(xyz(0) / voxel_size_)),
+                  static_cast<int64_t>(std::floor(xyz(1) / voxel_size_)),
+                  static_cast<int64_t>(std::floor(xyz(2) / voxel_size_)));
+}
+
+uint64_t Point3DIndex::VoxelKey(const int64_t x, const int64_t y,
+                                const int64_t z) const {
+  const uint64_t kMask = (uint64_t(1) << kNumVoxelKeyBits) - 1;
+  return ((static_cast<uint64_t>(x) & kMask) << (2 * kNumVoxelKeyBits)) |
+         ((static_cast<uint64_t>(y) & kMask) << kNumVoxelKeyBits) |
+         (static_cast<uint64_t>(z) & kMask);
+}
+
+}  // namespace colmap
@@ -0,0 +1,96 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_BASE_POINT3D_INDEX_H_
+#define COLMAP_SRC_BASE_POINT3D_INDEX_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "util/types.h"
+
+namespace colmap {
+
+// Voxel hash over the positions of 3D points for fast radius queries. Each
+// point is stored in the voxel that contains its position, so that a query
+// only visits the voxels overlapping the bounding box of the query sphere.
+// The voxel coordinates are folded into a 64-bit key, i.e. for very large
+// extents points in distant voxels may share a bucket, which is why queries
+// only return candidates and the caller checks the actual distances.
+class Point3DIndex {
+ public:
+  Point3DIndex();
+
+  // A non-positive voxel size disables the index.
+  explicit Point3DIndex(const double voxel_size);
+
+  inline double VoxelSize() const;
+  inline bool IsEnabled() const;
+  inline size_t NumPoints() const;
+
+  // Insert a new point or move an existing point to the given position.
+  void Update(const point3D_t point3D_id, const Eigen::Vector3d& xyz);
+
+  // Remove a point, if it exists in the index.
+  void Remove(const point3D_t point3D_id);
+
+  void Clear();
+
+  // Find the points in the voxels overlapping the cube of side length
+  // `2 * radius` centered at `xyz`.
+  std::vector<point3D_t> FindCandidates(const Eigen::Vector3d& xyz,
+                                        const double radius) const;
+
+ private:
+  uint64_t VoxelKey(const Eigen::Vector3d& xyz) const;
+  uint64_t VoxelKey(const int64_t x, const int64_t y, const int64_t z) const;
+
+  double voxel_size_;
+  std::unordered_map<uint64_t, std::vector<point3D_t>> voxels_;
+  std::unordered_map<point3D_t, uint64_t> point_voxels_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+double Point3DIndex::VoxelSize() const { return voxel_size_; }
+
+bool Point3DIndex::IsEnabled() const { return voxel_size_ > 0; }
+
+size_t Point3DIndex::NumPoints() const { return point_voxels_.size(); }
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_BASE_POINT3D_INDEX_H_
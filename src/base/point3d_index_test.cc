@@ -0,0 +1,92 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "base/point3d_index"
+#include "util/testing.h"
+
+#include <algorithm>
+
+#include "base/point3d_index.h"
+
+using namespace colmap;
+
+namespace {
+
+bool HasCandidate(const Point3DIndex& index, const Eigen::Vector3d& xyz,
+                  const double radius, const point3D_t point3D_id) {
+  const auto candidates = index.FindCandidates(xyz, radius);
+  return std::find(candidates.begin(), candidates.end(), point3D_id) !=
+         candidates.end();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestDefault) {
+  Point3DIndex index;
+  BOOST_CHECK(!index.IsEnabled());
+  BOOST_CHECK_EQUAL(index.VoxelSize(), 0);
+  BOOST_CHECK_EQUAL(index.NumPoints(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestUpdateRemove) {
+  Point3DIndex index(1);
+  BOOST_CHECK(index.IsEnabled());
+  index.Update(1, Eigen::Vector3d(0.5, 0.5, 0.5));
+  index.Update(2, Eigen::Vector3d(0.6, 0.5, 0.5));
+  index.Update(3, Eigen::Vector3d(-0.5, 0.5, 0.5));
+  BOOST_CHECK_EQUAL(index.NumPoints(), 3);
+
+  BOOST_CHECK_EQUAL(index.FindCandidates(Eigen::Vector3d(0.5, 0.5, 0.5), 0.1)
+                        .size(),
+                    2);
+  BOOST_CHECK(HasCandidate(index, Eigen::Vector3d(0.5, 0.5, 0.5), 0.1, 1));
+  BOOST_CHECK(HasCandidate(index, Eigen::Vector3d(0.5, 0.5, 0.5), 0.1, 2));
+  BOOST_CHECK(!HasCandidate(index, Eigen::Vector3d(0.5, 0.5, 0.5), 0.1, 3));
+  BOOST_CHECK(HasCandidate(index, Eigen::Vector3d(0.05, 0.5, 0.5), 0.1, 3));
+  BOOST_CHECK(
+      !HasCandidate(index, Eigen::Vector3d(10.5, 10.5, 10.5), 1.0, 1));
+
+  index.Update(1, Eigen::Vector3d(10.5, 10.5, 10.5));
+  BOOST_CHECK_EQUAL(index.NumPoints(), 3);
+  BOOST_CHECK(HasCandidate(index, Eigen::Vector3d(10.5, 10.5, 10.5), 0.1, 1));
+  BOOST_CHECK(!HasCandidate(index, Eigen::Vector3d(0.5, 0.5, 0.5), 0.1, 1));
+
+  index.Remove(2);
+  index.Remove(4);
+  BOOST_CHECK_EQUAL(index.NumPoints(), 2);
+  BOOST_CHECK(!HasCandidate(index, Eigen::Vector3d(0.5, 0.5, 0.5), 0.1, 2));
+
+  index.Clear();
+  BOOST_CHECK_EQUAL(index.NumPoints(), 0);
+  BOOST_CHECK(index.FindCandidates(Eigen::Vector3d(10.5, 10.5, 10.5), 1.0)
+                  .empty());
+}
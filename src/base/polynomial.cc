@@ -34,6 +34,7 @@
 #include <Eigen/Eigenvalues>
 
 #include "util/logging.h"
+#include "util/math.h"
 
 namespace colmap {
 namespace {
@@ -60,6 +61,40 @@ Eigen::VectorXd RemoveTrailingZeros(const Eigen::VectorXd& coeffs) {
   return coeffs.head(coeffs.size() - num_zeros);
 }
 
+// Find the largest real root of the cubic x^3 + a * x^2 + b * x + c = 0.
+double FindLargestRealCubicRoot(const double a, const double b,
+                                const double c) {
+  const double a2 = a * a;
+  const double Q = (a2 - 3 * b) / 9;
+  const double R = (a * (2 * a2 - 9 * b) + 27 * c) / 54;
+  const double Q3 = Q * Q * Q;
+
+  double x;
+  if (R * R < Q3) {
+    // Three real roots, of which the largest is the second one of the
+    // trigonometric solution.
+    const double theta = std::acos(R / std::sqrt(Q3));
+    x = -2 * std::sqrt(Q) * std::cos((theta + 2 * M_PI) / 3) - a / 3;
+  } else {
+    const double A =
+        -std::copysign(std::cbrt(std::abs(R) + std::sqrt(R * R - Q3)), R);
+    const double B = A == 0 ? 0 : Q / A;
+    x = A + B - a / 3;
+  }
+
+  // Polish the root, since the closed form solution is prone to cancellation.
+  for (int i = 0; i < 2; ++i) {
+    const double f = ((x + a) * x + b) * x + c;
+    const double df = (3 * x + 2 * a) * x + b;
+    if (df == 0) {
+      break;
+    }
+    x -= f / df;
+  }
+
+  return x;
+}
+
 }  // namespace
 
 bool FindLinearPolynomialRoots(const Eigen::VectorXd& coeffs,
@@ -274,4 +309,85 @@ bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs_all,
   return true;
 }
 
+bool FindQuarticPolynomialRealRoots(const Eigen::Matrix<double, 5, 1>& coeffs,
+                                    double roots[4], int* num_roots) {
+  *num_roots = 0;
+  if (coeffs(0) == 0) {
+    return false;
+  }
+
+  // Normalize to x^4 + b * x^3 + c * x^2 + d * x + e = 0 and substitute
+  // x = y - b / 4 to obtain the depressed quartic y^4 + p * y^2 + q * y + r.
+  const double b = coeffs(1) / coeffs(0);
+  const double c = coeffs(2) / coeffs(0);
+  const double d = coeffs(3) / coeffs(0);
+  const double e = coeffs(4) / coeffs(0);
+  const double b2 = b * b;
+  const double p = c - 3 * b2 / 8;
+  const double q = b * (b2 / 8 - c / 2) + d;
+  const double r = b * (b * (c / 16 - 3 * b2 / 256) - d / 4) + e;
+
+  // Tolerance for negative discriminants caused by rounding errors, such that
+  // double roots are not lost.
+  const double kEps = 1e-12;
+
+  double y[4];
+  int num_y = 0;
+  const double scale = std::abs(p) + std::sqrt(std::abs(r));
+  if (std::abs(q) <= kEps * scale * std::sqrt(scale)) {
+    // Biquadratic equation in y^2.
+    double disc = p * p - 4 * r;
+    if (disc < 0 && disc > -kEps * p * p) {
+      disc = 0;
+    }
+    if (disc >= 0) {
+      const double sqrt_disc = std::sqrt(disc);
+      for (const double y2 : {(-p + sqrt_disc) / 2, (-p - sqrt_disc) / 2}) {
+        if (y2 >= 0) {
+          y[num_y++] = std::sqrt(y2);
+          y[num_y++] = -std::sqrt(y2);
+        } else if (y2 > -kEps * scale) {
+          y[num_y++] = 0;
+        }
+      }
+    }
+  } else {
+    // Ferrari's method with m as positive root of the resolvent cubic
+    // 8 * m^3 + 8 * p * m^2 + (2 * p^2 - 8 * r) * m - q^2 = 0, which factors
+    // the quartic into two quadratics (y^2 +- sqrt(2m) y + ...).
+    const double m =
+        FindLargestRealCubicRoot(p, p * p / 4 - r, -q * q / 8);
+    if (m > 0) {
+      const double sqrt_2m = std::sqrt(2 * m);
+      for (const double sign : {1.0, -1.0}) {
+        double disc = -(2 * p + 2 * m + sign * 2 * q / sqrt_2m);
+        if (disc < 0 && disc > -kEps * (std::abs(p) + m)) {
+          disc = 0;
+        }
+        if (disc >= 0) {
+          const double sqrt_disc = std::sqrt(disc);
+          y[num_y++] = (sign * sqrt_2m + sqrt_disc) / 2;
+          y[num_y++] = (sign * sqrt_2m - sqrt_disc) / 2;
+        }
+      }
+    }
+  }
+
+  for (int i = 0; i < num_y; ++i) {
+    // Polish the roots in the original, normalized polynomial.
+    double x = y[i] - b / 4;
+    for (int j = 0; j < 2; ++j) {
+      const double f = (((x + b) * x + c) * x + d) * x + e;
+      const double df = ((4 * x + 3 * b) * x + 2 * c) * x + d;
+      if (df == 0) {
+        break;
+      }
+      x -= f / df;
+    }
+    roots[(*num_roots)++] = x;
+  }
+
+  return true;
+}
+
 }  // namespace colmap
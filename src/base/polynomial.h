@@ -83,6 +83,18 @@ bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs,
                                         Eigen::VectorXd* real,
                                         Eigen::VectorXd* imag);
 
+// Find the real roots of polynomials of the form:
+//
+//    a * x^4 + b * x^3 + c * x^2 + d * x + e = 0
+//
+// in closed form using Ferrari's method, followed by Newton iterations to
+// polish the roots. This is much faster than the companion matrix method and
+// does not allocate any memory, e.g., for minimal solvers inside RANSAC.
+// Multiple roots may be reported multiple times. Returns false if the leading
+// coefficient is zero, in which case the general methods should be used.
+bool FindQuarticPolynomialRealRoots(const Eigen::Matrix<double, 5, 1>& coeffs,
+                                    double roots[4], int* num_roots);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -182,3 +182,58 @@ BOOST_AUTO_TEST_CASE(TestFindPolynomialRootsCompanionMatrixZeroSolution) {
   ref_imag << 0, 0.651148, -0.651148, 0;
   BOOST_CHECK(imag.isApprox(ref_imag, 1e-6));
 }
+
+BOOST_AUTO_TEST_CASE(TestFindQuarticPolynomialRealRoots) {
+  double roots[4];
+  int num_roots;
+
+  BOOST_CHECK(!FindQuarticPolynomialRealRoots(
+      (Eigen::Matrix<double, 5, 1>() << 0, 1, 2, 3, 4).finished(), roots,
+      &num_roots));
+  BOOST_CHECK_EQUAL(num_roots, 0);
+
+  // No real roots.
+  Eigen::Matrix<double, 5, 1> coeffs;
+  coeffs << 10, -5, 3, -3, 1;
+  BOOST_CHECK(FindQuarticPolynomialRealRoots(coeffs, roots, &num_roots));
+  BOOST_CHECK_EQUAL(num_roots, 0);
+
+  // Two real roots.
+  coeffs << 10, -5, 3, -3, 0;
+  BOOST_CHECK(FindQuarticPolynomialRealRoots(coeffs, roots, &num_roots));
+  BOOST_CHECK_EQUAL(num_roots, 2);
+  std::sort(roots, roots + num_roots);
+  BOOST_CHECK_LT(std::abs(roots[0]), 1e-12);
+  BOOST_CHECK_LT(std::abs(roots[1] - 0.692438), 1e-6);
+
+  // Biquadratic with four real roots: (x^2 - 1) * (x^2 - 4).
+  coeffs << 2, 0, -10, 0, 8;
+  BOOST_CHECK(FindQuarticPolynomialRealRoots(coeffs, roots, &num_roots));
+  BOOST_CHECK_EQUAL(num_roots, 4);
+  std::sort(roots, roots + num_roots);
+  BOOST_CHECK_LT(std::abs(roots[0] + 2), 1e-12);
+  BOOST_CHECK_LT(std::abs(roots[1] + 1), 1e-12);
+  BOOST_CHECK_LT(std::abs(roots[2] - 1), 1e-12);
+  BOOST_CHECK_LT(std::abs(roots[3] - 2), 1e-12);
+
+  // Compare against the companion matrix method for random polynomials.
+  for (int i = 0; i < 1000; ++i) {
+    coeffs.setRandom();
+    Eigen::VectorXd real;
+    Eigen::VectorXd imag;
+    BOOST_CHECK(FindPolynomialRootsCompanionMatrix(coeffs, &real, &imag));
+    BOOST_CHECK(FindQuarticPolynomialRealRoots(coeffs, roots, &num_roots));
+    int num_ref_roots = 0;
+    for (Eigen::VectorXd::Index j = 0; j < real.size(); ++j) {
+      if (std::abs(imag(j)) < 1e-6) {
+        num_ref_roots += 1;
+        double min_dist = std::numeric_limits<double>::max();
+        for (int k = 0; k < num_roots; ++k) {
+          min_dist = std::min(min_dist, std::abs(roots[k] - real(j)));
+        }
+        BOOST_CHECK_LT(min_dist, 1e-6);
+      }
+    }
+    BOOST_CHECK_EQUAL(num_roots, num_ref_roots);
+  }
+}
@@ -31,6 +31,7 @@
 
 #include "base/reconstruction.h"
 
+#include <cstring>
 #include <fstream>
 
 #include "base/database_cache.h"
@@ -41,10 +42,500 @@
 #include "estimators/similarity_transform.h"
 #include "optim/loransac.h"
 #include "util/bitmap.h"
+#include "util/mapped_file.h"
 #include "util/misc.h"
+#include "util/octree_tiles.h"
 #include "util/ply.h"
+#include "util/threading.h"
 
 namespace colmap {
+namespace {
+
+// Marks the end of a complete checkpoint in a journal.
+const uint64_t kJournalCheckpointEnd = 0x544e494f504b4843;  // "CHKPOINT"
+
+// Number of 3D points evaluated per task when filtering 3D points.
+const size_t kFilterPoints3DChunkSize = 1024;
+
+// Number of 3D points of the other reconstruction classified per task when
+// merging two reconstructions.
+const size_t kMergePoints3DChunkSize = 1024;
+
+// A 3D point of another reconstruction to be merged, whose track is split
+// into the observations without and with a 3D point in this reconstruction.
+struct MergePoint3D {
+  const class Point3D* point3D = nullptr;
+  Eigen::Vector3d xyz;
+  class Track new_track;
+  class Track old_track;
+};
+
+// The records of the binary format, which are shared by the binary model and
+// the journal files.
+
+void WriteCameraBinary(const class Camera& camera, std::ostream* stream) {
+  WriteBinaryLittleEndian<camera_t>(stream, camera.CameraId());
+  WriteBinaryLittleEndian<int>(stream, camera.ModelId());
+  WriteBinaryLittleEndian<uint64_t>(stream, camera.Width());
+  WriteBinaryLittleEndian<uint64_t>(stream, camera.Height());
+  for (const double param : camera.Params()) {
+    WriteBinaryLittleEndian<double>(stream, param);
+  }
+}
+
+void WriteImageBinary(const class Image& image, std::ostream* stream) {
+  WriteBinaryLittleEndian<image_t>(stream, image.ImageId());
+
+  const Eigen::Vector4d normalized_qvec = NormalizeQuaternion(image.Qvec());
+  WriteBinaryLittleEndian<double>(stream, normalized_qvec(0));
+  WriteBinaryLittleEndian<double>(stream, normalized_qvec(1));
+  WriteBinaryLittleEndian<double>(stream, normalized_qvec(2));
+  WriteBinaryLittleEndian<double>(stream, normalized_qvec(3));
+
+  WriteBinaryLittleEndian<double>(stream, image.Tvec(0));
+  WriteBinaryLittleEndian<double>(stream, image.Tvec(1));
+  WriteBinaryLittleEndian<double>(stream, image.Tvec(2));
+
+  WriteBinaryLittleEndian<camera_t>(stream, image.CameraId());
+
+  const std::string name = image.Name() + '\0';
+  stream->write(name.c_str(), name.size());
+
+  WriteBinaryLittleEndian<uint64_t>(stream, image.NumPoints2D());
+  for (const Point2D& point2D : image.Points2D()) {
+    WriteBinaryLittleEndian<double>(stream, point2D.X());
+    WriteBinaryLittleEndian<double>(stream, point2D.Y());
+    WriteBinaryLittleEndian<point3D_t>(stream, point2D.Point3DId());
+  }
+}
+
+void WritePoint3DBinary(const point3D_t point3D_id,
+                        const class Point3D& point3D, std::ostream* stream) {
+  WriteBinaryLittleEndian<point3D_t>(stream, point3D_id);
+  WriteBinaryLittleEndian<double>(stream, point3D.XYZ()(0));
+  WriteBinaryLittleEndian<double>(stream, point3D.XYZ()(1));
+  WriteBinaryLittleEndian<double>(stream, point3D.XYZ()(2));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.Color(0));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.Color(1));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.Color(2));
+  WriteBinaryLittleEndian<double>(stream, point3D.Error());
+
+  WriteBinaryLittleEndian<uint64_t>(stream, point3D.Track().Length());
+  for (const auto& track_el : point3D.Track().Elements()) {
+    WriteBinaryLittleEndian<image_t>(stream, track_el.image_id);
+    WriteBinaryLittleEndian<point2D_t>(stream, track_el.point2D_idx);
+  }
+}
+
+// Returns false if the stream ended before the end of the record.
+bool ReadCameraBinary(std::istream* stream, class Camera* camera) {
+  const camera_t camera_id = ReadBinaryLittleEndian<camera_t>(stream);
+  const int model_id = ReadBinaryLittleEndian<int>(stream);
+  const uint64_t width = ReadBinaryLittleEndian<uint64_t>(stream);
+  const uint64_t height = ReadBinaryLittleEndian<uint64_t>(stream);
+  if (!*stream) {
+    return false;
+  }
+
+  camera->SetCameraId(camera_id);
+  camera->SetModelId(model_id);
+  camera->SetWidth(width);
+  camera->SetHeight(height);
+  ReadBinaryLittleEndian<double>(stream, &camera->Params());
+
+  return static_cast<bool>(*stream);
+}
+
+// Returns false if the stream ended before the end of the record. The image
+// must still be set up with its camera.
+bool ReadImageBinary(std::istream* stream, class Image* image) {
+  image->SetImageId(ReadBinaryLittleEndian<image_t>(stream));
+
+  image->Qvec(0) = ReadBinaryLittleEndian<double>(stream);
+  image->Qvec(1) = ReadBinaryLittleEndian<double>(stream);
+  image->Qvec(2) = ReadBinaryLittleEndian<double>(stream);
+  image->Qvec(3) = ReadBinaryLittleEndian<double>(stream);
+  image->NormalizeQvec();
+
+  image->Tvec(0) = ReadBinaryLittleEndian<double>(stream);
+  image->Tvec(1) = ReadBinaryLittleEndian<double>(stream);
+  image->Tvec(2) = ReadBinaryLittleEndian<double>(stream);
+
+  image->SetCameraId(ReadBinaryLittleEndian<camera_t>(stream));
+
+  char name_char;
+  do {
+    stream->read(&name_char, 1);
+    if (!*stream) {
+      return false;
+    }
+    if (name_char != '\0') {
+      image->Name() += name_char;
+    }
+  } while (name_char != '\0');
+
+  const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(stream);
+  if (!*stream) {
+    return false;
+  }
+
+  std::vector<Eigen::Vector2d> points2D;
+  points2D.reserve(num_points2D);
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(num_points2D);
+  for (size_t j = 0; j < num_points2D; ++j) {
+    const double x = ReadBinaryLittleEndian<double>(stream);
+    const double y = ReadBinaryLittleEndian<double>(stream);
+    points2D.emplace_back(x, y);
+    point3D_ids.push_back(ReadBinaryLittleEndian<point3D_t>(stream));
+  }
+  if (!*stream) {
+    return false;
+  }
+
+  image->SetPoints2D(points2D);
+
+  for (point2D_t point2D_idx = 0; point2D_idx < image->NumPoints2D();
+       ++point2D_idx) {
+    if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
+      image->SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
+    }
+  }
+
+  image->SetRegistered(true);
+
+  return true;
+}
+
+// Returns false if the stream ended before the end of the record.
+bool ReadPoint3DBinary(std::istream* stream, point3D_t* point3D_id,
+                       class Point3D* point3D) {
+  *point3D_id = ReadBinaryLittleEndian<point3D_t>(stream);
+
+  point3D->XYZ()(0) = ReadBinaryLittleEndian<double>(stream);
+  point3D->XYZ()(1) = ReadBinaryLittleEndian<double>(stream);
+  point3D->XYZ()(2) = ReadBinaryLittleEndian<double>(stream);
+  point3D->Color(0) = ReadBinaryLittleEndian<uint8_t>(stream);
+  point3D->Color(1) = ReadBinaryLittleEndian<uint8_t>(stream);
+  point3D->Color(2) = ReadBinaryLittleEndian<uint8_t>(stream);
+  point3D->SetError(ReadBinaryLittleEndian<double>(stream));
+
+  const size_t track_length = ReadBinaryLittleEndian<uint64_t>(stream);
+  if (!*stream) {
+    return false;
+  }
+
+  for (size_t j = 0; j < track_length; ++j) {
+    const image_t image_id = ReadBinaryLittleEndian<image_t>(stream);
+    const point2D_t point2D_idx = ReadBinaryLittleEndian<point2D_t>(stream);
+    point3D->Track().AddElement(image_id, point2D_idx);
+  }
+  point3D->Track().Compress();
+
+  return static_cast<bool>(*stream);
+}
+
+const size_t kBinaryPoint2DSize = 2 * sizeof(double) + sizeof(point3D_t);
+const size_t kBinaryTrackElementSize = sizeof(image_t) + sizeof(point2D_t);
+
+// The sizes of image and 3D point records without any 2D points, an empty
+// image name, and an empty track.
+const size_t kMinBinaryImageRecordSize = sizeof(image_t) + 7 * sizeof(double) +
+                                         sizeof(camera_t) + sizeof(char) +
+                                         sizeof(uint64_t);
+const size_t kMinBinaryPoint3DRecordSize =
+    sizeof(point3D_t) + 4 * sizeof(double) + 3 * sizeof(uint8_t) +
+    sizeof(uint64_t);
+
+// Reads the unaligned little endian records of a binary model file that is
+// mapped into memory.
+class BinaryRecordReader {
+ public:
+  BinaryRecordReader(const MappedFile& file, const size_t offset)
+      : file_(file), offset_(offset) {}
+
+  size_t Offset() const { return offset_; }
+
+  template <typename T>
+  T Read() {
+    T data_little_endian;
+    std::memcpy(&data_little_endian, Advance(sizeof(T)), sizeof(T));
+    return LittleEndianToNative(data_little_endian);
+  }
+
+  std::string ReadString() {
+    const char* begin = file_.Data() + offset_;
+    const void* end = std::memchr(begin, '\0', file_.Size() - offset_);
+    CHECK(end != nullptr) << "Unexpected end of file " << file_.Path();
+    const size_t length = static_cast<const char*>(end) - begin;
+    Advance(length + 1);
+    return std::string(begin, length);
+  }
+
+  void Skip(const size_t num_bytes) { Advance(num_bytes); }
+
+  void SkipArray(const size_t num_elements, const size_t element_size) {
+    CheckNumRecords(num_elements, element_size);
+    Advance(num_elements * element_size);
+  }
+
+  // Check that the remaining data can hold the given number of records of at
+  // least the given size, such that a corrupt count fails before any memory
+  // is allocated for the records.
+  void CheckNumRecords(const size_t num_records,
+                       const size_t min_record_size) const {
+    CHECK_LE(num_records, (file_.Size() - offset_) / min_record_size)
+        << "Unexpected end of file " << file_.Path();
+  }
+
+ private:
+  const char* Advance(const size_t num_bytes) {
+    CHECK_LE(num_bytes, file_.Size() - offset_)
+        << "Unexpected end of file " << file_.Path();
+    const char* data = file_.Data() + offset_;
+    offset_ += num_bytes;
+    return data;
+  }
+
+  const MappedFile& file_;
+  size_t offset_;
+};
+
+// The image record after the identifier. The image must still be set up with
+// its camera.
+void ReadImageBinary(BinaryRecordReader* reader, class Image* image) {
+  image->Qvec(0) = reader->Read<double>();
+  image->Qvec(1) = reader->Read<double>();
+  image->Qvec(2) = reader->Read<double>();
+  image->Qvec(3) = reader->Read<double>();
+  image->NormalizeQvec();
+
+  image->Tvec(0) = reader->Read<double>();
+  image->Tvec(1) = reader->Read<double>();
+  image->Tvec(2) = reader->Read<double>();
+
+  image->SetCameraId(reader->Read<camera_t>());
+  image->SetName(reader->ReadString());
+
+  const size_t num_points2D = reader->Read<uint64_t>();
+
+  std::vector<Eigen::Vector2d> points2D;
+  points2D.reserve(num_points2D);
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(num_points2D);
+  for (size_t j = 0; j < num_points2D; ++j) {
+    const double x = reader->Read<double>();
+    const double y = reader->Read<double>();
+    points2D.emplace_back(x, y);
+    point3D_ids.push_back(reader->Read<point3D_t>());
+  }
+
+  image->SetPoints2D(points2D);
+
+  for (point2D_t point2D_idx = 0; point2D_idx < image->NumPoints2D();
+       ++point2D_idx) {
+    if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
+      image->SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
+    }
+  }
+
+  image->SetRegistered(true);
+}
+
+// The 3D point record after the identifier.
+void ReadPoint3DBinary(BinaryRecordReader* reader, class Point3D* point3D) {
+  point3D->XYZ()(0) = reader->Read<double>();
+  point3D->XYZ()(1) = reader->Read<double>();
+  point3D->XYZ()(2) = reader->Read<double>();
+  point3D->Color(0) = reader->Read<uint8_t>();
+  point3D->Color(1) = reader->Read<uint8_t>();
+  point3D->Color(2) = reader->Read<uint8_t>();
+  point3D->SetError(reader->Read<double>());
+
+  const size_t track_length = reader->Read<uint64_t>();
+  point3D->Track().Reserve(track_length);
+  for (size_t j = 0; j < track_length; ++j) {
+    const image_t image_id = reader->Read<image_t>();
+    const point2D_t point2D_idx = reader->Read<point2D_t>();
+    point3D->Track().AddElement(image_id, point2D_idx);
+  }
+}
+
+// Parses the records at the given offsets of a mapped file in parallel. Each
+// record is parsed into the object that was already inserted for it.
+template <typename T, typename ParseFunc>
+void ParseRecordsParallel(const MappedFile& file,
+                          const std::vector<std::pair<size_t, T*>>& records,
+                          ParseFunc parse_func) {
+  const size_t kBlockSize = 4096;
+
+  const auto ParseBlock = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      BinaryRecordReader reader(file, records[i].first);
+      parse_func(&reader, records[i].second);
+    }
+  };
+
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, records.size(), ParseBlock,
+              ThreadPool::Schedule::DYNAMIC, kBlockSize);
+}
+
+// Returns the number of objects in the header of a text model file, such as
+// "# Number of points: 100, mean track length: 3.5", and zero for all other
+// lines.
+size_t ReadTextHeaderCount(const std::string& line,
+                           const std::string& header) {
+  if (!StringStartsWith(line, header)) {
+    return 0;
+  }
+  return std::strtoull(line.c_str() + header.size(), nullptr, 10);
+}
+
+// The location of an image record in a mapped binary images file.
+struct BinaryImageRecord {
+  image_t image_id = kInvalidImageId;
+  camera_t camera_id = kInvalidCameraId;
+  std::string name;
+  size_t begin = 0;
+  size_t points2D_begin = 0;
+  size_t num_points2D = 0;
+  size_t end = 0;
+
+  point3D_t Point3DId(const MappedFile& file, const size_t point2D_idx) const {
+    BinaryRecordReader reader(file, points2D_begin +
+                                        point2D_idx * kBinaryPoint2DSize +
+                                        2 * sizeof(double));
+    return reader.Read<point3D_t>();
+  }
+};
+
+// The location of a 3D point record in a mapped binary points3D file.
+struct BinaryPoint3DRecord {
+  point3D_t point3D_id = kInvalidPoint3DId;
+  size_t begin = 0;
+  size_t track_begin = 0;
+  size_t track_length = 0;
+  size_t end = 0;
+
+  image_t TrackImageId(const MappedFile& file, const size_t idx) const {
+    BinaryRecordReader reader(file,
+                              track_begin + idx * kBinaryTrackElementSize);
+    return reader.Read<image_t>();
+  }
+};
+
+template <typename Func>
+void ForEachBinaryImageRecord(const MappedFile& file, Func func) {
+  BinaryRecordReader reader(file, 0);
+  const size_t num_reg_images = reader.Read<uint64_t>();
+  reader.CheckNumRecords(num_reg_images, kMinBinaryImageRecordSize);
+  for (size_t i = 0; i < num_reg_images; ++i) {
+    BinaryImageRecord record;
+    record.begin = reader.Offset();
+    record.image_id = reader.Read<image_t>();
+    reader.Skip(7 * sizeof(double));
+    record.camera_id = reader.Read<camera_t>();
+    record.name = reader.ReadString();
+    record.num_points2D = reader.Read<uint64_t>();
+    record.points2D_begin = reader.Offset();
+    reader.SkipArray(record.num_points2D, kBinaryPoint2DSize);
+    record.end = reader.Offset();
+    func(record);
+  }
+}
+
+template <typename Func>
+void ForEachBinaryPoint3DRecord(const MappedFile& file, Func func) {
+  BinaryRecordReader reader(file, 0);
+  const size_t num_points3D = reader.Read<uint64_t>();
+  reader.CheckNumRecords(num_points3D, kMinBinaryPoint3DRecordSize);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    BinaryPoint3DRecord record;
+    record.begin = reader.Offset();
+    record.point3D_id = reader.Read<point3D_t>();
+    reader.Skip(4 * sizeof(double) + 3 * sizeof(uint8_t));
+    record.track_length = reader.Read<uint64_t>();
+    record.track_begin = reader.Offset();
+    reader.SkipArray(record.track_length, kBinaryTrackElementSize);
+    record.end = reader.Offset();
+    func(record);
+  }
+}
+
+// Find the 3D points that are deleted when de-registering the given images,
+// i.e. the 3D points with fewer than two observations in the other images.
+// If a stream is given, the remaining 3D points are written to it without
+// the observations in the given images.
+void FilterBinaryPoints3D(const MappedFile& file,
+                          const std::unordered_set<image_t>& image_ids,
+                          std::unordered_set<point3D_t>* deleted_point3D_ids,
+                          std::ostream* stream) {
+  uint64_t num_points3D = 0;
+  if (stream != nullptr) {
+    WriteBinaryLittleEndian<uint64_t>(stream, num_points3D);
+  }
+
+  std::vector<bool> deleted_track_els;
+  ForEachBinaryPoint3DRecord(file, [&](const BinaryPoint3DRecord& record) {
+    deleted_track_els.resize(record.track_length);
+    size_t num_deleted_track_els = 0;
+    for (size_t i = 0; i < record.track_length; ++i) {
+      deleted_track_els[i] = image_ids.count(record.TrackImageId(file, i)) > 0;
+      num_deleted_track_els += deleted_track_els[i];
+    }
+
+    if (num_deleted_track_els > 0 &&
+        record.track_length - num_deleted_track_els < 2) {
+      deleted_point3D_ids->insert(record.point3D_id);
+      return;
+    }
+
+    if (stream == nullptr) {
+      return;
+    }
+
+    num_points3D += 1;
+    if (num_deleted_track_els == 0) {
+      stream->write(file.Data() + record.begin, record.end - record.begin);
+      return;
+    }
+
+    const size_t track_length_begin = record.track_begin - sizeof(uint64_t);
+    stream->write(file.Data() + record.begin,
+                  track_length_begin - record.begin);
+    WriteBinaryLittleEndian<uint64_t>(
+        stream, record.track_length - num_deleted_track_els);
+    for (size_t i = 0; i < record.track_length; ++i) {
+      if (!deleted_track_els[i]) {
+        stream->write(
+            file.Data() + record.track_begin + i * kBinaryTrackElementSize,
+            kBinaryTrackElementSize);
+      }
+    }
+  });
+
+  if (stream != nullptr) {
+    stream->seekp(0);
+    WriteBinaryLittleEndian<uint64_t>(stream, num_points3D);
+    stream->seekp(0, std::ios::end);
+  }
+}
+
+// Write the binary model file through a temporary file, such that the input
+// and output file can be the same.
+template <typename WriteFunc>
+void WriteBinaryModelFile(const std::string& path, WriteFunc write_func) {
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::trunc | std::ios::binary);
+    CHECK(file.is_open()) << temp_path;
+    write_func(&file);
+    CHECK(file) << temp_path;
+  }
+  boost::filesystem::rename(temp_path, path);
+}
+
+}  // namespace
 
 Reconstruction::Reconstruction()
     : correspondence_graph_(nullptr), num_added_points3D_(0) {}
@@ -60,6 +551,21 @@ std::unordered_set<point3D_t> Reconstruction::Point3DIds() const {
   return point3D_ids;
 }
 
+const std::unordered_map<image_t, size_t>& Reconstruction::CovisibleImages(
+    const image_t image_id) const {
+  static const std::unordered_map<image_t, size_t> kNoCovisibleImages;
+  CHECK_NOTNULL(correspondence_graph_);
+  const auto covisible_images = covisibility_graph_.find(image_id);
+  if (covisible_images == covisibility_graph_.end()) {
+    return kNoCovisibleImages;
+  }
+  return covisible_images->second;
+}
+
+void Reconstruction::ClearModifiedVisibilityImageIds() {
+  modified_visibility_image_ids_.clear();
+}
+
 void Reconstruction::Load(const DatabaseCache& database_cache) {
   correspondence_graph_ = nullptr;
 
@@ -75,25 +581,32 @@ void Reconstruction::Load(const DatabaseCache& database_cache) {
   // Add images.
   images_.reserve(database_cache.NumImages());
 
-  for (const auto& image : database_cache.Images()) {
-    if (ExistsImage(image.second.ImageId())) {
-      class Image& existing_image = Image(image.second.ImageId());
-      CHECK_EQ(existing_image.Name(), image.second.Name());
+  const class CorrespondenceGraph& correspondence_graph =
+      database_cache.CorrespondenceGraph();
+  for (const image_t image_id : database_cache.ImageIds()) {
+    const class Image& image = database_cache.Image(image_id);
+    if (ExistsImage(image_id)) {
+      class Image& existing_image = Image(image_id);
+      CHECK_EQ(existing_image.Name(), image.Name());
       if (existing_image.NumPoints2D() == 0) {
-        existing_image.SetPoints2D(image.second.Points2D());
+        existing_image.SetPoints2D(image.Points2D());
       } else {
-        CHECK_EQ(image.second.NumPoints2D(), existing_image.NumPoints2D());
+        CHECK_EQ(image.NumPoints2D(), existing_image.NumPoints2D());
       }
-      existing_image.SetNumObservations(image.second.NumObservations());
-      existing_image.SetNumCorrespondences(image.second.NumCorrespondences());
     } else {
-      AddImage(image.second);
+      AddImage(image);
     }
+    // The images of a subset cache refer to the full correspondence graph.
+    class Image& loaded_image = Image(image_id);
+    loaded_image.SetNumObservations(
+        correspondence_graph.NumObservationsForImage(image_id));
+    loaded_image.SetNumCorrespondences(
+        correspondence_graph.NumCorrespondencesForImage(image_id));
   }
 
   // Add image pairs.
   for (const auto& image_pair :
-       database_cache.CorrespondenceGraph().NumCorrespondencesBetweenImages()) {
+       correspondence_graph.NumCorrespondencesBetweenImages()) {
     ImagePairStat image_pair_stat;
     image_pair_stat.num_total_corrs = image_pair.second;
     image_pair_stats_.emplace(image_pair.first, image_pair_stat);
@@ -120,10 +633,18 @@ void Reconstruction::SetUp(const CorrespondenceGraph* correspondence_graph) {
       }
     }
   }
+
+  const bool kIsAddedObservation = true;
+  covisibility_graph_.clear();
+  for (const auto& point3D : points3D_) {
+    UpdateCovisibility(point3D.second.Track(), kIsAddedObservation);
+  }
 }
 
 void Reconstruction::TearDown() {
   correspondence_graph_ = nullptr;
+  modified_visibility_image_ids_.clear();
+  covisibility_graph_.clear();
 
   // Remove all not yet registered images.
   std::unordered_set<camera_t> keep_camera_ids;
@@ -163,6 +684,49 @@ void Reconstruction::AddImage(const class Image& image) {
   images_[image.ImageId()] = image;
 }
 
+void Reconstruction::AddImageAfterSetUp(const class Image& image) {
+  CHECK_NOTNULL(correspondence_graph_);
+
+  const image_t image_id = image.ImageId();
+  AddImage(image);
+
+  class Image& new_image = Image(image_id);
+  new_image.SetUp(Camera(new_image.CameraId()));
+  new_image.SetNumObservations(
+      correspondence_graph_->NumObservationsForImage(image_id));
+  new_image.SetNumCorrespondences(
+      correspondence_graph_->NumCorrespondencesForImage(image_id));
+
+  // Mark the observations in the new image, whose correspondences were already
+  // triangulated, and collect the images with correspondences to it.
+  std::unordered_set<image_t> corr_image_ids;
+  for (point2D_t point2D_idx = 0; point2D_idx < new_image.NumPoints2D();
+       ++point2D_idx) {
+    for (const auto& corr :
+         correspondence_graph_->FindCorrespondences(image_id, point2D_idx)) {
+      corr_image_ids.insert(corr.image_id);
+      if (Image(corr.image_id).Point2D(corr.point2D_idx).HasPoint3D()) {
+        new_image.IncrementCorrespondenceHasPoint3D(point2D_idx);
+      }
+    }
+  }
+
+  for (const image_t corr_image_id : corr_image_ids) {
+    class Image& corr_image = Image(corr_image_id);
+    corr_image.SetNumObservations(
+        correspondence_graph_->NumObservationsForImage(corr_image_id));
+    corr_image.SetNumCorrespondences(
+        correspondence_graph_->NumCorrespondencesForImage(corr_image_id));
+    const image_pair_t pair_id =
+        Database::ImagePairToPairId(image_id, corr_image_id);
+    image_pair_stats_[pair_id].num_total_corrs =
+        correspondence_graph_->NumCorrespondencesBetweenImages(image_id,
+                                                               corr_image_id);
+  }
+
+  modified_visibility_image_ids_.insert(image_id);
+}
+
 point3D_t Reconstruction::AddPoint3D(const Eigen::Vector3d& xyz,
                                      const Track& track,
                                      const Eigen::Vector3ub& color) {
@@ -189,6 +753,13 @@ point3D_t Reconstruction::AddPoint3D(const Eigen::Vector3d& xyz,
                                  kIsContinuedPoint3D);
   }
 
+  const bool kIsAddedObservation = true;
+  UpdateCovisibility(track, kIsAddedObservation);
+
+  if (point3D_index_.IsEnabled()) {
+    point3D_index_.Update(point3D_id, xyz);
+  }
+
   return point3D_id;
 }
 
@@ -201,6 +772,9 @@ void Reconstruction::AddObservation(const point3D_t point3D_id,
   CHECK_LE(image.NumPoints3D(), image.NumPoints2D());
 
   class Point3D& point3D = Point3D(point3D_id);
+  const bool kIsAddedObservation = true;
+  UpdateCovisibility(track_el.image_id, point3D.Track().Elements().begin(),
+                     point3D.Track().Elements().end(), kIsAddedObservation);
   point3D.Track().AddElement(track_el);
 
   const bool kIsContinuedPoint3D = true;
@@ -254,7 +828,11 @@ void Reconstruction::DeletePoint3D(const point3D_t point3D_id) {
     image.ResetPoint3DForPoint2D(track_el.point2D_idx);
   }
 
+  const bool kIsAddedObservation = false;
+  UpdateCovisibility(track, kIsAddedObservation);
+
   points3D_.erase(point3D_id);
+  point3D_index_.Remove(point3D_id);
 }
 
 void Reconstruction::DeleteObservation(const image_t image_id,
@@ -272,6 +850,9 @@ void Reconstruction::DeleteObservation(const image_t image_id,
   }
 
   point3D.Track().DeleteElement(image_id, point2D_idx);
+  const bool kIsAddedObservation = false;
+  UpdateCovisibility(image_id, point3D.Track().Elements().begin(),
+                     point3D.Track().Elements().end(), kIsAddedObservation);
 
   const bool kIsDeletedPoint3D = false;
   ResetTriObservations(image_id, point2D_idx, kIsDeletedPoint3D);
@@ -281,6 +862,8 @@ void Reconstruction::DeleteObservation(const image_t image_id,
 
 void Reconstruction::DeleteAllPoints2DAndPoints3D() {
   points3D_.clear();
+  point3D_index_.Clear();
+  covisibility_graph_.clear();
   for (auto& image : images_) {
     class Image new_image;
     new_image.SetImageId(image.second.ImageId());
@@ -296,9 +879,123 @@ void Reconstruction::DeleteAllPoints2DAndPoints3D() {
   }
 }
 
+void Reconstruction::SetPoint3DIndexVoxelSize(const double voxel_size) {
+  point3D_index_ = Point3DIndex(voxel_size);
+  UpdatePoint3DIndex();
+}
+
+void Reconstruction::UpdatePoint3DIndex() {
+  if (!point3D_index_.IsEnabled()) {
+    return;
+  }
+
+  point3D_index_.Clear();
+  for (const auto& point3D : points3D_) {
+    point3D_index_.Update(point3D.first, point3D.second.XYZ());
+  }
+}
+
+std::vector<point3D_t> Reconstruction::FindPoints3DInRadius(
+    const Eigen::Vector3d& xyz, const double radius) const {
+  const double squared_radius = radius * radius;
+  std::vector<point3D_t> point3D_ids;
+
+  if (point3D_index_.IsEnabled()) {
+    for (const point3D_t point3D_id :
+         point3D_index_.FindCandidates(xyz, radius)) {
+      if ((Point3D(point3D_id).XYZ() - xyz).squaredNorm() <= squared_radius) {
+        point3D_ids.push_back(point3D_id);
+      }
+    }
+  } else {
+    for (const auto& point3D : points3D_) {
+      if ((point3D.second.XYZ() - xyz).squaredNorm() <= squared_radius) {
+        point3D_ids.push_back(point3D.first);
+      }
+    }
+  }
+
+  return point3D_ids;
+}
+
+size_t Reconstruction::MergeNearbyPoints3D(const double max_distance) {
+  CHECK_GT(max_distance, 0);
+
+  // Temporarily index the 3D points, if the reconstruction has no index.
+  const double prev_voxel_size = point3D_index_.VoxelSize();
+  if (!point3D_index_.IsEnabled()) {
+    SetPoint3DIndexVoxelSize(max_distance);
+  }
+
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(points3D_.size());
+  for (const auto& point3D : points3D_) {
+    point3D_ids.push_back(point3D.first);
+  }
+
+  size_t num_merged = 0;
+  std::unordered_set<image_t> image_ids;
+  for (const point3D_t point3D_id : point3D_ids) {
+    // The 3D point might have been merged already.
+    if (!ExistsPoint3D(point3D_id)) {
+      continue;
+    }
+
+    const class Point3D& point3D = Point3D(point3D_id);
+
+    image_ids.clear();
+    for (const auto& track_el : point3D.Track().Elements()) {
+      image_ids.insert(track_el.image_id);
+    }
+
+    point3D_t merge_point3D_id = kInvalidPoint3DId;
+    double min_squared_distance = std::numeric_limits<double>::max();
+    for (const point3D_t other_point3D_id :
+         FindPoints3DInRadius(point3D.XYZ(), max_distance)) {
+      if (other_point3D_id == point3D_id) {
+        continue;
+      }
+
+      const class Point3D& other_point3D = Point3D(other_point3D_id);
+      const double squared_distance =
+          (other_point3D.XYZ() - point3D.XYZ()).squaredNorm();
+      if (squared_distance >= min_squared_distance) {
+        continue;
+      }
+
+      bool has_common_image = false;
+      for (const auto& track_el : other_point3D.Track().Elements()) {
+        if (image_ids.count(track_el.image_id) > 0) {
+          has_common_image = true;
+          break;
+        }
+      }
+
+      if (!has_common_image) {
+        merge_point3D_id = other_point3D_id;
+        min_squared_distance = squared_distance;
+      }
+    }
+
+    if (merge_point3D_id != kInvalidPoint3DId) {
+      MergePoints3D(point3D_id, merge_point3D_id);
+      num_merged += 1;
+    }
+  }
+
+  if (prev_voxel_size <= 0) {
+    SetPoint3DIndexVoxelSize(prev_voxel_size);
+  }
+
+  return num_merged;
+}
+
 void Reconstruction::RegisterImage(const image_t image_id) {
   class Image& image = Image(image_id);
   if (!image.IsRegistered()) {
+    // References to the points of registered images, e.g. during
+    // triangulation, must stay valid when their 3D points are modified.
+    image.DetachPoints2D();
     image.SetRegistered(true);
     reg_image_ids_.push_back(image_id);
   }
@@ -416,15 +1113,35 @@ void Reconstruction::Normalize(const double extent, const double p0,
     point3D.second.XYZ() -= translation;
     point3D.second.XYZ() *= scale;
   }
+
+  UpdatePoint3DIndex();
 }
 
 void Reconstruction::Transform(const SimilarityTransform3& tform) {
+  std::vector<class Image*> images;
+  images.reserve(images_.size());
   for (auto& image : images_) {
-    tform.TransformPose(&image.second.Qvec(), &image.second.Tvec());
-  }
-  for (auto& point3D : points3D_) {
-    tform.TransformPoint(&point3D.second.XYZ());
-  }
+    images.push_back(&image.second);
+  }
+
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, images.size(),
+              [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  tform.TransformPose(&images[i]->Qvec(), &images[i]->Tvec());
+                }
+              });
+
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, points3D_.num_slots(),
+              [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  auto* point3D = points3D_.slot(i);
+                  if (point3D != nullptr) {
+                    tform.TransformPoint(&point3D->second.XYZ());
+                  }
+                }
+              });
+
+  UpdatePoint3DIndex();
 }
 
 bool Reconstruction::Merge(const Reconstruction& reconstruction,
@@ -438,25 +1155,48 @@ bool Reconstruction::Merge(const Reconstruction& reconstruction,
     return false;
   }
 
+  MergeWithAlignment(reconstruction, alignment, max_reproj_error);
+
+  return true;
+}
+
+void Reconstruction::MergeWithAlignment(const Reconstruction& reconstruction,
+                                        const Eigen::Matrix3x4d& alignment,
+                                        const double max_reproj_error) {
   const SimilarityTransform3 tform(alignment);
 
-  // Find common and missing images in the two reconstructions.
+  // Find common and missing images in the two reconstructions. The images are
+  // classified in tables indexed by their identifiers, which are consecutive
+  // database identifiers, such that every track element is classified with an
+  // array lookup instead of multiple hash lookups.
 
-  std::unordered_set<image_t> common_image_ids;
-  common_image_ids.reserve(reconstruction.NumRegImages());
-  std::unordered_set<image_t> missing_image_ids;
+  image_t max_image_id = 0;
+  for (const auto image_id : reconstruction.RegImageIds()) {
+    max_image_id = std::max(max_image_id, image_id);
+  }
+
+  std::vector<const class Image*> common_images(max_image_id + 1, nullptr);
+  std::vector<char> is_missing_image(max_image_id + 1, false);
+  std::vector<image_t> missing_image_ids;
   missing_image_ids.reserve(reconstruction.NumRegImages());
 
-  for (const auto& image_id : reconstruction.RegImageIds()) {
+  for (const auto image_id : reconstruction.RegImageIds()) {
     if (ExistsImage(image_id)) {
-      common_image_ids.insert(image_id);
+      common_images[image_id] = &Image(image_id);
     } else {
-      missing_image_ids.insert(image_id);
+      is_missing_image[image_id] = true;
+      missing_image_ids.push_back(image_id);
     }
   }
 
   // Register the missing images in this reconstruction.
 
+  images_.reserve(images_.size() + missing_image_ids.size());
+  reg_image_ids_.reserve(reg_image_ids_.size() + missing_image_ids.size());
+
+  std::vector<class Image*> missing_images;
+  missing_images.reserve(missing_image_ids.size());
+
   for (const auto image_id : missing_image_ids) {
     auto reg_image = reconstruction.Image(image_id);
     reg_image.SetRegistered(false);
@@ -465,9 +1205,24 @@ bool Reconstruction::Merge(const Reconstruction& reconstruction,
     if (!ExistsCamera(reg_image.CameraId())) {
       AddCamera(reconstruction.Camera(reg_image.CameraId()));
     }
-    auto& image = Image(image_id);
-    tform.TransformPose(&image.Qvec(), &image.Tvec());
-  }
+    missing_images.push_back(&Image(image_id));
+  }
+
+  // The observations of the missing images are re-added with the merged
+  // tracks below, so they are reset up front.
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, missing_images.size(),
+              [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  class Image* image = missing_images[i];
+                  tform.TransformPose(&image->Qvec(), &image->Tvec());
+                  for (point2D_t point2D_idx = 0;
+                       point2D_idx < image->NumPoints2D(); ++point2D_idx) {
+                    if (image->Point2D(point2D_idx).HasPoint3D()) {
+                      image->ResetPoint3DForPoint2D(point2D_idx);
+                    }
+                  }
+                }
+              });
 
   // Merge the two point clouds using the following two rules:
   //    - copy points to this reconstruction with non-conflicting tracks,
@@ -477,44 +1232,92 @@ bool Reconstruction::Merge(const Reconstruction& reconstruction,
   //      reconstructions if they have a one-to-one mapping.
   // Note that in both cases no cheirality or reprojection test is performed.
 
-  for (const auto& point3D : reconstruction.Points3D()) {
-    Track new_track;
-    Track old_track;
-    std::set<point3D_t> old_point3D_ids;
-    for (const auto& track_el : point3D.second.Track().Elements()) {
-      if (common_image_ids.count(track_el.image_id) > 0) {
-        const auto& point2D =
-            Image(track_el.image_id).Point2D(track_el.point2D_idx);
-        if (point2D.HasPoint3D()) {
-          old_track.AddElement(track_el);
-          old_point3D_ids.insert(point2D.Point3DId());
-        } else {
-          new_track.AddElement(track_el);
+  // Split the tracks of the other reconstruction in parallel, which only
+  // reads from both reconstructions. The candidates are collected per chunk
+  // in the iteration order of the other reconstruction.
+  const size_t num_slots = reconstruction.points3D_.num_slots();
+  const size_t num_chunks =
+      (num_slots + kMergePoints3DChunkSize - 1) / kMergePoints3DChunkSize;
+  std::vector<std::vector<MergePoint3D>> chunk_merge_points3D(num_chunks);
+  ParallelFor(
+      ThreadPool::kMaxNumThreads, 0, num_slots,
+      [&](const size_t begin, const size_t end) {
+        MergePoint3D merge_point3D;
+        for (size_t i = begin; i < end; ++i) {
+          const auto* point3D = reconstruction.points3D_.slot(i);
+          if (point3D == nullptr) {
+            continue;
+          }
+
+          merge_point3D.new_track.Elements().clear();
+          merge_point3D.old_track.Elements().clear();
+          for (const auto& track_el : point3D->second.Track().Elements()) {
+            if (track_el.image_id > max_image_id) {
+              continue;
+            } else if (common_images[track_el.image_id] != nullptr) {
+              if (common_images[track_el.image_id]
+                      ->Point2D(track_el.point2D_idx)
+                      .HasPoint3D()) {
+                merge_point3D.old_track.AddElement(track_el);
+              } else {
+                merge_point3D.new_track.AddElement(track_el);
+              }
+            } else if (is_missing_image[track_el.image_id]) {
+              merge_point3D.new_track.AddElement(track_el);
+            }
+          }
+
+          const size_t new_track_length = merge_point3D.new_track.Length();
+          const size_t old_track_length = merge_point3D.old_track.Length();
+          if (new_track_length < 2 &&
+              (old_track_length == 0 ||
+               new_track_length + old_track_length < 2)) {
+            continue;
+          }
+
+          merge_point3D.point3D = &point3D->second;
+          merge_point3D.xyz = point3D->second.XYZ();
+          tform.TransformPoint(&merge_point3D.xyz);
+          chunk_merge_points3D[i / kMergePoints3DChunkSize].push_back(
+              merge_point3D);
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC, kMergePoints3DChunkSize);
+
+  points3D_.reserve(points3D_.size() + reconstruction.NumPoints3D());
+
+  for (const auto& merge_points3D : chunk_merge_points3D) {
+    for (const auto& merge_point3D : merge_points3D) {
+      // The 3D points of the old observations are only resolved now, since
+      // merging previous points assigns new identifiers.
+      point3D_t old_point3D_id = kInvalidPoint3DId;
+      bool has_unique_old_point3D = false;
+      for (const auto& track_el : merge_point3D.old_track.Elements()) {
+        const point3D_t point3D_id = common_images[track_el.image_id]
+                                         ->Point2D(track_el.point2D_idx)
+                                         .Point3DId();
+        if (old_point3D_id == kInvalidPoint3DId) {
+          old_point3D_id = point3D_id;
+          has_unique_old_point3D = true;
+        } else if (point3D_id != old_point3D_id) {
+          has_unique_old_point3D = false;
+          break;
         }
-      } else if (missing_image_ids.count(track_el.image_id) > 0) {
-        Image(track_el.image_id).ResetPoint3DForPoint2D(track_el.point2D_idx);
-        new_track.AddElement(track_el);
       }
-    }
 
-    const bool create_new_point = new_track.Length() >= 2;
-    const bool merge_new_and_old_point =
-        (new_track.Length() + old_track.Length()) >= 2 &&
-        old_point3D_ids.size() == 1;
-    if (create_new_point || merge_new_and_old_point) {
-      Eigen::Vector3d xyz = point3D.second.XYZ();
-      tform.TransformPoint(&xyz);
-      const auto point3D_id =
-          AddPoint3D(xyz, new_track, point3D.second.Color());
-      if (old_point3D_ids.size() == 1) {
-        MergePoints3D(point3D_id, *old_point3D_ids.begin());
+      const bool create_new_point = merge_point3D.new_track.Length() >= 2;
+      if (create_new_point || has_unique_old_point3D) {
+        const auto point3D_id =
+            AddPoint3D(merge_point3D.xyz, merge_point3D.new_track,
+                       merge_point3D.point3D->Color());
+        if (has_unique_old_point3D) {
+          MergePoints3D(point3D_id, old_point3D_id);
+        }
       }
     }
   }
 
   FilterPoints3DWithLargeReprojectionError(max_reproj_error, Point3DIds());
-
-  return true;
 }
 
 bool Reconstruction::Align(const std::vector<std::string>& image_names,
@@ -525,31 +1328,12 @@ bool Reconstruction::Align(const std::vector<std::string>& image_names,
 
   // Find out which images are contained in the reconstruction and get the
   // positions of their camera centers.
-  std::set<image_t> common_image_ids;
   std::vector<Eigen::Vector3d> src;
   std::vector<Eigen::Vector3d> dst;
-  for (size_t i = 0; i < image_names.size(); ++i) {
-    const class Image* image = FindImageWithName(image_names[i]);
-    if (image == nullptr) {
-      continue;
-    }
-
-    if (!IsImageRegistered(image->ImageId())) {
-      continue;
-    }
-
-    // Ignore duplicate images.
-    if (common_image_ids.count(image->ImageId()) > 0) {
-      continue;
-    }
-
-    common_image_ids.insert(image->ImageId());
-    src.push_back(image->ProjectionCenter());
-    dst.push_back(locations[i]);
-  }
+  FindRegImageLocations(image_names, locations, &src, &dst);
 
   // Only compute the alignment if there are enough correspondences.
-  if (common_image_ids.size() < static_cast<size_t>(min_common_images)) {
+  if (src.size() < static_cast<size_t>(min_common_images)) {
     return false;
   }
 
@@ -566,52 +1350,61 @@ bool Reconstruction::Align(const std::vector<std::string>& image_names,
 bool Reconstruction::AlignRobust(const std::vector<std::string>& image_names,
                                  const std::vector<Eigen::Vector3d>& locations,
                                  const int min_common_images,
-                                 const RANSACOptions& ransac_options) {
+                                 const RANSACOptions& ransac_options,
+                                 const size_t max_num_samples) {
   CHECK_GE(min_common_images, 3);
   CHECK_EQ(image_names.size(), locations.size());
 
   // Find out which images are contained in the reconstruction and get the
   // positions of their camera centers.
-  std::set<image_t> common_image_ids;
   std::vector<Eigen::Vector3d> src;
   std::vector<Eigen::Vector3d> dst;
-  for (size_t i = 0; i < image_names.size(); ++i) {
-    const class Image* image = FindImageWithName(image_names[i]);
-    if (image == nullptr) {
-      continue;
-    }
-
-    if (!IsImageRegistered(image->ImageId())) {
-      continue;
-    }
-
-    // Ignore duplicate images.
-    if (common_image_ids.count(image->ImageId()) > 0) {
-      continue;
-    }
+  FindRegImageLocations(image_names, locations, &src, &dst);
 
-    common_image_ids.insert(image->ImageId());
-    src.push_back(image->ProjectionCenter());
-    dst.push_back(locations[i]);
+  // Only compute the alignment if there are enough correspondences.
+  if (src.size() < static_cast<size_t>(min_common_images)) {
+    return false;
   }
 
-  // Only compute the alignment if there are enough correspondences.
-  if (common_image_ids.size() < static_cast<size_t>(min_common_images)) {
+  Eigen::Matrix3x4d tform;
+  if (!EstimateSimilarityTransformRobust(src, dst, ransac_options,
+                                         min_common_images, max_num_samples,
+                                         &tform)) {
     return false;
   }
 
-  LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
-      ransac(ransac_options);
+  Transform(SimilarityTransform3(tform));
 
-  const auto report = ransac.Estimate(src, dst);
+  return true;
+}
 
-  if (report.support.num_inliers < static_cast<size_t>(min_common_images)) {
-    return false;
+void Reconstruction::FindRegImageLocations(
+    const std::vector<std::string>& image_names,
+    const std::vector<Eigen::Vector3d>& locations,
+    std::vector<Eigen::Vector3d>* src,
+    std::vector<Eigen::Vector3d>* dst) const {
+  std::unordered_map<std::string, const class Image*> name_to_reg_image;
+  name_to_reg_image.reserve(reg_image_ids_.size());
+  for (const image_t image_id : reg_image_ids_) {
+    const class Image& image = Image(image_id);
+    name_to_reg_image.emplace(image.Name(), &image);
   }
 
-  Transform(SimilarityTransform3(report.model));
+  std::unordered_set<image_t> common_image_ids;
+  for (size_t i = 0; i < image_names.size(); ++i) {
+    const auto image = name_to_reg_image.find(image_names[i]);
+    if (image == name_to_reg_image.end()) {
+      continue;
+    }
 
-  return true;
+    // Ignore duplicate images.
+    if (!common_image_ids.insert(image->second->ImageId()).second) {
+      continue;
+    }
+
+    src->push_back(image->second->ProjectionCenter());
+    dst->push_back(locations[i]);
+  }
 }
 
 const class Image* Reconstruction::FindImageWithName(
@@ -787,53 +1580,228 @@ double Reconstruction::ComputeMeanReprojectionError() const {
       error_sum += point3D.second.Error();
       num_valid_errors += 1;
     }
-  }
+  }
+
+  if (num_valid_errors == 0) {
+    return 0.0;
+  } else {
+    return error_sum / num_valid_errors;
+  }
+}
+
+void Reconstruction::Read(const std::string& path) {
+  if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
+      ExistsFile(JoinPaths(path, "images.bin")) &&
+      ExistsFile(JoinPaths(path, "points3D.bin"))) {
+    ReadBinary(path);
+  } else if (ExistsFile(JoinPaths(path, "cameras.txt")) &&
+             ExistsFile(JoinPaths(path, "images.txt")) &&
+             ExistsFile(JoinPaths(path, "points3D.txt"))) {
+    ReadText(path);
+  } else {
+    LOG(FATAL) << "cameras, images, points3D files do not exist at " << path;
+  }
+}
+
+void Reconstruction::Write(const std::string& path) const { WriteBinary(path); }
+
+void Reconstruction::ReadText(const std::string& path) {
+  ReadCamerasText(JoinPaths(path, "cameras.txt"));
+  ReadImagesText(JoinPaths(path, "images.txt"));
+  ReadPoints3DText(JoinPaths(path, "points3D.txt"));
+}
+
+void Reconstruction::ReadBinary(const std::string& path) {
+  ReadCamerasBinary(JoinPaths(path, "cameras.bin"));
+  ReadImagesBinary(JoinPaths(path, "images.bin"));
+  ReadPoints3DBinary(JoinPaths(path, "points3D.bin"));
+}
+
+void Reconstruction::WriteText(const std::string& path) const {
+  WriteCamerasText(JoinPaths(path, "cameras.txt"));
+  WriteImagesText(JoinPaths(path, "images.txt"));
+  WritePoints3DText(JoinPaths(path, "points3D.txt"));
+}
+
+void Reconstruction::WriteBinary(const std::string& path) const {
+  WriteCamerasBinary(JoinPaths(path, "cameras.bin"));
+  WriteImagesBinary(JoinPaths(path, "images.bin"));
+  WritePoints3DBinary(JoinPaths(path, "points3D.bin"));
+}
+
+void Reconstruction::WriteJournalCheckpoint(JournalState* state,
+                                            std::ostream* stream) const {
+  CHECK_NOTNULL(state);
+  CHECK_NOTNULL(stream);
+
+  // Serializes the record of each object and only appends the records whose
+  // content hash changed since the previous checkpoint.
+  std::ostringstream record;
+  std::string records;
+  std::hash<std::string> hash_func;
+  const auto AppendIfChanged = [&](const bool is_new, size_t* hash) {
+    const std::string record_data = record.str();
+    record.str("");
+    const size_t record_hash = hash_func(record_data);
+    if (is_new || *hash != record_hash) {
+      *hash = record_hash;
+      records += record_data;
+      return true;
+    }
+    return false;
+  };
+
+  const auto WriteRecords = [&](const size_t num_records) {
+    WriteBinaryLittleEndian<uint64_t>(stream, num_records);
+    stream->write(records.data(), records.size());
+    records.clear();
+  };
+
+  size_t num_records = 0;
+  for (const auto& camera : cameras_) {
+    WriteCameraBinary(camera.second, &record);
+    const auto hash = state->camera_hashes.emplace(camera.first, 0);
+    num_records += AppendIfChanged(hash.second, &hash.first->second);
+  }
+  WriteRecords(num_records);
+
+  num_records = 0;
+  for (const image_t image_id : reg_image_ids_) {
+    WriteImageBinary(Image(image_id), &record);
+    const auto hash = state->image_hashes.emplace(image_id, 0);
+    num_records += AppendIfChanged(hash.second, &hash.first->second);
+  }
+  WriteRecords(num_records);
+
+  num_records = 0;
+  for (const auto& point3D : points3D_) {
+    WritePoint3DBinary(point3D.first, point3D.second, &record);
+    const auto hash = state->point3D_hashes.emplace(point3D.first, 0);
+    num_records += AppendIfChanged(hash.second, &hash.first->second);
+  }
+  WriteRecords(num_records);
+
+  // Record the deregistered images and deleted 3D points.
+
+  std::vector<image_t> deleted_image_ids;
+  for (auto it = state->image_hashes.begin();
+       it != state->image_hashes.end();) {
+    if (ExistsImage(it->first) && Image(it->first).IsRegistered()) {
+      ++it;
+    } else {
+      deleted_image_ids.push_back(it->first);
+      it = state->image_hashes.erase(it);
+    }
+  }
+
+  std::vector<point3D_t> deleted_point3D_ids;
+  for (auto it = state->point3D_hashes.begin();
+       it != state->point3D_hashes.end();) {
+    if (ExistsPoint3D(it->first)) {
+      ++it;
+    } else {
+      deleted_point3D_ids.push_back(it->first);
+      it = state->point3D_hashes.erase(it);
+    }
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(stream, deleted_image_ids.size());
+  WriteBinaryLittleEndian<image_t>(stream, deleted_image_ids);
+  WriteBinaryLittleEndian<uint64_t>(stream, deleted_point3D_ids.size());
+  WriteBinaryLittleEndian<point3D_t>(stream, deleted_point3D_ids);
+  WriteBinaryLittleEndian<uint64_t>(stream, kJournalCheckpointEnd);
+}
+
+void Reconstruction::ReadJournal(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  size_t num_checkpoints = 0;
+  while (file.peek() != std::ifstream::traits_type::eof()) {
+    // Read the complete checkpoint before applying it, such that an
+    // incompletely written checkpoint at the end of the file is ignored.
+    std::vector<class Camera> cameras;
+    std::vector<class Image> images;
+    std::vector<std::pair<point3D_t, class Point3D>> points3D;
+    std::vector<image_t> deleted_image_ids;
+    std::vector<point3D_t> deleted_point3D_ids;
+
+    bool complete = true;
+
+    const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&file);
+    for (size_t i = 0; i < num_cameras && complete; ++i) {
+      cameras.emplace_back();
+      complete = ReadCameraBinary(&file, &cameras.back());
+    }
+
+    const size_t num_images =
+        file ? ReadBinaryLittleEndian<uint64_t>(&file) : 0;
+    for (size_t i = 0; i < num_images && complete; ++i) {
+      images.emplace_back();
+      complete = ReadImageBinary(&file, &images.back());
+    }
+
+    const size_t num_points3D =
+        file ? ReadBinaryLittleEndian<uint64_t>(&file) : 0;
+    for (size_t i = 0; i < num_points3D && complete; ++i) {
+      points3D.emplace_back();
+      complete = ReadPoint3DBinary(&file, &points3D.back().first,
+                                   &points3D.back().second);
+    }
 
-  if (num_valid_errors == 0) {
-    return 0.0;
-  } else {
-    return error_sum / num_valid_errors;
-  }
-}
+    const size_t num_deleted_images =
+        (complete && file) ? ReadBinaryLittleEndian<uint64_t>(&file) : 0;
+    if (file) {
+      deleted_image_ids.resize(num_deleted_images);
+      ReadBinaryLittleEndian<image_t>(&file, &deleted_image_ids);
+    }
 
-void Reconstruction::Read(const std::string& path) {
-  if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
-      ExistsFile(JoinPaths(path, "images.bin")) &&
-      ExistsFile(JoinPaths(path, "points3D.bin"))) {
-    ReadBinary(path);
-  } else if (ExistsFile(JoinPaths(path, "cameras.txt")) &&
-             ExistsFile(JoinPaths(path, "images.txt")) &&
-             ExistsFile(JoinPaths(path, "points3D.txt"))) {
-    ReadText(path);
-  } else {
-    LOG(FATAL) << "cameras, images, points3D files do not exist at " << path;
-  }
-}
+    const size_t num_deleted_points3D =
+        (complete && file) ? ReadBinaryLittleEndian<uint64_t>(&file) : 0;
+    if (file) {
+      deleted_point3D_ids.resize(num_deleted_points3D);
+      ReadBinaryLittleEndian<point3D_t>(&file, &deleted_point3D_ids);
+    }
 
-void Reconstruction::Write(const std::string& path) const { WriteBinary(path); }
+    if (!complete || !file ||
+        ReadBinaryLittleEndian<uint64_t>(&file) != kJournalCheckpointEnd ||
+        !file) {
+      std::cout << "WARNING: Ignoring incomplete checkpoint #"
+                << num_checkpoints + 1 << " in " << path << std::endl;
+      break;
+    }
 
-void Reconstruction::ReadText(const std::string& path) {
-  ReadCamerasText(JoinPaths(path, "cameras.txt"));
-  ReadImagesText(JoinPaths(path, "images.txt"));
-  ReadPoints3DText(JoinPaths(path, "points3D.txt"));
-}
+    for (const auto& camera : cameras) {
+      CHECK(camera.VerifyParams());
+      cameras_[camera.CameraId()] = camera;
+    }
+    for (const auto& image : images) {
+      images_[image.ImageId()] = image;
+    }
+    for (const auto& point3D : points3D) {
+      points3D_[point3D.first] = point3D.second;
+    }
+    for (const image_t image_id : deleted_image_ids) {
+      images_.erase(image_id);
+    }
+    for (const point3D_t point3D_id : deleted_point3D_ids) {
+      points3D_.erase(point3D_id);
+    }
 
-void Reconstruction::ReadBinary(const std::string& path) {
-  ReadCamerasBinary(JoinPaths(path, "cameras.bin"));
-  ReadImagesBinary(JoinPaths(path, "images.bin"));
-  ReadPoints3DBinary(JoinPaths(path, "points3D.bin"));
-}
+    num_checkpoints += 1;
+  }
 
-void Reconstruction::WriteText(const std::string& path) const {
-  WriteCamerasText(JoinPaths(path, "cameras.txt"));
-  WriteImagesText(JoinPaths(path, "images.txt"));
-  WritePoints3DText(JoinPaths(path, "points3D.txt"));
-}
+  reg_image_ids_.clear();
+  for (auto& image : images_) {
+    image.second.SetUp(Camera(image.second.CameraId()));
+    reg_image_ids_.push_back(image.first);
+  }
 
-void Reconstruction::WriteBinary(const std::string& path) const {
-  WriteCamerasBinary(JoinPaths(path, "cameras.bin"));
-  WriteImagesBinary(JoinPaths(path, "images.bin"));
-  WritePoints3DBinary(JoinPaths(path, "points3D.bin"));
+  for (const auto& point3D : points3D_) {
+    num_added_points3D_ = std::max(num_added_points3D_, point3D.first);
+  }
+
+  UpdatePoint3DIndex();
 }
 
 std::vector<PlyPoint> Reconstruction::ConvertToPLY() const {
@@ -856,6 +1824,7 @@ std::vector<PlyPoint> Reconstruction::ConvertToPLY() const {
 
 void Reconstruction::ImportPLY(const std::string& path) {
   points3D_.clear();
+  point3D_index_.Clear();
 
   const auto ply_points = ReadPly(path);
 
@@ -870,6 +1839,7 @@ void Reconstruction::ImportPLY(const std::string& path) {
 void Reconstruction::ImportPLY(const std::vector<PlyPoint> &ply_points)
 {
   points3D_.clear();
+  point3D_index_.Clear();
   points3D_.reserve(ply_points.size());
   for (const auto& ply_point : ply_points) {
     AddPoint3D(Eigen::Vector3d(ply_point.x, ply_point.y, ply_point.z), Track(),
@@ -1064,6 +2034,16 @@ void Reconstruction::ExportPLY(const std::string& path) const {
   WriteBinaryPlyPoints(path, ply_points, kWriteNormal, kWriteRGB);
 }
 
+void Reconstruction::ExportOctreeTiles(const std::string& path) const {
+  OctreeTilesOptions options;
+  options.write_normal = false;
+  OctreeTilesWriter writer(options, path);
+  for (const auto& ply_point : ConvertToPLY()) {
+    writer.Write(ply_point);
+  }
+  writer.Close();
+}
+
 void Reconstruction::ExportVRML(const std::string& images_path,
                                 const std::string& points3D_path,
                                 const double image_scale,
@@ -1209,42 +2189,83 @@ bool Reconstruction::ExtractColorsForImage(const image_t image_id,
   return true;
 }
 
-void Reconstruction::ExtractColorsForAllImages(const std::string& path) {
-  EIGEN_STL_UMAP(point3D_t, Eigen::Vector3d) color_sums;
-  std::unordered_map<point3D_t, size_t> color_counts;
+void Reconstruction::ExtractColorsForAllImages(const std::string& path,
+                                               const int max_image_size,
+                                               const int num_threads) {
+  // The colors sampled at the observations of an image.
+  struct ImageColors {
+    bool success = false;
+    std::vector<std::pair<point3D_t, Eigen::Vector3f>> colors;
+  };
 
-  for (size_t i = 0; i < reg_image_ids_.size(); ++i) {
-    const class Image& image = Image(reg_image_ids_[i]);
-    const std::string image_path = JoinPaths(path, image.Name());
+  auto SampleImageColors = [&](const image_t image_id) {
+    const class Image& image = Image(image_id);
+    const class Camera& camera = Camera(image.CameraId());
+
+    ImageColors image_colors;
 
     Bitmap bitmap;
-    if (!bitmap.Read(image_path)) {
-      std::cout << StringPrintf("Could not read image %s at path %s.",
-                                image.Name().c_str(), image_path.c_str())
-                << std::endl;
-      continue;
+    if (!bitmap.Read(JoinPaths(path, image.Name()), true, max_image_size)) {
+      return image_colors;
+    }
+
+    image_colors.success = true;
+    image_colors.colors.reserve(image.NumPoints3D());
+
+    // Scale the observations, if the image was decoded at a reduced scale.
+    double scale_x = 1.0;
+    double scale_y = 1.0;
+    if (camera.Width() > 0 && camera.Height() > 0) {
+      scale_x = static_cast<double>(bitmap.Width()) / camera.Width();
+      scale_y = static_cast<double>(bitmap.Height()) / camera.Height();
     }
 
-    for (const Point2D point2D : image.Points2D()) {
+    for (const Point2D& point2D : image.Points2D()) {
       if (point2D.HasPoint3D()) {
         BitmapColor<float> color;
         // COLMAP assumes that the upper left pixel center is (0.5, 0.5).
-        if (bitmap.InterpolateBilinear(point2D.X() - 0.5, point2D.Y() - 0.5,
-                                       &color)) {
-          if (color_sums.count(point2D.Point3DId())) {
-            Eigen::Vector3d& color_sum = color_sums[point2D.Point3DId()];
-            color_sum(0) += color.r;
-            color_sum(1) += color.g;
-            color_sum(2) += color.b;
-            color_counts[point2D.Point3DId()] += 1;
-          } else {
-            color_sums.emplace(point2D.Point3DId(),
-                               Eigen::Vector3d(color.r, color.g, color.b));
-            color_counts.emplace(point2D.Point3DId(), 1);
-          }
+        if (bitmap.InterpolateBilinear(scale_x * point2D.X() - 0.5,
+                                       scale_y * point2D.Y() - 0.5, &color)) {
+          image_colors.colors.emplace_back(
+              point2D.Point3DId(), Eigen::Vector3f(color.r, color.g, color.b));
         }
       }
     }
+
+    return image_colors;
+  };
+
+  ThreadPool thread_pool(GetEffectiveNumThreads(num_threads));
+  std::vector<std::future<ImageColors>> futures;
+  futures.reserve(reg_image_ids_.size());
+  for (const image_t image_id : reg_image_ids_) {
+    futures.push_back(thread_pool.AddTask(SampleImageColors, image_id));
+  }
+
+  // Accumulate the colors in the calling thread, while the remaining images
+  // are still being decoded.
+  EIGEN_STL_UMAP(point3D_t, Eigen::Vector3d) color_sums;
+  std::unordered_map<point3D_t, size_t> color_counts;
+  color_sums.reserve(points3D_.size());
+  color_counts.reserve(points3D_.size());
+
+  for (size_t i = 0; i < futures.size(); ++i) {
+    const ImageColors image_colors = futures[i].get();
+    if (!image_colors.success) {
+      const class Image& image = Image(reg_image_ids_[i]);
+      std::cout << StringPrintf("Could not read image %s at path %s.",
+                                image.Name().c_str(),
+                                JoinPaths(path, image.Name()).c_str())
+                << std::endl;
+      continue;
+    }
+
+    for (const auto& color : image_colors.colors) {
+      const auto color_sum =
+          color_sums.emplace(color.first, Eigen::Vector3d::Zero());
+      color_sum.first->second += color.second.cast<double>();
+      color_counts[color.first] += 1;
+    }
   }
 
   const Eigen::Vector3ub kBlackColor = Eigen::Vector3ub::Zero();
@@ -1283,59 +2304,59 @@ void Reconstruction::CreateImageDirs(const std::string& path) const {
 size_t Reconstruction::FilterPoints3DWithSmallTriangulationAngle(
     const double min_tri_angle,
     const std::unordered_set<point3D_t>& point3D_ids) {
-  // Number of filtered points.
-  size_t num_filtered = 0;
-
   // Minimum triangulation angle in radians.
   const double min_tri_angle_rad = DegToRad(min_tri_angle);
 
   // Cache for image projection centers.
   EIGEN_STL_UMAP(image_t, Eigen::Vector3d) proj_centers;
+  proj_centers.reserve(images_.size());
+  for (const auto& image : images_) {
+    proj_centers.emplace(image.first, image.second.ProjectionCenter());
+  }
+
+  const std::vector<point3D_t> existing_point3D_ids =
+      FindExistingPoints3D(point3D_ids);
+
+  // Evaluate the points in parallel and delete them serially afterwards.
+  std::vector<char> keep_points(existing_point3D_ids.size(), false);
+  ParallelFor(
+      ThreadPool::kMaxNumThreads, 0, existing_point3D_ids.size(),
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const class Point3D& point3D = Point3D(existing_point3D_ids[i]);
+
+          // Calculate triangulation angle for all pairwise combinations of
+          // image poses in the track. Only delete point if none of the
+          // combinations has a sufficient triangulation angle.
+          bool keep_point = false;
+          for (size_t i1 = 0; i1 < point3D.Track().Length() && !keep_point;
+               ++i1) {
+            const Eigen::Vector3d& proj_center1 =
+                proj_centers.at(point3D.Track().Element(i1).image_id);
+            for (size_t i2 = 0; i2 < i1; ++i2) {
+              const Eigen::Vector3d& proj_center2 =
+                  proj_centers.at(point3D.Track().Element(i2).image_id);
+              const double tri_angle = CalculateTriangulationAngle(
+                  proj_center1, proj_center2, point3D.XYZ());
+              if (tri_angle >= min_tri_angle_rad) {
+                keep_point = true;
+                break;
+              }
+            }
+          }
 
-  for (const auto point3D_id : point3D_ids) {
-    if (!ExistsPoint3D(point3D_id)) {
-      continue;
-    }
-
-    const class Point3D& point3D = Point3D(point3D_id);
-
-    // Calculate triangulation angle for all pairwise combinations of image
-    // poses in the track. Only delete point if none of the combinations
-    // has a sufficient triangulation angle.
-    bool keep_point = false;
-    for (size_t i1 = 0; i1 < point3D.Track().Length(); ++i1) {
-      const image_t image_id1 = point3D.Track().Element(i1).image_id;
-
-      Eigen::Vector3d proj_center1;
-      if (proj_centers.count(image_id1) == 0) {
-        const class Image& image1 = Image(image_id1);
-        proj_center1 = image1.ProjectionCenter();
-        proj_centers.emplace(image_id1, proj_center1);
-      } else {
-        proj_center1 = proj_centers.at(image_id1);
-      }
-
-      for (size_t i2 = 0; i2 < i1; ++i2) {
-        const image_t image_id2 = point3D.Track().Element(i2).image_id;
-        const Eigen::Vector3d proj_center2 = proj_centers.at(image_id2);
-
-        const double tri_angle = CalculateTriangulationAngle(
-            proj_center1, proj_center2, point3D.XYZ());
-
-        if (tri_angle >= min_tri_angle_rad) {
-          keep_point = true;
-          break;
+          keep_points[i] = keep_point;
         }
-      }
+      },
+      ThreadPool::Schedule::DYNAMIC, kFilterPoints3DChunkSize);
 
-      if (keep_point) {
-        break;
-      }
-    }
+  // Number of filtered points.
+  size_t num_filtered = 0;
 
-    if (!keep_point) {
+  for (size_t i = 0; i < existing_point3D_ids.size(); ++i) {
+    if (!keep_points[i]) {
       num_filtered += 1;
-      DeletePoint3D(point3D_id);
+      DeletePoint3D(existing_point3D_ids[i]);
     }
   }
 
@@ -1347,54 +2368,98 @@ size_t Reconstruction::FilterPoints3DWithLargeReprojectionError(
     const std::unordered_set<point3D_t>& point3D_ids) {
   const double max_squared_reproj_error = max_reproj_error * max_reproj_error;
 
-  // Number of filtered points.
-  size_t num_filtered = 0;
-
-  for (const auto point3D_id : point3D_ids) {
-    if (!ExistsPoint3D(point3D_id)) {
-      continue;
-    }
-
-    class Point3D& point3D = Point3D(point3D_id);
-
-    if (point3D.Track().Length() < 2) {
-      DeletePoint3D(point3D_id);
-      num_filtered += point3D.Track().Length();
-      continue;
-    }
+  const std::vector<point3D_t> existing_point3D_ids =
+      FindExistingPoints3D(point3D_ids);
+
+  // Evaluate the observations of the points in parallel. The observations to
+  // delete are collected per chunk, ordered by the index of their point.
+  const size_t num_chunks =
+      (existing_point3D_ids.size() + kFilterPoints3DChunkSize - 1) /
+      kFilterPoints3DChunkSize;
+  std::vector<double> reproj_error_sums(existing_point3D_ids.size(), 0.0);
+  std::vector<std::vector<std::pair<size_t, TrackElement>>>
+      chunk_track_els_to_delete(num_chunks);
+  ParallelFor(
+      ThreadPool::kMaxNumThreads, 0, existing_point3D_ids.size(),
+      [&](const size_t begin, const size_t end) {
+        // Note that the range covers multiple chunks, if it is not split.
+        for (size_t i = begin; i < end; ++i) {
+          const class Point3D& point3D = Point3D(existing_point3D_ids[i]);
+          if (point3D.Track().Length() < 2) {
+            continue;
+          }
 
-    double reproj_error_sum = 0.0;
+          auto& track_els_to_delete =
+              chunk_track_els_to_delete[i / kFilterPoints3DChunkSize];
+
+          for (const auto& track_el : point3D.Track().Elements()) {
+            const class Image& image = Image(track_el.image_id);
+            const class Camera& camera = Camera(image.CameraId());
+            const Point2D& point2D = image.Point2D(track_el.point2D_idx);
+            const double squared_reproj_error =
+                CalculateSquaredReprojectionError(point2D.XY(), point3D.XYZ(),
+                                                  image.Qvec(), image.Tvec(),
+                                                  camera);
+            if (squared_reproj_error > max_squared_reproj_error) {
+              track_els_to_delete.emplace_back(i, track_el);
+            } else {
+              reproj_error_sums[i] += std::sqrt(squared_reproj_error);
+            }
+          }
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC, kFilterPoints3DChunkSize);
 
-    std::vector<TrackElement> track_els_to_delete;
+  // Number of filtered points.
+  size_t num_filtered = 0;
 
-    for (const auto& track_el : point3D.Track().Elements()) {
-      const class Image& image = Image(track_el.image_id);
-      const class Camera& camera = Camera(image.CameraId());
-      const Point2D& point2D = image.Point2D(track_el.point2D_idx);
-      const double squared_reproj_error = CalculateSquaredReprojectionError(
-          point2D.XY(), point3D.XYZ(), image.Qvec(), image.Tvec(), camera);
-      if (squared_reproj_error > max_squared_reproj_error) {
-        track_els_to_delete.push_back(track_el);
-      } else {
-        reproj_error_sum += std::sqrt(squared_reproj_error);
+  for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+    const auto& track_els_to_delete = chunk_track_els_to_delete[chunk_idx];
+    auto track_el_it = track_els_to_delete.begin();
+
+    const size_t begin = chunk_idx * kFilterPoints3DChunkSize;
+    const size_t end = std::min(begin + kFilterPoints3DChunkSize,
+                                existing_point3D_ids.size());
+    for (size_t i = begin; i < end; ++i) {
+      const point3D_t point3D_id = existing_point3D_ids[i];
+      class Point3D& point3D = Point3D(point3D_id);
+      const size_t track_length = point3D.Track().Length();
+
+      const auto track_els_begin = track_el_it;
+      while (track_el_it != track_els_to_delete.end() &&
+             track_el_it->first == i) {
+        ++track_el_it;
       }
-    }
+      const size_t num_track_els_to_delete = track_el_it - track_els_begin;
 
-    if (track_els_to_delete.size() >= point3D.Track().Length() - 1) {
-      num_filtered += point3D.Track().Length();
-      DeletePoint3D(point3D_id);
-    } else {
-      num_filtered += track_els_to_delete.size();
-      for (const auto& track_el : track_els_to_delete) {
-        DeleteObservation(track_el.image_id, track_el.point2D_idx);
+      if (track_length < 2 || num_track_els_to_delete >= track_length - 1) {
+        num_filtered += track_length;
+        DeletePoint3D(point3D_id);
+      } else {
+        num_filtered += num_track_els_to_delete;
+        for (auto it = track_els_begin; it != track_el_it; ++it) {
+          DeleteObservation(it->second.image_id, it->second.point2D_idx);
+        }
+        point3D.SetError(reproj_error_sums[i] / point3D.Track().Length());
       }
-      point3D.SetError(reproj_error_sum / point3D.Track().Length());
     }
   }
 
   return num_filtered;
 }
 
+std::vector<point3D_t> Reconstruction::FindExistingPoints3D(
+    const std::unordered_set<point3D_t>& point3D_ids) const {
+  std::vector<point3D_t> existing_point3D_ids;
+  existing_point3D_ids.reserve(point3D_ids.size());
+  for (const point3D_t point3D_id : point3D_ids) {
+    if (ExistsPoint3D(point3D_id)) {
+      existing_point3D_ids.push_back(point3D_id);
+    }
+  }
+  return existing_point3D_ids;
+}
+
 void Reconstruction::ReadCamerasText(const std::string& path) {
   cameras_.clear();
 
@@ -1456,7 +2521,17 @@ void Reconstruction::ReadImagesText(const std::string& path) {
   while (std::getline(file, line)) {
     StringTrim(&line);
 
-    if (line.empty() || line[0] == '#') {
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line[0] == '#') {
+      const size_t num_images =
+          ReadTextHeaderCount(line, "# Number of images:");
+      if (num_images > 0) {
+        images_.reserve(num_images);
+        reg_image_ids_.reserve(reg_image_ids_.size() + num_images);
+      }
       continue;
     }
 
@@ -1563,7 +2638,16 @@ void Reconstruction::ReadPoints3DText(const std::string& path) {
   while (std::getline(file, line)) {
     StringTrim(&line);
 
-    if (line.empty() || line[0] == '#') {
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line[0] == '#') {
+      const size_t num_points3D =
+          ReadTextHeaderCount(line, "# Number of points:");
+      if (num_points3D > 0) {
+        points3D_.reserve(num_points3D);
+      }
       continue;
     }
 
@@ -1624,6 +2708,8 @@ void Reconstruction::ReadPoints3DText(const std::string& path) {
 
     points3D_.emplace(point3D_id, point3D);
   }
+
+  UpdatePoint3DIndex();
 }
 
 void Reconstruction::ReadCamerasBinary(const std::string& path) {
@@ -1633,105 +2719,72 @@ void Reconstruction::ReadCamerasBinary(const std::string& path) {
   const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&file);
   for (size_t i = 0; i < num_cameras; ++i) {
     class Camera camera;
-    camera.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
-    camera.SetModelId(ReadBinaryLittleEndian<int>(&file));
-    camera.SetWidth(ReadBinaryLittleEndian<uint64_t>(&file));
-    camera.SetHeight(ReadBinaryLittleEndian<uint64_t>(&file));
-    ReadBinaryLittleEndian<double>(&file, &camera.Params());
+    CHECK(ReadCameraBinary(&file, &camera)) << path;
     CHECK(camera.VerifyParams());
     cameras_.emplace(camera.CameraId(), camera);
   }
 }
 
 void Reconstruction::ReadImagesBinary(const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  CHECK(file.is_open()) << path;
-
-  const size_t num_reg_images = ReadBinaryLittleEndian<uint64_t>(&file);
+  const MappedFile file(path);
+  BinaryRecordReader reader(file, 0);
+
+  const size_t num_reg_images = reader.Read<uint64_t>();
+  reader.CheckNumRecords(num_reg_images, kMinBinaryImageRecordSize);
+  images_.reserve(images_.size() + num_reg_images);
+  reg_image_ids_.reserve(reg_image_ids_.size() + num_reg_images);
+
+  // Locate all records and insert their images, before the records are
+  // parsed in parallel.
+  std::vector<std::pair<size_t, class Image*>> records;
+  records.reserve(num_reg_images);
   for (size_t i = 0; i < num_reg_images; ++i) {
-    class Image image;
-
-    image.SetImageId(ReadBinaryLittleEndian<image_t>(&file));
-
-    image.Qvec(0) = ReadBinaryLittleEndian<double>(&file);
-    image.Qvec(1) = ReadBinaryLittleEndian<double>(&file);
-    image.Qvec(2) = ReadBinaryLittleEndian<double>(&file);
-    image.Qvec(3) = ReadBinaryLittleEndian<double>(&file);
-    image.NormalizeQvec();
-
-    image.Tvec(0) = ReadBinaryLittleEndian<double>(&file);
-    image.Tvec(1) = ReadBinaryLittleEndian<double>(&file);
-    image.Tvec(2) = ReadBinaryLittleEndian<double>(&file);
-
-    image.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
-
-    char name_char;
-    do {
-      file.read(&name_char, 1);
-      if (name_char != '\0') {
-        image.Name() += name_char;
-      }
-    } while (name_char != '\0');
-
-    const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(&file);
-
-    std::vector<Eigen::Vector2d> points2D;
-    points2D.reserve(num_points2D);
-    std::vector<point3D_t> point3D_ids;
-    point3D_ids.reserve(num_points2D);
-    for (size_t j = 0; j < num_points2D; ++j) {
-      const double x = ReadBinaryLittleEndian<double>(&file);
-      const double y = ReadBinaryLittleEndian<double>(&file);
-      points2D.emplace_back(x, y);
-      point3D_ids.push_back(ReadBinaryLittleEndian<point3D_t>(&file));
-    }
-
-    image.SetUp(Camera(image.CameraId()));
-    image.SetPoints2D(points2D);
-
-    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-         ++point2D_idx) {
-      if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
-        image.SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
-      }
-    }
-
-    image.SetRegistered(true);
-    reg_image_ids_.push_back(image.ImageId());
+    const image_t image_id = reader.Read<image_t>();
+    records.emplace_back(reader.Offset(), &images_[image_id]);
+    records.back().second->SetImageId(image_id);
+    reg_image_ids_.push_back(image_id);
 
-    images_.emplace(image.ImageId(), image);
+    reader.Skip(7 * sizeof(double) + sizeof(camera_t));
+    reader.ReadString();
+    const size_t num_points2D = reader.Read<uint64_t>();
+    reader.SkipArray(num_points2D, kBinaryPoint2DSize);
   }
+
+  ParseRecordsParallel(file, records,
+                       [this](BinaryRecordReader* reader, class Image* image) {
+                         ReadImageBinary(reader, image);
+                         image->SetUp(Camera(image->CameraId()));
+                       });
 }
 
 void Reconstruction::ReadPoints3DBinary(const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  CHECK(file.is_open()) << path;
+  const MappedFile file(path);
+  BinaryRecordReader reader(file, 0);
 
-  const size_t num_points3D = ReadBinaryLittleEndian<uint64_t>(&file);
-  for (size_t i = 0; i < num_points3D; ++i) {
-    class Point3D point3D;
+  const size_t num_points3D = reader.Read<uint64_t>();
+  reader.CheckNumRecords(num_points3D, kMinBinaryPoint3DRecordSize);
+  points3D_.reserve(points3D_.size() + num_points3D);
 
-    const point3D_t point3D_id = ReadBinaryLittleEndian<point3D_t>(&file);
+  // Locate all records and insert their 3D points, before the records are
+  // parsed in parallel.
+  std::vector<std::pair<size_t, class Point3D*>> records;
+  records.reserve(num_points3D);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    const point3D_t point3D_id = reader.Read<point3D_t>();
     num_added_points3D_ = std::max(num_added_points3D_, point3D_id);
+    records.emplace_back(reader.Offset(), &points3D_[point3D_id]);
 
-    point3D.XYZ()(0) = ReadBinaryLittleEndian<double>(&file);
-    point3D.XYZ()(1) = ReadBinaryLittleEndian<double>(&file);
-    point3D.XYZ()(2) = ReadBinaryLittleEndian<double>(&file);
-    point3D.Color(0) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.Color(1) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.Color(2) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.SetError(ReadBinaryLittleEndian<double>(&file));
+    reader.Skip(4 * sizeof(double) + 3 * sizeof(uint8_t));
+    const size_t track_length = reader.Read<uint64_t>();
+    reader.SkipArray(track_length, kBinaryTrackElementSize);
+  }
 
-    const size_t track_length = ReadBinaryLittleEndian<uint64_t>(&file);
-    for (size_t j = 0; j < track_length; ++j) {
-      const image_t image_id = ReadBinaryLittleEndian<image_t>(&file);
-      const point2D_t point2D_idx = ReadBinaryLittleEndian<point2D_t>(&file);
-      point3D.Track().AddElement(image_id, point2D_idx);
-    }
-    point3D.Track().Compress();
+  ParseRecordsParallel(
+      file, records, [](BinaryRecordReader* reader, class Point3D* point3D) {
+        ReadPoint3DBinary(reader, point3D);
+      });
 
-    points3D_.emplace(point3D_id, point3D);
-  }
+  UpdatePoint3DIndex();
 }
 
 void Reconstruction::WriteCamerasText(const std::string& path) const {
@@ -1872,13 +2925,7 @@ void Reconstruction::WriteCamerasBinary(const std::string& path) const {
   WriteBinaryLittleEndian<uint64_t>(&file, cameras_.size());
 
   for (const auto& camera : cameras_) {
-    WriteBinaryLittleEndian<camera_t>(&file, camera.first);
-    WriteBinaryLittleEndian<int>(&file, camera.second.ModelId());
-    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.Width());
-    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.Height());
-    for (const double param : camera.second.Params()) {
-      WriteBinaryLittleEndian<double>(&file, param);
-    }
+    WriteCameraBinary(camera.second, &file);
   }
 }
 
@@ -1893,30 +2940,7 @@ void Reconstruction::WriteImagesBinary(const std::string& path) const {
       continue;
     }
 
-    WriteBinaryLittleEndian<image_t>(&file, image.first);
-
-    const Eigen::Vector4d normalized_qvec =
-        NormalizeQuaternion(image.second.Qvec());
-    WriteBinaryLittleEndian<double>(&file, normalized_qvec(0));
-    WriteBinaryLittleEndian<double>(&file, normalized_qvec(1));
-    WriteBinaryLittleEndian<double>(&file, normalized_qvec(2));
-    WriteBinaryLittleEndian<double>(&file, normalized_qvec(3));
-
-    WriteBinaryLittleEndian<double>(&file, image.second.Tvec(0));
-    WriteBinaryLittleEndian<double>(&file, image.second.Tvec(1));
-    WriteBinaryLittleEndian<double>(&file, image.second.Tvec(2));
-
-    WriteBinaryLittleEndian<camera_t>(&file, image.second.CameraId());
-
-    const std::string name = image.second.Name() + '\0';
-    file.write(name.c_str(), name.size());
-
-    WriteBinaryLittleEndian<uint64_t>(&file, image.second.NumPoints2D());
-    for (const Point2D& point2D : image.second.Points2D()) {
-      WriteBinaryLittleEndian<double>(&file, point2D.X());
-      WriteBinaryLittleEndian<double>(&file, point2D.Y());
-      WriteBinaryLittleEndian<point3D_t>(&file, point2D.Point3DId());
-    }
+    WriteImageBinary(image.second, &file);
   }
 }
 
@@ -1927,20 +2951,7 @@ void Reconstruction::WritePoints3DBinary(const std::string& path) const {
   WriteBinaryLittleEndian<uint64_t>(&file, points3D_.size());
 
   for (const auto& point3D : points3D_) {
-    WriteBinaryLittleEndian<point3D_t>(&file, point3D.first);
-    WriteBinaryLittleEndian<double>(&file, point3D.second.XYZ()(0));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.XYZ()(1));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.XYZ()(2));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.Color(0));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.Color(1));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.Color(2));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.Error());
-
-    WriteBinaryLittleEndian<uint64_t>(&file, point3D.second.Track().Length());
-    for (const auto& track_el : point3D.second.Track().Elements()) {
-      WriteBinaryLittleEndian<image_t>(&file, track_el.image_id);
-      WriteBinaryLittleEndian<point2D_t>(&file, track_el.point2D_idx);
-    }
+    WritePoint3DBinary(point3D.first, point3D.second, &file);
   }
 }
 
@@ -1953,7 +2964,7 @@ void Reconstruction::SetObservationAsTriangulated(
 
   const class Image& image = Image(image_id);
   const Point2D& point2D = image.Point2D(point2D_idx);
-  const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+  const CorrespondenceGraph::CorrespondenceRange corrs =
       correspondence_graph_->FindCorrespondences(image_id, point2D_idx);
 
   CHECK(image.IsRegistered());
@@ -1963,6 +2974,9 @@ void Reconstruction::SetObservationAsTriangulated(
     class Image& corr_image = Image(corr.image_id);
     const Point2D& corr_point2D = corr_image.Point2D(corr.point2D_idx);
     corr_image.IncrementCorrespondenceHasPoint3D(corr.point2D_idx);
+    if (!corr_image.IsRegistered()) {
+      modified_visibility_image_ids_.insert(corr.image_id);
+    }
     // Update number of shared 3D points between image pairs and make sure to
     // only count the correspondences once (not twice forward and backward).
     if (point2D.Point3DId() == corr_point2D.Point3DId() &&
@@ -1987,7 +3001,7 @@ void Reconstruction::ResetTriObservations(const image_t image_id,
 
   const class Image& image = Image(image_id);
   const Point2D& point2D = image.Point2D(point2D_idx);
-  const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+  const CorrespondenceGraph::CorrespondenceRange corrs =
       correspondence_graph_->FindCorrespondences(image_id, point2D_idx);
 
   CHECK(image.IsRegistered());
@@ -1997,6 +3011,9 @@ void Reconstruction::ResetTriObservations(const image_t image_id,
     class Image& corr_image = Image(corr.image_id);
     const Point2D& corr_point2D = corr_image.Point2D(corr.point2D_idx);
     corr_image.DecrementCorrespondenceHasPoint3D(corr.point2D_idx);
+    if (!corr_image.IsRegistered()) {
+      modified_visibility_image_ids_.insert(corr.image_id);
+    }
     // Update number of shared 3D points between image pairs and make sure to
     // only count the correspondences once (not twice forward and backward).
     if (point2D.Point3DId() == corr_point2D.Point3DId() &&
@@ -2010,4 +3027,271 @@ void Reconstruction::ResetTriObservations(const image_t image_id,
   }
 }
 
+void Reconstruction::UpdateCovisibility(
+    const image_t image_id, TrackElements::const_iterator begin,
+    TrackElements::const_iterator end, const bool is_added) {
+  if (correspondence_graph_ == nullptr) {
+    return;
+  }
+
+  for (auto track_el = begin; track_el != end; ++track_el) {
+    if (track_el->image_id == image_id) {
+      continue;
+    }
+    auto& covisible_images1 = covisibility_graph_[image_id];
+    auto& covisible_images2 = covisibility_graph_[track_el->image_id];
+    if (is_added) {
+      covisible_images1[track_el->image_id] += 1;
+      covisible_images2[image_id] += 1;
+    } else {
+      // Remove the images that are no longer covisible, so that the graph only
+      // contains the edges between currently covisible images.
+      auto num_shared1 = covisible_images1.find(track_el->image_id);
+      auto num_shared2 = covisible_images2.find(image_id);
+      CHECK(num_shared1 != covisible_images1.end());
+      CHECK(num_shared2 != covisible_images2.end());
+      if (--num_shared1->second == 0) {
+        covisible_images1.erase(num_shared1);
+      }
+      if (--num_shared2->second == 0) {
+        covisible_images2.erase(num_shared2);
+      }
+    }
+  }
+}
+
+void Reconstruction::UpdateCovisibility(const Track& track,
+                                        const bool is_added) {
+  const TrackElements& track_els = track.Elements();
+  for (auto track_el = track_els.begin(); track_el != track_els.end();
+       ++track_el) {
+    UpdateCovisibility(track_el->image_id, track_el + 1, track_els.end(),
+                       is_added);
+  }
+}
+
+std::unordered_map<image_t, std::string> ReadBinaryModelImageNames(
+    const std::string& path) {
+  const MappedFile file(JoinPaths(path, "images.bin"));
+  std::unordered_map<image_t, std::string> image_names;
+  ForEachBinaryImageRecord(file, [&](const BinaryImageRecord& record) {
+    image_names.emplace(record.image_id, record.name);
+  });
+  return image_names;
+}
+
+std::vector<image_t> FindFilteredBinaryModelImages(
+    const std::string& path, const double min_focal_length_ratio,
+    const double max_focal_length_ratio, const double max_extra_param,
+    const size_t min_num_observations) {
+  std::unordered_set<camera_t> bogus_camera_ids;
+  {
+    const std::string cameras_path = JoinPaths(path, "cameras.bin");
+    std::ifstream file(cameras_path, std::ios::binary);
+    CHECK(file.is_open()) << cameras_path;
+    const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&file);
+    for (size_t i = 0; i < num_cameras; ++i) {
+      Camera camera;
+      CHECK(ReadCameraBinary(&file, &camera)) << cameras_path;
+      if (camera.HasBogusParams(min_focal_length_ratio, max_focal_length_ratio,
+                                max_extra_param)) {
+        bogus_camera_ids.insert(camera.CameraId());
+      }
+    }
+  }
+
+  const MappedFile images_file(JoinPaths(path, "images.bin"));
+  const MappedFile points3D_file(JoinPaths(path, "points3D.bin"));
+
+  // The images removed by `Reconstruction::FilterImages`.
+  std::unordered_set<image_t> filtered_image_ids;
+  ForEachBinaryImageRecord(images_file, [&](const BinaryImageRecord& record) {
+    if (bogus_camera_ids.count(record.camera_id) > 0) {
+      filtered_image_ids.insert(record.image_id);
+      return;
+    }
+    for (size_t i = 0; i < record.num_points2D; ++i) {
+      if (record.Point3DId(images_file, i) != kInvalidPoint3DId) {
+        return;
+      }
+    }
+    filtered_image_ids.insert(record.image_id);
+  });
+
+  // The images with too few observations after removing the above images.
+  std::unordered_set<point3D_t> deleted_point3D_ids;
+  FilterBinaryPoints3D(points3D_file, filtered_image_ids, &deleted_point3D_ids,
+                       nullptr);
+
+  std::vector<image_t> filtered_image_ids_vector(filtered_image_ids.begin(),
+                                                 filtered_image_ids.end());
+  ForEachBinaryImageRecord(images_file, [&](const BinaryImageRecord& record) {
+    if (filtered_image_ids.count(record.image_id) > 0) {
+      return;
+    }
+    size_t num_points3D = 0;
+    for (size_t i = 0; i < record.num_points2D; ++i) {
+      const point3D_t point3D_id = record.Point3DId(images_file, i);
+      if (point3D_id != kInvalidPoint3DId &&
+          deleted_point3D_ids.count(point3D_id) == 0) {
+        num_points3D += 1;
+      }
+    }
+    if (num_points3D < min_num_observations) {
+      filtered_image_ids_vector.push_back(record.image_id);
+    }
+  });
+
+  return filtered_image_ids_vector;
+}
+
+void DeleteBinaryModelImages(const std::string& input_path,
+                             const std::string& output_path,
+                             const std::unordered_set<image_t>& image_ids) {
+  if (!boost::filesystem::equivalent(input_path, output_path)) {
+    boost::filesystem::copy_file(
+        JoinPaths(input_path, "cameras.bin"),
+        JoinPaths(output_path, "cameras.bin"),
+        boost::filesystem::copy_option::overwrite_if_exists);
+  }
+
+  std::unordered_set<point3D_t> deleted_point3D_ids;
+  {
+    const MappedFile file(JoinPaths(input_path, "points3D.bin"));
+    WriteBinaryModelFile(JoinPaths(output_path, "points3D.bin"),
+                         [&](std::ostream* stream) {
+                           FilterBinaryPoints3D(file, image_ids,
+                                                &deleted_point3D_ids, stream);
+                         });
+  }
+
+  const MappedFile file(JoinPaths(input_path, "images.bin"));
+  WriteBinaryModelFile(
+      JoinPaths(output_path, "images.bin"), [&](std::ostream* stream) {
+        uint64_t num_reg_images = 0;
+        WriteBinaryLittleEndian<uint64_t>(stream, num_reg_images);
+
+        const point3D_t invalid_point3D_id =
+            NativeToLittleEndian(kInvalidPoint3DId);
+        std::string buffer;
+        ForEachBinaryImageRecord(file, [&](const BinaryImageRecord& record) {
+          if (image_ids.count(record.image_id) > 0) {
+            return;
+          }
+
+          num_reg_images += 1;
+
+          // Only the records with observations of deleted 3D points must be
+          // patched, all other records are copied verbatim.
+          buffer.clear();
+          for (size_t i = 0; i < record.num_points2D; ++i) {
+            if (deleted_point3D_ids.count(record.Point3DId(file, i)) == 0) {
+              continue;
+            }
+            if (buffer.empty()) {
+              buffer.assign(file.Data() + record.begin,
+                            record.end - record.begin);
+            }
+            std::memcpy(&buffer[record.points2D_begin - record.begin +
+                                i * kBinaryPoint2DSize + 2 * sizeof(double)],
+                        &invalid_point3D_id, sizeof(point3D_t));
+          }
+
+          if (buffer.empty()) {
+            stream->write(file.Data() + record.begin,
+                          record.end - record.begin);
+          } else {
+            stream->write(buffer.data(), buffer.size());
+          }
+        });
+
+        stream->seekp(0);
+        WriteBinaryLittleEndian<uint64_t>(stream, num_reg_images);
+        stream->seekp(0, std::ios::end);
+      });
+}
+
+std::unordered_map<std::string, Eigen::Vector3d>
+ReadBinaryModelProjectionCenters(const std::string& path) {
+  const MappedFile file(JoinPaths(path, "images.bin"));
+  std::unordered_map<std::string, Eigen::Vector3d> proj_centers;
+  ForEachBinaryImageRecord(file, [&](const BinaryImageRecord& record) {
+    BinaryRecordReader reader(file, record.begin + sizeof(image_t));
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+    for (Eigen::Index i = 0; i < qvec.size(); ++i) {
+      qvec(i) = reader.Read<double>();
+    }
+    for (Eigen::Index i = 0; i < tvec.size(); ++i) {
+      tvec(i) = reader.Read<double>();
+    }
+    proj_centers.emplace(record.name, ProjectionCenterFromPose(qvec, tvec));
+  });
+  return proj_centers;
+}
+
+void TransformBinaryModel(const std::string& input_path,
+                          const std::string& output_path,
+                          const SimilarityTransform3& tform) {
+  if (!boost::filesystem::equivalent(input_path, output_path)) {
+    boost::filesystem::copy_file(
+        JoinPaths(input_path, "cameras.bin"),
+        JoinPaths(output_path, "cameras.bin"),
+        boost::filesystem::copy_option::overwrite_if_exists);
+  }
+
+  {
+    const MappedFile file(JoinPaths(input_path, "images.bin"));
+    WriteBinaryModelFile(
+        JoinPaths(output_path, "images.bin"), [&](std::ostream* stream) {
+          WriteBinaryLittleEndian<uint64_t>(
+              stream, BinaryRecordReader(file, 0).Read<uint64_t>());
+          ForEachBinaryImageRecord(file, [&](const BinaryImageRecord& record) {
+            BinaryRecordReader reader(file, record.begin);
+            WriteBinaryLittleEndian<image_t>(stream, reader.Read<image_t>());
+            Eigen::Vector4d qvec;
+            Eigen::Vector3d tvec;
+            for (Eigen::Index i = 0; i < qvec.size(); ++i) {
+              qvec(i) = reader.Read<double>();
+            }
+            for (Eigen::Index i = 0; i < tvec.size(); ++i) {
+              tvec(i) = reader.Read<double>();
+            }
+            tform.TransformPose(&qvec, &tvec);
+            for (Eigen::Index i = 0; i < qvec.size(); ++i) {
+              WriteBinaryLittleEndian<double>(stream, qvec(i));
+            }
+            for (Eigen::Index i = 0; i < tvec.size(); ++i) {
+              WriteBinaryLittleEndian<double>(stream, tvec(i));
+            }
+            stream->write(file.Data() + reader.Offset(),
+                          record.end - reader.Offset());
+          });
+        });
+  }
+
+  const MappedFile file(JoinPaths(input_path, "points3D.bin"));
+  WriteBinaryModelFile(
+      JoinPaths(output_path, "points3D.bin"), [&](std::ostream* stream) {
+        WriteBinaryLittleEndian<uint64_t>(
+            stream, BinaryRecordReader(file, 0).Read<uint64_t>());
+        auto TransformPoint3D = [&](const BinaryPoint3DRecord& record) {
+          BinaryRecordReader reader(file, record.begin);
+          WriteBinaryLittleEndian<point3D_t>(stream,
+                                             reader.Read<point3D_t>());
+          Eigen::Vector3d xyz;
+          for (Eigen::Index i = 0; i < xyz.size(); ++i) {
+            xyz(i) = reader.Read<double>();
+          }
+          tform.TransformPoint(&xyz);
+          for (Eigen::Index i = 0; i < xyz.size(); ++i) {
+            WriteBinaryLittleEndian<double>(stream, xyz(i));
+          }
+          stream->write(file.Data() + reader.Offset(),
+                        record.end - reader.Offset());
+        };
+        ForEachBinaryPoint3DRecord(file, TransformPoint3D);
+      });
+}
+
 }  // namespace colmap
@@ -43,8 +43,10 @@
 #include "base/image.h"
 #include "base/point2d.h"
 #include "base/point3d.h"
+#include "base/point3d_index.h"
 #include "base/track.h"
 #include "util/alignment.h"
+#include "util/slot_map.h"
 #include "util/types.h"
 
 namespace colmap {
@@ -96,20 +98,33 @@ class Reconstruction {
   inline const EIGEN_STL_UMAP(camera_t, class Camera) & Cameras() const;
   inline const EIGEN_STL_UMAP(image_t, class Image) & Images() const;
   inline const std::vector<image_t>& RegImageIds() const;
-  inline const EIGEN_STL_UMAP(point3D_t, class Point3D) & Points3D() const;
+  inline const SlotMap<point3D_t, class Point3D>& Points3D() const;
   inline const std::unordered_map<image_pair_t, ImagePairStat>& ImagePairs()
       const;
 
   // Identifiers of all 3D points.
   std::unordered_set<point3D_t> Point3DIds() const;
 
+  // The images that observe 3D points in common with the given image and the
+  // number of their shared observations, i.e. the number of pairs of
+  // observations of the same 3D points in both images. The covisibility is
+  // maintained incrementally between `SetUp` and `TearDown`.
+  const std::unordered_map<image_t, size_t>& CovisibleImages(
+      const image_t image_id) const;
+
+  // Unregistered images, whose number of visible 3D points or visibility
+  // score changed since the last call to `ClearModifiedVisibilityImageIds`.
+  inline const std::unordered_set<image_t>& ModifiedVisibilityImageIds() const;
+  void ClearModifiedVisibilityImageIds();
+
   // Check whether specific object exists.
   inline bool ExistsCamera(const camera_t camera_id) const;
   inline bool ExistsImage(const image_t image_id) const;
   inline bool ExistsPoint3D(const point3D_t point3D_id) const;
   inline bool ExistsImagePair(const image_pair_t pair_id) const;
 
-  // Load data from given `DatabaseCache`.
+  // Load data from given `DatabaseCache`. The image points are shared with
+  // the cache until the images are registered or their points are modified.
   void Load(const DatabaseCache& database_cache);
 
   // Setup all relevant data structures before reconstruction. Note the
@@ -131,6 +146,14 @@ class Reconstruction {
   // Add new image.
   void AddImage(const class Image& image);
 
+  // Add a new image to a reconstruction that was already set up, e.g., for
+  // images that arrive during the reconstruction. The image and its
+  // correspondences must have been added to the correspondence graph and its
+  // camera to the reconstruction before. Updates the correspondence statistics
+  // of the image and its matched images and the visibility of the already
+  // triangulated correspondences in the new image.
+  void AddImageAfterSetUp(const class Image& image);
+
   // Add new 3D object, and return its unique ID.
   point3D_t AddPoint3D(
       const Eigen::Vector3d& xyz, const Track& track,
@@ -156,6 +179,27 @@ class Reconstruction {
   // Delete all 2D points of all images and all 3D points.
   void DeleteAllPoints2DAndPoints3D();
 
+  // Maintain a voxel hash of the 3D point positions with the given voxel size
+  // to accelerate spatial queries. The index follows the added, merged, and
+  // deleted 3D points and the transformations of the entire reconstruction.
+  // Positions that are changed in-place, e.g., by bundle adjustment, are only
+  // re-indexed by `UpdatePoint3DIndex`. A non-positive size disables it.
+  void SetPoint3DIndexVoxelSize(const double voxel_size);
+  void UpdatePoint3DIndex();
+
+  // Find the 3D points within the given distance of a position. Uses the
+  // voxel hash if enabled, and otherwise a linear search.
+  std::vector<point3D_t> FindPoints3DInRadius(const Eigen::Vector3d& xyz,
+                                              const double radius) const;
+
+  // Merge near-coincident 3D points that are not connected through the
+  // correspondences, e.g., duplicates after merging reconstructions. Each 3D
+  // point is merged with its closest 3D point within `max_distance` that is
+  // not observed in any of the same images.
+  //
+  // @return    The number of merged pairs of 3D points.
+  size_t MergeNearbyPoints3D(const double max_distance);
+
   // Register an existing image.
   void RegisterImage(const image_t image_id);
 
@@ -189,6 +233,13 @@ class Reconstruction {
   bool Merge(const Reconstruction& reconstruction,
              const double max_reproj_error);
 
+  // Merge the given reconstruction into this reconstruction as in `Merge`
+  // using a previously computed alignment from the given reconstruction to
+  // this reconstruction, see `ComputeAlignmentBetweenReconstructions`.
+  void MergeWithAlignment(const Reconstruction& reconstruction,
+                          const Eigen::Matrix3x4d& alignment,
+                          const double max_reproj_error);
+
   // Align the given reconstruction with a set of pre-defined camera positions.
   // Assuming that locations[i] gives the 3D coordinates of the center
   // of projection of the image with name image_names[i].
@@ -196,11 +247,14 @@ class Reconstruction {
              const std::vector<Eigen::Vector3d>& locations,
              const int min_common_images);
 
-  // Robust alignment using RANSAC.
+  // Robust alignment using RANSAC. For more than `max_num_samples` common
+  // images, RANSAC runs on a random subset of them and the alignment is
+  // refined using all inliers, see `EstimateSimilarityTransformRobust`.
   bool AlignRobust(const std::vector<std::string>& image_names,
                    const std::vector<Eigen::Vector3d>& locations,
                    const int min_common_images,
-                   const RANSACOptions& ransac_options);
+                   const RANSACOptions& ransac_options,
+                   const size_t max_num_samples = 0);
 
   // Find specific image by name. Note that this uses linear search.
   const class Image* FindImageWithName(const std::string& name) const;
@@ -260,6 +314,24 @@ class Reconstruction {
   void WriteText(const std::string& path) const;
   void WriteBinary(const std::string& path) const;
 
+  // The content hashes of all objects recorded in a journal so far.
+  struct JournalState {
+    std::unordered_map<camera_t, size_t> camera_hashes;
+    std::unordered_map<image_t, size_t> image_hashes;
+    std::unordered_map<point3D_t, size_t> point3D_hashes;
+  };
+
+  // Append a checkpoint to an append-only journal of the reconstruction. The
+  // checkpoint only contains the cameras, registered images, and 3D points
+  // that were added or changed since the previous checkpoint with the same
+  // state, and the identifiers of the removed images and 3D points. The
+  // records are in the same format as in the binary model.
+  void WriteJournalCheckpoint(JournalState* state, std::ostream* stream) const;
+
+  // Read the state of the last complete checkpoint of a journal. A checkpoint
+  // at the end of the file that was not completely written is ignored.
+  void ReadJournal(const std::string& path);
+
   // Convert 3D points in reconstruction to PLY point cloud.
   std::vector<PlyPoint> ConvertToPLY() const;
 
@@ -273,6 +345,8 @@ class Reconstruction {
   bool ExportBundler(const std::string& path,
                      const std::string& list_path) const;
   void ExportPLY(const std::string& path) const;
+  // Export the 3D points as octree tiles to the directory at the given path.
+  void ExportOctreeTiles(const std::string& path) const;
   void ExportVRML(const std::string& images_path,
                   const std::string& points3D_path, const double image_scale,
                   const Eigen::Vector3d& image_rgb) const;
@@ -289,11 +363,19 @@ class Reconstruction {
   bool ExtractColorsForImage(const image_t image_id, const std::string& path);
 
   // Extract colors for all 3D points by computing the mean color of all images.
+  // The images are decoded and sampled in parallel, while the colors of the
+  // already sampled images are accumulated.
   //
   // @param path          Absolute or relative path to root folder of image.
   //                      The image path is determined by concatenating the
   //                      root path and the name of the image.
-  void ExtractColorsForAllImages(const std::string& path);
+  // @param max_image_size  If positive, JPEG images are decoded at a reduced
+  //                      scale whose larger dimension is at least this size,
+  //                      see `Bitmap::Read`.
+  // @param num_threads   The number of threads for decoding and sampling.
+  void ExtractColorsForAllImages(const std::string& path,
+                                 const int max_image_size = -1,
+                                 const int num_threads = -1);
 
   // Create all image sub-directories in the given path.
   void CreateImageDirs(const std::string& path) const;
@@ -306,6 +388,17 @@ class Reconstruction {
       const double max_reproj_error,
       const std::unordered_set<point3D_t>& point3D_ids);
 
+  // The projection centers of the registered images with the given names and
+  // the corresponding locations, ignoring duplicate names.
+  void FindRegImageLocations(const std::vector<std::string>& image_names,
+                             const std::vector<Eigen::Vector3d>& locations,
+                             std::vector<Eigen::Vector3d>* src,
+                             std::vector<Eigen::Vector3d>* dst) const;
+
+  // The given 3D points that exist in the reconstruction.
+  std::vector<point3D_t> FindExistingPoints3D(
+      const std::unordered_set<point3D_t>& point3D_ids) const;
+
   void ReadCamerasText(const std::string& path);
   void ReadImagesText(const std::string& path);
   void ReadPoints3DText(const std::string& path);
@@ -326,21 +419,79 @@ class Reconstruction {
   void ResetTriObservations(const image_t image_id, const point2D_t point2D_idx,
                             const bool is_deleted_point3D);
 
+  // Add or remove the shared observations of an observation in the given image
+  // with the given observations of the same 3D point.
+  void UpdateCovisibility(const image_t image_id,
+                          TrackElements::const_iterator begin,
+                          TrackElements::const_iterator end,
+                          const bool is_added);
+  void UpdateCovisibility(const Track& track, const bool is_added);
+
   const CorrespondenceGraph* correspondence_graph_;
 
   EIGEN_STL_UMAP(camera_t, class Camera) cameras_;
   EIGEN_STL_UMAP(image_t, class Image) images_;
-  EIGEN_STL_UMAP(point3D_t, class Point3D) points3D_;
+  SlotMap<point3D_t, class Point3D> points3D_;
 
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
 
+  // The number of shared observations between covisible images.
+  std::unordered_map<image_t, std::unordered_map<image_t, size_t>>
+      covisibility_graph_;
+
   // { image_id, ... } where `images_.at(image_id).registered == true`.
   std::vector<image_t> reg_image_ids_;
 
+  // Unregistered images, whose correspondences were modified.
+  std::unordered_set<image_t> modified_visibility_image_ids_;
+
   // Total number of added 3D points, used to generate unique identifiers.
   point3D_t num_added_points3D_;
+
+  // Optional voxel hash of the 3D point positions.
+  Point3DIndex point3D_index_;
 };
 
+// Streaming operations on the files of a binary model, which avoid loading and
+// rewriting the entire reconstruction. The model files are memory-mapped and
+// traversed record by record, so that, e.g., filtering a few images from a
+// model with millions of 3D points costs a few sequential passes over the
+// files without building any of the reconstruction's data structures.
+
+// Read the names of the registered images in the binary model at `path`.
+std::unordered_map<image_t, std::string> ReadBinaryModelImageNames(
+    const std::string& path);
+
+// Find the images of the binary model at `path` that are removed by
+// `Reconstruction::FilterImages` and, thereafter, the images with fewer than
+// `min_num_observations` 3D points.
+std::vector<image_t> FindFilteredBinaryModelImages(
+    const std::string& path, const double min_focal_length_ratio,
+    const double max_focal_length_ratio, const double max_extra_param,
+    const size_t min_num_observations);
+
+// De-register the given images from the binary model at `input_path` and
+// write the model to `output_path`, which may be the same path. The result is
+// the same as de-registering the images from the loaded reconstruction and
+// writing it, i.e. the observations of the images are removed and the 3D
+// points with fewer than two remaining observations are deleted. Records that
+// are not affected by the deletion are copied verbatim.
+void DeleteBinaryModelImages(const std::string& input_path,
+                             const std::string& output_path,
+                             const std::unordered_set<image_t>& image_ids);
+
+// Read the projection centers of the registered images in the binary model at
+// `path` by image name.
+std::unordered_map<std::string, Eigen::Vector3d>
+ReadBinaryModelProjectionCenters(const std::string& path);
+
+// Apply the 3D similarity transformation to all images and points of the
+// binary model at `input_path` and write the model to `output_path`, which may
+// be the same path. Only the poses and point positions are re-encoded.
+void TransformBinaryModel(const std::string& input_path,
+                          const std::string& output_path,
+                          const SimilarityTransform3& tform);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -415,7 +566,7 @@ const std::vector<image_t>& Reconstruction::RegImageIds() const {
   return reg_image_ids_;
 }
 
-const EIGEN_STL_UMAP(point3D_t, Point3D) & Reconstruction::Points3D() const {
+const SlotMap<point3D_t, Point3D>& Reconstruction::Points3D() const {
   return points3D_;
 }
 
@@ -424,6 +575,11 @@ Reconstruction::ImagePairs() const {
   return image_pair_stats_;
 }
 
+const std::unordered_set<image_t>& Reconstruction::ModifiedVisibilityImageIds()
+    const {
+  return modified_visibility_image_ids_;
+}
+
 bool Reconstruction::ExistsCamera(const camera_t camera_id) const {
   return cameras_.find(camera_id) != cameras_.end();
 }
@@ -32,6 +32,11 @@
 #define TEST_NAME "base/reconstruction"
 #include "util/testing.h"
 
+#include <algorithm>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
 #include "base/camera_models.h"
 #include "base/correspondence_graph.h"
 #include "base/pose.h"
@@ -109,6 +114,41 @@ BOOST_AUTO_TEST_CASE(TestAddImage) {
   BOOST_CHECK_EQUAL(reconstruction.NumImagePairs(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestAddImageAfterSetUp) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, &reconstruction, &correspondence_graph);
+  Track track;
+  track.AddElement(1, 0);
+  track.AddElement(2, 0);
+  reconstruction.AddPoint3D(Eigen::Vector3d::Random(), track);
+  reconstruction.ClearModifiedVisibilityImageIds();
+
+  Image image;
+  image.SetImageId(3);
+  image.SetCameraId(1);
+  image.SetName("image3");
+  image.SetPoints2D(std::vector<Eigen::Vector2d>(10, Eigen::Vector2d::Zero()));
+  correspondence_graph.AddImage(3, 10);
+  correspondence_graph.AddCorrespondences(
+      1, 3, {FeatureMatch(0, 0), FeatureMatch(1, 1)});
+  correspondence_graph.UpdateNumObservations(1);
+  correspondence_graph.UpdateNumObservations(3);
+  reconstruction.AddImageAfterSetUp(image);
+
+  BOOST_CHECK(reconstruction.ExistsImage(3));
+  BOOST_CHECK(!reconstruction.Image(3).IsRegistered());
+  BOOST_CHECK_EQUAL(reconstruction.Image(3).NumObservations(), 2);
+  BOOST_CHECK_EQUAL(reconstruction.Image(3).NumCorrespondences(), 2);
+  BOOST_CHECK_EQUAL(reconstruction.Image(3).NumVisiblePoints3D(), 1);
+  BOOST_CHECK_EQUAL(reconstruction.Image(1).NumObservations(), 2);
+  BOOST_CHECK_EQUAL(reconstruction.Image(1).NumCorrespondences(), 2);
+  BOOST_CHECK_EQUAL(reconstruction.ImagePair(1, 3).num_total_corrs, 2);
+  BOOST_CHECK_EQUAL(reconstruction.ImagePair(1, 3).num_tri_corrs, 0);
+  BOOST_CHECK_EQUAL(reconstruction.ModifiedVisibilityImageIds().size(), 1);
+  BOOST_CHECK_EQUAL(reconstruction.ModifiedVisibilityImageIds().count(3), 1);
+}
+
 BOOST_AUTO_TEST_CASE(TestAddPoint3D) {
   Reconstruction reconstruction;
   const point3D_t point3D_id =
@@ -210,6 +250,42 @@ BOOST_AUTO_TEST_CASE(TestDeleteObservation) {
   BOOST_CHECK(!reconstruction.Image(point3D_id).Point2D(2).HasPoint3D());
 }
 
+BOOST_AUTO_TEST_CASE(TestCovisibleImages) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, &reconstruction, &correspondence_graph);
+  BOOST_CHECK(reconstruction.CovisibleImages(1).empty());
+  Track track;
+  track.AddElement(1, 0);
+  track.AddElement(2, 0);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Random(), track);
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Random(), Track());
+  reconstruction.AddObservation(point3D_id2, TrackElement(1, 1));
+  reconstruction.AddObservation(point3D_id2, TrackElement(2, 1));
+  reconstruction.AddObservation(point3D_id2, TrackElement(3, 1));
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(1).size(), 2);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(1).at(2), 2);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(1).at(3), 1);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(3).at(2), 1);
+  reconstruction.DeleteObservation(3, 1);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(1).size(), 1);
+  BOOST_CHECK(reconstruction.CovisibleImages(3).empty());
+  const point3D_t merged_point3D_id =
+      reconstruction.MergePoints3D(point3D_id1, point3D_id2);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(1).at(2), 4);
+  reconstruction.DeletePoint3D(merged_point3D_id);
+  BOOST_CHECK(reconstruction.CovisibleImages(1).empty());
+  BOOST_CHECK(reconstruction.CovisibleImages(2).empty());
+
+  // The covisibility of existing 3D points is restored on set up.
+  reconstruction.AddPoint3D(Eigen::Vector3d::Random(), track);
+  reconstruction.TearDown();
+  reconstruction.SetUp(&correspondence_graph);
+  BOOST_CHECK_EQUAL(reconstruction.CovisibleImages(2).at(1), 1);
+}
+
 BOOST_AUTO_TEST_CASE(TestRegisterImage) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -355,6 +431,55 @@ BOOST_AUTO_TEST_CASE(TestFilterPoints3D) {
   BOOST_CHECK_EQUAL(reconstruction.NumPoints3D(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestFilterPoints3DMany) {
+  // Enough 3D points to filter them in multiple parallel chunks.
+  const size_t kNumPoints3D = 3000;
+
+  Reconstruction reconstruction;
+  Camera camera;
+  camera.SetCameraId(1);
+  camera.InitializeWithName("PINHOLE", 1, 1, 1);
+  reconstruction.AddCamera(camera);
+  for (image_t image_id = 1; image_id <= 3; ++image_id) {
+    Image image;
+    image.SetImageId(image_id);
+    image.SetCameraId(1);
+    image.SetName("image" + std::to_string(image_id));
+    // The observations in the third image are offset by 0.2 pixels.
+    image.SetPoints2D(std::vector<Eigen::Vector2d>(
+        kNumPoints3D, Eigen::Vector2d(image_id == 3 ? 0.2 : 0, 0)));
+    reconstruction.AddImage(image);
+    reconstruction.RegisterImage(image_id);
+  }
+
+  std::unordered_set<point3D_t> point3D_ids;
+  for (point2D_t point2D_idx = 0; point2D_idx < kNumPoints3D; ++point2D_idx) {
+    // Odd points have a reprojection error of at least 0.2 pixels in all
+    // images, even points only in the third image.
+    const Eigen::Vector3d xyz(point2D_idx % 2 == 0 ? -0.5 : -0.7, -0.5, 1);
+    Track track;
+    track.AddElement(1, point2D_idx);
+    track.AddElement(2, point2D_idx);
+    track.AddElement(3, point2D_idx);
+    point3D_ids.insert(reconstruction.AddPoint3D(xyz, track));
+  }
+
+  BOOST_CHECK_EQUAL(reconstruction.FilterPoints3D(0.1, 0.0, point3D_ids),
+                    kNumPoints3D / 2 + 3 * kNumPoints3D / 2);
+  BOOST_CHECK_EQUAL(reconstruction.NumPoints3D(), kNumPoints3D / 2);
+  BOOST_CHECK_EQUAL(reconstruction.Image(1).NumPoints3D(), kNumPoints3D / 2);
+  BOOST_CHECK_EQUAL(reconstruction.Image(3).NumPoints3D(), 0);
+  for (const auto& point3D : reconstruction.Points3D()) {
+    BOOST_CHECK_EQUAL(point3D.second.Track().Length(), 2);
+    BOOST_CHECK_EQUAL(point3D.second.Error(), 0);
+  }
+
+  // All poses are identical and there is no triangulation angle.
+  BOOST_CHECK_EQUAL(reconstruction.FilterPoints3D(0.1, 1e-3, point3D_ids),
+                    kNumPoints3D / 2);
+  BOOST_CHECK_EQUAL(reconstruction.NumPoints3D(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(TestFilterPoints3DInImages) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -532,3 +657,392 @@ BOOST_AUTO_TEST_CASE(TestComputeMeanReprojectionError) {
   reconstruction.Point3D(point3D_id1).SetError(2.0);
   BOOST_CHECK_EQUAL(reconstruction.ComputeMeanReprojectionError(), 2.0);
 }
+
+BOOST_AUTO_TEST_CASE(TestJournal) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, &reconstruction, &correspondence_graph);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(1, 2, 3), Track());
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(4, 5, 6), Track());
+  reconstruction.AddObservation(point3D_id1, TrackElement(1, 0));
+  reconstruction.AddObservation(point3D_id1, TrackElement(2, 0));
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("reconstruction_%%%%-%%%%-%%%%"))
+          .string();
+
+  Reconstruction::JournalState journal_state;
+  std::ofstream file(path, std::ios::binary);
+  reconstruction.WriteJournalCheckpoint(&journal_state, &file);
+  file.flush();
+  const size_t checkpoint_size1 = boost::filesystem::file_size(path);
+
+  // An unchanged reconstruction only appends an empty checkpoint.
+  reconstruction.WriteJournalCheckpoint(&journal_state, &file);
+  file.flush();
+  const size_t checkpoint_size2 =
+      boost::filesystem::file_size(path) - checkpoint_size1;
+  BOOST_CHECK_LT(checkpoint_size2, checkpoint_size1);
+
+  reconstruction.Image(3).Tvec(0) = 10;
+  reconstruction.Point3D(point3D_id2).XYZ()(0) = 7;
+  reconstruction.DeletePoint3D(point3D_id1);
+  reconstruction.DeRegisterImage(1);
+  const point3D_t point3D_id3 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(8, 9, 10), Track());
+  reconstruction.AddObservation(point3D_id3, TrackElement(2, 1));
+  reconstruction.WriteJournalCheckpoint(&journal_state, &file);
+  file.close();
+
+  {
+    Reconstruction read_reconstruction;
+    read_reconstruction.ReadJournal(path);
+    BOOST_CHECK_EQUAL(read_reconstruction.NumCameras(), 1);
+    BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 2);
+    BOOST_CHECK(!read_reconstruction.ExistsImage(1));
+    BOOST_CHECK_EQUAL(read_reconstruction.Image(3).Tvec(0), 10);
+    BOOST_CHECK_EQUAL(read_reconstruction.Image(2).Point2D(1).Point3DId(),
+                      point3D_id3);
+    BOOST_CHECK_EQUAL(read_reconstruction.Image(2).NumPoints3D(), 1);
+    BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 2);
+    BOOST_CHECK(!read_reconstruction.ExistsPoint3D(point3D_id1));
+    BOOST_CHECK_EQUAL(read_reconstruction.Point3D(point3D_id2).XYZ()(0), 7);
+    BOOST_CHECK_EQUAL(
+        read_reconstruction.Point3D(point3D_id3).Track().Length(), 1);
+  }
+
+  // An incompletely written checkpoint is ignored.
+  boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 1);
+
+  {
+    Reconstruction read_reconstruction;
+    read_reconstruction.ReadJournal(path);
+    BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 3);
+    BOOST_CHECK(read_reconstruction.ExistsImage(1));
+    BOOST_CHECK_EQUAL(read_reconstruction.Image(3).Tvec(0), 0);
+    BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 2);
+    BOOST_CHECK_EQUAL(
+        read_reconstruction.Point3D(point3D_id1).Track().Length(), 2);
+    BOOST_CHECK_EQUAL(read_reconstruction.Point3D(point3D_id2).XYZ()(0), 4);
+  }
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWriteBinary) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, &reconstruction, &correspondence_graph);
+  reconstruction.Image(2).Tvec(1) = 5;
+  // Enough 3D points to parse the records in multiple blocks.
+  for (size_t i = 0; i < 10000; ++i) {
+    reconstruction.AddPoint3D(Eigen::Vector3d(i, 2, 3), Track());
+  }
+  const point3D_t point3D_id =
+      reconstruction.AddPoint3D(Eigen::Vector3d(4, 5, 6), Track());
+  reconstruction.AddObservation(point3D_id, TrackElement(1, 2));
+  reconstruction.AddObservation(point3D_id, TrackElement(3, 4));
+  reconstruction.Point3D(point3D_id).Color() = Eigen::Vector3ub(1, 2, 3);
+  reconstruction.Point3D(point3D_id).SetError(0.5);
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("reconstruction_%%%%-%%%%-%%%%"))
+          .string();
+  boost::filesystem::create_directory(path);
+  reconstruction.WriteBinary(path);
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.ReadBinary(path);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 3);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 10001);
+  for (const auto& image : reconstruction.Images()) {
+    const class Image& read_image = read_reconstruction.Image(image.first);
+    BOOST_CHECK(read_image.IsRegistered());
+    BOOST_CHECK_EQUAL(read_image.Name(), image.second.Name());
+    BOOST_CHECK_EQUAL(read_image.Tvec(), image.second.Tvec());
+    BOOST_CHECK_EQUAL(read_image.NumPoints2D(), image.second.NumPoints2D());
+    BOOST_CHECK_EQUAL(read_image.NumPoints3D(), image.second.NumPoints3D());
+  }
+  for (const auto& point3D : reconstruction.Points3D()) {
+    const class Point3D& read_point3D =
+        read_reconstruction.Point3D(point3D.first);
+    BOOST_CHECK_EQUAL(read_point3D.XYZ(), point3D.second.XYZ());
+    BOOST_CHECK_EQUAL(read_point3D.Color(), point3D.second.Color());
+    BOOST_CHECK_EQUAL(read_point3D.Error(), point3D.second.Error());
+    BOOST_CHECK_EQUAL(read_point3D.Track().Length(),
+                      point3D.second.Track().Length());
+  }
+  BOOST_CHECK_EQUAL(read_reconstruction.Image(3).Point2D(4).Point3DId(),
+                    point3D_id);
+
+  // New 3D points do not overwrite the read 3D points.
+  BOOST_CHECK_GT(read_reconstruction.AddPoint3D(Eigen::Vector3d::Zero(),
+                                                Track()),
+                 point3D_id);
+
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestDeleteBinaryModelImages) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(4, &reconstruction, &correspondence_graph);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Zero(), Track());
+  reconstruction.AddObservation(point3D_id1, TrackElement(1, 0));
+  reconstruction.AddObservation(point3D_id1, TrackElement(2, 0));
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Zero(), Track());
+  reconstruction.AddObservation(point3D_id2, TrackElement(1, 1));
+  reconstruction.AddObservation(point3D_id2, TrackElement(2, 1));
+  reconstruction.AddObservation(point3D_id2, TrackElement(3, 1));
+  const point3D_t point3D_id3 =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Zero(), Track());
+  reconstruction.AddObservation(point3D_id3, TrackElement(3, 2));
+  reconstruction.AddObservation(point3D_id3, TrackElement(4, 2));
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("reconstruction_%%%%-%%%%-%%%%"))
+          .string();
+  const std::string output_path = path + "_output";
+  boost::filesystem::create_directory(path);
+  boost::filesystem::create_directory(output_path);
+  reconstruction.WriteBinary(path);
+
+  const auto image_names = ReadBinaryModelImageNames(path);
+  BOOST_CHECK_EQUAL(image_names.size(), 4);
+  BOOST_CHECK_EQUAL(image_names.at(3), "image3");
+
+  // Image 4 has a single observation after deleting image 1.
+  const std::vector<image_t> filtered_image_ids =
+      FindFilteredBinaryModelImages(path, 0.1, 10, 1, 2);
+  BOOST_CHECK_EQUAL(filtered_image_ids.size(), 1);
+  BOOST_CHECK_EQUAL(filtered_image_ids.at(0), 4);
+
+  DeleteBinaryModelImages(path, output_path, {1});
+  reconstruction.DeRegisterImage(1);
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.ReadBinary(output_path);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumCameras(), 1);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 3);
+  BOOST_CHECK(!read_reconstruction.ExistsImage(1));
+  BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(),
+                    reconstruction.NumPoints3D());
+  BOOST_CHECK(!read_reconstruction.ExistsPoint3D(point3D_id1));
+  BOOST_CHECK_EQUAL(read_reconstruction.Point3D(point3D_id2).Track().Length(),
+                    2);
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    BOOST_CHECK_EQUAL(read_reconstruction.Image(image_id).NumPoints3D(),
+                      reconstruction.Image(image_id).NumPoints3D());
+  }
+
+  // Delete in-place.
+  DeleteBinaryModelImages(output_path, output_path, {4});
+  read_reconstruction = Reconstruction();
+  read_reconstruction.ReadBinary(output_path);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 2);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 1);
+  BOOST_CHECK(!read_reconstruction.ExistsPoint3D(point3D_id3));
+  BOOST_CHECK_EQUAL(read_reconstruction.Image(3).NumPoints3D(), 1);
+
+  boost::filesystem::remove_all(path);
+  boost::filesystem::remove_all(output_path);
+}
+
+BOOST_AUTO_TEST_CASE(TestFindPoints3DInRadius) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(1, &reconstruction, &correspondence_graph);
+  const point3D_t point3D_id1 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(0, 0, 0), Track());
+  const point3D_t point3D_id2 =
+      reconstruction.AddPoint3D(Eigen::Vector3d(0.5, 0, 0), Track());
+  reconstruction.AddPoint3D(Eigen::Vector3d(2, 0, 0), Track());
+
+  for (const double voxel_size : {0.0, 0.1, 1.0, 10.0}) {
+    reconstruction.SetPoint3DIndexVoxelSize(voxel_size);
+    auto point3D_ids =
+        reconstruction.FindPoints3DInRadius(Eigen::Vector3d(0.1, 0, 0), 0.5);
+    std::sort(point3D_ids.begin(), point3D_ids.end());
+    BOOST_CHECK_EQUAL(point3D_ids.size(), 2);
+    BOOST_CHECK_EQUAL(point3D_ids[0], point3D_id1);
+    BOOST_CHECK_EQUAL(point3D_ids[1], point3D_id2);
+  }
+
+  reconstruction.SetPoint3DIndexVoxelSize(1.0);
+  reconstruction.DeletePoint3D(point3D_id1);
+  BOOST_CHECK_EQUAL(
+      reconstruction.FindPoints3DInRadius(Eigen::Vector3d(0.1, 0, 0), 0.5)
+          .size(),
+      1);
+
+  // In-place changes are only found after updating the index.
+  reconstruction.Point3D(point3D_id2).XYZ() = Eigen::Vector3d(5, 0, 0);
+  BOOST_CHECK(
+      reconstruction.FindPoints3DInRadius(Eigen::Vector3d(5, 0, 0), 0.5)
+          .empty());
+  reconstruction.UpdatePoint3DIndex();
+  BOOST_CHECK_EQUAL(
+      reconstruction.FindPoints3DInRadius(Eigen::Vector3d(5, 0, 0), 0.5)
+          .size(),
+      1);
+}
+
+BOOST_AUTO_TEST_CASE(TestMergeNearbyPoints3D) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(4, &reconstruction, &correspondence_graph);
+  Track track1;
+  track1.AddElement(1, 0);
+  track1.AddElement(2, 0);
+  reconstruction.AddPoint3D(Eigen::Vector3d(0, 0, 0), track1);
+  Track track2;
+  track2.AddElement(3, 0);
+  track2.AddElement(4, 0);
+  reconstruction.AddPoint3D(Eigen::Vector3d(0.01, 0, 0), track2);
+  // Observed in a common image and not merged.
+  Track track3;
+  track3.AddElement(1, 1);
+  track3.AddElement(3, 1);
+  reconstruction.AddPoint3D(Eigen::Vector3d(0, 0.01, 0), track3);
+  // Too far away and not merged.
+  Track track4;
+  track4.AddElement(2, 2);
+  track4.AddElement(4, 2);
+  reconstruction.AddPoint3D(Eigen::Vector3d(1, 0, 0), track4);
+
+  BOOST_CHECK_EQUAL(reconstruction.MergeNearbyPoints3D(0.1), 1);
+  BOOST_CHECK_EQUAL(reconstruction.NumPoints3D(), 3);
+  BOOST_CHECK_EQUAL(
+      reconstruction.Image(1).Point2D(0).Point3DId(),
+      reconstruction.Image(4).Point2D(0).Point3DId());
+  BOOST_CHECK_EQUAL(reconstruction.Point3D(
+                        reconstruction.Image(1).Point2D(0).Point3DId())
+                        .Track()
+                        .Length(),
+                    4);
+  BOOST_CHECK_EQUAL(reconstruction.MergeNearbyPoints3D(0.1), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMergeWithAlignment) {
+  Reconstruction reconstruction1;
+  CorrespondenceGraph correspondence_graph1;
+  GenerateReconstruction(3, &reconstruction1, &correspondence_graph1);
+  // In front of all cameras, so that the points pass the reprojection filter.
+  const Eigen::Vector3d kXYZ(0, 0, 1);
+  Track track1;
+  track1.AddElement(1, 1);
+  track1.AddElement(2, 1);
+  const point3D_t point3D_id1 = reconstruction1.AddPoint3D(kXYZ, track1);
+  Track track2;
+  track2.AddElement(1, 2);
+  track2.AddElement(3, 3);
+  reconstruction1.AddPoint3D(kXYZ, track2);
+  Track track3;
+  track3.AddElement(2, 2);
+  track3.AddElement(3, 4);
+  reconstruction1.AddPoint3D(kXYZ, track3);
+
+  Reconstruction reconstruction2;
+  CorrespondenceGraph correspondence_graph2;
+  GenerateReconstruction(4, &reconstruction2, &correspondence_graph2);
+  // Observed in a common image without 3D point and a missing image.
+  Track track4;
+  track4.AddElement(3, 0);
+  track4.AddElement(4, 0);
+  reconstruction2.AddPoint3D(kXYZ, track4);
+  // Merged with the first 3D point.
+  Track track5;
+  track5.AddElement(1, 1);
+  track5.AddElement(4, 1);
+  reconstruction2.AddPoint3D(kXYZ, track5);
+  // Conflicting with two different 3D points and not merged.
+  Track track6;
+  track6.AddElement(1, 2);
+  track6.AddElement(2, 2);
+  reconstruction2.AddPoint3D(kXYZ, track6);
+
+  // The correspondence graph of a set up reconstruction contains all images.
+  correspondence_graph1.AddImage(4, 10);
+
+  reconstruction1.MergeWithAlignment(
+      reconstruction2, SimilarityTransform3().Matrix().topRows<3>(), 1.0);
+
+  BOOST_CHECK_EQUAL(reconstruction1.NumRegImages(), 4);
+  BOOST_CHECK(reconstruction1.IsImageRegistered(4));
+  BOOST_CHECK_EQUAL(reconstruction1.NumPoints3D(), 4);
+  BOOST_CHECK(!reconstruction1.ExistsPoint3D(point3D_id1));
+  BOOST_CHECK(reconstruction1.Image(3).Point2D(0).HasPoint3D());
+  BOOST_CHECK_EQUAL(reconstruction1.Image(3).Point2D(0).Point3DId(),
+                    reconstruction1.Image(4).Point2D(0).Point3DId());
+  const point3D_t merged_point3D_id =
+      reconstruction1.Image(4).Point2D(1).Point3DId();
+  BOOST_CHECK_EQUAL(reconstruction1.Image(1).Point2D(1).Point3DId(),
+                    merged_point3D_id);
+  BOOST_CHECK_EQUAL(reconstruction1.Image(2).Point2D(1).Point3DId(),
+                    merged_point3D_id);
+  BOOST_CHECK_EQUAL(
+      reconstruction1.Point3D(merged_point3D_id).Track().Length(), 3);
+  BOOST_CHECK(!reconstruction1.Image(4).Point2D(2).HasPoint3D());
+  BOOST_CHECK_NE(reconstruction1.Image(1).Point2D(2).Point3DId(),
+                 reconstruction1.Image(2).Point2D(2).Point3DId());
+}
+
+BOOST_AUTO_TEST_CASE(TestTransformBinaryModel) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, &reconstruction, &correspondence_graph);
+  reconstruction.Image(2).Tvec(1) = 5;
+  const point3D_t point3D_id =
+      reconstruction.AddPoint3D(Eigen::Vector3d(4, 5, 6), Track());
+  reconstruction.AddObservation(point3D_id, TrackElement(1, 2));
+  reconstruction.AddObservation(point3D_id, TrackElement(3, 4));
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("reconstruction_%%%%-%%%%-%%%%"))
+          .string();
+  const std::string output_path = path + "_output";
+  boost::filesystem::create_directory(path);
+  boost::filesystem::create_directory(output_path);
+  reconstruction.WriteBinary(path);
+
+  const SimilarityTransform3 tform(2, Eigen::Vector4d(0.1, 0.3, 0.2, 0.4),
+                                   Eigen::Vector3d(100, 10, 0.5));
+  TransformBinaryModel(path, output_path, tform);
+  reconstruction.Transform(tform);
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.ReadBinary(output_path);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumRegImages(), 3);
+  BOOST_CHECK_EQUAL(read_reconstruction.NumPoints3D(), 1);
+  BOOST_CHECK_LT((read_reconstruction.Point3D(point3D_id).XYZ() -
+                  reconstruction.Point3D(point3D_id).XYZ())
+                     .norm(),
+                 1e-9);
+  BOOST_CHECK_EQUAL(read_reconstruction.Image(3).Point2D(4).Point3DId(),
+                    point3D_id);
+
+  const auto proj_centers = ReadBinaryModelProjectionCenters(output_path);
+  BOOST_CHECK_EQUAL(proj_centers.size(), 3);
+  for (const auto& image : reconstruction.Images()) {
+    BOOST_CHECK_LT((read_reconstruction.Image(image.first).Qvec() -
+                    image.second.Qvec())
+                       .norm(),
+                   1e-9);
+    BOOST_CHECK_LT((proj_centers.at(image.second.Name()) -
+                    image.second.ProjectionCenter())
+                       .norm(),
+                   1e-9);
+  }
+
+  boost::filesystem::remove_all(path);
+  boost::filesystem::remove_all(output_path);
+}
@@ -31,17 +31,22 @@
 
 #include "base/scene_clustering.h"
 
+#include <fstream>
 #include <set>
+#include <sstream>
 
 #include "base/database.h"
 #include "base/graph_cut.h"
+#include "util/misc.h"
 #include "util/random.h"
+#include "util/threading.h"
 
 namespace colmap {
 
 bool SceneClustering::Options::Check() const {
   CHECK_OPTION_GT(branching, 0);
   CHECK_OPTION_GE(image_overlap, 0);
+  CHECK_OPTION_GE(num_threads, -1);
   return true;
 }
 
@@ -67,15 +72,103 @@ void SceneClustering::Partition(
   root_cluster_.reset(new Cluster());
   root_cluster_->image_ids.insert(root_cluster_->image_ids.end(),
                                   image_ids.begin(), image_ids.end());
-  PartitionCluster(edges, num_inliers, root_cluster_.get());
+
+  struct PartitionTask {
+    Cluster* cluster = nullptr;
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> weights;
+    std::vector<std::vector<std::pair<int, int>>> child_edges;
+    std::vector<std::vector<int>> child_weights;
+    std::vector<std::vector<image_t>> overlapping_image_ids;
+  };
+
+  std::vector<PartitionTask> tasks(1);
+  tasks[0].cluster = root_cluster_.get();
+  tasks[0].edges = std::move(edges);
+  tasks[0].weights = num_inliers;
+
+  const int num_eff_threads = GetEffectiveNumThreads(options_.num_threads);
+
+  // Partition the hierarchy level by level, since the clusters on the same
+  // level are independent of each other. The edges of a level are released
+  // once its child clusters are created, so that the memory does not grow
+  // with the depth of the hierarchy.
+  std::vector<std::vector<PartitionTask>> partitioned_levels;
+  while (!tasks.empty()) {
+    const auto PartitionTaskCluster = [this, &tasks](const size_t task_idx) {
+      auto& task = tasks[task_idx];
+      PartitionCluster(task.edges, task.weights, task.cluster,
+                       &task.child_edges, &task.child_weights,
+                       &task.overlapping_image_ids);
+    };
+
+    const int num_workers =
+        std::min(num_eff_threads, static_cast<int>(tasks.size()));
+    if (num_workers <= 1) {
+      for (size_t i = 0; i < tasks.size(); ++i) {
+        PartitionTaskCluster(i);
+      }
+    } else {
+      ThreadPool thread_pool(num_workers);
+      for (size_t i = 0; i < tasks.size(); ++i) {
+        thread_pool.AddTask(PartitionTaskCluster, i);
+      }
+      thread_pool.Wait();
+    }
+
+    std::vector<PartitionTask> child_tasks;
+    for (auto& task : tasks) {
+      for (size_t i = 0; i < task.child_edges.size(); ++i) {
+        child_tasks.emplace_back();
+        child_tasks.back().cluster = &task.cluster->child_clusters[i];
+        child_tasks.back().edges = std::move(task.child_edges[i]);
+        child_tasks.back().weights = std::move(task.child_weights[i]);
+      }
+      std::vector<std::pair<int, int>>().swap(task.edges);
+      std::vector<int>().swap(task.weights);
+      std::vector<std::vector<std::pair<int, int>>>().swap(task.child_edges);
+      std::vector<std::vector<int>>().swap(task.child_weights);
+    }
+
+    partitioned_levels.push_back(std::move(tasks));
+    tasks = std::move(child_tasks);
+  }
+
+  // Recursively append the overlapping images to the child clusters and their
+  // children. The deepest levels are processed first to produce the same image
+  // order as a depth-first partitioning of the hierarchy.
+  std::function<void(const std::vector<image_t>&, Cluster*)>
+      InsertOverlappingImageIds =
+          [&](const std::vector<image_t>& overlapping_image_ids,
+              Cluster* cluster) {
+            cluster->image_ids.insert(cluster->image_ids.end(),
+                                      overlapping_image_ids.begin(),
+                                      overlapping_image_ids.end());
+            for (auto& child_cluster : cluster->child_clusters) {
+              InsertOverlappingImageIds(overlapping_image_ids, &child_cluster);
+            }
+          };
+
+  for (auto level = partitioned_levels.rbegin();
+       level != partitioned_levels.rend(); ++level) {
+    for (const auto& task : *level) {
+      for (size_t i = 0; i < task.overlapping_image_ids.size(); ++i) {
+        InsertOverlappingImageIds(task.overlapping_image_ids[i],
+                                  &task.cluster->child_clusters[i]);
+      }
+    }
+  }
 }
 
 void SceneClustering::PartitionCluster(
     const std::vector<std::pair<int, int>>& edges,
-    const std::vector<int>& weights, Cluster* cluster) {
+    const std::vector<int>& weights, Cluster* cluster,
+    std::vector<std::vector<std::pair<int, int>>>* child_edges,
+    std::vector<std::vector<int>>* child_weights,
+    std::vector<std::vector<image_t>>* overlapping_image_ids) const {
   CHECK_EQ(edges.size(), weights.size());
 
-  // If the cluster is small enough, we return from the recursive clustering.
+  // If the cluster is small enough, we stop the hierarchical clustering.
   if (edges.size() == 0 ||
       cluster->image_ids.size() <=
           static_cast<size_t>(options_.leaf_max_num_images)) {
@@ -96,29 +189,27 @@ void SceneClustering::PartitionCluster(
   }
 
   // Collect the edges based on whether they are inter or intra child clusters.
-  std::vector<std::vector<std::pair<int, int>>> child_edges(options_.branching);
-  std::vector<std::vector<int>> child_weights(options_.branching);
+  child_edges->clear();
+  child_edges->resize(options_.branching);
+  child_weights->clear();
+  child_weights->resize(options_.branching);
   std::vector<std::vector<std::pair<std::pair<int, int>, int>>>
       overlapping_edges(options_.branching);
   for (size_t i = 0; i < edges.size(); ++i) {
     const int label1 = labels.at(edges[i].first);
     const int label2 = labels.at(edges[i].second);
     if (label1 == label2) {
-      child_edges.at(label1).push_back(edges[i]);
-      child_weights.at(label1).push_back(weights[i]);
+      child_edges->at(label1).push_back(edges[i]);
+      child_weights->at(label1).push_back(weights[i]);
     } else {
       overlapping_edges.at(label1).emplace_back(edges[i], weights[i]);
       overlapping_edges.at(label2).emplace_back(edges[i], weights[i]);
     }
   }
 
-  // Recursively partition all the child clusters.
-  for (int i = 0; i < options_.branching; ++i) {
-    PartitionCluster(child_edges[i], child_weights[i],
-                     &cluster->child_clusters[i]);
-  }
-
+  overlapping_image_ids->clear();
   if (options_.image_overlap > 0) {
+    overlapping_image_ids->resize(options_.branching);
     for (int i = 0; i < options_.branching; ++i) {
       // Sort the overlapping edges by the number of inlier matches, such
       // that we add overlapping images with many common observations.
@@ -129,31 +220,21 @@ void SceneClustering::PartitionCluster(
                 });
 
       // Select overlapping edges at random and add image to cluster.
-      std::set<int> overlapping_image_ids;
+      std::set<int> child_overlapping_image_ids;
       for (const auto& edge : overlapping_edges[i]) {
         if (labels.at(edge.first.first) == i) {
-          overlapping_image_ids.insert(edge.first.second);
+          child_overlapping_image_ids.insert(edge.first.second);
         } else {
-          overlapping_image_ids.insert(edge.first.first);
+          child_overlapping_image_ids.insert(edge.first.first);
         }
-        if (overlapping_image_ids.size() >=
+        if (child_overlapping_image_ids.size() >=
             static_cast<size_t>(options_.image_overlap)) {
           break;
         }
       }
 
-      // Recursively append the overlapping images to cluster and its children.
-      std::function<void(Cluster*)> InsertOverlappingImageIds =
-          [&](Cluster* cluster) {
-            cluster->image_ids.insert(cluster->image_ids.end(),
-                                      overlapping_image_ids.begin(),
-                                      overlapping_image_ids.end());
-            for (auto& child_cluster : cluster->child_clusters) {
-              InsertOverlappingImageIds(&child_cluster);
-            }
-          };
-
-      InsertOverlappingImageIds(&cluster->child_clusters[i]);
+      overlapping_image_ids->at(i).assign(child_overlapping_image_ids.begin(),
+                                          child_overlapping_image_ids.end());
     }
   }
 }
@@ -194,4 +275,69 @@ std::vector<const SceneClustering::Cluster*> SceneClustering::GetLeafClusters()
   return leaf_clusters;
 }
 
+void SceneClustering::Read(const std::string& path) {
+  CHECK(!root_cluster_);
+
+  std::ifstream file(path);
+  CHECK(file.is_open()) << path;
+
+  std::function<void(Cluster*)> ReadCluster = [&](Cluster* cluster) {
+    std::string line;
+    while (std::getline(file, line)) {
+      StringTrim(&line);
+      if (!line.empty() && line[0] != '#') {
+        break;
+      }
+    }
+
+    CHECK(!line.empty()) << "Unexpected end of file: " << path;
+
+    std::stringstream line_stream(line);
+
+    size_t num_child_clusters;
+    size_t num_images;
+    line_stream >> num_child_clusters >> num_images;
+    CHECK(!line_stream.fail()) << "Invalid cluster line: " << line;
+
+    cluster->image_ids.resize(num_images);
+    for (size_t i = 0; i < num_images; ++i) {
+      line_stream >> cluster->image_ids[i];
+    }
+    CHECK(!line_stream.fail()) << "Invalid cluster line: " << line;
+
+    cluster->child_clusters.resize(num_child_clusters);
+    for (auto& child_cluster : cluster->child_clusters) {
+      ReadCluster(&child_cluster);
+    }
+  };
+
+  root_cluster_.reset(new Cluster());
+  ReadCluster(root_cluster_.get());
+}
+
+void SceneClustering::Write(const std::string& path) const {
+  CHECK(root_cluster_);
+
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  file << "# Scene clustering with one line per cluster in depth-first order:"
+       << std::endl;
+  file << "#   NUM_CHILD_CLUSTERS, NUM_IMAGES, IMAGE_ID[]" << std::endl;
+
+  std::function<void(const Cluster&)> WriteCluster =
+      [&](const Cluster& cluster) {
+        file << cluster.child_clusters.size() << " " << cluster.image_ids.size();
+        for (const auto image_id : cluster.image_ids) {
+          file << " " << image_id;
+        }
+        file << std::endl;
+        for (const auto& child_cluster : cluster.child_clusters) {
+          WriteCluster(child_cluster);
+        }
+      };
+
+  WriteCluster(*root_cluster_);
+}
+
 }  // namespace colmap
@@ -33,6 +33,7 @@
 #define COLMAP_SRC_BASE_SCENE_CLUSTERING_H_
 
 #include <list>
+#include <string>
 #include <vector>
 
 #include "util/types.h"
@@ -57,6 +58,10 @@ class SceneClustering {
     // overlap` images to satisfy the overlap constraint.
     int leaf_max_num_images = 500;
 
+    // The number of threads used to partition independent sub-trees of the
+    // cluster hierarchy in parallel.
+    int num_threads = -1;
+
     bool Check() const;
   };
 
@@ -73,9 +78,22 @@ class SceneClustering {
   const Cluster* GetRootCluster() const;
   std::vector<const Cluster*> GetLeafClusters() const;
 
+  // Read/write the cluster hierarchy from/to a text file. The order of the
+  // leaf clusters returned by `GetLeafClusters` is preserved, so that leaf
+  // clusters can be referenced by their index across processes.
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
  private:
-  void PartitionCluster(const std::vector<std::pair<int, int>>& edges,
-                        const std::vector<int>& weights, Cluster* cluster);
+  // Partition the cluster into its child clusters and return the edges with
+  // their weights inside each child cluster and the images that overlap into
+  // each child cluster. Leaves the cluster untouched if it is small enough.
+  void PartitionCluster(
+      const std::vector<std::pair<int, int>>& edges,
+      const std::vector<int>& weights, Cluster* cluster,
+      std::vector<std::vector<std::pair<int, int>>>* child_edges,
+      std::vector<std::vector<int>>* child_weights,
+      std::vector<std::vector<image_t>>* overlapping_image_ids) const;
 
   const Options options_;
   std::unique_ptr<Cluster> root_cluster_;
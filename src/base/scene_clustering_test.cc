@@ -34,6 +34,8 @@
 
 #include <set>
 
+#include <boost/filesystem.hpp>
+
 #include "base/database.h"
 #include "base/scene_clustering.h"
 
@@ -214,3 +216,41 @@ BOOST_AUTO_TEST_CASE(TestTwoOverlap) {
   BOOST_CHECK(image_ids1.count(2));
   BOOST_CHECK(image_ids1.count(3));
 }
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {0, 1}, {0, 2}, {1, 2}, {2, 3}, {3, 4}};
+  const std::vector<int> num_inliers = {10, 11, 12, 13, 14};
+  SceneClustering::Options options;
+  options.branching = 2;
+  options.image_overlap = 1;
+  options.leaf_max_num_images = 1;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("scene_clustering_%%%%-%%%%-%%%%"))
+          .string();
+  scene_clustering.Write(path);
+
+  SceneClustering read_scene_clustering(options);
+  read_scene_clustering.Read(path);
+  boost::filesystem::remove(path);
+
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  const auto read_leaf_clusters = read_scene_clustering.GetLeafClusters();
+  BOOST_CHECK_EQUAL(read_leaf_clusters.size(), leaf_clusters.size());
+  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+    BOOST_CHECK_EQUAL_COLLECTIONS(read_leaf_clusters[i]->image_ids.begin(),
+                                  read_leaf_clusters[i]->image_ids.end(),
+                                  leaf_clusters[i]->image_ids.begin(),
+                                  leaf_clusters[i]->image_ids.end());
+  }
+
+  BOOST_CHECK_EQUAL_COLLECTIONS(
+      read_scene_clustering.GetRootCluster()->image_ids.begin(),
+      read_scene_clustering.GetRootCluster()->image_ids.end(),
+      scene_clustering.GetRootCluster()->image_ids.begin(),
+      scene_clustering.GetRootCluster()->image_ids.end());
+}
@@ -31,34 +31,99 @@
 
 #include "base/similarity_transform.h"
 
+#include <algorithm>
+#include <numeric>
+
 #include "base/pose.h"
 #include "base/projection.h"
 #include "base/reconstruction.h"
 #include "estimators/similarity_transform.h"
 #include "optim/loransac.h"
+#include "util/random.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace {
 
+// The observations of a common registered image in both reconstructions,
+// whose 2D points have a 3D point in both reconstructions. They are gathered
+// once before RANSAC, such that the alignments are evaluated on contiguous
+// arrays without looking up any images or 3D points.
+struct CommonImage {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  Eigen::Matrix3x4d proj_matrix1;
+  Eigen::Matrix3x4d proj_matrix2;
+  Eigen::Vector3d proj_center1;
+  Eigen::Vector3d proj_center2;
+  const Camera* camera1 = nullptr;
+  const Camera* camera2 = nullptr;
+  std::vector<Eigen::Vector2d> points2D1;
+  std::vector<Eigen::Vector2d> points2D2;
+  std::vector<Eigen::Vector3d> points3D1;
+  std::vector<Eigen::Vector3d> points3D2;
+};
+
+CommonImage GatherCommonImage(const Reconstruction& reconstruction1,
+                              const Reconstruction& reconstruction2,
+                              const image_t image_id) {
+  const Image& image1 = reconstruction1.Image(image_id);
+  const Image& image2 = reconstruction2.Image(image_id);
+
+  CHECK_EQ(image1.CameraId(), image2.CameraId());
+  CHECK_EQ(image1.NumPoints2D(), image2.NumPoints2D());
+
+  CommonImage common_image;
+  common_image.proj_matrix1 = image1.ProjectionMatrix();
+  common_image.proj_matrix2 = image2.ProjectionMatrix();
+  common_image.proj_center1 = image1.ProjectionCenter();
+  common_image.proj_center2 = image2.ProjectionCenter();
+  common_image.camera1 = &reconstruction1.Camera(image1.CameraId());
+  common_image.camera2 = &reconstruction2.Camera(image2.CameraId());
+
+  const size_t num_points3D =
+      std::min(image1.NumPoints3D(), image2.NumPoints3D());
+  common_image.points2D1.reserve(num_points3D);
+  common_image.points2D2.reserve(num_points3D);
+  common_image.points3D1.reserve(num_points3D);
+  common_image.points3D2.reserve(num_points3D);
+
+  for (point2D_t point2D_idx = 0; point2D_idx < image1.NumPoints2D();
+       ++point2D_idx) {
+    // Check if both images have a 3D point.
+
+    const auto& point2D1 = image1.Point2D(point2D_idx);
+    if (!point2D1.HasPoint3D()) {
+      continue;
+    }
+
+    const auto& point2D2 = image2.Point2D(point2D_idx);
+    if (!point2D2.HasPoint3D()) {
+      continue;
+    }
+
+    common_image.points2D1.push_back(point2D1.XY());
+    common_image.points2D2.push_back(point2D2.XY());
+    common_image.points3D1.push_back(
+        reconstruction1.Point3D(point2D1.Point3DId()).XYZ());
+    common_image.points3D2.push_back(
+        reconstruction2.Point3D(point2D2.Point3DId()).XYZ());
+  }
+
+  return common_image;
+}
+
 struct ReconstructionAlignmentEstimator {
   static const int kMinNumSamples = 3;
 
-  typedef const Image* X_t;
-  typedef const Image* Y_t;
+  typedef const CommonImage* X_t;
+  typedef const CommonImage* Y_t;
   typedef Eigen::Matrix3x4d M_t;
 
   void SetMaxReprojError(const double max_reproj_error) {
     max_squared_reproj_error_ = max_reproj_error * max_reproj_error;
   }
 
-  void SetReconstructions(const Reconstruction* reconstruction1,
-                          const Reconstruction* reconstruction2) {
-    CHECK_NOTNULL(reconstruction1);
-    CHECK_NOTNULL(reconstruction2);
-    reconstruction1_ = reconstruction1;
-    reconstruction2_ = reconstruction2;
-  }
-
   // Estimate 3D similarity transform from corresponding projection centers.
   std::vector<M_t> Estimate(const std::vector<X_t>& images1,
                             const std::vector<Y_t>& images2) const {
@@ -69,9 +134,9 @@ struct ReconstructionAlignmentEstimator {
     std::vector<Eigen::Vector3d> proj_centers1(images1.size());
     std::vector<Eigen::Vector3d> proj_centers2(images2.size());
     for (size_t i = 0; i < images1.size(); ++i) {
-      CHECK_EQ(images1[i]->ImageId(), images2[i]->ImageId());
-      proj_centers1[i] = images1[i]->ProjectionCenter();
-      proj_centers2[i] = images2[i]->ProjectionCenter();
+      CHECK_EQ(images1[i], images2[i]);
+      proj_centers1[i] = images1[i]->proj_center1;
+      proj_centers2[i] = images2[i]->proj_center2;
     }
 
     SimilarityTransform3 tform12;
@@ -89,8 +154,6 @@ struct ReconstructionAlignmentEstimator {
                  const std::vector<Y_t>& images2, const M_t& alignment12,
                  std::vector<double>* residuals) const {
     CHECK_EQ(images1.size(), images2.size());
-    CHECK_NOTNULL(reconstruction1_);
-    CHECK_NOTNULL(reconstruction2_);
 
     const Eigen::Matrix3x4d alignment21 =
         SimilarityTransform3(alignment12).Inverse().Matrix().topRows<3>();
@@ -98,55 +161,29 @@ struct ReconstructionAlignmentEstimator {
     residuals->resize(images1.size());
 
     for (size_t i = 0; i < images1.size(); ++i) {
-      const auto& image1 = *images1[i];
-      const auto& image2 = *images2[i];
+      CHECK_EQ(images1[i], images2[i]);
+      const CommonImage& image = *images1[i];
 
-      CHECK_EQ(image1.ImageId(), image2.ImageId());
-      CHECK_EQ(image1.CameraId(), image2.CameraId());
-
-      const auto& camera1 = reconstruction1_->Camera(image1.CameraId());
-      const auto& camera2 = reconstruction2_->Camera(image2.CameraId());
-
-      const Eigen::Matrix3x4d proj_matrix1 = image1.ProjectionMatrix();
-      const Eigen::Matrix3x4d proj_matrix2 = image2.ProjectionMatrix();
-
-      CHECK_EQ(image1.NumPoints2D(), image2.NumPoints2D());
+      const size_t num_common_points = image.points2D1.size();
 
       size_t num_inliers = 0;
-      size_t num_common_points = 0;
-
-      for (point2D_t point2D_idx = 0; point2D_idx < image1.NumPoints2D();
-           ++point2D_idx) {
-        // Check if both images have a 3D point.
-
-        const auto& point2D1 = image1.Point2D(point2D_idx);
-        if (!point2D1.HasPoint3D()) {
-          continue;
-        }
-
-        const auto& point2D2 = image2.Point2D(point2D_idx);
-        if (!point2D2.HasPoint3D()) {
-          continue;
-        }
-
-        num_common_points += 1;
-
+      for (size_t j = 0; j < num_common_points; ++j) {
         // Reproject 3D point in image 1 to image 2.
         const Eigen::Vector3d xyz12 =
-            alignment12 *
-            reconstruction1_->Point3D(point2D1.Point3DId()).XYZ().homogeneous();
-        if (CalculateSquaredReprojectionError(point2D2.XY(), xyz12,
-                                              proj_matrix2, camera2) >
+            alignment12 * image.points3D1[j].homogeneous();
+        if (CalculateSquaredReprojectionError(image.points2D2[j], xyz12,
+                                              image.proj_matrix2,
+                                              *image.camera2) >
             max_squared_reproj_error_) {
           continue;
         }
 
         // Reproject 3D point in image 2 to image 1.
         const Eigen::Vector3d xyz21 =
-            alignment21 *
-            reconstruction2_->Point3D(point2D2.Point3DId()).XYZ().homogeneous();
-        if (CalculateSquaredReprojectionError(point2D1.XY(), xyz21,
-                                              proj_matrix1, camera1) >
+            alignment21 * image.points3D2[j].homogeneous();
+        if (CalculateSquaredReprojectionError(image.points2D1[j], xyz21,
+                                              image.proj_matrix1,
+                                              *image.camera1) >
             max_squared_reproj_error_) {
           continue;
         }
@@ -167,8 +204,6 @@ struct ReconstructionAlignmentEstimator {
 
  private:
   double max_squared_reproj_error_ = 0.0;
-  const Reconstruction* reconstruction1_ = nullptr;
-  const Reconstruction* reconstruction2_ = nullptr;
 };
 
 }  // namespace
@@ -257,6 +292,76 @@ Eigen::Vector3d SimilarityTransform3::Translation() const {
   return Matrix().block<3, 1>(0, 3);
 }
 
+bool EstimateSimilarityTransformRobust(const std::vector<Eigen::Vector3d>& src,
+                                       const std::vector<Eigen::Vector3d>& dst,
+                                       const RANSACOptions& ransac_options,
+                                       const size_t min_num_inliers,
+                                       const size_t max_num_samples,
+                                       Eigen::Matrix3x4d* tform) {
+  CHECK_EQ(src.size(), dst.size());
+  CHECK_NOTNULL(tform);
+
+  typedef SimilarityTransformEstimator<3> Estimator;
+
+  if (max_num_samples == 0 || src.size() <= max_num_samples) {
+    LORANSAC<Estimator, Estimator> ransac(ransac_options);
+    const auto report = ransac.Estimate(src, dst);
+    if (!report.success || report.support.num_inliers < min_num_inliers) {
+      return false;
+    }
+    *tform = report.model;
+    return true;
+  }
+
+  // Estimate the transformation from a random subset of the correspondences.
+  std::vector<size_t> sample_idxs(src.size());
+  std::iota(sample_idxs.begin(), sample_idxs.end(), 0);
+  Shuffle(static_cast<uint32_t>(max_num_samples), &sample_idxs);
+  sample_idxs.resize(max_num_samples);
+
+  std::vector<Eigen::Vector3d> sample_src(max_num_samples);
+  std::vector<Eigen::Vector3d> sample_dst(max_num_samples);
+  for (size_t i = 0; i < max_num_samples; ++i) {
+    sample_src[i] = src[sample_idxs[i]];
+    sample_dst[i] = dst[sample_idxs[i]];
+  }
+
+  LORANSAC<Estimator, Estimator> ransac(ransac_options);
+  const auto report = ransac.Estimate(sample_src, sample_dst);
+  if (!report.success) {
+    return false;
+  }
+
+  // Refine the transformation from the inliers among all correspondences.
+  std::vector<double> residuals;
+  Estimator::Residuals(src, dst, report.model, &residuals);
+
+  const double max_residual =
+      ransac_options.max_error * ransac_options.max_error;
+  std::vector<Eigen::Vector3d> inlier_src;
+  std::vector<Eigen::Vector3d> inlier_dst;
+  for (size_t i = 0; i < residuals.size(); ++i) {
+    if (residuals[i] <= max_residual) {
+      inlier_src.push_back(src[i]);
+      inlier_dst.push_back(dst[i]);
+    }
+  }
+
+  if (inlier_src.size() < min_num_inliers ||
+      inlier_src.size() < static_cast<size_t>(Estimator::kMinNumSamples)) {
+    return false;
+  }
+
+  const auto models = Estimator::Estimate(inlier_src, inlier_dst);
+  if (models.empty()) {
+    return false;
+  }
+
+  *tform = models[0];
+
+  return true;
+}
+
 bool ComputeAlignmentBetweenReconstructions(
     const Reconstruction& src_reconstruction,
     const Reconstruction& ref_reconstruction,
@@ -272,10 +377,7 @@ bool ComputeAlignmentBetweenReconstructions(
   LORANSAC<ReconstructionAlignmentEstimator, ReconstructionAlignmentEstimator>
       ransac(ransac_options);
   ransac.estimator.SetMaxReprojError(max_reproj_error);
-  ransac.estimator.SetReconstructions(&src_reconstruction, &ref_reconstruction);
   ransac.local_estimator.SetMaxReprojError(max_reproj_error);
-  ransac.local_estimator.SetReconstructions(&src_reconstruction,
-                                            &ref_reconstruction);
 
   const auto& common_image_ids =
       src_reconstruction.FindCommonRegImageIds(ref_reconstruction);
@@ -284,12 +386,22 @@ bool ComputeAlignmentBetweenReconstructions(
     return false;
   }
 
-  std::vector<const Image*> src_images(common_image_ids.size());
-  std::vector<const Image*> ref_images(common_image_ids.size());
-  for (size_t i = 0; i < common_image_ids.size(); ++i) {
-    src_images[i] = &src_reconstruction.Image(common_image_ids[i]);
-    ref_images[i] = &ref_reconstruction.Image(common_image_ids[i]);
+  std::vector<CommonImage, Eigen::aligned_allocator<CommonImage>>
+      common_images(common_image_ids.size());
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, common_image_ids.size(),
+              [&](const size_t begin, const size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                  common_images[i] =
+                      GatherCommonImage(src_reconstruction, ref_reconstruction,
+                                        common_image_ids[i]);
+                }
+              });
+
+  std::vector<const CommonImage*> src_images(common_images.size());
+  for (size_t i = 0; i < common_images.size(); ++i) {
+    src_images[i] = &common_images[i];
   }
+  const std::vector<const CommonImage*>& ref_images = src_images;
 
   const auto report = ransac.Estimate(src_images, ref_images);
 
@@ -300,4 +412,29 @@ bool ComputeAlignmentBetweenReconstructions(
   return report.success;
 }
 
+std::vector<char> ComputeAlignmentsBetweenReconstructions(
+    const std::vector<std::pair<const Reconstruction*, const Reconstruction*>>&
+        src_ref_reconstructions,
+    const double min_inlier_observations, const double max_reproj_error,
+    std::vector<Eigen::Matrix3x4d>* alignments, const int num_threads) {
+  CHECK_NOTNULL(alignments);
+
+  std::vector<char> success(src_ref_reconstructions.size(), false);
+  alignments->resize(src_ref_reconstructions.size());
+
+  const auto ComputeAlignments = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      success[i] = ComputeAlignmentBetweenReconstructions(
+          *src_ref_reconstructions[i].first,
+          *src_ref_reconstructions[i].second, min_inlier_observations,
+          max_reproj_error, &(*alignments)[i]);
+    }
+  };
+
+  ParallelFor(num_threads, 0, src_ref_reconstructions.size(),
+              ComputeAlignments, ThreadPool::Schedule::DYNAMIC, 1);
+
+  return success;
+}
+
 }  // namespace colmap
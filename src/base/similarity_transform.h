@@ -77,6 +77,19 @@ class SimilarityTransform3 {
   Eigen::Transform<double, 3, Eigen::Affine> transform_;
 };
 
+// Robustly estimate the similarity transformation from the source to the
+// destination locations using LO-RANSAC. If there are more than
+// `max_num_samples` correspondences, RANSAC only runs on a random subset of
+// them and the transformation is then re-estimated from the inliers among all
+// correspondences, which bounds the cost for very many correspondences.
+// Returns false if fewer than `min_num_inliers` correspondences are inliers.
+bool EstimateSimilarityTransformRobust(const std::vector<Eigen::Vector3d>& src,
+                                       const std::vector<Eigen::Vector3d>& dst,
+                                       const RANSACOptions& ransac_options,
+                                       const size_t min_num_inliers,
+                                       const size_t max_num_samples,
+                                       Eigen::Matrix3x4d* tform);
+
 // Robustly compute alignment between reconstructions by finding images that
 // are registered in both reconstructions. The alignment is then estimated
 // robustly inside RANSAC from corresponding projection centers. An alignment
@@ -89,6 +102,16 @@ bool ComputeAlignmentBetweenReconstructions(
     const double min_inlier_observations, const double max_reproj_error,
     Eigen::Matrix3x4d* alignment);
 
+// Compute the alignments between multiple pairs of source and reference
+// reconstructions in parallel, see `ComputeAlignmentBetweenReconstructions`.
+// Returns whether each alignment was successful, and the alignments are only
+// valid for the successful pairs.
+std::vector<char> ComputeAlignmentsBetweenReconstructions(
+    const std::vector<std::pair<const Reconstruction*, const Reconstruction*>>&
+        src_ref_reconstructions,
+    const double min_inlier_observations, const double max_reproj_error,
+    std::vector<Eigen::Matrix3x4d>* alignments, const int num_threads = -1);
+
 }  // namespace colmap
 
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION_CUSTOM(colmap::SimilarityTransform3)
@@ -35,7 +35,9 @@
 #include <Eigen/Core>
 
 #include "base/pose.h"
+#include "base/reconstruction.h"
 #include "base/similarity_transform.h"
+#include "optim/ransac.h"
 
 using namespace colmap;
 
@@ -98,3 +100,53 @@ BOOST_AUTO_TEST_CASE(TestEstimation) {
   TestEstimationWithNumCoords(3);
   TestEstimationWithNumCoords(100);
 }
+
+BOOST_AUTO_TEST_CASE(TestEstimateSimilarityTransformRobust) {
+  const SimilarityTransform3 orig_tform(2, Eigen::Vector4d(0.1, 0.3, 0.2, 0.4),
+                                        Eigen::Vector3d(100, 10, 0.5));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < 1000; ++i) {
+    src.push_back(Eigen::Vector3d::Random());
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+    // Every fifth correspondence is an outlier.
+    if (i % 5 == 0) {
+      dst.back() += Eigen::Vector3d(10, 0, 0);
+    }
+  }
+
+  RANSACOptions ransac_options;
+  ransac_options.max_error = 1e-3;
+
+  for (const size_t max_num_samples : {0, 100, 1000, 2000}) {
+    Eigen::Matrix3x4d tform;
+    BOOST_CHECK(EstimateSimilarityTransformRobust(
+        src, dst, ransac_options, 800, max_num_samples, &tform));
+    BOOST_CHECK_LT(
+        (orig_tform.Matrix().topRows<3>() - tform).norm(), 1e-6);
+  }
+
+  Eigen::Matrix3x4d tform;
+  BOOST_CHECK(!EstimateSimilarityTransformRobust(src, dst, ransac_options,
+                                                 801, 100, &tform));
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeAlignmentsBetweenReconstructions) {
+  // Reconstructions without common registered images cannot be aligned.
+  Reconstruction reconstruction1;
+  Reconstruction reconstruction2;
+  std::vector<Eigen::Matrix3x4d> alignments;
+  const auto success = ComputeAlignmentsBetweenReconstructions(
+      {{&reconstruction1, &reconstruction2},
+       {&reconstruction2, &reconstruction1}},
+      0.3, 8.0, &alignments);
+  BOOST_CHECK_EQUAL(success.size(), 2);
+  BOOST_CHECK_EQUAL(alignments.size(), 2);
+  BOOST_CHECK(!success[0]);
+  BOOST_CHECK(!success[1]);
+  BOOST_CHECK(ComputeAlignmentsBetweenReconstructions({}, 0.3, 8.0, &alignments)
+                  .empty());
+  BOOST_CHECK(alignments.empty());
+}
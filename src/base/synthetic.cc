@@ -0,0 +1,336 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "base/synthetic.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "base/camera_models.h"
+#include "base/essential_matrix.h"
+#include "base/pose.h"
+#include "base/projection.h"
+#include "base/triangulation.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/random.h"
+
+namespace colmap {
+namespace {
+
+// An observation of a 3D point as the index of the image and of its 2D point.
+typedef std::pair<size_t, point2D_t> Observation;
+
+TwoViewGeometry ComputeTwoViewGeometry(const Reconstruction& reconstruction,
+                                       const image_t image_id1,
+                                       const image_t image_id2,
+                                       const FeatureMatches& inlier_matches) {
+  const Image& image1 = reconstruction.Image(image_id1);
+  const Image& image2 = reconstruction.Image(image_id2);
+  const Camera& camera1 = reconstruction.Camera(image1.CameraId());
+  const Camera& camera2 = reconstruction.Camera(image2.CameraId());
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+  ComputeRelativePose(image1.Qvec(), image1.Tvec(), image2.Qvec(),
+                      image2.Tvec(), &two_view_geometry.qvec,
+                      &two_view_geometry.tvec);
+  two_view_geometry.E = EssentialMatrixFromPose(
+      QuaternionToRotationMatrix(two_view_geometry.qvec),
+      two_view_geometry.tvec);
+  two_view_geometry.F = camera2.CalibrationMatrix().transpose().inverse() *
+                        two_view_geometry.E *
+                        camera1.CalibrationMatrix().inverse();
+  two_view_geometry.inlier_matches = inlier_matches;
+
+  std::vector<double> tri_angles;
+  tri_angles.reserve(inlier_matches.size());
+  const Eigen::Vector3d proj_center1 = image1.ProjectionCenter();
+  const Eigen::Vector3d proj_center2 = image2.ProjectionCenter();
+  for (const auto& match : inlier_matches) {
+    const point3D_t point3D_id = image1.Point2D(match.point2D_idx1).Point3DId();
+    tri_angles.push_back(CalculateTriangulationAngle(
+        proj_center1, proj_center2,
+        reconstruction.Point3D(point3D_id).XYZ()));
+  }
+  two_view_geometry.tri_angle = tri_angles.empty() ? 0 : Median(tri_angles);
+
+  return two_view_geometry;
+}
+
+}  // namespace
+
+bool SyntheticDatasetOptions::Check() const {
+  CHECK_OPTION_GT(num_cameras, 0);
+  CHECK_OPTION_GT(num_images, 1);
+  CHECK_OPTION_GE(num_points3D, 0);
+  CHECK_OPTION(ExistsCameraModelWithName(camera_model_name));
+  CHECK_OPTION_GT(camera_width, 0);
+  CHECK_OPTION_GT(camera_height, 0);
+  CHECK_OPTION_GT(mean_track_length, 0);
+  CHECK_OPTION_GE(num_points2D_without_point3D, 0);
+  CHECK_OPTION_GE(point2D_stddev, 0);
+  CHECK_OPTION_GE(match_outlier_ratio, 0);
+  CHECK_OPTION_LT(match_outlier_ratio, 1);
+  return true;
+}
+
+void SynthesizeDataset(const SyntheticDatasetOptions& options,
+                       Reconstruction* reconstruction, Database* database) {
+  CHECK(options.Check());
+  CHECK_NOTNULL(reconstruction);
+  CHECK_EQ(reconstruction->NumCameras(), 0);
+  CHECK_EQ(reconstruction->NumImages(), 0);
+  if (database != nullptr) {
+    CHECK_EQ(database->NumCameras(), 0);
+    CHECK_EQ(database->NumImages(), 0);
+  }
+
+  SetPRNGSeed(static_cast<unsigned>(options.prng_seed));
+
+  const double focal_length =
+      1.2 * std::max(options.camera_width, options.camera_height);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Cameras and poses
+  //////////////////////////////////////////////////////////////////////////////
+
+  for (int camera_idx = 0; camera_idx < options.num_cameras; ++camera_idx) {
+    Camera camera;
+    camera.InitializeWithName(options.camera_model_name, focal_length,
+                              options.camera_width, options.camera_height);
+    camera.SetCameraId(static_cast<camera_t>(camera_idx + 1));
+    reconstruction->AddCamera(camera);
+  }
+
+  const size_t num_images = static_cast<size_t>(options.num_images);
+  std::vector<Image> images(num_images);
+  std::vector<Eigen::Matrix3x4d> proj_matrices(num_images);
+  for (size_t image_idx = 0; image_idx < num_images; ++image_idx) {
+    Image& image = images[image_idx];
+    image.SetImageId(static_cast<image_t>(image_idx + 1));
+    image.SetCameraId(
+        static_cast<camera_t>(image_idx % options.num_cameras + 1));
+    image.SetName(StringPrintf("image%06d.png", static_cast<int>(image_idx)));
+    const double kRotationStddev = 0.02;
+    const Eigen::Matrix3d R = EulerAnglesToRotationMatrix(
+        RandomGaussian(0.0, kRotationStddev),
+        RandomGaussian(0.0, kRotationStddev),
+        RandomGaussian(0.0, kRotationStddev));
+    image.Qvec() = RotationMatrixToQuaternion(R);
+    image.Tvec() = -R * Eigen::Vector3d(static_cast<double>(image_idx), 0, 0);
+    proj_matrices[image_idx] = image.ProjectionMatrix();
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // 3D points and their observations
+  //////////////////////////////////////////////////////////////////////////////
+
+  // A point at depth d is seen by the images within a range of d * w / f
+  // along the x-axis, so the depth controls the track length.
+  const double mean_depth =
+      options.mean_track_length * focal_length / options.camera_width;
+
+  std::vector<std::vector<Eigen::Vector2d>> points2D(num_images);
+  std::vector<Eigen::Vector3d> points3D;
+  std::vector<std::vector<Observation>> tracks;
+  points3D.reserve(options.num_points3D);
+  tracks.reserve(options.num_points3D);
+
+  std::vector<Observation> track;
+  std::vector<Eigen::Vector2d> track_points2D;
+  for (int i = 0; i < options.num_points3D; ++i) {
+    const double depth = mean_depth * RandomReal(0.5, 1.5);
+    const double half_width = 0.5 * depth * options.camera_width / focal_length;
+    const double half_height =
+        0.5 * depth * options.camera_height / focal_length;
+    const Eigen::Vector3d xyz(RandomReal(-0.5, num_images - 0.5),
+                              RandomReal(-0.8, 0.8) * half_height, depth);
+
+    // Only the images around the point can see it.
+    const size_t min_image_idx = static_cast<size_t>(
+        std::max(0.0, std::floor(xyz.x() - half_width) - 1));
+    const size_t max_image_idx =
+        std::min(num_images - 1,
+                 static_cast<size_t>(std::ceil(xyz.x() + half_width) + 1));
+
+    track.clear();
+    track_points2D.clear();
+    for (size_t image_idx = min_image_idx; image_idx <= max_image_idx;
+         ++image_idx) {
+      if (!HasPointPositiveDepth(proj_matrices[image_idx], xyz)) {
+        continue;
+      }
+      const Camera& camera =
+          reconstruction->Camera(images[image_idx].CameraId());
+      const Eigen::Vector2d point2D =
+          ProjectPointToImage(xyz, proj_matrices[image_idx], camera);
+      if (point2D.x() < 0 || point2D.x() >= options.camera_width ||
+          point2D.y() < 0 || point2D.y() >= options.camera_height) {
+        continue;
+      }
+      track.emplace_back(image_idx, 0);
+      track_points2D.push_back(point2D);
+    }
+
+    if (track.size() < 2) {
+      continue;
+    }
+
+    for (size_t j = 0; j < track.size(); ++j) {
+      const size_t image_idx = track[j].first;
+      Eigen::Vector2d point2D = track_points2D[j];
+      if (options.point2D_stddev > 0) {
+        point2D.x() += RandomGaussian(0.0, options.point2D_stddev);
+        point2D.y() += RandomGaussian(0.0, options.point2D_stddev);
+      }
+      track[j].second = static_cast<point2D_t>(points2D[image_idx].size());
+      points2D[image_idx].push_back(point2D);
+    }
+
+    points3D.push_back(xyz);
+    tracks.push_back(track);
+  }
+
+  for (size_t image_idx = 0; image_idx < num_images; ++image_idx) {
+    for (int i = 0; i < options.num_points2D_without_point3D; ++i) {
+      points2D[image_idx].emplace_back(
+          RandomReal(0.0, static_cast<double>(options.camera_width)),
+          RandomReal(0.0, static_cast<double>(options.camera_height)));
+    }
+    images[image_idx].SetPoints2D(points2D[image_idx]);
+    std::vector<Eigen::Vector2d>().swap(points2D[image_idx]);
+    reconstruction->AddImage(images[image_idx]);
+    reconstruction->RegisterImage(images[image_idx].ImageId());
+  }
+  images.clear();
+
+  for (size_t point3D_idx = 0; point3D_idx < points3D.size(); ++point3D_idx) {
+    Track point3D_track;
+    point3D_track.Reserve(tracks[point3D_idx].size());
+    for (const auto& observation : tracks[point3D_idx]) {
+      point3D_track.AddElement(static_cast<image_t>(observation.first + 1),
+                               observation.second);
+    }
+    reconstruction->AddPoint3D(points3D[point3D_idx], point3D_track);
+  }
+
+  if (database == nullptr) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Database
+  //////////////////////////////////////////////////////////////////////////////
+
+  // The observations of every track are ordered by image, so the first image
+  // of every match has the smaller identifier.
+  std::unordered_map<image_pair_t, FeatureMatches> inlier_matches;
+  for (const auto& point3D_track : tracks) {
+    for (size_t i = 0; i < point3D_track.size(); ++i) {
+      for (size_t j = i + 1; j < point3D_track.size(); ++j) {
+        const image_pair_t pair_id = Database::ImagePairToPairId(
+            static_cast<image_t>(point3D_track[i].first + 1),
+            static_cast<image_t>(point3D_track[j].first + 1));
+        inlier_matches[pair_id].emplace_back(point3D_track[i].second,
+                                             point3D_track[j].second);
+      }
+    }
+  }
+  tracks.clear();
+
+  DatabaseTransaction database_transaction(database);
+
+  const bool kUseCameraId = true;
+  for (const auto& camera : reconstruction->Cameras()) {
+    database->WriteCamera(camera.second, kUseCameraId);
+  }
+
+  const bool kUseImageId = true;
+  for (image_t image_id = 1; image_id <= num_images; ++image_id) {
+    const Image& image = reconstruction->Image(image_id);
+    database->WriteImage(image, kUseImageId);
+
+    FeatureKeypoints keypoints;
+    keypoints.reserve(image.NumPoints2D());
+    for (const auto& point2D : image.Points2D()) {
+      keypoints.emplace_back(static_cast<float>(point2D.X()),
+                             static_cast<float>(point2D.Y()));
+    }
+    database->WriteKeypoints(image_id, keypoints);
+
+    if (options.write_descriptors) {
+      FeatureDescriptors descriptors(image.NumPoints2D(), 128);
+      for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+        descriptors.data()[i] = static_cast<uint8_t>(RandomInteger(0, 255));
+      }
+      database->WriteDescriptors(image_id, descriptors);
+    }
+  }
+
+  // Process the image pairs in a deterministic order.
+  std::vector<image_pair_t> pair_ids;
+  pair_ids.reserve(inlier_matches.size());
+  for (const auto& pair : inlier_matches) {
+    pair_ids.push_back(pair.first);
+  }
+  std::sort(pair_ids.begin(), pair_ids.end());
+
+  for (const image_pair_t pair_id : pair_ids) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(pair_id, &image_id1, &image_id2);
+    const FeatureMatches& pair_inlier_matches = inlier_matches.at(pair_id);
+
+    FeatureMatches matches = pair_inlier_matches;
+    const size_t num_outliers = static_cast<size_t>(std::round(
+        options.match_outlier_ratio / (1 - options.match_outlier_ratio) *
+        pair_inlier_matches.size()));
+    const point2D_t num_points2D1 =
+        reconstruction->Image(image_id1).NumPoints2D();
+    const point2D_t num_points2D2 =
+        reconstruction->Image(image_id2).NumPoints2D();
+    for (size_t i = 0; i < num_outliers; ++i) {
+      matches.emplace_back(RandomInteger<point2D_t>(0, num_points2D1 - 1),
+                           RandomInteger<point2D_t>(0, num_points2D2 - 1));
+    }
+    Shuffle(static_cast<uint32_t>(matches.size()), &matches);
+
+    database->WriteMatches(image_id1, image_id2, matches);
+    database->WriteTwoViewGeometry(
+        image_id1, image_id2,
+        ComputeTwoViewGeometry(*reconstruction, image_id1, image_id2,
+                               pair_inlier_matches));
+  }
+}
+
+}  // namespace colmap
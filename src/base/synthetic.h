@@ -0,0 +1,100 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_BASE_SYNTHETIC_H_
+#define COLMAP_SRC_BASE_SYNTHETIC_H_
+
+#include <string>
+
+#include "base/database.h"
+#include "base/reconstruction.h"
+
+namespace colmap {
+
+struct SyntheticDatasetOptions {
+  // The number of cameras, which are shared round-robin by the images.
+  int num_cameras = 2;
+
+  // The number of images, which are placed with unit spacing along the x-axis
+  // and look along the z-axis with a small random rotation.
+  int num_images = 10;
+
+  // The number of generated 3D points. Points observed by fewer than two
+  // images are discarded, so the final number can be slightly smaller.
+  int num_points3D = 100;
+
+  // The camera model and image size of all cameras. The focal length is 1.2
+  // times the larger image dimension and the extra parameters are zero.
+  std::string camera_model_name = "SIMPLE_RADIAL";
+  int camera_width = 1024;
+  int camera_height = 768;
+
+  // The average number of images observing a 3D point. Since the images are
+  // placed along a line, this also controls the number of neighboring images
+  // with which every image is matched, i.e. the connectivity of the scene
+  // graph, which is about two times the track length.
+  double mean_track_length = 5;
+
+  // The number of additional keypoints per image without 3D point, which are
+  // only used for outlier matches.
+  int num_points2D_without_point3D = 10;
+
+  // Standard deviation of the Gaussian noise added to the 2D points in pixels.
+  double point2D_stddev = 0;
+
+  // The fraction of outlier matches between random keypoints in the matches
+  // of each image pair. The two-view geometries only contain the inliers.
+  double match_outlier_ratio = 0;
+
+  // Whether to write random descriptors to the database. This is only
+  // necessary to run the feature matchers, but dominates the database size.
+  bool write_descriptors = false;
+
+  // Seed of the random number generator, such that datasets are reproducible.
+  int prng_seed = 0;
+
+  bool Check() const;
+};
+
+// Generate a synthetic scene with known ground-truth in the reconstruction
+// and optionally write the corresponding cameras, images, keypoints, noisy
+// matches, and two-view geometries to the database, e.g. to benchmark the
+// loading of the database, the incremental mapper, and bundle adjustment at
+// controlled scale. The reconstruction and the database must be empty. The
+// identifiers of cameras and images start at 1 as for a new database.
+void SynthesizeDataset(const SyntheticDatasetOptions& options,
+                       Reconstruction* reconstruction,
+                       Database* database = nullptr);
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_BASE_SYNTHETIC_H_
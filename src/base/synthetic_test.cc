@@ -0,0 +1,128 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "base/synthetic"
+#include "util/testing.h"
+
+#include "base/projection.h"
+#include "base/synthetic.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestReconstruction) {
+  SyntheticDatasetOptions options;
+  Reconstruction reconstruction;
+  SynthesizeDataset(options, &reconstruction);
+  BOOST_CHECK_EQUAL(reconstruction.NumCameras(), options.num_cameras);
+  BOOST_CHECK_EQUAL(reconstruction.NumImages(), options.num_images);
+  BOOST_CHECK_EQUAL(reconstruction.NumRegImages(), options.num_images);
+  BOOST_CHECK_GT(reconstruction.NumPoints3D(), 0);
+  BOOST_CHECK_LE(reconstruction.NumPoints3D(), options.num_points3D);
+  for (const auto& point3D : reconstruction.Points3D()) {
+    BOOST_CHECK_GE(point3D.second.Track().Length(), 2);
+    for (const auto& track_el : point3D.second.Track().Elements()) {
+      const Image& image = reconstruction.Image(track_el.image_id);
+      const Camera& camera = reconstruction.Camera(image.CameraId());
+      BOOST_CHECK_LT(CalculateSquaredReprojectionError(
+                         image.Point2D(track_el.point2D_idx).XY(),
+                         point3D.second.XYZ(), image.Qvec(), image.Tvec(),
+                         camera),
+                     1e-6);
+    }
+  }
+  for (const auto& image : reconstruction.Images()) {
+    BOOST_CHECK_EQUAL(image.second.NumPoints2D(),
+                      image.second.NumPoints3D() +
+                          options.num_points2D_without_point3D);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestDeterministic) {
+  SyntheticDatasetOptions options;
+  Reconstruction reconstruction1;
+  SynthesizeDataset(options, &reconstruction1);
+  Reconstruction reconstruction2;
+  SynthesizeDataset(options, &reconstruction2);
+  BOOST_CHECK_EQUAL(reconstruction1.NumPoints3D(),
+                    reconstruction2.NumPoints3D());
+  for (const auto& image : reconstruction1.Images()) {
+    BOOST_CHECK_EQUAL(image.second.Qvec(),
+                      reconstruction2.Image(image.first).Qvec());
+    BOOST_CHECK_EQUAL(image.second.Tvec(),
+                      reconstruction2.Image(image.first).Tvec());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestDatabase) {
+  SyntheticDatasetOptions options;
+  options.point2D_stddev = 1;
+  options.match_outlier_ratio = 0.5;
+  options.write_descriptors = true;
+  Reconstruction reconstruction;
+  Database database(":memory:");
+  SynthesizeDataset(options, &reconstruction, &database);
+
+  BOOST_CHECK_EQUAL(database.NumCameras(), options.num_cameras);
+  BOOST_CHECK_EQUAL(database.NumImages(), options.num_images);
+  BOOST_CHECK_GT(database.NumMatchedImagePairs(), 0);
+  BOOST_CHECK_EQUAL(database.NumMatchedImagePairs(),
+                    database.NumVerifiedImagePairs());
+  BOOST_CHECK_GT(database.NumInlierMatches(), 0);
+  BOOST_CHECK_EQUAL(database.NumMatches(), 2 * database.NumInlierMatches());
+
+  for (const auto& image : reconstruction.Images()) {
+    BOOST_CHECK_EQUAL(database.ReadImage(image.first).Name(),
+                      image.second.Name());
+    BOOST_CHECK_EQUAL(database.NumKeypointsForImage(image.first),
+                      image.second.NumPoints2D());
+    BOOST_CHECK_EQUAL(database.NumDescriptorsForImage(image.first),
+                      image.second.NumPoints2D());
+  }
+
+  std::vector<image_pair_t> image_pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(image_pair_ids[i], &image_id1, &image_id2);
+    const Image& image1 = reconstruction.Image(image_id1);
+    const Image& image2 = reconstruction.Image(image_id2);
+    for (const auto& match : two_view_geometries[i].inlier_matches) {
+      const Point2D& point2D1 = image1.Point2D(match.point2D_idx1);
+      const Point2D& point2D2 = image2.Point2D(match.point2D_idx2);
+      BOOST_CHECK(point2D1.HasPoint3D());
+      BOOST_CHECK_EQUAL(point2D1.Point3DId(), point2D2.Point3DId());
+    }
+  }
+}
@@ -35,6 +35,7 @@
 #include <vector>
 
 #include "util/logging.h"
+#include "util/small_vector.h"
 #include "util/types.h"
 
 namespace colmap {
@@ -49,6 +50,12 @@ struct TrackElement {
   point2D_t point2D_idx;
 };
 
+// The elements of a track. Most tracks, and especially the short-lived tracks
+// of 3D point hypotheses during triangulation, are short enough to be stored
+// inline without a heap allocation.
+const size_t kNumInlineTrackElements = 4;
+typedef SmallVector<TrackElement, kNumInlineTrackElements> TrackElements;
+
 class Track {
  public:
   Track();
@@ -57,8 +64,8 @@ class Track {
   inline size_t Length() const;
 
   // Access all elements.
-  inline const std::vector<TrackElement>& Elements() const;
-  inline std::vector<TrackElement>& Elements();
+  inline const TrackElements& Elements() const;
+  inline TrackElements& Elements();
   inline void SetElements(const std::vector<TrackElement>& elements);
 
   // Access specific elements.
@@ -70,20 +77,22 @@ class Track {
   inline void AddElement(const TrackElement& element);
   inline void AddElement(const image_t image_id, const point2D_t point2D_idx);
   inline void AddElements(const std::vector<TrackElement>& elements);
+  inline void AddElements(const TrackElements& elements);
 
   // Delete existing element.
   inline void DeleteElement(const size_t idx);
   void DeleteElement(const image_t image_id, const point2D_t point2D_idx);
 
   // Requests that the track capacity be at least enough to contain the
-  // specified number of elements.
+  // specified number of elements, e.g. the number of correspondences of a new
+  // track, such that it grows with at most one allocation.
   inline void Reserve(const size_t num_elements);
 
   // Shrink the capacity of track vector to fit its size to save memory.
   inline void Compress();
 
  private:
-  std::vector<TrackElement> elements_;
+  TrackElements elements_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -92,12 +101,12 @@ class Track {
 
 size_t Track::Length() const { return elements_.size(); }
 
-const std::vector<TrackElement>& Track::Elements() const { return elements_; }
+const TrackElements& Track::Elements() const { return elements_; }
 
-std::vector<TrackElement>& Track::Elements() { return elements_; }
+TrackElements& Track::Elements() { return elements_; }
 
 void Track::SetElements(const std::vector<TrackElement>& elements) {
-  elements_ = elements;
+  elements_.assign(elements.begin(), elements.end());
 }
 
 // Access specific elements.
@@ -123,6 +132,10 @@ void Track::AddElements(const std::vector<TrackElement>& elements) {
   elements_.insert(elements_.end(), elements.begin(), elements.end());
 }
 
+void Track::AddElements(const TrackElements& elements) {
+  elements_.insert(elements_.end(), elements.begin(), elements.end());
+}
+
 void Track::DeleteElement(const size_t idx) {
   CHECK_LT(idx, elements_.size());
   elements_.erase(elements_.begin() + idx);
@@ -119,19 +119,22 @@ BOOST_AUTO_TEST_CASE(TestDeleteElement) {
 BOOST_AUTO_TEST_CASE(TestReserve) {
   Track track;
   track.Reserve(2);
-  BOOST_CHECK_EQUAL(track.Elements().capacity(), 2);
+  BOOST_CHECK_EQUAL(track.Elements().capacity(), kNumInlineTrackElements);
+  track.Reserve(2 * kNumInlineTrackElements);
+  BOOST_CHECK_EQUAL(track.Elements().capacity(), 2 * kNumInlineTrackElements);
 }
 
 BOOST_AUTO_TEST_CASE(TestCompress) {
   Track track;
-  track.AddElement(0, 1);
-  track.AddElement(0, 2);
-  track.AddElement(0, 3);
-  track.AddElement(0, 3);
-  BOOST_CHECK_EQUAL(track.Elements().capacity(), 4);
+  for (size_t i = 0; i <= kNumInlineTrackElements; ++i) {
+    track.AddElement(0, i);
+  }
+  BOOST_CHECK_EQUAL(track.Elements().capacity(), 2 * kNumInlineTrackElements);
   track.DeleteElement(0);
   track.DeleteElement(0);
-  BOOST_CHECK_EQUAL(track.Elements().capacity(), 4);
+  BOOST_CHECK_EQUAL(track.Elements().capacity(), 2 * kNumInlineTrackElements);
   track.Compress();
-  BOOST_CHECK_EQUAL(track.Elements().capacity(), 2);
+  BOOST_CHECK_EQUAL(track.Elements().capacity(), kNumInlineTrackElements);
+  BOOST_CHECK_EQUAL(track.Length(), kNumInlineTrackElements - 1);
+  BOOST_CHECK_EQUAL(track.Element(0).point2D_idx, 2);
 }
@@ -31,7 +31,13 @@
 
 #include "base/undistortion.h"
 
+#include <atomic>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include <boost/filesystem.hpp>
 
 #include "base/camera_models.h"
 #include "base/pose.h"
@@ -41,6 +47,64 @@
 namespace colmap {
 namespace {
 
+// Get the FreeImage format, save flags, and file extensions of the given
+// `UndistortImagesOptions::image_format`.
+void GetUndistortedImageFormat(const std::string& image_format,
+                               FREE_IMAGE_FORMAT* format, int* flags,
+                               std::vector<std::string>* extensions) {
+  if (image_format.empty()) {
+    *format = FIF_UNKNOWN;
+    *flags = 0;
+    *extensions = {};
+  } else if (image_format == "JPEG") {
+    *format = FIF_JPEG;
+    *flags = 0;
+    *extensions = {".jpg", ".jpeg"};
+  } else if (image_format == "PNG") {
+    *format = FIF_PNG;
+    *flags = PNG_Z_BEST_SPEED;
+    *extensions = {".png"};
+  } else if (image_format == "BMP") {
+    *format = FIF_BMP;
+    *flags = BMP_DEFAULT;
+    *extensions = {".bmp"};
+  } else if (image_format == "TIFF") {
+    *format = FIF_TIFF;
+    *flags = TIFF_NONE;
+    *extensions = {".tif", ".tiff"};
+  } else if (image_format == "WEBP") {
+    *format = FIF_WEBP;
+    *flags = WEBP_LOSSLESS;
+    *extensions = {".webp"};
+  } else {
+    LOG(FATAL) << "Invalid image format: " << image_format;
+  }
+}
+
+// Append the extension of the image format to the image name, if the image
+// name has a different extension.
+std::string GetUndistortedImageName(const UndistortImagesOptions& options,
+                                    const std::string& image_name) {
+  FREE_IMAGE_FORMAT format;
+  int flags;
+  std::vector<std::string> extensions;
+  GetUndistortedImageFormat(options.image_format, &format, &flags,
+                            &extensions);
+  if (extensions.empty()) {
+    return image_name;
+  }
+
+  std::string image_name_lower = image_name;
+  StringToLower(&image_name_lower);
+  for (const auto& extension : extensions) {
+    if (HasFileExtension(image_name_lower, extension)) {
+      return image_name;
+    }
+  }
+
+  return image_name + extensions[0];
+}
+
 template <typename Derived>
 void WriteMatrix(const Eigen::MatrixBase<Derived>& matrix,
                  std::ofstream* file) {
@@ -53,6 +117,210 @@ void WriteMatrix(const Eigen::MatrixBase<Derived>& matrix,
   }
 }
 
+// Compute the undistortion warp maps of all cameras that are shared by
+// multiple registered images, so that their camera models are only evaluated
+// once instead of for every image. Each map requires 8 bytes per pixel.
+std::unordered_map<camera_t, WarpMap> ComputeSharedUndistortionWarpMaps(
+    const UndistortCameraOptions& options,
+    const Reconstruction& reconstruction) {
+  std::unordered_map<camera_t, size_t> num_camera_images;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    num_camera_images[reconstruction.Image(image_id).CameraId()] += 1;
+  }
+
+  std::unordered_map<camera_t, WarpMap> warp_maps;
+  for (const auto& camera_num_images : num_camera_images) {
+    if (camera_num_images.second > 1) {
+      ComputeUndistortionWarpMap(
+          options, reconstruction.Camera(camera_num_images.first),
+          &warp_maps[camera_num_images.first], ThreadPool::kMaxNumThreads);
+    }
+  }
+
+  return warp_maps;
+}
+
+void UndistortImageWithWarpMaps(
+    const UndistortCameraOptions& options,
+    const std::unordered_map<camera_t, WarpMap>& warp_maps,
+    const camera_t camera_id, const Camera& distorted_camera,
+    const Bitmap& distorted_bitmap, Bitmap* undistorted_bitmap,
+    Camera* undistorted_camera) {
+  const auto warp_map = warp_maps.find(camera_id);
+  if (warp_map == warp_maps.end()) {
+    UndistortImage(options, distorted_bitmap, distorted_camera,
+                   undistorted_bitmap, undistorted_camera);
+  } else {
+    UndistortImage(options, warp_map->second, distorted_bitmap,
+                   distorted_camera, undistorted_bitmap, undistorted_camera);
+  }
+}
+
+// Check whether the output file was written after the last modification of
+// the input file.
+bool IsOutputUpToDate(const std::string& input_path,
+                      const std::string& output_path) {
+  return ExistsFile(input_path) && ExistsFile(output_path) &&
+         boost::filesystem::last_write_time(output_path) >=
+             boost::filesystem::last_write_time(input_path);
+}
+
+// Undistort the registered images in three concurrent stages, which read,
+// undistort, and write the images. The undistorted camera of every written or
+// skipped image is passed to `WriteCamera`, e.g., to write its projection
+// matrix. Images are first written to a temporary file, such that an
+// interrupted undistortion never leaves an incomplete image behind, which
+// would be skipped when resuming the undistortion.
+void UndistortRegImages(
+    const UndistortCameraOptions& options,
+    const UndistortImagesOptions& images_options,
+    const Reconstruction& reconstruction,
+    const std::unordered_map<camera_t, WarpMap>& warp_maps,
+    const std::string& image_path,
+    const std::function<std::string(const size_t)>& GetOutputImagePath,
+    const std::function<void(const size_t, const Camera&)>& WriteCamera,
+    Thread* thread) {
+  CHECK(images_options.Check());
+
+  struct UndistortionData {
+    size_t reg_image_idx = 0;
+    Bitmap bitmap;
+    Camera undistorted_camera;
+  };
+
+  FREE_IMAGE_FORMAT format;
+  int flags;
+  std::vector<std::string> extensions;
+  GetUndistortedImageFormat(images_options.image_format, &format, &flags,
+                            &extensions);
+
+  const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+  const size_t num_images = reg_image_ids.size();
+
+  std::mutex progress_mutex;
+  size_t num_processed_images = 0;
+  const auto PrintProgress = [&]() {
+    std::unique_lock<std::mutex> lock(progress_mutex);
+    num_processed_images += 1;
+    std::cout << StringPrintf("Undistorting image [%d/%d]",
+                              num_processed_images, num_images)
+              << std::endl;
+  };
+
+  JobQueue<UndistortionData> read_queue(images_options.max_num_queued_images);
+  JobQueue<UndistortionData> write_queue(
+      images_options.max_num_queued_images);
+
+  std::atomic<size_t> next_reg_image_idx(0);
+  const auto ReadImages = [&]() {
+    while (!thread->IsStopped()) {
+      const size_t reg_image_idx = next_reg_image_idx++;
+      if (reg_image_idx >= num_images) {
+        break;
+      }
+
+      const Image& image = reconstruction.Image(reg_image_ids[reg_image_idx]);
+      const std::string input_image_path = JoinPaths(image_path, image.Name());
+
+      if (images_options.skip_existing &&
+          IsOutputUpToDate(input_image_path,
+                           GetOutputImagePath(reg_image_idx))) {
+        WriteCamera(reg_image_idx,
+                    UndistortCamera(options,
+                                    reconstruction.Camera(image.CameraId())));
+        PrintProgress();
+        continue;
+      }
+
+      UndistortionData data;
+      data.reg_image_idx = reg_image_idx;
+      if (!data.bitmap.Read(input_image_path)) {
+        std::cerr << "ERROR: Cannot read image at path " << input_image_path
+                  << std::endl;
+        PrintProgress();
+        continue;
+      }
+
+      read_queue.Push(std::move(data));
+    }
+  };
+
+  const auto UndistortImages = [&]() {
+    while (true) {
+      auto input_job = read_queue.Pop();
+      if (!input_job.IsValid()) {
+        break;
+      }
+
+      UndistortionData& data = input_job.Data();
+      const Image& image =
+          reconstruction.Image(reg_image_ids[data.reg_image_idx]);
+      Bitmap undistorted_bitmap;
+      UndistortImageWithWarpMaps(
+          options, warp_maps, image.CameraId(),
+          reconstruction.Camera(image.CameraId()), data.bitmap,
+          &undistorted_bitmap, &data.undistorted_camera);
+      data.bitmap = std::move(undistorted_bitmap);
+
+      write_queue.Push(std::move(data));
+    }
+  };
+
+  const auto WriteImages = [&]() {
+    while (true) {
+      auto output_job = write_queue.Pop();
+      if (!output_job.IsValid()) {
+        break;
+      }
+
+      const UndistortionData& data = output_job.Data();
+      const std::string output_image_path =
+          GetOutputImagePath(data.reg_image_idx);
+
+      // Keep the extension, such that the format can be deduced from it.
+      std::string output_image_root;
+      std::string output_image_ext;
+      SplitFileExtension(output_image_path, &output_image_root,
+                         &output_image_ext);
+      const std::string tmp_image_path =
+          output_image_root + ".tmp" + output_image_ext;
+
+      if (data.bitmap.Write(tmp_image_path, format, flags)) {
+        boost::filesystem::rename(tmp_image_path, output_image_path);
+      } else {
+        std::cerr << "ERROR: Cannot write image at path " << output_image_path
+                  << std::endl;
+      }
+
+      WriteCamera(data.reg_image_idx, data.undistorted_camera);
+      PrintProgress();
+    }
+  };
+
+  ThreadPool read_thread_pool(images_options.num_read_threads);
+  ThreadPool undistort_thread_pool(images_options.num_threads);
+  ThreadPool write_thread_pool(images_options.num_write_threads);
+
+  for (size_t i = 0; i < read_thread_pool.NumThreads(); ++i) {
+    read_thread_pool.AddTask(ReadImages);
+  }
+  for (size_t i = 0; i < undistort_thread_pool.NumThreads(); ++i) {
+    undistort_thread_pool.AddTask(UndistortImages);
+  }
+  for (size_t i = 0; i < write_thread_pool.NumThreads(); ++i) {
+    write_thread_pool.AddTask(WriteImages);
+  }
+
+  // Drain the stages in order, such that every read image is written.
+  read_thread_pool.Wait();
+  read_queue.Wait();
+  read_queue.Stop();
+  undistort_thread_pool.Wait();
+  write_queue.Wait();
+  write_queue.Stop();
+  write_thread_pool.Wait();
+}
+
 // Write projection matrix P = K * [R t] to file and prepend given header.
 void WriteProjectionMatrix(const std::string& path, const Camera& camera,
                            const Image& image, const std::string& header) {
@@ -148,89 +416,123 @@ void WriteCOLMAPCommands(const bool geometric,
 
 }  // namespace
 
-COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
-                                     const Reconstruction& reconstruction,
-                                     const std::string& image_path,
-                                     const std::string& output_path)
+bool UndistortImagesOptions::Check() const {
+  CHECK_OPTION_NE(num_read_threads, 0);
+  CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_NE(num_write_threads, 0);
+  CHECK_OPTION_GT(max_num_queued_images, 0);
+  CHECK_OPTION(image_format.empty() || image_format == "JPEG" ||
+               image_format == "PNG" || image_format == "BMP" ||
+               image_format == "TIFF" || image_format == "WEBP");
+  return true;
+}
+
+COLMAPUndistorter::COLMAPUndistorter(
+    const UndistortCameraOptions& options, const Reconstruction& reconstruction,
+    const std::string& image_path, const std::string& output_path,
+    const bool write_images, const UndistortImagesOptions& images_options)
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      write_images_(write_images),
+      images_options_(images_options),
+      reconstruction_(reconstruction) {
+  if (!write_images_) {
+    // The workspace reads the original images under their original name.
+    images_options_.image_format = "";
+  }
+}
 
 void COLMAPUndistorter::Run() {
+  const int kNumConfigThreads = 4;
+
   PrintHeading1("Image undistortion");
 
-  CreateDirIfNotExists(JoinPaths(output_path_, "images"));
   CreateDirIfNotExists(JoinPaths(output_path_, "sparse"));
   CreateDirIfNotExists(JoinPaths(output_path_, "stereo"));
   CreateDirIfNotExists(JoinPaths(output_path_, "stereo/depth_maps"));
   CreateDirIfNotExists(JoinPaths(output_path_, "stereo/normal_maps"));
   CreateDirIfNotExists(JoinPaths(output_path_, "stereo/consistency_graphs"));
-  reconstruction_.CreateImageDirs(JoinPaths(output_path_, "images"));
   reconstruction_.CreateImageDirs(JoinPaths(output_path_, "stereo/depth_maps"));
   reconstruction_.CreateImageDirs(
       JoinPaths(output_path_, "stereo/normal_maps"));
   reconstruction_.CreateImageDirs(
       JoinPaths(output_path_, "stereo/consistency_graphs"));
 
-  ThreadPool thread_pool;
-  std::vector<std::future<void>> futures;
-  futures.reserve(reconstruction_.NumRegImages());
-  for (size_t i = 0; i < reconstruction_.NumRegImages(); ++i) {
-    futures.push_back(
-        thread_pool.AddTask(&COLMAPUndistorter::Undistort, this, i));
-  }
-
-  for (size_t i = 0; i < futures.size(); ++i) {
-    if (IsStopped()) {
-      break;
+  if (write_images_) {
+    // Otherwise, the workspace would keep undistorting the original images.
+    const auto config_path =
+        JoinPaths(output_path_, "stereo/undistortion.cfg");
+    if (ExistsFile(config_path)) {
+      boost::filesystem::remove(config_path);
     }
 
-    std::cout << StringPrintf("Undistorting image [%d/%d]", i + 1,
-                              futures.size())
-              << std::endl;
-
-    futures[i].get();
+    CreateDirIfNotExists(JoinPaths(output_path_, "images"));
+    reconstruction_.CreateImageDirs(JoinPaths(output_path_, "images"));
   }
 
-  std::cout << "Writing reconstruction..." << std::endl;
-  Reconstruction undistorted_reconstruction = reconstruction_;
-  UndistortReconstruction(options_, &undistorted_reconstruction);
-  undistorted_reconstruction.Write(JoinPaths(output_path_, "sparse"));
+  // The reconstruction and configuration do not depend on the undistorted
+  // images, such that they are written while the images are undistorted.
+  std::cout << "Writing reconstruction and configuration..." << std::endl;
+  ThreadPool config_thread_pool(kNumConfigThreads);
+  config_thread_pool.AddTask([this]() {
+    Reconstruction undistorted_reconstruction = reconstruction_;
+    UndistortReconstruction(options_, &undistorted_reconstruction);
+    for (const auto image_id : undistorted_reconstruction.RegImageIds()) {
+      Image& image = undistorted_reconstruction.Image(image_id);
+      image.SetName(GetUndistortedImageName(images_options_, image.Name()));
+    }
+    undistorted_reconstruction.Write(JoinPaths(output_path_, "sparse"));
+  });
+  config_thread_pool.AddTask(&COLMAPUndistorter::WritePatchMatchConfig, this);
+  config_thread_pool.AddTask(&COLMAPUndistorter::WriteFusionConfig, this);
+  config_thread_pool.AddTask(&COLMAPUndistorter::WriteScript, this, false);
+  config_thread_pool.AddTask(&COLMAPUndistorter::WriteScript, this, true);
+  if (!write_images_) {
+    config_thread_pool.AddTask(&COLMAPUndistorter::WriteUndistortionConfig,
+                               this);
+  }
 
-  std::cout << "Writing configuration..." << std::endl;
-  WritePatchMatchConfig();
-  WriteFusionConfig();
+  if (write_images_) {
+    warp_maps_ = ComputeSharedUndistortionWarpMaps(options_, reconstruction_);
+    UndistortRegImages(
+        options_, images_options_, reconstruction_, warp_maps_, image_path_,
+        [this](const size_t reg_image_idx) {
+          const Image& image = reconstruction_.Image(
+              reconstruction_.RegImageIds()[reg_image_idx]);
+          return JoinPaths(
+              output_path_, "images",
+              GetUndistortedImageName(images_options_, image.Name()));
+        },
+        [](const size_t, const Camera&) {}, this);
+  }
 
-  std::cout << "Writing scripts..." << std::endl;
-  WriteScript(false);
-  WriteScript(true);
+  config_thread_pool.Wait();
 
   GetTimer().PrintMinutes();
 }
 
-void COLMAPUndistorter::Undistort(const size_t reg_image_idx) const {
-  const image_t image_id = reconstruction_.RegImageIds().at(reg_image_idx);
-  const Image& image = reconstruction_.Image(image_id);
-  const Camera& camera = reconstruction_.Camera(image.CameraId());
+void COLMAPUndistorter::WriteUndistortionConfig() const {
+  const auto path = JoinPaths(output_path_, "stereo/undistortion.cfg");
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
 
-  const std::string output_image_path =
-      JoinPaths(output_path_, "images", image.Name());
+  // Make sure that we don't lose any precision by using the shortest
+  // representation of a double that guarantees a round-trip conversion.
+  file.precision(17);
 
-  Bitmap distorted_bitmap;
-  const std::string input_image_path = JoinPaths(image_path_, image.Name());
-  if (!distorted_bitmap.Read(input_image_path)) {
-    std::cerr << "ERROR: Cannot read image at path " << input_image_path
-              << std::endl;
-    return;
+  file << boost::filesystem::absolute(image_path_).string() << std::endl;
+  for (const auto image_id : reconstruction_.RegImageIds()) {
+    const auto& image = reconstruction_.Image(image_id);
+    const auto& camera = reconstruction_.Camera(image.CameraId());
+    file << image.Name() << " " << image.CameraId() << " "
+         << camera.ModelName() << " " << camera.Width() << " "
+         << camera.Height();
+    for (const double param : camera.Params()) {
+      file << " " << param;
+    }
+    file << std::endl;
   }
-
-  Bitmap undistorted_bitmap;
-  Camera undistorted_camera;
-  UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
-
-  undistorted_bitmap.Write(output_image_path);
 }
 
 void COLMAPUndistorter::WritePatchMatchConfig() const {
@@ -239,7 +541,8 @@ void COLMAPUndistorter::WritePatchMatchConfig() const {
   CHECK(file.is_open()) << path;
   for (const auto image_id : reconstruction_.RegImageIds()) {
     const auto& image = reconstruction_.Image(image_id);
-    file << image.Name() << std::endl;
+    file << GetUndistortedImageName(images_options_, image.Name())
+         << std::endl;
     file << "__auto__, 20" << std::endl;
   }
 }
@@ -250,7 +553,8 @@ void COLMAPUndistorter::WriteFusionConfig() const {
   CHECK(file.is_open()) << path;
   for (const auto image_id : reconstruction_.RegImageIds()) {
     const auto& image = reconstruction_.Image(image_id);
-    file << image.Name() << std::endl;
+    file << GetUndistortedImageName(images_options_, image.Name())
+         << std::endl;
   }
 }
 
@@ -269,13 +573,20 @@ void COLMAPUndistorter::WriteScript(const bool geometric) const {
 PMVSUndistorter::PMVSUndistorter(const UndistortCameraOptions& options,
                                  const Reconstruction& reconstruction,
                                  const std::string& image_path,
-                                 const std::string& output_path)
+                                 const std::string& output_path,
+                                 const UndistortImagesOptions& images_options)
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      images_options_(images_options),
+      reconstruction_(reconstruction) {
+  // PMVS only reads JPEG images.
+  images_options_.image_format = "";
+}
 
 void PMVSUndistorter::Run() {
+  const int kNumConfigThreads = 4;
+
   PrintHeading1("Image undistortion (CMVS/PMVS)");
 
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs"));
@@ -283,83 +594,59 @@ void PMVSUndistorter::Run() {
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs/visualize"));
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs/models"));
 
-  ThreadPool thread_pool;
-  std::vector<std::future<void>> futures;
-  futures.reserve(reconstruction_.NumRegImages());
-  for (size_t i = 0; i < reconstruction_.NumRegImages(); ++i) {
-    futures.push_back(
-        thread_pool.AddTask(&PMVSUndistorter::Undistort, this, i));
-  }
-
-  for (size_t i = 0; i < futures.size(); ++i) {
-    if (IsStopped()) {
-      thread_pool.Stop();
-      std::cout << "WARNING: Stopped the undistortion process. Image point "
-                   "locations and camera parameters for not yet processed "
-                   "images in the Bundler output file is probably wrong."
-                << std::endl;
-      break;
-    }
-
-    std::cout << StringPrintf("Undistorting image [%d/%d]", i + 1,
-                              futures.size())
+  // The bundle, visibility, and option files and the scripts do not depend on
+  // the undistorted images, such that they are written while the images are
+  // undistorted.
+  std::cout << "Writing bundle, visibility, and option files..." << std::endl;
+  ThreadPool config_thread_pool(kNumConfigThreads);
+  config_thread_pool.AddTask([this]() {
+    Reconstruction undistorted_reconstruction = reconstruction_;
+    UndistortReconstruction(options_, &undistorted_reconstruction);
+    const std::string bundle_path =
+        JoinPaths(output_path_, "pmvs/bundle.rd.out");
+    undistorted_reconstruction.ExportBundler(bundle_path,
+                                             bundle_path + ".list.txt");
+  });
+  config_thread_pool.AddTask(&PMVSUndistorter::WriteVisibilityData, this);
+  config_thread_pool.AddTask(&PMVSUndistorter::WriteOptionFile, this);
+  config_thread_pool.AddTask([this]() {
+    WritePMVSScript();
+    WriteCMVSPMVSScript();
+    WriteCOLMAPScript(false);
+    WriteCOLMAPScript(true);
+    WriteCMVSCOLMAPScript(false);
+    WriteCMVSCOLMAPScript(true);
+  });
+
+  warp_maps_ = ComputeSharedUndistortionWarpMaps(options_, reconstruction_);
+  UndistortRegImages(
+      options_, images_options_, reconstruction_, warp_maps_, image_path_,
+      [this](const size_t reg_image_idx) {
+        return JoinPaths(output_path_, StringPrintf("pmvs/visualize/%08d.jpg",
+                                                    reg_image_idx));
+      },
+      [this](const size_t reg_image_idx, const Camera& undistorted_camera) {
+        const Image& image = reconstruction_.Image(
+            reconstruction_.RegImageIds()[reg_image_idx]);
+        WriteProjectionMatrix(
+            JoinPaths(output_path_,
+                      StringPrintf("pmvs/txt/%08d.txt", reg_image_idx)),
+            undistorted_camera, image, "CONTOUR");
+      },
+      this);
+
+  if (IsStopped()) {
+    std::cout << "WARNING: Stopped the undistortion process. The images and "
+                 "projection matrices of not yet processed images are "
+                 "missing in the PMVS output."
               << std::endl;
-
-    futures[i].get();
   }
 
-  std::cout << "Writing bundle file..." << std::endl;
-  Reconstruction undistorted_reconstruction = reconstruction_;
-  UndistortReconstruction(options_, &undistorted_reconstruction);
-  const std::string bundle_path = JoinPaths(output_path_, "pmvs/bundle.rd.out");
-  undistorted_reconstruction.ExportBundler(bundle_path,
-                                           bundle_path + ".list.txt");
-
-  std::cout << "Writing visibility file..." << std::endl;
-  WriteVisibilityData();
-
-  std::cout << "Writing option file..." << std::endl;
-  WriteOptionFile();
-
-  std::cout << "Writing scripts..." << std::endl;
-  WritePMVSScript();
-  WriteCMVSPMVSScript();
-  WriteCOLMAPScript(false);
-  WriteCOLMAPScript(true);
-  WriteCMVSCOLMAPScript(false);
-  WriteCMVSCOLMAPScript(true);
+  config_thread_pool.Wait();
 
   GetTimer().PrintMinutes();
 }
 
-void PMVSUndistorter::Undistort(const size_t reg_image_idx) const {
-  const std::string output_image_path = JoinPaths(
-      output_path_, StringPrintf("pmvs/visualize/%08d.jpg", reg_image_idx));
-  const std::string proj_matrix_path =
-      JoinPaths(output_path_, StringPrintf("pmvs/txt/%08d.txt", reg_image_idx));
-
-  const image_t image_id = reconstruction_.RegImageIds().at(reg_image_idx);
-  const Image& image = reconstruction_.Image(image_id);
-  const Camera& camera = reconstruction_.Camera(image.CameraId());
-
-  Bitmap distorted_bitmap;
-  const std::string input_image_path = JoinPaths(image_path_, image.Name());
-  if (!distorted_bitmap.Read(input_image_path)) {
-    std::cerr << StringPrintf("ERROR: Cannot read image at path %s",
-                              input_image_path.c_str())
-              << std::endl;
-    return;
-  }
-
-  Bitmap undistorted_bitmap;
-  Camera undistorted_camera;
-  UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
-
-  undistorted_bitmap.Write(output_image_path);
-  WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
-}
-
 void PMVSUndistorter::WriteVisibilityData() const {
   const auto path = JoinPaths(output_path_, "pmvs/vis.dat");
   std::ofstream file(path, std::ios::trunc);
@@ -498,68 +785,42 @@ void PMVSUndistorter::WriteOptionFile() const {
   file << "oimages 0" << std::endl;
 }
 
-CMPMVSUndistorter::CMPMVSUndistorter(const UndistortCameraOptions& options,
-                                     const Reconstruction& reconstruction,
-                                     const std::string& image_path,
-                                     const std::string& output_path)
+CMPMVSUndistorter::CMPMVSUndistorter(
+    const UndistortCameraOptions& options, const Reconstruction& reconstruction,
+    const std::string& image_path, const std::string& output_path,
+    const UndistortImagesOptions& images_options)
     : options_(options),
       image_path_(image_path),
       output_path_(output_path),
-      reconstruction_(reconstruction) {}
+      images_options_(images_options),
+      reconstruction_(reconstruction) {
+  // CMP-MVS only reads JPEG images.
+  images_options_.image_format = "";
+}
 
 void CMPMVSUndistorter::Run() {
   PrintHeading1("Image undistortion (CMP-MVS)");
 
-  ThreadPool thread_pool;
-  std::vector<std::future<void>> futures;
-  futures.reserve(reconstruction_.NumRegImages());
-  for (size_t i = 0; i < reconstruction_.NumRegImages(); ++i) {
-    futures.push_back(
-        thread_pool.AddTask(&CMPMVSUndistorter::Undistort, this, i));
-  }
-
-  for (size_t i = 0; i < futures.size(); ++i) {
-    if (IsStopped()) {
-      break;
-    }
-
-    std::cout << StringPrintf("Undistorting image [%d/%d]", i + 1,
-                              futures.size())
-              << std::endl;
-
-    futures[i].get();
-  }
+  warp_maps_ = ComputeSharedUndistortionWarpMaps(options_, reconstruction_);
+  UndistortRegImages(
+      options_, images_options_, reconstruction_, warp_maps_, image_path_,
+      [this](const size_t reg_image_idx) {
+        return JoinPaths(output_path_,
+                         StringPrintf("%05d.jpg", reg_image_idx + 1));
+      },
+      [this](const size_t reg_image_idx, const Camera& undistorted_camera) {
+        const Image& image = reconstruction_.Image(
+            reconstruction_.RegImageIds()[reg_image_idx]);
+        WriteProjectionMatrix(
+            JoinPaths(output_path_,
+                      StringPrintf("%05d_P.txt", reg_image_idx + 1)),
+            undistorted_camera, image, "CONTOUR");
+      },
+      this);
 
   GetTimer().PrintMinutes();
 }
 
-void CMPMVSUndistorter::Undistort(const size_t reg_image_idx) const {
-  const std::string output_image_path =
-      JoinPaths(output_path_, StringPrintf("%05d.jpg", reg_image_idx + 1));
-  const std::string proj_matrix_path =
-      JoinPaths(output_path_, StringPrintf("%05d_P.txt", reg_image_idx + 1));
-
-  const image_t image_id = reconstruction_.RegImageIds().at(reg_image_idx);
-  const Image& image = reconstruction_.Image(image_id);
-  const Camera& camera = reconstruction_.Camera(image.CameraId());
-
-  Bitmap distorted_bitmap;
-  const std::string input_image_path = JoinPaths(image_path_, image.Name());
-  if (!distorted_bitmap.Read(input_image_path)) {
-    std::cerr << "ERROR: Cannot read image at path " << input_image_path
-              << std::endl;
-    return;
-  }
-
-  Bitmap undistorted_bitmap;
-  Camera undistorted_camera;
-  UndistortImage(options_, distorted_bitmap, camera, &undistorted_bitmap,
-                 &undistorted_camera);
-
-  undistorted_bitmap.Write(output_image_path);
-  WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
-}
-
 PureImageUndistorter::PureImageUndistorter(
   const UndistortCameraOptions& options, const std::string& image_path,
   const std::string& output_path,
@@ -634,13 +895,14 @@ StereoImageRectifier::StereoImageRectifier(
 void StereoImageRectifier::Run() {
   PrintHeading1("Stereo rectification");
 
+  ComputeSharedRectificationMaps();
+
   ThreadPool thread_pool;
   std::vector<std::future<void>> futures;
   futures.reserve(stereo_pairs_.size());
-  for (const auto& stereo_pair : stereo_pairs_) {
-    futures.push_back(thread_pool.AddTask(&StereoImageRectifier::Rectify, this,
-                                          stereo_pair.first,
-                                          stereo_pair.second));
+  for (size_t i = 0; i < stereo_pairs_.size(); ++i) {
+    futures.push_back(
+        thread_pool.AddTask(&StereoImageRectifier::Rectify, this, i));
   }
 
   for (size_t i = 0; i < futures.size(); ++i) {
@@ -658,10 +920,80 @@ void StereoImageRectifier::Run() {
   GetTimer().PrintMinutes();
 }
 
-void StereoImageRectifier::Rectify(const image_t image_id1,
-                                   const image_t image_id2) const {
-  const Image& image1 = reconstruction_.Image(image_id1);
-  const Image& image2 = reconstruction_.Image(image_id2);
+void StereoImageRectifier::ComputeSharedRectificationMaps() {
+  // The maximum difference of the quaternions and of the normalized
+  // translations, for which the relative poses of two stereo pairs are
+  // considered the same. This is far below the accuracy of the rectification,
+  // but far above the numerical differences of the relative poses of a rigid
+  // camera rig in the reconstruction.
+  const double kMaxRelativePoseDiff = 1e-6;
+
+  struct StereoConfig {
+    camera_t camera_id1;
+    camera_t camera_id2;
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+    std::vector<size_t> stereo_pair_idxs;
+  };
+
+  std::vector<StereoConfig, Eigen::aligned_allocator<StereoConfig>> configs;
+  std::map<std::pair<camera_t, camera_t>, std::vector<size_t>>
+      camera_pair_configs;
+  for (size_t i = 0; i < stereo_pairs_.size(); ++i) {
+    const Image& image1 = reconstruction_.Image(stereo_pairs_[i].first);
+    const Image& image2 = reconstruction_.Image(stereo_pairs_[i].second);
+
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+    ComputeRelativePose(image1.Qvec(), image1.Tvec(), image2.Qvec(),
+                        image2.Tvec(), &qvec, &tvec);
+
+    auto& config_idxs = camera_pair_configs[std::make_pair(
+        image1.CameraId(), image2.CameraId())];
+
+    bool found_config = false;
+    for (const size_t config_idx : config_idxs) {
+      StereoConfig& config = configs[config_idx];
+      const double tvec_norm = std::max(config.tvec.norm(), 1e-12);
+      if ((config.qvec - qvec).cwiseAbs().maxCoeff() <= kMaxRelativePoseDiff &&
+          (config.tvec - tvec).norm() / tvec_norm <= kMaxRelativePoseDiff) {
+        config.stereo_pair_idxs.push_back(i);
+        found_config = true;
+        break;
+      }
+    }
+
+    if (!found_config) {
+      config_idxs.push_back(configs.size());
+      configs.push_back(
+          {image1.CameraId(), image2.CameraId(), qvec, tvec, {i}});
+    }
+  }
+
+  rectification_map_idxs_.assign(stereo_pairs_.size(), -1);
+  rectification_maps_.clear();
+  for (const auto& config : configs) {
+    if (config.stereo_pair_idxs.size() < 2) {
+      continue;
+    }
+
+    for (const size_t stereo_pair_idx : config.stereo_pair_idxs) {
+      rectification_map_idxs_[stereo_pair_idx] =
+          static_cast<int>(rectification_maps_.size());
+    }
+
+    rectification_maps_.emplace_back();
+    ComputeStereoRectificationMaps(
+        options_, reconstruction_.Camera(config.camera_id1),
+        reconstruction_.Camera(config.camera_id2), config.qvec, config.tvec,
+        &rectification_maps_.back(), ThreadPool::kMaxNumThreads);
+  }
+}
+
+void StereoImageRectifier::Rectify(const size_t stereo_pair_idx) const {
+  const auto& stereo_pair = stereo_pairs_[stereo_pair_idx];
+  const Image& image1 = reconstruction_.Image(stereo_pair.first);
+  const Image& image2 = reconstruction_.Image(stereo_pair.second);
   const Camera& camera1 = reconstruction_.Camera(image1.CameraId());
   const Camera& camera2 = reconstruction_.Camera(image2.CameraId());
 
@@ -694,19 +1026,28 @@ void StereoImageRectifier::Rectify(const image_t image_id1,
     return;
   }
 
-  Eigen::Vector4d qvec;
-  Eigen::Vector3d tvec;
-  ComputeRelativePose(image1.Qvec(), image1.Tvec(), image2.Qvec(),
-                      image2.Tvec(), &qvec, &tvec);
-
   Bitmap undistorted_bitmap1;
   Bitmap undistorted_bitmap2;
-  Camera undistorted_camera;
   Eigen::Matrix4d Q;
-  RectifyAndUndistortStereoImages(
-      options_, distorted_bitmap1, distorted_bitmap2, camera1, camera2, qvec,
-      tvec, &undistorted_bitmap1, &undistorted_bitmap2, &undistorted_camera,
-      &Q);
+  const int rectification_map_idx = rectification_map_idxs_[stereo_pair_idx];
+  if (rectification_map_idx >= 0) {
+    const StereoRectificationMaps& maps =
+        rectification_maps_[rectification_map_idx];
+    RectifyAndUndistortStereoImages(maps, distorted_bitmap1, distorted_bitmap2,
+                                    &undistorted_bitmap1, &undistorted_bitmap2);
+    Q = maps.Q;
+  } else {
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+    ComputeRelativePose(image1.Qvec(), image1.Tvec(), image2.Qvec(),
+                        image2.Tvec(), &qvec, &tvec);
+
+    Camera undistorted_camera;
+    RectifyAndUndistortStereoImages(
+        options_, distorted_bitmap1, distorted_bitmap2, camera1, camera2, qvec,
+        tvec, &undistorted_bitmap1, &undistorted_bitmap2, &undistorted_camera,
+        &Q);
+  }
 
   undistorted_bitmap1.Write(output_image1_path);
   undistorted_bitmap2.Write(output_image2_path);
@@ -919,6 +1260,31 @@ void UndistortImage(const UndistortCameraOptions& options,
                           distorted_bitmap, undistorted_bitmap);
 }
 
+void ComputeUndistortionWarpMap(const UndistortCameraOptions& options,
+                                const Camera& distorted_camera,
+                                WarpMap* warp_map, const int num_threads) {
+  const Camera undistorted_camera = UndistortCamera(options, distorted_camera);
+  ComputeWarpMapBetweenCameras(distorted_camera, undistorted_camera, warp_map,
+                               num_threads);
+}
+
+void UndistortImage(const UndistortCameraOptions& options,
+                    const WarpMap& warp_map, const Bitmap& distorted_bitmap,
+                    const Camera& distorted_camera, Bitmap* undistorted_bitmap,
+                    Camera* undistorted_camera) {
+  CHECK_EQ(distorted_camera.Width(), distorted_bitmap.Width());
+  CHECK_EQ(distorted_camera.Height(), distorted_bitmap.Height());
+
+  *undistorted_camera = UndistortCamera(options, distorted_camera);
+  CHECK_EQ(static_cast<size_t>(warp_map.target_width),
+           undistorted_camera->Width());
+  CHECK_EQ(static_cast<size_t>(warp_map.target_height),
+           undistorted_camera->Height());
+
+  WarpImageWithMap(warp_map, distorted_bitmap, undistorted_bitmap);
+  distorted_bitmap.CloneMetadata(undistorted_bitmap);
+}
+
 void UndistortReconstruction(const UndistortCameraOptions& options,
                              Reconstruction* reconstruction) {
   const auto distorted_cameras = reconstruction->Cameras();
@@ -931,11 +1297,16 @@ void UndistortReconstruction(const UndistortCameraOptions& options,
     auto& image = reconstruction->Image(distorted_image.first);
     const auto& distorted_camera = distorted_cameras.at(image.CameraId());
     const auto& undistorted_camera = reconstruction->Camera(image.CameraId());
+    std::vector<Eigen::Vector2d> points2D(image.NumPoints2D());
     for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
          ++point2D_idx) {
-      auto& point2D = image.Point2D(point2D_idx);
-      point2D.SetXY(undistorted_camera.WorldToImage(
-          distorted_camera.ImageToWorld(point2D.XY())));
+      points2D[point2D_idx] = image.Point2D(point2D_idx).XY();
+    }
+    distorted_camera.ImageToWorld(points2D, &points2D);
+    undistorted_camera.WorldToImage(points2D, &points2D);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      image.Point2D(point2D_idx).SetXY(points2D[point2D_idx]);
     }
   }
 }
@@ -1009,33 +1380,55 @@ void RectifyAndUndistortStereoImages(
     const Eigen::Vector3d& tvec, Bitmap* undistorted_image1,
     Bitmap* undistorted_image2, Camera* undistorted_camera,
     Eigen::Matrix4d* Q) {
-  CHECK_EQ(distorted_camera1.Width(), distorted_image1.Width());
-  CHECK_EQ(distorted_camera1.Height(), distorted_image1.Height());
-  CHECK_EQ(distorted_camera2.Width(), distorted_image2.Width());
-  CHECK_EQ(distorted_camera2.Height(), distorted_image2.Height());
+  StereoRectificationMaps maps;
+  ComputeStereoRectificationMaps(options, distorted_camera1, distorted_camera2,
+                                 qvec, tvec, &maps);
+  RectifyAndUndistortStereoImages(maps, distorted_image1, distorted_image2,
+                                  undistorted_image1, undistorted_image2);
+  *undistorted_camera = maps.undistorted_camera;
+  *Q = maps.Q;
+}
 
-  *undistorted_camera = UndistortCamera(options, distorted_camera1);
-  undistorted_image1->Allocate(static_cast<int>(undistorted_camera->Width()),
-                               static_cast<int>(undistorted_camera->Height()),
-                               distorted_image1.IsRGB());
-  distorted_image1.CloneMetadata(undistorted_image1);
+void ComputeStereoRectificationMaps(const UndistortCameraOptions& options,
+                                    const Camera& distorted_camera1,
+                                    const Camera& distorted_camera2,
+                                    const Eigen::Vector4d& qvec,
+                                    const Eigen::Vector3d& tvec,
+                                    StereoRectificationMaps* maps,
+                                    const int num_threads) {
+  CHECK_NOTNULL(maps);
 
-  undistorted_image2->Allocate(static_cast<int>(undistorted_camera->Width()),
-                               static_cast<int>(undistorted_camera->Height()),
-                               distorted_image2.IsRGB());
-  distorted_image2.CloneMetadata(undistorted_image2);
+  maps->undistorted_camera = UndistortCamera(options, distorted_camera1);
 
   Eigen::Matrix3d H1;
   Eigen::Matrix3d H2;
-  RectifyStereoCameras(*undistorted_camera, *undistorted_camera, qvec, tvec,
-                       &H1, &H2, Q);
-
-  WarpImageWithHomographyBetweenCameras(H1.inverse(), distorted_camera1,
-                                        *undistorted_camera, distorted_image1,
-                                        undistorted_image1);
-  WarpImageWithHomographyBetweenCameras(H2.inverse(), distorted_camera2,
-                                        *undistorted_camera, distorted_image2,
-                                        undistorted_image2);
+  RectifyStereoCameras(maps->undistorted_camera, maps->undistorted_camera,
+                       qvec, tvec, &H1, &H2, &maps->Q);
+
+  ComputeWarpMapWithHomographyBetweenCameras(
+      H1.inverse(), distorted_camera1, maps->undistorted_camera,
+      &maps->warp_map1, num_threads);
+  ComputeWarpMapWithHomographyBetweenCameras(
+      H2.inverse(), distorted_camera2, maps->undistorted_camera,
+      &maps->warp_map2, num_threads);
+}
+
+void RectifyAndUndistortStereoImages(const StereoRectificationMaps& maps,
+                                     const Bitmap& distorted_image1,
+                                     const Bitmap& distorted_image2,
+                                     Bitmap* undistorted_image1,
+                                     Bitmap* undistorted_image2,
+                                     const int num_threads) {
+  CHECK_NOTNULL(undistorted_image1);
+  CHECK_NOTNULL(undistorted_image2);
+
+  WarpImageWithMap(maps.warp_map1, distorted_image1, undistorted_image1,
+                   num_threads);
+  distorted_image1.CloneMetadata(undistorted_image1);
+
+  WarpImageWithMap(maps.warp_map2, distorted_image2, undistorted_image2,
+                   num_threads);
+  distorted_image2.CloneMetadata(undistorted_image2);
 }
 
 }  // namespace colmap
@@ -32,7 +32,10 @@
 #ifndef COLMAP_SRC_BASE_UNDISTORTION_H_
 #define COLMAP_SRC_BASE_UNDISTORTION_H_
 
+#include <unordered_map>
+
 #include "base/reconstruction.h"
+#include "base/warp.h"
 #include "util/alignment.h"
 #include "util/bitmap.h"
 #include "util/threading.h"
@@ -61,19 +64,76 @@ struct UndistortCameraOptions {
   double roi_max_y = 1.0;
 };
 
+struct UndistortImagesOptions {
+  // The number of threads that read, undistort, and write the images. The
+  // three stages run concurrently, such that the decoding and encoding of
+  // images overlaps with their undistortion. If negative, all available cores
+  // are used.
+  int num_read_threads = 2;
+  int num_threads = -1;
+  int num_write_threads = -1;
+
+  // The maximum number of images waiting between two stages, which bounds the
+  // memory usage, if reading or writing is faster than undistorting.
+  int max_num_queued_images = 16;
+
+  // The format of the undistorted images in {"", "JPEG", "PNG", "BMP",
+  // "TIFF", "WEBP"}. By default, the format is deduced from the image name.
+  // PNG images use the fastest compression level, BMP and TIFF images are not
+  // compressed, and WEBP images are compressed losslessly. If the image name
+  // has a different extension, the extension of the format is appended to the
+  // name of the undistorted image. Only used for the COLMAP output, since PMVS
+  // and CMP-MVS require JPEG images.
+  std::string image_format = "";
+
+  // Whether to skip images, whose undistorted image was written after the
+  // last modification of the original image, e.g., when resuming an
+  // interrupted undistortion.
+  bool skip_existing = false;
+
+  bool Check() const;
+};
+
+// Precomputed rectification and undistortion of a stereo camera pair. It only
+// depends on the cameras and their relative pose, such that it can be reused
+// for all image pairs of a calibrated stereo rig.
+struct StereoRectificationMaps {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  // The common undistorted camera of both rectified images.
+  Camera undistorted_camera;
+
+  // Transformation from [x, y, disparity, 1] to world coordinates, see
+  // `RectifyStereoCameras`.
+  Eigen::Matrix4d Q = Eigen::Matrix4d::Identity();
+
+  // The warp maps from the rectified to the distorted images.
+  WarpMap warp_map1;
+  WarpMap warp_map2;
+};
+
 // Undistort images and export undistorted cameras, as required by the
 // mvs::PatchMatchController class.
+//
+// If the undistorted images are not written, the original image path and the
+// distorted cameras of the images are written to "stereo/undistortion.cfg"
+// instead, so that the mvs::Workspace undistorts the original images on the
+// fly when they are read. This avoids storing a full undistorted copy of every
+// image at the cost of undistorting the images whenever they are read.
 class COLMAPUndistorter : public Thread {
  public:
   COLMAPUndistorter(const UndistortCameraOptions& options,
                     const Reconstruction& reconstruction,
                     const std::string& image_path,
-                    const std::string& output_path);
+                    const std::string& output_path,
+                    const bool write_images = true,
+                    const UndistortImagesOptions& images_options =
+                        UndistortImagesOptions());
 
  private:
   void Run();
 
-  void Undistort(const size_t reg_image_idx) const;
+  void WriteUndistortionConfig() const;
   void WritePatchMatchConfig() const;
   void WriteFusionConfig() const;
   void WriteScript(const bool geometric) const;
@@ -81,7 +141,10 @@ class COLMAPUndistorter : public Thread {
   UndistortCameraOptions options_;
   std::string image_path_;
   std::string output_path_;
+  bool write_images_;
+  UndistortImagesOptions images_options_;
   const Reconstruction& reconstruction_;
+  std::unordered_map<camera_t, WarpMap> warp_maps_;
 };
 
 // Undistort images and prepare data for CMVS/PMVS.
@@ -90,12 +153,13 @@ class PMVSUndistorter : public Thread {
   PMVSUndistorter(const UndistortCameraOptions& options,
                   const Reconstruction& reconstruction,
                   const std::string& image_path,
-                  const std::string& output_path);
+                  const std::string& output_path,
+                  const UndistortImagesOptions& images_options =
+                      UndistortImagesOptions());
 
  private:
   void Run();
 
-  void Undistort(const size_t reg_image_idx) const;
   void WriteVisibilityData() const;
   void WriteOptionFile() const;
   void WritePMVSScript() const;
@@ -106,7 +170,9 @@ class PMVSUndistorter : public Thread {
   UndistortCameraOptions options_;
   std::string image_path_;
   std::string output_path_;
+  UndistortImagesOptions images_options_;
   const Reconstruction& reconstruction_;
+  std::unordered_map<camera_t, WarpMap> warp_maps_;
 };
 
 // Undistort images and prepare data for CMP-MVS.
@@ -115,17 +181,19 @@ class CMPMVSUndistorter : public Thread {
   CMPMVSUndistorter(const UndistortCameraOptions& options,
                     const Reconstruction& reconstruction,
                     const std::string& image_path,
-                    const std::string& output_path);
+                    const std::string& output_path,
+                    const UndistortImagesOptions& images_options =
+                        UndistortImagesOptions());
 
  private:
   void Run();
 
-  void Undistort(const size_t reg_image_idx) const;
-
   UndistortCameraOptions options_;
   std::string image_path_;
   std::string output_path_;
+  UndistortImagesOptions images_options_;
   const Reconstruction& reconstruction_;
+  std::unordered_map<camera_t, WarpMap> warp_maps_;
 };
   
 // Undistort images and export undistorted cameras without the need for a
@@ -149,7 +217,9 @@ class PureImageUndistorter : public Thread {
   const std::vector<std::pair<std::string, Camera>>& image_names_and_cameras_;
 };
 
-// Rectify stereo image pairs.
+// Rectify stereo image pairs. The rectification of camera pairs with the same
+// relative pose in multiple stereo pairs, e.g., of a calibrated stereo rig, is
+// only computed once and shared by all these stereo pairs.
 class StereoImageRectifier : public Thread {
  public:
   StereoImageRectifier(
@@ -161,13 +231,21 @@ class StereoImageRectifier : public Thread {
  private:
   void Run();
 
-  void Rectify(const image_t image_id1, const image_t image_id2) const;
+  void ComputeSharedRectificationMaps();
+  void Rectify(const size_t stereo_pair_idx) const;
 
   UndistortCameraOptions options_;
   std::string image_path_;
   std::string output_path_;
   const std::vector<std::pair<image_t, image_t>>& stereo_pairs_;
   const Reconstruction& reconstruction_;
+
+  // The index of the shared rectification of each stereo pair or -1, if the
+  // rectification of the stereo pair is not shared.
+  std::vector<int> rectification_map_idxs_;
+  std::vector<StereoRectificationMaps,
+              Eigen::aligned_allocator<StereoRectificationMaps>>
+      rectification_maps_;
 };
 
 // Undistort camera by resizing the image and shifting the principal point.
@@ -198,6 +276,20 @@ void UndistortImage(const UndistortCameraOptions& options,
                     const Camera& distorted_camera, Bitmap* undistorted_image,
                     Camera* undistorted_camera);
 
+// Compute the warp map that undistorts the images of the given camera. The map
+// only depends on the camera, so that it can be reused for all its images
+// instead of evaluating the camera models for every pixel of every image.
+void ComputeUndistortionWarpMap(const UndistortCameraOptions& options,
+                                const Camera& distorted_camera,
+                                WarpMap* warp_map, const int num_threads = 1);
+
+// Undistort image as `UndistortImage` using the precomputed undistortion warp
+// map of its camera, see `ComputeUndistortionWarpMap`.
+void UndistortImage(const UndistortCameraOptions& options,
+                    const WarpMap& warp_map, const Bitmap& distorted_image,
+                    const Camera& distorted_camera, Bitmap* undistorted_image,
+                    Camera* undistorted_camera);
+
 // Undistort all cameras in the reconstruction and accordingly all
 // observations in their corresponding images.
 void UndistortReconstruction(const UndistortCameraOptions& options,
@@ -221,6 +313,26 @@ void RectifyAndUndistortStereoImages(
     const Eigen::Vector3d& tvec, Bitmap* undistorted_image1,
     Bitmap* undistorted_image2, Camera* undistorted_camera, Eigen::Matrix4d* Q);
 
+// Compute the rectification and undistortion of the stereo camera pair as in
+// `RectifyAndUndistortStereoImages`. The warp maps are computed in parallel
+// using the given number of threads and require 16 bytes per pixel.
+void ComputeStereoRectificationMaps(const UndistortCameraOptions& options,
+                                    const Camera& distorted_camera1,
+                                    const Camera& distorted_camera2,
+                                    const Eigen::Vector4d& qvec,
+                                    const Eigen::Vector3d& tvec,
+                                    StereoRectificationMaps* maps,
+                                    const int num_threads = 1);
+
+// Rectify and undistort the stereo image pair as in
+// `RectifyAndUndistortStereoImages` using the precomputed maps of its cameras.
+void RectifyAndUndistortStereoImages(const StereoRectificationMaps& maps,
+                                     const Bitmap& distorted_image1,
+                                     const Bitmap& distorted_image2,
+                                     Bitmap* undistorted_image1,
+                                     Bitmap* undistorted_image2,
+                                     const int num_threads = 1);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_BASE_UNDISTORTION_H_
@@ -247,3 +247,53 @@ BOOST_AUTO_TEST_CASE(TestRectifyStereoCameras) {
   Q_ref << 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, -2.67261, -0.5, -0.5, 1, 0;
   BOOST_CHECK(Q.isApprox(Q_ref, 1e-5));
 }
+
+BOOST_AUTO_TEST_CASE(TestComputeStereoRectificationMaps) {
+  Camera camera1;
+  camera1.InitializeWithName("SIMPLE_RADIAL", 100, 40, 30);
+  camera1.Params(3) = 0.1;
+
+  Camera camera2;
+  camera2.InitializeWithName("SIMPLE_RADIAL", 100, 40, 30);
+  camera2.Params(3) = -0.1;
+
+  const Eigen::Vector4d qvec =
+      RotationMatrixToQuaternion(EulerAnglesToRotationMatrix(0.1, 0.2, 0.3));
+  const Eigen::Vector3d tvec(0.1, 0.2, 0.3);
+
+  StereoRectificationMaps maps;
+  ComputeStereoRectificationMaps(UndistortCameraOptions(), camera1, camera2,
+                                 qvec, tvec, &maps, 2);
+
+  const Camera undistorted_camera =
+      UndistortCamera(UndistortCameraOptions(), camera1);
+  BOOST_CHECK_EQUAL(maps.undistorted_camera.Width(),
+                    undistorted_camera.Width());
+  BOOST_CHECK_EQUAL(maps.undistorted_camera.Height(),
+                    undistorted_camera.Height());
+  BOOST_CHECK_EQUAL(maps.undistorted_camera.ParamsToString(),
+                    undistorted_camera.ParamsToString());
+
+  Eigen::Matrix3d H1;
+  Eigen::Matrix3d H2;
+  Eigen::Matrix4d Q;
+  RectifyStereoCameras(undistorted_camera, undistorted_camera, qvec, tvec, &H1,
+                       &H2, &Q);
+  BOOST_CHECK(maps.Q.isApprox(Q));
+
+  WarpMap warp_map1;
+  ComputeWarpMapWithHomographyBetweenCameras(H1.inverse(), camera1,
+                                             undistorted_camera, &warp_map1);
+  BOOST_CHECK_EQUAL(maps.warp_map1.width, warp_map1.width);
+  BOOST_CHECK_EQUAL(maps.warp_map1.height, warp_map1.height);
+  BOOST_CHECK(maps.warp_map1.source_x == warp_map1.source_x);
+  BOOST_CHECK(maps.warp_map1.source_y == warp_map1.source_y);
+
+  WarpMap warp_map2;
+  ComputeWarpMapWithHomographyBetweenCameras(H2.inverse(), camera2,
+                                             undistorted_camera, &warp_map2);
+  BOOST_CHECK_EQUAL(maps.warp_map2.width, warp_map2.width);
+  BOOST_CHECK_EQUAL(maps.warp_map2.height, warp_map2.height);
+  BOOST_CHECK(maps.warp_map2.source_x == warp_map2.source_x);
+  BOOST_CHECK(maps.warp_map2.source_y == warp_map2.source_y);
+}
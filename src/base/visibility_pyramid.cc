@@ -39,69 +39,41 @@ VisibilityPyramid::VisibilityPyramid() : VisibilityPyramid(0, 0, 0) {}
 
 VisibilityPyramid::VisibilityPyramid(const size_t num_levels,
                                      const size_t width, const size_t height)
-    : width_(width), height_(height), score_(0), max_score_(0) {
-  pyramid_.resize(num_levels);
+    : width_(width),
+      height_(height),
+      score_(0),
+      max_score_(0),
+      num_levels_(num_levels) {
+  level_offsets_.resize(num_levels);
+  size_t num_cells = 0;
   for (size_t level = 0; level < num_levels; ++level) {
-    const size_t level_plus_one = level + 1;
-    const int dim = 1 << level_plus_one;
-    pyramid_[level].setZero(dim, dim);
+    const size_t dim = size_t(1) << (level + 1);
+    level_offsets_[level] = num_cells;
+    num_cells += dim * dim;
     max_score_ += dim * dim * dim * dim;
   }
+  cells_.resize(num_cells, 0);
 }
 
 void VisibilityPyramid::SetPoint(const double x, const double y) {
-  CHECK_GT(pyramid_.size(), 0);
-
-  size_t cx = 0;
-  size_t cy = 0;
-  CellForPoint(x, y, &cx, &cy);
-
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) += 1;
-    if (level(cy, cx) == 1) {
-      score_ += level.size();
-    }
-
-    cx = cx >> 1;
-    cy = cy >> 1;
-  }
-
-  CHECK_LE(score_, max_score_);
+  CHECK_GT(num_levels_, 0);
+  SetCell(CellIndex(x, y));
 }
 
 void VisibilityPyramid::ResetPoint(const double x, const double y) {
-  CHECK_GT(pyramid_.size(), 0);
-
-  size_t cx = 0;
-  size_t cy = 0;
-  CellForPoint(x, y, &cx, &cy);
-
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) -= 1;
-    if (level(cy, cx) == 0) {
-      score_ -= level.size();
-    }
-
-    cx = cx >> 1;
-    cy = cy >> 1;
-  }
-
-  CHECK_LE(score_, max_score_);
+  CHECK_GT(num_levels_, 0);
+  ResetCell(CellIndex(x, y));
 }
 
-void VisibilityPyramid::CellForPoint(const double x, const double y, size_t* cx,
-                                     size_t* cy) const {
+size_t VisibilityPyramid::CellIndex(const double x, const double y) const {
   CHECK_GT(width_, 0);
   CHECK_GT(height_, 0);
-  const int max_dim = 1 << pyramid_.size();
-  *cx = Clip<size_t>(static_cast<size_t>(max_dim * x / width_), 0,
-                     static_cast<size_t>(max_dim - 1));
-  *cy = Clip<size_t>(static_cast<size_t>(max_dim * y / height_), 0,
-                     static_cast<size_t>(max_dim - 1));
+  const size_t max_dim = size_t(1) << num_levels_;
+  const size_t cx = Clip<size_t>(static_cast<size_t>(max_dim * x / width_), 0,
+                                 max_dim - 1);
+  const size_t cy = Clip<size_t>(static_cast<size_t>(max_dim * y / height_), 0,
+                                 max_dim - 1);
+  return cy * max_dim + cx;
 }
 
 }  // namespace colmap
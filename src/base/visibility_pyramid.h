@@ -37,6 +37,7 @@
 #include <Eigen/Core>
 
 #include "util/alignment.h"
+#include "util/logging.h"
 
 namespace colmap {
 
@@ -60,6 +61,14 @@ class VisibilityPyramid {
   void SetPoint(const double x, const double y);
   void ResetPoint(const double x, const double y);
 
+  // The index of the cell of a point in the finest level. Points that are set
+  // and reset repeatedly can precompute their cell and then set and reset the
+  // cell directly, which avoids the repeated lookup of the cell.
+  size_t CellIndex(const double x, const double y) const;
+  inline size_t NumCells() const;
+  inline void SetCell(const size_t cell_idx);
+  inline void ResetCell(const size_t cell_idx);
+
   inline size_t NumLevels() const;
   inline size_t Width() const;
   inline size_t Height() const;
@@ -68,9 +77,6 @@ class VisibilityPyramid {
   inline size_t MaxScore() const;
 
  private:
-  void CellForPoint(const double x, const double y, size_t* cx,
-                    size_t* cy) const;
-
   // Range of the input points.
   size_t width_;
   size_t height_;
@@ -81,15 +87,61 @@ class VisibilityPyramid {
   // The maximum score when all cells are populated.
   size_t max_score_;
 
-  // The visibilty pyramid with multiple levels.
-  std::vector<Eigen::MatrixXi> pyramid_;
+  // The number of points in the cells of all levels, which are stored
+  // consecutively in row-major order from the coarsest to the finest level.
+  // The level with index i has 2^(i+1) x 2^(i+1) cells.
+  size_t num_levels_;
+  std::vector<int> cells_;
+  std::vector<size_t> level_offsets_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t VisibilityPyramid::NumLevels() const { return pyramid_.size(); }
+size_t VisibilityPyramid::NumCells() const {
+  return num_levels_ == 0 ? 0 : size_t(1) << (2 * num_levels_);
+}
+
+void VisibilityPyramid::SetCell(const size_t cell_idx) {
+  DCHECK_LT(cell_idx, NumCells());
+
+  size_t cx = cell_idx & ((size_t(1) << num_levels_) - 1);
+  size_t cy = cell_idx >> num_levels_;
+  for (size_t level = num_levels_; level > 0; --level) {
+    const size_t dim = size_t(1) << level;
+    int& num_points = cells_[level_offsets_[level - 1] + cy * dim + cx];
+    num_points += 1;
+    if (num_points == 1) {
+      score_ += dim * dim;
+    }
+    cx >>= 1;
+    cy >>= 1;
+  }
+
+  DCHECK_LE(score_, max_score_);
+}
+
+void VisibilityPyramid::ResetCell(const size_t cell_idx) {
+  DCHECK_LT(cell_idx, NumCells());
+
+  size_t cx = cell_idx & ((size_t(1) << num_levels_) - 1);
+  size_t cy = cell_idx >> num_levels_;
+  for (size_t level = num_levels_; level > 0; --level) {
+    const size_t dim = size_t(1) << level;
+    int& num_points = cells_[level_offsets_[level - 1] + cy * dim + cx];
+    num_points -= 1;
+    if (num_points == 0) {
+      score_ -= dim * dim;
+    }
+    cx >>= 1;
+    cy >>= 1;
+  }
+
+  DCHECK_LE(score_, max_score_);
+}
+
+size_t VisibilityPyramid::NumLevels() const { return num_levels_; }
 
 size_t VisibilityPyramid::Width() const { return width_; }
 
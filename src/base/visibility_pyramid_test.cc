@@ -89,3 +89,30 @@ BOOST_AUTO_TEST_CASE(TestScore) {
         2 * scores.sum() + 2 * scores.tail(scores.size() - 1).sum());
   }
 }
+
+BOOST_AUTO_TEST_CASE(TestCells) {
+  VisibilityPyramid pyramid(3, 8, 8);
+  BOOST_CHECK_EQUAL(pyramid.NumCells(), 64);
+  BOOST_CHECK_EQUAL(pyramid.CellIndex(0, 0), 0);
+  BOOST_CHECK_EQUAL(pyramid.CellIndex(1, 0), 1);
+  BOOST_CHECK_EQUAL(pyramid.CellIndex(0, 1), 8);
+  BOOST_CHECK_EQUAL(pyramid.CellIndex(7.5, 7.5), 63);
+  BOOST_CHECK_EQUAL(pyramid.CellIndex(100, 100), 63);
+
+  VisibilityPyramid point_pyramid(3, 8, 8);
+  for (size_t x = 0; x < 8; x += 3) {
+    for (size_t y = 0; y < 8; y += 2) {
+      pyramid.SetCell(pyramid.CellIndex(x, y));
+      point_pyramid.SetPoint(x, y);
+      BOOST_CHECK_EQUAL(pyramid.Score(), point_pyramid.Score());
+    }
+  }
+  for (size_t x = 0; x < 8; x += 3) {
+    for (size_t y = 0; y < 8; y += 2) {
+      pyramid.ResetCell(pyramid.CellIndex(x, y));
+      point_pyramid.ResetPoint(x, y);
+      BOOST_CHECK_EQUAL(pyramid.Score(), point_pyramid.Score());
+    }
+  }
+  BOOST_CHECK_EQUAL(pyramid.Score(), 0);
+}
@@ -33,10 +33,86 @@
 
 #include "VLFeat/imopv.h"
 #include "util/logging.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace {
 
+void InitializeWarpMap(const Camera& source_camera, const Camera& target_camera,
+                       WarpMap* warp_map) {
+  CHECK_NOTNULL(warp_map);
+  warp_map->source_width = static_cast<int>(source_camera.Width());
+  warp_map->source_height = static_cast<int>(source_camera.Height());
+  // To avoid aliasing, perform the warping in the source resolution and
+  // then rescale the image at the end.
+  warp_map->width = warp_map->source_width;
+  warp_map->height = warp_map->source_height;
+  warp_map->target_width = static_cast<int>(target_camera.Width());
+  warp_map->target_height = static_cast<int>(target_camera.Height());
+  const size_t num_pixels =
+      static_cast<size_t>(warp_map->width) * warp_map->height;
+  warp_map->source_x.resize(num_pixels);
+  warp_map->source_y.resize(num_pixels);
+}
+
+// Same conventions as Bitmap::InterpolateBilinear, where the source scanlines
+// are in FreeImage order with the origin in the lower left of the image.
+// Pixels outside the source image are set to zero.
+template <int kChannels>
+inline void InterpolateBilinear(const uint8_t* const* source_lines,
+                                const int source_width,
+                                const int source_height, const float x,
+                                const float y, uint8_t* color) {
+  const float inv_y = source_height - 1 - y;
+
+  const int x0 = static_cast<int>(std::floor(x));
+  const int x1 = x0 + 1;
+  const int y0 = static_cast<int>(std::floor(inv_y));
+  const int y1 = y0 + 1;
+
+  if (x0 < 0 || x1 >= source_width || y0 < 0 || y1 >= source_height) {
+    for (int c = 0; c < kChannels; ++c) {
+      color[c] = 0;
+    }
+    return;
+  }
+
+  const float dx = x - x0;
+  const float dy = inv_y - y0;
+  const float dx_1 = 1 - dx;
+  const float dy_1 = 1 - dy;
+
+  const uint8_t* p00 = source_lines[y0] + kChannels * x0;
+  const uint8_t* p01 = source_lines[y0] + kChannels * x1;
+  const uint8_t* p10 = source_lines[y1] + kChannels * x0;
+  const uint8_t* p11 = source_lines[y1] + kChannels * x1;
+
+  for (int c = 0; c < kChannels; ++c) {
+    const float v0 = dx_1 * p00[c] + dx * p01[c];
+    const float v1 = dx_1 * p10[c] + dx * p11[c];
+    const float value = dy_1 * v0 + dy * v1;
+    color[c] = static_cast<uint8_t>(std::min(255.0f, value + 0.5f));
+  }
+}
+
+template <int kChannels>
+void WarpRowsWithMap(const WarpMap& warp_map,
+                     const std::vector<const uint8_t*>& source_lines,
+                     const int row_begin, const int row_end,
+                     Bitmap* target_image) {
+  for (int y = row_begin; y < row_end; ++y) {
+    const size_t offset = static_cast<size_t>(y) * warp_map.width;
+    const float* source_x = warp_map.source_x.data() + offset;
+    const float* source_y = warp_map.source_y.data() + offset;
+    uint8_t* target_line = target_image->GetScanline(y);
+    for (int x = 0; x < warp_map.width; ++x) {
+      InterpolateBilinear<kChannels>(
+          source_lines.data(), warp_map.source_width, warp_map.source_height,
+          source_x[x], source_y[x], target_line + kChannels * x);
+    }
+  }
+}
+
 float GetPixelConstantBorder(const float* data, const int rows, const int cols,
                              const int row, const int col) {
   if (row >= 0 && col >= 0 && row < rows && col < cols) {
@@ -48,53 +124,126 @@ float GetPixelConstantBorder(const float* data, const int rows, const int cols,
 
 }  // namespace
 
-void WarpImageBetweenCameras(const Camera& source_camera,
-                             const Camera& target_camera,
-                             const Bitmap& source_image, Bitmap* target_image) {
-  CHECK_EQ(source_camera.Width(), source_image.Width());
-  CHECK_EQ(source_camera.Height(), source_image.Height());
-  CHECK_NOTNULL(target_image);
+size_t WarpMap::NumBytes() const {
+  return (source_x.size() + source_y.size()) * sizeof(float);
+}
 
-  target_image->Allocate(static_cast<int>(source_camera.Width()),
-                         static_cast<int>(source_camera.Height()),
-                         source_image.IsRGB());
+void ComputeWarpMapBetweenCameras(const Camera& source_camera,
+                                  const Camera& target_camera,
+                                  WarpMap* warp_map, const int num_threads) {
+  InitializeWarpMap(source_camera, target_camera, warp_map);
 
-  // To avoid aliasing, perform the warping in the source resolution and
-  // then rescale the image at the end.
   Camera scaled_target_camera = target_camera;
   if (target_camera.Width() != source_camera.Width() ||
       target_camera.Height() != source_camera.Height()) {
     scaled_target_camera.Rescale(source_camera.Width(), source_camera.Height());
   }
 
-  Eigen::Vector2d image_point;
-  for (int y = 0; y < target_image->Height(); ++y) {
-    image_point.y() = y + 0.5;
-    for (int x = 0; x < target_image->Width(); ++x) {
-      image_point.x() = x + 0.5;
+  const auto ComputeRows = [&](const int row_begin, const int row_end) {
+    Eigen::Vector2d image_point;
+    for (int y = row_begin; y < row_end; ++y) {
+      image_point.y() = y + 0.5;
+      for (int x = 0; x < warp_map->width; ++x) {
+        image_point.x() = x + 0.5;
+
+        // Camera models assume that the upper left pixel center is (0.5, 0.5).
+        const Eigen::Vector2d world_point =
+            scaled_target_camera.ImageToWorld(image_point);
+        const Eigen::Vector2d source_point =
+            source_camera.WorldToImage(world_point);
+
+        const size_t idx = static_cast<size_t>(y) * warp_map->width + x;
+        warp_map->source_x[idx] = static_cast<float>(source_point.x() - 0.5);
+        warp_map->source_y[idx] = static_cast<float>(source_point.y() - 0.5);
+      }
+    }
+  };
 
-      // Camera models assume that the upper left pixel center is (0.5, 0.5).
-      const Eigen::Vector2d world_point =
-          scaled_target_camera.ImageToWorld(image_point);
-      const Eigen::Vector2d source_point =
-          source_camera.WorldToImage(world_point);
+  ParallelFor(num_threads, 0, warp_map->height, ComputeRows,
+              ThreadPool::Schedule::DYNAMIC);
+}
 
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(source_point.x() - 0.5,
-                                           source_point.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
+void ComputeWarpMapWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
+                                                const Camera& source_camera,
+                                                const Camera& target_camera,
+                                                WarpMap* warp_map,
+                                                const int num_threads) {
+  InitializeWarpMap(source_camera, target_camera, warp_map);
+
+  const auto ComputeRows = [&](const int row_begin, const int row_end) {
+    Eigen::Vector3d image_point(0, 0, 1);
+    for (int y = row_begin; y < row_end; ++y) {
+      image_point.y() = y + 0.5;
+      for (int x = 0; x < warp_map->width; ++x) {
+        image_point.x() = x + 0.5;
+
+        // Camera models assume that the upper left pixel center is (0.5, 0.5).
+        const Eigen::Vector3d warped_point = H * image_point;
+        const Eigen::Vector2d world_point =
+            target_camera.ImageToWorld(warped_point.hnormalized());
+        const Eigen::Vector2d source_point =
+            source_camera.WorldToImage(world_point);
+
+        const size_t idx = static_cast<size_t>(y) * warp_map->width + x;
+        warp_map->source_x[idx] = static_cast<float>(source_point.x() - 0.5);
+        warp_map->source_y[idx] = static_cast<float>(source_point.y() - 0.5);
       }
     }
+  };
+
+  ParallelFor(num_threads, 0, warp_map->height, ComputeRows,
+              ThreadPool::Schedule::DYNAMIC);
+}
+
+void WarpImageWithMap(const WarpMap& warp_map, const Bitmap& source_image,
+                      Bitmap* target_image, const int num_threads) {
+  CHECK_EQ(warp_map.source_width, source_image.Width());
+  CHECK_EQ(warp_map.source_height, source_image.Height());
+  CHECK_EQ(warp_map.source_x.size(),
+           static_cast<size_t>(warp_map.width) * warp_map.height);
+  CHECK_EQ(warp_map.source_y.size(), warp_map.source_x.size());
+  CHECK_NOTNULL(target_image);
+
+  target_image->Allocate(warp_map.width, warp_map.height, source_image.IsRGB());
+
+  // Gather the scanlines once in FreeImage order, so that the interpolation
+  // directly accesses the raw pixel data of the source image.
+  std::vector<const uint8_t*> source_lines(warp_map.source_height);
+  for (int y = 0; y < warp_map.source_height; ++y) {
+    source_lines[warp_map.source_height - 1 - y] = source_image.GetScanline(y);
   }
 
-  if (target_camera.Width() != source_camera.Width() ||
-      target_camera.Height() != source_camera.Height()) {
-    target_image->Rescale(target_camera.Width(), target_camera.Height());
+  const auto WarpRows = [&](const int row_begin, const int row_end) {
+    if (source_image.IsRGB()) {
+      WarpRowsWithMap<3>(warp_map, source_lines, row_begin, row_end,
+                         target_image);
+    } else {
+      WarpRowsWithMap<1>(warp_map, source_lines, row_begin, row_end,
+                         target_image);
+    }
+  };
+
+  ParallelFor(num_threads, 0, warp_map.height, WarpRows,
+              ThreadPool::Schedule::DYNAMIC);
+
+  if (warp_map.target_width != warp_map.width ||
+      warp_map.target_height != warp_map.height) {
+    target_image->Rescale(warp_map.target_width, warp_map.target_height);
   }
 }
 
+void WarpImageBetweenCameras(const Camera& source_camera,
+                             const Camera& target_camera,
+                             const Bitmap& source_image, Bitmap* target_image) {
+  CHECK_EQ(source_camera.Width(), source_image.Width());
+  CHECK_EQ(source_camera.Height(), source_image.Height());
+  CHECK_NOTNULL(target_image);
+
+  WarpMap warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera, &warp_map);
+  WarpImageWithMap(warp_map, source_image, target_image);
+}
+
 void WarpImageWithHomography(const Eigen::Matrix3d& H,
                              const Bitmap& source_image, Bitmap* target_image) {
   CHECK_NOTNULL(target_image);
@@ -130,45 +279,10 @@ void WarpImageWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
   CHECK_EQ(source_camera.Height(), source_image.Height());
   CHECK_NOTNULL(target_image);
 
-  target_image->Allocate(static_cast<int>(source_camera.Width()),
-                         static_cast<int>(source_camera.Height()),
-                         source_image.IsRGB());
-
-  // To avoid aliasing, perform the warping in the source resolution and
-  // then rescale the image at the end.
-  Camera scaled_target_camera = target_camera;
-  if (target_camera.Width() != source_camera.Width() ||
-      target_camera.Height() != source_camera.Height()) {
-    scaled_target_camera.Rescale(source_camera.Width(), source_camera.Height());
-  }
-
-  Eigen::Vector3d image_point(0, 0, 1);
-  for (int y = 0; y < target_image->Height(); ++y) {
-    image_point.y() = y + 0.5;
-    for (int x = 0; x < target_image->Width(); ++x) {
-      image_point.x() = x + 0.5;
-
-      // Camera models assume that the upper left pixel center is (0.5, 0.5).
-      const Eigen::Vector3d warped_point = H * image_point;
-      const Eigen::Vector2d world_point =
-          target_camera.ImageToWorld(warped_point.hnormalized());
-      const Eigen::Vector2d source_point =
-          source_camera.WorldToImage(world_point);
-
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(source_point.x() - 0.5,
-                                           source_point.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
-      }
-    }
-  }
-
-  if (target_camera.Width() != source_camera.Width() ||
-      target_camera.Height() != source_camera.Height()) {
-    target_image->Rescale(target_camera.Width(), target_camera.Height());
-  }
+  WarpMap warp_map;
+  ComputeWarpMapWithHomographyBetweenCameras(H, source_camera, target_camera,
+                                             &warp_map);
+  WarpImageWithMap(warp_map, source_image, target_image);
 }
 
 void ResampleImageBilinear(const float* data, const int rows, const int cols,
@@ -32,12 +32,57 @@
 #ifndef COLMAP_SRC_BASE_WARP_H_
 #define COLMAP_SRC_BASE_WARP_H_
 
+#include <vector>
+
 #include "base/camera.h"
 #include "util/alignment.h"
 #include "util/bitmap.h"
 
 namespace colmap {
 
+// Precomputed mapping from the pixels of a target image to their positions in
+// the source image. The mapping only depends on the cameras, so it can be
+// computed once and then reused to warp all images of the same cameras without
+// evaluating the camera models for every pixel.
+struct WarpMap {
+  // Dimensions of the source image.
+  int source_width = 0;
+  int source_height = 0;
+
+  // Dimensions of the mapped image, in which the warping is performed.
+  int width = 0;
+  int height = 0;
+
+  // Dimensions to which the mapped image is rescaled after the warping.
+  int target_width = 0;
+  int target_height = 0;
+
+  // Row-major source image coordinates for each mapped pixel, where the upper
+  // left pixel center of the source image is at (0, 0).
+  std::vector<float> source_x;
+  std::vector<float> source_y;
+
+  size_t NumBytes() const;
+};
+
+// Compute the warp map corresponding to `WarpImageBetweenCameras` and
+// `WarpImageWithHomographyBetweenCameras`. The rows of the map are computed
+// in parallel using the given number of threads.
+void ComputeWarpMapBetweenCameras(const Camera& source_camera,
+                                  const Camera& target_camera,
+                                  WarpMap* warp_map, const int num_threads = 1);
+void ComputeWarpMapWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
+                                                const Camera& source_camera,
+                                                const Camera& target_camera,
+                                                WarpMap* warp_map,
+                                                const int num_threads = 1);
+
+// Warp source image to target image using a precomputed warp map. The rows of
+// the target image are warped in parallel using the given number of threads.
+// The function allocates the target image.
+void WarpImageWithMap(const WarpMap& warp_map, const Bitmap& source_image,
+                      Bitmap* target_image, const int num_threads = 1);
+
 // Warp source image to target image by projecting the pixels of the target
 // image up to infinity and projecting it down into the source image
 // (i.e. an inverse mapping). The function allocates the target image.
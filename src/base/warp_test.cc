@@ -219,6 +219,82 @@ BOOST_AUTO_TEST_CASE(TestWarpImageWithHomographyBetweenCamerasTransposed) {
   CheckBitmapsTransposed(source_image_rgb, target_image_rgb);
 }
 
+BOOST_AUTO_TEST_CASE(TestWarpImageWithMap) {
+  Camera source_camera;
+  source_camera.InitializeWithName("SIMPLE_RADIAL", 100, 100, 80);
+  source_camera.Params(3) = 0.1;
+  Camera target_camera;
+  target_camera.InitializeWithName("PINHOLE", 100, 50, 40);
+
+  WarpMap warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera, &warp_map);
+  BOOST_CHECK_EQUAL(warp_map.width, 100);
+  BOOST_CHECK_EQUAL(warp_map.height, 80);
+  BOOST_CHECK_EQUAL(warp_map.target_width, 50);
+  BOOST_CHECK_EQUAL(warp_map.target_height, 40);
+  BOOST_CHECK_EQUAL(warp_map.NumBytes(), 100 * 80 * 2 * sizeof(float));
+
+  WarpMap parallel_warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera,
+                               &parallel_warp_map, 4);
+  BOOST_CHECK(warp_map.source_x == parallel_warp_map.source_x);
+  BOOST_CHECK(warp_map.source_y == parallel_warp_map.source_y);
+
+  for (const bool as_rgb : {false, true}) {
+    Bitmap source_image;
+    GenerateRandomBitmap(100, 80, as_rgb, &source_image);
+
+    Bitmap target_image;
+    WarpImageWithMap(warp_map, source_image, &target_image);
+    Bitmap parallel_target_image;
+    WarpImageWithMap(warp_map, source_image, &parallel_target_image, 4);
+    CheckBitmapsEqual(target_image, parallel_target_image);
+    BOOST_CHECK_EQUAL(target_image.Width(), 50);
+    BOOST_CHECK_EQUAL(target_image.Height(), 40);
+
+    Bitmap camera_target_image;
+    WarpImageBetweenCameras(source_camera, target_camera, source_image,
+                            &camera_target_image);
+    CheckBitmapsEqual(target_image, camera_target_image);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestWarpImageWithMapInterpolation) {
+  Camera source_camera;
+  source_camera.InitializeWithName("SIMPLE_RADIAL", 100, 100, 100);
+  source_camera.Params(3) = 0.1;
+  Camera target_camera;
+  target_camera.InitializeWithName("PINHOLE", 100, 100, 100);
+
+  Bitmap source_image;
+  GenerateRandomBitmap(100, 100, true, &source_image);
+
+  WarpMap warp_map;
+  ComputeWarpMapBetweenCameras(source_camera, target_camera, &warp_map);
+  Bitmap target_image;
+  WarpImageWithMap(warp_map, source_image, &target_image);
+
+  // Compare against the per-pixel interpolation of the source image, where
+  // the interpolated colors may only differ due to rounding.
+  for (int y = 1; y < target_image.Height() - 1; ++y) {
+    for (int x = 1; x < target_image.Width() - 1; ++x) {
+      const Eigen::Vector2d source_point = source_camera.WorldToImage(
+          target_camera.ImageToWorld(Eigen::Vector2d(x + 0.5, y + 0.5)));
+      BitmapColor<float> expected_color;
+      if (!source_image.InterpolateBilinear(source_point.x() - 0.5,
+                                            source_point.y() - 0.5,
+                                            &expected_color)) {
+        continue;
+      }
+      BitmapColor<uint8_t> color;
+      BOOST_CHECK(target_image.GetPixel(x, y, &color));
+      BOOST_CHECK_LE(std::abs(color.r - expected_color.r), 1.0f);
+      BOOST_CHECK_LE(std::abs(color.g - expected_color.g), 1.0f);
+      BOOST_CHECK_LE(std::abs(color.b - expected_color.b), 1.0f);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestResampleImageBilinear) {
   std::vector<float> image(16);
   for (size_t i = 0; i < image.size(); ++i) {
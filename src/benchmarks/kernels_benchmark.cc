@@ -0,0 +1,350 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "base/camera.h"
+#include "base/camera_models.h"
+#include "base/projection.h"
+#include "estimators/absolute_pose.h"
+#include "estimators/generalized_absolute_pose.h"
+#include "estimators/utils.h"
+#include "feature/sift.h"
+#include "util/benchmark.h"
+#include "util/cache.h"
+#include "util/random.h"
+#include "util/threading.h"
+
+using namespace colmap;
+
+namespace {
+
+const size_t kNumPoints = 10000;
+
+std::vector<Eigen::Vector2d> RandomPoints2D(const size_t num_points,
+                                            const double min,
+                                            const double max) {
+  std::vector<Eigen::Vector2d> points(num_points);
+  for (auto& point : points) {
+    point = Eigen::Vector2d(RandomReal(min, max), RandomReal(min, max));
+  }
+  return points;
+}
+
+FeatureDescriptors RandomDescriptors(const size_t num_descriptors) {
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (size_t i = 0; i < num_descriptors; ++i) {
+    for (size_t j = 0; j < 128; ++j) {
+      descriptors(i, j) = static_cast<uint8_t>(RandomInteger(0, 255));
+    }
+  }
+  return descriptors;
+}
+
+void BenchmarkWorldToImage(BenchmarkState* state, const std::string& model_name,
+                           const bool batch) {
+  SetPRNGSeed(0);
+  Camera camera;
+  camera.InitializeWithName(model_name, 1000, 1000, 1000);
+  const std::vector<Eigen::Vector2d> points = RandomPoints2D(kNumPoints, -1, 1);
+  Eigen::Vector2d sum = Eigen::Vector2d::Zero();
+  std::vector<Eigen::Vector2d> batch_points;
+  while (state->KeepRunning()) {
+    if (batch) {
+      camera.WorldToImage(points, &batch_points);
+      for (const auto& point : batch_points) {
+        sum += point;
+      }
+    } else {
+      for (const auto& point : points) {
+        sum += camera.WorldToImage(point);
+      }
+    }
+  }
+  CHECK(sum.allFinite());
+  state->SetItemsProcessed(state->NumIterations() * points.size());
+}
+
+// Repeatedly sum per-worker buffers, which are allocated and first touched by
+// their workers, such that the benchmark is bound by the memory bandwidth and
+// by the locality of the buffers to the cores of the workers.
+void BenchmarkThreadPoolLocalBuffers(BenchmarkState* state,
+                                     const bool numa_thread_pinning) {
+  const size_t kNumBufferValues = 4 * 1024 * 1024;
+  SetNumaThreadPinning(numa_thread_pinning);
+  ThreadPool thread_pool;
+  const size_t num_threads = thread_pool.NumThreads();
+  std::vector<std::vector<float>> buffers(num_threads);
+  std::vector<double> sums(num_threads, 0);
+  const auto SumBuffer = [&](const size_t, const size_t) {
+    const int worker_index = thread_pool.GetThreadIndex();
+    std::vector<float>& buffer = buffers[worker_index];
+    if (buffer.empty()) {
+      buffer.resize(kNumBufferValues, 1.0f);
+    }
+    double sum = 0;
+    for (const float value : buffer) {
+      sum += value;
+    }
+    sums[worker_index] += sum;
+  };
+  while (state->KeepRunning()) {
+    thread_pool.ParallelFor(0, num_threads, SumBuffer);
+  }
+  SetNumaThreadPinning(false);
+  double sum = 0;
+  for (const double worker_sum : sums) {
+    sum += worker_sum;
+  }
+  CHECK_GT(sum, 0);
+  state->SetItemsProcessed(state->NumIterations() * num_threads *
+                           kNumBufferValues);
+}
+
+void BenchmarkImageToWorld(BenchmarkState* state, const std::string& model_name,
+                           const bool batch, const bool grid = false) {
+  SetPRNGSeed(0);
+  Camera camera;
+  camera.InitializeWithName(model_name, 1000, 1000, 1000);
+  for (const size_t idx : camera.ExtraParamsIdxs()) {
+    camera.Params(idx) = 0.01;
+  }
+  if (grid) {
+    camera.ComputeUndistortionGrid();
+  }
+  const std::vector<Eigen::Vector2d> points =
+      RandomPoints2D(kNumPoints, 0, 1000);
+  Eigen::Vector2d sum = Eigen::Vector2d::Zero();
+  std::vector<Eigen::Vector2d> batch_points;
+  while (state->KeepRunning()) {
+    if (batch) {
+      camera.ImageToWorld(points, &batch_points);
+      for (const auto& point : batch_points) {
+        sum += point;
+      }
+    } else {
+      for (const auto& point : points) {
+        sum += camera.ImageToWorld(point);
+      }
+    }
+  }
+  CHECK(sum.allFinite());
+  state->SetItemsProcessed(state->NumIterations() * points.size());
+}
+
+}  // namespace
+
+COLMAP_BENCHMARK(WorldToImageSimpleRadial) {
+  BenchmarkWorldToImage(state, "SIMPLE_RADIAL", false);
+}
+
+COLMAP_BENCHMARK(WorldToImageOpenCV) {
+  BenchmarkWorldToImage(state, "OPENCV", false);
+}
+
+COLMAP_BENCHMARK(WorldToImageBatchSimpleRadial) {
+  BenchmarkWorldToImage(state, "SIMPLE_RADIAL", true);
+}
+
+COLMAP_BENCHMARK(WorldToImageBatchOpenCV) {
+  BenchmarkWorldToImage(state, "OPENCV", true);
+}
+
+COLMAP_BENCHMARK(ImageToWorldSimpleRadial) {
+  BenchmarkImageToWorld(state, "SIMPLE_RADIAL", false);
+}
+
+COLMAP_BENCHMARK(ImageToWorldOpenCV) {
+  BenchmarkImageToWorld(state, "OPENCV", false);
+}
+
+COLMAP_BENCHMARK(ImageToWorldBatchSimpleRadial) {
+  BenchmarkImageToWorld(state, "SIMPLE_RADIAL", true);
+}
+
+COLMAP_BENCHMARK(ImageToWorldBatchOpenCV) {
+  BenchmarkImageToWorld(state, "OPENCV", true);
+}
+
+COLMAP_BENCHMARK(ImageToWorldGridOpenCV) {
+  BenchmarkImageToWorld(state, "OPENCV", false, true);
+}
+
+COLMAP_BENCHMARK(ImageToWorldGridBatchOpenCV) {
+  BenchmarkImageToWorld(state, "OPENCV", true, true);
+}
+
+COLMAP_BENCHMARK(SquaredSampsonError) {
+  SetPRNGSeed(0);
+  const std::vector<Eigen::Vector2d> points1 =
+      RandomPoints2D(kNumPoints, -1, 1);
+  const std::vector<Eigen::Vector2d> points2 =
+      RandomPoints2D(kNumPoints, -1, 1);
+  const Eigen::Matrix3d E = Eigen::Matrix3d::Random();
+  std::vector<double> residuals;
+  while (state->KeepRunning()) {
+    ComputeSquaredSampsonError(points1, points2, E, &residuals);
+  }
+  CHECK_EQ(residuals.size(), kNumPoints);
+  state->SetItemsProcessed(state->NumIterations() * kNumPoints);
+}
+
+COLMAP_BENCHMARK(SiftMatchingCPUBruteForce) {
+  SetPRNGSeed(0);
+  const size_t kNumDescriptors = 2000;
+  const FeatureDescriptors descriptors1 = RandomDescriptors(kNumDescriptors);
+  const FeatureDescriptors descriptors2 = RandomDescriptors(kNumDescriptors);
+  SiftMatchingOptions options;
+  options.max_ratio = 1;
+  options.max_distance = 1;
+  FeatureMatches matches;
+  while (state->KeepRunning()) {
+    MatchSiftFeaturesCPUBruteForce(options, descriptors1, descriptors2,
+                                   &matches);
+  }
+  // Number of computed descriptor distances.
+  state->SetItemsProcessed(state->NumIterations() * kNumDescriptors *
+                           kNumDescriptors);
+}
+
+COLMAP_BENCHMARK(P3PEstimate) {
+  SetPRNGSeed(0);
+  const size_t kNumProblems = 1000;
+  const Eigen::Matrix3x4d proj_matrix = ComposeProjectionMatrix(
+      Eigen::Vector4d(0.9, 0.1, -0.2, 0.3).normalized(),
+      Eigen::Vector3d(0.5, -0.3, 4));
+  std::vector<std::vector<Eigen::Vector2d>> points2D(kNumProblems);
+  std::vector<std::vector<Eigen::Vector3d>> points3D(kNumProblems);
+  for (size_t i = 0; i < kNumProblems; ++i) {
+    for (int j = 0; j < P3PEstimator::kMinNumSamples; ++j) {
+      const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0),
+                                    RandomReal(-1.0, 1.0),
+                                    RandomReal(-1.0, 1.0));
+      points3D[i].push_back(point3D);
+      points2D[i].push_back(
+          (proj_matrix * point3D.homogeneous()).hnormalized());
+    }
+  }
+  size_t num_models = 0;
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i < kNumProblems; ++i) {
+      num_models += P3PEstimator::Estimate(points2D[i], points3D[i]).size();
+    }
+  }
+  CHECK_GT(num_models, 0);
+  state->SetItemsProcessed(state->NumIterations() * kNumProblems);
+}
+
+COLMAP_BENCHMARK(GP3PEstimate) {
+  SetPRNGSeed(0);
+  const size_t kNumProblems = 1000;
+  const Eigen::Matrix3x4d proj_matrix = ComposeProjectionMatrix(
+      Eigen::Vector4d(0.9, 0.1, -0.2, 0.3).normalized(),
+      Eigen::Vector3d(0.5, -0.3, 4));
+  std::vector<std::vector<GP3PEstimator::X_t>> points2D(kNumProblems);
+  std::vector<std::vector<Eigen::Vector3d>> points3D(kNumProblems);
+  for (size_t i = 0; i < kNumProblems; ++i) {
+    for (int j = 0; j < GP3PEstimator::kMinNumSamples; ++j) {
+      // Each observation is made by a different camera of the rig.
+      GP3PEstimator::X_t point2D;
+      point2D.rel_tform = ComposeProjectionMatrix(
+          Eigen::Vector4d(1, RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2),
+                          RandomReal(-0.2, 0.2))
+              .normalized(),
+          Eigen::Vector3d(RandomReal(-0.5, 0.5), RandomReal(-0.5, 0.5),
+                          RandomReal(-0.5, 0.5)));
+      const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0),
+                                    RandomReal(-1.0, 1.0),
+                                    RandomReal(-1.0, 1.0));
+      const Eigen::Vector3d point3D_rig = proj_matrix * point3D.homogeneous();
+      point2D.xy =
+          (point2D.rel_tform * point3D_rig.homogeneous()).hnormalized();
+      points2D[i].push_back(point2D);
+      points3D[i].push_back(point3D);
+    }
+  }
+  size_t num_models = 0;
+  std::vector<GP3PEstimator::M_t> models;
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i < kNumProblems; ++i) {
+      GP3PEstimator::Estimate(points2D[i], points3D[i], &models);
+      num_models += models.size();
+    }
+  }
+  CHECK_GT(num_models, 0);
+  state->SetItemsProcessed(state->NumIterations() * kNumProblems);
+}
+
+COLMAP_BENCHMARK(ThreadPoolLocalBuffers) {
+  BenchmarkThreadPoolLocalBuffers(state, false);
+}
+
+COLMAP_BENCHMARK(ThreadPoolLocalBuffersNumaPinning) {
+  BenchmarkThreadPoolLocalBuffers(state, true);
+}
+
+COLMAP_BENCHMARK(LRUCacheGet) {
+  SetPRNGSeed(0);
+  const int kNumKeys = 10000;
+  LRUCache<int, int> cache(kNumKeys / 2, [](const int key) { return key; });
+  std::vector<int> keys(kNumPoints);
+  for (auto& key : keys) {
+    key = RandomInteger(0, kNumKeys - 1);
+  }
+  size_t sum = 0;
+  while (state->KeepRunning()) {
+    for (const int key : keys) {
+      sum += cache.Get(key);
+    }
+  }
+  CHECK_GT(sum, 0);
+  state->SetItemsProcessed(state->NumIterations() * keys.size());
+}
+
+COLMAP_BENCHMARK(ShardedLRUCacheGet) {
+  SetPRNGSeed(0);
+  const int kNumKeys = 10000;
+  ShardedLRUCache<int, int> cache(kNumKeys / 2, 16,
+                                  [](const int key) { return key; });
+  std::vector<int> keys(kNumPoints);
+  for (auto& key : keys) {
+    key = RandomInteger(0, kNumKeys - 1);
+  }
+  size_t sum = 0;
+  while (state->KeepRunning()) {
+    for (const int key : keys) {
+      sum += *cache.Get(key);
+    }
+  }
+  CHECK_GT(sum, 0);
+  state->SetItemsProcessed(state->NumIterations() * keys.size());
+}
+
+COLMAP_BENCHMARK_MAIN()
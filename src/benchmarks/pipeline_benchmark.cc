@@ -0,0 +1,266 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "base/database_cache.h"
+#include "base/projection.h"
+#include "base/reconstruction.h"
+#include "base/reconstruction_manager.h"
+#include "base/synthetic.h"
+#include "controllers/incremental_mapper.h"
+#include "estimators/two_view_geometry.h"
+#include "feature/sift.h"
+#include "optim/bundle_adjustment.h"
+#include "util/benchmark.h"
+#include "util/random.h"
+
+#ifdef CUDA_ENABLED
+#include "SiftGPU/SiftGPU.h"
+#endif
+
+using namespace colmap;
+
+namespace {
+
+// Synthesize a scene of images on a line, whose 3D points are observed with
+// pixel noise in the neighboring images.
+void SynthesizeReconstruction(const int num_images, const int num_points,
+                              Reconstruction* reconstruction,
+                              Database* database = nullptr) {
+  SyntheticDatasetOptions options;
+  options.num_images = num_images;
+  options.num_points3D = num_points;
+  options.point2D_stddev = 1;
+  options.match_outlier_ratio = 0.2;
+  SynthesizeDataset(options, reconstruction, database);
+}
+
+void BenchmarkBundleAdjustment(BenchmarkState* state, const int num_images,
+                               const int num_points) {
+  Reconstruction reconstruction;
+  SynthesizeReconstruction(num_images, num_points, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    config.AddImage(image_id);
+  }
+  config.SetConstantPose(1);
+  config.SetConstantTvec(2, {0});
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    Reconstruction adjusted_reconstruction = reconstruction;
+    state->ResumeTiming();
+    BundleAdjuster bundle_adjuster(options, config);
+    CHECK(bundle_adjuster.Solve(&adjusted_reconstruction));
+  }
+
+  state->SetItemsProcessed(state->NumIterations() *
+                           reconstruction.ComputeNumObservations());
+}
+
+// Generate correspondences between two calibrated views, of which the given
+// fraction are random outliers.
+void GenerateTwoViewCorrespondences(const size_t num_points,
+                                    const double outlier_ratio, Camera* camera,
+                                    std::vector<Eigen::Vector2d>* points1,
+                                    std::vector<Eigen::Vector2d>* points2,
+                                    FeatureMatches* matches) {
+  SetPRNGSeed(0);
+  camera->InitializeWithName("SIMPLE_PINHOLE", 1000, 1000, 1000);
+  const Eigen::Matrix3x4d proj_matrix1 = ComposeProjectionMatrix(
+      ComposeIdentityQuaternion(), Eigen::Vector3d::Zero());
+  const Eigen::Matrix3x4d proj_matrix2 =
+      ComposeProjectionMatrix(Eigen::Vector4d(0.99, 0, 0.1, 0).normalized(),
+                              Eigen::Vector3d(-1, 0, 0));
+  for (size_t i = 0; i < num_points; ++i) {
+    const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                                  RandomReal(4.0, 6.0));
+    points1->push_back(ProjectPointToImage(point3D, proj_matrix1, *camera));
+    if (RandomReal(0.0, 1.0) < outlier_ratio) {
+      points2->emplace_back(RandomReal(0.0, 1000.0), RandomReal(0.0, 1000.0));
+    } else {
+      points2->push_back(ProjectPointToImage(point3D, proj_matrix2, *camera));
+    }
+    matches->emplace_back(i, i);
+  }
+}
+
+}  // namespace
+
+COLMAP_BENCHMARK(BundleAdjustment10Images1000Points) {
+  BenchmarkBundleAdjustment(state, 10, 1000);
+}
+
+COLMAP_BENCHMARK(BundleAdjustment50Images5000Points) {
+  BenchmarkBundleAdjustment(state, 50, 5000);
+}
+
+COLMAP_BENCHMARK(CalculateReprojectionErrors) {
+  Reconstruction reconstruction;
+  SynthesizeReconstruction(50, 5000, &reconstruction);
+  double sum = 0;
+  while (state->KeepRunning()) {
+    for (const auto& point3D : reconstruction.Points3D()) {
+      for (const auto& track_el : point3D.second.Track().Elements()) {
+        const Image& image = reconstruction.Image(track_el.image_id);
+        sum += CalculateSquaredReprojectionError(
+            image.Point2D(track_el.point2D_idx).XY(), point3D.second.XYZ(),
+            image.Qvec(), image.Tvec(),
+            reconstruction.Camera(image.CameraId()));
+      }
+    }
+  }
+  CHECK_GT(sum, 0);
+  state->SetItemsProcessed(state->NumIterations() *
+                           reconstruction.ComputeNumObservations());
+}
+
+COLMAP_BENCHMARK(DatabaseCacheLoad) {
+  Reconstruction reconstruction;
+  Database database(":memory:");
+  SynthesizeReconstruction(200, 20000, &reconstruction, &database);
+  while (state->KeepRunning()) {
+    DatabaseCache database_cache;
+    database_cache.Load(database, 15, false, {});
+  }
+  state->SetItemsProcessed(state->NumIterations() *
+                           database.NumInlierMatches());
+}
+
+COLMAP_BENCHMARK(IncrementalMapper50Images) {
+  Reconstruction reconstruction;
+  Database database(":memory:");
+  SynthesizeReconstruction(50, 5000, &reconstruction, &database);
+
+  DatabaseCache database_cache;
+  database_cache.Load(database, 15, false, {});
+
+  IncrementalMapperOptions options;
+  options.multiple_models = false;
+  options.extract_colors = false;
+
+  while (state->KeepRunning()) {
+    ReconstructionManager reconstruction_manager;
+    IncrementalMapperController mapper(&options, "", &database_cache,
+                                       &reconstruction_manager);
+    mapper.Start();
+    mapper.Wait();
+    CHECK_EQ(reconstruction_manager.Size(), 1);
+  }
+
+  state->SetItemsProcessed(state->NumIterations() *
+                           reconstruction.NumRegImages());
+}
+
+COLMAP_BENCHMARK(MergeReconstructions) {
+  Reconstruction reconstruction;
+  SynthesizeReconstruction(200, 100000, &reconstruction);
+
+  // Split the scene into two reconstructions, which overlap in the middle
+  // fifth of the images.
+  Reconstruction reconstruction1 = reconstruction;
+  Reconstruction reconstruction2 = reconstruction;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    if (image_id > 120) {
+      reconstruction1.DeRegisterImage(image_id);
+    }
+    if (image_id <= 80) {
+      reconstruction2.DeRegisterImage(image_id);
+    }
+  }
+
+  while (state->KeepRunning()) {
+    state->PauseTiming();
+    Reconstruction merged_reconstruction = reconstruction1;
+    state->ResumeTiming();
+    CHECK(merged_reconstruction.Merge(reconstruction2, 8.0));
+  }
+
+  state->SetItemsProcessed(state->NumIterations() *
+                           reconstruction2.NumPoints3D());
+}
+
+COLMAP_BENCHMARK(TwoViewGeometryCalibrated) {
+  Camera camera;
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  FeatureMatches matches;
+  GenerateTwoViewCorrespondences(2000, 0.3, &camera, &points1, &points2,
+                                 &matches);
+  TwoViewGeometry::Options options;
+  options.ransac_options.min_num_trials = 100;
+  options.ransac_options.max_num_trials = 100;
+  while (state->KeepRunning()) {
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.EstimateCalibrated(camera, points1, camera, points2,
+                                         matches, options);
+  }
+  state->SetItemsProcessed(state->NumIterations() * matches.size());
+}
+
+#ifdef CUDA_ENABLED
+
+COLMAP_BENCHMARK(SiftMatchingGPU) {
+  SetPRNGSeed(0);
+  const size_t kNumDescriptors = 8000;
+  FeatureDescriptors descriptors1(kNumDescriptors, 128);
+  FeatureDescriptors descriptors2(kNumDescriptors, 128);
+  for (size_t i = 0; i < kNumDescriptors; ++i) {
+    for (size_t j = 0; j < 128; ++j) {
+      descriptors1(i, j) = static_cast<uint8_t>(RandomInteger(0, 255));
+      descriptors2(i, j) = static_cast<uint8_t>(RandomInteger(0, 255));
+    }
+  }
+
+  SiftMatchingOptions options;
+  options.gpu_index = "0";
+  options.max_num_matches = kNumDescriptors;
+  SiftMatchGPU sift_match_gpu;
+  CHECK(CreateSiftGPUMatcher(options, &sift_match_gpu));
+
+  FeatureMatches matches;
+  while (state->KeepRunning()) {
+    MatchSiftFeaturesGPU(options, &descriptors1, &descriptors2,
+                         &sift_match_gpu, &matches);
+  }
+  state->SetItemsProcessed(state->NumIterations() * kNumDescriptors *
+                           kNumDescriptors);
+  state->SetBytesProcessed(state->NumIterations() * 2 * kNumDescriptors *
+                           128);
+}
+
+#endif  // CUDA_ENABLED
+
+COLMAP_BENCHMARK_MAIN()
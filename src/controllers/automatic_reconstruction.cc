@@ -31,6 +31,8 @@
 
 #include "controllers/automatic_reconstruction.h"
 
+#include <future>
+
 #include "base/undistortion.h"
 #include "controllers/incremental_mapper.h"
 #include "feature/extraction.h"
@@ -47,7 +49,8 @@ AutomaticReconstructionController::AutomaticReconstructionController(
     const Options& options, ReconstructionManager* reconstruction_manager)
     : options_(options),
       reconstruction_manager_(reconstruction_manager),
-      active_thread_(nullptr) {
+      active_thread_(nullptr),
+      active_fusion_thread_(nullptr) {
   CHECK(ExistsDir(options_.workspace_path));
   CHECK(ExistsDir(options_.image_path));
   CHECK_NOTNULL(reconstruction_manager_);
@@ -58,6 +61,15 @@ AutomaticReconstructionController::AutomaticReconstructionController(
   *option_manager_.database_path =
       JoinPaths(options_.workspace_path, "database.db");
 
+  if (options_.in_memory_database) {
+    database_path_ = Database::InMemoryPath(
+        "automatic_reconstruction_" +
+        std::to_string(reinterpret_cast<uintptr_t>(this)));
+    in_memory_database_.reset(new Database(database_path_));
+  } else {
+    database_path_ = *option_manager_.database_path;
+  }
+
   if (options_.data_type == DataType::VIDEO) {
     option_manager_.ModifyForVideoData();
   } else if (options_.data_type == DataType::INDIVIDUAL) {
@@ -86,7 +98,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
   option_manager_.poisson_meshing->num_threads = options_.num_threads;
 
   ImageReaderOptions reader_options = *option_manager_.image_reader;
-  reader_options.database_path = *option_manager_.database_path;
+  reader_options.database_path = database_path_;
   reader_options.image_path = *option_manager_.image_path;
   if (!options_.mask_path.empty()) {
     reader_options.mask_path = options_.mask_path;
@@ -102,12 +114,15 @@ AutomaticReconstructionController::AutomaticReconstructionController(
   option_manager_.sift_matching->gpu_index = options_.gpu_index;
   option_manager_.patch_match_stereo->gpu_index = options_.gpu_index;
 
+  *option_manager_.memory_budget = options_.memory_budget;
+  option_manager_.ApplyMemoryBudget();
+
   feature_extractor_.reset(new SiftFeatureExtractor(
       reader_options, *option_manager_.sift_extraction));
 
   exhaustive_matcher_.reset(new ExhaustiveFeatureMatcher(
       *option_manager_.exhaustive_matching, *option_manager_.sift_matching,
-      *option_manager_.database_path));
+      database_path_));
 
   if (!options_.vocab_tree_path.empty()) {
     option_manager_.sequential_matching->loop_detection = true;
@@ -117,14 +132,14 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 
   sequential_matcher_.reset(new SequentialFeatureMatcher(
       *option_manager_.sequential_matching, *option_manager_.sift_matching,
-      *option_manager_.database_path));
+      database_path_));
 
   if (!options_.vocab_tree_path.empty()) {
     option_manager_.vocab_tree_matching->vocab_tree_path =
         options_.vocab_tree_path;
     vocab_tree_matcher_.reset(new VocabTreeFeatureMatcher(
         *option_manager_.vocab_tree_matching, *option_manager_.sift_matching,
-        *option_manager_.database_path));
+        database_path_));
   }
 }
 
@@ -132,6 +147,10 @@ void AutomaticReconstructionController::Stop() {
   if (active_thread_ != nullptr) {
     active_thread_->Stop();
   }
+  Thread* active_fusion_thread = active_fusion_thread_;
+  if (active_fusion_thread != nullptr) {
+    active_fusion_thread->Stop();
+  }
   Thread::Stop();
 }
 
@@ -152,6 +171,10 @@ void AutomaticReconstructionController::Run() {
     return;
   }
 
+  if (in_memory_database_) {
+    in_memory_database_->Backup(*option_manager_.database_path);
+  }
+
   if (options_.sparse) {
     RunSparseMapper();
   }
@@ -180,7 +203,7 @@ void AutomaticReconstructionController::RunFeatureMatching() {
     matcher = sequential_matcher_.get();
   } else if (options_.data_type == DataType::INDIVIDUAL ||
              options_.data_type == DataType::INTERNET) {
-    Database database(*option_manager_.database_path);
+    Database database(database_path_);
     const size_t num_images = database.NumImages();
     if (options_.vocab_tree_path.empty() || num_images < 200) {
       matcher = exhaustive_matcher_.get();
@@ -218,7 +241,7 @@ void AutomaticReconstructionController::RunSparseMapper() {
 
   IncrementalMapperController mapper(
       option_manager_.mapper.get(), *option_manager_.image_path,
-      *option_manager_.database_path, reconstruction_manager_);
+      database_path_, reconstruction_manager_);
   active_thread_ = &mapper;
   mapper.Start();
   mapper.Wait();
@@ -231,6 +254,9 @@ void AutomaticReconstructionController::RunSparseMapper() {
 void AutomaticReconstructionController::RunDenseMapper() {
   CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
 
+  // Joins the fusion and meshing of the previous reconstruction on return.
+  std::future<void> fusion_and_meshing;
+
   for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
     if (IsStopped()) {
       return;
@@ -295,50 +321,63 @@ void AutomaticReconstructionController::RunDenseMapper() {
       return;
     }
 
-    // Stereo fusion.
-
-    if (!ExistsFile(fused_path)) {
-      auto fusion_options = *option_manager_.stereo_fusion;
-      const int num_reg_images = reconstruction_manager_->Get(i).NumRegImages();
-      fusion_options.min_num_pixels =
-          std::min(num_reg_images + 1, fusion_options.min_num_pixels);
-      mvs::StereoFusion fuser(
-          fusion_options, dense_path, "COLMAP", "",
-          options_.quality == Quality::HIGH ? "geometric" : "photometric");
-      active_thread_ = &fuser;
-      fuser.Start();
-      fuser.Wait();
-      active_thread_ = nullptr;
-
-      std::cout << "Writing output: " << fused_path << std::endl;
-      WriteBinaryPlyPoints(fused_path, fuser.GetFusedPoints());
-      mvs::WritePointsVisibility(fused_path + ".vis",
-                                 fuser.GetFusedPointsVisibility());
+    // Fuse and mesh the reconstruction on the CPU, while the next
+    // reconstruction is already undistorted and processed by patch match
+    // stereo on the GPU. At most one fusion runs at the same time.
+    if (fusion_and_meshing.valid()) {
+      fusion_and_meshing.get();
     }
 
-    if (IsStopped()) {
-      return;
-    }
+    fusion_and_meshing = std::async(
+        std::launch::async,
+        &AutomaticReconstructionController::RunFusionAndMeshing, this, i,
+        dense_path, fused_path, meshing_path);
+  }
+}
+
+void AutomaticReconstructionController::RunFusionAndMeshing(
+    const size_t reconstruction_idx, const std::string& dense_path,
+    const std::string& fused_path, const std::string& meshing_path) {
+  // Stereo fusion.
+
+  if (!ExistsFile(fused_path)) {
+    auto fusion_options = *option_manager_.stereo_fusion;
+    const int num_reg_images =
+        reconstruction_manager_->Get(reconstruction_idx).NumRegImages();
+    fusion_options.min_num_pixels =
+        std::min(num_reg_images + 1, fusion_options.min_num_pixels);
+    mvs::StereoFusion fuser(
+        fusion_options, dense_path, "COLMAP", "",
+        options_.quality == Quality::HIGH ? "geometric" : "photometric");
+    fuser.SetOutputPath(fused_path);
+    active_fusion_thread_ = &fuser;
+    fuser.Start();
+    fuser.Wait();
+    active_fusion_thread_ = nullptr;
+  }
+
+  if (IsStopped()) {
+    return;
+  }
 
-    // Surface meshing.
+  // Surface meshing.
 
-    if (!ExistsFile(meshing_path)) {
-      if (options_.mesher == Mesher::POISSON) {
-        mvs::PoissonMeshing(*option_manager_.poisson_meshing, fused_path,
-                            meshing_path);
-      } else if (options_.mesher == Mesher::DELAUNAY) {
+  if (!ExistsFile(meshing_path)) {
+    if (options_.mesher == Mesher::POISSON) {
+      mvs::PoissonMeshing(*option_manager_.poisson_meshing, fused_path,
+                          meshing_path);
+    } else if (options_.mesher == Mesher::DELAUNAY) {
 #ifdef CGAL_ENABLED
-        mvs::DenseDelaunayMeshing(*option_manager_.delaunay_meshing, dense_path,
-                                  meshing_path);
+      mvs::DenseDelaunayMeshing(*option_manager_.delaunay_meshing, dense_path,
+                                meshing_path);
 #else  // CGAL_ENABLED
-        std::cout << std::endl
-                  << "WARNING: Skipping Delaunay meshing because CGAL is "
-                     "not available."
-                  << std::endl;
-        return;
+      std::cout << std::endl
+                << "WARNING: Skipping Delaunay meshing because CGAL is "
+                   "not available."
+                << std::endl;
+      return;
 
 #endif  // CGAL_ENABLED
-      }
     }
   }
 }
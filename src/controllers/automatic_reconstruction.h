@@ -32,8 +32,10 @@
 #ifndef COLMAP_SRC_CONTROLLERS_AUTOMATIC_RECONSTRUCTION_H_
 #define COLMAP_SRC_CONTROLLERS_AUTOMATIC_RECONSTRUCTION_H_
 
+#include <atomic>
 #include <string>
 
+#include "base/database.h"
 #include "base/reconstruction_manager.h"
 #include "util/option_manager.h"
 #include "util/threading.h"
@@ -94,6 +96,18 @@ class AutomaticReconstructionController : public Thread {
     // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
     // By default, all GPUs will be used in all stages.
     std::string gpu_index = "-1";
+
+    // Whether to pass the features and matches between the stages through an
+    // in-memory database instead of the database file in the workspace, which
+    // is only written once after feature matching. This avoids most of the
+    // disk I/O for small datasets, while all data must fit into memory. An
+    // existing database file in the workspace is replaced.
+    bool in_memory_database = false;
+
+    // Memory budget in GB, which limits the caches of the stages, see
+    // `OptionManager::ApplyMemoryBudget`. A value of zero uses the available
+    // physical memory and a negative value disables the limits.
+    double memory_budget = -1;
   };
 
   AutomaticReconstructionController(
@@ -107,11 +121,21 @@ class AutomaticReconstructionController : public Thread {
   void RunFeatureMatching();
   void RunSparseMapper();
   void RunDenseMapper();
+  void RunFusionAndMeshing(const size_t reconstruction_idx,
+                           const std::string& dense_path,
+                           const std::string& fused_path,
+                           const std::string& meshing_path);
 
   const Options options_;
   OptionManager option_manager_;
+  // The database that is used by all stages and the connection that keeps an
+  // in-memory database alive between the stages.
+  std::string database_path_;
+  std::unique_ptr<Database> in_memory_database_;
   ReconstructionManager* reconstruction_manager_;
   Thread* active_thread_;
+  // The fusion of a reconstruction runs concurrently to the other stages.
+  std::atomic<Thread*> active_fusion_thread_;
   std::unique_ptr<Thread> feature_extractor_;
   std::unique_ptr<Thread> exhaustive_matcher_;
   std::unique_ptr<Thread> sequential_matcher_;
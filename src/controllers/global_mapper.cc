@@ -0,0 +1,173 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "controllers/global_mapper.h"
+
+#include "util/misc.h"
+
+namespace colmap {
+
+GlobalMapperController::GlobalMapperController(
+    const GlobalMapper::Options& global_options,
+    const IncrementalMapperOptions* options, const std::string& image_path,
+    const std::string& database_path,
+    ReconstructionManager* reconstruction_manager)
+    : global_options_(global_options),
+      options_(options),
+      image_path_(image_path),
+      database_path_(database_path),
+      reconstruction_manager_(reconstruction_manager) {
+  CHECK(global_options_.Check());
+  CHECK(options_->Check());
+}
+
+void GlobalMapperController::Run() {
+  if (!LoadDatabase()) {
+    return;
+  }
+
+  if (IsStopped()) {
+    GetTimer().PrintMinutes();
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register all images
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Global image registration");
+
+  const size_t reconstruction_idx = reconstruction_manager_->Add();
+  Reconstruction& reconstruction =
+      reconstruction_manager_->Get(reconstruction_idx);
+
+  GlobalMapper global_mapper(&database_cache_);
+  const size_t num_reg_images =
+      global_mapper.RegisterImages(global_options_, &reconstruction);
+  std::cout << "  => Registered images: " << num_reg_images << std::endl;
+
+  if (num_reg_images < static_cast<size_t>(options_->min_model_size) ||
+      num_reg_images < 2) {
+    std::cout << "  => Not enough images registered." << std::endl;
+    reconstruction_manager_->Delete(reconstruction_idx);
+    GetTimer().PrintMinutes();
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Triangulate and refine the reconstruction
+  //////////////////////////////////////////////////////////////////////////////
+
+  IncrementalMapper mapper(&database_cache_);
+  mapper.BeginReconstruction(&reconstruction);
+
+  PrintHeading1("Triangulation");
+
+  size_t num_tris = 0;
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    num_tris += mapper.TriangulateImage(options_->Triangulation(), image_id);
+  }
+  std::cout << "  => Triangulated observations: " << num_tris << std::endl;
+
+  CompleteAndMergeTracks(*options_, &mapper);
+
+  for (int i = 0; i < options_->ba_global_max_refinements; ++i) {
+    if (IsStopped()) {
+      break;
+    }
+
+    const size_t num_observations = reconstruction.ComputeNumObservations();
+
+    PrintHeading1("Global bundle adjustment");
+    mapper.AdjustGlobalBundle(options_->Mapper(),
+                              options_->GlobalBundleAdjustment());
+
+    size_t num_changed_observations = 0;
+    num_changed_observations += CompleteAndMergeTracks(*options_, &mapper);
+    num_changed_observations += FilterPoints(*options_, &mapper);
+    const double changed =
+        static_cast<double>(num_changed_observations) /
+        std::max(num_observations, static_cast<size_t>(1));
+    std::cout << StringPrintf("  => Changed observations: %.6f", changed)
+              << std::endl;
+    if (changed < options_->ba_global_max_refinement_change) {
+      break;
+    }
+  }
+
+  // The poses are accurate after the global bundle adjustment, so that the
+  // image pairs without common observations are triangulated once more.
+  PrintHeading1("Retriangulation");
+  std::cout << "  => Retriangulated observations: "
+            << mapper.Retriangulate(options_->Triangulation()) << std::endl;
+  CompleteAndMergeTracks(*options_, &mapper);
+
+  PrintHeading1("Global bundle adjustment");
+  mapper.AdjustGlobalBundle(options_->Mapper(),
+                            options_->GlobalBundleAdjustment());
+  FilterPoints(*options_, &mapper);
+  FilterImages(*options_, &mapper);
+
+  if (options_->extract_colors) {
+    reconstruction.ExtractColorsForAllImages(image_path_);
+  }
+
+  mapper.EndReconstruction(false);
+
+  std::cout << std::endl;
+  GetTimer().PrintMinutes();
+}
+
+bool GlobalMapperController::LoadDatabase() {
+  PrintHeading1("Loading database");
+
+  Timer timer;
+  timer.Start();
+  Database database(database_path_);
+  database_cache_.Load(database, static_cast<size_t>(options_->min_num_matches),
+                       options_->ignore_watermarks, options_->image_names,
+                       options_->num_threads);
+  std::cout << std::endl;
+  timer.PrintMinutes();
+
+  std::cout << std::endl;
+
+  if (database_cache_.NumImages() == 0) {
+    std::cout << "WARNING: No images with matches found in the database."
+              << std::endl
+              << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace colmap
@@ -0,0 +1,70 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_CONTROLLERS_GLOBAL_MAPPER_H_
+#define COLMAP_SRC_CONTROLLERS_GLOBAL_MAPPER_H_
+
+#include "base/reconstruction_manager.h"
+#include "controllers/incremental_mapper.h"
+#include "sfm/global_mapper.h"
+#include "util/threading.h"
+
+namespace colmap {
+
+// Global mapping registers all images at once by averaging the relative poses
+// of the image pairs, then triangulates the scene and refines it in global
+// bundle adjustment. This is much faster than incremental mapping for large,
+// well-connected scenes, while the incremental mapper is typically more robust
+// for weakly connected scenes. The triangulation and bundle adjustment use the
+// options of the incremental mapper.
+class GlobalMapperController : public Thread {
+ public:
+  GlobalMapperController(const GlobalMapper::Options& global_options,
+                         const IncrementalMapperOptions* options,
+                         const std::string& image_path,
+                         const std::string& database_path,
+                         ReconstructionManager* reconstruction_manager);
+
+ private:
+  void Run();
+  bool LoadDatabase();
+
+  const GlobalMapper::Options global_options_;
+  const IncrementalMapperOptions* options_;
+  const std::string image_path_;
+  const std::string database_path_;
+  ReconstructionManager* reconstruction_manager_;
+  DatabaseCache database_cache_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_CONTROLLERS_GLOBAL_MAPPER_H_
@@ -31,40 +31,207 @@
 
 #include "controllers/hierarchical_mapper.h"
 
+#include <map>
+
+#include "base/database.h"
 #include "base/scene_clustering.h"
+#include "base/similarity_transform.h"
+#include "optim/bundle_adjustment.h"
 #include "util/misc.h"
+#include "util/timer.h"
 
 namespace colmap {
 namespace {
 
-void MergeClusters(
+std::string GetClustersPath(const std::string& cluster_path) {
+  return JoinPaths(cluster_path, "clusters.txt");
+}
+
+std::string GetClusterPath(const std::string& cluster_path,
+                           const size_t cluster_idx) {
+  return JoinPaths(cluster_path, "cluster" + std::to_string(cluster_idx));
+}
+
+std::string GetClusterDatabasePath(const std::string& cluster_path,
+                                   const size_t cluster_idx) {
+  return JoinPaths(GetClusterPath(cluster_path, cluster_idx), "database.db");
+}
+
+std::string GetClusterSparsePath(const std::string& cluster_path,
+                                 const size_t cluster_idx) {
+  return JoinPaths(GetClusterPath(cluster_path, cluster_idx), "sparse");
+}
+
+// The checkpoint folder of the incremental mapper of a leaf cluster, which is
+// empty if no checkpoints are written.
+std::string GetClusterCheckpointPath(const std::string& checkpoint_path,
+                                     const size_t cluster_idx) {
+  if (checkpoint_path.empty()) {
+    return "";
+  }
+  return GetClusterPath(checkpoint_path, cluster_idx);
+}
+
+// Write a database for each leaf cluster that only contains the cameras,
+// images, keypoints, and two-view geometries required to reconstruct the
+// cluster. The two-view geometries are streamed once per batch of clusters
+// to bound the number of simultaneously open databases.
+void WriteClusterDatabases(
+    const std::string& database_path, const std::string& cluster_path,
+    const std::vector<const SceneClustering::Cluster*>& leaf_clusters) {
+  const size_t kMaxNumOpenDatabases = 64;
+
+  Database database(database_path);
+
+  for (size_t batch_begin = 0; batch_begin < leaf_clusters.size();
+       batch_begin += kMaxNumOpenDatabases) {
+    const size_t batch_end =
+        std::min(leaf_clusters.size(), batch_begin + kMaxNumOpenDatabases);
+
+    std::vector<std::unique_ptr<Database>> cluster_databases;
+    std::vector<std::unique_ptr<DatabaseTransaction>> cluster_transactions;
+    std::unordered_map<image_t, std::vector<size_t>> image_id_to_batch_idxs;
+
+    for (size_t cluster_idx = batch_begin; cluster_idx < batch_end;
+         ++cluster_idx) {
+      std::cout << StringPrintf("  Writing database for cluster %d",
+                                cluster_idx)
+                << std::endl;
+
+      const std::string cluster_database_path =
+          GetClusterDatabasePath(cluster_path, cluster_idx);
+      CHECK(!ExistsFile(cluster_database_path))
+          << "Cluster database already exists: " << cluster_database_path;
+      CreateDirIfNotExists(GetClusterPath(cluster_path, cluster_idx));
+
+      cluster_databases.emplace_back(new Database(cluster_database_path));
+      cluster_transactions.emplace_back(
+          new DatabaseTransaction(cluster_databases.back().get()));
+      const Database& cluster_database = *cluster_databases.back();
+
+      std::unordered_set<camera_t> camera_ids;
+      for (const auto image_id : leaf_clusters[cluster_idx]->image_ids) {
+        const Image image = database.ReadImage(image_id);
+        if (camera_ids.insert(image.CameraId()).second) {
+          cluster_database.WriteCamera(database.ReadCamera(image.CameraId()),
+                                       /*use_camera_id=*/true);
+        }
+        cluster_database.WriteImage(image, /*use_image_id=*/true);
+        cluster_database.WriteKeypoints(image_id,
+                                        database.ReadKeypoints(image_id));
+        image_id_to_batch_idxs[image_id].push_back(cluster_idx - batch_begin);
+      }
+    }
+
+    database.ReadTwoViewGeometries(
+        [&](const image_pair_t pair_id, TwoViewGeometry* two_view_geometry) {
+          image_t image_id1;
+          image_t image_id2;
+          Database::PairIdToImagePair(pair_id, &image_id1, &image_id2);
+          const auto batch_idxs1 = image_id_to_batch_idxs.find(image_id1);
+          const auto batch_idxs2 = image_id_to_batch_idxs.find(image_id2);
+          if (batch_idxs1 == image_id_to_batch_idxs.end() ||
+              batch_idxs2 == image_id_to_batch_idxs.end()) {
+            return;
+          }
+          // Both lists are sorted, since clusters are visited in order.
+          auto it1 = batch_idxs1->second.begin();
+          auto it2 = batch_idxs2->second.begin();
+          while (it1 != batch_idxs1->second.end() &&
+                 it2 != batch_idxs2->second.end()) {
+            if (*it1 < *it2) {
+              ++it1;
+            } else if (*it2 < *it1) {
+              ++it2;
+            } else {
+              cluster_databases[*it1]->WriteTwoViewGeometry(
+                  image_id1, image_id2, *two_view_geometry);
+              ++it1;
+              ++it2;
+            }
+          }
+        });
+  }
+}
+
+// Merge the reconstructions of the child clusters into the reconstruction
+// manager of the given cluster, which must already exist.
+void MergeCluster(
     const SceneClustering::Cluster& cluster,
     std::unordered_map<const SceneClustering::Cluster*, ReconstructionManager>*
-        reconstruction_managers) {
+        reconstruction_managers,
+    const int num_threads) {
   // Extract all reconstructions from all child clusters.
   std::vector<Reconstruction*> reconstructions;
   for (const auto& child_cluster : cluster.child_clusters) {
-    if (!child_cluster.child_clusters.empty()) {
-      MergeClusters(child_cluster, reconstruction_managers);
-    }
-
     auto& reconstruction_manager = reconstruction_managers->at(&child_cluster);
     for (size_t i = 0; i < reconstruction_manager.Size(); ++i) {
       reconstructions.push_back(&reconstruction_manager.Get(i));
     }
   }
 
+  const double kMaxReprojError = 8.0;
+  const double kMinInlierObservations = 0.3;
+
+  // The estimated alignments from the first into the second reconstruction,
+  // which remain valid until the second reconstruction is merged into.
+  typedef std::pair<const Reconstruction*, const Reconstruction*>
+      ReconstructionPair;
+  std::map<ReconstructionPair, size_t> alignment_idxs;
+  std::vector<char> alignment_success;
+  std::vector<Eigen::Matrix3x4d> alignments;
+
   // Try to merge all child cluster reconstruction.
   while (reconstructions.size() > 1) {
+    // Estimate the alignments of all not yet aligned pairs in parallel.
+    std::vector<ReconstructionPair> new_pairs;
+    for (size_t i = 0; i < reconstructions.size(); ++i) {
+      for (size_t j = 0; j < i; ++j) {
+        const ReconstructionPair pair(reconstructions[j], reconstructions[i]);
+        if (alignment_idxs.count(pair) == 0) {
+          new_pairs.push_back(pair);
+        }
+      }
+    }
+
+    std::vector<Eigen::Matrix3x4d> new_alignments;
+    const std::vector<char> new_alignment_success =
+        ComputeAlignmentsBetweenReconstructions(
+            new_pairs, kMinInlierObservations, kMaxReprojError,
+            &new_alignments, num_threads);
+    for (size_t k = 0; k < new_pairs.size(); ++k) {
+      alignment_idxs.emplace(new_pairs[k], alignments.size());
+      alignment_success.push_back(new_alignment_success[k]);
+      alignments.push_back(new_alignments[k]);
+    }
+
+    // Merge the first pair that could be aligned in the same order as a
+    // serial search over all pairs.
     bool merge_success = false;
     for (size_t i = 0; i < reconstructions.size(); ++i) {
       for (size_t j = 0; j < i; ++j) {
-        const double kMaxReprojError = 8.0;
-        if (reconstructions[i]->Merge(*reconstructions[j], kMaxReprojError)) {
-          reconstructions.erase(reconstructions.begin() + j);
-          merge_success = true;
-          break;
+        const size_t alignment_idx =
+            alignment_idxs.at(ReconstructionPair(reconstructions[j],
+                                                 reconstructions[i]));
+        if (!alignment_success[alignment_idx]) {
+          continue;
         }
+
+        reconstructions[i]->MergeWithAlignment(
+            *reconstructions[j], alignments[alignment_idx], kMaxReprojError);
+
+        for (auto it = alignment_idxs.begin(); it != alignment_idxs.end();) {
+          if (it->first.first == reconstructions[i] ||
+              it->first.second == reconstructions[i]) {
+            it = alignment_idxs.erase(it);
+          } else {
+            ++it;
+          }
+        }
+
+        reconstructions.erase(reconstructions.begin() + j);
+        merge_success = true;
+        break;
       }
 
       if (merge_success) {
@@ -77,25 +244,107 @@ void MergeClusters(
     }
   }
 
-  // Insert a new reconstruction manager for merged cluster.
-  auto& reconstruction_manager = (*reconstruction_managers)[&cluster];
+  // Insert the reconstructions into the manager of the merged cluster.
+  auto& reconstruction_manager = reconstruction_managers->at(&cluster);
   for (const auto& reconstruction : reconstructions) {
     reconstruction_manager.Add();
     reconstruction_manager.Get(reconstruction_manager.Size() - 1) =
         *reconstruction;
   }
+}
 
-  // Delete all merged child cluster reconstruction managers.
-  for (const auto& child_cluster : cluster.child_clusters) {
-    reconstruction_managers->erase(&child_cluster);
+// Merge the reconstructions of all clusters bottom-up into the root cluster.
+// The clusters at the same depth of the tree are independent and merged in
+// parallel, where clusters with fewer siblings use more threads to align
+// their reconstructions.
+void MergeClusters(
+    const SceneClustering::Cluster& root_cluster,
+    std::unordered_map<const SceneClustering::Cluster*, ReconstructionManager>*
+        reconstruction_managers,
+    const int num_threads) {
+  std::vector<std::vector<const SceneClustering::Cluster*>> clusters_by_depth;
+  std::function<void(const SceneClustering::Cluster&, size_t)> CollectClusters =
+      [&](const SceneClustering::Cluster& cluster, const size_t depth) {
+        if (cluster.child_clusters.empty()) {
+          return;
+        }
+        if (clusters_by_depth.size() <= depth) {
+          clusters_by_depth.resize(depth + 1);
+        }
+        clusters_by_depth[depth].push_back(&cluster);
+        for (const auto& child_cluster : cluster.child_clusters) {
+          CollectClusters(child_cluster, depth + 1);
+        }
+      };
+  CollectClusters(root_cluster, 0);
+
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+
+  for (auto clusters = clusters_by_depth.rbegin();
+       clusters != clusters_by_depth.rend(); ++clusters) {
+    // Insert the managers before merging, so that the map is only read
+    // concurrently.
+    for (const auto cluster : *clusters) {
+      (*reconstruction_managers)[cluster];
+    }
+
+    const int num_workers =
+        std::min(num_eff_threads, static_cast<int>(clusters->size()));
+    const int num_threads_per_worker =
+        std::max(1, num_eff_threads / num_workers);
+
+    ThreadPool thread_pool(num_workers);
+    for (const auto cluster : *clusters) {
+      thread_pool.AddTask(MergeCluster, std::cref(*cluster),
+                          reconstruction_managers, num_threads_per_worker);
+    }
+    thread_pool.Wait();
+
+    // Delete all merged child cluster reconstruction managers.
+    for (const auto cluster : *clusters) {
+      for (const auto& child_cluster : cluster->child_clusters) {
+        reconstruction_managers->erase(&child_cluster);
+      }
+    }
   }
 }
 
+// Globally bundle adjust the merged reconstruction.
+void AdjustGlobalBundle(const BundleAdjustmentOptions& ba_options,
+                        Reconstruction* reconstruction) {
+  const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
+  if (reg_image_ids.size() < 2) {
+    return;
+  }
+
+  // Avoid degeneracies in bundle adjustment.
+  reconstruction->FilterObservationsWithNegativeDepth();
+
+  BundleAdjustmentConfig ba_config;
+  for (const image_t image_id : reg_image_ids) {
+    ba_config.AddImage(image_id);
+  }
+
+  // Fix 7-DOFs of the bundle adjustment problem.
+  ba_config.SetConstantPose(reg_image_ids[0]);
+  ba_config.SetConstantTvec(reg_image_ids[1], {0});
+
+  BundleAdjuster bundle_adjuster(ba_options, ba_config);
+  bundle_adjuster.Solve(reconstruction);
+}
+
 }  // namespace
 
 bool HierarchicalMapperController::Options::Check() const {
   CHECK_OPTION_GT(init_num_trials, -1);
   CHECK_OPTION_GE(num_workers, -1);
+  CHECK_OPTION_GE(num_threads, -1);
+  if (stage != Stage::ALL) {
+    CHECK_OPTION(!cluster_path.empty());
+  }
+  if (stage == Stage::RECONSTRUCT) {
+    CHECK_OPTION_GE(cluster_idx, 0);
+  }
   return true;
 }
 
@@ -114,47 +363,32 @@ HierarchicalMapperController::HierarchicalMapperController(
 }
 
 void HierarchicalMapperController::Run() {
-  PrintHeading1("Partitioning the scene");
+  switch (options_.stage) {
+    case Stage::ALL:
+      RunAll();
+      break;
+    case Stage::PARTITION:
+      RunPartition();
+      break;
+    case Stage::RECONSTRUCT:
+      RunReconstruct();
+      break;
+    case Stage::MERGE:
+      RunMerge();
+      break;
+  }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Cluster scene
-  //////////////////////////////////////////////////////////////////////////////
+  std::cout << std::endl;
+  GetTimer().PrintMinutes();
+}
 
+void HierarchicalMapperController::RunAll() {
   SceneClustering scene_clustering(clustering_options_);
-
   std::unordered_map<image_t, std::string> image_id_to_name;
-
-  {
-    Database database(options_.database_path);
-
-    std::cout << "Reading images..." << std::endl;
-    const auto images = database.ReadAllImages();
-    for (const auto& image : images) {
-      image_id_to_name.emplace(image.ImageId(), image.Name());
-    }
-
-    std::cout << "Reading scene graph..." << std::endl;
-    std::vector<std::pair<image_t, image_t>> image_pairs;
-    std::vector<int> num_inliers;
-    database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
-
-    std::cout << "Partitioning scene graph..." << std::endl;
-    scene_clustering.Partition(image_pairs, num_inliers);
-  }
+  PartitionScene(&scene_clustering, &image_id_to_name);
 
   auto leaf_clusters = scene_clustering.GetLeafClusters();
 
-  size_t total_num_images = 0;
-  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
-    total_num_images += leaf_clusters[i]->image_ids.size();
-    std::cout << StringPrintf("  Cluster %d with %d images", i + 1,
-                              leaf_clusters[i]->image_ids.size())
-              << std::endl;
-  }
-
-  std::cout << StringPrintf("Clusters have %d images", total_num_images)
-            << std::endl;
-
   //////////////////////////////////////////////////////////////////////////////
   // Reconstruct clusters
   //////////////////////////////////////////////////////////////////////////////
@@ -173,29 +407,37 @@ void HierarchicalMapperController::Run() {
   const int num_threads_per_worker =
       std::max(1, num_eff_threads / num_eff_workers);
 
-  // Function to reconstruct one cluster using incremental mapping.
-  auto ReconstructCluster = [&, this](
-                                const SceneClustering::Cluster& cluster,
-                                ReconstructionManager* reconstruction_manager) {
-    if (cluster.image_ids.empty()) {
-      return;
-    }
-
-    IncrementalMapperOptions custom_options = mapper_options_;
-    custom_options.max_model_overlap = 3;
-    custom_options.init_num_trials = options_.init_num_trials;
-    custom_options.num_threads = num_threads_per_worker;
+  // Load the database once and share the cameras and images between all
+  // workers, which only allocate the correspondence graph of their cluster.
+  PrintHeading1("Loading database");
 
-    for (const auto image_id : cluster.image_ids) {
-      custom_options.image_names.insert(image_id_to_name.at(image_id));
-    }
+  DatabaseCache database_cache;
+  {
+    Database database(options_.database_path);
+    Timer timer;
+    timer.Start();
+    const size_t min_num_matches =
+        static_cast<size_t>(mapper_options_.min_num_matches);
+    database_cache.Load(database, min_num_matches,
+                        mapper_options_.ignore_watermarks,
+                        mapper_options_.image_names, num_eff_threads);
+    std::cout << std::endl;
+    timer.PrintMinutes();
+  }
 
-    IncrementalMapperController mapper(&custom_options, options_.image_path,
-                                       options_.database_path,
-                                       reconstruction_manager);
-    mapper.Start();
-    mapper.Wait();
-  };
+  // The checkpoints of the clusters are identified by their index in the
+  // partition, which does not change when resuming.
+  std::unordered_map<const SceneClustering::Cluster*, std::string>
+      checkpoint_paths;
+  if (!mapper_options_.checkpoint_path.empty()) {
+    CreateDirIfNotExists(mapper_options_.checkpoint_path);
+  }
+  for (size_t cluster_idx = 0; cluster_idx < leaf_clusters.size();
+       ++cluster_idx) {
+    checkpoint_paths.emplace(
+        leaf_clusters[cluster_idx],
+        GetClusterCheckpointPath(mapper_options_.checkpoint_path, cluster_idx));
+  }
 
   // Start reconstructing the bigger clusters first for resource usage.
   std::sort(leaf_clusters.begin(), leaf_clusters.end(),
@@ -212,7 +454,11 @@ void HierarchicalMapperController::Run() {
 
   ThreadPool thread_pool(num_eff_workers);
   for (const auto& cluster : leaf_clusters) {
-    thread_pool.AddTask(ReconstructCluster, *cluster,
+    thread_pool.AddTask(&HierarchicalMapperController::ReconstructCluster,
+                        this, std::cref(*cluster), std::cref(image_id_to_name),
+                        std::cref(options_.database_path), &database_cache,
+                        std::cref(checkpoint_paths.at(cluster)),
+                        num_threads_per_worker,
                         &reconstruction_managers[cluster]);
   }
   thread_pool.Wait();
@@ -223,13 +469,209 @@ void HierarchicalMapperController::Run() {
 
   PrintHeading1("Merging clusters");
 
-  MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers);
+  MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers,
+                options_.num_threads);
 
   CHECK_EQ(reconstruction_managers.size(), 1);
   *reconstruction_manager_ = std::move(reconstruction_managers.begin()->second);
 
-  std::cout << std::endl;
-  GetTimer().PrintMinutes();
+  if (options_.ba_global) {
+    AdjustGlobalBundles();
+  }
+}
+
+void HierarchicalMapperController::RunPartition() {
+  SceneClustering scene_clustering(clustering_options_);
+  std::unordered_map<image_t, std::string> image_id_to_name;
+  PartitionScene(&scene_clustering, &image_id_to_name);
+
+  PrintHeading1("Writing clusters");
+
+  CreateDirIfNotExists(options_.cluster_path);
+  scene_clustering.Write(GetClustersPath(options_.cluster_path));
+
+  if (options_.write_cluster_databases) {
+    WriteClusterDatabases(options_.database_path, options_.cluster_path,
+                          scene_clustering.GetLeafClusters());
+  }
+}
+
+void HierarchicalMapperController::RunReconstruct() {
+  SceneClustering scene_clustering(clustering_options_);
+  scene_clustering.Read(GetClustersPath(options_.cluster_path));
+
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  CHECK_LT(options_.cluster_idx, leaf_clusters.size());
+  const auto& cluster = *leaf_clusters[options_.cluster_idx];
+
+  PrintHeading1(StringPrintf("Reconstructing cluster %d with %d images",
+                             options_.cluster_idx, cluster.image_ids.size()));
+
+  // Prefer the cluster database written in the partition stage.
+  std::string database_path = GetClusterDatabasePath(
+      options_.cluster_path, static_cast<size_t>(options_.cluster_idx));
+  if (!ExistsFile(database_path)) {
+    database_path = options_.database_path;
+  }
+
+  std::unordered_map<image_t, std::string> image_id_to_name;
+  {
+    Database database(database_path);
+    for (const auto& image : database.ReadAllImages()) {
+      image_id_to_name.emplace(image.ImageId(), image.Name());
+    }
+  }
+
+  if (!mapper_options_.checkpoint_path.empty()) {
+    CreateDirIfNotExists(mapper_options_.checkpoint_path);
+  }
+  const std::string checkpoint_path = GetClusterCheckpointPath(
+      mapper_options_.checkpoint_path,
+      static_cast<size_t>(options_.cluster_idx));
+
+  ReconstructCluster(cluster, image_id_to_name, database_path, nullptr,
+                     checkpoint_path, mapper_options_.num_threads,
+                     reconstruction_manager_);
+
+  const std::string sparse_path = GetClusterSparsePath(
+      options_.cluster_path, static_cast<size_t>(options_.cluster_idx));
+  CreateDirIfNotExists(sparse_path);
+  reconstruction_manager_->Write(sparse_path, nullptr);
+}
+
+void HierarchicalMapperController::RunMerge() {
+  SceneClustering scene_clustering(clustering_options_);
+  scene_clustering.Read(GetClustersPath(options_.cluster_path));
+
+  PrintHeading1("Reading clusters");
+
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+
+  std::unordered_map<const SceneClustering::Cluster*, ReconstructionManager>
+      reconstruction_managers;
+  reconstruction_managers.reserve(leaf_clusters.size());
+
+  for (size_t cluster_idx = 0; cluster_idx < leaf_clusters.size();
+       ++cluster_idx) {
+    auto& reconstruction_manager =
+        reconstruction_managers[leaf_clusters[cluster_idx]];
+    const std::string sparse_path =
+        GetClusterSparsePath(options_.cluster_path, cluster_idx);
+    if (!ExistsDir(sparse_path)) {
+      std::cout << StringPrintf("  Cluster %d has no reconstruction",
+                                cluster_idx)
+                << std::endl;
+      continue;
+    }
+
+    auto reconstruction_paths = GetDirList(sparse_path);
+    std::sort(reconstruction_paths.begin(), reconstruction_paths.end());
+    for (const auto& reconstruction_path : reconstruction_paths) {
+      reconstruction_manager.Read(reconstruction_path);
+    }
+
+    std::cout << StringPrintf("  Cluster %d with %d reconstructions",
+                              cluster_idx, reconstruction_manager.Size())
+              << std::endl;
+  }
+
+  PrintHeading1("Merging clusters");
+
+  MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers,
+                options_.num_threads);
+
+  CHECK_EQ(reconstruction_managers.size(), 1);
+  *reconstruction_manager_ = std::move(reconstruction_managers.begin()->second);
+
+  if (options_.ba_global) {
+    AdjustGlobalBundles();
+  }
+}
+
+void HierarchicalMapperController::AdjustGlobalBundles() {
+  PrintHeading1("Global bundle adjustment");
+
+  IncrementalMapperOptions custom_options = mapper_options_;
+  custom_options.num_threads = options_.num_threads;
+  const BundleAdjustmentOptions ba_options =
+      custom_options.GlobalBundleAdjustment();
+
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    Reconstruction& reconstruction = reconstruction_manager_->Get(i);
+    AdjustGlobalBundle(ba_options, &reconstruction);
+    reconstruction.Normalize();
+  }
+}
+
+void HierarchicalMapperController::PartitionScene(
+    SceneClustering* scene_clustering,
+    std::unordered_map<image_t, std::string>* image_id_to_name) const {
+  PrintHeading1("Partitioning the scene");
+
+  {
+    Database database(options_.database_path);
+
+    std::cout << "Reading images..." << std::endl;
+    const auto images = database.ReadAllImages();
+    for (const auto& image : images) {
+      image_id_to_name->emplace(image.ImageId(), image.Name());
+    }
+
+    std::cout << "Reading scene graph..." << std::endl;
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    std::vector<int> num_inliers;
+    database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
+
+    std::cout << "Partitioning scene graph..." << std::endl;
+    scene_clustering->Partition(image_pairs, num_inliers);
+  }
+
+  const auto leaf_clusters = scene_clustering->GetLeafClusters();
+
+  size_t total_num_images = 0;
+  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+    total_num_images += leaf_clusters[i]->image_ids.size();
+    std::cout << StringPrintf("  Cluster %d with %d images", i,
+                              leaf_clusters[i]->image_ids.size())
+              << std::endl;
+  }
+
+  std::cout << StringPrintf("Clusters have %d images", total_num_images)
+            << std::endl;
+}
+
+void HierarchicalMapperController::ReconstructCluster(
+    const SceneClustering::Cluster& cluster,
+    const std::unordered_map<image_t, std::string>& image_id_to_name,
+    const std::string& database_path, const DatabaseCache* database_cache,
+    const std::string& checkpoint_path, const int num_threads,
+    ReconstructionManager* reconstruction_manager) const {
+  if (cluster.image_ids.empty()) {
+    return;
+  }
+
+  IncrementalMapperOptions custom_options = mapper_options_;
+  custom_options.max_model_overlap = 3;
+  custom_options.init_num_trials = options_.init_num_trials;
+  custom_options.num_threads = num_threads;
+  custom_options.checkpoint_path = checkpoint_path;
+
+  for (const auto image_id : cluster.image_ids) {
+    custom_options.image_names.insert(image_id_to_name.at(image_id));
+  }
+
+  std::unique_ptr<IncrementalMapperController> mapper;
+  if (database_cache == nullptr) {
+    mapper.reset(new IncrementalMapperController(
+        &custom_options, options_.image_path, database_path,
+        reconstruction_manager));
+  } else {
+    mapper.reset(new IncrementalMapperController(
+        &custom_options, options_.image_path, database_cache,
+        reconstruction_manager));
+  }
+  mapper->Start();
+  mapper->Wait();
 }
 
 }  // namespace colmap
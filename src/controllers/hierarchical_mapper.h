@@ -44,8 +44,25 @@ namespace colmap {
 // mapping, and finally merges them all into a globally consistent
 // reconstruction. This is especially useful for larger-scale scenes, since
 // incremental mapping becomes slow with an increasing number of images.
+//
+// By default, all stages run in this process. Alternatively, the stages can be
+// run separately through a directory shared between multiple machines: the
+// coordinator partitions the scene, every worker reconstructs one or more
+// leaf clusters, and the coordinator finally merges the cluster
+// reconstructions.
 class HierarchicalMapperController : public Thread {
  public:
+  enum class Stage {
+    // Partition, reconstruct, and merge all clusters in this process.
+    ALL,
+    // Partition the scene and write the clusters to `cluster_path`.
+    PARTITION,
+    // Reconstruct the leaf cluster `cluster_idx` from `cluster_path`.
+    RECONSTRUCT,
+    // Merge all leaf cluster reconstructions from `cluster_path`.
+    MERGE,
+  };
+
   struct Options {
     // The path to the image folder which are used as input.
     std::string image_path;
@@ -59,6 +76,28 @@ class HierarchicalMapperController : public Thread {
     // The number of workers used to reconstruct clusters in parallel.
     int num_workers = -1;
 
+    // The number of threads used to partition the scene and to merge the
+    // cluster reconstructions.
+    int num_threads = -1;
+
+    // Whether to globally bundle adjust the merged reconstructions.
+    bool ba_global = false;
+
+    // The stage to run. All stages except `ALL` exchange their inputs and
+    // outputs through `cluster_path`.
+    Stage stage = Stage::ALL;
+
+    // The directory shared between the coordinator and the workers.
+    std::string cluster_path;
+
+    // The index of the leaf cluster to reconstruct in the `RECONSTRUCT` stage.
+    int cluster_idx = -1;
+
+    // Whether to write a separate database for each leaf cluster in the
+    // `PARTITION` stage, such that workers only need to read the data of
+    // their own cluster instead of the full database.
+    bool write_cluster_databases = true;
+
     bool Check() const;
   };
 
@@ -71,6 +110,26 @@ class HierarchicalMapperController : public Thread {
  private:
   void Run() override;
 
+  void RunAll();
+  void RunPartition();
+  void RunReconstruct();
+  void RunMerge();
+  void AdjustGlobalBundles();
+
+  void PartitionScene(
+      SceneClustering* scene_clustering,
+      std::unordered_map<image_t, std::string>* image_id_to_name) const;
+
+  // Reconstruct the cluster from the shared database cache, if given, and
+  // otherwise by loading the cluster's images from the database. The mapper
+  // of the cluster is checkpointed to the given folder, unless it is empty.
+  void ReconstructCluster(
+      const SceneClustering::Cluster& cluster,
+      const std::unordered_map<image_t, std::string>& image_id_to_name,
+      const std::string& database_path, const DatabaseCache* database_cache,
+      const std::string& checkpoint_path, const int num_threads,
+      ReconstructionManager* reconstruction_manager) const;
+
   const Options options_;
   const SceneClustering::Options clustering_options_;
   const IncrementalMapperOptions mapper_options_;
@@ -31,11 +31,80 @@
 
 #include "controllers/incremental_mapper.h"
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#include "util/endian.h"
+#include "util/metrics.h"
 #include "util/misc.h"
+#include "util/random.h"
 
 namespace colmap {
 namespace {
 
+// Export the progress of the incremental mapping, see util/metrics.h.
+void RecordRegistrationMetrics(const Reconstruction& reconstruction,
+                               const bool success,
+                               const double elapsed_seconds) {
+  static MetricCounter& num_registered = GetMetricCounter(
+      "mapper_registered_images_total", "Number of registered next images");
+  static MetricCounter& num_failed = GetMetricCounter(
+      "mapper_failed_registrations_total",
+      "Number of failed registration trials of next images");
+  static MetricGauge& registration_rate = GetMetricGauge(
+      "mapper_registered_images_per_minute",
+      "Average number of registered images per minute of mapping");
+  static MetricGauge& num_reg_images = GetMetricGauge(
+      "mapper_num_reg_images",
+      "Number of registered images in the current reconstruction");
+  static MetricGauge& num_points3D =
+      GetMetricGauge("mapper_num_points3D",
+                     "Number of 3D points in the current reconstruction");
+  if (success) {
+    num_registered.Increment();
+  } else {
+    num_failed.Increment();
+  }
+  if (elapsed_seconds > 0) {
+    registration_rate.Set(60 * num_registered.Value() / elapsed_seconds);
+  }
+  num_reg_images.Set(reconstruction.NumRegImages());
+  num_points3D.Set(reconstruction.NumPoints3D());
+}
+
+// Estimate the poses of the next images concurrently against the current
+// state of the reconstruction. Each estimation has its own PRNG seed derived
+// from the image, so the estimated poses do not depend on the scheduling of the
+// estimations to threads.
+std::vector<IncrementalMapper::NextImagePose> EstimateNextImagePoses(
+    const IncrementalMapperOptions& options,
+    const std::vector<image_t>& image_ids, const IncrementalMapper& mapper,
+    ThreadPool* thread_pool) {
+  IncrementalMapper::Options mapper_options = options.Mapper();
+  mapper_options.num_threads = 1;
+
+  const unsigned seed = RandomPRNGSeed();
+
+  std::vector<IncrementalMapper::NextImagePose> poses(image_ids.size());
+  std::vector<std::future<void>> futures;
+  futures.reserve(image_ids.size());
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    futures.push_back(thread_pool->AddTask([&, i]() {
+      ScopedPRNGSeed scoped_prng_seed(seed ^ (image_ids[i] * 2654435761u));
+      mapper.EstimateNextImagePose(mapper_options, image_ids[i], &poses[i]);
+    }));
+  }
+
+  for (auto& future : futures) {
+    future.get();
+  }
+
+  return poses;
+}
+
 size_t TriangulateImage(const IncrementalMapperOptions& options,
                         const Image& image, IncrementalMapper* mapper) {
   std::cout << "  => Continued observations: " << image.NumPoints3D()
@@ -62,18 +131,337 @@ void AdjustGlobalBundle(const IncrementalMapperOptions& options,
     custom_ba_options.solver_options.max_linear_solver_iterations = 200;
   }
 
+  // Use PBA if it was explicitly enabled or the problem is large enough.
+  const bool use_pba =
+      options.ba_global_use_pba ||
+      (options.ba_global_pba_min_num_observations >= 0 &&
+       mapper->GetReconstruction().ComputeNumObservations() >=
+           static_cast<size_t>(options.ba_global_pba_min_num_observations));
+
   PrintHeading1("Global bundle adjustment");
-  if (options.ba_global_use_pba && !options.fix_existing_images &&
-      num_reg_images >= kMinNumRegImagesForFastBA &&
+  if (use_pba && num_reg_images >= kMinNumRegImagesForFastBA &&
       ParallelBundleAdjuster::IsSupported(custom_ba_options,
                                           mapper->GetReconstruction())) {
     mapper->AdjustParallelGlobalBundle(
-        custom_ba_options, options.ParallelGlobalBundleAdjustment());
+        options.Mapper(), custom_ba_options,
+        options.ParallelGlobalBundleAdjustment());
+  } else if (options.ba_global_partition_max_num_images > 0 &&
+             num_reg_images > static_cast<size_t>(
+                                  options.ba_global_partition_max_num_images)) {
+    mapper->AdjustPartitionedGlobalBundle(
+        options.Mapper(), custom_ba_options,
+        options.PartitionedGlobalBundleAdjustment());
   } else {
     mapper->AdjustGlobalBundle(options.Mapper(), custom_ba_options);
   }
 }
 
+void ExtractColors(const std::string& image_path, const image_t image_id,
+                   Reconstruction* reconstruction) {
+  if (!reconstruction->ExtractColorsForImage(image_id, image_path)) {
+    std::cout << StringPrintf("WARNING: Could not read image %s at path %s.",
+                              reconstruction->Image(image_id).Name().c_str(),
+                              image_path.c_str())
+              << std::endl;
+  }
+}
+
+// Get a unique name for a snapshot from the current timestamp in milliseconds.
+std::string GetSnapshotName() {
+  const size_t timestamp =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now().time_since_epoch())
+          .count();
+  return StringPrintf("%010d", timestamp);
+}
+
+void WriteSnapshot(const Reconstruction& reconstruction,
+                   const std::string& snapshot_path) {
+  PrintHeading1("Creating snapshot");
+  // Write reconstruction to unique path with current timestamp.
+  const std::string path = JoinPaths(snapshot_path, GetSnapshotName());
+  CreateDirIfNotExists(path);
+  std::cout << "  => Writing to " << path << std::endl;
+  reconstruction.Write(path);
+}
+
+// Appends the snapshots of a reconstruction to a journal. The changes since
+// the previous snapshot are serialized in the calling thread, while the
+// serialized data is written to the file in a background thread.
+class SnapshotJournal {
+ public:
+  explicit SnapshotJournal(const std::string& snapshot_path)
+      : path_(JoinPaths(snapshot_path, GetSnapshotName() + ".journal")),
+        thread_pool_(1) {
+    std::ofstream file(path_, std::ios::trunc | std::ios::binary);
+    CHECK(file.is_open()) << path_;
+  }
+
+  ~SnapshotJournal() { thread_pool_.Wait(); }
+
+  void Write(const Reconstruction& reconstruction) {
+    PrintHeading1("Creating snapshot");
+
+    auto data = std::make_shared<std::string>();
+    {
+      std::ostringstream stream;
+      reconstruction.WriteJournalCheckpoint(&state_, &stream);
+      *data = stream.str();
+    }
+
+    std::cout << "  => Appending " << data->size() << " bytes to " << path_
+              << std::endl;
+
+    // Only keep the data of a single pending snapshot in memory.
+    thread_pool_.Wait();
+    thread_pool_.AddTask([this, data]() {
+      std::ofstream file(path_, std::ios::app | std::ios::binary);
+      CHECK(file.is_open()) << path_;
+      file.write(data->data(), data->size());
+    });
+  }
+
+ private:
+  const std::string path_;
+  Reconstruction::JournalState state_;
+  ThreadPool thread_pool_;
+};
+
+// The files of a mapper checkpoint in the checkpoint folder.
+const char kCheckpointStateName[] = "mapper.state";
+const char kCheckpointJournalName[] = "model.journal";
+
+// Replace the file with the data, such that it is not left incompletely
+// written, if the mapper is interrupted.
+void ReplaceFile(const std::string& path, const std::string& data) {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc | std::ios::binary);
+    CHECK(file.is_open()) << tmp_path;
+    file.write(data.data(), data.size());
+  }
+  CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0) << path;
+}
+
+template <typename T>
+void WriteIds(const std::unordered_set<T>& ids, std::ostream* stream) {
+  WriteBinaryLittleEndian<uint64_t>(stream, ids.size());
+  for (const T id : ids) {
+    WriteBinaryLittleEndian<T>(stream, id);
+  }
+}
+
+template <typename T>
+void ReadIds(std::istream* stream, std::unordered_set<T>* ids) {
+  const size_t num_ids = ReadBinaryLittleEndian<uint64_t>(stream);
+  ids->clear();
+  ids->reserve(num_ids);
+  for (size_t i = 0; i < num_ids && *stream; ++i) {
+    ids->insert(ReadBinaryLittleEndian<T>(stream));
+  }
+}
+
+template <typename T>
+void WriteIdCounts(const std::unordered_map<T, size_t>& counts,
+                   std::ostream* stream) {
+  WriteBinaryLittleEndian<uint64_t>(stream, counts.size());
+  for (const auto& count : counts) {
+    WriteBinaryLittleEndian<T>(stream, count.first);
+    WriteBinaryLittleEndian<uint64_t>(stream, count.second);
+  }
+}
+
+template <typename T>
+void ReadIdCounts(std::istream* stream,
+                  std::unordered_map<T, size_t>* counts) {
+  const size_t num_counts = ReadBinaryLittleEndian<uint64_t>(stream);
+  counts->clear();
+  counts->reserve(num_counts);
+  for (size_t i = 0; i < num_counts && *stream; ++i) {
+    const T id = ReadBinaryLittleEndian<T>(stream);
+    (*counts)[id] = ReadBinaryLittleEndian<uint64_t>(stream);
+  }
+}
+
+std::string SerializeCheckpointState(
+    const IncrementalMapperCheckpoint::State& state) {
+  std::ostringstream stream;
+  WriteBinaryLittleEndian<uint8_t>(&stream,
+                                   state.initial_reconstruction_given);
+  WriteBinaryLittleEndian<uint8_t>(&stream, state.complete);
+  WriteBinaryLittleEndian<uint64_t>(&stream, state.num_finished_models);
+  WriteBinaryLittleEndian<uint8_t>(&stream, state.has_current_model);
+  WriteIdCounts(state.mapper.init_num_reg_trials, &stream);
+  WriteIds(state.mapper.init_image_pairs, &stream);
+  WriteIdCounts(state.mapper.num_registrations, &stream);
+  WriteIds(state.mapper.existing_image_ids, &stream);
+  WriteIds(state.mapper.filtered_images, &stream);
+  WriteIdCounts(state.mapper.num_reg_trials, &stream);
+  return stream.str();
+}
+
+}  // namespace
+
+IncrementalMapperCheckpoint::IncrementalMapperCheckpoint(
+    const std::string& path, const bool initial_reconstruction_given,
+    const size_t num_finished_models)
+    : path_(path),
+      initial_reconstruction_given_(initial_reconstruction_given),
+      num_finished_models_(num_finished_models),
+      journal_begun_(false),
+      thread_pool_(1) {
+  CreateDirIfNotExists(path_);
+}
+
+IncrementalMapperCheckpoint::~IncrementalMapperCheckpoint() {
+  thread_pool_.Wait();
+}
+
+void IncrementalMapperCheckpoint::Write(const IncrementalMapper& mapper) {
+  PrintHeading1("Creating checkpoint");
+
+  State state;
+  state.initial_reconstruction_given = initial_reconstruction_given_;
+  state.num_finished_models = num_finished_models_;
+  state.has_current_model = true;
+  state.mapper = mapper.GetState();
+  auto state_data = std::make_shared<std::string>(
+      SerializeCheckpointState(state));
+
+  // The journal of a new model in progress replaces the journal of the
+  // previous model, while the following checkpoints are appended to it.
+  auto journal_data = std::make_shared<std::string>();
+  {
+    std::ostringstream stream;
+    mapper.GetReconstruction().WriteJournalCheckpoint(&journal_state_,
+                                                      &stream);
+    *journal_data = stream.str();
+  }
+  const bool append_journal = journal_begun_;
+  journal_begun_ = true;
+
+  std::cout << "  => Writing " << journal_data->size() + state_data->size()
+            << " bytes to " << path_ << std::endl;
+
+  // Only keep the data of a single pending checkpoint in memory. The state is
+  // written after the journal, such that the journal is never older than the
+  // state of the mapper.
+  thread_pool_.Wait();
+  thread_pool_.AddTask([this, state_data, journal_data, append_journal]() {
+    const std::string journal_path = JoinPaths(path_, kCheckpointJournalName);
+    if (append_journal) {
+      std::ofstream file(journal_path, std::ios::app | std::ios::binary);
+      CHECK(file.is_open()) << journal_path;
+      file.write(journal_data->data(), journal_data->size());
+    } else {
+      ReplaceFile(journal_path, *journal_data);
+    }
+    ReplaceFile(JoinPaths(path_, kCheckpointStateName), *state_data);
+  });
+}
+
+void IncrementalMapperCheckpoint::WriteFinished(
+    const IncrementalMapper& mapper, const Reconstruction* reconstruction) {
+  thread_pool_.Wait();
+
+  if (reconstruction != nullptr) {
+    const std::string model_path =
+        JoinPaths(path_, std::to_string(num_finished_models_));
+    CreateDirIfNotExists(model_path);
+    reconstruction->Write(model_path);
+    num_finished_models_ += 1;
+  }
+
+  journal_begun_ = false;
+  journal_state_ = Reconstruction::JournalState();
+
+  State state;
+  state.initial_reconstruction_given = initial_reconstruction_given_;
+  state.num_finished_models = num_finished_models_;
+  state.mapper = mapper.GetState();
+  WriteState(state);
+}
+
+void IncrementalMapperCheckpoint::WriteComplete() {
+  thread_pool_.Wait();
+
+  State state;
+  state.initial_reconstruction_given = initial_reconstruction_given_;
+  state.complete = true;
+  state.num_finished_models = num_finished_models_;
+  WriteState(state);
+}
+
+bool IncrementalMapperCheckpoint::Exists(const std::string& path) {
+  return ExistsFile(JoinPaths(path, kCheckpointStateName));
+}
+
+void IncrementalMapperCheckpoint::Read(
+    const std::string& path, ReconstructionManager* reconstruction_manager,
+    State* state) {
+  const std::string state_path = JoinPaths(path, kCheckpointStateName);
+  std::ifstream file(state_path, std::ios::binary);
+  CHECK(file.is_open()) << state_path;
+
+  *state = State();
+  state->initial_reconstruction_given =
+      ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+  state->complete = ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+  state->num_finished_models = ReadBinaryLittleEndian<uint64_t>(&file);
+  state->has_current_model = ReadBinaryLittleEndian<uint8_t>(&file) != 0;
+  ReadIdCounts(&file, &state->mapper.init_num_reg_trials);
+  ReadIds(&file, &state->mapper.init_image_pairs);
+  ReadIdCounts(&file, &state->mapper.num_registrations);
+  ReadIds(&file, &state->mapper.existing_image_ids);
+  ReadIds(&file, &state->mapper.filtered_images);
+  ReadIdCounts(&file, &state->mapper.num_reg_trials);
+  CHECK(file) << "Incomplete checkpoint " << state_path;
+
+  for (size_t i = 0; i < state->num_finished_models; ++i) {
+    reconstruction_manager->Get(reconstruction_manager->Add())
+        .Read(JoinPaths(path, std::to_string(i)));
+  }
+
+  if (state->has_current_model) {
+    reconstruction_manager->Get(reconstruction_manager->Add())
+        .ReadJournal(JoinPaths(path, kCheckpointJournalName));
+  }
+}
+
+void IncrementalMapperCheckpoint::WriteState(const State& state) {
+  ReplaceFile(JoinPaths(path_, kCheckpointStateName),
+              SerializeCheckpointState(state));
+}
+
+size_t FilterPoints(const IncrementalMapperOptions& options,
+                    IncrementalMapper* mapper) {
+  const size_t num_filtered_observations =
+      mapper->FilterPoints(options.Mapper());
+  std::cout << "  => Filtered observations: " << num_filtered_observations
+            << std::endl;
+  return num_filtered_observations;
+}
+
+size_t FilterImages(const IncrementalMapperOptions& options,
+                    IncrementalMapper* mapper) {
+  const size_t num_filtered_images = mapper->FilterImages(options.Mapper());
+  std::cout << "  => Filtered images: " << num_filtered_images << std::endl;
+  return num_filtered_images;
+}
+
+size_t CompleteAndMergeTracks(const IncrementalMapperOptions& options,
+                              IncrementalMapper* mapper) {
+  const size_t num_completed_observations =
+      mapper->CompleteTracks(options.Triangulation());
+  std::cout << "  => Completed observations: " << num_completed_observations
+            << std::endl;
+  const size_t num_merged_observations =
+      mapper->MergeTracks(options.Triangulation());
+  std::cout << "  => Merged observations: " << num_merged_observations
+            << std::endl;
+  return num_completed_observations + num_merged_observations;
+}
+
 void IterativeLocalRefinement(const IncrementalMapperOptions& options,
                               const image_t image_id,
                               IncrementalMapper* mapper) {
@@ -130,63 +518,6 @@ void IterativeGlobalRefinement(const IncrementalMapperOptions& options,
   FilterImages(options, mapper);
 }
 
-void ExtractColors(const std::string& image_path, const image_t image_id,
-                   Reconstruction* reconstruction) {
-  if (!reconstruction->ExtractColorsForImage(image_id, image_path)) {
-    std::cout << StringPrintf("WARNING: Could not read image %s at path %s.",
-                              reconstruction->Image(image_id).Name().c_str(),
-                              image_path.c_str())
-              << std::endl;
-  }
-}
-
-void WriteSnapshot(const Reconstruction& reconstruction,
-                   const std::string& snapshot_path) {
-  PrintHeading1("Creating snapshot");
-  // Get the current timestamp in milliseconds.
-  const size_t timestamp =
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::high_resolution_clock::now().time_since_epoch())
-          .count();
-  // Write reconstruction to unique path with current timestamp.
-  const std::string path =
-      JoinPaths(snapshot_path, StringPrintf("%010d", timestamp));
-  CreateDirIfNotExists(path);
-  std::cout << "  => Writing to " << path << std::endl;
-  reconstruction.Write(path);
-}
-
-}  // namespace
-
-size_t FilterPoints(const IncrementalMapperOptions& options,
-                    IncrementalMapper* mapper) {
-  const size_t num_filtered_observations =
-      mapper->FilterPoints(options.Mapper());
-  std::cout << "  => Filtered observations: " << num_filtered_observations
-            << std::endl;
-  return num_filtered_observations;
-}
-
-size_t FilterImages(const IncrementalMapperOptions& options,
-                    IncrementalMapper* mapper) {
-  const size_t num_filtered_images = mapper->FilterImages(options.Mapper());
-  std::cout << "  => Filtered images: " << num_filtered_images << std::endl;
-  return num_filtered_images;
-}
-
-size_t CompleteAndMergeTracks(const IncrementalMapperOptions& options,
-                              IncrementalMapper* mapper) {
-  const size_t num_completed_observations =
-      mapper->CompleteTracks(options.Triangulation());
-  std::cout << "  => Completed observations: " << num_completed_observations
-            << std::endl;
-  const size_t num_merged_observations =
-      mapper->MergeTracks(options.Triangulation());
-  std::cout << "  => Merged observations: " << num_merged_observations
-            << std::endl;
-  return num_completed_observations + num_merged_observations;
-}
-
 IncrementalMapper::Options IncrementalMapperOptions::Mapper() const {
   IncrementalMapper::Options options = mapper;
   options.abs_pose_refine_focal_length = ba_refine_focal_length;
@@ -196,7 +527,11 @@ IncrementalMapper::Options IncrementalMapperOptions::Mapper() const {
   options.max_extra_param = max_extra_param;
   options.num_threads = num_threads;
   options.local_ba_num_images = ba_local_num_images;
+  options.local_ba_reuse_problem = ba_local_reuse_problem;
   options.fix_existing_images = fix_existing_images;
+  options.global_ba_max_num_points_per_image =
+      ba_global_max_num_points_per_image;
+  options.global_ba_reuse_problem = ba_global_reuse_problem;
   return options;
 }
 
@@ -206,6 +541,7 @@ IncrementalTriangulator::Options IncrementalMapperOptions::Triangulation()
   options.min_focal_length_ratio = min_focal_length_ratio;
   options.max_focal_length_ratio = max_focal_length_ratio;
   options.max_extra_param = max_extra_param;
+  options.num_threads = num_threads;
   return options;
 }
 
@@ -231,6 +567,7 @@ BundleAdjustmentOptions IncrementalMapperOptions::LocalBundleAdjustment()
   options.loss_function_scale = 1.0;
   options.loss_function_type =
       BundleAdjustmentOptions::LossFunctionType::SOFT_L1;
+  options.prior_position_std = ba_prior_position_std;
   return options;
 }
 
@@ -255,6 +592,7 @@ BundleAdjustmentOptions IncrementalMapperOptions::GlobalBundleAdjustment()
 	  ba_min_num_residuals_for_multi_threading;
   options.loss_function_type =
       BundleAdjustmentOptions::LossFunctionType::TRIVIAL;
+  options.prior_position_std = ba_prior_position_std;
   return options;
 }
 
@@ -270,27 +608,42 @@ IncrementalMapperOptions::ParallelGlobalBundleAdjustment() const {
   return options;
 }
 
+PartitionedBundleAdjuster::Options
+IncrementalMapperOptions::PartitionedGlobalBundleAdjustment() const {
+  PartitionedBundleAdjuster::Options options;
+  options.max_num_images = ba_global_partition_max_num_images;
+  options.image_overlap = ba_global_partition_image_overlap;
+  return options;
+}
+
 bool IncrementalMapperOptions::Check() const {
   CHECK_OPTION_GT(min_num_matches, 0);
   CHECK_OPTION_GT(max_num_models, 0);
   CHECK_OPTION_GT(max_model_overlap, 0);
+  CHECK_OPTION_GT(num_parallel_models, 0);
+  CHECK_OPTION_GT(num_speculative_images, 0);
   CHECK_OPTION_GE(min_model_size, 0);
   CHECK_OPTION_GT(init_num_trials, 0);
   CHECK_OPTION_GT(min_focal_length_ratio, 0);
   CHECK_OPTION_GT(max_focal_length_ratio, 0);
   CHECK_OPTION_GE(max_extra_param, 0);
+  CHECK_OPTION_GT(ba_prior_position_std, 0);
   CHECK_OPTION_GE(ba_local_num_images, 2);
   CHECK_OPTION_GE(ba_local_max_num_iterations, 0);
   CHECK_OPTION_GT(ba_global_images_ratio, 1.0);
   CHECK_OPTION_GT(ba_global_points_ratio, 1.0);
   CHECK_OPTION_GT(ba_global_images_freq, 0);
   CHECK_OPTION_GT(ba_global_points_freq, 0);
+  CHECK_OPTION_GE(ba_global_prior_freq_factor, 1.0);
   CHECK_OPTION_GT(ba_global_max_num_iterations, 0);
+  CHECK_OPTION_GE(ba_global_partition_image_overlap, 0);
   CHECK_OPTION_GT(ba_local_max_refinements, 0);
   CHECK_OPTION_GE(ba_local_max_refinement_change, 0);
   CHECK_OPTION_GT(ba_global_max_refinements, 0);
   CHECK_OPTION_GE(ba_global_max_refinement_change, 0);
   CHECK_OPTION_GE(snapshot_images_freq, 0);
+  CHECK_OPTION_GT(checkpoint_images_freq, 0);
+  CHECK_OPTION(!resume || !checkpoint_path.empty());
   CHECK_OPTION(Mapper().Check());
   CHECK_OPTION(Triangulation().Check());
   return true;
@@ -303,18 +656,63 @@ IncrementalMapperController::IncrementalMapperController(
     : options_(options),
       image_path_(image_path),
       database_path_(database_path),
-      reconstruction_manager_(reconstruction_manager) {
+      reconstruction_manager_(reconstruction_manager),
+      shared_database_cache_(nullptr) {
   CHECK(options_->Check());
   RegisterCallback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
   RegisterCallback(NEXT_IMAGE_REG_CALLBACK);
   RegisterCallback(LAST_IMAGE_REG_CALLBACK);
 }
 
+IncrementalMapperController::IncrementalMapperController(
+    const IncrementalMapperOptions* options, const std::string& image_path,
+    const DatabaseCache* database_cache,
+    ReconstructionManager* reconstruction_manager)
+    : IncrementalMapperController(options, image_path, "",
+                                  reconstruction_manager) {
+  shared_database_cache_ = CHECK_NOTNULL(database_cache);
+}
+
 void IncrementalMapperController::Run() {
   if (!LoadDatabase()) {
     return;
   }
 
+  if (options_->resume &&
+      IncrementalMapperCheckpoint::Exists(options_->checkpoint_path)) {
+    PrintHeading1("Resuming from checkpoint");
+    CHECK_EQ(reconstruction_manager_->Size(), 0)
+        << "The checkpoint already contains the given reconstruction.";
+    resume_state_.reset(new IncrementalMapperCheckpoint::State());
+    IncrementalMapperCheckpoint::Read(options_->checkpoint_path,
+                                      reconstruction_manager_,
+                                      resume_state_.get());
+    std::cout << StringPrintf("  => Finished models: %d",
+                              resume_state_->num_finished_models)
+              << std::endl;
+    if (resume_state_->complete) {
+      std::cout << "  => Reconstruction is already complete." << std::endl;
+      resume_state_.reset();
+      return;
+    }
+  }
+
+  if (!options_->checkpoint_path.empty()) {
+    if (resume_state_) {
+      checkpoint_.reset(new IncrementalMapperCheckpoint(
+          options_->checkpoint_path,
+          resume_state_->initial_reconstruction_given,
+          resume_state_->num_finished_models));
+    } else {
+      const bool initial_reconstruction_given =
+          reconstruction_manager_->Size() > 0;
+      const size_t kNumFinishedModels = 0;
+      checkpoint_.reset(new IncrementalMapperCheckpoint(
+          options_->checkpoint_path, initial_reconstruction_given,
+          kNumFinishedModels));
+    }
+  }
+
   IncrementalMapper::Options init_mapper_options = options_->Mapper();
   Reconstruct(init_mapper_options);
 
@@ -337,6 +735,11 @@ void IncrementalMapperController::Run() {
     Reconstruct(init_mapper_options);
   }
 
+  if (checkpoint_ && !IsStopped()) {
+    checkpoint_->WriteComplete();
+  }
+  checkpoint_.reset();
+
   std::cout << std::endl;
   GetTimer().PrintMinutes();
 }
@@ -355,18 +758,27 @@ bool IncrementalMapperController::LoadDatabase() {
     }
   }
 
-  Database database(database_path_);
   Timer timer;
   timer.Start();
-  const size_t min_num_matches = static_cast<size_t>(options_->min_num_matches);
-  database_cache_.Load(database, min_num_matches, options_->ignore_watermarks,
-                       image_names);
+  if (shared_database_cache_ == nullptr) {
+    Database database(database_path_);
+    const size_t min_num_matches =
+        static_cast<size_t>(options_->min_num_matches);
+    std::unique_ptr<DatabaseCache> database_cache(new DatabaseCache());
+    database_cache->Load(database, min_num_matches,
+                         options_->ignore_watermarks, image_names,
+                         options_->num_threads);
+    database_cache_ = std::move(database_cache);
+  } else {
+    database_cache_ =
+        DatabaseCache::CreateSubset(*shared_database_cache_, image_names);
+  }
   std::cout << std::endl;
   timer.PrintMinutes();
 
   std::cout << std::endl;
 
-  if (database_cache_.NumImages() == 0) {
+  if (database_cache_->NumImages() == 0) {
     std::cout << "WARNING: No images with matches found in the database."
               << std::endl
               << std::endl;
@@ -378,20 +790,38 @@ bool IncrementalMapperController::LoadDatabase() {
 
 void IncrementalMapperController::Reconstruct(
     const IncrementalMapper::Options& init_mapper_options) {
-  const bool kDiscardReconstruction = true;
+  // Is there a sub-model before we start the reconstruction? I.e. the user
+  // has imported an existing reconstruction.
+  bool initial_reconstruction_given = reconstruction_manager_->Size() > 0;
+  // Whether the last model is continued, i.e. the imported reconstruction or
+  // the model in progress of the resumed checkpoint.
+  bool continue_last_model = initial_reconstruction_given;
+  if (resume_state_) {
+    initial_reconstruction_given = resume_state_->initial_reconstruction_given;
+    continue_last_model = resume_state_->has_current_model;
+    // The imported reconstruction was already finished.
+    if (initial_reconstruction_given && !continue_last_model) {
+      resume_state_.reset();
+      return;
+    }
+  } else {
+    CHECK_LE(reconstruction_manager_->Size(), 1)
+        << "Can only resume from a single reconstruction, but multiple are "
+           "given.";
+  }
+
+  if (!initial_reconstruction_given && !checkpoint_ &&
+      options_->multiple_models && options_->num_parallel_models > 1 &&
+      options_->init_image_id1 == -1 && options_->init_image_id2 == -1) {
+    ReconstructConcurrently(init_mapper_options);
+    return;
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Main loop
   //////////////////////////////////////////////////////////////////////////////
 
-  IncrementalMapper mapper(&database_cache_);
-
-  // Is there a sub-model before we start the reconstruction? I.e. the user
-  // has imported an existing reconstruction.
-  const bool initial_reconstruction_given = reconstruction_manager_->Size() > 0;
-  CHECK_LE(reconstruction_manager_->Size(), 1) << "Can only resume from a "
-                                                  "single reconstruction, but "
-                                                  "multiple are given.";
+  IncrementalMapper mapper(database_cache_.get());
 
   for (int num_trials = 0; num_trials < options_->init_num_trials;
        ++num_trials) {
@@ -401,232 +831,431 @@ void IncrementalMapperController::Reconstruct(
     }
 
     size_t reconstruction_idx;
-    if (!initial_reconstruction_given || num_trials > 0) {
-      reconstruction_idx = reconstruction_manager_->Add();
+    if (continue_last_model && num_trials == 0) {
+      reconstruction_idx = reconstruction_manager_->Size() - 1;
     } else {
-      reconstruction_idx = 0;
+      reconstruction_idx = reconstruction_manager_->Add();
     }
 
     Reconstruction& reconstruction =
         reconstruction_manager_->Get(reconstruction_idx);
 
-    mapper.BeginReconstruction(&reconstruction);
-
-    ////////////////////////////////////////////////////////////////////////////
-    // Register initial pair
-    ////////////////////////////////////////////////////////////////////////////
-
-    if (reconstruction.NumRegImages() == 0) {
-      image_t image_id1 = static_cast<image_t>(options_->init_image_id1);
-      image_t image_id2 = static_cast<image_t>(options_->init_image_id2);
-
-      // Try to find good initial pair.
-      if (options_->init_image_id1 == -1 || options_->init_image_id2 == -1) {
-        PrintHeading1("Finding good initial image pair");
-        const bool find_init_success = mapper.FindInitialImagePair(
-            init_mapper_options, &image_id1, &image_id2);
-        if (!find_init_success) {
-          std::cout << "  => No good initial image pair found." << std::endl;
-          mapper.EndReconstruction(kDiscardReconstruction);
-          reconstruction_manager_->Delete(reconstruction_idx);
+    const bool kConcurrent = false;
+    const ModelStatus status =
+        ReconstructModel(init_mapper_options, &mapper, &reconstruction,
+                         kConcurrent, checkpoint_.get());
+    if (status == ModelStatus::INTERRUPTED) {
+      break;
+    }
+
+    if (checkpoint_) {
+      checkpoint_->WriteFinished(
+          mapper, status == ModelStatus::SUCCESS ? &reconstruction : nullptr);
+    }
+
+    if (status != ModelStatus::SUCCESS) {
+      reconstruction_manager_->Delete(reconstruction_idx);
+    }
+
+    if (status == ModelStatus::INITIALIZATION_FAILED) {
+      break;
+    } else if (status == ModelStatus::BAD_INITIAL_PAIR) {
+      continue;
+    }
+
+    Callback(LAST_IMAGE_REG_CALLBACK);
+
+    const size_t max_num_models = static_cast<size_t>(options_->max_num_models);
+    if (initial_reconstruction_given || !options_->multiple_models ||
+        reconstruction_manager_->Size() >= max_num_models ||
+        mapper.NumTotalRegImages() >= database_cache_->NumImages() - 1) {
+      break;
+    }
+  }
+}
+
+void IncrementalMapperController::ReconstructConcurrently(
+    const IncrementalMapper::Options& init_mapper_options) {
+  // The mappers claim the images they register, such that each mapper only
+  // initializes new models from unclaimed images and the models respect the
+  // maximum overlap, as if they were reconstructed one after another.
+  ImageClaims image_claims(database_cache_->ImageIds(),
+                           static_cast<size_t>(options_->max_model_overlap));
+
+  const size_t max_num_models = static_cast<size_t>(options_->max_num_models);
+  std::atomic<int> num_trials(0);
+  std::atomic<bool> finished(false);
+  std::mutex reconstruction_manager_mutex;
+
+  auto ReconstructModels = [&]() {
+    IncrementalMapper mapper(database_cache_.get(), &image_claims);
+
+    while (!finished && num_trials++ < options_->init_num_trials) {
+      BlockIfPaused();
+      if (IsStopped()) {
+        break;
+      }
+
+      // Models that are still being reconstructed count towards the maximum
+      // number of models, so that no more models than requested are started.
+      Reconstruction* reconstruction = nullptr;
+      {
+        std::unique_lock<std::mutex> lock(reconstruction_manager_mutex);
+        if (reconstruction_manager_->Size() >= max_num_models) {
+          finished = true;
           break;
         }
-      } else {
-        if (!reconstruction.ExistsImage(image_id1) ||
-            !reconstruction.ExistsImage(image_id2)) {
-          std::cout << StringPrintf(
-                           "  => Initial image pair #%d and #%d do not exist.",
-                           image_id1, image_id2)
-                    << std::endl;
-          mapper.EndReconstruction(kDiscardReconstruction);
-          reconstruction_manager_->Delete(reconstruction_idx);
-          return;
-        }
+        reconstruction =
+            &reconstruction_manager_->Get(reconstruction_manager_->Add());
       }
 
-      PrintHeading1(StringPrintf("Initializing with image pair #%d and #%d",
-                                 image_id1, image_id2));
-      const bool reg_init_success = mapper.RegisterInitialImagePair(
-          init_mapper_options, image_id1, image_id2);
-      if (!reg_init_success) {
-        std::cout << "  => Initialization failed - possible solutions:"
-                  << std::endl
-                  << "     - try to relax the initialization constraints"
-                  << std::endl
-                  << "     - manually select an initial image pair"
-                  << std::endl;
-        mapper.EndReconstruction(kDiscardReconstruction);
-        reconstruction_manager_->Delete(reconstruction_idx);
+      const bool kConcurrent = true;
+      const ModelStatus status =
+          ReconstructModel(init_mapper_options, &mapper, reconstruction,
+                           kConcurrent, nullptr);
+      if (status == ModelStatus::INTERRUPTED) {
         break;
       }
 
-      AdjustGlobalBundle(*options_, &mapper);
-      FilterPoints(*options_, &mapper);
-      FilterImages(*options_, &mapper);
-
-      // Initial image pair failed to register.
-      if (reconstruction.NumRegImages() == 0 ||
-          reconstruction.NumPoints3D() == 0) {
-        mapper.EndReconstruction(kDiscardReconstruction);
-        reconstruction_manager_->Delete(reconstruction_idx);
-        // If both initial images are manually specified, there is no need for
-        // further initialization trials.
-        if (options_->init_image_id1 != -1 && options_->init_image_id2 != -1) {
-          break;
-        } else {
-          continue;
+      std::unique_lock<std::mutex> lock(reconstruction_manager_mutex);
+
+      // The indices of the other models change when a model is deleted, so
+      // the model is identified by its address.
+      if (status != ModelStatus::SUCCESS) {
+        for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+          if (&reconstruction_manager_->Get(i) == reconstruction) {
+            reconstruction_manager_->Delete(i);
+            break;
+          }
         }
       }
 
-      if (options_->extract_colors) {
-        ExtractColors(image_path_, image_id1, &reconstruction);
+      if (status == ModelStatus::INITIALIZATION_FAILED) {
+        break;
+      } else if (status == ModelStatus::BAD_INITIAL_PAIR) {
+        continue;
+      }
+
+      Callback(LAST_IMAGE_REG_CALLBACK);
+
+      if (mapper.NumTotalRegImages() >= database_cache_->NumImages() - 1) {
+        finished = true;
       }
     }
+  };
 
-    Callback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
+  ThreadPool thread_pool(options_->num_parallel_models);
+  for (int i = 0; i < options_->num_parallel_models; ++i) {
+    thread_pool.AddTask(ReconstructModels);
+  }
+  thread_pool.Wait();
+}
 
-    ////////////////////////////////////////////////////////////////////////////
-    // Incremental mapping
-    ////////////////////////////////////////////////////////////////////////////
+IncrementalMapperController::ModelStatus
+IncrementalMapperController::ReconstructModel(
+    const IncrementalMapper::Options& init_mapper_options,
+    IncrementalMapper* mapper, Reconstruction* reconstruction_ptr,
+    const bool concurrent, IncrementalMapperCheckpoint* checkpoint) {
+  const bool kDiscardReconstruction = true;
 
-    size_t snapshot_prev_num_reg_images = reconstruction.NumRegImages();
-    size_t ba_prev_num_reg_images = reconstruction.NumRegImages();
-    size_t ba_prev_num_points = reconstruction.NumPoints3D();
+  Reconstruction& reconstruction = *reconstruction_ptr;
 
-    bool reg_next_success = true;
-    bool prev_reg_next_success = true;
-    while (reg_next_success) {
-      BlockIfPaused();
-      if (IsStopped()) {
-        break;
+  if (resume_state_) {
+    mapper->ResumeReconstruction(&reconstruction, resume_state_->mapper);
+    resume_state_.reset();
+  } else {
+    mapper->BeginReconstruction(&reconstruction);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Register initial pair
+  //////////////////////////////////////////////////////////////////////////////
+
+  if (reconstruction.NumRegImages() == 0) {
+    image_t image_id1 = static_cast<image_t>(options_->init_image_id1);
+    image_t image_id2 = static_cast<image_t>(options_->init_image_id2);
+
+    // Try to find good initial pair.
+    if (options_->init_image_id1 == -1 || options_->init_image_id2 == -1) {
+      PrintHeading1("Finding good initial image pair");
+      const bool find_init_success = mapper->FindInitialImagePair(
+          init_mapper_options, &image_id1, &image_id2);
+      if (!find_init_success) {
+        std::cout << "  => No good initial image pair found." << std::endl;
+        mapper->EndReconstruction(kDiscardReconstruction);
+        return ModelStatus::INITIALIZATION_FAILED;
       }
+    } else {
+      if (!reconstruction.ExistsImage(image_id1) ||
+          !reconstruction.ExistsImage(image_id2)) {
+        std::cout << StringPrintf(
+                         "  => Initial image pair #%d and #%d do not exist.",
+                         image_id1, image_id2)
+                  << std::endl;
+        mapper->EndReconstruction(kDiscardReconstruction);
+        return ModelStatus::INITIALIZATION_FAILED;
+      }
+    }
 
-      reg_next_success = false;
+    PrintHeading1(StringPrintf("Initializing with image pair #%d and #%d",
+                               image_id1, image_id2));
+    const bool reg_init_success = mapper->RegisterInitialImagePair(
+        init_mapper_options, image_id1, image_id2);
+    if (!reg_init_success) {
+      std::cout << "  => Initialization failed - possible solutions:"
+                << std::endl
+                << "     - try to relax the initialization constraints"
+                << std::endl
+                << "     - manually select an initial image pair"
+                << std::endl;
+      mapper->EndReconstruction(kDiscardReconstruction);
+      return ModelStatus::INITIALIZATION_FAILED;
+    }
 
-      const std::vector<image_t> next_images =
-          mapper.FindNextImages(options_->Mapper());
+    AdjustGlobalBundle(*options_, mapper);
+    FilterPoints(*options_, mapper);
+    FilterImages(*options_, mapper);
+
+    // Initial image pair failed to register.
+    if (reconstruction.NumRegImages() == 0 ||
+        reconstruction.NumPoints3D() == 0) {
+      mapper->EndReconstruction(kDiscardReconstruction);
+      // If both initial images are manually specified, there is no need for
+      // further initialization trials.
+      if (options_->init_image_id1 != -1 && options_->init_image_id2 != -1) {
+        return ModelStatus::INITIALIZATION_FAILED;
+      } else {
+        return ModelStatus::BAD_INITIAL_PAIR;
+      }
+    }
 
-      if (next_images.empty()) {
-        break;
+    if (options_->extract_colors) {
+      ExtractColors(image_path_, image_id1, &reconstruction);
+    }
+  }
+
+  if (!concurrent) {
+    Callback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Incremental mapping
+  //////////////////////////////////////////////////////////////////////////////
+
+  size_t snapshot_prev_num_reg_images = reconstruction.NumRegImages();
+  std::unique_ptr<SnapshotJournal> snapshot_journal;
+  if (!concurrent && options_->snapshot_images_freq > 0 &&
+      options_->snapshot_journal) {
+    snapshot_journal.reset(new SnapshotJournal(options_->snapshot_path));
+  }
+  size_t checkpoint_prev_num_reg_images = reconstruction.NumRegImages();
+  size_t ba_prev_num_reg_images = reconstruction.NumRegImages();
+  size_t ba_prev_num_points = reconstruction.NumPoints3D();
+
+  // The poses of multiple next images can be estimated speculatively in
+  // parallel and are then registered one after another.
+  const size_t num_speculative_images =
+      static_cast<size_t>(options_->num_speculative_images);
+  std::unique_ptr<ThreadPool> speculative_thread_pool;
+  if (num_speculative_images > 1) {
+    speculative_thread_pool.reset(
+        new ThreadPool(GetEffectiveNumThreads(options_->num_threads)));
+  }
+
+  bool reg_next_success = true;
+  bool prev_reg_next_success = true;
+  while (reg_next_success) {
+    BlockIfPaused();
+    if (IsStopped()) {
+      break;
+    }
+
+    reg_next_success = false;
+
+    const std::vector<image_t> next_images =
+        mapper->FindNextImages(options_->Mapper());
+
+    if (next_images.empty()) {
+      break;
+    }
+
+    std::vector<IncrementalMapper::NextImagePose> next_image_poses;
+    size_t next_image_poses_begin = 0;
+    bool reg_any_success = false;
+
+    for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
+      const image_t next_image_id = next_images[reg_trial];
+      const Image& next_image = reconstruction.Image(next_image_id);
+
+      if (speculative_thread_pool &&
+          reg_trial >= next_image_poses_begin + next_image_poses.size()) {
+        const std::vector<image_t> speculative_image_ids(
+            next_images.begin() + reg_trial,
+            next_images.begin() +
+                std::min(next_images.size(),
+                         reg_trial + num_speculative_images));
+        next_image_poses_begin = reg_trial;
+        next_image_poses =
+            EstimateNextImagePoses(*options_, speculative_image_ids, *mapper,
+                                   speculative_thread_pool.get());
       }
 
-      for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
-        const image_t next_image_id = next_images[reg_trial];
-        const Image& next_image = reconstruction.Image(next_image_id);
+      // The remaining candidates of the speculative poses are registered
+      // before ranking the next images again.
+      const bool last_speculative_image =
+          reg_trial + 1 >= next_image_poses_begin + next_image_poses.size();
 
-        PrintHeading1(StringPrintf("Registering image #%d (%d)", next_image_id,
-                                   reconstruction.NumRegImages() + 1));
+      PrintHeading1(StringPrintf("Registering image #%d (%d)", next_image_id,
+                                 reconstruction.NumRegImages() + 1));
 
-        std::cout << StringPrintf("  => Image sees %d / %d points",
-                                  next_image.NumVisiblePoints3D(),
-                                  next_image.NumObservations())
-                  << std::endl;
+      std::cout << StringPrintf("  => Image sees %d / %d points",
+                                next_image.NumVisiblePoints3D(),
+                                next_image.NumObservations())
+                << std::endl;
 
+      if (speculative_thread_pool) {
+        reg_next_success = mapper->RegisterNextImage(
+            options_->Mapper(),
+            next_image_poses[reg_trial - next_image_poses_begin]);
+      } else {
         reg_next_success =
-            mapper.RegisterNextImage(options_->Mapper(), next_image_id);
-
-        if (reg_next_success) {
-          TriangulateImage(*options_, next_image, &mapper);
-          IterativeLocalRefinement(*options_, next_image_id, &mapper);
-
-          if (reconstruction.NumRegImages() >=
-                  options_->ba_global_images_ratio * ba_prev_num_reg_images ||
-              reconstruction.NumRegImages() >=
-                  options_->ba_global_images_freq + ba_prev_num_reg_images ||
-              reconstruction.NumPoints3D() >=
-                  options_->ba_global_points_ratio * ba_prev_num_points ||
-              reconstruction.NumPoints3D() >=
-                  options_->ba_global_points_freq + ba_prev_num_points) {
-            IterativeGlobalRefinement(*options_, &mapper);
-            ba_prev_num_points = reconstruction.NumPoints3D();
-            ba_prev_num_reg_images = reconstruction.NumRegImages();
-          }
+            mapper->RegisterNextImage(options_->Mapper(), next_image_id);
+      }
 
-          if (options_->extract_colors) {
-            ExtractColors(image_path_, next_image_id, &reconstruction);
-          }
+      RecordRegistrationMetrics(reconstruction, reg_next_success,
+                                GetTimer().ElapsedSeconds());
+
+      if (reg_next_success) {
+        TriangulateImage(*options_, next_image, mapper);
+        IterativeLocalRefinement(*options_, next_image_id, mapper);
+
+        // The position priors bound the drift of an aligned reconstruction,
+        // such that global bundle adjustment is needed less often.
+        const double ba_global_freq_factor =
+            mapper->IsAlignedToPriorPositions()
+                ? options_->ba_global_prior_freq_factor
+                : 1.0;
+        const auto IsGrown = [ba_global_freq_factor](
+                                 const size_t num, const size_t prev_num,
+                                 const double ratio, const int freq) {
+          return num >= (1 + ba_global_freq_factor * (ratio - 1)) * prev_num ||
+                 num >= ba_global_freq_factor * freq + prev_num;
+        };
+
+        if (IsGrown(reconstruction.NumRegImages(), ba_prev_num_reg_images,
+                    options_->ba_global_images_ratio,
+                    options_->ba_global_images_freq) ||
+            IsGrown(reconstruction.NumPoints3D(), ba_prev_num_points,
+                    options_->ba_global_points_ratio,
+                    options_->ba_global_points_freq)) {
+          IterativeGlobalRefinement(*options_, mapper);
+          ba_prev_num_points = reconstruction.NumPoints3D();
+          ba_prev_num_reg_images = reconstruction.NumRegImages();
+        }
+
+        if (options_->extract_colors) {
+          ExtractColors(image_path_, next_image_id, &reconstruction);
+        }
 
-          if (options_->snapshot_images_freq > 0 &&
-              reconstruction.NumRegImages() >=
-                  options_->snapshot_images_freq +
-                      snapshot_prev_num_reg_images) {
-            snapshot_prev_num_reg_images = reconstruction.NumRegImages();
+        if (!concurrent && options_->snapshot_images_freq > 0 &&
+            reconstruction.NumRegImages() >=
+                options_->snapshot_images_freq +
+                    snapshot_prev_num_reg_images) {
+          snapshot_prev_num_reg_images = reconstruction.NumRegImages();
+          if (snapshot_journal) {
+            snapshot_journal->Write(reconstruction);
+          } else {
             WriteSnapshot(reconstruction, options_->snapshot_path);
           }
+        }
 
+        if (checkpoint != nullptr &&
+            reconstruction.NumRegImages() >=
+                options_->checkpoint_images_freq +
+                    checkpoint_prev_num_reg_images) {
+          checkpoint_prev_num_reg_images = reconstruction.NumRegImages();
+          checkpoint->Write(*mapper);
+        }
+
+        if (!concurrent) {
           Callback(NEXT_IMAGE_REG_CALLBACK);
+        }
 
+        reg_any_success = true;
+        if (last_speculative_image) {
           break;
-        } else {
-          std::cout << "  => Could not register, trying another image."
-                    << std::endl;
-
-          // If initial pair fails to continue for some time,
-          // abort and try different initial pair.
-          const size_t kMinNumInitialRegTrials = 30;
-          if (reg_trial >= kMinNumInitialRegTrials &&
-              reconstruction.NumRegImages() <
-                  static_cast<size_t>(options_->min_model_size)) {
-            break;
-          }
         }
-      }
+      } else {
+        std::cout << "  => Could not register, trying another image."
+                  << std::endl;
 
-      const size_t max_model_overlap =
-          static_cast<size_t>(options_->max_model_overlap);
-      if (mapper.NumSharedRegImages() >= max_model_overlap) {
-        break;
-      }
+        // If initial pair fails to continue for some time,
+        // abort and try different initial pair.
+        const size_t kMinNumInitialRegTrials = 30;
+        if (reg_trial >= kMinNumInitialRegTrials &&
+            reconstruction.NumRegImages() <
+                static_cast<size_t>(options_->min_model_size)) {
+          break;
+        }
 
-      // If no image could be registered, try a single final global iterative
-      // bundle adjustment and try again to register one image. If this fails
-      // once, then exit the incremental mapping.
-      if (!reg_next_success && prev_reg_next_success) {
-        reg_next_success = true;
-        prev_reg_next_success = false;
-        IterativeGlobalRefinement(*options_, &mapper);
-      } else {
-        prev_reg_next_success = reg_next_success;
+        if (reg_any_success && last_speculative_image) {
+          break;
+        }
       }
     }
 
-    if (IsStopped()) {
-      const bool kDiscardReconstruction = false;
-      mapper.EndReconstruction(kDiscardReconstruction);
-      break;
-    }
+    reg_next_success = reg_any_success;
 
-    // Only run final global BA, if last incremental BA was not global.
-    if (reconstruction.NumRegImages() >= 2 &&
-        reconstruction.NumRegImages() != ba_prev_num_reg_images &&
-        reconstruction.NumPoints3D() != ba_prev_num_points) {
-      IterativeGlobalRefinement(*options_, &mapper);
+    const size_t max_model_overlap =
+        static_cast<size_t>(options_->max_model_overlap);
+    if (mapper->NumSharedRegImages() >= max_model_overlap) {
+      break;
     }
 
-    // If the total number of images is small then do not enforce the minimum
-    // model size so that we can reconstruct small image collections.
-    const size_t min_model_size =
-        std::min(database_cache_.NumImages(),
-                 static_cast<size_t>(options_->min_model_size));
-    if ((options_->multiple_models &&
-         reconstruction.NumRegImages() < min_model_size) ||
-        reconstruction.NumRegImages() == 0) {
-      mapper.EndReconstruction(kDiscardReconstruction);
-      reconstruction_manager_->Delete(reconstruction_idx);
+    // If no image could be registered, try a single final global iterative
+    // bundle adjustment and try again to register one image. If this fails
+    // once, then exit the incremental mapping.
+    if (!reg_next_success && prev_reg_next_success) {
+      reg_next_success = true;
+      prev_reg_next_success = false;
+      IterativeGlobalRefinement(*options_, mapper);
     } else {
-      const bool kDiscardReconstruction = false;
-      mapper.EndReconstruction(kDiscardReconstruction);
+      prev_reg_next_success = reg_next_success;
     }
+  }
 
-    Callback(LAST_IMAGE_REG_CALLBACK);
+  if (IsStopped()) {
+    const bool kDiscardReconstruction = false;
+    mapper->EndReconstruction(kDiscardReconstruction);
+    return ModelStatus::INTERRUPTED;
+  }
 
-    const size_t max_num_models = static_cast<size_t>(options_->max_num_models);
-    if (initial_reconstruction_given || !options_->multiple_models ||
-        reconstruction_manager_->Size() >= max_num_models ||
-        mapper.NumTotalRegImages() >= database_cache_.NumImages() - 1) {
-      break;
-    }
+  // Only run final global BA, if last incremental BA was not global or only
+  // adjusted a subset of the points.
+  if (reconstruction.NumRegImages() >= 2 &&
+      ((reconstruction.NumRegImages() != ba_prev_num_reg_images &&
+        reconstruction.NumPoints3D() != ba_prev_num_points) ||
+       options_->ba_global_max_num_points_per_image > 0)) {
+    IncrementalMapperOptions final_options = *options_;
+    final_options.ba_global_max_num_points_per_image = -1;
+    IterativeGlobalRefinement(final_options, mapper);
+  }
+
+  // If the total number of images is small then do not enforce the minimum
+  // model size so that we can reconstruct small image collections.
+  const size_t min_model_size =
+      std::min(database_cache_->NumImages(),
+               static_cast<size_t>(options_->min_model_size));
+  if ((options_->multiple_models &&
+       reconstruction.NumRegImages() < min_model_size) ||
+      reconstruction.NumRegImages() == 0) {
+    mapper->EndReconstruction(kDiscardReconstruction);
+    return ModelStatus::DISCARDED;
   }
+
+  mapper->EndReconstruction(!kDiscardReconstruction);
+  return ModelStatus::SUCCESS;
 }
 
+
 }  // namespace colmap
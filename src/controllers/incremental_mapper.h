@@ -57,6 +57,19 @@ struct IncrementalMapperOptions {
   // model, then the reconstruction is stopped.
   int max_model_overlap = 20;
 
+  // The number of sub-models to reconstruct concurrently, if multiple models
+  // are enabled and no initial image pair is given. The sub-models share the
+  // loaded database and claim their registered images, such that they respect
+  // the maximum model overlap. Each sub-model uses `num_threads` threads.
+  int num_parallel_models = 1;
+
+  // The number of next image candidates whose poses are estimated in parallel
+  // against the current model. The candidates are then registered one after
+  // another, if their poses are still consistent with the model after the
+  // previous registrations. This increases the registration throughput for
+  // large models, but the next images are ranked less often.
+  int num_speculative_images = 1;
+
   // The minimum number of registered images of a sub-model, otherwise the
   // sub-model is discarded.
   int min_model_size = 10;
@@ -90,24 +103,63 @@ struct IncrementalMapperOptions {
   // enable multi-threading solving of the problems.
   int ba_min_num_residuals_for_multi_threading = 50000;
 
+  // The standard deviation of the position priors of the images in bundle
+  // adjustment, in meters for GPS priors.
+  double ba_prior_position_std = 1.0;
+
   // The number of images to optimize in local bundle adjustment.
   int ba_local_num_images = 6;
 
   // The maximum number of local bundle adjustment iterations.
   int ba_local_max_num_iterations = 25;
 
+  // Whether to keep the local bundle adjustment problem between iterations and
+  // only update the residuals of changed observations.
+  bool ba_local_reuse_problem = false;
+
   // Whether to use PBA in global bundle adjustment.
   bool ba_global_use_pba = false;
 
   // The GPU index for PBA bundle adjustment.
   int ba_global_pba_gpu_index = -1;
 
+  // Automatically use PBA in global bundle adjustment if the reconstruction
+  // has at least this number of observations and is supported by PBA.
+  // Negative values disable the automatic selection.
+  int ba_global_pba_min_num_observations = -1;
+
+  // Partition global bundle adjustment into overlapping clusters of at most
+  // this number of images if the reconstruction has more registered images.
+  // Non-positive values disable the partitioning.
+  int ba_global_partition_max_num_images = -1;
+
+  // The number of overlapping images between the partitions.
+  int ba_global_partition_image_overlap = 50;
+
+  // Maximum number of 3D points per image in intermediate global bundle
+  // adjustments. The points are chosen to uniformly cover the images and the
+  // remaining points are refined afterwards with constant cameras. The final
+  // global bundle adjustment always uses all points. Non-positive values
+  // disable the subsampling.
+  int ba_global_max_num_points_per_image = -1;
+
+  // Whether to keep the global bundle adjustment problem, its elimination
+  // ordering, and the trust region radius between iterations and only update
+  // the residuals of changed observations.
+  bool ba_global_reuse_problem = false;
+
   // The growth rates after which to perform global bundle adjustment.
   double ba_global_images_ratio = 1.1;
   double ba_global_points_ratio = 1.1;
   int ba_global_images_freq = 500;
   int ba_global_points_freq = 250000;
 
+  // The factor by which the growth ratios minus one and the frequencies of
+  // global bundle adjustment are multiplied, once the reconstruction is
+  // aligned to the position priors of its images, since the priors then bound
+  // its drift, see `IncrementalMapper::Options::use_prior_position`.
+  double ba_global_prior_freq_factor = 10.0;
+
   // The maximum number of global bundle adjustment iterations.
   int ba_global_max_num_iterations = 50;
 
@@ -123,6 +175,25 @@ struct IncrementalMapperOptions {
   std::string snapshot_path = "";
   int snapshot_images_freq = 0;
 
+  // Whether to append the snapshots of each reconstruction to a journal file
+  // in the snapshot folder instead of writing each snapshot to a new folder.
+  // The journal only records the changes since the previous snapshot and is
+  // written in the background, and it can be converted to a model with the
+  // journal_compactor command.
+  bool snapshot_journal = false;
+
+  // Path to a folder in which the state of the mapper is checkpointed, such
+  // that an interrupted reconstruction can be resumed. The model in progress
+  // is checkpointed according to the specified frequency of registered images
+  // and the finished models when they are done. If checkpoints are written,
+  // the models are reconstructed one after another.
+  std::string checkpoint_path = "";
+  int checkpoint_images_freq = 100;
+
+  // Whether to resume the reconstruction from the last checkpoint in the
+  // checkpoint folder instead of starting from scratch, if it exists.
+  bool resume = false;
+
   // Which images to reconstruct. If no images are specified, all images will
   // be reconstructed by default.
   std::unordered_set<std::string> image_names;
@@ -135,6 +206,7 @@ struct IncrementalMapperOptions {
   BundleAdjustmentOptions LocalBundleAdjustment() const;
   BundleAdjustmentOptions GlobalBundleAdjustment() const;
   ParallelBundleAdjuster::Options ParallelGlobalBundleAdjustment() const;
+  PartitionedBundleAdjuster::Options PartitionedGlobalBundleAdjustment() const;
 
   bool Check() const;
 
@@ -151,6 +223,62 @@ struct IncrementalMapperOptions {
   IncrementalTriangulator::Options triangulation;
 };
 
+// Checkpoint of the incremental mapping procedure, from which an interrupted
+// reconstruction is resumed. The checkpoint folder contains the finished models
+// in numbered sub-folders, a journal of the model in progress, and the state
+// of the mapper. As for the snapshot journal, the model in progress and the
+// state are serialized in the calling thread and written in the background.
+class IncrementalMapperCheckpoint {
+ public:
+  struct State {
+    // Whether the mapper continues an existing reconstruction.
+    bool initial_reconstruction_given = false;
+    // Whether the mapper finished all reconstructions.
+    bool complete = false;
+    // The number of finished models.
+    size_t num_finished_models = 0;
+    // Whether a model was in progress.
+    bool has_current_model = false;
+    // The state of the mapper, which is only valid if not complete.
+    IncrementalMapper::State mapper;
+  };
+
+  IncrementalMapperCheckpoint(const std::string& path,
+                              const bool initial_reconstruction_given,
+                              const size_t num_finished_models);
+  ~IncrementalMapperCheckpoint();
+
+  // Checkpoint the model in progress of the mapper.
+  void Write(const IncrementalMapper& mapper);
+
+  // Checkpoint the mapper after its model is done. The reconstruction is
+  // written as a finished model, unless it is null and was discarded.
+  void WriteFinished(const IncrementalMapper& mapper,
+                     const Reconstruction* reconstruction);
+
+  // Checkpoint that the mapper finished all reconstructions.
+  void WriteComplete();
+
+  // Whether the folder contains a checkpoint.
+  static bool Exists(const std::string& path);
+
+  // Read the state of the checkpoint and append the finished models and the
+  // model in progress, if any, to the reconstruction manager.
+  static void Read(const std::string& path,
+                   ReconstructionManager* reconstruction_manager,
+                   State* state);
+
+ private:
+  void WriteState(const State& state);
+
+  const std::string path_;
+  const bool initial_reconstruction_given_;
+  size_t num_finished_models_;
+  bool journal_begun_;
+  Reconstruction::JournalState journal_state_;
+  ThreadPool thread_pool_;
+};
+
 // Class that controls the incremental mapping procedure by iteratively
 // initializing reconstructions from the same scene graph.
 class IncrementalMapperController : public Thread {
@@ -166,16 +294,56 @@ class IncrementalMapperController : public Thread {
                               const std::string& database_path,
                               ReconstructionManager* reconstruction_manager);
 
+  // Reconstruct the images from a subset of an already loaded database cache
+  // instead of loading the database. The cameras and images are shared with
+  // the given cache, which must outlive the controller.
+  IncrementalMapperController(const IncrementalMapperOptions* options,
+                              const std::string& image_path,
+                              const DatabaseCache* database_cache,
+                              ReconstructionManager* reconstruction_manager);
+
  private:
   void Run();
   bool LoadDatabase();
   void Reconstruct(const IncrementalMapper::Options& init_mapper_options);
+  void ReconstructConcurrently(
+      const IncrementalMapper::Options& init_mapper_options);
+
+  // The outcome of reconstructing a single model from an initial image pair.
+  enum class ModelStatus {
+    // The model was reconstructed and should be kept.
+    SUCCESS,
+    // The model was reconstructed but is too small.
+    DISCARDED,
+    // The initial image pair did not yield a model, try another one.
+    BAD_INITIAL_PAIR,
+    // No further initial image pair can be found or registered.
+    INITIALIZATION_FAILED,
+    // The reconstruction was stopped, the partial model should be kept.
+    INTERRUPTED,
+  };
+
+  // Reconstruct a single model with the given mapper. If the model is
+  // reconstructed concurrently with other models, the intermediate callbacks
+  // and snapshots are disabled. The model in progress is checkpointed, if a
+  // checkpoint is given.
+  ModelStatus ReconstructModel(
+      const IncrementalMapper::Options& init_mapper_options,
+      IncrementalMapper* mapper, Reconstruction* reconstruction,
+      const bool concurrent, IncrementalMapperCheckpoint* checkpoint);
 
   const IncrementalMapperOptions* options_;
   const std::string image_path_;
   const std::string database_path_;
   ReconstructionManager* reconstruction_manager_;
-  DatabaseCache database_cache_;
+  const DatabaseCache* shared_database_cache_;
+  // The cache loaded from the database or the subset of the shared cache.
+  std::unique_ptr<const DatabaseCache> database_cache_;
+
+  // The checkpoint of the mapping procedure and the checkpointed state from
+  // which it is resumed, if any.
+  std::unique_ptr<IncrementalMapperCheckpoint> checkpoint_;
+  std::unique_ptr<IncrementalMapperCheckpoint::State> resume_state_;
 };
 
 // Globally filter points and images in mapper.
@@ -188,6 +356,17 @@ size_t FilterImages(const IncrementalMapperOptions& options,
 size_t CompleteAndMergeTracks(const IncrementalMapperOptions& options,
                               IncrementalMapper* mapper);
 
+// Iteratively refine the local bundle of a newly registered image in mapper
+// until only few observations change.
+void IterativeLocalRefinement(const IncrementalMapperOptions& options,
+                              const image_t image_id,
+                              IncrementalMapper* mapper);
+
+// Retriangulate and iteratively refine the reconstruction of mapper in global
+// bundle adjustment until only few observations change.
+void IterativeGlobalRefinement(const IncrementalMapperOptions& options,
+                               IncrementalMapper* mapper);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_CONTROLLERS_INCREMENTAL_MAPPER_H_
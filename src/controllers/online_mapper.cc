@@ -0,0 +1,629 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "controllers/online_mapper.h"
+
+#include <boost/filesystem.hpp>
+
+#include "base/gps.h"
+#include "feature/extraction.h"
+#include "feature/utils.h"
+#include "util/misc.h"
+
+namespace colmap {
+
+bool OnlineMapperController::Options::Check() const {
+  CHECK_OPTION_GE(num_sequential_neighbors, 0);
+  CHECK_OPTION_GE(num_visual_neighbors, 0);
+  CHECK_OPTION_GE(num_spatial_neighbors, 0);
+  CHECK_OPTION_GT(max_spatial_distance, 0.0);
+  CHECK_OPTION_GE(max_num_retried_images, 0);
+  CHECK_OPTION_GT(poll_interval, 0.0);
+  return true;
+}
+
+OnlineMapperController::OnlineMapperController(
+    const Options& options, const ImageReaderOptions& reader_options,
+    const SiftExtractionOptions& extraction_options,
+    const SiftMatchingOptions& matching_options,
+    const IncrementalMapperOptions& mapper_options,
+    ReconstructionManager* reconstruction_manager)
+    : options_(options),
+      reader_options_(reader_options),
+      extraction_options_(extraction_options),
+      matching_options_(matching_options),
+      mapper_options_(mapper_options),
+      reconstruction_manager_(reconstruction_manager),
+      database_(reader_options.database_path),
+      reconstruction_idx_(0),
+      reconstruction_(nullptr),
+      initialized_(false),
+      num_indexed_images_(0) {
+  CHECK(options_.Check());
+  CHECK(reader_options_.Check());
+  CHECK(extraction_options_.Check());
+  CHECK(matching_options_.Check());
+  CHECK(mapper_options_.Check());
+
+  // Decode the images directly at the resolution at which the features are
+  // extracted, if the image format supports it.
+  reader_options_.max_image_size = extraction_options_.max_image_size;
+  reader_options_.image_path =
+      EnsureTrailingSlash(StringReplace(reader_options_.image_path, "\\", "/"));
+
+  two_view_geometry_options_.min_num_inliers =
+      static_cast<size_t>(matching_options_.min_num_inliers);
+  two_view_geometry_options_.ransac_options.max_error =
+      matching_options_.max_error;
+  two_view_geometry_options_.ransac_options.confidence =
+      matching_options_.confidence;
+  two_view_geometry_options_.ransac_options.min_num_trials =
+      static_cast<size_t>(matching_options_.min_num_trials);
+  two_view_geometry_options_.ransac_options.max_num_trials =
+      static_cast<size_t>(matching_options_.max_num_trials);
+  two_view_geometry_options_.ransac_options.min_inlier_ratio =
+      matching_options_.min_inlier_ratio;
+  two_view_geometry_options_.early_exit =
+      matching_options_.early_exit_verification;
+  two_view_geometry_options_.progressive_sampling =
+      matching_options_.progressive_sampling;
+
+  RegisterCallback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
+  RegisterCallback(NEXT_IMAGE_REG_CALLBACK);
+  RegisterCallback(LAST_IMAGE_REG_CALLBACK);
+}
+
+void OnlineMapperController::Run() {
+  if (!options_.vocab_tree_path.empty() && options_.num_visual_neighbors > 0) {
+    PrintHeading1("Loading vocabulary tree");
+    visual_index_.Read(options_.vocab_tree_path);
+  }
+
+  if (!reader_options_.camera_mask_path.empty()) {
+    camera_mask_.reset(new Bitmap());
+    if (!camera_mask_->Read(reader_options_.camera_mask_path,
+                            /*as_rgb*/ false)) {
+      std::cerr << "  ERROR: Cannot read camera mask file: "
+                << reader_options_.camera_mask_path
+                << ". No mask is going to be used." << std::endl;
+      camera_mask_.reset();
+    }
+  }
+
+  reconstruction_idx_ = reconstruction_manager_->Add();
+  reconstruction_ = &reconstruction_manager_->Get(reconstruction_idx_);
+  mapper_.reset(new IncrementalMapper(&database_cache_));
+
+  Timer idle_timer;
+  idle_timer.Start();
+
+  while (true) {
+    BlockIfPaused();
+    if (IsStopped()) {
+      break;
+    }
+
+    const std::vector<std::string> image_names = FindNewImages();
+
+    if (image_names.empty()) {
+      if (options_.max_idle_time > 0 &&
+          idle_timer.ElapsedSeconds() > options_.max_idle_time) {
+        std::cout << "No new images arrived, stopping." << std::endl;
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(
+          static_cast<int>(1000 * options_.poll_interval)));
+      continue;
+    }
+
+    if (image_reader_) {
+      for (const auto& image_name : image_names) {
+        image_reader_->AddImage(image_name);
+      }
+    } else {
+      reader_options_.image_list = image_names;
+      image_reader_.reset(new ImageReader(reader_options_, &database_));
+    }
+
+    while (image_reader_->NextIndex() < image_reader_->NumImages()) {
+      BlockIfPaused();
+      if (IsStopped()) {
+        break;
+      }
+
+      Timer timer;
+      timer.Start();
+
+      image_t image_id;
+      if (ReadImage(&image_id)) {
+        MatchImage(image_id);
+        RegisterImage(image_id);
+      }
+
+      std::cout << StringPrintf("  => Latency: %.3fs", timer.ElapsedSeconds())
+                << std::endl;
+    }
+
+    idle_timer.Restart();
+  }
+
+  if (initialized_) {
+    RefineReconstruction();
+    const bool kDiscardReconstruction = false;
+    mapper_->EndReconstruction(kDiscardReconstruction);
+    Callback(LAST_IMAGE_REG_CALLBACK);
+  } else {
+    std::cout << "WARNING: Could not initialize the reconstruction."
+              << std::endl;
+    reconstruction_manager_->Delete(reconstruction_idx_);
+    reconstruction_ = nullptr;
+  }
+
+  GetTimer().PrintMinutes();
+}
+
+std::vector<std::string> OnlineMapperController::FindNewImages() {
+  std::vector<std::string> image_names;
+  std::unordered_map<std::string, size_t> pending_image_sizes;
+
+  for (const auto& image_path :
+       GetRecursiveFileList(reader_options_.image_path)) {
+    if (image_paths_.count(image_path) > 0) {
+      continue;
+    }
+
+    const size_t file_size =
+        static_cast<size_t>(boost::filesystem::file_size(image_path));
+    const auto pending_it = pending_image_sizes_.find(image_path);
+    if (pending_it != pending_image_sizes_.end() &&
+        pending_it->second == file_size) {
+      image_paths_.insert(image_path);
+      image_names.push_back(
+          GetRelativePath(reader_options_.image_path, image_path));
+    } else {
+      pending_image_sizes.emplace(image_path, file_size);
+    }
+  }
+
+  pending_image_sizes_.swap(pending_image_sizes);
+
+  std::sort(image_names.begin(), image_names.end());
+
+  return image_names;
+}
+
+bool OnlineMapperController::ReadImage(image_t* image_id) {
+  Camera camera;
+  Image image;
+  Bitmap bitmap;
+  Bitmap mask;
+  const ImageReader::Status status =
+      image_reader_->Next(&camera, &image, &bitmap, &mask);
+
+  PrintHeading1(StringPrintf("Processing image %s", image.Name().c_str()));
+
+  FeatureKeypoints keypoints;
+
+  if (status == ImageReader::Status::IMAGE_EXISTS) {
+    camera = database_.ReadCamera(image.CameraId());
+    keypoints = database_.ReadKeypoints(image.ImageId());
+  } else if (status == ImageReader::Status::SUCCESS) {
+    const int max_image_size = extraction_options_.max_image_size;
+    if (static_cast<int>(bitmap.Width()) > max_image_size ||
+        static_cast<int>(bitmap.Height()) > max_image_size) {
+      // Fit the down-sampled version exactly into the max dimensions.
+      const double scale = static_cast<double>(max_image_size) /
+                           std::max(bitmap.Width(), bitmap.Height());
+      bitmap.Rescale(static_cast<int>(bitmap.Width() * scale),
+                     static_cast<int>(bitmap.Height() * scale));
+    }
+
+    FeatureDescriptors descriptors;
+    bool success = false;
+    if (extraction_options_.estimate_affine_shape ||
+        extraction_options_.domain_size_pooling) {
+      success = ExtractCovariantSiftFeaturesCPU(extraction_options_, bitmap,
+                                                &keypoints, &descriptors);
+    } else {
+      success = ExtractSiftFeaturesCPU(extraction_options_, bitmap, &keypoints,
+                                       &descriptors);
+    }
+
+    if (!success) {
+      std::cout << "  => Could not extract features." << std::endl;
+      return false;
+    }
+
+    internal::ScaleKeypoints(bitmap, camera, &keypoints);
+    if (camera_mask_) {
+      internal::MaskKeypoints(*camera_mask_, &keypoints, &descriptors);
+    }
+    if (mask.Data()) {
+      internal::MaskKeypoints(mask, &keypoints, &descriptors);
+    }
+
+    DatabaseTransaction database_transaction(&database_);
+    if (image.ImageId() == kInvalidImageId) {
+      image.SetImageId(database_.WriteImage(image));
+    }
+    if (!database_.ExistsKeypoints(image.ImageId())) {
+      database_.WriteKeypoints(image.ImageId(), keypoints);
+    }
+    if (!database_.ExistsDescriptors(image.ImageId())) {
+      database_.WriteDescriptors(image.ImageId(), descriptors);
+    }
+  } else {
+    std::cout << "  => Could not read image." << std::endl;
+    return false;
+  }
+
+  std::cout << "  => Features: " << keypoints.size() << std::endl;
+
+  if (database_cache_.ExistsImage(image.ImageId())) {
+    std::cout << "  => Image was already processed." << std::endl;
+    return false;
+  }
+
+  if (!database_cache_.ExistsCamera(camera.CameraId())) {
+    database_cache_.AddCamera(camera);
+  }
+
+  image.SetPoints2D(FeatureKeypointsToPointsVector(keypoints));
+  database_cache_.AddImage(image);
+
+  *image_id = image.ImageId();
+
+  return true;
+}
+
+void OnlineMapperController::MatchImage(const image_t image_id) {
+  const FeatureKeypoints keypoints = database_.ReadKeypoints(image_id);
+  const FeatureDescriptors descriptors = database_.ReadDescriptors(image_id);
+
+  const std::vector<image_t> neighbor_ids =
+      FindNeighbors(image_id, keypoints, descriptors);
+  image_ids_.push_back(image_id);
+
+  struct NeighborMatch {
+    image_t image_id = kInvalidImageId;
+    bool exists = false;
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    FeatureMatches matches;
+    TwoViewGeometry two_view_geometry;
+  };
+
+  // The features are read sequentially, since the database must not be
+  // accessed concurrently, and the neighbors are then matched in parallel.
+  std::vector<NeighborMatch> neighbor_matches(neighbor_ids.size());
+  for (size_t i = 0; i < neighbor_ids.size(); ++i) {
+    NeighborMatch& neighbor_match = neighbor_matches[i];
+    neighbor_match.image_id = neighbor_ids[i];
+    if (database_.ExistsInlierMatches(image_id, neighbor_ids[i])) {
+      neighbor_match.exists = true;
+      neighbor_match.two_view_geometry =
+          database_.ReadTwoViewGeometry(image_id, neighbor_ids[i]);
+    } else {
+      neighbor_match.keypoints = database_.ReadKeypoints(neighbor_ids[i]);
+      neighbor_match.descriptors = database_.ReadDescriptors(neighbor_ids[i]);
+    }
+  }
+
+  const Camera& camera =
+      database_cache_.Camera(database_cache_.Image(image_id).CameraId());
+  const std::vector<Eigen::Vector2d> points =
+      FeatureKeypointsToPointsVector(keypoints);
+
+  auto MatchNeighbor = [&](NeighborMatch* neighbor_match) {
+    MatchSiftFeaturesCPU(matching_options_, descriptors,
+                         neighbor_match->descriptors, &neighbor_match->matches);
+    if (neighbor_match->matches.size() <
+        static_cast<size_t>(matching_options_.min_num_inliers)) {
+      return;
+    }
+
+    const Camera& neighbor_camera = database_cache_.Camera(
+        database_cache_.Image(neighbor_match->image_id).CameraId());
+    neighbor_match->two_view_geometry.Estimate(
+        camera, points, neighbor_camera,
+        FeatureKeypointsToPointsVector(neighbor_match->keypoints),
+        neighbor_match->matches, two_view_geometry_options_);
+
+    if (matching_options_.guided_matching &&
+        neighbor_match->two_view_geometry.inlier_matches.size() >=
+            static_cast<size_t>(matching_options_.min_num_inliers)) {
+      MatchGuidedSiftFeaturesCPU(matching_options_, keypoints,
+                                 neighbor_match->keypoints, descriptors,
+                                 neighbor_match->descriptors,
+                                 &neighbor_match->two_view_geometry);
+    }
+  };
+
+  {
+    ThreadPool thread_pool(GetEffectiveNumThreads(options_.num_threads));
+    std::vector<std::future<void>> futures;
+    futures.reserve(neighbor_matches.size());
+    for (auto& neighbor_match : neighbor_matches) {
+      if (!neighbor_match.exists) {
+        futures.push_back(thread_pool.AddTask(MatchNeighbor, &neighbor_match));
+      }
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+
+  DatabaseTransaction database_transaction(&database_);
+
+  size_t num_verified_neighbors = 0;
+  for (const auto& neighbor_match : neighbor_matches) {
+    const TwoViewGeometry& two_view_geometry = neighbor_match.two_view_geometry;
+
+    if (!neighbor_match.exists) {
+      if (!database_.ExistsMatches(image_id, neighbor_match.image_id)) {
+        database_.WriteMatches(image_id, neighbor_match.image_id,
+                               neighbor_match.matches);
+      }
+      database_.WriteTwoViewGeometry(image_id, neighbor_match.image_id,
+                                     two_view_geometry);
+    }
+
+    // Only use image pairs as in `DatabaseCache::Load`.
+    if (two_view_geometry.inlier_matches.size() <
+            static_cast<size_t>(mapper_options_.min_num_matches) ||
+        (mapper_options_.ignore_watermarks &&
+         two_view_geometry.config ==
+             TwoViewGeometry::ConfigurationType::WATERMARK)) {
+      continue;
+    }
+
+    database_cache_.AddCorrespondences(image_id, neighbor_match.image_id,
+                                       two_view_geometry.inlier_matches);
+    num_verified_neighbors += 1;
+  }
+
+  std::cout << StringPrintf("  => Verified neighbors: %d / %d",
+                            num_verified_neighbors, neighbor_ids.size())
+            << std::endl;
+}
+
+std::vector<image_t> OnlineMapperController::FindNeighbors(
+    const image_t image_id, const FeatureKeypoints& keypoints,
+    const FeatureDescriptors& descriptors) {
+  std::vector<image_t> neighbor_ids;
+  std::unordered_set<image_t> neighbor_ids_set;
+  auto AddNeighbor = [&](const image_t neighbor_id) {
+    if (neighbor_id != image_id && database_cache_.ExistsImage(neighbor_id) &&
+        neighbor_ids_set.insert(neighbor_id).second) {
+      neighbor_ids.push_back(neighbor_id);
+    }
+  };
+
+  // Sequential neighbors.
+  const size_t num_sequential_neighbors = std::min(
+      image_ids_.size(), static_cast<size_t>(options_.num_sequential_neighbors));
+  for (size_t i = image_ids_.size() - num_sequential_neighbors;
+       i < image_ids_.size(); ++i) {
+    AddNeighbor(image_ids_[i]);
+  }
+
+  // Spatial neighbors.
+  const Image& image = database_cache_.Image(image_id);
+  if (options_.num_spatial_neighbors > 0 && image.HasTvecPrior()) {
+    Eigen::Vector3d location = image.TvecPrior();
+    if (options_.spatial_is_gps) {
+      GPSTransform gps_transform(GPSTransform::WGS84);
+      location = gps_transform.EllToXYZ({location})[0];
+    }
+
+    std::vector<std::pair<double, image_t>> distances;
+    for (const auto& image_location : image_locations_) {
+      const double distance = (image_location.second - location).norm();
+      if (distance <= options_.max_spatial_distance) {
+        distances.emplace_back(distance, image_location.first);
+      }
+    }
+
+    const size_t num_spatial_neighbors = std::min(
+        distances.size(), static_cast<size_t>(options_.num_spatial_neighbors));
+    std::partial_sort(distances.begin(),
+                      distances.begin() + num_spatial_neighbors,
+                      distances.end());
+    for (size_t i = 0; i < num_spatial_neighbors; ++i) {
+      AddNeighbor(distances[i].second);
+    }
+
+    image_locations_.emplace(image_id, location);
+  }
+
+  // Visual neighbors. The index must be prepared again after adding an image,
+  // so that the image can be retrieved for the following images.
+  if (!options_.vocab_tree_path.empty() && options_.num_visual_neighbors > 0) {
+    if (num_indexed_images_ > 0) {
+      retrieval::VisualIndex<>::QueryOptions query_options;
+      query_options.max_num_images = options_.num_visual_neighbors;
+      query_options.num_threads = options_.num_threads;
+      std::vector<retrieval::ImageScore> image_scores;
+      visual_index_.Query(query_options, keypoints, descriptors,
+                          &image_scores);
+      for (const auto& image_score : image_scores) {
+        AddNeighbor(static_cast<image_t>(image_score.image_id));
+      }
+    }
+
+    retrieval::VisualIndex<>::IndexOptions index_options;
+    index_options.num_threads = options_.num_threads;
+    visual_index_.Add(index_options, image_id, keypoints, descriptors);
+    visual_index_.Prepare();
+    num_indexed_images_ += 1;
+  }
+
+  return neighbor_ids;
+}
+
+void OnlineMapperController::RegisterImage(const image_t image_id) {
+  if (initialized_) {
+    const Image& image = database_cache_.Image(image_id);
+    if (!reconstruction_->ExistsCamera(image.CameraId())) {
+      reconstruction_->AddCamera(database_cache_.Camera(image.CameraId()));
+    }
+    reconstruction_->AddImageAfterSetUp(image);
+  } else {
+    // The images that arrived before are loaded when initializing.
+    initialized_ = InitializeReconstruction();
+    if (!initialized_) {
+      return;
+    }
+    Callback(INITIAL_IMAGE_PAIR_REG_CALLBACK);
+  }
+
+  bool reg_any_success = false;
+  if (!reconstruction_->IsImageRegistered(image_id)) {
+    reg_any_success = RegisterNextImage(image_id);
+  }
+
+  // Retry a bounded number of the previously failed images, which might now
+  // be registered due to the new image.
+  int num_retried_images = 0;
+  for (const image_t next_image_id :
+       mapper_->FindNextImages(mapper_options_.Mapper())) {
+    if (num_retried_images >= options_.max_num_retried_images) {
+      break;
+    }
+    if (next_image_id == image_id) {
+      continue;
+    }
+    num_retried_images += 1;
+    reg_any_success |= RegisterNextImage(next_image_id);
+  }
+
+  if (reg_any_success) {
+    Callback(NEXT_IMAGE_REG_CALLBACK);
+  }
+}
+
+bool OnlineMapperController::InitializeReconstruction() {
+  const bool kDiscardReconstruction = true;
+
+  const IncrementalMapper::Options init_mapper_options =
+      mapper_options_.Mapper();
+
+  mapper_->BeginReconstruction(reconstruction_);
+
+  PrintHeading1("Finding good initial image pair");
+  image_t image_id1 = kInvalidImageId;
+  image_t image_id2 = kInvalidImageId;
+  if (!mapper_->FindInitialImagePair(init_mapper_options, &image_id1,
+                                     &image_id2)) {
+    std::cout << "  => No good initial image pair found." << std::endl;
+    mapper_->EndReconstruction(kDiscardReconstruction);
+    return false;
+  }
+
+  PrintHeading1(StringPrintf("Initializing with image pair #%d and #%d",
+                             image_id1, image_id2));
+  bool success = mapper_->RegisterInitialImagePair(init_mapper_options,
+                                                   image_id1, image_id2);
+  if (success) {
+    mapper_->AdjustGlobalBundle(init_mapper_options,
+                                mapper_options_.GlobalBundleAdjustment());
+    FilterPoints(mapper_options_, mapper_.get());
+    FilterImages(mapper_options_, mapper_.get());
+    success = reconstruction_->NumRegImages() > 0 &&
+              reconstruction_->NumPoints3D() > 0;
+  }
+
+  if (!success) {
+    std::cout << "  => Initialization failed, waiting for more images."
+              << std::endl;
+    mapper_->EndReconstruction(kDiscardReconstruction);
+    // The initial pair might have left behind 3D points, so the next trial
+    // starts with a new reconstruction.
+    reconstruction_manager_->Delete(reconstruction_idx_);
+    reconstruction_idx_ = reconstruction_manager_->Add();
+    reconstruction_ = &reconstruction_manager_->Get(reconstruction_idx_);
+    return false;
+  }
+
+  if (mapper_options_.extract_colors) {
+    for (const image_t image_id : {image_id1, image_id2}) {
+      reconstruction_->ExtractColorsForImage(image_id,
+                                             reader_options_.image_path);
+    }
+  }
+
+  return true;
+}
+
+bool OnlineMapperController::RegisterNextImage(const image_t image_id) {
+  PrintHeading1(StringPrintf("Registering image #%d (%d)", image_id,
+                             reconstruction_->NumRegImages() + 1));
+
+  if (!mapper_->RegisterNextImage(mapper_options_.Mapper(), image_id)) {
+    std::cout << "  => Could not register image." << std::endl;
+    return false;
+  }
+
+  const size_t num_tris =
+      mapper_->TriangulateImage(mapper_options_.Triangulation(), image_id);
+  std::cout << "  => Added observations: " << num_tris << std::endl;
+
+  // The local bundle adjustment only covers a fixed number of images, so that
+  // its cost does not grow with the size of the reconstruction.
+  IterativeLocalRefinement(mapper_options_, image_id, mapper_.get());
+
+  if (mapper_options_.extract_colors) {
+    reconstruction_->ExtractColorsForImage(image_id,
+                                           reader_options_.image_path);
+  }
+
+  return true;
+}
+
+void OnlineMapperController::RefineReconstruction() {
+  // Register all remaining images, which is no longer bounded by the arrival
+  // of new images.
+  bool reg_next_success = true;
+  while (reg_next_success && !IsStopped()) {
+    reg_next_success = false;
+    for (const image_t image_id :
+         mapper_->FindNextImages(mapper_options_.Mapper())) {
+      if (RegisterNextImage(image_id)) {
+        reg_next_success = true;
+        break;
+      }
+    }
+  }
+
+  IterativeGlobalRefinement(mapper_options_, mapper_.get());
+}
+
+}  // namespace colmap
@@ -0,0 +1,172 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_CONTROLLERS_ONLINE_MAPPER_H_
+#define COLMAP_SRC_CONTROLLERS_ONLINE_MAPPER_H_
+
+#include <unordered_map>
+
+#include "base/database.h"
+#include "base/database_cache.h"
+#include "base/image_reader.h"
+#include "base/reconstruction_manager.h"
+#include "controllers/incremental_mapper.h"
+#include "feature/sift.h"
+#include "retrieval/visual_index.h"
+#include "util/threading.h"
+
+namespace colmap {
+
+// Online mapping reconstructs the scene while its images are still arriving,
+// e.g., from a camera that continuously writes new images to the image path.
+// Each new image is processed to completion before the next one: its features
+// are extracted, it is matched against its sequential, spatial, and visual
+// neighbors among the previous images, and it is registered in the
+// reconstruction followed by local bundle adjustment. The cost per image is
+// bounded by the number of matched neighbors, the local bundle adjustment
+// window, and the number of previously failed images that are retried, and
+// does not grow with the size of the reconstruction. Only a single model is
+// reconstructed, which is refined in global bundle adjustment at the end.
+class OnlineMapperController : public Thread {
+ public:
+  enum {
+    INITIAL_IMAGE_PAIR_REG_CALLBACK,
+    NEXT_IMAGE_REG_CALLBACK,
+    LAST_IMAGE_REG_CALLBACK,
+  };
+
+  struct Options {
+    // The number of previously arrived images to match against each new
+    // image, assuming the images arrive in sequential order.
+    int num_sequential_neighbors = 5;
+
+    // The number of nearest images retrieved from the visual index to match
+    // against each new image. Only used if a vocabulary tree is given.
+    int num_visual_neighbors = 10;
+
+    // Path to the vocabulary tree used to retrieve the visual neighbors.
+    std::string vocab_tree_path = "";
+
+    // The number of spatially nearest images within the maximum distance to
+    // match against each new image, based on their location priors.
+    int num_spatial_neighbors = 10;
+    double max_spatial_distance = 100.0;
+
+    // Whether the location priors are GPS coordinates in the form of latitude
+    // and longitude, which are converted to Cartesian coordinates.
+    bool spatial_is_gps = true;
+
+    // The maximum number of previously failed images that are retried to be
+    // registered after each new image.
+    int max_num_retried_images = 5;
+
+    // The interval in seconds in which the image path is checked for new
+    // images. An image is only read once its file size did not change between
+    // two successive checks, so that partially written files are skipped.
+    double poll_interval = 1.0;
+
+    // Stop once no new image arrived for this number of seconds. The mapper
+    // runs until it is stopped explicitly, if this is not positive.
+    double max_idle_time = 60.0;
+
+    // The number of threads used to match each new image to its neighbors.
+    int num_threads = -1;
+
+    bool Check() const;
+  };
+
+  OnlineMapperController(const Options& options,
+                         const ImageReaderOptions& reader_options,
+                         const SiftExtractionOptions& extraction_options,
+                         const SiftMatchingOptions& matching_options,
+                         const IncrementalMapperOptions& mapper_options,
+                         ReconstructionManager* reconstruction_manager);
+
+ private:
+  void Run();
+
+  // Find the images in the image path that are new and completely written.
+  std::vector<std::string> FindNewImages();
+
+  // Read the next image and extract its features. The image and its features
+  // are written to the database and the image is added to the cache.
+  bool ReadImage(image_t* image_id);
+
+  // Match the image against its neighbors and add the verified matches to the
+  // database and the correspondence graph.
+  void MatchImage(const image_t image_id);
+  std::vector<image_t> FindNeighbors(const image_t image_id,
+                                     const FeatureKeypoints& keypoints,
+                                     const FeatureDescriptors& descriptors);
+
+  // Register the image in the reconstruction and retry the registration of
+  // previously failed images. Tries to initialize the reconstruction if it
+  // was not initialized before.
+  void RegisterImage(const image_t image_id);
+  bool InitializeReconstruction();
+  bool RegisterNextImage(const image_t image_id);
+
+  // Refine the reconstruction after all images arrived.
+  void RefineReconstruction();
+
+  const Options options_;
+  ImageReaderOptions reader_options_;
+  const SiftExtractionOptions extraction_options_;
+  const SiftMatchingOptions matching_options_;
+  const IncrementalMapperOptions mapper_options_;
+  TwoViewGeometry::Options two_view_geometry_options_;
+  ReconstructionManager* reconstruction_manager_;
+
+  Database database_;
+  DatabaseCache database_cache_;
+  std::unique_ptr<ImageReader> image_reader_;
+  std::unique_ptr<Bitmap> camera_mask_;
+  std::unique_ptr<IncrementalMapper> mapper_;
+  size_t reconstruction_idx_;
+  Reconstruction* reconstruction_;
+  bool initialized_;
+
+  retrieval::VisualIndex<> visual_index_;
+  size_t num_indexed_images_;
+
+  // The images in the order of their arrival and their location priors.
+  std::vector<image_t> image_ids_;
+  std::unordered_map<image_t, Eigen::Vector3d> image_locations_;
+
+  // The files in the image path that were already read and the sizes of the
+  // files that were not yet completely written at the previous check.
+  std::unordered_set<std::string> image_paths_;
+  std::unordered_map<std::string, size_t> pending_image_sizes_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_CONTROLLERS_ONLINE_MAPPER_H_
@@ -46,6 +46,14 @@ Eigen::Vector3d LiftImagePoint(const Eigen::Vector2d& point) {
 
 std::vector<P3PEstimator::M_t> P3PEstimator::Estimate(
     const std::vector<X_t>& points2D, const std::vector<Y_t>& points3D) {
+  std::vector<M_t> models;
+  Estimate(points2D, points3D, &models);
+  return models;
+}
+
+void P3PEstimator::Estimate(const std::vector<X_t>& points2D,
+                            const std::vector<Y_t>& points3D,
+                            std::vector<M_t>* models) {
   CHECK_EQ(points2D.size(), 3);
   CHECK_EQ(points3D.size(), 3);
 
@@ -98,22 +106,29 @@ std::vector<P3PEstimator::M_t> P3PEstimator::Estimate(
               (p * r + q * p2 - 2 * q) * b + (r * p + 2 * q) * a * b - 2 * q;
   coeffs(4) = a2 + b2 - 2 * a + (2 - p2) * b - 2 * a * b + 1;
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
-  if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return std::vector<P3PEstimator::M_t>({});
-  }
-
-  std::vector<M_t> models;
-  models.reserve(roots_real.size());
-
-  for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
-    const double kMaxRootImag = 1e-10;
-    if (std::abs(roots_imag(i)) > kMaxRootImag) {
-      continue;
+  models->clear();
+
+  // Solve the quartic in closed form and only fall back to the more expensive
+  // companion matrix method in the degenerate case of a lower degree.
+  double roots[4];
+  int num_roots = 0;
+  if (!FindQuarticPolynomialRealRoots(coeffs, roots, &num_roots)) {
+    Eigen::VectorXd roots_real;
+    Eigen::VectorXd roots_imag;
+    if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real,
+                                            &roots_imag)) {
+      return;
+    }
+    for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
+      const double kMaxRootImag = 1e-10;
+      if (std::abs(roots_imag(i)) <= kMaxRootImag) {
+        roots[num_roots++] = roots_real(i);
+      }
     }
+  }
 
-    const double x = roots_real(i);
+  for (int i = 0; i < num_roots; ++i) {
+    const double x = roots[i];
     if (x < 0) {
       continue;
     }
@@ -167,10 +182,8 @@ std::vector<P3PEstimator::M_t> P3PEstimator::Estimate(
     // Find transformation from the world to the camera system.
     const Eigen::Matrix4d transform =
         Eigen::umeyama(points3D_world, points3D_camera, false);
-    models.push_back(transform.topLeftCorner<3, 4>());
+    models->push_back(transform.topLeftCorner<3, 4>());
   }
-
-  return models;
 }
 
 void P3PEstimator::Residuals(const std::vector<X_t>& points2D,
@@ -182,16 +195,24 @@ void P3PEstimator::Residuals(const std::vector<X_t>& points2D,
 
 std::vector<EPNPEstimator::M_t> EPNPEstimator::Estimate(
     const std::vector<X_t>& points2D, const std::vector<Y_t>& points3D) {
+  std::vector<M_t> models;
+  Estimate(points2D, points3D, &models);
+  return models;
+}
+
+void EPNPEstimator::Estimate(const std::vector<X_t>& points2D,
+                             const std::vector<Y_t>& points3D,
+                             std::vector<M_t>* models) {
   CHECK_GE(points2D.size(), 4);
   CHECK_EQ(points2D.size(), points3D.size());
 
+  models->clear();
+
   EPNPEstimator epnp;
   M_t proj_matrix;
-  if (!epnp.ComputePose(points2D, points3D, &proj_matrix)) {
-    return std::vector<EPNPEstimator::M_t>({});
+  if (epnp.ComputePose(points2D, points3D, &proj_matrix)) {
+    models->push_back(proj_matrix);
   }
-
-  return std::vector<EPNPEstimator::M_t>({proj_matrix});
 }
 
 void EPNPEstimator::Residuals(const std::vector<X_t>& points2D,
@@ -71,6 +71,12 @@ class P3PEstimator {
   static std::vector<M_t> Estimate(const std::vector<X_t>& points2D,
                                    const std::vector<Y_t>& points3D);
 
+  // Same as above but writes the poses to the given vector, whose memory is
+  // reused, such that RANSAC does not allocate memory for every sample.
+  static void Estimate(const std::vector<X_t>& points2D,
+                       const std::vector<Y_t>& points3D,
+                       std::vector<M_t>* models);
+
   // Calculate the squared reprojection error given a set of 2D-3D point
   // correspondences and a projection matrix.
   //
@@ -116,6 +122,12 @@ class EPNPEstimator {
   static std::vector<M_t> Estimate(const std::vector<X_t>& points2D,
                                    const std::vector<Y_t>& points3D);
 
+  // Same as above but writes the pose to the given vector, whose memory is
+  // reused, such that RANSAC does not allocate memory for every sample.
+  static void Estimate(const std::vector<X_t>& points2D,
+                       const std::vector<Y_t>& points3D,
+                       std::vector<M_t>* models);
+
   // Calculate the squared reprojection error given a set of 2D-3D point
   // correspondences and a projection matrix.
   //
@@ -38,6 +38,7 @@
 #include "optim/ransac.h"
 #include "util/logging.h"
 #include "util/misc.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace {
@@ -139,6 +140,116 @@ Eigen::Vector3d FindBestConsensusAxis(const std::vector<Eigen::Vector3d>& axes,
   return best_axis;
 }
 
+// The axes of the vanishing points in a single image.
+struct VanishingPointAxes {
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  size_t num_lines = 0;
+  size_t num_horizontal_lines = 0;
+  size_t num_vertical_lines = 0;
+  size_t num_horizontal_inliers = 0;
+  size_t num_vertical_inliers = 0;
+
+  // The horizontal axis in the world frame, whose sign is ambiguous.
+  bool has_horizontal_axis = false;
+  Eigen::Vector3d horizontal_axis = Eigen::Vector3d::Zero();
+
+  // The vertical axis in the world frame, pointing downwards in the image.
+  bool has_vertical_axis = false;
+  Eigen::Vector3d vertical_axis = Eigen::Vector3d::Zero();
+};
+
+VanishingPointAxes EstimateVanishingPointAxes(
+    const ManhattanWorldFrameEstimationOptions& options,
+    const Reconstruction& reconstruction, const std::string& image_path,
+    const image_t image_id) {
+  const auto& image = reconstruction.Image(image_id);
+  const auto& camera = reconstruction.Camera(image.CameraId());
+
+  colmap::Bitmap bitmap;
+  CHECK(bitmap.Read(colmap::JoinPaths(image_path, image.Name())));
+
+  // The image is downscaled to the maximum image size during undistortion.
+  UndistortCameraOptions undistortion_options;
+  undistortion_options.max_image_size = options.max_image_size;
+
+  Bitmap undistorted_bitmap;
+  Camera undistorted_camera;
+  UndistortImage(undistortion_options, bitmap, camera, &undistorted_bitmap,
+                 &undistorted_camera);
+
+  // Release the original image before the line detection.
+  bitmap.Deallocate();
+
+  const std::vector<LineSegment> line_segments =
+      DetectLineSegments(undistorted_bitmap, options.min_line_length);
+  const std::vector<LineSegmentOrientation> line_orientations =
+      ClassifyLineSegmentOrientations(line_segments,
+                                      options.line_orientation_tolerance);
+
+  std::vector<LineSegment> horizontal_line_segments;
+  std::vector<LineSegment> vertical_line_segments;
+  std::vector<Eigen::Vector3d> horizontal_lines;
+  std::vector<Eigen::Vector3d> vertical_lines;
+  for (size_t i = 0; i < line_segments.size(); ++i) {
+    const auto line_segment = line_segments[i];
+    const Eigen::Vector3d line_segment_start =
+        line_segment.start.homogeneous();
+    const Eigen::Vector3d line_segment_end = line_segment.end.homogeneous();
+    const Eigen::Vector3d line = line_segment_start.cross(line_segment_end);
+    if (line_orientations[i] == LineSegmentOrientation::HORIZONTAL) {
+      horizontal_line_segments.push_back(line_segment);
+      horizontal_lines.push_back(line);
+    } else if (line_orientations[i] == LineSegmentOrientation::VERTICAL) {
+      vertical_line_segments.push_back(line_segment);
+      vertical_lines.push_back(line);
+    }
+  }
+
+  VanishingPointAxes axes;
+  axes.num_lines = line_segments.size();
+  axes.num_horizontal_lines = horizontal_lines.size();
+  axes.num_vertical_lines = vertical_lines.size();
+
+  RANSACOptions ransac_options;
+  ransac_options.max_error = options.max_line_vp_distance;
+  RANSAC<VanishingPointEstimator> ransac(ransac_options);
+  const auto horizontal_report =
+      ransac.Estimate(horizontal_line_segments, horizontal_lines);
+  const auto vertical_report =
+      ransac.Estimate(vertical_line_segments, vertical_lines);
+
+  axes.num_horizontal_inliers = horizontal_report.support.num_inliers;
+  axes.num_vertical_inliers = vertical_report.support.num_inliers;
+
+  const Eigen::Matrix3d inv_calib_matrix =
+      undistorted_camera.CalibrationMatrix().inverse();
+  const Eigen::Vector4d inv_qvec = InvertQuaternion(image.Qvec());
+
+  if (horizontal_report.success) {
+    const Eigen::Vector3d horizontal_camera_axis =
+        (inv_calib_matrix * horizontal_report.model).normalized();
+    axes.has_horizontal_axis = true;
+    axes.horizontal_axis =
+        QuaternionRotatePoint(inv_qvec, horizontal_camera_axis).normalized();
+  }
+
+  if (vertical_report.success) {
+    const Eigen::Vector3d vertical_camera_axis =
+        (inv_calib_matrix * vertical_report.model).normalized();
+    axes.has_vertical_axis = true;
+    axes.vertical_axis =
+        QuaternionRotatePoint(inv_qvec, vertical_camera_axis).normalized();
+    // Make sure axis points downwards in the image, assuming that the image
+    // was taken in upright orientation.
+    if (vertical_camera_axis.dot(Eigen::Vector3d(0, 1, 0)) < 0) {
+      axes.vertical_axis = -axes.vertical_axis;
+    }
+  }
+
+  return axes;
+}
+
 }  // namespace
 
 Eigen::Vector3d EstimateGravityVectorFromImageOrientation(
@@ -156,91 +267,51 @@ Eigen::Vector3d EstimateGravityVectorFromImageOrientation(
 Eigen::Matrix3d EstimateManhattanWorldFrame(
     const ManhattanWorldFrameEstimationOptions& options,
     const Reconstruction& reconstruction, const std::string& image_path) {
-  std::vector<Eigen::Vector3d> rightward_axes;
-  std::vector<Eigen::Vector3d> downward_axes;
-  for (size_t i = 0; i < reconstruction.NumRegImages(); ++i) {
-    const auto image_id = reconstruction.RegImageIds()[i];
-    const auto& image = reconstruction.Image(image_id);
-    const auto& camera = reconstruction.Camera(image.CameraId());
-
-    PrintHeading1(StringPrintf("Processing image %s (%d / %d)",
-                               image.Name().c_str(), i + 1,
-                               reconstruction.NumRegImages()));
-
-    std::cout << "Reading image..." << std::endl;
-
-    colmap::Bitmap bitmap;
-    CHECK(bitmap.Read(colmap::JoinPaths(image_path, image.Name())));
-
-    std::cout << "Undistorting image..." << std::endl;
-
-    UndistortCameraOptions undistortion_options;
-    undistortion_options.max_image_size = options.max_image_size;
-
-    Bitmap undistorted_bitmap;
-    Camera undistorted_camera;
-    UndistortImage(undistortion_options, bitmap, camera, &undistorted_bitmap,
-                   &undistorted_camera);
-
-    std::cout << "Detecting lines...";
-
-    const std::vector<LineSegment> line_segments =
-        DetectLineSegments(undistorted_bitmap, options.min_line_length);
-    const std::vector<LineSegmentOrientation> line_orientations =
-        ClassifyLineSegmentOrientations(line_segments,
-                                        options.line_orientation_tolerance);
-
-    std::cout << StringPrintf(" %d", line_segments.size());
-
-    std::vector<LineSegment> horizontal_line_segments;
-    std::vector<LineSegment> vertical_line_segments;
-    std::vector<Eigen::Vector3d> horizontal_lines;
-    std::vector<Eigen::Vector3d> vertical_lines;
-    for (size_t i = 0; i < line_segments.size(); ++i) {
-      const auto line_segment = line_segments[i];
-      const Eigen::Vector3d line_segment_start =
-          line_segment.start.homogeneous();
-      const Eigen::Vector3d line_segment_end = line_segment.end.homogeneous();
-      const Eigen::Vector3d line = line_segment_start.cross(line_segment_end);
-      if (line_orientations[i] == LineSegmentOrientation::HORIZONTAL) {
-        horizontal_line_segments.push_back(line_segment);
-        horizontal_lines.push_back(line);
-      } else if (line_orientations[i] == LineSegmentOrientation::VERTICAL) {
-        vertical_line_segments.push_back(line_segment);
-        vertical_lines.push_back(line);
-      }
+  std::vector<image_t> image_ids = reconstruction.RegImageIds();
+  if (options.max_num_images >= 0 &&
+      image_ids.size() > static_cast<size_t>(options.max_num_images)) {
+    std::vector<image_t> sampled_image_ids(options.max_num_images);
+    for (size_t i = 0; i < sampled_image_ids.size(); ++i) {
+      sampled_image_ids[i] =
+          image_ids[i * image_ids.size() / sampled_image_ids.size()];
     }
+    image_ids = std::move(sampled_image_ids);
+  }
 
-    std::cout << StringPrintf(" (%d horizontal, %d vertical)",
-                              horizontal_lines.size(), vertical_lines.size())
-              << std::endl;
-
-    std::cout << "Estimating vanishing points...";
-
-    RANSACOptions ransac_options;
-    ransac_options.max_error = options.max_line_vp_distance;
-    RANSAC<VanishingPointEstimator> ransac(ransac_options);
-    const auto horizontal_report =
-        ransac.Estimate(horizontal_line_segments, horizontal_lines);
-    const auto vertical_report =
-        ransac.Estimate(vertical_line_segments, vertical_lines);
+  // The vanishing points of the images are estimated in parallel, while the
+  // resulting axes are collected and printed in the order of the images.
+  ThreadPool thread_pool(options.num_threads);
+  std::vector<std::future<VanishingPointAxes>> futures;
+  futures.reserve(image_ids.size());
+  for (const image_t image_id : image_ids) {
+    futures.push_back(thread_pool.AddTask(
+        EstimateVanishingPointAxes, std::cref(options),
+        std::cref(reconstruction), std::cref(image_path), image_id));
+  }
 
-    std::cout << StringPrintf(" (%d horizontal inliers, %d vertical inliers)",
-                              horizontal_report.support.num_inliers,
-                              vertical_report.support.num_inliers)
+  std::vector<Eigen::Vector3d> rightward_axes;
+  std::vector<Eigen::Vector3d> downward_axes;
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    const VanishingPointAxes axes = futures[i].get();
+
+    PrintHeading1(StringPrintf(
+        "Processing image %s (%d / %d)",
+        reconstruction.Image(image_ids[i]).Name().c_str(), i + 1,
+        image_ids.size()));
+
+    std::cout << StringPrintf(
+                     "Detected %d lines (%d horizontal, %d vertical)",
+                     axes.num_lines, axes.num_horizontal_lines,
+                     axes.num_vertical_lines)
+              << std::endl;
+    std::cout << StringPrintf(
+                     "Estimated vanishing points (%d horizontal inliers, %d "
+                     "vertical inliers)",
+                     axes.num_horizontal_inliers, axes.num_vertical_inliers)
               << std::endl;
 
-    std::cout << "Composing coordinate axes..." << std::endl;
-
-    const Eigen::Matrix3d inv_calib_matrix =
-        undistorted_camera.CalibrationMatrix().inverse();
-    const Eigen::Vector4d inv_qvec = InvertQuaternion(image.Qvec());
-
-    if (horizontal_report.success) {
-      const Eigen::Vector3d horizontal_camera_axis =
-          (inv_calib_matrix * horizontal_report.model).normalized();
-      Eigen::Vector3d horizontal_axis =
-          QuaternionRotatePoint(inv_qvec, horizontal_camera_axis).normalized();
+    if (axes.has_horizontal_axis) {
+      Eigen::Vector3d horizontal_axis = axes.horizontal_axis;
       // Make sure all axes point into the same direction.
       if (rightward_axes.size() > 0 &&
           rightward_axes[0].dot(horizontal_axis) < 0) {
@@ -250,18 +321,10 @@ Eigen::Matrix3d EstimateManhattanWorldFrame(
       std::cout << "  Horizontal: " << horizontal_axis.transpose() << std::endl;
     }
 
-    if (vertical_report.success) {
-      const Eigen::Vector3d vertical_camera_axis =
-          (inv_calib_matrix * vertical_report.model).normalized();
-      Eigen::Vector3d vertical_axis =
-          QuaternionRotatePoint(inv_qvec, vertical_camera_axis).normalized();
-      // Make sure axis points downwards in the image, assuming that the image
-      // was taken in upright orientation.
-      if (vertical_camera_axis.dot(Eigen::Vector3d(0, 1, 0)) < 0) {
-        vertical_axis = -vertical_axis;
-      }
-      downward_axes.push_back(vertical_axis);
-      std::cout << "  Vertical: " << vertical_axis.transpose() << std::endl;
+    if (axes.has_vertical_axis) {
+      downward_axes.push_back(axes.vertical_axis);
+      std::cout << "  Vertical: " << axes.vertical_axis.transpose()
+                << std::endl;
     }
   }
 
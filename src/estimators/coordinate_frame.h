@@ -49,6 +49,11 @@ struct ManhattanWorldFrameEstimationOptions {
   double max_line_vp_distance = 0.5;
   // The maximum cosine distance between estimated axes to be inliers.
   double max_axis_distance = 0.05;
+  // The maximum number of images, which are evenly sampled from the registered
+  // images, if the reconstruction has more images. Unlimited if negative.
+  int max_num_images = -1;
+  // The number of threads for processing the images in parallel.
+  int num_threads = -1;
 };
 
 // Estimate gravity vector by assuming gravity-aligned image orientation, i.e.
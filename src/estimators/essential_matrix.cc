@@ -47,8 +47,18 @@ namespace colmap {
 std::vector<EssentialMatrixFivePointEstimator::M_t>
 EssentialMatrixFivePointEstimator::Estimate(const std::vector<X_t>& points1,
                                             const std::vector<Y_t>& points2) {
+  std::vector<M_t> models;
+  Estimate(points1, points2, &models);
+  return models;
+}
+
+void EssentialMatrixFivePointEstimator::Estimate(
+    const std::vector<X_t>& points1, const std::vector<Y_t>& points2,
+    std::vector<M_t>* models) {
   CHECK_EQ(points1.size(), points2.size());
 
+  models->clear();
+
   // Step 1: Extraction of the nullspace x, y, z, w.
 
   Eigen::Matrix<double, Eigen::Dynamic, 9> Q(points1.size(), 9);
@@ -103,12 +113,9 @@ EssentialMatrixFivePointEstimator::Estimate(const std::vector<X_t>& points1,
   Eigen::VectorXd roots_real;
   Eigen::VectorXd roots_imag;
   if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return {};
+    return;
   }
 
-  std::vector<M_t> models;
-  models.reserve(roots_real.size());
-
   for (Eigen::VectorXd::Index i = 0; i < roots_imag.size(); ++i) {
     const double kMaxRootImag = 1e-10;
     if (std::abs(roots_imag(i)) > kMaxRootImag) {
@@ -136,18 +143,16 @@ EssentialMatrixFivePointEstimator::Estimate(const std::vector<X_t>& points1,
       continue;
     }
 
-    Eigen::MatrixXd essential_vec = E.col(0) * (X(0) / X(2)) +
-                                    E.col(1) * (X(1) / X(2)) + E.col(2) * z1 +
-                                    E.col(3);
+    Eigen::Matrix<double, 9, 1> essential_vec =
+        E.col(0) * (X(0) / X(2)) + E.col(1) * (X(1) / X(2)) + E.col(2) * z1 +
+        E.col(3);
     essential_vec /= essential_vec.norm();
 
     const Eigen::Matrix3d essential_matrix =
         Eigen::Map<Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(
             essential_vec.data());
-    models.push_back(essential_matrix);
+    models->push_back(essential_matrix);
   }
-
-  return models;
 }
 
 void EssentialMatrixFivePointEstimator::Residuals(
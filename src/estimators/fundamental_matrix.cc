@@ -48,9 +48,19 @@ namespace colmap {
 std::vector<FundamentalMatrixSevenPointEstimator::M_t>
 FundamentalMatrixSevenPointEstimator::Estimate(
     const std::vector<X_t>& points1, const std::vector<Y_t>& points2) {
+  std::vector<M_t> models;
+  Estimate(points1, points2, &models);
+  return models;
+}
+
+void FundamentalMatrixSevenPointEstimator::Estimate(
+    const std::vector<X_t>& points1, const std::vector<Y_t>& points2,
+    std::vector<M_t>* models) {
   CHECK_EQ(points1.size(), 7);
   CHECK_EQ(points2.size(), 7);
 
+  models->clear();
+
   // Note that no normalization of the points is necessary here.
 
   // Setup system of equations: [points2(i,:), 1]' * F * [points1(i,:), 1]'.
@@ -110,12 +120,9 @@ FundamentalMatrixSevenPointEstimator::Estimate(
   Eigen::VectorXd roots_real;
   Eigen::VectorXd roots_imag;
   if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return {};
+    return;
   }
 
-  std::vector<M_t> models;
-  models.reserve(roots_real.size());
-
   for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
     const double kMaxRootImag = 1e-10;
     if (std::abs(roots_imag(i)) > kMaxRootImag) {
@@ -125,21 +132,19 @@ FundamentalMatrixSevenPointEstimator::Estimate(
     const double lambda = roots_real(i);
     const double mu = 1;
 
-    Eigen::MatrixXd F = lambda * f1 + mu * f2;
-
-    F.resize(3, 3);
+    // The row-major coefficients of the fundamental matrix.
+    const Eigen::Matrix<double, 1, 9> F = lambda * f1 + mu * f2;
 
     const double kEps = 1e-10;
-    if (std::abs(F(2, 2)) < kEps) {
+    if (std::abs(F(8)) < kEps) {
       continue;
     }
 
-    F /= F(2, 2);
-
-    models.push_back(F.transpose());
+    models->push_back(
+        Eigen::Map<const Eigen::Matrix<double, 3, 3, Eigen::RowMajor>>(
+            F.data()) /
+        F(8));
   }
-
-  return models;
 }
 
 void FundamentalMatrixSevenPointEstimator::Residuals(
@@ -71,6 +71,12 @@ class FundamentalMatrixSevenPointEstimator {
   static std::vector<M_t> Estimate(const std::vector<X_t>& points1,
                                    const std::vector<Y_t>& points2);
 
+  // Same as above but writes the solutions to the given vector, whose memory
+  // is reused, such that RANSAC does not allocate memory for every sample.
+  static void Estimate(const std::vector<X_t>& points1,
+                       const std::vector<Y_t>& points2,
+                       std::vector<M_t>* models);
+
   // Calculate the residuals of a set of corresponding points and a given
   // fundamental matrix.
   //
@@ -31,6 +31,7 @@
 
 #include "estimators/generalized_absolute_pose.h"
 
+#include <algorithm>
 #include <array>
 
 #include "base/polynomial.h"
@@ -41,12 +42,16 @@
 namespace colmap {
 namespace {
 
-// Check whether the rays are close to parallel.
+// Check whether the normalized rays are close to parallel. Note that an
+// absolute threshold is needed here, since a relative comparison against zero
+// only succeeds for exactly parallel rays.
 bool CheckParallelRays(const Eigen::Vector3d& ray1, const Eigen::Vector3d& ray2,
                        const Eigen::Vector3d& ray3) {
   const double kParallelThreshold = 1e-5;
-  return ray1.cross(ray2).isApproxToConstant(0, kParallelThreshold) &&
-         ray1.cross(ray3).isApproxToConstant(0, kParallelThreshold);
+  const double kSquaredParallelThreshold =
+      kParallelThreshold * kParallelThreshold;
+  return ray1.cross(ray2).squaredNorm() < kSquaredParallelThreshold &&
+         ray1.cross(ray3).squaredNorm() < kSquaredParallelThreshold;
 }
 
 // Check whether the points are close to collinear.
@@ -61,10 +66,11 @@ bool CheckCollinearPoints(const Eigen::Vector3d& X1, const Eigen::Vector3d& X2,
 
 Eigen::Vector6d ComposePlueckerLine(const Eigen::Matrix3x4d& rel_tform,
                                     const Eigen::Vector2d& point2D) {
-  const Eigen::Matrix3x4d inv_proj_matrix = InvertProjectionMatrix(rel_tform);
+  // Avoids the explicit inversion of the relative transformation.
   const Eigen::Vector3d bearing =
-      inv_proj_matrix.leftCols<3>() * point2D.homogeneous();
-  const Eigen::Vector3d proj_center = inv_proj_matrix.rightCols<1>();
+      rel_tform.leftCols<3>().transpose() * point2D.homogeneous();
+  const Eigen::Vector3d proj_center =
+      -rel_tform.leftCols<3>().transpose() * rel_tform.rightCols<1>();
   const Eigen::Vector3d bearing_normalized = bearing.normalized();
   Eigen::Vector6d pluecker;
   pluecker << bearing_normalized, proj_center.cross(bearing_normalized);
@@ -93,9 +99,8 @@ Eigen::Vector3d PointFromPlueckerLineAndDepth(const Eigen::Vector6d& pluecker,
 //    B_fi = q_i x q_i' + lambda_i * q_i.
 //
 Eigen::Matrix<double, 3, 6> ComputePolynomialCoefficients(
-    const std::vector<Eigen::Vector6d>& plueckers,
+    const Eigen::Vector6d plueckers[3],
     const std::vector<Eigen::Vector3d>& points3D) {
-  CHECK_EQ(plueckers.size(), 3);
   CHECK_EQ(points3D.size(), 3);
 
   Eigen::Matrix<double, 3, 6> K;
@@ -134,98 +139,368 @@ int SolveQuadratic(const double b, const double c, double* roots) {
   }
 }
 
-// Given lambda_j, return the values for lambda_i, where:
+// Given lambda_j, return the positive values for lambda_i, where:
 //     k1 lambda_i^2 + (k2 lambda_j + k3) lambda_i
 //      + k4 lambda_j^2 + k5 lambda_j + k6          = 0.
-void ComputeLambdaValues(const Eigen::Matrix<double, 3, 6>::ConstRowXpr& k,
-                         const double lambda_j,
-                         std::vector<double>* lambdas_i) {
+int ComputeLambdaValues(const Eigen::Matrix<double, 3, 6>::ConstRowXpr& k,
+                        const double lambda_j, double lambdas_i[2]) {
   // Note that we solve x^2 + bx + c = 0, since k(0) is one.
   double roots[2];
   const int num_solutions =
       SolveQuadratic(k(1) * lambda_j + k(2),
                      lambda_j * (k(3) * lambda_j + k(4)) + k(5), roots);
+  int num_lambdas_i = 0;
   for (int i = 0; i < num_solutions; ++i) {
     if (roots[i] > 0) {
-      lambdas_i->push_back(roots[i]);
+      lambdas_i[num_lambdas_i] = roots[i];
+      num_lambdas_i += 1;
     }
   }
+  return num_lambdas_i;
+}
+
+// Polynomial of at most degree 8 with coefficients from the highest to the
+// lowest degree, as used by the Sturm sequence below.
+struct OcticPolynomial {
+  int degree = -1;
+  double coeffs[9];
+
+  double Evaluate(const double x) const {
+    double value = coeffs[0];
+    for (int i = 1; i <= degree; ++i) {
+      value = value * x + coeffs[i];
+    }
+    return value;
+  }
+
+  // Scale the coefficients by a positive factor, such that the largest
+  // coefficient has unit magnitude. This does not change the signs of the
+  // polynomial but avoids overflow in the Sturm sequence.
+  void Normalize() {
+    double max_abs_coeff = 0;
+    for (int i = 0; i <= degree; ++i) {
+      max_abs_coeff = std::max(max_abs_coeff, std::abs(coeffs[i]));
+    }
+    if (max_abs_coeff > 0) {
+      for (int i = 0; i <= degree; ++i) {
+        coeffs[i] /= max_abs_coeff;
+      }
+    }
+  }
+
+  // Remove leading coefficients that are numerically zero.
+  void Trim() {
+    const double kMinLeadingCoeff = 1e-12;
+    int num_leading_zeros = 0;
+    while (num_leading_zeros <= degree &&
+           std::abs(coeffs[num_leading_zeros]) < kMinLeadingCoeff) {
+      num_leading_zeros += 1;
+    }
+    degree -= num_leading_zeros;
+    for (int i = 0; i <= degree; ++i) {
+      coeffs[i] = coeffs[i + num_leading_zeros];
+    }
+  }
+};
+
+// Sturm sequence of a polynomial, which is used to count the number of its
+// distinct real roots in an interval. The sequence is computed once and its
+// evaluation only requires a few Horner schemes without any allocation.
+class SturmSequence {
+ public:
+  // Returns false if the leading coefficient is numerically zero.
+  bool Compute(const Eigen::Matrix<double, 9, 1>& coeffs) {
+    OcticPolynomial& p0 = sequence_[0];
+    p0.degree = 8;
+    for (int i = 0; i <= 8; ++i) {
+      p0.coeffs[i] = coeffs(i);
+    }
+    p0.Normalize();
+    if (std::abs(p0.coeffs[0]) < 1e-10) {
+      return false;
+    }
+
+    OcticPolynomial& p1 = sequence_[1];
+    p1.degree = 7;
+    for (int i = 0; i <= 7; ++i) {
+      p1.coeffs[i] = (8 - i) * p0.coeffs[i];
+    }
+    p1.Normalize();
+
+    // p_{k+1} = -rem(p_{k-1}, p_k) until the remainder vanishes.
+    num_polys_ = 2;
+    while (num_polys_ < 9 && sequence_[num_polys_ - 1].degree > 0) {
+      const OcticPolynomial& a = sequence_[num_polys_ - 2];
+      const OcticPolynomial& b = sequence_[num_polys_ - 1];
+      double rem[9];
+      std::copy(a.coeffs, a.coeffs + a.degree + 1, rem);
+      for (int i = 0; i <= a.degree - b.degree; ++i) {
+        const double factor = rem[i] / b.coeffs[0];
+        for (int j = 0; j <= b.degree; ++j) {
+          rem[i + j] -= factor * b.coeffs[j];
+        }
+      }
+
+      OcticPolynomial& c = sequence_[num_polys_];
+      c.degree = b.degree - 1;
+      for (int i = 0; i <= c.degree; ++i) {
+        c.coeffs[i] = -rem[a.degree - b.degree + 1 + i];
+      }
+      c.Normalize();
+      c.Trim();
+      if (c.degree < 0) {
+        break;
+      }
+      num_polys_ += 1;
+    }
+
+    return true;
+  }
+
+  const OcticPolynomial& Polynomial() const { return sequence_[0]; }
+
+  // Number of sign changes of the sequence at x. The number of distinct roots
+  // in the interval (a, b] is NumSignChanges(a) - NumSignChanges(b).
+  int NumSignChanges(const double x) const {
+    int num_sign_changes = 0;
+    double prev_value = 0;
+    for (int i = 0; i < num_polys_; ++i) {
+      const double value = sequence_[i].Evaluate(x);
+      if (value == 0) {
+        continue;
+      }
+      if ((prev_value < 0 && value > 0) || (prev_value > 0 && value < 0)) {
+        num_sign_changes += 1;
+      }
+      prev_value = value;
+    }
+    return num_sign_changes;
+  }
+
+ private:
+  int num_polys_ = 0;
+  OcticPolynomial sequence_[9];
+};
+
+// Refine the single root of the polynomial in the interval (lower, upper]
+// using Newton's method, safeguarded by bisection.
+double RefineIsolatedRoot(const OcticPolynomial& p, double lower,
+                          double upper) {
+  double lower_value = p.Evaluate(lower);
+  double x = 0.5 * (lower + upper);
+  const int kMaxNumIterations = 100;
+  for (int iter = 0; iter < kMaxNumIterations; ++iter) {
+    double value = p.coeffs[0];
+    double deriv = 0;
+    for (int i = 1; i <= p.degree; ++i) {
+      deriv = deriv * x + value;
+      value = value * x + p.coeffs[i];
+    }
+
+    if (value == 0) {
+      return x;
+    }
+
+    if ((value < 0) == (lower_value < 0)) {
+      lower = x;
+      lower_value = value;
+    } else {
+      upper = x;
+    }
+
+    const double x_newton = x - value / deriv;
+    if (deriv != 0 && x_newton > lower && x_newton < upper) {
+      if (std::abs(x_newton - x) < 1e-15 * std::abs(x)) {
+        return x_newton;
+      }
+      x = x_newton;
+    } else {
+      x = 0.5 * (lower + upper);
+    }
+
+    if (upper - lower < 1e-15 * upper) {
+      break;
+    }
+  }
+  return x;
+}
+
+// Find the positive real roots of the polynomial of degree 8 using Sturm
+// sequences for the isolation of the roots, followed by safeguarded Newton
+// iterations. In contrast to the companion matrix method, this only computes
+// the roots relevant for the depths and avoids the eigen decomposition.
+// Returns false if the polynomial is degenerate, in which case the companion
+// matrix method should be used.
+bool FindPositiveRootsSturm(const Eigen::Matrix<double, 9, 1>& coeffs,
+                            double roots[8], int* num_roots) {
+  // Substitute x = scale * y, such that the roots are of unit magnitude on
+  // average, which balances the coefficients and greatly improves the
+  // numerical stability of the Sturm sequence.
+  double scale = 1;
+  if (coeffs(0) != 0 && coeffs(8) != 0) {
+    scale = std::pow(std::abs(coeffs(8) / coeffs(0)), 1.0 / 8.0);
+  }
+  Eigen::Matrix<double, 9, 1> scaled_coeffs;
+  double scale_power = 1;
+  for (int i = 8; i >= 0; --i) {
+    scaled_coeffs(i) = coeffs(i) * scale_power;
+    scale_power *= scale;
+  }
+
+  SturmSequence sturm;
+  if (!sturm.Compute(scaled_coeffs)) {
+    return false;
+  }
+
+  // Cauchy's upper bound on the magnitude of the roots.
+  const OcticPolynomial& p = sturm.Polynomial();
+  double max_ratio = 0;
+  for (int i = 1; i <= p.degree; ++i) {
+    max_ratio = std::max(max_ratio, std::abs(p.coeffs[i] / p.coeffs[0]));
+  }
+
+  struct Interval {
+    double lower;
+    double upper;
+    int lower_num_sign_changes;
+    int upper_num_sign_changes;
+    int depth;
+  };
+
+  // Bisect the intervals until each contains a single root. Note that the
+  // stack size is bounded by the maximum bisection depth plus the degree.
+  const int kMaxDepth = 64;
+  Interval stack[kMaxDepth + 8];
+  int stack_size = 1;
+  stack[0].lower = 0;
+  stack[0].upper = 1 + max_ratio;
+  stack[0].lower_num_sign_changes = sturm.NumSignChanges(stack[0].lower);
+  stack[0].upper_num_sign_changes = sturm.NumSignChanges(stack[0].upper);
+  stack[0].depth = 0;
+
+  *num_roots = 0;
+  while (stack_size > 0 && *num_roots < 8) {
+    const Interval interval = stack[--stack_size];
+    const int num_interval_roots =
+        interval.lower_num_sign_changes - interval.upper_num_sign_changes;
+    if (num_interval_roots <= 0) {
+      continue;
+    } else if (num_interval_roots == 1) {
+      roots[*num_roots] =
+          scale * RefineIsolatedRoot(p, interval.lower, interval.upper);
+      *num_roots += 1;
+    } else if (interval.depth >= kMaxDepth) {
+      // Numerically multiple root.
+      roots[*num_roots] = scale * 0.5 * (interval.lower + interval.upper);
+      *num_roots += 1;
+    } else {
+      const double mid = 0.5 * (interval.lower + interval.upper);
+      const int mid_num_sign_changes = sturm.NumSignChanges(mid);
+      stack[stack_size++] = {interval.lower, mid,
+                             interval.lower_num_sign_changes,
+                             mid_num_sign_changes, interval.depth + 1};
+      stack[stack_size++] = {mid, interval.upper, mid_num_sign_changes,
+                             interval.upper_num_sign_changes,
+                             interval.depth + 1};
+    }
+  }
+
+  return true;
 }
 
 // Given the coefficients of the polynomial system return the depths of the
 // points along the Pluecker lines. Use Sylvester resultant to get and 8th
 // degree polynomial for lambda_3 and back-substite in the original equations.
-std::vector<Eigen::Vector3d> ComputeDepthsSylvester(
-    const Eigen::Matrix<double, 3, 6>& K) {
+void ComputeDepthsSylvester(const Eigen::Matrix<double, 3, 6>& K,
+                            std::vector<Eigen::Vector3d>* depths) {
   const Eigen::Matrix<double, 9, 1> coeffs = ComputeDepthsSylvesterCoeffs(K);
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
-  if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return std::vector<Eigen::Vector3d>();
-  }
-
-  // Back-substitute every lambda_3 to the system of equations.
-  std::vector<Eigen::Vector3d> depths;
-  depths.reserve(roots_real.size());
-  for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
-    const double kMaxRootImagRatio = 1e-3;
-    if (std::abs(roots_imag(i)) > kMaxRootImagRatio * std::abs(roots_real(i))) {
-      continue;
+  double lambdas_3[8];
+  int num_lambdas_3 = 0;
+  if (!FindPositiveRootsSturm(coeffs, lambdas_3, &num_lambdas_3)) {
+    Eigen::VectorXd roots_real;
+    Eigen::VectorXd roots_imag;
+    if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real,
+                                            &roots_imag)) {
+      return;
     }
 
-    const double lambda_3 = roots_real(i);
-    if (lambda_3 <= 0) {
-      continue;
+    for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
+      const double kMaxRootImagRatio = 1e-3;
+      if (std::abs(roots_imag(i)) >
+              kMaxRootImagRatio * std::abs(roots_real(i)) ||
+          roots_real(i) <= 0) {
+        continue;
+      }
+      lambdas_3[num_lambdas_3] = roots_real(i);
+      num_lambdas_3 += 1;
     }
+  }
 
-    std::vector<double> lambdas_2;
-    ComputeLambdaValues(K.row(2), lambda_3, &lambdas_2);
+  // Back-substitute every lambda_3 to the system of equations.
+  for (int i = 0; i < num_lambdas_3; ++i) {
+    const double lambda_3 = lambdas_3[i];
+
+    double lambdas_2[2];
+    const int num_lambdas_2 = ComputeLambdaValues(K.row(2), lambda_3, lambdas_2);
 
     // Now we have two depths, lambda_2 and lambda_3. From the two remaining
     // equations, we must get the same lambda_1, otherwise the solution is
     // invalid.
-    for (const double lambda_2 : lambdas_2) {
-      std::vector<double> lambdas_1_1;
-      ComputeLambdaValues(K.row(0), lambda_2, &lambdas_1_1);
-      std::vector<double> lambdas_1_2;
-      ComputeLambdaValues(K.row(1), lambda_3, &lambdas_1_2);
-      for (const double lambda_1_1 : lambdas_1_1) {
-        for (const double lambda_1_2 : lambdas_1_2) {
+    double lambdas_1_2[2];
+    const int num_lambdas_1_2 =
+        ComputeLambdaValues(K.row(1), lambda_3, lambdas_1_2);
+    for (int j = 0; j < num_lambdas_2; ++j) {
+      const double lambda_2 = lambdas_2[j];
+      double lambdas_1_1[2];
+      const int num_lambdas_1_1 =
+          ComputeLambdaValues(K.row(0), lambda_2, lambdas_1_1);
+      for (int k = 0; k < num_lambdas_1_1; ++k) {
+        for (int l = 0; l < num_lambdas_1_2; ++l) {
+          const double lambda_1_1 = lambdas_1_1[k];
+          const double lambda_1_2 = lambdas_1_2[l];
           const double kMaxLambdaRatio = 1e-2;
           if (std::abs(lambda_1_1 - lambda_1_2) <
               kMaxLambdaRatio * std::max(lambda_1_1, lambda_1_2)) {
-              const double lambda_1 = (lambda_1_1 + lambda_1_2) / 2;
-              depths.emplace_back(lambda_1, lambda_2, lambda_3);
-            }
+            const double lambda_1 = (lambda_1_1 + lambda_1_2) / 2;
+            depths->emplace_back(lambda_1, lambda_2, lambda_3);
+          }
         }
       }
     }
   }
-
-  return depths;
 }
 
 }  // namespace
 
 std::vector<GP3PEstimator::M_t> GP3PEstimator::Estimate(
     const std::vector<X_t>& points2D, const std::vector<Y_t>& points3D) {
+  std::vector<M_t> models;
+  Estimate(points2D, points3D, &models);
+  return models;
+}
+
+void GP3PEstimator::Estimate(const std::vector<X_t>& points2D,
+                             const std::vector<Y_t>& points3D,
+                             std::vector<M_t>* models) {
   CHECK_EQ(points2D.size(), 3);
   CHECK_EQ(points3D.size(), 3);
 
+  models->clear();
+
   if (CheckCollinearPoints(points3D[0], points3D[1], points3D[2])) {
-    return std::vector<GP3PEstimator::M_t>({});
+    return;
   }
 
   // Transform 2D points into compact Pluecker line representation.
-  std::vector<Eigen::Vector6d> plueckers(3);
+  Eigen::Vector6d plueckers[3];
   for (size_t i = 0; i < 3; ++i) {
     plueckers[i] = ComposePlueckerLine(points2D[i].rel_tform, points2D[i].xy);
   }
 
   if (CheckParallelRays(plueckers[0].head<3>(), plueckers[1].head<3>(),
                         plueckers[2].head<3>())) {
-    return std::vector<GP3PEstimator::M_t>({});
+    return;
   }
 
   // Compute the coefficients k1, k2, k3 using Eq. 4.
@@ -233,9 +508,11 @@ std::vector<GP3PEstimator::M_t> GP3PEstimator::Estimate(
       ComputePolynomialCoefficients(plueckers, points3D);
 
   // Compute the depths along the Pluecker lines of the observations.
-  const std::vector<Eigen::Vector3d> depths = ComputeDepthsSylvester(K);
+  std::vector<Eigen::Vector3d> depths;
+  depths.reserve(8);
+  ComputeDepthsSylvester(K, &depths);
   if (depths.empty()) {
-    return std::vector<GP3PEstimator::M_t>({});
+    return;
   }
 
   // For all valid depth values, compute the transformation between points in
@@ -248,7 +525,7 @@ std::vector<GP3PEstimator::M_t> GP3PEstimator::Estimate(
     points3D_world.col(i) = points3D[i];
   }
 
-  std::vector<M_t> models(depths.size());
+  models->resize(depths.size());
   for (size_t i = 0; i < depths.size(); ++i) {
     Eigen::Matrix3d points3D_camera;
     for (size_t j = 0; j < 3; ++j) {
@@ -258,10 +535,8 @@ std::vector<GP3PEstimator::M_t> GP3PEstimator::Estimate(
 
     const Eigen::Matrix4d transform =
         Eigen::umeyama(points3D_world, points3D_camera, false);
-    models[i] = transform.topLeftCorner<3, 4>();
+    (*models)[i] = transform.topLeftCorner<3, 4>();
   }
-
-  return models;
 }
 
 void GP3PEstimator::Residuals(const std::vector<X_t>& points2D,
@@ -127,3 +127,51 @@ BOOST_AUTO_TEST_CASE(Estimate) {
     }
   }
 }
+
+BOOST_AUTO_TEST_CASE(EstimateRandomRigs) {
+  SetPRNGSeed(0);
+
+  const int kNumProblems = 1000;
+  int num_correct = 0;
+  for (int i = 0; i < kNumProblems; ++i) {
+    const Eigen::Matrix3x4d tform = ComposeProjectionMatrix(
+        Eigen::Vector4d(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                        RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0))
+            .normalized(),
+        Eigen::Vector3d(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                        RandomReal(-1.0, 1.0)));
+
+    std::vector<GP3PEstimator::X_t> points2D(3);
+    std::vector<Eigen::Vector3d> points3D(3);
+    for (int j = 0; j < 3; ++j) {
+      points2D[j].rel_tform = ComposeProjectionMatrix(
+          Eigen::Vector4d(1, RandomReal(-0.2, 0.2), RandomReal(-0.2, 0.2),
+                          RandomReal(-0.2, 0.2))
+              .normalized(),
+          Eigen::Vector3d(RandomReal(-0.5, 0.5), RandomReal(-0.5, 0.5),
+                          RandomReal(-0.5, 0.5)));
+      const Eigen::Vector3d point3D_camera(RandomReal(-1.0, 1.0),
+                                           RandomReal(-1.0, 1.0),
+                                           RandomReal(2.0, 5.0));
+      points2D[j].xy = point3D_camera.hnormalized();
+      // Transform the point from the camera to the world frame.
+      const Eigen::Vector3d point3D_rig =
+          points2D[j].rel_tform.leftCols<3>().transpose() *
+          (point3D_camera - points2D[j].rel_tform.col(3));
+      points3D[j] = tform.leftCols<3>().transpose() *
+                    (point3D_rig - tform.col(3));
+    }
+
+    std::vector<GP3PEstimator::M_t> models;
+    GP3PEstimator::Estimate(points2D, points3D, &models);
+    for (const auto& model : models) {
+      if ((model - tform).norm() < 1e-6) {
+        num_correct += 1;
+        break;
+      }
+    }
+  }
+
+  // Near-degenerate configurations fail the consistency check of the depths.
+  BOOST_CHECK_GE(num_correct, 0.95 * kNumProblems);
+}
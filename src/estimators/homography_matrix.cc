@@ -38,6 +38,7 @@
 #include "base/projection.h"
 #include "estimators/utils.h"
 #include "util/logging.h"
+#include "util/simd.h"
 
 namespace colmap {
 
@@ -91,16 +92,22 @@ std::vector<HomographyMatrixEstimator::M_t> HomographyMatrixEstimator::Estimate(
   return models;
 }
 
+COLMAP_SIMD_CLONES
 void HomographyMatrixEstimator::Residuals(const std::vector<X_t>& points1,
                                           const std::vector<Y_t>& points2,
                                           const M_t& H,
                                           std::vector<double>* residuals) {
   CHECK_EQ(points1.size(), points2.size());
 
-  residuals->resize(points1.size());
+  const size_t num_points = points1.size();
+  residuals->resize(num_points);
+  if (num_points == 0) {
+    return;
+  }
 
   // Note that this code might not be as nice as Eigen expressions,
-  // but it is significantly faster in various tests.
+  // but it is significantly faster in various tests. The loop operates on
+  // raw pointers, so that it can be vectorized by the compiler.
 
   const double H_00 = H(0, 0);
   const double H_01 = H(0, 1);
@@ -112,11 +119,15 @@ void HomographyMatrixEstimator::Residuals(const std::vector<X_t>& points1,
   const double H_21 = H(2, 1);
   const double H_22 = H(2, 2);
 
-  for (size_t i = 0; i < points1.size(); ++i) {
-    const double s_0 = points1[i](0);
-    const double s_1 = points1[i](1);
-    const double d_0 = points2[i](0);
-    const double d_1 = points2[i](1);
+  const double* s = points1[0].data();
+  const double* d = points2[0].data();
+  double* residuals_data = residuals->data();
+
+  for (size_t i = 0; i < num_points; ++i) {
+    const double s_0 = s[2 * i];
+    const double s_1 = s[2 * i + 1];
+    const double d_0 = d[2 * i];
+    const double d_1 = d[2 * i + 1];
 
     const double pd_0 = H_00 * s_0 + H_01 * s_1 + H_02;
     const double pd_1 = H_10 * s_0 + H_11 * s_1 + H_12;
@@ -126,7 +137,7 @@ void HomographyMatrixEstimator::Residuals(const std::vector<X_t>& points1,
     const double dd_0 = d_0 - pd_0 * inv_pd_2;
     const double dd_1 = d_1 - pd_1 * inv_pd_2;
 
-    (*residuals)[i] = dd_0 * dd_0 + dd_1 * dd_1;
+    residuals_data[i] = dd_0 * dd_0 + dd_1 * dd_1;
   }
 }
 
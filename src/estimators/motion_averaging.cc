@@ -0,0 +1,662 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "estimators/motion_averaging.h"
+
+#include <numeric>
+#include <queue>
+
+#include <Eigen/Geometry>
+#include <Eigen/SparseCholesky>
+
+#include "base/pose.h"
+#include "optim/least_absolute_deviations.h"
+#include "util/logging.h"
+#include "util/math.h"
+
+namespace colmap {
+namespace {
+
+class UnionFind {
+ public:
+  explicit UnionFind(const size_t num_nodes) : parents_(num_nodes) {
+    std::iota(parents_.begin(), parents_.end(), 0);
+  }
+
+  int Find(int node) {
+    while (parents_[node] != node) {
+      parents_[node] = parents_[parents_[node]];
+      node = parents_[node];
+    }
+    return node;
+  }
+
+  // Returns false, if the nodes were already in the same set.
+  bool Union(const int node1, const int node2) {
+    const int root1 = Find(node1);
+    const int root2 = Find(node2);
+    if (root1 == root2) {
+      return false;
+    }
+    parents_[root2] = root1;
+    return true;
+  }
+
+ private:
+  std::vector<int> parents_;
+};
+
+// Returns a mask of the nodes in the largest connected component.
+std::vector<char> FindLargestConnectedComponent(
+    const size_t num_nodes, const std::vector<std::pair<int, int>>& edges) {
+  UnionFind union_find(num_nodes);
+  for (const auto& edge : edges) {
+    union_find.Union(edge.first, edge.second);
+  }
+
+  std::vector<int> component_sizes(num_nodes, 0);
+  for (size_t node = 0; node < num_nodes; ++node) {
+    component_sizes[union_find.Find(node)] += 1;
+  }
+
+  const int largest_root = static_cast<int>(
+      std::max_element(component_sizes.begin(), component_sizes.end()) -
+      component_sizes.begin());
+
+  std::vector<char> component_mask(num_nodes, false);
+  for (size_t node = 0; node < num_nodes; ++node) {
+    component_mask[node] = union_find.Find(node) == largest_root;
+  }
+
+  return component_mask;
+}
+
+Eigen::Matrix3d AngleAxisToRotationMatrix(const Eigen::Vector3d& angle_axis) {
+  const double angle = angle_axis.norm();
+  if (angle < std::numeric_limits<double>::epsilon()) {
+    return Eigen::Matrix3d::Identity();
+  }
+  return Eigen::AngleAxisd(angle, angle_axis / angle).toRotationMatrix();
+}
+
+Eigen::Vector3d RotationMatrixToAngleAxis(const Eigen::Matrix3d& rot_mat) {
+  const Eigen::AngleAxisd angle_axis(rot_mat);
+  return angle_axis.angle() * angle_axis.axis();
+}
+
+// Solve the weighted least-squares problem on the graph of the given edges:
+//
+//    min sum_k weights_k * || x_j - x_i - rhs_k ||^2  for edge k = (i, j),
+//
+// where the unknowns of nodes without a parameter index are zero.
+bool SolveGraphLeastSquares(const std::vector<std::pair<int, int>>& edges,
+                            const std::vector<double>& weights,
+                            const Eigen::MatrixXd& rhs,
+                            const std::vector<int>& param_idxs,
+                            const int num_params, Eigen::MatrixXd* x) {
+  std::vector<Eigen::Triplet<double>> triplets;
+  triplets.reserve(4 * edges.size());
+  Eigen::MatrixXd b = Eigen::MatrixXd::Zero(num_params, rhs.cols());
+  for (size_t k = 0; k < edges.size(); ++k) {
+    const int param_idx1 = param_idxs[edges[k].first];
+    const int param_idx2 = param_idxs[edges[k].second];
+    const double weight = weights[k];
+    if (param_idx1 >= 0) {
+      triplets.emplace_back(param_idx1, param_idx1, weight);
+      b.row(param_idx1) -= weight * rhs.row(k);
+    }
+    if (param_idx2 >= 0) {
+      triplets.emplace_back(param_idx2, param_idx2, weight);
+      b.row(param_idx2) += weight * rhs.row(k);
+    }
+    if (param_idx1 >= 0 && param_idx2 >= 0) {
+      triplets.emplace_back(param_idx1, param_idx2, -weight);
+      triplets.emplace_back(param_idx2, param_idx1, -weight);
+    }
+  }
+
+  Eigen::SparseMatrix<double> A(num_params, num_params);
+  A.setFromTriplets(triplets.begin(), triplets.end());
+
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> linear_solver;
+  linear_solver.compute(A);
+  if (linear_solver.info() != Eigen::Success) {
+    return false;
+  }
+
+  *x = linear_solver.solve(b);
+  return linear_solver.info() == Eigen::Success;
+}
+
+}  // namespace
+
+bool RotationAveragingOptions::Check() const {
+  CHECK_OPTION_GE(max_num_l1_iterations, 0);
+  CHECK_OPTION_GE(max_num_irls_iterations, 0);
+  CHECK_OPTION_GE(convergence_threshold, 0);
+  CHECK_OPTION_GT(loss_scale, 0);
+  CHECK_OPTION_GE(max_rotation_error, 0);
+  return true;
+}
+
+bool TranslationAveragingOptions::Check() const {
+  CHECK_OPTION_GT(max_num_iterations, 0);
+  CHECK_OPTION_GE(convergence_threshold, 0);
+  CHECK_OPTION_GT(loss_scale, 0);
+  CHECK_OPTION_GE(max_angular_error, 0);
+  return true;
+}
+
+bool AverageRotations(
+    const RotationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector4d>& rel_qvecs,
+    const std::vector<double>& weights,
+    EIGEN_STL_UMAP(image_t, Eigen::Vector4d) * qvecs,
+    std::vector<char>* inlier_mask) {
+  CHECK(options.Check());
+  CHECK_EQ(image_pairs.size(), rel_qvecs.size());
+  CHECK_EQ(image_pairs.size(), weights.size());
+  CHECK_NOTNULL(qvecs);
+  CHECK_NOTNULL(inlier_mask);
+
+  qvecs->clear();
+  inlier_mask->clear();
+  inlier_mask->resize(image_pairs.size(), false);
+
+  if (image_pairs.empty()) {
+    return false;
+  }
+
+  // Map the images to consecutive node indices.
+  std::unordered_map<image_t, int> image_id_to_idx;
+  std::vector<image_t> image_ids;
+  const auto ImageIdToIdx = [&](const image_t image_id) {
+    const auto it = image_id_to_idx.emplace(image_id, image_ids.size());
+    if (it.second) {
+      image_ids.push_back(image_id);
+    }
+    return it.first->second;
+  };
+
+  std::vector<std::pair<int, int>> edges(image_pairs.size());
+  std::vector<Eigen::Matrix3d> rel_rot_mats(image_pairs.size());
+  for (size_t k = 0; k < image_pairs.size(); ++k) {
+    CHECK_NE(image_pairs[k].first, image_pairs[k].second);
+    CHECK_GE(weights[k], 0);
+    edges[k].first = ImageIdToIdx(image_pairs[k].first);
+    edges[k].second = ImageIdToIdx(image_pairs[k].second);
+    rel_rot_mats[k] = QuaternionToRotationMatrix(rel_qvecs[k]);
+  }
+
+  const size_t num_images = image_ids.size();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Initialize the rotations from the maximum spanning tree.
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::vector<size_t> sorted_edge_idxs(edges.size());
+  std::iota(sorted_edge_idxs.begin(), sorted_edge_idxs.end(), 0);
+  std::stable_sort(sorted_edge_idxs.begin(), sorted_edge_idxs.end(),
+                   [&weights](const size_t edge_idx1, const size_t edge_idx2) {
+                     return weights[edge_idx1] > weights[edge_idx2];
+                   });
+
+  UnionFind union_find(num_images);
+  std::vector<std::vector<size_t>> tree_edge_idxs(num_images);
+  for (const size_t edge_idx : sorted_edge_idxs) {
+    const auto& edge = edges[edge_idx];
+    if (union_find.Union(edge.first, edge.second)) {
+      tree_edge_idxs[edge.first].push_back(edge_idx);
+      tree_edge_idxs[edge.second].push_back(edge_idx);
+    }
+  }
+
+  // The image with the largest total weight in the largest connected component
+  // is the root of the tree and its rotation is fixed to remove the gauge.
+  const std::vector<char> component_mask =
+      FindLargestConnectedComponent(num_images, edges);
+  std::vector<double> node_weights(num_images, 0);
+  for (size_t k = 0; k < edges.size(); ++k) {
+    node_weights[edges[k].first] += weights[k];
+    node_weights[edges[k].second] += weights[k];
+  }
+  int root_idx = -1;
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node] &&
+        (root_idx == -1 || node_weights[node] > node_weights[root_idx])) {
+      root_idx = static_cast<int>(node);
+    }
+  }
+
+  std::vector<Eigen::Matrix3d> rot_mats(num_images,
+                                        Eigen::Matrix3d::Identity());
+  std::vector<char> visited(num_images, false);
+  std::queue<int> queue;
+  queue.push(root_idx);
+  visited[root_idx] = true;
+  while (!queue.empty()) {
+    const int node = queue.front();
+    queue.pop();
+    for (const size_t edge_idx : tree_edge_idxs[node]) {
+      const auto& edge = edges[edge_idx];
+      const int other_node = edge.first == node ? edge.second : edge.first;
+      if (visited[other_node]) {
+        continue;
+      }
+      if (edge.first == node) {
+        rot_mats[other_node] = rel_rot_mats[edge_idx] * rot_mats[node];
+      } else {
+        rot_mats[other_node] =
+            rel_rot_mats[edge_idx].transpose() * rot_mats[node];
+      }
+      visited[other_node] = true;
+      queue.push(other_node);
+    }
+  }
+
+  // Only the images in the connected component of the root are estimated.
+  std::vector<int> param_idxs(num_images, -1);
+  int num_params = 0;
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node] && static_cast<int>(node) != root_idx) {
+      param_idxs[node] = num_params;
+      num_params += 1;
+    }
+  }
+
+  std::vector<size_t> component_edge_idxs;
+  std::vector<std::pair<int, int>> component_edges;
+  for (size_t k = 0; k < edges.size(); ++k) {
+    if (component_mask[edges[k].first]) {
+      component_edge_idxs.push_back(k);
+      component_edges.push_back(edges[k]);
+    }
+  }
+
+  // The residual rotation of the image pair is the identity for consistent
+  // rotations. The rotations are updated as `R_i * exp(x_i)`, such that the
+  // linearized residual of edge (i, j) is `log(residual) + x_i - x_j`.
+  const auto ComputeResiduals = [&]() {
+    Eigen::MatrixXd residuals(component_edge_idxs.size(), 3);
+    for (size_t k = 0; k < component_edge_idxs.size(); ++k) {
+      const size_t edge_idx = component_edge_idxs[k];
+      const auto& edge = edges[edge_idx];
+      residuals.row(k) = RotationMatrixToAngleAxis(
+                             rot_mats[edge.second].transpose() *
+                             rel_rot_mats[edge_idx] * rot_mats[edge.first])
+                             .transpose();
+    }
+    return residuals;
+  };
+
+  // Returns the maximum update of the rotations in degrees.
+  const auto UpdateRotations = [&](const Eigen::MatrixXd& updates) {
+    double max_update = 0;
+    for (size_t node = 0; node < num_images; ++node) {
+      const int param_idx = param_idxs[node];
+      if (param_idx >= 0) {
+        const Eigen::Vector3d update = updates.row(param_idx).transpose();
+        rot_mats[node] = rot_mats[node] * AngleAxisToRotationMatrix(update);
+        max_update = std::max(max_update, update.norm());
+      }
+    }
+    return RadToDeg(max_update);
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  // L1 rotation averaging.
+  //////////////////////////////////////////////////////////////////////////////
+
+  // The three axes of the updates are independent, so that the problem is
+  // separable along the axes and solved jointly with interleaved unknowns.
+  std::vector<Eigen::Triplet<double>> triplets;
+  triplets.reserve(6 * component_edges.size());
+  for (size_t k = 0; k < component_edges.size(); ++k) {
+    const int param_idx1 = param_idxs[component_edges[k].first];
+    const int param_idx2 = param_idxs[component_edges[k].second];
+    for (int d = 0; d < 3; ++d) {
+      if (param_idx1 >= 0) {
+        triplets.emplace_back(3 * k + d, 3 * param_idx1 + d, -1);
+      }
+      if (param_idx2 >= 0) {
+        triplets.emplace_back(3 * k + d, 3 * param_idx2 + d, 1);
+      }
+    }
+  }
+
+  Eigen::SparseMatrix<double> A(3 * component_edges.size(), 3 * num_params);
+  A.setFromTriplets(triplets.begin(), triplets.end());
+
+  LeastAbsoluteDeviationsOptions lad_options;
+  for (int iter = 0; iter < options.max_num_l1_iterations; ++iter) {
+    const Eigen::MatrixXd residuals = ComputeResiduals();
+    Eigen::VectorXd b(3 * residuals.rows());
+    for (Eigen::Index k = 0; k < residuals.rows(); ++k) {
+      b.segment<3>(3 * k) = residuals.row(k).transpose();
+    }
+
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(3 * num_params);
+    if (!SolveLeastAbsoluteDeviations(lad_options, A, b, &x)) {
+      return false;
+    }
+
+    Eigen::MatrixXd updates(num_params, 3);
+    for (int i = 0; i < num_params; ++i) {
+      updates.row(i) = x.segment<3>(3 * i).transpose();
+    }
+
+    if (UpdateRotations(updates) < options.convergence_threshold) {
+      break;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Iteratively reweighted least-squares refinement.
+  //////////////////////////////////////////////////////////////////////////////
+
+  const double loss_scale_sq = DegToRad(options.loss_scale) *
+                               DegToRad(options.loss_scale);
+  std::vector<double> irls_weights(component_edges.size());
+  for (int iter = 0; iter < options.max_num_irls_iterations; ++iter) {
+    const Eigen::MatrixXd residuals = ComputeResiduals();
+    for (size_t k = 0; k < component_edges.size(); ++k) {
+      // Weight of the Geman-McClure loss.
+      const double weight =
+          loss_scale_sq / (residuals.row(k).squaredNorm() + loss_scale_sq);
+      irls_weights[k] = weight * weight;
+    }
+
+    Eigen::MatrixXd updates;
+    if (!SolveGraphLeastSquares(component_edges, irls_weights, residuals,
+                                param_idxs, num_params, &updates)) {
+      return false;
+    }
+
+    if (UpdateRotations(updates) < options.convergence_threshold) {
+      break;
+    }
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Extract the rotations and inliers.
+  //////////////////////////////////////////////////////////////////////////////
+
+  const Eigen::MatrixXd residuals = ComputeResiduals();
+  const double max_rotation_error = DegToRad(options.max_rotation_error);
+  for (size_t k = 0; k < component_edge_idxs.size(); ++k) {
+    if (residuals.row(k).norm() <= max_rotation_error) {
+      inlier_mask->at(component_edge_idxs[k]) = true;
+    }
+  }
+
+  qvecs->reserve(num_params + 1);
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node]) {
+      qvecs->emplace(image_ids[node], RotationMatrixToQuaternion(rot_mats[node]));
+    }
+  }
+
+  return true;
+}
+
+bool AverageTranslations(
+    const TranslationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector3d>& rel_tvecs,
+    const EIGEN_STL_UMAP(image_t, Eigen::Vector4d) & qvecs,
+    std::unordered_map<image_t, Eigen::Vector3d>* proj_centers,
+    std::vector<char>* inlier_mask) {
+  CHECK(options.Check());
+  CHECK_EQ(image_pairs.size(), rel_tvecs.size());
+  CHECK_NOTNULL(proj_centers);
+  CHECK_NOTNULL(inlier_mask);
+
+  proj_centers->clear();
+  inlier_mask->clear();
+  inlier_mask->resize(image_pairs.size(), false);
+
+  // Map the images to consecutive node indices.
+  std::unordered_map<image_t, int> image_id_to_idx;
+  std::vector<image_t> image_ids;
+  const auto ImageIdToIdx = [&](const image_t image_id) {
+    const auto it = image_id_to_idx.emplace(image_id, image_ids.size());
+    if (it.second) {
+      image_ids.push_back(image_id);
+    }
+    return it.first->second;
+  };
+
+  // The relative translation is `t_ij = R_j * (c_i - c_j)`, so that its
+  // direction in the world frame is the direction between the centers.
+  std::vector<size_t> edge_idxs;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<Eigen::Vector3d> directions;
+  for (size_t k = 0; k < image_pairs.size(); ++k) {
+    const auto qvec1 = qvecs.find(image_pairs[k].first);
+    const auto qvec2 = qvecs.find(image_pairs[k].second);
+    if (qvec1 == qvecs.end() || qvec2 == qvecs.end() ||
+        rel_tvecs[k].norm() < std::numeric_limits<double>::epsilon()) {
+      continue;
+    }
+    CHECK_NE(image_pairs[k].first, image_pairs[k].second);
+    edge_idxs.push_back(k);
+    edges.emplace_back(ImageIdToIdx(image_pairs[k].first),
+                       ImageIdToIdx(image_pairs[k].second));
+    directions.push_back(
+        (QuaternionToRotationMatrix(qvec2->second).transpose() * rel_tvecs[k])
+            .normalized());
+  }
+
+  if (edges.empty()) {
+    return false;
+  }
+
+  const size_t num_images = image_ids.size();
+
+  // The image with the most image pairs in the largest connected component
+  // is fixed at the origin to remove the gauge.
+  const std::vector<char> component_mask =
+      FindLargestConnectedComponent(num_images, edges);
+  std::vector<int> num_node_edges(num_images, 0);
+  for (const auto& edge : edges) {
+    num_node_edges[edge.first] += 1;
+    num_node_edges[edge.second] += 1;
+  }
+  int root_idx = -1;
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node] &&
+        (root_idx == -1 || num_node_edges[node] > num_node_edges[root_idx])) {
+      root_idx = static_cast<int>(node);
+    }
+  }
+
+  std::vector<int> param_idxs(num_images, -1);
+  int num_params = 0;
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node] && static_cast<int>(node) != root_idx) {
+      param_idxs[node] = num_params;
+      num_params += 1;
+    }
+  }
+
+  std::vector<size_t> component_edge_idxs;
+  std::vector<std::pair<int, int>> component_edges;
+  for (size_t k = 0; k < edges.size(); ++k) {
+    if (component_mask[edges[k].first]) {
+      component_edge_idxs.push_back(k);
+      // The edge is oriented as (j, i), so that the unknowns are `c_i - c_j`.
+      component_edges.emplace_back(edges[k].second, edges[k].first);
+    }
+  }
+
+  const auto ProjectionCenter = [&](const Eigen::MatrixXd& centers,
+                                    const int node) {
+    const int param_idx = param_idxs[node];
+    if (param_idx >= 0) {
+      return Eigen::Vector3d(centers.row(param_idx).transpose());
+    }
+    return Eigen::Vector3d(Eigen::Vector3d::Zero());
+  };
+
+  // The unknown scale of the baseline `c_i - c_j = s * d` is eliminated by
+  // penalizing the component of the baseline orthogonal to the direction,
+  // i.e. `(I - d * d^T) * (c_i - c_j)`. The resulting homogeneous problem is
+  // constrained by `sum_k w_k * d_k^T * (c_i - c_j) = 1` to fix the scale and
+  // sign of the solution, which is found from a single linear system. The
+  // residuals are normalized by the baseline lengths of the previous iteration
+  // to make the estimate independent of the baseline lengths.
+  const size_t num_component_edges = component_edges.size();
+  std::vector<double> irls_weights(num_component_edges, 1);
+  std::vector<double> baseline_weights(num_component_edges, 1);
+  Eigen::MatrixXd centers = Eigen::MatrixXd::Zero(num_params, 3);
+  const double loss_scale_sq = options.loss_scale * options.loss_scale;
+  const double kRegularization = 1e-10;
+  std::vector<Eigen::Triplet<double>> triplets;
+  triplets.reserve(36 * num_component_edges);
+  for (int iter = 0; iter < options.max_num_iterations; ++iter) {
+    triplets.clear();
+    Eigen::VectorXd g = Eigen::VectorXd::Zero(3 * num_params);
+    for (size_t k = 0; k < num_component_edges; ++k) {
+      const Eigen::Vector3d& direction = directions[component_edge_idxs[k]];
+      const Eigen::Matrix3d P =
+          irls_weights[k] * baseline_weights[k] *
+          (Eigen::Matrix3d::Identity() - direction * direction.transpose());
+      const int param_idx1 = param_idxs[component_edges[k].second];
+      const int param_idx2 = param_idxs[component_edges[k].first];
+      for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+          if (param_idx1 >= 0) {
+            triplets.emplace_back(3 * param_idx1 + r, 3 * param_idx1 + c,
+                                  P(r, c));
+          }
+          if (param_idx2 >= 0) {
+            triplets.emplace_back(3 * param_idx2 + r, 3 * param_idx2 + c,
+                                  P(r, c));
+          }
+          if (param_idx1 >= 0 && param_idx2 >= 0) {
+            triplets.emplace_back(3 * param_idx1 + r, 3 * param_idx2 + c,
+                                  -P(r, c));
+            triplets.emplace_back(3 * param_idx2 + r, 3 * param_idx1 + c,
+                                  -P(r, c));
+          }
+        }
+      }
+      if (param_idx1 >= 0) {
+        g.segment<3>(3 * param_idx1) += irls_weights[k] * direction;
+      }
+      if (param_idx2 >= 0) {
+        g.segment<3>(3 * param_idx2) -= irls_weights[k] * direction;
+      }
+    }
+
+    // The system is singular for noise-free directions, since the solution is
+    // in its null space, so that it is slightly regularized.
+    Eigen::SparseMatrix<double> H(3 * num_params, 3 * num_params);
+    H.setFromTriplets(triplets.begin(), triplets.end());
+    const double regularization =
+        kRegularization * H.diagonal().sum() / H.rows();
+    for (int i = 0; i < H.rows(); ++i) {
+      H.coeffRef(i, i) += regularization;
+    }
+
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> linear_solver;
+    linear_solver.compute(H);
+    if (linear_solver.info() != Eigen::Success) {
+      return false;
+    }
+
+    const Eigen::VectorXd y = linear_solver.solve(g);
+    const double g_dot_y = g.dot(y);
+    if (linear_solver.info() != Eigen::Success ||
+        g_dot_y <= std::numeric_limits<double>::epsilon()) {
+      return false;
+    }
+
+    Eigen::MatrixXd new_centers(num_params, 3);
+    for (int i = 0; i < num_params; ++i) {
+      new_centers.row(i) = y.segment<3>(3 * i).transpose() / g_dot_y;
+    }
+
+    // The scale of the centers changes between iterations, so that the
+    // change is measured after normalizing the scale.
+    new_centers /= std::max(new_centers.norm(),
+                            std::numeric_limits<double>::epsilon());
+    const double change = (new_centers - centers).norm();
+    centers = new_centers;
+
+    for (size_t k = 0; k < num_component_edges; ++k) {
+      const Eigen::Vector3d baseline =
+          ProjectionCenter(centers, component_edges[k].second) -
+          ProjectionCenter(centers, component_edges[k].first);
+      const double baseline_norm_sq = baseline.squaredNorm();
+      if (baseline_norm_sq <= std::numeric_limits<double>::epsilon()) {
+        continue;
+      }
+      baseline_weights[k] = 1 / baseline_norm_sq;
+      // Weight of the Geman-McClure loss on the chordal distance.
+      const double residual_sq =
+          (baseline / std::sqrt(baseline_norm_sq) -
+           directions[component_edge_idxs[k]])
+              .squaredNorm();
+      const double weight = loss_scale_sq / (residual_sq + loss_scale_sq);
+      irls_weights[k] = weight * weight;
+    }
+
+    if (change < options.convergence_threshold) {
+      break;
+    }
+  }
+
+  const double min_cos_angle = std::cos(DegToRad(options.max_angular_error));
+  for (size_t k = 0; k < num_component_edges; ++k) {
+    const Eigen::Vector3d baseline =
+        ProjectionCenter(centers, component_edges[k].second) -
+        ProjectionCenter(centers, component_edges[k].first);
+    const double baseline_norm = baseline.norm();
+    if (baseline_norm > std::numeric_limits<double>::epsilon() &&
+        baseline.dot(directions[component_edge_idxs[k]]) / baseline_norm >=
+            min_cos_angle) {
+      inlier_mask->at(edge_idxs[component_edge_idxs[k]]) = true;
+    }
+  }
+
+  proj_centers->reserve(num_params + 1);
+  for (size_t node = 0; node < num_images; ++node) {
+    if (component_mask[node]) {
+      proj_centers->emplace(image_ids[node], ProjectionCenter(centers, node));
+    }
+  }
+
+  return true;
+}
+
+}  // namespace colmap
@@ -0,0 +1,145 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_ESTIMATORS_MOTION_AVERAGING_H_
+#define COLMAP_SRC_ESTIMATORS_MOTION_AVERAGING_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "util/alignment.h"
+#include "util/types.h"
+
+namespace colmap {
+
+struct RotationAveragingOptions {
+  // Maximum number of iterations of the L1 averaging, which robustly
+  // initializes the rotations.
+  int max_num_l1_iterations = 5;
+
+  // Maximum number of iterations of the iteratively reweighted least-squares
+  // refinement of the rotations.
+  int max_num_irls_iterations = 100;
+
+  // The iterations stop once the maximum rotation update falls below this
+  // threshold in degrees.
+  double convergence_threshold = 1e-3;
+
+  // Scale of the Geman-McClure loss in degrees of the refinement.
+  double loss_scale = 5.0;
+
+  // Maximum residual in degrees of a relative rotation to be an inlier.
+  double max_rotation_error = 5.0;
+
+  bool Check() const;
+};
+
+struct TranslationAveragingOptions {
+  // Maximum number of iteratively reweighted least-squares iterations.
+  int max_num_iterations = 100;
+
+  // The iterations stop once the relative change of the projection centers
+  // falls below this threshold.
+  double convergence_threshold = 1e-5;
+
+  // Scale of the Geman-McClure loss on the chordal distance between the
+  // relative translation directions and the directions between the centers.
+  double loss_scale = 0.1;
+
+  // Maximum angle in degrees between a relative translation direction and the
+  // direction between the projection centers to be an inlier.
+  double max_angular_error = 10.0;
+
+  bool Check() const;
+};
+
+// Estimate the absolute rotations of the images from the relative rotations
+// between image pairs. The relative rotation of the image pair (i, j) maps
+// from the frame of image i to the frame of image j, i.e. `R_j = R_ij * R_i`.
+// The rotations are initialized from the maximum spanning tree of the pair
+// weights (e.g., the number of inlier matches), robustly averaged in L1 and
+// refined using iteratively reweighted least-squares, as described in
+// "Efficient and Robust Large-Scale Rotation Averaging" by Chatterjee and
+// Govindu. Only the largest connected component of the image pairs is
+// estimated, so that images without an estimated rotation are not in `qvecs`.
+//
+// @param options         Rotation averaging options.
+// @param image_pairs     Identifiers of the image pairs.
+// @param rel_qvecs       Relative rotation for each image pair.
+// @param weights         Non-negative weight for each image pair.
+// @param qvecs           Estimated absolute rotation for each image.
+// @param inlier_mask     Whether the relative rotation of an image pair is
+//                        consistent with the estimated absolute rotations.
+//
+// @return                Whether the rotations were estimated successfully.
+bool AverageRotations(
+    const RotationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector4d>& rel_qvecs,
+    const std::vector<double>& weights,
+    EIGEN_STL_UMAP(image_t, Eigen::Vector4d) * qvecs,
+    std::vector<char>* inlier_mask);
+
+// Estimate the projection centers of the images from the directions of the
+// relative translations between image pairs and the absolute rotations of the
+// images. The relative translation of the image pair (i, j) is given in the
+// frame of image j, i.e. `X_j = R_ij * X_i + t_ij`, and only its direction is
+// used. The projection centers are estimated up to an unknown similarity
+// transformation using iteratively reweighted least-squares on the baselines
+// orthogonal to the relative translation directions. The residuals are
+// normalized by the baseline lengths to be insensitive to them, as proposed in
+// "Baseline Desensitizing in Translation Averaging" by Zhuang et al. Image
+// pairs without rotations for both images are ignored and only the largest
+// connected component of the remaining image pairs is estimated.
+//
+// @param options         Translation averaging options.
+// @param image_pairs     Identifiers of the image pairs.
+// @param rel_tvecs       Relative translation for each image pair.
+// @param qvecs           Absolute rotation for each image.
+// @param proj_centers    Estimated projection center for each image.
+// @param inlier_mask     Whether the relative translation of an image pair is
+//                        consistent with the estimated projection centers.
+//
+// @return                Whether the projection centers were estimated
+//                        successfully.
+bool AverageTranslations(
+    const TranslationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector3d>& rel_tvecs,
+    const EIGEN_STL_UMAP(image_t, Eigen::Vector4d) & qvecs,
+    std::unordered_map<image_t, Eigen::Vector3d>* proj_centers,
+    std::vector<char>* inlier_mask);
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_ESTIMATORS_MOTION_AVERAGING_H_
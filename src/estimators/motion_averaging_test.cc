@@ -0,0 +1,220 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "estimators/motion_averaging"
+#include "util/testing.h"
+
+#include <Eigen/Geometry>
+
+#include "base/pose.h"
+#include "estimators/motion_averaging.h"
+#include "util/math.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+Eigen::Matrix3d RandomRotationMatrix(const double max_angle) {
+  const Eigen::Vector3d axis(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                             RandomReal(-1.0, 1.0));
+  return Eigen::AngleAxisd(RandomReal(0.0, max_angle), axis.normalized())
+      .toRotationMatrix();
+}
+
+struct SyntheticScene {
+  std::vector<Eigen::Matrix3d> rot_mats;
+  std::vector<Eigen::Vector3d> proj_centers;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<bool> outlier_pairs;
+};
+
+SyntheticScene GenerateScene(const size_t num_images,
+                             const size_t num_neighbors) {
+  SetPRNGSeed(0);
+
+  SyntheticScene scene;
+  for (size_t i = 0; i < num_images; ++i) {
+    scene.rot_mats.push_back(RandomRotationMatrix(M_PI));
+    scene.proj_centers.emplace_back(RandomReal(-10.0, 10.0),
+                                    RandomReal(-10.0, 10.0),
+                                    RandomReal(-10.0, 10.0));
+  }
+
+  for (size_t i = 0; i < num_images; ++i) {
+    for (size_t j = i + 1; j < std::min(num_images, i + num_neighbors + 1);
+         ++j) {
+      scene.image_pairs.emplace_back(i, j);
+      scene.outlier_pairs.push_back(scene.image_pairs.size() % 10 == 0);
+    }
+  }
+
+  return scene;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestAverageRotations) {
+  const SyntheticScene scene = GenerateScene(30, 5);
+
+  std::vector<Eigen::Vector4d> rel_qvecs;
+  std::vector<double> weights;
+  for (size_t k = 0; k < scene.image_pairs.size(); ++k) {
+    const auto& image_pair = scene.image_pairs[k];
+    Eigen::Matrix3d rel_rot_mat = scene.rot_mats[image_pair.second] *
+                                  scene.rot_mats[image_pair.first].transpose();
+    if (scene.outlier_pairs[k]) {
+      rel_rot_mat = RandomRotationMatrix(M_PI) * rel_rot_mat;
+    } else {
+      rel_rot_mat = RandomRotationMatrix(DegToRad(0.5)) * rel_rot_mat;
+    }
+    rel_qvecs.push_back(RotationMatrixToQuaternion(rel_rot_mat));
+    weights.push_back(scene.outlier_pairs[k] ? 1000 : 100);
+  }
+
+  RotationAveragingOptions options;
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) qvecs;
+  std::vector<char> inlier_mask;
+  BOOST_CHECK(AverageRotations(options, scene.image_pairs, rel_qvecs, weights,
+                               &qvecs, &inlier_mask));
+  BOOST_CHECK_EQUAL(qvecs.size(), scene.rot_mats.size());
+  BOOST_CHECK_EQUAL(inlier_mask.size(), scene.image_pairs.size());
+
+  for (size_t k = 0; k < scene.image_pairs.size(); ++k) {
+    BOOST_CHECK_EQUAL(inlier_mask[k], !scene.outlier_pairs[k]);
+  }
+
+  for (size_t i = 0; i < scene.rot_mats.size(); ++i) {
+    for (size_t j = i + 1; j < scene.rot_mats.size(); ++j) {
+      const Eigen::Matrix3d rel_rot_mat =
+          QuaternionToRotationMatrix(qvecs.at(j)) *
+          QuaternionToRotationMatrix(qvecs.at(i)).transpose();
+      const Eigen::Matrix3d true_rel_rot_mat =
+          scene.rot_mats[j] * scene.rot_mats[i].transpose();
+      const double error =
+          Eigen::AngleAxisd(rel_rot_mat.transpose() * true_rel_rot_mat).angle();
+      BOOST_CHECK_LT(RadToDeg(error), 1.0);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestAverageRotationsLargestComponent) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {1, 2}, {2, 3}, {4, 5}};
+  const std::vector<Eigen::Vector4d> rel_qvecs(3, ComposeIdentityQuaternion());
+  const std::vector<double> weights(3, 1);
+
+  RotationAveragingOptions options;
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) qvecs;
+  std::vector<char> inlier_mask;
+  BOOST_CHECK(AverageRotations(options, image_pairs, rel_qvecs, weights,
+                               &qvecs, &inlier_mask));
+  BOOST_CHECK_EQUAL(qvecs.size(), 3);
+  BOOST_CHECK(qvecs.count(1));
+  BOOST_CHECK(qvecs.count(2));
+  BOOST_CHECK(qvecs.count(3));
+  BOOST_CHECK(inlier_mask[0]);
+  BOOST_CHECK(inlier_mask[1]);
+  BOOST_CHECK(!inlier_mask[2]);
+}
+
+BOOST_AUTO_TEST_CASE(TestAverageTranslations) {
+  const SyntheticScene scene = GenerateScene(30, 5);
+
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) qvecs;
+  for (size_t i = 0; i < scene.rot_mats.size(); ++i) {
+    qvecs.emplace(i, RotationMatrixToQuaternion(scene.rot_mats[i]));
+  }
+
+  std::vector<Eigen::Vector3d> rel_tvecs;
+  for (size_t k = 0; k < scene.image_pairs.size(); ++k) {
+    const auto& image_pair = scene.image_pairs[k];
+    const Eigen::Vector3d rel_tvec =
+        scene.rot_mats[image_pair.second] *
+        (scene.proj_centers[image_pair.first] -
+         scene.proj_centers[image_pair.second]);
+    if (scene.outlier_pairs[k]) {
+      rel_tvecs.push_back(-rel_tvec.normalized());
+    } else {
+      rel_tvecs.push_back(RandomRotationMatrix(DegToRad(0.5)) *
+                          rel_tvec.normalized());
+    }
+  }
+
+  TranslationAveragingOptions options;
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  std::vector<char> inlier_mask;
+  BOOST_CHECK(AverageTranslations(options, scene.image_pairs, rel_tvecs, qvecs,
+                                  &proj_centers, &inlier_mask));
+  BOOST_CHECK_EQUAL(proj_centers.size(), scene.proj_centers.size());
+  BOOST_CHECK_EQUAL(inlier_mask.size(), scene.image_pairs.size());
+
+  for (size_t k = 0; k < scene.image_pairs.size(); ++k) {
+    BOOST_CHECK_EQUAL(inlier_mask[k], !scene.outlier_pairs[k]);
+  }
+
+  // The projection centers are estimated up to a translation and scale, so
+  // that the directions between all projection centers must be the same.
+  for (size_t i = 0; i < scene.proj_centers.size(); ++i) {
+    for (size_t j = i + 1; j < scene.proj_centers.size(); ++j) {
+      const Eigen::Vector3d direction =
+          (proj_centers.at(j) - proj_centers.at(i)).normalized();
+      const Eigen::Vector3d true_direction =
+          (scene.proj_centers[j] - scene.proj_centers[i]).normalized();
+      BOOST_CHECK_GT(direction.dot(true_direction), std::cos(DegToRad(2.0)));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestAverageTranslationsMissingRotations) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {1, 2}, {2, 3}, {1, 3}};
+  const std::vector<Eigen::Vector3d> rel_tvecs = {
+      Eigen::Vector3d(1, 0, 0), Eigen::Vector3d(0, 1, 0),
+      Eigen::Vector3d(0, 0, 1)};
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) qvecs;
+  qvecs.emplace(1, ComposeIdentityQuaternion());
+  qvecs.emplace(2, ComposeIdentityQuaternion());
+
+  TranslationAveragingOptions options;
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  std::vector<char> inlier_mask;
+  BOOST_CHECK(AverageTranslations(options, image_pairs, rel_tvecs, qvecs,
+                                  &proj_centers, &inlier_mask));
+  BOOST_CHECK_EQUAL(proj_centers.size(), 2);
+  BOOST_CHECK(inlier_mask[0]);
+  BOOST_CHECK(!inlier_mask[1]);
+  BOOST_CHECK(!inlier_mask[2]);
+  BOOST_CHECK_GT(
+      (proj_centers.at(1) - proj_centers.at(2)).normalized().dot(
+          Eigen::Vector3d(1, 0, 0)),
+      0.99);
+}
@@ -31,6 +31,8 @@
 
 #include "estimators/pose.h"
 
+#include <Eigen/Geometry>
+
 #include "base/camera_models.h"
 #include "base/cost_functions.h"
 #include "base/essential_matrix.h"
@@ -38,6 +40,7 @@
 #include "estimators/absolute_pose.h"
 #include "estimators/essential_matrix.h"
 #include "optim/bundle_adjustment.h"
+#include "optim/levenberg_marquardt.h"
 #include "util/matrix.h"
 #include "util/misc.h"
 #include "util/threading.h"
@@ -52,6 +55,7 @@ void EstimateAbsolutePoseKernel(const Camera& camera,
                                 const std::vector<Eigen::Vector2d>& points2D,
                                 const std::vector<Eigen::Vector3d>& points3D,
                                 const RANSACOptions& options,
+                                const bool progressive_sampling,
                                 AbsolutePoseRANSAC::Report* report) {
   // Scale the focal length by the given factor.
   Camera scaled_camera = camera;
@@ -61,19 +65,312 @@ void EstimateAbsolutePoseKernel(const Camera& camera,
   }
 
   // Normalize image coordinates with current camera hypothesis.
-  std::vector<Eigen::Vector2d> points2D_N(points2D.size());
-  for (size_t i = 0; i < points2D.size(); ++i) {
-    points2D_N[i] = scaled_camera.ImageToWorld(points2D[i]);
-  }
+  std::vector<Eigen::Vector2d> points2D_N;
+  scaled_camera.ImageToWorld(points2D, &points2D_N);
 
   // Estimate pose for given focal length.
   auto custom_options = options;
   custom_options.max_error =
       scaled_camera.ImageToWorldThreshold(options.max_error);
-  AbsolutePoseRANSAC ransac(custom_options);
-  *report = ransac.Estimate(points2D_N, points3D);
+  *report = EstimateLORANSAC<P3PEstimator, EPNPEstimator>(
+      custom_options, points2D_N, points3D, progressive_sampling);
+}
+
+// Rotate the quaternion by the rotation with the given angle-axis vector from
+// the left, i.e. R' = exp([omega]_x) * R.
+Eigen::Vector4d RotateQuaternion(const Eigen::Vector4d& qvec,
+                                 const Eigen::Vector3d& omega) {
+  const double angle = omega.norm();
+  const Eigen::Quaterniond delta_quat =
+      angle > 0 ? Eigen::Quaterniond(Eigen::AngleAxisd(angle, omega / angle))
+                : Eigen::Quaterniond::Identity();
+  const Eigen::Quaterniond quat =
+      (delta_quat * Eigen::Quaterniond(qvec(0), qvec(1), qvec(2), qvec(3)))
+          .normalized();
+  return Eigen::Vector4d(quat.w(), quat.x(), quat.y(), quat.z());
+}
+
+// The Cauchy loss rho(s) = b * log(1 + s / b) with b = scale^2 as defined in
+// Ceres, and its derivative, which weights the normal equations.
+inline double CauchyLoss(const double squared_scale, const double s) {
+  return squared_scale * std::log1p(s / squared_scale);
+}
+
+inline double CauchyLossWeight(const double squared_scale, const double s) {
+  return 1 / (1 + s / squared_scale);
+}
+
+// Transform normalized to image coordinates and compute the derivative w.r.t.
+// the normalized coordinates (2x2, row-major), analytically if possible and
+// otherwise with automatic differentiation.
+template <typename CameraModel>
+void WorldToImageWithJacobian(const double* params, const double u,
+                              const double v, double* x, double* y,
+                              double* J_uv, std::true_type) {
+  double J_params[2 * CameraModel::kNumParams];
+  AnalyticCameraModel<CameraModel>::WorldToImage(params, u, v, x, y, J_uv,
+                                                 J_params);
+}
+
+template <typename CameraModel>
+void WorldToImageWithJacobian(const double* params, const double u,
+                              const double v, double* x, double* y,
+                              double* J_uv, std::false_type) {
+  typedef ceres::Jet<double, 2> JetT;
+  JetT params_jet[CameraModel::kNumParams];
+  for (size_t i = 0; i < CameraModel::kNumParams; ++i) {
+    params_jet[i] = JetT(params[i]);
+  }
+  JetT x_jet;
+  JetT y_jet;
+  CameraModel::WorldToImage(params_jet, JetT(u, 0), JetT(v, 1), &x_jet,
+                            &y_jet);
+  *x = x_jet.a;
+  *y = y_jet.a;
+  J_uv[0] = x_jet.v[0];
+  J_uv[1] = x_jet.v[1];
+  J_uv[2] = y_jet.v[0];
+  J_uv[3] = y_jet.v[1];
+}
+
+// Robust re-projection error of the inlier 2D-3D correspondences w.r.t. the
+// 6-DoF pose of a camera with constant parameters. The rotation is updated
+// from the left and the translation additively.
+template <typename CameraModel>
+class AbsolutePoseRefinementProblem {
+ public:
+  struct Parameters {
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+  };
+
+  AbsolutePoseRefinementProblem(const std::vector<char>& inlier_mask,
+                                const std::vector<Eigen::Vector2d>& points2D,
+                                const std::vector<Eigen::Vector3d>& points3D,
+                                const double* camera_params,
+                                const double loss_function_scale)
+      : inlier_mask_(inlier_mask),
+        points2D_(points2D),
+        points3D_(points3D),
+        camera_params_(camera_params),
+        squared_scale_(loss_function_scale * loss_function_scale),
+        num_residuals_(0) {
+    for (const char is_inlier : inlier_mask_) {
+      if (is_inlier) {
+        num_residuals_ += 2;
+      }
+    }
+  }
+
+  double Evaluate(const Parameters& params, Eigen::Matrix<double, 6, 6>* H,
+                  Eigen::Vector6d* g) const {
+    const Eigen::Matrix3d R = QuaternionToRotationMatrix(params.qvec);
+
+    if (H != nullptr) {
+      H->setZero();
+      g->setZero();
+    }
+
+    double cost = 0;
+    for (size_t i = 0; i < points2D_.size(); ++i) {
+      if (!inlier_mask_[i]) {
+        continue;
+      }
+
+      const Eigen::Vector3d RX = R * points3D_[i];
+      const Eigen::Vector3d X = RX + params.tvec;
+
+      const double inv_z = 1 / X.z();
+      const double u = X.x() * inv_z;
+      const double v = X.y() * inv_z;
+
+      Eigen::Vector2d residual;
+      double J_uv[4];
+      WorldToImageWithJacobian<CameraModel>(
+          camera_params_, u, v, &residual.x(), &residual.y(), J_uv,
+          AnalyticCameraModel<CameraModel>());
+      residual -= points2D_[i];
+
+      const double squared_norm = residual.squaredNorm();
+      cost += 0.5 * CauchyLoss(squared_scale_, squared_norm);
+
+      if (H == nullptr) {
+        continue;
+      }
+
+      Eigen::Matrix<double, 2, 3> J_X;
+      J_X << J_uv[0] * inv_z, J_uv[1] * inv_z,
+          -(J_uv[0] * u + J_uv[1] * v) * inv_z, J_uv[2] * inv_z,
+          J_uv[3] * inv_z, -(J_uv[2] * u + J_uv[3] * v) * inv_z;
+
+      Eigen::Matrix<double, 2, 6> J;
+      J.leftCols<3>() = -J_X * CrossProductMatrix(RX);
+      J.rightCols<3>() = J_X;
+
+      const double weight = CauchyLossWeight(squared_scale_, squared_norm);
+      H->noalias() += weight * J.transpose() * J;
+      g->noalias() += weight * J.transpose() * residual;
+    }
+
+    return cost;
+  }
+
+  Parameters Plus(const Parameters& params, const Eigen::Vector6d& step) const {
+    Parameters new_params;
+    new_params.qvec = RotateQuaternion(params.qvec, step.head<3>());
+    new_params.tvec = params.tvec + step.tail<3>();
+    return new_params;
+  }
+
+  double Norm(const Parameters& params) const {
+    return std::sqrt(params.qvec.squaredNorm() + params.tvec.squaredNorm());
+  }
+
+  size_t NumResiduals() const { return num_residuals_; }
+
+ private:
+  const std::vector<char>& inlier_mask_;
+  const std::vector<Eigen::Vector2d>& points2D_;
+  const std::vector<Eigen::Vector3d>& points3D_;
+  const double* camera_params_;
+  const double squared_scale_;
+  size_t num_residuals_;
+};
+
+template <typename CameraModel>
+LevenbergMarquardtSummary RefineAbsolutePoseKernel(
+    const LevenbergMarquardtOptions& options,
+    const std::vector<char>& inlier_mask,
+    const std::vector<Eigen::Vector2d>& points2D,
+    const std::vector<Eigen::Vector3d>& points3D,
+    const double loss_function_scale, const Camera& camera,
+    Eigen::Vector4d* qvec, Eigen::Vector3d* tvec) {
+  const AbsolutePoseRefinementProblem<CameraModel> problem(
+      inlier_mask, points2D, points3D, camera.ParamsData(),
+      loss_function_scale);
+  typename AbsolutePoseRefinementProblem<CameraModel>::Parameters params;
+  params.qvec = *qvec;
+  params.tvec = *tvec;
+  const LevenbergMarquardtSummary summary =
+      SolveLevenbergMarquardt<6>(options, problem, &params);
+  *qvec = params.qvec;
+  *tvec = params.tvec;
+  return summary;
+}
+
+// Orthonormal basis of the tangent space of the unit sphere at the given unit
+// vector, which is a deterministic function of the vector.
+Eigen::Matrix<double, 3, 2> SphereTangentBasis(const Eigen::Vector3d& vec) {
+  int min_idx;
+  vec.cwiseAbs().minCoeff(&min_idx);
+  Eigen::Matrix<double, 3, 2> basis;
+  basis.col(0) = vec.cross(Eigen::Vector3d::Unit(min_idx)).normalized();
+  basis.col(1) = vec.cross(basis.col(0));
+  return basis;
+}
+
+// Derivative of trace(A * [w]_x) w.r.t. w.
+inline Eigen::Vector3d CrossProductTraceJacobian(const Eigen::Matrix3d& A) {
+  return Eigen::Vector3d(A(1, 2) - A(2, 1), A(2, 0) - A(0, 2),
+                         A(0, 1) - A(1, 0));
 }
 
+// Robust squared Sampson error of the normalized correspondences w.r.t. the
+// 5-DoF relative pose, where the unit translation is updated on the sphere.
+// Same residuals and loss as `RelativePoseCostFunction`.
+class RelativePoseRefinementProblem {
+ public:
+  struct Parameters {
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+  };
+
+  RelativePoseRefinementProblem(const std::vector<Eigen::Vector2d>& points1,
+                                const std::vector<Eigen::Vector2d>& points2,
+                                const double loss_function_scale)
+      : points1_(points1),
+        points2_(points2),
+        squared_scale_(loss_function_scale * loss_function_scale) {}
+
+  double Evaluate(const Parameters& params,
+                  Eigen::Matrix<double, 5, 5>* H,
+                  Eigen::Matrix<double, 5, 1>* g) const {
+    const Eigen::Matrix3d R = QuaternionToRotationMatrix(params.qvec);
+    const Eigen::Matrix3d t_x = CrossProductMatrix(params.tvec);
+    const Eigen::Matrix3d E = t_x * R;
+
+    Eigen::Matrix<double, 3, 2> tangent_basis;
+    if (H != nullptr) {
+      H->setZero();
+      g->setZero();
+      tangent_basis = SphereTangentBasis(params.tvec);
+    }
+
+    double cost = 0;
+    for (size_t i = 0; i < points1_.size(); ++i) {
+      const Eigen::Vector3d x1 = points1_[i].homogeneous();
+      const Eigen::Vector3d x2 = points2_[i].homogeneous();
+
+      const Eigen::Vector3d Ex1 = E * x1;
+      const Eigen::Vector3d Etx2 = E.transpose() * x2;
+      const double x2tEx1 = x2.dot(Ex1);
+      const double denom = Ex1(0) * Ex1(0) + Ex1(1) * Ex1(1) +
+                           Etx2(0) * Etx2(0) + Etx2(1) * Etx2(1);
+      const double residual = x2tEx1 * x2tEx1 / denom;
+
+      const double squared_norm = residual * residual;
+      cost += 0.5 * CauchyLoss(squared_scale_, squared_norm);
+
+      if (H == nullptr) {
+        continue;
+      }
+
+      // Derivative of the residual w.r.t. the essential matrix.
+      const Eigen::Vector3d Ex1_xy(Ex1(0), Ex1(1), 0);
+      const Eigen::Vector3d Etx2_xy(Etx2(0), Etx2(1), 0);
+      const Eigen::Matrix3d J_E =
+          (2 * x2tEx1 / denom) * x2 * x1.transpose() -
+          (2 * residual / denom) *
+              (Ex1_xy * x1.transpose() + x2 * Etx2_xy.transpose());
+
+      // With dE = [t]_x * [w]_x * R for the rotation and dE = [dt]_x * R for
+      // the translation, the derivatives follow from trace(J_E^T * dE).
+      const Eigen::Matrix3d RJ_Et = R * J_E.transpose();
+      Eigen::Matrix<double, 1, 5> J;
+      J.leftCols<3>() = CrossProductTraceJacobian(RJ_Et * t_x).transpose();
+      J.rightCols<2>() =
+          CrossProductTraceJacobian(RJ_Et).transpose() * tangent_basis;
+
+      const double weight = CauchyLossWeight(squared_scale_, squared_norm);
+      H->noalias() += weight * J.transpose() * J;
+      g->noalias() += weight * residual * J.transpose();
+    }
+
+    return cost;
+  }
+
+  Parameters Plus(const Parameters& params,
+                  const Eigen::Matrix<double, 5, 1>& step) const {
+    Parameters new_params;
+    new_params.qvec = RotateQuaternion(params.qvec, step.head<3>());
+    new_params.tvec =
+        (params.tvec + SphereTangentBasis(params.tvec) * step.tail<2>())
+            .normalized();
+    return new_params;
+  }
+
+  double Norm(const Parameters& params) const {
+    return std::sqrt(params.qvec.squaredNorm() + params.tvec.squaredNorm());
+  }
+
+  size_t NumResiduals() const { return points1_.size(); }
+
+ private:
+  const std::vector<Eigen::Vector2d>& points1_;
+  const std::vector<Eigen::Vector2d>& points2_;
+  const double squared_scale_;
+};
+
 }  // namespace
 
 bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
@@ -108,13 +405,20 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
       reports;
   reports.resize(focal_length_factors.size());
 
+  // Without focal length estimation, the threads are instead used to
+  // evaluate the RANSAC hypotheses in parallel.
+  RANSACOptions ransac_options = options.ransac_options;
+  if (focal_length_factors.size() == 1) {
+    ransac_options.num_threads = options.num_threads;
+  }
+
   ThreadPool thread_pool(std::min(
       options.num_threads, static_cast<int>(focal_length_factors.size())));
 
   for (size_t i = 0; i < focal_length_factors.size(); ++i) {
     futures[i] = thread_pool.AddTask(
         EstimateAbsolutePoseKernel, *camera, focal_length_factors[i], points2D,
-        points3D, options.ransac_options, &reports[i]);
+        points3D, ransac_options, options.progressive_sampling, &reports[i]);
   }
 
   double focal_length_factor = 0;
@@ -205,6 +509,41 @@ bool RefineAbsolutePose(const AbsolutePoseRefinementOptions& options,
   CHECK_EQ(points2D.size(), points3D.size());
   options.Check();
 
+  // Without refinement of the camera parameters, the 6-DoF pose is refined
+  // with a lightweight solver, which avoids the setup costs of Ceres.
+  const bool refine_focal_length =
+      options.refine_focal_length && !camera->FocalLengthIdxs().empty();
+  const bool refine_extra_params =
+      options.refine_extra_params && !camera->ExtraParamsIdxs().empty();
+  if (!refine_focal_length && !refine_extra_params) {
+    *qvec = NormalizeQuaternion(*qvec);
+
+    LevenbergMarquardtOptions solver_options;
+    solver_options.gradient_tolerance = options.gradient_tolerance;
+    solver_options.max_num_iterations = options.max_num_iterations;
+
+    LevenbergMarquardtSummary summary;
+    switch (camera->ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                     \
+  case CameraModel::kModelId:                              \
+    summary = RefineAbsolutePoseKernel<CameraModel>(       \
+        solver_options, inlier_mask, points2D, points3D,   \
+        options.loss_function_scale, *camera, qvec, tvec); \
+    break;
+
+      CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+    }
+
+    if (options.print_summary) {
+      PrintHeading2("Pose refinement report");
+      PrintLevenbergMarquardtSummary(summary, 6);
+    }
+
+    return summary.IsSolutionUsable();
+  }
+
   ceres::LossFunction* loss_function =
       new ceres::CauchyLoss(options.loss_function_scale);
 
@@ -320,31 +659,24 @@ bool RefineRelativePose(const ceres::Solver::Options& options,
                         Eigen::Vector4d* qvec, Eigen::Vector3d* tvec) {
   CHECK_EQ(points1.size(), points2.size());
 
-  // CostFunction assumes unit quaternions.
-  *qvec = NormalizeQuaternion(*qvec);
-
   const double kMaxL2Error = 1.0;
-  ceres::LossFunction* loss_function = new ceres::CauchyLoss(kMaxL2Error);
-
-  ceres::Problem problem;
-
-  for (size_t i = 0; i < points1.size(); ++i) {
-    ceres::CostFunction* cost_function =
-        RelativePoseCostFunction::Create(points1[i], points2[i]);
-    problem.AddResidualBlock(cost_function, loss_function, qvec->data(),
-                             tvec->data());
-  }
+  const RelativePoseRefinementProblem problem(points1, points2, kMaxL2Error);
 
-  ceres::LocalParameterization* quaternion_parameterization =
-      new ceres::QuaternionParameterization;
-  problem.SetParameterization(qvec->data(), quaternion_parameterization);
-
-  ceres::HomogeneousVectorParameterization* homogeneous_parameterization =
-      new ceres::HomogeneousVectorParameterization(3);
-  problem.SetParameterization(tvec->data(), homogeneous_parameterization);
-
-  ceres::Solver::Summary summary;
-  ceres::Solve(options, &problem, &summary);
+  // The 5-DoF pose is refined with a lightweight solver instead of Ceres, of
+  // which only the iteration limit and the tolerances are used.
+  LevenbergMarquardtOptions solver_options;
+  solver_options.max_num_iterations = options.max_num_iterations;
+  solver_options.gradient_tolerance = options.gradient_tolerance;
+  solver_options.function_tolerance = options.function_tolerance;
+  solver_options.parameter_tolerance = options.parameter_tolerance;
+
+  RelativePoseRefinementProblem::Parameters params;
+  params.qvec = NormalizeQuaternion(*qvec);
+  params.tvec = tvec->normalized();
+  const LevenbergMarquardtSummary summary =
+      SolveLevenbergMarquardt<5>(solver_options, problem, &params);
+  *qvec = params.qvec;
+  *tvec = params.tvec;
 
   return summary.IsSolutionUsable();
 }
@@ -66,6 +66,10 @@ struct AbsolutePoseEstimationOptions {
   // Number of threads for parallel estimation of focal length.
   int num_threads = ThreadPool::kMaxNumThreads;
 
+  // Whether to draw the RANSAC samples with PROSAC, which requires the 2D-3D
+  // correspondences to be sorted by quality in descending order.
+  bool progressive_sampling = false;
+
   // Options used for P3P RANSAC.
   RANSACOptions ransac_options;
 
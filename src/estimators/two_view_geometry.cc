@@ -50,6 +50,50 @@
 namespace colmap {
 namespace {
 
+typedef LORANSAC<FundamentalMatrixSevenPointEstimator,
+                 FundamentalMatrixEightPointEstimator>
+    FundamentalMatrixRANSAC;
+
+// Screen the matches for the early exit stage by estimating the fundamental
+// matrix with a bounded number of trials. Returns false, if the matches are
+// rejected. Otherwise, the report is reusable, if the estimation converged.
+bool ScreenFundamentalMatrix(const std::vector<Eigen::Vector2d>& points1,
+                             const std::vector<Eigen::Vector2d>& points2,
+                             const bool progressive_sampling,
+                             const TwoViewGeometry::Options& options,
+                             FundamentalMatrixRANSAC::Report* report,
+                             bool* converged) {
+  RANSACOptions ransac_options = options.ransac_options;
+  ransac_options.max_num_trials = std::min(ransac_options.max_num_trials,
+                                           options.early_exit_max_num_trials);
+  ransac_options.min_num_trials =
+      std::min(ransac_options.min_num_trials, ransac_options.max_num_trials);
+
+  *report = EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                             FundamentalMatrixEightPointEstimator>(
+      ransac_options, points1, points2, progressive_sampling);
+
+  // Terminating before the maximum number of trials means that the dynamic
+  // stopping criterion was met, i.e. more trials would not change the result.
+  *converged = report->num_trials < ransac_options.max_num_trials;
+
+  return report->success &&
+         report->support.num_inliers >= options.min_num_inliers;
+}
+
+// Sort the matches by their score for progressive sampling, if enabled and all
+// matches have a score. Returns false, if the matches are not sorted.
+bool SortMatchesForSampling(const FeatureMatches& matches,
+                            const TwoViewGeometry::Options& options,
+                            FeatureMatches* sorted_matches) {
+  if (!options.progressive_sampling || !HasMatchScores(matches)) {
+    return false;
+  }
+  *sorted_matches = matches;
+  SortMatchesByScore(sorted_matches);
+  return true;
+}
+
 FeatureMatches ExtractInlierMatches(const FeatureMatches& matches,
                                     const size_t num_inliers,
                                     const std::vector<char>& inlier_mask) {
@@ -94,6 +138,149 @@ inline bool IsImagePointInBoundingBox(const Eigen::Vector2d& point,
          point.y() <= maxy;
 }
 
+// Support of an estimated model, independent of how the model was estimated.
+struct ModelSupport {
+  bool success = false;
+  size_t num_inliers = 0;
+  std::vector<char> inlier_mask;
+};
+
+template <typename Report>
+ModelSupport ModelSupportFromReport(const Report& report) {
+  ModelSupport support;
+  support.success = report.success;
+  support.num_inliers = report.support.num_inliers;
+  support.inlier_mask = report.inlier_mask;
+  return support;
+}
+
+// Determine the configuration of a calibrated image pair from the support of
+// its essential, fundamental, and homography matrices.
+void DetermineCalibratedConfiguration(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& matched_points1,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& matched_points2,
+    const FeatureMatches& matches, const ModelSupport& E_support,
+    const ModelSupport& F_support, const ModelSupport& H_support,
+    const TwoViewGeometry::Options& options,
+    TwoViewGeometry* two_view_geometry) {
+  if ((!E_support.success && !F_support.success && !H_support.success) ||
+      (E_support.num_inliers < options.min_num_inliers &&
+       F_support.num_inliers < options.min_num_inliers &&
+       H_support.num_inliers < options.min_num_inliers)) {
+    two_view_geometry->config = TwoViewGeometry::DEGENERATE;
+    return;
+  }
+
+  // Determine inlier ratios of different models.
+
+  const double E_F_inlier_ratio =
+      static_cast<double>(E_support.num_inliers) / F_support.num_inliers;
+  const double H_F_inlier_ratio =
+      static_cast<double>(H_support.num_inliers) / F_support.num_inliers;
+  const double H_E_inlier_ratio =
+      static_cast<double>(H_support.num_inliers) / E_support.num_inliers;
+
+  const std::vector<char>* best_inlier_mask = nullptr;
+  size_t num_inliers = 0;
+
+  if (E_support.success && E_F_inlier_ratio > options.min_E_F_inlier_ratio &&
+      E_support.num_inliers >= options.min_num_inliers) {
+    // Calibrated configuration.
+
+    // Always use the model with maximum matches.
+    if (E_support.num_inliers >= F_support.num_inliers) {
+      num_inliers = E_support.num_inliers;
+      best_inlier_mask = &E_support.inlier_mask;
+    } else {
+      num_inliers = F_support.num_inliers;
+      best_inlier_mask = &F_support.inlier_mask;
+    }
+
+    if (H_E_inlier_ratio > options.max_H_inlier_ratio) {
+      two_view_geometry->config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+      if (H_support.num_inliers > num_inliers) {
+        num_inliers = H_support.num_inliers;
+        best_inlier_mask = &H_support.inlier_mask;
+      }
+    } else {
+      two_view_geometry->config = TwoViewGeometry::CALIBRATED;
+    }
+  } else if (F_support.success &&
+             F_support.num_inliers >= options.min_num_inliers) {
+    // Uncalibrated configuration.
+
+    num_inliers = F_support.num_inliers;
+    best_inlier_mask = &F_support.inlier_mask;
+
+    if (H_F_inlier_ratio > options.max_H_inlier_ratio) {
+      two_view_geometry->config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+      if (H_support.num_inliers > num_inliers) {
+        num_inliers = H_support.num_inliers;
+        best_inlier_mask = &H_support.inlier_mask;
+      }
+    } else {
+      two_view_geometry->config = TwoViewGeometry::UNCALIBRATED;
+    }
+  } else if (H_support.success &&
+             H_support.num_inliers >= options.min_num_inliers) {
+    num_inliers = H_support.num_inliers;
+    best_inlier_mask = &H_support.inlier_mask;
+    two_view_geometry->config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  } else {
+    two_view_geometry->config = TwoViewGeometry::DEGENERATE;
+    return;
+  }
+
+  if (best_inlier_mask != nullptr) {
+    two_view_geometry->inlier_matches =
+        ExtractInlierMatches(matches, num_inliers, *best_inlier_mask);
+
+    if (options.detect_watermark &&
+        TwoViewGeometry::DetectWatermark(camera1, matched_points1, camera2,
+                                         matched_points2, num_inliers,
+                                         *best_inlier_mask, options)) {
+      two_view_geometry->config = TwoViewGeometry::WATERMARK;
+    }
+  }
+}
+
+// Determine the configuration of an uncalibrated image pair from the support
+// of its fundamental and homography matrices.
+void DetermineUncalibratedConfiguration(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& matched_points1,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& matched_points2,
+    const FeatureMatches& matches, const ModelSupport& F_support,
+    const ModelSupport& H_support, const TwoViewGeometry::Options& options,
+    TwoViewGeometry* two_view_geometry) {
+  if ((!F_support.success && !H_support.success) ||
+      (F_support.num_inliers < options.min_num_inliers &&
+       H_support.num_inliers < options.min_num_inliers)) {
+    two_view_geometry->config = TwoViewGeometry::DEGENERATE;
+    return;
+  }
+
+  // Determine inlier ratios of different models.
+
+  const double H_F_inlier_ratio =
+      static_cast<double>(H_support.num_inliers) / F_support.num_inliers;
+
+  if (H_F_inlier_ratio > options.max_H_inlier_ratio) {
+    two_view_geometry->config = TwoViewGeometry::PLANAR_OR_PANORAMIC;
+  } else {
+    two_view_geometry->config = TwoViewGeometry::UNCALIBRATED;
+  }
+
+  two_view_geometry->inlier_matches = ExtractInlierMatches(
+      matches, F_support.num_inliers, F_support.inlier_mask);
+
+  if (options.detect_watermark &&
+      TwoViewGeometry::DetectWatermark(camera1, matched_points1, camera2,
+                                       matched_points2, F_support.num_inliers,
+                                       F_support.inlier_mask, options)) {
+    two_view_geometry->config = TwoViewGeometry::WATERMARK;
+  }
+}
+
 }  // namespace
 
 void TwoViewGeometry::Invert() {
@@ -123,16 +310,49 @@ void TwoViewGeometry::Estimate(const Camera& camera1,
   }
 }
 
+void TwoViewGeometry::Estimate(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points1_normalized,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector2d>& points2_normalized,
+    const FeatureMatches& matches, const Options& options) {
+  if (camera1.HasPriorFocalLength() && camera2.HasPriorFocalLength()) {
+    EstimateCalibrated(camera1, points1, points1_normalized, camera2, points2,
+                       points2_normalized, matches, options);
+  } else {
+    EstimateUncalibrated(camera1, points1, camera2, points2, matches, options);
+  }
+}
+
+void TwoViewGeometry::EstimateMultiple(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& points1,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& points2,
+    const FeatureMatches& matches, const Options& options) {
+  // The normalized points are only needed in the calibrated case, where they
+  // are reused by all recursive estimations.
+  std::vector<Eigen::Vector2d> points1_normalized;
+  std::vector<Eigen::Vector2d> points2_normalized;
+  if (camera1.HasPriorFocalLength() && camera2.HasPriorFocalLength()) {
+    camera1.ImageToWorld(points1, &points1_normalized);
+    camera2.ImageToWorld(points2, &points2_normalized);
+  }
+  EstimateMultiple(camera1, points1, points1_normalized, camera2, points2,
+                   points2_normalized, matches, options);
+}
+
 void TwoViewGeometry::EstimateMultiple(
     const Camera& camera1, const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points1_normalized,
     const Camera& camera2, const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector2d>& points2_normalized,
     const FeatureMatches& matches, const Options& options) {
   FeatureMatches remaining_matches = matches;
   std::vector<TwoViewGeometry> two_view_geometries;
   while (true) {
     TwoViewGeometry two_view_geometry;
-    two_view_geometry.Estimate(camera1, points1, camera2, points2,
-                               remaining_matches, options);
+    two_view_geometry.Estimate(camera1, points1, points1_normalized, camera2,
+                               points2, points2_normalized, remaining_matches,
+                               options);
     if (two_view_geometry.config == ConfigurationType::DEGENERATE) {
       break;
     }
@@ -179,11 +399,11 @@ bool TwoViewGeometry::EstimateRelativePose(
   std::vector<Eigen::Vector2d> inlier_points2_normalized;
   inlier_points2_normalized.reserve(inlier_matches.size());
   for (const auto& match : inlier_matches) {
-    const point2D_t idx1 = match.point2D_idx1;
-    const point2D_t idx2 = match.point2D_idx2;
-    inlier_points1_normalized.push_back(camera1.ImageToWorld(points1[idx1]));
-    inlier_points2_normalized.push_back(camera2.ImageToWorld(points2[idx2]));
+    inlier_points1_normalized.push_back(points1[match.point2D_idx1]);
+    inlier_points2_normalized.push_back(points2[match.point2D_idx2]);
   }
+  camera1.ImageToWorld(inlier_points1_normalized, &inlier_points1_normalized);
+  camera2.ImageToWorld(inlier_points2_normalized, &inlier_points2_normalized);
 
   Eigen::Matrix3d R;
   std::vector<Eigen::Vector3d> points3D;
@@ -238,128 +458,127 @@ void TwoViewGeometry::EstimateCalibrated(
     return;
   }
 
+  FeatureMatches sorted_matches;
+  const bool progressive_sampling =
+      SortMatchesForSampling(matches, options, &sorted_matches);
+  const FeatureMatches& ordered_matches =
+      progressive_sampling ? sorted_matches : matches;
+
   // Extract corresponding points.
-  std::vector<Eigen::Vector2d> matched_points1(matches.size());
-  std::vector<Eigen::Vector2d> matched_points2(matches.size());
-  std::vector<Eigen::Vector2d> matched_points1_normalized(matches.size());
-  std::vector<Eigen::Vector2d> matched_points2_normalized(matches.size());
-  for (size_t i = 0; i < matches.size(); ++i) {
-    const point2D_t idx1 = matches[i].point2D_idx1;
-    const point2D_t idx2 = matches[i].point2D_idx2;
-    matched_points1[i] = points1[idx1];
-    matched_points2[i] = points2[idx2];
-    matched_points1_normalized[i] = camera1.ImageToWorld(points1[idx1]);
-    matched_points2_normalized[i] = camera2.ImageToWorld(points2[idx2]);
+  std::vector<Eigen::Vector2d> matched_points1(ordered_matches.size());
+  std::vector<Eigen::Vector2d> matched_points2(ordered_matches.size());
+  for (size_t i = 0; i < ordered_matches.size(); ++i) {
+    matched_points1[i] = points1[ordered_matches[i].point2D_idx1];
+    matched_points2[i] = points2[ordered_matches[i].point2D_idx2];
   }
+  std::vector<Eigen::Vector2d> matched_points1_normalized;
+  std::vector<Eigen::Vector2d> matched_points2_normalized;
+  camera1.ImageToWorld(matched_points1, &matched_points1_normalized);
+  camera2.ImageToWorld(matched_points2, &matched_points2_normalized);
+
+  EstimateCalibratedFromMatchedPoints(
+      camera1, matched_points1, matched_points1_normalized, camera2,
+      matched_points2, matched_points2_normalized, ordered_matches,
+      progressive_sampling, options);
+}
 
-  // Estimate epipolar models.
+void TwoViewGeometry::EstimateCalibrated(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& points1,
+    const std::vector<Eigen::Vector2d>& points1_normalized,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& points2,
+    const std::vector<Eigen::Vector2d>& points2_normalized,
+    const FeatureMatches& matches, const Options& options) {
+  options.Check();
 
-  auto E_ransac_options = options.ransac_options;
-  E_ransac_options.max_error =
-      (camera1.ImageToWorldThreshold(options.ransac_options.max_error) +
-       camera2.ImageToWorldThreshold(options.ransac_options.max_error)) /
-      2;
+  if (matches.size() < options.min_num_inliers) {
+    config = ConfigurationType::DEGENERATE;
+    return;
+  }
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      E_ransac(E_ransac_options);
-  const auto E_report =
-      E_ransac.Estimate(matched_points1_normalized, matched_points2_normalized);
-  E = E_report.model;
+  CHECK_EQ(points1.size(), points1_normalized.size());
+  CHECK_EQ(points2.size(), points2_normalized.size());
 
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
-  F = F_report.model;
+  FeatureMatches sorted_matches;
+  const bool progressive_sampling =
+      SortMatchesForSampling(matches, options, &sorted_matches);
+  const FeatureMatches& ordered_matches =
+      progressive_sampling ? sorted_matches : matches;
 
-  // Estimate planar or panoramic model.
+  // Extract corresponding points.
+  std::vector<Eigen::Vector2d> matched_points1(ordered_matches.size());
+  std::vector<Eigen::Vector2d> matched_points2(ordered_matches.size());
+  std::vector<Eigen::Vector2d> matched_points1_normalized(
+      ordered_matches.size());
+  std::vector<Eigen::Vector2d> matched_points2_normalized(
+      ordered_matches.size());
+  for (size_t i = 0; i < ordered_matches.size(); ++i) {
+    const point2D_t point2D_idx1 = ordered_matches[i].point2D_idx1;
+    const point2D_t point2D_idx2 = ordered_matches[i].point2D_idx2;
+    matched_points1[i] = points1[point2D_idx1];
+    matched_points2[i] = points2[point2D_idx2];
+    matched_points1_normalized[i] = points1_normalized[point2D_idx1];
+    matched_points2_normalized[i] = points2_normalized[point2D_idx2];
+  }
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
-  H = H_report.model;
+  EstimateCalibratedFromMatchedPoints(
+      camera1, matched_points1, matched_points1_normalized, camera2,
+      matched_points2, matched_points2_normalized, ordered_matches,
+      progressive_sampling, options);
+}
 
-  if ((!E_report.success && !F_report.success && !H_report.success) ||
-      (E_report.support.num_inliers < options.min_num_inliers &&
-       F_report.support.num_inliers < options.min_num_inliers &&
-       H_report.support.num_inliers < options.min_num_inliers)) {
+void TwoViewGeometry::EstimateCalibratedFromMatchedPoints(
+    const Camera& camera1, const std::vector<Eigen::Vector2d>& matched_points1,
+    const std::vector<Eigen::Vector2d>& matched_points1_normalized,
+    const Camera& camera2, const std::vector<Eigen::Vector2d>& matched_points2,
+    const std::vector<Eigen::Vector2d>& matched_points2_normalized,
+    const FeatureMatches& matches, const bool progressive_sampling,
+    const Options& options) {
+  // Screen the matches before running the more expensive estimators.
+
+  FundamentalMatrixRANSAC::Report F_report;
+  bool F_converged = false;
+  if (options.early_exit &&
+      !ScreenFundamentalMatrix(matched_points1, matched_points2,
+                               progressive_sampling, options, &F_report,
+                               &F_converged)) {
     config = ConfigurationType::DEGENERATE;
     return;
   }
 
-  // Determine inlier ratios of different models.
-
-  const double E_F_inlier_ratio =
-      static_cast<double>(E_report.support.num_inliers) /
-      F_report.support.num_inliers;
-  const double H_F_inlier_ratio =
-      static_cast<double>(H_report.support.num_inliers) /
-      F_report.support.num_inliers;
-  const double H_E_inlier_ratio =
-      static_cast<double>(H_report.support.num_inliers) /
-      E_report.support.num_inliers;
-
-  const std::vector<char>* best_inlier_mask = nullptr;
-  size_t num_inliers = 0;
-
-  if (E_report.success && E_F_inlier_ratio > options.min_E_F_inlier_ratio &&
-      E_report.support.num_inliers >= options.min_num_inliers) {
-    // Calibrated configuration.
-
-    // Always use the model with maximum matches.
-    if (E_report.support.num_inliers >= F_report.support.num_inliers) {
-      num_inliers = E_report.support.num_inliers;
-      best_inlier_mask = &E_report.inlier_mask;
-    } else {
-      num_inliers = F_report.support.num_inliers;
-      best_inlier_mask = &F_report.inlier_mask;
-    }
+  // Estimate epipolar models.
 
-    if (H_E_inlier_ratio > options.max_H_inlier_ratio) {
-      config = PLANAR_OR_PANORAMIC;
-      if (H_report.support.num_inliers > num_inliers) {
-        num_inliers = H_report.support.num_inliers;
-        best_inlier_mask = &H_report.inlier_mask;
-      }
-    } else {
-      config = ConfigurationType::CALIBRATED;
-    }
-  } else if (F_report.success &&
-             F_report.support.num_inliers >= options.min_num_inliers) {
-    // Uncalibrated configuration.
+  auto E_ransac_options = options.ransac_options;
+  E_ransac_options.max_error =
+      (camera1.ImageToWorldThreshold(options.ransac_options.max_error) +
+       camera2.ImageToWorldThreshold(options.ransac_options.max_error)) /
+      2;
 
-    num_inliers = F_report.support.num_inliers;
-    best_inlier_mask = &F_report.inlier_mask;
+  const auto E_report = EstimateLORANSAC<EssentialMatrixFivePointEstimator,
+                                         EssentialMatrixFivePointEstimator>(
+      E_ransac_options, matched_points1_normalized, matched_points2_normalized,
+      progressive_sampling);
+  E = E_report.model;
 
-    if (H_F_inlier_ratio > options.max_H_inlier_ratio) {
-      config = ConfigurationType::PLANAR_OR_PANORAMIC;
-      if (H_report.support.num_inliers > num_inliers) {
-        num_inliers = H_report.support.num_inliers;
-        best_inlier_mask = &H_report.inlier_mask;
-      }
-    } else {
-      config = ConfigurationType::UNCALIBRATED;
-    }
-  } else if (H_report.success &&
-             H_report.support.num_inliers >= options.min_num_inliers) {
-    num_inliers = H_report.support.num_inliers;
-    best_inlier_mask = &H_report.inlier_mask;
-    config = ConfigurationType::PLANAR_OR_PANORAMIC;
-  } else {
-    config = ConfigurationType::DEGENERATE;
-    return;
+  if (!F_converged) {
+    F_report = EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                                FundamentalMatrixEightPointEstimator>(
+        options.ransac_options, matched_points1, matched_points2,
+        progressive_sampling);
   }
+  F = F_report.model;
 
-  if (best_inlier_mask != nullptr) {
-    inlier_matches =
-        ExtractInlierMatches(matches, num_inliers, *best_inlier_mask);
+  // Estimate planar or panoramic model.
 
-    if (options.detect_watermark &&
-        DetectWatermark(camera1, matched_points1, camera2, matched_points2,
-                        num_inliers, *best_inlier_mask, options)) {
-      config = ConfigurationType::WATERMARK;
-    }
-  }
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options, matched_points1, matched_points2,
+          progressive_sampling);
+  H = H_report.model;
+
+  DetermineCalibratedConfiguration(
+      camera1, matched_points1, camera2, matched_points2, matches,
+      ModelSupportFromReport(E_report), ModelSupportFromReport(F_report),
+      ModelSupportFromReport(H_report), options, this);
 }
 
 void TwoViewGeometry::EstimateUncalibrated(
@@ -373,57 +592,52 @@ void TwoViewGeometry::EstimateUncalibrated(
     return;
   }
 
+  FeatureMatches sorted_matches;
+  const bool progressive_sampling =
+      SortMatchesForSampling(matches, options, &sorted_matches);
+  const FeatureMatches& ordered_matches =
+      progressive_sampling ? sorted_matches : matches;
+
   // Extract corresponding points.
-  std::vector<Eigen::Vector2d> matched_points1(matches.size());
-  std::vector<Eigen::Vector2d> matched_points2(matches.size());
-  for (size_t i = 0; i < matches.size(); ++i) {
-    matched_points1[i] = points1[matches[i].point2D_idx1];
-    matched_points2[i] = points2[matches[i].point2D_idx2];
+  std::vector<Eigen::Vector2d> matched_points1(ordered_matches.size());
+  std::vector<Eigen::Vector2d> matched_points2(ordered_matches.size());
+  for (size_t i = 0; i < ordered_matches.size(); ++i) {
+    matched_points1[i] = points1[ordered_matches[i].point2D_idx1];
+    matched_points2[i] = points2[ordered_matches[i].point2D_idx2];
   }
 
-  // Estimate epipolar model.
-
-  LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
-  F = F_report.model;
+  // Estimate epipolar model, reusing the screening result if possible.
 
-  // Estimate planar or panoramic model.
-
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
-  H = H_report.model;
-
-  if ((!F_report.success && !H_report.success) ||
-      (F_report.support.num_inliers < options.min_num_inliers &&
-       H_report.support.num_inliers < options.min_num_inliers)) {
+  FundamentalMatrixRANSAC::Report F_report;
+  bool F_converged = false;
+  if (options.early_exit &&
+      !ScreenFundamentalMatrix(matched_points1, matched_points2,
+                               progressive_sampling, options, &F_report,
+                               &F_converged)) {
     config = ConfigurationType::DEGENERATE;
     return;
   }
 
-  // Determine inlier ratios of different models.
-
-  const double H_F_inlier_ratio =
-      static_cast<double>(H_report.support.num_inliers) /
-      F_report.support.num_inliers;
-
-  if (H_F_inlier_ratio > options.max_H_inlier_ratio) {
-    config = ConfigurationType::PLANAR_OR_PANORAMIC;
-  } else {
-    config = ConfigurationType::UNCALIBRATED;
+  if (!F_converged) {
+    F_report = EstimateLORANSAC<FundamentalMatrixSevenPointEstimator,
+                                FundamentalMatrixEightPointEstimator>(
+        options.ransac_options, matched_points1, matched_points2,
+        progressive_sampling);
   }
+  F = F_report.model;
 
-  inlier_matches = ExtractInlierMatches(matches, F_report.support.num_inliers,
-                                        F_report.inlier_mask);
+  // Estimate planar or panoramic model.
 
-  if (options.detect_watermark &&
-      DetectWatermark(camera1, matched_points1, camera2, matched_points2,
-                      F_report.support.num_inliers, F_report.inlier_mask,
-                      options)) {
-    config = ConfigurationType::WATERMARK;
-  }
+  const auto H_report =
+      EstimateLORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options, matched_points1, matched_points2,
+          progressive_sampling);
+  H = H_report.model;
+
+  DetermineUncalibratedConfiguration(
+      camera1, matched_points1, camera2, matched_points2, ordered_matches,
+      ModelSupportFromReport(F_report), ModelSupportFromReport(H_report),
+      options, this);
 }
 
 bool TwoViewGeometry::DetectWatermark(
@@ -104,6 +104,22 @@ struct TwoViewGeometry {
     // Whether to ignore watermark models in multiple model estimation.
     bool multiple_ignore_watermark = true;
 
+    // Whether to first screen the matches with a fundamental matrix
+    // estimation of bounded cost. Image pairs, whose screening yields less
+    // than `min_num_inliers` inliers, are rejected as degenerate without
+    // running the remaining estimators. If the screening estimation converged
+    // within its number of trials, its result is reused.
+    bool early_exit = false;
+
+    // Maximum number of RANSAC trials of the screening estimation.
+    size_t early_exit_max_num_trials = 500;
+
+    // Whether to draw the RANSAC samples with PROSAC, if all matches have a
+    // quality score from the ratio test. The matches are then sampled in the
+    // order of descending score, which typically finds a good model in fewer
+    // trials than uniform sampling. Otherwise, samples are drawn uniformly.
+    bool progressive_sampling = true;
+
     // Options used to robustly estimate the geometry.
     RANSACOptions ransac_options;
 
@@ -117,6 +133,7 @@ struct TwoViewGeometry {
       CHECK_LE(watermark_min_inlier_ratio, 1);
       CHECK_GE(watermark_border_size, 0);
       CHECK_LE(watermark_border_size, 1);
+      CHECK_GT(early_exit_max_num_trials, 0);
       ransac_options.Check();
     }
   };
@@ -148,6 +165,21 @@ struct TwoViewGeometry {
                 const std::vector<Eigen::Vector2d>& points2,
                 const FeatureMatches& matches, const Options& options);
 
+  // Same as above but with the feature points additionally given in the
+  // normalized camera coordinate systems of both images. This avoids the
+  // normalization of the matched points for every image pair, if the
+  // normalized points of the images are shared by many pairs.
+  //
+  // @param points1_normalized  Feature points in first image, normalized.
+  // @param points2_normalized  Feature points in second image, normalized.
+  void Estimate(const Camera& camera1,
+                const std::vector<Eigen::Vector2d>& points1,
+                const std::vector<Eigen::Vector2d>& points1_normalized,
+                const Camera& camera2,
+                const std::vector<Eigen::Vector2d>& points2,
+                const std::vector<Eigen::Vector2d>& points2_normalized,
+                const FeatureMatches& matches, const Options& options);
+
   // Recursively estimate multiple configurations by removing the previous set
   // of inliers from the matches until not enough inliers are found. Inlier
   // matches are concatenated and the configuration type is `MULTIPLE` if
@@ -170,6 +202,16 @@ struct TwoViewGeometry {
                         const std::vector<Eigen::Vector2d>& points2,
                         const FeatureMatches& matches, const Options& options);
 
+  // Same as above but with the feature points additionally given in the
+  // normalized camera coordinate systems of both images.
+  void EstimateMultiple(const Camera& camera1,
+                        const std::vector<Eigen::Vector2d>& points1,
+                        const std::vector<Eigen::Vector2d>& points1_normalized,
+                        const Camera& camera2,
+                        const std::vector<Eigen::Vector2d>& points2,
+                        const std::vector<Eigen::Vector2d>& points2_normalized,
+                        const FeatureMatches& matches, const Options& options);
+
   // Estimate two-view geometry and its relative pose from a calibrated or an
   // uncalibrated image pair.
   //
@@ -199,6 +241,15 @@ struct TwoViewGeometry {
                           const FeatureMatches& matches,
                           const Options& options);
 
+  // Same as above but with the feature points additionally given in the
+  // normalized camera coordinate systems of both images.
+  void EstimateCalibrated(
+      const Camera& camera1, const std::vector<Eigen::Vector2d>& points1,
+      const std::vector<Eigen::Vector2d>& points1_normalized,
+      const Camera& camera2, const std::vector<Eigen::Vector2d>& points2,
+      const std::vector<Eigen::Vector2d>& points2_normalized,
+      const FeatureMatches& matches, const Options& options);
+
   // Estimate two-view geometry from uncalibrated image pair.
   //
   // @param camera1         Camera of first image.
@@ -243,6 +294,19 @@ struct TwoViewGeometry {
 
   // Median triangulation angle.
   double tri_angle;
+
+ private:
+  // Estimate the calibrated two-view geometry from the already extracted
+  // corresponding points of the matches.
+  void EstimateCalibratedFromMatchedPoints(
+      const Camera& camera1,
+      const std::vector<Eigen::Vector2d>& matched_points1,
+      const std::vector<Eigen::Vector2d>& matched_points1_normalized,
+      const Camera& camera2,
+      const std::vector<Eigen::Vector2d>& matched_points2,
+      const std::vector<Eigen::Vector2d>& matched_points2_normalized,
+      const FeatureMatches& matches, const bool progressive_sampling,
+      const Options& options);
 };
 
 }  // namespace colmap
@@ -34,6 +34,7 @@
 
 #include "base/pose.h"
 #include "estimators/two_view_geometry.h"
+#include "util/random.h"
 
 using namespace colmap;
 
@@ -83,3 +84,164 @@ BOOST_AUTO_TEST_CASE(TestInvert) {
   BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches[1].point2D_idx1, 2);
   BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches[1].point2D_idx2, 3);
 }
+
+BOOST_AUTO_TEST_CASE(TestEstimateEarlyExit) {
+  SetPRNGSeed(0);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1000, 1000, 1000);
+  camera.SetPriorFocalLength(true);
+
+  const Eigen::Vector4d qvec =
+      NormalizeQuaternion(Eigen::Vector4d(1, 0.1, 0, 0));
+  const Eigen::Vector3d tvec(1, 0, 0);
+
+  // Projections of random points in front of both cameras.
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  FeatureMatches matches;
+  for (size_t i = 0; i < 100; ++i) {
+    const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                                  RandomReal(4.0, 6.0));
+    const Eigen::Vector3d point3D2 =
+        QuaternionRotatePoint(qvec, point3D) + tvec;
+    points1.push_back(camera.WorldToImage(point3D.hnormalized()));
+    points2.push_back(camera.WorldToImage(point3D2.hnormalized()));
+    matches.emplace_back(i, i);
+  }
+
+  // Unrelated points, for which no geometry can be verified.
+  std::vector<Eigen::Vector2d> random_points2;
+  for (size_t i = 0; i < 100; ++i) {
+    random_points2.emplace_back(RandomReal(0.0, 1000.0),
+                                RandomReal(0.0, 1000.0));
+  }
+
+  TwoViewGeometry::Options options;
+  options.ransac_options.max_error = 1;
+  options.ransac_options.max_num_trials = 10000;
+  options.early_exit = true;
+
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.Estimate(camera, points1, camera, points2, matches,
+                             options);
+  BOOST_CHECK_EQUAL(two_view_geometry.config, TwoViewGeometry::CALIBRATED);
+  BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 100);
+
+  TwoViewGeometry random_two_view_geometry;
+  random_two_view_geometry.Estimate(camera, points1, camera, random_points2,
+                                    matches, options);
+  BOOST_CHECK_EQUAL(random_two_view_geometry.config,
+                    TwoViewGeometry::DEGENERATE);
+  BOOST_CHECK(random_two_view_geometry.inlier_matches.empty());
+
+  camera.SetPriorFocalLength(false);
+  TwoViewGeometry uncalibrated_two_view_geometry;
+  uncalibrated_two_view_geometry.Estimate(camera, points1, camera,
+                                          random_points2, matches, options);
+  BOOST_CHECK_EQUAL(uncalibrated_two_view_geometry.config,
+                    TwoViewGeometry::DEGENERATE);
+}
+
+BOOST_AUTO_TEST_CASE(TestEstimateNormalizedPoints) {
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_RADIAL", 1000, 1000, 1000);
+  camera.Params(3) = 0.01;
+  camera.SetPriorFocalLength(true);
+
+  const Eigen::Vector4d qvec =
+      NormalizeQuaternion(Eigen::Vector4d(1, 0.1, 0, 0));
+  const Eigen::Vector3d tvec(1, 0, 0);
+
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  FeatureMatches matches;
+  SetPRNGSeed(0);
+  for (size_t i = 0; i < 100; ++i) {
+    const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                                  RandomReal(4.0, 6.0));
+    const Eigen::Vector3d point3D2 =
+        QuaternionRotatePoint(qvec, point3D) + tvec;
+    points1.push_back(camera.WorldToImage(point3D.hnormalized()));
+    points2.push_back(camera.WorldToImage(point3D2.hnormalized()));
+    // Only a subset of the points is matched.
+    if (i % 4 != 0) {
+      matches.emplace_back(i, i);
+    }
+  }
+
+  std::vector<Eigen::Vector2d> points1_normalized;
+  std::vector<Eigen::Vector2d> points2_normalized;
+  camera.ImageToWorld(points1, &points1_normalized);
+  camera.ImageToWorld(points2, &points2_normalized);
+
+  TwoViewGeometry::Options options;
+  options.ransac_options.max_error = 1;
+
+  SetPRNGSeed(0);
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.Estimate(camera, points1, camera, points2, matches,
+                             options);
+
+  SetPRNGSeed(0);
+  TwoViewGeometry normalized_two_view_geometry;
+  normalized_two_view_geometry.Estimate(camera, points1, points1_normalized,
+                                        camera, points2, points2_normalized,
+                                        matches, options);
+
+  BOOST_CHECK_EQUAL(two_view_geometry.config, TwoViewGeometry::CALIBRATED);
+  BOOST_CHECK_EQUAL(normalized_two_view_geometry.config,
+                    two_view_geometry.config);
+  BOOST_CHECK_EQUAL(normalized_two_view_geometry.inlier_matches.size(),
+                    matches.size());
+  BOOST_CHECK(normalized_two_view_geometry.E.isApprox(two_view_geometry.E));
+}
+
+BOOST_AUTO_TEST_CASE(TestEstimateProgressiveSampling) {
+  SetPRNGSeed(0);
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 1000, 1000, 1000);
+  camera.SetPriorFocalLength(true);
+
+  const Eigen::Vector4d qvec =
+      NormalizeQuaternion(Eigen::Vector4d(1, 0.1, 0, 0));
+  const Eigen::Vector3d tvec(1, 0, 0);
+
+  // Correct matches with high scores interleaved with wrong matches with low
+  // scores, such that the matches must be sorted for progressive sampling.
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  FeatureMatches matches;
+  for (size_t i = 0; i < 150; ++i) {
+    const Eigen::Vector3d point3D(RandomReal(-1.0, 1.0), RandomReal(-1.0, 1.0),
+                                  RandomReal(4.0, 6.0));
+    points1.push_back(camera.WorldToImage(point3D.hnormalized()));
+    matches.emplace_back(i, i);
+    if (i % 3 == 0) {
+      points2.emplace_back(RandomReal(0.0, 1000.0), RandomReal(0.0, 1000.0));
+      matches.back().score = RandomReal(0.01f, 0.1f);
+    } else {
+      const Eigen::Vector3d point3D2 =
+          QuaternionRotatePoint(qvec, point3D) + tvec;
+      points2.push_back(camera.WorldToImage(point3D2.hnormalized()));
+      matches.back().score = RandomReal(0.2f, 1.0f);
+    }
+  }
+
+  TwoViewGeometry::Options options;
+  options.ransac_options.max_error = 1;
+
+  for (const bool progressive_sampling : {false, true}) {
+    options.progressive_sampling = progressive_sampling;
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.Estimate(camera, points1, camera, points2, matches,
+                               options);
+    BOOST_CHECK_EQUAL(two_view_geometry.config, TwoViewGeometry::CALIBRATED);
+    BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 100);
+    for (const auto& match : two_view_geometry.inlier_matches) {
+      BOOST_CHECK_NE(match.point2D_idx1 % 3, 0);
+      BOOST_CHECK_EQUAL(match.point2D_idx1, match.point2D_idx2);
+    }
+  }
+}
@@ -32,6 +32,7 @@
 #include "estimators/utils.h"
 
 #include "util/logging.h"
+#include "util/simd.h"
 
 namespace colmap {
 
@@ -84,16 +85,23 @@ void CenterAndNormalizeImagePoints(const std::vector<Eigen::Vector2d>& points,
   }
 }
 
+COLMAP_SIMD_CLONES
 void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
                                 const std::vector<Eigen::Vector2d>& points2,
                                 const Eigen::Matrix3d& E,
                                 std::vector<double>* residuals) {
   CHECK_EQ(points1.size(), points2.size());
 
-  residuals->resize(points1.size());
+  const size_t num_points = points1.size();
+  residuals->resize(num_points);
+  if (num_points == 0) {
+    return;
+  }
 
   // Note that this code might not be as nice as Eigen expressions,
-  // but it is significantly faster in various tests
+  // but it is significantly faster in various tests. The loop operates on
+  // raw pointers, since the compiler cannot otherwise rule out aliasing of
+  // the residuals and the points and thus does not vectorize it.
 
   const double E_00 = E(0, 0);
   const double E_01 = E(0, 1);
@@ -105,11 +113,15 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
   const double E_21 = E(2, 1);
   const double E_22 = E(2, 2);
 
-  for (size_t i = 0; i < points1.size(); ++i) {
-    const double x1_0 = points1[i](0);
-    const double x1_1 = points1[i](1);
-    const double x2_0 = points2[i](0);
-    const double x2_1 = points2[i](1);
+  const double* x1 = points1[0].data();
+  const double* x2 = points2[0].data();
+  double* residuals_data = residuals->data();
+
+  for (size_t i = 0; i < num_points; ++i) {
+    const double x1_0 = x1[2 * i];
+    const double x1_1 = x1[2 * i + 1];
+    const double x2_0 = x2[2 * i];
+    const double x2_1 = x2[2 * i + 1];
 
     // Ex1 = E * points1[i].homogeneous();
     const double Ex1_0 = E_00 * x1_0 + E_01 * x1_1 + E_02;
@@ -124,22 +136,29 @@ void ComputeSquaredSampsonError(const std::vector<Eigen::Vector2d>& points1,
     const double x2tEx1 = x2_0 * Ex1_0 + x2_1 * Ex1_1 + Ex1_2;
 
     // Sampson distance
-    (*residuals)[i] =
+    residuals_data[i] =
         x2tEx1 * x2tEx1 /
         (Ex1_0 * Ex1_0 + Ex1_1 * Ex1_1 + Etx2_0 * Etx2_0 + Etx2_1 * Etx2_1);
   }
 }
 
+COLMAP_SIMD_CLONES
 void ComputeSquaredReprojectionError(
     const std::vector<Eigen::Vector2d>& points2D,
     const std::vector<Eigen::Vector3d>& points3D,
     const Eigen::Matrix3x4d& proj_matrix, std::vector<double>* residuals) {
   CHECK_EQ(points2D.size(), points3D.size());
 
-  residuals->resize(points2D.size());
+  const size_t num_points = points2D.size();
+  residuals->resize(num_points);
+  if (num_points == 0) {
+    return;
+  }
 
   // Note that this code might not be as nice as Eigen expressions,
-  // but it is significantly faster in various tests.
+  // but it is significantly faster in various tests. The residual is computed
+  // for all points and only then selected based on the cheirality, such that
+  // the loop has no branches and can be vectorized.
 
   const double P_00 = proj_matrix(0, 0);
   const double P_01 = proj_matrix(0, 1);
@@ -154,30 +173,29 @@ void ComputeSquaredReprojectionError(
   const double P_22 = proj_matrix(2, 2);
   const double P_23 = proj_matrix(2, 3);
 
-  for (size_t i = 0; i < points2D.size(); ++i) {
-    const double X_0 = points3D[i](0);
-    const double X_1 = points3D[i](1);
-    const double X_2 = points3D[i](2);
+  const double* x = points2D[0].data();
+  const double* X = points3D[0].data();
+  double* residuals_data = residuals->data();
+
+  for (size_t i = 0; i < num_points; ++i) {
+    const double X_0 = X[3 * i];
+    const double X_1 = X[3 * i + 1];
+    const double X_2 = X[3 * i + 2];
 
     // Project 3D point from world to camera.
+    const double px_0 = P_00 * X_0 + P_01 * X_1 + P_02 * X_2 + P_03;
+    const double px_1 = P_10 * X_0 + P_11 * X_1 + P_12 * X_2 + P_13;
     const double px_2 = P_20 * X_0 + P_21 * X_1 + P_22 * X_2 + P_23;
 
-    // Check if 3D point is in front of camera.
-    if (px_2 > std::numeric_limits<double>::epsilon()) {
-      const double px_0 = P_00 * X_0 + P_01 * X_1 + P_02 * X_2 + P_03;
-      const double px_1 = P_10 * X_0 + P_11 * X_1 + P_12 * X_2 + P_13;
-
-      const double x_0 = points2D[i](0);
-      const double x_1 = points2D[i](1);
+    const double inv_px_2 = 1.0 / px_2;
+    const double dx_0 = x[2 * i] - px_0 * inv_px_2;
+    const double dx_1 = x[2 * i + 1] - px_1 * inv_px_2;
+    const double squared_error = dx_0 * dx_0 + dx_1 * dx_1;
 
-      const double inv_px_2 = 1.0 / px_2;
-      const double dx_0 = x_0 - px_0 * inv_px_2;
-      const double dx_1 = x_1 - px_1 * inv_px_2;
-
-      (*residuals)[i] = dx_0 * dx_0 + dx_1 * dx_1;
-    } else {
-      (*residuals)[i] = std::numeric_limits<double>::max();
-    }
+    // Check if 3D point is in front of camera.
+    residuals_data[i] = px_2 > std::numeric_limits<double>::epsilon()
+                            ? squared_error
+                            : std::numeric_limits<double>::max();
   }
 }
 
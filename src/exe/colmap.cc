@@ -33,22 +33,34 @@
 #define NOMINMAX
 #endif
 
+#include <numeric>
+
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include "base/feature_store.h"
 #include "base/similarity_transform.h"
+#include "base/synthetic.h"
 #include "controllers/automatic_reconstruction.h"
 #include "controllers/bundle_adjustment.h"
+#include "controllers/global_mapper.h"
 #include "controllers/hierarchical_mapper.h"
+#include "controllers/online_mapper.h"
 #include "estimators/coordinate_frame.h"
 #include "feature/extraction.h"
 #include "feature/matching.h"
+#include "feature/product_quantizer.h"
+#include "feature/redundancy.h"
 #include "feature/utils.h"
+#include "mvs/clustering.h"
 #include "mvs/meshing.h"
 #include "mvs/patch_match.h"
+#include "retrieval/global_descriptor.h"
 #include "retrieval/visual_index.h"
+#include "sfm/image_localizer.h"
 #include "ui/main_window.h"
 #include "util/opengl_utils.h"
+#include "util/random.h"
 #include "util/version.h"
 
 using namespace colmap;
@@ -115,8 +127,12 @@ int RunAutomaticReconstructor(int argc, char** argv) {
   options.AddDefaultOption("num_threads", &reconstruction_options.num_threads);
   options.AddDefaultOption("use_gpu", &reconstruction_options.use_gpu);
   options.AddDefaultOption("gpu_index", &reconstruction_options.gpu_index);
+  options.AddDefaultOption("in_memory_database",
+                           &reconstruction_options.in_memory_database);
   options.Parse(argc, argv);
 
+  reconstruction_options.memory_budget = *options.memory_budget;
+
   StringToLower(&data_type);
   if (data_type == "individual") {
     reconstruction_options.data_type =
@@ -211,16 +227,23 @@ int RunBundleAdjuster(int argc, char** argv) {
 int RunColorExtractor(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  int max_image_size = -1;
+  int num_threads = -1;
 
   OptionManager options;
   options.AddImageOptions();
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption(
+      "max_image_size", &max_image_size,
+      "Decode JPEG images at a reduced scale of at least this size, if > 0");
+  options.AddDefaultOption("num_threads", &num_threads);
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
-  reconstruction.ExtractColorsForAllImages(*options.image_path);
+  reconstruction.ExtractColorsForAllImages(*options.image_path, max_image_size,
+                                           num_threads);
   reconstruction.Write(output_path);
 
   return EXIT_SUCCESS;
@@ -239,11 +262,13 @@ int RunDatabaseCreator(int argc, char** argv) {
 int RunDatabaseMerger(int argc, char** argv) {
   std::string database_path1;
   std::string database_path2;
+  std::string database_list_path;
   std::string merged_database_path;
 
   OptionManager options;
-  options.AddRequiredOption("database_path1", &database_path1);
-  options.AddRequiredOption("database_path2", &database_path2);
+  options.AddDefaultOption("database_path1", &database_path1);
+  options.AddDefaultOption("database_path2", &database_path2);
+  options.AddDefaultOption("database_list_path", &database_list_path);
   options.AddRequiredOption("merged_database_path", &merged_database_path);
   options.Parse(argc, argv);
 
@@ -252,10 +277,37 @@ int RunDatabaseMerger(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  Database database1(database_path1);
-  Database database2(database_path2);
+  std::vector<std::string> database_paths;
+  for (const auto& database_path : {database_path1, database_path2}) {
+    if (!database_path.empty()) {
+      database_paths.push_back(database_path);
+    }
+  }
+
+  if (!database_list_path.empty()) {
+    for (const auto& database_path : ReadTextFileLines(database_list_path)) {
+      if (!database_path.empty()) {
+        database_paths.push_back(database_path);
+      }
+    }
+  }
+
+  if (database_paths.size() < 2) {
+    std::cout << "ERROR: At least two databases must be given." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (const auto& database_path : database_paths) {
+    if (!ExistsFile(database_path)) {
+      std::cout << StringPrintf("ERROR: Database %s does not exist.",
+                                database_path.c_str())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
   Database merged_database(merged_database_path);
-  Database::Merge(database1, database2, &merged_database);
+  Database::Merge(database_paths, &merged_database);
 
   return EXIT_SUCCESS;
 }
@@ -267,6 +319,8 @@ int RunStereoFuser(int argc, char** argv) {
   std::string pmvs_option_name = "option-all";
   std::string output_type = "PLY";
   std::string output_path;
+  std::string cluster_path;
+  int cluster_idx = -1;
 
   OptionManager options;
   options.AddRequiredOption("workspace_path", &workspace_path);
@@ -276,11 +330,20 @@ int RunStereoFuser(int argc, char** argv) {
   options.AddDefaultOption("input_type", &input_type,
                            "{photometric, geometric}");
   options.AddDefaultOption("output_type", &output_type,
-                            "{BIN, TXT, PLY}");
+                            "{BIN, TXT, PLY, TILES}");
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("cluster_path", &cluster_path);
+  options.AddDefaultOption("cluster_idx", &cluster_idx);
   options.AddStereoFusionOptions();
   options.Parse(argc, argv);
 
+  if (cluster_idx >= 0 && !ExistsFile(cluster_path)) {
+    std::cerr << "ERROR: Fusing a cluster requires a `cluster_path` written "
+                 "by `stereo_clustering`."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
   StringToLower(&workspace_format);
   if (workspace_format != "colmap" && workspace_format != "pmvs") {
     std::cout << "ERROR: Invalid `workspace_format` - supported values are "
@@ -297,12 +360,35 @@ int RunStereoFuser(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  StringToLower(&output_type);
+  if (output_type != "bin" && output_type != "txt" && output_type != "ply" &&
+      output_type != "tiles") {
+    std::cerr << "ERROR: Invalid `output_type`" << std::endl;
+    return EXIT_FAILURE;
+  }
+
   mvs::StereoFusion fuser(*options.stereo_fusion, workspace_path,
                           workspace_format, pmvs_option_name, input_type);
 
+  // The PLY and tiles outputs are written during the fusion, so that the fused
+  // points do not need to be kept in memory.
+  if (output_type == "ply") {
+    fuser.SetOutputPath(output_path);
+  } else if (output_type == "tiles") {
+    fuser.SetTilesOutputPath(output_path);
+  }
+
+  if (cluster_idx >= 0) {
+    fuser.SetViewCluster(cluster_path, cluster_idx);
+  }
+
   fuser.Start();
   fuser.Wait();
 
+  if (output_type == "ply" || output_type == "tiles") {
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
 
   // read data from sparse reconstruction
@@ -316,23 +402,83 @@ int RunStereoFuser(int argc, char** argv) {
   std::cout << "Writing output: " << output_path << std::endl;
 
   // write output
-  StringToLower(&output_type);
   if (output_type == "bin") {
     reconstruction.WriteBinary(output_path);
   } else if (output_type == "txt") {
     reconstruction.WriteText(output_path);
-  } else if (output_type == "ply") {
-    WriteBinaryPlyPoints(output_path, fuser.GetFusedPoints());
-    mvs::WritePointsVisibility(output_path + ".vis",
-                               fuser.GetFusedPointsVisibility());
-  } else {
-    std::cerr << "ERROR: Invalid `output_type`" << std::endl;
-    return EXIT_FAILURE;
   }
 
   return EXIT_SUCCESS;
 }
 
+// Partition the images of a dense workspace into clusters, which are fused
+// independently by `stereo_fusion` with `--cluster_idx`, e.g., on different
+// nodes, and then merged by `stereo_fusion_merger`.
+int RunStereoClustering(int argc, char** argv) {
+  std::string workspace_path;
+  std::string workspace_format = "COLMAP";
+  std::string cluster_path;
+  mvs::ViewClusteringOptions clustering_options;
+
+  OptionManager options;
+  options.AddRequiredOption("workspace_path", &workspace_path);
+  options.AddDefaultOption("workspace_format", &workspace_format,
+                           "{COLMAP, PMVS}");
+  options.AddRequiredOption("cluster_path", &cluster_path);
+  options.AddDefaultOption("max_num_images",
+                           &clustering_options.max_num_images);
+  options.AddDefaultOption("max_num_support_images",
+                           &clustering_options.max_num_support_images);
+  options.AddDefaultOption("num_threads", &clustering_options.num_threads);
+  options.Parse(argc, argv);
+
+  mvs::Model model;
+  model.Read(workspace_path, workspace_format);
+
+  const auto clusters = mvs::ClusterViews(clustering_options, model);
+  for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+    std::cout << StringPrintf(
+                     "Cluster %d: %d reference images, %d support images",
+                     cluster_idx, clusters[cluster_idx].ref_image_idxs.size(),
+                     clusters[cluster_idx].support_image_idxs.size())
+              << std::endl;
+  }
+
+  mvs::WriteViewClusters(cluster_path, clusters);
+
+  return EXIT_SUCCESS;
+}
+
+int RunStereoFusionMerger(int argc, char** argv) {
+  std::string input_list_path;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddRequiredOption("input_list_path", &input_list_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.Parse(argc, argv);
+
+  std::vector<std::string> input_paths;
+  for (const auto& input_path : ReadTextFileLines(input_list_path)) {
+    if (input_path.empty()) {
+      continue;
+    }
+    if (!ExistsFile(input_path) || !ExistsFile(input_path + ".vis")) {
+      std::cerr << StringPrintf(
+                       "ERROR: Fused points %s or their visibility do not "
+                       "exist.",
+                       input_path.c_str())
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    input_paths.push_back(input_path);
+  }
+
+  mvs::MergeFusedPoints(input_paths, output_path);
+
+  return EXIT_SUCCESS;
+}
+
 int RunPoissonMesher(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -456,6 +602,124 @@ int RunPatchMatchStereo(int argc, char** argv) {
 #endif  // CUDA_ENABLED
 }
 
+// Compress the descriptors in the database with a product quantizer, which is
+// trained on a random sample of the descriptors. The recall of the nearest
+// neighbors between two images with the compressed descriptors is reported to
+// assess the trade-off between storage size and matching quality.
+int RunDescriptorCompressor(int argc, char** argv) {
+  int num_subspaces = 16;
+  int num_training_descriptors = 100000;
+  int num_iterations = 10;
+  int num_threads = -1;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddDefaultOption("num_subspaces", &num_subspaces);
+  options.AddDefaultOption("num_training_descriptors",
+                           &num_training_descriptors);
+  options.AddDefaultOption("num_iterations", &num_iterations);
+  options.AddDefaultOption("num_threads", &num_threads);
+  options.Parse(argc, argv);
+
+  Timer timer;
+  timer.Start();
+
+  Database database(*options.database_path);
+
+  if (database.NumCompressedDescriptorImages() > 0) {
+    std::cout << "ERROR: Database already contains compressed descriptors."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<image_t> image_ids;
+  for (const auto& image : database.ReadAllImages()) {
+    if (database.ExistsDescriptors(image.ImageId())) {
+      image_ids.push_back(image.ImageId());
+    }
+  }
+
+  if (image_ids.size() < 2) {
+    std::cout << "ERROR: Database must contain descriptors of at least two "
+                 "images."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  PrintHeading1("Training product quantizer");
+
+  // Sample the same number of training descriptors from random images.
+  Shuffle(static_cast<uint32_t>(image_ids.size()), &image_ids);
+  const size_t num_descriptors_per_image =
+      std::max<size_t>(1, num_training_descriptors / image_ids.size() + 1);
+  std::vector<FeatureDescriptors> training_descriptors;
+  size_t num_sampled_descriptors = 0;
+  for (const auto image_id : image_ids) {
+    if (num_sampled_descriptors >=
+        static_cast<size_t>(num_training_descriptors)) {
+      break;
+    }
+    const FeatureDescriptors descriptors = database.ReadDescriptors(image_id);
+    std::vector<int> row_idxs(descriptors.rows());
+    std::iota(row_idxs.begin(), row_idxs.end(), 0);
+    const size_t num_samples =
+        std::min(num_descriptors_per_image, row_idxs.size());
+    Shuffle(static_cast<uint32_t>(num_samples), &row_idxs);
+    FeatureDescriptors samples(num_samples, descriptors.cols());
+    for (size_t i = 0; i < num_samples; ++i) {
+      samples.row(i) = descriptors.row(row_idxs[i]);
+    }
+    num_sampled_descriptors += num_samples;
+    training_descriptors.push_back(std::move(samples));
+  }
+
+  FeatureDescriptors descriptors(num_sampled_descriptors,
+                                 training_descriptors[0].cols());
+  size_t row = 0;
+  for (const auto& samples : training_descriptors) {
+    descriptors.middleRows(row, samples.rows()) = samples;
+    row += samples.rows();
+  }
+  training_descriptors.clear();
+
+  std::cout << StringPrintf("Training on %d descriptors",
+                            num_sampled_descriptors)
+            << std::endl;
+
+  ProductQuantizer quantizer;
+  quantizer.Train(descriptors, num_subspaces, num_iterations, num_threads);
+
+  const double recall = ComputeProductQuantizerRecall(
+      quantizer, database.ReadDescriptors(image_ids[image_ids.size() - 1]),
+      database.ReadDescriptors(image_ids[image_ids.size() - 2]));
+  std::cout << StringPrintf("Descriptor size: %d -> %d bytes",
+                            quantizer.NumDims(), quantizer.NumSubspaces())
+            << std::endl;
+  std::cout << StringPrintf("Nearest neighbor recall: %.3f", recall)
+            << std::endl;
+
+  PrintHeading1("Compressing descriptors");
+
+  database.WriteDescriptorCodebook(quantizer);
+  database.SetCompressDescriptors(true);
+
+  const size_t kBatchSize = 100;
+  for (size_t i = 0; i < image_ids.size(); i += kBatchSize) {
+    std::cout << StringPrintf("Compressing images [%d/%d]", i + 1,
+                              image_ids.size())
+              << std::endl;
+    DatabaseTransaction database_transaction(&database);
+    for (size_t j = i; j < std::min(i + kBatchSize, image_ids.size()); ++j) {
+      database.UpdateDescriptors(image_ids[j],
+                                 database.ReadDescriptors(image_ids[j]));
+    }
+  }
+
+  timer.PrintMinutes();
+
+  return EXIT_SUCCESS;
+}
+
 int RunExhaustiveMatcher(int argc, char** argv) {
   OptionManager options;
   options.AddDatabaseOptions();
@@ -582,6 +846,49 @@ int RunFeatureImporter(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+// Export the features in the database to a feature store, from which the
+// matchers read them with `--SiftMatching.feature_store_path`. The features of
+// images that are already in the store are skipped, such that the store can be
+// updated after extracting the features of new images.
+int RunFeatureStoreExporter(int argc, char** argv) {
+  std::string feature_store_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("feature_store_path", &feature_store_path);
+  options.Parse(argc, argv);
+
+  Timer timer;
+  timer.Start();
+
+  Database database(*options.database_path);
+  FeatureStore feature_store(feature_store_path);
+
+  const std::vector<Image> images = database.ReadAllImages();
+  size_t num_exported_images = 0;
+  for (size_t i = 0; i < images.size(); ++i) {
+    const image_t image_id = images[i].ImageId();
+    if (!feature_store.ExistsKeypoints(image_id) &&
+        database.ExistsKeypoints(image_id)) {
+      feature_store.WriteKeypoints(image_id, database.ReadKeypoints(image_id));
+    }
+    if (!feature_store.ExistsDescriptors(image_id) &&
+        database.ExistsDescriptors(image_id)) {
+      feature_store.WriteDescriptors(image_id,
+                                     database.ReadDescriptors(image_id));
+      num_exported_images += 1;
+    }
+  }
+
+  std::cout << StringPrintf("Exported the features of %d images",
+                            num_exported_images)
+            << std::endl;
+
+  timer.PrintMinutes();
+
+  return EXIT_SUCCESS;
+}
+
 // Read stereo image pair names from a text file. The text file is expected to
 // have one image pair per line, e.g.:
 //
@@ -613,6 +920,155 @@ std::vector<std::pair<image_t, image_t>> ReadStereoImagePairs(
   return stereo_pairs;
 }
 
+// Binary models can be processed by streaming through the model files instead
+// of reading and re-writing the full reconstruction.
+bool ExistsBinaryModel(const std::string& path) {
+  return ExistsFile(JoinPaths(path, "cameras.bin")) &&
+         ExistsFile(JoinPaths(path, "images.bin")) &&
+         ExistsFile(JoinPaths(path, "points3D.bin"));
+}
+
+int RunGlobalDescriptorExtractor(int argc, char** argv) {
+  std::string vocab_tree_path;
+  std::string model_path;
+  int num_training_images = 5000;
+  int max_num_features = -1;
+
+  retrieval::GlobalDescriptorOptions descriptor_options;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddDefaultOption("vocab_tree_path", &vocab_tree_path);
+  options.AddRequiredOption("model_path", &model_path);
+  options.AddDefaultOption("num_training_images", &num_training_images);
+  options.AddDefaultOption("max_num_features", &max_num_features);
+  options.AddDefaultOption("num_words", &descriptor_options.num_words);
+  options.AddDefaultOption("num_dims", &descriptor_options.num_dims);
+  options.AddDefaultOption("num_iterations",
+                           &descriptor_options.num_iterations);
+  options.AddDefaultOption("num_threads", &descriptor_options.num_threads);
+  options.Parse(argc, argv);
+
+  Timer timer;
+  timer.Start();
+
+  Database database(*options.database_path);
+
+  std::vector<image_t> image_ids;
+  for (const auto& image : database.ReadAllImages()) {
+    if (database.ExistsDescriptors(image.ImageId())) {
+      image_ids.push_back(image.ImageId());
+    }
+  }
+
+  auto ReadDescriptors = [&](const image_t image_id) {
+    FeatureDescriptors descriptors = database.ReadDescriptors(image_id);
+    if (max_num_features > 0 && descriptors.rows() > max_num_features) {
+      FeatureKeypoints keypoints = database.ReadKeypoints(image_id);
+      ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+    }
+    return descriptors;
+  };
+
+  // An existing model is reused, such that the descriptors of new images are
+  // comparable to the descriptors that were computed before.
+  retrieval::GlobalDescriptorModel model;
+  if (ExistsFile(model_path)) {
+    model.Read(model_path);
+  } else {
+    if (image_ids.size() < 2) {
+      std::cout << "ERROR: Database must contain descriptors of at least two "
+                   "images."
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (!ExistsFile(vocab_tree_path)) {
+      std::cerr << "ERROR: `vocab_tree_path` is required to train the model"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    PrintHeading1("Training global descriptor model");
+
+    retrieval::VisualIndex<> visual_index;
+    visual_index.Read(vocab_tree_path);
+
+    std::vector<image_t> training_image_ids = image_ids;
+    Shuffle(static_cast<uint32_t>(training_image_ids.size()),
+            &training_image_ids);
+    training_image_ids.resize(std::min(
+        training_image_ids.size(), static_cast<size_t>(num_training_images)));
+
+    std::vector<FeatureDescriptors> training_descriptors;
+    training_descriptors.reserve(training_image_ids.size());
+    for (const auto image_id : training_image_ids) {
+      training_descriptors.push_back(ReadDescriptors(image_id));
+    }
+
+    std::cout << StringPrintf("Training on %d images",
+                              training_descriptors.size())
+              << std::endl;
+
+    model.Train(descriptor_options, visual_index.GetVisualWords(),
+                training_descriptors);
+    model.Write(model_path);
+
+    // The descriptors of a previous model are not comparable.
+    database.ClearGlobalDescriptors();
+  }
+
+  std::cout << StringPrintf("Descriptor size: %d -> %d dimensions",
+                            128 * model.NumWords(), model.NumDims())
+            << std::endl;
+
+  PrintHeading1("Computing global descriptors");
+
+  std::vector<image_t> new_image_ids;
+  for (const auto image_id : image_ids) {
+    if (!database.ExistsGlobalDescriptor(image_id)) {
+      new_image_ids.push_back(image_id);
+    }
+  }
+
+  // The features are read sequentially, since the database is not
+  // thread-safe, and the descriptors are computed in parallel.
+  ThreadPool thread_pool(descriptor_options.num_threads);
+  const size_t kBatchSize = 100;
+  std::vector<FeatureDescriptors> batch_descriptors;
+  std::vector<Eigen::VectorXf> batch_global_descriptors;
+  for (size_t i = 0; i < new_image_ids.size(); i += kBatchSize) {
+    std::cout << StringPrintf("Computing images [%d/%d]", i + 1,
+                              new_image_ids.size())
+              << std::endl;
+
+    const size_t batch_end = std::min(i + kBatchSize, new_image_ids.size());
+    batch_descriptors.clear();
+    for (size_t j = i; j < batch_end; ++j) {
+      batch_descriptors.push_back(ReadDescriptors(new_image_ids[j]));
+    }
+
+    batch_global_descriptors.resize(batch_descriptors.size());
+    thread_pool.ParallelFor(0, batch_descriptors.size(),
+                            [&](const size_t begin, const size_t end) {
+                              for (size_t j = begin; j < end; ++j) {
+                                batch_global_descriptors[j] =
+                                    model.Compute(batch_descriptors[j]);
+                              }
+                            });
+
+    DatabaseTransaction database_transaction(&database);
+    for (size_t j = i; j < batch_end; ++j) {
+      database.WriteGlobalDescriptor(new_image_ids[j],
+                                     batch_global_descriptors[j - i]);
+    }
+  }
+
+  timer.PrintMinutes();
+
+  return EXIT_SUCCESS;
+}
+
 int RunImageDeleter(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -630,8 +1086,34 @@ int RunImageDeleter(int argc, char** argv) {
       "Path to text file containing one image name to delete per line");
   options.Parse(argc, argv);
 
+  const bool binary_model = ExistsBinaryModel(input_path);
+
   Reconstruction reconstruction;
-  reconstruction.Read(input_path);
+  std::unordered_map<image_t, std::string> image_names;
+  if (binary_model) {
+    image_names = ReadBinaryModelImageNames(input_path);
+  } else {
+    reconstruction.Read(input_path);
+    for (const auto& image : reconstruction.Images()) {
+      image_names.emplace(image.first, image.second.Name());
+    }
+  }
+
+  std::unordered_map<std::string, image_t> image_name_to_image_id;
+  image_name_to_image_id.reserve(image_names.size());
+  for (const auto& image_name : image_names) {
+    image_name_to_image_id.emplace(image_name.second, image_name.first);
+  }
+
+  std::unordered_set<image_t> deleted_image_ids;
+
+  auto DeleteImage = [&](const image_t image_id) {
+    std::cout << StringPrintf(
+                     "Deleting image_id=%d, image_name=%s from reconstruction",
+                     image_id, image_names.at(image_id).c_str())
+              << std::endl;
+    deleted_image_ids.insert(image_id);
+  };
 
   if (!image_ids_path.empty()) {
     const auto image_ids = ReadTextFileLines(image_ids_path);
@@ -642,14 +1124,8 @@ int RunImageDeleter(int argc, char** argv) {
       }
 
       const image_t image_id = std::stoi(image_id_str);
-      if (reconstruction.ExistsImage(image_id)) {
-        const auto& image = reconstruction.Image(image_id);
-        std::cout
-            << StringPrintf(
-                   "Deleting image_id=%d, image_name=%s from reconstruction",
-                   image.ImageId(), image.Name().c_str())
-            << std::endl;
-        reconstruction.DeRegisterImage(image_id);
+      if (image_names.count(image_id) > 0) {
+        DeleteImage(image_id);
       } else {
         std::cout << StringPrintf(
                          "WARNING: Skipping image_id=%s, because it does not "
@@ -661,21 +1137,16 @@ int RunImageDeleter(int argc, char** argv) {
   }
 
   if (!image_names_path.empty()) {
-    const auto image_names = ReadTextFileLines(image_names_path);
+    const auto image_names_to_delete = ReadTextFileLines(image_names_path);
 
-    for (const auto image_name : image_names) {
+    for (const auto image_name : image_names_to_delete) {
       if (image_name.empty()) {
         continue;
       }
 
-      const Image* image = reconstruction.FindImageWithName(image_name);
-      if (image != nullptr) {
-        std::cout
-            << StringPrintf(
-                   "Deleting image_id=%d, image_name=%s from reconstruction",
-                   image->ImageId(), image->Name().c_str())
-            << std::endl;
-        reconstruction.DeRegisterImage(image->ImageId());
+      const auto image_id = image_name_to_image_id.find(image_name);
+      if (image_id != image_name_to_image_id.end()) {
+        DeleteImage(image_id->second);
       } else {
         std::cout << StringPrintf(
                          "WARNING: Skipping image_name=%s, because it does not "
@@ -686,7 +1157,14 @@ int RunImageDeleter(int argc, char** argv) {
     }
   }
 
-  reconstruction.Write(output_path);
+  if (binary_model) {
+    DeleteBinaryModelImages(input_path, output_path, deleted_image_ids);
+  } else {
+    for (const auto image_id : deleted_image_ids) {
+      reconstruction.DeRegisterImage(image_id);
+    }
+    reconstruction.Write(output_path);
+  }
 
   return EXIT_SUCCESS;
 }
@@ -708,6 +1186,25 @@ int RunImageFilterer(int argc, char** argv) {
   options.AddDefaultOption("min_num_observations", &min_num_observations);
   options.Parse(argc, argv);
 
+  if (ExistsBinaryModel(input_path)) {
+    const size_t num_reg_images = ReadBinaryModelImageNames(input_path).size();
+    const std::vector<image_t> filtered_image_ids =
+        FindFilteredBinaryModelImages(input_path, min_focal_length_ratio,
+                                      max_focal_length_ratio, max_extra_param,
+                                      min_num_observations);
+
+    std::cout << StringPrintf("Filtered %d images from a total of %d images",
+                              filtered_image_ids.size(), num_reg_images)
+              << std::endl;
+
+    DeleteBinaryModelImages(input_path, output_path,
+                            std::unordered_set<image_t>(
+                                filtered_image_ids.begin(),
+                                filtered_image_ids.end()));
+
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
 
@@ -775,14 +1272,148 @@ int RunImageRectifier(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+// Register the new images in the database by matching their features
+// directly against the 3D points of the model, without loading the matches
+// between the images, so that the cost per image is independent of the size
+// of the database.
+int RunImageLocalization(const OptionManager& options,
+                         const std::string& input_path,
+                         const std::string& output_path,
+                         const std::string& index_path) {
+  Database database(*options.database_path);
+
+  Reconstruction reconstruction;
+  reconstruction.Read(input_path);
+
+  ImageLocalizer localizer;
+
+  {
+    Timer timer;
+    timer.Start();
+    if (!index_path.empty() && ExistsFile(index_path)) {
+      PrintHeading1("Reading localization index");
+      localizer.Read(index_path);
+    } else {
+      PrintHeading1("Building localization index");
+      localizer.Build(reconstruction, database);
+      if (!index_path.empty()) {
+        localizer.Write(index_path);
+      }
+    }
+    std::cout << "  => Indexed points: " << localizer.NumPoints3D()
+              << std::endl;
+    timer.PrintSeconds();
+  }
+
+  const auto mapper_options = options.mapper->Mapper();
+
+  ImageLocalizer::Options localizer_options;
+  localizer_options.max_ratio = options.sift_matching->max_ratio;
+  localizer_options.max_distance = options.sift_matching->max_distance;
+  localizer_options.cross_check = options.sift_matching->cross_check;
+  localizer_options.abs_pose_max_error = mapper_options.abs_pose_max_error;
+  localizer_options.abs_pose_min_num_inliers =
+      mapper_options.abs_pose_min_num_inliers;
+  localizer_options.abs_pose_min_inlier_ratio =
+      mapper_options.abs_pose_min_inlier_ratio;
+  localizer_options.min_focal_length_ratio =
+      mapper_options.min_focal_length_ratio;
+  localizer_options.max_focal_length_ratio =
+      mapper_options.max_focal_length_ratio;
+  localizer_options.num_threads = mapper_options.num_threads;
+
+  for (const auto& db_image : database.ReadAllImages()) {
+    if (!options.mapper->image_names.empty() &&
+        options.mapper->image_names.count(db_image.Name()) == 0) {
+      continue;
+    }
+
+    if (reconstruction.ExistsImage(db_image.ImageId()) &&
+        reconstruction.IsImageRegistered(db_image.ImageId())) {
+      continue;
+    }
+
+    PrintHeading1("Localizing image #" + std::to_string(db_image.ImageId()) +
+                  " (" + std::to_string(reconstruction.NumRegImages() + 1) +
+                  ")");
+
+    Timer timer;
+    timer.Start();
+
+    const FeatureKeypoints keypoints =
+        database.ReadKeypoints(db_image.ImageId());
+    const FeatureDescriptors descriptors =
+        database.ReadDescriptors(db_image.ImageId());
+
+    // Cameras that are shared with already registered images are kept fixed,
+    // since refining them would invalidate the existing reconstruction.
+    const bool camera_exists = reconstruction.ExistsCamera(db_image.CameraId());
+    Camera camera = camera_exists
+                        ? reconstruction.Camera(db_image.CameraId())
+                        : database.ReadCamera(db_image.CameraId());
+    localizer_options.abs_pose_refine_focal_length =
+        !camera_exists && mapper_options.abs_pose_refine_focal_length;
+    localizer_options.abs_pose_refine_extra_params =
+        !camera_exists && mapper_options.abs_pose_refine_extra_params;
+
+    Eigen::Vector4d qvec;
+    Eigen::Vector3d tvec;
+    std::vector<std::pair<point2D_t, point3D_t>> inlier_corrs;
+    if (!localizer.Localize(localizer_options, keypoints, descriptors, &camera,
+                            &qvec, &tvec, &inlier_corrs)) {
+      std::cout << "  => Could not localize image" << std::endl;
+      timer.PrintSeconds();
+      continue;
+    }
+
+    if (!camera_exists) {
+      reconstruction.AddCamera(camera);
+    }
+
+    if (!reconstruction.ExistsImage(db_image.ImageId())) {
+      Image image = db_image;
+      image.SetPoints2D(FeatureKeypointsToPointsVector(keypoints));
+      reconstruction.AddImage(image);
+    }
+
+    Image& image = reconstruction.Image(db_image.ImageId());
+    image.SetQvec(qvec);
+    image.SetTvec(tvec);
+    reconstruction.RegisterImage(db_image.ImageId());
+
+    // A 3D point can only be observed once per image.
+    std::unordered_set<point3D_t> point3D_ids;
+    for (const auto& corr : inlier_corrs) {
+      if (!image.Point2D(corr.first).HasPoint3D() &&
+          point3D_ids.insert(corr.second).second) {
+        reconstruction.AddObservation(
+            corr.second, TrackElement(db_image.ImageId(), corr.first));
+      }
+    }
+
+    std::cout << "  => Observed points: " << point3D_ids.size() << std::endl;
+    timer.PrintSeconds();
+  }
+
+  reconstruction.Write(output_path);
+
+  return EXIT_SUCCESS;
+}
+
 int RunImageRegistrator(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  bool localization_only = false;
+  std::string localization_index_path;
 
   OptionManager options;
   options.AddDatabaseOptions();
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("localization_only", &localization_only);
+  options.AddDefaultOption("localization_index_path",
+                           &localization_index_path);
+  options.AddMatchingOptions();
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -796,6 +1427,11 @@ int RunImageRegistrator(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if (localization_only) {
+    return RunImageLocalization(options, input_path, output_path,
+                                localization_index_path);
+  }
+
   PrintHeading1("Loading database");
 
   DatabaseCache database_cache;
@@ -808,7 +1444,8 @@ int RunImageRegistrator(int argc, char** argv) {
         static_cast<size_t>(options.mapper->min_num_matches);
     database_cache.Load(database, min_num_matches,
                         options.mapper->ignore_watermarks,
-                        options.mapper->image_names);
+                        options.mapper->image_names,
+                        options.mapper->num_threads);
     std::cout << std::endl;
     timer.PrintMinutes();
   }
@@ -850,8 +1487,10 @@ int RunImageUndistorter(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
   std::string output_type = "COLMAP";
+  bool write_images = true;
 
   UndistortCameraOptions undistort_camera_options;
+  UndistortImagesOptions undistort_images_options;
 
   OptionManager options;
   options.AddImageOptions();
@@ -859,6 +1498,20 @@ int RunImageUndistorter(int argc, char** argv) {
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("output_type", &output_type,
                            "{COLMAP, PMVS, CMP-MVS}");
+  options.AddDefaultOption("write_images", &write_images);
+  options.AddDefaultOption("image_format",
+                           &undistort_images_options.image_format,
+                           "{, JPEG, PNG, BMP, TIFF, WEBP}");
+  options.AddDefaultOption("skip_existing",
+                           &undistort_images_options.skip_existing);
+  options.AddDefaultOption("num_read_threads",
+                           &undistort_images_options.num_read_threads);
+  options.AddDefaultOption("num_threads",
+                           &undistort_images_options.num_threads);
+  options.AddDefaultOption("num_write_threads",
+                           &undistort_images_options.num_write_threads);
+  options.AddDefaultOption("max_num_queued_images",
+                           &undistort_images_options.max_num_queued_images);
   options.AddDefaultOption("blank_pixels",
                            &undistort_camera_options.blank_pixels);
   options.AddDefaultOption("min_scale", &undistort_camera_options.min_scale);
@@ -871,6 +1524,10 @@ int RunImageUndistorter(int argc, char** argv) {
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
   options.Parse(argc, argv);
 
+  if (!undistort_images_options.Check()) {
+    return EXIT_FAILURE;
+  }
+
   CreateDirIfNotExists(output_path);
 
   Reconstruction reconstruction;
@@ -878,17 +1535,17 @@ int RunImageUndistorter(int argc, char** argv) {
 
   std::unique_ptr<Thread> undistorter;
   if (output_type == "COLMAP") {
-    undistorter.reset(new COLMAPUndistorter(undistort_camera_options,
-                                            reconstruction, *options.image_path,
-                                            output_path));
+    undistorter.reset(new COLMAPUndistorter(
+        undistort_camera_options, reconstruction, *options.image_path,
+        output_path, write_images, undistort_images_options));
   } else if (output_type == "PMVS") {
-    undistorter.reset(new PMVSUndistorter(undistort_camera_options,
-                                          reconstruction, *options.image_path,
-                                          output_path));
+    undistorter.reset(new PMVSUndistorter(
+        undistort_camera_options, reconstruction, *options.image_path,
+        output_path, undistort_images_options));
   } else if (output_type == "CMP-MVS") {
-    undistorter.reset(new CMPMVSUndistorter(undistort_camera_options,
-                                            reconstruction, *options.image_path,
-                                            output_path));
+    undistorter.reset(new CMPMVSUndistorter(
+        undistort_camera_options, reconstruction, *options.image_path,
+        output_path, undistort_images_options));
   } else {
     std::cerr << "ERROR: Invalid `output_type` - supported values are "
                  "{'COLMAP', 'PMVS', 'CMP-MVS'}."
@@ -1002,6 +1659,7 @@ int RunMapper(int argc, char** argv) {
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("image_list_path", &image_list_path);
+  options.AddDefaultOption("resume", &options.mapper->resume);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -1010,14 +1668,26 @@ int RunMapper(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if (options.mapper->resume && options.mapper->checkpoint_path.empty()) {
+    std::cerr << "ERROR: Resuming requires a `Mapper.checkpoint_path`."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
   if (!image_list_path.empty()) {
     const auto image_names = ReadTextFileLines(image_list_path);
     options.mapper->image_names =
         std::unordered_set<std::string>(image_names.begin(), image_names.end());
   }
 
+  // When resuming from a checkpoint, the input reconstruction is continued
+  // from the checkpoint instead.
+  const bool resume_checkpoint =
+      options.mapper->resume &&
+      IncrementalMapperCheckpoint::Exists(options.mapper->checkpoint_path);
+
   ReconstructionManager reconstruction_manager;
-  if (input_path != "") {
+  if (input_path != "" && !resume_checkpoint) {
     if (!ExistsDir(input_path)) {
       std::cerr << "ERROR: `input_path` is not a directory." << std::endl;
       return EXIT_FAILURE;
@@ -1033,27 +1703,35 @@ int RunMapper(int argc, char** argv) {
   // models to as their reconstruction finishes instead of writing all results
   // after all reconstructions finished.
   size_t prev_num_reconstructions = 0;
+  const auto WriteNewReconstructions = [&]() {
+    // If the number of reconstructions has not changed, the last model was
+    // discarded for some reason. The models that were finished before
+    // resuming from a checkpoint are written together with the next model.
+    while (reconstruction_manager.Size() > prev_num_reconstructions) {
+      const std::string reconstruction_path =
+          JoinPaths(output_path, std::to_string(prev_num_reconstructions));
+      const auto& reconstruction =
+          reconstruction_manager.Get(prev_num_reconstructions);
+      CreateDirIfNotExists(reconstruction_path);
+      reconstruction.Write(reconstruction_path);
+      options.Write(JoinPaths(reconstruction_path, "project.ini"));
+      prev_num_reconstructions += 1;
+    }
+  };
+
   if (input_path == "") {
-    mapper.AddCallback(
-        IncrementalMapperController::LAST_IMAGE_REG_CALLBACK, [&]() {
-          // If the number of reconstructions has not changed, the last model
-          // was discarded for some reason.
-          if (reconstruction_manager.Size() > prev_num_reconstructions) {
-            const std::string reconstruction_path = JoinPaths(
-                output_path, std::to_string(prev_num_reconstructions));
-            const auto& reconstruction =
-                reconstruction_manager.Get(prev_num_reconstructions);
-            CreateDirIfNotExists(reconstruction_path);
-            reconstruction.Write(reconstruction_path);
-            options.Write(JoinPaths(reconstruction_path, "project.ini"));
-            prev_num_reconstructions = reconstruction_manager.Size();
-          }
-        });
+    mapper.AddCallback(IncrementalMapperController::LAST_IMAGE_REG_CALLBACK,
+                       WriteNewReconstructions);
   }
 
   mapper.Start();
   mapper.Wait();
 
+  // The models of a completed checkpoint are not reconstructed again.
+  if (input_path == "" && resume_checkpoint) {
+    WriteNewReconstructions();
+  }
+
   // In case the reconstruction is continued from an existing reconstruction, do
   // not create sub-folders but directly write the results.
   if (input_path != "" && reconstruction_manager.Size() > 0) {
@@ -1063,10 +1741,51 @@ int RunMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunGlobalMapper(int argc, char** argv) {
+  GlobalMapper::Options global_options;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddImageOptions();
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("min_num_inliers", &global_options.min_num_inliers);
+  options.AddDefaultOption("max_error", &global_options.max_error);
+  options.AddDefaultOption("min_tri_angle", &global_options.min_tri_angle);
+  options.AddDefaultOption(
+      "max_rotation_error",
+      &global_options.rotation_averaging.max_rotation_error);
+  options.AddDefaultOption(
+      "max_angular_error",
+      &global_options.translation_averaging.max_angular_error);
+  options.AddMapperOptions();
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    std::cerr << "ERROR: `output_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  global_options.num_threads = options.mapper->num_threads;
+
+  ReconstructionManager reconstruction_manager;
+
+  GlobalMapperController global_mapper(
+      global_options, options.mapper.get(), *options.image_path,
+      *options.database_path, &reconstruction_manager);
+  global_mapper.Start();
+  global_mapper.Wait();
+
+  reconstruction_manager.Write(output_path, &options);
+
+  return EXIT_SUCCESS;
+}
+
 int RunHierarchicalMapper(int argc, char** argv) {
   HierarchicalMapperController::Options hierarchical_options;
   SceneClustering::Options clustering_options;
   std::string output_path;
+  std::string stage = "all";
 
   OptionManager options;
   options.AddRequiredOption("database_path",
@@ -1074,9 +1793,18 @@ int RunHierarchicalMapper(int argc, char** argv) {
   options.AddRequiredOption("image_path", &hierarchical_options.image_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("num_workers", &hierarchical_options.num_workers);
+  options.AddDefaultOption("num_threads", &hierarchical_options.num_threads);
+  options.AddDefaultOption("ba_global", &hierarchical_options.ba_global);
   options.AddDefaultOption("image_overlap", &clustering_options.image_overlap);
   options.AddDefaultOption("leaf_max_num_images",
                            &clustering_options.leaf_max_num_images);
+  options.AddDefaultOption("stage", &stage,
+                           "{'all', 'partition', 'reconstruct', 'merge'}");
+  options.AddDefaultOption("cluster_path", &hierarchical_options.cluster_path);
+  options.AddDefaultOption("cluster_idx", &hierarchical_options.cluster_idx);
+  options.AddDefaultOption("write_cluster_databases",
+                           &hierarchical_options.write_cluster_databases);
+  options.AddDefaultOption("resume", &options.mapper->resume);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -1085,6 +1813,28 @@ int RunHierarchicalMapper(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if (options.mapper->resume && options.mapper->checkpoint_path.empty()) {
+    std::cerr << "ERROR: Resuming requires a `Mapper.checkpoint_path`."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  StringToLower(&stage);
+  if (stage == "all") {
+    hierarchical_options.stage = HierarchicalMapperController::Stage::ALL;
+  } else if (stage == "partition") {
+    hierarchical_options.stage = HierarchicalMapperController::Stage::PARTITION;
+  } else if (stage == "reconstruct") {
+    hierarchical_options.stage =
+        HierarchicalMapperController::Stage::RECONSTRUCT;
+  } else if (stage == "merge") {
+    hierarchical_options.stage = HierarchicalMapperController::Stage::MERGE;
+  } else {
+    LOG(FATAL) << "Invalid stage provided";
+  }
+
+  clustering_options.num_threads = hierarchical_options.num_threads;
+
   ReconstructionManager reconstruction_manager;
 
   HierarchicalMapperController hierarchical_mapper(
@@ -1098,6 +1848,57 @@ int RunHierarchicalMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunOnlineMapper(int argc, char** argv) {
+  OnlineMapperController::Options online_options;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddImageOptions();
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("num_sequential_neighbors",
+                           &online_options.num_sequential_neighbors);
+  options.AddDefaultOption("num_visual_neighbors",
+                           &online_options.num_visual_neighbors);
+  options.AddDefaultOption("vocab_tree_path", &online_options.vocab_tree_path);
+  options.AddDefaultOption("num_spatial_neighbors",
+                           &online_options.num_spatial_neighbors);
+  options.AddDefaultOption("max_spatial_distance",
+                           &online_options.max_spatial_distance);
+  options.AddDefaultOption("spatial_is_gps", &online_options.spatial_is_gps);
+  options.AddDefaultOption("max_num_retried_images",
+                           &online_options.max_num_retried_images);
+  options.AddDefaultOption("poll_interval", &online_options.poll_interval);
+  options.AddDefaultOption("max_idle_time", &online_options.max_idle_time);
+  options.AddExtractionOptions();
+  options.AddMatchingOptions();
+  options.AddMapperOptions();
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    std::cerr << "ERROR: `output_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ImageReaderOptions reader_options = *options.image_reader;
+  reader_options.database_path = *options.database_path;
+  reader_options.image_path = *options.image_path;
+
+  online_options.num_threads = options.sift_matching->num_threads;
+
+  ReconstructionManager reconstruction_manager;
+
+  OnlineMapperController online_mapper(
+      online_options, reader_options, *options.sift_extraction,
+      *options.sift_matching, *options.mapper, &reconstruction_manager);
+  online_mapper.Start();
+  online_mapper.Wait();
+
+  reconstruction_manager.Write(output_path, &options);
+
+  return EXIT_SUCCESS;
+}
+
 int RunMatchesImporter(int argc, char** argv) {
   std::string match_list_path;
   std::string match_type = "pairs";
@@ -1142,12 +1943,49 @@ int RunMatchesImporter(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunMatchingServer(int argc, char** argv) {
+  MatchingServerOptions server_options;
+
+  OptionManager options;
+  options.AddRequiredOption("spool_path", &server_options.spool_path);
+  options.AddDefaultOption("cache_size", &server_options.cache_size);
+  options.AddDefaultOption("block_size", &server_options.block_size);
+  options.AddDefaultOption("poll_interval", &server_options.poll_interval);
+  options.AddDefaultOption("max_idle_time", &server_options.max_idle_time);
+  options.AddMatchingOptions();
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(server_options.spool_path)) {
+    std::cerr << "ERROR: `spool_path` is not a directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<QApplication> app;
+  if (options.sift_matching->use_gpu && kUseOpenGL) {
+    app.reset(new QApplication(argc, argv));
+  }
+
+  FeatureMatchingServer matching_server(server_options,
+                                        *options.sift_matching);
+
+  if (options.sift_matching->use_gpu && kUseOpenGL) {
+    RunThreadWithOpenGLContext(&matching_server);
+  } else {
+    matching_server.Start();
+    matching_server.Wait();
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int RunModelAligner(int argc, char** argv) {
   std::string input_path;
   std::string ref_images_path;
   std::string output_path;
   int min_common_images = 3;
   bool robust_alignment = true;
+  int robust_alignment_max_num_samples = 0;
+  bool stream_transform = false;
   RANSACOptions ransac_options;
 
   OptionManager options;
@@ -1158,6 +1996,12 @@ int RunModelAligner(int argc, char** argv) {
   options.AddDefaultOption("robust_alignment", &robust_alignment);
   options.AddDefaultOption("robust_alignment_max_error",
                            &ransac_options.max_error);
+  options.AddDefaultOption(
+      "robust_alignment_max_num_samples", &robust_alignment_max_num_samples,
+      "Run RANSAC on a random subset of the reference images, if > 0");
+  options.AddDefaultOption(
+      "stream_transform", &stream_transform,
+      "Transform a binary model file by file without loading it");
   options.Parse(argc, argv);
 
   if (robust_alignment && ransac_options.max_error <= 0) {
@@ -1166,6 +2010,11 @@ int RunModelAligner(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  if (stream_transform && !ExistsBinaryModel(input_path)) {
+    std::cout << "ERROR: Streaming requires a binary model" << std::endl;
+    return EXIT_FAILURE;
+  }
+
   std::vector<std::string> ref_image_names;
   std::vector<Eigen::Vector3d> ref_locations;
   std::vector<std::string> lines = ReadTextFileLines(ref_images_path);
@@ -1179,8 +2028,14 @@ int RunModelAligner(int argc, char** argv) {
     ref_locations.push_back(camera_position);
   }
 
+  // Either read the full reconstruction or only the projection centers.
   Reconstruction reconstruction;
-  reconstruction.Read(input_path);
+  std::unordered_map<std::string, Eigen::Vector3d> proj_centers;
+  if (stream_transform) {
+    proj_centers = ReadBinaryModelProjectionCenters(input_path);
+  } else {
+    reconstruction.Read(input_path);
+  }
 
   PrintHeading2("Aligning reconstruction");
 
@@ -1189,25 +2044,67 @@ int RunModelAligner(int argc, char** argv) {
             << std::endl;
 
   bool alignment_success;
-  if (robust_alignment) {
-    alignment_success = reconstruction.AlignRobust(
-        ref_image_names, ref_locations, min_common_images, ransac_options);
+  if (stream_transform) {
+    std::unordered_set<std::string> common_image_names;
+    std::vector<Eigen::Vector3d> src;
+    std::vector<Eigen::Vector3d> dst;
+    for (size_t i = 0; i < ref_image_names.size(); ++i) {
+      const auto proj_center = proj_centers.find(ref_image_names[i]);
+      if (proj_center != proj_centers.end() &&
+          common_image_names.insert(ref_image_names[i]).second) {
+        src.push_back(proj_center->second);
+        dst.push_back(ref_locations[i]);
+      }
+    }
+
+    SimilarityTransform3 tform;
+    if (src.size() < static_cast<size_t>(min_common_images)) {
+      alignment_success = false;
+    } else if (robust_alignment) {
+      Eigen::Matrix3x4d tform_matrix;
+      alignment_success = EstimateSimilarityTransformRobust(
+          src, dst, ransac_options, min_common_images,
+          robust_alignment_max_num_samples, &tform_matrix);
+      tform = SimilarityTransform3(tform_matrix);
+    } else {
+      alignment_success = tform.Estimate(src, dst);
+    }
+
+    if (alignment_success) {
+      TransformBinaryModel(input_path, output_path, tform);
+      for (auto& proj_center : proj_centers) {
+        tform.TransformPoint(&proj_center.second);
+      }
+    }
   } else {
-    alignment_success =
-        reconstruction.Align(ref_image_names, ref_locations, min_common_images);
+    if (robust_alignment) {
+      alignment_success = reconstruction.AlignRobust(
+          ref_image_names, ref_locations, min_common_images, ransac_options,
+          robust_alignment_max_num_samples);
+    } else {
+      alignment_success = reconstruction.Align(ref_image_names, ref_locations,
+                                               min_common_images);
+    }
+
+    if (alignment_success) {
+      reconstruction.Write(output_path);
+      for (const image_t image_id : reconstruction.RegImageIds()) {
+        const Image& image = reconstruction.Image(image_id);
+        proj_centers.emplace(image.Name(), image.ProjectionCenter());
+      }
+    }
   }
 
   if (alignment_success) {
     std::cout << " => Alignment succeeded" << std::endl;
-    reconstruction.Write(output_path);
 
     std::vector<double> errors;
     errors.reserve(ref_image_names.size());
 
     for (size_t i = 0; i < ref_image_names.size(); ++i) {
-      const Image* image = reconstruction.FindImageWithName(ref_image_names[i]);
-      if (image != nullptr) {
-        errors.push_back((image->ProjectionCenter() - ref_locations[i]).norm());
+      const auto proj_center = proj_centers.find(ref_image_names[i]);
+      if (proj_center != proj_centers.end()) {
+        errors.push_back((proj_center->second - ref_locations[i]).norm());
       }
     }
 
@@ -1265,7 +2162,7 @@ int RunModelConverter(int argc, char** argv) {
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddRequiredOption("output_type", &output_type,
-                            "{BIN, TXT, NVM, Bundler, VRML, PLY}");
+                            "{BIN, TXT, NVM, Bundler, VRML, PLY, TILES}");
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
@@ -1283,6 +2180,8 @@ int RunModelConverter(int argc, char** argv) {
                                  output_path + ".list.txt");
   } else if (output_type == "ply") {
     reconstruction.ExportPLY(output_path);
+  } else if (output_type == "tiles") {
+    reconstruction.ExportOctreeTiles(output_path);
   } else if (output_type == "vrml") {
     const auto base_path = output_path.substr(0, output_path.find_last_of("."));
     reconstruction.ExportVRML(base_path + ".images.wrl",
@@ -1296,17 +2195,53 @@ int RunModelConverter(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunJournalCompactor(int argc, char** argv) {
+  std::string input_path;
+  std::string output_path;
+  std::string output_type = "BIN";
+
+  OptionManager options;
+  options.AddRequiredOption("input_path", &input_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("output_type", &output_type, "{BIN, TXT}");
+  options.Parse(argc, argv);
+
+  Reconstruction reconstruction;
+  reconstruction.ReadJournal(input_path);
+
+  std::cout << StringPrintf("Compacted journal with %d images and %d points",
+                            reconstruction.NumRegImages(),
+                            reconstruction.NumPoints3D())
+            << std::endl;
+
+  StringToLower(&output_type);
+  if (output_type == "bin") {
+    reconstruction.WriteBinary(output_path);
+  } else if (output_type == "txt") {
+    reconstruction.WriteText(output_path);
+  } else {
+    std::cerr << "ERROR: Invalid `output_type`" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
 int RunModelMerger(int argc, char** argv) {
   std::string input_path1;
   std::string input_path2;
   std::string output_path;
   double max_reproj_error = 64.0;
+  double max_point_distance = 0.0;
 
   OptionManager options;
   options.AddRequiredOption("input_path1", &input_path1);
   options.AddRequiredOption("input_path2", &input_path2);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("max_reproj_error", &max_reproj_error);
+  options.AddDefaultOption(
+      "max_point_distance", &max_point_distance,
+      "Merge duplicate 3D points within this distance after merging, if > 0");
   options.Parse(argc, argv);
 
   Reconstruction reconstruction1;
@@ -1328,6 +2263,13 @@ int RunModelMerger(int argc, char** argv) {
   PrintHeading2("Merging reconstructions");
   if (reconstruction1.Merge(reconstruction2, max_reproj_error)) {
     std::cout << "=> Merge succeeded" << std::endl;
+    if (max_point_distance > 0) {
+      const size_t num_merged_points3D =
+          reconstruction1.MergeNearbyPoints3D(max_point_distance);
+      std::cout << StringPrintf("=> Merged %d nearby points",
+                                num_merged_points3D)
+                << std::endl;
+    }
     PrintHeading2("Merged reconstruction");
     std::cout << StringPrintf("Images: %d", reconstruction1.NumRegImages())
               << std::endl;
@@ -1357,6 +2299,10 @@ int RunModelOrientationAligner(int argc, char** argv) {
                            "{MANHATTAN-WORLD, IMAGE-ORIENTATION}");
   options.AddDefaultOption("max_image_size",
                            &frame_estimation_options.max_image_size);
+  options.AddDefaultOption("max_num_images",
+                           &frame_estimation_options.max_num_images);
+  options.AddDefaultOption("num_threads",
+                           &frame_estimation_options.num_threads);
   options.Parse(argc, argv);
 
   StringToLower(&method);
@@ -1474,6 +2420,8 @@ int RunPointTriangulator(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
   bool clear_points = false;
+  bool triangulate_all_images = false;
+  bool refine_points = true;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -1483,6 +2431,13 @@ int RunPointTriangulator(int argc, char** argv) {
   options.AddDefaultOption(
       "clear_points", &clear_points,
       "Whether to clear all existing points and observations");
+  options.AddDefaultOption(
+      "triangulate_all_images", &triangulate_all_images,
+      "Whether to triangulate all images at once in parallel instead of one "
+      "after another, which is faster for many images");
+  options.AddDefaultOption(
+      "refine_points", &refine_points,
+      "Whether to refine the points in bundle adjustment with fixed poses");
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -1517,7 +2472,8 @@ int RunPointTriangulator(int argc, char** argv) {
         static_cast<size_t>(mapper_options.min_num_matches);
     database_cache.Load(database, min_num_matches,
                         mapper_options.ignore_watermarks,
-                        mapper_options.image_names);
+                        mapper_options.image_names,
+                        mapper_options.num_threads);
 
     if (clear_points) {
       reconstruction.DeleteAllPoints2DAndPoints3D();
@@ -1544,23 +2500,31 @@ int RunPointTriangulator(int argc, char** argv) {
 
   const auto& reg_image_ids = reconstruction.RegImageIds();
 
-  for (size_t i = 0; i < reg_image_ids.size(); ++i) {
-    const image_t image_id = reg_image_ids[i];
+  if (triangulate_all_images) {
+    PrintHeading1(
+        StringPrintf("Triangulating %d images", reg_image_ids.size()));
+    std::cout << "  => Triangulated "
+              << mapper.TriangulateAllImages(tri_options) << " observations"
+              << std::endl;
+  } else {
+    for (size_t i = 0; i < reg_image_ids.size(); ++i) {
+      const image_t image_id = reg_image_ids[i];
 
-    const auto& image = reconstruction.Image(image_id);
+      const auto& image = reconstruction.Image(image_id);
 
-    PrintHeading1(StringPrintf("Triangulating image #%d (%d)", image_id, i));
+      PrintHeading1(StringPrintf("Triangulating image #%d (%d)", image_id, i));
 
-    const size_t num_existing_points3D = image.NumPoints3D();
+      const size_t num_existing_points3D = image.NumPoints3D();
 
-    std::cout << "  => Image sees " << num_existing_points3D << " / "
-              << image.NumObservations() << " points" << std::endl;
+      std::cout << "  => Image sees " << num_existing_points3D << " / "
+                << image.NumObservations() << " points" << std::endl;
 
-    mapper.TriangulateImage(tri_options, image_id);
+      mapper.TriangulateImage(tri_options, image_id);
 
-    std::cout << "  => Triangulated "
-              << (image.NumPoints3D() - num_existing_points3D) << " points"
-              << std::endl;
+      std::cout << "  => Triangulated "
+                << (image.NumPoints3D() - num_existing_points3D) << " points"
+                << std::endl;
+    }
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -1587,7 +2551,14 @@ int RunPointTriangulator(int argc, char** argv) {
     ba_config.AddImage(image_id);
   }
 
-  for (int i = 0; i < mapper_options.ba_global_max_refinements; ++i) {
+  // Without refinement, the points are only filtered once.
+  const int num_refinements =
+      refine_points ? mapper_options.ba_global_max_refinements : 0;
+  if (!refine_points) {
+    FilterPoints(mapper_options, &mapper);
+  }
+
+  for (int i = 0; i < num_refinements; ++i) {
     // Avoid degeneracies in bundle adjustment.
     reconstruction.FilterObservationsWithNegativeDepth();
 
@@ -1740,6 +2711,85 @@ std::vector<CameraRig> ReadCameraRigConfig(
   return camera_rigs;
 }
 
+int RunRedundantImageDetector(int argc, char** argv) {
+  std::string output_path;
+
+  RedundantImageOptions redundant_image_options;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("max_num_features",
+                           &redundant_image_options.max_num_features);
+  options.AddDefaultOption("min_match_ratio",
+                           &redundant_image_options.min_match_ratio);
+  options.AddDefaultOption("max_displacement",
+                           &redundant_image_options.max_displacement);
+  options.AddDefaultOption("max_num_consecutive_images",
+                           &redundant_image_options.max_num_consecutive_images);
+  options.AddDefaultOption("max_ratio", &redundant_image_options.max_ratio);
+  options.AddDefaultOption("max_distance",
+                           &redundant_image_options.max_distance);
+  options.AddDefaultOption("num_threads", &redundant_image_options.num_threads);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    std::cerr << "ERROR: `output_path` is not a directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  PrintHeading1("Redundant image detection");
+
+  Database database(*options.database_path);
+
+  const RedundantImages redundant_images =
+      FindRedundantImages(redundant_image_options, database);
+
+  std::unordered_map<image_t, std::string> image_names;
+  for (const auto& image : database.ReadAllImages()) {
+    image_names.emplace(image.ImageId(), image.Name());
+  }
+
+  // The keyframes are matched and reconstructed as usual.
+  std::ofstream keyframes_file(JoinPaths(output_path, "keyframes.txt"));
+  CHECK(keyframes_file.is_open());
+  std::unordered_map<image_t, image_t> next_keyframe_ids;
+  for (size_t i = 0; i < redundant_images.keyframe_ids.size(); ++i) {
+    const image_t keyframe_id = redundant_images.keyframe_ids[i];
+    keyframes_file << image_names.at(keyframe_id) << std::endl;
+    if (i + 1 < redundant_images.keyframe_ids.size()) {
+      next_keyframe_ids.emplace(keyframe_id,
+                                redundant_images.keyframe_ids[i + 1]);
+    }
+  }
+
+  // The redundant images are skipped in matching and mapping. Afterwards,
+  // they are matched against their surrounding keyframes, see
+  // `ImagePairsFeatureMatcher`, and registered with the image registrator.
+  std::ofstream images_file(JoinPaths(output_path, "redundant_images.txt"));
+  CHECK(images_file.is_open());
+  std::ofstream pairs_file(JoinPaths(output_path, "redundant_image_pairs.txt"));
+  CHECK(pairs_file.is_open());
+  for (const auto& image_ids : redundant_images.redundant_image_ids) {
+    const std::string& image_name = image_names.at(image_ids.first);
+    images_file << image_name << std::endl;
+    pairs_file << image_name << " " << image_names.at(image_ids.second)
+               << std::endl;
+    const auto next_keyframe_id = next_keyframe_ids.find(image_ids.second);
+    if (next_keyframe_id != next_keyframe_ids.end()) {
+      pairs_file << image_name << " "
+                 << image_names.at(next_keyframe_id->second) << std::endl;
+    }
+  }
+
+  std::cout << StringPrintf("Kept %d keyframes of %d images",
+                            redundant_images.keyframe_ids.size(),
+                            image_names.size())
+            << std::endl;
+
+  return EXIT_SUCCESS;
+}
+
 int RunRigBundleAdjuster(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -1815,6 +2865,72 @@ int RunSpatialMatcher(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunSyntheticDatasetGenerator(int argc, char** argv) {
+  std::string output_path;
+  SyntheticDatasetOptions synthetic_options;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("num_cameras", &synthetic_options.num_cameras);
+  options.AddDefaultOption("num_images", &synthetic_options.num_images);
+  options.AddDefaultOption("num_points3D", &synthetic_options.num_points3D);
+  options.AddDefaultOption("camera_model_name",
+                           &synthetic_options.camera_model_name);
+  options.AddDefaultOption("camera_width", &synthetic_options.camera_width);
+  options.AddDefaultOption("camera_height", &synthetic_options.camera_height);
+  options.AddDefaultOption("mean_track_length",
+                           &synthetic_options.mean_track_length);
+  options.AddDefaultOption("num_points2D_without_point3D",
+                           &synthetic_options.num_points2D_without_point3D);
+  options.AddDefaultOption("point2D_stddev",
+                           &synthetic_options.point2D_stddev);
+  options.AddDefaultOption("match_outlier_ratio",
+                           &synthetic_options.match_outlier_ratio);
+  options.AddDefaultOption("write_descriptors",
+                           &synthetic_options.write_descriptors);
+  options.AddDefaultOption("prng_seed", &synthetic_options.prng_seed);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    std::cerr << "ERROR: `output_path` is not a directory" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Database database(*options.database_path);
+  if (database.NumCameras() > 0 || database.NumImages() > 0) {
+    std::cerr << "ERROR: Database must be empty" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  PrintHeading1("Synthesizing dataset");
+
+  Timer timer;
+  timer.Start();
+
+  Reconstruction reconstruction;
+  SynthesizeDataset(synthetic_options, &reconstruction, &database);
+
+  std::cout << StringPrintf("Cameras: %d", reconstruction.NumCameras())
+            << std::endl;
+  std::cout << StringPrintf("Images: %d", reconstruction.NumImages())
+            << std::endl;
+  std::cout << StringPrintf("Points: %d", reconstruction.NumPoints3D())
+            << std::endl;
+  std::cout << StringPrintf("Mean track length: %f",
+                            reconstruction.ComputeMeanTrackLength())
+            << std::endl;
+  std::cout << StringPrintf("Verified image pairs: %d",
+                            database.NumVerifiedImagePairs())
+            << std::endl;
+
+  reconstruction.Write(output_path);
+
+  timer.PrintMinutes();
+
+  return EXIT_SUCCESS;
+}
+
 int RunTransitiveMatcher(int argc, char** argv) {
   OptionManager options;
   options.AddDatabaseOptions();
@@ -1888,10 +3004,34 @@ FeatureDescriptors LoadRandomDatabaseDescriptors(
   return descriptors;
 }
 
+// Samples descriptors for training from the database, without loading all
+// descriptors into memory. The descriptors are read from randomly selected
+// images until the requested number of descriptors is reached.
+FeatureDescriptors SampleDatabaseDescriptors(const std::vector<Image>& images,
+                                             const size_t num_descriptors,
+                                             Database* database) {
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  size_t descriptor_row = 0;
+  while (descriptor_row < num_descriptors) {
+    const auto& image =
+        images.at(RandomInteger<size_t>(0, images.size() - 1));
+    const FeatureDescriptors image_descriptors =
+        database->ReadDescriptors(image.ImageId());
+    const size_t num_image_descriptors = std::min<size_t>(
+        image_descriptors.rows(), num_descriptors - descriptor_row);
+    descriptors.block(descriptor_row, 0, num_image_descriptors, 128) =
+        image_descriptors.topRows(num_image_descriptors);
+    descriptor_row += num_image_descriptors;
+  }
+  return descriptors;
+}
+
 int RunVocabTreeBuilder(int argc, char** argv) {
   std::string vocab_tree_path;
   retrieval::VisualIndex<>::BuildOptions build_options;
+  retrieval::VisualIndex<>::MiniBatchBuildOptions mini_batch_options;
   int max_num_images = -1;
+  bool mini_batch = false;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -1901,10 +3041,47 @@ int RunVocabTreeBuilder(int argc, char** argv) {
   options.AddDefaultOption("branching", &build_options.branching);
   options.AddDefaultOption("num_iterations", &build_options.num_iterations);
   options.AddDefaultOption("max_num_images", &max_num_images);
+  options.AddDefaultOption("mini_batch", &mini_batch);
+  options.AddDefaultOption("batch_size", &mini_batch_options.batch_size);
+  options.AddDefaultOption("num_batches", &mini_batch_options.num_batches);
+  options.AddDefaultOption("num_embedding_descriptors",
+                           &mini_batch_options.num_embedding_descriptors);
+  options.AddDefaultOption("checkpoint_path",
+                           &mini_batch_options.checkpoint_path);
+  options.AddDefaultOption("checkpoint_freq",
+                           &mini_batch_options.checkpoint_freq);
   options.Parse(argc, argv);
 
   retrieval::VisualIndex<> visual_index;
 
+  if (mini_batch) {
+    mini_batch_options.num_visual_words = build_options.num_visual_words;
+    mini_batch_options.num_checks = build_options.num_checks;
+
+    Database database(*options.database_path);
+    const std::vector<Image> images = database.ReadAllImages();
+    CHECK_GT(database.NumDescriptors(), 0);
+
+    size_t num_sampled_descriptors = 0;
+    const auto sampler = [&](const size_t num_descriptors) {
+      num_sampled_descriptors += num_descriptors;
+      std::cout << "  => Sampling " << num_descriptors << " descriptors ("
+                << num_sampled_descriptors << " in total)" << std::endl;
+      return SampleDatabaseDescriptors(images, num_descriptors, &database);
+    };
+
+    std::cout << "Building index for visual words in mini-batches..."
+              << std::endl;
+    visual_index.BuildMiniBatch(mini_batch_options, sampler);
+    std::cout << " => Quantized descriptor space using "
+              << visual_index.NumVisualWords() << " visual words" << std::endl;
+
+    std::cout << "Saving index to file..." << std::endl;
+    visual_index.Write(vocab_tree_path);
+
+    return EXIT_SUCCESS;
+  }
+
   std::cout << "Loading descriptors..." << std::endl;
   const auto descriptors =
       LoadRandomDatabaseDescriptors(*options.database_path, max_num_images);
@@ -2037,9 +3214,10 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   visual_index.Prepare();
 
   // Optionally save the indexing data for the database images (as well as the
-  // original vocabulary tree data) to speed up future indexing.
+  // original vocabulary tree data) to speed up future indexing. The index is
+  // written in the memory-mapped layout, so that it is quickly read again.
   if (!output_index_path.empty()) {
-    visual_index.Write(output_index_path);
+    visual_index.WriteMapped(output_index_path);
   }
 
   if (query_images.empty()) {
@@ -2143,9 +3321,14 @@ int main(int argc, char** argv) {
   commands.emplace_back("database_creator", &RunDatabaseCreator);
   commands.emplace_back("database_merger", &RunDatabaseMerger);
   commands.emplace_back("delaunay_mesher", &RunDelaunayMesher);
+  commands.emplace_back("descriptor_compressor", &RunDescriptorCompressor);
   commands.emplace_back("exhaustive_matcher", &RunExhaustiveMatcher);
   commands.emplace_back("feature_extractor", &RunFeatureExtractor);
   commands.emplace_back("feature_importer", &RunFeatureImporter);
+  commands.emplace_back("feature_store_exporter", &RunFeatureStoreExporter);
+  commands.emplace_back("global_descriptor_extractor",
+                        &RunGlobalDescriptorExtractor);
+  commands.emplace_back("global_mapper", &RunGlobalMapper);
   commands.emplace_back("hierarchical_mapper", &RunHierarchicalMapper);
   commands.emplace_back("image_deleter", &RunImageDeleter);
   commands.emplace_back("image_filterer", &RunImageFilterer);
@@ -2154,23 +3337,32 @@ int main(int argc, char** argv) {
   commands.emplace_back("image_undistorter", &RunImageUndistorter);
   commands.emplace_back("image_undistorter_standalone",
                         &RunImageUndistorterStandalone);
+  commands.emplace_back("journal_compactor", &RunJournalCompactor);
   commands.emplace_back("mapper", &RunMapper);
   commands.emplace_back("matches_importer", &RunMatchesImporter);
+  commands.emplace_back("matching_server", &RunMatchingServer);
   commands.emplace_back("model_aligner", &RunModelAligner);
   commands.emplace_back("model_analyzer", &RunModelAnalyzer);
   commands.emplace_back("model_converter", &RunModelConverter);
   commands.emplace_back("model_merger", &RunModelMerger);
   commands.emplace_back("model_orientation_aligner",
                         &RunModelOrientationAligner);
+  commands.emplace_back("online_mapper", &RunOnlineMapper);
   commands.emplace_back("patch_match_stereo", &RunPatchMatchStereo);
   commands.emplace_back("point_filtering", &RunPointFiltering);
   commands.emplace_back("point_triangulator", &RunPointTriangulator);
   commands.emplace_back("poisson_mesher", &RunPoissonMesher);
   commands.emplace_back("project_generator", &RunProjectGenerator);
+  commands.emplace_back("redundant_image_detector",
+                        &RunRedundantImageDetector);
   commands.emplace_back("rig_bundle_adjuster", &RunRigBundleAdjuster);
   commands.emplace_back("sequential_matcher", &RunSequentialMatcher);
   commands.emplace_back("spatial_matcher", &RunSpatialMatcher);
+  commands.emplace_back("stereo_clustering", &RunStereoClustering);
   commands.emplace_back("stereo_fusion", &RunStereoFuser);
+  commands.emplace_back("stereo_fusion_merger", &RunStereoFusionMerger);
+  commands.emplace_back("synthetic_dataset_generator",
+                        &RunSyntheticDatasetGenerator);
   commands.emplace_back("transitive_matcher", &RunTransitiveMatcher);
   commands.emplace_back("vocab_tree_builder", &RunVocabTreeBuilder);
   commands.emplace_back("vocab_tree_matcher", &RunVocabTreeMatcher);
@@ -31,15 +31,20 @@
 
 #include "feature/extraction.h"
 
+#include <fstream>
+#include <map>
 #include <numeric>
+#include <sstream>
 
 #include "SiftGPU/SiftGPU.h"
 #include "feature/sift.h"
 #include "util/cuda.h"
+#include "util/metrics.h"
 #include "util/misc.h"
+#include "util/trace.h"
 
 namespace colmap {
-namespace {
+namespace internal {
 
 void ScaleKeypoints(const Bitmap& bitmap, const Camera& camera,
                     FeatureKeypoints* keypoints) {
@@ -79,6 +84,20 @@ void MaskKeypoints(const Bitmap& mask, FeatureKeypoints* keypoints,
   descriptors->conservativeResize(out_index, descriptors->cols());
 }
 
+}  // namespace internal
+
+namespace {
+
+// Decode the images directly at the resolution at which the features are
+// extracted, if the image format supports it.
+ImageReaderOptions DecodeAtMaxImageSize(
+    const ImageReaderOptions& reader_options,
+    const SiftExtractionOptions& sift_options) {
+  ImageReaderOptions decode_reader_options = reader_options;
+  decode_reader_options.max_image_size = sift_options.max_image_size;
+  return decode_reader_options;
+}
+
 }  // namespace
 
 SiftFeatureExtractor::SiftFeatureExtractor(
@@ -87,7 +106,8 @@ SiftFeatureExtractor::SiftFeatureExtractor(
     : reader_options_(reader_options),
       sift_options_(sift_options),
       database_(reader_options_.database_path),
-      image_reader_(reader_options_, &database_) {
+      image_reader_(DecodeAtMaxImageSize(reader_options_, sift_options_),
+                    &database_) {
   CHECK(reader_options_.Check());
   CHECK(sift_options_.Check());
 
@@ -103,23 +123,30 @@ SiftFeatureExtractor::SiftFeatureExtractor(
     }
   }
 
+  if (!sift_options_.feature_cache_path.empty()) {
+    if (reader_options_.mask_path.empty()) {
+      std::string camera_mask_data;
+      if (camera_mask) {
+        std::ifstream file(reader_options_.camera_mask_path, std::ios::binary);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        camera_mask_data = contents.str();
+      }
+      feature_cache_.reset(new FeatureCache(sift_options_.feature_cache_path,
+                                            sift_options_, camera_mask_data));
+    } else {
+      std::cout << "WARNING: The feature cache is not used with image masks."
+                << std::endl;
+    }
+  }
+
   const int num_threads = GetEffectiveNumThreads(sift_options_.num_threads);
   CHECK_GT(num_threads, 0);
 
-  // Make sure that we only have limited number of objects in the queue to avoid
-  // excess in memory usage since images and features take lots of memory.
-  const int kQueueSize = 1;
-  resizer_queue_.reset(new JobQueue<internal::ImageData>(kQueueSize));
-  extractor_queue_.reset(new JobQueue<internal::ImageData>(kQueueSize));
-  writer_queue_.reset(new JobQueue<internal::ImageData>(kQueueSize));
-
-  if (sift_options_.max_image_size > 0) {
-    for (int i = 0; i < num_threads; ++i) {
-      resizers_.emplace_back(new internal::ImageResizerThread(
-          sift_options_.max_image_size, resizer_queue_.get(),
-          extractor_queue_.get()));
-    }
-  }
+  reader_throughput_.reset(new internal::StageThroughput());
+  resizer_throughput_.reset(new internal::StageThroughput());
+  extractor_throughput_.reset(new internal::StageThroughput());
+  writer_throughput_.reset(new internal::StageThroughput());
 
   if (!sift_options_.domain_size_pooling &&
       !sift_options_.estimate_affine_shape && sift_options_.use_gpu) {
@@ -135,12 +162,25 @@ SiftFeatureExtractor::SiftFeatureExtractor(
     }
 #endif  // CUDA_ENABLED
 
+    // All devices pull from the same queue, such that an idle device always
+    // takes the next available image, while a device that is busy with a
+    // large image does not hold back the other devices. Make sure that we
+    // only have a limited number of objects in the queues to avoid excess in
+    // memory usage since images and features take lots of memory, but allow
+    // one batch of images per device to keep all devices busy. The writer
+    // queue only holds features and can buffer the next batch of images,
+    // while the previous batch is committed to the database.
+    extractor_queue_.reset(new JobQueue<internal::ImageData>(
+        gpu_indices.size() * sift_options_.gpu_batch_size));
+    writer_queue_.reset(new JobQueue<internal::ImageData>(std::max<size_t>(
+        gpu_indices.size(), sift_options_.max_writer_batch_size)));
+
     auto sift_gpu_options = sift_options_;
     for (const auto& gpu_index : gpu_indices) {
       sift_gpu_options.gpu_index = std::to_string(gpu_index);
       extractors_.emplace_back(new internal::SiftFeatureExtractorThread(
           sift_gpu_options, camera_mask, extractor_queue_.get(),
-          writer_queue_.get()));
+          writer_queue_.get(), extractor_throughput_.get()));
     }
   } else {
     if (sift_options_.num_threads == -1 &&
@@ -158,17 +198,42 @@ SiftFeatureExtractor::SiftFeatureExtractor(
           << std::endl;
     }
 
+    extractor_queue_.reset(new JobQueue<internal::ImageData>(num_threads));
+    writer_queue_.reset(new JobQueue<internal::ImageData>(
+        std::max(num_threads, sift_options_.max_writer_batch_size)));
+
+    // With tiling, the tiles of all images are extracted by a shared pool of
+    // threads, such that the cores are also used when only few very large
+    // images are extracted at the same time.
+    if (sift_options_.tile_size > 0) {
+      tile_thread_pool_.reset(new ThreadPool(num_threads));
+    }
+
     auto custom_sift_options = sift_options_;
     custom_sift_options.use_gpu = false;
     for (int i = 0; i < num_threads; ++i) {
       extractors_.emplace_back(new internal::SiftFeatureExtractorThread(
           custom_sift_options, camera_mask, extractor_queue_.get(),
-          writer_queue_.get()));
+          writer_queue_.get(), extractor_throughput_.get(),
+          tile_thread_pool_.get()));
     }
   }
 
+  if (sift_options_.max_image_size > 0) {
+    resizer_queue_.reset(new JobQueue<internal::ImageData>(num_threads));
+    for (int i = 0; i < num_threads; ++i) {
+      resizers_.emplace_back(new internal::ImageResizerThread(
+          sift_options_.max_image_size, resizer_queue_.get(),
+          extractor_queue_.get(), resizer_throughput_.get()));
+    }
+  } else {
+    resizer_queue_.reset(new JobQueue<internal::ImageData>(1));
+  }
+
   writer_.reset(new internal::FeatureWriterThread(
-      image_reader_.NumImages(), &database_, writer_queue_.get()));
+      image_reader_.NumImages(), &database_, writer_queue_.get(),
+      writer_throughput_.get(), sift_options_.max_writer_batch_size,
+      sift_options_.max_writer_batch_delay_ms, feature_cache_.get()));
 }
 
 void SiftFeatureExtractor::Run() {
@@ -199,19 +264,46 @@ void SiftFeatureExtractor::Run() {
       break;
     }
 
+    Timer reader_timer;
+    reader_timer.Start();
+
     internal::ImageData image_data;
-    image_data.status =
-        image_reader_.Next(&image_data.camera, &image_data.image,
-                           &image_data.bitmap, &image_data.mask);
+    bool is_cached = false;
+    {
+      const TraceSpan trace_span("extraction/read");
+      // Look up the features in the cache before the image is decoded.
+      if (feature_cache_) {
+        image_data.feature_cache_key =
+            feature_cache_->ImageKey(image_reader_.PeekImageData());
+        is_cached = feature_cache_->Read(image_data.feature_cache_key,
+                                         &image_data.keypoints,
+                                         &image_data.descriptors);
+      }
+      image_data.status = image_reader_.Next(
+          &image_data.camera, &image_data.image, &image_data.bitmap,
+          &image_data.mask, /*read_bitmap=*/!is_cached);
+    }
 
     if (image_data.status != ImageReader::Status::SUCCESS) {
       image_data.bitmap.Deallocate();
     }
 
-    if (sift_options_.max_image_size > 0) {
-      CHECK(resizer_queue_->Push(image_data));
+    reader_throughput_->Add(reader_timer.ElapsedSeconds());
+
+    if (is_cached) {
+      // Cached features are directly written to the database.
+      static MetricCounter& num_cached_images = GetMetricCounter(
+          "extraction_cached_images_total",
+          "Number of images with features read from the feature cache");
+      if (image_data.status == ImageReader::Status::SUCCESS) {
+        num_cached_images.Increment();
+      }
+      image_data.feature_cache_key.clear();
+      CHECK(writer_queue_->Push(std::move(image_data)));
+    } else if (sift_options_.max_image_size > 0) {
+      CHECK(resizer_queue_->Push(std::move(image_data)));
     } else {
-      CHECK(extractor_queue_->Push(image_data));
+      CHECK(extractor_queue_->Push(std::move(image_data)));
     }
   }
 
@@ -231,6 +323,25 @@ void SiftFeatureExtractor::Run() {
   writer_queue_->Stop();
   writer_->Wait();
 
+  const double elapsed_seconds = GetTimer().ElapsedSeconds();
+  std::cout << std::endl << "Throughput:" << std::endl;
+  reader_throughput_->Print("Reading", 1, elapsed_seconds);
+  if (!resizers_.empty()) {
+    resizer_throughput_->Print("Resizing", resizers_.size(), elapsed_seconds);
+  }
+  extractor_throughput_->Print("Extraction", extractors_.size(),
+                               elapsed_seconds);
+  writer_throughput_->Print("Writing", 1, elapsed_seconds);
+  const auto writer = static_cast<internal::FeatureWriterThread*>(writer_.get());
+  std::cout << StringPrintf(
+                   "  %-12s %d batches, %.1f images/batch, %.1fms mean "
+                   "latency, %.1fms max latency",
+                   "Committing:", static_cast<int>(writer->NumBatches()),
+                   writer->MeanBatchSize(), 1e3 * writer->MeanCommitSeconds(),
+                   1e3 * writer->MaxCommitSeconds())
+            << std::endl;
+  std::cout << std::endl;
+
   GetTimer().PrintMinutes();
 }
 
@@ -249,63 +360,147 @@ void FeatureImporter::Run() {
   Database database(reader_options_.database_path);
   ImageReader image_reader(reader_options_, &database);
 
-  while (image_reader.NextIndex() < image_reader.NumImages()) {
-    if (IsStopped()) {
-      break;
-    }
+  // Feature files are parsed in parallel while the images are read in order.
+  // The parsed features are written in batches, each in a single transaction,
+  // since committing a transaction per image dominates the import time for
+  // large datasets.
+  const size_t kBatchSize = 512;
 
-    std::cout << StringPrintf("Processing file [%d/%d]",
-                              image_reader.NextIndex() + 1,
-                              image_reader.NumImages())
-              << std::endl;
+  typedef std::pair<FeatureKeypoints, FeatureDescriptors> Features;
 
-    // Load image data and possibly save camera to database.
-    Camera camera;
+  struct ImportItem {
+    size_t index;
     Image image;
-    Bitmap bitmap;
-    if (image_reader.Next(&camera, &image, &bitmap, nullptr) !=
-        ImageReader::Status::SUCCESS) {
-      continue;
-    }
+    std::future<Features> features;
+  };
 
-    const std::string path = JoinPaths(import_path_, image.Name() + ".txt");
+  ThreadPool thread_pool;
+  std::vector<ImportItem> batch;
+  batch.reserve(kBatchSize);
 
-    if (ExistsFile(path)) {
-      FeatureKeypoints keypoints;
-      FeatureDescriptors descriptors;
-      LoadSiftFeaturesFromTextFile(path, &keypoints, &descriptors);
+  const size_t num_images = image_reader.NumImages();
 
-      std::cout << "  Features:       " << keypoints.size() << std::endl;
+  auto WriteBatch = [&]() {
+    DatabaseTransaction database_transaction(&database);
+    for (auto& item : batch) {
+      const Features features = item.features.get();
 
-      DatabaseTransaction database_transaction(&database);
+      std::cout << StringPrintf("Processing file [%d/%d]", item.index + 1,
+                                num_images)
+                << std::endl;
+      std::cout << "  Features:       " << features.first.size()
+                << std::endl;
 
+      Image& image = item.image;
       if (image.ImageId() == kInvalidImageId) {
         image.SetImageId(database.WriteImage(image));
       }
 
       if (!database.ExistsKeypoints(image.ImageId())) {
-        database.WriteKeypoints(image.ImageId(), keypoints);
+        database.WriteKeypoints(image.ImageId(), features.first);
       }
 
       if (!database.ExistsDescriptors(image.ImageId())) {
-        database.WriteDescriptors(image.ImageId(), descriptors);
+        database.WriteDescriptors(image.ImageId(), features.second);
       }
+    }
+    batch.clear();
+  };
+
+  while (image_reader.NextIndex() < num_images) {
+    if (IsStopped()) {
+      break;
+    }
+
+    const size_t index = image_reader.NextIndex();
+
+    // Load image data and possibly save camera to database.
+    Camera camera;
+    Image image;
+    Bitmap bitmap;
+    if (image_reader.Next(&camera, &image, &bitmap, nullptr) !=
+        ImageReader::Status::SUCCESS) {
+      continue;
+    }
+
+    const std::string binary_path =
+        JoinPaths(import_path_, image.Name() + ".bin");
+    const std::string text_path =
+        JoinPaths(import_path_, image.Name() + ".txt");
+
+    ImportItem item;
+    item.index = index;
+    item.image = image;
+    if (ExistsFile(binary_path)) {
+      item.features = thread_pool.AddTask([binary_path]() {
+        Features features;
+        LoadSiftFeaturesFromBinaryFile(binary_path, &features.first,
+                                       &features.second);
+        return features;
+      });
+    } else if (ExistsFile(text_path)) {
+      item.features = thread_pool.AddTask([text_path]() {
+        Features features;
+        LoadSiftFeaturesFromTextFile(text_path, &features.first,
+                                     &features.second);
+        return features;
+      });
     } else {
-      std::cout << "  SKIP: No features found at " << path << std::endl;
+      std::cout << StringPrintf("Processing file [%d/%d]", index + 1,
+                                num_images)
+                << std::endl;
+      std::cout << "  SKIP: No features found at " << text_path << std::endl;
+      continue;
+    }
+
+    batch.push_back(std::move(item));
+    if (batch.size() >= kBatchSize) {
+      WriteBatch();
     }
   }
 
+  WriteBatch();
+
   GetTimer().PrintMinutes();
 }
 
 namespace internal {
 
+void StageThroughput::Add(const double processing_seconds,
+                          const size_t num_images) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_images_ += num_images;
+  processing_seconds_ += processing_seconds;
+}
+
+void StageThroughput::Print(const std::string& name, const size_t num_threads,
+                            const double elapsed_seconds) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const double images_per_second =
+      elapsed_seconds > 0 ? num_images_ / elapsed_seconds : 0;
+  // Fraction of the available thread time spent on processing, i.e., a value
+  // close to 1 means that this stage is the bottleneck of the pipeline.
+  const double utilization =
+      elapsed_seconds > 0 && num_threads > 0
+          ? processing_seconds_ / (num_threads * elapsed_seconds)
+          : 0;
+  std::cout << StringPrintf(
+                   "  %-12s %d images, %.2f images/s, %d threads, "
+                   "%.1f%% utilization",
+                   (name + ":").c_str(), static_cast<int>(num_images_),
+                   images_per_second, static_cast<int>(num_threads),
+                   100 * utilization)
+            << std::endl;
+}
+
 ImageResizerThread::ImageResizerThread(const int max_image_size,
                                        JobQueue<ImageData>* input_queue,
-                                       JobQueue<ImageData>* output_queue)
+                                       JobQueue<ImageData>* output_queue,
+                                       StageThroughput* throughput)
     : max_image_size_(max_image_size),
       input_queue_(input_queue),
-      output_queue_(output_queue) {}
+      output_queue_(output_queue),
+      throughput_(throughput) {}
 
 void ImageResizerThread::Run() {
   while (true) {
@@ -313,11 +508,15 @@ void ImageResizerThread::Run() {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
-      auto image_data = input_job.Data();
+      Timer timer;
+      timer.Start();
+
+      auto image_data = std::move(input_job.Data());
 
       if (image_data.status == ImageReader::Status::SUCCESS) {
+        const TraceSpan trace_span("extraction/resize");
         if (static_cast<int>(image_data.bitmap.Width()) > max_image_size_ ||
             static_cast<int>(image_data.bitmap.Height()) > max_image_size_) {
           // Fit the down-sampled version exactly into the max dimensions.
@@ -329,11 +528,15 @@ void ImageResizerThread::Run() {
           const int new_height =
               static_cast<int>(image_data.bitmap.Height() * scale);
 
-          image_data.bitmap.Rescale(new_width, new_height);
+          image_data.bitmap.Downsize(new_width, new_height);
         }
       }
 
-      output_queue_->Push(image_data);
+      if (throughput_ != nullptr) {
+        throughput_->Add(timer.ElapsedSeconds());
+      }
+
+      output_queue_->Push(std::move(image_data));
     } else {
       break;
     }
@@ -343,11 +546,14 @@ void ImageResizerThread::Run() {
 SiftFeatureExtractorThread::SiftFeatureExtractorThread(
     const SiftExtractionOptions& sift_options,
     const std::shared_ptr<Bitmap>& camera_mask,
-    JobQueue<ImageData>* input_queue, JobQueue<ImageData>* output_queue)
+    JobQueue<ImageData>* input_queue, JobQueue<ImageData>* output_queue,
+    StageThroughput* throughput, ThreadPool* tile_thread_pool)
     : sift_options_(sift_options),
       camera_mask_(camera_mask),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      throughput_(throughput),
+      tile_thread_pool_(tile_thread_pool) {
   CHECK(sift_options_.Check());
 
 #ifndef CUDA_ENABLED
@@ -380,57 +586,214 @@ void SiftFeatureExtractorThread::Run() {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
-      auto image_data = input_job.Data();
+      Timer timer;
+      timer.Start();
 
-      if (image_data.status == ImageReader::Status::SUCCESS) {
-        bool success = false;
-        if (sift_options_.estimate_affine_shape ||
-            sift_options_.domain_size_pooling) {
-          success = ExtractCovariantSiftFeaturesCPU(
-              sift_options_, image_data.bitmap, &image_data.keypoints,
-              &image_data.descriptors);
-        } else if (sift_options_.use_gpu) {
-          success = ExtractSiftFeaturesGPU(
-              sift_options_, image_data.bitmap, sift_gpu.get(),
-              &image_data.keypoints, &image_data.descriptors);
-        } else {
-          success = ExtractSiftFeaturesCPU(sift_options_, image_data.bitmap,
-                                           &image_data.keypoints,
-                                           &image_data.descriptors);
-        }
-        if (success) {
-          ScaleKeypoints(image_data.bitmap, image_data.camera,
-                         &image_data.keypoints);
-          if (camera_mask_) {
-            MaskKeypoints(*camera_mask_, &image_data.keypoints,
-                          &image_data.descriptors);
-          }
-          if (image_data.mask.Data()) {
-            MaskKeypoints(image_data.mask, &image_data.keypoints,
-                          &image_data.descriptors);
-          }
-        } else {
-          image_data.status = ImageReader::Status::FAILURE;
-        }
+      std::vector<ImageData> image_datas;
+      image_datas.push_back(std::move(input_job.Data()));
+
+      // Take further images that are already queued without waiting, so that
+      // their features are extracted together on the GPU.
+      if (sift_gpu) {
+        input_queue_->TryPopBatch(sift_options_.gpu_batch_size - 1,
+                                  &image_datas);
       }
 
-      image_data.bitmap.Deallocate();
+      ExtractFeatures(sift_gpu.get(), &image_datas);
+
+      const double elapsed_seconds = timer.ElapsedSeconds();
+      for (auto& image_data : image_datas) {
+        image_data.bitmap.Deallocate();
 
-      output_queue_->Push(image_data);
+        if (throughput_ != nullptr) {
+          throughput_->Add(elapsed_seconds / image_datas.size());
+        }
+
+        output_queue_->Push(std::move(image_data));
+      }
     } else {
       break;
     }
   }
 }
 
+void SiftFeatureExtractorThread::ExtractFeatures(
+    SiftGPU* sift_gpu, std::vector<ImageData>* image_datas) {
+  const TraceSpan trace_span("extraction/sift");
+
+  const auto FinishFeatures = [&](const bool success, ImageData* image_data) {
+    if (success) {
+      ScaleKeypoints(image_data->bitmap, image_data->camera,
+                     &image_data->keypoints);
+      if (camera_mask_) {
+        MaskKeypoints(*camera_mask_, &image_data->keypoints,
+                      &image_data->descriptors);
+      }
+      if (image_data->mask.Data()) {
+        MaskKeypoints(image_data->mask, &image_data->keypoints,
+                      &image_data->descriptors);
+      }
+    } else {
+      image_data->status = ImageReader::Status::FAILURE;
+    }
+  };
+
+  // The images to extract on the GPU, grouped by their size.
+  std::map<std::pair<int, int>, std::vector<ImageData*>> gpu_batches;
+
+  for (auto& image_data : *image_datas) {
+    if (image_data.status != ImageReader::Status::SUCCESS) {
+      continue;
+    }
+
+    bool success = false;
+    if (tile_thread_pool_ != nullptr) {
+      success = ExtractSiftFeaturesCPUTiled(
+          sift_options_, image_data.bitmap, tile_thread_pool_,
+          &image_data.keypoints, &image_data.descriptors);
+    } else if (sift_options_.estimate_affine_shape ||
+               sift_options_.domain_size_pooling) {
+      success = ExtractCovariantSiftFeaturesCPU(
+          sift_options_, image_data.bitmap, &image_data.keypoints,
+          &image_data.descriptors);
+    } else if (sift_options_.use_gpu) {
+      gpu_batches[std::make_pair(image_data.bitmap.Width(),
+                                 image_data.bitmap.Height())]
+          .push_back(&image_data);
+      continue;
+    } else {
+      success = ExtractSiftFeaturesCPU(sift_options_, image_data.bitmap,
+                                       &image_data.keypoints,
+                                       &image_data.descriptors);
+    }
+    FinishFeatures(success, &image_data);
+  }
+
+  for (auto& gpu_batch : gpu_batches) {
+    std::vector<const Bitmap*> bitmaps;
+    bitmaps.reserve(gpu_batch.second.size());
+    for (const ImageData* image_data : gpu_batch.second) {
+      bitmaps.push_back(&image_data->bitmap);
+    }
+
+    std::vector<FeatureKeypoints> keypoints;
+    std::vector<FeatureDescriptors> descriptors;
+    const bool success = ExtractSiftFeaturesGPUBatch(
+        sift_options_, bitmaps, sift_gpu, &keypoints, &descriptors);
+
+    for (size_t i = 0; i < gpu_batch.second.size(); ++i) {
+      ImageData* image_data = gpu_batch.second[i];
+      if (success) {
+        image_data->keypoints = std::move(keypoints[i]);
+        image_data->descriptors = std::move(descriptors[i]);
+      }
+      FinishFeatures(success, image_data);
+    }
+  }
+}
+
 FeatureWriterThread::FeatureWriterThread(const size_t num_images,
                                          Database* database,
-                                         JobQueue<ImageData>* input_queue)
-    : num_images_(num_images), database_(database), input_queue_(input_queue) {}
+                                         JobQueue<ImageData>* input_queue,
+                                         StageThroughput* throughput,
+                                         const int max_batch_size,
+                                         const int max_batch_delay_ms,
+                                         const FeatureCache* feature_cache)
+    : num_images_(num_images),
+      database_(database),
+      input_queue_(input_queue),
+      throughput_(throughput),
+      max_batch_size_(max_batch_size),
+      max_batch_delay_seconds_(max_batch_delay_ms / 1000.0),
+      feature_cache_(feature_cache),
+      num_batches_(0),
+      num_batch_images_(0),
+      total_commit_seconds_(0),
+      max_commit_seconds_(0) {
+  CHECK_GT(max_batch_size, 0);
+  CHECK_GE(max_batch_delay_ms, 0);
+}
+
+size_t FeatureWriterThread::NumBatches() const { return num_batches_; }
+
+double FeatureWriterThread::MeanBatchSize() const {
+  return num_batches_ > 0 ? static_cast<double>(num_batch_images_) /
+                                num_batches_
+                          : 0;
+}
+
+double FeatureWriterThread::MeanCommitSeconds() const {
+  return num_batches_ > 0 ? total_commit_seconds_ / num_batches_ : 0;
+}
+
+double FeatureWriterThread::MaxCommitSeconds() const {
+  return max_commit_seconds_;
+}
+
+void FeatureWriterThread::CommitBatch(std::vector<ImageData>* batch) {
+  if (batch->empty()) {
+    return;
+  }
+
+  const TraceSpan trace_span("extraction/write");
+
+  Timer timer;
+  timer.Start();
+
+  {
+    DatabaseTransaction database_transaction(database_);
+
+    for (auto& image_data : *batch) {
+      if (image_data.image.ImageId() == kInvalidImageId) {
+        image_data.image.SetImageId(database_->WriteImage(image_data.image));
+      }
+
+      if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
+        database_->WriteKeypoints(image_data.image.ImageId(),
+                                  image_data.keypoints);
+      }
+
+      if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
+        database_->WriteDescriptors(image_data.image.ImageId(),
+                                    image_data.descriptors);
+      }
+    }
+  }
+
+  static MetricCounter& num_written_images = GetMetricCounter(
+      "extraction_written_images_total",
+      "Number of images with features written to the database");
+  num_written_images.Increment(batch->size());
+
+  const double commit_seconds = timer.ElapsedSeconds();
+  num_batches_ += 1;
+  num_batch_images_ += batch->size();
+  total_commit_seconds_ += commit_seconds;
+  max_commit_seconds_ = std::max(max_commit_seconds_, commit_seconds);
+
+  if (throughput_ != nullptr) {
+    throughput_->Add(commit_seconds, batch->size());
+  }
+
+  if (feature_cache_ != nullptr) {
+    for (const auto& image_data : *batch) {
+      if (!image_data.feature_cache_key.empty()) {
+        feature_cache_->Write(image_data.feature_cache_key,
+                              image_data.keypoints, image_data.descriptors);
+      }
+    }
+  }
+
+  batch->clear();
+}
 
 void FeatureWriterThread::Run() {
+  std::vector<ImageData> batch;
+  batch.reserve(max_batch_size_);
+  Timer batch_timer;
+
   size_t image_index = 0;
   while (true) {
     if (IsStopped()) {
@@ -443,6 +806,14 @@ void FeatureWriterThread::Run() {
 
       image_index += 1;
 
+      static MetricCounter& num_processed_images = GetMetricCounter(
+          "extraction_processed_images_total", "Number of processed images");
+      static MetricGauge& num_queued_images =
+          GetMetricGauge("extraction_writer_queue_size",
+                         "Number of images waiting to be written");
+      num_processed_images.Increment();
+      num_queued_images.Set(input_queue_->Size());
+
       std::cout << StringPrintf("Processed file [%d/%d]", image_index,
                                 num_images_)
                 << std::endl;
@@ -503,25 +874,22 @@ void FeatureWriterThread::Run() {
                                 image_data.keypoints.size())
                 << std::endl;
 
-      DatabaseTransaction database_transaction(database_);
-
-      if (image_data.image.ImageId() == kInvalidImageId) {
-        image_data.image.SetImageId(database_->WriteImage(image_data.image));
+      if (batch.empty()) {
+        batch_timer.Restart();
       }
 
-      if (!database_->ExistsKeypoints(image_data.image.ImageId())) {
-        database_->WriteKeypoints(image_data.image.ImageId(),
-                                  image_data.keypoints);
-      }
+      batch.push_back(std::move(image_data));
 
-      if (!database_->ExistsDescriptors(image_data.image.ImageId())) {
-        database_->WriteDescriptors(image_data.image.ImageId(),
-                                    image_data.descriptors);
+      if (batch.size() >= max_batch_size_ ||
+          batch_timer.ElapsedSeconds() >= max_batch_delay_seconds_) {
+        CommitBatch(&batch);
       }
     } else {
       break;
     }
   }
+
+  CommitBatch(&batch);
 }
 
 }  // namespace internal
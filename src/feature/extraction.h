@@ -34,6 +34,7 @@
 
 #include "base/database.h"
 #include "base/image_reader.h"
+#include "feature/feature_cache.h"
 #include "feature/sift.h"
 #include "util/opengl_utils.h"
 #include "util/threading.h"
@@ -43,6 +44,7 @@ namespace colmap {
 namespace internal {
 
 struct ImageData;
+class StageThroughput;
 
 }  // namespace internal
 
@@ -61,6 +63,12 @@ class SiftFeatureExtractor : public Thread {
   Database database_;
   ImageReader image_reader_;
 
+  // Optional cache of features shared with other databases.
+  std::unique_ptr<FeatureCache> feature_cache_;
+
+  // Thread pool shared by all CPU extractor threads for tiled extraction.
+  std::unique_ptr<ThreadPool> tile_thread_pool_;
+
   std::vector<std::unique_ptr<Thread>> resizers_;
   std::vector<std::unique_ptr<Thread>> extractors_;
   std::unique_ptr<Thread> writer_;
@@ -68,10 +76,19 @@ class SiftFeatureExtractor : public Thread {
   std::unique_ptr<JobQueue<internal::ImageData>> resizer_queue_;
   std::unique_ptr<JobQueue<internal::ImageData>> extractor_queue_;
   std::unique_ptr<JobQueue<internal::ImageData>> writer_queue_;
+
+  std::unique_ptr<internal::StageThroughput> reader_throughput_;
+  std::unique_ptr<internal::StageThroughput> resizer_throughput_;
+  std::unique_ptr<internal::StageThroughput> extractor_throughput_;
+  std::unique_ptr<internal::StageThroughput> writer_throughput_;
 };
 
-// Import features from text files. Each image must have a corresponding text
-// file with the same name and an additional ".txt" suffix.
+// Import features from text or binary files. Each image must have a
+// corresponding file with the same name and an additional ".txt" suffix for
+// the text format or ".bin" suffix for the binary format, see
+// `LoadSiftFeaturesFromTextFile` and `LoadSiftFeaturesFromBinaryFile`. Binary
+// files take precedence if both exist. Feature files are parsed in parallel
+// and written to the database in batched transactions.
 class FeatureImporter : public Thread {
  public:
   FeatureImporter(const ImageReaderOptions& reader_options,
@@ -100,12 +117,42 @@ struct ImageData {
 
   FeatureKeypoints keypoints;
   FeatureDescriptors descriptors;
+
+  // Key of the image in the feature cache, if its extracted features are
+  // written to the cache.
+  std::string feature_cache_key;
+};
+
+// Rescale the keypoints extracted from a down-sampled bitmap to the original
+// resolution of the camera.
+void ScaleKeypoints(const Bitmap& bitmap, const Camera& camera,
+                    FeatureKeypoints* keypoints);
+
+// Remove the keypoints and descriptors in the black regions of the mask.
+void MaskKeypoints(const Bitmap& mask, FeatureKeypoints* keypoints,
+                   FeatureDescriptors* descriptors);
+
+// Thread-safe counter of the number of images processed by a pipeline stage
+// and the time spent processing them, excluding the time spent waiting on the
+// input and output queues. Shared by all threads of the same stage.
+class StageThroughput {
+ public:
+  void Add(const double processing_seconds, const size_t num_images = 1);
+
+  void Print(const std::string& name, const size_t num_threads,
+             const double elapsed_seconds) const;
+
+ private:
+  mutable std::mutex mutex_;
+  size_t num_images_ = 0;
+  double processing_seconds_ = 0;
 };
 
 class ImageResizerThread : public Thread {
  public:
   ImageResizerThread(const int max_image_size, JobQueue<ImageData>* input_queue,
-                     JobQueue<ImageData>* output_queue);
+                     JobQueue<ImageData>* output_queue,
+                     StageThroughput* throughput = nullptr);
 
  private:
   void Run();
@@ -114,6 +161,7 @@ class ImageResizerThread : public Thread {
 
   JobQueue<ImageData>* input_queue_;
   JobQueue<ImageData>* output_queue_;
+  StageThroughput* throughput_;
 };
 
 class SiftFeatureExtractorThread : public Thread {
@@ -121,11 +169,17 @@ class SiftFeatureExtractorThread : public Thread {
   SiftFeatureExtractorThread(const SiftExtractionOptions& sift_options,
                              const std::shared_ptr<Bitmap>& camera_mask,
                              JobQueue<ImageData>* input_queue,
-                             JobQueue<ImageData>* output_queue);
+                             JobQueue<ImageData>* output_queue,
+                             StageThroughput* throughput = nullptr,
+                             ThreadPool* tile_thread_pool = nullptr);
 
  private:
   void Run();
 
+  // Extract the features of the given images, where images of equal size are
+  // extracted together on the GPU, and mark failed images.
+  void ExtractFeatures(SiftGPU* sift_gpu, std::vector<ImageData>* image_datas);
+
   const SiftExtractionOptions sift_options_;
   std::shared_ptr<Bitmap> camera_mask_;
 
@@ -133,19 +187,49 @@ class SiftFeatureExtractorThread : public Thread {
 
   JobQueue<ImageData>* input_queue_;
   JobQueue<ImageData>* output_queue_;
+  StageThroughput* throughput_;
+  ThreadPool* tile_thread_pool_;
 };
 
+// Writes the extracted features to the database. The features of multiple
+// images are committed in batches within a single transaction, while the
+// extractor threads can continue to push to the input queue. The features of
+// images with a feature cache key are additionally written to the cache.
 class FeatureWriterThread : public Thread {
  public:
   FeatureWriterThread(const size_t num_images, Database* database,
-                      JobQueue<ImageData>* input_queue);
+                      JobQueue<ImageData>* input_queue,
+                      StageThroughput* throughput = nullptr,
+                      const int max_batch_size = 1,
+                      const int max_batch_delay_ms = 0,
+                      const FeatureCache* feature_cache = nullptr);
+
+  // Statistics about the committed batches, only valid after the thread
+  // has finished.
+  size_t NumBatches() const;
+  double MeanBatchSize() const;
+  double MeanCommitSeconds() const;
+  double MaxCommitSeconds() const;
 
  private:
   void Run();
 
+  // Write the features of all images in the batch in one transaction and
+  // clear the batch.
+  void CommitBatch(std::vector<ImageData>* batch);
+
   const size_t num_images_;
   Database* database_;
   JobQueue<ImageData>* input_queue_;
+  StageThroughput* throughput_;
+  const size_t max_batch_size_;
+  const double max_batch_delay_seconds_;
+  const FeatureCache* feature_cache_;
+
+  size_t num_batches_;
+  size_t num_batch_images_;
+  double total_commit_seconds_;
+  double max_commit_seconds_;
 };
 
 }  // namespace internal
@@ -0,0 +1,190 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "feature/feature_cache.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "util/endian.h"
+#include "util/logging.h"
+#include "util/misc.h"
+
+namespace colmap {
+namespace {
+
+// Stable 64-bit FNV-1a hash, which does not depend on the platform or build.
+// The bytes can be hashed in reverse order to obtain a second hash with
+// different collisions.
+uint64_t HashString(const std::string& str, const bool reverse = false) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < str.size(); ++i) {
+    hash ^= static_cast<uint8_t>(reverse ? str[str.size() - 1 - i] : str[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+}  // namespace
+
+FeatureCache::FeatureCache(const std::string& path,
+                           const SiftExtractionOptions& sift_options,
+                           const std::string& camera_mask_data) {
+  std::ostringstream stream;
+  stream.precision(9);
+
+  // The version of the file format, which invalidates the cache on changes.
+  stream << 1 << ";";
+
+  // The GPU and CPU implementations extract slightly different features.
+  stream << (!sift_options.domain_size_pooling &&
+             !sift_options.estimate_affine_shape && sift_options.use_gpu)
+         << ";";
+
+  // The options that affect the features.
+  stream << sift_options.max_image_size << ";" << sift_options.max_num_features
+         << ";" << sift_options.first_octave << ";" << sift_options.num_octaves
+         << ";" << sift_options.octave_resolution << ";"
+         << sift_options.peak_threshold << ";" << sift_options.edge_threshold
+         << ";" << sift_options.estimate_affine_shape << ";"
+         << sift_options.max_num_orientations << ";" << sift_options.upright
+         << ";" << sift_options.darkness_adaptivity << ";"
+         << sift_options.domain_size_pooling << ";"
+         << sift_options.dsp_min_scale << ";" << sift_options.dsp_max_scale
+         << ";" << sift_options.dsp_num_scales << ";"
+         << static_cast<int>(sift_options.normalization) << ";"
+         << sift_options.tile_size << ";" << sift_options.tile_overlap << ";"
+         << sift_options.gpu_batch_size << ";";
+
+  stream << ImageKey(camera_mask_data);
+
+  options_path_ = JoinPaths(
+      path, StringPrintf("%016llx", static_cast<unsigned long long>(
+                                        HashString(stream.str()))));
+}
+
+std::string FeatureCache::ImageKey(const std::string& image_data) const {
+  return StringPrintf(
+      "%016llx%016llx%llx",
+      static_cast<unsigned long long>(HashString(image_data)),
+      static_cast<unsigned long long>(HashString(image_data, true)),
+      static_cast<unsigned long long>(image_data.size()));
+}
+
+bool FeatureCache::Read(const std::string& image_key,
+                        FeatureKeypoints* keypoints,
+                        FeatureDescriptors* descriptors) const {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(descriptors);
+
+  const std::string path = GetImagePath(image_key);
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  const int64_t num_features = ReadBinaryLittleEndian<int64_t>(&file);
+  const int64_t dim = ReadBinaryLittleEndian<int64_t>(&file);
+
+  // Ignore files that do not match the file format, e.g., of a previous
+  // version of the format.
+  const int64_t file_size = static_cast<int64_t>(GetFileSize(path));
+  const int64_t keypoint_size = static_cast<int64_t>(6 * sizeof(float));
+  if (!file || num_features < 0 || dim < 0 || num_features > file_size ||
+      dim > file_size ||
+      file_size != 16 + num_features * (keypoint_size + dim)) {
+    return false;
+  }
+
+  std::vector<float> keypoint_data(6 * num_features);
+  ReadBinaryLittleEndian<float>(&file, &keypoint_data);
+
+  descriptors->resize(num_features, dim);
+  file.read(reinterpret_cast<char*>(descriptors->data()),
+            descriptors->size() * sizeof(uint8_t));
+  if (!file) {
+    return false;
+  }
+
+  keypoints->resize(num_features);
+  for (int64_t i = 0; i < num_features; ++i) {
+    const float* data = &keypoint_data[6 * i];
+    (*keypoints)[i] =
+        FeatureKeypoint(data[0], data[1], data[2], data[3], data[4], data[5]);
+  }
+
+  return true;
+}
+
+void FeatureCache::Write(const std::string& image_key,
+                         const FeatureKeypoints& keypoints,
+                         const FeatureDescriptors& descriptors) const {
+  CHECK_EQ(keypoints.size(), descriptors.rows());
+
+  const std::string path = GetImagePath(image_key);
+  boost::filesystem::create_directories(GetParentDir(path));
+
+  // Write to a uniquely named file that is atomically renamed, such that
+  // concurrent readers and writers never see incomplete files.
+  const std::string temp_path =
+      boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%-%%%%").string();
+
+  {
+    std::ofstream file(temp_path, std::ios::trunc | std::ios::binary);
+    CHECK(file.is_open()) << temp_path;
+
+    WriteBinaryLittleEndian<int64_t>(&file, descriptors.rows());
+    WriteBinaryLittleEndian<int64_t>(&file, descriptors.cols());
+
+    std::vector<float> keypoint_data;
+    keypoint_data.reserve(6 * keypoints.size());
+    for (const auto& keypoint : keypoints) {
+      keypoint_data.push_back(keypoint.x);
+      keypoint_data.push_back(keypoint.y);
+      keypoint_data.push_back(keypoint.a11);
+      keypoint_data.push_back(keypoint.a12);
+      keypoint_data.push_back(keypoint.a21);
+      keypoint_data.push_back(keypoint.a22);
+    }
+    WriteBinaryLittleEndian<float>(&file, keypoint_data);
+
+    file.write(reinterpret_cast<const char*>(descriptors.data()),
+               descriptors.size() * sizeof(uint8_t));
+  }
+
+  boost::filesystem::rename(temp_path, path);
+}
+
+std::string FeatureCache::GetImagePath(const std::string& image_key) const {
+  // Distribute the files over sub-directories to keep the directories small.
+  return JoinPaths(options_path_, image_key.substr(0, 2), image_key + ".bin");
+}
+
+}  // namespace colmap
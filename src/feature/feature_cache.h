@@ -0,0 +1,77 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_FEATURE_FEATURE_CACHE_H_
+#define COLMAP_SRC_FEATURE_FEATURE_CACHE_H_
+
+#include <string>
+
+#include "feature/sift.h"
+#include "feature/types.h"
+
+namespace colmap {
+
+// Cache of extracted features that is shared by multiple databases, e.g., by
+// projects with overlapping images. The features of an image are identified
+// by the contents of its file and the options that affect the extraction, so
+// that renamed or copied images are also found. The cache is a directory with
+// one file per image, which can be shared by concurrent processes, since the
+// files are written atomically. The features are stored after rescaling to
+// the original image resolution and masking with the camera mask.
+class FeatureCache {
+ public:
+  // Create a cache in the given directory for features extracted with the
+  // given options and the camera mask read from the given file contents.
+  FeatureCache(const std::string& path,
+               const SiftExtractionOptions& sift_options,
+               const std::string& camera_mask_data = "");
+
+  // Compute the key of an image from the contents of its file. The key is
+  // based on a non-cryptographic 128-bit hash and the size of the contents.
+  std::string ImageKey(const std::string& image_data) const;
+
+  // Read the features of an image, returns false if they are not cached.
+  bool Read(const std::string& image_key, FeatureKeypoints* keypoints,
+            FeatureDescriptors* descriptors) const;
+
+  // Write the features of an image, replacing any existing features.
+  void Write(const std::string& image_key, const FeatureKeypoints& keypoints,
+             const FeatureDescriptors& descriptors) const;
+
+ private:
+  std::string GetImagePath(const std::string& image_key) const;
+
+  // The directory of the features extracted with the same options.
+  std::string options_path_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_FEATURE_FEATURE_CACHE_H_
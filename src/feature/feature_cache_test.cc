@@ -0,0 +1,113 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "feature/feature_cache"
+#include "util/testing.h"
+
+#include "feature/feature_cache.h"
+#include "util/misc.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_feature_cache_%%%%-%%%%"))
+          .string();
+
+  FeatureCache cache(path, SiftExtractionOptions());
+
+  const std::string image_key = cache.ImageKey("image1");
+  BOOST_CHECK_NE(image_key, cache.ImageKey("image2"));
+  BOOST_CHECK_NE(image_key, cache.ImageKey("1egami"));
+  BOOST_CHECK_EQUAL(image_key, cache.ImageKey("image1"));
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  BOOST_CHECK(!cache.Read(image_key, &keypoints, &descriptors));
+
+  const FeatureKeypoints keypoints_write = {
+      FeatureKeypoint(1, 2, 3, 4, 5, 6), FeatureKeypoint(7, 8, 9, 10, 11, 12)};
+  FeatureDescriptors descriptors_write(2, 3);
+  descriptors_write << 1, 2, 3, 4, 5, 6;
+  cache.Write(image_key, keypoints_write, descriptors_write);
+
+  BOOST_CHECK(cache.Read(image_key, &keypoints, &descriptors));
+  BOOST_CHECK_EQUAL(keypoints.size(), keypoints_write.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    BOOST_CHECK_EQUAL(keypoints[i].x, keypoints_write[i].x);
+    BOOST_CHECK_EQUAL(keypoints[i].y, keypoints_write[i].y);
+    BOOST_CHECK_EQUAL(keypoints[i].a11, keypoints_write[i].a11);
+    BOOST_CHECK_EQUAL(keypoints[i].a12, keypoints_write[i].a12);
+    BOOST_CHECK_EQUAL(keypoints[i].a21, keypoints_write[i].a21);
+    BOOST_CHECK_EQUAL(keypoints[i].a22, keypoints_write[i].a22);
+  }
+  BOOST_CHECK_EQUAL(descriptors, descriptors_write);
+
+  // The features are shared by caches with the same options.
+  FeatureCache same_cache(path, SiftExtractionOptions());
+  BOOST_CHECK(same_cache.Read(image_key, &keypoints, &descriptors));
+  BOOST_CHECK_EQUAL(descriptors, descriptors_write);
+
+  SiftExtractionOptions other_options;
+  other_options.max_num_features += 1;
+  FeatureCache other_cache(path, other_options);
+  BOOST_CHECK(!other_cache.Read(image_key, &keypoints, &descriptors));
+
+  FeatureCache masked_cache(path, SiftExtractionOptions(), "mask");
+  BOOST_CHECK(!masked_cache.Read(image_key, &keypoints, &descriptors));
+
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadInvalid) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_feature_cache_%%%%-%%%%"))
+          .string();
+
+  FeatureCache cache(path, SiftExtractionOptions());
+  const std::string image_key = cache.ImageKey("image");
+
+  FeatureDescriptors descriptors_write(2, 3);
+  descriptors_write.setZero();
+  cache.Write(image_key, FeatureKeypoints(2), descriptors_write);
+
+  // Truncate the file of the image.
+  for (const auto& file_path : GetRecursiveFileList(path)) {
+    boost::filesystem::resize_file(file_path, GetFileSize(file_path) - 1);
+  }
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  BOOST_CHECK(!cache.Read(image_key, &keypoints, &descriptors));
+
+  boost::filesystem::remove_all(path);
+}
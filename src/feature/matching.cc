@@ -31,24 +31,355 @@
 
 #include "feature/matching.h"
 
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <numeric>
+#include <thread>
 
 #include "SiftGPU/SiftGPU.h"
 #include "base/gps.h"
 #include "feature/utils.h"
+#include "retrieval/global_descriptor.h"
 #include "retrieval/visual_index.h"
 #include "util/cuda.h"
+#include "util/endian.h"
+#include "util/metrics.h"
 #include "util/misc.h"
+#include "util/trace.h"
 
 namespace colmap {
 namespace {
 
+// The maximum number of image pairs in the input queues of the matching and
+// verification stages. Bounding the queues back-pressures the upstream stages
+// instead of buffering an unbounded number of pairs with their matches.
+const size_t kMaxNumQueuedImagePairs = 256;
+
 void PrintElapsedTime(const Timer& timer) {
   std::cout << StringPrintf(" in %.3fs", timer.ElapsedSeconds()) << std::endl;
 }
 
+// Write all pending results of the matcher to the database and report the
+// statistics of its pipeline stages.
+void FlushMatcher(Database* database, SiftFeatureMatcher* matcher) {
+  DatabaseTransaction database_transaction(database);
+  matcher->Flush();
+  matcher->PrintStageStats();
+}
+
+template <typename MatchingOptions>
+RigPairFilter::Options GetRigPairFilterOptions(const MatchingOptions& options) {
+  RigPairFilter::Options rig_options;
+  rig_options.max_rig_rotation = options.rig_max_rotation;
+  rig_options.skip_intra_snapshot_pairs = options.rig_skip_intra_snapshot_pairs;
+  return rig_options;
+}
+
+// Read the rig configuration, if given, and assign the images of the cache to
+// the rigs, such that the filter prunes their pairs without view overlap.
+void SetupRigPairFilter(const std::string& rig_config_path,
+                        const FeatureMatcherCache& cache,
+                        RigPairFilter* rig_pair_filter) {
+  if (rig_config_path.empty()) {
+    return;
+  }
+
+  rig_pair_filter->ReadConfig(rig_config_path);
+  for (const auto image_id : cache.GetImageIds()) {
+    const auto& image = cache.GetImage(image_id);
+    rig_pair_filter->AddImage(image, cache.GetCamera(image.CameraId()));
+  }
+
+  std::cout << StringPrintf("Assigned %d images to %d rig cameras",
+                            rig_pair_filter->NumImages(),
+                            rig_pair_filter->NumRigCameras())
+            << std::endl;
+}
+
+// Read the identifiers of the images with the names in the given file, one
+// name per line. Empty lines, comments, and duplicate names are skipped.
+std::vector<image_t> ReadImageIdsFromList(const std::string& path,
+                                          const FeatureMatcherCache& cache) {
+  std::unordered_map<std::string, image_t> image_name_to_image_id;
+  image_name_to_image_id.reserve(cache.GetImageIds().size());
+  for (const auto image_id : cache.GetImageIds()) {
+    const auto& image = cache.GetImage(image_id);
+    image_name_to_image_id.emplace(image.Name(), image_id);
+  }
+
+  std::ifstream file(path);
+  CHECK(file.is_open()) << path;
+
+  std::vector<image_t> image_ids;
+  std::unordered_set<image_t> added_image_ids;
+  std::string line;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    const auto image_id = image_name_to_image_id.find(line);
+    if (image_id == image_name_to_image_id.end()) {
+      std::cerr << "ERROR: Image " << line << " does not exist." << std::endl;
+    } else if (added_image_ids.insert(image_id->second).second) {
+      image_ids.push_back(image_id->second);
+    }
+  }
+
+  return image_ids;
+}
+
+// Remove the images with the names in the given file from the image list.
+void RemoveImageIdsInList(const std::string& path,
+                          const FeatureMatcherCache& cache,
+                          std::vector<image_t>* image_ids) {
+  const std::vector<image_t> skip_image_ids =
+      ReadImageIdsFromList(path, cache);
+  const std::unordered_set<image_t> skip_image_id_set(skip_image_ids.begin(),
+                                                      skip_image_ids.end());
+  const size_t num_images = image_ids->size();
+  image_ids->erase(std::remove_if(image_ids->begin(), image_ids->end(),
+                                  [&](const image_t image_id) {
+                                    return skip_image_id_set.count(image_id);
+                                  }),
+                   image_ids->end());
+  std::cout << StringPrintf("Skipping %d images",
+                            num_images - image_ids->size())
+            << std::endl;
+}
+
+// Reads a list of image pairs by their image names, see
+// `ImagePairsFeatureMatcher`, in chunks, such that huge lists are streamed
+// instead of read into memory at once. Pairs with unknown images are skipped.
+// Duplicate pairs are skipped by the matcher, which also detects duplicates
+// across different chunks.
+class ImagePairsListReader {
+ public:
+  ImagePairsListReader(std::istream* stream, const FeatureMatcherCache& cache)
+      : stream_(stream) {
+    image_name_to_image_id_.reserve(cache.GetImageIds().size());
+    for (const auto image_id : cache.GetImageIds()) {
+      const auto& image = cache.GetImage(image_id);
+      image_name_to_image_id_.emplace(image.Name(), image_id);
+    }
+  }
+
+  // Read up to the given number of next image pairs. Returns false, if there
+  // are no more image pairs.
+  bool Next(const size_t max_num_image_pairs,
+            std::vector<std::pair<image_t, image_t>>* image_pairs) {
+    image_pairs->clear();
+
+    std::string line;
+    while (image_pairs->size() < max_num_image_pairs &&
+           std::getline(*stream_, line)) {
+      StringTrim(&line);
+
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+
+      // Splitting the line directly is considerably faster than with a string
+      // stream for large lists.
+      const size_t name1_end = line.find(' ');
+      std::string image_name1 = line.substr(0, name1_end);
+      std::string image_name2;
+      if (name1_end != std::string::npos) {
+        const size_t name2_end = line.find(' ', name1_end + 1);
+        image_name2 = line.substr(
+            name1_end + 1, name2_end == std::string::npos
+                               ? std::string::npos
+                               : name2_end - name1_end - 1);
+      }
+      StringTrim(&image_name1);
+      StringTrim(&image_name2);
+
+      const auto image_id1 = image_name_to_image_id_.find(image_name1);
+      if (image_id1 == image_name_to_image_id_.end()) {
+        std::cerr << "ERROR: Image " << image_name1 << " does not exist."
+                  << std::endl;
+        continue;
+      }
+      const auto image_id2 = image_name_to_image_id_.find(image_name2);
+      if (image_id2 == image_name_to_image_id_.end()) {
+        std::cerr << "ERROR: Image " << image_name2 << " does not exist."
+                  << std::endl;
+        continue;
+      }
+
+      image_pairs->emplace_back(image_id1->second, image_id2->second);
+    }
+
+    return !image_pairs->empty();
+  }
+
+ private:
+  std::istream* stream_;
+  std::unordered_map<std::string, image_t> image_name_to_image_id_;
+};
+
+// Order the image pairs by their smaller and then by their larger image
+// identifier, such that consecutive blocks of image pairs share most of their
+// images and thereby their cached keypoints and descriptors.
+void SortImagePairsForCacheLocality(
+    std::vector<std::pair<image_t, image_t>>* image_pairs) {
+  std::sort(image_pairs->begin(), image_pairs->end(),
+            [](const std::pair<image_t, image_t>& image_pair1,
+               const std::pair<image_t, image_t>& image_pair2) {
+              return std::minmax(image_pair1.first, image_pair1.second) <
+                     std::minmax(image_pair2.first, image_pair2.second);
+            });
+}
+
+// Match the image pairs of the list in blocks. The list is read in a separate
+// thread in chunks of multiple blocks, which are reordered for cache locality,
+// such that reading and parsing the list overlaps with the matching. Returns
+// the number of dispatched image pairs.
+size_t MatchImagePairsList(std::istream* stream, const size_t block_size,
+                         Thread* thread, Database* database,
+                         FeatureMatcherCache* cache,
+                         SiftFeatureMatcher* matcher) {
+  // The number of blocks that are read and reordered at once, which trades
+  // off the memory usage against the cache locality of the reordering.
+  const size_t kNumBlocksPerChunk = 64;
+
+  JobQueue<std::vector<std::pair<image_t, image_t>>> chunk_queue(2);
+
+  std::thread reader_thread([&]() {
+    ImagePairsListReader reader(stream, *cache);
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    while (reader.Next(kNumBlocksPerChunk * block_size, &image_pairs)) {
+      SortImagePairsForCacheLocality(&image_pairs);
+      if (!chunk_queue.Push(std::move(image_pairs))) {
+        return;
+      }
+    }
+    // Signal the end of the list with an empty chunk, since stopping the
+    // queue would discard the chunks that were not yet popped.
+    chunk_queue.Push(std::vector<std::pair<image_t, image_t>>());
+  });
+
+  size_t block_idx = 0;
+  size_t num_image_pairs = 0;
+  std::vector<std::pair<image_t, image_t>> block_image_pairs;
+  block_image_pairs.reserve(block_size);
+  while (!thread->IsStopped()) {
+    auto chunk_job = chunk_queue.Pop();
+    if (!chunk_job.IsValid() || chunk_job.Data().empty()) {
+      break;
+    }
+
+    const auto& image_pairs = chunk_job.Data();
+    for (size_t i = 0; i < image_pairs.size(); i += block_size) {
+      if (thread->IsStopped()) {
+        break;
+      }
+
+      Timer timer;
+      timer.Start();
+
+      const size_t block_end = std::min(i + block_size, image_pairs.size());
+      block_image_pairs.assign(image_pairs.begin() + i,
+                               image_pairs.begin() + block_end);
+
+      block_idx += 1;
+      num_image_pairs += block_image_pairs.size();
+      std::cout << StringPrintf("Matching block [%d, %d image pairs]",
+                                block_idx, num_image_pairs)
+                << std::flush;
+
+      DatabaseTransaction database_transaction(database);
+      matcher->Match(block_image_pairs);
+
+      PrintElapsedTime(timer);
+    }
+  }
+
+  // Unblock the reader, if the matching was stopped.
+  chunk_queue.Stop();
+  reader_thread.join();
+
+  return num_image_pairs;
+}
+
+// Measures the time a pipeline stage thread spends waiting for input, on
+// processing, and waiting for space in the output queue.
+class StageTimer {
+ public:
+  explicit StageTimer(internal::FeatureMatcherStageStats* stats)
+      : stats_(stats), starved_seconds_(0) {}
+
+  JobQueue<internal::FeatureMatcherData>::Job Pop(
+      JobQueue<internal::FeatureMatcherData>* queue) {
+    timer_.Restart();
+    auto job = queue->Pop();
+    starved_seconds_ = timer_.ElapsedSeconds();
+    timer_.Restart();
+    return job;
+  }
+
+  // Account a job, which was obtained without waiting, e.g., with `TryPop`.
+  void Start() {
+    starved_seconds_ = 0;
+    timer_.Restart();
+  }
+
+  bool Push(JobQueue<internal::FeatureMatcherData>* queue,
+            internal::FeatureMatcherData data, const bool rejected = false) {
+    const double processing_seconds = timer_.ElapsedSeconds();
+    timer_.Restart();
+    const bool success = queue->Push(std::move(data));
+    if (stats_ != nullptr) {
+      stats_->Add(processing_seconds, starved_seconds_,
+                  timer_.ElapsedSeconds());
+      if (rejected) {
+        stats_->AddRejected(processing_seconds);
+      }
+    }
+    return success;
+  }
+
+ private:
+  internal::FeatureMatcherStageStats* stats_;
+  Timer timer_;
+  double starved_seconds_;
+};
+
+// Reorder the image pairs such that all pairs with the same first image are
+// consecutive. The groups are ordered by the first occurrence of their first
+// image and the relative order of pairs within a group is preserved. The GPU
+// matchers keep the descriptors of the last first and second image uploaded,
+// so this maximizes the reuse of uploaded descriptors for pair lists, where
+// the same image occurs in many scattered pairs (e.g. spatial, vocabulary
+// tree, or imported matching).
+std::vector<std::pair<image_t, image_t>> GroupImagePairsByFirstImage(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs) {
+  std::unordered_map<image_t, size_t> group_idxs;
+  std::vector<std::vector<std::pair<image_t, image_t>>> groups;
+  for (const auto& image_pair : image_pairs) {
+    const auto group_idx =
+        group_idxs.emplace(image_pair.first, groups.size()).first->second;
+    if (group_idx == groups.size()) {
+      groups.emplace_back();
+    }
+    groups[group_idx].push_back(image_pair);
+  }
+
+  std::vector<std::pair<image_t, image_t>> grouped_image_pairs;
+  grouped_image_pairs.reserve(image_pairs.size());
+  for (const auto& group : groups) {
+    grouped_image_pairs.insert(grouped_image_pairs.end(), group.begin(),
+                               group.end());
+  }
+
+  return grouped_image_pairs;
+}
+
 void IndexImagesInVisualIndex(const int num_threads, const int num_checks,
+                              const bool exhaustive_quantization,
                               const int max_num_features,
                               const std::vector<image_t>& image_ids,
                               Thread* thread, FeatureMatcherCache* cache,
@@ -56,6 +387,7 @@ void IndexImagesInVisualIndex(const int num_threads, const int num_checks,
   retrieval::VisualIndex<>::IndexOptions index_options;
   index_options.num_threads = num_threads;
   index_options.num_checks = num_checks;
+  index_options.exhaustive_quantization = exhaustive_quantization;
 
   for (size_t i = 0; i < image_ids.size(); ++i) {
     if (thread->IsStopped()) {
@@ -68,8 +400,8 @@ void IndexImagesInVisualIndex(const int num_threads, const int num_checks,
     std::cout << StringPrintf("Indexing image [%d/%d]", i + 1, image_ids.size())
               << std::flush;
 
-    auto keypoints = cache->GetKeypoints(image_ids[i]);
-    auto descriptors = cache->GetDescriptors(image_ids[i]);
+    auto keypoints = *cache->GetKeypoints(image_ids[i]);
+    auto descriptors = *cache->GetDescriptors(image_ids[i]);
     if (max_num_features > 0 && descriptors.rows() > max_num_features) {
       ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
     }
@@ -85,10 +417,14 @@ void IndexImagesInVisualIndex(const int num_threads, const int num_checks,
 
 void MatchNearestNeighborsInVisualIndex(
     const int num_threads, const int num_images, const int num_neighbors,
-    const int num_checks, const int num_images_after_verification,
-    const int max_num_features, const std::vector<image_t>& image_ids,
-    Thread* thread, FeatureMatcherCache* cache,
-    retrieval::VisualIndex<>* visual_index, SiftFeatureMatcher* matcher) {
+    const int num_checks, const bool exhaustive_quantization,
+    const int num_images_after_verification,
+    const double max_verification_time, const int max_inverted_file_size,
+    const int max_num_scored_entries, const int max_num_features,
+    const std::vector<image_t>& image_ids,
+    const std::unordered_set<image_t>& match_image_ids, Thread* thread,
+    FeatureMatcherCache* cache, retrieval::VisualIndex<>* visual_index,
+    SiftFeatureMatcher* matcher) {
   struct Retrieval {
     image_t image_id = kInvalidImageId;
     std::vector<retrieval::ImageScore> image_scores;
@@ -105,28 +441,61 @@ void MatchNearestNeighborsInVisualIndex(
   query_options.max_num_images = num_images;
   query_options.num_neighbors = num_neighbors;
   query_options.num_checks = num_checks;
+  query_options.exhaustive_quantization = exhaustive_quantization;
   query_options.num_images_after_verification = num_images_after_verification;
-  auto QueryFunc = [&](const image_t image_id) {
-    auto keypoints = cache->GetKeypoints(image_id);
-    auto descriptors = cache->GetDescriptors(image_id);
-    if (max_num_features > 0 && descriptors.rows() > max_num_features) {
-      ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+  query_options.max_verification_time = max_verification_time;
+  query_options.max_inverted_file_size = max_inverted_file_size;
+  query_options.max_num_scored_entries = max_num_scored_entries;
+  // The images are already queried in parallel.
+  query_options.num_threads = 1;
+
+  // The images are queried in batches, such that the inverted files are
+  // traversed only once per batch. Note that the dense score buffers of each
+  // thread grow linearly with the batch size and the number of images.
+  const size_t kQueryBatchSize = 8;
+  std::vector<retrieval::VisualIndex<>::QueryBatchBuffers> query_buffers(
+      retrieval_thread_pool.NumThreads());
+  auto QueryFunc = [&](const size_t begin, const size_t end) {
+    std::vector<FeatureKeypoints> batch_keypoints;
+    std::vector<retrieval::VisualIndex<>::DescType> batch_descriptors;
+    batch_keypoints.reserve(end - begin);
+    batch_descriptors.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      auto keypoints = *cache->GetKeypoints(image_ids[i]);
+      auto descriptors = *cache->GetDescriptors(image_ids[i]);
+      if (max_num_features > 0 && descriptors.rows() > max_num_features) {
+        ExtractTopScaleFeatures(&keypoints, &descriptors, max_num_features);
+      }
+      batch_keypoints.push_back(std::move(keypoints));
+      batch_descriptors.push_back(descriptors);
     }
 
-    Retrieval retrieval;
-    retrieval.image_id = image_id;
-    visual_index->Query(query_options, keypoints, descriptors,
-                        &retrieval.image_scores);
+    std::vector<std::vector<retrieval::ImageScore>> image_scores;
+    visual_index->QueryBatch(
+        query_options, batch_keypoints, batch_descriptors, &image_scores,
+        &query_buffers[retrieval_thread_pool.GetThreadIndex()]);
 
-    CHECK(retrieval_queue.Push(retrieval));
+    for (size_t i = begin; i < end; ++i) {
+      Retrieval retrieval;
+      retrieval.image_id = image_ids[i];
+      retrieval.image_scores = std::move(image_scores[i - begin]);
+      CHECK(retrieval_queue.Push(retrieval));
+    }
   };
 
-  // Initially, make all retrieval threads busy and continue with the matching.
   size_t image_idx = 0;
-  const size_t init_num_tasks =
-      std::min(image_ids.size(), 2 * retrieval_thread_pool.NumThreads());
-  for (; image_idx < init_num_tasks; ++image_idx) {
-    retrieval_thread_pool.AddTask(QueryFunc, image_ids[image_idx]);
+  auto AddQueryTask = [&]() {
+    if (image_idx < image_ids.size()) {
+      const size_t end =
+          std::min(image_idx + kQueryBatchSize, image_ids.size());
+      retrieval_thread_pool.AddTask(QueryFunc, image_idx, end);
+      image_idx = end;
+    }
+  };
+
+  // Initially, make all retrieval threads busy and continue with the matching.
+  for (size_t i = 0; i < 2 * retrieval_thread_pool.NumThreads(); ++i) {
+    AddQueryTask();
   }
 
   std::vector<std::pair<image_t, image_t>> image_pairs;
@@ -144,10 +513,9 @@ void MatchNearestNeighborsInVisualIndex(
     std::cout << StringPrintf("Matching image [%d/%d]", i + 1, image_ids.size())
               << std::flush;
 
-    // Push the next image to the retrieval queue.
-    if (image_idx < image_ids.size()) {
-      retrieval_thread_pool.AddTask(QueryFunc, image_ids[image_idx]);
-      image_idx += 1;
+    // Push the next batch of images to the retrieval queue.
+    if (i % kQueryBatchSize == 0) {
+      AddQueryTask();
     }
 
     // Pop the next results from the retrieval queue.
@@ -157,11 +525,109 @@ void MatchNearestNeighborsInVisualIndex(
     const auto& image_id = retrieval.Data().image_id;
     const auto& image_scores = retrieval.Data().image_scores;
 
-    // Compose the image pairs from the scores.
+    // Compose the image pairs from the scores, optionally only with the
+    // retrieved images that may be matched.
     image_pairs.clear();
     image_pairs.reserve(image_scores.size());
     for (const auto image_score : image_scores) {
-      image_pairs.emplace_back(image_id, image_score.image_id);
+      if (match_image_ids.empty() ||
+          match_image_ids.count(image_score.image_id) > 0) {
+        image_pairs.emplace_back(image_id, image_score.image_id);
+      }
+    }
+
+    matcher->Match(image_pairs);
+
+    PrintElapsedTime(timer);
+  }
+}
+
+// Match the query images against the most similar images by the inner
+// products of their global descriptors in the database. The database images
+// are all images with a global descriptor or, if given, only the match images.
+// In contrast to the visual index, all images are retrieved upfront, which
+// takes seconds even for large datasets.
+void MatchNearestNeighborsByGlobalDescriptors(
+    const int num_threads, const int num_images,
+    const std::vector<image_t>& image_ids,
+    const std::unordered_set<image_t>& match_image_ids, Thread* thread,
+    Database* database, SiftFeatureMatcher* matcher) {
+  std::unordered_map<image_t, Eigen::VectorXf> descriptors;
+  for (auto& descriptor : database->ReadAllGlobalDescriptors()) {
+    descriptors.emplace(descriptor.first, std::move(descriptor.second));
+  }
+
+  std::vector<int> query_image_ids;
+  std::vector<int> database_image_ids;
+  query_image_ids.reserve(image_ids.size());
+  database_image_ids.reserve(descriptors.size());
+  for (const auto image_id : image_ids) {
+    if (descriptors.count(image_id) > 0) {
+      query_image_ids.push_back(static_cast<int>(image_id));
+    }
+  }
+  for (const auto& descriptor : descriptors) {
+    if (match_image_ids.empty() || match_image_ids.count(descriptor.first)) {
+      database_image_ids.push_back(static_cast<int>(descriptor.first));
+    }
+  }
+
+  if (query_image_ids.size() < image_ids.size()) {
+    std::cout << StringPrintf("WARNING: Skipping %d images without a global "
+                              "descriptor",
+                              image_ids.size() - query_image_ids.size())
+              << std::endl;
+  }
+
+  if (query_image_ids.empty() || database_image_ids.empty()) {
+    return;
+  }
+
+  // Sort the database images, so that the retrieval does not depend on the
+  // order of the hash map.
+  std::sort(database_image_ids.begin(), database_image_ids.end());
+
+  const Eigen::Index num_dims = descriptors.begin()->second.size();
+  auto StackDescriptors = [&](const std::vector<int>& ids) {
+    retrieval::GlobalDescriptors matrix(ids.size(), num_dims);
+    for (size_t i = 0; i < ids.size(); ++i) {
+      const Eigen::VectorXf& descriptor = descriptors.at(ids[i]);
+      CHECK_EQ(descriptor.size(), num_dims)
+          << "The global descriptors were computed with different models";
+      matrix.row(i) = descriptor;
+    }
+    return matrix;
+  };
+
+  Timer timer;
+  timer.Start();
+
+  std::cout << "Retrieving images..." << std::flush;
+
+  std::vector<std::vector<retrieval::ImageScore>> image_scores;
+  retrieval::QueryGlobalDescriptors(
+      query_image_ids, StackDescriptors(query_image_ids), database_image_ids,
+      StackDescriptors(database_image_ids), num_images, num_threads,
+      &image_scores);
+
+  PrintElapsedTime(timer);
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  for (size_t i = 0; i < query_image_ids.size(); ++i) {
+    if (thread->IsStopped()) {
+      return;
+    }
+
+    timer.Restart();
+
+    std::cout << StringPrintf("Matching image [%d/%d]", i + 1,
+                              query_image_ids.size())
+              << std::flush;
+
+    image_pairs.clear();
+    image_pairs.reserve(image_scores[i].size());
+    for (const auto& image_score : image_scores[i]) {
+      image_pairs.emplace_back(query_image_ids[i], image_score.image_id);
     }
 
     matcher->Match(image_pairs);
@@ -170,19 +636,538 @@ void MatchNearestNeighborsInVisualIndex(
   }
 }
 
+// Undirected graph of the verified image pairs in compressed sparse row
+// format, in which the neighbors of every image are sorted by their index.
+// Image pairs without inlier matches are edges with zero inliers, such that
+// they are not proposed again but do not connect their images.
+class TransitiveMatchGraph {
+ public:
+  explicit TransitiveMatchGraph(const std::vector<image_t>& image_ids)
+      : image_ids_(image_ids) {
+    std::sort(image_ids_.begin(), image_ids_.end());
+    image_idxs_.reserve(image_ids_.size());
+    for (size_t idx = 0; idx < image_ids_.size(); ++idx) {
+      image_idxs_.emplace(image_ids_[idx], idx);
+    }
+    Build();
+  }
+
+  // Add a new image pair, which takes effect after the next call to `Build`.
+  void AddImagePair(const image_t image_id1, const image_t image_id2,
+                    const int num_inliers) {
+    const auto image_idx1 = image_idxs_.find(image_id1);
+    const auto image_idx2 = image_idxs_.find(image_id2);
+    if (image_idx1 == image_idxs_.end() || image_idx2 == image_idxs_.end()) {
+      return;
+    }
+    edges_.push_back(
+        {image_idx1->second, image_idx2->second, std::max(num_inliers, 0)});
+  }
+
+  // Rebuild the adjacency of the images from all added image pairs.
+  void Build() {
+    offsets_.assign(image_ids_.size() + 1, 0);
+    for (const auto& edge : edges_) {
+      offsets_[edge.image_idx1 + 1] += 1;
+      offsets_[edge.image_idx2 + 1] += 1;
+    }
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+
+    neighbors_.resize(offsets_.back());
+    std::vector<size_t> next_offsets(offsets_.begin(), offsets_.end() - 1);
+    for (const auto& edge : edges_) {
+      neighbors_[next_offsets[edge.image_idx1]++] = {edge.image_idx2,
+                                                     edge.num_inliers};
+      neighbors_[next_offsets[edge.image_idx2]++] = {edge.image_idx1,
+                                                     edge.num_inliers};
+    }
+
+    for (size_t idx = 0; idx < image_ids_.size(); ++idx) {
+      std::sort(neighbors_.begin() + offsets_[idx],
+                neighbors_.begin() + offsets_[idx + 1],
+                [](const Neighbor& neighbor1, const Neighbor& neighbor2) {
+                  return neighbor1.image_idx < neighbor2.image_idx;
+                });
+    }
+  }
+
+  // Find the unverified image pairs that are connected through a common
+  // neighbor. For every image, at most `max_num_candidates` candidates with the
+  // highest expected number of inliers are selected, if positive. Every image
+  // pair is returned once, if selected by either of its images.
+  std::vector<std::pair<image_t, image_t>> FindImagePairs(
+      const int max_num_candidates, const int num_threads) const {
+    const size_t num_images = image_ids_.size();
+    std::vector<std::vector<size_t>> candidates(num_images);
+
+    ThreadPool thread_pool(num_threads);
+    thread_pool.ParallelFor(
+        0, num_images,
+        [&](const size_t begin, const size_t end) {
+          for (size_t idx = begin; idx < end; ++idx) {
+            candidates[idx] = FindCandidates(idx, max_num_candidates);
+          }
+        },
+        ThreadPool::Schedule::DYNAMIC);
+
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    for (size_t idx1 = 0; idx1 < num_images; ++idx1) {
+      for (const size_t idx2 : candidates[idx1]) {
+        if (idx1 < idx2 || !std::binary_search(candidates[idx2].begin(),
+                                               candidates[idx2].end(), idx1)) {
+          image_pairs.emplace_back(image_ids_[idx1], image_ids_[idx2]);
+        }
+      }
+    }
+
+    return image_pairs;
+  }
+
+ private:
+  struct Edge {
+    size_t image_idx1;
+    size_t image_idx2;
+    int num_inliers;
+  };
+
+  struct Neighbor {
+    size_t image_idx;
+    int num_inliers;
+  };
+
+  // Find the sorted indices of the candidate images of an image, where the
+  // expected number of inliers with a candidate is the sum of the minimum
+  // number of inliers along all paths through a common neighbor.
+  std::vector<size_t> FindCandidates(const size_t image_idx,
+                                     const int max_num_candidates) const {
+    std::vector<std::pair<size_t, size_t>> paths;
+    for (size_t i = offsets_[image_idx]; i < offsets_[image_idx + 1]; ++i) {
+      const Neighbor& neighbor1 = neighbors_[i];
+      if (neighbor1.num_inliers == 0) {
+        continue;
+      }
+      for (size_t j = offsets_[neighbor1.image_idx];
+           j < offsets_[neighbor1.image_idx + 1]; ++j) {
+        const Neighbor& neighbor2 = neighbors_[j];
+        if (neighbor2.num_inliers > 0 && neighbor2.image_idx != image_idx) {
+          paths.emplace_back(neighbor2.image_idx,
+                             std::min(neighbor1.num_inliers,
+                                      neighbor2.num_inliers));
+        }
+      }
+    }
+
+    std::sort(paths.begin(), paths.end());
+
+    // Accumulate the paths per candidate and remove the existing image pairs
+    // by intersecting the sorted candidates with the sorted neighbors.
+    std::vector<std::pair<size_t, size_t>> candidates;
+    size_t neighbor_idx = offsets_[image_idx];
+    for (const auto& path : paths) {
+      if (!candidates.empty() && candidates.back().first == path.first) {
+        candidates.back().second += path.second;
+        continue;
+      }
+      while (neighbor_idx < offsets_[image_idx + 1] &&
+             neighbors_[neighbor_idx].image_idx < path.first) {
+        neighbor_idx += 1;
+      }
+      if (neighbor_idx < offsets_[image_idx + 1] &&
+          neighbors_[neighbor_idx].image_idx == path.first) {
+        continue;
+      }
+      candidates.push_back(path);
+    }
+
+    if (max_num_candidates > 0 &&
+        candidates.size() > static_cast<size_t>(max_num_candidates)) {
+      std::nth_element(candidates.begin(),
+                       candidates.begin() + max_num_candidates,
+                       candidates.end(),
+                       [](const std::pair<size_t, size_t>& candidate1,
+                          const std::pair<size_t, size_t>& candidate2) {
+                         return candidate1.second > candidate2.second ||
+                                (candidate1.second == candidate2.second &&
+                                 candidate1.first < candidate2.first);
+                       });
+      candidates.resize(max_num_candidates);
+      std::sort(candidates.begin(), candidates.end());
+    }
+
+    std::vector<size_t> candidate_idxs(candidates.size());
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      candidate_idxs[i] = candidates[i].first;
+    }
+
+    return candidate_idxs;
+  }
+
+  std::vector<image_t> image_ids_;
+  std::unordered_map<image_t, size_t> image_idxs_;
+  std::vector<Edge> edges_;
+  std::vector<size_t> offsets_;
+  std::vector<Neighbor> neighbors_;
+};
+
+// Selects the keyframes for loop detection in a sequence of images, either
+// every `loop_detection_period` images or, if enabled, once the feature track
+// overlap with the previous keyframe falls below the threshold. The overlap is
+// only known after the image pair with the previous keyframe was verified, so
+// the decisions are deferred until then.
+class SequentialKeyframeSelector {
+ public:
+  SequentialKeyframeSelector(const SequentialMatchingOptions& options,
+                             const std::vector<image_t>& image_ids,
+                             FeatureMatcherCache* cache)
+      : options_(options),
+        image_ids_(image_ids),
+        cache_(cache),
+        next_image_idx_(0),
+        keyframe_idx_(0),
+        keyframe_num_inliers_(0) {}
+
+  // Select the next keyframes among the images up to the given index. If not
+  // forced, the selection stops at the first image, whose image pair with the
+  // previous keyframe is not yet verified.
+  std::vector<image_t> Select(const size_t max_image_idx, const bool force) {
+    std::vector<image_t> keyframe_ids;
+    for (; next_image_idx_ <= max_image_idx &&
+           next_image_idx_ < image_ids_.size();
+         ++next_image_idx_) {
+      const size_t image_idx = next_image_idx_;
+
+      bool is_keyframe = false;
+      if (image_idx == 0) {
+        is_keyframe = true;
+      } else if (options_.loop_detection_keyframe_overlap <= 0) {
+        is_keyframe = image_idx % options_.loop_detection_period == 0;
+      } else if (!IsSequentialImagePair(keyframe_idx_, image_idx)) {
+        // The tracks of the keyframe end, since the images are never matched.
+        is_keyframe = true;
+      } else {
+        const image_t keyframe_id = image_ids_[keyframe_idx_];
+        const image_t image_id = image_ids_[image_idx];
+        if (cache_->ExistsInlierMatches(keyframe_id, image_id)) {
+          const int num_inliers =
+              cache_->GetNumInlierMatches(keyframe_id, image_id);
+          if (image_idx == keyframe_idx_ + 1) {
+            keyframe_num_inliers_ = num_inliers;
+          }
+          is_keyframe = num_inliers == 0 ||
+                        num_inliers < options_.loop_detection_keyframe_overlap *
+                                          keyframe_num_inliers_;
+        } else if (force) {
+          is_keyframe = true;
+        } else {
+          break;
+        }
+      }
+
+      if (is_keyframe) {
+        keyframe_idx_ = image_idx;
+        keyframe_num_inliers_ = 0;
+        keyframe_ids.push_back(image_ids_[image_idx]);
+      }
+    }
+
+    return keyframe_ids;
+  }
+
+ private:
+  // Whether the images are matched in the sequential matching.
+  bool IsSequentialImagePair(const size_t image_idx1,
+                             const size_t image_idx2) const {
+    const size_t offset = image_idx2 - image_idx1;
+    if (offset < static_cast<size_t>(options_.overlap)) {
+      return true;
+    }
+    if (options_.quadratic_overlap) {
+      for (int i = 0; i < options_.overlap && i < 63; ++i) {
+        if (offset == (static_cast<size_t>(1) << i)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  const SequentialMatchingOptions& options_;
+  const std::vector<image_t>& image_ids_;
+  FeatureMatcherCache* cache_;
+  size_t next_image_idx_;
+  size_t keyframe_idx_;
+  int keyframe_num_inliers_;
+};
+
+// Detects loops in a sequence of images by retrieving the most similar
+// keyframes for every keyframe from a visual index of all keyframes. The
+// keyframes are incrementally indexed and queried in a separate thread,
+// while the images of the sequence are matched.
+class SequentialLoopDetector {
+ public:
+  SequentialLoopDetector(const SequentialMatchingOptions& options,
+                         const int num_threads, FeatureMatcherCache* cache)
+      : options_(options), num_threads_(num_threads), cache_(cache) {
+    thread_ = std::thread(&SequentialLoopDetector::Run, this);
+  }
+
+  ~SequentialLoopDetector() {
+    keyframe_queue_.Stop();
+    image_pairs_queue_.Stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void AddKeyframes(const std::vector<image_t>& keyframe_ids) {
+    for (const image_t keyframe_id : keyframe_ids) {
+      CHECK(keyframe_queue_.Push(keyframe_id));
+    }
+  }
+
+  // Wait until all added keyframes are indexed and queried.
+  void Finish() {
+    CHECK(keyframe_queue_.Push(kInvalidImageId));
+    thread_.join();
+  }
+
+  // Pop the image pairs of all loop detections finished so far.
+  std::vector<std::pair<image_t, image_t>> PopImagePairs() {
+    std::vector<std::pair<image_t, image_t>> image_pairs;
+    while (true) {
+      auto image_pairs_job = image_pairs_queue_.TryPop();
+      if (!image_pairs_job.IsValid()) {
+        break;
+      }
+      image_pairs.insert(image_pairs.end(), image_pairs_job.Data().begin(),
+                         image_pairs_job.Data().end());
+    }
+    return image_pairs;
+  }
+
+ private:
+  // The maximum number of keyframes indexed and queried at once. Larger
+  // batches amortize the preparation of the visual index, smaller batches
+  // detect loops earlier.
+  static const size_t kMaxBatchSize = 8;
+
+  void Run() {
+    retrieval::VisualIndex<> visual_index;
+    visual_index.Read(options_.vocab_tree_path);
+
+    retrieval::VisualIndex<>::IndexOptions index_options;
+    index_options.num_threads = num_threads_;
+    index_options.num_checks = options_.loop_detection_num_checks;
+
+    retrieval::VisualIndex<>::QueryOptions query_options;
+    // The keyframe itself is always retrieved.
+    query_options.max_num_images = options_.loop_detection_num_images + 1;
+    query_options.num_neighbors = options_.loop_detection_num_nearest_neighbors;
+    query_options.num_checks = options_.loop_detection_num_checks;
+    query_options.num_images_after_verification =
+        options_.loop_detection_num_images_after_verification;
+    query_options.num_threads = num_threads_;
+
+    retrieval::VisualIndex<>::QueryBatchBuffers query_buffers;
+
+    bool finished = false;
+    while (!finished) {
+      auto keyframe_job = keyframe_queue_.Pop();
+      if (!keyframe_job.IsValid()) {
+        break;
+      }
+
+      // Process all keyframes that are already available as a batch.
+      std::vector<image_t> keyframe_ids;
+      while (keyframe_job.IsValid()) {
+        if (keyframe_job.Data() == kInvalidImageId) {
+          finished = true;
+          break;
+        }
+        keyframe_ids.push_back(keyframe_job.Data());
+        if (keyframe_ids.size() >= kMaxBatchSize) {
+          break;
+        }
+        keyframe_job = keyframe_queue_.TryPop();
+      }
+
+      if (keyframe_ids.empty()) {
+        continue;
+      }
+
+      std::vector<FeatureKeypoints> batch_keypoints;
+      std::vector<retrieval::VisualIndex<>::DescType> batch_descriptors;
+      batch_keypoints.reserve(keyframe_ids.size());
+      batch_descriptors.reserve(keyframe_ids.size());
+      for (const image_t keyframe_id : keyframe_ids) {
+        auto keypoints = *cache_->GetKeypoints(keyframe_id);
+        auto descriptors = *cache_->GetDescriptors(keyframe_id);
+        if (options_.loop_detection_max_num_features > 0 &&
+            descriptors.rows() > options_.loop_detection_max_num_features) {
+          ExtractTopScaleFeatures(&keypoints, &descriptors,
+                                  options_.loop_detection_max_num_features);
+        }
+        visual_index.Add(index_options, keyframe_id, keypoints, descriptors);
+        batch_keypoints.push_back(std::move(keypoints));
+        batch_descriptors.push_back(std::move(descriptors));
+      }
+
+      // Only the inverted files changed by the new keyframes are updated.
+      visual_index.Prepare();
+
+      std::vector<std::vector<retrieval::ImageScore>> image_scores;
+      visual_index.QueryBatch(query_options, batch_keypoints,
+                              batch_descriptors, &image_scores,
+                              &query_buffers);
+
+      std::vector<std::pair<image_t, image_t>> image_pairs;
+      for (size_t i = 0; i < keyframe_ids.size(); ++i) {
+        for (const auto& image_score : image_scores[i]) {
+          if (static_cast<image_t>(image_score.image_id) != keyframe_ids[i]) {
+            image_pairs.emplace_back(keyframe_ids[i], image_score.image_id);
+          }
+        }
+      }
+
+      if (!image_pairs.empty() && !image_pairs_queue_.Push(image_pairs)) {
+        break;
+      }
+    }
+  }
+
+  const SequentialMatchingOptions& options_;
+  const int num_threads_;
+  FeatureMatcherCache* cache_;
+  JobQueue<image_t> keyframe_queue_;
+  JobQueue<std::vector<std::pair<image_t, image_t>>> image_pairs_queue_;
+  std::thread thread_;
+};
+
+// Reads the image pairs and their feature matches from a match list in the text
+// or binary format of `FeaturePairsFeatureMatcher`. Files with the ".bin"
+// extension are read in the binary format.
+class MatchListReader {
+ public:
+  explicit MatchListReader(const std::string& path)
+      : binary_(HasFileExtension(path, ".bin")),
+        file_(path, binary_ ? std::ios::binary : std::ios::in) {
+    CHECK(file_.is_open()) << path;
+  }
+
+  // Read the next image pair and its matches. Returns false at the end of the
+  // file or if the file is malformed.
+  bool Next(std::string* image_name1, std::string* image_name2,
+            FeatureMatches* matches) {
+    matches->clear();
+    return binary_ ? NextBinary(image_name1, image_name2, matches)
+                   : NextText(image_name1, image_name2, matches);
+  }
+
+ private:
+  bool NextText(std::string* image_name1, std::string* image_name2,
+                FeatureMatches* matches) {
+    std::string line;
+    do {
+      if (!std::getline(file_, line)) {
+        return false;
+      }
+      StringTrim(&line);
+    } while (line.empty());
+
+    std::istringstream line_stream(line);
+    if (!(line_stream >> *image_name1 >> *image_name2)) {
+      std::cerr << "ERROR: Could not read image pair." << std::endl;
+      return false;
+    }
+
+    while (std::getline(file_, line)) {
+      StringTrim(&line);
+      if (line.empty()) {
+        break;
+      }
+
+      // Parsing with strtoul is considerably faster than with a string stream
+      // for large match lists.
+      char* end = nullptr;
+      FeatureMatch match;
+      match.point2D_idx1 = std::strtoul(line.c_str(), &end, 10);
+      match.point2D_idx2 = std::strtoul(end, nullptr, 10);
+      matches->push_back(match);
+    }
+
+    return true;
+  }
+
+  bool NextBinary(std::string* image_name1, std::string* image_name2,
+                  FeatureMatches* matches) {
+    if (file_.peek() == std::char_traits<char>::eof()) {
+      return false;
+    }
+
+    if (!ReadName(image_name1) || !ReadName(image_name2)) {
+      std::cerr << "ERROR: Could not read image pair." << std::endl;
+      return false;
+    }
+
+    const uint64_t num_matches = ReadBinaryLittleEndian<uint64_t>(&file_);
+    std::vector<point2D_t> data(2 * num_matches);
+    if (IsLittleEndian()) {
+      file_.read(reinterpret_cast<char*>(data.data()),
+                 data.size() * sizeof(point2D_t));
+    } else {
+      ReadBinaryLittleEndian<point2D_t>(&file_, &data);
+    }
+
+    if (!file_) {
+      std::cerr << "ERROR: Cannot read feature matches." << std::endl;
+      return false;
+    }
+
+    matches->resize(num_matches);
+    for (size_t i = 0; i < matches->size(); ++i) {
+      (*matches)[i].point2D_idx1 = data[2 * i];
+      (*matches)[i].point2D_idx2 = data[2 * i + 1];
+    }
+
+    return true;
+  }
+
+  bool ReadName(std::string* name) {
+    const uint32_t length = ReadBinaryLittleEndian<uint32_t>(&file_);
+    if (!file_) {
+      return false;
+    }
+    name->resize(length);
+    file_.read(&(*name)[0], length);
+    return static_cast<bool>(file_);
+  }
+
+  const bool binary_;
+  std::ifstream file_;
+};
+
 }  // namespace
 
 bool ExhaustiveMatchingOptions::Check() const {
   CHECK_OPTION_GT(block_size, 1);
+  CHECK_OPTION_GE(rig_max_rotation, 0);
+  CHECK_OPTION_LE(rig_max_rotation, 180);
+  if (new_vs_new) {
+    CHECK_OPTION(!new_image_list_path.empty());
+  }
   return true;
 }
 
 bool SequentialMatchingOptions::Check() const {
   CHECK_OPTION_GT(overlap, 0);
   CHECK_OPTION_GT(loop_detection_period, 0);
+  CHECK_OPTION_GE(loop_detection_keyframe_overlap, 0);
+  CHECK_OPTION_LE(loop_detection_keyframe_overlap, 1);
   CHECK_OPTION_GT(loop_detection_num_images, 0);
   CHECK_OPTION_GT(loop_detection_num_nearest_neighbors, 0);
   CHECK_OPTION_GT(loop_detection_num_checks, 0);
+  CHECK_OPTION_GE(rig_max_rotation, 0);
+  CHECK_OPTION_LE(rig_max_rotation, 180);
   return true;
 }
 
@@ -190,12 +1175,18 @@ bool VocabTreeMatchingOptions::Check() const {
   CHECK_OPTION_GT(num_images, 0);
   CHECK_OPTION_GT(num_nearest_neighbors, 0);
   CHECK_OPTION_GT(num_checks, 0);
+  if (new_vs_new) {
+    CHECK_OPTION(!new_image_list_path.empty());
+  }
   return true;
 }
 
 bool SpatialMatchingOptions::Check() const {
   CHECK_OPTION_GT(max_num_neighbors, 0);
   CHECK_OPTION_GT(max_distance, 0.0);
+  if (new_vs_new) {
+    CHECK_OPTION(!new_image_list_path.empty());
+  }
   return true;
 }
 
@@ -212,44 +1203,159 @@ bool ImagePairsMatchingOptions::Check() const {
 
 bool FeaturePairsMatchingOptions::Check() const { return true; }
 
+bool MatchingServerOptions::Check() const {
+  CHECK_OPTION(ExistsDir(spool_path));
+  CHECK_OPTION_GT(cache_size, 0);
+  CHECK_OPTION_GT(block_size, 0);
+  CHECK_OPTION_GT(poll_interval, 0);
+  return true;
+}
+
 FeatureMatcherCache::FeatureMatcherCache(const size_t cache_size,
-                                         const Database* database)
-    : cache_size_(cache_size), database_(database) {
+                                         const Database* database,
+                                         const std::string& feature_store_path)
+    : cache_size_(cache_size),
+      database_(database),
+      feature_store_path_(feature_store_path),
+      features_data_version_(0),
+      database_wait_micro_seconds_(0) {
   CHECK_NOTNULL(database_);
 }
 
 void FeatureMatcherCache::Setup() {
+  // The features are only reused, if no other connection, e.g., another
+  // feature extraction process, has modified the database in the meantime.
+  const int64_t database_data_version = database_->DataVersion();
+  const bool reuse_features =
+      keypoints_cache_ && features_database_path_ == database_->Path() &&
+      features_data_version_ == database_data_version;
+
+  if (!reuse_features) {
+    reader_pool_.reset(new DatabaseReaderPool(
+        database_->Path(), GetEffectiveNumThreads(ThreadPool::kMaxNumThreads)));
+  }
+
   const std::vector<Camera> cameras = database_->ReadAllCameras();
+  cameras_cache_.clear();
   cameras_cache_.reserve(cameras.size());
   for (const auto& camera : cameras) {
-    cameras_cache_.emplace(camera.CameraId(), camera);
+    // The keypoints of every image are normalized once for the geometric
+    // verification of all its image pairs, see GetPoints, which amortizes
+    // the computation of the grid.
+    Camera& cached_camera =
+        cameras_cache_.emplace(camera.CameraId(), camera).first->second;
+    cached_camera.ComputeUndistortionGrid();
   }
 
   const std::vector<Image> images = database_->ReadAllImages();
+  images_cache_.clear();
   images_cache_.reserve(images.size());
   for (const auto& image : images) {
     images_cache_.emplace(image.ImageId(), image);
   }
 
-  keypoints_cache_.reset(new LRUCache<image_t, FeatureKeypoints>(
-      cache_size_, [this](const image_t image_id) {
-        return database_->ReadKeypoints(image_id);
-      }));
+  // The features of the images are kept, if the cache is set up again for the
+  // same unmodified database, e.g., by the matching server for its next job.
+  if (!reuse_features) {
+    features_database_path_ = database_->Path();
+    features_data_version_ = database_data_version;
 
-  descriptors_cache_.reset(new LRUCache<image_t, FeatureDescriptors>(
-      cache_size_, [this](const image_t image_id) {
-        return database_->ReadDescriptors(image_id);
-      }));
+    // Reopen the store to index the records appended in the meantime.
+    if (!feature_store_path_.empty()) {
+      feature_store_.reset(new FeatureStore(feature_store_path_));
+    }
+
+    keypoints_cache_.reset(new ShardedLRUCache<image_t, FeatureKeypoints>(
+        cache_size_, kNumCacheShards, [this](const image_t image_id) {
+          if (feature_store_ && feature_store_->ExistsKeypoints(image_id)) {
+            return feature_store_->ReadKeypoints(image_id);
+          }
+          return ReadFeatures([image_id](const Database& database) {
+            return database.ReadKeypoints(image_id);
+          });
+        }));
+
+    descriptors_cache_.reset(new ShardedLRUCache<image_t, FeatureDescriptors>(
+        cache_size_, kNumCacheShards, [this](const image_t image_id) {
+          if (feature_store_ && feature_store_->ExistsDescriptors(image_id)) {
+            return feature_store_->ReadDescriptors(image_id);
+          }
+          return ReadFeatures([image_id](const Database& database) {
+            return database.ReadDescriptors(image_id);
+          });
+        }));
+
+    descriptor_index_cache_.reset(
+        new ShardedLRUCache<image_t, SiftDescriptorIndex>(
+            cache_size_, kNumCacheShards, [this](const image_t image_id) {
+              return SiftDescriptorIndex(*GetDescriptors(image_id));
+            }));
+
+    binary_descriptors_cache_.reset(
+        new ShardedLRUCache<image_t, FeatureBinaryDescriptors>(
+            cache_size_, kNumCacheShards, [this](const image_t image_id) {
+              return BinarizeFeatureDescriptors(*GetDescriptors(image_id));
+            }));
+
+    points_cache_.reset(new ShardedLRUCache<image_t, Points>(
+        cache_size_, kNumCacheShards, [this](const image_t image_id) {
+          const Camera& camera = GetCamera(GetImage(image_id).CameraId());
+          Points points;
+          points.points =
+              FeatureKeypointsToPointsVector(*GetKeypoints(image_id));
+          camera.ImageToWorld(points.points, &points.points_normalized);
+          return points;
+        }));
+  }
+
+  const size_t exists_cache_size = std::max<size_t>(images.size(), 1);
 
-  keypoints_exists_cache_.reset(new LRUCache<image_t, bool>(
-      images.size(), [this](const image_t image_id) {
-        return database_->ExistsKeypoints(image_id);
+  keypoints_exists_cache_.reset(new ShardedLRUCache<image_t, bool>(
+      exists_cache_size, kNumCacheShards, [this](const image_t image_id) {
+        if (feature_store_ && feature_store_->ExistsKeypoints(image_id)) {
+          return true;
+        }
+        return ReadFeatures([image_id](const Database& database) {
+          return database.ExistsKeypoints(image_id);
+        });
       }));
 
-  descriptors_exists_cache_.reset(new LRUCache<image_t, bool>(
-      images.size(), [this](const image_t image_id) {
-        return database_->ExistsDescriptors(image_id);
+  descriptors_exists_cache_.reset(new ShardedLRUCache<image_t, bool>(
+      exists_cache_size, kNumCacheShards, [this](const image_t image_id) {
+        if (feature_store_ && feature_store_->ExistsDescriptors(image_id)) {
+          return true;
+        }
+        return ReadFeatures([image_id](const Database& database) {
+          return database.ExistsDescriptors(image_id);
+        });
       }));
+
+  {
+    const auto lock = LockDatabase();
+    const std::vector<image_pair_t> matched_image_pair_ids =
+        database_->ReadMatchedImagePairIds();
+    const std::vector<image_pair_t> verified_image_pair_ids =
+        database_->ReadVerifiedImagePairIds();
+    std::vector<std::pair<image_t, image_t>> inlier_image_pairs;
+    std::vector<int> num_inliers;
+    database_->ReadTwoViewGeometryNumInliers(&inlier_image_pairs,
+                                             &num_inliers);
+
+    std::unique_lock<std::mutex> image_pairs_lock(image_pairs_mutex_);
+    matched_image_pair_ids_.clear();
+    matched_image_pair_ids_.insert(matched_image_pair_ids.begin(),
+                                   matched_image_pair_ids.end());
+    verified_image_pairs_.clear();
+    verified_image_pairs_.reserve(verified_image_pair_ids.size());
+    for (const image_pair_t pair_id : verified_image_pair_ids) {
+      verified_image_pairs_.emplace(pair_id, 0);
+    }
+    for (size_t i = 0; i < inlier_image_pairs.size(); ++i) {
+      verified_image_pairs_[Database::ImagePairToPairId(
+          inlier_image_pairs[i].first, inlier_image_pairs[i].second)] =
+          num_inliers[i];
+    }
+  }
 }
 
 const Camera& FeatureMatcherCache::GetCamera(const camera_t camera_id) const {
@@ -260,21 +1366,34 @@ const Image& FeatureMatcherCache::GetImage(const image_t image_id) const {
   return images_cache_.at(image_id);
 }
 
-const FeatureKeypoints& FeatureMatcherCache::GetKeypoints(
+std::shared_ptr<const FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
     const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
   return keypoints_cache_->Get(image_id);
 }
 
-const FeatureDescriptors& FeatureMatcherCache::GetDescriptors(
+std::shared_ptr<const FeatureDescriptors> FeatureMatcherCache::GetDescriptors(
     const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
   return descriptors_cache_->Get(image_id);
 }
 
+std::shared_ptr<const SiftDescriptorIndex>
+FeatureMatcherCache::GetDescriptorIndex(const image_t image_id) {
+  return descriptor_index_cache_->Get(image_id);
+}
+
+std::shared_ptr<const FeatureBinaryDescriptors>
+FeatureMatcherCache::GetBinaryDescriptors(const image_t image_id) {
+  return binary_descriptors_cache_->Get(image_id);
+}
+
+std::shared_ptr<const FeatureMatcherCache::Points>
+FeatureMatcherCache::GetPoints(const image_t image_id) {
+  return points_cache_->Get(image_id);
+}
+
 FeatureMatches FeatureMatcherCache::GetMatches(const image_t image_id1,
                                                const image_t image_id2) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
+  const auto lock = LockDatabase();
   return database_->ReadMatches(image_id1, image_id2);
 }
 
@@ -288,53 +1407,231 @@ std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
 }
 
 bool FeatureMatcherCache::ExistsKeypoints(const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  return keypoints_exists_cache_->Get(image_id);
+  return *keypoints_exists_cache_->Get(image_id);
 }
 
 bool FeatureMatcherCache::ExistsDescriptors(const image_t image_id) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  return descriptors_exists_cache_->Get(image_id);
+  return *descriptors_exists_cache_->Get(image_id);
 }
 
 bool FeatureMatcherCache::ExistsMatches(const image_t image_id1,
                                         const image_t image_id2) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  return database_->ExistsMatches(image_id1, image_id2);
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  return matched_image_pair_ids_.count(pair_id) > 0;
 }
 
 bool FeatureMatcherCache::ExistsInlierMatches(const image_t image_id1,
                                               const image_t image_id2) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  return database_->ExistsInlierMatches(image_id1, image_id2);
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  return verified_image_pairs_.count(pair_id) > 0;
+}
+
+int FeatureMatcherCache::GetNumInlierMatches(const image_t image_id1,
+                                             const image_t image_id2) {
+  const image_pair_t pair_id =
+      Database::ImagePairToPairId(image_id1, image_id2);
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  const auto it = verified_image_pairs_.find(pair_id);
+  return it == verified_image_pairs_.end() ? 0 : it->second;
 }
 
 void FeatureMatcherCache::WriteMatches(const image_t image_id1,
                                        const image_t image_id2,
                                        const FeatureMatches& matches) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  database_->WriteMatches(image_id1, image_id2, matches);
+  {
+    const auto lock = LockDatabase();
+    database_->WriteMatches(image_id1, image_id2, matches);
+  }
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  matched_image_pair_ids_.insert(
+      Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 void FeatureMatcherCache::WriteTwoViewGeometry(
     const image_t image_id1, const image_t image_id2,
     const TwoViewGeometry& two_view_geometry) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  database_->WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  {
+    const auto lock = LockDatabase();
+    database_->WriteTwoViewGeometry(image_id1, image_id2, two_view_geometry);
+  }
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  verified_image_pairs_[Database::ImagePairToPairId(image_id1, image_id2)] =
+      static_cast<int>(two_view_geometry.inlier_matches.size());
 }
 
 void FeatureMatcherCache::DeleteMatches(const image_t image_id1,
                                         const image_t image_id2) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  database_->DeleteMatches(image_id1, image_id2);
+  {
+    const auto lock = LockDatabase();
+    database_->DeleteMatches(image_id1, image_id2);
+  }
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  matched_image_pair_ids_.erase(
+      Database::ImagePairToPairId(image_id1, image_id2));
 }
 
 void FeatureMatcherCache::DeleteInlierMatches(const image_t image_id1,
                                               const image_t image_id2) {
-  std::unique_lock<std::mutex> lock(database_mutex_);
-  database_->DeleteInlierMatches(image_id1, image_id2);
+  {
+    const auto lock = LockDatabase();
+    database_->DeleteInlierMatches(image_id1, image_id2);
+  }
+  std::unique_lock<std::mutex> lock(image_pairs_mutex_);
+  verified_image_pairs_.erase(
+      Database::ImagePairToPairId(image_id1, image_id2));
+}
+
+void FeatureMatcherCache::PrintStats() const {
+  const auto PrintCacheStats = [](const std::string& name,
+                                  const size_t num_hits,
+                                  const size_t num_misses,
+                                  const size_t num_waits) {
+    const size_t num_requests = num_hits + num_misses + num_waits;
+    std::cout << StringPrintf(
+                     "  %-16s %d hits, %d misses, %d waits, %.1f%% hit rate",
+                     (name + ":").c_str(), static_cast<int>(num_hits),
+                     static_cast<int>(num_misses), static_cast<int>(num_waits),
+                     num_requests > 0 ? 100.0 * num_hits / num_requests : 0)
+              << std::endl;
+  };
+
+  PrintCacheStats("Keypoints", keypoints_cache_->NumHits(),
+                  keypoints_cache_->NumMisses(), keypoints_cache_->NumWaits());
+  PrintCacheStats("Descriptors", descriptors_cache_->NumHits(),
+                  descriptors_cache_->NumMisses(),
+                  descriptors_cache_->NumWaits());
+  PrintCacheStats("Indices", descriptor_index_cache_->NumHits(),
+                  descriptor_index_cache_->NumMisses(),
+                  descriptor_index_cache_->NumWaits());
+  PrintCacheStats("Binary", binary_descriptors_cache_->NumHits(),
+                  binary_descriptors_cache_->NumMisses(),
+                  binary_descriptors_cache_->NumWaits());
+  PrintCacheStats("Points", points_cache_->NumHits(),
+                  points_cache_->NumMisses(), points_cache_->NumWaits());
+  std::cout << StringPrintf("  %-16s %.3fs waiting for access", "Database:",
+                            database_wait_micro_seconds_ / 1e6)
+            << std::endl;
+}
+
+void FeatureMatcherCache::RecordMetrics() const {
+  const auto RecordHitRate = [](const std::string& name,
+                                const double hit_ratio) {
+    GetMetricGauge("matching_" + name + "_cache_hit_rate",
+                   "Fraction of the requests served from the cache")
+        .Set(hit_ratio);
+  };
+
+  RecordHitRate("keypoints", keypoints_cache_->HitRatio());
+  RecordHitRate("descriptors", descriptors_cache_->HitRatio());
+  RecordHitRate("indices", descriptor_index_cache_->HitRatio());
+  RecordHitRate("binary_descriptors", binary_descriptors_cache_->HitRatio());
+  RecordHitRate("points", points_cache_->HitRatio());
+  GetMetricGauge("matching_database_wait_seconds",
+                 "Time spent waiting for access to the database")
+      .Set(database_wait_micro_seconds_ / 1e6);
+}
+
+std::unique_lock<std::mutex> FeatureMatcherCache::LockDatabase() {
+  std::unique_lock<std::mutex> lock(database_mutex_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    Timer timer;
+    timer.Start();
+    lock.lock();
+    database_wait_micro_seconds_ +=
+        static_cast<size_t>(timer.ElapsedMicroSeconds());
+  }
+  return lock;
+}
+
+template <typename func_t>
+auto FeatureMatcherCache::ReadFeatures(const func_t& func)
+    -> decltype(func(std::declval<const Database&>())) {
+  if (reader_pool_->NumConnections() > 0) {
+    const auto reader = reader_pool_->Acquire();
+    return func(*reader);
+  }
+  const auto lock = LockDatabase();
+  return func(*database_);
+}
+
+namespace internal {
+
+void FeatureMatcherStageStats::Add(const double processing_seconds,
+                                   const double starved_seconds,
+                                   const double stalled_seconds,
+                                   const size_t num_pairs) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_pairs_ += num_pairs;
+  processing_seconds_ += processing_seconds;
+  starved_seconds_ += starved_seconds;
+  stalled_seconds_ += stalled_seconds;
+}
+
+void FeatureMatcherStageStats::AddRejected(const double processing_seconds) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  num_rejected_pairs_ += 1;
+  rejected_processing_seconds_ += processing_seconds;
+}
+
+size_t FeatureMatcherStageStats::NumPairs() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return num_pairs_;
+}
+
+size_t FeatureMatcherStageStats::NumRejectedPairs() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return num_rejected_pairs_;
+}
+
+double FeatureMatcherStageStats::ProcessingSeconds() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return processing_seconds_;
 }
 
+double FeatureMatcherStageStats::StarvedSeconds() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return starved_seconds_;
+}
+
+double FeatureMatcherStageStats::StalledSeconds() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stalled_seconds_;
+}
+
+void FeatureMatcherStageStats::Print(const std::string& name,
+                                     const size_t num_threads,
+                                     const double elapsed_seconds) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Fractions of the available thread time, i.e., a busy stage that is never
+  // starved is the bottleneck of the pipeline, while a stalled stage has more
+  // threads than its downstream stage can absorb.
+  const double thread_seconds = num_threads * elapsed_seconds;
+  const auto Percent = [thread_seconds](const double seconds) {
+    return thread_seconds > 0 ? 100 * seconds / thread_seconds : 0;
+  };
+  std::cout << StringPrintf(
+                   "  %-16s %d pairs, %d threads, %.1f%% busy, "
+                   "%.1f%% starved, %.1f%% stalled",
+                   (name + ":").c_str(), static_cast<int>(num_pairs_),
+                   static_cast<int>(num_threads), Percent(processing_seconds_),
+                   Percent(starved_seconds_), Percent(stalled_seconds_));
+  if (num_rejected_pairs_ > 0) {
+    // Number of rejected pairs per second of processing time of one thread.
+    std::cout << StringPrintf(
+        ", %d rejected at %.1f pairs/s", static_cast<int>(num_rejected_pairs_),
+        rejected_processing_seconds_ > 0
+            ? num_rejected_pairs_ / rejected_processing_seconds_
+            : 0);
+  }
+  std::cout << std::endl;
+}
+
+}  // namespace internal
+
 FeatureMatcherThread::FeatureMatcherThread(const SiftMatchingOptions& options,
                                            FeatureMatcherCache* cache)
     : options_(options), cache_(cache) {}
@@ -343,52 +1640,75 @@ void FeatureMatcherThread::SetMaxNumMatches(const int max_num_matches) {
   options_.max_num_matches = max_num_matches;
 }
 
-SiftCPUFeatureMatcher::SiftCPUFeatureMatcher(const SiftMatchingOptions& options,
-                                             FeatureMatcherCache* cache,
-                                             JobQueue<Input>* input_queue,
-                                             JobQueue<Output>* output_queue)
+SiftCPUFeatureMatcher::SiftCPUFeatureMatcher(
+    const SiftMatchingOptions& options, FeatureMatcherCache* cache,
+    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+    internal::FeatureMatcherStageStats* stats)
     : FeatureMatcherThread(options, cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats) {
   CHECK(options_.Check());
 }
 
 void SiftCPUFeatureMatcher::Run() {
   SignalValidSetup();
 
+  StageTimer stage_timer(stats_);
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = stage_timer.Pop(input_queue_);
     if (input_job.IsValid()) {
-      auto data = input_job.Data();
+      auto data = std::move(input_job.Data());
 
       if (!cache_->ExistsDescriptors(data.image_id1) ||
           !cache_->ExistsDescriptors(data.image_id2)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
-      const FeatureDescriptors descriptors1 =
-          cache_->GetDescriptors(data.image_id1);
-      const FeatureDescriptors descriptors2 =
-          cache_->GetDescriptors(data.image_id2);
-      MatchSiftFeaturesCPU(options_, descriptors1, descriptors2, &data.matches);
+      {
+        const TraceSpan trace_span("matching/match");
+        if (options_.binary_matching) {
+          const auto descriptors1 =
+              cache_->GetBinaryDescriptors(data.image_id1);
+          const auto descriptors2 =
+              cache_->GetBinaryDescriptors(data.image_id2);
+          MatchBinarySiftFeaturesCPU(options_, *descriptors1, *descriptors2,
+                                     &data.matches);
+        } else if (options_.cpu_cache_indices) {
+          const auto index1 = cache_->GetDescriptorIndex(data.image_id1);
+          const auto index2 = cache_->GetDescriptorIndex(data.image_id2);
+          MatchSiftFeaturesCPUFLANN(options_, *index1, *index2, &data.matches);
+        } else {
+          const auto descriptors1 = cache_->GetDescriptors(data.image_id1);
+          const auto descriptors2 = cache_->GetDescriptors(data.image_id2);
+          MatchSiftFeaturesCPU(options_, *descriptors1, *descriptors2,
+                               &data.matches);
+        }
+      }
 
-      CHECK(output_queue_->Push(data));
+      CHECK(stage_timer.Push(output_queue_, std::move(data)));
     }
   }
 }
 
-SiftGPUFeatureMatcher::SiftGPUFeatureMatcher(const SiftMatchingOptions& options,
-                                             FeatureMatcherCache* cache,
-                                             JobQueue<Input>* input_queue,
-                                             JobQueue<Output>* output_queue)
+SiftGPUFeatureMatcher::SiftGPUFeatureMatcher(
+    const SiftMatchingOptions& options, FeatureMatcherCache* cache,
+    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+    internal::FeatureMatcherStageStats* stats,
+    const std::vector<JobQueue<Input>*>& steal_queues,
+    internal::FeatureMatcherStageStats* device_stats)
     : FeatureMatcherThread(options, cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats),
+      steal_queues_(steal_queues),
+      device_stats_(device_stats) {
   CHECK(options_.Check());
 
   prev_uploaded_image_ids_[0] = kInvalidImageId;
@@ -414,33 +1734,80 @@ void SiftGPUFeatureMatcher::Run() {
 
   SignalValidSetup();
 
+  StageTimer stage_timer(stats_);
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    // Only wait for the own queue, if there is nothing to steal.
+    auto input_job = input_queue_->TryPop();
+    if (!input_job.IsValid()) {
+      input_job = TrySteal();
+    }
+    if (input_job.IsValid()) {
+      stage_timer.Start();
+    } else {
+      input_job = stage_timer.Pop(input_queue_);
+    }
+
     if (input_job.IsValid()) {
-      auto data = input_job.Data();
+      auto data = std::move(input_job.Data());
 
       if (!cache_->ExistsDescriptors(data.image_id1) ||
           !cache_->ExistsDescriptors(data.image_id2)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
-      const FeatureDescriptors* descriptors1_ptr;
-      GetDescriptorData(0, data.image_id1, &descriptors1_ptr);
-      const FeatureDescriptors* descriptors2_ptr;
-      GetDescriptorData(1, data.image_id2, &descriptors2_ptr);
-      MatchSiftFeaturesGPU(options_, descriptors1_ptr, descriptors2_ptr,
-                           &sift_match_gpu, &data.matches);
+      {
+        const TraceSpan trace_span("matching/match");
+        Timer timer;
+        timer.Start();
+        const FeatureDescriptors* descriptors1_ptr;
+        GetDescriptorData(0, data.image_id1, &descriptors1_ptr);
+        const FeatureDescriptors* descriptors2_ptr;
+        GetDescriptorData(1, data.image_id2, &descriptors2_ptr);
+        MatchSiftFeaturesGPU(options_, descriptors1_ptr, descriptors2_ptr,
+                             &sift_match_gpu, &data.matches);
+        if (device_stats_ != nullptr) {
+          device_stats_->Add(timer.ElapsedSeconds(), 0, 0);
+        }
+      }
 
-      CHECK(output_queue_->Push(data));
+      CHECK(stage_timer.Push(output_queue_, std::move(data)));
     }
   }
 }
 
+JobQueue<SiftGPUFeatureMatcher::Input>::Job SiftGPUFeatureMatcher::TrySteal() {
+  static MetricCounter& num_stolen_image_pairs = GetMetricCounter(
+      "matching_stolen_image_pairs_total",
+      "Number of image pairs matched by another than the assigned GPU");
+
+  JobQueue<Input>* steal_queue = nullptr;
+  size_t max_num_jobs = 0;
+  for (auto* queue : steal_queues_) {
+    const size_t num_jobs = queue->Size();
+    if (num_jobs > max_num_jobs) {
+      steal_queue = queue;
+      max_num_jobs = num_jobs;
+    }
+  }
+
+  if (steal_queue == nullptr) {
+    return JobQueue<Input>::Job();
+  }
+
+  auto job = steal_queue->TryPop();
+  if (job.IsValid()) {
+    num_stolen_image_pairs.Increment();
+  }
+
+  return job;
+}
+
 void SiftGPUFeatureMatcher::GetDescriptorData(
     const int index, const image_t image_id,
     const FeatureDescriptors** descriptors_ptr) {
@@ -449,7 +1816,7 @@ void SiftGPUFeatureMatcher::GetDescriptorData(
   if (prev_uploaded_image_ids_[index] == image_id) {
     *descriptors_ptr = nullptr;
   } else {
-    prev_uploaded_descriptors_[index] = cache_->GetDescriptors(image_id);
+    prev_uploaded_descriptors_[index] = *cache_->GetDescriptors(image_id);
     *descriptors_ptr = &prev_uploaded_descriptors_[index];
     prev_uploaded_image_ids_[index] = image_id;
   }
@@ -457,28 +1824,32 @@ void SiftGPUFeatureMatcher::GetDescriptorData(
 
 GuidedSiftCPUFeatureMatcher::GuidedSiftCPUFeatureMatcher(
     const SiftMatchingOptions& options, FeatureMatcherCache* cache,
-    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue)
+    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+    internal::FeatureMatcherStageStats* stats)
     : FeatureMatcherThread(options, cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats) {
   CHECK(options_.Check());
 }
 
 void GuidedSiftCPUFeatureMatcher::Run() {
   SignalValidSetup();
 
+  StageTimer stage_timer(stats_);
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = stage_timer.Pop(input_queue_);
     if (input_job.IsValid()) {
-      auto data = input_job.Data();
+      auto data = std::move(input_job.Data());
 
       if (data.two_view_geometry.inlier_matches.size() <
           static_cast<size_t>(options_.min_num_inliers)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
@@ -486,30 +1857,34 @@ void GuidedSiftCPUFeatureMatcher::Run() {
           !cache_->ExistsKeypoints(data.image_id2) ||
           !cache_->ExistsDescriptors(data.image_id1) ||
           !cache_->ExistsDescriptors(data.image_id2)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
-      const FeatureKeypoints keypoints1 = cache_->GetKeypoints(data.image_id1);
-      const FeatureKeypoints keypoints2 = cache_->GetKeypoints(data.image_id2);
-      const FeatureDescriptors descriptors1 =
-          cache_->GetDescriptors(data.image_id1);
-      const FeatureDescriptors descriptors2 =
-          cache_->GetDescriptors(data.image_id2);
-      MatchGuidedSiftFeaturesCPU(options_, keypoints1, keypoints2, descriptors1,
-                                 descriptors2, &data.two_view_geometry);
+      {
+        const TraceSpan trace_span("matching/guided_match");
+        const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
+        const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
+        const auto descriptors1 = cache_->GetDescriptors(data.image_id1);
+        const auto descriptors2 = cache_->GetDescriptors(data.image_id2);
+        MatchGuidedSiftFeaturesCPU(options_, *keypoints1, *keypoints2,
+                                   *descriptors1, *descriptors2,
+                                   &data.two_view_geometry);
+      }
 
-      CHECK(output_queue_->Push(data));
+      CHECK(stage_timer.Push(output_queue_, std::move(data)));
     }
   }
 }
 
 GuidedSiftGPUFeatureMatcher::GuidedSiftGPUFeatureMatcher(
     const SiftMatchingOptions& options, FeatureMatcherCache* cache,
-    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue)
+    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+    internal::FeatureMatcherStageStats* stats)
     : FeatureMatcherThread(options, cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats) {
   CHECK(options_.Check());
 
   prev_uploaded_image_ids_[0] = kInvalidImageId;
@@ -535,18 +1910,20 @@ void GuidedSiftGPUFeatureMatcher::Run() {
 
   SignalValidSetup();
 
+  StageTimer stage_timer(stats_);
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = stage_timer.Pop(input_queue_);
     if (input_job.IsValid()) {
-      auto data = input_job.Data();
+      auto data = std::move(input_job.Data());
 
       if (data.two_view_geometry.inlier_matches.size() <
           static_cast<size_t>(options_.min_num_inliers)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
@@ -554,22 +1931,42 @@ void GuidedSiftGPUFeatureMatcher::Run() {
           !cache_->ExistsKeypoints(data.image_id2) ||
           !cache_->ExistsDescriptors(data.image_id1) ||
           !cache_->ExistsDescriptors(data.image_id2)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
         continue;
       }
 
-      const FeatureDescriptors* descriptors1_ptr;
-      const FeatureKeypoints* keypoints1_ptr;
-      GetFeatureData(0, data.image_id1, &keypoints1_ptr, &descriptors1_ptr);
-      const FeatureDescriptors* descriptors2_ptr;
-      const FeatureKeypoints* keypoints2_ptr;
-      GetFeatureData(1, data.image_id2, &keypoints2_ptr, &descriptors2_ptr);
+      // SiftMatchGPU clamps the number of features, so images with more
+      // features are matched with the grid-based guided matching on the CPU.
+      const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
+      const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
+      if (keypoints1->size() >
+              static_cast<size_t>(sift_match_gpu.GetMaxSift()) ||
+          keypoints2->size() >
+              static_cast<size_t>(sift_match_gpu.GetMaxSift())) {
+        const auto descriptors1 = cache_->GetDescriptors(data.image_id1);
+        const auto descriptors2 = cache_->GetDescriptors(data.image_id2);
+        MatchGuidedSiftFeaturesCPU(options_, *keypoints1, *keypoints2,
+                                   *descriptors1, *descriptors2,
+                                   &data.two_view_geometry);
+        CHECK(stage_timer.Push(output_queue_, std::move(data)));
+        continue;
+      }
 
-      MatchGuidedSiftFeaturesGPU(options_, keypoints1_ptr, keypoints2_ptr,
-                                 descriptors1_ptr, descriptors2_ptr,
-                                 &sift_match_gpu, &data.two_view_geometry);
+      {
+        const TraceSpan trace_span("matching/guided_match");
+        const FeatureDescriptors* descriptors1_ptr;
+        const FeatureKeypoints* keypoints1_ptr;
+        GetFeatureData(0, data.image_id1, &keypoints1_ptr, &descriptors1_ptr);
+        const FeatureDescriptors* descriptors2_ptr;
+        const FeatureKeypoints* keypoints2_ptr;
+        GetFeatureData(1, data.image_id2, &keypoints2_ptr, &descriptors2_ptr);
+
+        MatchGuidedSiftFeaturesGPU(options_, keypoints1_ptr, keypoints2_ptr,
+                                   descriptors1_ptr, descriptors2_ptr,
+                                   &sift_match_gpu, &data.two_view_geometry);
+      }
 
-      CHECK(output_queue_->Push(data));
+      CHECK(stage_timer.Push(output_queue_, std::move(data)));
     }
   }
 }
@@ -584,8 +1981,8 @@ void GuidedSiftGPUFeatureMatcher::GetFeatureData(
     *keypoints_ptr = nullptr;
     *descriptors_ptr = nullptr;
   } else {
-    prev_uploaded_keypoints_[index] = cache_->GetKeypoints(image_id);
-    prev_uploaded_descriptors_[index] = cache_->GetDescriptors(image_id);
+    prev_uploaded_keypoints_[index] = *cache_->GetKeypoints(image_id);
+    prev_uploaded_descriptors_[index] = *cache_->GetDescriptors(image_id);
     *keypoints_ptr = &prev_uploaded_keypoints_[index];
     *descriptors_ptr = &prev_uploaded_descriptors_[index];
     prev_uploaded_image_ids_[index] = image_id;
@@ -594,11 +1991,13 @@ void GuidedSiftGPUFeatureMatcher::GetFeatureData(
 
 TwoViewGeometryVerifier::TwoViewGeometryVerifier(
     const SiftMatchingOptions& options, FeatureMatcherCache* cache,
-    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue)
+    JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+    internal::FeatureMatcherStageStats* stats)
     : options_(options),
       cache_(cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats) {
   CHECK(options_.Check());
 
   two_view_geometry_options_.min_num_inliers =
@@ -611,43 +2010,53 @@ TwoViewGeometryVerifier::TwoViewGeometryVerifier(
       static_cast<size_t>(options_.max_num_trials);
   two_view_geometry_options_.ransac_options.min_inlier_ratio =
       options_.min_inlier_ratio;
+  two_view_geometry_options_.early_exit = options_.early_exit_verification;
+  two_view_geometry_options_.progressive_sampling =
+      options_.progressive_sampling;
 }
 
 void TwoViewGeometryVerifier::Run() {
+  StageTimer stage_timer(stats_);
+
   while (true) {
     if (IsStopped()) {
       break;
     }
 
-    const auto input_job = input_queue_->Pop();
+    auto input_job = stage_timer.Pop(input_queue_);
     if (input_job.IsValid()) {
-      auto data = input_job.Data();
+      auto data = std::move(input_job.Data());
 
       if (data.matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
-        CHECK(output_queue_->Push(data));
+        CHECK(stage_timer.Push(output_queue_, std::move(data), true));
         continue;
       }
 
-      const auto& camera1 =
-          cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
-      const auto& camera2 =
-          cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-      const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-      const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-      const auto points1 = FeatureKeypointsToPointsVector(keypoints1);
-      const auto points2 = FeatureKeypointsToPointsVector(keypoints2);
-
-      if (options_.multiple_models) {
-        data.two_view_geometry.EstimateMultiple(camera1, points1, camera2,
-                                                points2, data.matches,
-                                                two_view_geometry_options_);
-      } else {
-        data.two_view_geometry.Estimate(camera1, points1, camera2, points2,
-                                        data.matches,
-                                        two_view_geometry_options_);
+      {
+        const TraceSpan trace_span("matching/verify");
+        const auto& camera1 =
+            cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
+        const auto& camera2 =
+            cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
+        const auto points1 = cache_->GetPoints(data.image_id1);
+        const auto points2 = cache_->GetPoints(data.image_id2);
+
+        if (options_.multiple_models) {
+          data.two_view_geometry.EstimateMultiple(
+              camera1, points1->points, points1->points_normalized, camera2,
+              points2->points, points2->points_normalized, data.matches,
+              two_view_geometry_options_);
+        } else {
+          data.two_view_geometry.Estimate(
+              camera1, points1->points, points1->points_normalized, camera2,
+              points2->points, points2->points_normalized, data.matches,
+              two_view_geometry_options_);
+        }
       }
 
-      CHECK(output_queue_->Push(data));
+      const bool rejected = data.two_view_geometry.config ==
+                            TwoViewGeometry::ConfigurationType::DEGENERATE;
+      CHECK(stage_timer.Push(output_queue_, std::move(data), rejected));
     }
   }
 }
@@ -655,9 +2064,17 @@ void TwoViewGeometryVerifier::Run() {
 SiftFeatureMatcher::SiftFeatureMatcher(const SiftMatchingOptions& options,
                                        Database* database,
                                        FeatureMatcherCache* cache)
-    : options_(options), database_(database), cache_(cache), is_setup_(false) {
+    : options_(options),
+      database_(database),
+      cache_(cache),
+      is_setup_(false),
+      matcher_queue_(kMaxNumQueuedImagePairs),
+      verifier_queue_(kMaxNumQueuedImagePairs),
+      guided_matcher_queue_(kMaxNumQueuedImagePairs) {
   CHECK(options_.Check());
 
+  database_->SetCompressMatches(options_.compress_matches);
+
   const int num_threads = GetEffectiveNumThreads(options_.num_threads);
   CHECK_GT(num_threads, 0);
 
@@ -673,54 +2090,80 @@ SiftFeatureMatcher::SiftFeatureMatcher(const SiftMatchingOptions& options,
   }
 #endif  // CUDA_ENABLED
 
-  if (options_.use_gpu) {
+  // Binary descriptors are only matched on the CPU.
+  if (options_.use_gpu && !options_.binary_matching) {
+    gpu_matcher_queues_.reserve(gpu_indices.size());
+    gpu_matcher_stats_.reserve(gpu_indices.size());
+    for (size_t i = 0; i < gpu_indices.size(); ++i) {
+      gpu_matcher_queues_.emplace_back(
+          new JobQueue<internal::FeatureMatcherData>(kMaxNumQueuedImagePairs));
+      gpu_matcher_stats_.emplace_back(new internal::FeatureMatcherStageStats());
+    }
+    gpu_matcher_image_ids_.assign(gpu_indices.size(), kInvalidImageId);
+
     auto gpu_options = options_;
     matchers_.reserve(gpu_indices.size());
-    for (const auto& gpu_index : gpu_indices) {
-      gpu_options.gpu_index = std::to_string(gpu_index);
+    for (size_t i = 0; i < gpu_indices.size(); ++i) {
+      gpu_options.gpu_index = std::to_string(gpu_indices[i]);
+      std::vector<JobQueue<internal::FeatureMatcherData>*> steal_queues;
+      for (size_t j = 0; j < gpu_indices.size(); ++j) {
+        if (j != i) {
+          steal_queues.push_back(gpu_matcher_queues_[j].get());
+        }
+      }
       matchers_.emplace_back(new SiftGPUFeatureMatcher(
-          gpu_options, cache, &matcher_queue_, &verifier_queue_));
+          gpu_options, cache, gpu_matcher_queues_[i].get(), &verifier_queue_,
+          &matcher_stats_, steal_queues, gpu_matcher_stats_[i].get()));
     }
   } else {
     matchers_.reserve(num_threads);
     for (int i = 0; i < num_threads; ++i) {
-      matchers_.emplace_back(new SiftCPUFeatureMatcher(
-          options_, cache, &matcher_queue_, &verifier_queue_));
+      matchers_.emplace_back(
+          new SiftCPUFeatureMatcher(options_, cache, &matcher_queue_,
+                                    &verifier_queue_, &matcher_stats_));
     }
   }
 
+  auto* verifier_output_queue =
+      options_.guided_matching ? &guided_matcher_queue_ : &output_queue_;
   verifiers_.reserve(num_threads);
-  if (options_.guided_matching) {
-    for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(new TwoViewGeometryVerifier(
-          options_, cache, &verifier_queue_, &guided_matcher_queue_));
-    }
+  for (int i = 0; i < num_threads; ++i) {
+    verifiers_.emplace_back(new TwoViewGeometryVerifier(
+        options_, cache, &verifier_queue_, verifier_output_queue,
+        &verifier_stats_));
+  }
 
+  if (options_.guided_matching) {
     if (options_.use_gpu) {
       auto gpu_options = options_;
       guided_matchers_.reserve(gpu_indices.size());
       for (const auto& gpu_index : gpu_indices) {
         gpu_options.gpu_index = std::to_string(gpu_index);
         guided_matchers_.emplace_back(new GuidedSiftGPUFeatureMatcher(
-            gpu_options, cache, &guided_matcher_queue_, &output_queue_));
+            gpu_options, cache, &guided_matcher_queue_, &output_queue_,
+            &guided_matcher_stats_));
       }
     } else {
       guided_matchers_.reserve(num_threads);
       for (int i = 0; i < num_threads; ++i) {
         guided_matchers_.emplace_back(new GuidedSiftCPUFeatureMatcher(
-            options_, cache, &guided_matcher_queue_, &output_queue_));
+            options_, cache, &guided_matcher_queue_, &output_queue_,
+            &guided_matcher_stats_));
       }
     }
-  } else {
-    for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(new TwoViewGeometryVerifier(
-          options_, cache, &verifier_queue_, &output_queue_));
-    }
   }
 }
 
 SiftFeatureMatcher::~SiftFeatureMatcher() {
+  // Write the results of an interrupted matching, whose caller did not flush.
+  if (is_setup_) {
+    Flush();
+  }
+
   matcher_queue_.Wait();
+  for (auto& gpu_matcher_queue : gpu_matcher_queues_) {
+    gpu_matcher_queue->Wait();
+  }
   verifier_queue_.Wait();
   guided_matcher_queue_.Wait();
   output_queue_.Wait();
@@ -738,6 +2181,9 @@ SiftFeatureMatcher::~SiftFeatureMatcher() {
   }
 
   matcher_queue_.Stop();
+  for (auto& gpu_matcher_queue : gpu_matcher_queues_) {
+    gpu_matcher_queue->Stop();
+  }
   verifier_queue_.Stop();
   guided_matcher_queue_.Stop();
   output_queue_.Stop();
@@ -756,9 +2202,11 @@ SiftFeatureMatcher::~SiftFeatureMatcher() {
 }
 
 bool SiftFeatureMatcher::Setup() {
-  const int max_num_features = CHECK_NOTNULL(database_)->MaxNumDescriptors();
-  options_.max_num_matches =
-      std::min(options_.max_num_matches, max_num_features);
+  if (!CHECK_NOTNULL(database_)->Path().empty()) {
+    const int max_num_features = database_->MaxNumDescriptors();
+    options_.max_num_matches =
+        std::min(options_.max_num_matches, max_num_features);
+  }
 
   for (auto& matcher : matchers_) {
     matcher->SetMaxNumMatches(options_.max_num_matches);
@@ -788,6 +2236,8 @@ bool SiftFeatureMatcher::Setup() {
 
   is_setup_ = true;
 
+  timer_.Start();
+
   return true;
 }
 
@@ -808,8 +2258,19 @@ void SiftFeatureMatcher::Match(
   std::unordered_set<image_pair_t> image_pair_ids;
   image_pair_ids.reserve(image_pairs.size());
 
+  // The GPU matcher that receives the current group of image pairs with the
+  // same first image. A new group goes to the least busy GPU matcher.
+  image_t gpu_matcher_image_id1 = kInvalidImageId;
+  size_t gpu_matcher_idx = 0;
+
+  // Only the GPU matchers benefit from grouping, since the CPU matchers have
+  // no notion of uploaded descriptors.
+  const std::vector<std::pair<image_t, image_t>> ordered_image_pairs =
+      gpu_matcher_queues_.empty() ? image_pairs
+                                  : GroupImagePairsByFirstImage(image_pairs);
+
   size_t num_outputs = 0;
-  for (const auto image_pair : image_pairs) {
+  for (const auto image_pair : ordered_image_pairs) {
     // Avoid self-matches.
     if (image_pair.first == image_pair.second) {
       continue;
@@ -824,6 +2285,11 @@ void SiftFeatureMatcher::Match(
 
     image_pair_ids.insert(pair_id);
 
+    // Skip image pairs of a previous batch that are still being processed.
+    if (pending_image_pair_ids_.count(pair_id) > 0) {
+      continue;
+    }
+
     const bool exists_matches =
         cache_->ExistsMatches(image_pair.first, image_pair.second);
     const bool exists_inlier_matches =
@@ -834,6 +2300,7 @@ void SiftFeatureMatcher::Match(
     }
 
     num_outputs += 1;
+    pending_image_pair_ids_.insert(pair_id);
 
     // If only one of the matches or inlier matches exist, we recompute them
     // from scratch and delete the existing results. This must be done before
@@ -848,39 +2315,182 @@ void SiftFeatureMatcher::Match(
     data.image_id1 = image_pair.first;
     data.image_id2 = image_pair.second;
 
+    // Pushing blocks, if the downstream stages cannot keep up with the rate
+    // at which new image pairs are dispatched.
+    Timer push_timer;
+    push_timer.Start();
+
     if (exists_matches) {
       data.matches = cache_->GetMatches(image_pair.first, image_pair.second);
       cache_->DeleteMatches(image_pair.first, image_pair.second);
-      CHECK(verifier_queue_.Push(data));
+      CHECK(verifier_queue_.Push(std::move(data)));
+    } else if (gpu_matcher_queues_.empty()) {
+      CHECK(matcher_queue_.Push(std::move(data)));
     } else {
-      CHECK(matcher_queue_.Push(data));
+      if (image_pair.first != gpu_matcher_image_id1) {
+        gpu_matcher_image_id1 = image_pair.first;
+        gpu_matcher_idx = SelectGPUMatcher(image_pair.first);
+        gpu_matcher_image_ids_[gpu_matcher_idx] = image_pair.first;
+      }
+      CHECK(gpu_matcher_queues_[gpu_matcher_idx]->Push(std::move(data)));
     }
+
+    writer_stats_.Add(0, 0, push_timer.ElapsedSeconds(), 0);
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Write results to database
+  // Write results of previous batches to database
   //////////////////////////////////////////////////////////////////////////////
 
-  for (size_t i = 0; i < num_outputs; ++i) {
-    const auto output_job = output_queue_.Pop();
-    CHECK(output_job.IsValid());
-    auto output = output_job.Data();
+  // Keep the current batch in flight, so that the matchers and verifiers
+  // continue to work while the caller composes the next batch. The results
+  // are written in the order in which they finish, so this may also write
+  // some results of the current batch.
+  while (pending_image_pair_ids_.size() > num_outputs) {
+    WriteOutput();
+  }
+
+  RecordMetrics();
+}
+
+void SiftFeatureMatcher::Flush() {
+  CHECK_NOTNULL(cache_);
+  while (!pending_image_pair_ids_.empty()) {
+    WriteOutput();
+  }
+
+  CHECK_EQ(output_queue_.Size(), 0);
+}
 
-    if (output.matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
-      output.matches = {};
+void SiftFeatureMatcher::PrintStageStats() const {
+  const double elapsed_seconds = timer_.ElapsedSeconds();
+  matcher_stats_.Print("Matching", matchers_.size(), elapsed_seconds);
+  for (size_t i = 0; i < gpu_matcher_stats_.size(); ++i) {
+    gpu_matcher_stats_[i]->Print(
+        StringPrintf("  GPU %d", static_cast<int>(i)), 1, elapsed_seconds);
+  }
+  verifier_stats_.Print("Verification", verifiers_.size(), elapsed_seconds);
+  if (!guided_matchers_.empty()) {
+    guided_matcher_stats_.Print("Guided matching", guided_matchers_.size(),
+                                elapsed_seconds);
+  }
+  writer_stats_.Print("Writing", 1, elapsed_seconds);
+  cache_->PrintStats();
+}
+
+size_t SiftFeatureMatcher::SelectGPUMatcher(const image_t image_id1) const {
+  // The number of image pairs, by which the GPU matcher that already has the
+  // descriptors of the first image may lag behind the least loaded GPU
+  // matcher. Uploading the descriptors takes about as long as matching a few
+  // image pairs, and the other GPU matchers steal from a lagging matcher.
+  const double kMaxNumAffinityImagePairs = 8;
+
+  // The throughput of the GPU matchers in image pairs per second. GPU matchers
+  // without measurements are assumed to be as fast as the average GPU.
+  std::vector<double> throughputs(gpu_matcher_queues_.size(), 0);
+  double mean_throughput = 0;
+  size_t num_measured_throughputs = 0;
+  for (size_t i = 0; i < gpu_matcher_queues_.size(); ++i) {
+    const double processing_seconds =
+        gpu_matcher_stats_[i]->ProcessingSeconds();
+    if (processing_seconds > 0) {
+      throughputs[i] = gpu_matcher_stats_[i]->NumPairs() / processing_seconds;
+      mean_throughput += throughputs[i];
+      num_measured_throughputs += 1;
     }
+  }
+  mean_throughput = num_measured_throughputs > 0
+                        ? mean_throughput / num_measured_throughputs
+                        : 1;
+  for (auto& throughput : throughputs) {
+    if (throughput == 0) {
+      throughput = mean_throughput;
+    }
+  }
 
-    if (output.two_view_geometry.inlier_matches.size() <
-        static_cast<size_t>(options_.min_num_inliers)) {
-      output.two_view_geometry = TwoViewGeometry();
+  // The estimated time until each GPU matcher has processed its queue and the
+  // next image pair.
+  std::vector<double> drain_seconds(gpu_matcher_queues_.size());
+  size_t min_idx = 0;
+  for (size_t i = 0; i < gpu_matcher_queues_.size(); ++i) {
+    drain_seconds[i] = (gpu_matcher_queues_[i]->Size() + 1) / throughputs[i];
+    if (drain_seconds[i] < drain_seconds[min_idx]) {
+      min_idx = i;
     }
+  }
 
-    cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
-    cache_->WriteTwoViewGeometry(output.image_id1, output.image_id2,
-                                 output.two_view_geometry);
+  for (size_t i = 0; i < gpu_matcher_queues_.size(); ++i) {
+    if (gpu_matcher_image_ids_[i] == image_id1 &&
+        drain_seconds[i] <= drain_seconds[min_idx] +
+                                kMaxNumAffinityImagePairs / throughputs[i]) {
+      return i;
+    }
   }
 
-  CHECK_EQ(output_queue_.Size(), 0);
+  return min_idx;
+}
+
+void SiftFeatureMatcher::WriteOutput() {
+  Timer timer;
+  timer.Start();
+
+  auto output_job = output_queue_.Pop();
+  CHECK(output_job.IsValid());
+  auto output = std::move(output_job.Data());
+
+  const double starved_seconds = timer.ElapsedSeconds();
+  timer.Restart();
+
+  if (output.matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
+    output.matches = {};
+  }
+
+  if (output.two_view_geometry.inlier_matches.size() <
+      static_cast<size_t>(options_.min_num_inliers)) {
+    output.two_view_geometry = TwoViewGeometry();
+  }
+
+  cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
+  cache_->WriteTwoViewGeometry(output.image_id1, output.image_id2,
+                               output.two_view_geometry);
+
+  pending_image_pair_ids_.erase(
+      Database::ImagePairToPairId(output.image_id1, output.image_id2));
+
+  static MetricCounter& num_image_pairs = GetMetricCounter(
+      "matching_image_pairs_total", "Number of matched image pairs");
+  static MetricCounter& num_verified_image_pairs =
+      GetMetricCounter("matching_verified_image_pairs_total",
+                       "Number of image pairs with verified geometry");
+  num_image_pairs.Increment();
+  if (!output.two_view_geometry.inlier_matches.empty()) {
+    num_verified_image_pairs.Increment();
+  }
+
+  writer_stats_.Add(timer.ElapsedSeconds(), starved_seconds, 0);
+}
+
+void SiftFeatureMatcher::RecordMetrics() {
+  size_t matcher_queue_size = matcher_queue_.Size();
+  for (auto& gpu_matcher_queue : gpu_matcher_queues_) {
+    matcher_queue_size += gpu_matcher_queue->Size();
+  }
+  GetMetricGauge("matching_matcher_queue_size",
+                 "Number of image pairs waiting for matching")
+      .Set(matcher_queue_size);
+  GetMetricGauge("matching_verifier_queue_size",
+                 "Number of image pairs waiting for verification")
+      .Set(verifier_queue_.Size());
+  GetMetricGauge("matching_guided_matcher_queue_size",
+                 "Number of image pairs waiting for guided matching")
+      .Set(guided_matcher_queue_.Size());
+  GetMetricGauge("matching_output_queue_size",
+                 "Number of image pairs waiting to be written")
+      .Set(output_queue_.Size());
+  GetMetricGauge("matching_pending_image_pairs",
+                 "Number of image pairs in the pipeline")
+      .Set(pending_image_pair_ids_.size());
+  cache_->RecordMetrics();
 }
 
 ExhaustiveFeatureMatcher::ExhaustiveFeatureMatcher(
@@ -889,8 +2499,10 @@ ExhaustiveFeatureMatcher::ExhaustiveFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(5 * options_.block_size, &database_),
-      matcher_(match_options, &database_, &cache_) {
+      cache_(5 * options_.block_size, &database_,
+             match_options.feature_store_path),
+      matcher_(match_options, &database_, &cache_),
+      rig_pair_filter_(GetRigPairFilterOptions(options_)) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
 }
@@ -904,9 +2516,41 @@ void ExhaustiveFeatureMatcher::Run() {
 
   cache_.Setup();
 
-  const std::vector<image_t> image_ids = cache_.GetImageIds();
+  SetupRigPairFilter(options_.rig_config_path, cache_, &rig_pair_filter_);
+
+  // The images of the rows and columns of the blocks. With new images, the
+  // rows are the new images and, for new-vs-all matching, the columns are
+  // all images, such that only the pairs of the new images are generated.
+  std::vector<image_t> image_ids = cache_.GetImageIds();
+  std::vector<image_t> new_image_ids;
+  std::unordered_set<image_t> new_image_id_set;
+  if (!options_.new_image_list_path.empty()) {
+    new_image_ids =
+        ReadImageIdsFromList(options_.new_image_list_path, cache_);
+    new_image_id_set.insert(new_image_ids.begin(), new_image_ids.end());
+    std::cout << StringPrintf("Matching %d new images", new_image_ids.size())
+              << std::endl;
+    if (options_.new_vs_new) {
+      image_ids = new_image_ids;
+    }
+  }
+
+  if (!options_.skip_image_list_path.empty()) {
+    RemoveImageIdsInList(options_.skip_image_list_path, cache_, &image_ids);
+    if (!new_image_ids.empty()) {
+      RemoveImageIdsInList(options_.skip_image_list_path, cache_,
+                           &new_image_ids);
+    }
+  }
+
+  const bool new_vs_all =
+      !options_.new_image_list_path.empty() && !options_.new_vs_new;
+  const std::vector<image_t>& row_image_ids =
+      new_vs_all ? new_image_ids : image_ids;
 
   const size_t block_size = static_cast<size_t>(options_.block_size);
+  const size_t num_row_blocks = static_cast<size_t>(
+      std::ceil(static_cast<double>(row_image_ids.size()) / block_size));
   const size_t num_blocks = static_cast<size_t>(
       std::ceil(static_cast<double>(image_ids.size()) / block_size));
   const size_t num_pairs_per_block = block_size * (block_size - 1) / 2;
@@ -914,10 +2558,10 @@ void ExhaustiveFeatureMatcher::Run() {
   std::vector<std::pair<image_t, image_t>> image_pairs;
   image_pairs.reserve(num_pairs_per_block);
 
-  for (size_t start_idx1 = 0; start_idx1 < image_ids.size();
+  for (size_t start_idx1 = 0; start_idx1 < row_image_ids.size();
        start_idx1 += block_size) {
     const size_t end_idx1 =
-        std::min(image_ids.size(), start_idx1 + block_size) - 1;
+        std::min(row_image_ids.size(), start_idx1 + block_size) - 1;
     for (size_t start_idx2 = 0; start_idx2 < image_ids.size();
          start_idx2 += block_size) {
       const size_t end_idx2 =
@@ -932,13 +2576,25 @@ void ExhaustiveFeatureMatcher::Run() {
       timer.Start();
 
       std::cout << StringPrintf("Matching block [%d/%d, %d/%d]",
-                                start_idx1 / block_size + 1, num_blocks,
+                                start_idx1 / block_size + 1, num_row_blocks,
                                 start_idx2 / block_size + 1, num_blocks)
                 << std::flush;
 
       image_pairs.clear();
       for (size_t idx1 = start_idx1; idx1 <= end_idx1; ++idx1) {
         for (size_t idx2 = start_idx2; idx2 <= end_idx2; ++idx2) {
+          if (new_vs_all) {
+            // Pairs of two new images appear in both orders, keep one.
+            const image_t image_id1 = row_image_ids[idx1];
+            const image_t image_id2 = image_ids[idx2];
+            if (image_id1 != image_id2 &&
+                (new_image_id_set.count(image_id2) == 0 ||
+                 image_id1 < image_id2)) {
+              image_pairs.emplace_back(image_id1, image_id2);
+            }
+            continue;
+          }
+
           const size_t block_id1 = idx1 % block_size;
           const size_t block_id2 = idx2 % block_size;
           if ((idx1 > idx2 && block_id1 <= block_id2) ||
@@ -949,6 +2605,8 @@ void ExhaustiveFeatureMatcher::Run() {
         }
       }
 
+      rig_pair_filter_.Filter(&image_pairs);
+
       DatabaseTransaction database_transaction(&database_);
       matcher_.Match(image_pairs);
 
@@ -956,6 +2614,8 @@ void ExhaustiveFeatureMatcher::Run() {
     }
   }
 
+  FlushMatcher(&database_, &matcher_);
+
   GetTimer().PrintMinutes();
 }
 
@@ -967,8 +2627,9 @@ SequentialFeatureMatcher::SequentialFeatureMatcher(
       database_(database_path),
       cache_(std::max(5 * options_.loop_detection_num_images,
                       5 * options_.overlap),
-             &database_),
-      matcher_(match_options, &database_, &cache_) {
+             &database_, match_options.feature_store_path),
+      matcher_(match_options, &database_, &cache_),
+      rig_pair_filter_(GetRigPairFilterOptions(options_)) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
 }
@@ -982,18 +2643,22 @@ void SequentialFeatureMatcher::Run() {
 
   cache_.Setup();
 
+  SetupRigPairFilter(options_.rig_config_path, cache_, &rig_pair_filter_);
+
   const std::vector<image_t> ordered_image_ids = GetOrderedImageIds();
 
   RunSequentialMatching(ordered_image_ids);
-  if (options_.loop_detection) {
-    RunLoopDetection(ordered_image_ids);
-  }
+
+  FlushMatcher(&database_, &matcher_);
 
   GetTimer().PrintMinutes();
 }
 
 std::vector<image_t> SequentialFeatureMatcher::GetOrderedImageIds() const {
-  const std::vector<image_t> image_ids = cache_.GetImageIds();
+  std::vector<image_t> image_ids = cache_.GetImageIds();
+  if (!options_.skip_image_list_path.empty()) {
+    RemoveImageIdsInList(options_.skip_image_list_path, cache_, &image_ids);
+  }
 
   std::vector<Image> ordered_images;
   ordered_images.reserve(image_ids.size());
@@ -1017,6 +2682,17 @@ std::vector<image_t> SequentialFeatureMatcher::GetOrderedImageIds() const {
 
 void SequentialFeatureMatcher::RunSequentialMatching(
     const std::vector<image_t>& image_ids) {
+  std::unique_ptr<SequentialKeyframeSelector> keyframe_selector;
+  std::unique_ptr<SequentialLoopDetector> loop_detector;
+  if (options_.loop_detection) {
+    keyframe_selector.reset(
+        new SequentialKeyframeSelector(options_, image_ids, &cache_));
+    loop_detector.reset(new SequentialLoopDetector(
+        options_, match_options_.num_threads, &cache_));
+  }
+
+  size_t num_keyframes = 0;
+
   std::vector<std::pair<image_t, image_t>> image_pairs;
   image_pairs.reserve(options_.overlap);
 
@@ -1051,43 +2727,54 @@ void SequentialFeatureMatcher::RunSequentialMatching(
       }
     }
 
+    rig_pair_filter_.Filter(&image_pairs);
+
     DatabaseTransaction database_transaction(&database_);
     matcher_.Match(image_pairs);
 
+    // The loop detections are matched interleaved with the sequence.
+    if (loop_detector) {
+      const std::vector<image_t> keyframe_ids =
+          keyframe_selector->Select(image_idx1, /*force=*/false);
+      num_keyframes += keyframe_ids.size();
+      loop_detector->AddKeyframes(keyframe_ids);
+      std::vector<std::pair<image_t, image_t>> loop_image_pairs =
+          loop_detector->PopImagePairs();
+      rig_pair_filter_.Filter(&loop_image_pairs);
+      matcher_.Match(loop_image_pairs);
+    }
+
     PrintElapsedTime(timer);
   }
-}
-
-void SequentialFeatureMatcher::RunLoopDetection(
-    const std::vector<image_t>& image_ids) {
-  // Read the pre-trained vocabulary tree from disk.
-  retrieval::VisualIndex<> visual_index;
-  visual_index.Read(options_.vocab_tree_path);
-
-  // Index all images in the visual index.
-  IndexImagesInVisualIndex(match_options_.num_threads,
-                           options_.loop_detection_num_checks,
-                           options_.loop_detection_max_num_features, image_ids,
-                           this, &cache_, &visual_index);
 
-  if (IsStopped()) {
+  if (!loop_detector) {
     return;
   }
 
-  // Only perform loop detection for every n-th image.
-  std::vector<image_t> match_image_ids;
-  for (size_t i = 0; i < image_ids.size();
-       i += options_.loop_detection_period) {
-    match_image_ids.push_back(image_ids[i]);
+  Timer timer;
+  timer.Start();
+
+  std::cout << "Loop detection" << std::flush;
+
+  DatabaseTransaction database_transaction(&database_);
+
+  // The remaining keyframes depend on the verification of the last images.
+  if (options_.loop_detection_keyframe_overlap > 0) {
+    matcher_.Flush();
   }
 
-  MatchNearestNeighborsInVisualIndex(
-      match_options_.num_threads, options_.loop_detection_num_images,
-      options_.loop_detection_num_nearest_neighbors,
-      options_.loop_detection_num_checks,
-      options_.loop_detection_num_images_after_verification,
-      options_.loop_detection_max_num_features, match_image_ids, this, &cache_,
-      &visual_index, &matcher_);
+  const std::vector<image_t> keyframe_ids =
+      keyframe_selector->Select(image_ids.size(), /*force=*/true);
+  num_keyframes += keyframe_ids.size();
+  loop_detector->AddKeyframes(keyframe_ids);
+  loop_detector->Finish();
+  std::vector<std::pair<image_t, image_t>> loop_image_pairs =
+      loop_detector->PopImagePairs();
+  rig_pair_filter_.Filter(&loop_image_pairs);
+  matcher_.Match(loop_image_pairs);
+
+  std::cout << StringPrintf(" for %d keyframes", num_keyframes);
+  PrintElapsedTime(timer);
 }
 
 VocabTreeFeatureMatcher::VocabTreeFeatureMatcher(
@@ -1096,7 +2783,8 @@ VocabTreeFeatureMatcher::VocabTreeFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(5 * options_.num_images, &database_),
+      cache_(5 * options_.num_images, &database_,
+             match_options.feature_store_path),
       matcher_(match_options, &database_, &cache_) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
@@ -1111,45 +2799,86 @@ void VocabTreeFeatureMatcher::Run() {
 
   cache_.Setup();
 
-  // Read the pre-trained vocabulary tree from disk.
+  if (options_.use_global_descriptors) {
+    std::vector<image_t> image_ids = cache_.GetImageIds();
+    std::unordered_set<image_t> match_image_ids;
+    if (!options_.new_image_list_path.empty()) {
+      image_ids = ReadImageIdsFromList(options_.new_image_list_path, cache_);
+      std::cout << StringPrintf("Matching %d new images", image_ids.size())
+                << std::endl;
+      if (options_.new_vs_new) {
+        match_image_ids.insert(image_ids.begin(), image_ids.end());
+      }
+    } else if (!options_.match_list_path.empty()) {
+      image_ids = ReadImageIdsFromList(options_.match_list_path, cache_);
+    }
+
+    MatchNearestNeighborsByGlobalDescriptors(
+        match_options_.num_threads, options_.num_images, image_ids,
+        match_image_ids, this, &database_, &matcher_);
+
+    FlushMatcher(&database_, &matcher_);
+
+    GetTimer().PrintMinutes();
+    return;
+  }
+
+  // Read the pre-trained vocabulary tree from disk or, if it exists, the
+  // previously populated visual index that is extended with the new images.
+  const bool use_persistent_index =
+      !options_.vocab_tree_index_path.empty() &&
+      ExistsFile(options_.vocab_tree_index_path);
   retrieval::VisualIndex<> visual_index;
-  visual_index.Read(options_.vocab_tree_path);
+  if (use_persistent_index) {
+    visual_index.Read(options_.vocab_tree_index_path);
+  } else {
+    visual_index.Read(options_.vocab_tree_path);
+  }
 
   const std::vector<image_t> all_image_ids = cache_.GetImageIds();
-  std::vector<image_t> image_ids;
-  if (options_.match_list_path == "") {
-    image_ids = cache_.GetImageIds();
-  } else {
-    // Map image names to image identifiers.
-    std::unordered_map<std::string, image_t> image_name_to_image_id;
-    image_name_to_image_id.reserve(all_image_ids.size());
-    for (const auto image_id : all_image_ids) {
-      const auto& image = cache_.GetImage(image_id);
-      image_name_to_image_id.emplace(image.Name(), image_id);
-    }
 
-    // Read the match list path.
-    std::ifstream file(options_.match_list_path);
-    CHECK(file.is_open()) << options_.match_list_path;
-    std::string line;
-    while (std::getline(file, line)) {
-      StringTrim(&line);
+  std::vector<image_t> new_image_ids;
+  new_image_ids.reserve(all_image_ids.size());
+  for (const auto image_id : all_image_ids) {
+    if (!visual_index.ImageIndexed(image_id)) {
+      new_image_ids.push_back(image_id);
+    }
+  }
 
-      if (line.empty() || line[0] == '#') {
-        continue;
-      }
+  if (use_persistent_index) {
+    std::cout << StringPrintf("Extending visual index with %d new images",
+                              new_image_ids.size())
+              << std::endl;
+  }
 
-      if (image_name_to_image_id.count(line) == 0) {
-        std::cerr << "ERROR: Image " << line << " does not exist." << std::endl;
-      } else {
-        image_ids.push_back(image_name_to_image_id.at(line));
+  // The query images and, for new-vs-new matching, the retrieved images that
+  // are matched.
+  std::vector<image_t> image_ids;
+  std::unordered_set<image_t> match_image_ids;
+  if (!options_.new_image_list_path.empty()) {
+    image_ids = ReadImageIdsFromList(options_.new_image_list_path, cache_);
+    std::cout << StringPrintf("Matching %d new images", image_ids.size())
+              << std::endl;
+    if (options_.new_vs_new) {
+      match_image_ids.insert(image_ids.begin(), image_ids.end());
+      // Without a persisted index, it suffices to index the new images, such
+      // that they are only retrieved among each other.
+      if (options_.vocab_tree_index_path.empty()) {
+        new_image_ids = image_ids;
       }
     }
+  } else if (options_.match_list_path == "") {
+    // The previously indexed images were already matched against each other,
+    // so it suffices to match the new images against all images.
+    image_ids = use_persistent_index ? new_image_ids : all_image_ids;
+  } else {
+    image_ids = ReadImageIdsFromList(options_.match_list_path, cache_);
   }
 
   // Index all images in the visual index.
   IndexImagesInVisualIndex(match_options_.num_threads, options_.num_checks,
-                           options_.max_num_features, all_image_ids, this,
+                           options_.exhaustive_quantization,
+                           options_.max_num_features, new_image_ids, this,
                            &cache_, &visual_index);
 
   if (IsStopped()) {
@@ -1161,8 +2890,18 @@ void VocabTreeFeatureMatcher::Run() {
   MatchNearestNeighborsInVisualIndex(
       match_options_.num_threads, options_.num_images,
       options_.num_nearest_neighbors, options_.num_checks,
-      options_.num_images_after_verification, options_.max_num_features,
-      image_ids, this, &cache_, &visual_index, &matcher_);
+      options_.exhaustive_quantization, options_.num_images_after_verification,
+      options_.max_verification_time, options_.max_inverted_file_size,
+      options_.max_num_scored_entries, options_.max_num_features, image_ids,
+      match_image_ids, this, &cache_, &visual_index, &matcher_);
+
+  FlushMatcher(&database_, &matcher_);
+
+  // Only persist the index once the new images are matched, such that an
+  // interrupted run indexes and matches them again in the next run.
+  if (!options_.vocab_tree_index_path.empty() && !IsStopped()) {
+    visual_index.WriteMapped(options_.vocab_tree_index_path);
+  }
 
   GetTimer().PrintMinutes();
 }
@@ -1173,7 +2912,8 @@ SpatialFeatureMatcher::SpatialFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(5 * options_.max_num_neighbors, &database_),
+      cache_(5 * options_.max_num_neighbors, &database_,
+             match_options.feature_store_path),
       matcher_(match_options, &database_, &cache_) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
@@ -1188,7 +2928,23 @@ void SpatialFeatureMatcher::Run() {
 
   cache_.Setup();
 
-  const std::vector<image_t> image_ids = cache_.GetImageIds();
+  std::vector<image_t> image_ids = cache_.GetImageIds();
+
+  // With new images, only the new images are queried and, for new-vs-new
+  // matching, only the new images are indexed.
+  const bool match_new_images = !options_.new_image_list_path.empty();
+  std::unordered_set<image_t> new_image_ids;
+  if (match_new_images) {
+    std::vector<image_t> new_image_id_list =
+        ReadImageIdsFromList(options_.new_image_list_path, cache_);
+    std::cout << StringPrintf("Matching %d new images",
+                              new_image_id_list.size())
+              << std::endl;
+    new_image_ids.insert(new_image_id_list.begin(), new_image_id_list.end());
+    if (options_.new_vs_new) {
+      image_ids = std::move(new_image_id_list);
+    }
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Spatial indexing
@@ -1199,8 +2955,6 @@ void SpatialFeatureMatcher::Run() {
 
   std::cout << "Indexing images..." << std::flush;
 
-  GPSTransform gps_transform;
-
   size_t num_locations = 0;
   Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
       image_ids.size(), 3);
@@ -1208,7 +2962,10 @@ void SpatialFeatureMatcher::Run() {
   std::vector<size_t> location_idxs;
   location_idxs.reserve(image_ids.size());
 
-  std::vector<Eigen::Vector3d> ells(1);
+  std::vector<Eigen::Vector3d> ells;
+  if (options_.is_gps) {
+    ells.reserve(image_ids.size());
+  }
 
   for (size_t i = 0; i < image_ids.size(); ++i) {
     const auto image_id = image_ids[i];
@@ -1224,15 +2981,8 @@ void SpatialFeatureMatcher::Run() {
     location_idxs.push_back(i);
 
     if (options_.is_gps) {
-      ells[0](0) = image.TvecPrior(0);
-      ells[0](1) = image.TvecPrior(1);
-      ells[0](2) = options_.ignore_z ? 0 : image.TvecPrior(2);
-
-      const auto xyzs = gps_transform.EllToXYZ(ells);
-
-      location_matrix(num_locations, 0) = static_cast<float>(xyzs[0](0));
-      location_matrix(num_locations, 1) = static_cast<float>(xyzs[0](1));
-      location_matrix(num_locations, 2) = static_cast<float>(xyzs[0](2));
+      ells.emplace_back(image.TvecPrior(0), image.TvecPrior(1),
+                        options_.ignore_z ? 0 : image.TvecPrior(2));
     } else {
       location_matrix(num_locations, 0) =
           static_cast<float>(image.TvecPrior(0));
@@ -1245,6 +2995,20 @@ void SpatialFeatureMatcher::Run() {
     num_locations += 1;
   }
 
+  if (options_.is_gps && num_locations > 0) {
+    GPSTransform gps_transform;
+    // Earth-centered coordinates are in the order of 1e6 meters, such that
+    // their single precision representation has an accuracy in the order of
+    // decimeters. A local frame centered at the first location avoids this.
+    const std::vector<Eigen::Vector3d> xyzs =
+        options_.use_enu
+            ? gps_transform.EllToENU(ells, ells[0](0), ells[0](1))
+            : gps_transform.EllToXYZ(ells);
+    for (size_t i = 0; i < num_locations; ++i) {
+      location_matrix.row(i) = xyzs[i].cast<float>();
+    }
+  }
+
   PrintElapsedTime(timer);
 
   if (num_locations == 0) {
@@ -1264,9 +3028,10 @@ void SpatialFeatureMatcher::Run() {
   flann::Matrix<float> locations(location_matrix.data(), num_locations,
                                  location_matrix.cols());
 
-  flann::LinearIndexParams index_params;
-  flann::LinearIndex<flann::L2<float>> search_index(index_params);
-  search_index.buildIndex(locations);
+  flann::KDTreeSingleIndexParams index_params;
+  flann::KDTreeSingleIndex<flann::L2<float>> search_index(locations,
+                                                          index_params);
+  search_index.buildIndex();
 
   PrintElapsedTime(timer);
 
@@ -1278,27 +3043,35 @@ void SpatialFeatureMatcher::Run() {
 
   std::cout << "Searching for nearest neighbors..." << std::flush;
 
-  const int knn = std::min<int>(options_.max_num_neighbors, num_locations);
-
-  Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      index_matrix(num_locations, knn);
-  flann::Matrix<size_t> indices(index_matrix.data(), num_locations, knn);
-
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distance_matrix(num_locations, knn);
-  flann::Matrix<float> distances(distance_matrix.data(), num_locations, knn);
-
-  flann::SearchParams search_params(flann::FLANN_CHECKS_AUTOTUNED);
-  if (match_options_.num_threads == ThreadPool::kMaxNumThreads) {
-    search_params.cores = std::thread::hardware_concurrency();
-  } else {
-    search_params.cores = match_options_.num_threads;
-  }
-  if (search_params.cores <= 0) {
-    search_params.cores = 1;
-  }
-
-  search_index.knnSearch(locations, indices, distances, knn, search_params);
+  // The query itself is always among its nearest neighbors.
+  const int knn = std::min<int>(options_.max_num_neighbors + 1, num_locations);
+
+  // Exact radius search, which only returns the up to `knn` nearest neighbors
+  // within the maximum distance. Note that FLANN uses squared distances.
+  flann::SearchParams search_params;
+  search_params.max_neighbors = knn;
+  search_params.sorted = true;
+  search_params.cores = 1;
+
+  const float max_distance = std::nextafter(
+      static_cast<float>(options_.max_distance * options_.max_distance),
+      std::numeric_limits<float>::max());
+
+  std::vector<std::vector<size_t>> neighbor_idxs(num_locations);
+
+  ThreadPool thread_pool(match_options_.num_threads);
+  thread_pool.ParallelFor(
+      0, num_locations, [&](const size_t begin, const size_t end) {
+        flann::Matrix<float> queries(location_matrix.row(begin).data(),
+                                     end - begin, location_matrix.cols());
+        std::vector<std::vector<size_t>> indices;
+        std::vector<std::vector<float>> distances;
+        search_index.radiusSearch(queries, indices, distances, max_distance,
+                                  search_params);
+        for (size_t i = begin; i < end; ++i) {
+          neighbor_idxs[i] = std::move(indices[i - begin]);
+        }
+      });
 
   PrintElapsedTime(timer);
 
@@ -1306,9 +3079,6 @@ void SpatialFeatureMatcher::Run() {
   // Matching
   //////////////////////////////////////////////////////////////////////////////
 
-  const float max_distance =
-      static_cast<float>(options_.max_distance * options_.max_distance);
-
   std::vector<std::pair<image_t, image_t>> image_pairs;
   image_pairs.reserve(knn);
 
@@ -1318,6 +3088,13 @@ void SpatialFeatureMatcher::Run() {
       return;
     }
 
+    const size_t idx = location_idxs[i];
+    const image_t image_id = image_ids.at(idx);
+
+    if (match_new_images && new_image_ids.count(image_id) == 0) {
+      continue;
+    }
+
     timer.Restart();
 
     std::cout << StringPrintf("Matching image [%d/%d]", i + 1, num_locations)
@@ -1325,20 +3102,18 @@ void SpatialFeatureMatcher::Run() {
 
     image_pairs.clear();
 
-    for (int j = 0; j < knn; ++j) {
+    for (const size_t nn_location_idx : neighbor_idxs[i]) {
       // Check if query equals result.
-      if (index_matrix(i, j) == i) {
+      if (nn_location_idx == i) {
         continue;
       }
 
-      // Since the nearest neighbors are sorted by distance, we can break.
-      if (distance_matrix(i, j) > max_distance) {
+      if (image_pairs.size() >=
+          static_cast<size_t>(options_.max_num_neighbors)) {
         break;
       }
 
-      const size_t idx = location_idxs[i];
-      const image_t image_id = image_ids.at(idx);
-      const size_t nn_idx = location_idxs.at(index_matrix(i, j));
+      const size_t nn_idx = location_idxs.at(nn_location_idx);
       const image_t nn_image_id = image_ids.at(nn_idx);
       image_pairs.emplace_back(image_id, nn_image_id);
     }
@@ -1349,6 +3124,8 @@ void SpatialFeatureMatcher::Run() {
     PrintElapsedTime(timer);
   }
 
+  FlushMatcher(&database_, &matcher_);
+
   GetTimer().PrintMinutes();
 }
 
@@ -1358,7 +3135,7 @@ TransitiveFeatureMatcher::TransitiveFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(options_.batch_size, &database_),
+      cache_(options_.batch_size, &database_, match_options.feature_store_path),
       matcher_(match_options, &database_, &cache_) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
@@ -1373,10 +3150,21 @@ void TransitiveFeatureMatcher::Run() {
 
   cache_.Setup();
 
-  const std::vector<image_t> image_ids = cache_.GetImageIds();
+  // The match graph is read once and then extended in memory by the image
+  // pairs verified in every iteration.
+  TransitiveMatchGraph graph(cache_.GetImageIds());
+  for (const image_pair_t pair_id : database_.ReadVerifiedImagePairIds()) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(pair_id, &image_id1, &image_id2);
+    graph.AddImagePair(image_id1, image_id2,
+                       cache_.GetNumInlierMatches(image_id1, image_id2));
+  }
+  graph.Build();
+
+  const size_t batch_size = static_cast<size_t>(options_.batch_size);
 
   std::vector<std::pair<image_t, image_t>> image_pairs;
-  std::unordered_set<image_pair_t> image_pair_ids;
 
   for (int iteration = 0; iteration < options_.num_iterations; ++iteration) {
     if (IsStopped()) {
@@ -1391,62 +3179,52 @@ void TransitiveFeatureMatcher::Run() {
                               options_.num_iterations)
               << std::endl;
 
-    std::vector<std::pair<image_t, image_t>> existing_image_pairs;
-    std::vector<int> existing_num_inliers;
-    database_.ReadTwoViewGeometryNumInliers(&existing_image_pairs,
-                                            &existing_num_inliers);
+    const std::vector<std::pair<image_t, image_t>> candidate_image_pairs =
+        graph.FindImagePairs(options_.max_num_candidates,
+                             match_options_.num_threads);
 
-    CHECK_EQ(existing_image_pairs.size(), existing_num_inliers.size());
+    size_t num_batches = 0;
+    for (size_t begin = 0; begin < candidate_image_pairs.size();
+         begin += batch_size) {
+      const size_t end =
+          std::min(begin + batch_size, candidate_image_pairs.size());
+      image_pairs.assign(candidate_image_pairs.begin() + begin,
+                         candidate_image_pairs.begin() + end);
+
+      num_batches += 1;
+      std::cout << StringPrintf("  Batch %d", num_batches) << std::flush;
+      DatabaseTransaction database_transaction(&database_);
+      matcher_.Match(image_pairs);
+      if (end == candidate_image_pairs.size()) {
+        // The next iteration depends on all results of this iteration.
+        matcher_.Flush();
+      }
+      PrintElapsedTime(timer);
+      timer.Restart();
 
-    std::unordered_map<image_t, std::vector<image_t>> adjacency;
-    for (const auto& image_pair : existing_image_pairs) {
-      adjacency[image_pair.first].push_back(image_pair.second);
-      adjacency[image_pair.second].push_back(image_pair.first);
+      if (IsStopped()) {
+        GetTimer().PrintMinutes();
+        return;
+      }
     }
 
-    const size_t batch_size = static_cast<size_t>(options_.batch_size);
+    if (candidate_image_pairs.empty()) {
+      std::cout << "  No new image pairs" << std::endl;
+      break;
+    }
 
-    size_t num_batches = 0;
-    image_pairs.clear();
-    image_pair_ids.clear();
-    for (const auto& image : adjacency) {
-      const auto image_id1 = image.first;
-      for (const auto& image_id2 : image.second) {
-        if (adjacency.count(image_id2) > 0) {
-          for (const auto& image_id3 : adjacency.at(image_id2)) {
-            const auto image_pair_id =
-                Database::ImagePairToPairId(image_id1, image_id3);
-            if (image_pair_ids.count(image_pair_id) == 0) {
-              image_pairs.emplace_back(image_id1, image_id3);
-              image_pair_ids.insert(image_pair_id);
-              if (image_pairs.size() >= batch_size) {
-                num_batches += 1;
-                std::cout << StringPrintf("  Batch %d", num_batches)
-                          << std::flush;
-                DatabaseTransaction database_transaction(&database_);
-                matcher_.Match(image_pairs);
-                image_pairs.clear();
-                PrintElapsedTime(timer);
-                timer.Restart();
-
-                if (IsStopped()) {
-                  GetTimer().PrintMinutes();
-                  return;
-                }
-              }
-            }
-          }
-        }
+    for (const auto& image_pair : candidate_image_pairs) {
+      if (cache_.ExistsInlierMatches(image_pair.first, image_pair.second)) {
+        graph.AddImagePair(
+            image_pair.first, image_pair.second,
+            cache_.GetNumInlierMatches(image_pair.first, image_pair.second));
       }
     }
-
-    num_batches += 1;
-    std::cout << StringPrintf("  Batch %d", num_batches) << std::flush;
-    DatabaseTransaction database_transaction(&database_);
-    matcher_.Match(image_pairs);
-    PrintElapsedTime(timer);
+    graph.Build();
   }
 
+  FlushMatcher(&database_, &matcher_);
+
   GetTimer().PrintMinutes();
 }
 
@@ -1456,7 +3234,7 @@ ImagePairsFeatureMatcher::ImagePairsFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(options.block_size, &database_),
+      cache_(options.block_size, &database_, match_options.feature_store_path),
       matcher_(match_options, &database_, &cache_) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
@@ -1471,96 +3249,13 @@ void ImagePairsFeatureMatcher::Run() {
 
   cache_.Setup();
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Reading image pairs list
-  //////////////////////////////////////////////////////////////////////////////
-
-  std::unordered_map<std::string, image_t> image_name_to_image_id;
-  image_name_to_image_id.reserve(cache_.GetImageIds().size());
-  for (const auto image_id : cache_.GetImageIds()) {
-    const auto& image = cache_.GetImage(image_id);
-    image_name_to_image_id.emplace(image.Name(), image_id);
-  }
-
   std::ifstream file(options_.match_list_path);
   CHECK(file.is_open()) << options_.match_list_path;
 
-  std::string line;
-  std::vector<std::pair<image_t, image_t>> image_pairs;
-  std::unordered_set<colmap::image_pair_t> image_pairs_set;
-  while (std::getline(file, line)) {
-    StringTrim(&line);
-
-    if (line.empty() || line[0] == '#') {
-      continue;
-    }
-
-    std::stringstream line_stream(line);
+  MatchImagePairsList(&file, options_.block_size, this, &database_, &cache_,
+                      &matcher_);
 
-    std::string image_name1;
-    std::string image_name2;
-
-    std::getline(line_stream, image_name1, ' ');
-    StringTrim(&image_name1);
-    std::getline(line_stream, image_name2, ' ');
-    StringTrim(&image_name2);
-
-    if (image_name_to_image_id.count(image_name1) == 0) {
-      std::cerr << "ERROR: Image " << image_name1 << " does not exist."
-                << std::endl;
-      continue;
-    }
-    if (image_name_to_image_id.count(image_name2) == 0) {
-      std::cerr << "ERROR: Image " << image_name2 << " does not exist."
-                << std::endl;
-      continue;
-    }
-
-    const image_t image_id1 = image_name_to_image_id.at(image_name1);
-    const image_t image_id2 = image_name_to_image_id.at(image_name2);
-    const image_pair_t image_pair =
-        Database::ImagePairToPairId(image_id1, image_id2);
-    const bool image_pair_exists = image_pairs_set.insert(image_pair).second;
-    if (image_pair_exists) {
-      image_pairs.emplace_back(image_id1, image_id2);
-    }
-  }
-
-  //////////////////////////////////////////////////////////////////////////////
-  // Feature matching
-  //////////////////////////////////////////////////////////////////////////////
-
-  const size_t num_match_blocks = image_pairs.size() / options_.block_size + 1;
-  std::vector<std::pair<image_t, image_t>> block_image_pairs;
-  block_image_pairs.reserve(options_.block_size);
-
-  for (size_t i = 0; i < image_pairs.size(); i += options_.block_size) {
-    if (IsStopped()) {
-      GetTimer().PrintMinutes();
-      return;
-    }
-
-    Timer timer;
-    timer.Start();
-
-    std::cout << StringPrintf("Matching block [%d/%d]",
-                              i / options_.block_size + 1, num_match_blocks)
-              << std::flush;
-
-    const size_t block_end = i + options_.block_size <= image_pairs.size()
-                                 ? i + options_.block_size
-                                 : image_pairs.size();
-    std::vector<std::pair<image_t, image_t>> block_image_pairs;
-    block_image_pairs.reserve(options_.block_size);
-    for (size_t j = i; j < block_end; ++j) {
-      block_image_pairs.push_back(image_pairs[j]);
-    }
-
-    DatabaseTransaction database_transaction(&database_);
-    matcher_.Match(block_image_pairs);
-
-    PrintElapsedTime(timer);
-  }
+  FlushMatcher(&database_, &matcher_);
 
   GetTimer().PrintMinutes();
 }
@@ -1571,7 +3266,7 @@ FeaturePairsFeatureMatcher::FeaturePairsFeatureMatcher(
     : options_(options),
       match_options_(match_options),
       database_(database_path),
-      cache_(kCacheSize, &database_) {
+      cache_(kCacheSize, &database_, match_options.feature_store_path) {
   CHECK(options_.Check());
   CHECK(match_options_.Check());
 }
@@ -1588,34 +3283,95 @@ void FeaturePairsFeatureMatcher::Run() {
     image_name_to_image.emplace(image.Name(), &image);
   }
 
-  std::ifstream file(options_.match_list_path);
-  CHECK(file.is_open()) << options_.match_list_path;
+  TwoViewGeometry::Options two_view_geometry_options;
+  two_view_geometry_options.min_num_inliers =
+      static_cast<size_t>(match_options_.min_num_inliers);
+  two_view_geometry_options.ransac_options.max_error = match_options_.max_error;
+  two_view_geometry_options.ransac_options.confidence =
+      match_options_.confidence;
+  two_view_geometry_options.ransac_options.min_num_trials =
+      static_cast<size_t>(match_options_.min_num_trials);
+  two_view_geometry_options.ransac_options.max_num_trials =
+      static_cast<size_t>(match_options_.max_num_trials);
+  two_view_geometry_options.ransac_options.min_inlier_ratio =
+      match_options_.min_inlier_ratio;
+
+  // The image pairs are read sequentially, verified in parallel, and written
+  // in batches, each in a single transaction. Committing every pair on its own
+  // dominates the import time for large match lists. The next batch is read
+  // while the previous batch is verified.
+  const size_t kBatchSize = 1000;
+
+  ThreadPool thread_pool(match_options_.num_threads);
+  std::vector<internal::FeatureMatcherData> batch;
+  batch.reserve(kBatchSize);
+  std::unordered_set<image_pair_t> batch_pair_ids;
+  std::vector<internal::FeatureMatcherData> pending_batch;
+  std::unordered_set<image_pair_t> pending_batch_pair_ids;
+  std::vector<std::future<void>> pending_batch_futures;
+  size_t num_image_pairs = 0;
+
+  auto VerifyMatches = [&](internal::FeatureMatcherData* data) {
+    const Camera& camera1 =
+        cache_.GetCamera(cache_.GetImage(data->image_id1).CameraId());
+    const Camera& camera2 =
+        cache_.GetCamera(cache_.GetImage(data->image_id2).CameraId());
+    const auto points1 = cache_.GetPoints(data->image_id1);
+    const auto points2 = cache_.GetPoints(data->image_id2);
+    data->two_view_geometry.Estimate(
+        camera1, points1->points, points1->points_normalized, camera2,
+        points2->points, points2->points_normalized, data->matches,
+        two_view_geometry_options);
+  };
 
-  std::string line;
-  while (std::getline(file, line)) {
-    if (IsStopped()) {
-      GetTimer().PrintMinutes();
-      return;
+  auto WritePendingBatch = [&]() {
+    for (auto& future : pending_batch_futures) {
+      future.get();
     }
 
-    StringTrim(&line);
-    if (line.empty()) {
-      continue;
+    DatabaseTransaction database_transaction(&database_);
+    for (const auto& data : pending_batch) {
+      if (options_.verify_matches) {
+        cache_.WriteMatches(data.image_id1, data.image_id2, data.matches);
+      }
+      cache_.WriteTwoViewGeometry(data.image_id1, data.image_id2,
+                                  data.two_view_geometry);
     }
 
-    std::istringstream line_stream(line);
+    num_image_pairs += pending_batch.size();
+    if (!pending_batch.empty()) {
+      std::cout << StringPrintf("Imported %d image pairs", num_image_pairs)
+                << std::endl;
+    }
 
-    std::string image_name1, image_name2;
-    try {
-      line_stream >> image_name1 >> image_name2;
-    } catch (...) {
-      std::cerr << "ERROR: Could not read image pair." << std::endl;
-      break;
+    pending_batch.clear();
+    pending_batch_pair_ids.clear();
+    pending_batch_futures.clear();
+  };
+
+  auto WriteBatch = [&]() {
+    WritePendingBatch();
+
+    pending_batch.swap(batch);
+    pending_batch_pair_ids.swap(batch_pair_ids);
+    if (options_.verify_matches) {
+      pending_batch_futures.reserve(pending_batch.size());
+      for (auto& data : pending_batch) {
+        pending_batch_futures.push_back(
+            thread_pool.AddTask(VerifyMatches, &data));
+      }
     }
+  };
 
-    std::cout << StringPrintf("%s - %s", image_name1.c_str(),
-                              image_name2.c_str())
-              << std::endl;
+  MatchListReader reader(options_.match_list_path);
+
+  std::string image_name1;
+  std::string image_name2;
+  FeatureMatches matches;
+  while (reader.Next(&image_name1, &image_name2, &matches)) {
+    if (IsStopped()) {
+      break;
+    }
 
     if (image_name_to_image.count(image_name1) == 0) {
       std::cout << StringPrintf("SKIP: Image %s not found in database.",
@@ -1633,86 +3389,160 @@ void FeaturePairsFeatureMatcher::Run() {
     const Image& image1 = *image_name_to_image[image_name1];
     const Image& image2 = *image_name_to_image[image_name2];
 
-    bool skip_pair = false;
-    if (database_.ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
-      std::cout << "SKIP: Matches for image pair already exist in database."
+    const image_pair_t pair_id =
+        Database::ImagePairToPairId(image1.ImageId(), image2.ImageId());
+    if (batch_pair_ids.count(pair_id) > 0 ||
+        pending_batch_pair_ids.count(pair_id) > 0 ||
+        cache_.ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
+      std::cout << StringPrintf("SKIP: Matches for image pair %s - %s already "
+                                "exist in database.",
+                                image_name1.c_str(), image_name2.c_str())
                 << std::endl;
-      skip_pair = true;
+      continue;
     }
 
-    FeatureMatches matches;
-    while (std::getline(file, line)) {
-      StringTrim(&line);
+    internal::FeatureMatcherData data;
+    data.image_id1 = image1.ImageId();
+    data.image_id2 = image2.ImageId();
 
-      if (line.empty()) {
-        break;
+    if (options_.verify_matches) {
+      data.matches = std::move(matches);
+    } else {
+      const Camera& camera1 = cache_.GetCamera(image1.CameraId());
+      const Camera& camera2 = cache_.GetCamera(image2.CameraId());
+      if (camera1.HasPriorFocalLength() && camera2.HasPriorFocalLength()) {
+        data.two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+      } else {
+        data.two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
       }
+      data.two_view_geometry.inlier_matches = std::move(matches);
+    }
 
-      std::istringstream line_stream(line);
+    batch_pair_ids.insert(pair_id);
+    batch.push_back(std::move(data));
+    if (batch.size() >= kBatchSize) {
+      WriteBatch();
+    }
+  }
 
-      FeatureMatch match;
-      try {
-        line_stream >> match.point2D_idx1 >> match.point2D_idx2;
-      } catch (...) {
-        std::cerr << "ERROR: Cannot read feature matches." << std::endl;
+  WriteBatch();
+  WritePendingBatch();
+
+  GetTimer().PrintMinutes();
+}
+
+FeatureMatchingServer::FeatureMatchingServer(
+    const MatchingServerOptions& options,
+    const SiftMatchingOptions& match_options)
+    : options_(options),
+      match_options_(match_options),
+      cache_(options.cache_size, &database_, match_options.feature_store_path),
+      matcher_(match_options, &database_, &cache_) {
+  CHECK(options_.Check());
+  CHECK(match_options_.Check());
+}
+
+void FeatureMatchingServer::Run() {
+  PrintHeading1("Feature matching server");
+
+  // The matchers are set up once before any database is opened, so that the
+  // maximum number of matches is not limited by the first database.
+  if (!matcher_.Setup()) {
+    return;
+  }
+
+  std::cout << "Waiting for jobs in " << options_.spool_path << std::endl;
+
+  Timer idle_timer;
+  idle_timer.Start();
+
+  while (!IsStopped()) {
+    const std::string job_path = ClaimNextJob();
+
+    if (job_path.empty()) {
+      if (options_.max_idle_time > 0 &&
+          idle_timer.ElapsedSeconds() > options_.max_idle_time) {
+        std::cout << "No new jobs arrived, stopping." << std::endl;
         break;
       }
-
-      matches.push_back(match);
+      std::this_thread::sleep_for(std::chrono::milliseconds(
+          static_cast<int>(1000 * options_.poll_interval)));
+      continue;
     }
 
-    if (skip_pair) {
+    const bool success = ProcessJob(job_path);
+
+    const std::string running_job_path = job_path + ".running";
+    const std::string finished_job_path =
+        job_path + (success ? ".done" : ".failed");
+    CHECK_EQ(std::rename(running_job_path.c_str(), finished_job_path.c_str()),
+             0)
+        << running_job_path;
+
+    idle_timer.Restart();
+  }
+
+  GetTimer().PrintMinutes();
+}
+
+std::string FeatureMatchingServer::ClaimNextJob() const {
+  std::vector<std::string> file_paths = GetFileList(options_.spool_path);
+  std::sort(file_paths.begin(), file_paths.end());
+
+  for (const auto& file_path : file_paths) {
+    if (!HasFileExtension(file_path, ".job")) {
       continue;
     }
 
-    const Camera& camera1 = cache_.GetCamera(image1.CameraId());
-    const Camera& camera2 = cache_.GetCamera(image2.CameraId());
+    // Another server may claim the same job concurrently, in which case only
+    // one of the renames succeeds.
+    const std::string running_job_path = file_path + ".running";
+    if (std::rename(file_path.c_str(), running_job_path.c_str()) == 0) {
+      return file_path;
+    }
+  }
 
-    if (options_.verify_matches) {
-      database_.WriteMatches(image1.ImageId(), image2.ImageId(), matches);
-
-      const auto keypoints1 = cache_.GetKeypoints(image1.ImageId());
-      const auto keypoints2 = cache_.GetKeypoints(image2.ImageId());
-
-      TwoViewGeometry two_view_geometry;
-      TwoViewGeometry::Options two_view_geometry_options;
-      two_view_geometry_options.min_num_inliers =
-          static_cast<size_t>(match_options_.min_num_inliers);
-      two_view_geometry_options.ransac_options.max_error =
-          match_options_.max_error;
-      two_view_geometry_options.ransac_options.confidence =
-          match_options_.confidence;
-      two_view_geometry_options.ransac_options.min_num_trials =
-          static_cast<size_t>(match_options_.min_num_trials);
-      two_view_geometry_options.ransac_options.max_num_trials =
-          static_cast<size_t>(match_options_.max_num_trials);
-      two_view_geometry_options.ransac_options.min_inlier_ratio =
-          match_options_.min_inlier_ratio;
-
-      two_view_geometry.Estimate(
-          camera1, FeatureKeypointsToPointsVector(keypoints1), camera2,
-          FeatureKeypointsToPointsVector(keypoints2), matches,
-          two_view_geometry_options);
-
-      database_.WriteTwoViewGeometry(image1.ImageId(), image2.ImageId(),
-                                     two_view_geometry);
-    } else {
-      TwoViewGeometry two_view_geometry;
+  return "";
+}
 
-      if (camera1.HasPriorFocalLength() && camera2.HasPriorFocalLength()) {
-        two_view_geometry.config = TwoViewGeometry::CALIBRATED;
-      } else {
-        two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
-      }
+bool FeatureMatchingServer::ProcessJob(const std::string& job_path) {
+  PrintHeading1("Processing job " + GetPathBaseName(job_path));
 
-      two_view_geometry.inlier_matches = matches;
+  Timer timer;
+  timer.Start();
 
-      database_.WriteTwoViewGeometry(image1.ImageId(), image2.ImageId(),
-                                     two_view_geometry);
-    }
+  std::ifstream file(job_path + ".running");
+  if (!file.is_open()) {
+    std::cerr << "ERROR: Cannot read job " << job_path << std::endl;
+    return false;
   }
 
-  GetTimer().PrintMinutes();
+  std::string database_path;
+  std::getline(file, database_path);
+  StringTrim(&database_path);
+
+  if (!ExistsFile(database_path)) {
+    std::cerr << "ERROR: Database " << database_path << " does not exist."
+              << std::endl;
+    return false;
+  }
+
+  if (database_path != database_.Path()) {
+    database_.Open(database_path);
+  }
+
+  cache_.Setup();
+
+  const size_t num_image_pairs = MatchImagePairsList(
+      &file, options_.block_size, this, &database_, &cache_, &matcher_);
+
+  FlushMatcher(&database_, &matcher_);
+
+  std::cout << StringPrintf("Matched %d image pairs",
+                            static_cast<int>(num_image_pairs));
+  PrintElapsedTime(timer);
+
+  return !IsStopped();
 }
 
 }  // namespace colmap
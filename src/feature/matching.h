@@ -33,10 +33,17 @@
 #define COLMAP_SRC_FEATURE_MATCHING_H_
 
 #include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "base/database.h"
+#include "base/feature_store.h"
+#include "feature/rig_pair_filter.h"
 #include "feature/sift.h"
 #include "util/alignment.h"
 #include "util/cache.h"
@@ -50,6 +57,29 @@ struct ExhaustiveMatchingOptions {
   // Block size, i.e. number of images to simultaneously load into memory.
   int block_size = 50;
 
+  // Path to a camera rig configuration, see `RigPairFilter`. If given, the
+  // image pairs of the rigs whose views cannot overlap are not matched.
+  std::string rig_config_path = "";
+
+  // Maximum rotation of a rig in degrees between two of its snapshots.
+  double rig_max_rotation = 180.0;
+
+  // Whether to skip all image pairs within the same rig snapshot.
+  bool rig_skip_intra_snapshot_pairs = false;
+
+  // Optional path to a file with the names of new images, one per line, e.g.,
+  // of the images appended to an existing database. If given, only the image
+  // pairs of the new images are generated instead of all image pairs.
+  std::string new_image_list_path = "";
+
+  // Whether to match the new images only against each other (new-vs-new)
+  // instead of against all images (new-vs-all).
+  bool new_vs_new = false;
+
+  // Optional path to a file with the names of images, one per line, which are
+  // not matched, e.g., the redundant images found by `FindRedundantImages`.
+  std::string skip_image_list_path = "";
+
   bool Check() const;
 };
 
@@ -66,6 +96,14 @@ struct SequentialMatchingOptions {
   // Loop detection is invoked every `loop_detection_period` images.
   int loop_detection_period = 10;
 
+  // If positive, loop detection is instead invoked for keyframes, which are
+  // selected once the number of inlier matches between an image and the
+  // previous keyframe falls below this fraction of the inlier matches between
+  // the previous keyframe and its successor, i.e., once most feature tracks of
+  // the previous keyframe ended. This spreads the loop detection evenly over
+  // the scene independent of the camera speed.
+  double loop_detection_keyframe_overlap = 0;
+
   // The number of images to retrieve in loop detection. This number should
   // be significantly bigger than the sequential matching overlap.
   int loop_detection_num_images = 50;
@@ -87,6 +125,20 @@ struct SequentialMatchingOptions {
   // Path to the vocabulary tree.
   std::string vocab_tree_path = "";
 
+  // Path to a camera rig configuration, see `RigPairFilter`. If given, the
+  // image pairs of the rigs whose views cannot overlap are not matched.
+  std::string rig_config_path = "";
+
+  // Maximum rotation of a rig in degrees between two of its snapshots.
+  double rig_max_rotation = 180.0;
+
+  // Whether to skip all image pairs within the same rig snapshot.
+  bool rig_skip_intra_snapshot_pairs = false;
+
+  // Optional path to a file with the names of images, one per line, which are
+  // not matched, e.g., the redundant images found by `FindRedundantImages`.
+  std::string skip_image_list_path = "";
+
   bool Check() const;
 };
 
@@ -104,16 +156,59 @@ struct VocabTreeMatchingOptions {
   // spatial verification.
   int num_images_after_verification = 0;
 
+  // The maximum time in seconds to spend on the spatial verification of each
+  // query image. Images that are ranked too low to be verified within this
+  // time keep their retrieval score. Set to a negative value for no limit.
+  double max_verification_time = -1.0;
+
+  // Visual words whose inverted files have more entries than this are skipped
+  // as stop words in the retrieval. Set to a negative value for no limit.
+  int max_inverted_file_size = -1;
+
+  // The maximum number of inverted file entries to score for each query
+  // image, which bounds the retrieval cost on repetitive scenes independent
+  // of the number of nearest neighbors. Set to a negative value for no limit.
+  int max_num_scored_entries = -1;
+
   // The maximum number of features to use for indexing an image. If an
   // image has more features, only the largest-scale features will be indexed.
   int max_num_features = -1;
 
+  // Whether to assign visual words by exhaustive search over the vocabulary
+  // instead of approximate nearest neighbor search. This is exact but slower
+  // for large vocabularies.
+  bool exhaustive_quantization = false;
+
+  // Whether to retrieve the images by the similarity of their global
+  // descriptors in the database instead of querying the visual index, which
+  // replaces the inverted file traversals with dense matrix products and is
+  // much faster for large datasets. The global descriptors must have been
+  // computed with the `global_descriptor_extractor`. The other retrieval
+  // options and the vocabulary tree are then not used.
+  bool use_global_descriptors = false;
+
   // Path to the vocabulary tree.
   std::string vocab_tree_path = "";
 
+  // Optional path to a persistent visual index. If the file exists, it is
+  // used instead of the vocabulary tree and only the images that are not yet
+  // indexed are added and matched against all images. The updated index is
+  // written back to this path, so that subsequent runs can repeat the process.
+  std::string vocab_tree_index_path = "";
+
   // Optional path to file with specific image names to match.
   std::string match_list_path = "";
 
+  // Optional path to a file with the names of new images, one per line, e.g.,
+  // of the images appended to an existing database. If given, only the image
+  // pairs of the new images are generated instead of all image pairs. The
+  // new images take the place of the images in the match list.
+  std::string new_image_list_path = "";
+
+  // Whether to match the new images only against each other (new-vs-new)
+  // instead of against all images (new-vs-all).
+  bool new_vs_new = false;
+
   bool Check() const;
 };
 
@@ -125,6 +220,11 @@ struct SpatialMatchingOptions {
   // Whether to ignore the Z-component of the location prior.
   bool ignore_z = true;
 
+  // Whether to convert GPS coordinates to a local East-North-Up frame instead
+  // of the Earth-centered frame before the search, which preserves distances
+  // but is numerically more accurate.
+  bool use_enu = true;
+
   // The maximum number of nearest neighbors to match.
   int max_num_neighbors = 50;
 
@@ -132,6 +232,15 @@ struct SpatialMatchingOptions {
   // coordinates the unit is Euclidean distance in meters.
   double max_distance = 100;
 
+  // Optional path to a file with the names of new images, one per line, e.g.,
+  // of the images appended to an existing database. If given, only the image
+  // pairs of the new images are generated instead of all image pairs.
+  std::string new_image_list_path = "";
+
+  // Whether to match the new images only against each other (new-vs-new)
+  // instead of against all images (new-vs-all).
+  bool new_vs_new = false;
+
   bool Check() const;
 };
 
@@ -142,6 +251,11 @@ struct TransitiveMatchingOptions {
   // The number of transitive closure iterations.
   int num_iterations = 3;
 
+  // The maximum number of new image pairs proposed per image and iteration,
+  // which are the pairs with the highest expected number of inlier matches
+  // through their common neighbors. Set to a negative value for no limit.
+  int max_num_candidates = -1;
+
   bool Check() const;
 };
 
@@ -149,7 +263,8 @@ struct ImagePairsMatchingOptions {
   // Number of image pairs to match in one batch.
   int block_size = 1225;
 
-  // Path to the file with the matches.
+  // Path to the file with the matches in the text or binary format (".bin"
+  // extension) of `FeaturePairsFeatureMatcher`.
   std::string match_list_path = "";
 
   bool Check() const;
@@ -159,12 +274,33 @@ struct FeaturePairsMatchingOptions {
   // Whether to geometrically verify the given matches.
   bool verify_matches = true;
 
-  // Path to the file with the matches.
+  // Path to the file with the matches in the text or binary format (".bin"
+  // extension) of `FeaturePairsFeatureMatcher`.
   std::string match_list_path = "";
 
   bool Check() const;
 };
 
+struct MatchingServerOptions {
+  // Path to the spool directory, to which the clients submit their jobs.
+  std::string spool_path = "";
+
+  // The maximum number of images, whose features are cached in memory.
+  int cache_size = 1000;
+
+  // Number of image pairs to match in one batch.
+  int block_size = 1225;
+
+  // The interval in seconds in which the spool directory is checked for jobs.
+  double poll_interval = 1.0;
+
+  // Stop once no new job arrived for this number of seconds. The server runs
+  // until it is stopped explicitly, if this is not positive.
+  double max_idle_time = 0.0;
+
+  bool Check() const;
+};
+
 namespace internal {
 
 struct FeatureMatcherData {
@@ -174,28 +310,93 @@ struct FeatureMatcherData {
   TwoViewGeometry two_view_geometry;
 };
 
+// Thread-safe statistics of a stage in the matching pipeline, shared by all
+// threads of the same stage. The processing time excludes the time spent
+// waiting for input (the stage is starved) and the time spent waiting to push
+// the output into a full downstream queue (the stage is stalled).
+class FeatureMatcherStageStats {
+ public:
+  void Add(const double processing_seconds, const double starved_seconds,
+           const double stalled_seconds, const size_t num_pairs = 1);
+
+  // Account a pair, which was rejected by the stage, e.g., by geometric
+  // verification, in addition to adding it as a processed pair.
+  void AddRejected(const double processing_seconds);
+
+  size_t NumPairs() const;
+  size_t NumRejectedPairs() const;
+  double ProcessingSeconds() const;
+  double StarvedSeconds() const;
+  double StalledSeconds() const;
+
+  void Print(const std::string& name, const size_t num_threads,
+             const double elapsed_seconds) const;
+
+ private:
+  mutable std::mutex mutex_;
+  size_t num_pairs_ = 0;
+  size_t num_rejected_pairs_ = 0;
+  double processing_seconds_ = 0;
+  double rejected_processing_seconds_ = 0;
+  double starved_seconds_ = 0;
+  double stalled_seconds_ = 0;
+};
+
 }  // namespace internal
 
 // Cache for feature matching to minimize database access during matching.
+// The cache is thread-safe. Keypoints and descriptors are cached in sharded
+// caches, so that threads only contend on the database for cache misses and
+// concurrent misses for the same image are coalesced into a single read.
 class FeatureMatcherCache {
  public:
-  FeatureMatcherCache(const size_t cache_size, const Database* database);
-
+  // The keypoint locations of an image in pixels and in the normalized camera
+  // coordinate system, which are shared by the geometric verification of all
+  // image pairs of the image instead of being converted for every pair.
+  struct Points {
+    std::vector<Eigen::Vector2d> points;
+    std::vector<Eigen::Vector2d> points_normalized;
+  };
+
+  // The features are read from the feature store at the given path instead of
+  // the database, if the store is given and contains the image.
+  FeatureMatcherCache(const size_t cache_size, const Database* database,
+                      const std::string& feature_store_path = "");
+
+  // Read the cameras, images, and matched image pairs from the database. The
+  // cache can be set up again, e.g., after the database was reopened or
+  // modified by another process. The cached features are kept, if the
+  // database is the same, such that the features of existing images must not
+  // be changed in the meantime.
   void Setup();
 
   const Camera& GetCamera(const camera_t camera_id) const;
   const Image& GetImage(const image_t image_id) const;
-  const FeatureKeypoints& GetKeypoints(const image_t image_id);
-  const FeatureDescriptors& GetDescriptors(const image_t image_id);
+  std::shared_ptr<const FeatureKeypoints> GetKeypoints(const image_t image_id);
+  std::shared_ptr<const FeatureDescriptors> GetDescriptors(
+      const image_t image_id);
+  std::shared_ptr<const SiftDescriptorIndex> GetDescriptorIndex(
+      const image_t image_id);
+  std::shared_ptr<const FeatureBinaryDescriptors> GetBinaryDescriptors(
+      const image_t image_id);
+  std::shared_ptr<const Points> GetPoints(const image_t image_id);
   FeatureMatches GetMatches(const image_t image_id1, const image_t image_id2);
   std::vector<image_t> GetImageIds() const;
 
   bool ExistsKeypoints(const image_t image_id);
   bool ExistsDescriptors(const image_t image_id);
 
+  // Whether the matches or inlier matches of an image pair exist. The pairs
+  // are read once in bulk in `Setup` and then maintained in memory as matches
+  // are written and deleted through the cache, so these do not query the
+  // database. The database must not be modified in other ways meanwhile.
   bool ExistsMatches(const image_t image_id1, const image_t image_id2);
   bool ExistsInlierMatches(const image_t image_id1, const image_t image_id2);
 
+  // The number of inlier matches of a verified image pair or zero if the
+  // image pair is not verified, which is likewise maintained in memory.
+  int GetNumInlierMatches(const image_t image_id1, const image_t image_id2);
+
   void WriteMatches(const image_t image_id1, const image_t image_id2,
                     const FeatureMatches& matches);
   void WriteTwoViewGeometry(const image_t image_id1, const image_t image_id2,
@@ -204,16 +405,55 @@ class FeatureMatcherCache {
   void DeleteMatches(const image_t image_id1, const image_t image_id2);
   void DeleteInlierMatches(const image_t image_id1, const image_t image_id2);
 
+  // Print the hits, misses, and coalesced waits of the feature caches and the
+  // time spent waiting for exclusive access to the database.
+  void PrintStats() const;
+
+  // Export the hit rates of the feature caches, see util/metrics.h.
+  void RecordMetrics() const;
+
  private:
+  // The number of independently locked shards of each feature cache.
+  static const size_t kNumCacheShards = 16;
+
+  // Acquire exclusive access to the database and measure the waiting time.
+  std::unique_lock<std::mutex> LockDatabase();
+
+  // Read the features through a connection of the reader pool, such that
+  // multiple threads can read in parallel, or else through the database.
+  template <typename func_t>
+  auto ReadFeatures(const func_t& func)
+      -> decltype(func(std::declval<const Database&>()));
+
   const size_t cache_size_;
   const Database* database_;
+  const std::string feature_store_path_;
+  std::unique_ptr<FeatureStore> feature_store_;
+  // The path and data version of the database, whose features are in the
+  // feature caches.
+  std::string features_database_path_;
+  int64_t features_data_version_;
   std::mutex database_mutex_;
+  // Separate connections to read the features, which are not written by the
+  // matchers. All other reads go through `database_` to see its own writes.
+  std::unique_ptr<DatabaseReaderPool> reader_pool_;
+  std::atomic<size_t> database_wait_micro_seconds_;
   EIGEN_STL_UMAP(camera_t, Camera) cameras_cache_;
   EIGEN_STL_UMAP(image_t, Image) images_cache_;
-  std::unique_ptr<LRUCache<image_t, FeatureKeypoints>> keypoints_cache_;
-  std::unique_ptr<LRUCache<image_t, FeatureDescriptors>> descriptors_cache_;
-  std::unique_ptr<LRUCache<image_t, bool>> keypoints_exists_cache_;
-  std::unique_ptr<LRUCache<image_t, bool>> descriptors_exists_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureKeypoints>> keypoints_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureDescriptors>>
+      descriptors_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, SiftDescriptorIndex>>
+      descriptor_index_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, FeatureBinaryDescriptors>>
+      binary_descriptors_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, Points>> points_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, bool>> keypoints_exists_cache_;
+  std::unique_ptr<ShardedLRUCache<image_t, bool>> descriptors_exists_cache_;
+  std::mutex image_pairs_mutex_;
+  std::unordered_set<image_pair_t> matched_image_pair_ids_;
+  // The number of inlier matches of the verified image pairs.
+  std::unordered_map<image_pair_t, int> verified_image_pairs_;
 };
 
 class FeatureMatcherThread : public Thread {
@@ -236,33 +476,48 @@ class SiftCPUFeatureMatcher : public FeatureMatcherThread {
   SiftCPUFeatureMatcher(const SiftMatchingOptions& options,
                         FeatureMatcherCache* cache,
                         JobQueue<Input>* input_queue,
-                        JobQueue<Output>* output_queue);
+                        JobQueue<Output>* output_queue,
+                        internal::FeatureMatcherStageStats* stats = nullptr);
 
  protected:
   void Run() override;
 
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStageStats* stats_;
 };
 
+// If the input queue of the GPU matcher runs empty, it steals image pairs from
+// the given input queues of the other GPU matchers, such that the GPUs finish a
+// batch at the same time. The matching time of the GPU is additionally
+// accumulated in the device statistics, by which the image pairs are balanced
+// between heterogeneous GPUs.
 class SiftGPUFeatureMatcher : public FeatureMatcherThread {
  public:
   typedef internal::FeatureMatcherData Input;
   typedef internal::FeatureMatcherData Output;
 
-  SiftGPUFeatureMatcher(const SiftMatchingOptions& options,
-                        FeatureMatcherCache* cache,
-                        JobQueue<Input>* input_queue,
-                        JobQueue<Output>* output_queue);
+  SiftGPUFeatureMatcher(
+      const SiftMatchingOptions& options, FeatureMatcherCache* cache,
+      JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+      internal::FeatureMatcherStageStats* stats = nullptr,
+      const std::vector<JobQueue<Input>*>& steal_queues = {},
+      internal::FeatureMatcherStageStats* device_stats = nullptr);
 
  protected:
   void Run() override;
 
+  // Steal the next image pair of the fullest input queue of another GPU.
+  JobQueue<Input>::Job TrySteal();
+
   void GetDescriptorData(const int index, const image_t image_id,
                          const FeatureDescriptors** descriptors_ptr);
 
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStageStats* stats_;
+  std::vector<JobQueue<Input>*> steal_queues_;
+  internal::FeatureMatcherStageStats* device_stats_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
@@ -276,16 +531,17 @@ class GuidedSiftCPUFeatureMatcher : public FeatureMatcherThread {
   typedef internal::FeatureMatcherData Input;
   typedef internal::FeatureMatcherData Output;
 
-  GuidedSiftCPUFeatureMatcher(const SiftMatchingOptions& options,
-                              FeatureMatcherCache* cache,
-                              JobQueue<Input>* input_queue,
-                              JobQueue<Output>* output_queue);
+  GuidedSiftCPUFeatureMatcher(
+      const SiftMatchingOptions& options, FeatureMatcherCache* cache,
+      JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+      internal::FeatureMatcherStageStats* stats = nullptr);
 
  private:
   void Run() override;
 
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStageStats* stats_;
 };
 
 class GuidedSiftGPUFeatureMatcher : public FeatureMatcherThread {
@@ -293,10 +549,10 @@ class GuidedSiftGPUFeatureMatcher : public FeatureMatcherThread {
   typedef internal::FeatureMatcherData Input;
   typedef internal::FeatureMatcherData Output;
 
-  GuidedSiftGPUFeatureMatcher(const SiftMatchingOptions& options,
-                              FeatureMatcherCache* cache,
-                              JobQueue<Input>* input_queue,
-                              JobQueue<Output>* output_queue);
+  GuidedSiftGPUFeatureMatcher(
+      const SiftMatchingOptions& options, FeatureMatcherCache* cache,
+      JobQueue<Input>* input_queue, JobQueue<Output>* output_queue,
+      internal::FeatureMatcherStageStats* stats = nullptr);
 
  private:
   void Run() override;
@@ -307,6 +563,7 @@ class GuidedSiftGPUFeatureMatcher : public FeatureMatcherThread {
 
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStageStats* stats_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
@@ -324,7 +581,8 @@ class TwoViewGeometryVerifier : public Thread {
   TwoViewGeometryVerifier(const SiftMatchingOptions& options,
                           FeatureMatcherCache* cache,
                           JobQueue<Input>* input_queue,
-                          JobQueue<Output>* output_queue);
+                          JobQueue<Output>* output_queue,
+                          internal::FeatureMatcherStageStats* stats = nullptr);
 
  protected:
   void Run() override;
@@ -334,6 +592,7 @@ class TwoViewGeometryVerifier : public Thread {
   FeatureMatcherCache* cache_;
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  internal::FeatureMatcherStageStats* stats_;
 };
 
 // Multi-threaded and multi-GPU SIFT feature matcher, which writes the computed
@@ -348,13 +607,35 @@ class SiftFeatureMatcher {
 
   ~SiftFeatureMatcher();
 
-  // Setup the matchers and return if successful.
+  // Setup the matchers and return if successful. The maximum number of
+  // matches is limited by the maximum number of features in the database, if
+  // the database is already open.
   bool Setup();
 
-  // Match one batch of multiple image pairs.
+  // Match one batch of multiple image pairs. The matching of the batch is
+  // pipelined with the previous batch, i.e. the function returns once the
+  // results of all previous batches are written to the database, while the
+  // current batch is still being processed in the background.
   void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs);
 
+  // Wait for all pending image pairs and write their results to the database.
+  void Flush();
+
+  // Print the throughput and the fraction of the time each stage of the
+  // pipeline was busy, starved for input, or stalled by a full output queue.
+  void PrintStageStats() const;
+
  private:
+  void WriteOutput();
+
+  // Select the GPU matcher for a group of image pairs with the same first
+  // image by the estimated time until the GPU matchers have processed their
+  // queued image pairs and by the descriptors already uploaded to the GPUs.
+  size_t SelectGPUMatcher(const image_t image_id1) const;
+
+  // Export the number of image pairs in the queues of the pipeline stages.
+  void RecordMetrics();
+
   SiftMatchingOptions options_;
   Database* database_;
   FeatureMatcherCache* cache_;
@@ -367,9 +648,28 @@ class SiftFeatureMatcher {
   std::unique_ptr<ThreadPool> thread_pool_;
 
   JobQueue<internal::FeatureMatcherData> matcher_queue_;
+  // Separate input queue per GPU matcher. Consecutive image pairs with the
+  // same first image are dispatched to the same GPU, so that the descriptors
+  // of the first image are only uploaded once per row of a matching block.
+  std::vector<std::unique_ptr<JobQueue<internal::FeatureMatcherData>>>
+      gpu_matcher_queues_;
+  // The throughput of each GPU matcher and the first image of the image pairs
+  // last dispatched to it, whose descriptors remain uploaded to the GPU.
+  std::vector<std::unique_ptr<internal::FeatureMatcherStageStats>>
+      gpu_matcher_stats_;
+  std::vector<image_t> gpu_matcher_image_ids_;
   JobQueue<internal::FeatureMatcherData> verifier_queue_;
   JobQueue<internal::FeatureMatcherData> guided_matcher_queue_;
   JobQueue<internal::FeatureMatcherData> output_queue_;
+
+  // The image pairs pushed to the pipeline, whose results are not yet written.
+  std::unordered_set<image_pair_t> pending_image_pair_ids_;
+
+  Timer timer_;
+  internal::FeatureMatcherStageStats matcher_stats_;
+  internal::FeatureMatcherStageStats verifier_stats_;
+  internal::FeatureMatcherStageStats guided_matcher_stats_;
+  internal::FeatureMatcherStageStats writer_stats_;
 };
 
 // Exhaustively match images by processing each block in the exhaustive match
@@ -409,6 +709,7 @@ class ExhaustiveFeatureMatcher : public Thread {
   Database database_;
   FeatureMatcherCache cache_;
   SiftFeatureMatcher matcher_;
+  RigPairFilter rig_pair_filter_;
 };
 
 // Sequentially match images within neighborhood:
@@ -440,13 +741,13 @@ class SequentialFeatureMatcher : public Thread {
 
   std::vector<image_t> GetOrderedImageIds() const;
   void RunSequentialMatching(const std::vector<image_t>& image_ids);
-  void RunLoopDetection(const std::vector<image_t>& image_ids);
 
   const SequentialMatchingOptions options_;
   const SiftMatchingOptions match_options_;
   Database database_;
   FeatureMatcherCache cache_;
   SiftFeatureMatcher matcher_;
+  RigPairFilter rig_pair_filter_;
 };
 
 // Match each image against its nearest neighbors using a vocabulary tree.
@@ -544,6 +845,18 @@ class ImagePairsFeatureMatcher : public Thread {
 //      2 3
 //      ...
 //
+// For large match lists, the matches can be imported much faster from a
+// binary file with the ".bin" extension, which contains a sequence of image
+// pairs in little endian byte order:
+//
+//      uint32  LENGTH_1, char IMAGE_NAME_1[LENGTH_1]
+//      uint32  LENGTH_2, char IMAGE_NAME_2[LENGTH_2]
+//      uint64  NUM_MATCHES
+//      uint32  MATCHES[NUM_MATCHES][2]
+//      ...
+//
+// The image pairs are verified in parallel and written to the database in
+// batched transactions.
 class FeaturePairsFeatureMatcher : public Thread {
  public:
   FeaturePairsFeatureMatcher(const FeaturePairsMatchingOptions& options,
@@ -561,6 +874,50 @@ class FeaturePairsFeatureMatcher : public Thread {
   FeatureMatcherCache cache_;
 };
 
+// Persistent feature matching service, which owns the matchers, e.g., the
+// SiftGPU contexts of all GPUs, and the feature cache for its lifetime and
+// processes the jobs of many client processes. This avoids setting up the
+// matchers and warming up the cache for each job.
+//
+// The clients submit jobs to the spool directory as text files with the
+// ".job" extension, which contain the path to the database followed by the
+// image pairs to match in the format of `ImagePairsFeatureMatcher`:
+//
+//    /path/to/database.db
+//    image_name1 image_name2
+//    image_name1 image_name3
+//    ...
+//
+// A job must be written under a different name and then renamed to its
+// final name, so that partially written jobs are never read. The jobs are
+// processed in the order of their names. The server claims a job by
+// renaming it to "NAME.job.running", such that multiple servers can share
+// the same spool directory, and renames it to "NAME.job.done" or
+// "NAME.job.failed" once finished. The features stay cached for consecutive
+// jobs of the same database, while the database must not be written by other
+// processes during a job.
+class FeatureMatchingServer : public Thread {
+ public:
+  FeatureMatchingServer(const MatchingServerOptions& options,
+                        const SiftMatchingOptions& match_options);
+
+ private:
+  void Run() override;
+
+  // Claim the next job in the spool directory and return its path or an
+  // empty string if there is no job.
+  std::string ClaimNextJob() const;
+
+  // Match the image pairs of the claimed job and return if successful.
+  bool ProcessJob(const std::string& job_path);
+
+  const MatchingServerOptions options_;
+  const SiftMatchingOptions match_options_;
+  Database database_;
+  FeatureMatcherCache cache_;
+  SiftFeatureMatcher matcher_;
+};
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_FEATURE_MATCHING_H_
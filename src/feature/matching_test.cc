@@ -0,0 +1,188 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "feature/matching"
+#include "util/testing.h"
+
+#include <fstream>
+
+#include "base/database.h"
+#include "base/feature_store.h"
+#include "feature/matching.h"
+#include "feature/utils.h"
+#include "util/misc.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features) {
+  Eigen::MatrixXf descriptors(num_features, 128);
+  for (size_t i = 0; i < num_features; ++i) {
+    for (size_t j = 0; j < 128; ++j) {
+      descriptors(i, j) = std::pow(RandomReal(0.0f, 1.0f), 2);
+    }
+  }
+  return FeatureDescriptorsToUnsignedByte(
+      L2NormalizeFeatureDescriptors(descriptors));
+}
+
+FeatureKeypoints CreateRandomFeatureKeypoints(const size_t num_features) {
+  FeatureKeypoints keypoints(num_features);
+  for (size_t i = 0; i < num_features; ++i) {
+    keypoints[i] = FeatureKeypoint(RandomReal(0.0f, 100.0f),
+                                   RandomReal(0.0f, 100.0f));
+  }
+  return keypoints;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestImagePairsFeatureMatcher) {
+  SetPRNGSeed(0);
+
+  const boost::filesystem::path test_dir =
+      boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path("colmap_matching_%%%%-%%%%");
+  boost::filesystem::create_directories(test_dir);
+  const std::string database_path = (test_dir / "database.db").string();
+  const std::string match_list_path = (test_dir / "match_list.txt").string();
+
+  std::vector<image_t> image_ids;
+  {
+    Database database(database_path);
+    Camera camera;
+    camera.InitializeWithName("SIMPLE_PINHOLE", 100, 100, 100);
+    const camera_t camera_id = database.WriteCamera(camera);
+    for (int i = 0; i < 4; ++i) {
+      Image image;
+      image.SetName("image" + std::to_string(i) + ".png");
+      image.SetCameraId(camera_id);
+      image_ids.push_back(database.WriteImage(image));
+      database.WriteKeypoints(image_ids.back(),
+                              CreateRandomFeatureKeypoints(50));
+      database.WriteDescriptors(image_ids.back(),
+                                CreateRandomFeatureDescriptors(50));
+    }
+  }
+
+  // The list is much smaller than a single chunk of blocks, such that all
+  // image pairs are dispatched at the very end of the list.
+  {
+    std::ofstream file(match_list_path);
+    file << "image0.png image1.png" << std::endl;
+    file << "image2.png image3.png" << std::endl;
+    file << "image1.png image3.png" << std::endl;
+  }
+
+  ImagePairsMatchingOptions options;
+  options.block_size = 2;
+  options.match_list_path = match_list_path;
+  SiftMatchingOptions match_options;
+  match_options.use_gpu = false;
+  match_options.num_threads = 2;
+
+  ImagePairsFeatureMatcher matcher(options, match_options, database_path);
+  matcher.Start();
+  matcher.Wait();
+
+  {
+    Database database(database_path);
+    BOOST_CHECK(database.ExistsMatches(image_ids[0], image_ids[1]));
+    BOOST_CHECK(database.ExistsMatches(image_ids[2], image_ids[3]));
+    BOOST_CHECK(database.ExistsMatches(image_ids[1], image_ids[3]));
+    BOOST_CHECK(!database.ExistsMatches(image_ids[0], image_ids[2]));
+    BOOST_CHECK(database.ExistsInlierMatches(image_ids[0], image_ids[1]));
+    BOOST_CHECK(database.ExistsInlierMatches(image_ids[2], image_ids[3]));
+    BOOST_CHECK(database.ExistsInlierMatches(image_ids[1], image_ids[3]));
+  }
+
+  boost::filesystem::remove_all(test_dir);
+}
+
+BOOST_AUTO_TEST_CASE(TestFeatureMatcherCacheFeatureStore) {
+  SetPRNGSeed(0);
+
+  const boost::filesystem::path test_dir =
+      boost::filesystem::temp_directory_path() /
+      boost::filesystem::unique_path("colmap_matching_%%%%-%%%%");
+  boost::filesystem::create_directories(test_dir);
+  const std::string database_path = (test_dir / "database.db").string();
+  const std::string feature_store_path = (test_dir / "features").string();
+
+  Database database(database_path);
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 100, 100, 100);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i) + ".png");
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+  }
+
+  // The first image is only in the database, the second image only in the
+  // store, and the last image has no features at all.
+  const FeatureKeypoints keypoints1 = CreateRandomFeatureKeypoints(10);
+  const FeatureDescriptors descriptors1 = CreateRandomFeatureDescriptors(10);
+  database.WriteKeypoints(image_ids[0], keypoints1);
+  database.WriteDescriptors(image_ids[0], descriptors1);
+  const FeatureKeypoints keypoints2 = CreateRandomFeatureKeypoints(20);
+  const FeatureDescriptors descriptors2 = CreateRandomFeatureDescriptors(20);
+  {
+    FeatureStore feature_store(feature_store_path);
+    feature_store.WriteKeypoints(image_ids[1], keypoints2);
+    feature_store.WriteDescriptors(image_ids[1], descriptors2);
+  }
+
+  FeatureMatcherCache cache(10, &database, feature_store_path);
+  cache.Setup();
+
+  BOOST_CHECK(cache.ExistsKeypoints(image_ids[0]));
+  BOOST_CHECK(cache.ExistsDescriptors(image_ids[0]));
+  BOOST_CHECK(cache.ExistsKeypoints(image_ids[1]));
+  BOOST_CHECK(cache.ExistsDescriptors(image_ids[1]));
+  BOOST_CHECK(!cache.ExistsKeypoints(image_ids[2]));
+  BOOST_CHECK(!cache.ExistsDescriptors(image_ids[2]));
+
+  BOOST_CHECK_EQUAL(cache.GetKeypoints(image_ids[0])->size(), 10);
+  BOOST_CHECK_EQUAL(cache.GetKeypoints(image_ids[0])->at(3).x,
+                    keypoints1[3].x);
+  BOOST_CHECK(*cache.GetDescriptors(image_ids[0]) == descriptors1);
+  BOOST_CHECK_EQUAL(cache.GetKeypoints(image_ids[1])->size(), 20);
+  BOOST_CHECK_EQUAL(cache.GetKeypoints(image_ids[1])->at(3).x,
+                    keypoints2[3].x);
+  BOOST_CHECK(*cache.GetDescriptors(image_ids[1]) == descriptors2);
+
+  database.Close();
+  boost::filesystem::remove_all(test_dir);
+}
@@ -0,0 +1,243 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "feature/product_quantizer.h"
+
+#include <numeric>
+
+#include "util/logging.h"
+#include "util/math.h"
+#include "util/random.h"
+#include "util/threading.h"
+
+namespace colmap {
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    RowMajorMatrixXf;
+
+// Find the nearest centroid and its squared distance for every row of the
+// data. The distances are computed as |x|^2 - 2 x^T c + |c|^2 with matrix
+// products over blocks of rows, which is much faster than computing the
+// distances individually.
+void FindNearestCentroids(const RowMajorMatrixXf& data,
+                          const RowMajorMatrixXf& centroids,
+                          std::vector<int>* centroid_idxs,
+                          std::vector<float>* squared_distances) {
+  const Eigen::RowVectorXf centroid_norms =
+      centroids.rowwise().squaredNorm().transpose();
+
+  centroid_idxs->resize(data.rows());
+  squared_distances->resize(data.rows());
+
+  const Eigen::Index kBlockSize = 4096;
+  for (Eigen::Index begin = 0; begin < data.rows(); begin += kBlockSize) {
+    const Eigen::Index block_size =
+        std::min(kBlockSize, static_cast<Eigen::Index>(data.rows() - begin));
+    const auto block = data.middleRows(begin, block_size);
+    const Eigen::MatrixXf dots = block * centroids.transpose();
+    for (Eigen::Index i = 0; i < block_size; ++i) {
+      Eigen::Index centroid_idx;
+      const float distance =
+          (centroid_norms - 2 * dots.row(i)).minCoeff(&centroid_idx);
+      (*centroid_idxs)[begin + i] = static_cast<int>(centroid_idx);
+      (*squared_distances)[begin + i] =
+          std::max(0.0f, distance + block.row(i).squaredNorm());
+    }
+  }
+}
+
+// Index of the nearest neighbor in the database for every query descriptor.
+std::vector<int> FindNearestNeighbors(const RowMajorMatrixXf& query,
+                                      const RowMajorMatrixXf& database) {
+  std::vector<int> neighbor_idxs;
+  std::vector<float> squared_distances;
+  FindNearestCentroids(query, database, &neighbor_idxs, &squared_distances);
+  return neighbor_idxs;
+}
+
+}  // namespace
+
+ProductQuantizer::ProductQuantizer(const Codebook& codebook)
+    : codebook_(codebook) {
+  CHECK_GT(codebook_.rows(), 0);
+  CHECK_EQ(codebook_.rows() % kNumCentroids, 0);
+}
+
+void ProductQuantizer::Train(const FeatureDescriptors& descriptors,
+                             const int num_subspaces, const int num_iterations,
+                             const int num_threads) {
+  CHECK_GT(num_subspaces, 0);
+  CHECK_EQ(descriptors.cols() % num_subspaces, 0);
+  CHECK_GE(descriptors.rows(), kNumCentroids);
+  CHECK_GT(num_iterations, 0);
+
+  const int num_subspace_dims =
+      static_cast<int>(descriptors.cols()) / num_subspaces;
+  const RowMajorMatrixXf data = descriptors.cast<float>();
+
+  // The centroids are initialized with distinct random training descriptors.
+  // They are sampled up front, since the random number generator is local to
+  // the calling thread.
+  std::vector<std::vector<int>> init_idxs(num_subspaces);
+  for (auto& subspace_init_idxs : init_idxs) {
+    subspace_init_idxs.resize(data.rows());
+    std::iota(subspace_init_idxs.begin(), subspace_init_idxs.end(), 0);
+    Shuffle(kNumCentroids, &subspace_init_idxs);
+    subspace_init_idxs.resize(kNumCentroids);
+  }
+
+  codebook_.resize(num_subspaces * kNumCentroids, num_subspace_dims);
+
+  auto TrainSubspace = [&](const int subspace_idx) {
+    const RowMajorMatrixXf subspace_data =
+        data.middleCols(subspace_idx * num_subspace_dims, num_subspace_dims);
+
+    RowMajorMatrixXf centroids(kNumCentroids, num_subspace_dims);
+    for (int k = 0; k < kNumCentroids; ++k) {
+      centroids.row(k) = subspace_data.row(init_idxs[subspace_idx][k]);
+    }
+
+    std::vector<int> centroid_idxs;
+    std::vector<float> squared_distances;
+    for (int iteration = 0; iteration < num_iterations; ++iteration) {
+      FindNearestCentroids(subspace_data, centroids, &centroid_idxs,
+                           &squared_distances);
+
+      RowMajorMatrixXf sums =
+          RowMajorMatrixXf::Zero(kNumCentroids, num_subspace_dims);
+      std::vector<int> counts(kNumCentroids, 0);
+      for (Eigen::Index i = 0; i < subspace_data.rows(); ++i) {
+        sums.row(centroid_idxs[i]) += subspace_data.row(i);
+        counts[centroid_idxs[i]] += 1;
+      }
+
+      for (int k = 0; k < kNumCentroids; ++k) {
+        if (counts[k] > 0) {
+          centroids.row(k) = sums.row(k) / static_cast<float>(counts[k]);
+        } else {
+          // Move empty clusters to the descriptor with the largest error.
+          const auto max_distance = std::max_element(squared_distances.begin(),
+                                                     squared_distances.end());
+          centroids.row(k) =
+              subspace_data.row(max_distance - squared_distances.begin());
+          *max_distance = 0;
+        }
+      }
+    }
+
+    codebook_.middleRows(subspace_idx * kNumCentroids, kNumCentroids) =
+        centroids;
+  };
+
+  ThreadPool thread_pool(num_threads);
+  thread_pool.ParallelFor(0, num_subspaces,
+                          [&](const size_t begin, const size_t end) {
+                            for (size_t i = begin; i < end; ++i) {
+                              TrainSubspace(static_cast<int>(i));
+                            }
+                          },
+                          ThreadPool::Schedule::DYNAMIC, 1);
+}
+
+FeatureDescriptors ProductQuantizer::Encode(
+    const FeatureDescriptors& descriptors) const {
+  CHECK(IsTrained());
+  CHECK_EQ(descriptors.cols(), NumDims());
+
+  const int num_subspace_dims = static_cast<int>(codebook_.cols());
+  const RowMajorMatrixXf data = descriptors.cast<float>();
+
+  FeatureDescriptors codes(descriptors.rows(), NumSubspaces());
+  std::vector<int> centroid_idxs;
+  std::vector<float> squared_distances;
+  for (int s = 0; s < NumSubspaces(); ++s) {
+    const RowMajorMatrixXf subspace_data =
+        data.middleCols(s * num_subspace_dims, num_subspace_dims);
+    const RowMajorMatrixXf centroids =
+        codebook_.middleRows(s * kNumCentroids, kNumCentroids);
+    FindNearestCentroids(subspace_data, centroids, &centroid_idxs,
+                         &squared_distances);
+    for (Eigen::Index i = 0; i < codes.rows(); ++i) {
+      codes(i, s) = static_cast<uint8_t>(centroid_idxs[i]);
+    }
+  }
+
+  return codes;
+}
+
+FeatureDescriptors ProductQuantizer::Decode(
+    const FeatureDescriptors& codes) const {
+  CHECK(IsTrained());
+  CHECK_EQ(codes.cols(), NumSubspaces());
+
+  const int num_subspace_dims = static_cast<int>(codebook_.cols());
+
+  FeatureDescriptors descriptors(codes.rows(), NumDims());
+  for (Eigen::Index i = 0; i < codes.rows(); ++i) {
+    for (int s = 0; s < NumSubspaces(); ++s) {
+      const auto centroid = codebook_.row(s * kNumCentroids + codes(i, s));
+      for (int d = 0; d < num_subspace_dims; ++d) {
+        descriptors(i, s * num_subspace_dims + d) =
+            static_cast<uint8_t>(Clip(std::round(centroid(d)), 0.0f, 255.0f));
+      }
+    }
+  }
+
+  return descriptors;
+}
+
+double ComputeProductQuantizerRecall(const ProductQuantizer& quantizer,
+                                     const FeatureDescriptors& query,
+                                     const FeatureDescriptors& database) {
+  CHECK_EQ(query.cols(), database.cols());
+  if (query.rows() == 0 || database.rows() == 0) {
+    return 1.0;
+  }
+
+  const std::vector<int> neighbor_idxs = FindNearestNeighbors(
+      query.cast<float>(), database.cast<float>());
+  const std::vector<int> quantized_neighbor_idxs = FindNearestNeighbors(
+      quantizer.Decode(quantizer.Encode(query)).cast<float>(),
+      quantizer.Decode(quantizer.Encode(database)).cast<float>());
+
+  size_t num_recalled = 0;
+  for (size_t i = 0; i < neighbor_idxs.size(); ++i) {
+    if (neighbor_idxs[i] == quantized_neighbor_idxs[i]) {
+      num_recalled += 1;
+    }
+  }
+
+  return static_cast<double>(num_recalled) / neighbor_idxs.size();
+}
+
+}  // namespace colmap
@@ -0,0 +1,111 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_FEATURE_PRODUCT_QUANTIZER_H_
+#define COLMAP_SRC_FEATURE_PRODUCT_QUANTIZER_H_
+
+#include <Eigen/Core>
+
+#include "feature/types.h"
+
+namespace colmap {
+
+// Product quantizer for the compact storage of feature descriptors. The
+// descriptor space is split into contiguous subspaces of equal dimension and
+// the part of a descriptor in each subspace is quantized to the nearest of
+// 256 centroids, which are learned with k-means from training descriptors.
+// A descriptor is thus encoded with one byte per subspace, e.g. 16 instead of
+// 128 bytes for SIFT with 16 subspaces. The codes are stored in a matrix of
+// the same type as the descriptors with one row per descriptor and one column
+// per subspace. See "Product quantization for nearest neighbor search",
+// Herve Jegou, Matthijs Douze, and Cordelia Schmid, PAMI 2011.
+class ProductQuantizer {
+ public:
+  // The centroids of all subspaces stacked on top of each other, i.e. the
+  // centroids of the s-th subspace are the rows [256 * s, 256 * (s + 1)).
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Codebook;
+
+  static const int kNumCentroids = 256;
+
+  ProductQuantizer() = default;
+  explicit ProductQuantizer(const Codebook& codebook);
+
+  // Learn the codebook from the given training descriptors. The number of
+  // subspaces must divide the descriptor dimensionality and there must be at
+  // least as many training descriptors as centroids per subspace.
+  void Train(const FeatureDescriptors& descriptors, const int num_subspaces,
+             const int num_iterations = 10, const int num_threads = -1);
+
+  inline bool IsTrained() const;
+  inline int NumSubspaces() const;
+  inline int NumDims() const;
+  inline const Codebook& GetCodebook() const;
+
+  // Encode the descriptors to one code per subspace and decode the codes to
+  // approximate descriptors of the original dimensionality.
+  FeatureDescriptors Encode(const FeatureDescriptors& descriptors) const;
+  FeatureDescriptors Decode(const FeatureDescriptors& codes) const;
+
+ private:
+  Codebook codebook_;
+};
+
+// Fraction of the query descriptors, whose nearest neighbor among the
+// database descriptors is the same for the original and the quantized
+// descriptors. This measures the loss in matching recall due to the
+// quantization of the descriptors.
+double ComputeProductQuantizerRecall(const ProductQuantizer& quantizer,
+                                     const FeatureDescriptors& query,
+                                     const FeatureDescriptors& database);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool ProductQuantizer::IsTrained() const { return codebook_.size() > 0; }
+
+int ProductQuantizer::NumSubspaces() const {
+  return static_cast<int>(codebook_.rows() / kNumCentroids);
+}
+
+int ProductQuantizer::NumDims() const {
+  return static_cast<int>(NumSubspaces() * codebook_.cols());
+}
+
+const ProductQuantizer::Codebook& ProductQuantizer::GetCodebook() const {
+  return codebook_;
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_FEATURE_PRODUCT_QUANTIZER_H_
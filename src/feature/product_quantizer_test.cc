@@ -0,0 +1,116 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "feature/product_quantizer_test"
+#include "util/testing.h"
+
+#include "feature/product_quantizer.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+// Descriptors scattered around a small number of random prototypes.
+FeatureDescriptors CreateClusteredDescriptors(const int num_descriptors,
+                                              const int num_prototypes) {
+  SetPRNGSeed(0);
+  FeatureDescriptors prototypes(num_prototypes, 128);
+  for (int i = 0; i < prototypes.size(); ++i) {
+    prototypes.data()[i] = RandomInteger<int>(10, 245);
+  }
+
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (int i = 0; i < num_descriptors; ++i) {
+    const int prototype_idx = RandomInteger<int>(0, num_prototypes - 1);
+    for (int d = 0; d < 128; ++d) {
+      descriptors(i, d) =
+          prototypes(prototype_idx, d) + RandomInteger<int>(-2, 2);
+    }
+  }
+
+  return descriptors;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  ProductQuantizer quantizer;
+  BOOST_CHECK(!quantizer.IsTrained());
+  BOOST_CHECK_EQUAL(quantizer.NumSubspaces(), 0);
+  BOOST_CHECK_EQUAL(quantizer.NumDims(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestTrainEncodeDecode) {
+  const FeatureDescriptors descriptors = CreateClusteredDescriptors(2000, 50);
+
+  ProductQuantizer quantizer;
+  quantizer.Train(descriptors, 16);
+  BOOST_CHECK(quantizer.IsTrained());
+  BOOST_CHECK_EQUAL(quantizer.NumSubspaces(), 16);
+  BOOST_CHECK_EQUAL(quantizer.NumDims(), 128);
+  BOOST_CHECK_EQUAL(quantizer.GetCodebook().rows(), 16 * 256);
+  BOOST_CHECK_EQUAL(quantizer.GetCodebook().cols(), 8);
+
+  const FeatureDescriptors codes = quantizer.Encode(descriptors);
+  BOOST_CHECK_EQUAL(codes.rows(), descriptors.rows());
+  BOOST_CHECK_EQUAL(codes.cols(), 16);
+
+  const FeatureDescriptors decoded = quantizer.Decode(codes);
+  BOOST_CHECK_EQUAL(decoded.rows(), descriptors.rows());
+  BOOST_CHECK_EQUAL(decoded.cols(), descriptors.cols());
+  const double mean_error =
+      (decoded.cast<double>() - descriptors.cast<double>()).cwiseAbs().mean();
+  BOOST_CHECK_LT(mean_error, 2);
+
+  // The quantizer can be restored from its codebook.
+  const ProductQuantizer restored_quantizer(quantizer.GetCodebook());
+  BOOST_CHECK_EQUAL(restored_quantizer.Encode(descriptors), codes);
+}
+
+BOOST_AUTO_TEST_CASE(TestRecall) {
+  const FeatureDescriptors descriptors = CreateClusteredDescriptors(1000, 500);
+
+  ProductQuantizer quantizer;
+  quantizer.Train(descriptors, 16);
+
+  BOOST_CHECK_EQUAL(ComputeProductQuantizerRecall(
+                        quantizer, descriptors, FeatureDescriptors(0, 128)),
+                    1.0);
+
+  const FeatureDescriptors query = descriptors.topRows(100);
+  const FeatureDescriptors database = descriptors.bottomRows(900);
+  const double recall =
+      ComputeProductQuantizerRecall(quantizer, query, database);
+  BOOST_CHECK_GT(recall, 0.5);
+  BOOST_CHECK_LE(recall, 1.0);
+}
@@ -0,0 +1,206 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "feature/redundancy.h"
+
+#include <algorithm>
+
+#include "feature/sift.h"
+#include "feature/utils.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/threading.h"
+
+namespace colmap {
+namespace {
+
+struct ImageFeatures {
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+};
+
+}  // namespace
+
+bool RedundantImageOptions::Check() const {
+  CHECK_OPTION_GT(max_num_features, 0);
+  CHECK_OPTION_GE(min_match_ratio, 0);
+  CHECK_OPTION_LE(min_match_ratio, 1);
+  CHECK_OPTION_GE(max_displacement, 0);
+  CHECK_OPTION_GT(max_ratio, 0);
+  CHECK_OPTION_GT(max_distance, 0);
+  return true;
+}
+
+bool IsRedundantImage(const RedundantImageOptions& options,
+                      const FeatureKeypoints& keyframe_keypoints,
+                      const FeatureDescriptors& keyframe_descriptors,
+                      const FeatureKeypoints& keypoints,
+                      const FeatureDescriptors& descriptors,
+                      const size_t image_size) {
+  const size_t num_features =
+      std::min(keyframe_keypoints.size(), keypoints.size());
+  if (num_features == 0) {
+    return false;
+  }
+
+  SiftMatchingOptions match_options;
+  match_options.num_threads = 1;
+  match_options.max_ratio = options.max_ratio;
+  match_options.max_distance = options.max_distance;
+  match_options.cross_check = true;
+  FeatureMatches matches;
+  MatchSiftFeaturesCPU(match_options, keyframe_descriptors, descriptors,
+                       &matches);
+  if (matches.empty() ||
+      matches.size() < options.min_match_ratio * num_features) {
+    return false;
+  }
+
+  std::vector<double> displacements;
+  displacements.reserve(matches.size());
+  for (const auto& match : matches) {
+    const FeatureKeypoint& keypoint1 = keyframe_keypoints[match.point2D_idx1];
+    const FeatureKeypoint& keypoint2 = keypoints[match.point2D_idx2];
+    const double dx = keypoint2.x - keypoint1.x;
+    const double dy = keypoint2.y - keypoint1.y;
+    displacements.push_back(std::sqrt(dx * dx + dy * dy));
+  }
+
+  return Median(displacements) <= options.max_displacement * image_size;
+}
+
+RedundantImages FindRedundantImages(const RedundantImageOptions& options,
+                                    const Database& database) {
+  CHECK(options.Check());
+
+  std::vector<Image> images = database.ReadAllImages();
+  std::sort(images.begin(), images.end(),
+            [](const Image& image1, const Image& image2) {
+              return image1.Name() < image2.Name();
+            });
+
+  std::unordered_map<camera_t, size_t> image_sizes;
+  for (const auto& camera : database.ReadAllCameras()) {
+    image_sizes.emplace(camera.CameraId(),
+                        std::max(camera.Width(), camera.Height()));
+  }
+
+  const auto ReadFeatures = [&](const image_t image_id) {
+    ImageFeatures features;
+    features.keypoints = database.ReadKeypoints(image_id);
+    features.descriptors = database.ReadDescriptors(image_id);
+    ExtractTopScaleFeatures(&features.keypoints, &features.descriptors,
+                            static_cast<size_t>(options.max_num_features));
+    return features;
+  };
+
+  RedundantImages redundant_images;
+  if (images.empty()) {
+    return redundant_images;
+  }
+
+  ThreadPool thread_pool(options.num_threads);
+
+  // Every image is compared to the last keyframe, so the comparisons of the
+  // next images are computed in parallel and discarded after the next
+  // keyframe, which is rare in the long runs of redundant images.
+  const size_t window_size = 2 * thread_pool.NumThreads();
+
+  size_t keyframe_idx = 0;
+  ImageFeatures keyframe_features = ReadFeatures(images[0].ImageId());
+  redundant_images.keyframe_ids.push_back(images[0].ImageId());
+
+  std::vector<ImageFeatures> window_features;
+  std::vector<char> is_redundant;
+  size_t image_idx = 1;
+  while (image_idx < images.size()) {
+    const size_t window_begin = image_idx;
+    const size_t window_end =
+        std::min(window_begin + window_size, images.size());
+
+    // The database is read sequentially, since it is not thread-safe.
+    window_features.clear();
+    for (size_t i = window_begin; i < window_end; ++i) {
+      window_features.push_back(ReadFeatures(images[i].ImageId()));
+    }
+
+    const Image& keyframe = images[keyframe_idx];
+    const size_t image_size = image_sizes.at(keyframe.CameraId());
+    is_redundant.assign(window_end - window_begin, false);
+    thread_pool.ParallelFor(
+        window_begin, window_end,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            if (images[i].CameraId() != keyframe.CameraId()) {
+              continue;
+            }
+            const ImageFeatures& features = window_features[i - window_begin];
+            is_redundant[i - window_begin] = IsRedundantImage(
+                options, keyframe_features.keypoints,
+                keyframe_features.descriptors, features.keypoints,
+                features.descriptors, image_size);
+          }
+        },
+        ThreadPool::Schedule::DYNAMIC, 1);
+
+    for (size_t i = window_begin; i < window_end; ++i) {
+      image_idx = i + 1;
+      const bool exceeds_max_num_consecutive_images =
+          options.max_num_consecutive_images > 0 &&
+          i - keyframe_idx >
+              static_cast<size_t>(options.max_num_consecutive_images);
+      if (is_redundant[i - window_begin] &&
+          !exceeds_max_num_consecutive_images) {
+        redundant_images.redundant_image_ids.emplace_back(
+            images[i].ImageId(), keyframe.ImageId());
+      } else {
+        // The comparisons of the remaining images of the window were made
+        // against the previous keyframe and are recomputed.
+        keyframe_idx = i;
+        keyframe_features = std::move(window_features[i - window_begin]);
+        redundant_images.keyframe_ids.push_back(images[i].ImageId());
+        break;
+      }
+    }
+
+    std::cout << StringPrintf("Processed image [%d/%d], %d keyframes",
+                              image_idx, images.size(),
+                              redundant_images.keyframe_ids.size())
+              << std::endl;
+  }
+
+  std::cout << StringPrintf("Found %d redundant images",
+                            redundant_images.redundant_image_ids.size())
+            << std::endl;
+
+  return redundant_images;
+}
+
+}  // namespace colmap
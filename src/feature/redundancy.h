@@ -0,0 +1,104 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_FEATURE_REDUNDANCY_H_
+#define COLMAP_SRC_FEATURE_REDUNDANCY_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/database.h"
+#include "feature/types.h"
+
+namespace colmap {
+
+struct RedundantImageOptions {
+  // Maximum number of largest-scale features per image, which are matched
+  // between an image and its keyframe.
+  int max_num_features = 1024;
+
+  // Minimum number of matches between an image and its keyframe relative to
+  // the smaller number of their features for the image to be redundant.
+  double min_match_ratio = 0.6;
+
+  // Maximum median displacement of the matched features between an image and
+  // its keyframe relative to the larger image dimension for the image to be
+  // redundant.
+  double max_displacement = 0.02;
+
+  // Maximum number of consecutive redundant images after a keyframe, such
+  // that slowly drifting captures still yield keyframes. Non-positive values
+  // do not limit the number.
+  int max_num_consecutive_images = -1;
+
+  // Maximum distance ratio between first and second best match and maximum
+  // distance to the best match, as in `SiftMatchingOptions`.
+  double max_ratio = 0.8;
+  double max_distance = 0.7;
+
+  // Number of threads to compare the images.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+struct RedundantImages {
+  // The images that are kept for matching and mapping in sequence order.
+  std::vector<image_t> keyframe_ids;
+
+  // The redundant images in sequence order and the preceding keyframe, of
+  // which they are near-duplicates.
+  std::vector<std::pair<image_t, image_t>> redundant_image_ids;
+};
+
+// Check whether an image is a near-duplicate of its keyframe, i.e. most of
+// their features match and barely moved. The features are the largest-scale
+// features of the images, see `ExtractTopScaleFeatures`, and the image size is
+// the larger dimension of the images, which must have the same camera.
+bool IsRedundantImage(const RedundantImageOptions& options,
+                      const FeatureKeypoints& keyframe_keypoints,
+                      const FeatureDescriptors& keyframe_descriptors,
+                      const FeatureKeypoints& keypoints,
+                      const FeatureDescriptors& descriptors,
+                      const size_t image_size);
+
+// Find the redundant images in the runs of nearly identical frames of video
+// or drone captures from the features in the database. The images are ordered
+// by their names as in sequential matching and every image is compared to the
+// last keyframe, which is the first image or the last image that was not
+// redundant. The redundant images can then be skipped in matching and mapping
+// and registered against their keyframes at the end, which saves most of the
+// compute for captures with long runs of nearly identical frames.
+RedundantImages FindRedundantImages(const RedundantImageOptions& options,
+                                    const Database& database);
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_FEATURE_REDUNDANCY_H_
@@ -0,0 +1,145 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "feature/redundancy"
+#include "util/testing.h"
+
+#include "feature/redundancy.h"
+#include "feature/utils.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features) {
+  Eigen::MatrixXf descriptors(num_features, 128);
+  for (size_t i = 0; i < num_features; ++i) {
+    for (size_t j = 0; j < 128; ++j) {
+      descriptors(i, j) = std::pow(RandomReal(0.0f, 1.0f), 2);
+    }
+  }
+  return FeatureDescriptorsToUnsignedByte(
+      L2NormalizeFeatureDescriptors(descriptors));
+}
+
+FeatureKeypoints CreateRandomFeatureKeypoints(const size_t num_features) {
+  FeatureKeypoints keypoints(num_features);
+  for (size_t i = 0; i < num_features; ++i) {
+    keypoints[i] = FeatureKeypoint(RandomReal(0.0f, 100.0f),
+                                   RandomReal(0.0f, 100.0f));
+  }
+  return keypoints;
+}
+
+FeatureKeypoints ShiftFeatureKeypoints(const FeatureKeypoints& keypoints,
+                                       const float shift) {
+  FeatureKeypoints shifted_keypoints = keypoints;
+  for (auto& keypoint : shifted_keypoints) {
+    keypoint.x += shift;
+  }
+  return shifted_keypoints;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestIsRedundantImage) {
+  SetPRNGSeed(0);
+  const FeatureKeypoints keypoints = CreateRandomFeatureKeypoints(100);
+  const FeatureDescriptors descriptors = CreateRandomFeatureDescriptors(100);
+
+  RedundantImageOptions options;
+  BOOST_CHECK(IsRedundantImage(options, keypoints, descriptors, keypoints,
+                               descriptors, 100));
+  BOOST_CHECK(IsRedundantImage(options, keypoints, descriptors,
+                               ShiftFeatureKeypoints(keypoints, 1.5f),
+                               descriptors, 100));
+  BOOST_CHECK(!IsRedundantImage(options, keypoints, descriptors,
+                                ShiftFeatureKeypoints(keypoints, 3.0f),
+                                descriptors, 100));
+  BOOST_CHECK(!IsRedundantImage(options, keypoints, descriptors, keypoints,
+                                CreateRandomFeatureDescriptors(100), 100));
+  BOOST_CHECK(!IsRedundantImage(options, keypoints, descriptors,
+                                FeatureKeypoints(),
+                                CreateRandomFeatureDescriptors(0), 100));
+
+  // Only half of the features are matched.
+  FeatureDescriptors half_descriptors = descriptors;
+  half_descriptors.bottomRows(50) = CreateRandomFeatureDescriptors(50);
+  BOOST_CHECK(!IsRedundantImage(options, keypoints, descriptors, keypoints,
+                                half_descriptors, 100));
+  options.min_match_ratio = 0.4;
+  BOOST_CHECK(IsRedundantImage(options, keypoints, descriptors, keypoints,
+                               half_descriptors, 100));
+}
+
+BOOST_AUTO_TEST_CASE(TestFindRedundantImages) {
+  SetPRNGSeed(0);
+  Database database(":memory:");
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 100, 100, 100);
+  const camera_t camera_id = database.WriteCamera(camera);
+
+  // Two runs of slowly moving frames and one frame of another scene.
+  const FeatureKeypoints keypoints = CreateRandomFeatureKeypoints(100);
+  const std::vector<FeatureDescriptors> descriptors = {
+      CreateRandomFeatureDescriptors(100), CreateRandomFeatureDescriptors(100)};
+  const std::vector<int> scenes = {0, 0, 0, 0, 1, 0, 0};
+  std::vector<image_t> image_ids;
+  for (size_t i = 0; i < scenes.size(); ++i) {
+    Image image;
+    image.SetName("frame" + std::to_string(i) + ".png");
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(),
+                            ShiftFeatureKeypoints(keypoints, 0.5f * i));
+    database.WriteDescriptors(image_ids.back(), descriptors[scenes[i]]);
+  }
+
+  RedundantImageOptions options;
+  options.num_threads = 2;
+  RedundantImages redundant_images = FindRedundantImages(options, database);
+  BOOST_CHECK(redundant_images.keyframe_ids ==
+              std::vector<image_t>({image_ids[0], image_ids[4], image_ids[5]}));
+  const std::vector<std::pair<image_t, image_t>> redundant_image_ids = {
+      {image_ids[1], image_ids[0]},
+      {image_ids[2], image_ids[0]},
+      {image_ids[3], image_ids[0]},
+      {image_ids[6], image_ids[5]}};
+  BOOST_CHECK(redundant_images.redundant_image_ids == redundant_image_ids);
+
+  options.max_num_consecutive_images = 2;
+  redundant_images = FindRedundantImages(options, database);
+  BOOST_CHECK(redundant_images.keyframe_ids ==
+              std::vector<image_t>({image_ids[0], image_ids[3], image_ids[4],
+                                    image_ids[5]}));
+  BOOST_CHECK_EQUAL(redundant_images.redundant_image_ids.size(), 3);
+}
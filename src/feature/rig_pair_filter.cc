@@ -0,0 +1,214 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "feature/rig_pair_filter.h"
+
+#include <algorithm>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "base/pose.h"
+#include "util/logging.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/string.h"
+
+namespace colmap {
+namespace {
+
+// Half of the diagonal field of view of the camera in radians, determined
+// from the largest angle of the rays through the image corners.
+double ComputeHalfFieldOfView(const Camera& camera) {
+  if (camera.Width() == 0 || camera.Height() == 0) {
+    return -1;
+  }
+
+  double half_fov = 0;
+  for (int i = 0; i < 4; ++i) {
+    const Eigen::Vector2d corner((i & 1) ? camera.Width() : 0,
+                                 (i & 2) ? camera.Height() : 0);
+    const Eigen::Vector2d ray = camera.ImageToWorld(corner);
+    if (!ray.allFinite()) {
+      return -1;
+    }
+    half_fov = std::max(half_fov, std::atan(ray.norm()));
+  }
+
+  return half_fov;
+}
+
+}  // namespace
+
+bool RigPairFilter::Options::Check() const {
+  CHECK_OPTION_GE(max_rig_rotation, 0);
+  CHECK_OPTION_LE(max_rig_rotation, 180);
+  return true;
+}
+
+RigPairFilter::RigPairFilter(const Options& options) : options_(options) {
+  CHECK(options_.Check());
+}
+
+void RigPairFilter::ReadConfig(const std::string& path) {
+  boost::property_tree::ptree pt;
+  boost::property_tree::read_json(path.c_str(), pt);
+
+  size_t rig_idx = 0;
+  for (const auto& rig_config : pt) {
+    for (const auto& camera : rig_config.second.get_child("cameras")) {
+      Eigen::Vector4d rel_qvec = ComposeIdentityQuaternion();
+      const auto rel_qvec_node = camera.second.get_child_optional("rel_qvec");
+      if (rel_qvec_node) {
+        int i = 0;
+        for (const auto& value : rel_qvec_node.get()) {
+          CHECK_LT(i, 4);
+          rel_qvec(i) = value.second.get_value<double>();
+          i += 1;
+        }
+        CHECK_EQ(i, 4);
+      }
+      AddRigCamera(rig_idx, camera.second.get<camera_t>("camera_id"),
+                   camera.second.get<std::string>("image_prefix"),
+                   static_cast<bool>(rel_qvec_node), rel_qvec);
+    }
+    rig_idx += 1;
+  }
+}
+
+void RigPairFilter::AddRigCamera(const size_t rig_idx, const camera_t camera_id,
+                                 const std::string& image_prefix,
+                                 const bool has_rel_qvec,
+                                 const Eigen::Vector4d& rel_qvec) {
+  CHECK(!image_prefix.empty());
+  RigCamera rig_camera;
+  rig_camera.rig_idx = rig_idx;
+  rig_camera.camera_id = camera_id;
+  rig_camera.image_prefix = image_prefix;
+  rig_camera.has_viewing_direction = has_rel_qvec;
+  if (has_rel_qvec) {
+    // The optical axis of the camera is the third row of the rotation from
+    // the rig to the camera frame.
+    rig_camera.viewing_direction =
+        QuaternionToRotationMatrix(NormalizeQuaternion(rel_qvec))
+            .row(2)
+            .transpose();
+  } else {
+    rig_camera.viewing_direction.setZero();
+  }
+  rig_cameras_.push_back(rig_camera);
+}
+
+void RigPairFilter::AddImage(const Image& image, const Camera& camera) {
+  for (size_t rig_camera_idx = 0; rig_camera_idx < rig_cameras_.size();
+       ++rig_camera_idx) {
+    const RigCamera& rig_camera = rig_cameras_[rig_camera_idx];
+    if (rig_camera.camera_id != image.CameraId() ||
+        !StringContains(image.Name(), rig_camera.image_prefix)) {
+      continue;
+    }
+
+    const std::string snapshot_name =
+        std::to_string(rig_camera.rig_idx) + "/" +
+        StringGetAfter(image.Name(), rig_camera.image_prefix);
+    const auto snapshot_idx =
+        snapshot_idxs_.emplace(snapshot_name, snapshot_idxs_.size()).first;
+
+    RigImage& rig_image = images_[image.ImageId()];
+    rig_image.rig_camera_idx = rig_camera_idx;
+    rig_image.snapshot_idx = snapshot_idx->second;
+    rig_image.half_fov = ComputeHalfFieldOfView(camera);
+    return;
+  }
+}
+
+size_t RigPairFilter::NumRigCameras() const { return rig_cameras_.size(); }
+
+size_t RigPairFilter::NumImages() const { return images_.size(); }
+
+bool RigPairFilter::IsMatchable(const image_t image_id1,
+                                const image_t image_id2) const {
+  const auto image1 = images_.find(image_id1);
+  const auto image2 = images_.find(image_id2);
+  if (image1 == images_.end() || image2 == images_.end()) {
+    return true;
+  }
+
+  const RigCamera& rig_camera1 = rig_cameras_[image1->second.rig_camera_idx];
+  const RigCamera& rig_camera2 = rig_cameras_[image2->second.rig_camera_idx];
+  if (rig_camera1.rig_idx != rig_camera2.rig_idx) {
+    return true;
+  }
+
+  const bool same_snapshot =
+      image1->second.snapshot_idx == image2->second.snapshot_idx;
+  if (same_snapshot && options_.skip_intra_snapshot_pairs) {
+    return false;
+  }
+
+  if (!rig_camera1.has_viewing_direction ||
+      !rig_camera2.has_viewing_direction || image1->second.half_fov < 0 ||
+      image2->second.half_fov < 0) {
+    return true;
+  }
+
+  double max_angle = image1->second.half_fov + image2->second.half_fov;
+  if (!same_snapshot) {
+    max_angle += DegToRad(options_.max_rig_rotation);
+  }
+
+  if (max_angle >= M_PI) {
+    return true;
+  }
+
+  const double cos_angle =
+      rig_camera1.viewing_direction.dot(rig_camera2.viewing_direction);
+  return cos_angle >= std::cos(max_angle);
+}
+
+size_t RigPairFilter::Filter(
+    std::vector<std::pair<image_t, image_t>>* image_pairs) const {
+  const size_t num_image_pairs = image_pairs->size();
+  if (images_.empty()) {
+    return 0;
+  }
+
+  image_pairs->erase(
+      std::remove_if(image_pairs->begin(), image_pairs->end(),
+                     [this](const std::pair<image_t, image_t>& image_pair) {
+                       return !IsMatchable(image_pair.first,
+                                           image_pair.second);
+                     }),
+      image_pairs->end());
+
+  return num_image_pairs - image_pairs->size();
+}
+
+}  // namespace colmap
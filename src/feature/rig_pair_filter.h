@@ -0,0 +1,146 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_FEATURE_RIG_PAIR_FILTER_H_
+#define COLMAP_SRC_FEATURE_RIG_PAIR_FILTER_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "base/camera.h"
+#include "base/image.h"
+#include "util/types.h"
+
+namespace colmap {
+
+// Filter for the image pairs of camera rigs, which skips the pairs whose views
+// cannot overlap. The images are assigned to the rig cameras and snapshots by
+// their names, as in the rig bundle adjuster: all images of a rig camera
+// contain its image prefix and the images of a snapshot share the same name
+// after the prefix. The viewing direction of a camera in the rig follows from
+// its rotation relative to the rig and its field of view from the intrinsics.
+// As the baseline of a rig is small compared to the scene depth, two views
+// cannot overlap if the angle between their viewing directions exceeds the sum
+// of their half fields of view. For images of different snapshots, the angle
+// is allowed to grow by the maximum rotation of the rig between the snapshots.
+class RigPairFilter {
+ public:
+  struct Options {
+    // Maximum rotation of a rig in degrees between two of its snapshots. The
+    // default of 180 degrees never skips pairs of different snapshots.
+    double max_rig_rotation = 180.0;
+
+    // Whether to skip all pairs of images within the same snapshot, e.g.,
+    // because the views of the rig cameras only overlap marginally.
+    bool skip_intra_snapshot_pairs = false;
+
+    bool Check() const;
+  };
+
+  explicit RigPairFilter(const Options& options);
+
+  // Read the rig configuration from a JSON file in the format of the rig
+  // bundle adjuster, where each camera can additionally specify its rotation
+  // relative to the rig as a quaternion "rel_qvec": [qw, qx, qy, qz] that
+  // transforms from the rig to the camera frame. The viewing directions of
+  // cameras without a relative rotation are unknown and their pairs are only
+  // skipped within snapshots if `skip_intra_snapshot_pairs` is set.
+  //
+  // An example configuration of a single rig with two opposing cameras:
+  // [
+  //   {
+  //     "ref_camera_id": 1,
+  //     "cameras":
+  //     [
+  //       {
+  //           "camera_id": 1,
+  //           "image_prefix": "front/",
+  //           "rel_qvec": [1, 0, 0, 0]
+  //       },
+  //       {
+  //           "camera_id": 2,
+  //           "image_prefix": "back/",
+  //           "rel_qvec": [0, 0, 1, 0]
+  //       }
+  //     ]
+  //   }
+  // ]
+  void ReadConfig(const std::string& path);
+
+  // Add a camera of the given rig. The rig index is only used to distinguish
+  // the snapshots of different rigs.
+  void AddRigCamera(const size_t rig_idx, const camera_t camera_id,
+                    const std::string& image_prefix, const bool has_rel_qvec,
+                    const Eigen::Vector4d& rel_qvec);
+
+  // Assign an image to its rig camera and snapshot. Images outside of the rigs
+  // are always matched.
+  void AddImage(const Image& image, const Camera& camera);
+
+  size_t NumRigCameras() const;
+  size_t NumImages() const;
+
+  // Whether the views of the two images can overlap.
+  bool IsMatchable(const image_t image_id1, const image_t image_id2) const;
+
+  // Remove the image pairs whose views cannot overlap and return the number
+  // of removed pairs.
+  size_t Filter(std::vector<std::pair<image_t, image_t>>* image_pairs) const;
+
+ private:
+  struct RigCamera {
+    size_t rig_idx;
+    camera_t camera_id;
+    std::string image_prefix;
+    bool has_viewing_direction;
+    // The optical axis of the camera in the rig frame.
+    Eigen::Vector3d viewing_direction;
+  };
+
+  struct RigImage {
+    size_t rig_camera_idx;
+    size_t snapshot_idx;
+    // Half of the diagonal field of view in radians, or a negative value if
+    // the field of view is unknown.
+    double half_fov;
+  };
+
+  const Options options_;
+  std::vector<RigCamera> rig_cameras_;
+  std::unordered_map<image_t, RigImage> images_;
+  std::unordered_map<std::string, size_t> snapshot_idxs_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_FEATURE_RIG_PAIR_FILTER_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "feature/rig_pair_filter"
+#include "util/testing.h"
+
+#include "base/pose.h"
+#include "feature/rig_pair_filter.h"
+
+using namespace colmap;
+
+namespace {
+
+// Add a rig of four cameras with a field of view of 90 degrees, which look
+// into the four horizontal directions, and two of its snapshots.
+void AddRig(RigPairFilter* filter) {
+  const std::vector<std::string> prefixes = {"front/", "right/", "back/",
+                                             "left/"};
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    filter->AddRigCamera(
+        0, i + 1, prefixes[i], true,
+        RotationMatrixToQuaternion(
+            Eigen::AngleAxisd(i * M_PI / 2, Eigen::Vector3d::UnitY())
+                .toRotationMatrix()));
+  }
+
+  for (size_t i = 0; i < prefixes.size(); ++i) {
+    Camera camera;
+    camera.SetCameraId(i + 1);
+    camera.InitializeWithName("SIMPLE_PINHOLE", 50, 100, 100);
+    for (int j = 0; j < 2; ++j) {
+      Image image;
+      image.SetImageId(1 + i + j * prefixes.size());
+      image.SetCameraId(camera.CameraId());
+      image.SetName(prefixes[i] + std::to_string(j) + ".png");
+      filter->AddImage(image, camera);
+    }
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestIntraSnapshotPairs) {
+  RigPairFilter filter{RigPairFilter::Options()};
+  AddRig(&filter);
+  BOOST_CHECK_EQUAL(filter.NumRigCameras(), 4);
+  BOOST_CHECK_EQUAL(filter.NumImages(), 8);
+
+  // The diagonal field of view of the cameras is slightly larger than 90
+  // degrees, such that neighboring cameras overlap but opposing ones not.
+  BOOST_CHECK(filter.IsMatchable(1, 2));
+  BOOST_CHECK(filter.IsMatchable(1, 4));
+  BOOST_CHECK(!filter.IsMatchable(1, 3));
+  BOOST_CHECK(!filter.IsMatchable(2, 4));
+
+  // Images of the same camera and images outside of the rig.
+  BOOST_CHECK(filter.IsMatchable(1, 5));
+  BOOST_CHECK(filter.IsMatchable(1, 9));
+
+  std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {1, 2}, {1, 3}, {2, 4}, {3, 4}};
+  BOOST_CHECK_EQUAL(filter.Filter(&image_pairs), 2);
+  BOOST_CHECK_EQUAL(image_pairs.size(), 2);
+  BOOST_CHECK_EQUAL(image_pairs[0].second, 2);
+  BOOST_CHECK_EQUAL(image_pairs[1].first, 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestInterSnapshotPairs) {
+  RigPairFilter::Options options;
+  RigPairFilter filter1(options);
+  AddRig(&filter1);
+  BOOST_CHECK(filter1.IsMatchable(1, 7));
+  BOOST_CHECK(filter1.IsMatchable(2, 8));
+
+  options.max_rig_rotation = 30;
+  RigPairFilter filter2(options);
+  AddRig(&filter2);
+  BOOST_CHECK(filter2.IsMatchable(1, 6));
+  BOOST_CHECK(!filter2.IsMatchable(1, 7));
+  BOOST_CHECK(!filter2.IsMatchable(2, 8));
+
+  options.skip_intra_snapshot_pairs = true;
+  RigPairFilter filter3(options);
+  AddRig(&filter3);
+  BOOST_CHECK(!filter3.IsMatchable(1, 2));
+  BOOST_CHECK(filter3.IsMatchable(1, 6));
+}
+
+BOOST_AUTO_TEST_CASE(TestUnknownViewingDirection) {
+  RigPairFilter filter{RigPairFilter::Options()};
+  filter.AddRigCamera(0, 1, "front/", false, ComposeIdentityQuaternion());
+  filter.AddRigCamera(0, 2, "back/", false, ComposeIdentityQuaternion());
+
+  Camera camera;
+  camera.InitializeWithName("SIMPLE_PINHOLE", 50, 100, 100);
+  Image image;
+  for (camera_t camera_id = 1; camera_id <= 2; ++camera_id) {
+    camera.SetCameraId(camera_id);
+    image.SetImageId(camera_id);
+    image.SetCameraId(camera_id);
+    image.SetName((camera_id == 1 ? "front/" : "back/") + std::string("0.png"));
+    filter.AddImage(image, camera);
+  }
+
+  BOOST_CHECK_EQUAL(filter.NumImages(), 2);
+  BOOST_CHECK(filter.IsMatchable(1, 2));
+}
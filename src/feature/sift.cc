@@ -31,9 +31,13 @@
 
 #include "feature/sift.h"
 
+#include <algorithm>
 #include <array>
+#include <bitset>
+#include <cmath>
 #include <fstream>
 #include <memory>
+#include <numeric>
 
 #include "FLANN/flann.hpp"
 #include "SiftGPU/SiftGPU.h"
@@ -41,10 +45,12 @@
 #include "VLFeat/sift.h"
 #include "feature/utils.h"
 #include "util/cuda.h"
+#include "util/endian.h"
 #include "util/logging.h"
 #include "util/math.h"
 #include "util/misc.h"
 #include "util/opengl_utils.h"
+#include "util/simd.h"
 
 namespace colmap {
 namespace {
@@ -52,12 +58,14 @@ namespace {
 size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
                                        const float max_ratio,
                                        const float max_distance,
-                                       std::vector<int>* matches) {
+                                       std::vector<int>* matches,
+                                       std::vector<float>* scores) {
   // SIFT descriptor vectors are normalized to length 512.
   const float kDistNorm = 1.0f / (512.0f * 512.0f);
 
   size_t num_matches = 0;
   matches->resize(dists.rows(), -1);
+  scores->resize(dists.rows(), 0);
 
   for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
     int best_i2 = -1;
@@ -98,6 +106,7 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
 
     num_matches += 1;
     (*matches)[i1] = best_i2;
+    (*scores)[i1] = 1.0f - best_dist_normed / second_best_dist_normed;
   }
 
   return num_matches;
@@ -110,13 +119,15 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
   matches->clear();
 
   std::vector<int> matches12;
+  std::vector<float> scores12;
   const size_t num_matches12 = FindBestMatchesOneWayBruteForce(
-      dists, max_ratio, max_distance, &matches12);
+      dists, max_ratio, max_distance, &matches12, &scores12);
 
   if (cross_check) {
     std::vector<int> matches21;
+    std::vector<float> scores21;
     const size_t num_matches21 = FindBestMatchesOneWayBruteForce(
-        dists.transpose(), max_ratio, max_distance, &matches21);
+        dists.transpose(), max_ratio, max_distance, &matches21, &scores21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -124,6 +135,9 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches12[i1];
+        // The match passed the ratio test in both directions, so its quality
+        // is bounded by the worse of the two.
+        match.score = std::min(scores12[i1], scores21[matches12[i1]]);
         matches->push_back(match);
       }
     }
@@ -134,12 +148,86 @@ void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches12[i1];
+        match.score = scores12[i1];
         matches->push_back(match);
       }
     }
   }
 }
 
+inline int CountSetBits(const uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(bits);
+#else
+  return static_cast<int>(std::bitset<64>(bits).count());
+#endif
+}
+
+// Computes the Hamming distances between the binary descriptor and each of
+// the given binary descriptors with four words per descriptor.
+COLMAP_POPCNT_CLONES void ComputeBinaryDescriptorDistances(
+    const uint64_t* descriptor, const uint64_t* descriptors,
+    const size_t num_descriptors, int* dists) {
+  for (size_t i = 0; i < num_descriptors; ++i) {
+    const uint64_t* other_descriptor = descriptors + 4 * i;
+    dists[i] = CountSetBits(descriptor[0] ^ other_descriptor[0]) +
+               CountSetBits(descriptor[1] ^ other_descriptor[1]) +
+               CountSetBits(descriptor[2] ^ other_descriptor[2]) +
+               CountSetBits(descriptor[3] ^ other_descriptor[3]);
+  }
+}
+
+size_t FindBestBinaryMatchesOneWay(
+    const FeatureBinaryDescriptors& descriptors1,
+    const FeatureBinaryDescriptors& descriptors2, const float max_ratio,
+    std::vector<int>* matches, std::vector<float>* scores) {
+  // The maximum Hamming distance, which is used as the second best distance
+  // if there is only a single descriptor to match against.
+  const int kMaxDist = 256;
+
+  size_t num_matches = 0;
+  matches->assign(descriptors1.rows(), -1);
+  scores->assign(descriptors1.rows(), 0);
+
+  std::vector<int> dists(descriptors2.rows());
+  for (Eigen::Index i1 = 0; i1 < descriptors1.rows(); ++i1) {
+    ComputeBinaryDescriptorDistances(descriptors1.row(i1).data(),
+                                     descriptors2.data(), descriptors2.rows(),
+                                     dists.data());
+
+    int best_i2 = -1;
+    int best_dist = kMaxDist;
+    int second_best_dist = kMaxDist;
+    for (Eigen::Index i2 = 0; i2 < descriptors2.rows(); ++i2) {
+      const int dist = dists[i2];
+      if (best_i2 == -1 || dist < best_dist) {
+        best_i2 = i2;
+        second_best_dist = best_dist;
+        best_dist = dist;
+      } else if (dist < second_best_dist) {
+        second_best_dist = dist;
+      }
+    }
+
+    // Check if any match found or if the two best matches are both exact.
+    if (best_i2 == -1 || second_best_dist == 0) {
+      continue;
+    }
+
+    // Check if match passes ratio test.
+    const float ratio = static_cast<float>(best_dist) / second_best_dist;
+    if (ratio >= max_ratio) {
+      continue;
+    }
+
+    num_matches += 1;
+    (*matches)[i1] = best_i2;
+    (*scores)[i1] = 1.0f - ratio;
+  }
+
+  return num_matches;
+}
+
 // Mutexes that ensure that only one thread extracts/matches on the same GPU
 // at the same time, since SiftGPU internally uses static variables.
 static std::map<int, std::unique_ptr<std::mutex>> sift_extraction_mutexes;
@@ -147,22 +235,35 @@ static std::map<int, std::unique_ptr<std::mutex>> sift_matching_mutexes;
 
 // VLFeat uses a different convention to store its descriptors. This transforms
 // the VLFeat format into the original SIFT format that is also used by SiftGPU.
-FeatureDescriptors TransformVLFeatToUBCFeatureDescriptors(
-    const FeatureDescriptors& vlfeat_descriptors) {
-  FeatureDescriptors ubc_descriptors(vlfeat_descriptors.rows(),
-                                     vlfeat_descriptors.cols());
+Eigen::Matrix<float, 1, 128> TransformVLFeatToUBCFeatureDescriptor(
+    const Eigen::Matrix<float, 1, 128>& vlfeat_descriptor) {
+  Eigen::Matrix<float, 1, 128> ubc_descriptor;
   const std::array<int, 8> q{{0, 7, 6, 5, 4, 3, 2, 1}};
-  for (FeatureDescriptors::Index n = 0; n < vlfeat_descriptors.rows(); ++n) {
-    for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        for (int k = 0; k < 8; ++k) {
-          ubc_descriptors(n, 8 * (j + 4 * i) + q[k]) =
-              vlfeat_descriptors(n, 8 * (j + 4 * i) + k);
-        }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      for (int k = 0; k < 8; ++k) {
+        ubc_descriptor(8 * (j + 4 * i) + q[k]) =
+            vlfeat_descriptor(8 * (j + 4 * i) + k);
       }
     }
   }
-  return ubc_descriptors;
+  return ubc_descriptor;
+}
+
+// Normalize the floating point descriptor and convert it to unsigned bytes in
+// a single pass over the descriptor.
+void NormalizeFeatureDescriptorToUnsignedByte(
+    const SiftExtractionOptions::Normalization normalization,
+    const float* descriptor, const int num_dims, uint8_t* descriptor_uint8) {
+  if (normalization == SiftExtractionOptions::Normalization::L2) {
+    L2NormalizeFeatureDescriptorToUnsignedByte(descriptor, num_dims,
+                                               descriptor_uint8);
+  } else if (normalization == SiftExtractionOptions::Normalization::L1_ROOT) {
+    L1RootNormalizeFeatureDescriptorToUnsignedByte(descriptor, num_dims,
+                                                   descriptor_uint8);
+  } else {
+    LOG(FATAL) << "Normalization type not supported";
+  }
 }
 
 Eigen::MatrixXi ComputeSiftDistanceMatrix(
@@ -210,40 +311,8 @@ void FindNearestNeighborsFLANN(
     return;
   }
 
-  const size_t kNumNearestNeighbors = 2;
-  const size_t kNumTreesInForest = 4;
-
-  const size_t num_nearest_neighbors =
-      std::min(kNumNearestNeighbors, static_cast<size_t>(database.rows()));
-
-  indices->resize(query.rows(), num_nearest_neighbors);
-  distances->resize(query.rows(), num_nearest_neighbors);
-  const flann::Matrix<uint8_t> query_matrix(const_cast<uint8_t*>(query.data()),
-                                            query.rows(), 128);
-  const flann::Matrix<uint8_t> database_matrix(
-      const_cast<uint8_t*>(database.data()), database.rows(), 128);
-
-  flann::Matrix<int> indices_matrix(indices->data(), query.rows(),
-                                    num_nearest_neighbors);
-  std::vector<float> distances_vector(query.rows() * num_nearest_neighbors);
-  flann::Matrix<float> distances_matrix(distances_vector.data(), query.rows(),
-                                        num_nearest_neighbors);
-  flann::Index<flann::L2<uint8_t>> index(
-      database_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
-  index.buildIndex();
-  index.knnSearch(query_matrix, indices_matrix, distances_matrix,
-                  num_nearest_neighbors, flann::SearchParams(128));
-
-  for (Eigen::Index query_index = 0; query_index < indices->rows();
-       ++query_index) {
-    for (Eigen::Index k = 0; k < indices->cols(); ++k) {
-      const Eigen::Index database_index = indices->coeff(query_index, k);
-      distances->coeffRef(query_index, k) =
-          query.row(query_index)
-              .cast<int>()
-              .dot(database.row(database_index).cast<int>());
-    }
-  }
+  const SiftDescriptorIndex index(database);
+  index.Search(query, indices, distances);
 }
 
 size_t FindBestMatchesOneWayFLANN(
@@ -252,12 +321,13 @@ size_t FindBestMatchesOneWayFLANN(
     const Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>&
         distances,
     const float max_ratio, const float max_distance,
-    std::vector<int>* matches) {
+    std::vector<int>* matches, std::vector<float>* scores) {
   // SIFT descriptor vectors are normalized to length 512.
   const float kDistNorm = 1.0f / (512.0f * 512.0f);
 
   size_t num_matches = 0;
   matches->resize(indices.rows(), -1);
+  scores->resize(indices.rows(), 0);
 
   for (int d1_idx = 0; d1_idx < indices.rows(); ++d1_idx) {
     int best_i2 = -1;
@@ -299,6 +369,7 @@ size_t FindBestMatchesOneWayFLANN(
 
     num_matches += 1;
     (*matches)[d1_idx] = best_i2;
+    (*scores)[d1_idx] = 1.0f - best_dist_normed / second_best_dist_normed;
   }
 
   return num_matches;
@@ -318,13 +389,17 @@ void FindBestMatchesFLANN(
   matches->clear();
 
   std::vector<int> matches12;
-  const size_t num_matches12 = FindBestMatchesOneWayFLANN(
-      indices_1to2, distances_1to2, max_ratio, max_distance, &matches12);
+  std::vector<float> scores12;
+  const size_t num_matches12 =
+      FindBestMatchesOneWayFLANN(indices_1to2, distances_1to2, max_ratio,
+                                 max_distance, &matches12, &scores12);
 
   if (cross_check && indices_2to1.rows()) {
     std::vector<int> matches21;
-    const size_t num_matches21 = FindBestMatchesOneWayFLANN(
-        indices_2to1, distances_2to1, max_ratio, max_distance, &matches21);
+    std::vector<float> scores21;
+    const size_t num_matches21 =
+        FindBestMatchesOneWayFLANN(indices_2to1, distances_2to1, max_ratio,
+                                   max_distance, &matches21, &scores21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -332,6 +407,9 @@ void FindBestMatchesFLANN(
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches12[i1];
+        // The match passed the ratio test in both directions, so its quality
+        // is bounded by the worse of the two.
+        match.score = std::min(scores12[i1], scores21[matches12[i1]]);
         matches->push_back(match);
       }
     }
@@ -342,12 +420,248 @@ void FindBestMatchesFLANN(
         FeatureMatch match;
         match.point2D_idx1 = i1;
         match.point2D_idx2 = matches12[i1];
+        match.score = scores12[i1];
         matches->push_back(match);
       }
     }
   }
 }
 
+// Uniform grid over the keypoint locations of an image, which is used to
+// find the candidate keypoints close to a point or an epipolar line. The
+// returned candidates are a superset of the keypoints within the query
+// region, since all keypoints of the overlapping grid cells are returned.
+class FeatureKeypointGrid {
+ public:
+  FeatureKeypointGrid(const FeatureKeypoints& keypoints,
+                      const float min_cell_size) {
+    num_keypoints_ = static_cast<int>(keypoints.size());
+
+    float max_x = 0;
+    float max_y = 0;
+    min_x_ = 0;
+    min_y_ = 0;
+    if (!keypoints.empty()) {
+      min_x_ = max_x = keypoints[0].x;
+      min_y_ = max_y = keypoints[0].y;
+    }
+    for (const auto& keypoint : keypoints) {
+      min_x_ = std::min(min_x_, keypoint.x);
+      min_y_ = std::min(min_y_, keypoint.y);
+      max_x = std::max(max_x, keypoint.x);
+      max_y = std::max(max_y, keypoint.y);
+    }
+
+    // Choose the cell size such that every cell contains a few keypoints on
+    // average, while limiting the total number of cells.
+    const float kNumKeypointsPerCell = 4.0f;
+    const int kMaxGridSize = 1024;
+    const float extent = std::max(max_x - min_x_, max_y - min_y_);
+    const float area = std::max((max_x - min_x_) * (max_y - min_y_), 1.0f);
+    cell_size_ = std::max(
+        {min_cell_size, extent / kMaxGridSize, 1.0f,
+         std::sqrt(area * kNumKeypointsPerCell /
+                   std::max(num_keypoints_, 1))});
+
+    num_cols_ = static_cast<int>((max_x - min_x_) / cell_size_) + 1;
+    num_rows_ = static_cast<int>((max_y - min_y_) / cell_size_) + 1;
+
+    cells_.resize(num_cols_ * num_rows_);
+    for (int i = 0; i < num_keypoints_; ++i) {
+      const int col = std::min(
+          static_cast<int>((keypoints[i].x - min_x_) / cell_size_),
+          num_cols_ - 1);
+      const int row = std::min(
+          static_cast<int>((keypoints[i].y - min_y_) / cell_size_),
+          num_rows_ - 1);
+      cells_[row * num_cols_ + col].push_back(i);
+    }
+  }
+
+  // Find the keypoints within the given radius around the point.
+  void QueryPoint(const float x, const float y, const float radius,
+                  std::vector<int>* idxs) const {
+    if (!std::isfinite(x) || !std::isfinite(y)) {
+      QueryAll(idxs);
+      return;
+    }
+
+    const int min_col = ToCol(x - radius);
+    const int max_col = ToCol(x + radius);
+    const int min_row = ToRow(y - radius);
+    const int max_row = ToRow(y + radius);
+    for (int row = min_row; row <= max_row; ++row) {
+      QueryCells(row, min_col, max_col, idxs);
+    }
+  }
+
+  // Find the keypoints within the given distance to the line
+  // `a * x + b * y + c = 0`.
+  void QueryLine(const float a, const float b, const float c,
+                 const float radius, std::vector<int>* idxs) const {
+    const float norm = std::sqrt(a * a + b * b);
+    if (!std::isfinite(norm) || !std::isfinite(c) || norm == 0) {
+      QueryAll(idxs);
+      return;
+    }
+
+    const float a_n = a / norm;
+    const float b_n = b / norm;
+    const float c_n = c / norm;
+
+    if (std::abs(b_n) >= std::abs(a_n)) {
+      // Mostly horizontal line, so traverse the grid column by column.
+      const float y_radius = radius / std::abs(b_n);
+      for (int col = 0; col < num_cols_; ++col) {
+        const float x0 = min_x_ + col * cell_size_;
+        const float x1 = x0 + cell_size_;
+        const float y0 = -(a_n * x0 + c_n) / b_n;
+        const float y1 = -(a_n * x1 + c_n) / b_n;
+        const int min_row = ToRow(std::min(y0, y1) - y_radius);
+        const int max_row = ToRow(std::max(y0, y1) + y_radius);
+        for (int row = min_row; row <= max_row; ++row) {
+          QueryCells(row, col, col, idxs);
+        }
+      }
+    } else {
+      // Mostly vertical line, so traverse the grid row by row.
+      const float x_radius = radius / std::abs(a_n);
+      for (int row = 0; row < num_rows_; ++row) {
+        const float y0 = min_y_ + row * cell_size_;
+        const float y1 = y0 + cell_size_;
+        const float x0 = -(b_n * y0 + c_n) / a_n;
+        const float x1 = -(b_n * y1 + c_n) / a_n;
+        const int min_col = ToCol(std::min(x0, x1) - x_radius);
+        const int max_col = ToCol(std::max(x0, x1) + x_radius);
+        QueryCells(row, min_col, max_col, idxs);
+      }
+    }
+  }
+
+ private:
+  int ToCol(const float x) const {
+    const float col = std::floor((x - min_x_) / cell_size_);
+    return static_cast<int>(
+        std::max(0.0f, std::min(col, static_cast<float>(num_cols_))));
+  }
+
+  int ToRow(const float y) const {
+    const float row = std::floor((y - min_y_) / cell_size_);
+    return static_cast<int>(
+        std::max(0.0f, std::min(row, static_cast<float>(num_rows_))));
+  }
+
+  void QueryCells(const int row, const int min_col, const int max_col,
+                  std::vector<int>* idxs) const {
+    if (row >= num_rows_) {
+      return;
+    }
+    for (int col = min_col; col <= std::min(max_col, num_cols_ - 1); ++col) {
+      const auto& cell = cells_[row * num_cols_ + col];
+      idxs->insert(idxs->end(), cell.begin(), cell.end());
+    }
+  }
+
+  void QueryAll(std::vector<int>* idxs) const {
+    for (int i = 0; i < num_keypoints_; ++i) {
+      idxs->push_back(i);
+    }
+  }
+
+  int num_keypoints_;
+  float min_x_;
+  float min_y_;
+  float cell_size_;
+  int num_cols_;
+  int num_rows_;
+  std::vector<std::vector<int>> cells_;
+};
+
+// Find the candidate matches for guided matching, i.e. a superset of all
+// pairs of keypoints that are consistent with the given two-view geometry.
+// Returns the sorted candidate keypoint indices in the second image for each
+// keypoint in the first image.
+std::vector<std::vector<int>> FindGuidedMatchCandidates(
+    const FeatureKeypoints& keypoints1, const FeatureKeypoints& keypoints2,
+    const TwoViewGeometry& two_view_geometry, const float max_residual) {
+  std::vector<std::vector<int>> candidates(keypoints1.size());
+
+  // Small margin on the search radius to account for rounding errors.
+  const float kRadiusMargin = 1.01f;
+
+  if (two_view_geometry.config == TwoViewGeometry::CALIBRATED ||
+      two_view_geometry.config == TwoViewGeometry::UNCALIBRATED) {
+    // The squared Sampson error is consistent with the threshold only if the
+    // squared distance of one of the points to the epipolar line of the
+    // other point is below twice the threshold. The candidates are thus
+    // found from the epipolar lines in both images.
+    const float radius = kRadiusMargin * std::sqrt(2 * max_residual);
+    const Eigen::Matrix3f F = two_view_geometry.F.cast<float>();
+
+    const FeatureKeypointGrid grid2(keypoints2, radius);
+    for (size_t i1 = 0; i1 < keypoints1.size(); ++i1) {
+      const Eigen::Vector3f line =
+          F * Eigen::Vector3f(keypoints1[i1].x, keypoints1[i1].y, 1.0f);
+      grid2.QueryLine(line(0), line(1), line(2), radius, &candidates[i1]);
+    }
+
+    const FeatureKeypointGrid grid1(keypoints1, radius);
+    std::vector<int> candidates1;
+    for (size_t i2 = 0; i2 < keypoints2.size(); ++i2) {
+      const Eigen::Vector3f line =
+          F.transpose() *
+          Eigen::Vector3f(keypoints2[i2].x, keypoints2[i2].y, 1.0f);
+      candidates1.clear();
+      grid1.QueryLine(line(0), line(1), line(2), radius, &candidates1);
+      for (const int i1 : candidates1) {
+        candidates[i1].push_back(static_cast<int>(i2));
+      }
+    }
+  } else if (two_view_geometry.config == TwoViewGeometry::PLANAR ||
+             two_view_geometry.config == TwoViewGeometry::PANORAMIC ||
+             two_view_geometry.config ==
+                 TwoViewGeometry::PLANAR_OR_PANORAMIC) {
+    const float radius = kRadiusMargin * std::sqrt(max_residual);
+    const Eigen::Matrix3f H = two_view_geometry.H.cast<float>();
+
+    const FeatureKeypointGrid grid2(keypoints2, radius);
+    for (size_t i1 = 0; i1 < keypoints1.size(); ++i1) {
+      const Eigen::Vector2f point2 =
+          (H * Eigen::Vector3f(keypoints1[i1].x, keypoints1[i1].y, 1.0f))
+              .hnormalized();
+      grid2.QueryPoint(point2(0), point2(1), radius, &candidates[i1]);
+    }
+  }
+
+  for (auto& candidates2 : candidates) {
+    std::sort(candidates2.begin(), candidates2.end());
+    candidates2.erase(std::unique(candidates2.begin(), candidates2.end()),
+                      candidates2.end());
+  }
+
+  return candidates;
+}
+
+// Keep track of the best and second best distance in the same order as
+// `FindBestMatchesOneWayFLANN` evaluates the neighbors, such that the sparse
+// neighbors yield the same result as all neighbors.
+void UpdateBestNeighbors(
+    const int idx, const int dist, const int row,
+    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+        indices,
+    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+        distances) {
+  if (dist > (*distances)(row, 0)) {
+    (*indices)(row, 1) = (*indices)(row, 0);
+    (*distances)(row, 1) = (*distances)(row, 0);
+    (*indices)(row, 0) = idx;
+    (*distances)(row, 0) = dist;
+  } else if (dist > (*distances)(row, 1)) {
+    (*indices)(row, 1) = idx;
+    (*distances)(row, 1) = dist;
+  }
+}
+
 void WarnIfMaxNumMatchesReachedGPU(const SiftMatchGPU& sift_match_gpu,
                                    const FeatureDescriptors& descriptors) {
   if (sift_match_gpu.GetMaxSift() < descriptors.rows()) {
@@ -364,59 +678,34 @@ void WarnDarknessAdaptivityNotAvailable() {
             << std::endl;
 }
 
-}  // namespace
-
-bool SiftExtractionOptions::Check() const {
-  if (use_gpu) {
-    CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
-  }
-  CHECK_OPTION_GT(max_image_size, 0);
-  CHECK_OPTION_GT(max_num_features, 0);
-  CHECK_OPTION_GT(octave_resolution, 0);
-  CHECK_OPTION_GT(peak_threshold, 0.0);
-  CHECK_OPTION_GT(edge_threshold, 0.0);
-  CHECK_OPTION_GT(max_num_orientations, 0);
-  if (domain_size_pooling) {
-    CHECK_OPTION_GT(dsp_min_scale, 0);
-    CHECK_OPTION_GE(dsp_max_scale, dsp_min_scale);
-    CHECK_OPTION_GT(dsp_num_scales, 0);
-  }
-  return true;
-}
-
-bool SiftMatchingOptions::Check() const {
-  if (use_gpu) {
-    CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+// Convert the grayscale bitmap to a row-major array with intensities in the
+// range [0, 1], as expected by VLFeat.
+std::vector<float> ConvertBitmapToFloatArray(const Bitmap& bitmap) {
+  // Convert the scanlines directly to avoid an intermediate copy of the image.
+  const int width = bitmap.Width();
+  const int height = bitmap.Height();
+  std::vector<float> data_float(static_cast<size_t>(width) * height);
+  float* data = data_float.data();
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* line = bitmap.GetScanline(y);
+    for (int x = 0; x < width; ++x) {
+      data[x] = static_cast<float>(line[x]) / 255.0f;
+    }
+    data += width;
   }
-  CHECK_OPTION_GT(max_ratio, 0.0);
-  CHECK_OPTION_GT(max_distance, 0.0);
-  CHECK_OPTION_GT(max_error, 0.0);
-  CHECK_OPTION_GE(min_num_trials, 0);
-  CHECK_OPTION_GT(max_num_trials, 0);
-  CHECK_OPTION_LE(min_num_trials, max_num_trials);
-  CHECK_OPTION_GE(min_inlier_ratio, 0);
-  CHECK_OPTION_LE(min_inlier_ratio, 1);
-  CHECK_OPTION_GE(min_num_inliers, 0);
-  return true;
+  return data_float;
 }
 
-bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
-                            const Bitmap& bitmap, FeatureKeypoints* keypoints,
-                            FeatureDescriptors* descriptors) {
-  CHECK(options.Check());
-  CHECK(bitmap.IsGrey());
-  CHECK_NOTNULL(keypoints);
-
-  CHECK(!options.estimate_affine_shape);
-  CHECK(!options.domain_size_pooling);
-
-  if (options.darkness_adaptivity) {
-    WarnDarknessAdaptivityNotAvailable();
-  }
-
+// Extract SIFT features from a row-major grayscale image with intensities in
+// the range [0, 1]. The output keypoints are expected to be empty.
+bool ExtractSiftFeaturesFromFloatArrayCPU(const SiftExtractionOptions& options,
+                                          const float* data, const int width,
+                                          const int height,
+                                          FeatureKeypoints* keypoints,
+                                          FeatureDescriptors* descriptors) {
   // Setup SIFT extractor.
   std::unique_ptr<VlSiftFilt, void (*)(VlSiftFilt*)> sift(
-      vl_sift_new(bitmap.Width(), bitmap.Height(), options.num_octaves,
+      vl_sift_new(width, height, options.num_octaves,
                   options.octave_resolution, options.first_octave),
       &vl_sift_delete);
   if (!sift) {
@@ -433,12 +722,7 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
   bool first_octave = true;
   while (true) {
     if (first_octave) {
-      const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-      std::vector<float> data_float(data_uint8.size());
-      for (size_t i = 0; i < data_uint8.size(); ++i) {
-        data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-      }
-      if (vl_sift_process_first_octave(sift.get(), data_float.data())) {
+      if (vl_sift_process_first_octave(sift.get(), data)) {
         break;
       }
       first_octave = false;
@@ -507,21 +791,13 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
             FeatureKeypoint(vl_keypoints[i].x + 0.5f, vl_keypoints[i].y + 0.5f,
                             vl_keypoints[i].sigma, angles[o]);
         if (descriptors != nullptr) {
-          Eigen::MatrixXf desc(1, 128);
+          Eigen::Matrix<float, 1, 128> desc;
           vl_sift_calc_keypoint_descriptor(sift.get(), desc.data(),
                                            &vl_keypoints[i], angles[o]);
-          if (options.normalization ==
-              SiftExtractionOptions::Normalization::L2) {
-            desc = L2NormalizeFeatureDescriptors(desc);
-          } else if (options.normalization ==
-                     SiftExtractionOptions::Normalization::L1_ROOT) {
-            desc = L1RootNormalizeFeatureDescriptors(desc);
-          } else {
-            LOG(FATAL) << "Normalization type not supported";
-          }
-
-          level_descriptors.back().row(level_idx) =
-              FeatureDescriptorsToUnsignedByte(desc);
+          desc = TransformVLFeatToUBCFeatureDescriptor(desc);
+          NormalizeFeatureDescriptorToUnsignedByte(
+              options.normalization, desc.data(), 128,
+              level_descriptors.back().row(level_idx).data());
         }
 
         level_idx += 1;
@@ -570,24 +846,18 @@ bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
         k += 1;
       }
     }
-    *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
   }
 
   return true;
 }
 
-bool ExtractCovariantSiftFeaturesCPU(const SiftExtractionOptions& options,
-                                     const Bitmap& bitmap,
-                                     FeatureKeypoints* keypoints,
-                                     FeatureDescriptors* descriptors) {
-  CHECK(options.Check());
-  CHECK(bitmap.IsGrey());
-  CHECK_NOTNULL(keypoints);
-
-  if (options.darkness_adaptivity) {
-    WarnDarknessAdaptivityNotAvailable();
-  }
-
+// Extract covariant SIFT features from a row-major grayscale image with
+// intensities in the range [0, 1]. The output keypoints are expected to be
+// empty.
+bool ExtractCovariantSiftFeaturesFromFloatArrayCPU(
+    const SiftExtractionOptions& options, const float* data, const int width,
+    const int height, FeatureKeypoints* keypoints,
+    FeatureDescriptors* descriptors) {
   // Setup covariant SIFT detector.
   std::unique_ptr<VlCovDet, void (*)(VlCovDet*)> covdet(
       vl_covdet_new(VL_COVDET_METHOD_DOG), &vl_covdet_delete);
@@ -603,15 +873,7 @@ bool ExtractCovariantSiftFeaturesCPU(const SiftExtractionOptions& options,
   vl_covdet_set_peak_threshold(covdet.get(), options.peak_threshold);
   vl_covdet_set_edge_threshold(covdet.get(), options.edge_threshold);
 
-  {
-    const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-    std::vector<float> data_float(data_uint8.size());
-    for (size_t i = 0; i < data_uint8.size(); ++i) {
-      data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-    }
-    vl_covdet_put_image(covdet.get(), data_float.data(), bitmap.Width(),
-                        bitmap.Height());
-  }
+  vl_covdet_put_image(covdet.get(), data, width, height);
 
   vl_covdet_detect(covdet.get(), options.max_num_features);
 
@@ -730,19 +992,363 @@ bool ExtractCovariantSiftFeaturesCPU(const SiftExtractionOptions& options,
         descriptor = scaled_descriptors;
       }
 
-      if (options.normalization == SiftExtractionOptions::Normalization::L2) {
-        descriptor = L2NormalizeFeatureDescriptors(descriptor);
-      } else if (options.normalization ==
-                 SiftExtractionOptions::Normalization::L1_ROOT) {
-        descriptor = L1RootNormalizeFeatureDescriptors(descriptor);
-      } else {
-        LOG(FATAL) << "Normalization type not supported";
+      descriptor = TransformVLFeatToUBCFeatureDescriptor(descriptor);
+      NormalizeFeatureDescriptorToUnsignedByte(options.normalization,
+                                               descriptor.data(), 128,
+                                               descriptors->row(i).data());
+    }
+  }
+
+  return true;
+}
+
+// Convert the features extracted by SiftGPU with the given indices, whose
+// coordinates are offset by the given minimum, and keep the largest-scale
+// features. Only the descriptors of the kept features are normalized.
+void ConvertSiftGPUFeatures(
+    const SiftExtractionOptions& options,
+    const std::vector<SiftKeypoint>& keypoints_data,
+    const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                        Eigen::RowMajor>& descriptors_float,
+    const std::vector<size_t>& feature_idxs, const float min_x,
+    const float min_y, FeatureKeypoints* keypoints,
+    FeatureDescriptors* descriptors) {
+  FeatureKeypoints all_keypoints(feature_idxs.size());
+  for (size_t i = 0; i < feature_idxs.size(); ++i) {
+    const SiftKeypoint& keypoint = keypoints_data[feature_idxs[i]];
+    all_keypoints[i] = FeatureKeypoint(keypoint.x - min_x, keypoint.y - min_y,
+                                       keypoint.s, keypoint.o);
+  }
+
+  const std::vector<size_t> top_scale_idxs =
+      SelectTopScaleFeatures(all_keypoints, options.max_num_features);
+
+  keypoints->resize(top_scale_idxs.size());
+  descriptors->resize(top_scale_idxs.size(), 128);
+  for (size_t i = 0; i < top_scale_idxs.size(); ++i) {
+    (*keypoints)[i] = all_keypoints[top_scale_idxs[i]];
+    NormalizeFeatureDescriptorToUnsignedByte(
+        options.normalization,
+        descriptors_float.row(feature_idxs[top_scale_idxs[i]]).data(), 128,
+        descriptors->row(i).data());
+  }
+}
+
+}  // namespace
+
+struct SiftDescriptorIndex::Index {
+  explicit Index(const FeatureDescriptors& descriptors)
+      : descriptors(descriptors) {
+    CHECK_EQ(descriptors.cols(), 128);
+    // FLANN cannot build an index without any points.
+    if (descriptors.rows() > 0) {
+      flann_index.reset(new flann::Index<flann::L2<uint8_t>>(
+          flann::Matrix<uint8_t>(
+              const_cast<uint8_t*>(this->descriptors.data()),
+              this->descriptors.rows(), this->descriptors.cols()),
+          flann::KDTreeIndexParams(kNumTreesInForest)));
+      flann_index->buildIndex();
+    }
+  }
+
+  static const int kNumTreesInForest = 4;
+
+  const FeatureDescriptors descriptors;
+  std::unique_ptr<flann::Index<flann::L2<uint8_t>>> flann_index;
+};
+
+SiftDescriptorIndex::SiftDescriptorIndex(const FeatureDescriptors& descriptors)
+    : index_(new Index(descriptors)) {}
+
+SiftDescriptorIndex::SiftDescriptorIndex(SiftDescriptorIndex&& other) = default;
+
+SiftDescriptorIndex::~SiftDescriptorIndex() {}
+
+size_t SiftDescriptorIndex::NumDescriptors() const {
+  return index_->descriptors.rows();
+}
+
+const FeatureDescriptors& SiftDescriptorIndex::Descriptors() const {
+  return index_->descriptors;
+}
+
+void SiftDescriptorIndex::Search(
+    const FeatureDescriptors& query,
+    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+        indices,
+    Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+        distances) const {
+  CHECK_NOTNULL(indices);
+  CHECK_NOTNULL(distances);
+
+  const FeatureDescriptors& database = index_->descriptors;
+  if (query.rows() == 0 || database.rows() == 0) {
+    return;
+  }
+
+  const size_t kNumNearestNeighbors = 2;
+
+  const size_t num_nearest_neighbors =
+      std::min(kNumNearestNeighbors, static_cast<size_t>(database.rows()));
+
+  indices->resize(query.rows(), num_nearest_neighbors);
+  distances->resize(query.rows(), num_nearest_neighbors);
+  const flann::Matrix<uint8_t> query_matrix(const_cast<uint8_t*>(query.data()),
+                                            query.rows(), 128);
+
+  flann::Matrix<int> indices_matrix(indices->data(), query.rows(),
+                                    num_nearest_neighbors);
+  std::vector<float> distances_vector(query.rows() * num_nearest_neighbors);
+  flann::Matrix<float> distances_matrix(distances_vector.data(), query.rows(),
+                                        num_nearest_neighbors);
+  index_->flann_index->knnSearch(query_matrix, indices_matrix,
+                                 distances_matrix, num_nearest_neighbors,
+                                 flann::SearchParams(128));
+
+  for (Eigen::Index query_index = 0; query_index < indices->rows();
+       ++query_index) {
+    for (Eigen::Index k = 0; k < indices->cols(); ++k) {
+      const Eigen::Index database_index = indices->coeff(query_index, k);
+      distances->coeffRef(query_index, k) =
+          query.row(query_index)
+              .cast<int>()
+              .dot(database.row(database_index).cast<int>());
+    }
+  }
+}
+
+bool SiftExtractionOptions::Check() const {
+  if (use_gpu) {
+    CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+  }
+  CHECK_OPTION_GT(max_writer_batch_size, 0);
+  CHECK_OPTION_GE(max_writer_batch_delay_ms, 0);
+  CHECK_OPTION_GT(max_image_size, 0);
+  CHECK_OPTION_GT(max_num_features, 0);
+  CHECK_OPTION_GT(octave_resolution, 0);
+  CHECK_OPTION_GT(peak_threshold, 0.0);
+  CHECK_OPTION_GT(edge_threshold, 0.0);
+  CHECK_OPTION_GT(max_num_orientations, 0);
+  CHECK_OPTION_GE(tile_overlap, 0);
+  CHECK_OPTION_GT(gpu_batch_size, 0);
+  if (domain_size_pooling) {
+    CHECK_OPTION_GT(dsp_min_scale, 0);
+    CHECK_OPTION_GE(dsp_max_scale, dsp_min_scale);
+    CHECK_OPTION_GT(dsp_num_scales, 0);
+  }
+  return true;
+}
+
+bool SiftMatchingOptions::Check() const {
+  if (use_gpu) {
+    CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+  }
+  CHECK_OPTION_GT(max_ratio, 0.0);
+  CHECK_OPTION_GT(max_distance, 0.0);
+  CHECK_OPTION_GT(max_error, 0.0);
+  CHECK_OPTION_GE(min_num_trials, 0);
+  CHECK_OPTION_GT(max_num_trials, 0);
+  CHECK_OPTION_LE(min_num_trials, max_num_trials);
+  CHECK_OPTION_GE(min_inlier_ratio, 0);
+  CHECK_OPTION_LE(min_inlier_ratio, 1);
+  CHECK_OPTION_GE(min_num_inliers, 0);
+  return true;
+}
+
+bool ExtractSiftFeaturesCPU(const SiftExtractionOptions& options,
+                            const Bitmap& bitmap, FeatureKeypoints* keypoints,
+                            FeatureDescriptors* descriptors) {
+  CHECK(options.Check());
+  CHECK(bitmap.IsGrey());
+  CHECK_NOTNULL(keypoints);
+
+  CHECK(!options.estimate_affine_shape);
+  CHECK(!options.domain_size_pooling);
+
+  if (options.darkness_adaptivity) {
+    WarnDarknessAdaptivityNotAvailable();
+  }
+
+  const std::vector<float> data_float = ConvertBitmapToFloatArray(bitmap);
+  keypoints->clear();
+  return ExtractSiftFeaturesFromFloatArrayCPU(options, data_float.data(),
+                                              bitmap.Width(), bitmap.Height(),
+                                              keypoints, descriptors);
+}
+
+bool ExtractCovariantSiftFeaturesCPU(const SiftExtractionOptions& options,
+                                     const Bitmap& bitmap,
+                                     FeatureKeypoints* keypoints,
+                                     FeatureDescriptors* descriptors) {
+  CHECK(options.Check());
+  CHECK(bitmap.IsGrey());
+  CHECK_NOTNULL(keypoints);
+
+  if (options.darkness_adaptivity) {
+    WarnDarknessAdaptivityNotAvailable();
+  }
+
+  const std::vector<float> data_float = ConvertBitmapToFloatArray(bitmap);
+  keypoints->clear();
+  return ExtractCovariantSiftFeaturesFromFloatArrayCPU(
+      options, data_float.data(), bitmap.Width(), bitmap.Height(), keypoints,
+      descriptors);
+}
+
+bool ExtractSiftFeaturesCPUTiled(const SiftExtractionOptions& options,
+                                 const Bitmap& bitmap, ThreadPool* thread_pool,
+                                 FeatureKeypoints* keypoints,
+                                 FeatureDescriptors* descriptors) {
+  CHECK(options.Check());
+  CHECK(bitmap.IsGrey());
+  CHECK_NOTNULL(thread_pool);
+  CHECK_NOTNULL(keypoints);
+  CHECK_GT(options.tile_size, 0);
+
+  if (options.darkness_adaptivity) {
+    WarnDarknessAdaptivityNotAvailable();
+  }
+
+  const bool covariant =
+      options.estimate_affine_shape || options.domain_size_pooling;
+
+  const int width = bitmap.Width();
+  const int height = bitmap.Height();
+  const std::vector<float> data_float = ConvertBitmapToFloatArray(bitmap);
+
+  // Partition the image into tiles of (almost) equal size, whose dimensions
+  // do not exceed the tile size.
+  const int num_tiles_x = (width + options.tile_size - 1) / options.tile_size;
+  const int num_tiles_y = (height + options.tile_size - 1) / options.tile_size;
+  const int tile_width = (width + num_tiles_x - 1) / num_tiles_x;
+  const int tile_height = (height + num_tiles_y - 1) / num_tiles_y;
+
+  struct Tile {
+    // The non-overlapping part of the tile.
+    int min_x, min_y, max_x, max_y;
+    bool success = false;
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+  };
+
+  std::vector<Tile> tiles;
+  tiles.reserve(num_tiles_x * num_tiles_y);
+  for (int tile_y = 0; tile_y < num_tiles_y; ++tile_y) {
+    for (int tile_x = 0; tile_x < num_tiles_x; ++tile_x) {
+      Tile tile;
+      tile.min_x = tile_x * tile_width;
+      tile.min_y = tile_y * tile_height;
+      tile.max_x = std::min(width, tile.min_x + tile_width);
+      tile.max_y = std::min(height, tile.min_y + tile_height);
+      if (tile.min_x < tile.max_x && tile.min_y < tile.max_y) {
+        tiles.push_back(std::move(tile));
       }
+    }
+  }
+
+  auto ExtractTile = [&](Tile* tile) {
+    // Extend the tile by the overlap to cover the support region of the
+    // features close to the boundary of the tile.
+    const int min_x = std::max(0, tile->min_x - options.tile_overlap);
+    const int min_y = std::max(0, tile->min_y - options.tile_overlap);
+    const int max_x = std::min(width, tile->max_x + options.tile_overlap);
+    const int max_y = std::min(height, tile->max_y + options.tile_overlap);
+    const int padded_width = max_x - min_x;
+    const int padded_height = max_y - min_y;
+
+    std::vector<float> tile_data(padded_width * padded_height);
+    for (int y = 0; y < padded_height; ++y) {
+      const float* row = data_float.data() + (min_y + y) * width + min_x;
+      std::copy(row, row + padded_width,
+                tile_data.begin() + y * padded_width);
+    }
+
+    FeatureKeypoints tile_keypoints;
+    FeatureDescriptors tile_descriptors;
+    FeatureDescriptors* tile_descriptors_ptr =
+        descriptors == nullptr ? nullptr : &tile_descriptors;
+    if (covariant) {
+      tile->success = ExtractCovariantSiftFeaturesFromFloatArrayCPU(
+          options, tile_data.data(), padded_width, padded_height,
+          &tile_keypoints, tile_descriptors_ptr);
+    } else {
+      tile->success = ExtractSiftFeaturesFromFloatArrayCPU(
+          options, tile_data.data(), padded_width, padded_height,
+          &tile_keypoints, tile_descriptors_ptr);
+    }
 
-      descriptors->row(i) = FeatureDescriptorsToUnsignedByte(descriptor);
+    if (!tile->success) {
+      return;
     }
 
-    *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+    // Only keep the features located in the non-overlapping part of the
+    // tile, such that features in the overlap are not duplicated.
+    tile->keypoints.reserve(tile_keypoints.size());
+    if (descriptors != nullptr) {
+      tile->descriptors.resize(tile_descriptors.rows(),
+                               tile_descriptors.cols());
+    }
+    for (size_t i = 0; i < tile_keypoints.size(); ++i) {
+      FeatureKeypoint keypoint = tile_keypoints[i];
+      keypoint.x += min_x;
+      keypoint.y += min_y;
+      if (keypoint.x >= tile->min_x && keypoint.x < tile->max_x &&
+          keypoint.y >= tile->min_y && keypoint.y < tile->max_y) {
+        if (descriptors != nullptr) {
+          tile->descriptors.row(tile->keypoints.size()) =
+              tile_descriptors.row(i);
+        }
+        tile->keypoints.push_back(keypoint);
+      }
+    }
+    if (descriptors != nullptr) {
+      tile->descriptors.conservativeResize(tile->keypoints.size(),
+                                           tile_descriptors.cols());
+    }
+  };
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(tiles.size());
+  for (auto& tile : tiles) {
+    futures.push_back(thread_pool->AddTask(ExtractTile, &tile));
+  }
+
+  size_t num_features = 0;
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    futures[i].get();
+    if (!tiles[i].success) {
+      return false;
+    }
+    num_features += tiles[i].keypoints.size();
+  }
+
+  keypoints->clear();
+  keypoints->reserve(num_features);
+  if (descriptors != nullptr) {
+    descriptors->resize(num_features, 128);
+  }
+  for (const auto& tile : tiles) {
+    if (descriptors != nullptr) {
+      descriptors->middleRows(keypoints->size(), tile.keypoints.size()) =
+          tile.descriptors;
+    }
+    keypoints->insert(keypoints->end(), tile.keypoints.begin(),
+                      tile.keypoints.end());
+  }
+
+  if (descriptors != nullptr) {
+    ExtractTopScaleFeatures(keypoints, descriptors, options.max_num_features);
+  } else if (keypoints->size() >
+             static_cast<size_t>(options.max_num_features)) {
+    std::partial_sort(keypoints->begin(),
+                      keypoints->begin() + options.max_num_features,
+                      keypoints->end(),
+                      [](const FeatureKeypoint& keypoint1,
+                         const FeatureKeypoint& keypoint2) {
+                        return keypoint1.ComputeScale() >
+                               keypoint2.ComputeScale();
+                      });
+    keypoints->resize(options.max_num_features);
   }
 
   return true;
@@ -753,24 +1359,32 @@ bool CreateSiftGPUExtractor(const SiftExtractionOptions& options,
   CHECK(options.Check());
   CHECK_NOTNULL(sift_gpu);
 
+  std::vector<int> gpu_indices = CSVToVector<int>(options.gpu_index);
+  CHECK_EQ(gpu_indices.size(), 1) << "SiftGPU can only run on one GPU";
+
+#ifdef CUDA_ENABLED
+  // Use CUDA version by default if darkness adaptivity is disabled.
+  if (!options.darkness_adaptivity && gpu_indices[0] < 0) {
+    gpu_indices[0] = 0;
+  }
+
+  // Create the CUDA context before the serialized initialization of SiftGPU,
+  // so that the threads of multiple devices create their contexts in parallel.
+  if (gpu_indices[0] >= 0) {
+    InitializeCudaDevice(gpu_indices[0]);
+  }
+#endif  // CUDA_ENABLED
+
   // SiftGPU uses many global static state variables and the initialization must
   // be thread-safe in order to work correctly. This is enforced here.
   static std::mutex mutex;
   std::unique_lock<std::mutex> lock(mutex);
 
-  std::vector<int> gpu_indices = CSVToVector<int>(options.gpu_index);
-  CHECK_EQ(gpu_indices.size(), 1) << "SiftGPU can only run on one GPU";
-
   std::vector<std::string> sift_gpu_args;
 
   sift_gpu_args.push_back("./sift_gpu");
 
 #ifdef CUDA_ENABLED
-  // Use CUDA version by default if darkness adaptivity is disabled.
-  if (!options.darkness_adaptivity && gpu_indices[0] < 0) {
-    gpu_indices[0] = 0;
-  }
-
   if (gpu_indices[0] >= 0) {
     sift_gpu_args.push_back("-cuda");
     sift_gpu_args.push_back(std::to_string(gpu_indices[0]));
@@ -794,9 +1408,11 @@ bool CreateSiftGPUExtractor(const SiftExtractionOptions& options,
   sift_gpu_args.push_back("-maxd");
   sift_gpu_args.push_back(std::to_string(options.max_image_size));
 
-  // Keep the highest level features.
+  // Keep the highest level features. A mosaic of batched images may contain
+  // the maximum number of features of each image.
   sift_gpu_args.push_back("-tc2");
-  sift_gpu_args.push_back(std::to_string(options.max_num_features));
+  sift_gpu_args.push_back(
+      std::to_string(options.max_num_features * options.gpu_batch_size));
 
   // First octave level.
   sift_gpu_args.push_back("-fo");
@@ -856,49 +1472,190 @@ bool ExtractSiftFeaturesGPU(const SiftExtractionOptions& options,
   CHECK(!options.estimate_affine_shape);
   CHECK(!options.domain_size_pooling);
 
-  std::unique_lock<std::mutex> lock(
-      *sift_extraction_mutexes[sift_gpu->gpu_index]);
-
   // Note, that this produces slightly different results than using SiftGPU
   // directly for RGB->GRAY conversion, since it uses different weights.
   const std::vector<uint8_t> bitmap_raw_bits = bitmap.ConvertToRawBits();
-  const int code =
-      sift_gpu->RunSIFT(bitmap.ScanWidth(), bitmap.Height(),
-                        bitmap_raw_bits.data(), GL_LUMINANCE, GL_UNSIGNED_BYTE);
 
-  const int kSuccessCode = 1;
-  if (code != kSuccessCode) {
-    return false;
+  std::vector<SiftKeypoint> keypoints_data;
+
+  // Eigen's default is ColMajor, but SiftGPU stores result as RowMajor.
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      descriptors_float;
+
+  // Only the extraction on the device is serialized, such that multiple
+  // threads of the same device, e.g., with gpu_index "0,0", overlap the
+  // conversion of their images and features on the CPU.
+  {
+    std::unique_lock<std::mutex> lock(
+        *sift_extraction_mutexes.at(sift_gpu->gpu_index));
+
+    const int code = sift_gpu->RunSIFT(bitmap.ScanWidth(), bitmap.Height(),
+                                       bitmap_raw_bits.data(), GL_LUMINANCE,
+                                       GL_UNSIGNED_BYTE);
+
+    const int kSuccessCode = 1;
+    if (code != kSuccessCode) {
+      return false;
+    }
+
+    const size_t num_features =
+        static_cast<size_t>(sift_gpu->GetFeatureNum());
+    keypoints_data.resize(num_features);
+    descriptors_float.resize(num_features, 128);
+
+    // Download the extracted keypoints and descriptors.
+    sift_gpu->GetFeatureVector(keypoints_data.data(),
+                               descriptors_float.data());
   }
 
-  const size_t num_features = static_cast<size_t>(sift_gpu->GetFeatureNum());
+  // Keep the largest-scale features, since the feature limit of SiftGPU is
+  // raised for batched extraction.
+  std::vector<size_t> feature_idxs(keypoints_data.size());
+  std::iota(feature_idxs.begin(), feature_idxs.end(), 0);
+  ConvertSiftGPUFeatures(options, keypoints_data, descriptors_float,
+                         feature_idxs, 0, 0, keypoints, descriptors);
 
-  std::vector<SiftKeypoint> keypoints_data(num_features);
+  return true;
+}
 
-  // Eigen's default is ColMajor, but SiftGPU stores result as RowMajor.
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      descriptors_float(num_features, 128);
+bool ExtractSiftFeaturesGPUBatch(const SiftExtractionOptions& options,
+                                 const std::vector<const Bitmap*>& bitmaps,
+                                 SiftGPU* sift_gpu,
+                                 std::vector<FeatureKeypoints>* keypoints,
+                                 std::vector<FeatureDescriptors>* descriptors) {
+  CHECK(options.Check());
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(descriptors);
+  CHECK_EQ(options.max_image_size, sift_gpu->GetMaxDimension());
 
-  // Download the extracted keypoints and descriptors.
-  sift_gpu->GetFeatureVector(keypoints_data.data(), descriptors_float.data());
+  CHECK(!options.estimate_affine_shape);
+  CHECK(!options.domain_size_pooling);
 
-  keypoints->resize(num_features);
-  for (size_t i = 0; i < num_features; ++i) {
-    (*keypoints)[i] = FeatureKeypoint(keypoints_data[i].x, keypoints_data[i].y,
-                                      keypoints_data[i].s, keypoints_data[i].o);
+  keypoints->resize(bitmaps.size());
+  descriptors->resize(bitmaps.size());
+  if (bitmaps.empty()) {
+    return true;
   }
 
-  // Save and normalize the descriptors.
-  if (options.normalization == SiftExtractionOptions::Normalization::L2) {
-    descriptors_float = L2NormalizeFeatureDescriptors(descriptors_float);
-  } else if (options.normalization ==
-             SiftExtractionOptions::Normalization::L1_ROOT) {
-    descriptors_float = L1RootNormalizeFeatureDescriptors(descriptors_float);
-  } else {
-    LOG(FATAL) << "Normalization type not supported";
+  const int width = bitmaps[0]->Width();
+  const int height = bitmaps[0]->Height();
+  for (const Bitmap* bitmap : bitmaps) {
+    CHECK(bitmap->IsGrey());
+    CHECK_EQ(bitmap->Width(), width);
+    CHECK_EQ(bitmap->Height(), height);
   }
 
-  *descriptors = FeatureDescriptorsToUnsignedByte(descriptors_float);
+  // SiftGPU skips the upsampled octaves of images whose upsampled size exceeds
+  // the maximum image size. Limit the size of the mosaic accordingly, so that
+  // the same octaves are extracted as for the individual images. The width of
+  // the mosaic is padded to a multiple of 4 as for bitmaps.
+  const int max_mosaic_size =
+      options.first_octave < 0
+          ? options.max_image_size >> -options.first_octave
+          : options.max_image_size;
+  const int max_num_cols =
+      std::min((max_mosaic_size & ~3) / width, options.gpu_batch_size);
+  const int max_num_rows = max_mosaic_size / height;
+  const size_t max_num_tiles = static_cast<size_t>(
+      std::min(max_num_cols * max_num_rows, options.gpu_batch_size));
+
+  if (max_num_tiles < 2) {
+    for (size_t i = 0; i < bitmaps.size(); ++i) {
+      if (!ExtractSiftFeaturesGPU(options, *bitmaps[i], sift_gpu,
+                                  &(*keypoints)[i], &(*descriptors)[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Radius of the support region of a feature relative to its scale. The
+  // descriptor covers 4x4 bins of 3 times the scale, which are rotated by the
+  // orientation of the feature. Features whose support region crosses the
+  // boundary of their image would describe the neighboring images.
+  const float kSupportRadius = 6.0f * std::sqrt(2.0f);
+
+  for (size_t begin = 0; begin < bitmaps.size(); begin += max_num_tiles) {
+    const size_t num_tiles = std::min(max_num_tiles, bitmaps.size() - begin);
+    const int num_cols = std::min(max_num_cols, static_cast<int>(num_tiles));
+    const int num_rows =
+        (static_cast<int>(num_tiles) + num_cols - 1) / num_cols;
+    const int mosaic_width = (num_cols * width + 3) & ~3;
+    const int mosaic_height = num_rows * height;
+
+    std::vector<uint8_t> mosaic_raw_bits(mosaic_width * mosaic_height, 0);
+    for (size_t tile_idx = 0; tile_idx < num_tiles; ++tile_idx) {
+      const Bitmap& bitmap = *bitmaps[begin + tile_idx];
+      const std::vector<uint8_t> bitmap_raw_bits = bitmap.ConvertToRawBits();
+      const int min_x = static_cast<int>(tile_idx) % num_cols * width;
+      const int min_y = static_cast<int>(tile_idx) / num_cols * height;
+      for (int y = 0; y < height; ++y) {
+        std::copy_n(bitmap_raw_bits.begin() + y * bitmap.ScanWidth(), width,
+                    mosaic_raw_bits.begin() + (min_y + y) * mosaic_width +
+                        min_x);
+      }
+    }
+
+    std::vector<SiftKeypoint> keypoints_data;
+
+    // Eigen's default is ColMajor, but SiftGPU stores result as RowMajor.
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+        descriptors_float;
+
+    {
+      std::unique_lock<std::mutex> lock(
+          *sift_extraction_mutexes.at(sift_gpu->gpu_index));
+
+      const int code =
+          sift_gpu->RunSIFT(mosaic_width, mosaic_height,
+                            mosaic_raw_bits.data(), GL_LUMINANCE,
+                            GL_UNSIGNED_BYTE);
+
+      const int kSuccessCode = 1;
+      if (code != kSuccessCode) {
+        return false;
+      }
+
+      const size_t num_features =
+          static_cast<size_t>(sift_gpu->GetFeatureNum());
+      keypoints_data.resize(num_features);
+      descriptors_float.resize(num_features, 128);
+
+      sift_gpu->GetFeatureVector(keypoints_data.data(),
+                                 descriptors_float.data());
+    }
+
+    // Assign the features to the images in whose tile they are located.
+    std::vector<std::vector<size_t>> tile_feature_idxs(num_tiles);
+    for (size_t i = 0; i < keypoints_data.size(); ++i) {
+      const SiftKeypoint& keypoint = keypoints_data[i];
+      if (keypoint.x < 0 || keypoint.y < 0) {
+        continue;
+      }
+      const int col = static_cast<int>(keypoint.x) / width;
+      const int row = static_cast<int>(keypoint.y) / height;
+      const size_t tile_idx = static_cast<size_t>(row * num_cols + col);
+      if (col >= num_cols || tile_idx >= num_tiles) {
+        continue;
+      }
+      const float x = keypoint.x - col * width;
+      const float y = keypoint.y - row * height;
+      const float radius = kSupportRadius * keypoint.s;
+      if (x >= radius && y >= radius && x + radius <= width &&
+          y + radius <= height) {
+        tile_feature_idxs[tile_idx].push_back(i);
+      }
+    }
+
+    for (size_t tile_idx = 0; tile_idx < num_tiles; ++tile_idx) {
+      const int min_x = static_cast<int>(tile_idx) % num_cols * width;
+      const int min_y = static_cast<int>(tile_idx) / num_cols * height;
+      ConvertSiftGPUFeatures(options, keypoints_data, descriptors_float,
+                             tile_feature_idxs[tile_idx], min_x, min_y,
+                             &(*keypoints)[begin + tile_idx],
+                             &(*descriptors)[begin + tile_idx]);
+    }
+  }
 
   return true;
 }
@@ -958,6 +1715,68 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
   }
 }
 
+void LoadSiftFeaturesFromBinaryFile(const std::string& path,
+                                    FeatureKeypoints* keypoints,
+                                    FeatureDescriptors* descriptors) {
+  CHECK_NOTNULL(keypoints);
+  CHECK_NOTNULL(descriptors);
+
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  const int64_t num_features = ReadBinaryLittleEndian<int64_t>(&file);
+  const int64_t dim = ReadBinaryLittleEndian<int64_t>(&file);
+  CHECK(file) << path;
+  CHECK_GE(num_features, 0) << path;
+  CHECK_EQ(dim, 128) << "SIFT features must have 128 dimensions";
+
+  std::vector<float> keypoint_data(4 * num_features);
+  if (IsLittleEndian()) {
+    file.read(reinterpret_cast<char*>(keypoint_data.data()),
+              keypoint_data.size() * sizeof(float));
+  } else {
+    ReadBinaryLittleEndian<float>(&file, &keypoint_data);
+  }
+
+  keypoints->resize(num_features);
+  for (int64_t i = 0; i < num_features; ++i) {
+    (*keypoints)[i] =
+        FeatureKeypoint(keypoint_data[4 * i], keypoint_data[4 * i + 1],
+                        keypoint_data[4 * i + 2], keypoint_data[4 * i + 3]);
+  }
+
+  // Descriptors are single bytes and row-major, so they can be read directly.
+  descriptors->resize(num_features, dim);
+  file.read(reinterpret_cast<char*>(descriptors->data()),
+            descriptors->size() * sizeof(uint8_t));
+  CHECK(file) << "Unexpected end of file: " << path;
+}
+
+void WriteSiftFeaturesToBinaryFile(const std::string& path,
+                                   const FeatureKeypoints& keypoints,
+                                   const FeatureDescriptors& descriptors) {
+  CHECK_EQ(keypoints.size(), descriptors.rows());
+
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  WriteBinaryLittleEndian<int64_t>(&file, descriptors.rows());
+  WriteBinaryLittleEndian<int64_t>(&file, descriptors.cols());
+
+  std::vector<float> keypoint_data;
+  keypoint_data.reserve(4 * keypoints.size());
+  for (const auto& keypoint : keypoints) {
+    keypoint_data.push_back(keypoint.x);
+    keypoint_data.push_back(keypoint.y);
+    keypoint_data.push_back(keypoint.ComputeScale());
+    keypoint_data.push_back(keypoint.ComputeOrientation());
+  }
+  WriteBinaryLittleEndian<float>(&file, keypoint_data);
+
+  file.write(reinterpret_cast<const char*>(descriptors.data()),
+             descriptors.size() * sizeof(uint8_t));
+}
+
 void MatchSiftFeaturesCPUBruteForce(const SiftMatchingOptions& match_options,
                                     const FeatureDescriptors& descriptors1,
                                     const FeatureDescriptors& descriptors2,
@@ -1002,6 +1821,33 @@ void MatchSiftFeaturesCPUFLANN(const SiftMatchingOptions& match_options,
                        matches);
 }
 
+void MatchSiftFeaturesCPUFLANN(const SiftMatchingOptions& match_options,
+                               const SiftDescriptorIndex& index1,
+                               const SiftDescriptorIndex& index2,
+                               FeatureMatches* matches) {
+  CHECK(match_options.Check());
+  CHECK_NOTNULL(matches);
+
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      indices_1to2;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      distances_1to2;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      indices_2to1;
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      distances_2to1;
+
+  index2.Search(index1.Descriptors(), &indices_1to2, &distances_1to2);
+  if (match_options.cross_check) {
+    index1.Search(index2.Descriptors(), &indices_2to1, &distances_2to1);
+  }
+
+  FindBestMatchesFLANN(indices_1to2, distances_1to2, indices_2to1,
+                       distances_2to1, match_options.max_ratio,
+                       match_options.max_distance, match_options.cross_check,
+                       matches);
+}
+
 void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                           const FeatureDescriptors& descriptors1,
                           const FeatureDescriptors& descriptors2,
@@ -1009,6 +1855,51 @@ void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
   MatchSiftFeaturesCPUFLANN(match_options, descriptors1, descriptors2, matches);
 }
 
+void MatchBinarySiftFeaturesCPU(
+    const SiftMatchingOptions& match_options,
+    const FeatureBinaryDescriptors& descriptors1,
+    const FeatureBinaryDescriptors& descriptors2, FeatureMatches* matches) {
+  CHECK(match_options.Check());
+  CHECK_NOTNULL(matches);
+
+  matches->clear();
+
+  std::vector<int> matches12;
+  std::vector<float> scores12;
+  const size_t num_matches12 = FindBestBinaryMatchesOneWay(
+      descriptors1, descriptors2, match_options.max_ratio, &matches12,
+      &scores12);
+
+  std::vector<int> matches21;
+  std::vector<float> scores21;
+  if (match_options.cross_check) {
+    FindBestBinaryMatchesOneWay(descriptors2, descriptors1,
+                                match_options.max_ratio, &matches21,
+                                &scores21);
+  }
+
+  matches->reserve(num_matches12);
+  for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
+    const int i2 = matches12[i1];
+    if (i2 == -1) {
+      continue;
+    }
+
+    FeatureMatch match;
+    match.point2D_idx1 = i1;
+    match.point2D_idx2 = i2;
+    match.score = scores12[i1];
+    if (match_options.cross_check) {
+      if (matches21[i2] != static_cast<int>(i1)) {
+        continue;
+      }
+      match.score = std::min(match.score, scores21[i2]);
+    }
+
+    matches->push_back(match);
+  }
+}
+
 void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                                 const FeatureKeypoints& keypoints1,
                                 const FeatureKeypoints& keypoints2,
@@ -1054,25 +1945,51 @@ void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
 
   CHECK(guided_filter);
 
-  const Eigen::MatrixXi dists = ComputeSiftDistanceMatrix(
-      &keypoints1, &keypoints2, descriptors1, descriptors2, guided_filter);
+  two_view_geometry->inlier_matches.clear();
+  if (keypoints1.empty() || keypoints2.empty()) {
+    return;
+  }
+
+  CHECK_EQ(keypoints1.size(), descriptors1.rows());
+  CHECK_EQ(keypoints2.size(), descriptors2.rows());
+
+  // Only compute the descriptor distances of the candidate pairs close to
+  // the epipolar line or the transferred point instead of all pairs. The
+  // candidates are then checked with the exact same filter as before.
+  const std::vector<std::vector<int>> candidates = FindGuidedMatchCandidates(
+      keypoints1, keypoints2, *two_view_geometry, max_residual);
+
+  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
+      descriptors1.cast<int>();
+  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
+      descriptors2.cast<int>();
 
+  const int kNumNeighbors = 2;
   Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_1to2(dists.rows(), dists.cols());
+      indices_1to2 = Eigen::MatrixXi::Constant(descriptors1.rows(),
+                                               kNumNeighbors, -1);
   Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      indices_2to1(dists.cols(), dists.rows());
+      indices_2to1 = Eigen::MatrixXi::Constant(descriptors2.rows(),
+                                               kNumNeighbors, -1);
   Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_1to2 = dists;
+      distances_1to2 =
+          Eigen::MatrixXi::Zero(descriptors1.rows(), kNumNeighbors);
   Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distances_2to1 = dists.transpose();
-
-  for (int i = 0; i < indices_1to2.rows(); ++i) {
-    indices_1to2.row(i) = Eigen::VectorXi::LinSpaced(indices_1to2.cols(), 0,
-                                                     indices_1to2.cols() - 1);
-  }
-  for (int i = 0; i < indices_2to1.rows(); ++i) {
-    indices_2to1.row(i) = Eigen::VectorXi::LinSpaced(indices_2to1.cols(), 0,
-                                                     indices_2to1.cols() - 1);
+      distances_2to1 =
+          Eigen::MatrixXi::Zero(descriptors2.rows(), kNumNeighbors);
+
+  for (size_t i1 = 0; i1 < candidates.size(); ++i1) {
+    for (const int i2 : candidates[i1]) {
+      if (guided_filter(keypoints1[i1].x, keypoints1[i1].y, keypoints2[i2].x,
+                        keypoints2[i2].y)) {
+        continue;
+      }
+      const int dist = descriptors1_int.row(i1).dot(descriptors2_int.row(i2));
+      UpdateBestNeighbors(i2, dist, static_cast<int>(i1), &indices_1to2,
+                          &distances_1to2);
+      UpdateBestNeighbors(static_cast<int>(i1), dist, i2, &indices_2to1,
+                          &distances_2to1);
+    }
   }
 
   FindBestMatchesFLANN(indices_1to2, distances_1to2, indices_2to1,
@@ -1086,15 +2003,23 @@ bool CreateSiftGPUMatcher(const SiftMatchingOptions& match_options,
   CHECK(match_options.Check());
   CHECK_NOTNULL(sift_match_gpu);
 
+  const std::vector<int> gpu_indices =
+      CSVToVector<int>(match_options.gpu_index);
+  CHECK_EQ(gpu_indices.size(), 1) << "SiftGPU can only run on one GPU";
+
+#ifdef CUDA_ENABLED
+  // Create the CUDA context before the serialized initialization of SiftGPU,
+  // so that the threads of multiple devices create their contexts in parallel.
+  if (gpu_indices[0] >= 0) {
+    InitializeCudaDevice(gpu_indices[0]);
+  }
+#endif  // CUDA_ENABLED
+
   // SiftGPU uses many global static state variables and the initialization must
   // be thread-safe in order to work correctly. This is enforced here.
   static std::mutex mutex;
   std::unique_lock<std::mutex> lock(mutex);
 
-  const std::vector<int> gpu_indices =
-      CSVToVector<int>(match_options.gpu_index);
-  CHECK_EQ(gpu_indices.size(), 1) << "SiftGPU can only run on one GPU";
-
   SiftGPU sift_gpu;
   sift_gpu.SetVerbose(0);
 
@@ -1171,23 +2096,27 @@ void MatchSiftFeaturesGPU(const SiftMatchingOptions& match_options,
                                    descriptors2->data());
   }
 
-  matches->resize(static_cast<size_t>(match_options.max_num_matches));
+  std::vector<uint32_t> match_idxs(
+      2 * static_cast<size_t>(match_options.max_num_matches));
 
   const int num_matches = sift_match_gpu->GetSiftMatch(
       match_options.max_num_matches,
-      reinterpret_cast<uint32_t(*)[2]>(matches->data()),
+      reinterpret_cast<uint32_t(*)[2]>(match_idxs.data()),
       static_cast<float>(match_options.max_distance),
       static_cast<float>(match_options.max_ratio), match_options.cross_check);
 
+  matches->clear();
   if (num_matches < 0) {
     std::cerr << "ERROR: Feature matching failed. This is probably caused by "
                  "insufficient GPU memory. Consider reducing the maximum "
                  "number of features and/or matches."
               << std::endl;
-    matches->clear();
   } else {
-    CHECK_LE(num_matches, matches->size());
-    matches->resize(num_matches);
+    CHECK_LE(num_matches, match_options.max_num_matches);
+    matches->reserve(num_matches);
+    for (int i = 0; i < num_matches; ++i) {
+      matches->emplace_back(match_idxs[2 * i], match_idxs[2 * i + 1]);
+    }
   }
 }
 
@@ -1260,28 +2189,31 @@ void MatchGuidedSiftFeaturesGPU(const SiftMatchingOptions& match_options,
 
   CHECK(F_ptr != nullptr || H_ptr != nullptr);
 
-  two_view_geometry->inlier_matches.resize(
-      static_cast<size_t>(match_options.max_num_matches));
+  std::vector<uint32_t> match_idxs(
+      2 * static_cast<size_t>(match_options.max_num_matches));
 
   const int num_matches = sift_match_gpu->GetGuidedSiftMatch(
       match_options.max_num_matches,
-      reinterpret_cast<uint32_t(*)[2]>(
-          two_view_geometry->inlier_matches.data()),
+      reinterpret_cast<uint32_t(*)[2]>(match_idxs.data()),
       H_ptr, F_ptr, static_cast<float>(match_options.max_distance),
       static_cast<float>(match_options.max_ratio),
       static_cast<float>(match_options.max_error * match_options.max_error),
       static_cast<float>(match_options.max_error * match_options.max_error),
       match_options.cross_check);
 
+  two_view_geometry->inlier_matches.clear();
   if (num_matches < 0) {
     std::cerr << "ERROR: Feature matching failed. This is probably caused by "
                  "insufficient GPU memory. Consider reducing the maximum "
                  "number of features."
               << std::endl;
-    two_view_geometry->inlier_matches.clear();
   } else {
-    CHECK_LE(num_matches, two_view_geometry->inlier_matches.size());
-    two_view_geometry->inlier_matches.resize(num_matches);
+    CHECK_LE(num_matches, match_options.max_num_matches);
+    two_view_geometry->inlier_matches.reserve(num_matches);
+    for (int i = 0; i < num_matches; ++i) {
+      two_view_geometry->inlier_matches.emplace_back(match_idxs[2 * i],
+                                                     match_idxs[2 * i + 1]);
+    }
   }
 }
 
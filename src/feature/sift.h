@@ -32,9 +32,12 @@
 #ifndef COLMAP_SRC_FEATURE_SIFT_H_
 #define COLMAP_SRC_FEATURE_SIFT_H_
 
+#include <memory>
+
 #include "estimators/two_view_geometry.h"
 #include "feature/types.h"
 #include "util/bitmap.h"
+#include "util/threading.h"
 
 class SiftGPU;
 class SiftMatchGPU;
@@ -50,8 +53,17 @@ struct SiftExtractionOptions {
 
   // Index of the GPU used for feature extraction. For multi-GPU extraction,
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
+  // Repeat an index to run multiple extraction threads per GPU, e.g.,
+  // "0,0,1,1", which overlap the processing of their images on the CPU.
   std::string gpu_index = "-1";
 
+  // Maximum number of images whose features are written to the database in a
+  // single transaction. A partially filled batch is committed when the oldest
+  // image in the batch has waited for more than the given maximum delay in
+  // milliseconds, which is checked whenever a new image arrives.
+  int max_writer_batch_size = 32;
+  int max_writer_batch_delay_ms = 1000;
+
   // Maximum image size, otherwise image will be down-scaled.
   int max_image_size = 3200;
 
@@ -110,6 +122,32 @@ struct SiftExtractionOptions {
   };
   Normalization normalization = Normalization::L1_ROOT;
 
+  // Split images on the CPU into overlapping tiles of at most the given size,
+  // whose features are extracted in parallel. This reduces the latency for
+  // very large images, e.g., aerial mosaics, where only few images are
+  // processed at the same time. A non-positive value disables tiling. The
+  // overlap between neighboring tiles should cover the support region of the
+  // largest features, since features are only kept in the part of a tile
+  // that does not overlap with other tiles.
+  int tile_size = -1;
+  int tile_overlap = 256;
+
+  // Maximum number of queued images of equal size, whose features are
+  // extracted together on the GPU by packing them into a single mosaic image.
+  // This reduces the per-image overhead of SiftGPU for small images, e.g.,
+  // video frames. The size of the mosaic is limited by the maximum image size
+  // and, for a negative first octave, its upsampling, so that more images fit
+  // with a first octave of 0. Features whose support region crosses the
+  // boundary of their image in the mosaic are discarded.
+  int gpu_batch_size = 1;
+
+  // Optional path to a directory of extracted features that is shared by
+  // multiple databases, e.g., of projects with overlapping images. Images
+  // whose features are in the cache are not decoded and their features are
+  // directly written to the database. The cache is not used with image masks,
+  // since the features depend on the mask of the image.
+  std::string feature_cache_path = "";
+
   bool Check() const;
 };
 
@@ -161,6 +199,44 @@ struct SiftMatchingOptions {
   // Whether to perform guided matching, if geometric verification succeeds.
   bool guided_matching = false;
 
+  // Whether to reject image pairs early in geometric verification, if a
+  // screening estimation with a bounded number of trials does not yield
+  // enough inliers. This skips the full estimation of all models for the
+  // majority of non-overlapping pairs, e.g., in vocabulary tree matching.
+  bool early_exit_verification = false;
+
+  // Whether to draw the samples of geometric verification with PROSAC in the
+  // order of the ratio test scores of the matches instead of uniformly. Only
+  // applies to matches, which are scored by the CPU matcher and verified in
+  // the same run, since the scores are not stored in the database.
+  bool progressive_sampling = true;
+
+  // Whether to store the matches and inlier matches in the database in a
+  // compact encoding, which substantially reduces the database size for
+  // large datasets. Databases with compressed matches can only be read by
+  // COLMAP versions supporting the encoding.
+  bool compress_matches = false;
+
+  // Whether to build the nearest neighbor index over the descriptors of each
+  // image only once and to reuse it for all image pairs in CPU matching,
+  // instead of building new indices for every image pair. This trades memory
+  // for speed, since the indices are cached with the descriptors.
+  bool cpu_cache_indices = true;
+
+  // Whether to match binarized descriptors by their Hamming distance on the
+  // CPU instead of the original descriptors, see `BinarizeFeatureDescriptors`.
+  // This is much faster but finds fewer correct matches and is intended for
+  // quick preview reconstructions. The GPU is not used for matching and the
+  // maximum distance does not apply, while guided matching still uses the
+  // original descriptors.
+  bool binary_matching = false;
+
+  // Optional path of a feature store, see `FeatureStore`, from which the
+  // features of the images are read instead of the database, e.g., as
+  // exported by `feature_store_exporter`. The features of images that are not
+  // in the store are still read from the database.
+  std::string feature_store_path = "";
+
   bool Check() const;
 };
 
@@ -174,11 +250,23 @@ bool ExtractCovariantSiftFeaturesCPU(const SiftExtractionOptions& options,
                                      FeatureKeypoints* keypoints,
                                      FeatureDescriptors* descriptors);
 
+// Extract (covariant) SIFT features for the given image on the CPU by
+// splitting it into overlapping tiles of `options.tile_size`, which are
+// processed in parallel by the given thread pool. The features of all tiles
+// are combined and the `options.max_num_features` largest-scale features are
+// kept. Note that the results can differ slightly from the untiled version
+// for features whose support region exceeds the overlap between tiles.
+bool ExtractSiftFeaturesCPUTiled(const SiftExtractionOptions& options,
+                                 const Bitmap& bitmap, ThreadPool* thread_pool,
+                                 FeatureKeypoints* keypoints,
+                                 FeatureDescriptors* descriptors);
+
 // Create a SiftGPU feature extractor. The same SiftGPU instance can be used to
 // extract features for multiple images. Note a OpenGL context must be made
 // current in the thread of the caller. If the gpu_index is not -1, the CUDA
 // version of SiftGPU is used, which produces slightly different results
-// than the OpenGL implementation.
+// than the OpenGL implementation. The CUDA version needs no OpenGL context
+// and creates the CUDA context of the device in the thread of the caller.
 bool CreateSiftGPUExtractor(const SiftExtractionOptions& options,
                             SiftGPU* sift_gpu);
 
@@ -189,6 +277,20 @@ bool ExtractSiftFeaturesGPU(const SiftExtractionOptions& options,
                             FeatureKeypoints* keypoints,
                             FeatureDescriptors* descriptors);
 
+// Extract SIFT features for multiple grey images of equal size on the GPU by
+// packing up to `options.gpu_batch_size` images into a mosaic, which is
+// processed by a single SiftGPU run. The features are assigned back to their
+// images and the `options.max_num_features` largest-scale features are kept
+// per image. Images are extracted individually, if not at least two of them
+// fit into the mosaic. Note that the results differ from the unbatched version
+// close to the image boundaries. SiftGPU must already be initialized using
+// `CreateSiftGPU`.
+bool ExtractSiftFeaturesGPUBatch(const SiftExtractionOptions& options,
+                                 const std::vector<const Bitmap*>& bitmaps,
+                                 SiftGPU* sift_gpu,
+                                 std::vector<FeatureKeypoints>* keypoints,
+                                 std::vector<FeatureDescriptors>* descriptors);
+
 // Load keypoints and descriptors from text file in the following format:
 //
 //    LINE_0:            NUM_FEATURES DIM
@@ -210,7 +312,58 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
                                   FeatureKeypoints* keypoints,
                                   FeatureDescriptors* descriptors);
 
-// Match the given SIFT features on the CPU.
+// Load keypoints and descriptors from a binary file in the following format,
+// where all values are stored in little endian byte order:
+//
+//    int64   NUM_FEATURES
+//    int64   DIM
+//    float32 KEYPOINTS[NUM_FEATURES][4]   (X, Y, SCALE, ORIENTATION)
+//    uint8   DESCRIPTORS[NUM_FEATURES][DIM]
+//
+// The keypoint and descriptor arrays are the raw C-ordered buffers of the
+// corresponding NumPy arrays, e.g. as written by `ndarray.tofile`. Parsing a
+// binary file is much faster than the text format and is preferred for large
+// bulk imports.
+void LoadSiftFeaturesFromBinaryFile(const std::string& path,
+                                    FeatureKeypoints* keypoints,
+                                    FeatureDescriptors* descriptors);
+
+// Write keypoints and descriptors in the binary format read by
+// `LoadSiftFeaturesFromBinaryFile`.
+void WriteSiftFeaturesToBinaryFile(const std::string& path,
+                                   const FeatureKeypoints& keypoints,
+                                   const FeatureDescriptors& descriptors);
+
+// Approximate nearest neighbor index over the SIFT descriptors of an image. The
+// index is immutable after construction and can be searched concurrently, so
+// it can be built once and shared by all image pairs involving the image.
+class SiftDescriptorIndex {
+ public:
+  explicit SiftDescriptorIndex(const FeatureDescriptors& descriptors);
+  SiftDescriptorIndex(SiftDescriptorIndex&& other);
+  ~SiftDescriptorIndex();
+
+  size_t NumDescriptors() const;
+  const FeatureDescriptors& Descriptors() const;
+
+  // Find the two nearest neighbors in the index for each query descriptor.
+  // The returned distances are exact dot products of the descriptors.
+  void Search(
+      const FeatureDescriptors& query,
+      Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+          indices,
+      Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>*
+          distances) const;
+
+ private:
+  // The index references the descriptors, so both are allocated together and
+  // keep their address when the object is moved.
+  struct Index;
+  std::unique_ptr<Index> index_;
+};
+
+// Match the given SIFT features on the CPU. The matches are scored by their
+// ratio test, see `FeatureMatch::score`.
 void MatchSiftFeaturesCPUBruteForce(const SiftMatchingOptions& match_options,
                                     const FeatureDescriptors& descriptors1,
                                     const FeatureDescriptors& descriptors2,
@@ -219,10 +372,22 @@ void MatchSiftFeaturesCPUFLANN(const SiftMatchingOptions& match_options,
                                const FeatureDescriptors& descriptors1,
                                const FeatureDescriptors& descriptors2,
                                FeatureMatches* matches);
+void MatchSiftFeaturesCPUFLANN(const SiftMatchingOptions& match_options,
+                               const SiftDescriptorIndex& index1,
+                               const SiftDescriptorIndex& index2,
+                               FeatureMatches* matches);
 void MatchSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                           const FeatureDescriptors& descriptors1,
                           const FeatureDescriptors& descriptors2,
                           FeatureMatches* matches);
+// Match the given binarized SIFT features on the CPU by their Hamming
+// distance, see `BinarizeFeatureDescriptors`. The ratio test and the cross
+// check are applied as for the original descriptors.
+void MatchBinarySiftFeaturesCPU(
+    const SiftMatchingOptions& match_options,
+    const FeatureBinaryDescriptors& descriptors1,
+    const FeatureBinaryDescriptors& descriptors2, FeatureMatches* matches);
+
 void MatchGuidedSiftFeaturesCPU(const SiftMatchingOptions& match_options,
                                 const FeatureKeypoints& keypoints1,
                                 const FeatureKeypoints& keypoints2,
@@ -239,7 +404,8 @@ bool CreateSiftGPUMatcher(const SiftMatchingOptions& match_options,
 
 // Match the given SIFT features on the GPU. If either of the descriptors is
 // NULL, the keypoints/descriptors will not be uploaded and the previously
-// uploaded descriptors will be reused for the matching.
+// uploaded descriptors will be reused for the matching. The matches have no
+// score, since SiftGPU does not return the descriptor distances.
 void MatchSiftFeaturesGPU(const SiftMatchingOptions& match_options,
                           const FeatureDescriptors* descriptors1,
                           const FeatureDescriptors* descriptors2,
@@ -34,6 +34,8 @@
 
 #include <QApplication>
 
+#include <boost/filesystem.hpp>
+
 #include "SiftGPU/SiftGPU.h"
 #include "feature/sift.h"
 #include "feature/utils.h"
@@ -79,6 +81,58 @@ BOOST_AUTO_TEST_CASE(TestExtractSiftFeaturesCPU) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestExtractSiftFeaturesCPUTiled) {
+  Bitmap bitmap;
+  CreateImageWithSquare(256, &bitmap);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  BOOST_CHECK(ExtractSiftFeaturesCPU(SiftExtractionOptions(), bitmap,
+                                     &keypoints, &descriptors));
+
+  // With an overlap covering the entire image, every tile extracts the same
+  // features as the untiled version, of which each tile keeps a disjoint set.
+  SiftExtractionOptions options;
+  options.tile_size = 100;
+  options.tile_overlap = 256;
+
+  ThreadPool thread_pool(4);
+  FeatureKeypoints tiled_keypoints;
+  FeatureDescriptors tiled_descriptors;
+  BOOST_CHECK(ExtractSiftFeaturesCPUTiled(options, bitmap, &thread_pool,
+                                          &tiled_keypoints,
+                                          &tiled_descriptors));
+
+  BOOST_CHECK_EQUAL(tiled_keypoints.size(), keypoints.size());
+  BOOST_CHECK_EQUAL(tiled_descriptors.rows(), descriptors.rows());
+  for (size_t i = 0; i < tiled_keypoints.size(); ++i) {
+    bool found = false;
+    for (size_t j = 0; j < keypoints.size(); ++j) {
+      if (tiled_keypoints[i].x == keypoints[j].x &&
+          tiled_keypoints[i].y == keypoints[j].y &&
+          tiled_keypoints[i].ComputeOrientation() ==
+              keypoints[j].ComputeOrientation()) {
+        BOOST_CHECK_EQUAL(tiled_descriptors.row(i), descriptors.row(j));
+        found = true;
+      }
+    }
+    BOOST_CHECK(found);
+  }
+
+  // Without overlap, features are only extracted within the tiles.
+  options.tile_overlap = 0;
+  BOOST_CHECK(ExtractSiftFeaturesCPUTiled(options, bitmap, &thread_pool,
+                                          &tiled_keypoints,
+                                          &tiled_descriptors));
+  BOOST_CHECK_EQUAL(tiled_keypoints.size(), tiled_descriptors.rows());
+  for (size_t i = 0; i < tiled_keypoints.size(); ++i) {
+    BOOST_CHECK_GE(tiled_keypoints[i].x, 0);
+    BOOST_CHECK_GE(tiled_keypoints[i].y, 0);
+    BOOST_CHECK_LE(tiled_keypoints[i].x, bitmap.Width());
+    BOOST_CHECK_LE(tiled_keypoints[i].y, bitmap.Height());
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestExtractCovariantSiftFeaturesCPU) {
   Bitmap bitmap;
   CreateImageWithSquare(256, &bitmap);
@@ -297,6 +351,39 @@ BOOST_AUTO_TEST_CASE(TestCreateSiftGPUMatcherCUDA) {
 #endif
 }
 
+BOOST_AUTO_TEST_CASE(TestLoadSiftFeaturesFromBinaryFile) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_sift_%%%%-%%%%.bin"))
+          .string();
+
+  FeatureKeypoints keypoints = {FeatureKeypoint(1, 2, 3, 0.5),
+                                FeatureKeypoint(4, 5, 6, -0.5)};
+  FeatureDescriptors descriptors(2, 128);
+  for (int i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = static_cast<uint8_t>(i % 256);
+  }
+
+  WriteSiftFeaturesToBinaryFile(path, keypoints, descriptors);
+
+  FeatureKeypoints read_keypoints;
+  FeatureDescriptors read_descriptors;
+  LoadSiftFeaturesFromBinaryFile(path, &read_keypoints, &read_descriptors);
+
+  BOOST_CHECK_EQUAL(read_keypoints.size(), keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    BOOST_CHECK_EQUAL(read_keypoints[i].x, keypoints[i].x);
+    BOOST_CHECK_EQUAL(read_keypoints[i].y, keypoints[i].y);
+    BOOST_CHECK_CLOSE(read_keypoints[i].ComputeScale(),
+                      keypoints[i].ComputeScale(), 1e-4);
+    BOOST_CHECK_CLOSE(read_keypoints[i].ComputeOrientation(),
+                      keypoints[i].ComputeOrientation(), 1e-4);
+  }
+  BOOST_CHECK_EQUAL(read_descriptors, descriptors);
+
+  boost::filesystem::remove(path);
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPU) {
   const FeatureDescriptors empty_descriptors =
       CreateRandomFeatureDescriptors(0);
@@ -324,6 +411,42 @@ BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPU) {
   BOOST_CHECK_EQUAL(matches.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestMatchBinarySiftFeaturesCPU) {
+  const FeatureBinaryDescriptors empty_descriptors =
+      BinarizeFeatureDescriptors(CreateRandomFeatureDescriptors(0));
+  const FeatureBinaryDescriptors descriptors1 =
+      BinarizeFeatureDescriptors(CreateRandomFeatureDescriptors(100));
+  const FeatureBinaryDescriptors descriptors2 =
+      descriptors1.colwise().reverse();
+
+  FeatureMatches matches;
+
+  MatchBinarySiftFeaturesCPU(SiftMatchingOptions(), descriptors1, descriptors2,
+                             &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 100);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx1, i);
+    BOOST_CHECK_EQUAL(matches[i].point2D_idx2, 99 - i);
+    BOOST_CHECK_EQUAL(matches[i].score, 1);
+  }
+
+  SiftMatchingOptions match_options;
+  match_options.cross_check = false;
+  MatchBinarySiftFeaturesCPU(match_options, descriptors1, descriptors2,
+                             &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 100);
+
+  MatchBinarySiftFeaturesCPU(SiftMatchingOptions(), empty_descriptors,
+                             descriptors2, &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 0);
+  MatchBinarySiftFeaturesCPU(SiftMatchingOptions(), descriptors1,
+                             empty_descriptors, &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 0);
+  MatchBinarySiftFeaturesCPU(SiftMatchingOptions(), empty_descriptors,
+                             empty_descriptors, &matches);
+  BOOST_CHECK_EQUAL(matches.size(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUFLANNvsBruteForce) {
   SiftMatchingOptions match_options;
   match_options.max_num_matches = 1000;
@@ -430,6 +553,46 @@ BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUFLANNvsBruteForce) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesCPUFLANNIndex) {
+  const FeatureDescriptors descriptors1 = CreateRandomFeatureDescriptors(100);
+  const FeatureDescriptors descriptors2 = descriptors1.colwise().reverse();
+  const FeatureDescriptors empty_descriptors =
+      CreateRandomFeatureDescriptors(0);
+
+  const SiftDescriptorIndex index1(descriptors1);
+  const SiftDescriptorIndex index2(descriptors2);
+  const SiftDescriptorIndex empty_index(empty_descriptors);
+  BOOST_CHECK_EQUAL(index1.NumDescriptors(), 100);
+  BOOST_CHECK_EQUAL(empty_index.NumDescriptors(), 0);
+
+  for (const bool cross_check : {true, false}) {
+    SiftMatchingOptions match_options;
+    match_options.cross_check = cross_check;
+
+    FeatureMatches matches_bf;
+    FeatureMatches matches_index;
+
+    MatchSiftFeaturesCPUBruteForce(match_options, descriptors1, descriptors2,
+                                   &matches_bf);
+    MatchSiftFeaturesCPUFLANN(match_options, index1, index2, &matches_index);
+    CheckEqualMatches(matches_bf, matches_index);
+    BOOST_CHECK_EQUAL(matches_index.size(), 100);
+
+    // The same index can be reused for multiple image pairs.
+    MatchSiftFeaturesCPUBruteForce(match_options, descriptors2, descriptors1,
+                                   &matches_bf);
+    MatchSiftFeaturesCPUFLANN(match_options, index2, index1, &matches_index);
+    CheckEqualMatches(matches_bf, matches_index);
+
+    MatchSiftFeaturesCPUFLANN(match_options, empty_index, index2,
+                              &matches_index);
+    BOOST_CHECK_EQUAL(matches_index.size(), 0);
+    MatchSiftFeaturesCPUFLANN(match_options, index1, empty_index,
+                              &matches_index);
+    BOOST_CHECK_EQUAL(matches_index.size(), 0);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchGuidedSiftFeaturesCPU) {
   FeatureKeypoints empty_keypoints(0);
   FeatureKeypoints keypoints1(2);
@@ -476,6 +639,51 @@ BOOST_AUTO_TEST_CASE(TestMatchGuidedSiftFeaturesCPU) {
   BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestMatchGuidedSiftFeaturesCPUManyFeatures) {
+  const size_t kNumFeatures = 1000;
+  FeatureKeypoints keypoints1(kNumFeatures);
+  FeatureKeypoints keypoints2(kNumFeatures);
+  for (size_t i = 0; i < kNumFeatures; ++i) {
+    keypoints1[i].x = 1.0f * (i % 40) * 25;
+    keypoints1[i].y = 2.0f * i;
+    keypoints2[kNumFeatures - 1 - i].x = keypoints1[i].x + 10;
+    keypoints2[kNumFeatures - 1 - i].y = keypoints1[i].y;
+  }
+  const FeatureDescriptors descriptors1 =
+      CreateRandomFeatureDescriptors(kNumFeatures);
+  const FeatureDescriptors descriptors2 = descriptors1.colwise().reverse();
+
+  // Horizontal epipolar lines.
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+  two_view_geometry.F << 0, 0, 0, 0, 0, -1, 0, 1, 0;
+  MatchGuidedSiftFeaturesCPU(SiftMatchingOptions(), keypoints1, keypoints2,
+                             descriptors1, descriptors2, &two_view_geometry);
+  BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), kNumFeatures);
+  for (const auto& match : two_view_geometry.inlier_matches) {
+    BOOST_CHECK_EQUAL(match.point2D_idx2,
+                      kNumFeatures - 1 - match.point2D_idx1);
+  }
+
+  // Translation of all points.
+  two_view_geometry.config = TwoViewGeometry::PLANAR;
+  two_view_geometry.H = Eigen::Matrix3d::Identity();
+  two_view_geometry.H(0, 2) = 10;
+  MatchGuidedSiftFeaturesCPU(SiftMatchingOptions(), keypoints1, keypoints2,
+                             descriptors1, descriptors2, &two_view_geometry);
+  BOOST_CHECK_EQUAL(two_view_geometry.inlier_matches.size(), kNumFeatures);
+  for (const auto& match : two_view_geometry.inlier_matches) {
+    BOOST_CHECK_EQUAL(match.point2D_idx2,
+                      kNumFeatures - 1 - match.point2D_idx1);
+  }
+
+  // Translation of all points in the wrong direction.
+  two_view_geometry.H(0, 2) = -10;
+  MatchGuidedSiftFeaturesCPU(SiftMatchingOptions(), keypoints1, keypoints2,
+                             descriptors1, descriptors2, &two_view_geometry);
+  BOOST_CHECK_LT(two_view_geometry.inlier_matches.size(), kNumFeatures / 10);
+}
+
 BOOST_AUTO_TEST_CASE(TestMatchSiftFeaturesGPU) {
   char app_name[] = "Test";
   int argc = 1;
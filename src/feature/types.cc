@@ -31,6 +31,8 @@
 
 #include "feature/types.h"
 
+#include <algorithm>
+
 #include "util/logging.h"
 
 namespace colmap {
@@ -104,4 +106,19 @@ float FeatureKeypoint::ComputeShear() const {
   return std::atan2(-a12, a22) - ComputeOrientation();
 }
 
+bool HasMatchScores(const FeatureMatches& matches) {
+  return !matches.empty() &&
+         std::all_of(matches.begin(), matches.end(),
+                     [](const FeatureMatch& match) { return match.score > 0; });
+}
+
+void SortMatchesByScore(FeatureMatches* matches) {
+  // Stable sort, such that matches of equal score keep their relative order
+  // and the result is deterministic.
+  std::stable_sort(matches->begin(), matches->end(),
+                   [](const FeatureMatch& match1, const FeatureMatch& match2) {
+                     return match1.score > match2.score;
+                   });
+}
+
 }  // namespace colmap
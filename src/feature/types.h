@@ -91,6 +91,12 @@ struct FeatureMatch {
 
   // Feature index in second image.
   point2D_t point2D_idx2 = kInvalidPoint2DIdx;
+
+  // Quality of the match from the ratio test, i.e. one minus the ratio of the
+  // best to the second best descriptor distance, such that higher is better.
+  // Zero if the quality is unknown, e.g., for matches read from the database.
+  // Only kept in memory and not written to the database.
+  float score = 0;
 };
 
 typedef std::vector<FeatureKeypoint> FeatureKeypoints;
@@ -98,6 +104,18 @@ typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
     FeatureDescriptors;
 typedef std::vector<FeatureMatch> FeatureMatches;
 
+// Binary feature descriptors with 256 bits per feature, packed into four 64-bit
+// words per row, which are compared by their Hamming distance.
+typedef Eigen::Matrix<uint64_t, Eigen::Dynamic, 4, Eigen::RowMajor>
+    FeatureBinaryDescriptors;
+
+// Whether there are matches and all of them have a known quality score.
+bool HasMatchScores(const FeatureMatches& matches);
+
+// Sort the matches by their score in descending order, such that the matches
+// of higher quality are at the front, as expected by `ProgressiveSampler`.
+void SortMatchesByScore(FeatureMatches* matches);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_FEATURE_TYPES_H_
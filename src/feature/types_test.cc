@@ -232,6 +232,24 @@ BOOST_AUTO_TEST_CASE(TestFeatureMatches) {
   BOOST_CHECK_EQUAL(matches.size(), 1);
   BOOST_CHECK_EQUAL(matches[0].point2D_idx1, kInvalidPoint2DIdx);
   BOOST_CHECK_EQUAL(matches[0].point2D_idx2, kInvalidPoint2DIdx);
+  BOOST_CHECK_EQUAL(matches[0].score, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestFeatureMatchScores) {
+  FeatureMatches matches;
+  BOOST_CHECK(!HasMatchScores(matches));
+  matches.emplace_back(0, 1);
+  BOOST_CHECK(!HasMatchScores(matches));
+  matches.back().score = 0.2f;
+  matches.emplace_back(1, 2);
+  matches.back().score = 0.5f;
+  matches.emplace_back(2, 3);
+  matches.back().score = 0.2f;
+  BOOST_CHECK(HasMatchScores(matches));
+  SortMatchesByScore(&matches);
+  BOOST_CHECK_EQUAL(matches[0].point2D_idx1, 1);
+  BOOST_CHECK_EQUAL(matches[1].point2D_idx1, 0);
+  BOOST_CHECK_EQUAL(matches[2].point2D_idx1, 2);
 }
 
 BOOST_AUTO_TEST_CASE(TestFeatureMatchHashing) {
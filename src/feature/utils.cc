@@ -31,6 +31,11 @@
 
 #include "feature/utils.h"
 
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+#include "util/logging.h"
 #include "util/math.h"
 
 namespace colmap {
@@ -76,6 +81,97 @@ FeatureDescriptors FeatureDescriptorsToUnsignedByte(
   return descriptors_unsigned_byte;
 }
 
+void L2NormalizeFeatureDescriptorToUnsignedByte(const float* descriptor,
+                                                const int num_dims,
+                                                uint8_t* descriptor_uint8) {
+  const Eigen::Map<const Eigen::ArrayXf> values(descriptor, num_dims);
+  const float norm = std::sqrt(values.square().sum());
+  if (norm == 0) {
+    std::fill(descriptor_uint8, descriptor_uint8 + num_dims, 0);
+    return;
+  }
+  for (int i = 0; i < num_dims; ++i) {
+    descriptor_uint8[i] = TruncateCast<float, uint8_t>(
+        std::round(512.0f * (descriptor[i] / norm)));
+  }
+}
+
+void L1RootNormalizeFeatureDescriptorToUnsignedByte(const float* descriptor,
+                                                    const int num_dims,
+                                                    uint8_t* descriptor_uint8) {
+  const Eigen::Map<const Eigen::ArrayXf> values(descriptor, num_dims);
+  const float norm = values.abs().sum();
+  if (norm == 0) {
+    std::fill(descriptor_uint8, descriptor_uint8 + num_dims, 0);
+    return;
+  }
+  for (int i = 0; i < num_dims; ++i) {
+    descriptor_uint8[i] = TruncateCast<float, uint8_t>(
+        std::round(512.0f * std::sqrt(descriptor[i] / norm)));
+  }
+}
+
+FeatureBinaryDescriptors BinarizeFeatureDescriptors(
+    const FeatureDescriptors& descriptors) {
+  CHECK_EQ(descriptors.cols(), 128);
+
+  FeatureBinaryDescriptors binary_descriptors =
+      FeatureBinaryDescriptors::Zero(descriptors.rows(), 4);
+
+  std::array<uint8_t, 128> sorted_values;
+  for (Eigen::Index i = 0; i < descriptors.rows(); ++i) {
+    const uint8_t* descriptor = descriptors.row(i).data();
+
+    std::copy(descriptor, descriptor + 128, sorted_values.begin());
+    std::nth_element(sorted_values.begin(), sorted_values.begin() + 64,
+                     sorted_values.end());
+    const uint8_t median = sorted_values[64];
+    std::nth_element(sorted_values.begin() + 64, sorted_values.begin() + 96,
+                     sorted_values.end());
+    const uint8_t upper_quartile = sorted_values[96];
+
+    uint64_t* binary_descriptor = binary_descriptors.row(i).data();
+    for (int d = 0; d < 128; ++d) {
+      const uint64_t bit = uint64_t(1) << (d % 64);
+      if (descriptor[d] > median) {
+        binary_descriptor[d / 64] |= bit;
+      }
+      if (descriptor[d] > upper_quartile) {
+        binary_descriptor[2 + d / 64] |= bit;
+      }
+    }
+  }
+
+  return binary_descriptors;
+}
+
+std::vector<size_t> SelectTopScaleFeatures(const FeatureKeypoints& keypoints,
+                                           const size_t num_features) {
+  CHECK_GT(num_features, 0);
+
+  std::vector<size_t> feature_idxs(keypoints.size());
+  std::iota(feature_idxs.begin(), feature_idxs.end(), 0);
+  if (keypoints.size() <= num_features) {
+    return feature_idxs;
+  }
+
+  std::vector<float> scales(keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    scales[i] = keypoints[i].ComputeScale();
+  }
+
+  // Only the selected features are sorted by their scale.
+  const auto CompareScales = [&](const size_t idx1, const size_t idx2) {
+    return scales[idx1] > scales[idx2];
+  };
+  std::nth_element(feature_idxs.begin(), feature_idxs.begin() + num_features,
+                   feature_idxs.end(), CompareScales);
+  feature_idxs.resize(num_features);
+  std::sort(feature_idxs.begin(), feature_idxs.end(), CompareScales);
+
+  return feature_idxs;
+}
+
 void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
                              FeatureDescriptors* descriptors,
                              const size_t num_features) {
@@ -86,31 +182,18 @@ void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
     return;
   }
 
-  FeatureKeypoints top_scale_keypoints;
-  FeatureDescriptors top_scale_descriptors;
-
-  std::vector<std::pair<size_t, float>> scales;
-  scales.reserve(static_cast<size_t>(keypoints->size()));
-  for (size_t i = 0; i < keypoints->size(); ++i) {
-    scales.emplace_back(i, (*keypoints)[i].ComputeScale());
-  }
-
-  std::partial_sort(scales.begin(), scales.begin() + num_features,
-                    scales.end(),
-                    [](const std::pair<size_t, float> scale1,
-                       const std::pair<size_t, float> scale2) {
-                      return scale1.second > scale2.second;
-                    });
+  const std::vector<size_t> feature_idxs =
+      SelectTopScaleFeatures(*keypoints, num_features);
 
-  top_scale_keypoints.resize(num_features);
-  top_scale_descriptors.resize(num_features, descriptors->cols());
+  FeatureKeypoints top_scale_keypoints(num_features);
+  FeatureDescriptors top_scale_descriptors(num_features, descriptors->cols());
   for (size_t i = 0; i < num_features; ++i) {
-    top_scale_keypoints[i] = (*keypoints)[scales[i].first];
-    top_scale_descriptors.row(i) = descriptors->row(scales[i].first);
+    top_scale_keypoints[i] = (*keypoints)[feature_idxs[i]];
+    top_scale_descriptors.row(i) = descriptors->row(feature_idxs[i]);
   }
 
-  *keypoints = top_scale_keypoints;
-  *descriptors = top_scale_descriptors;
+  keypoints->swap(top_scale_keypoints);
+  descriptors->swap(top_scale_descriptors);
 }
 
 }  // namespace colmap
@@ -57,6 +57,36 @@ Eigen::MatrixXf L1RootNormalizeFeatureDescriptors(
 FeatureDescriptors FeatureDescriptorsToUnsignedByte(
     const Eigen::MatrixXf& descriptors);
 
+// L2- or L1-Root-normalize a single floating point descriptor with the given
+// number of dimensions and convert it to the unsigned byte representation in
+// one pass. The result is equivalent to the normalization functions above
+// followed by FeatureDescriptorsToUnsignedByte, but avoids the allocation of
+// temporary matrices and additional passes over the data. A descriptor with
+// zero norm is converted to all zeros.
+void L2NormalizeFeatureDescriptorToUnsignedByte(const float* descriptor,
+                                                const int num_dims,
+                                                uint8_t* descriptor_uint8);
+void L1RootNormalizeFeatureDescriptorToUnsignedByte(const float* descriptor,
+                                                    const int num_dims,
+                                                    uint8_t* descriptor_uint8);
+
+// Binarize SIFT descriptors for fast approximate matching by their Hamming
+// distance. Each dimension is quantized to three levels by the median and the
+// upper quartile of the values of its descriptor and encoded with two bits in
+// a thermometer code, such that the Hamming distance of two binary descriptors
+// equals the L1 distance of their quantized levels. The first 128 bits encode
+// whether a dimension exceeds the median and the last 128 bits whether it
+// exceeds the upper quartile.
+FeatureBinaryDescriptors BinarizeFeatureDescriptors(
+    const FeatureDescriptors& descriptors);
+
+// Select the indices of the given number of largest-scale features in the
+// order of decreasing scale, or the indices of all features in their original
+// order if there are not more features. This allows to only convert the
+// descriptors of the selected features.
+std::vector<size_t> SelectTopScaleFeatures(const FeatureKeypoints& keypoints,
+                                           const size_t num_features);
+
 // Extract the descriptors corresponding to the largest-scale features.
 void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
                              FeatureDescriptors* descriptors,
@@ -80,6 +80,92 @@ BOOST_AUTO_TEST_CASE(TestFeatureDescriptorsToUnsignedByte) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestNormalizeFeatureDescriptorToUnsignedByte) {
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      descriptors = Eigen::MatrixXf::Random(100, 128);
+  descriptors.array() += 1.0f;
+  const FeatureDescriptors descriptors_l2 = FeatureDescriptorsToUnsignedByte(
+      L2NormalizeFeatureDescriptors(descriptors));
+  const FeatureDescriptors descriptors_l1_root =
+      FeatureDescriptorsToUnsignedByte(
+          L1RootNormalizeFeatureDescriptors(descriptors));
+  FeatureDescriptors descriptor_uint8(1, 128);
+  for (Eigen::MatrixXf::Index r = 0; r < descriptors.rows(); ++r) {
+    L2NormalizeFeatureDescriptorToUnsignedByte(descriptors.row(r).data(), 128,
+                                               descriptor_uint8.data());
+    for (Eigen::MatrixXf::Index c = 0; c < descriptors.cols(); ++c) {
+      BOOST_CHECK_LE(std::abs(static_cast<int>(descriptor_uint8(0, c)) -
+                              static_cast<int>(descriptors_l2(r, c))),
+                     1);
+    }
+    L1RootNormalizeFeatureDescriptorToUnsignedByte(
+        descriptors.row(r).data(), 128, descriptor_uint8.data());
+    for (Eigen::MatrixXf::Index c = 0; c < descriptors.cols(); ++c) {
+      BOOST_CHECK_LE(std::abs(static_cast<int>(descriptor_uint8(0, c)) -
+                              static_cast<int>(descriptors_l1_root(r, c))),
+                     1);
+    }
+  }
+
+  const Eigen::VectorXf zero_descriptor = Eigen::VectorXf::Zero(128);
+  L1RootNormalizeFeatureDescriptorToUnsignedByte(zero_descriptor.data(), 128,
+                                                 descriptor_uint8.data());
+  BOOST_CHECK_EQUAL(descriptor_uint8.cast<int>().sum(), 0);
+  L2NormalizeFeatureDescriptorToUnsignedByte(zero_descriptor.data(), 128,
+                                             descriptor_uint8.data());
+  BOOST_CHECK_EQUAL(descriptor_uint8.cast<int>().sum(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinarizeFeatureDescriptors) {
+  const FeatureDescriptors empty_descriptors(0, 128);
+  BOOST_CHECK_EQUAL(BinarizeFeatureDescriptors(empty_descriptors).rows(), 0);
+
+  FeatureDescriptors descriptors(2, 128);
+  for (int d = 0; d < 128; ++d) {
+    descriptors(0, d) = d;
+    descriptors(1, d) = 127 - d;
+  }
+
+  const FeatureBinaryDescriptors binary_descriptors =
+      BinarizeFeatureDescriptors(descriptors);
+  BOOST_CHECK_EQUAL(binary_descriptors.rows(), 2);
+
+  // The median is 64 and the upper quartile is 96.
+  BOOST_CHECK_EQUAL(binary_descriptors(0, 0), 0);
+  BOOST_CHECK_EQUAL(binary_descriptors(0, 1), 0xFFFFFFFFFFFFFFFEull);
+  BOOST_CHECK_EQUAL(binary_descriptors(0, 2), 0);
+  BOOST_CHECK_EQUAL(binary_descriptors(0, 3), 0xFFFFFFFE00000000ull);
+
+  // The dimensions are reversed, which reverses the bits of each level.
+  BOOST_CHECK_EQUAL(binary_descriptors(1, 0), 0x7FFFFFFFFFFFFFFFull);
+  BOOST_CHECK_EQUAL(binary_descriptors(1, 1), 0);
+  BOOST_CHECK_EQUAL(binary_descriptors(1, 2), 0x000000007FFFFFFFull);
+  BOOST_CHECK_EQUAL(binary_descriptors(1, 3), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestSelectTopScaleFeatures) {
+  FeatureKeypoints keypoints(5);
+  keypoints[0].Rescale(3);
+  keypoints[1].Rescale(4);
+  keypoints[2].Rescale(1);
+  keypoints[3].Rescale(5);
+  keypoints[4].Rescale(2);
+
+  const std::vector<size_t> top_idxs3 = SelectTopScaleFeatures(keypoints, 3);
+  BOOST_CHECK_EQUAL(top_idxs3.size(), 3);
+  BOOST_CHECK_EQUAL(top_idxs3[0], 3);
+  BOOST_CHECK_EQUAL(top_idxs3[1], 1);
+  BOOST_CHECK_EQUAL(top_idxs3[2], 0);
+
+  const std::vector<size_t> top_idxs6 = SelectTopScaleFeatures(keypoints, 6);
+  BOOST_CHECK_EQUAL(top_idxs6.size(), 5);
+  for (size_t i = 0; i < top_idxs6.size(); ++i) {
+    BOOST_CHECK_EQUAL(top_idxs6[i], i);
+  }
+
+  BOOST_CHECK(SelectTopScaleFeatures(FeatureKeypoints(), 1).empty());
+}
+
 BOOST_AUTO_TEST_CASE(TestExtractTopScaleFeatures) {
   FeatureKeypoints keypoints(5);
   keypoints[0].Rescale(3);
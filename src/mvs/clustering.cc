@@ -0,0 +1,277 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "mvs/clustering.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include "base/scene_clustering.h"
+#include "mvs/fusion.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/ply.h"
+
+namespace colmap {
+namespace mvs {
+
+bool ViewClusteringOptions::Check() const {
+  CHECK_OPTION_GT(max_num_images, 0);
+  CHECK_OPTION_GE(max_num_support_images, 0);
+  CHECK_OPTION_GE(num_threads, -1);
+  return true;
+}
+
+std::vector<ViewCluster> ClusterViews(const ViewClusteringOptions& options,
+                                      const Model& model) {
+  CHECK(options.Check());
+
+  const auto shared_num_points = model.ComputeSharedPoints();
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_shared_points;
+  for (size_t image_idx1 = 0; image_idx1 < shared_num_points.size();
+       ++image_idx1) {
+    for (const auto& image : shared_num_points[image_idx1]) {
+      const size_t image_idx2 = image.first;
+      if (image_idx1 < image_idx2) {
+        image_pairs.emplace_back(image_idx1, image_idx2);
+        num_shared_points.push_back(image.second);
+      }
+    }
+  }
+
+  // The reference images of the clusters must be disjoint, so the leaf
+  // clusters are partitioned without overlap and the support images are
+  // selected per cluster below.
+  SceneClustering::Options clustering_options;
+  clustering_options.image_overlap = 0;
+  clustering_options.leaf_max_num_images = options.max_num_images;
+  clustering_options.num_threads = options.num_threads;
+
+  SceneClustering scene_clustering(clustering_options);
+  scene_clustering.Partition(image_pairs, num_shared_points);
+
+  std::vector<ViewCluster> clusters;
+  std::vector<int> image_cluster_idxs(model.images.size(), -1);
+  for (const auto leaf_cluster : scene_clustering.GetLeafClusters()) {
+    if (leaf_cluster->image_ids.empty()) {
+      continue;
+    }
+    for (const auto image_id : leaf_cluster->image_ids) {
+      image_cluster_idxs.at(image_id) = static_cast<int>(clusters.size());
+    }
+    clusters.emplace_back();
+    clusters.back().ref_image_idxs.assign(leaf_cluster->image_ids.begin(),
+                                          leaf_cluster->image_ids.end());
+  }
+
+  // Images without any shared points to other images are not part of the view
+  // graph, so they are assigned to the smallest clusters.
+  for (size_t image_idx = 0; image_idx < image_cluster_idxs.size();
+       ++image_idx) {
+    if (image_cluster_idxs[image_idx] != -1) {
+      continue;
+    }
+    auto smallest_cluster = std::min_element(
+        clusters.begin(), clusters.end(),
+        [](const ViewCluster& cluster1, const ViewCluster& cluster2) {
+          return cluster1.ref_image_idxs.size() <
+                 cluster2.ref_image_idxs.size();
+        });
+    if (smallest_cluster == clusters.end() ||
+        smallest_cluster->ref_image_idxs.size() >=
+            static_cast<size_t>(options.max_num_images)) {
+      clusters.emplace_back();
+      smallest_cluster = clusters.end() - 1;
+    }
+    smallest_cluster->ref_image_idxs.push_back(image_idx);
+    image_cluster_idxs[image_idx] =
+        static_cast<int>(smallest_cluster - clusters.begin());
+  }
+
+  // Support each cluster with the images of other clusters that share the most
+  // points with its reference images.
+  for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+    auto& cluster = clusters[cluster_idx];
+    std::sort(cluster.ref_image_idxs.begin(), cluster.ref_image_idxs.end());
+
+    std::unordered_map<int, int> support_num_points;
+    for (const int ref_image_idx : cluster.ref_image_idxs) {
+      for (const auto& image : shared_num_points.at(ref_image_idx)) {
+        if (image_cluster_idxs.at(image.first) !=
+            static_cast<int>(cluster_idx)) {
+          support_num_points[image.first] += image.second;
+        }
+      }
+    }
+
+    std::vector<std::pair<int, int>> support_images(support_num_points.begin(),
+                                                    support_num_points.end());
+    std::sort(support_images.begin(), support_images.end(),
+              [](const std::pair<int, int>& image1,
+                 const std::pair<int, int>& image2) {
+                return image1.second > image2.second ||
+                       (image1.second == image2.second &&
+                        image1.first < image2.first);
+              });
+    if (support_images.size() >
+        static_cast<size_t>(options.max_num_support_images)) {
+      support_images.resize(options.max_num_support_images);
+    }
+
+    for (const auto& image : support_images) {
+      cluster.support_image_idxs.push_back(image.first);
+    }
+    std::sort(cluster.support_image_idxs.begin(),
+              cluster.support_image_idxs.end());
+  }
+
+  return clusters;
+}
+
+std::vector<ViewCluster> ReadViewClusters(const std::string& path) {
+  std::vector<ViewCluster> clusters;
+
+  const auto ReadImageIdxs = [](const std::string& line,
+                                std::vector<int>* image_idxs) {
+    std::stringstream line_stream(line);
+    size_t num_images;
+    line_stream >> num_images;
+    image_idxs->resize(num_images);
+    for (auto& image_idx : *image_idxs) {
+      line_stream >> image_idx;
+    }
+    CHECK(!line_stream.fail()) << line;
+  };
+
+  std::vector<std::string> lines;
+  for (auto& line : ReadTextFileLines(path)) {
+    StringTrim(&line);
+    if (!line.empty() && line[0] != '#') {
+      lines.push_back(line);
+    }
+  }
+
+  CHECK_EQ(lines.size() % 2, 0) << path;
+  clusters.resize(lines.size() / 2);
+  for (size_t cluster_idx = 0; cluster_idx < clusters.size(); ++cluster_idx) {
+    ReadImageIdxs(lines[2 * cluster_idx],
+                  &clusters[cluster_idx].ref_image_idxs);
+    ReadImageIdxs(lines[2 * cluster_idx + 1],
+                  &clusters[cluster_idx].support_image_idxs);
+  }
+
+  return clusters;
+}
+
+void WriteViewClusters(const std::string& path,
+                       const std::vector<ViewCluster>& clusters) {
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  file << "# View clustering with two lines per cluster:" << std::endl;
+  file << "#   NUM_REF_IMAGES, REF_IMAGE_IDX[]" << std::endl;
+  file << "#   NUM_SUPPORT_IMAGES, SUPPORT_IMAGE_IDX[]" << std::endl;
+
+  const auto WriteImageIdxs = [&file](const std::vector<int>& image_idxs) {
+    file << image_idxs.size();
+    for (const int image_idx : image_idxs) {
+      file << " " << image_idx;
+    }
+    file << std::endl;
+  };
+
+  for (const auto& cluster : clusters) {
+    WriteImageIdxs(cluster.ref_image_idxs);
+    WriteImageIdxs(cluster.support_image_idxs);
+  }
+}
+
+int FindOwnerViewCluster(const std::unordered_set<int>& image_idxs,
+                         const std::vector<int>& image_cluster_idxs) {
+  std::unordered_map<int, int> cluster_num_images;
+  for (const int image_idx : image_idxs) {
+    const int cluster_idx = image_cluster_idxs.at(image_idx);
+    if (cluster_idx != -1) {
+      cluster_num_images[cluster_idx] += 1;
+    }
+  }
+
+  int owner_cluster_idx = -1;
+  int owner_num_images = 0;
+  for (const auto& cluster : cluster_num_images) {
+    if (cluster.second > owner_num_images ||
+        (cluster.second == owner_num_images &&
+         cluster.first < owner_cluster_idx)) {
+      owner_cluster_idx = cluster.first;
+      owner_num_images = cluster.second;
+    }
+  }
+
+  return owner_cluster_idx;
+}
+
+void MergeFusedPoints(const std::vector<std::string>& input_paths,
+                      const std::string& output_path) {
+  BinaryPlyPointWriter ply_writer(output_path);
+  PointsVisibilityWriter visibility_writer(output_path + ".vis");
+
+  // The points of one cluster are read at a time, so that the memory is
+  // bounded by the largest cluster.
+  std::vector<int> point_visibility;
+  for (const auto& input_path : input_paths) {
+    std::cout << StringPrintf("Merging %s", input_path.c_str()) << std::endl;
+
+    const auto points = ReadPly(input_path);
+    const auto visibility = ReadPointsVisibility(input_path + ".vis");
+    CHECK_EQ(points.size(), visibility.NumPoints()) << input_path;
+
+    for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+      ply_writer.Write(points[point_idx]);
+      point_visibility.assign(
+          visibility.image_idxs.begin() + visibility.point_offsets[point_idx],
+          visibility.image_idxs.begin() +
+              visibility.point_offsets[point_idx + 1]);
+      visibility_writer.Write(point_visibility);
+    }
+  }
+
+  ply_writer.Close();
+  visibility_writer.Close();
+
+  std::cout << "Number of merged points: " << ply_writer.NumPoints()
+            << std::endl;
+}
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,98 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_MVS_CLUSTERING_H_
+#define COLMAP_SRC_MVS_CLUSTERING_H_
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "mvs/model.h"
+
+namespace colmap {
+namespace mvs {
+
+struct ViewClusteringOptions {
+  // The maximum number of reference images in a cluster.
+  int max_num_images = 500;
+
+  // The maximum number of images of other clusters that are added to a
+  // cluster to fuse the points at its boundary.
+  int max_num_support_images = 100;
+
+  // The number of threads used to partition the view graph.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// A cluster of views of a dense workspace, which is fused independently of the
+// other clusters, such that the memory of the fusion is bounded by the size of
+// the cluster instead of the size of the scene.
+struct ViewCluster {
+  // The images whose pixels seed the fused points of the cluster. Every image
+  // is a reference image of exactly one cluster.
+  std::vector<int> ref_image_idxs;
+
+  // The images of other clusters that most overlap with the reference images.
+  // These are only traversed to fuse the points of the reference images.
+  std::vector<int> support_image_idxs;
+};
+
+// Partition the images of the model into clusters of strongly overlapping
+// images, similar to CMVS. The view graph, in which images are connected by
+// the number of shared sparse points, is partitioned using normalized cuts.
+std::vector<ViewCluster> ClusterViews(const ViewClusteringOptions& options,
+                                      const Model& model);
+
+// Read/write the clusters from/to a text file, where the images are given by
+// their index in the model.
+std::vector<ViewCluster> ReadViewClusters(const std::string& path);
+void WriteViewClusters(const std::string& path,
+                       const std::vector<ViewCluster>& clusters);
+
+// Determine the cluster that owns a fused point with the given visible images,
+// i.e., the cluster with most of the visible images as reference images and,
+// in case of a tie, the one with the smallest index. A point at a cluster
+// boundary is fused in all adjacent clusters, but it is only kept in its owner
+// cluster, so that the fused points of all clusters can simply be merged.
+int FindOwnerViewCluster(const std::unordered_set<int>& image_idxs,
+                         const std::vector<int>& image_cluster_idxs);
+
+// Merge the fused points and their visibility of the clusters into a single
+// binary PLY file and the visibility file at "<output_path>.vis".
+void MergeFusedPoints(const std::vector<std::string>& input_paths,
+                      const std::string& output_path);
+
+}  // namespace mvs
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_MVS_CLUSTERING_H_
@@ -0,0 +1,172 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "mvs/clustering"
+#include "util/testing.h"
+
+#include <boost/filesystem.hpp>
+
+#include "mvs/clustering.h"
+#include "mvs/fusion.h"
+#include "util/ply.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+std::string CreateTempPath(const std::string& extension) {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("colmap_clustering_%%%%-%%%%" +
+                                         extension))
+      .string();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestClusterViewsSingleCluster) {
+  Model model;
+  for (int i = 0; i < 5; ++i) {
+    model.images.emplace_back();
+  }
+  model.points.resize(2);
+  model.points[0].track = {0, 1, 2};
+  model.points[1].track = {2, 3};
+
+  ViewClusteringOptions options;
+  options.max_num_images = 10;
+  const auto clusters = ClusterViews(options, model);
+  BOOST_REQUIRE_EQUAL(clusters.size(), 1);
+  BOOST_CHECK_EQUAL(clusters[0].ref_image_idxs.size(), 5);
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(clusters[0].ref_image_idxs[i], i);
+  }
+  BOOST_CHECK(clusters[0].support_image_idxs.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestClusterViewsUnconnectedImages) {
+  Model model;
+  for (int i = 0; i < 5; ++i) {
+    model.images.emplace_back();
+  }
+
+  ViewClusteringOptions options;
+  options.max_num_images = 2;
+  const auto clusters = ClusterViews(options, model);
+  BOOST_REQUIRE_EQUAL(clusters.size(), 3);
+  BOOST_CHECK_EQUAL(clusters[0].ref_image_idxs.size(), 2);
+  BOOST_CHECK_EQUAL(clusters[1].ref_image_idxs.size(), 2);
+  BOOST_CHECK_EQUAL(clusters[2].ref_image_idxs.size(), 1);
+  std::vector<int> image_idxs;
+  for (const auto& cluster : clusters) {
+    BOOST_CHECK(cluster.support_image_idxs.empty());
+    image_idxs.insert(image_idxs.end(), cluster.ref_image_idxs.begin(),
+                      cluster.ref_image_idxs.end());
+  }
+  std::sort(image_idxs.begin(), image_idxs.end());
+  BOOST_CHECK_EQUAL(image_idxs.size(), 5);
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(image_idxs[i], i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteReadViewClusters) {
+  std::vector<ViewCluster> clusters(3);
+  clusters[0].ref_image_idxs = {0, 1, 2};
+  clusters[0].support_image_idxs = {3};
+  clusters[1].ref_image_idxs = {3, 4};
+  clusters[1].support_image_idxs = {};
+  clusters[2].ref_image_idxs = {5};
+  clusters[2].support_image_idxs = {2, 4};
+
+  const std::string path = CreateTempPath(".txt");
+  WriteViewClusters(path, clusters);
+  const auto read_clusters = ReadViewClusters(path);
+  boost::filesystem::remove(path);
+
+  BOOST_REQUIRE_EQUAL(read_clusters.size(), clusters.size());
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    BOOST_CHECK(read_clusters[i].ref_image_idxs == clusters[i].ref_image_idxs);
+    BOOST_CHECK(read_clusters[i].support_image_idxs ==
+                clusters[i].support_image_idxs);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestFindOwnerViewCluster) {
+  const std::vector<int> image_cluster_idxs = {0, 0, 1, 1, 1, -1};
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({}, image_cluster_idxs), -1);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({5}, image_cluster_idxs), -1);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({0, 1}, image_cluster_idxs), 0);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({0, 2}, image_cluster_idxs), 0);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({2, 0}, image_cluster_idxs), 0);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({0, 2, 3}, image_cluster_idxs), 1);
+  BOOST_CHECK_EQUAL(FindOwnerViewCluster({0, 1, 2, 3, 5}, image_cluster_idxs),
+                    0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMergeFusedPoints) {
+  std::vector<std::string> input_paths;
+  for (int cluster_idx = 0; cluster_idx < 2; ++cluster_idx) {
+    input_paths.push_back(CreateTempPath(".ply"));
+    std::vector<PlyPoint> points(cluster_idx + 1);
+    std::vector<std::vector<int>> points_visibility(cluster_idx + 1);
+    for (size_t i = 0; i < points.size(); ++i) {
+      points[i].x = cluster_idx;
+      points[i].y = i;
+      points_visibility[i] = {cluster_idx, static_cast<int>(i) + 2};
+    }
+    WriteBinaryPlyPoints(input_paths.back(), points);
+    WritePointsVisibility(input_paths.back() + ".vis", points_visibility);
+  }
+
+  const std::string output_path = CreateTempPath(".ply");
+  MergeFusedPoints(input_paths, output_path);
+
+  const auto points = ReadPly(output_path);
+  const auto visibility = ReadPointsVisibility(output_path + ".vis");
+  BOOST_REQUIRE_EQUAL(points.size(), 3);
+  BOOST_REQUIRE_EQUAL(visibility.NumPoints(), 3);
+  BOOST_CHECK_EQUAL(points[0].x, 0);
+  BOOST_CHECK_EQUAL(points[1].x, 1);
+  BOOST_CHECK_EQUAL(points[1].y, 0);
+  BOOST_CHECK_EQUAL(points[2].x, 1);
+  BOOST_CHECK_EQUAL(points[2].y, 1);
+  BOOST_CHECK_EQUAL(visibility.image_idxs[0], 0);
+  BOOST_CHECK_EQUAL(visibility.image_idxs[1], 2);
+  BOOST_CHECK_EQUAL(visibility.image_idxs[4], 1);
+  BOOST_CHECK_EQUAL(visibility.image_idxs[5], 3);
+
+  for (const auto& path : input_paths) {
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(path + ".vis");
+  }
+  boost::filesystem::remove(output_path);
+  boost::filesystem::remove(output_path + ".vis");
+}
@@ -31,43 +31,149 @@
 
 #include "mvs/consistency_graph.h"
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
-#include <numeric>
+#include <unordered_map>
 
+#include "util/endian.h"
 #include "util/logging.h"
+#include "util/mapped_file.h"
 #include "util/misc.h"
 
 namespace colmap {
 namespace mvs {
 
-const int ConsistencyGraph::kNoConsistentImageIds = -1;
+ConsistencyGraph::ConsistencyGraph() : width_(0), height_(0) {}
 
-ConsistencyGraph::ConsistencyGraph() {}
+ConsistencyGraph::ConsistencyGraph(const size_t width, const size_t height,
+                                   const std::vector<int>& src_image_idxs,
+                                   const std::vector<uint32_t>& masks)
+    : width_(width),
+      height_(height),
+      src_image_idxs_(src_image_idxs),
+      masks_(masks) {
+  CHECK_EQ(masks_.size(), width_ * height_ * GetNumWords());
+}
 
 ConsistencyGraph::ConsistencyGraph(const size_t width, const size_t height,
                                    const std::vector<int>& data)
-    : data_(data) {
-  InitializeMap(width, height);
+    : width_(width), height_(height) {
+  for (size_t i = 0; i < data.size();) {
+    const int num_images = data.at(i + 2);
+    for (int j = 0; j < num_images; ++j) {
+      src_image_idxs_.push_back(data.at(i + 3 + j));
+    }
+    i += 3 + num_images;
+  }
+
+  std::sort(src_image_idxs_.begin(), src_image_idxs_.end());
+  src_image_idxs_.erase(
+      std::unique(src_image_idxs_.begin(), src_image_idxs_.end()),
+      src_image_idxs_.end());
+
+  std::unordered_map<int, size_t> src_image_positions;
+  for (size_t i = 0; i < src_image_idxs_.size(); ++i) {
+    src_image_positions.emplace(src_image_idxs_[i], i);
+  }
+
+  const size_t num_words = GetNumWords();
+  masks_.resize(width_ * height_ * num_words, 0);
+  for (size_t i = 0; i < data.size();) {
+    const size_t col = data.at(i);
+    const size_t row = data.at(i + 1);
+    CHECK_LT(col, width_);
+    CHECK_LT(row, height_);
+    const int num_images = data.at(i + 2);
+    uint32_t* mask = &masks_[(row * width_ + col) * num_words];
+    for (int j = 0; j < num_images; ++j) {
+      const size_t position = src_image_positions.at(data.at(i + 3 + j));
+      mask[position / 32] |= 1u << (position % 32);
+    }
+    i += 3 + num_images;
+  }
 }
 
+size_t ConsistencyGraph::GetWidth() const { return width_; }
+
+size_t ConsistencyGraph::GetHeight() const { return height_; }
+
 size_t ConsistencyGraph::GetNumBytes() const {
-  return (data_.size() + map_.size()) * sizeof(int);
+  return src_image_idxs_.size() * sizeof(int) +
+         masks_.size() * sizeof(uint32_t);
+}
+
+const std::vector<int>& ConsistencyGraph::GetSrcImageIdxs() const {
+  return src_image_idxs_;
+}
+
+size_t ConsistencyGraph::GetNumWords() const {
+  return (src_image_idxs_.size() + 31) / 32;
+}
+
+const uint32_t* ConsistencyGraph::GetMask(const int row, const int col) const {
+  return masks_.data() + (row * width_ + col) * GetNumWords();
 }
 
 void ConsistencyGraph::GetImageIdxs(const int row, const int col,
-                                    int* num_images,
-                                    const int** image_idxs) const {
-  const int index = map_(row, col);
-  if (index == kNoConsistentImageIds) {
-    *num_images = 0;
-    *image_idxs = nullptr;
-  } else {
-    *num_images = data_.at(index);
-    *image_idxs = &data_.at(index + 1);
+                                    std::vector<int>* image_idxs) const {
+  image_idxs->clear();
+  const uint32_t* mask = GetMask(row, col);
+  for (size_t i = 0; i < src_image_idxs_.size(); ++i) {
+    if (mask[i / 32] & (1u << (i % 32))) {
+      image_idxs->push_back(src_image_idxs_[i]);
+    }
   }
 }
 
 void ConsistencyGraph::Read(const std::string& path) {
+  {
+    std::ifstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+    char magic[sizeof(kConsistencyGraphMagic)] = {0};
+    file.read(magic, sizeof(magic));
+    if (!file ||
+        std::memcmp(magic, kConsistencyGraphMagic, sizeof(magic)) != 0) {
+      file.close();
+      ReadLegacy(path);
+      return;
+    }
+  }
+
+  const MappedFile file(path);
+
+  size_t offset = sizeof(kConsistencyGraphMagic);
+  CHECK_EQ(file.Read<uint32_t>(&offset), kConsistencyGraphVersion)
+      << "Incompatible consistency graph file " << path;
+  width_ = file.Read<uint64_t>(&offset);
+  height_ = file.Read<uint64_t>(&offset);
+
+  const size_t num_src_images = file.Read<uint64_t>(&offset);
+  const int32_t* src_image_idxs =
+      file.ReadArray<int32_t>(&offset, num_src_images);
+  src_image_idxs_.assign(src_image_idxs, src_image_idxs + num_src_images);
+
+  const size_t num_words = width_ * height_ * GetNumWords();
+  const uint32_t* masks = file.ReadArray<uint32_t>(&offset, num_words);
+  masks_.assign(masks, masks + num_words);
+}
+
+void ConsistencyGraph::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  CHECK(file.is_open()) << path;
+  file.write(kConsistencyGraphMagic, sizeof(kConsistencyGraphMagic));
+  WriteMapped(&file, kConsistencyGraphVersion);
+  WriteMapped(&file, static_cast<uint64_t>(width_));
+  WriteMapped(&file, static_cast<uint64_t>(height_));
+  WriteMapped(&file, static_cast<uint64_t>(src_image_idxs_.size()));
+  const std::vector<int32_t> src_image_idxs(src_image_idxs_.begin(),
+                                            src_image_idxs_.end());
+  WriteMappedArray(&file, src_image_idxs.data(), src_image_idxs.size());
+  WriteMappedArray(&file, masks_.data(), masks_.size());
+  CHECK(file.good()) << path;
+}
+
+void ConsistencyGraph::ReadLegacy(const std::string& path) {
   std::fstream text_file(path, std::ios::in | std::ios::binary);
   CHECK(text_file.is_open()) << path;
 
@@ -91,40 +197,13 @@ void ConsistencyGraph::Read(const std::string& path) {
   binary_file.seekg(0, std::ios::end);
   const size_t num_bytes = binary_file.tellg() - pos;
 
-  data_.resize(num_bytes / sizeof(int));
+  std::vector<int> data(num_bytes / sizeof(int));
 
   binary_file.seekg(pos);
-  ReadBinaryLittleEndian<int>(&binary_file, &data_);
-  binary_file.close();
-
-  InitializeMap(width, height);
-}
-
-void ConsistencyGraph::Write(const std::string& path) const {
-  std::fstream text_file(path, std::ios::out);
-  CHECK(text_file.is_open()) << path;
-  text_file << map_.cols() << "&" << map_.rows() << "&" << 1 << "&";
-  text_file.close();
-
-  std::fstream binary_file(path,
-                           std::ios::out | std::ios::binary | std::ios::app);
-  CHECK(binary_file.is_open()) << path;
-  WriteBinaryLittleEndian<int>(&binary_file, data_);
+  ReadBinaryLittleEndian<int>(&binary_file, &data);
   binary_file.close();
-}
 
-void ConsistencyGraph::InitializeMap(const size_t width, const size_t height) {
-  map_.resize(height, width);
-  map_.setConstant(kNoConsistentImageIds);
-  for (size_t i = 0; i < data_.size();) {
-    const int num_images = data_.at(i + 2);
-    if (num_images > 0) {
-      const int col = data_.at(i);
-      const int row = data_.at(i + 1);
-      map_(row, col) = i + 2;
-    }
-    i += 3 + num_images;
-  }
+  *this = ConsistencyGraph(width, height, data);
 }
 
 }  // namespace mvs
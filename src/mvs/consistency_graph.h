@@ -32,45 +32,72 @@
 #ifndef COLMAP_SRC_MVS_CONSISTENCY_GRAPH_H_
 #define COLMAP_SRC_MVS_CONSISTENCY_GRAPH_H_
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
-#include <Eigen/Core>
-
 #include "util/types.h"
 
 namespace colmap {
 namespace mvs {
 
-// List of geometrically consistent images, in the following format:
-//
-//    r_1, c_1, N_1, i_11, i_12, ..., i_1N_1,
-//    r_2, c_2, N_2, i_21, i_22, ..., i_2N_2, ...
-//
-// where r, c are the row and column image coordinates of the pixel,
-// N is the number of consistent images, followed by the N image indices.
-// Note that only pixels are listed which are not filtered and that the
-// consistency graph is only filled if filtering is enabled.
+// Identifier and version of the mask format of consistency graphs.
+const char kConsistencyGraphMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'C', 'G'};
+const uint32_t kConsistencyGraphVersion = 1;
+
+// Masks of the geometrically consistent source images for each pixel of a
+// reference image. Each pixel stores ceil(N / 32) words of 32 bits, where bit
+// i of word j is set, if the source image at index 32 * j + i in the list of
+// the N source images of the problem is consistent. Note that the consistency
+// graph is only filled if filtering is enabled.
 class ConsistencyGraph {
  public:
   ConsistencyGraph();
+
+  // Construct from the masks, where the words of a pixel are contiguous and
+  // the pixels are stored in row-major order.
+  ConsistencyGraph(const size_t width, const size_t height,
+                   const std::vector<int>& src_image_idxs,
+                   const std::vector<uint32_t>& masks);
+
+  // Construct from a list of consistent images in the legacy format:
+  //
+  //    c_1, r_1, N_1, i_11, i_12, ..., i_1N_1,
+  //    c_2, r_2, N_2, i_21, i_22, ..., i_2N_2, ...
+  //
+  // where c, r are the column and row image coordinates of the pixel,
+  // N is the number of consistent images, followed by the N image indices.
   ConsistencyGraph(const size_t width, const size_t height,
                    const std::vector<int>& data);
 
+  size_t GetWidth() const;
+  size_t GetHeight() const;
   size_t GetNumBytes() const;
 
-  void GetImageIdxs(const int row, const int col, int* num_images,
-                    const int** image_idxs) const;
+  const std::vector<int>& GetSrcImageIdxs() const;
+
+  // The number of mask words per pixel.
+  size_t GetNumWords() const;
+
+  // The mask words of a pixel.
+  const uint32_t* GetMask(const int row, const int col) const;
+
+  // The indices of the consistent images of a pixel.
+  void GetImageIdxs(const int row, const int col,
+                    std::vector<int>* image_idxs) const;
 
+  // Read the consistency graph in the mask or legacy format and write it in
+  // the mask format.
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
  private:
-  void InitializeMap(const size_t width, const size_t height);
+  void ReadLegacy(const std::string& path);
 
-  const static int kNoConsistentImageIds;
-  std::vector<int> data_;
-  Eigen::MatrixXi map_;
+  size_t width_;
+  size_t height_;
+  std::vector<int> src_image_idxs_;
+  std::vector<uint32_t> masks_;
 };
 
 }  // namespace mvs
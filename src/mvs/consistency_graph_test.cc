@@ -32,7 +32,12 @@
 #define TEST_NAME "mvs/consistency_graph_test"
 #include "util/testing.h"
 
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
 #include "mvs/consistency_graph.h"
+#include "util/endian.h"
 
 using namespace colmap;
 using namespace colmap::mvs;
@@ -40,60 +45,124 @@ using namespace colmap::mvs;
 BOOST_AUTO_TEST_CASE(TestEmpty) {
   const std::vector<int> data;
   ConsistencyGraph consistency_graph(2, 2, data);
+  BOOST_CHECK_EQUAL(consistency_graph.GetWidth(), 2);
+  BOOST_CHECK_EQUAL(consistency_graph.GetHeight(), 2);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumWords(), 0);
+  std::vector<int> image_idxs = {1};
   for (size_t i = 0; i < 2; ++i) {
     for (size_t j = 0; j < 2; ++j) {
-      int num_images;
-      const int* image_idxs;
-      consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-      BOOST_CHECK_EQUAL(num_images, 0);
-      BOOST_CHECK(image_idxs == nullptr);
+      consistency_graph.GetImageIdxs(i, j, &image_idxs);
+      BOOST_CHECK(image_idxs.empty());
     }
   }
-  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 16);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 0);
 }
 
 BOOST_AUTO_TEST_CASE(TestPartial) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33};
   ConsistencyGraph consistency_graph(2, 1, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 3);
+  BOOST_CHECK_EQUAL(consistency_graph.GetSrcImageIdxs().size(), 3);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumWords(), 1);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK_EQUAL(image_idxs.size(), 3);
   BOOST_CHECK_EQUAL(image_idxs[0], 5);
   BOOST_CHECK_EQUAL(image_idxs[1], 7);
   BOOST_CHECK_EQUAL(image_idxs[2], 33);
-  consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 0);
-  BOOST_CHECK(image_idxs == nullptr);
-  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 32);
+  BOOST_CHECK_EQUAL(consistency_graph.GetMask(0, 0)[0], 7);
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  BOOST_CHECK(image_idxs.empty());
+  BOOST_CHECK_EQUAL(consistency_graph.GetMask(0, 1)[0], 0);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 20);
 }
 
 BOOST_AUTO_TEST_CASE(TestZero) {
   const std::vector<int> data = {0, 0, 0};
   ConsistencyGraph consistency_graph(2, 1, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 0);
-  BOOST_CHECK(image_idxs == nullptr);
-  consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 0);
-  BOOST_CHECK(image_idxs == nullptr);
-  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 20);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK(image_idxs.empty());
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  BOOST_CHECK(image_idxs.empty());
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 0);
 }
 
 BOOST_AUTO_TEST_CASE(TestFull) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33, 0, 1, 1, 100};
   ConsistencyGraph consistency_graph(1, 2, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 3);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK_EQUAL(image_idxs.size(), 3);
   BOOST_CHECK_EQUAL(image_idxs[0], 5);
   BOOST_CHECK_EQUAL(image_idxs[1], 7);
   BOOST_CHECK_EQUAL(image_idxs[2], 33);
-  consistency_graph.GetImageIdxs(1, 0, &num_images, &image_idxs);
-  BOOST_CHECK_EQUAL(num_images, 1);
+  consistency_graph.GetImageIdxs(1, 0, &image_idxs);
+  BOOST_CHECK_EQUAL(image_idxs.size(), 1);
   BOOST_CHECK_EQUAL(image_idxs[0], 100);
-  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 48);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 24);
+}
+
+BOOST_AUTO_TEST_CASE(TestMasks) {
+  // Use more source images than fit into a single mask word.
+  std::vector<int> src_image_idxs(40);
+  for (size_t i = 0; i < src_image_idxs.size(); ++i) {
+    src_image_idxs[i] = 2 * i;
+  }
+  const std::vector<uint32_t> masks = {0, 0, 0x80000001u, 0x81u};
+  ConsistencyGraph consistency_graph(2, 1, src_image_idxs, masks);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumWords(), 2);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK(image_idxs.empty());
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  BOOST_CHECK_EQUAL(image_idxs.size(), 4);
+  BOOST_CHECK_EQUAL(image_idxs[0], 0);
+  BOOST_CHECK_EQUAL(image_idxs[1], 62);
+  BOOST_CHECK_EQUAL(image_idxs[2], 64);
+  BOOST_CHECK_EQUAL(image_idxs[3], 78);
+  BOOST_CHECK_EQUAL(consistency_graph.GetNumBytes(), 40 * 4 + 4 * 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_consistency_%%%%-%%%%.bin"))
+          .string();
+
+  const std::vector<int> data = {0, 0, 3, 5, 7, 33, 0, 1, 1, 100};
+  const ConsistencyGraph consistency_graph(1, 2, data);
+  consistency_graph.Write(path);
+
+  ConsistencyGraph read_consistency_graph;
+  read_consistency_graph.Read(path);
+  BOOST_CHECK_EQUAL(read_consistency_graph.GetWidth(), 1);
+  BOOST_CHECK_EQUAL(read_consistency_graph.GetHeight(), 2);
+  BOOST_CHECK(read_consistency_graph.GetSrcImageIdxs() ==
+              consistency_graph.GetSrcImageIdxs());
+  std::vector<int> image_idxs;
+  read_consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK(image_idxs == std::vector<int>({5, 7, 33}));
+  read_consistency_graph.GetImageIdxs(1, 0, &image_idxs);
+  BOOST_CHECK(image_idxs == std::vector<int>({100}));
+
+  // Write the graph in the legacy format.
+  {
+    std::fstream text_file(path, std::ios::out | std::ios::trunc);
+    text_file << 1 << "&" << 2 << "&" << 1 << "&";
+    text_file.close();
+    std::fstream binary_file(path,
+                             std::ios::out | std::ios::binary | std::ios::app);
+    WriteBinaryLittleEndian<int>(&binary_file, data);
+  }
+
+  read_consistency_graph = ConsistencyGraph();
+  read_consistency_graph.Read(path);
+  BOOST_CHECK_EQUAL(read_consistency_graph.GetWidth(), 1);
+  BOOST_CHECK_EQUAL(read_consistency_graph.GetHeight(), 2);
+  read_consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  BOOST_CHECK(image_idxs == std::vector<int>({5, 7, 33}));
+  read_consistency_graph.GetImageIdxs(1, 0, &image_idxs);
+  BOOST_CHECK(image_idxs == std::vector<int>({100}));
+
+  boost::filesystem::remove(path);
 }
@@ -32,8 +32,10 @@
 #ifndef COLMAP_SRC_MVS_CUDA_ARRAY_WRAPPER_H_
 #define COLMAP_SRC_MVS_CUDA_ARRAY_WRAPPER_H_
 
+#include <cstring>
 #include <memory>
 
+#include <cuda_fp16.h>
 #include <cuda_runtime.h>
 
 #include "mvs/gpu_mat.h"
@@ -42,15 +44,38 @@
 namespace colmap {
 namespace mvs {
 
+// Layered array on the device, which is read through a texture object in the
+// kernels. The array is allocated on the first copy and then reused for all
+// following copies, so that the texture object remains valid.
+namespace internal {
+
+template <typename T>
+cudaChannelFormatDesc CreateChannelDesc() {
+  return cudaCreateChannelDesc<T>();
+}
+
+// Half precision elements are read as single precision in the kernels.
+template <>
+inline cudaChannelFormatDesc CreateChannelDesc<__half>() {
+  return cudaCreateChannelDescHalf();
+}
+
+}  // namespace internal
+
 template <typename T>
 class CudaArrayWrapper {
  public:
-  CudaArrayWrapper(const size_t width, const size_t height, const size_t depth);
+  CudaArrayWrapper(
+      const size_t width, const size_t height, const size_t depth,
+      const cudaTextureFilterMode filter_mode = cudaFilterModePoint,
+      const cudaTextureReadMode read_mode = cudaReadModeElementType);
   ~CudaArrayWrapper();
 
   const cudaArray* GetPtr() const;
   cudaArray* GetPtr();
 
+  cudaTextureObject_t GetTexture() const;
+
   size_t GetWidth() const;
   size_t GetHeight() const;
   size_t GetDepth() const;
@@ -69,10 +94,14 @@ class CudaArrayWrapper {
   void Deallocate();
 
   cudaArray* array_;
+  cudaTextureObject_t texture_;
 
   size_t width_;
   size_t height_;
   size_t depth_;
+
+  cudaTextureFilterMode filter_mode_;
+  cudaTextureReadMode read_mode_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -81,8 +110,16 @@ class CudaArrayWrapper {
 
 template <typename T>
 CudaArrayWrapper<T>::CudaArrayWrapper(const size_t width, const size_t height,
-                                      const size_t depth)
-    : width_(width), height_(height), depth_(depth), array_(nullptr) {}
+                                      const size_t depth,
+                                      const cudaTextureFilterMode filter_mode,
+                                      const cudaTextureReadMode read_mode)
+    : array_(nullptr),
+      texture_(0),
+      width_(width),
+      height_(height),
+      depth_(depth),
+      filter_mode_(filter_mode),
+      read_mode_(read_mode) {}
 
 template <typename T>
 CudaArrayWrapper<T>::~CudaArrayWrapper() {
@@ -99,6 +136,11 @@ cudaArray* CudaArrayWrapper<T>::GetPtr() {
   return array_;
 }
 
+template <typename T>
+cudaTextureObject_t CudaArrayWrapper<T>::GetTexture() const {
+  return texture_;
+}
+
 template <typename T>
 size_t CudaArrayWrapper<T>::GetWidth() const {
   return width_;
@@ -151,14 +193,47 @@ void CudaArrayWrapper<T>::CopyFromGpuMat(const GpuMat<T>& array) {
 
 template <typename T>
 void CudaArrayWrapper<T>::Allocate() {
-  Deallocate();
+  if (array_ != nullptr) {
+    return;
+  }
+
   struct cudaExtent extent = make_cudaExtent(width_, height_, depth_);
-  cudaChannelFormatDesc fmt = cudaCreateChannelDesc<T>();
-  CUDA_SAFE_CALL(cudaMalloc3DArray(&array_, &fmt, extent, cudaArrayLayered));
+  cudaChannelFormatDesc fmt = internal::CreateChannelDesc<T>();
+  const cudaError_t error =
+      cudaMalloc3DArray(&array_, &fmt, extent, cudaArrayLayered);
+  if (error == cudaErrorMemoryAllocation) {
+    // Reset the error and retry after releasing the cached device memory.
+    cudaGetLastError();
+    CudaFreeCachedMemory();
+    CUDA_SAFE_CALL(cudaMalloc3DArray(&array_, &fmt, extent, cudaArrayLayered));
+  } else {
+    CUDA_SAFE_CALL(error);
+  }
+
+  cudaResourceDesc resource_desc;
+  memset(&resource_desc, 0, sizeof(resource_desc));
+  resource_desc.resType = cudaResourceTypeArray;
+  resource_desc.res.array.array = array_;
+
+  cudaTextureDesc texture_desc;
+  memset(&texture_desc, 0, sizeof(texture_desc));
+  texture_desc.addressMode[0] = cudaAddressModeBorder;
+  texture_desc.addressMode[1] = cudaAddressModeBorder;
+  texture_desc.addressMode[2] = cudaAddressModeBorder;
+  texture_desc.filterMode = filter_mode_;
+  texture_desc.readMode = read_mode_;
+  texture_desc.normalizedCoords = 0;
+
+  CUDA_SAFE_CALL(cudaCreateTextureObject(&texture_, &resource_desc,
+                                         &texture_desc, nullptr));
 }
 
 template <typename T>
 void CudaArrayWrapper<T>::Deallocate() {
+  if (texture_ != 0) {
+    CUDA_SAFE_CALL(cudaDestroyTextureObject(texture_));
+    texture_ = 0;
+  }
   if (array_ != nullptr) {
     CUDA_SAFE_CALL(cudaFreeArray(array_));
     array_ = nullptr;
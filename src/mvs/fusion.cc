@@ -31,8 +31,17 @@
 
 #include "mvs/fusion.h"
 
+#include <iterator>
+#include <unordered_map>
+
+#include "mvs/clustering.h"
+#include "util/metrics.h"
 #include "util/misc.h"
 
+#ifdef CUDA_ENABLED
+#include "mvs/fusion_cuda.h"
+#endif  // CUDA_ENABLED
+
 namespace colmap {
 namespace mvs {
 namespace internal {
@@ -92,6 +101,10 @@ void StereoFusionOptions::Print() const {
   PrintOption(max_normal_error);
   PrintOption(check_num_images);
   PrintOption(cache_size);
+  PrintOption(num_threads);
+  PrintOption(use_gpu);
+  PrintOption(gpu_index);
+  PrintOption(gpu_cache_size);
 #undef PrintOption
 }
 
@@ -104,6 +117,8 @@ bool StereoFusionOptions::Check() const {
   CHECK_OPTION_GE(max_normal_error, 0);
   CHECK_OPTION_GT(check_num_images, 0);
   CHECK_OPTION_GT(cache_size, 0);
+  CHECK_OPTION_GE(gpu_index, -1);
+  CHECK_OPTION_GT(gpu_cache_size, 0);
   return true;
 }
 
@@ -119,10 +134,27 @@ StereoFusion::StereoFusion(const StereoFusionOptions& options,
       input_type_(input_type),
       max_squared_reproj_error_(options_.max_reproj_error *
                                 options_.max_reproj_error),
-      min_cos_normal_error_(std::cos(DegToRad(options_.max_normal_error))) {
+      min_cos_normal_error_(std::cos(DegToRad(options_.max_normal_error))),
+      cluster_idx_(-1),
+      use_gpu_(false) {
   CHECK(options_.Check());
 }
 
+void StereoFusion::SetOutputPath(const std::string& output_path) {
+  output_path_ = output_path;
+}
+
+void StereoFusion::SetTilesOutputPath(const std::string& tiles_output_path) {
+  tiles_output_path_ = tiles_output_path;
+}
+
+void StereoFusion::SetViewCluster(const std::string& cluster_path,
+                                  const int cluster_idx) {
+  CHECK_GE(cluster_idx, 0);
+  cluster_path_ = cluster_path;
+  cluster_idx_ = cluster_idx;
+}
+
 const std::vector<PlyPoint>& StereoFusion::GetFusedPoints() const {
   return fused_points_;
 }
@@ -178,18 +210,55 @@ void StereoFusion::Run() {
 
   used_images_.resize(model.images.size(), false);
   fused_images_.resize(model.images.size(), false);
+  ref_images_.resize(model.images.size(), false);
   fused_pixel_masks_.resize(model.images.size());
+  loaded_images_ = std::vector<std::atomic<bool>>(model.images.size());
+  bitmaps_.resize(model.images.size());
+  depth_maps_.resize(model.images.size());
+  normal_maps_.resize(model.images.size());
   depth_map_sizes_.resize(model.images.size());
   bitmap_scales_.resize(model.images.size());
   P_.resize(model.images.size());
   inv_P_.resize(model.images.size());
   inv_R_.resize(model.images.size());
 
+  // The images of the view cluster, if only a cluster is fused, where the
+  // reference images are marked by true.
+  std::unordered_map<int, bool> cluster_images;
+  image_cluster_idxs_.clear();
+  if (cluster_idx_ >= 0) {
+    const auto clusters = ReadViewClusters(cluster_path_);
+    CHECK_LT(cluster_idx_, clusters.size()) << cluster_path_;
+    image_cluster_idxs_.resize(model.images.size(), -1);
+    for (size_t cluster_idx = 0; cluster_idx < clusters.size();
+         ++cluster_idx) {
+      for (const int image_idx : clusters[cluster_idx].ref_image_idxs) {
+        image_cluster_idxs_.at(image_idx) = static_cast<int>(cluster_idx);
+      }
+    }
+    for (const int image_idx : clusters[cluster_idx_].support_image_idxs) {
+      cluster_images.emplace(image_idx, false);
+    }
+    for (const int image_idx : clusters[cluster_idx_].ref_image_idxs) {
+      cluster_images[image_idx] = true;
+    }
+    std::cout << StringPrintf("Fusing cluster %d with %d reference and %d "
+                              "support images",
+                              cluster_idx_,
+                              clusters[cluster_idx_].ref_image_idxs.size(),
+                              clusters[cluster_idx_].support_image_idxs.size())
+              << std::endl;
+  }
+
   const auto image_names = ReadTextFileLines(JoinPaths(
       workspace_path_, workspace_options.stereo_folder, "fusion.cfg"));
   for (const auto& image_name : image_names) {
     const int image_idx = model.GetImageIdx(image_name);
 
+    if (cluster_idx_ >= 0 && cluster_images.count(image_idx) == 0) {
+      continue;
+    }
+
     if (!workspace_->HasBitmap(image_idx) ||
         !workspace_->HasDepthMap(image_idx) ||
         !workspace_->HasNormalMap(image_idx)) {
@@ -205,10 +274,11 @@ void StereoFusion::Run() {
     const auto& depth_map = workspace_->GetDepthMap(image_idx);
 
     used_images_.at(image_idx) = true;
+    ref_images_.at(image_idx) =
+        cluster_idx_ < 0 || cluster_images.at(image_idx);
 
-    fused_pixel_masks_.at(image_idx) =
-        Mat<bool>(depth_map.GetWidth(), depth_map.GetHeight(), 1);
-    fused_pixel_masks_.at(image_idx).Fill(false);
+    fused_pixel_masks_.at(image_idx) = std::vector<std::atomic<bool>>(
+        depth_map.GetWidth() * depth_map.GetHeight());
 
     depth_map_sizes_.at(image_idx) =
         std::make_pair(depth_map.GetWidth(), depth_map.GetHeight());
@@ -235,9 +305,68 @@ void StereoFusion::Run() {
             .transpose();
   }
 
+  ThreadPool thread_pool(options_.num_threads);
+  thread_buffers_.clear();
+  thread_buffers_.resize(thread_pool.NumThreads());
+
+  std::unique_ptr<BinaryPlyPointWriter> ply_writer;
+  std::unique_ptr<PointsVisibilityWriter> visibility_writer;
+  if (!output_path_.empty()) {
+    std::cout << "Writing output: " << output_path_ << std::endl;
+    ply_writer.reset(new BinaryPlyPointWriter(output_path_));
+    visibility_writer.reset(new PointsVisibilityWriter(output_path_ + ".vis"));
+  }
+
+  std::unique_ptr<OctreeTilesWriter> tiles_writer;
+  if (!tiles_output_path_.empty()) {
+    std::cout << "Writing tiles: " << tiles_output_path_ << std::endl;
+    OctreeTilesOptions tiles_options;
+    tiles_options.num_threads = options_.num_threads;
+    tiles_writer.reset(
+        new OctreeTilesWriter(tiles_options, tiles_output_path_));
+  }
+
+  use_gpu_ = false;
+#ifdef CUDA_ENABLED
+  std::unique_ptr<FusionCuda> fusion_cuda;
+  if (options_.use_gpu) {
+    FusionCuda::Options cuda_options;
+    cuda_options.max_reproj_error = options_.max_reproj_error;
+    cuda_options.max_depth_error = options_.max_depth_error;
+    cuda_options.min_cos_normal_error = min_cos_normal_error_;
+    cuda_options.cache_size = options_.gpu_cache_size;
+    fusion_cuda.reset(new FusionCuda(cuda_options, options_.gpu_index));
+    use_gpu_ = true;
+  }
+#else   // CUDA_ENABLED
+  if (options_.use_gpu) {
+    std::cout << "WARNING: Fusing on the CPU, because COLMAP was compiled "
+                 "without CUDA support."
+              << std::endl;
+  }
+#endif  // CUDA_ENABLED
+
   size_t num_fused_images = 0;
-  for (int image_idx = 0; image_idx >= 0;
-       image_idx = internal::FindNextImage(overlapping_images_, used_images_,
+  size_t num_fused_points = 0;
+  MetricGauge& num_fused_images_metric = GetMetricGauge(
+      "fusion_num_fused_images", "Number of fused images");
+  MetricGauge& num_fused_points_metric = GetMetricGauge(
+      "fusion_num_fused_points", "Number of fused points");
+  // Only the reference images of a view cluster are fused, while its support
+  // images are only traversed from the reference images.
+  const size_t num_images =
+      cluster_idx_ < 0
+          ? model.images.size()
+          : std::count(ref_images_.begin(), ref_images_.end(), true);
+  const int first_image_idx =
+      (cluster_idx_ < 0 || ref_images_.at(0))
+          ? 0
+          : internal::FindNextImage(overlapping_images_, ref_images_,
+                                    fused_images_, 0);
+  GetMetricGauge("fusion_num_images", "Number of images to fuse")
+      .Set(num_images);
+  for (int image_idx = first_image_idx; image_idx >= 0;
+       image_idx = internal::FindNextImage(overlapping_images_, ref_images_,
                                            fused_images_, image_idx)) {
     if (IsStopped()) {
       break;
@@ -247,85 +376,236 @@ void StereoFusion::Run() {
     timer.Start();
 
     std::cout << StringPrintf("Fusing image [%d/%d]", num_fused_images + 1,
-                              model.images.size())
+                              num_images)
               << std::flush;
 
-    const int width = depth_map_sizes_.at(image_idx).first;
-    const int height = depth_map_sizes_.at(image_idx).second;
-    const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
+    ReadImageData(image_idx);
 
-    FusionData data;
-    data.image_idx = image_idx;
-    data.traversal_depth = 0;
+#ifdef CUDA_ENABLED
+    if (fusion_cuda) {
+      ComputeConsistentPixels(image_idx, fusion_cuda.get());
+    }
+#endif  // CUDA_ENABLED
 
-    for (data.row = 0; data.row < height; ++data.row) {
-      for (data.col = 0; data.col < width; ++data.col) {
-        if (fused_pixel_mask.Get(data.row, data.col)) {
-          continue;
-        }
+    // Use more tiles than threads to balance the load, since the number of
+    // fused points strongly varies between different parts of the image.
+    const int height = depth_map_sizes_.at(image_idx).second;
+    const int num_tiles =
+        std::min(height, 4 * static_cast<int>(thread_pool.NumThreads()));
+    std::vector<FusionTile> tiles(num_tiles);
+    for (int tile_idx = 0; tile_idx < num_tiles; ++tile_idx) {
+      FusionTile* tile = &tiles[tile_idx];
+      tile->row_start = tile_idx * height / num_tiles;
+      tile->row_end = (tile_idx + 1) * height / num_tiles;
+      thread_pool.AddTask([this, image_idx, tile, &thread_pool]() {
+        FuseTile(image_idx, tile,
+                 &thread_buffers_.at(thread_pool.GetThreadIndex()));
+      });
+    }
 
-        fusion_queue_.push_back(data);
+    thread_pool.Wait();
 
-        Fuse();
+    // Merge the points in the order of the tiles, such that the order of the
+    // points is the same as for sequential fusion.
+    for (auto& tile : tiles) {
+      num_fused_points += tile.fused_points.size();
+      if (tiles_writer) {
+        for (const auto& point : tile.fused_points) {
+          tiles_writer->Write(point);
+        }
+      }
+      if (ply_writer) {
+        for (size_t i = 0; i < tile.fused_points.size(); ++i) {
+          ply_writer->Write(tile.fused_points[i]);
+          visibility_writer->Write(tile.fused_points_visibility[i]);
+        }
+      } else if (!tiles_writer) {
+        fused_points_.insert(fused_points_.end(), tile.fused_points.begin(),
+                             tile.fused_points.end());
+        fused_points_visibility_.insert(
+            fused_points_visibility_.end(),
+            std::make_move_iterator(tile.fused_points_visibility.begin()),
+            std::make_move_iterator(tile.fused_points_visibility.end()));
       }
     }
 
     num_fused_images += 1;
     fused_images_.at(image_idx) = true;
 
-    std::cout << StringPrintf(" in %.3fs (%d points)", timer.ElapsedSeconds(),
-                              fused_points_.size())
-              << std::endl;
+    // A fused image is never traversed again, so its data can be released.
+    workspace_->EvictImage(image_idx);
+    std::vector<std::atomic<bool>>().swap(fused_pixel_masks_.at(image_idx));
+#ifdef CUDA_ENABLED
+    if (fusion_cuda) {
+      fusion_cuda->EvictImage(image_idx);
+    }
+#endif  // CUDA_ENABLED
+
+    std::cout << StringPrintf(" in %.3fs", timer.ElapsedSeconds()) << " ("
+              << num_fused_points << " points)" << std::endl;
+
+    num_fused_images_metric.Set(num_fused_images);
+    num_fused_points_metric.Set(num_fused_points);
+  }
+
+  thread_buffers_.clear();
+  bitmaps_.clear();
+  depth_maps_.clear();
+  normal_maps_.clear();
+  consistent_pixels_ = Mat<int>();
+  consistent_image_idxs_.clear();
+
+  if (ply_writer) {
+    ply_writer->Close();
+    visibility_writer->Close();
+  }
+
+  if (tiles_writer) {
+    tiles_writer->Close();
   }
 
   fused_points_.shrink_to_fit();
   fused_points_visibility_.shrink_to_fit();
 
-  if (fused_points_.empty()) {
+  if (num_fused_points == 0) {
     std::cout << "WARNING: Could not fuse any points. This is likely caused by "
                  "incorrect settings - filtering must be enabled for the last "
                  "call to patch match stereo."
               << std::endl;
   }
 
-  std::cout << "Number of fused points: " << fused_points_.size() << std::endl;
+  std::cout << "Number of fused points: " << num_fused_points << std::endl;
   GetTimer().PrintMinutes();
 }
 
-void StereoFusion::Fuse() {
-  CHECK_EQ(fusion_queue_.size(), 1);
+void StereoFusion::ReadImageData(const int ref_image_idx) {
+  for (size_t image_idx = 0; image_idx < loaded_images_.size(); ++image_idx) {
+    loaded_images_[image_idx] = false;
+    bitmaps_[image_idx].reset();
+    depth_maps_[image_idx].reset();
+    normal_maps_[image_idx].reset();
+  }
+
+  // Read the least overlapping images first and the reference image last, so
+  // that these are evicted first, if the cache is too small for all images.
+  const auto& overlapping_images = overlapping_images_.at(ref_image_idx);
+  for (auto it = overlapping_images.rbegin(); it != overlapping_images.rend();
+       ++it) {
+    if (used_images_.at(*it) && !fused_images_.at(*it)) {
+      LoadImageData(*it);
+    }
+  }
+
+  LoadImageData(ref_image_idx);
+}
+
+void StereoFusion::LoadImageData(const int image_idx) {
+  if (loaded_images_[image_idx]) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(workspace_mutex_);
+  if (loaded_images_[image_idx]) {
+    return;
+  }
+
+  bitmaps_[image_idx] = workspace_->GetBitmapPtr(image_idx);
+  depth_maps_[image_idx] = workspace_->GetDepthMapPtr(image_idx);
+  normal_maps_[image_idx] = workspace_->GetNormalMapPtr(image_idx);
+  loaded_images_[image_idx] = true;
+}
+
+#ifdef CUDA_ENABLED
+void StereoFusion::ComputeConsistentPixels(const int ref_image_idx,
+                                           FusionCuda* fusion_cuda) {
+  const auto GetImage = [this](const int image_idx) {
+    FusionCuda::Image image;
+    image.depth_map = depth_maps_.at(image_idx).get();
+    image.normal_map = normal_maps_.at(image_idx).get();
+    std::copy(P_.at(image_idx).data(), P_.at(image_idx).data() + 12, image.P);
+    std::copy(inv_P_.at(image_idx).data(), inv_P_.at(image_idx).data() + 12,
+              image.inv_P);
+    std::copy(inv_R_.at(image_idx).data(), inv_R_.at(image_idx).data() + 9,
+              image.inv_R);
+    return image;
+  };
+
+  // The CPU fusion only traverses into the overlapping images, if the
+  // maximum traversal depth permits it.
+  consistent_image_idxs_.clear();
+  std::vector<FusionCuda::Image> src_images;
+  if (options_.max_traversal_depth > 1) {
+    for (const auto image_idx : overlapping_images_.at(ref_image_idx)) {
+      if (used_images_.at(image_idx) && !fused_images_.at(image_idx)) {
+        consistent_image_idxs_.push_back(image_idx);
+        src_images.push_back(GetImage(image_idx));
+      }
+    }
+  }
+
+  consistent_pixels_ = fusion_cuda->ComputeConsistentPixels(
+      ref_image_idx, GetImage(ref_image_idx), consistent_image_idxs_,
+      src_images);
+}
+#endif  // CUDA_ENABLED
+
+void StereoFusion::FuseTile(const int ref_image_idx, FusionTile* tile,
+                            FusionBuffers* buffers) {
+  const int width = depth_map_sizes_.at(ref_image_idx).first;
+  const auto& fused_pixel_mask = fused_pixel_masks_.at(ref_image_idx);
+
+  FusionData data;
+  data.image_idx = ref_image_idx;
+  data.traversal_depth = 0;
+
+  for (data.row = tile->row_start; data.row < tile->row_end; ++data.row) {
+    for (data.col = 0; data.col < width; ++data.col) {
+      if (fused_pixel_mask[data.row * width + data.col]) {
+        continue;
+      }
+
+      if (use_gpu_) {
+        FuseConsistentPixels(data, tile, buffers);
+      } else {
+        Fuse(data, tile, buffers);
+      }
+    }
+  }
+}
+
+void StereoFusion::Fuse(const FusionData& ref_data, FusionTile* tile,
+                        FusionBuffers* buffers) {
+  auto& fusion_queue = buffers->fusion_queue;
+
+  CHECK(fusion_queue.empty());
+  fusion_queue.push_back(ref_data);
 
   Eigen::Vector4f fused_ref_point = Eigen::Vector4f::Zero();
   Eigen::Vector3f fused_ref_normal = Eigen::Vector3f::Zero();
 
-  fused_point_x_.clear();
-  fused_point_y_.clear();
-  fused_point_z_.clear();
-  fused_point_nx_.clear();
-  fused_point_ny_.clear();
-  fused_point_nz_.clear();
-  fused_point_r_.clear();
-  fused_point_g_.clear();
-  fused_point_b_.clear();
-  fused_point_visibility_.clear();
-
-  while (!fusion_queue_.empty()) {
-    const auto data = fusion_queue_.back();
+  ClearFusedPoint(buffers);
+
+  while (!fusion_queue.empty()) {
+    const auto data = fusion_queue.back();
     const int image_idx = data.image_idx;
     const int row = data.row;
     const int col = data.col;
     const int traversal_depth = data.traversal_depth;
 
-    fusion_queue_.pop_back();
+    fusion_queue.pop_back();
 
     // Check if pixel already fused.
-    auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
-    if (fused_pixel_mask.Get(row, col)) {
+    const int width = depth_map_sizes_.at(image_idx).first;
+    auto& fused_pixel = fused_pixel_masks_.at(image_idx).at(row * width + col);
+    if (fused_pixel) {
       continue;
     }
 
-    const auto& depth_map = workspace_->GetDepthMap(image_idx);
-    const float depth = depth_map.Get(row, col);
+    // The images that do not overlap with the reference image are only read,
+    // once they are traversed.
+    LoadImageData(image_idx);
+
+    const float depth = depth_maps_.at(image_idx)->Get(row, col);
 
     // Pixels with negative depth are filtered.
     if (depth <= 0.0f) {
@@ -355,7 +635,7 @@ void StereoFusion::Fuse() {
     }
 
     // Determine normal direction in global reference frame.
-    const auto& normal_map = workspace_->GetNormalMap(image_idx);
+    const auto& normal_map = *normal_maps_.at(image_idx);
     const Eigen::Vector3f normal =
         inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.Get(row, col, 0),
                                                normal_map.Get(row, col, 1),
@@ -374,26 +654,13 @@ void StereoFusion::Fuse() {
         inv_P_.at(image_idx) *
         Eigen::Vector4f(col * depth, row * depth, depth, 1.0f);
 
-    // Read the color of the pixel.
-    BitmapColor<uint8_t> color;
-    const auto& bitmap_scale = bitmap_scales_.at(image_idx);
-    workspace_->GetBitmap(image_idx).InterpolateNearestNeighbor(
-        col / bitmap_scale.first, row / bitmap_scale.second, &color);
-
-    // Set the current pixel as visited.
-    fused_pixel_mask.Set(row, col, true);
-
-    // Accumulate statistics for fused point.
-    fused_point_x_.push_back(xyz(0));
-    fused_point_y_.push_back(xyz(1));
-    fused_point_z_.push_back(xyz(2));
-    fused_point_nx_.push_back(normal(0));
-    fused_point_ny_.push_back(normal(1));
-    fused_point_nz_.push_back(normal(2));
-    fused_point_r_.push_back(color.r);
-    fused_point_g_.push_back(color.g);
-    fused_point_b_.push_back(color.b);
-    fused_point_visibility_.insert(image_idx);
+    // Set the current pixel as visited, unless it was fused by another
+    // thread in the meantime.
+    if (fused_pixel.exchange(true)) {
+      continue;
+    }
+
+    AccumulatePixel(image_idx, row, col, xyz, normal, buffers);
 
     // Remember the first pixel as the reference.
     if (traversal_depth == 0) {
@@ -401,7 +668,8 @@ void StereoFusion::Fuse() {
       fused_ref_normal = normal;
     }
 
-    if (fused_point_x_.size() >= static_cast<size_t>(options_.max_num_pixels)) {
+    if (buffers->fused_point_x.size() >=
+        static_cast<size_t>(options_.max_num_pixels)) {
       break;
     }
 
@@ -432,61 +700,392 @@ void StereoFusion::Fuse() {
         continue;
       }
 
-      fusion_queue_.push_back(next_data);
+      fusion_queue.push_back(next_data);
     }
   }
 
-  fusion_queue_.clear();
+  fusion_queue.clear();
 
-  const size_t num_pixels = fused_point_x_.size();
+  AddFusedPoint(tile, buffers);
+}
+
+void StereoFusion::FuseConsistentPixels(const FusionData& ref_data,
+                                        FusionTile* tile,
+                                        FusionBuffers* buffers) {
+  ClearFusedPoint(buffers);
+
+  const int ref_image_idx = ref_data.image_idx;
+  const int ref_row = ref_data.row;
+  const int ref_col = ref_data.col;
+
+  const float ref_depth = depth_maps_.at(ref_image_idx)->Get(ref_row, ref_col);
+
+  // Pixels with negative depth are filtered.
+  if (ref_depth <= 0.0f) {
+    return;
+  }
+
+  const int ref_width = depth_map_sizes_.at(ref_image_idx).first;
+  if (fused_pixel_masks_.at(ref_image_idx)
+          .at(ref_row * ref_width + ref_col)
+          .exchange(true)) {
+    return;
+  }
+
+  const auto& ref_normal_map = *normal_maps_.at(ref_image_idx);
+  AccumulatePixel(
+      ref_image_idx, ref_row, ref_col,
+      inv_P_.at(ref_image_idx) * Eigen::Vector4f(ref_col * ref_depth,
+                                                 ref_row * ref_depth,
+                                                 ref_depth, 1.0f),
+      inv_R_.at(ref_image_idx) *
+          Eigen::Vector3f(ref_normal_map.Get(ref_row, ref_col, 0),
+                          ref_normal_map.Get(ref_row, ref_col, 1),
+                          ref_normal_map.Get(ref_row, ref_col, 2)),
+      buffers);
+
+  // The consistency of the source pixels with the reference pixel was already
+  // checked on the GPU, so they only need to be claimed.
+  for (size_t i = 0; i < consistent_image_idxs_.size(); ++i) {
+    if (buffers->fused_point_x.size() >=
+        static_cast<size_t>(options_.max_num_pixels)) {
+      break;
+    }
+
+    const int pixel_idx = consistent_pixels_.Get(ref_row, ref_col, i);
+    if (pixel_idx < 0) {
+      continue;
+    }
+
+    const int image_idx = consistent_image_idxs_[i];
+    if (fused_pixel_masks_.at(image_idx).at(pixel_idx).exchange(true)) {
+      continue;
+    }
+
+    const int width = depth_map_sizes_.at(image_idx).first;
+    const int row = pixel_idx / width;
+    const int col = pixel_idx % width;
+    const float depth = depth_maps_.at(image_idx)->Get(row, col);
+    const auto& normal_map = *normal_maps_.at(image_idx);
+    AccumulatePixel(
+        image_idx, row, col,
+        inv_P_.at(image_idx) *
+            Eigen::Vector4f(col * depth, row * depth, depth, 1.0f),
+        inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.Get(row, col, 0),
+                                               normal_map.Get(row, col, 1),
+                                               normal_map.Get(row, col, 2)),
+        buffers);
+  }
+
+  AddFusedPoint(tile, buffers);
+}
+
+void StereoFusion::ClearFusedPoint(FusionBuffers* buffers) {
+  buffers->fused_point_x.clear();
+  buffers->fused_point_y.clear();
+  buffers->fused_point_z.clear();
+  buffers->fused_point_nx.clear();
+  buffers->fused_point_ny.clear();
+  buffers->fused_point_nz.clear();
+  buffers->fused_point_r.clear();
+  buffers->fused_point_g.clear();
+  buffers->fused_point_b.clear();
+  buffers->fused_point_visibility.clear();
+}
+
+void StereoFusion::AccumulatePixel(const int image_idx, const int row,
+                                   const int col, const Eigen::Vector3f& xyz,
+                                   const Eigen::Vector3f& normal,
+                                   FusionBuffers* buffers) {
+  // Read the color of the pixel.
+  BitmapColor<uint8_t> color;
+  const auto& bitmap_scale = bitmap_scales_.at(image_idx);
+  bitmaps_.at(image_idx)->InterpolateNearestNeighbor(
+      col / bitmap_scale.first, row / bitmap_scale.second, &color);
+
+  // Accumulate statistics for fused point.
+  buffers->fused_point_x.push_back(xyz(0));
+  buffers->fused_point_y.push_back(xyz(1));
+  buffers->fused_point_z.push_back(xyz(2));
+  buffers->fused_point_nx.push_back(normal(0));
+  buffers->fused_point_ny.push_back(normal(1));
+  buffers->fused_point_nz.push_back(normal(2));
+  buffers->fused_point_r.push_back(color.r);
+  buffers->fused_point_g.push_back(color.g);
+  buffers->fused_point_b.push_back(color.b);
+  buffers->fused_point_visibility.insert(image_idx);
+}
+
+void StereoFusion::AddFusedPoint(FusionTile* tile, FusionBuffers* buffers) {
+  auto& fused_point_x = buffers->fused_point_x;
+  auto& fused_point_y = buffers->fused_point_y;
+  auto& fused_point_z = buffers->fused_point_z;
+  auto& fused_point_nx = buffers->fused_point_nx;
+  auto& fused_point_ny = buffers->fused_point_ny;
+  auto& fused_point_nz = buffers->fused_point_nz;
+  auto& fused_point_r = buffers->fused_point_r;
+  auto& fused_point_g = buffers->fused_point_g;
+  auto& fused_point_b = buffers->fused_point_b;
+  const auto& fused_point_visibility = buffers->fused_point_visibility;
+
+  const size_t num_pixels = fused_point_x.size();
   if (num_pixels >= static_cast<size_t>(options_.min_num_pixels)) {
+    // The pixels of a point owned by another view cluster remain fused, so
+    // that they do not seed another duplicate point in this cluster.
+    if (cluster_idx_ >= 0 &&
+        FindOwnerViewCluster(fused_point_visibility, image_cluster_idxs_) !=
+            cluster_idx_) {
+      return;
+    }
+
     PlyPoint fused_point;
 
     Eigen::Vector3f fused_normal;
-    fused_normal.x() = internal::Median(&fused_point_nx_);
-    fused_normal.y() = internal::Median(&fused_point_ny_);
-    fused_normal.z() = internal::Median(&fused_point_nz_);
+    fused_normal.x() = internal::Median(&fused_point_nx);
+    fused_normal.y() = internal::Median(&fused_point_ny);
+    fused_normal.z() = internal::Median(&fused_point_nz);
     const float fused_normal_norm = fused_normal.norm();
     if (fused_normal_norm < std::numeric_limits<float>::epsilon()) {
       return;
     }
 
-    fused_point.x = internal::Median(&fused_point_x_);
-    fused_point.y = internal::Median(&fused_point_y_);
-    fused_point.z = internal::Median(&fused_point_z_);
+    fused_point.x = internal::Median(&fused_point_x);
+    fused_point.y = internal::Median(&fused_point_y);
+    fused_point.z = internal::Median(&fused_point_z);
 
     fused_point.nx = fused_normal.x() / fused_normal_norm;
     fused_point.ny = fused_normal.y() / fused_normal_norm;
     fused_point.nz = fused_normal.z() / fused_normal_norm;
 
     fused_point.r = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_r_)));
+        std::round(internal::Median(&fused_point_r)));
     fused_point.g = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_g_)));
+        std::round(internal::Median(&fused_point_g)));
     fused_point.b = TruncateCast<float, uint8_t>(
-        std::round(internal::Median(&fused_point_b_)));
+        std::round(internal::Median(&fused_point_b)));
+
+    tile->fused_points.push_back(fused_point);
+    tile->fused_points_visibility.emplace_back(fused_point_visibility.begin(),
+                                               fused_point_visibility.end());
+  }
+}
+
+namespace {
+
+void EncodeVarint(uint32_t value, std::string* data) {
+  while (value >= 0x80) {
+    data->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  data->push_back(static_cast<char>(value));
+}
 
-    fused_points_.push_back(fused_point);
-    fused_points_visibility_.emplace_back(fused_point_visibility_.begin(),
-                                          fused_point_visibility_.end());
+uint32_t DecodeVarint(const std::string& data, size_t* pos) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    CHECK_LT(*pos, data.size());
+    const uint8_t byte = static_cast<uint8_t>(data[(*pos)++]);
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      break;
+    }
   }
+  return value;
+}
+
+uint32_t ZigZagEncode(const int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+int32_t ZigZagDecode(const uint32_t value) {
+  return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
 }
 
+PointsVisibility ReadUncompressedPointsVisibility(std::fstream* file,
+                                                  const size_t num_points) {
+  // Read the remaining file at once instead of every number separately.
+  const std::streampos begin_pos = file->tellg();
+  file->seekg(0, std::ios::end);
+  const std::streampos end_pos = file->tellg();
+  file->seekg(begin_pos);
+  std::vector<uint32_t> data((end_pos - begin_pos) / sizeof(uint32_t));
+  ReadBinaryLittleEndian<uint32_t>(file, &data);
+
+  CHECK_GE(data.size(), num_points);
+
+  PointsVisibility visibility;
+  visibility.point_offsets.reserve(num_points + 1);
+  visibility.image_idxs.reserve(data.size() - num_points);
+  visibility.point_offsets.push_back(0);
+  size_t pos = 0;
+  for (size_t point_idx = 0; point_idx < num_points; ++point_idx) {
+    CHECK_LT(pos, data.size());
+    const size_t num_visible_images = data[pos];
+    CHECK_LE(pos + 1 + num_visible_images, data.size());
+    visibility.image_idxs.insert(visibility.image_idxs.end(),
+                                 data.begin() + pos + 1,
+                                 data.begin() + pos + 1 + num_visible_images);
+    visibility.point_offsets.push_back(visibility.image_idxs.size());
+    pos += 1 + num_visible_images;
+  }
+
+  return visibility;
+}
+
+}  // namespace
+
 void WritePointsVisibility(
     const std::string& path,
     const std::vector<std::vector<int>>& points_visibility) {
-  std::fstream file(path, std::ios::out | std::ios::binary);
+  PointsVisibilityWriter writer(path);
+  for (const auto& visibility : points_visibility) {
+    writer.Write(visibility);
+  }
+  writer.Close();
+}
+
+size_t PointsVisibility::NumPoints() const {
+  return point_offsets.empty() ? 0 : point_offsets.size() - 1;
+}
+
+PointsVisibility ReadPointsVisibility(const std::string& path,
+                                      const int num_threads) {
+  std::fstream file(path, std::ios::in | std::ios::binary);
   CHECK(file.is_open()) << path;
 
-  WriteBinaryLittleEndian<uint64_t>(&file, points_visibility.size());
+  const uint64_t magic = ReadBinaryLittleEndian<uint64_t>(&file);
+  if (magic != kPointsVisibilityMagic) {
+    return ReadUncompressedPointsVisibility(&file, magic);
+  }
 
-  for (const auto& visibility : points_visibility) {
-    WriteBinaryLittleEndian<uint32_t>(&file, visibility.size());
-    for (const auto& image_idx : visibility) {
-      WriteBinaryLittleEndian<uint32_t>(&file, image_idx);
-    }
+  const size_t num_points = ReadBinaryLittleEndian<uint64_t>(&file);
+  const size_t num_chunks = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t chunk_table_offset = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t data_offset = file.tellg();
+
+  // Determine the location of every chunk in the file and in the output.
+  std::vector<uint64_t> chunk_offsets(num_chunks + 1, data_offset);
+  std::vector<size_t> chunk_point_offsets(num_chunks + 1, 0);
+  std::vector<size_t> chunk_image_idx_offsets(num_chunks + 1, 0);
+  file.seekg(chunk_table_offset);
+  for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+    chunk_point_offsets[chunk_idx + 1] =
+        chunk_point_offsets[chunk_idx] +
+        ReadBinaryLittleEndian<uint64_t>(&file);
+    chunk_image_idx_offsets[chunk_idx + 1] =
+        chunk_image_idx_offsets[chunk_idx] +
+        ReadBinaryLittleEndian<uint64_t>(&file);
+    chunk_offsets[chunk_idx + 1] =
+        chunk_offsets[chunk_idx] + ReadBinaryLittleEndian<uint64_t>(&file);
+  }
+  CHECK(file.good()) << path;
+  CHECK_EQ(chunk_point_offsets.back(), num_points);
+  file.close();
+
+  PointsVisibility visibility;
+  visibility.point_offsets.resize(num_points + 1);
+  visibility.point_offsets[num_points] = chunk_image_idx_offsets.back();
+  visibility.image_idxs.resize(chunk_image_idx_offsets.back());
+
+  ParallelFor(
+      num_threads, 0, num_chunks,
+      [&](const size_t chunk_begin, const size_t chunk_end) {
+        std::fstream chunk_file(path, std::ios::in | std::ios::binary);
+        CHECK(chunk_file.is_open()) << path;
+        std::string data;
+        for (size_t chunk_idx = chunk_begin; chunk_idx < chunk_end;
+             ++chunk_idx) {
+          data.resize(chunk_offsets[chunk_idx + 1] - chunk_offsets[chunk_idx]);
+          chunk_file.seekg(chunk_offsets[chunk_idx]);
+          chunk_file.read(&data[0], data.size());
+          CHECK(chunk_file.good()) << path;
+
+          size_t pos = 0;
+          size_t image_idx_offset = chunk_image_idx_offsets[chunk_idx];
+          for (size_t point_idx = chunk_point_offsets[chunk_idx];
+               point_idx < chunk_point_offsets[chunk_idx + 1]; ++point_idx) {
+            visibility.point_offsets[point_idx] = image_idx_offset;
+            const uint32_t num_visible_images = DecodeVarint(data, &pos);
+            CHECK_LE(image_idx_offset + num_visible_images,
+                     chunk_image_idx_offsets[chunk_idx + 1]);
+            int32_t image_idx = 0;
+            for (uint32_t i = 0; i < num_visible_images; ++i) {
+              image_idx += ZigZagDecode(DecodeVarint(data, &pos));
+              visibility.image_idxs[image_idx_offset++] = image_idx;
+            }
+          }
+          CHECK_EQ(image_idx_offset, chunk_image_idx_offsets[chunk_idx + 1]);
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC, 1);
+
+  return visibility;
+}
+
+PointsVisibilityWriter::PointsVisibilityWriter(const std::string& path)
+    : path_(path), num_points_(0) {
+  file_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+  CHECK(file_.is_open()) << path;
+  // The header is completed when the writer is closed.
+  WriteBinaryLittleEndian<uint64_t>(&file_, kPointsVisibilityMagic);
+  WriteBinaryLittleEndian<uint64_t>(&file_, 0);
+  WriteBinaryLittleEndian<uint64_t>(&file_, 0);
+  WriteBinaryLittleEndian<uint64_t>(&file_, 0);
+}
+
+PointsVisibilityWriter::~PointsVisibilityWriter() { Close(); }
+
+void PointsVisibilityWriter::Write(const std::vector<int>& visibility) {
+  CHECK(file_.is_open()) << path_;
+  EncodeVarint(visibility.size(), &chunk_data_);
+  int32_t prev_image_idx = 0;
+  for (const auto& image_idx : visibility) {
+    EncodeVarint(ZigZagEncode(image_idx - prev_image_idx), &chunk_data_);
+    prev_image_idx = image_idx;
+  }
+  chunk_.num_points += 1;
+  chunk_.num_image_idxs += visibility.size();
+  num_points_ += 1;
+
+  if (chunk_.num_points == kNumPointsPerVisibilityChunk) {
+    WriteChunk();
   }
 }
 
+size_t PointsVisibilityWriter::NumPoints() const { return num_points_; }
+
+void PointsVisibilityWriter::Close() {
+  if (!file_.is_open()) {
+    return;
+  }
+
+  if (chunk_.num_points > 0) {
+    WriteChunk();
+  }
+
+  const uint64_t chunk_table_offset = file_.tellp();
+  for (const auto& chunk : chunks_) {
+    WriteBinaryLittleEndian<uint64_t>(&file_, chunk.num_points);
+    WriteBinaryLittleEndian<uint64_t>(&file_, chunk.num_image_idxs);
+    WriteBinaryLittleEndian<uint64_t>(&file_, chunk.num_bytes);
+  }
+
+  file_.seekp(sizeof(uint64_t));
+  WriteBinaryLittleEndian<uint64_t>(&file_, num_points_);
+  WriteBinaryLittleEndian<uint64_t>(&file_, chunks_.size());
+  WriteBinaryLittleEndian<uint64_t>(&file_, chunk_table_offset);
+  CHECK(file_.good()) << path_;
+  file_.close();
+}
+
+void PointsVisibilityWriter::WriteChunk() {
+  file_.write(chunk_data_.data(), chunk_data_.size());
+  chunk_.num_bytes = chunk_data_.size();
+  chunks_.push_back(chunk_);
+  chunk_ = Chunk();
+  chunk_data_.clear();
+}
+
 }  // namespace mvs
 }  // namespace colmap
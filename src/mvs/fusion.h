@@ -32,6 +32,10 @@
 #ifndef COLMAP_SRC_MVS_FUSION_H_
 #define COLMAP_SRC_MVS_FUSION_H_
 
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -46,12 +50,15 @@
 #include "util/alignment.h"
 #include "util/cache.h"
 #include "util/math.h"
+#include "util/octree_tiles.h"
 #include "util/ply.h"
 #include "util/threading.h"
 
 namespace colmap {
 namespace mvs {
 
+class FusionCuda;
+
 struct StereoFusionOptions {
   // Maximum image size in either dimension.
   int max_image_size = -1;
@@ -81,9 +88,27 @@ struct StereoFusionOptions {
   // maps, normal maps, and consistency graphs of this number of images in
   // memory. A higher value leads to less disk access and faster fusion, while
   // a lower value leads to reduced memory usage. Note that a single image can
-  // consume a lot of memory, if the consistency graph is dense.
+  // consume a lot of memory, if the consistency graph is dense. The images
+  // traversed from the currently fused image are kept in memory until it is
+  // fused, even if they exceed the cache size.
   double cache_size = 32.0;
 
+  // The number of threads for fusion. The pixels of each reference image are
+  // partitioned into tiles of rows, which are fused concurrently.
+  int num_threads = -1;
+
+  // Whether to check the consistency of the pixels on the GPU. The reference
+  // point of each pixel is then only compared against the pixels it directly
+  // projects to in the overlapping images, instead of traversing the images
+  // transitively. Requires COLMAP to be compiled with CUDA.
+  bool use_gpu = false;
+
+  // Index of the GPU used for fusion. By default, the best GPU is selected.
+  int gpu_index = -1;
+
+  // Size in gigabytes of the depth and normal maps cached on the GPU.
+  double gpu_cache_size = 2.0;
+
   // Check the options for validity.
   bool Check() const;
 
@@ -101,64 +126,173 @@ class StereoFusion : public Thread {
                const std::string& pmvs_option_name,
                const std::string& input_type);
 
+  // Write the fused points and their visibility incrementally to a binary PLY
+  // file at the given path and to the visibility file at "<path>.vis" during
+  // the fusion, instead of keeping them in memory. Must be called before the
+  // fusion is started, in which case the fused points below remain empty.
+  void SetOutputPath(const std::string& output_path);
+
+  // Write the fused points incrementally as octree tiles to the directory at
+  // the given path during the fusion, see `OctreeTilesWriter`, instead of
+  // keeping them in memory. Can be combined with the PLY output above. Must
+  // be called before the fusion is started.
+  void SetTilesOutputPath(const std::string& tiles_output_path);
+
+  // Only fuse the points of the reference images of the given cluster in the
+  // view clustering file at the given path, see `ClusterViews`. Points that
+  // are owned by another cluster are discarded, so that the outputs of all
+  // clusters can be merged without duplicates. Must be called before the
+  // fusion is started.
+  void SetViewCluster(const std::string& cluster_path, const int cluster_idx);
+
   const std::vector<PlyPoint>& GetFusedPoints() const;
   const std::vector<std::vector<int>>& GetFusedPointsVisibility() const;
 
  private:
+  struct FusionData {
+    int image_idx = kInvalidImageId;
+    int row = 0;
+    int col = 0;
+    int traversal_depth = -1;
+    bool operator()(const FusionData& data1, const FusionData& data2) {
+      return data1.image_idx > data2.image_idx;
+    }
+  };
+
+  // Scratch buffers of a thread for the point that is currently fused.
+  struct FusionBuffers {
+    // Next points to fuse.
+    std::vector<FusionData> fusion_queue;
+
+    // Points of different pixels of the currently point to be fused.
+    std::vector<float> fused_point_x;
+    std::vector<float> fused_point_y;
+    std::vector<float> fused_point_z;
+    std::vector<float> fused_point_nx;
+    std::vector<float> fused_point_ny;
+    std::vector<float> fused_point_nz;
+    std::vector<uint8_t> fused_point_r;
+    std::vector<uint8_t> fused_point_g;
+    std::vector<uint8_t> fused_point_b;
+    std::unordered_set<int> fused_point_visibility;
+  };
+
+  // Fused points of a tile of rows in the reference image.
+  struct FusionTile {
+    int row_start = 0;
+    int row_end = 0;
+    std::vector<PlyPoint> fused_points;
+    std::vector<std::vector<int>> fused_points_visibility;
+  };
+
   void Run();
-  void Fuse();
+
+  // Release the data of the previously fused reference image and read the
+  // data of the next reference image and its overlapping images.
+  void ReadImageData(const int ref_image_idx);
+
+  // Read the data of an image, unless it was already read for the current
+  // reference image. The workspace is not thread-safe, so all threads read
+  // the data under the same mutex. The data is pinned until the next
+  // reference image, so that it is not released, when the image is evicted
+  // from the workspace cache.
+  void LoadImageData(const int image_idx);
+
+  // Compute the pixels in the overlapping images that are consistent with
+  // the pixels of the reference image on the GPU.
+  void ComputeConsistentPixels(const int ref_image_idx,
+                               FusionCuda* fusion_cuda);
+
+  void FuseTile(const int ref_image_idx, FusionTile* tile,
+                FusionBuffers* buffers);
+
+  // Fuse a point by traversing the overlapping images on the CPU or from the
+  // consistent pixels computed on the GPU.
+  void Fuse(const FusionData& ref_data, FusionTile* tile,
+            FusionBuffers* buffers);
+  void FuseConsistentPixels(const FusionData& ref_data, FusionTile* tile,
+                            FusionBuffers* buffers);
+
+  void ClearFusedPoint(FusionBuffers* buffers);
+  void AccumulatePixel(const int image_idx, const int row, const int col,
+                       const Eigen::Vector3f& xyz,
+                       const Eigen::Vector3f& normal, FusionBuffers* buffers);
+  void AddFusedPoint(FusionTile* tile, FusionBuffers* buffers);
 
   const StereoFusionOptions options_;
   const std::string workspace_path_;
   const std::string workspace_format_;
   const std::string pmvs_option_name_;
   const std::string input_type_;
+  std::string output_path_;
+  std::string tiles_output_path_;
+  std::string cluster_path_;
+  int cluster_idx_;
   const float max_squared_reproj_error_;
   const float min_cos_normal_error_;
 
   std::unique_ptr<Workspace> workspace_;
   std::vector<char> used_images_;
   std::vector<char> fused_images_;
+
+  // The used images whose pixels seed fused points, which are all used images
+  // unless only a view cluster is fused, and the cluster of each image.
+  std::vector<char> ref_images_;
+  std::vector<int> image_cluster_idxs_;
   std::vector<std::vector<int>> overlapping_images_;
-  std::vector<Mat<bool>> fused_pixel_masks_;
   std::vector<std::pair<int, int>> depth_map_sizes_;
   std::vector<std::pair<float, float>> bitmap_scales_;
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> P_;
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> inv_P_;
   std::vector<Eigen::Matrix<float, 3, 3, Eigen::RowMajor>> inv_R_;
 
-  struct FusionData {
-    int image_idx = kInvalidImageId;
-    int row = 0;
-    int col = 0;
-    int traversal_depth = -1;
-    bool operator()(const FusionData& data1, const FusionData& data2) {
-      return data1.image_idx > data2.image_idx;
-    }
-  };
+  // Row-major masks of the already fused pixels of each image. A pixel is
+  // claimed atomically, so that concurrently fused points never share pixels.
+  std::vector<std::vector<std::atomic<bool>>> fused_pixel_masks_;
+
+  // Data of the images that were traversed from the current reference image,
+  // or null for all other images, and whether the data was already read.
+  std::mutex workspace_mutex_;
+  std::vector<std::atomic<bool>> loaded_images_;
+  std::vector<std::shared_ptr<const Bitmap>> bitmaps_;
+  std::vector<std::shared_ptr<const DepthMap>> depth_maps_;
+  std::vector<std::shared_ptr<const NormalMap>> normal_maps_;
 
-  // Next points to fuse.
-  std::vector<FusionData> fusion_queue_;
+  // Scratch buffers of each thread.
+  std::vector<FusionBuffers> thread_buffers_;
+
+  // The consistent pixels of the current reference image in the overlapping
+  // images, if the consistency is checked on the GPU.
+  bool use_gpu_;
+  std::vector<int> consistent_image_idxs_;
+  Mat<int> consistent_pixels_;
 
   // Already fused points.
   std::vector<PlyPoint> fused_points_;
   std::vector<std::vector<int>> fused_points_visibility_;
-
-  // Points of different pixels of the currently point to be fused.
-  std::vector<float> fused_point_x_;
-  std::vector<float> fused_point_y_;
-  std::vector<float> fused_point_z_;
-  std::vector<float> fused_point_nx_;
-  std::vector<float> fused_point_ny_;
-  std::vector<float> fused_point_nz_;
-  std::vector<uint8_t> fused_point_r_;
-  std::vector<uint8_t> fused_point_g_;
-  std::vector<uint8_t> fused_point_b_;
-  std::unordered_set<int> fused_point_visibility_;
 };
 
 // Write the visiblity information into a binary file of the following format:
 //
+//    <magic : uint64_t>
+//    <num_points : uint64_t>
+//    <num_chunks : uint64_t>
+//    <chunk_table_offset : uint64_t>
+//    <chunk1_data><chunk2_data> ...
+//    <chunk1_num_points : uint64_t>
+//    <chunk1_num_image_idxs : uint64_t>
+//    <chunk1_num_bytes : uint64_t>
+//    <chunk2_num_points : uint64_t>
+//    ...
+//
+// The points are split into chunks of up to `kNumPointsPerVisibilityChunk`
+// points, which are decoded in parallel. For every point, the data of a chunk
+// contains the number of visible images followed by the differences of the
+// consecutive image indices, starting from zero, where all numbers are
+// zig-zag and varint encoded.
+//
+// The previous uncompressed format of the following form can still be read:
+//
 //    <num_points : uint64_t>
 //    <num_visible_images_for_point1 : uint32_t>
 //    <point1_image_idx1 : uint32_t><point1_image_idx2 : uint32_t> ...
@@ -173,6 +307,54 @@ void WritePointsVisibility(
     const std::string& path,
     const std::vector<std::vector<int>>& points_visibility);
 
+const uint64_t kPointsVisibilityMagic = 0x3153495650414D43;  // "CMAPVIS1"
+const size_t kNumPointsPerVisibilityChunk = 65536;
+
+// The visible image indices of all points in compressed sparse row format,
+// i.e., the image indices of the i-th point are stored in
+// image_idxs[point_offsets[i]], ..., image_idxs[point_offsets[i + 1] - 1].
+struct PointsVisibility {
+  std::vector<size_t> point_offsets;
+  std::vector<uint32_t> image_idxs;
+
+  size_t NumPoints() const;
+};
+
+// Read the visibility information in either of the above formats.
+PointsVisibility ReadPointsVisibility(const std::string& path,
+                                      const int num_threads = -1);
+
+// Write the visibility information incrementally in the same format as above,
+// where the chunk table is written, when the writer is closed.
+class PointsVisibilityWriter {
+ public:
+  explicit PointsVisibilityWriter(const std::string& path);
+  ~PointsVisibilityWriter();
+
+  void Write(const std::vector<int>& visibility);
+
+  size_t NumPoints() const;
+
+  // Write the last chunk and the chunk table and close the file.
+  void Close();
+
+ private:
+  struct Chunk {
+    uint64_t num_points = 0;
+    uint64_t num_image_idxs = 0;
+    uint64_t num_bytes = 0;
+  };
+
+  void WriteChunk();
+
+  const std::string path_;
+  std::fstream file_;
+  size_t num_points_;
+  std::vector<Chunk> chunks_;
+  Chunk chunk_;
+  std::string chunk_data_;
+};
+
 }  // namespace mvs
 }  // namespace colmap
 
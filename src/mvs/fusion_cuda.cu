@@ -0,0 +1,293 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "mvs/fusion_cuda.h"
+
+#include <cstring>
+
+#include "mvs/gpu_mat.h"
+#include "util/cache.h"
+#include "util/cuda.h"
+#include "util/cudacc.h"
+#include "util/logging.h"
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+const int kBlockDimX = 32;
+const int kBlockDimY = 16;
+
+// The device data and calibration of an image, which is passed to the kernel.
+struct ImageParams {
+  const float* depth_map = nullptr;
+  size_t depth_map_pitch = 0;
+  const float* normal_map = nullptr;
+  size_t normal_map_pitch = 0;
+  int width = 0;
+  int height = 0;
+  float P[12];
+  float inv_P[12];
+  float inv_R[9];
+};
+
+__device__ inline float ReadMap(const float* map, const size_t pitch,
+                                const int height, const int row, const int col,
+                                const int slice) {
+  return *((const float*)((const char*)map + pitch * (slice * height + row)) +
+           col);
+}
+
+__device__ inline void Mat33DotVec3(const float mat[9], const float vec[3],
+                                    float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+__device__ inline void Mat34DotVec3Homogeneous(const float mat[12],
+                                               const float vec[3],
+                                               float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2] + mat[3];
+  result[1] = mat[4] * vec[0] + mat[5] * vec[1] + mat[6] * vec[2] + mat[7];
+  result[2] = mat[8] * vec[0] + mat[9] * vec[1] + mat[10] * vec[2] + mat[11];
+}
+
+__device__ inline void ReadGlobalNormal(const ImageParams& image,
+                                        const int row, const int col,
+                                        float normal[3]) {
+  float local_normal[3];
+  for (int i = 0; i < 3; ++i) {
+    local_normal[i] = ReadMap(image.normal_map, image.normal_map_pitch,
+                              image.height, row, col, i);
+  }
+  Mat33DotVec3(image.inv_R, local_normal, normal);
+}
+
+__global__ void ComputeConsistentPixelsKernel(
+    const ImageParams ref_image, const ImageParams* src_images,
+    const int num_src_images, const float max_squared_reproj_error,
+    const float max_depth_error, const float min_cos_normal_error,
+    GpuMat<int> consistent_pixels) {
+  const int row = blockIdx.y * blockDim.y + threadIdx.y;
+  const int col = blockIdx.x * blockDim.x + threadIdx.x;
+  if (row >= ref_image.height || col >= ref_image.width) {
+    return;
+  }
+
+  const float depth = ReadMap(ref_image.depth_map, ref_image.depth_map_pitch,
+                              ref_image.height, row, col, 0);
+
+  // Pixels with negative depth are filtered.
+  if (depth <= 0.0f) {
+    for (int i = 0; i < num_src_images; ++i) {
+      consistent_pixels.Set(row, col, i, -1);
+    }
+    return;
+  }
+
+  // Determine 3D location and normal of the reference pixel.
+  const float ref_point[3] = {col * depth, row * depth, depth};
+  float xyz[3];
+  Mat34DotVec3Homogeneous(ref_image.inv_P, ref_point, xyz);
+  float ref_normal[3];
+  ReadGlobalNormal(ref_image, row, col, ref_normal);
+
+  for (int i = 0; i < num_src_images; ++i) {
+    const ImageParams& src_image = src_images[i];
+
+    int consistent_pixel = -1;
+
+    float proj[3];
+    Mat34DotVec3Homogeneous(src_image.P, xyz, proj);
+    const float src_col_proj = proj[0] / proj[2];
+    const float src_row_proj = proj[1] / proj[2];
+    const int src_col = static_cast<int>(roundf(src_col_proj));
+    const int src_row = static_cast<int>(roundf(src_row_proj));
+
+    if (src_col >= 0 && src_row >= 0 && src_col < src_image.width &&
+        src_row < src_image.height) {
+      const float src_depth =
+          ReadMap(src_image.depth_map, src_image.depth_map_pitch,
+                  src_image.height, src_row, src_col, 0);
+      const float depth_error = fabsf((proj[2] - src_depth) / src_depth);
+      const float col_diff = src_col_proj - src_col;
+      const float row_diff = src_row_proj - src_row;
+      const float squared_reproj_error =
+          col_diff * col_diff + row_diff * row_diff;
+      if (src_depth > 0.0f && depth_error <= max_depth_error &&
+          squared_reproj_error <= max_squared_reproj_error) {
+        float src_normal[3];
+        ReadGlobalNormal(src_image, src_row, src_col, src_normal);
+        const float cos_normal_error = ref_normal[0] * src_normal[0] +
+                                       ref_normal[1] * src_normal[1] +
+                                       ref_normal[2] * src_normal[2];
+        if (cos_normal_error >= min_cos_normal_error) {
+          consistent_pixel = src_row * src_image.width + src_col;
+        }
+      }
+    }
+
+    consistent_pixels.Set(row, col, i, consistent_pixel);
+  }
+}
+
+}  // namespace
+
+struct FusionCuda::DeviceImages {
+  struct DeviceImage {
+    size_t NumBytes() const { return num_bytes; }
+    size_t num_bytes = 0;
+    std::shared_ptr<GpuMat<float>> depth_map;
+    std::shared_ptr<GpuMat<float>> normal_map;
+  };
+
+  explicit DeviceImages(const double cache_size)
+      : cache(1024 * 1024 * 1024 * cache_size, [](const int image_idx) {
+          LOG(FATAL) << "Image " << image_idx << " not uploaded";
+          return DeviceImage();
+        }) {}
+
+  // Upload the data of an image to the device, unless it is already cached,
+  // and return its parameters for the kernel. The returned image keeps its
+  // device data alive, even if it is evicted from the cache in the meantime.
+  DeviceImage Upload(const int image_idx, const Image& image,
+                     ImageParams* params);
+
+  MemoryConstrainedLRUCache<int, DeviceImage> cache;
+};
+
+FusionCuda::DeviceImages::DeviceImage FusionCuda::DeviceImages::Upload(
+    const int image_idx, const Image& image, ImageParams* params) {
+  CHECK_NOTNULL(image.depth_map);
+  CHECK_NOTNULL(image.normal_map);
+
+  if (!cache.Exists(image_idx)) {
+    const DepthMap& depth_map = *image.depth_map;
+    const NormalMap& normal_map = *image.normal_map;
+    CHECK_EQ(depth_map.GetWidth(), normal_map.GetWidth());
+    CHECK_EQ(depth_map.GetHeight(), normal_map.GetHeight());
+
+    DeviceImage device_image;
+    device_image.depth_map.reset(
+        new GpuMat<float>(depth_map.GetWidth(), depth_map.GetHeight(), 1));
+    device_image.depth_map->CopyToDevice(
+        depth_map.GetPtr(), depth_map.GetWidth() * sizeof(float));
+    device_image.normal_map.reset(
+        new GpuMat<float>(normal_map.GetWidth(), normal_map.GetHeight(), 3));
+    device_image.normal_map->CopyToDevice(
+        normal_map.GetPtr(), normal_map.GetWidth() * sizeof(float));
+    device_image.num_bytes =
+        device_image.depth_map->GetPitch() * depth_map.GetHeight() +
+        device_image.normal_map->GetPitch() * normal_map.GetHeight() * 3;
+    cache.Set(image_idx, std::move(device_image));
+  }
+
+  const DeviceImage device_image = cache.Get(image_idx);
+
+  params->depth_map = device_image.depth_map->GetPtr();
+  params->depth_map_pitch = device_image.depth_map->GetPitch();
+  params->normal_map = device_image.normal_map->GetPtr();
+  params->normal_map_pitch = device_image.normal_map->GetPitch();
+  params->width = static_cast<int>(device_image.depth_map->GetWidth());
+  params->height = static_cast<int>(device_image.depth_map->GetHeight());
+  memcpy(params->P, image.P, 12 * sizeof(float));
+  memcpy(params->inv_P, image.inv_P, 12 * sizeof(float));
+  memcpy(params->inv_R, image.inv_R, 9 * sizeof(float));
+
+  return device_image;
+}
+
+FusionCuda::FusionCuda(const Options& options, const int gpu_index)
+    : options_(options) {
+  SetBestCudaDevice(gpu_index);
+  device_images_.reset(new DeviceImages(options_.cache_size));
+}
+
+FusionCuda::~FusionCuda() {}
+
+Mat<int> FusionCuda::ComputeConsistentPixels(
+    const int ref_image_idx, const Image& ref_image,
+    const std::vector<int>& src_image_idxs,
+    const std::vector<Image>& src_images) {
+  CHECK_EQ(src_image_idxs.size(), src_images.size());
+
+  const size_t width = ref_image.depth_map->GetWidth();
+  const size_t height = ref_image.depth_map->GetHeight();
+  const size_t num_src_images = src_images.size();
+  if (width == 0 || height == 0 || num_src_images == 0) {
+    return Mat<int>(width, height, 0);
+  }
+
+  // Upload the source images first, so that the reference image is the last
+  // to be evicted from the cache.
+  std::vector<DeviceImages::DeviceImage> device_images;
+  device_images.reserve(num_src_images + 1);
+  std::vector<ImageParams> src_params(num_src_images);
+  for (size_t i = 0; i < num_src_images; ++i) {
+    device_images.push_back(device_images_->Upload(
+        src_image_idxs[i], src_images[i], &src_params[i]));
+  }
+
+  ImageParams ref_params;
+  device_images.push_back(
+      device_images_->Upload(ref_image_idx, ref_image, &ref_params));
+
+  ImageParams* src_params_device = nullptr;
+  CUDA_SAFE_CALL(cudaMalloc((void**)&src_params_device,
+                            num_src_images * sizeof(ImageParams)));
+  CUDA_SAFE_CALL(cudaMemcpy(src_params_device, src_params.data(),
+                            num_src_images * sizeof(ImageParams),
+                            cudaMemcpyHostToDevice));
+
+  GpuMat<int> consistent_pixels(width, height, num_src_images);
+
+  const dim3 block_size(kBlockDimX, kBlockDimY);
+  const dim3 grid_size((width - 1) / kBlockDimX + 1,
+                       (height - 1) / kBlockDimY + 1);
+  ComputeConsistentPixelsKernel<<<grid_size, block_size>>>(
+      ref_params, src_params_device, static_cast<int>(num_src_images),
+      options_.max_reproj_error * options_.max_reproj_error,
+      options_.max_depth_error, options_.min_cos_normal_error,
+      consistent_pixels);
+  CUDA_SYNC_AND_CHECK();
+
+  CUDA_SAFE_CALL(cudaFree(src_params_device));
+
+  return consistent_pixels.CopyToMat();
+}
+
+void FusionCuda::EvictImage(const int image_idx) {
+  device_images_->cache.Erase(image_idx);
+}
+
+}  // namespace mvs
+}  // namespace colmap
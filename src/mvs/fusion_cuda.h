@@ -0,0 +1,105 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_MVS_FUSION_CUDA_H_
+#define COLMAP_SRC_MVS_FUSION_CUDA_H_
+
+#include <memory>
+#include <vector>
+
+#include "mvs/depth_map.h"
+#include "mvs/mat.h"
+#include "mvs/normal_map.h"
+
+namespace colmap {
+namespace mvs {
+
+// Evaluate the cross-view consistency of all pixels of a reference depth map
+// in parallel on the GPU. The reference point of every pixel is projected into
+// each source image and the nearest source pixel is consistent, if its depth,
+// reprojection, and normal agree with the reference pixel under the same
+// criteria as in the traversal of the CPU fusion.
+class FusionCuda {
+ public:
+  struct Options {
+    // Maximum relative difference between measured and projected pixel.
+    float max_reproj_error = 2.0f;
+
+    // Maximum relative difference between measured and projected depth.
+    float max_depth_error = 0.01f;
+
+    // Minimum cosine of the angle between the normals of consistent pixels.
+    float min_cos_normal_error = 0.0f;
+
+    // Maximum size in gigabytes of the depth and normal maps that are kept on
+    // the device, so that source images are not uploaded for every reference
+    // image they overlap with.
+    double cache_size = 2.0;
+  };
+
+  struct Image {
+    const DepthMap* depth_map = nullptr;
+    const NormalMap* normal_map = nullptr;
+    // Projection matrix of the depth map as row-major 3x4 matrix.
+    float P[12];
+    // Inverse projection matrix of the depth map as row-major 3x4 matrix.
+    float inv_P[12];
+    // Rotation from the camera to the world frame as row-major 3x3 matrix.
+    float inv_R[9];
+  };
+
+  FusionCuda(const Options& options, const int gpu_index);
+  ~FusionCuda();
+
+  // Compute the consistent source pixels of all reference pixels. Element
+  // (row, col, i) of the returned matrix is the linear index src_row *
+  // src_width + src_col of the consistent pixel in the i-th source image or
+  // -1, if there is none. The images are identified by their index in order
+  // to keep their data on the device across calls.
+  Mat<int> ComputeConsistentPixels(const int ref_image_idx,
+                                   const Image& ref_image,
+                                   const std::vector<int>& src_image_idxs,
+                                   const std::vector<Image>& src_images);
+
+  // Remove the data of an image from the device, once it is not needed.
+  void EvictImage(const int image_idx);
+
+ private:
+  struct DeviceImages;
+
+  const Options options_;
+  std::unique_ptr<DeviceImages> device_images_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_MVS_FUSION_CUDA_H_
@@ -0,0 +1,125 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "mvs/fusion"
+#include "util/testing.h"
+
+#include <boost/filesystem.hpp>
+
+#include "mvs/fusion.h"
+#include "util/endian.h"
+#include "util/random.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+std::string CreateTempPath() {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("colmap_fusion_%%%%-%%%%.vis"))
+      .string();
+}
+
+void CheckPointsVisibility(
+    const std::vector<std::vector<int>>& points_visibility,
+    const PointsVisibility& visibility) {
+  BOOST_CHECK_EQUAL(visibility.NumPoints(), points_visibility.size());
+  for (size_t point_idx = 0; point_idx < points_visibility.size();
+       ++point_idx) {
+    const auto& image_idxs = points_visibility[point_idx];
+    const size_t offset = visibility.point_offsets[point_idx];
+    BOOST_CHECK_EQUAL(visibility.point_offsets[point_idx + 1] - offset,
+                      image_idxs.size());
+    for (size_t i = 0; i < image_idxs.size(); ++i) {
+      BOOST_CHECK_EQUAL(visibility.image_idxs[offset + i], image_idxs[i]);
+    }
+  }
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestWriteReadPointsVisibility) {
+  SetPRNGSeed(0);
+  for (const size_t num_points :
+       {size_t(0), size_t(10), 3 * kNumPointsPerVisibilityChunk + 1}) {
+    std::vector<std::vector<int>> points_visibility(num_points);
+    for (auto& image_idxs : points_visibility) {
+      image_idxs.resize(RandomInteger(0, 5));
+      for (auto& image_idx : image_idxs) {
+        image_idx = RandomInteger(0, 100000);
+      }
+    }
+
+    const std::string path = CreateTempPath();
+    WritePointsVisibility(path, points_visibility);
+    CheckPointsVisibility(points_visibility, ReadPointsVisibility(path));
+    CheckPointsVisibility(points_visibility, ReadPointsVisibility(path, 1));
+    boost::filesystem::remove(path);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestPointsVisibilityWriter) {
+  const std::vector<std::vector<int>> points_visibility = {
+      {0, 1, 2}, {}, {5, 3, 1000000}, {7}};
+
+  const std::string path = CreateTempPath();
+  {
+    PointsVisibilityWriter writer(path);
+    for (const auto& image_idxs : points_visibility) {
+      writer.Write(image_idxs);
+    }
+    BOOST_CHECK_EQUAL(writer.NumPoints(), points_visibility.size());
+  }
+
+  CheckPointsVisibility(points_visibility, ReadPointsVisibility(path));
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadUncompressedPointsVisibility) {
+  const std::vector<std::vector<int>> points_visibility = {
+      {0, 1, 2}, {}, {5, 3, 1000000}, {7}};
+
+  const std::string path = CreateTempPath();
+  {
+    std::fstream file(path, std::ios::out | std::ios::binary);
+    WriteBinaryLittleEndian<uint64_t>(&file, points_visibility.size());
+    for (const auto& image_idxs : points_visibility) {
+      WriteBinaryLittleEndian<uint32_t>(&file, image_idxs.size());
+      for (const int image_idx : image_idxs) {
+        WriteBinaryLittleEndian<uint32_t>(&file, image_idx);
+      }
+    }
+  }
+
+  CheckPointsVisibility(points_visibility, ReadPointsVisibility(path));
+  boost::filesystem::remove(path);
+}
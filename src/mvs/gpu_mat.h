@@ -174,10 +174,10 @@ GpuMat<T>::GpuMat(const size_t width, const size_t height, const size_t depth)
       width_(width),
       height_(height),
       depth_(depth) {
-  CUDA_SAFE_CALL(cudaMallocPitch((void**)&array_ptr_, &pitch_,
-                                 width_ * sizeof(T), height_ * depth_));
+  CudaMallocPitchCached((void**)&array_ptr_, &pitch_, width_ * sizeof(T),
+                        height_ * depth_);
 
-  array_ = std::shared_ptr<T>(array_ptr_, cudaFree);
+  array_ = std::shared_ptr<T>(array_ptr_, CudaFreeCached);
 
   ComputeCudaConfig();
 }
@@ -32,16 +32,29 @@
 #ifndef COLMAP_SRC_MVS_MAT_H_
 #define COLMAP_SRC_MVS_MAT_H_
 
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "util/endian.h"
 #include "util/logging.h"
+#include "util/mapped_file.h"
+#include "util/math.h"
 
 namespace colmap {
 namespace mvs {
 
+// The identifier and version of the compressed format of matrices.
+const char kMatCompressedMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'M', 'T'};
+const uint32_t kMatCompressedVersion = 1;
+
+// The number of rows in each block of the compressed format, which are
+// compressed independently of the other blocks.
+const size_t kMatCompressedBlockNumRows = 64;
+
 template <typename T>
 class Mat {
  public:
@@ -67,10 +80,23 @@ class Mat {
 
   void Fill(const T value);
 
+  // Read the matrix in the raw or the compressed format.
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
+  // Write the matrix in the compressed format, which omits runs of zeros, e.g.,
+  // the filtered pixels of depth and normal maps, and stores the remaining
+  // values losslessly. The rows are split into blocks with an offset table, so
+  // that a block can be decoded without the preceding blocks. Float matrices
+  // can be quantized to half precision with a relative rounding error of up to
+  // 2^-11, which halves the size of the remaining values, unless any value is
+  // out of the range of half precision.
+  void WriteCompressed(const std::string& path,
+                       const bool half_precision = false) const;
+
  protected:
+  void ReadCompressed(const std::string& path);
+
   size_t width_ = 0;
   size_t height_ = 0;
   size_t depth_ = 0;
@@ -155,6 +181,19 @@ void Mat<T>::Fill(const T value) {
 
 template <typename T>
 void Mat<T>::Read(const std::string& path) {
+  {
+    std::ifstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+    char magic[sizeof(kMatCompressedMagic)] = {0};
+    file.read(magic, sizeof(magic));
+    if (file &&
+        std::memcmp(magic, kMatCompressedMagic, sizeof(magic)) == 0) {
+      file.close();
+      ReadCompressed(path);
+      return;
+    }
+  }
+
   std::fstream text_file(path, std::ios::in | std::ios::binary);
   CHECK(text_file.is_open()) << path;
 
@@ -190,6 +229,154 @@ void Mat<T>::Write(const std::string& path) const {
   binary_file.close();
 }
 
+template <typename T>
+void Mat<T>::WriteCompressed(const std::string& path,
+                             bool half_precision) const {
+  CHECK(!half_precision || (std::is_same<T, float>::value))
+      << "Half precision is only supported for float matrices";
+
+  // Fall back to single precision, if any value is out of the range of half
+  // precision floats.
+  if (half_precision) {
+    for (const T value : data_) {
+      if (std::abs(static_cast<float>(value)) > 65504.0f) {
+        half_precision = false;
+        break;
+      }
+    }
+  }
+
+  const size_t num_blocks =
+      (height_ + kMatCompressedBlockNumRows - 1) / kMatCompressedBlockNumRows;
+
+  // Encode each block as a sequence of the number of zeros, the number of
+  // following non-zero values, and the non-zero values, separately for each
+  // slice of the block.
+  std::vector<char> blocks;
+  std::vector<uint64_t> block_offsets;
+  block_offsets.reserve(num_blocks + 1);
+  block_offsets.push_back(0);
+
+  const auto AppendValue = [&blocks](const void* value, const size_t size) {
+    const char* bytes = static_cast<const char*>(value);
+    blocks.insert(blocks.end(), bytes, bytes + size);
+  };
+
+  for (size_t block_idx = 0; block_idx < num_blocks; ++block_idx) {
+    const size_t row_begin = block_idx * kMatCompressedBlockNumRows;
+    const size_t row_end =
+        std::min(row_begin + kMatCompressedBlockNumRows, height_);
+    for (size_t slice = 0; slice < depth_; ++slice) {
+      const T* values = data_.data() + slice * width_ * height_;
+      const size_t end = row_end * width_;
+      size_t idx = row_begin * width_;
+      while (idx < end) {
+        const size_t zeros_begin = idx;
+        while (idx < end && values[idx] == static_cast<T>(0)) {
+          idx += 1;
+        }
+        const size_t values_begin = idx;
+        while (idx < end && values[idx] != static_cast<T>(0)) {
+          idx += 1;
+        }
+
+        const uint32_t num_zeros = values_begin - zeros_begin;
+        const uint32_t num_values = idx - values_begin;
+        AppendValue(&num_zeros, sizeof(num_zeros));
+        AppendValue(&num_values, sizeof(num_values));
+        for (size_t i = values_begin; i < idx; ++i) {
+          if (half_precision) {
+            const uint16_t value = FloatToHalf(values[i]);
+            AppendValue(&value, sizeof(value));
+          } else {
+            AppendValue(&values[i], sizeof(T));
+          }
+        }
+      }
+    }
+    block_offsets.push_back(blocks.size());
+  }
+
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  CHECK(file.is_open()) << path;
+  file.write(kMatCompressedMagic, sizeof(kMatCompressedMagic));
+  WriteMapped(&file, kMatCompressedVersion);
+  WriteMapped(&file, static_cast<uint32_t>(sizeof(T)));
+  WriteMapped(&file, static_cast<uint32_t>(half_precision));
+  WriteMapped(&file, static_cast<uint64_t>(width_));
+  WriteMapped(&file, static_cast<uint64_t>(height_));
+  WriteMapped(&file, static_cast<uint64_t>(depth_));
+  WriteMapped(&file, static_cast<uint64_t>(kMatCompressedBlockNumRows));
+  WriteMappedArray(&file, block_offsets.data(), block_offsets.size());
+  WriteMappedArray(&file, blocks.data(), blocks.size());
+  CHECK(file.good()) << path;
+}
+
+template <typename T>
+void Mat<T>::ReadCompressed(const std::string& path) {
+  const MappedFile file(path);
+
+  size_t offset = sizeof(kMatCompressedMagic);
+  CHECK_EQ(file.Read<uint32_t>(&offset), kMatCompressedVersion)
+      << "Incompatible matrix file " << path;
+  CHECK_EQ(file.Read<uint32_t>(&offset), sizeof(T))
+      << "Incompatible value type in " << path;
+  const bool half_precision = file.Read<uint32_t>(&offset) != 0;
+  CHECK(!half_precision || (std::is_same<T, float>::value))
+      << "Incompatible value type in " << path;
+  width_ = file.Read<uint64_t>(&offset);
+  height_ = file.Read<uint64_t>(&offset);
+  depth_ = file.Read<uint64_t>(&offset);
+  const size_t block_num_rows = file.Read<uint64_t>(&offset);
+  CHECK_GT(block_num_rows, 0) << path;
+
+  const size_t num_blocks = (height_ + block_num_rows - 1) / block_num_rows;
+  const uint64_t* block_offsets =
+      file.ReadArray<uint64_t>(&offset, num_blocks + 1);
+  const char* blocks = file.ReadArray<char>(&offset, block_offsets[num_blocks]);
+
+  data_.assign(width_ * height_ * depth_, 0);
+
+  for (size_t block_idx = 0; block_idx < num_blocks; ++block_idx) {
+    const char* block = blocks + block_offsets[block_idx];
+    const char* block_end = blocks + block_offsets[block_idx + 1];
+    const size_t row_begin = block_idx * block_num_rows;
+    const size_t row_end = std::min(row_begin + block_num_rows, height_);
+    for (size_t slice = 0; slice < depth_; ++slice) {
+      T* values = data_.data() + slice * width_ * height_;
+      const size_t end = row_end * width_;
+      size_t idx = row_begin * width_;
+      while (idx < end) {
+        CHECK_LE(block + 2 * sizeof(uint32_t), block_end)
+            << "Corrupt matrix file " << path;
+        uint32_t num_zeros;
+        uint32_t num_values;
+        std::memcpy(&num_zeros, block, sizeof(num_zeros));
+        std::memcpy(&num_values, block + sizeof(num_zeros), sizeof(num_values));
+        block += sizeof(num_zeros) + sizeof(num_values);
+
+        idx += num_zeros;
+        CHECK_LE(idx + num_values, end) << "Corrupt matrix file " << path;
+
+        const size_t value_size = half_precision ? sizeof(uint16_t) : sizeof(T);
+        CHECK_LE(block + num_values * value_size, block_end)
+            << "Corrupt matrix file " << path;
+        if (half_precision) {
+          for (uint32_t i = 0; i < num_values; ++i) {
+            uint16_t value;
+            std::memcpy(&value, block + i * sizeof(uint16_t), sizeof(value));
+            values[idx + i] = HalfToFloat(value);
+          }
+        } else {
+          std::memcpy(values + idx, block, num_values * sizeof(T));
+        }
+        block += num_values * value_size;
+        idx += num_values;
+      }
+    }
+  }
+}
+
 }  // namespace mvs
 }  // namespace colmap
 
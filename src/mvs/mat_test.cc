@@ -32,6 +32,8 @@
 #define TEST_NAME "mvs/mat_test"
 #include "util/testing.h"
 
+#include <boost/filesystem.hpp>
+
 #include "mvs/mat.h"
 
 using namespace colmap::mvs;
@@ -95,3 +97,76 @@ BOOST_AUTO_TEST_CASE(TestFill) {
   mat.Set(1, 0, 1, 10);
   mat.Set(1, 0, 2, 10);
 }
+
+BOOST_AUTO_TEST_CASE(TestReadWriteCompressed) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_mat_%%%%-%%%%.bin"))
+          .string();
+
+  // Use more rows than fit into a single block.
+  Mat<float> mat(3, 150, 2);
+  for (size_t row = 0; row < mat.GetHeight(); ++row) {
+    for (size_t col = 0; col < mat.GetWidth(); ++col) {
+      if ((row + col) % 4 != 0) {
+        mat.Set(row, col, 0, row + 0.25f * col);
+        mat.Set(row, col, 1, -1.0f / (row + col));
+      }
+    }
+  }
+
+  mat.WriteCompressed(path);
+
+  Mat<float> read_mat;
+  read_mat.Read(path);
+  BOOST_CHECK_EQUAL(read_mat.GetWidth(), mat.GetWidth());
+  BOOST_CHECK_EQUAL(read_mat.GetHeight(), mat.GetHeight());
+  BOOST_CHECK_EQUAL(read_mat.GetDepth(), mat.GetDepth());
+  BOOST_CHECK(read_mat.GetData() == mat.GetData());
+
+  mat.WriteCompressed(path, true);
+
+  read_mat.Read(path);
+  BOOST_CHECK_EQUAL(read_mat.GetWidth(), mat.GetWidth());
+  BOOST_CHECK_EQUAL(read_mat.GetHeight(), mat.GetHeight());
+  BOOST_CHECK_EQUAL(read_mat.GetDepth(), mat.GetDepth());
+  for (size_t i = 0; i < mat.GetData().size(); ++i) {
+    BOOST_CHECK_LE(std::abs(read_mat.GetData()[i] - mat.GetData()[i]),
+                   std::abs(mat.GetData()[i]) / 2048.0f);
+    BOOST_CHECK_EQUAL(read_mat.GetData()[i] == 0, mat.GetData()[i] == 0);
+  }
+
+  // Values out of the range of half precision are stored in single precision.
+  mat.Set(0, 1, 1, 1e5f);
+  mat.WriteCompressed(path, true);
+
+  read_mat.Read(path);
+  BOOST_CHECK(read_mat.GetData() == mat.GetData());
+
+  mat.Write(path);
+
+  read_mat.Read(path);
+  BOOST_CHECK(read_mat.GetData() == mat.GetData());
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWriteCompressedEmpty) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_mat_%%%%-%%%%.bin"))
+          .string();
+
+  Mat<int> mat(4, 3, 1);
+  mat.WriteCompressed(path);
+
+  Mat<int> read_mat(1, 1, 1);
+  read_mat.Fill(1);
+  read_mat.Read(path);
+  BOOST_CHECK_EQUAL(read_mat.GetWidth(), 4);
+  BOOST_CHECK_EQUAL(read_mat.GetHeight(), 3);
+  BOOST_CHECK_EQUAL(read_mat.GetDepth(), 1);
+  BOOST_CHECK(read_mat.GetData() == mat.GetData());
+
+  boost::filesystem::remove(path);
+}
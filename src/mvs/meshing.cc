@@ -31,10 +31,15 @@
 
 #include "mvs/meshing.h"
 
+#include <algorithm>
+#include <array>
 #include <fstream>
+#include <numeric>
 #include <unordered_map>
 #include <vector>
 
+#include <boost/filesystem.hpp>
+
 #ifdef CGAL_ENABLED
 #include <CGAL/Delaunay_triangulation_3.h>
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -44,6 +49,7 @@
 #include "PoissonRecon/SurfaceTrimmer.h"
 #include "base/graph_cut.h"
 #include "base/reconstruction.h"
+#include "mvs/fusion.h"
 #include "util/endian.h"
 #include "util/logging.h"
 #include "util/misc.h"
@@ -102,6 +108,8 @@ bool PoissonMeshingOptions::Check() const {
   CHECK_OPTION_GE(trim, 0);
   CHECK_OPTION_GE(num_threads, -1);
   CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GE(max_tile_points, 0);
+  CHECK_OPTION_GE(tile_overlap, 0);
   return true;
 }
 
@@ -120,11 +128,11 @@ bool DelaunayMeshingOptions::Check() const {
   return true;
 }
 
-bool PoissonMeshing(const PoissonMeshingOptions& options,
-                    const std::string& input_path,
-                    const std::string& output_path) {
-  CHECK(options.Check());
+namespace {
 
+bool RunPoissonRecon(const PoissonMeshingOptions& options, const int depth,
+                     const std::string& input_path,
+                     const std::string& output_path) {
   std::vector<std::string> args;
 
   args.push_back("./binary");
@@ -139,7 +147,7 @@ bool PoissonMeshing(const PoissonMeshingOptions& options,
   args.push_back(std::to_string(options.point_weight));
 
   args.push_back("--depth");
-  args.push_back(std::to_string(options.depth));
+  args.push_back(std::to_string(depth));
 
   if (options.color > 0) {
     args.push_back("--color");
@@ -195,6 +203,187 @@ bool PoissonMeshing(const PoissonMeshingOptions& options,
                         const_cast<char**>(args_cstr.data())) == EXIT_SUCCESS;
 }
 
+struct PoissonTile {
+  // The bounds of the faces that are kept from the mesh of the tile. The tiles
+  // at the boundary of the scene are unbounded towards the outside.
+  Eigen::Vector3f min_bound;
+  Eigen::Vector3f max_bound;
+  // The extent of the points inside the bounds of the tile.
+  Eigen::Vector3f extent;
+};
+
+// Recursively split the points at the median along their longest extent until
+// each tile contains at most the maximum number of points.
+void SplitPoissonTile(const std::vector<PlyPoint>& points,
+                      const size_t max_num_points, const PoissonTile& tile,
+                      std::vector<size_t>::iterator point_idxs_begin,
+                      std::vector<size_t>::iterator point_idxs_end,
+                      std::vector<PoissonTile>* tiles) {
+  Eigen::Vector3f min_xyz = Eigen::Vector3f::Constant(
+      std::numeric_limits<float>::max());
+  Eigen::Vector3f max_xyz = Eigen::Vector3f::Constant(
+      std::numeric_limits<float>::lowest());
+  for (auto it = point_idxs_begin; it != point_idxs_end; ++it) {
+    const PlyPoint& point = points[*it];
+    const Eigen::Vector3f xyz(point.x, point.y, point.z);
+    min_xyz = min_xyz.cwiseMin(xyz);
+    max_xyz = max_xyz.cwiseMax(xyz);
+  }
+
+  const size_t num_points = point_idxs_end - point_idxs_begin;
+  if (num_points <= max_num_points) {
+    tiles->push_back(tile);
+    tiles->back().extent = max_xyz - min_xyz;
+    return;
+  }
+
+  int axis;
+  (max_xyz - min_xyz).maxCoeff(&axis);
+
+  const auto point_idxs_mid = point_idxs_begin + num_points / 2;
+  std::nth_element(point_idxs_begin, point_idxs_mid, point_idxs_end,
+                   [&points, axis](const size_t idx1, const size_t idx2) {
+                     return (&points[idx1].x)[axis] < (&points[idx2].x)[axis];
+                   });
+  const float split = (&points[*point_idxs_mid].x)[axis];
+
+  PoissonTile tile1 = tile;
+  tile1.max_bound(axis) = split;
+  SplitPoissonTile(points, max_num_points, tile1, point_idxs_begin,
+                   point_idxs_mid, tiles);
+
+  PoissonTile tile2 = tile;
+  tile2.min_bound(axis) = split;
+  SplitPoissonTile(points, max_num_points, tile2, point_idxs_mid,
+                   point_idxs_end, tiles);
+}
+
+bool TiledPoissonMeshing(const PoissonMeshingOptions& options,
+                         const std::string& input_path,
+                         const std::string& output_path) {
+  const std::vector<PlyPoint> points = ReadPly(input_path);
+
+  std::vector<size_t> point_idxs(points.size());
+  std::iota(point_idxs.begin(), point_idxs.end(), 0);
+
+  PoissonTile root_tile;
+  root_tile.min_bound.setConstant(-std::numeric_limits<float>::infinity());
+  root_tile.max_bound.setConstant(std::numeric_limits<float>::infinity());
+
+  std::vector<PoissonTile> tiles;
+  SplitPoissonTile(points, options.max_tile_points, root_tile,
+                   point_idxs.begin(), point_idxs.end(), &tiles);
+
+  Eigen::Vector3f min_xyz = Eigen::Vector3f::Constant(
+      std::numeric_limits<float>::max());
+  Eigen::Vector3f max_xyz = Eigen::Vector3f::Constant(
+      std::numeric_limits<float>::lowest());
+  for (const auto& point : points) {
+    const Eigen::Vector3f xyz(point.x, point.y, point.z);
+    min_xyz = min_xyz.cwiseMin(xyz);
+    max_xyz = max_xyz.cwiseMax(xyz);
+  }
+  const float scene_extent = (max_xyz - min_xyz).maxCoeff();
+
+  const std::string tile_input_path = output_path + ".tile-input.ply";
+  const std::string tile_output_path = output_path + ".tile-output.ply";
+
+  PlyMesh mesh;
+  std::vector<PlyPoint> tile_points;
+  std::vector<int> vertex_idx_map;
+
+  for (size_t tile_idx = 0; tile_idx < tiles.size(); ++tile_idx) {
+    const PoissonTile& tile = tiles[tile_idx];
+
+    const Eigen::Vector3f overlap = options.tile_overlap * tile.extent;
+    const Eigen::Vector3f min_bound = tile.min_bound - overlap;
+    const Eigen::Vector3f max_bound = tile.max_bound + overlap;
+
+    tile_points.clear();
+    for (const auto& point : points) {
+      const Eigen::Vector3f xyz(point.x, point.y, point.z);
+      if ((xyz.array() >= min_bound.array()).all() &&
+          (xyz.array() <= max_bound.array()).all()) {
+        tile_points.push_back(point);
+      }
+    }
+
+    // Reduce the depth of the tile according to its extent, such that the
+    // resolution of the tile is the same as for the entire scene.
+    const float tile_extent = (tile.extent + 2 * overlap).maxCoeff();
+    int depth = options.depth;
+    if (tile_extent > 0) {
+      depth -= static_cast<int>(std::round(std::log2(scene_extent /
+                                                     tile_extent)));
+    }
+    depth = std::max(1, depth);
+
+    std::cout << "Meshing tile " << tile_idx + 1 << " / " << tiles.size()
+              << " with " << tile_points.size() << " points at depth "
+              << depth << std::endl;
+
+    WriteBinaryPlyPoints(tile_input_path, tile_points);
+    tile_points.clear();
+
+    if (!RunPoissonRecon(options, depth, tile_input_path, tile_output_path)) {
+      return false;
+    }
+
+    const PlyMesh tile_mesh = ReadPlyMesh(tile_output_path);
+
+    // Only keep the faces with their centroid inside the tile and add their
+    // vertices to the output mesh.
+    vertex_idx_map.assign(tile_mesh.vertices.size(), -1);
+    const auto AddVertex = [&mesh, &tile_mesh,
+                            &vertex_idx_map](const size_t vertex_idx) {
+      if (vertex_idx_map[vertex_idx] == -1) {
+        vertex_idx_map[vertex_idx] = static_cast<int>(mesh.vertices.size());
+        mesh.vertices.push_back(tile_mesh.vertices[vertex_idx]);
+      }
+      return static_cast<size_t>(vertex_idx_map[vertex_idx]);
+    };
+
+    for (const auto& face : tile_mesh.faces) {
+      const PlyMeshVertex& vertex1 = tile_mesh.vertices[face.vertex_idx1];
+      const PlyMeshVertex& vertex2 = tile_mesh.vertices[face.vertex_idx2];
+      const PlyMeshVertex& vertex3 = tile_mesh.vertices[face.vertex_idx3];
+      const Eigen::Vector3f centroid =
+          (Eigen::Vector3f(vertex1.x, vertex1.y, vertex1.z) +
+           Eigen::Vector3f(vertex2.x, vertex2.y, vertex2.z) +
+           Eigen::Vector3f(vertex3.x, vertex3.y, vertex3.z)) /
+          3.0f;
+      if ((centroid.array() >= tile.min_bound.array()).all() &&
+          (centroid.array() < tile.max_bound.array()).all()) {
+        const size_t vertex_idx1 = AddVertex(face.vertex_idx1);
+        const size_t vertex_idx2 = AddVertex(face.vertex_idx2);
+        const size_t vertex_idx3 = AddVertex(face.vertex_idx3);
+        mesh.faces.emplace_back(vertex_idx1, vertex_idx2, vertex_idx3);
+      }
+    }
+  }
+
+  boost::filesystem::remove(tile_input_path);
+  boost::filesystem::remove(tile_output_path);
+
+  WriteBinaryPlyMesh(output_path, mesh, options.color > 0);
+
+  return true;
+}
+
+}  // namespace
+
+bool PoissonMeshing(const PoissonMeshingOptions& options,
+                    const std::string& input_path,
+                    const std::string& output_path) {
+  CHECK(options.Check());
+
+  if (options.max_tile_points > 0) {
+    return TiledPoissonMeshing(options, input_path, output_path);
+  }
+
+  return RunPoissonRecon(options, options.depth, input_path, output_path);
+}
+
 #ifdef CGAL_ENABLED
 
 K::Point_3 EigenToCGAL(const Eigen::Vector3f& point) {
@@ -282,12 +471,9 @@ class DelaunayMeshingInput {
 
     const auto& ply_points = ReadPly(JoinPaths(path, "fused.ply"));
 
-    const std::string vis_path = JoinPaths(path, "fused.ply.vis");
-    std::fstream vis_file(vis_path, std::ios::in | std::ios::binary);
-    CHECK(vis_file.is_open()) << vis_path;
-
-    const size_t vis_num_points = ReadBinaryLittleEndian<uint64_t>(&vis_file);
-    CHECK_EQ(vis_num_points, ply_points.size());
+    const PointsVisibility visibility =
+        ReadPointsVisibility(JoinPaths(path, "fused.ply.vis"));
+    CHECK_EQ(visibility.NumPoints(), ply_points.size());
 
     points.reserve(ply_points.size());
     for (const auto& ply_point : ply_points) {
@@ -296,10 +482,11 @@ class DelaunayMeshingInput {
       input_point.position =
           Eigen::Vector3f(ply_point.x, ply_point.y, ply_point.z);
       input_point.num_visible_images =
-          ReadBinaryLittleEndian<uint32_t>(&vis_file);
-      for (uint32_t i = 0; i < input_point.num_visible_images; ++i) {
-        const int image_idx = ReadBinaryLittleEndian<uint32_t>(&vis_file);
-        images.at(image_idx).point_idxs.push_back(point_idx);
+          visibility.point_offsets[point_idx + 1] -
+          visibility.point_offsets[point_idx];
+      for (size_t i = visibility.point_offsets[point_idx];
+           i < visibility.point_offsets[point_idx + 1]; ++i) {
+        images.at(visibility.image_idxs[i]).point_idxs.push_back(point_idx);
       }
       points.push_back(input_point);
     }
@@ -315,8 +502,9 @@ class DelaunayMeshingInput {
     return Delaunay(delaunay_points.begin(), delaunay_points.end());
   }
 
-  Delaunay CreateSubSampledDelaunayTriangulation(
-      const float max_proj_dist, const float max_depth_dist) const {
+  Delaunay CreateSubSampledDelaunayTriangulation(const float max_proj_dist,
+                                                 const float max_depth_dist,
+                                                 const int num_threads) const {
     CHECK_GE(max_proj_dist, 0);
 
     if (max_proj_dist == 0) {
@@ -340,31 +528,19 @@ class DelaunayMeshingInput {
     const float min_depth_ratio = 1.0f - max_depth_dist;
     const float max_depth_ratio = 1.0f + max_depth_dist;
 
-    for (const auto point_idx : point_idxs) {
+    const auto IsPointDistinct = [&](const size_t point_idx,
+                                     const Delaunay::Cell_handle cell) -> bool {
       const auto& point = points[point_idx];
       const auto& visible_image_idxs = points_visible_image_idxs[point_idx];
 
-      const K::Point_3 point_position = EigenToCGAL(point.position);
-
-      // Insert point into triangulation until there is one cell.
-      if (triangulation.number_of_vertices() < 4) {
-        triangulation.insert(point_position);
-        continue;
-      }
-
-      const Delaunay::Cell_handle cell = triangulation.locate(point_position);
-
       // If the point is outside the current hull, then extend the hull.
       if (triangulation.is_infinite(cell)) {
-        triangulation.insert(point_position);
-        continue;
+        return true;
       }
 
       // Project point and located cell vertices to all visible images and
       // determine reprojection error.
 
-      bool insert_point = false;
-
       for (const auto& image_idx : visible_image_idxs) {
         const auto& image = images[image_idx];
         const auto& camera = cameras.at(image.camera_id);
@@ -380,15 +556,13 @@ class DelaunayMeshingInput {
 
           // Ensure that both points are infront of camera.
           if (point_local.z() <= 0 || cell_point_local.z() <= 0) {
-            insert_point = true;
-            break;
+            return true;
           }
 
           // Check depth ratio between the two points.
           const float depth_ratio = point_local.z() / cell_point_local.z();
           if (depth_ratio < min_depth_ratio || depth_ratio > max_depth_ratio) {
-            insert_point = true;
-            break;
+            return true;
           }
 
           // Check reprojection error between the two points.
@@ -401,23 +575,107 @@ class DelaunayMeshingInput {
           const float squared_proj_dist =
               (point_proj - cell_point_proj).squaredNorm();
           if (squared_proj_dist > max_squared_proj_dist) {
-            insert_point = true;
-            break;
+            return true;
           }
         }
+      }
 
-        if (insert_point) {
-          break;
+      return false;
+    };
+
+    // Returns the vertices of a cell in an order independent of the cell's
+    // orientation. The distinctness of a point only depends on these vertices.
+    typedef std::array<Delaunay::Vertex_handle, 4> CellVertices;
+    const auto GetCellVertices =
+        [](const Delaunay::Cell_handle cell) -> CellVertices {
+      CellVertices cell_vertices;
+      for (int i = 0; i < 4; ++i) {
+        cell_vertices[i] = cell->vertex(i);
+      }
+      std::sort(cell_vertices.begin(), cell_vertices.end());
+      return cell_vertices;
+    };
+
+    // The points are located and tested in batches against the current
+    // triangulation in parallel. The points of a batch are then inserted one
+    // by one in their original order. Once a point of the batch is inserted,
+    // the following points are located again and only tested again if they
+    // fall into a different cell than before. The resulting triangulation is
+    // thus identical to inserting and testing all points sequentially, except
+    // for points exactly on a shared facet, which may be located in either
+    // cell. The batch size is limited to a fraction of the triangulation size,
+    // so that few of the parallel tests become invalid through insertions.
+    ThreadPool thread_pool(num_threads);
+    const size_t num_tasks = thread_pool.NumThreads();
+    std::vector<CellVertices> batch_cell_vertices;
+    std::vector<char> batch_distinct_mask;
+
+    size_t batch_begin = 0;
+    while (batch_begin < point_idxs.size()) {
+      // Insert point into triangulation until there is one cell.
+      if (triangulation.number_of_vertices() < 4) {
+        triangulation.insert(
+            EigenToCGAL(points[point_idxs[batch_begin]].position));
+        batch_begin += 1;
+        continue;
+      }
+
+      const size_t batch_size =
+          num_tasks == 1 ? 1
+                         : std::max(16 * num_tasks,
+                                    triangulation.number_of_vertices() / 16);
+      const size_t batch_end =
+          std::min(point_idxs.size(), batch_begin + batch_size);
+
+      batch_cell_vertices.resize(batch_end - batch_begin);
+      batch_distinct_mask.resize(batch_end - batch_begin);
+
+      const auto TestPoints = [&](const size_t task_idx) {
+        for (size_t i = batch_begin + task_idx; i < batch_end; i += num_tasks) {
+          const size_t point_idx = point_idxs[i];
+          const Delaunay::Cell_handle cell =
+              triangulation.locate(EigenToCGAL(points[point_idx].position));
+          batch_cell_vertices[i - batch_begin] = GetCellVertices(cell);
+          batch_distinct_mask[i - batch_begin] =
+              IsPointDistinct(point_idx, cell);
         }
+      };
+
+      if (num_tasks == 1) {
+        TestPoints(0);
+      } else {
+        for (size_t task_idx = 0; task_idx < num_tasks; ++task_idx) {
+          thread_pool.AddTask(TestPoints, task_idx);
+        }
+        thread_pool.Wait();
       }
 
-      if (insert_point) {
-        triangulation.insert(point_position);
+      bool batch_modified = false;
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        const size_t point_idx = point_idxs[i];
+        const K::Point_3 point_position =
+            EigenToCGAL(points[point_idx].position);
+
+        bool insert_point = batch_distinct_mask[i - batch_begin];
+        if (batch_modified) {
+          const Delaunay::Cell_handle cell =
+              triangulation.locate(point_position);
+          if (GetCellVertices(cell) != batch_cell_vertices[i - batch_begin]) {
+            insert_point = IsPointDistinct(point_idx, cell);
+          }
+        }
+
+        if (insert_point) {
+          triangulation.insert(point_position);
+          batch_modified = true;
+        }
       }
+
+      batch_begin = batch_end;
     }
 
-    std::cout << StringPrintf("Triangulation has %d using %d points.",
-                              triangulation.number_of_vertices(), points.size())
+    std::cout << "Triangulation has " << triangulation.number_of_vertices()
+              << " vertices using " << points.size() << " points."
               << std::endl;
 
     return triangulation;
@@ -701,7 +959,7 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
   // Create a delaunay triangulation of all input points.
   std::cout << "Triangulating points..." << std::endl;
   const auto triangulation = input_data.CreateSubSampledDelaunayTriangulation(
-      options.max_proj_dist, options.max_depth_dist);
+      options.max_proj_dist, options.max_depth_dist, options.num_threads);
 
   // Helper class to efficiently trace rays through the triangulation.
   std::cout << "Initializing ray tracer..." << std::endl;
@@ -871,8 +1129,10 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
   std::cout << "Setting up optimization..." << std::endl;
 
   // Each oriented facet in the Delaunay triangulation corresponds to a directed
-  // edge and each cell corresponds to a node in the graph.
-  MinSTGraphCut<size_t, float> graph_cut(cell_graph_data.size());
+  // edge and each cell corresponds to a node in the graph. Every cell has four
+  // facets that are each shared with another cell.
+  CompactMinSTGraphCut<size_t, float> graph_cut(cell_graph_data.size(),
+                                                2 * cell_graph_data.size());
 
   // Iterate all cells in the triangulation.
   for (auto& cell_data : cell_graph_data) {
@@ -64,6 +64,17 @@ struct PoissonMeshingOptions {
   // The number of threads used for the Poisson reconstruction.
   int num_threads = -1;
 
+  // If positive, the input points are split into spatial tiles with at most
+  // this number of points, which are meshed one after another and stitched
+  // into the output mesh. This bounds the memory of the reconstruction by the
+  // tile size instead of the scene size.
+  int max_tile_points = 0;
+
+  // The overlap of neighboring tiles relative to the tile extent. Only the
+  // faces in the interior of each tile are kept, so that the clipped tile
+  // boundaries are not part of the output mesh.
+  double tile_overlap = 0.1;
+
   bool Check() const;
 };
 
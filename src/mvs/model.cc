@@ -37,9 +37,106 @@
 #include "base/reconstruction.h"
 #include "base/triangulation.h"
 #include "util/misc.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace mvs {
+namespace {
+
+// Group the pairs of distinct images in the tracks of all points by image. For
+// every pair, make_entries(point, image_idx1, image_idx2, &entry1, &entry2)
+// creates the entry of the first image and of the second image. The sorted
+// entries of image i are stored in the range [offsets[i], offsets[i + 1]).
+template <typename Entry, typename MakeEntries>
+void GroupImagePairs(const std::vector<Model::Point>& points,
+                     const size_t num_images, const MakeEntries& make_entries,
+                     std::vector<size_t>* offsets,
+                     std::vector<Entry>* entries) {
+  const size_t kMinNumPointsPerChunk = 10000;
+  const size_t num_chunks = std::max<size_t>(
+      1, std::min((points.size() + kMinNumPointsPerChunk - 1) /
+                      kMinNumPointsPerChunk,
+                  4 * static_cast<size_t>(GetEffectiveNumThreads(
+                          ThreadPool::kMaxNumThreads))));
+  const size_t num_points_per_chunk =
+      (points.size() + num_chunks - 1) / num_chunks;
+
+  // Count the entries of every image per chunk of points.
+  std::vector<std::vector<size_t>> chunk_offsets(num_chunks);
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, num_chunks,
+              [&](const size_t begin, const size_t end) {
+                for (size_t chunk_idx = begin; chunk_idx < end; ++chunk_idx) {
+                  auto& counts = chunk_offsets[chunk_idx];
+                  counts.resize(num_images, 0);
+                  const size_t point_end = std::min(
+                      points.size(), (chunk_idx + 1) * num_points_per_chunk);
+                  for (size_t point_idx = chunk_idx * num_points_per_chunk;
+                       point_idx < point_end; ++point_idx) {
+                    const auto& track = points[point_idx].track;
+                    for (size_t i = 0; i < track.size(); ++i) {
+                      for (size_t j = 0; j < i; ++j) {
+                        if (track[i] != track[j]) {
+                          counts.at(track[i]) += 1;
+                          counts.at(track[j]) += 1;
+                        }
+                      }
+                    }
+                  }
+                }
+              },
+              ThreadPool::Schedule::DYNAMIC, 1);
+
+  // Convert the counts to the offsets, at which the chunks write the entries.
+  offsets->resize(num_images + 1);
+  size_t num_entries = 0;
+  for (size_t image_idx = 0; image_idx < num_images; ++image_idx) {
+    (*offsets)[image_idx] = num_entries;
+    for (auto& counts : chunk_offsets) {
+      const size_t count = counts[image_idx];
+      counts[image_idx] = num_entries;
+      num_entries += count;
+    }
+  }
+  (*offsets)[num_images] = num_entries;
+
+  entries->resize(num_entries);
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, num_chunks,
+              [&](const size_t begin, const size_t end) {
+                for (size_t chunk_idx = begin; chunk_idx < end; ++chunk_idx) {
+                  auto& next_offsets = chunk_offsets[chunk_idx];
+                  const size_t point_end = std::min(
+                      points.size(), (chunk_idx + 1) * num_points_per_chunk);
+                  for (size_t point_idx = chunk_idx * num_points_per_chunk;
+                       point_idx < point_end; ++point_idx) {
+                    const auto& point = points[point_idx];
+                    for (size_t i = 0; i < point.track.size(); ++i) {
+                      const int image_idx1 = point.track[i];
+                      for (size_t j = 0; j < i; ++j) {
+                        const int image_idx2 = point.track[j];
+                        if (image_idx1 != image_idx2) {
+                          make_entries(
+                              point, image_idx1, image_idx2,
+                              &(*entries)[next_offsets[image_idx1]++],
+                              &(*entries)[next_offsets[image_idx2]++]);
+                        }
+                      }
+                    }
+                  }
+                }
+              },
+              ThreadPool::Schedule::DYNAMIC, 1);
+
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, num_images,
+              [&](const size_t begin, const size_t end) {
+                for (size_t image_idx = begin; image_idx < end; ++image_idx) {
+                  std::sort(entries->begin() + (*offsets)[image_idx],
+                            entries->begin() + (*offsets)[image_idx + 1]);
+                }
+              },
+              ThreadPool::Schedule::DYNAMIC);
+}
+
+}  // namespace
 
 void Model::Read(const std::string& path, const std::string& format) {
   auto format_lower_case = format;
@@ -216,24 +313,49 @@ std::vector<std::pair<float, float>> Model::ComputeDepthRanges() const {
 }
 
 std::vector<std::map<int, int>> Model::ComputeSharedPoints() const {
+  // The entries of an image are the other images of its pairs, such that the
+  // number of shared points is the length of the runs of equal entries.
+  std::vector<size_t> offsets;
+  std::vector<int> other_image_idxs;
+  GroupImagePairs(
+      points, images.size(),
+      [](const Point&, const int image_idx1, const int image_idx2,
+         int* entry1, int* entry2) {
+        *entry1 = image_idx2;
+        *entry2 = image_idx1;
+      },
+      &offsets, &other_image_idxs);
+
   std::vector<std::map<int, int>> shared_points(images.size());
-  for (const auto& point : points) {
-    for (size_t i = 0; i < point.track.size(); ++i) {
-      const int image_idx1 = point.track[i];
-      for (size_t j = 0; j < i; ++j) {
-        const int image_idx2 = point.track[j];
-        if (image_idx1 != image_idx2) {
-          shared_points.at(image_idx1)[image_idx2] += 1;
-          shared_points.at(image_idx2)[image_idx1] += 1;
-        }
-      }
-    }
-  }
+  ParallelFor(ThreadPool::kMaxNumThreads, 0, images.size(),
+              [&](const size_t begin, const size_t end) {
+                for (size_t image_idx = begin; image_idx < end; ++image_idx) {
+                  auto& image_shared_points = shared_points[image_idx];
+                  size_t run_begin = offsets[image_idx];
+                  while (run_begin < offsets[image_idx + 1]) {
+                    const int other_image_idx = other_image_idxs[run_begin];
+                    size_t run_end = run_begin + 1;
+                    while (run_end < offsets[image_idx + 1] &&
+                           other_image_idxs[run_end] == other_image_idx) {
+                      run_end += 1;
+                    }
+                    image_shared_points.emplace_hint(
+                        image_shared_points.end(), other_image_idx,
+                        static_cast<int>(run_end - run_begin));
+                    run_begin = run_end;
+                  }
+                }
+              },
+              ThreadPool::Schedule::DYNAMIC);
+
   return shared_points;
 }
 
 std::vector<std::map<int, float>> Model::ComputeTriangulationAngles(
     const float percentile) const {
+  CHECK_GE(percentile, 0);
+  CHECK_LE(percentile, 100);
+
   std::vector<Eigen::Vector3d> proj_centers(images.size());
   for (size_t image_idx = 0; image_idx < images.size(); ++image_idx) {
     const auto& image = images[image_idx];
@@ -242,33 +364,51 @@ std::vector<std::map<int, float>> Model::ComputeTriangulationAngles(
     proj_centers[image_idx] = C.cast<double>();
   }
 
-  std::vector<std::map<int, std::vector<float>>> all_triangulation_angles(
-      images.size());
-  for (const auto& point : points) {
-    for (size_t i = 0; i < point.track.size(); ++i) {
-      const int image_idx1 = point.track[i];
-      for (size_t j = 0; j < i; ++j) {
-        const int image_idx2 = point.track[j];
-        if (image_idx1 != image_idx2) {
-          const float angle = CalculateTriangulationAngle(
-              proj_centers.at(image_idx1), proj_centers.at(image_idx2),
-              Eigen::Vector3d(point.x, point.y, point.z));
-          all_triangulation_angles.at(image_idx1)[image_idx2].push_back(angle);
-          all_triangulation_angles.at(image_idx2)[image_idx1].push_back(angle);
-        }
-      }
-    }
-  }
-
+  // The entries of an image are the other images of its pairs and the
+  // triangulation angles, such that the angles of an image pair are a sorted
+  // run of entries.
+  std::vector<size_t> offsets;
+  std::vector<std::pair<int, float>> angles;
+  GroupImagePairs(
+      points, images.size(),
+      [&](const Point& point, const int image_idx1, const int image_idx2,
+          std::pair<int, float>* entry1, std::pair<int, float>* entry2) {
+        const float angle = CalculateTriangulationAngle(
+            proj_centers.at(image_idx1), proj_centers.at(image_idx2),
+            Eigen::Vector3d(point.x, point.y, point.z));
+        *entry1 = std::make_pair(image_idx2, angle);
+        *entry2 = std::make_pair(image_idx1, angle);
+      },
+      &offsets, &angles);
+
+  // Select the percentile of the sorted angles as in `Percentile`.
   std::vector<std::map<int, float>> triangulation_angles(images.size());
-  for (size_t image_idx = 0; image_idx < all_triangulation_angles.size();
-       ++image_idx) {
-    const auto& overlapping_images = all_triangulation_angles[image_idx];
-    for (const auto& image : overlapping_images) {
-      triangulation_angles[image_idx].emplace(
-          image.first, Percentile(image.second, percentile));
-    }
-  }
+  ParallelFor(
+      ThreadPool::kMaxNumThreads, 0, images.size(),
+      [&](const size_t begin, const size_t end) {
+        for (size_t image_idx = begin; image_idx < end; ++image_idx) {
+          auto& image_angles = triangulation_angles[image_idx];
+          size_t run_begin = offsets[image_idx];
+          while (run_begin < offsets[image_idx + 1]) {
+            const int other_image_idx = angles[run_begin].first;
+            size_t run_end = run_begin + 1;
+            while (run_end < offsets[image_idx + 1] &&
+                   angles[run_end].first == other_image_idx) {
+              run_end += 1;
+            }
+            const size_t num_angles = run_end - run_begin;
+            const size_t percentile_idx = static_cast<size_t>(
+                std::round(static_cast<double>(percentile) / 100 *
+                           (num_angles - 1)));
+            image_angles.emplace_hint(
+                image_angles.end(), other_image_idx,
+                angles[run_begin + std::min(percentile_idx, num_angles - 1)]
+                    .second);
+            run_begin = run_end;
+          }
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC);
 
   return triangulation_angles;
 }
@@ -0,0 +1,140 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "mvs/model_test"
+#include "util/testing.h"
+
+#include "base/triangulation.h"
+#include "mvs/model.h"
+#include "util/math.h"
+#include "util/random.h"
+
+using namespace colmap;
+using namespace colmap::mvs;
+
+namespace {
+
+Model CreateModel(const int num_images, const int num_points) {
+  Model model;
+  const float K[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  for (int image_idx = 0; image_idx < num_images; ++image_idx) {
+    const float T[3] = {static_cast<float>(image_idx), 0, 0};
+    model.images.emplace_back("", 1, 1, K, R, T);
+  }
+
+  SetPRNGSeed(0);
+  model.points.resize(num_points);
+  for (auto& point : model.points) {
+    point.x = RandomReal<float>(-1, 1);
+    point.y = RandomReal<float>(-1, 1);
+    point.z = RandomReal<float>(1, 10);
+    const int track_length = RandomInteger(1, 6);
+    for (int i = 0; i < track_length; ++i) {
+      // Tracks may contain the same image multiple times.
+      point.track.push_back(RandomInteger(0, num_images - 1));
+    }
+  }
+
+  return model;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestComputeSharedPoints) {
+  Model model;
+  for (int i = 0; i < 4; ++i) {
+    model.images.emplace_back();
+  }
+  model.points.resize(3);
+  model.points[0].track = {0, 1, 2};
+  model.points[1].track = {1, 2, 1};
+  model.points[2].track = {3};
+
+  const auto shared_points = model.ComputeSharedPoints();
+  BOOST_CHECK_EQUAL(shared_points.size(), 4);
+  BOOST_CHECK_EQUAL(shared_points[0].size(), 2);
+  BOOST_CHECK_EQUAL(shared_points[0].at(1), 1);
+  BOOST_CHECK_EQUAL(shared_points[0].at(2), 1);
+  BOOST_CHECK_EQUAL(shared_points[1].size(), 2);
+  BOOST_CHECK_EQUAL(shared_points[1].at(0), 1);
+  BOOST_CHECK_EQUAL(shared_points[1].at(2), 3);
+  BOOST_CHECK_EQUAL(shared_points[2].size(), 2);
+  BOOST_CHECK_EQUAL(shared_points[2].at(0), 1);
+  BOOST_CHECK_EQUAL(shared_points[2].at(1), 3);
+  BOOST_CHECK(shared_points[3].empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestComputeSharedPointsAndAngles) {
+  const Model model = CreateModel(20, 50000);
+
+  std::vector<Eigen::Vector3d> proj_centers;
+  for (const auto& image : model.images) {
+    proj_centers.emplace_back(-image.GetT()[0], 0, 0);
+  }
+
+  std::vector<std::map<int, int>> ref_shared_points(model.images.size());
+  std::vector<std::map<int, std::vector<float>>> ref_angles(
+      model.images.size());
+  for (const auto& point : model.points) {
+    for (size_t i = 0; i < point.track.size(); ++i) {
+      const int image_idx1 = point.track[i];
+      for (size_t j = 0; j < i; ++j) {
+        const int image_idx2 = point.track[j];
+        if (image_idx1 != image_idx2) {
+          ref_shared_points[image_idx1][image_idx2] += 1;
+          ref_shared_points[image_idx2][image_idx1] += 1;
+          const float angle = CalculateTriangulationAngle(
+              proj_centers[image_idx1], proj_centers[image_idx2],
+              Eigen::Vector3d(point.x, point.y, point.z));
+          ref_angles[image_idx1][image_idx2].push_back(angle);
+          ref_angles[image_idx2][image_idx1].push_back(angle);
+        }
+      }
+    }
+  }
+
+  const auto shared_points = model.ComputeSharedPoints();
+  BOOST_CHECK(shared_points == ref_shared_points);
+
+  for (const float percentile : {0.0f, 50.0f, 75.0f, 100.0f}) {
+    const auto angles = model.ComputeTriangulationAngles(percentile);
+    BOOST_CHECK_EQUAL(angles.size(), model.images.size());
+    for (size_t image_idx = 0; image_idx < angles.size(); ++image_idx) {
+      BOOST_CHECK_EQUAL(angles[image_idx].size(),
+                        ref_angles[image_idx].size());
+      for (const auto& image_angles : ref_angles[image_idx]) {
+        BOOST_CHECK_EQUAL(angles[image_idx].at(image_angles.first),
+                          Percentile(image_angles.second, percentile));
+      }
+    }
+  }
+}
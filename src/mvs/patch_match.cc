@@ -31,19 +31,255 @@
 
 #include "mvs/patch_match.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <fstream>
 #include <numeric>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
+#include <boost/filesystem.hpp>
+
+#include "base/warp.h"
 #include "mvs/consistency_graph.h"
 #include "mvs/patch_match_cuda.h"
 #include "mvs/workspace.h"
 #include "util/math.h"
+#include "util/metrics.h"
 #include "util/misc.h"
+#include "util/trace.h"
 
 #define PrintOption(option) std::cout << #option ": " << option << std::endl
 
 namespace colmap {
 namespace mvs {
+namespace {
+
+// Resize a depth or normal map of a pyramid level to the exact resolution of
+// another level, by smoothing and resampling for downsampling and bilinear
+// interpolation for upsampling.
+void ResizeMap(const Mat<float>& map, const size_t width, const size_t height,
+               Mat<float>* resized_map) {
+  const size_t slice_size = map.GetWidth() * map.GetHeight();
+  const size_t resized_slice_size = width * height;
+  for (size_t d = 0; d < map.GetDepth(); ++d) {
+    if (width <= map.GetWidth() && height <= map.GetHeight()) {
+      DownsampleImage(map.GetPtr() + d * slice_size, map.GetHeight(),
+                      map.GetWidth(), height, width,
+                      resized_map->GetPtr() + d * resized_slice_size);
+    } else {
+      ResampleImageBilinear(map.GetPtr() + d * slice_size, map.GetHeight(),
+                            map.GetWidth(), height, width,
+                            resized_map->GetPtr() + d * resized_slice_size);
+    }
+  }
+}
+
+DepthMap ResizeDepthMap(const DepthMap& depth_map, const size_t width,
+                        const size_t height) {
+  DepthMap resized_depth_map(width, height, depth_map.GetDepthMin(),
+                             depth_map.GetDepthMax());
+  ResizeMap(depth_map, width, height, &resized_depth_map);
+  return resized_depth_map;
+}
+
+NormalMap ResizeNormalMap(const NormalMap& normal_map, const size_t width,
+                          const size_t height) {
+  NormalMap resized_normal_map(width, height);
+  ResizeMap(normal_map, width, height, &resized_normal_map);
+
+  // Re-normalize the interpolated normal vectors.
+  for (size_t r = 0; r < height; ++r) {
+    for (size_t c = 0; c < width; ++c) {
+      Eigen::Vector3f normal(resized_normal_map.Get(r, c, 0),
+                             resized_normal_map.Get(r, c, 1),
+                             resized_normal_map.Get(r, c, 2));
+      const float squared_norm = normal.squaredNorm();
+      if (squared_norm > 0) {
+        normal /= std::sqrt(squared_norm);
+      }
+      resized_normal_map.Set(r, c, 0, normal(0));
+      resized_normal_map.Set(r, c, 1, normal(1));
+      resized_normal_map.Set(r, c, 2, normal(2));
+    }
+  }
+
+  return resized_normal_map;
+}
+
+// A rectangular region of an image in pixels.
+struct ImageRegion {
+  size_t x = 0;
+  size_t y = 0;
+  size_t width = 0;
+  size_t height = 0;
+};
+
+// Crop the image to the region, where the principal point is shifted such
+// that the pixels of the cropped image keep their viewing rays.
+Image CropImage(const Image& image, const ImageRegion& region) {
+  float K[9];
+  memcpy(K, image.GetK(), 9 * sizeof(float));
+  K[2] -= region.x;
+  K[5] -= region.y;
+  Image cropped_image(image.GetPath(), region.width, region.height, K,
+                      image.GetR(), image.GetT());
+
+  const Bitmap& bitmap = image.GetBitmap();
+  Bitmap cropped_bitmap;
+  CHECK(cropped_bitmap.Allocate(region.width, region.height, bitmap.IsRGB()));
+  const size_t num_channels = bitmap.Channels();
+  for (size_t r = 0; r < region.height; ++r) {
+    memcpy(cropped_bitmap.GetScanline(r),
+           bitmap.GetScanline(region.y + r) + region.x * num_channels,
+           region.width * num_channels);
+  }
+  cropped_image.SetBitmap(cropped_bitmap);
+
+  return cropped_image;
+}
+
+template <typename T>
+void CropMap(const Mat<T>& map, const ImageRegion& region,
+             Mat<T>* cropped_map) {
+  for (size_t d = 0; d < map.GetDepth(); ++d) {
+    for (size_t r = 0; r < region.height; ++r) {
+      for (size_t c = 0; c < region.width; ++c) {
+        cropped_map->Set(r, c, d, map.Get(region.y + r, region.x + c, d));
+      }
+    }
+  }
+}
+
+DepthMap CropDepthMap(const DepthMap& depth_map, const ImageRegion& region) {
+  DepthMap cropped_depth_map(region.width, region.height,
+                             depth_map.GetDepthMin(), depth_map.GetDepthMax());
+  CropMap(depth_map, region, &cropped_depth_map);
+  return cropped_depth_map;
+}
+
+NormalMap CropNormalMap(const NormalMap& normal_map,
+                        const ImageRegion& region) {
+  NormalMap cropped_normal_map(region.width, region.height);
+  CropMap(normal_map, region, &cropped_normal_map);
+  return cropped_normal_map;
+}
+
+// The region of the source image that covers the viewing frustum of the
+// region of the reference image within the depth range, extended by the
+// margin. The frustum is the convex hull of the rays through the corners of
+// the region at the minimum and maximum depth, so its projection is bounded
+// by the projections of these eight points, if all are in front of the
+// source image. Otherwise, the whole source image is used.
+ImageRegion ComputeSourceRegion(const Image& ref_image,
+                                const ImageRegion& ref_region,
+                                const Image& src_image, const float depth_min,
+                                const float depth_max, const int margin) {
+  ImageRegion src_region;
+  src_region.width = src_image.GetWidth();
+  src_region.height = src_image.GetHeight();
+  if (depth_min <= 0 || depth_max <= 0) {
+    return src_region;
+  }
+
+  typedef Eigen::Matrix<float, 3, 3, Eigen::RowMajor> Matrix3fRowMajor;
+  const Matrix3fRowMajor ref_inv_K =
+      Eigen::Map<const Matrix3fRowMajor>(ref_image.GetK()).inverse();
+  const Eigen::Map<const Matrix3fRowMajor> ref_R(ref_image.GetR());
+  const Eigen::Map<const Eigen::Vector3f> ref_T(ref_image.GetT());
+  const Eigen::Map<const Matrix3fRowMajor> src_K(src_image.GetK());
+  const Eigen::Map<const Matrix3fRowMajor> src_R(src_image.GetR());
+  const Eigen::Map<const Eigen::Vector3f> src_T(src_image.GetT());
+
+  Eigen::Vector2f min_point(std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::max());
+  Eigen::Vector2f max_point(std::numeric_limits<float>::lowest(),
+                            std::numeric_limits<float>::lowest());
+  for (int i = 0; i < 8; ++i) {
+    const Eigen::Vector3f ref_point(
+        (i & 1) ? ref_region.x + ref_region.width : ref_region.x,
+        (i & 2) ? ref_region.y + ref_region.height : ref_region.y, 1.0f);
+    const float depth = (i & 4) ? depth_max : depth_min;
+    const Eigen::Vector3f world_point =
+        ref_R.transpose() * (depth * ref_inv_K * ref_point - ref_T);
+    const Eigen::Vector3f src_point = src_K * (src_R * world_point + src_T);
+    if (src_point.z() <= 0) {
+      return src_region;
+    }
+    min_point = min_point.cwiseMin(src_point.hnormalized());
+    max_point = max_point.cwiseMax(src_point.hnormalized());
+  }
+
+  // Clamp the region to the image, such that it contains at least one pixel,
+  // even if the frustum is not visible in the source image.
+  const auto ClampRange = [margin](const float min_value, const float max_value,
+                                   const size_t size, size_t* begin,
+                                   size_t* length) {
+    const float begin_value = std::floor(min_value) - margin;
+    const float end_value = std::ceil(max_value) + margin;
+    *begin = static_cast<size_t>(
+        std::min(std::max(begin_value, 0.0f), static_cast<float>(size - 1)));
+    const size_t end = static_cast<size_t>(std::min(
+        std::max(end_value, static_cast<float>(*begin + 1)),
+        static_cast<float>(size)));
+    *length = end - *begin;
+  };
+
+  ClampRange(min_point.x(), max_point.x(), src_image.GetWidth(), &src_region.x,
+             &src_region.width);
+  ClampRange(min_point.y(), max_point.y(), src_image.GetHeight(),
+             &src_region.y, &src_region.height);
+
+  return src_region;
+}
+
+// Stable 64-bit FNV-1a hash, which does not depend on the platform or build.
+uint64_t HashString(const std::string& str) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : str) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// Try to claim a file for exclusive processing among multiple processes that
+// share the file system. The lock file is atomically created as a hard link of
+// a uniquely named file, which fails if it already exists, also on network
+// file systems. Existing lock files older than the timeout are replaced.
+bool ClaimFile(const std::string& lock_path, const double timeout) {
+  namespace fs = boost::filesystem;
+
+  boost::system::error_code error;
+  if (fs::exists(lock_path, error)) {
+    const std::time_t lock_time = fs::last_write_time(lock_path, error);
+    if (error || std::difftime(std::time(nullptr), lock_time) < timeout) {
+      return false;
+    }
+    std::cout << StringPrintf("Retrying timed out claim %s", lock_path.c_str())
+              << std::endl;
+    fs::remove(lock_path, error);
+  }
+
+  const fs::path unique_path =
+      fs::unique_path(lock_path + ".%%%%-%%%%-%%%%-%%%%");
+  {
+    std::ofstream file(unique_path.string(), std::ios::trunc);
+    CHECK(file.is_open()) << unique_path.string();
+  }
+
+  fs::create_hard_link(unique_path, lock_path, error);
+  fs::remove(unique_path);
+
+  return !error;
+}
+
+}  // namespace
 
 PatchMatch::PatchMatch(const PatchMatchOptions& options, const Problem& problem)
     : options_(options), problem_(problem) {}
@@ -54,6 +290,11 @@ void PatchMatchOptions::Print() const {
   PrintHeading2("PatchMatchOptions");
   PrintOption(max_image_size);
   PrintOption(gpu_index);
+  PrintOption(num_problems_per_gpu);
+  PrintOption(tile_size);
+  PrintOption(tile_overlap);
+  PrintOption(half_precision);
+  PrintOption(kernel_config_path);
   PrintOption(depth_min);
   PrintOption(depth_max);
   PrintOption(window_radius);
@@ -65,15 +306,20 @@ void PatchMatchOptions::Print() const {
   PrintOption(min_triangulation_angle);
   PrintOption(incident_angle_sigma);
   PrintOption(num_iterations);
+  PrintOption(num_pyramid_levels);
+  PrintOption(pyramid_num_iterations);
   PrintOption(geom_consistency);
   PrintOption(geom_consistency_regularizer);
   PrintOption(geom_consistency_max_cost);
+  PrintOption(interleave_passes);
   PrintOption(filter);
   PrintOption(filter_min_ncc);
   PrintOption(filter_min_triangulation_angle);
   PrintOption(filter_min_num_consistent);
   PrintOption(filter_geom_consistency_max_cost);
   PrintOption(write_consistency_graph);
+  PrintOption(write_compressed_maps);
+  PrintOption(write_half_precision_maps);
 }
 
 void PatchMatch::Problem::Print() const {
@@ -96,9 +342,16 @@ void PatchMatch::Check() const {
   CHECK(options_.Check());
 
   CHECK(!options_.gpu_index.empty());
+  // Tiled problems process their tiles concurrently on multiple GPUs.
   const std::vector<int> gpu_indices = CSVToVector<int>(options_.gpu_index);
-  CHECK_EQ(gpu_indices.size(), 1);
-  CHECK_GE(gpu_indices[0], -1);
+  if (options_.tile_size > 0) {
+    CHECK_GE(gpu_indices.size(), 1);
+  } else {
+    CHECK_EQ(gpu_indices.size(), 1);
+  }
+  for (const int gpu_index : gpu_indices) {
+    CHECK_GE(gpu_index, -1);
+  }
 
   CHECK_NOTNULL(problem_.images);
   if (options_.geom_consistency) {
@@ -154,30 +407,277 @@ void PatchMatch::Check() const {
 }
 
 void PatchMatch::Run() {
+  const TraceSpan trace_span("patch_match/run");
+
   PrintHeading2("PatchMatch::Run");
 
   Check();
 
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+  if (options_.tile_size > 0 &&
+      (ref_image.GetWidth() > static_cast<size_t>(options_.tile_size) ||
+       ref_image.GetHeight() > static_cast<size_t>(options_.tile_size))) {
+    RunTiled();
+    return;
+  }
+
+  if (options_.num_pyramid_levels > 1) {
+    RunPyramid();
+    return;
+  }
+
   patch_match_cuda_.reset(new PatchMatchCuda(options_, problem_));
   patch_match_cuda_->Run();
 }
 
+void PatchMatch::RunPyramid() {
+  std::unordered_set<int> used_image_idxs(problem_.src_image_idxs.begin(),
+                                          problem_.src_image_idxs.end());
+  used_image_idxs.insert(problem_.ref_image_idx);
+
+  DepthMap init_depth_map;
+  NormalMap init_normal_map;
+
+  for (int level = options_.num_pyramid_levels - 1; level >= 0; --level) {
+    const bool coarsest_level = level == options_.num_pyramid_levels - 1;
+
+    std::cout << StringPrintf("Pyramid level %d / %d", level + 1,
+                              options_.num_pyramid_levels)
+              << std::endl;
+
+    // Only the used images of the problem are rescaled to the current level,
+    // while the finest level directly uses the input images.
+    std::vector<Image> level_images;
+    std::vector<DepthMap> level_depth_maps;
+    std::vector<NormalMap> level_normal_maps;
+    Problem level_problem = problem_;
+    if (level > 0) {
+      const float scale = 1.0f / (1 << level);
+      level_images = *problem_.images;
+      if (options_.geom_consistency) {
+        level_depth_maps.resize(problem_.depth_maps->size());
+        level_normal_maps.resize(problem_.normal_maps->size());
+      }
+      for (const int image_idx : used_image_idxs) {
+        level_images[image_idx].Rescale(scale);
+        if (options_.geom_consistency) {
+          const Image& level_image = level_images[image_idx];
+          level_depth_maps[image_idx] =
+              ResizeDepthMap(problem_.depth_maps->at(image_idx),
+                             level_image.GetWidth(), level_image.GetHeight());
+          level_normal_maps[image_idx] =
+              ResizeNormalMap(problem_.normal_maps->at(image_idx),
+                              level_image.GetWidth(), level_image.GetHeight());
+        }
+      }
+      level_problem.images = &level_images;
+      if (options_.geom_consistency) {
+        level_problem.depth_maps = &level_depth_maps;
+        level_problem.normal_maps = &level_normal_maps;
+      }
+    }
+
+    if (!coarsest_level) {
+      const Image& ref_image =
+          level_problem.images->at(level_problem.ref_image_idx);
+      init_depth_map = ResizeDepthMap(init_depth_map, ref_image.GetWidth(),
+                                      ref_image.GetHeight());
+      init_normal_map = ResizeNormalMap(init_normal_map, ref_image.GetWidth(),
+                                        ref_image.GetHeight());
+      level_problem.init_depth_map = &init_depth_map;
+      level_problem.init_normal_map = &init_normal_map;
+    }
+
+    // Filtering and the consistency graph only apply to the finest level,
+    // since the coarser levels merely initialize the next level.
+    PatchMatchOptions level_options = options_;
+    if (!coarsest_level) {
+      level_options.num_iterations = options_.pyramid_num_iterations;
+    }
+    if (level > 0) {
+      level_options.filter = false;
+    }
+
+    patch_match_cuda_.reset(new PatchMatchCuda(level_options, level_problem));
+    patch_match_cuda_->Run();
+
+    if (level > 0) {
+      init_depth_map = patch_match_cuda_->GetDepthMap();
+      init_normal_map = patch_match_cuda_->GetNormalMap();
+    }
+  }
+}
+
+void PatchMatch::RunTiled() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+  const size_t width = ref_image.GetWidth();
+  const size_t height = ref_image.GetHeight();
+  const size_t tile_size = static_cast<size_t>(options_.tile_size);
+  const size_t tile_overlap = static_cast<size_t>(options_.tile_overlap);
+  const size_t num_src_images = problem_.src_image_idxs.size();
+  const size_t num_mask_words = (num_src_images + 31) / 32;
+  const int src_margin = options_.window_radius * options_.window_step + 1;
+
+  std::vector<ImageRegion> tiles;
+  for (size_t y = 0; y < height; y += tile_size) {
+    for (size_t x = 0; x < width; x += tile_size) {
+      ImageRegion tile;
+      tile.x = x;
+      tile.y = y;
+      tile.width = std::min(tile_size, width - x);
+      tile.height = std::min(tile_size, height - y);
+      tiles.push_back(tile);
+    }
+  }
+
+  depth_map_ = DepthMap(width, height, options_.depth_min, options_.depth_max);
+  normal_map_ = NormalMap(width, height);
+  sel_prob_map_ = Mat<float>(width, height, num_src_images);
+  consistency_masks_.assign(width * height * num_mask_words, 0);
+
+  const std::vector<int> gpu_indices = CSVToVector<int>(options_.gpu_index);
+  ThreadPool thread_pool(gpu_indices.size());
+
+  auto ProcessTile = [&](const size_t tile_idx) {
+    const ImageRegion& tile = tiles[tile_idx];
+
+    std::cout << StringPrintf("Processing tile %d / %d", tile_idx + 1,
+                              tiles.size())
+              << std::endl;
+
+    // The tile extended by the overlap on each side.
+    ImageRegion region;
+    region.x = tile.x - std::min(tile.x, tile_overlap);
+    region.y = tile.y - std::min(tile.y, tile_overlap);
+    region.width =
+        std::min(width, tile.x + tile.width + tile_overlap) - region.x;
+    region.height =
+        std::min(height, tile.y + tile.height + tile_overlap) - region.y;
+
+    // The cropped reference image comes first, followed by the cropped source
+    // images in the order of the problem, which is the order of the source
+    // images in the outputs.
+    std::vector<Image> tile_images;
+    std::vector<DepthMap> tile_depth_maps;
+    std::vector<NormalMap> tile_normal_maps;
+    const auto AddTileImage = [&](const int image_idx,
+                                  const ImageRegion& image_region) {
+      tile_images.push_back(
+          CropImage(problem_.images->at(image_idx), image_region));
+      if (options_.geom_consistency) {
+        tile_depth_maps.push_back(
+            CropDepthMap(problem_.depth_maps->at(image_idx), image_region));
+        tile_normal_maps.push_back(
+            CropNormalMap(problem_.normal_maps->at(image_idx), image_region));
+      }
+    };
+
+    Problem tile_problem;
+    tile_problem.ref_image_idx = 0;
+    AddTileImage(problem_.ref_image_idx, region);
+    for (const int src_image_idx : problem_.src_image_idxs) {
+      tile_problem.src_image_idxs.push_back(tile_images.size());
+      AddTileImage(src_image_idx,
+                   ComputeSourceRegion(ref_image, region,
+                                       problem_.images->at(src_image_idx),
+                                       options_.depth_min, options_.depth_max,
+                                       src_margin));
+    }
+    tile_problem.images = &tile_images;
+    tile_problem.depth_maps = &tile_depth_maps;
+    tile_problem.normal_maps = &tile_normal_maps;
+
+    DepthMap init_depth_map;
+    NormalMap init_normal_map;
+    if (problem_.init_depth_map != nullptr) {
+      init_depth_map = CropDepthMap(*problem_.init_depth_map, region);
+      tile_problem.init_depth_map = &init_depth_map;
+    }
+    if (problem_.init_normal_map != nullptr) {
+      init_normal_map = CropNormalMap(*problem_.init_normal_map, region);
+      tile_problem.init_normal_map = &init_normal_map;
+    }
+
+    PatchMatchOptions tile_options = options_;
+    tile_options.tile_size = -1;
+    tile_options.gpu_index =
+        std::to_string(gpu_indices.at(thread_pool.GetThreadIndex()));
+
+    PatchMatch patch_match(tile_options, tile_problem);
+    patch_match.Run();
+
+    const DepthMap tile_depth_map = patch_match.GetDepthMap();
+    const NormalMap tile_normal_map = patch_match.GetNormalMap();
+    const Mat<float> tile_sel_prob_map = patch_match.GetSelProbMap();
+    const std::vector<uint32_t> tile_consistency_masks =
+        patch_match.patch_match_cuda_->GetConsistencyMasks();
+    CHECK_EQ(tile_consistency_masks.size(),
+             region.width * region.height * num_mask_words);
+
+    // Only the interior of the tile is stitched into the outputs, since the
+    // propagation at the borders of the extended tile lacks context.
+    for (size_t r = 0; r < tile.height; ++r) {
+      const size_t row = tile.y + r;
+      const size_t tile_row = row - region.y;
+      for (size_t c = 0; c < tile.width; ++c) {
+        const size_t col = tile.x + c;
+        const size_t tile_col = col - region.x;
+        depth_map_.Set(row, col, tile_depth_map.Get(tile_row, tile_col));
+        for (size_t d = 0; d < 3; ++d) {
+          normal_map_.Set(row, col, d,
+                          tile_normal_map.Get(tile_row, tile_col, d));
+        }
+        for (size_t d = 0; d < num_src_images; ++d) {
+          sel_prob_map_.Set(row, col, d,
+                            tile_sel_prob_map.Get(tile_row, tile_col, d));
+        }
+        std::copy_n(tile_consistency_masks.begin() +
+                        (tile_row * region.width + tile_col) * num_mask_words,
+                    num_mask_words,
+                    consistency_masks_.begin() +
+                        (row * width + col) * num_mask_words);
+      }
+    }
+  };
+
+  std::vector<std::future<void>> futures;
+  futures.reserve(tiles.size());
+  for (size_t tile_idx = 0; tile_idx < tiles.size(); ++tile_idx) {
+    futures.push_back(thread_pool.AddTask(ProcessTile, tile_idx));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
 DepthMap PatchMatch::GetDepthMap() const {
+  if (!patch_match_cuda_) {
+    return depth_map_;
+  }
   return patch_match_cuda_->GetDepthMap();
 }
 
 NormalMap PatchMatch::GetNormalMap() const {
+  if (!patch_match_cuda_) {
+    return normal_map_;
+  }
   return patch_match_cuda_->GetNormalMap();
 }
 
 Mat<float> PatchMatch::GetSelProbMap() const {
+  if (!patch_match_cuda_) {
+    return sel_prob_map_;
+  }
   return patch_match_cuda_->GetSelProbMap();
 }
 
 ConsistencyGraph PatchMatch::GetConsistencyGraph() const {
   const auto& ref_image = problem_.images->at(problem_.ref_image_idx);
   return ConsistencyGraph(ref_image.GetWidth(), ref_image.GetHeight(),
-                          patch_match_cuda_->GetConsistentImageIdxs());
+                          problem_.src_image_idxs,
+                          patch_match_cuda_
+                              ? patch_match_cuda_->GetConsistencyMasks()
+                              : consistency_masks_);
 }
 
 PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
@@ -194,9 +694,14 @@ PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
 void PatchMatchController::Run() {
   ReadWorkspace();
   ReadProblems();
+  OrderProblems();
   ReadGpuIndices();
+  ReadManifest();
 
   thread_pool_.reset(new ThreadPool(gpu_indices_.size()));
+  if (options_.num_prefetch_problems > 0) {
+    prefetch_thread_pool_.reset(new ThreadPool(gpu_indices_.size()));
+  }
 
   // If geometric consistency is enabled, then photometric output must be
   // computed first for all images without filtering.
@@ -205,23 +710,153 @@ void PatchMatchController::Run() {
     photometric_options.geom_consistency = false;
     photometric_options.filter = false;
 
+    if (options_.interleave_passes) {
+      ProcessProblemsInterleaved(photometric_options, options_);
+    } else {
+      ProcessProblems(photometric_options);
+
+      // The geometric pass additionally requires the depth and normal maps.
+      prefetched_image_idxs_.clear();
+
+      ProcessProblems(options_);
+    }
+  } else {
+    ProcessProblems(options_);
+  }
+
+  GetTimer().PrintMinutes();
+}
+
+void PatchMatchController::ProcessProblems(const PatchMatchOptions& options) {
+  GetMetricGauge("patch_match_num_problems", "Number of problems per pass")
+      .Set(problems_.size());
+
+  while (true) {
     for (size_t problem_idx = 0; problem_idx < problems_.size();
          ++problem_idx) {
       thread_pool_->AddTask(&PatchMatchController::ProcessProblem, this,
-                            photometric_options, problem_idx);
+                            options, problem_idx);
     }
 
     thread_pool_->Wait();
+    if (prefetch_thread_pool_) {
+      prefetch_thread_pool_->Wait();
+    }
+
+    if (!options.distributed || IsStopped()) {
+      break;
+    }
+
+    // Get the problems finished by the other processes in the meantime.
+    ReadManifest();
+
+    size_t num_unfinished_problems = 0;
+    for (size_t problem_idx = 0; problem_idx < problems_.size();
+         ++problem_idx) {
+      if (!HasOutputs(options, problem_idx)) {
+        num_unfinished_problems += 1;
+      }
+    }
+
+    if (num_unfinished_problems == 0) {
+      break;
+    }
+
+    // Poll until the other processes finished their claimed problems or
+    // their claims timed out, after which they are retried in this process.
+    std::cout << "Waiting for " << num_unfinished_problems
+              << " problems claimed by other processes..." << std::endl;
+    const int kPollIntervalSeconds = 10;
+    std::this_thread::sleep_for(std::chrono::seconds(kPollIntervalSeconds));
+  }
+}
+
+void PatchMatchController::ProcessProblemsInterleaved(
+    const PatchMatchOptions& photometric_options,
+    const PatchMatchOptions& geometric_options) {
+  GetMetricGauge("patch_match_num_problems", "Number of problems per pass")
+      .Set(problems_.size());
+
+  // The number of photometric problems of each reference image and the
+  // geometric problems that use its photometric outputs.
+  std::unordered_map<int, size_t> num_pending_photometric_problems;
+  std::unordered_map<int, std::vector<size_t>> dependent_problem_idxs;
+  for (const auto& problem : problems_) {
+    num_pending_photometric_problems[problem.ref_image_idx] += 1;
   }
 
+  // The number of images of each geometric problem, whose photometric outputs
+  // are not yet computed.
+  std::vector<size_t> num_pending_inputs(problems_.size(), 0);
   for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
-    thread_pool_->AddTask(&PatchMatchController::ProcessProblem, this, options_,
-                          problem_idx);
+    const auto& problem = problems_[problem_idx];
+    std::vector<int> image_idxs = problem.src_image_idxs;
+    image_idxs.push_back(problem.ref_image_idx);
+    for (const int image_idx : image_idxs) {
+      if (num_pending_photometric_problems.count(image_idx)) {
+        dependent_problem_idxs[image_idx].push_back(problem_idx);
+        num_pending_inputs[problem_idx] += 1;
+      }
+    }
   }
 
-  thread_pool_->Wait();
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::queue<size_t> ready_problem_idxs;
+  size_t next_photometric_problem_idx = 0;
+  size_t num_running_photometric_problems = 0;
+
+  // Each thread prefers the ready geometric problems, so that the photometric
+  // outputs are consumed while they are cached, and otherwise processes the
+  // next photometric problem. Threads only wait, if neither is available but
+  // photometric problems are still running in other threads.
+  const auto ProcessNextProblems = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!IsStopped()) {
+      if (!ready_problem_idxs.empty()) {
+        const size_t problem_idx = ready_problem_idxs.front();
+        ready_problem_idxs.pop();
+        lock.unlock();
+        ProcessProblem(geometric_options, problem_idx);
+        lock.lock();
+      } else if (next_photometric_problem_idx < problems_.size()) {
+        const size_t problem_idx = next_photometric_problem_idx;
+        next_photometric_problem_idx += 1;
+        num_running_photometric_problems += 1;
+        lock.unlock();
+        ProcessProblem(photometric_options, problem_idx);
+        lock.lock();
+        num_running_photometric_problems -= 1;
+
+        const int image_idx = problems_[problem_idx].ref_image_idx;
+        num_pending_photometric_problems[image_idx] -= 1;
+        if (num_pending_photometric_problems[image_idx] == 0) {
+          for (const size_t dependent_problem_idx :
+               dependent_problem_idxs[image_idx]) {
+            num_pending_inputs[dependent_problem_idx] -= 1;
+            if (num_pending_inputs[dependent_problem_idx] == 0) {
+              ready_problem_idxs.push(dependent_problem_idx);
+            }
+          }
+        }
+        condition.notify_all();
+      } else if (num_running_photometric_problems > 0) {
+        condition.wait(lock);
+      } else {
+        break;
+      }
+    }
+  };
 
-  GetTimer().PrintMinutes();
+  for (size_t thread_idx = 0; thread_idx < gpu_indices_.size();
+       ++thread_idx) {
+    thread_pool_->AddTask(ProcessNextProblems);
+  }
+
+  thread_pool_->Wait();
+  if (prefetch_thread_pool_) {
+    prefetch_thread_pool_->Wait();
+  }
 }
 
 void PatchMatchController::ReadWorkspace() {
@@ -392,6 +1027,72 @@ void PatchMatchController::ReadProblems() {
             << std::endl;
 }
 
+void PatchMatchController::OrderProblems() {
+  // The problems are traversed in depth-first order in the graph, in which
+  // each problem is connected to the problems of its source images. Since the
+  // source images are the most overlapping images, the successive problems,
+  // which are processed concurrently by the GPUs and read their images through
+  // the same cache, are spatially close and largely share their images.
+
+  std::unordered_map<int, size_t> ref_image_idx_to_problem_idx;
+  for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
+    ref_image_idx_to_problem_idx.emplace(problems_[problem_idx].ref_image_idx,
+                                         problem_idx);
+  }
+
+  std::vector<char> visited(problems_.size(), false);
+  std::vector<size_t> ordered_problem_idxs;
+  ordered_problem_idxs.reserve(problems_.size());
+
+  // The stack holds the visited problems that might have unvisited neighbors,
+  // together with the index of their next source image to check.
+  std::vector<std::pair<size_t, size_t>> stack;
+
+  for (size_t start_problem_idx = 0; start_problem_idx < problems_.size();
+       ++start_problem_idx) {
+    if (visited[start_problem_idx]) {
+      continue;
+    }
+
+    visited[start_problem_idx] = true;
+    ordered_problem_idxs.push_back(start_problem_idx);
+    stack.emplace_back(start_problem_idx, 0);
+
+    while (!stack.empty()) {
+      const auto& src_image_idxs =
+          problems_[stack.back().first].src_image_idxs;
+      size_t& src_idx = stack.back().second;
+
+      // The source images are ranked by their overlap in auto configurations,
+      // so that the most overlapping unvisited problem is visited next.
+      bool found_next_problem = false;
+      while (src_idx < src_image_idxs.size()) {
+        const auto it =
+            ref_image_idx_to_problem_idx.find(src_image_idxs[src_idx]);
+        src_idx += 1;
+        if (it != ref_image_idx_to_problem_idx.end() && !visited[it->second]) {
+          visited[it->second] = true;
+          ordered_problem_idxs.push_back(it->second);
+          stack.emplace_back(it->second, 0);
+          found_next_problem = true;
+          break;
+        }
+      }
+
+      if (!found_next_problem) {
+        stack.pop_back();
+      }
+    }
+  }
+
+  std::vector<PatchMatch::Problem> ordered_problems;
+  ordered_problems.reserve(problems_.size());
+  for (const size_t problem_idx : ordered_problem_idxs) {
+    ordered_problems.push_back(problems_[problem_idx]);
+  }
+  problems_ = std::move(ordered_problems);
+}
+
 void PatchMatchController::ReadGpuIndices() {
   gpu_indices_ = CSVToVector<int>(options_.gpu_index);
   if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
@@ -400,6 +1101,16 @@ void PatchMatchController::ReadGpuIndices() {
     gpu_indices_.resize(num_cuda_devices);
     std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
   }
+
+  // Each GPU index corresponds to a thread that processes one problem at a
+  // time, so that the concurrent problems per GPU run in separate threads.
+  std::vector<int> gpu_indices;
+  gpu_indices.reserve(gpu_indices_.size() * options_.num_problems_per_gpu);
+  for (int i = 0; i < options_.num_problems_per_gpu; ++i) {
+    gpu_indices.insert(gpu_indices.end(), gpu_indices_.begin(),
+                       gpu_indices_.end());
+  }
+  gpu_indices_ = gpu_indices;
 }
 
 void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
@@ -408,31 +1119,55 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
     return;
   }
 
+  PrefetchProblems(options, problem_idx);
+
   const auto& model = workspace_->GetModel();
 
   auto& problem = problems_.at(problem_idx);
   const int gpu_index = gpu_indices_.at(thread_pool_->GetThreadIndex());
   CHECK_GE(gpu_index, -1);
 
-  const std::string& stereo_folder = workspace_->GetOptions().stereo_folder;
   const std::string output_type =
       options.geom_consistency ? "geometric" : "photometric";
   const std::string image_name = model.GetImageName(problem.ref_image_idx);
-  const std::string file_name =
-      StringPrintf("%s.%s.bin", image_name.c_str(), output_type.c_str());
-  const std::string depth_map_path =
-      JoinPaths(workspace_path_, stereo_folder, "depth_maps", file_name);
-  const std::string normal_map_path =
-      JoinPaths(workspace_path_, stereo_folder, "normal_maps", file_name);
-  const std::string consistency_graph_path = JoinPaths(
-      workspace_path_, stereo_folder, "consistency_graphs", file_name);
+  std::string depth_map_path;
+  std::string normal_map_path;
+  std::string consistency_graph_path;
+  GetOutputPaths(options, problem_idx, &depth_map_path, &normal_map_path,
+                 &consistency_graph_path);
 
-  if (ExistsFile(depth_map_path) && ExistsFile(normal_map_path) &&
-      (!options.write_consistency_graph ||
-       ExistsFile(consistency_graph_path))) {
+  if (HasOutputs(options, problem_idx)) {
     return;
   }
 
+  const std::string lock_path = depth_map_path + ".lock";
+  if (options.distributed) {
+    if (!ClaimFile(lock_path, options.distributed_claim_timeout)) {
+      return;
+    }
+    // Another process might have finished the problem before the claim.
+    if (HasOutputs(options, problem_idx)) {
+      boost::filesystem::remove(lock_path);
+      return;
+    }
+  }
+
+  // Computed before processing, so that it reflects the used inputs.
+  const std::string problem_hash = ComputeProblemHash(options, problem_idx);
+
+  static MetricGauge& num_active_workers = GetMetricGauge(
+      "patch_match_active_workers",
+      "Number of GPU or CPU workers currently processing a problem");
+  static MetricCounter& num_processed_problems =
+      GetMetricCounter("patch_match_processed_problems_total",
+                       "Number of problems processed in this process");
+  static MetricHistogram& problem_time = GetMetricHistogram(
+      "patch_match_problem_seconds", "Time spent per problem",
+      GetDefaultDurationBuckets());
+  num_active_workers.Add(1);
+  Timer problem_timer;
+  problem_timer.Start();
+
   PrintHeading1(StringPrintf("Processing view %d / %d", problem_idx + 1,
                              problems_.size()));
 
@@ -451,6 +1186,12 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
 
   patch_match_options.gpu_index = std::to_string(gpu_index);
 
+  if (patch_match_options.kernel_config_path.empty()) {
+    patch_match_options.kernel_config_path =
+        JoinPaths(workspace_path_, workspace_->GetOptions().stereo_folder,
+                  "patch-match-kernels.txt");
+  }
+
   if (patch_match_options.sigma_spatial <= 0.0f) {
     patch_match_options.sigma_spatial = patch_match_options.window_radius;
   }
@@ -482,6 +1223,7 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
     std::unique_lock<std::mutex> lock(workspace_mutex_);
 
     std::cout << "Reading inputs..." << std::endl;
+    const TraceSpan trace_span("patch_match/read");
     for (const auto image_idx : used_image_idxs) {
       images.at(image_idx).SetBitmap(workspace_->GetBitmap(image_idx));
       if (options.geom_consistency) {
@@ -502,10 +1244,249 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
                             image_name.c_str())
             << std::endl;
 
-  patch_match.GetDepthMap().Write(depth_map_path);
-  patch_match.GetNormalMap().Write(normal_map_path);
-  if (options.write_consistency_graph) {
-    patch_match.GetConsistencyGraph().Write(consistency_graph_path);
+  DepthMap depth_map = patch_match.GetDepthMap();
+  NormalMap normal_map = patch_match.GetNormalMap();
+
+  {
+    const TraceSpan trace_span("patch_match/write");
+    if (options.write_compressed_maps) {
+      depth_map.WriteCompressed(depth_map_path,
+                                options.write_half_precision_maps);
+      normal_map.WriteCompressed(normal_map_path,
+                                 options.write_half_precision_maps);
+    } else {
+      depth_map.Write(depth_map_path);
+      normal_map.Write(normal_map_path);
+    }
+    if (options.write_consistency_graph) {
+      patch_match.GetConsistencyGraph().Write(consistency_graph_path);
+    }
+  }
+
+  // The photometric outputs are the inputs of the geometric pass, which then
+  // reads them from the cache instead of from disk. Quantized outputs are read
+  // from disk, so that the geometric pass uses the same inputs in any case.
+  if (options_.geom_consistency && !options.geom_consistency &&
+      !options.write_half_precision_maps) {
+    std::unique_lock<std::mutex> lock(workspace_mutex_);
+    workspace_->CacheMaps(problem.ref_image_idx, std::move(depth_map),
+                          std::move(normal_map));
+  }
+
+  WriteManifestEntry(GetOutputFileName(options, problem_idx), problem_hash);
+
+  num_active_workers.Add(-1);
+  num_processed_problems.Increment();
+  problem_time.Observe(problem_timer.ElapsedSeconds());
+
+  if (options.distributed) {
+    boost::filesystem::remove(lock_path);
+  }
+}
+
+std::string PatchMatchController::GetOutputFileName(
+    const PatchMatchOptions& options, const size_t problem_idx) const {
+  const std::string output_type =
+      options.geom_consistency ? "geometric" : "photometric";
+  const std::string image_name = workspace_->GetModel().GetImageName(
+      problems_.at(problem_idx).ref_image_idx);
+  return StringPrintf("%s.%s.bin", image_name.c_str(), output_type.c_str());
+}
+
+void PatchMatchController::GetOutputPaths(
+    const PatchMatchOptions& options, const size_t problem_idx,
+    std::string* depth_map_path, std::string* normal_map_path,
+    std::string* consistency_graph_path) const {
+  const std::string& stereo_folder = workspace_->GetOptions().stereo_folder;
+  const std::string file_name = GetOutputFileName(options, problem_idx);
+  *depth_map_path =
+      JoinPaths(workspace_path_, stereo_folder, "depth_maps", file_name);
+  *normal_map_path =
+      JoinPaths(workspace_path_, stereo_folder, "normal_maps", file_name);
+  *consistency_graph_path = JoinPaths(workspace_path_, stereo_folder,
+                                      "consistency_graphs", file_name);
+}
+
+bool PatchMatchController::HasOutputs(const PatchMatchOptions& options,
+                                      const size_t problem_idx) {
+  std::string depth_map_path;
+  std::string normal_map_path;
+  std::string consistency_graph_path;
+  GetOutputPaths(options, problem_idx, &depth_map_path, &normal_map_path,
+                 &consistency_graph_path);
+  if (!ExistsFile(depth_map_path) || !ExistsFile(normal_map_path) ||
+      (options.write_consistency_graph &&
+       !ExistsFile(consistency_graph_path))) {
+    return false;
+  }
+
+  const std::string file_name = GetOutputFileName(options, problem_idx);
+  const std::string hash = ComputeProblemHash(options, problem_idx);
+  const std::string manifest_hash =
+      ReadManifestEntry(file_name, options.distributed);
+  if (manifest_hash.empty() && adopt_existing_outputs_) {
+    WriteManifestEntry(file_name, hash);
+    return true;
+  }
+
+  return manifest_hash == hash;
+}
+
+std::string PatchMatchController::GetManifestPath() const {
+  return JoinPaths(workspace_path_, workspace_->GetOptions().stereo_folder,
+                   "patch-match-manifest.txt");
+}
+
+void PatchMatchController::ReadManifest() {
+  std::unique_lock<std::mutex> lock(manifest_mutex_);
+
+  const std::string manifest_path = GetManifestPath();
+  if (!ExistsFile(manifest_path)) {
+    // Only adopt the outputs of runs that did not write a manifest, so that
+    // partial outputs of failed runs with a manifest are recomputed.
+    adopt_existing_outputs_ = true;
+    return;
+  }
+
+  // Every line contains the hash and the file name of a finished problem.
+  // Later lines replace the earlier lines of the same file name.
+  for (const auto& line : ReadTextFileLines(manifest_path)) {
+    const size_t split_pos = line.find(' ');
+    if (split_pos == std::string::npos) {
+      continue;
+    }
+    manifest_[line.substr(split_pos + 1)] = line.substr(0, split_pos);
+  }
+}
+
+std::string PatchMatchController::ReadManifestEntry(
+    const std::string& file_name, const bool reload) {
+  {
+    std::unique_lock<std::mutex> lock(manifest_mutex_);
+    const auto it = manifest_.find(file_name);
+    if (it != manifest_.end()) {
+      return it->second;
+    }
+  }
+
+  if (!reload) {
+    return "";
+  }
+
+  // The entry might have been written by another process.
+  ReadManifest();
+
+  std::unique_lock<std::mutex> lock(manifest_mutex_);
+  const auto it = manifest_.find(file_name);
+  if (it != manifest_.end()) {
+    return it->second;
+  }
+  return "";
+}
+
+void PatchMatchController::WriteManifestEntry(const std::string& file_name,
+                                              const std::string& hash) {
+  std::unique_lock<std::mutex> lock(manifest_mutex_);
+  manifest_[file_name] = hash;
+  std::ofstream file(GetManifestPath(), std::ios::app);
+  CHECK(file.is_open()) << GetManifestPath();
+  file << hash << " " << file_name << std::endl;
+}
+
+std::string PatchMatchController::ComputeProblemHash(
+    const PatchMatchOptions& options, const size_t problem_idx) {
+  const auto& model = workspace_->GetModel();
+  const auto& problem = problems_.at(problem_idx);
+
+  std::ostringstream stream;
+  stream.precision(9);
+
+  // The images of the problem are identified by their names and cameras.
+  std::vector<int> image_idxs;
+  image_idxs.push_back(problem.ref_image_idx);
+  image_idxs.insert(image_idxs.end(), problem.src_image_idxs.begin(),
+                    problem.src_image_idxs.end());
+  for (const int image_idx : image_idxs) {
+    const Image& image = model.images.at(image_idx);
+    stream << model.GetImageName(image_idx) << ";" << image.GetWidth() << ";"
+           << image.GetHeight() << ";";
+    for (int i = 0; i < 9; ++i) {
+      stream << image.GetK()[i] << ";";
+    }
+    for (int i = 0; i < 9; ++i) {
+      stream << image.GetR()[i] << ";";
+    }
+    for (int i = 0; i < 3; ++i) {
+      stream << image.GetT()[i] << ";";
+    }
+    // The geometric output additionally depends on the photometric outputs
+    // of all its images, which are identified by their manifest hashes.
+    if (options.geom_consistency) {
+      stream << ReadManifestEntry(
+                    StringPrintf("%s.photometric.bin",
+                                 model.GetImageName(image_idx).c_str()),
+                    false)
+             << ";";
+    }
+  }
+
+  // The depth range, which is computed from the model if not specified.
+  stream << depth_ranges_.at(problem.ref_image_idx).first << ";"
+         << depth_ranges_.at(problem.ref_image_idx).second << ";";
+
+  // The options that affect the outputs.
+  stream << options.max_image_size << ";" << options.depth_min << ";"
+         << options.depth_max << ";" << options.window_radius << ";"
+         << options.window_step << ";" << options.sigma_spatial << ";"
+         << options.sigma_color << ";" << options.num_samples << ";"
+         << options.ncc_sigma << ";" << options.min_triangulation_angle << ";"
+         << options.incident_angle_sigma << ";" << options.num_iterations
+         << ";" << options.num_pyramid_levels << ";"
+         << options.pyramid_num_iterations << ";" << options.geom_consistency
+         << ";" << options.geom_consistency_regularizer << ";"
+         << options.geom_consistency_max_cost << ";" << options.filter << ";"
+         << options.filter_min_ncc << ";"
+         << options.filter_min_triangulation_angle << ";"
+         << options.filter_min_num_consistent << ";"
+         << options.filter_geom_consistency_max_cost << ";"
+         << options.half_precision << ";" << options.write_consistency_graph
+         << ";" << options.write_compressed_maps << ";"
+         << options.write_half_precision_maps << ";" << options.tile_size
+         << ";" << options.tile_overlap;
+
+  return StringPrintf("%016llx", static_cast<unsigned long long>(
+                                     HashString(stream.str())));
+}
+
+void PatchMatchController::PrefetchProblems(const PatchMatchOptions& options,
+                                            const size_t problem_idx) {
+  if (!prefetch_thread_pool_) {
+    return;
+  }
+
+  // The problems are processed in order, so that the following problems are
+  // the next ones to be started once one of the current problems finishes.
+  const size_t end_problem_idx = std::min(
+      problems_.size(), problem_idx + 1 + options.num_prefetch_problems);
+  const bool read_maps = options.geom_consistency;
+  for (size_t i = problem_idx + 1; i < end_problem_idx; ++i) {
+    const auto& problem = problems_[i];
+    std::vector<int> image_idxs = problem.src_image_idxs;
+    image_idxs.push_back(problem.ref_image_idx);
+    for (const int image_idx : image_idxs) {
+      {
+        std::unique_lock<std::mutex> lock(prefetch_mutex_);
+        if (!prefetched_image_idxs_.insert(image_idx).second) {
+          continue;
+        }
+      }
+
+      prefetch_thread_pool_->AddTask([this, image_idx, read_maps]() {
+        if (!IsStopped()) {
+          workspace_->Prefetch(image_idx, read_maps, &workspace_mutex_);
+        }
+      });
+    }
   }
 }
 
@@ -34,6 +34,8 @@
 
 #include <iostream>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "mvs/depth_map.h"
@@ -48,8 +50,8 @@ namespace colmap {
 namespace mvs {
 
 // Maximum possible window radius for the photometric consistency cost. This
-// value is equal to THREADS_PER_BLOCK in patch_match_cuda.cu and the limit
-// arises from the shared memory implementation.
+// value is equal to the default THREADS_PER_BLOCK in patch_match_cuda.cu and
+// the limit arises from the shared memory implementation.
 const static size_t kMaxPatchMatchWindowRadius = 32;
 
 class ConsistencyGraph;
@@ -64,6 +66,40 @@ struct PatchMatchOptions {
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // Number of problems that are processed concurrently on each GPU. Small
+  // images do not fully utilize large GPUs, in which case the sweeps and the
+  // transfers of multiple problems can overlap, at the cost of proportionally
+  // more GPU memory.
+  int num_problems_per_gpu = 1;
+
+  // Size in pixels of the square tiles into which larger reference images
+  // are split, such that the GPU memory of a problem is bounded independent of
+  // the image size. Each tile is processed with crops of the source images
+  // that cover its viewing frustum within the depth range, and multiple GPUs
+  // in `gpu_index` process different tiles concurrently. The tiles are
+  // extended by `tile_overlap` pixels on each side, so that the propagation
+  // at the tile borders is continued from the neighboring tiles' content, and
+  // only the interior of each tile is stitched into the outputs. A
+  // non-positive tile size disables tiling.
+  int tile_size = -1;
+  int tile_overlap = 64;
+
+  // Whether to store the cost and selection probability maps of the source
+  // images and the source depth maps in half instead of single precision,
+  // which halves the GPU memory that grows with the number of source images.
+  // The depth and normal maps of the reference image that are optimized
+  // remain in single precision, since small perturbations of the depth would
+  // be lost in the rounding. The stored probabilities and costs have a
+  // relative rounding error of up to 2^-11, which barely affects the sampling
+  // of the source images and the filtering.
+  bool half_precision = false;
+
+  // Path to a file, in which the autotuned number of threads per block of the
+  // sweep kernels is cached for each GPU model and window configuration, such
+  // that the kernels are only benchmarked once per workspace. If empty, the
+  // kernels are benchmarked once per process.
+  std::string kernel_config_path = "";
+
   // Depth range in which to randomly sample depth hypotheses.
   double depth_min = -1.0f;
   double depth_max = -1.0f;
@@ -98,6 +134,14 @@ struct PatchMatchOptions {
   // of four sweeps from left to right, top to bottom, and vice versa.
   int num_iterations = 5;
 
+  // Number of levels of the image pyramid for coarse-to-fine estimation,
+  // where each coarser level halves the image resolution. The coarsest level
+  // runs `num_iterations` from the usual initialization and each finer level
+  // runs `pyramid_num_iterations` initialized from the upsampled depth and
+  // normal map of the previous level. A single level disables the pyramid.
+  int num_pyramid_levels = 1;
+  int pyramid_num_iterations = 2;
+
   // Whether to add a regularized geometric consistency term to the cost
   // function. If true, the `depth_maps` and `normal_maps` must not be null.
   bool geom_consistency = true;
@@ -110,6 +154,13 @@ struct PatchMatchOptions {
   // reprojection error in pixels.
   double geom_consistency_max_cost = 3.0f;
 
+  // Whether to start the geometric consistency pass of each problem as soon
+  // as the photometric outputs of its images are computed, instead of after
+  // the photometric pass of all problems, so that the photometric outputs are
+  // mostly still cached in memory and the GPUs never idle between passes.
+  // Cannot be combined with distributed processing.
+  bool interleave_passes = false;
+
   // Whether to enable filtering.
   bool filter = true;
 
@@ -134,9 +185,32 @@ struct PatchMatchOptions {
   // of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // The number of upcoming problems whose input images are read into the
+  // cache in the background, while the GPUs process the current problems.
+  // Images are only prefetched as long as they fit into the cache size.
+  int num_prefetch_problems = 2;
+
   // Whether to write the consistency graph.
   bool write_consistency_graph = false;
 
+  // Whether to write the depth and normal maps in a compressed format, which
+  // omits the filtered pixels and stores the remaining pixels losslessly.
+  // Optionally, the compressed maps are quantized to half precision with a
+  // relative rounding error of up to 2^-11, which halves their size again but
+  // slightly perturbs the inputs of the geometric pass and fusion.
+  bool write_compressed_maps = false;
+  bool write_half_precision_maps = false;
+
+  // Whether multiple processes, e.g., on different nodes with a shared file
+  // system, process the same workspace concurrently. Each process claims a
+  // problem through a lock file next to its depth map before processing it.
+  // Claims older than the timeout in seconds are considered to be failed and
+  // the problem is retried by another process. Each process only finishes
+  // once all problems are processed, which also ensures that the photometric
+  // outputs of all problems exist before the geometric pass.
+  bool distributed = false;
+  double distributed_claim_timeout = 3600.0;
+
   void Print() const;
   bool Check() const {
     if (depth_min != -1.0f || depth_max != -1.0f) {
@@ -155,6 +229,9 @@ struct PatchMatchOptions {
     CHECK_OPTION_LT(min_triangulation_angle, 180.0f);
     CHECK_OPTION_GT(incident_angle_sigma, 0.0f);
     CHECK_OPTION_GT(num_iterations, 0);
+    CHECK_OPTION_GT(num_pyramid_levels, 0);
+    CHECK_OPTION_GT(pyramid_num_iterations, 0);
+    CHECK_OPTION(!write_half_precision_maps || write_compressed_maps);
     CHECK_OPTION_GE(geom_consistency_regularizer, 0.0f);
     CHECK_OPTION_GE(geom_consistency_max_cost, 0.0f);
     CHECK_OPTION_GE(filter_min_ncc, -1.0f);
@@ -164,6 +241,11 @@ struct PatchMatchOptions {
     CHECK_OPTION_GE(filter_min_num_consistent, 0);
     CHECK_OPTION_GE(filter_geom_consistency_max_cost, 0.0f);
     CHECK_OPTION_GT(cache_size, 0);
+    CHECK_OPTION_GE(num_prefetch_problems, 0);
+    CHECK_OPTION_GT(num_problems_per_gpu, 0);
+    CHECK_OPTION_GE(tile_overlap, 0);
+    CHECK_OPTION_GT(distributed_claim_timeout, 0);
+    CHECK_OPTION(!interleave_passes || !distributed);
     return true;
   }
 };
@@ -189,6 +271,12 @@ class PatchMatch {
     // Input normal maps for the geometric consistency term.
     std::vector<NormalMap>* normal_maps = nullptr;
 
+    // Optional initial depth and normal map of the reference image. If null,
+    // they are initialized from the input depth and normal maps for the
+    // geometric consistency term or otherwise randomly.
+    const DepthMap* init_depth_map = nullptr;
+    const NormalMap* init_normal_map = nullptr;
+
     // Print the configuration to stdout.
     void Print() const;
   };
@@ -209,9 +297,22 @@ class PatchMatch {
   Mat<float> GetSelProbMap() const;
 
  private:
+  // Run coarse-to-fine over the levels of the image pyramid.
+  void RunPyramid();
+
+  // Run each tile of the reference image as a separate problem and stitch
+  // their outputs, see `PatchMatchOptions::tile_size`.
+  void RunTiled();
+
   const PatchMatchOptions options_;
   const Problem problem_;
   std::unique_ptr<PatchMatchCuda> patch_match_cuda_;
+
+  // The stitched outputs of the tiles, if the problem was run in tiles.
+  DepthMap depth_map_;
+  NormalMap normal_map_;
+  Mat<float> sel_prob_map_;
+  std::vector<uint32_t> consistency_masks_;
 };
 
 // This thread processes all problems in a workspace. A workspace has the
@@ -256,9 +357,44 @@ class PatchMatchController : public Thread {
   void Run();
   void ReadWorkspace();
   void ReadProblems();
+  // Order the problems such that successive problems share many images.
+  void OrderProblems();
   void ReadGpuIndices();
+  // Process all problems, which in distributed mode waits for the problems
+  // that are claimed by other processes.
+  void ProcessProblems(const PatchMatchOptions& options);
+  // Process the photometric and the geometric pass of all problems, where the
+  // geometric pass of each problem starts as soon as the photometric outputs
+  // of all its images are available.
+  void ProcessProblemsInterleaved(const PatchMatchOptions& photometric_options,
+                                  const PatchMatchOptions& geometric_options);
   void ProcessProblem(const PatchMatchOptions& options,
                       const size_t problem_idx);
+  std::string GetOutputFileName(const PatchMatchOptions& options,
+                                const size_t problem_idx) const;
+  void GetOutputPaths(const PatchMatchOptions& options,
+                      const size_t problem_idx, std::string* depth_map_path,
+                      std::string* normal_map_path,
+                      std::string* consistency_graph_path) const;
+  // Whether the outputs of the problem exist and were computed from its
+  // current inputs and options according to the manifest.
+  bool HasOutputs(const PatchMatchOptions& options, const size_t problem_idx);
+
+  // The manifest in the stereo folder records the hash of the inputs and the
+  // options of each completed problem, so that finished problems are skipped
+  // and problems with changed inputs are recomputed in later runs.
+  std::string GetManifestPath() const;
+  void ReadManifest();
+  std::string ReadManifestEntry(const std::string& file_name,
+                                const bool reload);
+  void WriteManifestEntry(const std::string& file_name,
+                          const std::string& hash);
+  std::string ComputeProblemHash(const PatchMatchOptions& options,
+                                 const size_t problem_idx);
+  // Read the images of the problems following the given problem in the
+  // background, so that they are cached once their processing starts.
+  void PrefetchProblems(const PatchMatchOptions& options,
+                        const size_t problem_idx);
 
   const PatchMatchOptions options_;
   const std::string workspace_path_;
@@ -266,6 +402,14 @@ class PatchMatchController : public Thread {
   const std::string pmvs_option_name_;
 
   std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<ThreadPool> prefetch_thread_pool_;
+  std::mutex prefetch_mutex_;
+  std::unordered_set<int> prefetched_image_idxs_;
+  std::mutex manifest_mutex_;
+  std::unordered_map<std::string, std::string> manifest_;
+  // Whether the workspace was processed before the manifest was introduced,
+  // in which case all existing outputs are adopted into the manifest.
+  bool adopt_existing_outputs_ = false;
   std::mutex workspace_mutex_;
   std::unique_ptr<Workspace> workspace_;
   std::vector<PatchMatch::Problem> problems_;
@@ -37,16 +37,22 @@
 #include <cfloat>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
 
 #include "util/cuda.h"
 #include "util/cudacc.h"
 #include "util/logging.h"
 
-// The number of threads per Cuda thread. Warning: Do not change this value,
-// since the templated window sizes rely on this value.
+// The number of threads per block of the element-wise kernels in each
+// dimension and the default number of threads per block of the sweep kernels.
 #define THREADS_PER_BLOCK 32
 
+// Maximum size of the statically allocated shared memory per thread block.
+#define MAX_SHARED_MEMORY_SIZE 49152
+
 // We must not include "util/math.h" to avoid any Eigen includes here,
 // since Visual Studio cannot compile some of the Eigen/Boost expressions.
 #ifndef DEG2RAD
@@ -56,18 +62,20 @@
 namespace colmap {
 namespace mvs {
 
-texture<uint8_t, cudaTextureType2D, cudaReadModeNormalizedFloat>
-    ref_image_texture;
-texture<uint8_t, cudaTextureType2DLayered, cudaReadModeNormalizedFloat>
-    src_images_texture;
-texture<float, cudaTextureType2DLayered, cudaReadModeElementType>
-    src_depth_maps_texture;
-texture<float, cudaTextureType2D, cudaReadModeElementType> poses_texture;
-
-// Calibration of reference image as {fx, cx, fy, cy}.
-__constant__ float ref_K[4];
-// Calibration of reference image as {1/fx, -cx/fx, 1/fy, -cy/fy}.
-__constant__ float ref_inv_K[4];
+// The textures and the calibration of the reference image in the current
+// rotation, which are passed to the kernels instead of being bound to global
+// texture references and constant memory, so that multiple problems can run
+// concurrently on the same device.
+struct ProblemParams {
+  cudaTextureObject_t ref_image_texture = 0;
+  cudaTextureObject_t src_images_texture = 0;
+  cudaTextureObject_t src_depth_maps_texture = 0;
+  cudaTextureObject_t poses_texture = 0;
+  // Calibration of reference image as {fx, cx, fy, cy}.
+  float ref_K[4];
+  // Calibration of reference image as {1/fx, -cx/fx, 1/fy, -cy/fy}.
+  float ref_inv_K[4];
+};
 
 __device__ inline void Mat33DotVec3(const float mat[9], const float vec[3],
                                     float result[3]) {
@@ -94,9 +102,12 @@ __device__ inline float GenerateRandomDepth(const float depth_min,
   return curand_uniform(rand_state) * (depth_max - depth_min) + depth_min;
 }
 
-__device__ inline void GenerateRandomNormal(const int row, const int col,
+__device__ inline void GenerateRandomNormal(const ProblemParams& params,
+                                            const int row, const int col,
                                             curandState* rand_state,
                                             float normal[3]) {
+  const float* ref_inv_K = params.ref_inv_K;
+
   // Unbiased sampling of normal, according to George Marsaglia, "Choosing a
   // Point from the Surface of a Sphere", 1972.
   float v1 = 0.0f;
@@ -131,12 +142,15 @@ __device__ inline float PerturbDepth(const float perturbation,
   return GenerateRandomDepth(depth_min, depth_max, rand_state);
 }
 
-__device__ inline void PerturbNormal(const int row, const int col,
+__device__ inline void PerturbNormal(const ProblemParams& params,
+                                     const int row, const int col,
                                      const float perturbation,
                                      const float normal[3],
                                      curandState* rand_state,
                                      float perturbed_normal[3],
                                      const int num_trials = 0) {
+  const float* ref_inv_K = params.ref_inv_K;
+
   // Perturbation rotation angles.
   const float a1 = (curand_uniform(rand_state) - 0.5f) * perturbation;
   const float a2 = (curand_uniform(rand_state) - 0.5f) * perturbation;
@@ -171,7 +185,7 @@ __device__ inline void PerturbNormal(const int row, const int col,
   if (DotProduct3(perturbed_normal, view_ray) >= 0.0f) {
     const int kMaxNumTrials = 3;
     if (num_trials < kMaxNumTrials) {
-      PerturbNormal(row, col, 0.5f * perturbation, normal, rand_state,
+      PerturbNormal(params, row, col, 0.5f * perturbation, normal, rand_state,
                     perturbed_normal, num_trials + 1);
       return;
     } else {
@@ -189,8 +203,10 @@ __device__ inline void PerturbNormal(const int row, const int col,
   perturbed_normal[2] *= inv_norm;
 }
 
-__device__ inline void ComputePointAtDepth(const float row, const float col,
+__device__ inline void ComputePointAtDepth(const ProblemParams& params,
+                                           const float row, const float col,
                                            const float depth, float point[3]) {
+  const float* ref_inv_K = params.ref_inv_K;
   point[0] = depth * (ref_inv_K[0] * col + ref_inv_K[1]);
   point[1] = depth * (ref_inv_K[2] * row + ref_inv_K[3]);
   point[2] = depth;
@@ -199,9 +215,12 @@ __device__ inline void ComputePointAtDepth(const float row, const float col,
 // Transfer depth on plane from viewing ray at row1 to row2. The returned
 // depth is the intersection of the viewing ray through row2 with the plane
 // at row1 defined by the given depth and normal.
-__device__ inline float PropagateDepth(const float depth1,
+__device__ inline float PropagateDepth(const ProblemParams& params,
+                                       const float depth1,
                                        const float normal1[3], const float row1,
                                        const float row2) {
+  const float* ref_inv_K = params.ref_inv_K;
+
   // Point along first viewing ray.
   const float x1 = depth1 * (ref_inv_K[2] * row1 + ref_inv_K[3]);
   const float y1 = depth1;
@@ -229,7 +248,8 @@ __device__ inline float PropagateDepth(const float depth1,
 // First, compute triangulation angle between reference and source image for 3D
 // point. Second, compute incident angle between viewing direction of source
 // image and normal direction of 3D point. Both angles are cosine distances.
-__device__ inline void ComputeViewingAngles(const float point[3],
+__device__ inline void ComputeViewingAngles(const ProblemParams& params,
+                                            const float point[3],
                                             const float normal[3],
                                             const int image_idx,
                                             float* cos_triangulation_angle,
@@ -240,7 +260,7 @@ __device__ inline void ComputeViewingAngles(const float point[3],
   // Projection center of source image.
   float C[3];
   for (int i = 0; i < 3; ++i) {
-    C[i] = tex2D(poses_texture, i + 16, image_idx);
+    C[i] = tex2DLayered<float>(params.poses_texture, i + 16, image_idx, 0);
   }
 
   // Ray from point to camera.
@@ -256,25 +276,28 @@ __device__ inline void ComputeViewingAngles(const float point[3],
   *cos_triangulation_angle = DotProduct3(SX, point) * RX_inv_norm * SX_inv_norm;
 }
 
-__device__ inline void ComposeHomography(const int image_idx, const int row,
+__device__ inline void ComposeHomography(const ProblemParams& params,
+                                         const int image_idx, const int row,
                                          const int col, const float depth,
                                          const float normal[3], float H[9]) {
+  const float* ref_inv_K = params.ref_inv_K;
+
   // Calibration of source image.
   float K[4];
   for (int i = 0; i < 4; ++i) {
-    K[i] = tex2D(poses_texture, i, image_idx);
+    K[i] = tex2DLayered<float>(params.poses_texture, i, image_idx, 0);
   }
 
   // Relative rotation between reference and source image.
   float R[9];
   for (int i = 0; i < 9; ++i) {
-    R[i] = tex2D(poses_texture, i + 4, image_idx);
+    R[i] = tex2DLayered<float>(params.poses_texture, i + 4, image_idx, 0);
   }
 
   // Relative translation between reference and source image.
   float T[3];
   for (int i = 0; i < 3; ++i) {
-    T[i] = tex2D(poses_texture, i + 13, image_idx);
+    T[i] = tex2DLayered<float>(params.poses_texture, i + 13, image_idx, 0);
   }
 
   // Distance to the plane.
@@ -315,26 +338,27 @@ __device__ inline void ComposeHomography(const int image_idx, const int row,
 }
 
 // Each thread in the current warp / thread block reads in 3 columns of the
-// reference image. The shared memory holds 3 * THREADS_PER_BLOCK columns and
+// reference image. The shared memory holds 3 * kThreadsPerBlock columns and
 // kWindowSize rows of the reference image. Each thread copies every
-// THREADS_PER_BLOCK-th column from global to shared memory offset by its ID.
-// For example, if THREADS_PER_BLOCK = 32, then thread 0 reads columns 0, 32, 64
+// kThreadsPerBlock-th column from global to shared memory offset by its ID.
+// For example, if kThreadsPerBlock = 32, then thread 0 reads columns 0, 32, 64
 // and thread 1 columns 1, 33, 65. When computing the photoconsistency, which is
 // shared among each thread block, each thread can then read the reference image
 // colors from shared memory. Note that this limits the window radius to a
-// maximum of THREADS_PER_BLOCK.
-template <int kWindowSize>
+// maximum of kThreadsPerBlock.
+template <int kWindowSize, int kThreadsPerBlock>
 struct LocalRefImage {
   const static int kWindowRadius = kWindowSize / 2;
   const static int kThreadBlockRadius = 1;
   const static int kThreadBlockSize = 2 * kThreadBlockRadius + 1;
   const static int kNumRows = kWindowSize;
-  const static int kNumColumns = kThreadBlockSize * THREADS_PER_BLOCK;
+  const static int kNumColumns = kThreadBlockSize * kThreadsPerBlock;
   const static int kDataSize = kNumRows * kNumColumns;
 
   float* data = nullptr;
 
-  __device__ inline void Read(const int row) {
+  __device__ inline void Read(const cudaTextureObject_t ref_image_texture,
+                              const int row) {
     // For the first row, read the entire block into shared memory. For all
     // consecutive rows, it is only necessary to shift the rows in shared memory
     // up by one element and then read in a new row at the bottom of the shared
@@ -346,7 +370,7 @@ struct LocalRefImage {
 
     const int local_col_start = thread_id;
     const int global_col_start = thread_block_first_id -
-                                 kThreadBlockRadius * THREADS_PER_BLOCK +
+                                 kThreadBlockRadius * kThreadsPerBlock +
                                  thread_id;
 
     if (row == 0) {
@@ -357,9 +381,9 @@ struct LocalRefImage {
 #pragma unroll
         for (int block = 0; block < kThreadBlockSize; ++block) {
           data[local_row * kNumColumns + local_col] =
-              tex2D(ref_image_texture, global_col, global_row);
-          local_col += THREADS_PER_BLOCK;
-          global_col += THREADS_PER_BLOCK;
+              tex2DLayered<float>(ref_image_texture, global_col, global_row, 0);
+          local_col += kThreadsPerBlock;
+          global_col += kThreadsPerBlock;
         }
       }
     } else {
@@ -370,7 +394,7 @@ struct LocalRefImage {
         for (int block = 0; block < kThreadBlockSize; ++block) {
           data[(local_row - 1) * kNumColumns + local_col] =
               data[local_row * kNumColumns + local_col];
-          local_col += THREADS_PER_BLOCK;
+          local_col += kThreadsPerBlock;
         }
       }
 
@@ -382,9 +406,9 @@ struct LocalRefImage {
 #pragma unroll
       for (int block = 0; block < kThreadBlockSize; ++block) {
         data[local_row * kNumColumns + local_col] =
-            tex2D(ref_image_texture, global_col, global_row);
-        local_col += THREADS_PER_BLOCK;
-        global_col += THREADS_PER_BLOCK;
+            tex2DLayered<float>(ref_image_texture, global_col, global_row, 0);
+        local_col += kThreadsPerBlock;
+        global_col += kThreadsPerBlock;
       }
     }
   }
@@ -392,19 +416,21 @@ struct LocalRefImage {
 
 // The return values is 1 - NCC, so the range is [0, 2], the smaller the
 // value, the better the color consistency.
-template <int kWindowSize, int kWindowStep>
+template <int kWindowSize, int kWindowStep, int kThreadsPerBlock>
 struct PhotoConsistencyCostComputer {
   const static int kWindowRadius = kWindowSize / 2;
 
-  __device__ PhotoConsistencyCostComputer(const float sigma_spatial,
+  __device__ PhotoConsistencyCostComputer(const ProblemParams& params,
+                                          const float sigma_spatial,
                                           const float sigma_color)
-      : bilateral_weight_computer_(sigma_spatial, sigma_color) {}
+      : params_(params),
+        bilateral_weight_computer_(sigma_spatial, sigma_color) {}
 
   // Maximum photo consistency cost as 1 - min(NCC).
   const float kMaxCost = 2.0f;
 
   // Thread warp local reference image data around current patch.
-  typedef LocalRefImage<kWindowSize> LocalRefImageType;
+  typedef LocalRefImage<kWindowSize, kThreadsPerBlock> LocalRefImageType;
   LocalRefImageType local_ref_image;
 
   // Precomputed sum of raw and squared image intensities.
@@ -423,13 +449,13 @@ struct PhotoConsistencyCostComputer {
   const float* normal = nullptr;
 
   __device__ inline void Read(const int row) {
-    local_ref_image.Read(row);
+    local_ref_image.Read(params_.ref_image_texture, row);
     __syncthreads();
   }
 
   __device__ inline float Compute() const {
     float tform[9];
-    ComposeHomography(src_image_idx, row, col, depth, normal, tform);
+    ComposeHomography(params_, src_image_idx, row, col, depth, normal, tform);
 
     float tform_step[8];
     for (int i = 0; i < 8; ++i) {
@@ -447,12 +473,12 @@ struct PhotoConsistencyCostComputer {
     float base_row_src = row_src;
     float base_z = z;
 
-    int ref_image_idx = THREADS_PER_BLOCK - kWindowRadius + thread_id;
+    int ref_image_idx = kThreadsPerBlock - kWindowRadius + thread_id;
     int ref_image_base_idx = ref_image_idx;
 
     const float ref_center_color =
         local_ref_image
-            .data[ref_image_idx + kWindowRadius * 3 * THREADS_PER_BLOCK +
+            .data[ref_image_idx + kWindowRadius * 3 * kThreadsPerBlock +
                   kWindowRadius];
     const float ref_color_sum = local_ref_sum;
     const float ref_color_squared_sum = local_ref_squared_sum;
@@ -467,8 +493,9 @@ struct PhotoConsistencyCostComputer {
         const float norm_col_src = inv_z * col_src + 0.5f;
         const float norm_row_src = inv_z * row_src + 0.5f;
         const float ref_color = local_ref_image.data[ref_image_idx];
-        const float src_color = tex2DLayered(src_images_texture, norm_col_src,
-                                             norm_row_src, src_image_idx);
+        const float src_color =
+            tex2DLayered<float>(params_.src_images_texture, norm_col_src,
+                                norm_row_src, src_image_idx);
 
         const float bilateral_weight = bilateral_weight_computer_.Compute(
             row, col, ref_center_color, ref_color);
@@ -491,7 +518,7 @@ struct PhotoConsistencyCostComputer {
         z += tform_step[6];
       }
 
-      ref_image_base_idx += kWindowStep * 3 * THREADS_PER_BLOCK;
+      ref_image_base_idx += kWindowStep * 3 * kThreadsPerBlock;
       ref_image_idx = ref_image_base_idx;
 
       base_col_src += tform_step[1];
@@ -528,27 +555,31 @@ struct PhotoConsistencyCostComputer {
   }
 
  private:
+  const ProblemParams& params_;
   const BilateralWeightComputer bilateral_weight_computer_;
 };
 
-__device__ inline float ComputeGeomConsistencyCost(const float row,
+__device__ inline float ComputeGeomConsistencyCost(const ProblemParams& params,
+                                                   const float row,
                                                    const float col,
                                                    const float depth,
                                                    const int image_idx,
                                                    const float max_cost) {
+  const float* ref_K = params.ref_K;
+
   // Extract projection matrices for source image.
   float P[12];
   for (int i = 0; i < 12; ++i) {
-    P[i] = tex2D(poses_texture, i + 19, image_idx);
+    P[i] = tex2DLayered<float>(params.poses_texture, i + 19, image_idx, 0);
   }
   float inv_P[12];
   for (int i = 0; i < 12; ++i) {
-    inv_P[i] = tex2D(poses_texture, i + 31, image_idx);
+    inv_P[i] = tex2DLayered<float>(params.poses_texture, i + 31, image_idx, 0);
   }
 
   // Project point in reference image to world.
   float forward_point[3];
-  ComputePointAtDepth(row, col, depth, forward_point);
+  ComputePointAtDepth(params, row, col, depth, forward_point);
 
   // Project world point to source image.
   const float inv_forward_z =
@@ -562,8 +593,9 @@ __device__ inline float ComputeGeomConsistencyCost(const float row,
                        P[6] * forward_point[2] + P[7]);
 
   // Extract depth in source image.
-  const float src_depth = tex2DLayered(src_depth_maps_texture, src_col + 0.5f,
-                                       src_row + 0.5f, image_idx);
+  const float src_depth =
+      tex2DLayered<float>(params.src_depth_maps_texture, src_col + 0.5f,
+                          src_row + 0.5f, image_idx);
 
   // Projection outside of source image.
   if (src_depth == 0.0f) {
@@ -596,6 +628,15 @@ __device__ inline float ComputeGeomConsistencyCost(const float row,
   return min(max_cost, sqrt(diff_col * diff_col + diff_row * diff_row));
 }
 
+// Mark the source image as consistent in the mask words of the pixel.
+__device__ inline void SetConsistencyMaskBit(const int row, const int col,
+                                             const int image_idx,
+                                             GpuMat<uint32_t>* mask) {
+  const int word_idx = image_idx / 32;
+  mask->Set(row, col, word_idx,
+            mask->Get(row, col, word_idx) | (1u << (image_idx % 32)));
+}
+
 // Find index of minimum in given values.
 template <int kNumCosts>
 __device__ inline int FindMinCost(const float costs[kNumCosts]) {
@@ -762,14 +803,15 @@ class LikelihoodComputer {
 };
 
 // Rotate normals by 90deg around z-axis in counter-clockwise direction.
-__global__ void InitNormalMap(GpuMat<float> normal_map,
+__global__ void InitNormalMap(const ProblemParams params,
+                              GpuMat<float> normal_map,
                               GpuMat<curandState> rand_state_map) {
   const int row = blockDim.y * blockIdx.y + threadIdx.y;
   const int col = blockDim.x * blockIdx.x + threadIdx.x;
   if (col < normal_map.GetWidth() && row < normal_map.GetHeight()) {
     curandState rand_state = rand_state_map.Get(row, col);
     float normal[3];
-    GenerateRandomNormal(row, col, &rand_state, normal);
+    GenerateRandomNormal(params, row, col, &rand_state, normal);
     normal_map.SetSlice(row, col, normal);
     rand_state_map.Set(row, col, rand_state);
   }
@@ -790,8 +832,9 @@ __global__ void RotateNormalMap(GpuMat<float> normal_map) {
   }
 }
 
-template <int kWindowSize, int kWindowStep>
-__global__ void ComputeInitialCost(GpuMat<float> cost_map,
+template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T>
+__global__ void ComputeInitialCost(const ProblemParams params,
+                                   GpuMat<T> cost_map,
                                    const GpuMat<float> depth_map,
                                    const GpuMat<float> normal_map,
                                    const GpuMat<float> ref_sum_image,
@@ -800,9 +843,11 @@ __global__ void ComputeInitialCost(GpuMat<float> cost_map,
                                    const float sigma_color) {
   const int col = blockDim.x * blockIdx.x + threadIdx.x;
 
-  typedef PhotoConsistencyCostComputer<kWindowSize, kWindowStep>
+  typedef PhotoConsistencyCostComputer<kWindowSize, kWindowStep,
+                                       kThreadsPerBlock>
       PhotoConsistencyCostComputerType;
-  PhotoConsistencyCostComputerType pcc_computer(sigma_spatial, sigma_color);
+  PhotoConsistencyCostComputerType pcc_computer(params, sigma_spatial,
+                                                sigma_color);
   pcc_computer.col = col;
 
   __shared__ float local_ref_image_data
@@ -827,7 +872,7 @@ __global__ void ComputeInitialCost(GpuMat<float> cost_map,
 
       for (int image_idx = 0; image_idx < cost_map.GetDepth(); ++image_idx) {
         pcc_computer.src_image_idx = image_idx;
-        cost_map.Set(row, col, image_idx, pcc_computer.Compute());
+        cost_map.Set(row, col, image_idx, T(pcc_computer.Compute()));
       }
     }
   }
@@ -852,14 +897,18 @@ struct SweepOptions {
   float filter_geom_consistency_max_cost = 1.0f;
 };
 
-template <int kWindowSize, int kWindowStep, bool kGeomConsistencyTerm = false,
+// The cost and selection probability maps are read and written in single
+// precision, independent of their storage type T.
+template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T,
+          bool kGeomConsistencyTerm = false,
           bool kFilterPhotoConsistency = false,
           bool kFilterGeomConsistency = false>
 __global__ void SweepFromTopToBottom(
-    GpuMat<float> global_workspace, GpuMat<curandState> rand_state_map,
-    GpuMat<float> cost_map, GpuMat<float> depth_map, GpuMat<float> normal_map,
-    GpuMat<uint8_t> consistency_mask, GpuMat<float> sel_prob_map,
-    const GpuMat<float> prev_sel_prob_map, const GpuMat<float> ref_sum_image,
+    const ProblemParams params, GpuMat<float> global_workspace,
+    GpuMat<curandState> rand_state_map, GpuMat<T> cost_map,
+    GpuMat<float> depth_map, GpuMat<float> normal_map,
+    GpuMat<uint32_t> consistency_mask, GpuMat<T> sel_prob_map,
+    const GpuMat<T> prev_sel_prob_map, const GpuMat<float> ref_sum_image,
     const GpuMat<float> ref_squared_sum_image, const SweepOptions options) {
   const int col = blockDim.x * blockIdx.x + threadIdx.x;
 
@@ -890,7 +939,7 @@ __global__ void SweepFromTopToBottom(
       for (int row = cost_map.GetHeight() - 1; row >= 0; --row) {
         const float cost = cost_map.Get(row, col, image_idx);
         beta = likelihood_computer.ComputeBackwardMessage(cost, beta);
-        sel_prob_map.Set(row, col, image_idx, beta);
+        sel_prob_map.Set(row, col, image_idx, T(beta));
       }
 
       // Initialize forward message.
@@ -902,9 +951,10 @@ __global__ void SweepFromTopToBottom(
   // Estimate parameters for remaining rows and compute selection probabilities.
   //////////////////////////////////////////////////////////////////////////////
 
-  typedef PhotoConsistencyCostComputer<kWindowSize, kWindowStep>
+  typedef PhotoConsistencyCostComputer<kWindowSize, kWindowStep,
+                                       kThreadsPerBlock>
       PhotoConsistencyCostComputerType;
-  PhotoConsistencyCostComputerType pcc_computer(options.sigma_spatial,
+  PhotoConsistencyCostComputerType pcc_computer(params, options.sigma_spatial,
                                                 options.sigma_color);
   pcc_computer.col = col;
 
@@ -952,7 +1002,7 @@ __global__ void SweepFromTopToBottom(
     // the depth of very oblique structures, i.e. pixels whose normal direction
     // is significantly different from their viewing direction.
     prev_param_state.depth = PropagateDepth(
-        prev_param_state.depth, prev_param_state.normal, row - 1, row);
+        params, prev_param_state.depth, prev_param_state.normal, row - 1, row);
 
     // Read parameters for current pixel from previous sweep.
     curr_param_state.depth = depth_map.Get(row, col);
@@ -961,7 +1011,7 @@ __global__ void SweepFromTopToBottom(
     // Generate random parameters.
     rand_param_state.depth =
         PerturbDepth(options.perturbation, curr_param_state.depth, &rand_state);
-    PerturbNormal(row, col, options.perturbation * M_PI,
+    PerturbNormal(params, row, col, options.perturbation * M_PI,
                   curr_param_state.normal, &rand_state,
                   rand_param_state.normal);
 
@@ -969,7 +1019,7 @@ __global__ void SweepFromTopToBottom(
     // modulate selection probabilities with priors.
 
     float point[3];
-    ComputePointAtDepth(row, col, curr_param_state.depth, point);
+    ComputePointAtDepth(params, row, col, curr_param_state.depth, point);
 
     for (int image_idx = 0; image_idx < cost_map.GetDepth(); ++image_idx) {
       const float cost = cost_map.Get(row, col, image_idx);
@@ -982,7 +1032,7 @@ __global__ void SweepFromTopToBottom(
 
       float cos_triangulation_angle;
       float cos_incident_angle;
-      ComputeViewingAngles(point, curr_param_state.normal, image_idx,
+      ComputeViewingAngles(params, point, curr_param_state.normal, image_idx,
                            &cos_triangulation_angle, &cos_incident_angle);
       const float tri_prob =
           likelihood_computer.ComputeTriProb(cos_triangulation_angle);
@@ -990,7 +1040,7 @@ __global__ void SweepFromTopToBottom(
           likelihood_computer.ComputeIncProb(cos_incident_angle);
 
       float H[9];
-      ComposeHomography(image_idx, row, col, curr_param_state.depth,
+      ComposeHomography(params, image_idx, row, col, curr_param_state.depth,
                         curr_param_state.normal, H);
       const float res_prob =
           likelihood_computer.ComputeResolutionProb<kWindowSize>(H, row, col);
@@ -1033,11 +1083,13 @@ __global__ void SweepFromTopToBottom(
         continue;
       }
 
-      costs[0] += cost_map.Get(row, col, pcc_computer.src_image_idx);
+      costs[0] += static_cast<float>(
+          cost_map.Get(row, col, pcc_computer.src_image_idx));
       if (kGeomConsistencyTerm) {
         costs[0] += options.geom_consistency_regularizer *
                     ComputeGeomConsistencyCost(
-                        row, col, depths[0], pcc_computer.src_image_idx,
+                        params, row, col, depths[0],
+                        pcc_computer.src_image_idx,
                         options.geom_consistency_max_cost);
       }
 
@@ -1048,7 +1100,8 @@ __global__ void SweepFromTopToBottom(
         if (kGeomConsistencyTerm) {
           costs[i] += options.geom_consistency_regularizer *
                       ComputeGeomConsistencyCost(
-                          row, col, depths[i], pcc_computer.src_image_idx,
+                          params, row, col, depths[i],
+                          pcc_computer.src_image_idx,
                           options.geom_consistency_max_cost);
         }
       }
@@ -1075,7 +1128,7 @@ __global__ void SweepFromTopToBottom(
       } else {
         pcc_computer.src_image_idx = image_idx;
         cost = pcc_computer.Compute();
-        cost_map.Set(row, col, image_idx, cost);
+        cost_map.Set(row, col, image_idx, T(cost));
       }
 
       const float alpha = likelihood_computer.ComputeForwardMessage(
@@ -1085,14 +1138,14 @@ __global__ void SweepFromTopToBottom(
       const float prob = likelihood_computer.ComputeSelProb(
           alpha, beta, prev_prob, options.prev_sel_prob_weight);
       forward_message[image_idx] = alpha;
-      sel_prob_map.Set(row, col, image_idx, prob);
+      sel_prob_map.Set(row, col, image_idx, T(prob));
     }
 
     if (kFilterPhotoConsistency || kFilterGeomConsistency) {
       int num_consistent = 0;
 
       float best_point[3];
-      ComputePointAtDepth(row, col, best_depth, best_point);
+      ComputePointAtDepth(params, row, col, best_depth, best_point);
 
       const float min_ncc_prob =
           likelihood_computer.ComputeNCCProb(1.0f - options.filter_min_ncc);
@@ -1102,7 +1155,7 @@ __global__ void SweepFromTopToBottom(
       for (int image_idx = 0; image_idx < cost_map.GetDepth(); ++image_idx) {
         float cos_triangulation_angle;
         float cos_incident_angle;
-        ComputeViewingAngles(best_point, best_normal, image_idx,
+        ComputeViewingAngles(params, best_point, best_normal, image_idx,
                              &cos_triangulation_angle, &cos_incident_angle);
         if (cos_triangulation_angle > cos_min_triangulation_angle ||
             cos_incident_angle <= 0.0f) {
@@ -1110,23 +1163,27 @@ __global__ void SweepFromTopToBottom(
         }
 
         if (!kFilterGeomConsistency) {
-          if (sel_prob_map.Get(row, col, image_idx) >= min_ncc_prob) {
-            consistency_mask.Set(row, col, image_idx, 1);
+          if (static_cast<float>(sel_prob_map.Get(row, col, image_idx)) >=
+              min_ncc_prob) {
+            SetConsistencyMaskBit(row, col, image_idx, &consistency_mask);
             num_consistent += 1;
           }
         } else if (!kFilterPhotoConsistency) {
-          if (ComputeGeomConsistencyCost(row, col, best_depth, image_idx,
+          if (ComputeGeomConsistencyCost(params, row, col, best_depth,
+                                         image_idx,
                                          options.geom_consistency_max_cost) <=
               options.filter_geom_consistency_max_cost) {
-            consistency_mask.Set(row, col, image_idx, 1);
+            SetConsistencyMaskBit(row, col, image_idx, &consistency_mask);
             num_consistent += 1;
           }
         } else {
-          if (sel_prob_map.Get(row, col, image_idx) >= min_ncc_prob &&
-              ComputeGeomConsistencyCost(row, col, best_depth, image_idx,
+          if (static_cast<float>(sel_prob_map.Get(row, col, image_idx)) >=
+                  min_ncc_prob &&
+              ComputeGeomConsistencyCost(params, row, col, best_depth,
+                                         image_idx,
                                          options.geom_consistency_max_cost) <=
                   options.filter_geom_consistency_max_cost) {
-            consistency_mask.Set(row, col, image_idx, 1);
+            SetConsistencyMaskBit(row, col, image_idx, &consistency_mask);
             num_consistent += 1;
           }
         }
@@ -1137,8 +1194,9 @@ __global__ void SweepFromTopToBottom(
         normal_map.Set(row, col, 0, 0.0f);
         normal_map.Set(row, col, 1, 0.0f);
         normal_map.Set(row, col, 2, 0.0f);
-        for (int image_idx = 0; image_idx < cost_map.GetDepth(); ++image_idx) {
-          consistency_mask.Set(row, col, image_idx, 0);
+        for (int word_idx = 0; word_idx < consistency_mask.GetDepth();
+             ++word_idx) {
+          consistency_mask.Set(row, col, word_idx, 0);
         }
       }
     }
@@ -1155,13 +1213,81 @@ __global__ void SweepFromTopToBottom(
   }
 }
 
+// Whether the sweep kernels can be launched with the given number of threads
+// per block, i.e., the window radius is at most the number of threads and the
+// 3 * threads_per_block columns of the window fit into the shared memory of a
+// thread block, see LocalRefImage.
+constexpr bool IsValidSweepThreadsPerBlock(const int window_size,
+                                           const int threads_per_block) {
+  return window_size / 2 <= threads_per_block &&
+         window_size * 3 * threads_per_block * sizeof(float) <=
+             MAX_SHARED_MEMORY_SIZE;
+}
+
+// The given number of threads per block, if it is valid for the window size,
+// and otherwise the default, which avoids instantiating the sweep kernels with
+// invalid configurations.
+constexpr int GetSweepThreadsPerBlock(const int window_size,
+                                      const int threads_per_block) {
+  return IsValidSweepThreadsPerBlock(window_size, threads_per_block)
+             ? threads_per_block
+             : THREADS_PER_BLOCK;
+}
+
+// The candidate numbers of threads per block of the sweep kernels, among
+// which the fastest is chosen for each device and window configuration. Note
+// that each candidate must be dispatched in SWITCH_SWEEP_THREADS_PER_BLOCK.
+const static int kSweepThreadsPerBlockCandidates[] = {32, 64};
+
+#define SWITCH_SWEEP_THREADS_PER_BLOCK(threads_per_block, func, ...)        \
+  switch (threads_per_block) {                                              \
+    case 64:                                                                \
+      func<kWindowSize, kWindowStep,                                        \
+           GetSweepThreadsPerBlock(kWindowSize, 64)>(__VA_ARGS__);          \
+      break;                                                                \
+    default:                                                                \
+      func<kWindowSize, kWindowStep, THREADS_PER_BLOCK>(__VA_ARGS__);       \
+      break;                                                                \
+  }
+
+// The autotuned numbers of threads per block of the sweep kernels, which are
+// shared among all problems of the process and optionally cached in a file.
+std::mutex sweep_threads_per_block_mutex;
+std::unordered_map<std::string, int> sweep_threads_per_block;
+
+void ReadSweepThreadsPerBlock(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream line_stream(line);
+    int threads_per_block;
+    std::string key;
+    if (line_stream >> threads_per_block >> std::ws &&
+        std::getline(line_stream, key) && !key.empty()) {
+      sweep_threads_per_block.emplace(key, threads_per_block);
+    }
+  }
+}
+
+void WriteSweepThreadsPerBlock(const std::string& path, const std::string& key,
+                               const int threads_per_block) {
+  std::ofstream file(path, std::ios::app);
+  if (file.is_open()) {
+    file << threads_per_block << " " << key << std::endl;
+  } else {
+    std::cerr << "WARNING: Could not write kernel configuration to " << path
+              << std::endl;
+  }
+}
+
 PatchMatchCuda::PatchMatchCuda(const PatchMatchOptions& options,
                                const PatchMatch::Problem& problem)
     : options_(options),
       problem_(problem),
       ref_width_(0),
       ref_height_(0),
-      rotation_in_half_pi_(0) {
+      rotation_in_half_pi_(0),
+      sweep_threads_per_block_(THREADS_PER_BLOCK) {
   SetBestCudaDevice(std::stoi(options_.gpu_index));
   InitRefImage();
   InitSourceImages();
@@ -1176,9 +1302,15 @@ PatchMatchCuda::~PatchMatchCuda() {
 }
 
 void PatchMatchCuda::Run() {
-#define CASE_WINDOW_RADIUS(window_radius, window_step)              \
-  case window_radius:                                               \
-    RunWithWindowSizeAndStep<2 * window_radius + 1, window_step>(); \
+#define CASE_WINDOW_RADIUS(window_radius, window_step)                  \
+  case window_radius:                                                   \
+    if (options_.half_precision) {                                      \
+      RunWithWindowSizeAndStep<2 * window_radius + 1, window_step>(     \
+          &source_maps_half_);                                          \
+    } else {                                                            \
+      RunWithWindowSizeAndStep<2 * window_radius + 1, window_step>(     \
+          &source_maps_);                                               \
+    }                                                                   \
     break;
 
 #define CASE_WINDOW_STEP(window_step)                                 \
@@ -1204,6 +1336,18 @@ void PatchMatchCuda::Run() {
       CASE_WINDOW_RADIUS(18, window_step)                             \
       CASE_WINDOW_RADIUS(19, window_step)                             \
       CASE_WINDOW_RADIUS(20, window_step)                             \
+      CASE_WINDOW_RADIUS(21, window_step)                             \
+      CASE_WINDOW_RADIUS(22, window_step)                             \
+      CASE_WINDOW_RADIUS(23, window_step)                             \
+      CASE_WINDOW_RADIUS(24, window_step)                             \
+      CASE_WINDOW_RADIUS(25, window_step)                             \
+      CASE_WINDOW_RADIUS(26, window_step)                             \
+      CASE_WINDOW_RADIUS(27, window_step)                             \
+      CASE_WINDOW_RADIUS(28, window_step)                             \
+      CASE_WINDOW_RADIUS(29, window_step)                             \
+      CASE_WINDOW_RADIUS(30, window_step)                             \
+      CASE_WINDOW_RADIUS(31, window_step)                             \
+      CASE_WINDOW_RADIUS(32, window_step)                             \
       default: {                                                      \
         std::cerr << "Error: Window size not supported" << std::endl; \
         break;                                                        \
@@ -1234,49 +1378,150 @@ NormalMap PatchMatchCuda::GetNormalMap() const {
 }
 
 Mat<float> PatchMatchCuda::GetSelProbMap() const {
-  return prev_sel_prob_map_->CopyToMat();
+  if (!options_.half_precision) {
+    return source_maps_.prev_sel_prob_map->CopyToMat();
+  }
+
+  const Mat<__half> sel_prob_map_half =
+      source_maps_half_.prev_sel_prob_map->CopyToMat();
+  Mat<float> sel_prob_map(sel_prob_map_half.GetWidth(),
+                          sel_prob_map_half.GetHeight(),
+                          sel_prob_map_half.GetDepth());
+  for (size_t r = 0; r < sel_prob_map.GetHeight(); ++r) {
+    for (size_t c = 0; c < sel_prob_map.GetWidth(); ++c) {
+      for (size_t d = 0; d < sel_prob_map.GetDepth(); ++d) {
+        sel_prob_map.Set(r, c, d, __half2float(sel_prob_map_half.Get(r, c, d)));
+      }
+    }
+  }
+  return sel_prob_map;
 }
 
-std::vector<int> PatchMatchCuda::GetConsistentImageIdxs() const {
-  const Mat<uint8_t> mask = consistency_mask_->CopyToMat();
-  std::vector<int> consistent_image_idxs;
-  std::vector<int> pixel_consistent_image_idxs;
-  pixel_consistent_image_idxs.reserve(mask.GetDepth());
+std::vector<uint32_t> PatchMatchCuda::GetConsistencyMasks() const {
+  const Mat<uint32_t> mask = consistency_mask_->CopyToMat();
+  std::vector<uint32_t> masks(mask.GetWidth() * mask.GetHeight() *
+                              mask.GetDepth());
+  auto mask_it = masks.begin();
   for (size_t r = 0; r < mask.GetHeight(); ++r) {
     for (size_t c = 0; c < mask.GetWidth(); ++c) {
-      pixel_consistent_image_idxs.clear();
       for (size_t d = 0; d < mask.GetDepth(); ++d) {
-        if (mask.Get(r, c, d)) {
-          pixel_consistent_image_idxs.push_back(problem_.src_image_idxs[d]);
-        }
-      }
-      if (pixel_consistent_image_idxs.size() > 0) {
-        consistent_image_idxs.push_back(c);
-        consistent_image_idxs.push_back(r);
-        consistent_image_idxs.push_back(pixel_consistent_image_idxs.size());
-        consistent_image_idxs.insert(consistent_image_idxs.end(),
-                                     pixel_consistent_image_idxs.begin(),
-                                     pixel_consistent_image_idxs.end());
+        *mask_it = mask.Get(r, c, d);
+        ++mask_it;
       }
     }
   }
-  return consistent_image_idxs;
+  return masks;
 }
 
-template <int kWindowSize, int kWindowStep>
-void PatchMatchCuda::RunWithWindowSizeAndStep() {
+template <int kWindowSize, int kWindowStep, typename T>
+void PatchMatchCuda::RunWithWindowSizeAndStep(SourceMaps<T>* source_maps) {
   // Wait for all initializations to finish.
   CUDA_SYNC_AND_CHECK();
 
+  sweep_threads_per_block_ =
+      TuneSweepThreadsPerBlock<kWindowSize, kWindowStep>(source_maps);
+  SWITCH_SWEEP_THREADS_PER_BLOCK(sweep_threads_per_block_, RunWithKernelConfig,
+                                 source_maps)
+}
+
+template <int kWindowSize, int kWindowStep, typename T>
+int PatchMatchCuda::TuneSweepThreadsPerBlock(SourceMaps<T>* source_maps) {
+  int device;
+  CUDA_SAFE_CALL(cudaGetDevice(&device));
+  cudaDeviceProp device_prop;
+  CUDA_SAFE_CALL(cudaGetDeviceProperties(&device_prop, device));
+
+  std::ostringstream key;
+  key << "sm_" << device_prop.major << device_prop.minor << " " << kWindowSize
+      << " " << kWindowStep << " " << sizeof(T) << " " << device_prop.name;
+
+  // Concurrent problems wait for the autotuning to finish, such that they
+  // neither distort the timings nor autotune the same configuration.
+  std::unique_lock<std::mutex> lock(sweep_threads_per_block_mutex);
+
+  if (sweep_threads_per_block.count(key.str()) == 0 &&
+      !options_.kernel_config_path.empty()) {
+    ReadSweepThreadsPerBlock(options_.kernel_config_path);
+  }
+
+  const auto cached = sweep_threads_per_block.find(key.str());
+  if (cached != sweep_threads_per_block.end() &&
+      IsValidSweepThreadsPerBlock(kWindowSize, cached->second)) {
+    return cached->second;
+  }
+
+  // The initial cost is representative of the sweeps, since both are
+  // dominated by the photo-consistency computation. Each candidate runs twice
+  // to exclude the one-time overhead of the first launch.
+  const int kNumTrials = 2;
+
+  cudaEvent_t start;
+  cudaEvent_t stop;
+  CUDA_SAFE_CALL(cudaEventCreate(&start));
+  CUDA_SAFE_CALL(cudaEventCreate(&stop));
+
+  int best_threads_per_block = THREADS_PER_BLOCK;
+  float best_elapsed_time = FLT_MAX;
+  for (const int threads_per_block : kSweepThreadsPerBlockCandidates) {
+    if (!IsValidSweepThreadsPerBlock(kWindowSize, threads_per_block)) {
+      continue;
+    }
+
+    sweep_threads_per_block_ = threads_per_block;
+    ComputeCudaConfig();
+
+    float elapsed_time = FLT_MAX;
+    for (int trial = 0; trial < kNumTrials; ++trial) {
+      CUDA_SAFE_CALL(cudaEventRecord(start, 0));
+      SWITCH_SWEEP_THREADS_PER_BLOCK(threads_per_block, ComputeInitialCostMap,
+                                     source_maps)
+      CUDA_SAFE_CALL(cudaEventRecord(stop, 0));
+      CUDA_SAFE_CALL(cudaEventSynchronize(stop));
+      CUDA_SYNC_AND_CHECK();
+      float trial_elapsed_time;
+      CUDA_SAFE_CALL(
+          cudaEventElapsedTime(&trial_elapsed_time, start, stop));
+      elapsed_time = std::min(elapsed_time, trial_elapsed_time);
+    }
+
+    if (elapsed_time < best_elapsed_time) {
+      best_threads_per_block = threads_per_block;
+      best_elapsed_time = elapsed_time;
+    }
+  }
+
+  CUDA_SAFE_CALL(cudaEventDestroy(start));
+  CUDA_SAFE_CALL(cudaEventDestroy(stop));
+
+  std::cout << "Autotuned " << best_threads_per_block
+            << " threads per block for " << key.str() << std::endl;
+
+  sweep_threads_per_block[key.str()] = best_threads_per_block;
+  if (!options_.kernel_config_path.empty()) {
+    WriteSweepThreadsPerBlock(options_.kernel_config_path, key.str(),
+                              best_threads_per_block);
+  }
+
+  return best_threads_per_block;
+}
+
+template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T>
+void PatchMatchCuda::ComputeInitialCostMap(SourceMaps<T>* source_maps) {
+  ComputeInitialCost<kWindowSize, kWindowStep, kThreadsPerBlock, T>
+      <<<sweep_grid_size_, sweep_block_size_>>>(
+          GetProblemParams(), *source_maps->cost_map, *depth_map_, *normal_map_,
+          *ref_image_->sum_image, *ref_image_->squared_sum_image,
+          options_.sigma_spatial, options_.sigma_color);
+}
+
+template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T>
+void PatchMatchCuda::RunWithKernelConfig(SourceMaps<T>* source_maps) {
   CudaTimer total_timer;
   CudaTimer init_timer;
 
   ComputeCudaConfig();
-  ComputeInitialCost<kWindowSize, kWindowStep>
-      <<<sweep_grid_size_, sweep_block_size_>>>(
-          *cost_map_, *depth_map_, *normal_map_, *ref_image_->sum_image,
-          *ref_image_->squared_sum_image, options_.sigma_spatial,
-          options_.sigma_color);
+  ComputeInitialCostMap<kWindowSize, kWindowStep, kThreadsPerBlock>(
+      source_maps);
   CUDA_SYNC_AND_CHECK();
 
   init_timer.Print("Initialization");
@@ -1318,20 +1563,25 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
 
       const bool last_sweep = iter == options_.num_iterations - 1 && sweep == 3;
 
-#define CALL_SWEEP_FUNC                                                  \
-  SweepFromTopToBottom<kWindowSize, kWindowStep, kGeomConsistencyTerm,   \
-                       kFilterPhotoConsistency, kFilterGeomConsistency>  \
-      <<<sweep_grid_size_, sweep_block_size_>>>(                         \
-          *global_workspace_, *rand_state_map_, *cost_map_, *depth_map_, \
-          *normal_map_, *consistency_mask_, *sel_prob_map_,              \
-          *prev_sel_prob_map_, *ref_image_->sum_image,                   \
+      const ProblemParams problem_params = GetProblemParams();
+
+#define CALL_SWEEP_FUNC                                                     \
+  SweepFromTopToBottom<kWindowSize, kWindowStep, kThreadsPerBlock, T,       \
+                       kGeomConsistencyTerm, kFilterPhotoConsistency,       \
+                       kFilterGeomConsistency>                              \
+      <<<sweep_grid_size_, sweep_block_size_>>>(                            \
+          problem_params, *global_workspace_, *rand_state_map_,             \
+          *source_maps->cost_map, *depth_map_, *normal_map_,                \
+          *consistency_mask_, *source_maps->sel_prob_map,                   \
+          *source_maps->prev_sel_prob_map, *ref_image_->sum_image,          \
           *ref_image_->squared_sum_image, sweep_options);
 
       if (last_sweep) {
         if (options_.filter) {
-          consistency_mask_.reset(new GpuMat<uint8_t>(cost_map_->GetWidth(),
-                                                      cost_map_->GetHeight(),
-                                                      cost_map_->GetDepth()));
+          consistency_mask_.reset(new GpuMat<uint32_t>(
+              source_maps->cost_map->GetWidth(),
+              source_maps->cost_map->GetHeight(),
+              (source_maps->cost_map->GetDepth() + 31) / 32));
           consistency_mask_->FillWithScalar(0);
         }
         if (options_.geom_consistency) {
@@ -1377,9 +1627,10 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
 
       // Rotate selected image map.
       if (last_sweep && options_.filter) {
-        std::unique_ptr<GpuMat<uint8_t>> rot_consistency_mask_(
-            new GpuMat<uint8_t>(cost_map_->GetWidth(), cost_map_->GetHeight(),
-                                cost_map_->GetDepth()));
+        std::unique_ptr<GpuMat<uint32_t>> rot_consistency_mask_(
+            new GpuMat<uint32_t>(source_maps->cost_map->GetWidth(),
+                                 source_maps->cost_map->GetHeight(),
+                                 consistency_mask_->GetDepth()));
         consistency_mask_->Rotate(rot_consistency_mask_.get());
         consistency_mask_.swap(rot_consistency_mask_);
       }
@@ -1394,10 +1645,11 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
 }
 
 void PatchMatchCuda::ComputeCudaConfig() {
-  sweep_block_size_.x = THREADS_PER_BLOCK;
+  sweep_block_size_.x = sweep_threads_per_block_;
   sweep_block_size_.y = 1;
   sweep_block_size_.z = 1;
-  sweep_grid_size_.x = (depth_map_->GetWidth() - 1) / THREADS_PER_BLOCK + 1;
+  sweep_grid_size_.x =
+      (depth_map_->GetWidth() - 1) / sweep_threads_per_block_ + 1;
   sweep_grid_size_.y = 1;
   sweep_grid_size_.z = 1;
 
@@ -1410,6 +1662,29 @@ void PatchMatchCuda::ComputeCudaConfig() {
   elem_wise_grid_size_.z = 1;
 }
 
+ProblemParams PatchMatchCuda::GetProblemParams() const {
+  ProblemParams params;
+  params.ref_image_texture =
+      ref_image_device_[rotation_in_half_pi_ % 2]->GetTexture();
+  params.src_images_texture = src_images_device_->GetTexture();
+  if (src_depth_maps_device_) {
+    params.src_depth_maps_texture = src_depth_maps_device_->GetTexture();
+  } else if (src_depth_maps_half_device_) {
+    params.src_depth_maps_texture = src_depth_maps_half_device_->GetTexture();
+  }
+  params.poses_texture = poses_device_[rotation_in_half_pi_]->GetTexture();
+  memcpy(params.ref_K, ref_K_host_[rotation_in_half_pi_], 4 * sizeof(float));
+  memcpy(params.ref_inv_K, ref_inv_K_host_[rotation_in_half_pi_],
+         4 * sizeof(float));
+  return params;
+}
+
+bool PatchMatchCuda::UseHalfPrecisionDepthMaps() const {
+  // Larger depths are not representable in half precision.
+  const float kMaxHalfPrecisionDepth = 65504.0f;
+  return options_.half_precision && options_.depth_max < kMaxHalfPrecisionDepth;
+}
+
 void PatchMatchCuda::InitRefImage() {
   const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
 
@@ -1424,18 +1699,15 @@ void PatchMatchCuda::InitRefImage() {
                      options_.window_step, options_.sigma_spatial,
                      options_.sigma_color);
 
-  ref_image_device_.reset(
-      new CudaArrayWrapper<uint8_t>(ref_width_, ref_height_, 1));
-  ref_image_device_->CopyFromGpuMat(*ref_image_->image);
-
-  // Create texture.
-  ref_image_texture.addressMode[0] = cudaAddressModeBorder;
-  ref_image_texture.addressMode[1] = cudaAddressModeBorder;
-  ref_image_texture.addressMode[2] = cudaAddressModeBorder;
-  ref_image_texture.filterMode = cudaFilterModePoint;
-  ref_image_texture.normalized = false;
-  CUDA_SAFE_CALL(
-      cudaBindTextureToArray(ref_image_texture, ref_image_device_->GetPtr()));
+  // Arrays for the reference image in its original and rotated orientation,
+  // which are reused for all sweeps.
+  ref_image_device_[0].reset(new CudaArrayWrapper<uint8_t>(
+      ref_width_, ref_height_, 1, cudaFilterModePoint,
+      cudaReadModeNormalizedFloat));
+  ref_image_device_[1].reset(new CudaArrayWrapper<uint8_t>(
+      ref_height_, ref_width_, 1, cudaFilterModePoint,
+      cudaReadModeNormalizedFloat));
+  ref_image_device_[0]->CopyFromGpuMat(*ref_image_->image);
 }
 
 void PatchMatchCuda::InitSourceImages() {
@@ -1462,27 +1734,15 @@ void PatchMatchCuda::InitSourceImages() {
         kDefaultValue);
     for (size_t i = 0; i < problem_.src_image_idxs.size(); ++i) {
       const Image& image = problem_.images->at(problem_.src_image_idxs[i]);
-      const Bitmap& bitmap = image.GetBitmap();
-      uint8_t* dest = src_images_host_data.data() + max_width * max_height * i;
-      for (size_t r = 0; r < image.GetHeight(); ++r) {
-        memcpy(dest, bitmap.GetScanline(r), image.GetWidth() * sizeof(uint8_t));
-        dest += max_width;
-      }
+      image.GetBitmap().CopyToRowMajorArray(
+          src_images_host_data.data() + max_width * max_height * i, max_width);
     }
 
     // Upload to device.
     src_images_device_.reset(new CudaArrayWrapper<uint8_t>(
-        max_width, max_height, problem_.src_image_idxs.size()));
+        max_width, max_height, problem_.src_image_idxs.size(),
+        cudaFilterModeLinear, cudaReadModeNormalizedFloat));
     src_images_device_->CopyToDevice(src_images_host_data.data());
-
-    // Create source images texture.
-    src_images_texture.addressMode[0] = cudaAddressModeBorder;
-    src_images_texture.addressMode[1] = cudaAddressModeBorder;
-    src_images_texture.addressMode[2] = cudaAddressModeBorder;
-    src_images_texture.filterMode = cudaFilterModeLinear;
-    src_images_texture.normalized = false;
-    CUDA_SAFE_CALL(cudaBindTextureToArray(src_images_texture,
-                                          src_images_device_->GetPtr()));
   }
 
   // Upload source depth maps to device.
@@ -1504,19 +1764,25 @@ void PatchMatchCuda::InitSourceImages() {
       }
     }
 
-    src_depth_maps_device_.reset(new CudaArrayWrapper<float>(
-        max_width, max_height, problem_.src_image_idxs.size()));
-    src_depth_maps_device_->CopyToDevice(src_depth_maps_host_data.data());
-
-    // Create source depth maps texture.
-    src_depth_maps_texture.addressMode[0] = cudaAddressModeBorder;
-    src_depth_maps_texture.addressMode[1] = cudaAddressModeBorder;
-    src_depth_maps_texture.addressMode[2] = cudaAddressModeBorder;
     // TODO: Check if linear interpolation improves results or not.
-    src_depth_maps_texture.filterMode = cudaFilterModePoint;
-    src_depth_maps_texture.normalized = false;
-    CUDA_SAFE_CALL(cudaBindTextureToArray(src_depth_maps_texture,
-                                          src_depth_maps_device_->GetPtr()));
+    if (UseHalfPrecisionDepthMaps()) {
+      std::vector<__half> src_depth_maps_half_host_data(
+          src_depth_maps_host_data.size());
+      for (size_t i = 0; i < src_depth_maps_host_data.size(); ++i) {
+        src_depth_maps_half_host_data[i] =
+            __float2half(src_depth_maps_host_data[i]);
+      }
+      src_depth_maps_half_device_.reset(new CudaArrayWrapper<__half>(
+          max_width, max_height, problem_.src_image_idxs.size(),
+          cudaFilterModePoint, cudaReadModeElementType));
+      src_depth_maps_half_device_->CopyToDevice(
+          src_depth_maps_half_host_data.data());
+    } else {
+      src_depth_maps_device_.reset(new CudaArrayWrapper<float>(
+          max_width, max_height, problem_.src_image_idxs.size(),
+          cudaFilterModePoint, cudaReadModeElementType));
+      src_depth_maps_device_->CopyToDevice(src_depth_maps_host_data.data());
+    }
   }
 }
 
@@ -1556,13 +1822,6 @@ void PatchMatchCuda::InitTransforms() {
     ref_inv_K_host_[i][3] = -ref_K_host_[i][3] / ref_K_host_[i][2];
   }
 
-  // Bind 0 degrees version to constant global memory.
-  CUDA_SAFE_CALL(cudaMemcpyToSymbol(ref_K, ref_K_host_[0], sizeof(float) * 4, 0,
-                                    cudaMemcpyHostToDevice));
-  CUDA_SAFE_CALL(cudaMemcpyToSymbol(ref_inv_K, ref_inv_K_host_[0],
-                                    sizeof(float) * 4, 0,
-                                    cudaMemcpyHostToDevice));
-
   //////////////////////////////////////////////////////////////////////////////
   // Generate rotated versions of camera poses.
   //////////////////////////////////////////////////////////////////////////////
@@ -1620,21 +1879,17 @@ void PatchMatchCuda::InitTransforms() {
 
     RotatePose(R_z90, rotated_R, rotated_T);
   }
-
-  poses_texture.addressMode[0] = cudaAddressModeBorder;
-  poses_texture.addressMode[1] = cudaAddressModeBorder;
-  poses_texture.addressMode[2] = cudaAddressModeBorder;
-  poses_texture.filterMode = cudaFilterModePoint;
-  poses_texture.normalized = false;
-  CUDA_SAFE_CALL(
-      cudaBindTextureToArray(poses_texture, poses_device_[0]->GetPtr()));
 }
 
 void PatchMatchCuda::InitWorkspaceMemory() {
   rand_state_map_.reset(new GpuMatPRNG(ref_width_, ref_height_));
 
   depth_map_.reset(new GpuMat<float>(ref_width_, ref_height_));
-  if (options_.geom_consistency) {
+  if (problem_.init_depth_map != nullptr) {
+    depth_map_->CopyToDevice(problem_.init_depth_map->GetPtr(),
+                             problem_.init_depth_map->GetWidth() *
+                                 sizeof(float));
+  } else if (options_.geom_consistency) {
     const DepthMap& init_depth_map =
         problem_.depth_maps->at(problem_.ref_image_idx);
     depth_map_->CopyToDevice(init_depth_map.GetPtr(),
@@ -1646,39 +1901,52 @@ void PatchMatchCuda::InitWorkspaceMemory() {
 
   normal_map_.reset(new GpuMat<float>(ref_width_, ref_height_, 3));
 
-  // Note that it is not necessary to keep the selection probability map in
-  // memory for all pixels. Theoretically, it is possible to incorporate
-  // the temporary selection probabilities in the global_workspace_.
-  // However, it is useful to keep the probabilities for the entire image
-  // in memory, so that it can be exported.
-  sel_prob_map_.reset(new GpuMat<float>(ref_width_, ref_height_,
-                                        problem_.src_image_idxs.size()));
-  prev_sel_prob_map_.reset(new GpuMat<float>(ref_width_, ref_height_,
-                                             problem_.src_image_idxs.size()));
-  prev_sel_prob_map_->FillWithScalar(0.5f);
-
-  cost_map_.reset(new GpuMat<float>(ref_width_, ref_height_,
-                                    problem_.src_image_idxs.size()));
+  if (options_.half_precision) {
+    InitSourceMaps(&source_maps_half_);
+  } else {
+    InitSourceMaps(&source_maps_);
+  }
 
   const int ref_max_dim = std::max(ref_width_, ref_height_);
   global_workspace_.reset(
       new GpuMat<float>(ref_max_dim, problem_.src_image_idxs.size(), 2));
 
-  consistency_mask_.reset(new GpuMat<uint8_t>(0, 0, 0));
+  consistency_mask_.reset(new GpuMat<uint32_t>(0, 0, 0));
 
   ComputeCudaConfig();
 
-  if (options_.geom_consistency) {
+  if (problem_.init_normal_map != nullptr) {
+    normal_map_->CopyToDevice(problem_.init_normal_map->GetPtr(),
+                              problem_.init_normal_map->GetWidth() *
+                                  sizeof(float));
+  } else if (options_.geom_consistency) {
     const NormalMap& init_normal_map =
         problem_.normal_maps->at(problem_.ref_image_idx);
     normal_map_->CopyToDevice(init_normal_map.GetPtr(),
                               init_normal_map.GetWidth() * sizeof(float));
   } else {
     InitNormalMap<<<elem_wise_grid_size_, elem_wise_block_size_>>>(
-        *normal_map_, *rand_state_map_);
+        GetProblemParams(), *normal_map_, *rand_state_map_);
   }
 }
 
+template <typename T>
+void PatchMatchCuda::InitSourceMaps(SourceMaps<T>* source_maps) {
+  // Note that it is not necessary to keep the selection probability map in
+  // memory for all pixels. Theoretically, it is possible to incorporate
+  // the temporary selection probabilities in the global_workspace_.
+  // However, it is useful to keep the probabilities for the entire image
+  // in memory, so that it can be exported.
+  source_maps->sel_prob_map.reset(new GpuMat<T>(
+      ref_width_, ref_height_, problem_.src_image_idxs.size()));
+  source_maps->prev_sel_prob_map.reset(new GpuMat<T>(
+      ref_width_, ref_height_, problem_.src_image_idxs.size()));
+  source_maps->prev_sel_prob_map->FillWithScalar(T(0.5f));
+
+  source_maps->cost_map.reset(new GpuMat<T>(ref_width_, ref_height_,
+                                            problem_.src_image_idxs.size()));
+}
+
 void PatchMatchCuda::Rotate() {
   rotation_in_half_pi_ = (rotation_in_half_pi_ + 1) % 4;
 
@@ -1729,43 +1997,37 @@ void PatchMatchCuda::Rotate() {
     ref_image_.swap(rotated_ref_image);
   }
 
-  // Bind rotated reference image to texture.
-  ref_image_device_.reset(new CudaArrayWrapper<uint8_t>(width, height, 1));
-  ref_image_device_->CopyFromGpuMat(*ref_image_->image);
-  CUDA_SAFE_CALL(cudaUnbindTexture(ref_image_texture));
-  CUDA_SAFE_CALL(
-      cudaBindTextureToArray(ref_image_texture, ref_image_device_->GetPtr()));
+  // Copy rotated reference image to the array of its texture.
+  ref_image_device_[rotation_in_half_pi_ % 2]->CopyFromGpuMat(
+      *ref_image_->image);
+
+  if (options_.half_precision) {
+    RotateSourceMaps(width, height, &source_maps_half_);
+  } else {
+    RotateSourceMaps(width, height, &source_maps_);
+  }
 
+  // Recompute Cuda configuration for rotated reference image.
+  ComputeCudaConfig();
+}
+
+template <typename T>
+void PatchMatchCuda::RotateSourceMaps(const size_t width, const size_t height,
+                                      SourceMaps<T>* source_maps) {
   // Rotate selection probability map.
-  prev_sel_prob_map_.reset(
-      new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
-  sel_prob_map_->Rotate(prev_sel_prob_map_.get());
-  sel_prob_map_.reset(
-      new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
+  source_maps->prev_sel_prob_map.reset(
+      new GpuMat<T>(width, height, problem_.src_image_idxs.size()));
+  source_maps->sel_prob_map->Rotate(source_maps->prev_sel_prob_map.get());
+  source_maps->sel_prob_map.reset(
+      new GpuMat<T>(width, height, problem_.src_image_idxs.size()));
 
   // Rotate cost map.
   {
-    std::unique_ptr<GpuMat<float>> rotated_cost_map(
-        new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
-    cost_map_->Rotate(rotated_cost_map.get());
-    cost_map_.swap(rotated_cost_map);
+    std::unique_ptr<GpuMat<T>> rotated_cost_map(
+        new GpuMat<T>(width, height, problem_.src_image_idxs.size()));
+    source_maps->cost_map->Rotate(rotated_cost_map.get());
+    source_maps->cost_map.swap(rotated_cost_map);
   }
-
-  // Rotate transformations.
-  CUDA_SAFE_CALL(cudaUnbindTexture(poses_texture));
-  CUDA_SAFE_CALL(cudaBindTextureToArray(
-      poses_texture, poses_device_[rotation_in_half_pi_]->GetPtr()));
-
-  // Rotate calibration.
-  CUDA_SAFE_CALL(cudaMemcpyToSymbol(ref_K, ref_K_host_[rotation_in_half_pi_],
-                                    sizeof(float) * 4, 0,
-                                    cudaMemcpyHostToDevice));
-  CUDA_SAFE_CALL(
-      cudaMemcpyToSymbol(ref_inv_K, ref_inv_K_host_[rotation_in_half_pi_],
-                         sizeof(float) * 4, 0, cudaMemcpyHostToDevice));
-
-  // Recompute Cuda configuration for rotated reference image.
-  ComputeCudaConfig();
 }
 
 }  // namespace mvs
@@ -36,6 +36,7 @@
 #include <memory>
 #include <vector>
 
+#include <cuda_fp16.h>
 #include <cuda_runtime.h>
 
 #include "mvs/cuda_array_wrapper.h"
@@ -50,6 +51,8 @@
 namespace colmap {
 namespace mvs {
 
+struct ProblemParams;
+
 class PatchMatchCuda {
  public:
   PatchMatchCuda(const PatchMatchOptions& options,
@@ -61,21 +64,56 @@ class PatchMatchCuda {
   DepthMap GetDepthMap() const;
   NormalMap GetNormalMap() const;
   Mat<float> GetSelProbMap() const;
-  std::vector<int> GetConsistentImageIdxs() const;
+  // The masks of the consistent source images of each pixel in the format of
+  // ConsistencyGraph.
+  std::vector<uint32_t> GetConsistencyMasks() const;
 
  private:
-  template <int kWindowSize, int kWindowStep>
-  void RunWithWindowSizeAndStep();
+  // The cost and selection probability maps of all source images, which are
+  // stored in single or in half precision.
+  template <typename T>
+  struct SourceMaps {
+    std::unique_ptr<GpuMat<T>> sel_prob_map;
+    std::unique_ptr<GpuMat<T>> prev_sel_prob_map;
+    std::unique_ptr<GpuMat<T>> cost_map;
+  };
+
+  template <int kWindowSize, int kWindowStep, typename T>
+  void RunWithWindowSizeAndStep(SourceMaps<T>* source_maps);
+  template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T>
+  void RunWithKernelConfig(SourceMaps<T>* source_maps);
+
+  // Returns the fastest number of threads per block of the sweep kernels on
+  // the current device, which is benchmarked once per device and window
+  // configuration and then read from the cache.
+  template <int kWindowSize, int kWindowStep, typename T>
+  int TuneSweepThreadsPerBlock(SourceMaps<T>* source_maps);
+
+  template <int kWindowSize, int kWindowStep, int kThreadsPerBlock, typename T>
+  void ComputeInitialCostMap(SourceMaps<T>* source_maps);
 
   void ComputeCudaConfig();
 
+  // Textures and calibration for the current rotation of the reference image,
+  // which are passed to the kernels of this problem.
+  ProblemParams GetProblemParams() const;
+
+  // Whether the source depth maps are stored in half precision, which is only
+  // possible if all depths are in the range of half precision numbers.
+  bool UseHalfPrecisionDepthMaps() const;
+
   void InitRefImage();
   void InitSourceImages();
   void InitTransforms();
   void InitWorkspaceMemory();
+  template <typename T>
+  void InitSourceMaps(SourceMaps<T>* source_maps);
 
   // Rotate reference image by 90 degrees in counter-clockwise direction.
   void Rotate();
+  template <typename T>
+  void RotateSourceMaps(const size_t width, const size_t height,
+                        SourceMaps<T>* source_maps);
 
   const PatchMatchOptions options_;
   const PatchMatch::Problem problem_;
@@ -95,10 +133,17 @@ class PatchMatchCuda {
   // calls to `rotate` mod 4.
   int rotation_in_half_pi_;
 
-  // Reference and source image input data.
-  std::unique_ptr<CudaArrayWrapper<uint8_t>> ref_image_device_;
+  // Number of threads per block of the sweep kernels, which is autotuned for
+  // the device and the window configuration.
+  int sweep_threads_per_block_;
+
+  // Reference and source image input data. The reference image is stored in
+  // its original and in its rotated orientation corresponding to
+  // rotation_in_half_pi_ % 2.
+  std::unique_ptr<CudaArrayWrapper<uint8_t>> ref_image_device_[2];
   std::unique_ptr<CudaArrayWrapper<uint8_t>> src_images_device_;
   std::unique_ptr<CudaArrayWrapper<float>> src_depth_maps_device_;
+  std::unique_ptr<CudaArrayWrapper<__half>> src_depth_maps_half_device_;
 
   // Relative poses from rotated versions of reference image to source images
   // corresponding to _rotationInHalfPi:
@@ -125,11 +170,12 @@ class PatchMatchCuda {
   std::unique_ptr<GpuMatRefImage> ref_image_;
   std::unique_ptr<GpuMat<float>> depth_map_;
   std::unique_ptr<GpuMat<float>> normal_map_;
-  std::unique_ptr<GpuMat<float>> sel_prob_map_;
-  std::unique_ptr<GpuMat<float>> prev_sel_prob_map_;
-  std::unique_ptr<GpuMat<float>> cost_map_;
+  // Only the source maps in the precision of the options are allocated.
+  SourceMaps<float> source_maps_;
+  SourceMaps<__half> source_maps_half_;
   std::unique_ptr<GpuMatPRNG> rand_state_map_;
-  std::unique_ptr<GpuMat<uint8_t>> consistency_mask_;
+  // Bit masks of the consistent source images with one slice per 32 images.
+  std::unique_ptr<GpuMat<uint32_t>> consistency_mask_;
 
   // Shared memory is too small to hold local state for each thread,
   // so this is workspace memory in global memory.
@@ -31,7 +31,9 @@
 
 #include "mvs/workspace.h"
 
+#include <fstream>
 #include <numeric>
+#include <sstream>
 
 #include "util/misc.h"
 
@@ -65,6 +67,7 @@ Workspace::Workspace(const Options& options)
              [](const int) { return CachedImage(); }) {
   StringToLower(&options_.input_type);
   model_.Read(options_.workspace_path, options_.workspace_format);
+  ReadUndistortionConfig();
   if (options_.max_image_size > 0) {
     for (auto& image : model_.images) {
       image.Downsize(options_.max_image_size, options_.max_image_size);
@@ -79,57 +82,143 @@ Workspace::Workspace(const Options& options)
 
 void Workspace::ClearCache() { cache_.Clear(); }
 
+void Workspace::EvictImage(const int image_idx) { cache_.Erase(image_idx); }
+
 const Workspace::Options& Workspace::GetOptions() const { return options_; }
 
 const Model& Workspace::GetModel() const { return model_; }
 
 const Bitmap& Workspace::GetBitmap(const int image_idx) {
+  return *GetBitmapPtr(image_idx);
+}
+
+const DepthMap& Workspace::GetDepthMap(const int image_idx) {
+  return *GetDepthMapPtr(image_idx);
+}
+
+const NormalMap& Workspace::GetNormalMap(const int image_idx) {
+  return *GetNormalMapPtr(image_idx);
+}
+
+std::shared_ptr<const Bitmap> Workspace::GetBitmapPtr(const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.bitmap) {
-    cached_image.bitmap.reset(new Bitmap());
-    cached_image.bitmap->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
-    if (options_.max_image_size > 0) {
-      cached_image.bitmap->Rescale(model_.images.at(image_idx).GetWidth(),
-                                   model_.images.at(image_idx).GetHeight());
-    }
+    cached_image.bitmap = ReadBitmap(image_idx);
     cached_image.num_bytes += cached_image.bitmap->NumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
-  return *cached_image.bitmap;
+  return cached_image.bitmap;
 }
 
-const DepthMap& Workspace::GetDepthMap(const int image_idx) {
+std::shared_ptr<const DepthMap> Workspace::GetDepthMapPtr(
+    const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.depth_map) {
-    cached_image.depth_map.reset(new DepthMap());
-    cached_image.depth_map->Read(GetDepthMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
-                                       model_.images.at(image_idx).GetHeight());
-    }
+    cached_image.depth_map = ReadDepthMap(image_idx);
     cached_image.num_bytes += cached_image.depth_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
-  return *cached_image.depth_map;
+  return cached_image.depth_map;
 }
 
-const NormalMap& Workspace::GetNormalMap(const int image_idx) {
+std::shared_ptr<const NormalMap> Workspace::GetNormalMapPtr(
+    const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
   if (!cached_image.normal_map) {
-    cached_image.normal_map.reset(new NormalMap());
-    cached_image.normal_map->Read(GetNormalMapPath(image_idx));
-    if (options_.max_image_size > 0) {
-      cached_image.normal_map->Downsize(
-          model_.images.at(image_idx).GetWidth(),
-          model_.images.at(image_idx).GetHeight());
-    }
+    cached_image.normal_map = ReadNormalMap(image_idx);
     cached_image.num_bytes += cached_image.normal_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
   }
-  return *cached_image.normal_map;
+  return cached_image.normal_map;
+}
+
+void Workspace::CacheMaps(const int image_idx, DepthMap depth_map,
+                          NormalMap normal_map) {
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (cached_image.depth_map) {
+    cached_image.num_bytes -= cached_image.depth_map->GetNumBytes();
+  }
+  if (cached_image.normal_map) {
+    cached_image.num_bytes -= cached_image.normal_map->GetNumBytes();
+  }
+  cached_image.depth_map.reset(new DepthMap(std::move(depth_map)));
+  cached_image.normal_map.reset(new NormalMap(std::move(normal_map)));
+  cached_image.num_bytes += cached_image.depth_map->GetNumBytes() +
+                            cached_image.normal_map->GetNumBytes();
+  cache_.UpdateNumBytes(image_idx);
+}
+
+void Workspace::Prefetch(const int image_idx, const bool read_maps,
+                         std::mutex* mutex) {
+  bool has_bitmap = false;
+  bool has_depth_map = !read_maps;
+  bool has_normal_map = !read_maps;
+
+  {
+    std::unique_lock<std::mutex> lock(*mutex);
+    if (cache_.Exists(image_idx)) {
+      const auto& cached_image = cache_.Get(image_idx);
+      has_bitmap = static_cast<bool>(cached_image.bitmap);
+      has_depth_map = has_depth_map || cached_image.depth_map;
+      has_normal_map = has_normal_map || cached_image.normal_map;
+    }
+  }
+
+  if (has_bitmap && has_depth_map && has_normal_map) {
+    return;
+  }
+
+  CachedImage prefetched_image;
+  if (!has_bitmap) {
+    prefetched_image.bitmap = ReadBitmap(image_idx);
+    prefetched_image.num_bytes += prefetched_image.bitmap->NumBytes();
+  }
+  if (!has_depth_map) {
+    prefetched_image.depth_map = ReadDepthMap(image_idx);
+    prefetched_image.num_bytes += prefetched_image.depth_map->GetNumBytes();
+  }
+  if (!has_normal_map) {
+    prefetched_image.normal_map = ReadNormalMap(image_idx);
+    prefetched_image.num_bytes += prefetched_image.normal_map->GetNumBytes();
+  }
+
+  std::unique_lock<std::mutex> lock(*mutex);
+
+  // Never evict other images, which might be needed earlier than this one.
+  if (cache_.NumBytes() + prefetched_image.num_bytes > cache_.MaxNumBytes()) {
+    return;
+  }
+
+  if (!cache_.Exists(image_idx)) {
+    cache_.Set(image_idx, std::move(prefetched_image));
+    return;
+  }
+
+  // The image might have been read by another thread in the meantime.
+  auto& cached_image = cache_.GetMutable(image_idx);
+  if (!cached_image.bitmap && prefetched_image.bitmap) {
+    cached_image.bitmap = std::move(prefetched_image.bitmap);
+    cached_image.num_bytes += cached_image.bitmap->NumBytes();
+  }
+  if (!cached_image.depth_map && prefetched_image.depth_map) {
+    cached_image.depth_map = std::move(prefetched_image.depth_map);
+    cached_image.num_bytes += cached_image.depth_map->GetNumBytes();
+  }
+  if (!cached_image.normal_map && prefetched_image.normal_map) {
+    cached_image.normal_map = std::move(prefetched_image.normal_map);
+    cached_image.num_bytes += cached_image.normal_map->GetNumBytes();
+  }
+  cache_.UpdateNumBytes(image_idx);
+}
+
+bool Workspace::IsUndistortingBitmaps() const {
+  return !distorted_image_paths_.empty();
 }
 
 std::string Workspace::GetBitmapPath(const int image_idx) const {
+  if (IsUndistortingBitmaps()) {
+    return distorted_image_paths_.at(image_idx);
+  }
   return model_.images.at(image_idx).GetPath();
 }
 
@@ -159,6 +248,140 @@ std::string Workspace::GetFileName(const int image_idx) const {
                       options_.input_type.c_str());
 }
 
+std::unique_ptr<Bitmap> Workspace::ReadBitmap(const int image_idx) {
+  std::unique_ptr<Bitmap> bitmap(new Bitmap());
+  bitmap->Read(GetBitmapPath(image_idx), options_.image_as_rgb);
+  if (IsUndistortingBitmaps()) {
+    bitmap = UndistortBitmap(image_idx, *bitmap);
+  }
+  if (options_.max_image_size > 0) {
+    std::unique_lock<std::mutex> lock(resample_mutex_);
+    bitmap->Downsize(model_.images.at(image_idx).GetWidth(),
+                     model_.images.at(image_idx).GetHeight());
+  }
+  return bitmap;
+}
+
+std::unique_ptr<DepthMap> Workspace::ReadDepthMap(const int image_idx) {
+  std::unique_ptr<DepthMap> depth_map(new DepthMap());
+  depth_map->Read(GetDepthMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    std::unique_lock<std::mutex> lock(resample_mutex_);
+    depth_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                        model_.images.at(image_idx).GetHeight());
+  }
+  return depth_map;
+}
+
+std::unique_ptr<NormalMap> Workspace::ReadNormalMap(const int image_idx) {
+  std::unique_ptr<NormalMap> normal_map(new NormalMap());
+  normal_map->Read(GetNormalMapPath(image_idx));
+  if (options_.max_image_size > 0) {
+    std::unique_lock<std::mutex> lock(resample_mutex_);
+    normal_map->Downsize(model_.images.at(image_idx).GetWidth(),
+                         model_.images.at(image_idx).GetHeight());
+  }
+  return normal_map;
+}
+
+void Workspace::ReadUndistortionConfig() {
+  const std::string config_path = JoinPaths(
+      options_.workspace_path, options_.stereo_folder, "undistortion.cfg");
+  auto workspace_format_lower_case = options_.workspace_format;
+  StringToLower(&workspace_format_lower_case);
+  if (workspace_format_lower_case != "colmap" || !ExistsFile(config_path)) {
+    return;
+  }
+
+  // The first line contains the path of the original images, followed by one
+  // line for each image in the format:
+  //    IMAGE_NAME CAMERA_ID MODEL WIDTH HEIGHT PARAMS[]
+  const auto lines = ReadTextFileLines(config_path);
+  CHECK(!lines.empty()) << config_path;
+  const std::string& image_path = lines[0];
+
+  const size_t num_images = model_.images.size();
+  distorted_image_paths_.resize(num_images);
+  camera_ids_.resize(num_images, kInvalidCameraId);
+  distorted_cameras_.resize(num_images);
+  undistorted_cameras_.resize(num_images);
+
+  for (size_t i = 1; i < lines.size(); ++i) {
+    std::stringstream line_stream(lines[i]);
+
+    std::string image_name;
+    camera_t camera_id;
+    std::string model_name;
+    size_t width;
+    size_t height;
+    line_stream >> image_name >> camera_id >> model_name >> width >> height;
+    CHECK(!line_stream.fail()) << config_path << ": " << lines[i];
+
+    const int image_idx = model_.GetImageIdx(image_name);
+    distorted_image_paths_[image_idx] = JoinPaths(image_path, image_name);
+    camera_ids_[image_idx] = camera_id;
+    num_camera_images_[camera_id] += 1;
+
+    Camera& distorted_camera = distorted_cameras_[image_idx];
+    CHECK(ExistsCameraModelWithName(model_name)) << model_name;
+    distorted_camera.SetModelIdFromName(model_name);
+    distorted_camera.SetWidth(width);
+    distorted_camera.SetHeight(height);
+    distorted_camera.Params().clear();
+    double param;
+    while (line_stream >> param) {
+      distorted_camera.Params().push_back(param);
+    }
+    CHECK(distorted_camera.VerifyParams()) << config_path << ": " << lines[i];
+
+    // The undistorted camera as read from the sparse model, before the model
+    // images are downsized to the maximum image size.
+    const auto& image = model_.images[image_idx];
+    const float* K = image.GetK();
+    Camera& undistorted_camera = undistorted_cameras_[image_idx];
+    undistorted_camera.SetModelIdFromName("PINHOLE");
+    undistorted_camera.SetWidth(image.GetWidth());
+    undistorted_camera.SetHeight(image.GetHeight());
+    undistorted_camera.Params() = {K[0], K[4], K[2], K[5]};
+  }
+
+  for (size_t image_idx = 0; image_idx < num_images; ++image_idx) {
+    CHECK_NE(camera_ids_[image_idx], kInvalidCameraId)
+        << "Missing image " << model_.GetImageName(image_idx) << " in "
+        << config_path;
+  }
+}
+
+std::unique_ptr<Bitmap> Workspace::UndistortBitmap(
+    const int image_idx, const Bitmap& distorted_bitmap) {
+  const camera_t camera_id = camera_ids_.at(image_idx);
+  const Camera& distorted_camera = distorted_cameras_.at(image_idx);
+  const Camera& undistorted_camera = undistorted_cameras_.at(image_idx);
+
+  std::unique_ptr<Bitmap> bitmap(new Bitmap());
+  if (num_camera_images_.at(camera_id) > 1) {
+    const WarpMap* warp_map = nullptr;
+    {
+      // The cached warp maps are never modified after their computation,
+      // so that they can be used without holding the lock.
+      std::unique_lock<std::mutex> lock(warp_maps_mutex_);
+      auto& cached_warp_map = warp_maps_[camera_id];
+      if (!cached_warp_map) {
+        cached_warp_map.reset(new WarpMap());
+        ComputeWarpMapBetweenCameras(distorted_camera, undistorted_camera,
+                                     cached_warp_map.get());
+      }
+      warp_map = cached_warp_map.get();
+    }
+    WarpImageWithMap(*warp_map, distorted_bitmap, bitmap.get());
+  } else {
+    WarpImageBetweenCameras(distorted_camera, undistorted_camera,
+                            distorted_bitmap, bitmap.get());
+  }
+
+  return bitmap;
+}
+
 void ImportPMVSWorkspace(const Workspace& workspace,
                          const std::string& option_name) {
   const std::string& workspace_path = workspace.GetOptions().workspace_path;
@@ -32,6 +32,12 @@
 #ifndef COLMAP_SRC_MVS_WORKSPACE_H_
 #define COLMAP_SRC_MVS_WORKSPACE_H_
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "base/camera.h"
+#include "base/warp.h"
 #include "mvs/consistency_graph.h"
 #include "mvs/depth_map.h"
 #include "mvs/model.h"
@@ -65,6 +71,10 @@ class Workspace {
 
   void ClearCache();
 
+  // Remove the data of an image from the cache, e.g., once it is not needed
+  // anymore, so that it does not evict the data of other images.
+  void EvictImage(const int image_idx);
+
   const Options& GetOptions() const;
 
   const Model& GetModel() const;
@@ -72,6 +82,31 @@ class Workspace {
   const DepthMap& GetDepthMap(const int image_idx);
   const NormalMap& GetNormalMap(const int image_idx);
 
+  // Get shared ownership of the data of an image, which remains valid even
+  // after the image is evicted from the cache. This allows to pin the data of
+  // a working set of images that is accessed concurrently.
+  std::shared_ptr<const Bitmap> GetBitmapPtr(const int image_idx);
+  std::shared_ptr<const DepthMap> GetDepthMapPtr(const int image_idx);
+  std::shared_ptr<const NormalMap> GetNormalMapPtr(const int image_idx);
+
+  // Insert the depth and normal map of an image into the cache, e.g., right
+  // after computing them, so that they are not read from disk again. Note
+  // that the maps must have the resolution of the image in the model.
+  void CacheMaps(const int image_idx, DepthMap depth_map,
+                 NormalMap normal_map);
+
+  // Read the bitmap and, optionally, the depth and normal map of an image into
+  // the cache ahead of time, unless they are already cached or they would
+  // exceed the cache size. All accesses to the cache are guarded by the given
+  // mutex, while the data is read from disk without holding it, so that other
+  // threads can concurrently access the workspace under the same mutex.
+  void Prefetch(const int image_idx, const bool read_maps, std::mutex* mutex);
+
+  // Whether the bitmaps are undistorted on the fly from the original images,
+  // as configured in "stereo/undistortion.cfg" of a COLMAP workspace that was
+  // created without writing the undistorted images.
+  bool IsUndistortingBitmaps() const;
+
   // Get paths to bitmap, depth map, normal map and consistency graph.
   std::string GetBitmapPath(const int image_idx) const;
   std::string GetDepthMapPath(const int image_idx) const;
@@ -85,6 +120,18 @@ class Workspace {
  private:
   std::string GetFileName(const int image_idx) const;
 
+  // Read the data of an image from disk and resize it to the model image.
+  std::unique_ptr<Bitmap> ReadBitmap(const int image_idx);
+  std::unique_ptr<DepthMap> ReadDepthMap(const int image_idx);
+  std::unique_ptr<NormalMap> ReadNormalMap(const int image_idx);
+
+  // Read the distorted cameras of the original images, if configured.
+  void ReadUndistortionConfig();
+
+  // Undistort the original bitmap of an image to the model image.
+  std::unique_ptr<Bitmap> UndistortBitmap(const int image_idx,
+                                          const Bitmap& distorted_bitmap);
+
   class CachedImage {
    public:
     CachedImage();
@@ -92,9 +139,9 @@ class Workspace {
     CachedImage& operator=(CachedImage&& other);
     size_t NumBytes() const;
     size_t num_bytes = 0;
-    std::unique_ptr<Bitmap> bitmap;
-    std::unique_ptr<DepthMap> depth_map;
-    std::unique_ptr<NormalMap> normal_map;
+    std::shared_ptr<Bitmap> bitmap;
+    std::shared_ptr<DepthMap> depth_map;
+    std::shared_ptr<NormalMap> normal_map;
 
    private:
     NON_COPYABLE(CachedImage)
@@ -105,6 +152,19 @@ class Workspace {
   MemoryConstrainedLRUCache<int, CachedImage> cache_;
   std::string depth_map_path_;
   std::string normal_map_path_;
+  // Only resample the data of one image at a time.
+  std::mutex resample_mutex_;
+
+  // The original image paths and the distorted and undistorted cameras of the
+  // images, if the bitmaps are undistorted on the fly. The warp maps are only
+  // cached for cameras that are shared by multiple images.
+  std::vector<std::string> distorted_image_paths_;
+  std::vector<camera_t> camera_ids_;
+  std::vector<Camera> distorted_cameras_;
+  std::vector<Camera> undistorted_cameras_;
+  std::unordered_map<camera_t, int> num_camera_images_;
+  std::unordered_map<camera_t, std::unique_ptr<WarpMap>> warp_maps_;
+  std::mutex warp_maps_mutex_;
 };
 
 // Import a PMVS workspace into the COLMAP workspace format. Only images in the
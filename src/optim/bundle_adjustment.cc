@@ -31,7 +31,9 @@
 
 #include "optim/bundle_adjustment.h"
 
+#include <cmath>
 #include <iomanip>
+#include <limits>
 
 #ifdef OPENMP_ENABLED
 #include <omp.h>
@@ -39,12 +41,310 @@
 
 #include "base/camera_models.h"
 #include "base/cost_functions.h"
+#include "base/database.h"
 #include "base/projection.h"
+#include "base/scene_clustering.h"
+#include "util/metrics.h"
 #include "util/misc.h"
 #include "util/threading.h"
 #include "util/timer.h"
+#include "util/trace.h"
 
 namespace colmap {
+namespace {
+
+// Export the size and the duration of the solved problem, see util/metrics.h.
+void RecordSolverMetrics(const ceres::Solver::Summary& summary) {
+  static MetricCounter& num_solves = GetMetricCounter(
+      "bundle_adjustment_solves_total", "Number of bundle adjustments");
+  static MetricGauge& num_residuals = GetMetricGauge(
+      "bundle_adjustment_num_residuals",
+      "Number of residuals of the last bundle adjustment");
+  static MetricGauge& final_cost =
+      GetMetricGauge("bundle_adjustment_final_cost",
+                     "Final cost of the last bundle adjustment");
+  static MetricHistogram& solve_time = GetMetricHistogram(
+      "bundle_adjustment_solve_seconds",
+      "Time spent in the solver per bundle adjustment",
+      GetDefaultDurationBuckets());
+  num_solves.Increment();
+  num_residuals.Set(summary.num_residuals);
+  final_cost.Set(summary.final_cost);
+  solve_time.Observe(summary.total_time_in_seconds);
+}
+
+// Estimate the number of non-zero blocks of the reduced camera system, where
+// every pair of images that observe the same point results in a block. The
+// squared number of observations per point is an upper bound, since pairs of
+// images often share multiple points.
+size_t EstimateNumSchurBlocks(
+    const std::unordered_map<point3D_t, size_t>& point3D_num_observations) {
+  size_t num_schur_blocks = 0;
+  for (const auto& point3D : point3D_num_observations) {
+    num_schur_blocks += point3D.second * point3D.second;
+  }
+  return num_schur_blocks;
+}
+
+// Select the linear solver, the preconditioner, and the number of threads from
+// a cost model of the reduced camera system with 6x6 blocks per image. The
+// dense solver factorizes the full system, the sparse solver factorizes the
+// non-zero blocks with an estimated fill-in that grows with the number of
+// images, and the iterative solver multiplies the Jacobian in every conjugate
+// gradient iteration. The cheapest solver whose memory fits into a fraction of
+// the available memory is chosen. Mixed precision solves factorize the chosen
+// direct solver's system in single precision.
+ceres::Solver::Options CreateSolverOptions(
+    const BundleAdjustmentOptions& options, const size_t num_images,
+    const size_t num_residuals, const size_t num_schur_blocks) {
+  ceres::Solver::Options solver_options = options.solver_options;
+
+  // Empirical constants of the cost model.
+  const double kBlockSize = 6;
+  const double kDenseSpeedup = 4;
+  const double kGpuDenseSpeedup = 50;
+  const double kNumConjugateGradientIterations = 50;
+  const double kMaxMemoryFraction = 0.5;
+  const double kMinNumCovisibleImagesForClusterJacobi = 50;
+  const int kNumMixedPrecisionRefinementIterations = 3;
+
+  const double dim = kBlockSize * std::max<size_t>(num_images, 1);
+  const double num_blocks = std::min(
+      static_cast<double>(num_images) * num_images, double(num_schur_blocks));
+  const double fill_in = std::max(1.0, std::log2(double(num_images)));
+
+  const double sparse_factor_size =
+      std::min(dim * dim / 2, fill_in * kBlockSize * kBlockSize * num_blocks);
+  const double sparse_flops = sparse_factor_size * sparse_factor_size / dim;
+  const double sparse_memory = 12 * sparse_factor_size;
+
+  bool use_gpu = false;
+#if CERES_VERSION_MAJOR > 2 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)
+  use_gpu = options.use_gpu &&
+            ceres::IsDenseLinearAlgebraLibraryTypeAvailable(ceres::CUDA);
+#endif  // CERES_VERSION_MAJOR
+  const double dense_flops =
+      dim * dim * dim / 3 / (use_gpu ? kGpuDenseSpeedup : kDenseSpeedup);
+  const double dense_memory = 8 * dim * dim;
+
+  // Every iteration multiplies the Jacobian blocks of the point and the pose
+  // of every residual with a vector twice.
+  const double iterative_flops =
+      kNumConjugateGradientIterations * 4 * 9 * num_residuals;
+
+  const size_t available_memory = GetAvailableMemory();
+  const double max_memory = available_memory > 0
+                                ? kMaxMemoryFraction * available_memory
+                                : std::numeric_limits<double>::max();
+
+  const bool has_sparse_solver =
+      ceres::IsSparseLinearAlgebraLibraryTypeAvailable(
+          solver_options.sparse_linear_algebra_library_type);
+
+  if (dense_memory <= max_memory &&
+      (dense_flops <= sparse_flops || !has_sparse_solver ||
+       sparse_memory > max_memory) &&
+      dense_flops <= iterative_flops) {
+    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
+#if CERES_VERSION_MAJOR > 2 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)
+    if (use_gpu) {
+      solver_options.dense_linear_algebra_library_type = ceres::CUDA;
+    }
+#endif  // CERES_VERSION_MAJOR
+  } else if (has_sparse_solver && sparse_memory <= max_memory &&
+             sparse_flops <= iterative_flops) {
+    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {
+    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
+    // The block diagonal of the reduced camera system is a poor approximation
+    // for strongly connected images, which are better preconditioned by
+    // clustering them.
+    const double num_covisible_images =
+        num_blocks / std::max<size_t>(num_images, 1);
+    if (num_covisible_images >= kMinNumCovisibleImagesForClusterJacobi &&
+        ceres::IsSparseLinearAlgebraLibraryTypeAvailable(ceres::SUITE_SPARSE)) {
+      solver_options.preconditioner_type = ceres::CLUSTER_JACOBI;
+      solver_options.sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
+    } else {
+      solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
+    }
+  }
+
+#if CERES_VERSION_MAJOR > 2 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)
+  // Ceres supports mixed precision sparse factorizations only for Eigen and
+  // Accelerate and mixed precision iterative solves not at all.
+  const bool has_mixed_precision_solver =
+      solver_options.linear_solver_type == ceres::DENSE_SCHUR ||
+      (solver_options.linear_solver_type == ceres::SPARSE_SCHUR &&
+       (solver_options.sparse_linear_algebra_library_type ==
+            ceres::EIGEN_SPARSE ||
+        solver_options.sparse_linear_algebra_library_type ==
+            ceres::ACCELERATE_SPARSE));
+  if (options.use_mixed_precision && has_mixed_precision_solver) {
+    solver_options.use_mixed_precision_solves = true;
+    solver_options.max_num_refinement_iterations =
+        kNumMixedPrecisionRefinementIterations;
+  }
+#endif  // CERES_VERSION_MAJOR
+
+  // Use one more thread per the minimum number of residuals for
+  // multi-threading, such that small problems avoid the threading overhead.
+  const size_t min_num_residuals_for_multi_threading = static_cast<size_t>(
+      std::max(options.min_num_residuals_for_multi_threading, 1));
+  int num_threads = 1;
+  if (num_residuals >= min_num_residuals_for_multi_threading) {
+    num_threads = static_cast<int>(std::min<size_t>(
+        GetEffectiveNumThreads(solver_options.num_threads),
+        1 + num_residuals / min_num_residuals_for_multi_threading));
+  }
+  solver_options.num_threads = num_threads;
+#if CERES_VERSION_MAJOR < 2
+  solver_options.num_linear_solver_threads = num_threads;
+#endif  // CERES_VERSION_MAJOR
+
+  return solver_options;
+}
+
+// Unique identifier of the observation of a 2D point in an image.
+uint64_t ObservationKey(const image_t image_id, const point2D_t point2D_idx) {
+  return (static_cast<uint64_t>(image_id) << 32) | point2D_idx;
+}
+
+// Accumulate the robustified normal equations of a residual with the Jacobian
+// w.r.t. the N parameters of an independent problem and return its cost.
+template <int N>
+double AccumulateNormalEquations(
+    const ceres::LossFunction& loss_function, const Eigen::Vector2d& residual,
+    const Eigen::Matrix<double, 2, N, Eigen::RowMajor>& J,
+    Eigen::Matrix<double, N, N>* H, Eigen::Matrix<double, N, 1>* g) {
+  double rho[3];
+  loss_function.Evaluate(residual.squaredNorm(), rho);
+  H->noalias() += rho[1] * J.transpose() * J;
+  g->noalias() += rho[1] * J.transpose() * residual;
+  return 0.5 * rho[0];
+}
+
+struct DecoupledProblemSummary {
+  int num_iterations = 0;
+  double initial_cost = 0;
+  double final_cost = 0;
+  bool converged = false;
+};
+
+// Minimize the cost of an independent problem with N parameters in the tangent
+// space using Levenberg-Marquardt. The evaluate function returns the cost of
+// the given parameters and sets the normal equations, and the plus function
+// applies a step to the parameters. The parameters are only updated, if the
+// initial cost is finite.
+template <int N, typename params_t, typename evaluate_t, typename plus_t>
+DecoupledProblemSummary SolveDecoupledProblem(
+    const ceres::Solver::Options& solver_options, const evaluate_t& Evaluate,
+    const plus_t& Plus, params_t* params) {
+  // The problems are small and converge within few iterations, so the
+  // tolerances of the solver options are bounded from below.
+  const double kMinTolerance = 1e-12;
+  const double kMinLambda = 1e-16;
+  const double kMaxLambda = 1e16;
+  const double kMinDiagonal = 1e-6;
+
+  const double function_tolerance =
+      std::max(solver_options.function_tolerance, kMinTolerance);
+  const double gradient_tolerance =
+      std::max(solver_options.gradient_tolerance, kMinTolerance);
+  const double parameter_tolerance =
+      std::max(solver_options.parameter_tolerance, kMinTolerance);
+
+  Eigen::Matrix<double, N, N> H;
+  Eigen::Matrix<double, N, 1> g;
+  DecoupledProblemSummary summary;
+  summary.initial_cost = Evaluate(*params, &H, &g);
+  summary.final_cost = summary.initial_cost;
+  if (!std::isfinite(summary.initial_cost)) {
+    return summary;
+  }
+
+  params_t new_params;
+  Eigen::Matrix<double, N, N> new_H;
+  Eigen::Matrix<double, N, 1> new_g;
+  double lambda = 1e-4;
+  while (summary.num_iterations < solver_options.max_num_iterations) {
+    if (g.template lpNorm<Eigen::Infinity>() <= gradient_tolerance) {
+      summary.converged = true;
+      break;
+    }
+
+    summary.num_iterations += 1;
+
+    Eigen::Matrix<double, N, N> H_damped = H;
+    H_damped.diagonal() += lambda * H.diagonal().cwiseMax(kMinDiagonal);
+    const Eigen::Matrix<double, N, 1> delta = -H_damped.ldlt().solve(g);
+    if (delta.norm() <=
+        parameter_tolerance * (params->norm() + parameter_tolerance)) {
+      summary.converged = true;
+      break;
+    }
+
+    Plus(*params, delta, &new_params);
+    const double new_cost = Evaluate(new_params, &new_H, &new_g);
+    if (std::isfinite(new_cost) && new_cost < summary.final_cost) {
+      const double cost_change = summary.final_cost - new_cost;
+      *params = new_params;
+      H = new_H;
+      g = new_g;
+      summary.final_cost = new_cost;
+      lambda = std::max(lambda / 10, kMinLambda);
+      if (cost_change <= function_tolerance * (new_cost + cost_change)) {
+        summary.converged = true;
+        break;
+      }
+    } else {
+      lambda *= 10;
+      if (lambda > kMaxLambda) {
+        summary.converged = true;
+        break;
+      }
+    }
+  }
+
+  return summary;
+}
+
+// Fill the solver summary of the decoupled problems, such that it can be
+// reported like the summary of a Ceres problem.
+void SetDecoupledSolverSummary(
+    const std::vector<DecoupledProblemSummary>& problem_summaries,
+    const size_t num_residuals, const size_t num_parameters,
+    const int num_threads, ceres::Solver::Summary* summary) {
+  *summary = ceres::Solver::Summary();
+  summary->linear_solver_type_used = ceres::DENSE_NORMAL_CHOLESKY;
+  summary->num_threads_used = num_threads;
+  summary->num_residuals = static_cast<int>(num_residuals);
+  summary->num_residuals_reduced = static_cast<int>(num_residuals);
+  summary->num_parameters = static_cast<int>(num_parameters);
+  summary->num_effective_parameters = static_cast<int>(num_parameters);
+  summary->num_parameters_reduced = static_cast<int>(num_parameters);
+  summary->num_effective_parameters_reduced = static_cast<int>(num_parameters);
+  summary->initial_cost = 0;
+  summary->final_cost = 0;
+  summary->termination_type = ceres::CONVERGENCE;
+  for (const auto& problem_summary : problem_summaries) {
+    summary->initial_cost += problem_summary.initial_cost;
+    summary->final_cost += problem_summary.final_cost;
+    // The problems are solved simultaneously, so the number of iterations is
+    // that of the slowest problem.
+    summary->num_successful_steps = std::max(summary->num_successful_steps,
+                                             problem_summary.num_iterations);
+    if (!problem_summary.converged) {
+      summary->termination_type = ceres::NO_CONVERGENCE;
+    }
+  }
+  summary->message = "Decoupled problems";
+}
+
+}  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjustmentOptions
@@ -69,6 +369,7 @@ ceres::LossFunction* BundleAdjustmentOptions::CreateLossFunction() const {
 
 bool BundleAdjustmentOptions::Check() const {
   CHECK_OPTION_GE(loss_function_scale, 0);
+  CHECK_OPTION_GT(prior_position_std, 0);
   return true;
 }
 
@@ -76,7 +377,7 @@ bool BundleAdjustmentOptions::Check() const {
 // BundleAdjustmentConfig
 ////////////////////////////////////////////////////////////////////////////////
 
-BundleAdjustmentConfig::BundleAdjustmentConfig() {}
+BundleAdjustmentConfig::BundleAdjustmentConfig() : has_point_subset_(false) {}
 
 size_t BundleAdjustmentConfig::NumImages() const { return image_ids_.size(); }
 
@@ -109,7 +410,16 @@ size_t BundleAdjustmentConfig::NumResiduals(
   // Count the number of observations for all added images.
   size_t num_observations = 0;
   for (const image_t image_id : image_ids_) {
-    num_observations += reconstruction.Image(image_id).NumPoints3D();
+    const Image& image = reconstruction.Image(image_id);
+    if (has_point_subset_) {
+      for (const Point2D& point2D : image.Points2D()) {
+        if (point2D.HasPoint3D() && IsPointInSubset(point2D.Point3DId())) {
+          num_observations += 1;
+        }
+      }
+    } else {
+      num_observations += image.NumPoints3D();
+    }
   }
 
   // Count the number of observations for all added 3D points that are not
@@ -245,6 +555,45 @@ void BundleAdjustmentConfig::RemoveConstantPoint(const point3D_t point3D_id) {
   constant_point3D_ids_.erase(point3D_id);
 }
 
+void BundleAdjustmentConfig::SetPointSubset(
+    const std::unordered_set<point3D_t>& point3D_ids) {
+  has_point_subset_ = true;
+  point_subset_ = point3D_ids;
+}
+
+bool BundleAdjustmentConfig::HasPointSubset() const {
+  return has_point_subset_;
+}
+
+bool BundleAdjustmentConfig::IsPointInSubset(
+    const point3D_t point3D_id) const {
+  return !has_point_subset_ || point_subset_.count(point3D_id) > 0;
+}
+
+const std::unordered_set<point3D_t>& BundleAdjustmentConfig::PointSubset()
+    const {
+  return point_subset_;
+}
+
+void BundleAdjustmentConfig::SetPositionPrior(const image_t image_id,
+                                              const Eigen::Vector3d& position) {
+  CHECK(HasImage(image_id));
+  position_priors_[image_id] = position;
+}
+
+bool BundleAdjustmentConfig::HasPositionPrior(const image_t image_id) const {
+  return position_priors_.find(image_id) != position_priors_.end();
+}
+
+const Eigen::Vector3d& BundleAdjustmentConfig::PositionPrior(
+    const image_t image_id) const {
+  return position_priors_.at(image_id);
+}
+
+size_t BundleAdjustmentConfig::NumPositionPriors() const {
+  return position_priors_.size();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjuster
 ////////////////////////////////////////////////////////////////////////////////
@@ -256,9 +605,20 @@ BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
 }
 
 bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
+  const TraceSpan trace_span("bundle_adjustment/solve");
+
   CHECK_NOTNULL(reconstruction);
   CHECK(!problem_) << "Cannot use the same BundleAdjuster multiple times";
 
+  if (HasConstantCameras(*reconstruction)) {
+    if (HasConstantPoses()) {
+      return SolveStructureOnly(reconstruction);
+    } else if (config_.NumPositionPriors() == 0 &&
+               !HasVariablePoints(*reconstruction)) {
+      return SolveMotionOnly(reconstruction);
+    }
+  }
+
   problem_.reset(new ceres::Problem());
 
   ceres::LossFunction* loss_function = options_.CreateLossFunction();
@@ -268,40 +628,19 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
     return false;
   }
 
-  ceres::Solver::Options solver_options = options_.solver_options;
-
-  // Empirical choice.
-  const size_t kMaxNumImagesDirectDenseSolver = 50;
-  const size_t kMaxNumImagesDirectSparseSolver = 1000;
-  const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
-    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver) {
-    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
-  } else {  // Indirect sparse (preconditioned CG) solver.
-    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
-    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
-  }
-
-  if (problem_->NumResiduals() <
-      options_.min_num_residuals_for_multi_threading) {
-    solver_options.num_threads = 1;
-#if CERES_VERSION_MAJOR < 2
-    solver_options.num_linear_solver_threads = 1;
-#endif  // CERES_VERSION_MAJOR
-  } else {
-    solver_options.num_threads =
-        GetEffectiveNumThreads(solver_options.num_threads);
-#if CERES_VERSION_MAJOR < 2
-    solver_options.num_linear_solver_threads =
-        GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
-#endif  // CERES_VERSION_MAJOR
-  }
+  ceres::Solver::Options solver_options = CreateSolverOptions(
+      options_, config_.NumImages(), problem_->NumResiduals(),
+      EstimateNumSchurBlocks(point3D_num_observations_));
 
   std::string solver_error;
   CHECK(solver_options.IsValid(&solver_error)) << solver_error;
 
-  ceres::Solve(solver_options, problem_.get(), &summary_);
+  {
+    const TraceSpan trace_span("ceres/solve");
+    ceres::Solve(solver_options, problem_.get(), &summary_);
+  }
+
+  RecordSolverMetrics(summary_);
 
   if (solver_options.minimizer_progress_to_stdout) {
     std::cout << std::endl;
@@ -325,9 +664,53 @@ void BundleAdjuster::SetUp(Reconstruction* reconstruction,
                            ceres::LossFunction* loss_function) {
   // Warning: AddPointsToProblem assumes that AddImageToProblem is called first.
   // Do not change order of instructions!
-  for (const image_t image_id : config_.Images()) {
-    AddImageToProblem(image_id, reconstruction, loss_function);
+  const std::vector<image_t> image_ids(config_.Images().begin(),
+                                       config_.Images().end());
+
+  size_t num_residuals = 0;
+  for (const image_t image_id : image_ids) {
+    num_residuals += 2 * reconstruction->Image(image_id).NumPoints3D();
+  }
+
+  int num_threads = GetEffectiveNumThreads(options_.solver_options.num_threads);
+  if (num_residuals <
+      static_cast<size_t>(options_.min_num_residuals_for_multi_threading)) {
+    num_threads = 1;
   }
+
+  if (num_threads == 1) {
+    for (const image_t image_id : image_ids) {
+      AddImageToProblem(image_id, reconstruction, loss_function);
+    }
+  } else {
+    // The cost functions are created in parallel, while the residual blocks
+    // must be added sequentially, since the problem is not thread-safe. The
+    // images are processed in batches to limit the number of cost functions
+    // that are not yet owned by the problem.
+    const size_t kBatchSize = 64 * static_cast<size_t>(num_threads);
+    std::vector<std::vector<ImageResidualBlock>> residual_blocks;
+    ThreadPool thread_pool(num_threads);
+    for (size_t batch_begin = 0; batch_begin < image_ids.size();
+         batch_begin += kBatchSize) {
+      const size_t batch_end =
+          std::min(batch_begin + kBatchSize, image_ids.size());
+      residual_blocks.clear();
+      residual_blocks.resize(batch_end - batch_begin);
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        thread_pool.AddTask([this, i, batch_begin, reconstruction,
+                             &image_ids, &residual_blocks]() {
+          CreateImageResidualBlocks(image_ids[i], reconstruction,
+                                    &residual_blocks[i - batch_begin]);
+        });
+      }
+      thread_pool.Wait();
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        AddImageResidualBlocks(image_ids[i], residual_blocks[i - batch_begin],
+                               reconstruction, loss_function);
+      }
+    }
+  }
+
   for (const auto point3D_id : config_.VariablePoints()) {
     AddPointToProblem(point3D_id, reconstruction, loss_function);
   }
@@ -335,6 +718,8 @@ void BundleAdjuster::SetUp(Reconstruction* reconstruction,
     AddPointToProblem(point3D_id, reconstruction, loss_function);
   }
 
+  AddPositionPriorsToProblem(reconstruction);
+
   ParameterizeCameras(reconstruction);
   ParameterizePoints(reconstruction);
 }
@@ -346,29 +731,31 @@ void BundleAdjuster::TearDown(Reconstruction*) {
 void BundleAdjuster::AddImageToProblem(const image_t image_id,
                                        Reconstruction* reconstruction,
                                        ceres::LossFunction* loss_function) {
+  std::vector<ImageResidualBlock> residual_blocks;
+  CreateImageResidualBlocks(image_id, reconstruction, &residual_blocks);
+  AddImageResidualBlocks(image_id, residual_blocks, reconstruction,
+                         loss_function);
+}
+
+void BundleAdjuster::CreateImageResidualBlocks(
+    const image_t image_id, Reconstruction* reconstruction,
+    std::vector<ImageResidualBlock>* residual_blocks) const {
   Image& image = reconstruction->Image(image_id);
-  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Camera& camera = reconstruction->Camera(image.CameraId());
 
   // CostFunction assumes unit quaternions.
   image.NormalizeQvec();
 
-  double* qvec_data = image.Qvec().data();
-  double* tvec_data = image.Tvec().data();
-  double* camera_params_data = camera.ParamsData();
-
   const bool constant_pose =
       !options_.refine_extrinsics || config_.HasConstantPose(image_id);
 
-  // Add residuals to bundle adjustment problem.
-  size_t num_observations = 0;
+  residual_blocks->reserve(image.NumPoints3D());
   for (const Point2D& point2D : image.Points2D()) {
-    if (!point2D.HasPoint3D()) {
+    if (!point2D.HasPoint3D() ||
+        !config_.IsPointInSubset(point2D.Point3DId())) {
       continue;
     }
 
-    num_observations += 1;
-    point3D_num_observations_[point2D.Point3DId()] += 1;
-
     Point3D& point3D = reconstruction->Point3D(point2D.Point3DId());
     assert(point3D.Track().Length() > 1);
 
@@ -387,9 +774,6 @@ void BundleAdjuster::AddImageToProblem(const image_t image_id,
 
 #undef CAMERA_MODEL_CASE
       }
-
-      problem_->AddResidualBlock(cost_function, loss_function,
-                                 point3D.XYZ().data(), camera_params_data);
     } else {
       switch (camera.ModelId()) {
 #define CAMERA_MODEL_CASE(CameraModel)                                   \
@@ -402,14 +786,46 @@ void BundleAdjuster::AddImageToProblem(const image_t image_id,
 
 #undef CAMERA_MODEL_CASE
       }
+    }
 
-      problem_->AddResidualBlock(cost_function, loss_function, qvec_data,
-                                 tvec_data, point3D.XYZ().data(),
+    ImageResidualBlock residual_block;
+    residual_block.cost_function = cost_function;
+    residual_block.point3D_id = point2D.Point3DId();
+    residual_block.point3D_data = point3D.XYZ().data();
+    residual_blocks->push_back(residual_block);
+  }
+}
+
+void BundleAdjuster::AddImageResidualBlocks(
+    const image_t image_id,
+    const std::vector<ImageResidualBlock>& residual_blocks,
+    Reconstruction* reconstruction, ceres::LossFunction* loss_function) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+
+  double* qvec_data = image.Qvec().data();
+  double* tvec_data = image.Tvec().data();
+  double* camera_params_data = camera.ParamsData();
+
+  const bool constant_pose =
+      !options_.refine_extrinsics || config_.HasConstantPose(image_id);
+
+  // Add residuals to bundle adjustment problem.
+  for (const auto& residual_block : residual_blocks) {
+    point3D_num_observations_[residual_block.point3D_id] += 1;
+    if (constant_pose) {
+      problem_->AddResidualBlock(residual_block.cost_function, loss_function,
+                                 residual_block.point3D_data,
+                                 camera_params_data);
+    } else {
+      problem_->AddResidualBlock(residual_block.cost_function, loss_function,
+                                 qvec_data, tvec_data,
+                                 residual_block.point3D_data,
                                  camera_params_data);
     }
   }
 
-  if (num_observations > 0) {
+  if (residual_blocks.size() > 0) {
     camera_ids_.insert(image.CameraId());
 
     // Set pose parameterization.
@@ -474,63 +890,870 @@ void BundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
 
 #undef CAMERA_MODEL_CASE
     }
-    problem_->AddResidualBlock(cost_function, loss_function,
-                               point3D.XYZ().data(), camera.ParamsData());
-  }
-}
-
-void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
-  const bool constant_camera = !options_.refine_focal_length &&
-                               !options_.refine_principal_point &&
-                               !options_.refine_extra_params;
-  for (const camera_t camera_id : camera_ids_) {
-    Camera& camera = reconstruction->Camera(camera_id);
-
-    if (constant_camera || config_.IsConstantCamera(camera_id)) {
-      problem_->SetParameterBlockConstant(camera.ParamsData());
-      continue;
-    } else {
-      std::vector<int> const_camera_params;
+    problem_->AddResidualBlock(cost_function, loss_function,
+                               point3D.XYZ().data(), camera.ParamsData());
+  }
+}
+
+void BundleAdjuster::AddPositionPriorsToProblem(
+    Reconstruction* reconstruction) {
+  if (!options_.refine_extrinsics || config_.NumPositionPriors() == 0) {
+    return;
+  }
+
+  const double weight = 1.0 / options_.prior_position_std;
+
+  for (const image_t image_id : config_.Images()) {
+    if (!config_.HasPositionPrior(image_id) ||
+        config_.HasConstantPose(image_id)) {
+      continue;
+    }
+
+    // Only constrain images with observations in the problem, since the
+    // rotation of the other images would not be observable.
+    Image& image = reconstruction->Image(image_id);
+    double* qvec_data = image.Qvec().data();
+    double* tvec_data = image.Tvec().data();
+    if (!problem_->HasParameterBlock(qvec_data)) {
+      continue;
+    }
+
+    ceres::CostFunction* cost_function = PositionPriorCostFunction::Create(
+        config_.PositionPrior(image_id), weight);
+    problem_->AddResidualBlock(cost_function, nullptr, qvec_data, tvec_data);
+  }
+}
+
+bool BundleAdjuster::HasConstantCameras(
+    const Reconstruction& reconstruction) const {
+  if (!options_.refine_focal_length && !options_.refine_principal_point &&
+      !options_.refine_extra_params) {
+    return true;
+  }
+  for (const image_t image_id : config_.Images()) {
+    if (!config_.IsConstantCamera(reconstruction.Image(image_id).CameraId())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BundleAdjuster::HasConstantPoses() const {
+  if (!options_.refine_extrinsics) {
+    return true;
+  }
+  for (const image_t image_id : config_.Images()) {
+    if (!config_.HasConstantPose(image_id)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BundleAdjuster::IsVariablePoint(
+    const point3D_t point3D_id, const Reconstruction& reconstruction) const {
+  if (config_.HasConstantPoint(point3D_id)) {
+    return false;
+  }
+
+  // The observations in the configured images are part of the problem, if the
+  // point is in the subset, and the other observations, if the point is
+  // explicitly added to the configuration, see `AddPointToProblem`.
+  const bool is_in_subset = config_.IsPointInSubset(point3D_id);
+  const bool has_variable_point = config_.HasVariablePoint(point3D_id);
+  for (const auto& track_el :
+       reconstruction.Point3D(point3D_id).Track().Elements()) {
+    if (config_.HasImage(track_el.image_id) ? !is_in_subset
+                                            : !has_variable_point) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BundleAdjuster::HasVariablePoints(
+    const Reconstruction& reconstruction) const {
+  for (const point3D_t point3D_id : config_.VariablePoints()) {
+    if (IsVariablePoint(point3D_id, reconstruction)) {
+      return true;
+    }
+  }
+  for (const image_t image_id : config_.Images()) {
+    for (const Point2D& point2D : reconstruction.Image(image_id).Points2D()) {
+      if (point2D.HasPoint3D() &&
+          IsVariablePoint(point2D.Point3DId(), reconstruction)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool BundleAdjuster::SolveStructureOnly(Reconstruction* reconstruction) {
+  const TraceSpan trace_span("bundle_adjustment/solve_structure_only");
+
+  Timer timer;
+  timer.Start();
+
+  // Collect the variable points, whose observations form the residuals.
+  std::unordered_set<point3D_t> point3D_ids_set;
+  size_t num_observations = 0;
+  for (const image_t image_id : config_.Images()) {
+    // CostFunction assumes unit quaternions.
+    Image& image = reconstruction->Image(image_id);
+    image.NormalizeQvec();
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D() &&
+          config_.IsPointInSubset(point2D.Point3DId())) {
+        point3D_ids_set.insert(point2D.Point3DId());
+        num_observations += 1;
+      }
+    }
+  }
+
+  for (const point3D_t point3D_id : config_.VariablePoints()) {
+    point3D_ids_set.insert(point3D_id);
+    for (const auto& track_el :
+         reconstruction->Point3D(point3D_id).Track().Elements()) {
+      if (!config_.HasImage(track_el.image_id)) {
+        num_observations += 1;
+      }
+    }
+  }
+
+  if (num_observations == 0) {
+    return false;
+  }
+
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(point3D_ids_set.size());
+  size_t num_residuals = 0;
+  for (const point3D_t point3D_id : point3D_ids_set) {
+    if (IsVariablePoint(point3D_id, *reconstruction)) {
+      point3D_ids.push_back(point3D_id);
+      num_residuals += 2 * reconstruction->Point3D(point3D_id).Track().Length();
+    }
+  }
+
+  int num_threads = GetEffectiveNumThreads(options_.solver_options.num_threads);
+  if (num_residuals <
+      static_cast<size_t>(options_.min_num_residuals_for_multi_threading)) {
+    num_threads = 1;
+  }
+
+  const std::unique_ptr<ceres::LossFunction> loss_function(
+      options_.CreateLossFunction());
+
+  std::vector<DecoupledProblemSummary> problem_summaries(point3D_ids.size());
+  ParallelFor(
+      num_threads, 0, point3D_ids.size(),
+      [&](const size_t begin, const size_t end) {
+        std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions;
+        std::vector<const double*> camera_params;
+        for (size_t i = begin; i < end; ++i) {
+          Point3D& point3D = reconstruction->Point3D(point3D_ids[i]);
+
+          cost_functions.clear();
+          camera_params.clear();
+          for (const auto& track_el : point3D.Track().Elements()) {
+            const Image& image = reconstruction->Image(track_el.image_id);
+            const Camera& camera = reconstruction->Camera(image.CameraId());
+            const Point2D& point2D = image.Point2D(track_el.point2D_idx);
+
+            ceres::CostFunction* cost_function = nullptr;
+
+            switch (camera.ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                                 \
+  case CameraModel::kModelId:                                          \
+    cost_function =                                                    \
+        BundleAdjustmentConstantPoseCostFunction<CameraModel>::Create( \
+            image.Qvec(), image.Tvec(), point2D.XY());                 \
+    break;
+
+              CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+            }
+
+            cost_functions.emplace_back(cost_function);
+            camera_params.push_back(camera.ParamsData());
+          }
+
+          const auto Evaluate = [&](const Eigen::Vector3d& xyz,
+                                    Eigen::Matrix3d* H, Eigen::Vector3d* g) {
+            H->setZero();
+            g->setZero();
+            double cost = 0;
+            Eigen::Vector2d residual;
+            Eigen::Matrix<double, 2, 3, Eigen::RowMajor> J;
+            double* jacobians[2] = {J.data(), nullptr};
+            for (size_t j = 0; j < cost_functions.size(); ++j) {
+              const double* parameters[2] = {xyz.data(), camera_params[j]};
+              cost_functions[j]->Evaluate(parameters, residual.data(),
+                                          jacobians);
+              cost += AccumulateNormalEquations<3>(*loss_function, residual,
+                                                   J, H, g);
+            }
+            return cost;
+          };
+
+          const auto Plus = [](const Eigen::Vector3d& xyz,
+                               const Eigen::Vector3d& delta,
+                               Eigen::Vector3d* new_xyz) {
+            *new_xyz = xyz + delta;
+          };
+
+          Eigen::Vector3d xyz = point3D.XYZ();
+          problem_summaries[i] = SolveDecoupledProblem<3>(
+              options_.solver_options, Evaluate, Plus, &xyz);
+          point3D.XYZ() = xyz;
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC);
+
+  SetDecoupledSolverSummary(problem_summaries, num_residuals,
+                            3 * point3D_ids.size(), num_threads, &summary_);
+  summary_.total_time_in_seconds = timer.ElapsedSeconds();
+
+  RecordSolverMetrics(summary_);
+
+  if (options_.print_summary) {
+    PrintHeading2("Bundle adjustment report (structure-only)");
+    PrintSolverSummary(summary_);
+  }
+
+  return true;
+}
+
+bool BundleAdjuster::SolveMotionOnly(Reconstruction* reconstruction) {
+  const TraceSpan trace_span("bundle_adjustment/solve_motion_only");
+
+  Timer timer;
+  timer.Start();
+
+  // Collect the images with variable pose, whose observations of the constant
+  // points form the residuals.
+  std::vector<image_t> image_ids;
+  size_t num_observations = 0;
+  size_t num_residuals = 0;
+  size_t num_parameters = 0;
+  for (const image_t image_id : config_.Images()) {
+    Image& image = reconstruction->Image(image_id);
+    size_t num_image_observations = 0;
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D() &&
+          config_.IsPointInSubset(point2D.Point3DId())) {
+        num_image_observations += 1;
+      }
+    }
+
+    num_observations += num_image_observations;
+    if (num_image_observations > 0 && !config_.HasConstantPose(image_id)) {
+      // CostFunction assumes unit quaternions.
+      image.NormalizeQvec();
+      image_ids.push_back(image_id);
+      num_residuals += 2 * num_image_observations;
+      num_parameters += 6;
+      if (config_.HasConstantTvec(image_id)) {
+        num_parameters -= config_.ConstantTvec(image_id).size();
+      }
+    }
+  }
+
+  if (num_observations == 0) {
+    return false;
+  }
+
+  int num_threads = GetEffectiveNumThreads(options_.solver_options.num_threads);
+  if (num_residuals <
+      static_cast<size_t>(options_.min_num_residuals_for_multi_threading)) {
+    num_threads = 1;
+  }
+
+  const std::unique_ptr<ceres::LossFunction> loss_function(
+      options_.CreateLossFunction());
+
+  typedef Eigen::Matrix<double, 6, 1> Vector6d;
+  typedef Eigen::Matrix<double, 7, 1> Vector7d;
+
+  std::vector<DecoupledProblemSummary> problem_summaries(image_ids.size());
+  ParallelFor(
+      num_threads, 0, image_ids.size(),
+      [&](const size_t begin, const size_t end) {
+        const ceres::QuaternionParameterization quaternion_parameterization;
+        std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions;
+        std::vector<const double*> point3D_data;
+        for (size_t i = begin; i < end; ++i) {
+          Image& image = reconstruction->Image(image_ids[i]);
+          const Camera& camera = reconstruction->Camera(image.CameraId());
+          const double* camera_params = camera.ParamsData();
+
+          cost_functions.clear();
+          point3D_data.clear();
+          for (const Point2D& point2D : image.Points2D()) {
+            if (!point2D.HasPoint3D() ||
+                !config_.IsPointInSubset(point2D.Point3DId())) {
+              continue;
+            }
+
+            ceres::CostFunction* cost_function = nullptr;
+
+            switch (camera.ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                                   \
+  case CameraModel::kModelId:                                            \
+    cost_function =                                                      \
+        BundleAdjustmentCostFunction<CameraModel>::Create(point2D.XY()); \
+    break;
+
+              CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+            }
+
+            cost_functions.emplace_back(cost_function);
+            point3D_data.push_back(
+                reconstruction->Point3D(point2D.Point3DId()).XYZ().data());
+          }
+
+          // The parameters are the quaternion and the translation, and the
+          // tangent space is spanned by the rotation and the translation,
+          // except for the constant components of the translation.
+          std::vector<int> constant_tvec_idxs;
+          if (config_.HasConstantTvec(image_ids[i])) {
+            constant_tvec_idxs = config_.ConstantTvec(image_ids[i]);
+          }
+
+          const auto Evaluate = [&](const Vector7d& pose,
+                                    Eigen::Matrix<double, 6, 6>* H,
+                                    Vector6d* g) {
+            H->setZero();
+            g->setZero();
+            Eigen::Matrix<double, 4, 3, Eigen::RowMajor> J_qvec_local;
+            quaternion_parameterization.ComputeJacobian(pose.data(),
+                                                        J_qvec_local.data());
+            double cost = 0;
+            Eigen::Vector2d residual;
+            Eigen::Matrix<double, 2, 4, Eigen::RowMajor> J_qvec;
+            Eigen::Matrix<double, 2, 3, Eigen::RowMajor> J_tvec;
+            Eigen::Matrix<double, 2, 6, Eigen::RowMajor> J;
+            double* jacobians[4] = {J_qvec.data(), J_tvec.data(), nullptr,
+                                    nullptr};
+            for (size_t j = 0; j < cost_functions.size(); ++j) {
+              const double* parameters[4] = {pose.data(), pose.data() + 4,
+                                             point3D_data[j], camera_params};
+              cost_functions[j]->Evaluate(parameters, residual.data(),
+                                          jacobians);
+              J.leftCols<3>() = J_qvec * J_qvec_local;
+              J.rightCols<3>() = J_tvec;
+              for (const int idx : constant_tvec_idxs) {
+                J.col(3 + idx).setZero();
+              }
+              cost += AccumulateNormalEquations<6>(*loss_function, residual,
+                                                   J, H, g);
+            }
+            return cost;
+          };
+
+          const auto Plus = [&](const Vector7d& pose, const Vector6d& delta,
+                                Vector7d* new_pose) {
+            quaternion_parameterization.Plus(pose.data(), delta.data(),
+                                             new_pose->data());
+            new_pose->tail<3>() = pose.tail<3>() + delta.tail<3>();
+            for (const int idx : constant_tvec_idxs) {
+              (*new_pose)(4 + idx) = pose(4 + idx);
+            }
+          };
+
+          Vector7d pose;
+          pose << image.Qvec(), image.Tvec();
+          problem_summaries[i] = SolveDecoupledProblem<6>(
+              options_.solver_options, Evaluate, Plus, &pose);
+          image.Qvec() = pose.head<4>();
+          image.Tvec() = pose.tail<3>();
+        }
+      },
+      ThreadPool::Schedule::DYNAMIC);
+
+  SetDecoupledSolverSummary(problem_summaries, num_residuals, num_parameters,
+                            num_threads, &summary_);
+  summary_.total_time_in_seconds = timer.ElapsedSeconds();
+
+  RecordSolverMetrics(summary_);
+
+  if (options_.print_summary) {
+    PrintHeading2("Bundle adjustment report (motion-only)");
+    PrintSolverSummary(summary_);
+  }
+
+  return true;
+}
+
+void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  for (const camera_t camera_id : camera_ids_) {
+    Camera& camera = reconstruction->Camera(camera_id);
+
+    if (constant_camera || config_.IsConstantCamera(camera_id)) {
+      problem_->SetParameterBlockConstant(camera.ParamsData());
+      continue;
+    } else {
+      std::vector<int> const_camera_params;
+
+      if (!options_.refine_focal_length) {
+        const std::vector<size_t>& params_idxs = camera.FocalLengthIdxs();
+        const_camera_params.insert(const_camera_params.end(),
+                                   params_idxs.begin(), params_idxs.end());
+      }
+      if (!options_.refine_principal_point) {
+        const std::vector<size_t>& params_idxs = camera.PrincipalPointIdxs();
+        const_camera_params.insert(const_camera_params.end(),
+                                   params_idxs.begin(), params_idxs.end());
+      }
+      if (!options_.refine_extra_params) {
+        const std::vector<size_t>& params_idxs = camera.ExtraParamsIdxs();
+        const_camera_params.insert(const_camera_params.end(),
+                                   params_idxs.begin(), params_idxs.end());
+      }
+
+      if (const_camera_params.size() > 0) {
+        ceres::SubsetParameterization* camera_params_parameterization =
+            new ceres::SubsetParameterization(
+                static_cast<int>(camera.NumParams()), const_camera_params);
+        problem_->SetParameterization(camera.ParamsData(),
+                                      camera_params_parameterization);
+      }
+    }
+  }
+}
+
+void BundleAdjuster::ParameterizePoints(Reconstruction* reconstruction) {
+  for (const auto elem : point3D_num_observations_) {
+    Point3D& point3D = reconstruction->Point3D(elem.first);
+    if (point3D.Track().Length() > elem.second) {
+      problem_->SetParameterBlockConstant(point3D.XYZ().data());
+    }
+  }
+
+  for (const point3D_t point3D_id : config_.ConstantPoints()) {
+    Point3D& point3D = reconstruction->Point3D(point3D_id);
+    problem_->SetParameterBlockConstant(point3D.XYZ().data());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// IncrementalBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+IncrementalBundleAdjuster::IncrementalBundleAdjuster(
+    const BundleAdjustmentOptions& options, const bool warm_start)
+    : options_(options),
+      warm_start_(warm_start),
+      setup_time_(0),
+      trust_region_radius_(0),
+      num_added_residual_blocks_(0),
+      num_removed_residual_blocks_(0) {
+  CHECK(options_.Check());
+  loss_function_.reset(options_.CreateLossFunction());
+  ceres::Problem::Options problem_options;
+  // The loss function is shared by the residual blocks of all calls.
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  problem_options.enable_fast_removal = true;
+  problem_.reset(new ceres::Problem(problem_options));
+}
+
+bool IncrementalBundleAdjuster::Solve(const BundleAdjustmentConfig& config,
+                                      Reconstruction* reconstruction) {
+  const TraceSpan trace_span("bundle_adjustment/incremental_solve");
+
+  CHECK_NOTNULL(reconstruction);
+
+  Timer timer;
+  timer.Start();
+
+  summary_ = ceres::Solver::Summary();
+  num_added_residual_blocks_ = 0;
+  num_removed_residual_blocks_ = 0;
+
+  // Cameras that are only observed through the tracks of the configured points
+  // are set constant, as in `BundleAdjuster`.
+  BundleAdjustmentConfig solve_config = config;
+
+  // Determine the observations of the problem in the same way as
+  // `BundleAdjuster::SetUp`, with the information whether their pose is
+  // constant.
+  std::unordered_map<uint64_t, bool> observations;
+  std::unordered_map<point3D_t, size_t> point3D_num_observations;
+  std::unordered_set<camera_t> camera_ids;
+
+  for (const image_t image_id : solve_config.Images()) {
+    Image& image = reconstruction->Image(image_id);
+
+    // CostFunction assumes unit quaternions. Quaternions are only normalized
+    // if necessary, such that rounding errors do not change constant poses
+    // and thereby outdate their residual blocks.
+    const double kMaxQvecNormError = 1e-12;
+    if (std::abs(image.Qvec().norm() - 1.0) > kMaxQvecNormError) {
+      image.NormalizeQvec();
+    }
+
+    const bool constant_pose =
+        !options_.refine_extrinsics || solve_config.HasConstantPose(image_id);
+
+    size_t num_observations = 0;
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (!point2D.HasPoint3D()) {
+        continue;
+      }
+      num_observations += 1;
+      point3D_num_observations[point2D.Point3DId()] += 1;
+      observations.emplace(ObservationKey(image_id, point2D_idx),
+                           constant_pose);
+    }
+
+    if (num_observations > 0) {
+      camera_ids.insert(image.CameraId());
+    }
+  }
+
+  const auto AddPointObservations = [&](const point3D_t point3D_id) {
+    const Point3D& point3D = reconstruction->Point3D(point3D_id);
+    if (point3D_num_observations[point3D_id] == point3D.Track().Length()) {
+      return;
+    }
+    for (const auto& track_el : point3D.Track().Elements()) {
+      if (solve_config.HasImage(track_el.image_id)) {
+        continue;
+      }
+      point3D_num_observations[point3D_id] += 1;
+      const Image& image = reconstruction->Image(track_el.image_id);
+      if (camera_ids.count(image.CameraId()) == 0) {
+        camera_ids.insert(image.CameraId());
+        solve_config.SetConstantCamera(image.CameraId());
+      }
+      observations.emplace(
+          ObservationKey(track_el.image_id, track_el.point2D_idx), true);
+    }
+  };
+
+  for (const auto point3D_id : solve_config.VariablePoints()) {
+    AddPointObservations(point3D_id);
+  }
+  for (const auto point3D_id : solve_config.ConstantPoints()) {
+    AddPointObservations(point3D_id);
+  }
+
+  // Forget the recorded poses that changed since the previous call, such that
+  // the residual blocks of these images are recreated.
+  std::unordered_set<image_t> changed_pose_image_ids;
+  for (auto it = constant_poses_.begin(); it != constant_poses_.end();) {
+    if (it->second != reconstruction->Image(it->first).ProjectionMatrix()) {
+      changed_pose_image_ids.insert(it->first);
+      it = constant_poses_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Remove the residual blocks of observations that are not part of the
+  // problem anymore or whose point, pose, or parameterization changed.
+  for (auto it = residual_blocks_.begin(); it != residual_blocks_.end();) {
+    const image_t image_id = static_cast<image_t>(it->first >> 32);
+    const point2D_t point2D_idx = static_cast<point2D_t>(it->first);
+    const ResidualBlock& residual_block = it->second;
+
+    const auto observation = observations.find(it->first);
+    bool outdated = observation == observations.end() ||
+                    observation->second != residual_block.constant_pose ||
+                    reconstruction->Image(image_id)
+                            .Point2D(point2D_idx)
+                            .Point3DId() != residual_block.point3D_id;
+    if (!outdated && residual_block.constant_pose) {
+      outdated = changed_pose_image_ids.count(image_id) > 0;
+    } else if (!outdated) {
+      const std::vector<int> constant_tvec_idxs =
+          solve_config.HasConstantTvec(image_id)
+              ? solve_config.ConstantTvec(image_id)
+              : std::vector<int>();
+      outdated =
+          pose_blocks_.at(image_id).constant_tvec_idxs != constant_tvec_idxs;
+    }
+
+    if (outdated) {
+      RemoveResidualBlock(image_id, residual_block);
+      it = residual_blocks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Remove the parameter blocks without residual blocks. This must precede
+  // adding new residual blocks, since a new 3D point may reuse the memory of
+  // a deleted 3D point whose parameter block is still in the problem.
+  for (auto it = point3D_blocks_.begin(); it != point3D_blocks_.end();) {
+    if (it->second.num_residual_blocks == 0) {
+      problem_->RemoveParameterBlock(it->second.data);
+      ordering_.Remove(it->second.data);
+      it = point3D_blocks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto it = pose_blocks_.begin(); it != pose_blocks_.end();) {
+    if (it->second.num_residual_blocks == 0) {
+      Image& image = reconstruction->Image(it->first);
+      problem_->RemoveParameterBlock(image.Qvec().data());
+      problem_->RemoveParameterBlock(image.Tvec().data());
+      ordering_.Remove(image.Qvec().data());
+      ordering_.Remove(image.Tvec().data());
+      it = pose_blocks_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Add the residual blocks of all new observations.
+  for (const auto& observation : observations) {
+    if (residual_blocks_.count(observation.first) == 0) {
+      AddResidualBlock(static_cast<image_t>(observation.first >> 32),
+                       static_cast<point2D_t>(observation.first),
+                       observation.second, solve_config, reconstruction);
+    }
+  }
+
+  // The constant parameters depend on the configuration and are therefore
+  // updated in every call.
+
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  for (const camera_t camera_id : camera_ids_) {
+    double* params_data = reconstruction->Camera(camera_id).ParamsData();
+    if (constant_camera || camera_ids.count(camera_id) == 0 ||
+        solve_config.IsConstantCamera(camera_id)) {
+      problem_->SetParameterBlockConstant(params_data);
+    } else {
+      problem_->SetParameterBlockVariable(params_data);
+    }
+  }
+
+  for (const auto& point3D_block : point3D_blocks_) {
+    const point3D_t point3D_id = point3D_block.first;
+    const Point3D& point3D = reconstruction->Point3D(point3D_id);
+    if (solve_config.HasConstantPoint(point3D_id) ||
+        point3D.Track().Length() > point3D_num_observations.at(point3D_id)) {
+      problem_->SetParameterBlockConstant(point3D_block.second.data);
+    } else {
+      problem_->SetParameterBlockVariable(point3D_block.second.data);
+    }
+  }
+
+  setup_time_ = timer.ElapsedSeconds();
+
+  if (problem_->NumResiduals() == 0) {
+    return false;
+  }
+
+  ceres::Solver::Options solver_options = CreateSolverOptions(
+      options_, solve_config.NumImages(), problem_->NumResiduals(),
+      EstimateNumSchurBlocks(point3D_num_observations));
+
+  // Ceres removes the constant parameter blocks from the given ordering, so
+  // every call gets a copy.
+  solver_options.linear_solver_ordering =
+      std::make_shared<ceres::ParameterBlockOrdering>(ordering_);
+
+  if (warm_start_ && trust_region_radius_ > 0) {
+    solver_options.initial_trust_region_radius =
+        std::min(std::max(trust_region_radius_,
+                          solver_options.min_trust_region_radius),
+                 solver_options.max_trust_region_radius);
+  }
+
+  std::string solver_error;
+  CHECK(solver_options.IsValid(&solver_error)) << solver_error;
+
+  {
+    const TraceSpan trace_span("ceres/solve");
+    ceres::Solve(solver_options, problem_.get(), &summary_);
+  }
+
+  RecordSolverMetrics(summary_);
+
+  if (summary_.termination_type != ceres::FAILURE &&
+      !summary_.iterations.empty()) {
+    trust_region_radius_ = summary_.iterations.back().trust_region_radius;
+  }
+
+  if (solver_options.minimizer_progress_to_stdout) {
+    std::cout << std::endl;
+  }
+
+  if (options_.print_summary) {
+    PrintHeading2("Bundle adjustment report");
+    PrintSolverSummary(summary_);
+    std::cout << std::right << std::setw(16) << "Setup time : ";
+    std::cout << std::left << setup_time_ << " [s]" << std::endl;
+    std::cout << std::right << std::setw(16) << "Added blocks : ";
+    std::cout << std::left << num_added_residual_blocks_ << std::endl;
+    std::cout << std::right << std::setw(16) << "Removed blocks : ";
+    std::cout << std::left << num_removed_residual_blocks_ << std::endl;
+  }
+
+  return true;
+}
+
+void IncrementalBundleAdjuster::SetSolverOptions(
+    const ceres::Solver::Options& solver_options) {
+  options_.solver_options = solver_options;
+}
+
+const ceres::Solver::Summary& IncrementalBundleAdjuster::Summary() const {
+  return summary_;
+}
+
+double IncrementalBundleAdjuster::SetUpTime() const { return setup_time_; }
+
+size_t IncrementalBundleAdjuster::NumAddedResidualBlocks() const {
+  return num_added_residual_blocks_;
+}
+
+size_t IncrementalBundleAdjuster::NumRemovedResidualBlocks() const {
+  return num_removed_residual_blocks_;
+}
+
+void IncrementalBundleAdjuster::RemoveResidualBlock(
+    const image_t image_id, const ResidualBlock& residual_block) {
+  problem_->RemoveResidualBlock(residual_block.id);
+  num_removed_residual_blocks_ += 1;
+  point3D_blocks_.at(residual_block.point3D_id).num_residual_blocks -= 1;
+  if (!residual_block.constant_pose) {
+    pose_blocks_.at(image_id).num_residual_blocks -= 1;
+  }
+}
+
+void IncrementalBundleAdjuster::AddResidualBlock(
+    const image_t image_id, const point2D_t point2D_idx,
+    const bool constant_pose, const BundleAdjustmentConfig& config,
+    Reconstruction* reconstruction) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Point2D& point2D = image.Point2D(point2D_idx);
+  Point3D& point3D = reconstruction->Point3D(point2D.Point3DId());
+
+  double* qvec_data = image.Qvec().data();
+  double* tvec_data = image.Tvec().data();
+  double* camera_params_data = camera.ParamsData();
+
+  ResidualBlock residual_block;
+  residual_block.point3D_id = point2D.Point3DId();
+  residual_block.constant_pose = constant_pose;
+
+  ceres::CostFunction* cost_function = nullptr;
+
+  if (constant_pose) {
+    switch (camera.ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                                 \
+  case CameraModel::kModelId:                                          \
+    cost_function =                                                    \
+        BundleAdjustmentConstantPoseCostFunction<CameraModel>::Create( \
+            image.Qvec(), image.Tvec(), point2D.XY());                 \
+    break;
+
+      CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+    }
+
+    residual_block.id = problem_->AddResidualBlock(
+        cost_function, loss_function_.get(), point3D.XYZ().data(),
+        camera_params_data);
+
+    constant_poses_.emplace(image_id, image.ProjectionMatrix());
+  } else {
+    switch (camera.ModelId()) {
+#define CAMERA_MODEL_CASE(CameraModel)                                   \
+  case CameraModel::kModelId:                                            \
+    cost_function =                                                      \
+        BundleAdjustmentCostFunction<CameraModel>::Create(point2D.XY()); \
+    break;
+
+      CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+    }
 
-      if (!options_.refine_focal_length) {
-        const std::vector<size_t>& params_idxs = camera.FocalLengthIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
-      if (!options_.refine_principal_point) {
-        const std::vector<size_t>& params_idxs = camera.PrincipalPointIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
-      if (!options_.refine_extra_params) {
-        const std::vector<size_t>& params_idxs = camera.ExtraParamsIdxs();
-        const_camera_params.insert(const_camera_params.end(),
-                                   params_idxs.begin(), params_idxs.end());
-      }
+    residual_block.id = problem_->AddResidualBlock(
+        cost_function, loss_function_.get(), qvec_data, tvec_data,
+        point3D.XYZ().data(), camera_params_data);
 
-      if (const_camera_params.size() > 0) {
-        ceres::SubsetParameterization* camera_params_parameterization =
-            new ceres::SubsetParameterization(
-                static_cast<int>(camera.NumParams()), const_camera_params);
-        problem_->SetParameterization(camera.ParamsData(),
-                                      camera_params_parameterization);
+    // Set the pose parameterization, when the pose was added to the problem.
+    PoseBlock& pose_block = pose_blocks_[image_id];
+    if (pose_block.num_residual_blocks == 0) {
+      ordering_.AddElementToGroup(qvec_data, 1);
+      ordering_.AddElementToGroup(tvec_data, 1);
+      ceres::LocalParameterization* quaternion_parameterization =
+          new ceres::QuaternionParameterization;
+      problem_->SetParameterization(qvec_data, quaternion_parameterization);
+      if (config.HasConstantTvec(image_id)) {
+        pose_block.constant_tvec_idxs = config.ConstantTvec(image_id);
+        ceres::SubsetParameterization* tvec_parameterization =
+            new ceres::SubsetParameterization(3,
+                                              pose_block.constant_tvec_idxs);
+        problem_->SetParameterization(tvec_data, tvec_parameterization);
       }
     }
+    pose_block.num_residual_blocks += 1;
   }
-}
 
-void BundleAdjuster::ParameterizePoints(Reconstruction* reconstruction) {
-  for (const auto elem : point3D_num_observations_) {
-    Point3D& point3D = reconstruction->Point3D(elem.first);
-    if (point3D.Track().Length() > elem.second) {
-      problem_->SetParameterBlockConstant(point3D.XYZ().data());
-    }
+  Point3DBlock& point3D_block = point3D_blocks_[residual_block.point3D_id];
+  if (point3D_block.num_residual_blocks == 0) {
+    ordering_.AddElementToGroup(point3D.XYZ().data(), 0);
   }
+  point3D_block.data = point3D.XYZ().data();
+  point3D_block.num_residual_blocks += 1;
+
+  // Set the camera parameterization, when the camera was added to the problem.
+  if (camera_ids_.count(camera.CameraId()) == 0) {
+    camera_ids_.insert(camera.CameraId());
+    ordering_.AddElementToGroup(camera_params_data, 1);
+
+    std::vector<int> const_camera_params;
+    if (!options_.refine_focal_length) {
+      const std::vector<size_t>& params_idxs = camera.FocalLengthIdxs();
+      const_camera_params.insert(const_camera_params.end(),
+                                 params_idxs.begin(), params_idxs.end());
+    }
+    if (!options_.refine_principal_point) {
+      const std::vector<size_t>& params_idxs = camera.PrincipalPointIdxs();
+      const_camera_params.insert(const_camera_params.end(),
+                                 params_idxs.begin(), params_idxs.end());
+    }
+    if (!options_.refine_extra_params) {
+      const std::vector<size_t>& params_idxs = camera.ExtraParamsIdxs();
+      const_camera_params.insert(const_camera_params.end(),
+                                 params_idxs.begin(), params_idxs.end());
+    }
 
-  for (const point3D_t point3D_id : config_.ConstantPoints()) {
-    Point3D& point3D = reconstruction->Point3D(point3D_id);
-    problem_->SetParameterBlockConstant(point3D.XYZ().data());
+    // A camera without any refined parameters is set constant instead.
+    if (const_camera_params.size() > 0 &&
+        const_camera_params.size() < camera.NumParams()) {
+      ceres::SubsetParameterization* camera_params_parameterization =
+          new ceres::SubsetParameterization(
+              static_cast<int>(camera.NumParams()), const_camera_params);
+      problem_->SetParameterization(camera_params_data,
+                                    camera_params_parameterization);
+    }
   }
+
+  residual_blocks_.emplace(ObservationKey(image_id, point2D_idx),
+                           residual_block);
+  num_added_residual_blocks_ += 1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -548,20 +1771,21 @@ ParallelBundleAdjuster::ParallelBundleAdjuster(
     : options_(options),
       ba_options_(ba_options),
       config_(config),
-      num_measurements_(0) {
+      num_measurements_(0),
+      has_distortion_(true) {
   CHECK(options_.Check());
   CHECK(ba_options_.Check());
-  CHECK_EQ(config_.NumConstantCameras(), 0)
-      << "PBA does not allow to set individual cameras constant";
-  CHECK_EQ(config_.NumConstantPoses(), 0)
-      << "PBA does not allow to set individual translational elements constant";
   CHECK_EQ(config_.NumConstantTvecs(), 0)
       << "PBA does not allow to set individual translational elements constant";
   CHECK(config_.NumVariablePoints() == 0 && config_.NumConstantPoints() == 0)
       << "PBA does not allow to parameterize individual 3D points";
+  CHECK(!config_.HasPointSubset())
+      << "PBA does not allow to restrict the observed 3D points";
 }
 
 bool ParallelBundleAdjuster::Solve(Reconstruction* reconstruction) {
+  const TraceSpan trace_span("bundle_adjustment/parallel_solve");
+
   CHECK_NOTNULL(reconstruction);
   CHECK_EQ(num_measurements_, 0)
       << "Cannot use the same ParallelBundleAdjuster multiple times";
@@ -595,7 +1819,11 @@ bool ParallelBundleAdjuster::Solve(Reconstruction* reconstruction) {
   pba::ParallelBA pba(device, num_threads);
 
   pba.SetNextBundleMode(pba::ParallelBA::BUNDLE_FULL);
-  pba.EnableRadialDistortion(pba::ParallelBA::PBA_PROJECTION_DISTORTION);
+  if (has_distortion_) {
+    pba.EnableRadialDistortion(pba::ParallelBA::PBA_PROJECTION_DISTORTION);
+  } else {
+    pba.EnableRadialDistortion(pba::ParallelBA::PBA_NO_DISTORTION);
+  }
   pba.SetFixedIntrinsics(!ba_options_.refine_focal_length &&
                          !ba_options_.refine_extra_params);
 
@@ -619,9 +1847,16 @@ bool ParallelBundleAdjuster::Solve(Reconstruction* reconstruction) {
 
   // Compose Ceres solver summary from PBA options.
   summary_.num_residuals_reduced = num_residuals;
-  summary_.num_effective_parameters_reduced =
-      static_cast<int>(8 * config_.NumImages() -
-                       2 * config_.NumConstantCameras() + 3 * points3D_.size());
+  const int num_camera_params = has_distortion_ ? 2 : 1;
+  int num_effective_parameters = 3 * static_cast<int>(points3D_.size());
+  for (const auto& pba_camera : cameras_) {
+    if (pba_camera.constant_camera == 0.0f) {
+      num_effective_parameters += 6 + num_camera_params;
+    } else if (pba_camera.constant_camera == 2.0f) {
+      num_effective_parameters += 6;
+    }
+  }
+  summary_.num_effective_parameters_reduced = num_effective_parameters;
   summary_.num_successful_steps = pba_config->GetIterationsLM() + 1;
   summary_.termination_type = ceres::TerminationType::USER_SUCCESS;
   summary_.initial_cost =
@@ -651,13 +1886,25 @@ bool ParallelBundleAdjuster::IsSupported(const BundleAdjustmentOptions& options,
     return false;
   }
 
-  // Check that all cameras are SIMPLE_RADIAL and that no intrinsics are shared.
+  // Check that all cameras are either SIMPLE_RADIAL or SIMPLE_PINHOLE, since
+  // PBA only supports a single distortion mode for all cameras, and that no
+  // intrinsics are shared.
   std::set<camera_t> camera_ids;
+  int model_id = kInvalidCameraModelId;
   for (const auto& image : reconstruction.Images()) {
     if (image.second.IsRegistered()) {
-      if (camera_ids.count(image.second.CameraId()) != 0 ||
-          reconstruction.Camera(image.second.CameraId()).ModelId() !=
-              SimpleRadialCameraModel::model_id) {
+      if (camera_ids.count(image.second.CameraId()) != 0) {
+        return false;
+      }
+      const int camera_model_id =
+          reconstruction.Camera(image.second.CameraId()).ModelId();
+      if (camera_model_id != SimpleRadialCameraModel::model_id &&
+          camera_model_id != SimplePinholeCameraModel::model_id) {
+        return false;
+      }
+      if (model_id == kInvalidCameraModelId) {
+        model_id = camera_model_id;
+      } else if (model_id != camera_model_id) {
         return false;
       }
       camera_ids.insert(image.second.CameraId());
@@ -692,7 +1939,9 @@ void ParallelBundleAdjuster::TearDown(Reconstruction* reconstruction) {
 
     Camera& camera = reconstruction->Camera(image.CameraId());
     camera.Params(0) = pba_camera.GetFocalLength();
-    camera.Params(3) = pba_camera.GetProjectionDistortion();
+    if (has_distortion_) {
+      camera.Params(3) = pba_camera.GetProjectionDistortion();
+    }
   }
 
   for (size_t i = 0; i < points3D_.size(); ++i) {
@@ -709,8 +1958,17 @@ void ParallelBundleAdjuster::AddImagesToProblem(
         << "PBA does not support shared intrinsics";
 
     const Camera& camera = reconstruction->Camera(image.CameraId());
-    CHECK_EQ(camera.ModelId(), SimpleRadialCameraModel::model_id)
-        << "PBA only supports the SIMPLE_RADIAL camera model";
+    if (cameras_.empty()) {
+      has_distortion_ = camera.ModelId() == SimpleRadialCameraModel::model_id;
+    }
+    if (has_distortion_) {
+      CHECK_EQ(camera.ModelId(), SimpleRadialCameraModel::model_id)
+          << "PBA does not support mixed camera models";
+    } else {
+      CHECK_EQ(camera.ModelId(), SimplePinholeCameraModel::model_id)
+          << "PBA only supports the SIMPLE_RADIAL and SIMPLE_PINHOLE camera "
+             "models";
+    }
 
     // Note: Do not use PBA's quaternion methods as they seem to lead to
     // numerical instability or other issues.
@@ -719,15 +1977,19 @@ void ParallelBundleAdjuster::AddImagesToProblem(
 
     pba::CameraT pba_camera;
     pba_camera.SetFocalLength(camera.Params(0));
-    pba_camera.SetProjectionDistortion(camera.Params(3));
+    if (has_distortion_) {
+      pba_camera.SetProjectionDistortion(camera.Params(3));
+    }
     pba_camera.SetMatrixRotation(rotation_matrix.data());
     pba_camera.SetTranslation(image.Tvec().data());
 
     CHECK(!config_.HasConstantTvec(image_id))
         << "PBA cannot fix partial extrinsics";
+    const bool constant_intrinsics =
+        config_.IsConstantCamera(image.CameraId()) ||
+        (!ba_options_.refine_focal_length && !ba_options_.refine_extra_params);
     if (!ba_options_.refine_extrinsics || config_.HasConstantPose(image_id)) {
-      CHECK(config_.IsConstantCamera(image.CameraId()))
-          << "PBA cannot fix extrinsics only";
+      CHECK(constant_intrinsics) << "PBA cannot fix extrinsics only";
       pba_camera.SetConstantCamera();
     } else if (config_.IsConstantCamera(image.CameraId())) {
       pba_camera.SetFixedIntrinsic();
@@ -797,6 +2059,8 @@ RigBundleAdjuster::RigBundleAdjuster(const BundleAdjustmentOptions& options,
 
 bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
                               std::vector<CameraRig>* camera_rigs) {
+  const TraceSpan trace_span("bundle_adjustment/rig_solve");
+
   CHECK_NOTNULL(reconstruction);
   CHECK_NOTNULL(camera_rigs);
   CHECK(!problem_) << "Cannot use the same BundleAdjuster multiple times";
@@ -829,32 +2093,19 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
     return false;
   }
 
-  ceres::Solver::Options solver_options = options_.solver_options;
-
-  // Empirical choice.
-  const size_t kMaxNumImagesDirectDenseSolver = 50;
-  const size_t kMaxNumImagesDirectSparseSolver = 1000;
-  const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
-    solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver) {
-    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
-  } else {  // Indirect sparse (preconditioned CG) solver.
-    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
-    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
-  }
-
-  solver_options.num_threads =
-      GetEffectiveNumThreads(solver_options.num_threads);
-#if CERES_VERSION_MAJOR < 2
-  solver_options.num_linear_solver_threads =
-      GetEffectiveNumThreads(solver_options.num_linear_solver_threads);
-#endif  // CERES_VERSION_MAJOR
+  ceres::Solver::Options solver_options = CreateSolverOptions(
+      options_, config_.NumImages(), problem_->NumResiduals(),
+      EstimateNumSchurBlocks(point3D_num_observations_));
 
   std::string solver_error;
   CHECK(solver_options.IsValid(&solver_error)) << solver_error;
 
-  ceres::Solve(solver_options, problem_.get(), &summary_);
+  {
+    const TraceSpan trace_span("ceres/solve");
+    ceres::Solve(solver_options, problem_.get(), &summary_);
+  }
+
+  RecordSolverMetrics(summary_);
 
   if (solver_options.minimizer_progress_to_stdout) {
     std::cout << std::endl;
@@ -875,9 +2126,50 @@ void RigBundleAdjuster::SetUp(Reconstruction* reconstruction,
                               ceres::LossFunction* loss_function) {
   ComputeCameraRigPoses(*reconstruction, *camera_rigs);
 
-  for (const image_t image_id : config_.Images()) {
-    AddImageToProblem(image_id, reconstruction, camera_rigs, loss_function);
+  const std::vector<image_t> image_ids(config_.Images().begin(),
+                                       config_.Images().end());
+
+  size_t num_residuals = 0;
+  for (const image_t image_id : image_ids) {
+    num_residuals += 2 * reconstruction->Image(image_id).NumPoints3D();
+  }
+
+  int num_threads = GetEffectiveNumThreads(options_.solver_options.num_threads);
+  if (num_residuals <
+      static_cast<size_t>(options_.min_num_residuals_for_multi_threading)) {
+    num_threads = 1;
+  }
+
+  if (num_threads == 1) {
+    for (const image_t image_id : image_ids) {
+      AddImageToProblem(image_id, reconstruction, camera_rigs, loss_function);
+    }
+  } else {
+    // See `BundleAdjuster::SetUp` for the batched parallel setup.
+    const size_t kBatchSize = 64 * static_cast<size_t>(num_threads);
+    std::vector<std::vector<ImageResidualBlock>> residual_blocks;
+    ThreadPool thread_pool(num_threads);
+    for (size_t batch_begin = 0; batch_begin < image_ids.size();
+         batch_begin += kBatchSize) {
+      const size_t batch_end =
+          std::min(batch_begin + kBatchSize, image_ids.size());
+      residual_blocks.clear();
+      residual_blocks.resize(batch_end - batch_begin);
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        thread_pool.AddTask([this, i, batch_begin, reconstruction,
+                             &image_ids, &residual_blocks]() {
+          CreateImageResidualBlocks(image_ids[i], reconstruction,
+                                    &residual_blocks[i - batch_begin]);
+        });
+      }
+      thread_pool.Wait();
+      for (size_t i = batch_begin; i < batch_end; ++i) {
+        AddImageResidualBlocks(image_ids[i], residual_blocks[i - batch_begin],
+                               reconstruction, loss_function);
+      }
+    }
   }
+
   for (const auto point3D_id : config_.VariablePoints()) {
     AddPointToProblem(point3D_id, reconstruction, loss_function);
   }
@@ -908,33 +2200,34 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
                                           Reconstruction* reconstruction,
                                           std::vector<CameraRig>* camera_rigs,
                                           ceres::LossFunction* loss_function) {
+  std::vector<ImageResidualBlock> residual_blocks;
+  CreateImageResidualBlocks(image_id, reconstruction, &residual_blocks);
+  AddImageResidualBlocks(image_id, residual_blocks, reconstruction,
+                         loss_function);
+}
+
+void RigBundleAdjuster::CreateImageResidualBlocks(
+    const image_t image_id, Reconstruction* reconstruction,
+    std::vector<ImageResidualBlock>* residual_blocks) const {
   const double max_squared_reproj_error =
       rig_options_.max_reproj_error * rig_options_.max_reproj_error;
 
   Image& image = reconstruction->Image(image_id);
-  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Camera& camera = reconstruction->Camera(image.CameraId());
 
   const bool constant_pose = config_.HasConstantPose(image_id);
   const bool constant_tvec = config_.HasConstantTvec(image_id);
 
-  double* qvec_data = nullptr;
-  double* tvec_data = nullptr;
-  double* rig_qvec_data = nullptr;
-  double* rig_tvec_data = nullptr;
-  double* camera_params_data = camera.ParamsData();
-  CameraRig* camera_rig = nullptr;
+  const auto camera_rig_it = image_id_to_camera_rig_.find(image_id);
+  const bool in_camera_rig = camera_rig_it != image_id_to_camera_rig_.end();
   Eigen::Matrix3x4d rig_proj_matrix = Eigen::Matrix3x4d::Zero();
 
-  if (image_id_to_camera_rig_.count(image_id) > 0) {
+  if (in_camera_rig) {
     CHECK(!constant_pose)
         << "Images contained in a camera rig must not have constant pose";
     CHECK(!constant_tvec)
         << "Images contained in a camera rig must not have constant tvec";
-    camera_rig = image_id_to_camera_rig_.at(image_id);
-    rig_qvec_data = image_id_to_rig_qvec_.at(image_id)->data();
-    rig_tvec_data = image_id_to_rig_tvec_.at(image_id)->data();
-    qvec_data = camera_rig->RelativeQvec(image.CameraId()).data();
-    tvec_data = camera_rig->RelativeTvec(image.CameraId()).data();
+    const CameraRig& camera_rig = *camera_rig_it->second;
 
     // Concatenate the absolute pose of the rig and the relative pose the camera
     // within the rig to detect outlier observations.
@@ -942,25 +2235,16 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
     Eigen::Vector3d rig_concat_tvec;
     ConcatenatePoses(*image_id_to_rig_qvec_.at(image_id),
                      *image_id_to_rig_tvec_.at(image_id),
-                     camera_rig->RelativeQvec(image.CameraId()),
-                     camera_rig->RelativeTvec(image.CameraId()),
+                     camera_rig.RelativeQvec(image.CameraId()),
+                     camera_rig.RelativeTvec(image.CameraId()),
                      &rig_concat_qvec, &rig_concat_tvec);
     rig_proj_matrix = ComposeProjectionMatrix(rig_concat_qvec, rig_concat_tvec);
   } else {
     // CostFunction assumes unit quaternions.
     image.NormalizeQvec();
-    qvec_data = image.Qvec().data();
-    tvec_data = image.Tvec().data();
   }
 
-  // Collect cameras for final parameterization.
-  CHECK(image.HasCamera());
-  camera_ids_.insert(image.CameraId());
-
-  // The number of added observations for the current image.
-  size_t num_observations = 0;
-
-  // Add residuals to bundle adjustment problem.
+  residual_blocks->reserve(image.NumPoints3D());
   for (const Point2D& point2D : image.Points2D()) {
     if (!point2D.HasPoint3D()) {
       continue;
@@ -969,19 +2253,16 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
     Point3D& point3D = reconstruction->Point3D(point2D.Point3DId());
     assert(point3D.Track().Length() > 1);
 
-    if (camera_rig != nullptr &&
+    if (in_camera_rig &&
         CalculateSquaredReprojectionError(point2D.XY(), point3D.XYZ(),
                                           rig_proj_matrix,
                                           camera) > max_squared_reproj_error) {
       continue;
     }
 
-    num_observations += 1;
-    point3D_num_observations_[point2D.Point3DId()] += 1;
-
     ceres::CostFunction* cost_function = nullptr;
 
-    if (camera_rig == nullptr) {
+    if (!in_camera_rig) {
       if (constant_pose) {
         switch (camera.ModelId()) {
 #define CAMERA_MODEL_CASE(CameraModel)                                 \
@@ -995,9 +2276,6 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
 
 #undef CAMERA_MODEL_CASE
         }
-
-        problem_->AddResidualBlock(cost_function, loss_function,
-                                   point3D.XYZ().data(), camera_params_data);
       } else {
         switch (camera.ModelId()) {
 #define CAMERA_MODEL_CASE(CameraModel)                                   \
@@ -1010,10 +2288,6 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
 
 #undef CAMERA_MODEL_CASE
         }
-
-        problem_->AddResidualBlock(cost_function, loss_function, qvec_data,
-                                   tvec_data, point3D.XYZ().data(),
-                                   camera_params_data);
       }
     } else {
       switch (camera.ModelId()) {
@@ -1028,13 +2302,71 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
 
 #undef CAMERA_MODEL_CASE
       }
-      problem_->AddResidualBlock(cost_function, loss_function, rig_qvec_data,
-                                 rig_tvec_data, qvec_data, tvec_data,
-                                 point3D.XYZ().data(), camera_params_data);
+    }
+
+    ImageResidualBlock residual_block;
+    residual_block.cost_function = cost_function;
+    residual_block.point3D_id = point2D.Point3DId();
+    residual_block.point3D_data = point3D.XYZ().data();
+    residual_blocks->push_back(residual_block);
+  }
+}
+
+void RigBundleAdjuster::AddImageResidualBlocks(
+    const image_t image_id,
+    const std::vector<ImageResidualBlock>& residual_blocks,
+    Reconstruction* reconstruction, ceres::LossFunction* loss_function) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+
+  const bool constant_pose = config_.HasConstantPose(image_id);
+  const bool constant_tvec = config_.HasConstantTvec(image_id);
+
+  double* qvec_data = nullptr;
+  double* tvec_data = nullptr;
+  double* rig_qvec_data = nullptr;
+  double* rig_tvec_data = nullptr;
+  double* camera_params_data = camera.ParamsData();
+  CameraRig* camera_rig = nullptr;
+
+  if (image_id_to_camera_rig_.count(image_id) > 0) {
+    camera_rig = image_id_to_camera_rig_.at(image_id);
+    rig_qvec_data = image_id_to_rig_qvec_.at(image_id)->data();
+    rig_tvec_data = image_id_to_rig_tvec_.at(image_id)->data();
+    qvec_data = camera_rig->RelativeQvec(image.CameraId()).data();
+    tvec_data = camera_rig->RelativeTvec(image.CameraId()).data();
+  } else {
+    qvec_data = image.Qvec().data();
+    tvec_data = image.Tvec().data();
+  }
+
+  // Collect cameras for final parameterization.
+  CHECK(image.HasCamera());
+  camera_ids_.insert(image.CameraId());
+
+  // Add residuals to bundle adjustment problem.
+  for (const auto& residual_block : residual_blocks) {
+    point3D_num_observations_[residual_block.point3D_id] += 1;
+    if (camera_rig == nullptr) {
+      if (constant_pose) {
+        problem_->AddResidualBlock(residual_block.cost_function, loss_function,
+                                   residual_block.point3D_data,
+                                   camera_params_data);
+      } else {
+        problem_->AddResidualBlock(residual_block.cost_function, loss_function,
+                                   qvec_data, tvec_data,
+                                   residual_block.point3D_data,
+                                   camera_params_data);
+      }
+    } else {
+      problem_->AddResidualBlock(residual_block.cost_function, loss_function,
+                                 rig_qvec_data, rig_tvec_data, qvec_data,
+                                 tvec_data, residual_block.point3D_data,
+                                 camera_params_data);
     }
   }
 
-  if (num_observations > 0) {
+  if (residual_blocks.size() > 0) {
     parameterized_qvec_data_.insert(qvec_data);
 
     if (camera_rig != nullptr) {
@@ -1115,25 +2447,55 @@ void RigBundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
 void RigBundleAdjuster::ComputeCameraRigPoses(
     const Reconstruction& reconstruction,
     const std::vector<CameraRig>& camera_rigs) {
-  camera_rig_qvecs_.reserve(camera_rigs.size());
-  camera_rig_tvecs_.reserve(camera_rigs.size());
-  for (const auto& camera_rig : camera_rigs) {
-    camera_rig_qvecs_.emplace_back();
-    camera_rig_tvecs_.emplace_back();
-    auto& rig_qvecs = camera_rig_qvecs_.back();
-    auto& rig_tvecs = camera_rig_tvecs_.back();
+  camera_rig_qvecs_.resize(camera_rigs.size());
+  camera_rig_tvecs_.resize(camera_rigs.size());
+  size_t num_snapshots = 0;
+  for (size_t rig_idx = 0; rig_idx < camera_rigs.size(); ++rig_idx) {
+    const auto& camera_rig = camera_rigs[rig_idx];
+    auto& rig_qvecs = camera_rig_qvecs_[rig_idx];
+    auto& rig_tvecs = camera_rig_tvecs_[rig_idx];
     rig_qvecs.resize(camera_rig.NumSnapshots());
     rig_tvecs.resize(camera_rig.NumSnapshots());
     for (size_t snapshot_idx = 0; snapshot_idx < camera_rig.NumSnapshots();
          ++snapshot_idx) {
-      camera_rig.ComputeAbsolutePose(snapshot_idx, reconstruction,
-                                     &rig_qvecs[snapshot_idx],
-                                     &rig_tvecs[snapshot_idx]);
       for (const auto image_id : camera_rig.Snapshots()[snapshot_idx]) {
         image_id_to_rig_qvec_.emplace(image_id, &rig_qvecs[snapshot_idx]);
         image_id_to_rig_tvec_.emplace(image_id, &rig_tvecs[snapshot_idx]);
       }
     }
+    num_snapshots += camera_rig.NumSnapshots();
+  }
+
+  // The absolute pose of each snapshot is averaged over its images, which is
+  // independent of all other snapshots.
+  const int num_threads =
+      std::min(GetEffectiveNumThreads(options_.solver_options.num_threads),
+               static_cast<int>(num_snapshots));
+  if (num_threads <= 1) {
+    for (size_t rig_idx = 0; rig_idx < camera_rigs.size(); ++rig_idx) {
+      for (size_t snapshot_idx = 0;
+           snapshot_idx < camera_rigs[rig_idx].NumSnapshots(); ++snapshot_idx) {
+        camera_rigs[rig_idx].ComputeAbsolutePose(
+            snapshot_idx, reconstruction,
+            &camera_rig_qvecs_[rig_idx][snapshot_idx],
+            &camera_rig_tvecs_[rig_idx][snapshot_idx]);
+      }
+    }
+  } else {
+    ThreadPool thread_pool(num_threads);
+    for (size_t rig_idx = 0; rig_idx < camera_rigs.size(); ++rig_idx) {
+      for (size_t snapshot_idx = 0;
+           snapshot_idx < camera_rigs[rig_idx].NumSnapshots(); ++snapshot_idx) {
+        thread_pool.AddTask([this, rig_idx, snapshot_idx, &reconstruction,
+                             &camera_rigs]() {
+          camera_rigs[rig_idx].ComputeAbsolutePose(
+              snapshot_idx, reconstruction,
+              &camera_rig_qvecs_[rig_idx][snapshot_idx],
+              &camera_rig_tvecs_[rig_idx][snapshot_idx]);
+        });
+      }
+    }
+    thread_pool.Wait();
   }
 }
 
@@ -1145,6 +2507,180 @@ void RigBundleAdjuster::ParameterizeCameraRigs(Reconstruction* reconstruction) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// PartitionedBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+bool PartitionedBundleAdjuster::Options::Check() const {
+  CHECK_OPTION_GT(max_num_images, 0);
+  CHECK_OPTION_GE(image_overlap, 0);
+  CHECK_OPTION_GT(num_iterations, 0);
+  return true;
+}
+
+PartitionedBundleAdjuster::PartitionedBundleAdjuster(
+    const Options& options, const BundleAdjustmentOptions& ba_options,
+    const BundleAdjustmentConfig& config)
+    : options_(options),
+      ba_options_(ba_options),
+      config_(config),
+      num_partitions_(0) {
+  CHECK(options_.Check());
+  CHECK(ba_options_.Check());
+}
+
+bool PartitionedBundleAdjuster::Solve(Reconstruction* reconstruction) {
+  CHECK_NOTNULL(reconstruction);
+
+  if (config_.NumImages() <= static_cast<size_t>(options_.max_num_images)) {
+    num_partitions_ = 1;
+    BundleAdjuster bundle_adjuster(ba_options_, config_);
+    return bundle_adjuster.Solve(reconstruction);
+  }
+
+  const std::vector<std::vector<image_t>> partitions =
+      PartitionImages(*reconstruction);
+  num_partitions_ = partitions.size();
+
+  bool success = false;
+  for (int iteration = 0; iteration < options_.num_iterations; ++iteration) {
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      if (ba_options_.print_summary) {
+        PrintHeading2(StringPrintf("Partition %d / %d (iteration %d / %d)",
+                                   static_cast<int>(i + 1),
+                                   static_cast<int>(partitions.size()),
+                                   iteration + 1, options_.num_iterations));
+      }
+
+      // The problem of the partition is destroyed before adjusting the next
+      // partition, which bounds the memory to the largest partition.
+      BundleAdjuster bundle_adjuster(
+          ba_options_, CreatePartitionConfig(partitions[i], *reconstruction));
+      if (bundle_adjuster.Solve(reconstruction)) {
+        success = true;
+      }
+    }
+  }
+
+  return success;
+}
+
+size_t PartitionedBundleAdjuster::NumPartitions() const {
+  return num_partitions_;
+}
+
+std::vector<std::vector<image_t>> PartitionedBundleAdjuster::PartitionImages(
+    const Reconstruction& reconstruction) const {
+  // Weight the edges of the scene graph by the number of shared 3D points.
+  std::unordered_map<image_pair_t, int> num_shared_points3D;
+  for (const image_t image_id : config_.Images()) {
+    const Image& image = reconstruction.Image(image_id);
+    for (const Point2D& point2D : image.Points2D()) {
+      if (!point2D.HasPoint3D()) {
+        continue;
+      }
+      const Point3D& point3D = reconstruction.Point3D(point2D.Point3DId());
+      for (const auto& track_el : point3D.Track().Elements()) {
+        if (track_el.image_id < image_id &&
+            config_.HasImage(track_el.image_id)) {
+          num_shared_points3D[Database::ImagePairToPairId(
+              image_id, track_el.image_id)] += 1;
+        }
+      }
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  image_pairs.reserve(num_shared_points3D.size());
+  num_inliers.reserve(num_shared_points3D.size());
+  for (const auto& image_pair : num_shared_points3D) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(image_pair.first, &image_id1, &image_id2);
+    image_pairs.emplace_back(image_id1, image_id2);
+    num_inliers.push_back(image_pair.second);
+  }
+
+  SceneClustering::Options clustering_options;
+  clustering_options.leaf_max_num_images = options_.max_num_images;
+  clustering_options.image_overlap = options_.image_overlap;
+  SceneClustering scene_clustering(clustering_options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+
+  std::vector<std::vector<image_t>> partitions;
+  std::unordered_set<image_t> partitioned_image_ids;
+  for (const auto& cluster : scene_clustering.GetLeafClusters()) {
+    partitions.push_back(cluster->image_ids);
+    partitioned_image_ids.insert(cluster->image_ids.begin(),
+                                 cluster->image_ids.end());
+  }
+
+  // Images without any shared 3D points are not part of the scene graph and
+  // do not affect any other partition, so they can be added to any partition.
+  if (partitions.empty()) {
+    partitions.emplace_back();
+  }
+  for (const image_t image_id : config_.Images()) {
+    if (partitioned_image_ids.count(image_id) == 0) {
+      partitions[0].push_back(image_id);
+    }
+  }
+
+  return partitions;
+}
+
+BundleAdjustmentConfig PartitionedBundleAdjuster::CreatePartitionConfig(
+    const std::vector<image_t>& image_ids,
+    const Reconstruction& reconstruction) const {
+  BundleAdjustmentConfig config;
+  for (const image_t image_id : image_ids) {
+    config.AddImage(image_id);
+  }
+  if (config_.HasPointSubset()) {
+    config.SetPointSubset(config_.PointSubset());
+  }
+
+  std::unordered_set<point3D_t> point3D_ids;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction.Image(image_id);
+    if (config_.IsConstantCamera(image.CameraId())) {
+      config.SetConstantCamera(image.CameraId());
+    }
+    if (config_.HasConstantPose(image_id)) {
+      config.SetConstantPose(image_id);
+    }
+    if (config_.HasConstantTvec(image_id)) {
+      config.SetConstantTvec(image_id, config_.ConstantTvec(image_id));
+    }
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D() &&
+          config_.IsPointInSubset(point2D.Point3DId())) {
+        point3D_ids.insert(point2D.Point3DId());
+      }
+    }
+  }
+
+  // Add all observations of points that are only partially contained in the
+  // partition, so that they can be refined against the images of the other
+  // partitions, which are held constant.
+  for (const point3D_t point3D_id : point3D_ids) {
+    if (config_.HasConstantPoint(point3D_id)) {
+      config.AddConstantPoint(point3D_id);
+      continue;
+    }
+    for (const auto& track_el :
+         reconstruction.Point3D(point3D_id).Track().Elements()) {
+      if (!config.HasImage(track_el.image_id)) {
+        config.AddVariablePoint(point3D_id);
+        break;
+      }
+    }
+  }
+
+  return config;
+}
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary) {
   std::cout << std::right << std::setw(16) << "Residuals : ";
   std::cout << std::left << summary.num_residuals_reduced << std::endl;
@@ -1162,6 +2698,23 @@ void PrintSolverSummary(const ceres::Solver::Summary& summary) {
   std::cout << std::left << summary.total_time_in_seconds << " [s]"
             << std::endl;
 
+  std::cout << std::right << std::setw(16) << "Linear solver : ";
+  std::cout << std::left
+            << ceres::LinearSolverTypeToString(summary.linear_solver_type_used);
+  if (summary.linear_solver_type_used == ceres::ITERATIVE_SCHUR) {
+    std::cout << " with "
+              << ceres::PreconditionerTypeToString(
+                     summary.preconditioner_type_used);
+  }
+  std::cout << ", " << summary.num_threads_used << " threads" << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Phase times : ";
+  std::cout << std::left << "setup " << summary.preprocessor_time_in_seconds
+            << ", residuals " << summary.residual_evaluation_time_in_seconds
+            << ", jacobians " << summary.jacobian_evaluation_time_in_seconds
+            << ", linear solver " << summary.linear_solver_time_in_seconds
+            << " [s]" << std::endl;
+
   std::cout << std::right << std::setw(16) << "Initial cost : ";
   std::cout << std::right << std::setprecision(6)
             << std::sqrt(summary.initial_cost / summary.num_residuals_reduced)
@@ -71,10 +71,28 @@ struct BundleAdjustmentOptions {
 
   // Minimum number of residuals to enable multi-threading. Note that
   // single-threaded is typically better for small bundle adjustment problems
-  // due to the overhead of threading.
+  // due to the overhead of threading. Larger problems use one more thread per
+  // this number of residuals up to the number of threads of the solver options.
   int min_num_residuals_for_multi_threading = 50000;
 
-  // Ceres-Solver options.
+  // Whether to solve the dense reduced camera system on the GPU, if the linear
+  // solver selection chooses a dense solver and Ceres supports CUDA.
+  bool use_gpu = false;
+
+  // Whether to factorize the reduced camera system in single precision and
+  // iteratively refine its solution in double precision, if the linear solver
+  // selection chooses a direct solver that supports it (requires Ceres 2.2).
+  // The factorization is only faster for large dense systems or on GPUs with
+  // low double precision throughput, and slower for small systems.
+  bool use_mixed_precision = false;
+
+  // The standard deviation of the position priors of the images in the units
+  // of the reconstruction, which weights their residuals relative to the
+  // reprojection errors in pixels, see `BundleAdjustmentConfig`.
+  double prior_position_std = 1.0;
+
+  // Ceres-Solver options. The linear solver type, the preconditioner type, and
+  // the number of threads are chosen from the size of the problem.
   ceres::Solver::Options solver_options;
 
   BundleAdjustmentOptions() {
@@ -151,6 +169,27 @@ class BundleAdjustmentConfig {
   void RemoveVariablePoint(const point3D_t point3D_id);
   void RemoveConstantPoint(const point3D_t point3D_id);
 
+  // Restrict the observations of the added images to the given subset of 3D
+  // points. By default, all 3D points observed by the added images are used.
+  // Note that the subset is only respected by `BundleAdjuster` and
+  // `PartitionedBundleAdjuster`.
+  void SetPointSubset(const std::unordered_set<point3D_t>& point3D_ids);
+  bool HasPointSubset() const;
+  bool IsPointInSubset(const point3D_t point3D_id) const;
+  const std::unordered_set<point3D_t>& PointSubset() const;
+
+  // Constrain the projection center of an added image to the given prior
+  // position, which must be in the frame of the reconstruction. The prior is
+  // only used if the pose of the image is variable and, as for the subset, it
+  // is only respected by `BundleAdjuster`. Since the priors fix the gauge of
+  // the problem, no pose needs to be set constant, if there are priors for at
+  // least three images with non-collinear positions.
+  void SetPositionPrior(const image_t image_id,
+                        const Eigen::Vector3d& position);
+  bool HasPositionPrior(const image_t image_id) const;
+  const Eigen::Vector3d& PositionPrior(const image_t image_id) const;
+  size_t NumPositionPriors() const;
+
   // Access configuration data.
   const std::unordered_set<image_t>& Images() const;
   const std::unordered_set<point3D_t>& VariablePoints() const;
@@ -164,10 +203,17 @@ class BundleAdjustmentConfig {
   std::unordered_set<point3D_t> constant_point3D_ids_;
   std::unordered_set<image_t> constant_poses_;
   std::unordered_map<image_t, std::vector<int>> constant_tvecs_;
+  bool has_point_subset_;
+  std::unordered_set<point3D_t> point_subset_;
+  std::unordered_map<image_t, Eigen::Vector3d> position_priors_;
 };
 
 // Bundle adjustment based on Ceres-Solver. Enables most flexible configurations
-// and provides best solution quality.
+// and provides best solution quality. Configurations with constant cameras, in
+// which either all poses (structure-only) or all points (motion-only) are
+// constant, decouple into independent problems per point or per image. These
+// are solved in parallel with a small dense Levenberg-Marquardt solver instead
+// of a Ceres problem, and the summary reports the sum of their costs.
 class BundleAdjuster {
  public:
   BundleAdjuster(const BundleAdjustmentOptions& options,
@@ -178,6 +224,15 @@ class BundleAdjuster {
   // Get the Ceres solver summary for the last call to `Solve`.
   const ceres::Solver::Summary& Summary() const;
 
+ protected:
+  // The residual block of an observation of an image, whose cost function is
+  // not yet owned by the problem.
+  struct ImageResidualBlock {
+    ceres::CostFunction* cost_function;
+    point3D_t point3D_id;
+    double* point3D_data;
+  };
+
  private:
   void SetUp(Reconstruction* reconstruction,
              ceres::LossFunction* loss_function);
@@ -186,10 +241,37 @@ class BundleAdjuster {
   void AddImageToProblem(const image_t image_id, Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  // Create the residual blocks of an image without modifying the problem, such
+  // that multiple images can be processed in parallel.
+  void CreateImageResidualBlocks(
+      const image_t image_id, Reconstruction* reconstruction,
+      std::vector<ImageResidualBlock>* residual_blocks) const;
+  void AddImageResidualBlocks(
+      const image_t image_id,
+      const std::vector<ImageResidualBlock>& residual_blocks,
+      Reconstruction* reconstruction, ceres::LossFunction* loss_function);
+
   void AddPointToProblem(const point3D_t point3D_id,
                          Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  void AddPositionPriorsToProblem(Reconstruction* reconstruction);
+
+  // Whether the cameras or poses of all configured images are constant.
+  bool HasConstantCameras(const Reconstruction& reconstruction) const;
+  bool HasConstantPoses() const;
+
+  // Whether the point would be variable in the joint problem, i.e. whether all
+  // its observations are part of the problem and it is not set constant.
+  bool IsVariablePoint(const point3D_t point3D_id,
+                       const Reconstruction& reconstruction) const;
+  bool HasVariablePoints(const Reconstruction& reconstruction) const;
+
+  // Solve the decoupled problems of structure-only and motion-only
+  // configurations without constructing a Ceres problem.
+  bool SolveStructureOnly(Reconstruction* reconstruction);
+  bool SolveMotionOnly(Reconstruction* reconstruction);
+
  protected:
   void ParameterizeCameras(Reconstruction* reconstruction);
   void ParameterizePoints(Reconstruction* reconstruction);
@@ -202,9 +284,98 @@ class BundleAdjuster {
   std::unordered_map<point3D_t, size_t> point3D_num_observations_;
 };
 
+// Bundle adjuster that keeps its problem between calls to `Solve`, such as for
+// the repeated local bundle adjustments during incremental mapping. Each call
+// only removes the residual blocks of observations that changed since the
+// previous call and adds the residual blocks of new observations, while the
+// cost functions and parameterizations of all other observations are reused.
+// The problem references the parameters of the reconstruction, so the same
+// reconstruction must be passed to all calls. The elimination ordering of the
+// Schur solvers is maintained together with the problem, such that it is not
+// recomputed by Ceres in every call. If warm started, each call starts with
+// the final trust region radius of the previous call.
+class IncrementalBundleAdjuster {
+ public:
+  explicit IncrementalBundleAdjuster(const BundleAdjustmentOptions& options,
+                                     const bool warm_start = false);
+
+  bool Solve(const BundleAdjustmentConfig& config,
+             Reconstruction* reconstruction);
+
+  // Set the solver options for subsequent calls to `Solve`. The other options
+  // determine the residual blocks and parameterizations of the problem and
+  // therefore cannot be changed.
+  void SetSolverOptions(const ceres::Solver::Options& solver_options);
+
+  // Get the Ceres solver summary for the last call to `Solve`.
+  const ceres::Solver::Summary& Summary() const;
+
+  // The time in seconds to update the problem in the last call to `Solve`,
+  // which is not included in the total time of the solver summary.
+  double SetUpTime() const;
+
+  // The number of residual blocks that were added to and removed from the
+  // problem in the last call to `Solve`.
+  size_t NumAddedResidualBlocks() const;
+  size_t NumRemovedResidualBlocks() const;
+
+ private:
+  struct ResidualBlock {
+    ceres::ResidualBlockId id;
+    point3D_t point3D_id;
+    bool constant_pose;
+  };
+
+  struct PoseBlock {
+    size_t num_residual_blocks = 0;
+    std::vector<int> constant_tvec_idxs;
+  };
+
+  struct Point3DBlock {
+    double* data = nullptr;
+    size_t num_residual_blocks = 0;
+  };
+
+  void RemoveResidualBlock(const image_t image_id,
+                           const ResidualBlock& residual_block);
+  void AddResidualBlock(const image_t image_id, const point2D_t point2D_idx,
+                        const bool constant_pose,
+                        const BundleAdjustmentConfig& config,
+                        Reconstruction* reconstruction);
+
+  BundleAdjustmentOptions options_;
+  const bool warm_start_;
+  std::unique_ptr<ceres::LossFunction> loss_function_;
+  std::unique_ptr<ceres::Problem> problem_;
+  ceres::Solver::Summary summary_;
+  double setup_time_;
+
+  // The final trust region radius of the previous call, if warm started.
+  double trust_region_radius_;
+
+  // The elimination ordering of all parameter blocks in the problem, with the
+  // points in the first group and the poses and cameras in the second group.
+  ceres::ParameterBlockOrdering ordering_;
+  size_t num_added_residual_blocks_;
+  size_t num_removed_residual_blocks_;
+
+  // The residual blocks in the problem for each observation, identified by
+  // the image and the index of its 2D point.
+  std::unordered_map<uint64_t, ResidualBlock> residual_blocks_;
+
+  // The parameter blocks in the problem. Cameras are never removed.
+  std::unordered_map<image_t, PoseBlock> pose_blocks_;
+  std::unordered_map<point3D_t, Point3DBlock> point3D_blocks_;
+  std::unordered_set<camera_t> camera_ids_;
+
+  // Constant pose cost functions hold a copy of the pose, so the projection
+  // matrices of their images are recorded to detect outdated residual blocks.
+  EIGEN_STL_UMAP(image_t, Eigen::Matrix3x4d) constant_poses_;
+};
+
 // Bundle adjustment using PBA (GPU or CPU). Less flexible and accurate than
 // Ceres-Solver bundle adjustment but much faster. Only supports SimpleRadial
-// camera model.
+// and SimplePinhole camera models.
 class ParallelBundleAdjuster {
  public:
   struct Options {
@@ -239,6 +410,9 @@ class ParallelBundleAdjuster {
 
   // Check whether PBA is supported for the given reconstruction. If the
   // reconstruction is not supported, the PBA solver will exit ungracefully.
+  // PBA requires all registered images to have their own camera and either
+  // all cameras to be SIMPLE_RADIAL or all to be SIMPLE_PINHOLE. Images with
+  // constant poses are only supported if their camera is constant as well.
   static bool IsSupported(const BundleAdjustmentOptions& options,
                           const Reconstruction& reconstruction);
 
@@ -255,6 +429,7 @@ class ParallelBundleAdjuster {
   ceres::Solver::Summary summary_;
 
   size_t num_measurements_;
+  bool has_distortion_;
   std::vector<pba::CameraT> cameras_;
   std::vector<pba::Point3D> points3D_;
   std::vector<pba::Point2D> measurements_;
@@ -299,10 +474,24 @@ class RigBundleAdjuster : public BundleAdjuster {
                          std::vector<CameraRig>* camera_rigs,
                          ceres::LossFunction* loss_function);
 
+  // Create the residual blocks of an image without modifying the problem, such
+  // that multiple images can be processed in parallel. Observations with a
+  // reprojection error larger than `max_reproj_error` w.r.t. the concatenated
+  // rig pose are rejected.
+  void CreateImageResidualBlocks(
+      const image_t image_id, Reconstruction* reconstruction,
+      std::vector<ImageResidualBlock>* residual_blocks) const;
+  void AddImageResidualBlocks(
+      const image_t image_id,
+      const std::vector<ImageResidualBlock>& residual_blocks,
+      Reconstruction* reconstruction, ceres::LossFunction* loss_function);
+
   void AddPointToProblem(const point3D_t point3D_id,
                          Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  // Compute the absolute poses of all camera rig snapshots. The poses are
+  // computed once and shared as parameter blocks by all images of a snapshot.
   void ComputeCameraRigPoses(const Reconstruction& reconstruction,
                              const std::vector<CameraRig>& camera_rigs);
 
@@ -326,6 +515,55 @@ class RigBundleAdjuster : public BundleAdjuster {
   std::unordered_set<double*> parameterized_qvec_data_;
 };
 
+// Bundle adjustment of large problems by partitioning the images of the config
+// into overlapping clusters using `SceneClustering`. The clusters are adjusted
+// one after the other in a block Gauss-Seidel fashion, so that only the
+// problem of a single cluster must be held in memory at any time. Each cluster
+// problem contains the images of the cluster and all observations of their 3D
+// points, where the images of other clusters are held constant. Cameras and
+// points shared between clusters reach consensus over multiple passes over
+// all clusters. The constant poses, translations, cameras, and points of the
+// config are respected while explicitly added variable points are only
+// refined through the observations of the config images.
+class PartitionedBundleAdjuster {
+ public:
+  struct Options {
+    // The maximum number of images in a cluster, otherwise the images are
+    // further partitioned. Note that a cluster may have at most
+    // `max_num_images + image_overlap` images.
+    int max_num_images = 500;
+
+    // The number of overlapping images between neighboring clusters.
+    int image_overlap = 50;
+
+    // The number of passes over all clusters.
+    int num_iterations = 2;
+
+    bool Check() const;
+  };
+
+  PartitionedBundleAdjuster(const Options& options,
+                            const BundleAdjustmentOptions& ba_options,
+                            const BundleAdjustmentConfig& config);
+
+  bool Solve(Reconstruction* reconstruction);
+
+  // The number of clusters used in the last call to `Solve`.
+  size_t NumPartitions() const;
+
+ private:
+  std::vector<std::vector<image_t>> PartitionImages(
+      const Reconstruction& reconstruction) const;
+  BundleAdjustmentConfig CreatePartitionConfig(
+      const std::vector<image_t>& image_ids,
+      const Reconstruction& reconstruction) const;
+
+  const Options options_;
+  const BundleAdjustmentOptions ba_options_;
+  const BundleAdjustmentConfig config_;
+  size_t num_partitions_;
+};
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary);
 
 }  // namespace colmap
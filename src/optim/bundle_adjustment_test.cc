@@ -207,6 +207,35 @@ BOOST_AUTO_TEST_CASE(TestConfigNumObservations) {
   BOOST_CHECK_EQUAL(config.NumResiduals(reconstruction), 800);
 }
 
+BOOST_AUTO_TEST_CASE(TestConfigPointSubset) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(4, 100, &reconstruction, &correspondence_graph);
+
+  std::unordered_set<point3D_t> point3D_ids;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    if (point3D_ids.size() < 50) {
+      point3D_ids.insert(point3D.first);
+    }
+  }
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  BOOST_CHECK(!config.HasPointSubset());
+  BOOST_CHECK(config.IsPointInSubset(*point3D_ids.begin()));
+  BOOST_CHECK_EQUAL(config.NumResiduals(reconstruction), 400);
+
+  config.SetPointSubset(point3D_ids);
+  BOOST_CHECK(config.HasPointSubset());
+  BOOST_CHECK_EQUAL(config.PointSubset().size(), 50);
+  BOOST_CHECK_EQUAL(config.NumResiduals(reconstruction), 200);
+  for (const auto& point3D : reconstruction.Points3D()) {
+    BOOST_CHECK_EQUAL(config.IsPointInSubset(point3D.first),
+                      point3D_ids.count(point3D.first) > 0);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestTwoView) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -244,6 +273,126 @@ BOOST_AUTO_TEST_CASE(TestTwoView) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestSolverSelection) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  // Small problems are solved densely without multi-threading.
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  {
+    Reconstruction reconstruction_copy = reconstruction;
+    BundleAdjuster bundle_adjuster(options, config);
+    BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction_copy));
+    BOOST_CHECK_EQUAL(bundle_adjuster.Summary().linear_solver_type_used,
+                      ceres::DENSE_SCHUR);
+    BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_threads_used, 1);
+  }
+
+  // The number of threads grows with the number of residuals.
+  options.min_num_residuals_for_multi_threading = 200;
+  options.solver_options.num_threads = 8;
+  {
+    Reconstruction reconstruction_copy = reconstruction;
+    BundleAdjuster bundle_adjuster(options, config);
+    BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction_copy));
+    BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_threads_used, 3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestMultiThreadedSetUp) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(10, 100, &reconstruction, &correspondence_graph);
+  auto serial_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  for (image_t image_id = 0; image_id < 10; ++image_id) {
+    config.AddImage(image_id);
+  }
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.solver_options.num_threads = 1;
+  BundleAdjuster serial_bundle_adjuster(options, config);
+  BOOST_REQUIRE(serial_bundle_adjuster.Solve(&serial_reconstruction));
+
+  options.solver_options.num_threads = 4;
+  options.min_num_residuals_for_multi_threading = 0;
+  BundleAdjuster bundle_adjuster(options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto& serial_summary = serial_bundle_adjuster.Summary();
+  const auto& summary = bundle_adjuster.Summary();
+
+  // 100 points, 10 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 2000);
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced,
+                    serial_summary.num_residuals_reduced);
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced,
+                    serial_summary.num_effective_parameters_reduced);
+  BOOST_CHECK_CLOSE(summary.initial_cost, serial_summary.initial_cost, 1e-6);
+  BOOST_CHECK_CLOSE(summary.final_cost, serial_summary.final_cost, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(TestTwoViewPointSubset) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  std::unordered_set<point3D_t> point3D_ids;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    if (point3D_ids.size() < 50) {
+      point3D_ids.insert(point3D.first);
+    }
+  }
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+  config.SetPointSubset(point3D_ids);
+
+  BundleAdjustmentOptions options;
+  BundleAdjuster bundle_adjuster(options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 50 points, 2 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 200);
+  // 50 x 3 point parameters
+  // + 5 image parameters (pose of second image)
+  // + 2 x 2 camera parameters
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced, 159);
+
+  CheckVariableCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    if (point3D_ids.count(point3D.first) > 0) {
+      CheckVariablePoint(point3D.second,
+                         orig_reconstruction.Point3D(point3D.first));
+    } else {
+      CheckConstantPoint(point3D.second,
+                         orig_reconstruction.Point3D(point3D.first));
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestTwoViewConstantCamera) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -476,6 +625,129 @@ BOOST_AUTO_TEST_CASE(TestVariableImage) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestPositionPriors) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  // The priors translate the reconstruction and fix the gauge of the problem
+  // without constant poses.
+  const Eigen::Vector3d kOffset(5, 0, 0);
+  BundleAdjustmentConfig config;
+  for (image_t image_id = 0; image_id < 3; ++image_id) {
+    config.AddImage(image_id);
+    config.SetPositionPrior(
+        image_id, reconstruction.Image(image_id).ProjectionCenter() + kOffset);
+  }
+  BOOST_CHECK(config.HasPositionPrior(0));
+  BOOST_CHECK_EQUAL(config.NumPositionPriors(), 3);
+
+  BundleAdjustmentOptions options;
+  options.prior_position_std = 0.01;
+  BundleAdjuster bundle_adjuster(options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 100 points, 3 images, 2 residuals per point per image
+  // + 3 residuals per position prior
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 609);
+
+  for (image_t image_id = 0; image_id < 3; ++image_id) {
+    CheckVariableImage(reconstruction.Image(image_id),
+                       orig_reconstruction.Image(image_id));
+    BOOST_CHECK_LT((reconstruction.Image(image_id).ProjectionCenter() -
+                    config.PositionPrior(image_id))
+                       .norm(),
+                   0.1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestStructureOnly) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantPose(1);
+  config.SetConstantCamera(0);
+  config.SetConstantCamera(1);
+
+  BundleAdjustmentOptions options;
+  BundleAdjuster bundle_adjuster(options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 100 points, 2 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 400);
+  // 100 x 3 point parameters
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced, 300);
+  BOOST_CHECK_LT(summary.final_cost, summary.initial_cost);
+
+  CheckConstantCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckConstantCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestMotionOnly) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+  for (const auto& point3D : reconstruction.Points3D()) {
+    config.AddConstantPoint(point3D.first);
+  }
+
+  BundleAdjustmentOptions options;
+  options.refine_focal_length = false;
+  options.refine_extra_params = false;
+  BundleAdjuster bundle_adjuster(options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 100 points, 2 variable images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 400);
+  // 5 image parameters (pose of second image)
+  // + 6 image parameters (pose of third image)
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced, 11);
+  BOOST_CHECK_LT(summary.final_cost, summary.initial_cost);
+
+  CheckConstantCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckConstantCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  CheckConstantCamera(reconstruction.Camera(2), orig_reconstruction.Camera(2));
+  CheckVariableImage(reconstruction.Image(2), orig_reconstruction.Image(2));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckConstantPoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestConstantFocalLength) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
@@ -644,6 +916,207 @@ BOOST_AUTO_TEST_CASE(TestConstantExtraParam) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestIncrementalTwoView) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  BundleAdjustmentOptions options;
+  IncrementalBundleAdjuster bundle_adjuster(options);
+  BOOST_REQUIRE(bundle_adjuster.Solve(config, &reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 100 points, 2 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 400);
+  // 100 x 3 point parameters
+  // + 5 image parameters (pose of second image)
+  // + 2 x 2 camera parameters
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced, 309);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 200);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 0);
+  BOOST_CHECK_GE(bundle_adjuster.SetUpTime(), 0);
+
+  CheckVariableCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestIncrementalReuseProblem) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(3, 100, &reconstruction, &correspondence_graph);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  IncrementalBundleAdjuster bundle_adjuster(options);
+
+  // Compares the problem to the problem of a new bundle adjuster.
+  const auto CheckProblem = [&](const BundleAdjustmentConfig& ba_config) {
+    Reconstruction reconstruction_copy = reconstruction;
+    BundleAdjuster reference_bundle_adjuster(options, ba_config);
+    BOOST_REQUIRE(reference_bundle_adjuster.Solve(&reconstruction_copy));
+    BOOST_REQUIRE(bundle_adjuster.Solve(ba_config, &reconstruction));
+    BOOST_CHECK_EQUAL(bundle_adjuster.Summary().num_residuals_reduced,
+                      reference_bundle_adjuster.Summary().num_residuals_reduced);
+    BOOST_CHECK_EQUAL(
+        bundle_adjuster.Summary().num_effective_parameters_reduced,
+        reference_bundle_adjuster.Summary().num_effective_parameters_reduced);
+  };
+
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 200);
+
+  // Only the constant pose residuals of the points observed in the third
+  // image are added.
+  const point3D_t point3D_id1 = reconstruction.Image(0).Point2D(0).Point3DId();
+  config.AddVariablePoint(point3D_id1);
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 1);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 0);
+
+  // Deleted observations and 3D points remove their residuals.
+  reconstruction.DeleteObservation(1, 1);
+  const point3D_t point3D_id2 = reconstruction.Image(0).Point2D(2).Point3DId();
+  reconstruction.DeletePoint3D(point3D_id2);
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 0);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 3);
+
+  // A new 3D point, which may reuse the memory of the deleted 3D point.
+  Track track;
+  track.AddElement(0, 2);
+  track.AddElement(1, 2);
+  reconstruction.AddPoint3D(Eigen::Vector3d(0, 0, 0), track);
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 2);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 0);
+
+  // The residuals of images whose pose becomes constant or variable are
+  // recreated.
+  config.SetConstantPose(1);
+  config.RemoveConstantTvec(1);
+  config.AddImage(2);
+  config.SetConstantTvec(2, {0});
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 198);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 100);
+
+  // The residuals of the constant poses are recreated after the pose changed.
+  reconstruction.Image(0).Tvec(0) += 0.01;
+  CheckProblem(config);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 100);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumRemovedResidualBlocks(), 100);
+}
+
+BOOST_AUTO_TEST_CASE(TestIncrementalWarmStart) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.print_summary = false;
+  const bool kWarmStart = true;
+  IncrementalBundleAdjuster bundle_adjuster(options, kWarmStart);
+
+  BOOST_REQUIRE(bundle_adjuster.Solve(config, &reconstruction));
+  BOOST_REQUIRE(!bundle_adjuster.Summary().iterations.empty());
+  const double trust_region_radius =
+      bundle_adjuster.Summary().iterations.back().trust_region_radius;
+
+  // The next call starts with the final trust region radius.
+  BOOST_REQUIRE(bundle_adjuster.Solve(config, &reconstruction));
+  BOOST_CHECK_EQUAL(
+      bundle_adjuster.Summary().iterations.front().trust_region_radius,
+      trust_region_radius);
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumAddedResidualBlocks(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestPartitioned) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(6, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  for (image_t image_id = 0; image_id < 6; ++image_id) {
+    config.AddImage(image_id);
+  }
+  config.SetConstantPose(0);
+  config.SetConstantCamera(0);
+  config.SetConstantTvec(1, {0});
+
+  PartitionedBundleAdjuster::Options options;
+  options.max_num_images = 2;
+  options.image_overlap = 1;
+  BundleAdjustmentOptions ba_options;
+  PartitionedBundleAdjuster bundle_adjuster(options, ba_options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+  BOOST_CHECK_GT(bundle_adjuster.NumPartitions(), 1);
+
+  CheckConstantCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (camera_t camera_id = 2; camera_id < 6; ++camera_id) {
+    CheckVariableCamera(reconstruction.Camera(camera_id),
+                        orig_reconstruction.Camera(camera_id));
+    CheckVariableImage(reconstruction.Image(camera_id),
+                       orig_reconstruction.Image(camera_id));
+  }
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestPartitionedSinglePartition) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantTvec(1, {0});
+
+  PartitionedBundleAdjuster::Options options;
+  BundleAdjustmentOptions ba_options;
+  PartitionedBundleAdjuster bundle_adjuster(options, ba_options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+  BOOST_CHECK_EQUAL(bundle_adjuster.NumPartitions(), 1);
+}
+
 BOOST_AUTO_TEST_CASE(TestParallelReconstructionSupported) {
   BundleAdjustmentOptions options;
   options.refine_focal_length = true;
@@ -657,7 +1130,15 @@ BOOST_AUTO_TEST_CASE(TestParallelReconstructionSupported) {
   reconstruction.Camera(0).SetModelIdFromName("SIMPLE_PINHOLE");
   BOOST_CHECK(!ParallelBundleAdjuster::IsSupported(options, reconstruction));
 
+  reconstruction.Camera(1).SetModelIdFromName("SIMPLE_PINHOLE");
+  BOOST_CHECK(ParallelBundleAdjuster::IsSupported(options, reconstruction));
+
+  reconstruction.Camera(0).SetModelIdFromName("PINHOLE");
+  reconstruction.Camera(1).SetModelIdFromName("PINHOLE");
+  BOOST_CHECK(!ParallelBundleAdjuster::IsSupported(options, reconstruction));
+
   reconstruction.Camera(0).SetModelIdFromName("SIMPLE_RADIAL");
+  reconstruction.Camera(1).SetModelIdFromName("SIMPLE_RADIAL");
   BOOST_CHECK(ParallelBundleAdjuster::IsSupported(options, reconstruction));
 
   options.refine_principal_point = true;
@@ -752,6 +1233,47 @@ BOOST_AUTO_TEST_CASE(TestParallelTwoViewConstantIntrinsics) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestParallelTwoViewConstantPose) {
+  Reconstruction reconstruction;
+  CorrespondenceGraph correspondence_graph;
+  GenerateReconstruction(2, 100, &reconstruction, &correspondence_graph);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantPose(0);
+  config.SetConstantCamera(0);
+
+  ParallelBundleAdjuster::Options options;
+  BundleAdjustmentOptions ba_options;
+  ba_options.refine_focal_length = true;
+  ba_options.refine_principal_point = false;
+  ba_options.refine_extra_params = true;
+  ParallelBundleAdjuster bundle_adjuster(options, ba_options, config);
+  BOOST_REQUIRE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  // 100 points, 2 images, 2 residuals per point per image
+  BOOST_CHECK_EQUAL(summary.num_residuals_reduced, 400);
+  // 100 x 3 point parameters
+  // + 6 image parameters
+  // + 2 camera parameters
+  BOOST_CHECK_EQUAL(summary.num_effective_parameters_reduced, 308);
+
+  CheckConstantCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckVariableImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestRigTwoView) {
   Reconstruction reconstruction;
   CorrespondenceGraph correspondence_graph;
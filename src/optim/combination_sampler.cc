@@ -31,6 +31,7 @@
 
 #include "optim/combination_sampler.h"
 
+#include <algorithm>
 #include <numeric>
 
 #include "util/math.h"
@@ -39,7 +40,7 @@
 namespace colmap {
 
 CombinationSampler::CombinationSampler(const size_t num_samples)
-    : num_samples_(num_samples) {}
+    : Sampler(num_samples) {}
 
 void CombinationSampler::Initialize(const size_t total_num_samples) {
   CHECK_LE(num_samples_, total_num_samples);
@@ -52,11 +53,9 @@ size_t CombinationSampler::MaxNumSamples() {
   return NChooseK(total_sample_idxs_.size(), num_samples_);
 }
 
-std::vector<size_t> CombinationSampler::Sample() {
-  std::vector<size_t> sampled_idxs(num_samples_);
-  for (size_t i = 0; i < num_samples_; ++i) {
-    sampled_idxs[i] = total_sample_idxs_[i];
-  }
+void CombinationSampler::Sample(size_t* sample_idxs) {
+  std::copy(total_sample_idxs_.begin(),
+            total_sample_idxs_.begin() + num_samples_, sample_idxs);
 
   if (!NextCombination(total_sample_idxs_.begin(),
                        total_sample_idxs_.begin() + num_samples_,
@@ -65,8 +64,6 @@ std::vector<size_t> CombinationSampler::Sample() {
     // Note that the samples must be in increasing order for `NextCombination`.
     std::iota(total_sample_idxs_.begin(), total_sample_idxs_.end(), 0);
   }
-
-  return sampled_idxs;
 }
 
 }  // namespace colmap
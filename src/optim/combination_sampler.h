@@ -48,10 +48,10 @@ class CombinationSampler : public Sampler {
 
   size_t MaxNumSamples() override;
 
-  std::vector<size_t> Sample() override;
+  using Sampler::Sample;
+  void Sample(size_t* sample_idxs) override;
 
  private:
-  const size_t num_samples_;
   std::vector<size_t> total_sample_idxs_;
 };
 
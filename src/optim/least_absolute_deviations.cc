@@ -34,15 +34,6 @@
 #include <Eigen/SparseCholesky>
 
 namespace colmap {
-namespace {
-
-Eigen::VectorXd Shrinkage(const Eigen::VectorXd& a, const double kappa) {
-  const Eigen::VectorXd a_plus_kappa = a.array() + kappa;
-  const Eigen::VectorXd a_minus_kappa = a.array() - kappa;
-  return a_plus_kappa.cwiseMin(0) + a_minus_kappa.cwiseMax(0);
-}
-
-}  // namespace
 
 bool SolveLeastAbsoluteDeviations(const LeastAbsoluteDeviationsOptions& options,
                                   const Eigen::SparseMatrix<double>& A,
@@ -55,44 +46,66 @@ bool SolveLeastAbsoluteDeviations(const LeastAbsoluteDeviationsOptions& options,
   CHECK_GE(options.absolute_tolerance, 0);
   CHECK_GE(options.relative_tolerance, 0);
 
+  // The transpose is stored explicitly, such that its products are computed
+  // row-wise like the products with A.
+  const Eigen::SparseMatrix<double> At = A.transpose();
+
   Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> linear_solver;
-  linear_solver.compute(A.transpose() * A);
+  linear_solver.compute(At * A);
 
   Eigen::VectorXd z = Eigen::VectorXd::Zero(A.rows());
-  Eigen::VectorXd z_old(A.rows());
   Eigen::VectorXd u = Eigen::VectorXd::Zero(A.rows());
 
   Eigen::VectorXd Ax(A.rows());
   Eigen::VectorXd Ax_hat(A.rows());
 
+  // The products of the transpose with b, z, and u are maintained across the
+  // iterations. By linearity, only A * x and A^T * z have to be computed in
+  // each iteration instead of also A^T * (b + z - u), A^T * (z - z_old), and
+  // A^T * u, which dominate the cost of the iterations.
+  const Eigen::VectorXd Atb = At * b;
+  Eigen::VectorXd Atz = Eigen::VectorXd::Zero(A.cols());
+  Eigen::VectorXd Atz_old(A.cols());
+  Eigen::VectorXd Atu = Eigen::VectorXd::Zero(A.cols());
+  Eigen::VectorXd rhs(A.cols());
+
   const double b_norm = b.norm();
   const double eps_pri_threshold =
       std::sqrt(A.rows()) * options.absolute_tolerance;
   const double eps_dual_threshold =
       std::sqrt(A.cols()) * options.absolute_tolerance;
+  const double kappa = 1 / options.rho;
 
   for (int i = 0; i < options.max_num_iterations; ++i) {
-    *x = linear_solver.solve(A.transpose() * (b + z - u));
+    rhs = Atb + Atz - Atu;
+    *x = linear_solver.solve(rhs);
     if (linear_solver.info() != Eigen::Success) {
       return false;
     }
 
-    Ax = A * *x;
+    Ax.noalias() = A * *x;
     Ax_hat = options.alpha * Ax + (1 - options.alpha) * (z + b);
 
-    z_old = z;
-    z = Shrinkage(Ax_hat - b + u, 1 / options.rho);
+    // Shrinkage of Ax_hat - b + u, where u temporarily holds this sum.
+    u += Ax_hat - b;
+    z = (u.array() + kappa).min(0) + (u.array() - kappa).max(0);
+    u -= z;
+
+    Atz_old = Atz;
+    Atz.noalias() = At * z;
 
-    u += Ax_hat - z - b;
+    // A^T * Ax_hat follows from the normal equations A^T * A * x = rhs.
+    Atu += options.alpha * rhs + (1 - options.alpha) * (Atz_old + Atb) - Atz -
+           Atb;
 
     const double r_norm = (Ax - z - b).norm();
-    const double s_norm = (-options.rho * A.transpose() * (z - z_old)).norm();
+    const double s_norm = options.rho * (Atz - Atz_old).norm();
     const double eps_pri =
         eps_pri_threshold + options.relative_tolerance *
                                 std::max(b_norm, std::max(Ax.norm(), z.norm()));
     const double eps_dual =
         eps_dual_threshold +
-        options.relative_tolerance * (options.rho * A.transpose() * u).norm();
+        options.relative_tolerance * options.rho * Atu.norm();
 
     if (r_norm < eps_pri && s_norm < eps_dual) {
       break;
@@ -0,0 +1,79 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "optim/levenberg_marquardt.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include "util/logging.h"
+
+namespace colmap {
+
+void LevenbergMarquardtOptions::Check() const {
+  CHECK_GE(max_num_iterations, 0);
+  CHECK_GE(gradient_tolerance, 0);
+  CHECK_GE(function_tolerance, 0);
+  CHECK_GE(parameter_tolerance, 0);
+  CHECK_GT(initial_damping, 0);
+}
+
+void PrintLevenbergMarquardtSummary(const LevenbergMarquardtSummary& summary,
+                                    const int num_parameters) {
+  std::cout << std::right << std::setw(16) << "Residuals : ";
+  std::cout << std::left << summary.num_residuals << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Parameters : ";
+  std::cout << std::left << num_parameters << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Iterations : ";
+  std::cout << std::left
+            << summary.num_successful_steps + summary.num_unsuccessful_steps
+            << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Initial cost : ";
+  std::cout << std::right << std::setprecision(6)
+            << std::sqrt(summary.initial_cost / summary.num_residuals)
+            << " [px]" << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Final cost : ";
+  std::cout << std::right << std::setprecision(6)
+            << std::sqrt(summary.final_cost / summary.num_residuals) << " [px]"
+            << std::endl;
+
+  std::cout << std::right << std::setw(16) << "Termination : ";
+  std::cout << std::right
+            << (summary.converged ? "Convergence" : "No convergence")
+            << std::endl;
+  std::cout << std::endl;
+}
+
+}  // namespace colmap
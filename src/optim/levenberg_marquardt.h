@@ -0,0 +1,214 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_OPTIM_LEVENBERG_MARQUARDT_H_
+#define COLMAP_SRC_OPTIM_LEVENBERG_MARQUARDT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+
+namespace colmap {
+
+struct LevenbergMarquardtOptions {
+  // Maximum number of solver iterations, including unsuccessful steps.
+  int max_num_iterations = 100;
+
+  // Convergence criteria with the same meaning as in Ceres, i.e. the solver
+  // stops if the maximum norm of the gradient, the relative decrease of the
+  // cost, or the relative norm of the step fall below these tolerances.
+  double gradient_tolerance = 1e-10;
+  double function_tolerance = 1e-6;
+  double parameter_tolerance = 1e-8;
+
+  // Initial damping of the normal equations relative to their diagonal.
+  double initial_damping = 1e-4;
+
+  void Check() const;
+};
+
+struct LevenbergMarquardtSummary {
+  // Number of residuals of the problem.
+  size_t num_residuals = 0;
+
+  // Number of successful and unsuccessful steps.
+  size_t num_successful_steps = 0;
+  size_t num_unsuccessful_steps = 0;
+
+  // The cost before and after the optimization.
+  double initial_cost = 0;
+  double final_cost = 0;
+
+  // Whether one of the convergence criteria was met.
+  bool converged = false;
+
+  bool IsSolutionUsable() const { return std::isfinite(final_cost); }
+};
+
+// Print the summary in the same format as the Ceres solver summaries.
+void PrintLevenbergMarquardtSummary(const LevenbergMarquardtSummary& summary,
+                                    const int num_parameters);
+
+// Minimize a small non-linear least squares problem with a fixed number of
+// parameters using the Levenberg-Marquardt algorithm. In contrast to Ceres,
+// the problem evaluates its normal equations directly with fixed-size types,
+// which avoids any memory allocation and per-residual setup and makes the
+// solver suited for problems that are solved very often, e.g. the refinement
+// of a single pose. The problem must implement:
+//
+//    // The parameters, which are updated by the steps of the solver.
+//    typedef ... Parameters;
+//
+//    // Evaluate the cost at the given parameters and, if H and g are not
+//    // null, the (approximate) Hessian J^T * J and the gradient J^T * r
+//    // w.r.t. the local parameterization.
+//    double Evaluate(const Parameters& params,
+//                    Eigen::Matrix<double, kNumParams, kNumParams>* H,
+//                    Eigen::Matrix<double, kNumParams, 1>* g) const;
+//
+//    // Apply the step in the local parameterization to the parameters.
+//    Parameters Plus(const Parameters& params,
+//                    const Eigen::Matrix<double, kNumParams, 1>& step) const;
+//
+//    // Norm of the parameters for the relative step size criterion.
+//    double Norm(const Parameters& params) const;
+//
+//    // The number of residuals, for reporting only.
+//    size_t NumResiduals() const;
+template <int kNumParams, typename Problem>
+LevenbergMarquardtSummary SolveLevenbergMarquardt(
+    const LevenbergMarquardtOptions& options, const Problem& problem,
+    typename Problem::Parameters* params);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <int kNumParams, typename Problem>
+LevenbergMarquardtSummary SolveLevenbergMarquardt(
+    const LevenbergMarquardtOptions& options, const Problem& problem,
+    typename Problem::Parameters* params) {
+  typedef Eigen::Matrix<double, kNumParams, kNumParams> MatrixType;
+  typedef Eigen::Matrix<double, kNumParams, 1> VectorType;
+
+  // Same limits of the diagonal damping as in Ceres.
+  const double kMinDiagonal = 1e-6;
+  const double kMaxDiagonal = 1e32;
+
+  // Minimum ratio of the actual over the predicted cost decrease of a
+  // successful step.
+  const double kMinRelativeDecrease = 1e-3;
+
+  LevenbergMarquardtSummary summary;
+  summary.num_residuals = problem.NumResiduals();
+
+  MatrixType H;
+  VectorType g;
+  double cost = problem.Evaluate(*params, &H, &g);
+  summary.initial_cost = cost;
+  summary.final_cost = cost;
+
+  if (!std::isfinite(cost)) {
+    return summary;
+  }
+
+  double damping = options.initial_damping;
+  double damping_factor = 2;
+
+  for (int iteration = 0; iteration < options.max_num_iterations;
+       ++iteration) {
+    if (g.template lpNorm<Eigen::Infinity>() <= options.gradient_tolerance) {
+      summary.converged = true;
+      break;
+    }
+
+    MatrixType H_damped = H;
+    for (int i = 0; i < kNumParams; ++i) {
+      H_damped(i, i) +=
+          damping * std::min(std::max(H(i, i), kMinDiagonal), kMaxDiagonal);
+    }
+
+    const VectorType step = H_damped.ldlt().solve(-g);
+    if (!step.allFinite()) {
+      break;
+    }
+
+    if (step.norm() <= options.parameter_tolerance *
+                           (problem.Norm(*params) +
+                            options.parameter_tolerance)) {
+      summary.converged = true;
+      break;
+    }
+
+    const typename Problem::Parameters new_params =
+        problem.Plus(*params, step);
+    const double new_cost = problem.Evaluate(new_params, nullptr, nullptr);
+
+    // The decrease predicted by the linearized model of the cost.
+    const double predicted_decrease =
+        -step.dot(g) - 0.5 * step.dot(H * step);
+    const double relative_decrease =
+        (cost - new_cost) / std::max(predicted_decrease,
+                                     std::numeric_limits<double>::min());
+
+    if (std::isfinite(new_cost) && new_cost < cost &&
+        relative_decrease > kMinRelativeDecrease) {
+      summary.num_successful_steps += 1;
+
+      const double cost_change = cost - new_cost;
+      *params = new_params;
+      cost = problem.Evaluate(*params, &H, &g);
+
+      damping *= std::max(1.0 / 3.0,
+                          1.0 - std::pow(2 * relative_decrease - 1, 3));
+      damping_factor = 2;
+
+      if (cost_change <= options.function_tolerance * (cost + cost_change)) {
+        summary.converged = true;
+        break;
+      }
+    } else {
+      summary.num_unsuccessful_steps += 1;
+      damping *= damping_factor;
+      damping_factor *= 2;
+    }
+  }
+
+  summary.final_cost = cost;
+
+  return summary;
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_OPTIM_LEVENBERG_MARQUARDT_H_
@@ -0,0 +1,134 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "optim/levenberg_marquardt"
+#include "util/testing.h"
+
+#include <Eigen/Core>
+
+#include "optim/levenberg_marquardt.h"
+
+using namespace colmap;
+
+namespace {
+
+// Fit the curve y = exp(a * x + b) to the given samples.
+class CurveFittingProblem {
+ public:
+  typedef Eigen::Vector2d Parameters;
+
+  CurveFittingProblem(const std::vector<double>& x,
+                      const std::vector<double>& y)
+      : x_(x), y_(y) {}
+
+  double Evaluate(const Parameters& params, Eigen::Matrix2d* H,
+                  Eigen::Vector2d* g) const {
+    if (H != nullptr) {
+      H->setZero();
+      g->setZero();
+    }
+    double cost = 0;
+    for (size_t i = 0; i < x_.size(); ++i) {
+      const double y = std::exp(params(0) * x_[i] + params(1));
+      const double residual = y - y_[i];
+      cost += 0.5 * residual * residual;
+      if (H != nullptr) {
+        const Eigen::Vector2d J(x_[i] * y, y);
+        *H += J * J.transpose();
+        *g += residual * J;
+      }
+    }
+    return cost;
+  }
+
+  Parameters Plus(const Parameters& params, const Eigen::Vector2d& step) const {
+    return params + step;
+  }
+
+  double Norm(const Parameters& params) const { return params.norm(); }
+
+  size_t NumResiduals() const { return x_.size(); }
+
+ private:
+  const std::vector<double>& x_;
+  const std::vector<double>& y_;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestOptions) {
+  LevenbergMarquardtOptions options;
+  BOOST_CHECK_EQUAL(options.max_num_iterations, 100);
+  BOOST_CHECK_EQUAL(options.gradient_tolerance, 1e-10);
+  BOOST_CHECK_EQUAL(options.function_tolerance, 1e-6);
+  BOOST_CHECK_EQUAL(options.parameter_tolerance, 1e-8);
+  options.Check();
+}
+
+BOOST_AUTO_TEST_CASE(TestCurveFitting) {
+  std::vector<double> x;
+  std::vector<double> y;
+  for (int i = 0; i < 20; ++i) {
+    x.push_back(0.1 * i);
+    y.push_back(std::exp(0.3 * x.back() + 0.1));
+  }
+
+  const CurveFittingProblem problem(x, y);
+  Eigen::Vector2d params(0, 0);
+  LevenbergMarquardtOptions options;
+  options.function_tolerance = 0;
+  const LevenbergMarquardtSummary summary =
+      SolveLevenbergMarquardt<2>(options, problem, &params);
+
+  BOOST_CHECK(summary.IsSolutionUsable());
+  BOOST_CHECK(summary.converged);
+  BOOST_CHECK_EQUAL(summary.num_residuals, 20);
+  BOOST_CHECK_GT(summary.num_successful_steps, 0);
+  BOOST_CHECK_LT(summary.final_cost, summary.initial_cost);
+  BOOST_CHECK_LT(summary.final_cost, 1e-12);
+  BOOST_CHECK_LT(std::abs(params(0) - 0.3), 1e-6);
+  BOOST_CHECK_LT(std::abs(params(1) - 0.1), 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(TestNoIterations) {
+  std::vector<double> x = {0, 1};
+  std::vector<double> y = {1, 2};
+  const CurveFittingProblem problem(x, y);
+  Eigen::Vector2d params(0, 0);
+  LevenbergMarquardtOptions options;
+  options.max_num_iterations = 0;
+  const LevenbergMarquardtSummary summary =
+      SolveLevenbergMarquardt<2>(options, problem, &params);
+  BOOST_CHECK(summary.IsSolutionUsable());
+  BOOST_CHECK(!summary.converged);
+  BOOST_CHECK_EQUAL(summary.num_successful_steps, 0);
+  BOOST_CHECK_EQUAL(summary.initial_cost, summary.final_cost);
+  BOOST_CHECK_EQUAL(params, Eigen::Vector2d(0, 0));
+}
@@ -32,16 +32,20 @@
 #ifndef COLMAP_SRC_OPTIM_LORANSAC_H_
 #define COLMAP_SRC_OPTIM_LORANSAC_H_
 
+#include <algorithm>
 #include <cfloat>
 #include <random>
 #include <stdexcept>
 #include <vector>
 
+#include "optim/progressive_sampler.h"
 #include "optim/random_sampler.h"
 #include "optim/ransac.h"
 #include "optim/support_measurement.h"
 #include "util/alignment.h"
 #include "util/logging.h"
+#include "util/random.h"
+#include "util/timer.h"
 
 namespace colmap {
 
@@ -73,9 +77,41 @@ class LORANSAC : public RANSAC<Estimator, SupportMeasurer, Sampler> {
   using RANSAC<Estimator, SupportMeasurer, Sampler>::support_measurer;
 
  private:
+  using typename RANSAC<Estimator, SupportMeasurer, Sampler>::SampleModels;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::kNumTrialsPerBatch;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::CreateSPRTEvaluator;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::CreateThreadPool;
+  using RANSAC<Estimator, SupportMeasurer,
+               Sampler>::EstimateSampleModelsBatch;
   using RANSAC<Estimator, SupportMeasurer, Sampler>::options_;
+
+  // Recursively re-estimate the best model from its inliers with the local
+  // estimator, as long as its support improves. The residuals must be those
+  // of the best model. If `max_num_samples` is not zero, the model is
+  // estimated from a random subset of at most as many inliers. Returns
+  // whether the inliers were subsampled.
+  bool LocallyOptimizeModel(const std::vector<typename Estimator::X_t>& X,
+                            const std::vector<typename Estimator::Y_t>& Y,
+                            const double max_residual,
+                            const size_t max_num_samples,
+                            std::vector<double>* residuals,
+                            typename SupportMeasurer::Support* best_support,
+                            typename Estimator::M_t* best_model,
+                            bool* best_model_is_local);
 };
 
+// Robustly estimate the model with LO-RANSAC, where the sampler is chosen at
+// run-time. If `progressive_sampling` is true, the samples are drawn with
+// PROSAC, which assumes that the data is sorted by quality in descending
+// order, and otherwise uniformly at random. In both cases, the report is
+// returned as the report of the random sampler.
+template <typename Estimator, typename LocalEstimator>
+typename LORANSAC<Estimator, LocalEstimator>::Report EstimateLORANSAC(
+    const RANSACOptions& options,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const bool progressive_sampling);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -113,14 +149,26 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   const double max_residual = options_.max_error * options_.max_error;
 
   std::vector<double> residuals;
-  std::vector<double> best_local_residuals;
+  std::vector<double> block_residuals;
 
-  std::vector<typename LocalEstimator::X_t> X_inlier;
-  std::vector<typename LocalEstimator::Y_t> Y_inlier;
+  // Whether the local optimization of the best model was bounded, such that
+  // the best model must finally be re-estimated from all its inliers.
+  bool refit_best_model = false;
+  Timer local_optimization_timer;
 
   std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
 
+  const auto sprt_evaluator = CreateSPRTEvaluator(X, Y);
+  const RANSACBlockEvaluator<Estimator> block_evaluator(X, Y);
+  const auto thread_pool = CreateThreadPool();
+
+  std::vector<SampleModels> batch;
+  size_t batch_idx = 0;
+
+  // Reused between the trials to avoid allocations in the minimal solvers.
+  SampleModels sample_models;
+
   sampler.Initialize(num_samples);
 
   size_t max_num_trials = options_.max_num_trials;
@@ -134,21 +182,61 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
       break;
     }
 
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
-
     // Estimate model for current subset.
-    const std::vector<typename Estimator::M_t> sample_models =
-        estimator.Estimate(X_rand, Y_rand);
+    if (thread_pool) {
+      if (batch_idx == batch.size()) {
+        const size_t num_batch_trials = std::min<size_t>(
+            kNumTrialsPerBatch, max_num_trials - report.num_trials);
+        EstimateSampleModelsBatch(X, Y, max_residual, num_batch_trials,
+                                  block_evaluator, best_support,
+                                  thread_pool.get(), &batch);
+        batch_idx = 0;
+      }
+      std::swap(sample_models, batch[batch_idx]);
+      batch_idx += 1;
+    } else {
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+      EstimateSampleModels(estimator, X_rand, Y_rand, &sample_models.models);
+    }
 
     // Iterate through all estimated models
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+    for (size_t model_idx = 0; model_idx < sample_models.models.size();
+         ++model_idx) {
+      const auto& sample_model = sample_models.models[model_idx];
+
+      typename SupportMeasurer::Support support;
+      if (thread_pool) {
+        support = sample_models.supports[model_idx];
+      } else {
+        if (sprt_evaluator) {
+          if (!sprt_evaluator->Evaluate(estimator, sample_model, max_residual,
+                                        &residuals)) {
+            if (report.num_trials >= dyn_max_num_trials &&
+                report.num_trials >= options_.min_num_trials) {
+              abort = true;
+              break;
+            }
+            continue;
+          }
+          CHECK_EQ(residuals.size(), num_samples);
+          support = support_measurer.Evaluate(residuals, max_residual);
+        } else {
+          // Rejected models have a support that is never the best support.
+          block_evaluator.Evaluate(estimator, support_measurer, sample_model,
+                                   max_residual, best_support,
+                                   &block_residuals, &residuals, &support);
+        }
+      }
 
       // Do local optimization if better than all previous subsets.
       if (support_measurer.Compare(support, best_support)) {
+        // The residuals of models evaluated in parallel are not kept, but
+        // are required to extract the inliers for local optimization.
+        if (thread_pool) {
+          estimator.Residuals(X, Y, sample_model, &residuals);
+          CHECK_EQ(residuals.size(), num_samples);
+        }
+
         best_support = support;
         best_model = sample_model;
         best_model_is_local = false;
@@ -156,51 +244,20 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
         // Estimate locally optimized model from inliers.
         if (support.num_inliers > Estimator::kMinNumSamples &&
             support.num_inliers >= LocalEstimator::kMinNumSamples) {
-          // Recursive local optimization to expand inlier set.
-          const size_t kMaxNumLocalTrials = 10;
-          for (size_t local_num_trials = 0;
-               local_num_trials < kMaxNumLocalTrials; ++local_num_trials) {
-            X_inlier.clear();
-            Y_inlier.clear();
-            X_inlier.reserve(num_samples);
-            Y_inlier.reserve(num_samples);
-            for (size_t i = 0; i < residuals.size(); ++i) {
-              if (residuals[i] <= max_residual) {
-                X_inlier.push_back(X[i]);
-                Y_inlier.push_back(Y[i]);
-              }
-            }
-
-            const std::vector<typename LocalEstimator::M_t> local_models =
-                local_estimator.Estimate(X_inlier, Y_inlier);
-
-            const size_t prev_best_num_inliers = best_support.num_inliers;
-
-            for (const auto& local_model : local_models) {
-              local_estimator.Residuals(X, Y, local_model, &residuals);
-              CHECK_EQ(residuals.size(), num_samples);
-
-              const auto local_support =
-                  support_measurer.Evaluate(residuals, max_residual);
-
-              // Check if locally optimized model is better.
-              if (support_measurer.Compare(local_support, best_support)) {
-                best_support = local_support;
-                best_model = local_model;
-                best_model_is_local = true;
-                std::swap(residuals, best_local_residuals);
-              }
-            }
-
-            // Only continue recursive local optimization, if the inlier set
-            // size increased and we thus have a chance to further improve.
-            if (best_support.num_inliers <= prev_best_num_inliers) {
-              break;
+          if (options_.lo_max_num_runs == 0 ||
+              report.num_local_optimizations < options_.lo_max_num_runs) {
+            local_optimization_timer.Restart();
+            if (LocallyOptimizeModel(X, Y, max_residual,
+                                     options_.lo_max_num_samples, &residuals,
+                                     &best_support, &best_model,
+                                     &best_model_is_local)) {
+              refit_best_model = true;
             }
-
-            // Swap back the residuals, so we can extract the best inlier
-            // set in the next recursion of local optimization.
-            std::swap(residuals, best_local_residuals);
+            report.num_local_optimizations += 1;
+            report.local_optimization_seconds +=
+                local_optimization_timer.ElapsedSeconds();
+          } else {
+            refit_best_model = true;
           }
         }
 
@@ -208,6 +265,11 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
             RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
                 best_support.num_inliers, num_samples, options_.confidence,
                 options_.dyn_num_trials_multiplier);
+
+        if (sprt_evaluator) {
+          sprt_evaluator->UpdateInlierRatio(
+              best_support.num_inliers / static_cast<double>(num_samples));
+        }
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -218,14 +280,34 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
     }
   }
 
-  report.support = best_support;
-  report.model = best_model;
-
   // No valid model was found
-  if (report.support.num_inliers < estimator.kMinNumSamples) {
+  if (best_support.num_inliers < estimator.kMinNumSamples) {
+    report.support = best_support;
+    report.model = best_model;
     return report;
   }
 
+  // Re-estimate the best model from all its inliers, if its local
+  // optimization was bounded.
+  if (refit_best_model &&
+      best_support.num_inliers >= LocalEstimator::kMinNumSamples) {
+    local_optimization_timer.Restart();
+    if (best_model_is_local) {
+      local_estimator.Residuals(X, Y, best_model, &residuals);
+    } else {
+      estimator.Residuals(X, Y, best_model, &residuals);
+    }
+    CHECK_EQ(residuals.size(), num_samples);
+    const size_t kMaxNumSamples = 0;
+    LocallyOptimizeModel(X, Y, max_residual, kMaxNumSamples, &residuals,
+                         &best_support, &best_model, &best_model_is_local);
+    report.num_local_optimizations += 1;
+    report.local_optimization_seconds +=
+        local_optimization_timer.ElapsedSeconds();
+  }
+
+  report.support = best_support;
+  report.model = best_model;
   report.success = true;
 
   // Determine inlier mask. Note that this calculates the residuals for the
@@ -248,6 +330,117 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
   return report;
 }
 
+template <typename Estimator, typename LocalEstimator, typename SupportMeasurer,
+          typename Sampler>
+bool LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::
+    LocallyOptimizeModel(const std::vector<typename Estimator::X_t>& X,
+                         const std::vector<typename Estimator::Y_t>& Y,
+                         const double max_residual,
+                         const size_t max_num_samples,
+                         std::vector<double>* residuals,
+                         typename SupportMeasurer::Support* best_support,
+                         typename Estimator::M_t* best_model,
+                         bool* best_model_is_local) {
+  const size_t num_samples = X.size();
+
+  std::vector<size_t> inlier_idxs;
+  std::vector<typename LocalEstimator::X_t> X_inlier;
+  std::vector<typename LocalEstimator::Y_t> Y_inlier;
+  std::vector<double> best_local_residuals;
+
+  bool subsampled = false;
+
+  // Recursive local optimization to expand inlier set.
+  const size_t kMaxNumLocalTrials = 10;
+  for (size_t local_num_trials = 0; local_num_trials < kMaxNumLocalTrials;
+       ++local_num_trials) {
+    inlier_idxs.clear();
+    for (size_t i = 0; i < residuals->size(); ++i) {
+      if ((*residuals)[i] <= max_residual) {
+        inlier_idxs.push_back(i);
+      }
+    }
+
+    const size_t num_local_samples =
+        std::max<size_t>(max_num_samples, LocalEstimator::kMinNumSamples);
+    if (max_num_samples > 0 && inlier_idxs.size() > num_local_samples) {
+      Shuffle(static_cast<uint32_t>(num_local_samples), &inlier_idxs);
+      inlier_idxs.resize(num_local_samples);
+      subsampled = true;
+    }
+
+    X_inlier.clear();
+    Y_inlier.clear();
+    X_inlier.reserve(inlier_idxs.size());
+    Y_inlier.reserve(inlier_idxs.size());
+    for (const size_t idx : inlier_idxs) {
+      X_inlier.push_back(X[idx]);
+      Y_inlier.push_back(Y[idx]);
+    }
+
+    const std::vector<typename LocalEstimator::M_t> local_models =
+        local_estimator.Estimate(X_inlier, Y_inlier);
+
+    const size_t prev_best_num_inliers = best_support->num_inliers;
+
+    for (const auto& local_model : local_models) {
+      local_estimator.Residuals(X, Y, local_model, residuals);
+      CHECK_EQ(residuals->size(), num_samples);
+
+      const auto local_support =
+          support_measurer.Evaluate(*residuals, max_residual);
+
+      // Check if locally optimized model is better.
+      if (support_measurer.Compare(local_support, *best_support)) {
+        *best_support = local_support;
+        *best_model = local_model;
+        *best_model_is_local = true;
+        std::swap(*residuals, best_local_residuals);
+      }
+    }
+
+    // Only continue recursive local optimization, if the inlier set size
+    // increased and we thus have a chance to further improve.
+    if (best_support->num_inliers <= prev_best_num_inliers) {
+      break;
+    }
+
+    // Swap back the residuals, so we can extract the best inlier set in the
+    // next recursion of local optimization.
+    std::swap(*residuals, best_local_residuals);
+  }
+
+  return subsampled;
+}
+
+template <typename Estimator, typename LocalEstimator>
+typename LORANSAC<Estimator, LocalEstimator>::Report EstimateLORANSAC(
+    const RANSACOptions& options,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const bool progressive_sampling) {
+  if (!progressive_sampling) {
+    LORANSAC<Estimator, LocalEstimator> ransac(options);
+    return ransac.Estimate(X, Y);
+  }
+
+  LORANSAC<Estimator, LocalEstimator, InlierSupportMeasurer,
+           ProgressiveSampler>
+      ransac(options);
+  auto progressive_report = ransac.Estimate(X, Y);
+
+  typename LORANSAC<Estimator, LocalEstimator>::Report report;
+  report.success = progressive_report.success;
+  report.num_trials = progressive_report.num_trials;
+  report.support = progressive_report.support;
+  report.inlier_mask = std::move(progressive_report.inlier_mask);
+  report.model = progressive_report.model;
+  report.num_local_optimizations = progressive_report.num_local_optimizations;
+  report.local_optimization_seconds =
+      progressive_report.local_optimization_seconds;
+  return report;
+}
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_OPTIM_LORANSAC_H_
@@ -52,6 +52,8 @@ BOOST_AUTO_TEST_CASE(TestReport) {
   BOOST_CHECK_EQUAL(report.support.residual_sum,
                     std::numeric_limits<double>::max());
   BOOST_CHECK_EQUAL(report.inlier_mask.size(), 0);
+  BOOST_CHECK_EQUAL(report.num_local_optimizations, 0);
+  BOOST_CHECK_EQUAL(report.local_optimization_seconds, 0);
 }
 
 BOOST_AUTO_TEST_CASE(TestSimilarityTransform) {
@@ -89,6 +91,7 @@ BOOST_AUTO_TEST_CASE(TestSimilarityTransform) {
 
   BOOST_CHECK_EQUAL(report.success, true);
   BOOST_CHECK_GT(report.num_trials, 0);
+  BOOST_CHECK_GT(report.num_local_optimizations, 0);
 
   // Make sure outliers were detected correctly.
   BOOST_CHECK_EQUAL(report.support.num_inliers, num_samples - num_outliers);
@@ -105,3 +108,201 @@ BOOST_AUTO_TEST_CASE(TestSimilarityTransform) {
       (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
   BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
 }
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformSPRT) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  // Create some arbitrary transformation.
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  // Generate exact data
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // Add some faulty data.
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // Robustly estimate transformation using RANSAC.
+  RANSACOptions options;
+  options.max_error = 10;
+  options.use_sprt = true;
+  LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
+      ransac(options);
+  const auto report = ransac.Estimate(src, dst);
+
+  BOOST_CHECK_EQUAL(report.success, true);
+  BOOST_CHECK_GT(report.num_trials, 0);
+
+  // Make sure outliers were detected correctly.
+  BOOST_CHECK_EQUAL(report.support.num_inliers, num_samples - num_outliers);
+  for (size_t i = 0; i < num_samples; ++i) {
+    if (i < num_outliers) {
+      BOOST_CHECK(!report.inlier_mask[i]);
+    } else {
+      BOOST_CHECK(report.inlier_mask[i]);
+    }
+  }
+
+  // Make sure original transformation is estimated correctly.
+  const double matrix_diff =
+      (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
+  BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformMultiThreaded) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  // Create some arbitrary transformation.
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  // Generate exact data
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // Add some faulty data.
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // The estimation must not depend on the number of threads.
+  RANSACOptions options;
+  options.max_error = 10;
+  SetPRNGSeed(0);
+  LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
+      ransac(options);
+  const auto report = ransac.Estimate(src, dst);
+
+  options.num_threads = 4;
+  SetPRNGSeed(0);
+  LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
+      parallel_ransac(options);
+  const auto parallel_report = parallel_ransac.Estimate(src, dst);
+
+  BOOST_CHECK_EQUAL(parallel_report.success, true);
+  BOOST_CHECK_EQUAL(parallel_report.num_trials, report.num_trials);
+  BOOST_CHECK_EQUAL(parallel_report.support.num_inliers,
+                    report.support.num_inliers);
+  BOOST_CHECK_EQUAL(parallel_report.support.residual_sum,
+                    report.support.residual_sum);
+  BOOST_CHECK(parallel_report.inlier_mask == report.inlier_mask);
+  BOOST_CHECK(parallel_report.model == report.model);
+}
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformProgressive) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // The data is sorted by quality, so the outliers are at the end.
+  for (size_t i = num_samples - num_outliers; i < num_samples; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  RANSACOptions options;
+  options.max_error = 10;
+  for (const bool progressive_sampling : {false, true}) {
+    const auto report =
+        EstimateLORANSAC<SimilarityTransformEstimator<3>,
+                         SimilarityTransformEstimator<3>>(
+            options, src, dst, progressive_sampling);
+
+    BOOST_CHECK_EQUAL(report.success, true);
+    BOOST_CHECK_GT(report.num_trials, 0);
+
+    BOOST_CHECK_EQUAL(report.support.num_inliers, num_samples - num_outliers);
+    for (size_t i = 0; i < num_samples; ++i) {
+      BOOST_CHECK_EQUAL(static_cast<bool>(report.inlier_mask[i]),
+                        i < num_samples - num_outliers);
+    }
+
+    const double matrix_diff =
+        (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
+    BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformBoundedLocalOptimization) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // The local optimization uses a subset of the inliers and only runs once,
+  // before the best model is re-estimated from all inliers.
+  RANSACOptions options;
+  options.max_error = 10;
+  options.lo_max_num_samples = 50;
+  options.lo_max_num_runs = 1;
+  LORANSAC<SimilarityTransformEstimator<3>, SimilarityTransformEstimator<3>>
+      ransac(options);
+  const auto report = ransac.Estimate(src, dst);
+
+  BOOST_CHECK_EQUAL(report.success, true);
+  BOOST_CHECK_EQUAL(report.num_local_optimizations, 2);
+  BOOST_CHECK_GE(report.local_optimization_seconds, 0);
+
+  BOOST_CHECK_EQUAL(report.support.num_inliers, num_samples - num_outliers);
+  for (size_t i = 0; i < num_samples; ++i) {
+    BOOST_CHECK_EQUAL(static_cast<bool>(report.inlier_mask[i]),
+                      i >= num_outliers);
+  }
+
+  const double matrix_diff =
+      (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
+  BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
+}
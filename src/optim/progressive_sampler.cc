@@ -31,15 +31,15 @@
 
 #include "optim/progressive_sampler.h"
 
+#include <algorithm>
 #include <numeric>
 
-#include "util/misc.h"
 #include "util/random.h"
 
 namespace colmap {
 
 ProgressiveSampler::ProgressiveSampler(const size_t num_samples)
-    : num_samples_(num_samples),
+    : Sampler(num_samples),
       total_num_samples_(0),
       t_(0),
       n_(0),
@@ -69,7 +69,7 @@ size_t ProgressiveSampler::MaxNumSamples() {
   return std::numeric_limits<size_t>::max();
 }
 
-std::vector<size_t> ProgressiveSampler::Sample() {
+void ProgressiveSampler::Sample(size_t* sample_idxs) {
   t_ += 1;
 
   // Compute T_n_p_ using recurrent relation in equation 3 (second part).
@@ -90,25 +90,23 @@ std::vector<size_t> ProgressiveSampler::Sample() {
   }
 
   // Draw semi-random samples as described in algorithm 1.
-  std::vector<size_t> sampled_idxs;
-  sampled_idxs.reserve(num_samples_);
   for (size_t i = 0; i < num_random_samples; ++i) {
     while (true) {
       const size_t random_idx =
           RandomInteger<uint32_t>(0, max_random_sample_idx);
-      if (!VectorContainsValue(sampled_idxs, random_idx)) {
-        sampled_idxs.push_back(random_idx);
+      if (std::find(sample_idxs, sample_idxs + i, random_idx) ==
+          sample_idxs + i) {
+        sample_idxs[i] = random_idx;
         break;
       }
     }
   }
 
-  // In progressive sampling mode, the last element is mandatory.
+  // In progressive sampling mode, the n-th element is mandatory, i.e. the
+  // last element of the current subset of the n highest quality elements.
   if (T_n_p_ >= t_) {
-    sampled_idxs.push_back(n_);
+    sample_idxs[num_random_samples] = n_ - 1;
   }
-
-  return sampled_idxs;
 }
 
 }  // namespace colmap
@@ -53,10 +53,10 @@ class ProgressiveSampler : public Sampler {
 
   size_t MaxNumSamples() override;
 
-  std::vector<size_t> Sample() override;
+  using Sampler::Sample;
+  void Sample(size_t* sample_idxs) override;
 
  private:
-  const size_t num_samples_;
   size_t total_num_samples_;
 
   // The number of generated samples, i.e. the number of calls to `Sample`.
@@ -59,6 +59,9 @@ BOOST_AUTO_TEST_CASE(TestEqualSamples) {
   for (size_t i = 0; i < 100; ++i) {
     const auto samples = sampler.Sample();
     BOOST_CHECK_EQUAL(samples.size(), 5);
+    for (const size_t sample : samples) {
+      BOOST_CHECK_LT(sample, 5);
+    }
     BOOST_CHECK_EQUAL(
         std::unordered_set<size_t>(samples.begin(), samples.end()).size(), 5);
   }
@@ -68,9 +71,12 @@ BOOST_AUTO_TEST_CASE(TestProgressive) {
   const size_t kNumSamples = 5;
   ProgressiveSampler sampler(kNumSamples);
   sampler.Initialize(50);
-  size_t prev_last_sample = 5;
+  size_t prev_last_sample = kNumSamples - 1;
   for (size_t i = 0; i < 100; ++i) {
     const auto samples = sampler.Sample();
+    for (const size_t sample : samples) {
+      BOOST_CHECK_LT(sample, 50);
+    }
     for (size_t i = 0; i < samples.size() - 1; ++i) {
       BOOST_CHECK_LT(samples[i], samples.back());
       BOOST_CHECK_GE(samples.back(), prev_last_sample);
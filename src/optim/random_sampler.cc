@@ -31,6 +31,7 @@
 
 #include "optim/random_sampler.h"
 
+#include <algorithm>
 #include <numeric>
 
 #include "util/random.h"
@@ -38,7 +39,7 @@
 namespace colmap {
 
 RandomSampler::RandomSampler(const size_t num_samples)
-    : num_samples_(num_samples) {}
+    : Sampler(num_samples) {}
 
 void RandomSampler::Initialize(const size_t total_num_samples) {
   CHECK_LE(num_samples_, total_num_samples);
@@ -50,15 +51,10 @@ size_t RandomSampler::MaxNumSamples() {
   return std::numeric_limits<size_t>::max();
 }
 
-std::vector<size_t> RandomSampler::Sample() {
+void RandomSampler::Sample(size_t* sample_idxs) {
   Shuffle(static_cast<uint32_t>(num_samples_), &sample_idxs_);
-
-  std::vector<size_t> sampled_idxs(num_samples_);
-  for (size_t i = 0; i < num_samples_; ++i) {
-    sampled_idxs[i] = sample_idxs_[i];
-  }
-
-  return sampled_idxs;
+  std::copy(sample_idxs_.begin(), sample_idxs_.begin() + num_samples_,
+            sample_idxs);
 }
 
 }  // namespace colmap
@@ -32,15 +32,21 @@
 #ifndef COLMAP_SRC_OPTIM_RANSAC_H_
 #define COLMAP_SRC_OPTIM_RANSAC_H_
 
+#include <array>
 #include <cfloat>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <stdexcept>
 #include <vector>
 
 #include "optim/random_sampler.h"
+#include "optim/sprt.h"
 #include "optim/support_measurement.h"
 #include "util/alignment.h"
 #include "util/logging.h"
+#include "util/random.h"
+#include "util/threading.h"
 
 namespace colmap {
 
@@ -65,6 +71,38 @@ struct RANSACOptions {
   size_t min_num_trials = 0;
   size_t max_num_trials = std::numeric_limits<size_t>::max();
 
+  // Whether to evaluate the models of random samples with the sequential
+  // probability ratio test (SPRT), which rejects bad models after computing
+  // the residuals of only a small subset of the samples. Only used if the
+  // models are evaluated in a single thread.
+  bool use_sprt = false;
+
+  // Initial probability that a sample is consistent with a bad model, which
+  // is then adaptively estimated from the rejected models.
+  double sprt_initial_delta = 0.05;
+
+  // The ratio of the time it takes to estimate a model from a random sample
+  // over the time it takes to compute the residual of one sample.
+  double sprt_eval_time_ratio = 200;
+
+  // Maximum number of inliers, from which a model is re-estimated in the local
+  // optimization of LO-RANSAC. Larger inlier sets are randomly subsampled,
+  // since the non-minimal local estimator then costs far more than the
+  // minimal trials. Zero means no limit.
+  size_t lo_max_num_samples = 2000;
+
+  // Maximum number of local optimizations in LO-RANSAC. Models, which improve
+  // on the best model after that, are kept without local optimization. Zero
+  // means no limit. If the inliers were subsampled or local optimizations were
+  // skipped, the best model is finally re-estimated from all its inliers.
+  size_t lo_max_num_runs = 20;
+
+  // Number of threads used to estimate and evaluate the models of batches of
+  // random samples in parallel. The random samples are always drawn in the
+  // calling thread and the models are compared in the sequential order, so
+  // the estimated model does not depend on the number of threads.
+  int num_threads = 1;
+
   void Check() const {
     CHECK_GT(max_error, 0);
     CHECK_GE(min_inlier_ratio, 0);
@@ -72,9 +110,110 @@ struct RANSACOptions {
     CHECK_GE(confidence, 0);
     CHECK_LE(confidence, 1);
     CHECK_LE(min_num_trials, max_num_trials);
+    CHECK_GT(sprt_initial_delta, 0);
+    CHECK_LT(sprt_initial_delta, 1);
+    CHECK_GT(sprt_eval_time_ratio, 0);
+    CHECK_NE(num_threads, 0);
   }
 };
 
+// Adaptive evaluation of models with the sequential probability ratio test as
+// proposed in
+//
+//   "Optimal Randomized RANSAC", Chum and Matas, 2008
+//
+// The samples are randomly permuted once and partitioned into blocks, whose
+// residuals are computed and tested one after another until the model is
+// rejected. The inlier ratio epsilon is set from the best model found so far
+// and the probability delta of a sample being consistent with a bad model is
+// estimated as the average inlier ratio of the rejected models.
+template <typename Estimator>
+class RANSACSPRTEvaluator {
+ public:
+  RANSACSPRTEvaluator(const RANSACOptions& options,
+                      const std::vector<typename Estimator::X_t>& X,
+                      const std::vector<typename Estimator::Y_t>& Y);
+
+  // Compute the residuals of the model. Returns false, if the model was
+  // rejected before all residuals were computed. Otherwise, the residuals of
+  // all samples are returned in their original order.
+  bool Evaluate(Estimator& estimator, const typename Estimator::M_t& model,
+                const double max_residual, std::vector<double>* residuals);
+
+  // Update the test with the inlier ratio of a new best model.
+  void UpdateInlierRatio(const double inlier_ratio);
+
+  size_t NumRejectedModels() const;
+
+ private:
+  void UpdateTest();
+
+  // Number of samples per block, whose residuals are computed at once.
+  static const size_t kBlockSize = 32;
+
+  std::vector<std::vector<typename Estimator::X_t>> X_blocks_;
+  std::vector<std::vector<typename Estimator::Y_t>> Y_blocks_;
+  std::vector<std::vector<size_t>> sample_idxs_blocks_;
+  std::vector<double> block_residuals_;
+
+  SPRT::Options sprt_options_;
+  SPRT sprt_;
+
+  // The test is only meaningful if bad models are less likely to be
+  // consistent with a sample than the best model.
+  bool test_active_;
+
+  size_t num_rejected_models_;
+  double sum_rejected_inlier_ratios_;
+};
+
+// Evaluate the support of a model block by block and stop as soon as the model
+// cannot become better than the best model anymore, such that the residuals
+// of bad models are mostly not computed. In contrast to the SPRT, the test is
+// exact and the evaluated model is rejected only if it is certainly worse.
+template <typename Estimator>
+class RANSACBlockEvaluator {
+ public:
+  RANSACBlockEvaluator(const std::vector<typename Estimator::X_t>& X,
+                       const std::vector<typename Estimator::Y_t>& Y);
+
+  // Compute the residuals and the support of the model. Returns false, if the
+  // model was rejected before all residuals were computed, in which case the
+  // support is default-constructed and never better than another support.
+  // The block residuals are temporary storage, such that the evaluator can be
+  // shared between multiple threads.
+  template <typename SupportMeasurer>
+  bool Evaluate(Estimator& estimator, SupportMeasurer& support_measurer,
+                const typename Estimator::M_t& model,
+                const double max_residual,
+                const typename SupportMeasurer::Support& best_support,
+                std::vector<double>* block_residuals,
+                std::vector<double>* residuals,
+                typename SupportMeasurer::Support* support) const;
+
+ private:
+  // Number of samples per block, whose residuals are computed at once.
+  static const size_t kBlockSize = 128;
+
+  size_t num_samples_;
+  std::vector<std::vector<typename Estimator::X_t>> X_blocks_;
+  std::vector<std::vector<typename Estimator::Y_t>> Y_blocks_;
+};
+
+// Estimate the models of a sample. If the estimator implements
+//
+//    void Estimate(const std::vector<X_t>& X, const std::vector<Y_t>& Y,
+//                  std::vector<M_t>* models);
+//
+// the models are written to the given vector, whose memory is then reused
+// between the trials instead of allocating a new vector for every sample.
+// Otherwise, the models returned by the estimator are moved into the vector.
+template <typename Estimator>
+void EstimateSampleModels(const Estimator& estimator,
+                          const std::vector<typename Estimator::X_t>& X,
+                          const std::vector<typename Estimator::Y_t>& Y,
+                          std::vector<typename Estimator::M_t>* models);
+
 template <typename Estimator, typename SupportMeasurer = InlierSupportMeasurer,
           typename Sampler = RandomSampler>
 class RANSAC {
@@ -96,6 +235,11 @@ class RANSAC {
 
     // The estimated model.
     typename Estimator::M_t model;
+
+    // The number of local optimizations of LO-RANSAC, including the final
+    // re-estimation from all inliers, and the time spent in them.
+    size_t num_local_optimizations = 0;
+    double local_optimization_seconds = 0;
   };
 
   explicit RANSAC(const RANSACOptions& options);
@@ -133,6 +277,37 @@ class RANSAC {
   SupportMeasurer support_measurer;
 
  protected:
+  // Number of random samples per batch, that are estimated and evaluated in
+  // parallel, if multiple threads are used.
+  static const size_t kNumTrialsPerBatch = 64;
+
+  // The models estimated from a random sample together with their support.
+  struct SampleModels {
+    std::vector<typename Estimator::M_t> models;
+    std::vector<typename SupportMeasurer::Support> supports;
+  };
+
+  // Create the SPRT evaluator for the given samples, if enabled.
+  std::unique_ptr<RANSACSPRTEvaluator<Estimator>> CreateSPRTEvaluator(
+      const std::vector<typename Estimator::X_t>& X,
+      const std::vector<typename Estimator::Y_t>& Y) const;
+
+  // Create the thread pool for parallel evaluation, if enabled.
+  std::unique_ptr<ThreadPool> CreateThreadPool() const;
+
+  // Draw a batch of random samples and estimate and evaluate their models in
+  // parallel. The samples are drawn sequentially in the calling thread, such
+  // that the batch is deterministic for a given seed of the PRNG.
+  // Models, which cannot be better than the given best support, are rejected
+  // early by the block evaluator.
+  void EstimateSampleModelsBatch(
+      const std::vector<typename Estimator::X_t>& X,
+      const std::vector<typename Estimator::Y_t>& Y, const double max_residual,
+      const size_t num_trials,
+      const RANSACBlockEvaluator<Estimator>& block_evaluator,
+      const typename SupportMeasurer::Support& best_support,
+      ThreadPool* thread_pool, std::vector<SampleModels>* batch);
+
   RANSACOptions options_;
 };
 
@@ -140,6 +315,193 @@ class RANSAC {
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+namespace internal {
+
+template <typename Estimator>
+auto EstimateSampleModels(const Estimator& estimator,
+                          const std::vector<typename Estimator::X_t>& X,
+                          const std::vector<typename Estimator::Y_t>& Y,
+                          std::vector<typename Estimator::M_t>* models, int)
+    -> decltype(estimator.Estimate(X, Y, models)) {
+  estimator.Estimate(X, Y, models);
+}
+
+template <typename Estimator>
+void EstimateSampleModels(const Estimator& estimator,
+                          const std::vector<typename Estimator::X_t>& X,
+                          const std::vector<typename Estimator::Y_t>& Y,
+                          std::vector<typename Estimator::M_t>* models, long) {
+  *models = estimator.Estimate(X, Y);
+}
+
+}  // namespace internal
+
+template <typename Estimator>
+void EstimateSampleModels(const Estimator& estimator,
+                          const std::vector<typename Estimator::X_t>& X,
+                          const std::vector<typename Estimator::Y_t>& Y,
+                          std::vector<typename Estimator::M_t>* models) {
+  // The int argument prefers the first overload, if it is well-formed.
+  internal::EstimateSampleModels(estimator, X, Y, models, 0);
+}
+
+template <typename Estimator>
+RANSACSPRTEvaluator<Estimator>::RANSACSPRTEvaluator(
+    const RANSACOptions& options,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y)
+    : sprt_(SPRT::Options()),
+      test_active_(false),
+      num_rejected_models_(0),
+      sum_rejected_inlier_ratios_(0) {
+  CHECK_EQ(X.size(), Y.size());
+
+  std::vector<size_t> sample_idxs(X.size());
+  std::iota(sample_idxs.begin(), sample_idxs.end(), 0);
+  Shuffle(static_cast<uint32_t>(sample_idxs.size()), &sample_idxs);
+
+  const size_t num_blocks = (X.size() + kBlockSize - 1) / kBlockSize;
+  X_blocks_.resize(num_blocks);
+  Y_blocks_.resize(num_blocks);
+  sample_idxs_blocks_.resize(num_blocks);
+  for (size_t i = 0; i < sample_idxs.size(); ++i) {
+    const size_t block_idx = i / kBlockSize;
+    X_blocks_[block_idx].push_back(X[sample_idxs[i]]);
+    Y_blocks_[block_idx].push_back(Y[sample_idxs[i]]);
+    sample_idxs_blocks_[block_idx].push_back(sample_idxs[i]);
+  }
+
+  sprt_options_.delta = options.sprt_initial_delta;
+  sprt_options_.epsilon = options.min_inlier_ratio;
+  sprt_options_.eval_time_ratio = options.sprt_eval_time_ratio;
+  UpdateTest();
+}
+
+template <typename Estimator>
+bool RANSACSPRTEvaluator<Estimator>::Evaluate(
+    Estimator& estimator, const typename Estimator::M_t& model,
+    const double max_residual, std::vector<double>* residuals) {
+  size_t num_samples = 0;
+  for (const auto& sample_idxs : sample_idxs_blocks_) {
+    num_samples += sample_idxs.size();
+  }
+  residuals->resize(num_samples);
+
+  double likelihood_ratio = 1;
+  size_t num_inliers = 0;
+  size_t num_eval_samples = 0;
+
+  for (size_t block_idx = 0; block_idx < X_blocks_.size(); ++block_idx) {
+    estimator.Residuals(X_blocks_[block_idx], Y_blocks_[block_idx], model,
+                        &block_residuals_);
+
+    const auto& sample_idxs = sample_idxs_blocks_[block_idx];
+    CHECK_EQ(block_residuals_.size(), sample_idxs.size());
+
+    if (test_active_ &&
+        !sprt_.EvaluateBlock(block_residuals_, max_residual, &likelihood_ratio,
+                             &num_inliers, &num_eval_samples)) {
+      num_rejected_models_ += 1;
+      sum_rejected_inlier_ratios_ +=
+          num_inliers / static_cast<double>(num_eval_samples);
+
+      // Only update the decision threshold on significant changes of the
+      // estimated delta, since its computation is relatively costly.
+      const double delta = std::max(
+          sum_rejected_inlier_ratios_ / num_rejected_models_, 1e-6);
+      if (std::abs(delta - sprt_options_.delta) > 0.05 * sprt_options_.delta) {
+        sprt_options_.delta = delta;
+        UpdateTest();
+      }
+
+      return false;
+    }
+
+    for (size_t i = 0; i < sample_idxs.size(); ++i) {
+      (*residuals)[sample_idxs[i]] = block_residuals_[i];
+    }
+  }
+
+  return true;
+}
+
+template <typename Estimator>
+void RANSACSPRTEvaluator<Estimator>::UpdateInlierRatio(
+    const double inlier_ratio) {
+  sprt_options_.epsilon = inlier_ratio;
+  UpdateTest();
+}
+
+template <typename Estimator>
+size_t RANSACSPRTEvaluator<Estimator>::NumRejectedModels() const {
+  return num_rejected_models_;
+}
+
+template <typename Estimator>
+void RANSACSPRTEvaluator<Estimator>::UpdateTest() {
+  test_active_ = sprt_options_.delta < sprt_options_.epsilon &&
+                 sprt_options_.epsilon < 1;
+  if (test_active_) {
+    sprt_.Update(sprt_options_);
+  }
+}
+
+template <typename Estimator>
+const size_t RANSACBlockEvaluator<Estimator>::kBlockSize;
+
+template <typename Estimator>
+RANSACBlockEvaluator<Estimator>::RANSACBlockEvaluator(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y)
+    : num_samples_(X.size()) {
+  CHECK_EQ(X.size(), Y.size());
+
+  const size_t num_blocks = (num_samples_ + kBlockSize - 1) / kBlockSize;
+  X_blocks_.resize(num_blocks);
+  Y_blocks_.resize(num_blocks);
+  for (size_t block_idx = 0; block_idx < num_blocks; ++block_idx) {
+    const size_t begin = block_idx * kBlockSize;
+    const size_t end = std::min(begin + kBlockSize, num_samples_);
+    X_blocks_[block_idx].assign(X.begin() + begin, X.begin() + end);
+    Y_blocks_[block_idx].assign(Y.begin() + begin, Y.begin() + end);
+  }
+}
+
+template <typename Estimator>
+template <typename SupportMeasurer>
+bool RANSACBlockEvaluator<Estimator>::Evaluate(
+    Estimator& estimator, SupportMeasurer& support_measurer,
+    const typename Estimator::M_t& model, const double max_residual,
+    const typename SupportMeasurer::Support& best_support,
+    std::vector<double>* block_residuals, std::vector<double>* residuals,
+    typename SupportMeasurer::Support* support) const {
+  residuals->resize(num_samples_);
+  *support = support_measurer.Evaluate(std::vector<double>(), max_residual);
+
+  size_t num_eval_samples = 0;
+  for (size_t block_idx = 0; block_idx < X_blocks_.size(); ++block_idx) {
+    estimator.Residuals(X_blocks_[block_idx], Y_blocks_[block_idx], model,
+                        block_residuals);
+    CHECK_EQ(block_residuals->size(), X_blocks_[block_idx].size());
+
+    num_eval_samples += block_residuals->size();
+    if (!support_measurer.EvaluateBlock(*block_residuals, max_residual,
+                                        num_samples_ - num_eval_samples,
+                                        best_support, support)) {
+      *support = typename SupportMeasurer::Support();
+      return false;
+    }
+
+    std::copy(block_residuals->begin(), block_residuals->end(),
+              residuals->begin() + num_eval_samples - block_residuals->size());
+  }
+
+  return true;
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+const size_t RANSAC<Estimator, SupportMeasurer, Sampler>::kNumTrialsPerBatch;
+
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 RANSAC<Estimator, SupportMeasurer, Sampler>::RANSAC(
     const RANSACOptions& options)
@@ -175,6 +537,78 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
       std::ceil(std::log(nom) / std::log(denom) * num_trials_multiplier));
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+std::unique_ptr<RANSACSPRTEvaluator<Estimator>>
+RANSAC<Estimator, SupportMeasurer, Sampler>::CreateSPRTEvaluator(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) const {
+  if (!options_.use_sprt || GetEffectiveNumThreads(options_.num_threads) > 1) {
+    return nullptr;
+  }
+  return std::unique_ptr<RANSACSPRTEvaluator<Estimator>>(
+      new RANSACSPRTEvaluator<Estimator>(options_, X, Y));
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+std::unique_ptr<ThreadPool>
+RANSAC<Estimator, SupportMeasurer, Sampler>::CreateThreadPool() const {
+  if (GetEffectiveNumThreads(options_.num_threads) == 1) {
+    return nullptr;
+  }
+  return std::unique_ptr<ThreadPool>(new ThreadPool(options_.num_threads));
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::EstimateSampleModelsBatch(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y, const double max_residual,
+    const size_t num_trials,
+    const RANSACBlockEvaluator<Estimator>& block_evaluator,
+    const typename SupportMeasurer::Support& best_support,
+    ThreadPool* thread_pool, std::vector<SampleModels>* batch) {
+  // Only the indices of the samples are drawn in the calling thread, while
+  // the tasks gather the samples into their own reused sample vectors.
+  std::vector<std::array<size_t, Estimator::kMinNumSamples>> sample_idxs(
+      num_trials);
+  for (size_t i = 0; i < num_trials; ++i) {
+    sampler.Sample(sample_idxs[i].data());
+  }
+
+  // The models of previous batches are kept, such that their memory is reused.
+  batch->resize(num_trials);
+
+  // Each task reuses its residuals for an interleaved subset of the trials.
+  const size_t num_tasks = std::min(thread_pool->NumThreads(), num_trials);
+  std::vector<std::future<void>> futures(num_tasks);
+  for (size_t task_idx = 0; task_idx < num_tasks; ++task_idx) {
+    futures[task_idx] = thread_pool->AddTask([&, task_idx]() {
+      std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
+      std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
+      std::vector<double> block_residuals;
+      std::vector<double> residuals;
+      for (size_t i = task_idx; i < num_trials; i += num_tasks) {
+        for (size_t j = 0; j < sample_idxs[i].size(); ++j) {
+          X_rand[j] = X[sample_idxs[i][j]];
+          Y_rand[j] = Y[sample_idxs[i][j]];
+        }
+        SampleModels& sample_models = (*batch)[i];
+        EstimateSampleModels(estimator, X_rand, Y_rand, &sample_models.models);
+        sample_models.supports.resize(sample_models.models.size());
+        for (size_t j = 0; j < sample_models.models.size(); ++j) {
+          block_evaluator.Evaluate(estimator, support_measurer,
+                                   sample_models.models[j], max_residual,
+                                   best_support, &block_residuals, &residuals,
+                                   &sample_models.supports[j]);
+        }
+      }
+    });
+  }
+
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 typename RANSAC<Estimator, SupportMeasurer, Sampler>::Report
 RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
@@ -200,10 +634,21 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
   const double max_residual = options_.max_error * options_.max_error;
 
   std::vector<double> residuals(num_samples);
+  std::vector<double> block_residuals;
 
   std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
   std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
 
+  const auto sprt_evaluator = CreateSPRTEvaluator(X, Y);
+  const RANSACBlockEvaluator<Estimator> block_evaluator(X, Y);
+  const auto thread_pool = CreateThreadPool();
+
+  std::vector<SampleModels> batch;
+  size_t batch_idx = 0;
+
+  // Reused between the trials to avoid allocations in the minimal solvers.
+  SampleModels sample_models;
+
   sampler.Initialize(num_samples);
 
   size_t max_num_trials = options_.max_num_trials;
@@ -217,18 +662,51 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
       break;
     }
 
-    sampler.SampleXY(X, Y, &X_rand, &Y_rand);
-
     // Estimate model for current subset.
-    const std::vector<typename Estimator::M_t> sample_models =
-        estimator.Estimate(X_rand, Y_rand);
+    if (thread_pool) {
+      if (batch_idx == batch.size()) {
+        const size_t num_batch_trials = std::min<size_t>(
+            kNumTrialsPerBatch, max_num_trials - report.num_trials);
+        EstimateSampleModelsBatch(X, Y, max_residual, num_batch_trials,
+                                  block_evaluator, best_support,
+                                  thread_pool.get(), &batch);
+        batch_idx = 0;
+      }
+      std::swap(sample_models, batch[batch_idx]);
+      batch_idx += 1;
+    } else {
+      sampler.SampleXY(X, Y, &X_rand, &Y_rand);
+      EstimateSampleModels(estimator, X_rand, Y_rand, &sample_models.models);
+    }
 
     // Iterate through all estimated models.
-    for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+    for (size_t model_idx = 0; model_idx < sample_models.models.size();
+         ++model_idx) {
+      const auto& sample_model = sample_models.models[model_idx];
+
+      typename SupportMeasurer::Support support;
+      if (thread_pool) {
+        support = sample_models.supports[model_idx];
+      } else {
+        if (sprt_evaluator) {
+          if (!sprt_evaluator->Evaluate(estimator, sample_model, max_residual,
+                                        &residuals)) {
+            if (report.num_trials >= dyn_max_num_trials &&
+                report.num_trials >= options_.min_num_trials) {
+              abort = true;
+              break;
+            }
+            continue;
+          }
+          CHECK_EQ(residuals.size(), num_samples);
+          support = support_measurer.Evaluate(residuals, max_residual);
+        } else {
+          // Rejected models have a support that is never the best support.
+          block_evaluator.Evaluate(estimator, support_measurer, sample_model,
+                                   max_residual, best_support,
+                                   &block_residuals, &residuals, &support);
+        }
+      }
 
       // Save as best subset if better than all previous subsets.
       if (support_measurer.Compare(support, best_support)) {
@@ -238,6 +716,11 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
         dyn_max_num_trials = ComputeNumTrials(
             best_support.num_inliers, num_samples, options_.confidence,
             options_.dyn_num_trials_multiplier);
+
+        if (sprt_evaluator) {
+          sprt_evaluator->UpdateInlierRatio(
+              best_support.num_inliers / static_cast<double>(num_samples));
+        }
       }
 
       if (report.num_trials >= dyn_max_num_trials &&
@@ -136,3 +136,162 @@ BOOST_AUTO_TEST_CASE(TestSimilarityTransform) {
       (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
   BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
 }
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformSPRT) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  // Create some arbitrary transformation.
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  // Generate exact data.
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // Add some faulty data.
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // Robustly estimate transformation using RANSAC.
+  RANSACOptions options;
+  options.max_error = 10;
+  options.use_sprt = true;
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto report = ransac.Estimate(src, dst);
+
+  BOOST_CHECK_EQUAL(report.success, true);
+  BOOST_CHECK_GT(report.num_trials, 0);
+
+  // Make sure outliers were detected correctly.
+  BOOST_CHECK_EQUAL(report.support.num_inliers, num_samples - num_outliers);
+  for (size_t i = 0; i < num_samples; ++i) {
+    if (i < num_outliers) {
+      BOOST_CHECK(!report.inlier_mask[i]);
+    } else {
+      BOOST_CHECK(report.inlier_mask[i]);
+    }
+  }
+
+  // Make sure original transformation is estimated correctly.
+  const double matrix_diff =
+      (orig_tform.Matrix().topLeftCorner<3, 4>() - report.model).norm();
+  BOOST_CHECK(std::abs(matrix_diff) < 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(TestSimilarityTransformMultiThreaded) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  // Create some arbitrary transformation.
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  // Generate exact data.
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  // Add some faulty data.
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  // The estimation must not depend on the number of threads.
+  RANSACOptions options;
+  options.max_error = 10;
+  SetPRNGSeed(0);
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto report = ransac.Estimate(src, dst);
+
+  options.num_threads = 4;
+  SetPRNGSeed(0);
+  RANSAC<SimilarityTransformEstimator<3>> parallel_ransac(options);
+  const auto parallel_report = parallel_ransac.Estimate(src, dst);
+
+  BOOST_CHECK_EQUAL(parallel_report.success, true);
+  BOOST_CHECK_EQUAL(parallel_report.num_trials, report.num_trials);
+  BOOST_CHECK_EQUAL(parallel_report.support.num_inliers,
+                    report.support.num_inliers);
+  BOOST_CHECK_EQUAL(parallel_report.support.residual_sum,
+                    report.support.residual_sum);
+  BOOST_CHECK(parallel_report.inlier_mask == report.inlier_mask);
+  BOOST_CHECK(parallel_report.model == report.model);
+}
+
+BOOST_AUTO_TEST_CASE(TestBlockEvaluator) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  const SimilarityTransform3 orig_tform(2, ComposeIdentityQuaternion(),
+                                        Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    dst.push_back(src.back());
+    orig_tform.TransformPoint(&dst.back());
+  }
+
+  for (size_t i = 0; i < num_outliers; ++i) {
+    dst[i] = Eigen::Vector3d(RandomReal(-3000.0, -2000.0),
+                             RandomReal(-4000.0, -3000.0),
+                             RandomReal(-5000.0, -4000.0));
+  }
+
+  typedef SimilarityTransformEstimator<3> Estimator;
+  Estimator estimator;
+  InlierSupportMeasurer support_measurer;
+  const Estimator::M_t model = orig_tform.Matrix().topLeftCorner<3, 4>();
+  const double max_residual = 100;
+
+  std::vector<double> full_residuals;
+  estimator.Residuals(src, dst, model, &full_residuals);
+  const auto full_support =
+      support_measurer.Evaluate(full_residuals, max_residual);
+
+  const RANSACBlockEvaluator<Estimator> block_evaluator(src, dst);
+  std::vector<double> block_residuals;
+  std::vector<double> residuals;
+  InlierSupportMeasurer::Support support;
+  BOOST_CHECK(block_evaluator.Evaluate(
+      estimator, support_measurer, model, max_residual,
+      InlierSupportMeasurer::Support(), &block_residuals, &residuals,
+      &support));
+  BOOST_CHECK(residuals == full_residuals);
+  BOOST_CHECK_EQUAL(support.num_inliers, full_support.num_inliers);
+  BOOST_CHECK_EQUAL(support.residual_sum, full_support.residual_sum);
+
+  // A model, that cannot reach the number of inliers of the best model, is
+  // rejected before evaluating all samples.
+  InlierSupportMeasurer::Support best_support;
+  best_support.num_inliers = num_samples;
+  best_support.residual_sum = 0;
+  BOOST_CHECK(!block_evaluator.Evaluate(estimator, support_measurer, model,
+                                        max_residual, best_support,
+                                        &block_residuals, &residuals,
+                                        &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 0);
+  BOOST_CHECK(!support_measurer.Compare(support, best_support));
+}
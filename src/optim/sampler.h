@@ -42,8 +42,8 @@ namespace colmap {
 // Abstract base class for sampling methods.
 class Sampler {
  public:
-  Sampler(){};
   explicit Sampler(const size_t num_samples);
+  virtual ~Sampler() = default;
 
   // Initialize the sampler, before calling the `Sample` method.
   virtual void Initialize(const size_t total_num_samples) = 0;
@@ -52,7 +52,14 @@ class Sampler {
   virtual size_t MaxNumSamples() = 0;
 
   // Sample `num_samples` elements from all samples.
-  virtual std::vector<size_t> Sample() = 0;
+  std::vector<size_t> Sample();
+
+  // Same as above but writes the `num_samples` sampled indices to the given
+  // buffer, such that no memory is allocated for every sample.
+  virtual void Sample(size_t* sample_idxs) = 0;
+
+  // The number of elements per sample.
+  size_t NumSamples() const;
 
   // Sample elements from `X` into `X_rand`.
   //
@@ -67,28 +74,48 @@ class Sampler {
   // should equal `num_samples`. The same applies for `Y` and `Y_rand`.
   template <typename X_t, typename Y_t>
   void SampleXY(const X_t& X, const Y_t& Y, X_t* X_rand, Y_t* Y_rand);
+
+ protected:
+  const size_t num_samples_;
+
+ private:
+  // The sampled indices of `SampleX` and `SampleXY`, whose memory is reused.
+  std::vector<size_t> sampled_idxs_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
+inline Sampler::Sampler(const size_t num_samples)
+    : num_samples_(num_samples), sampled_idxs_(num_samples) {}
+
+inline std::vector<size_t> Sampler::Sample() {
+  std::vector<size_t> sample_idxs(num_samples_);
+  Sample(sample_idxs.data());
+  return sample_idxs;
+}
+
+inline size_t Sampler::NumSamples() const { return num_samples_; }
+
 template <typename X_t>
 void Sampler::SampleX(const X_t& X, X_t* X_rand) {
-  const auto sample_idxs = Sample();
+  CHECK_EQ(X_rand->size(), num_samples_);
+  Sample(sampled_idxs_.data());
   for (size_t i = 0; i < X_rand->size(); ++i) {
-    (*X_rand)[i] = X[sample_idxs[i]];
+    (*X_rand)[i] = X[sampled_idxs_[i]];
   }
 }
 
 template <typename X_t, typename Y_t>
 void Sampler::SampleXY(const X_t& X, const Y_t& Y, X_t* X_rand, Y_t* Y_rand) {
   CHECK_EQ(X.size(), Y.size());
-  CHECK_EQ(X_rand->size(), Y_rand->size());
-  const auto sample_idxs = Sample();
+  CHECK_EQ(X_rand->size(), num_samples_);
+  CHECK_EQ(Y_rand->size(), num_samples_);
+  Sample(sampled_idxs_.data());
   for (size_t i = 0; i < X_rand->size(); ++i) {
-    (*X_rand)[i] = X[sample_idxs[i]];
-    (*Y_rand)[i] = Y[sample_idxs[i]];
+    (*X_rand)[i] = X[sampled_idxs_[i]];
+    (*Y_rand)[i] = Y[sampled_idxs_[i]];
   }
 }
 
@@ -66,8 +66,19 @@ class SPRT {
 
   void Update(const Options& options);
 
+  const Options& GetOptions() const;
+
   bool Evaluate(const std::vector<double>& residuals, const double max_residual,
-                size_t* num_inliers, size_t* num_eval_samples);
+                size_t* num_inliers, size_t* num_eval_samples) const;
+
+  // Continue the evaluation of a model with the next block of residuals. The
+  // likelihood ratio, the number of inliers, and the number of evaluated
+  // samples are accumulated over all blocks of the same model and must be
+  // initialized to 1, 0, and 0 for the first block. Returns false as soon as
+  // the model is rejected.
+  bool EvaluateBlock(const std::vector<double>& residuals,
+                     const double max_residual, double* likelihood_ratio,
+                     size_t* num_inliers, size_t* num_eval_samples) const;
 
  private:
   void UpdateDecisionThreshold();
@@ -0,0 +1,95 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "optim/sprt"
+#include "util/testing.h"
+
+#include "optim/sprt.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestOptions) {
+  SPRT::Options options;
+  BOOST_CHECK_EQUAL(options.delta, 0.01);
+  BOOST_CHECK_EQUAL(options.epsilon, 0.1);
+  BOOST_CHECK_EQUAL(options.eval_time_ratio, 200);
+  BOOST_CHECK_EQUAL(options.num_models_per_sample, 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestEvaluate) {
+  SPRT::Options options;
+  options.delta = 0.05;
+  options.epsilon = 0.5;
+  SPRT sprt(options);
+
+  size_t num_inliers;
+  size_t num_eval_samples;
+
+  const std::vector<double> good_residuals(1000, 0.5);
+  BOOST_CHECK(sprt.Evaluate(good_residuals, 1, &num_inliers,
+                            &num_eval_samples));
+  BOOST_CHECK_EQUAL(num_inliers, 1000);
+  BOOST_CHECK_EQUAL(num_eval_samples, 1000);
+
+  const std::vector<double> bad_residuals(1000, 2);
+  BOOST_CHECK(!sprt.Evaluate(bad_residuals, 1, &num_inliers,
+                             &num_eval_samples));
+  BOOST_CHECK_EQUAL(num_inliers, 0);
+  BOOST_CHECK_GT(num_eval_samples, 0);
+  BOOST_CHECK_LT(num_eval_samples, 100);
+}
+
+BOOST_AUTO_TEST_CASE(TestEvaluateBlock) {
+  SPRT::Options options;
+  options.delta = 0.05;
+  options.epsilon = 0.5;
+  SPRT sprt(options);
+
+  size_t num_inliers;
+  size_t num_eval_samples;
+  const std::vector<double> bad_residuals(1000, 2);
+  BOOST_CHECK(!sprt.Evaluate(bad_residuals, 1, &num_inliers,
+                             &num_eval_samples));
+
+  // Evaluating the same residuals in blocks rejects at the same sample.
+  double likelihood_ratio = 1;
+  size_t block_num_inliers = 0;
+  size_t block_num_eval_samples = 0;
+  const std::vector<double> block_residuals(3, 2);
+  size_t num_blocks = 0;
+  while (sprt.EvaluateBlock(block_residuals, 1, &likelihood_ratio,
+                            &block_num_inliers, &block_num_eval_samples)) {
+    num_blocks += 1;
+    BOOST_CHECK_EQUAL(block_num_eval_samples, 3 * num_blocks);
+  }
+  BOOST_CHECK_EQUAL(block_num_inliers, 0);
+  BOOST_CHECK_EQUAL(block_num_eval_samples, num_eval_samples);
+}
@@ -49,6 +49,24 @@ InlierSupportMeasurer::Support InlierSupportMeasurer::Evaluate(
   return support;
 }
 
+bool InlierSupportMeasurer::EvaluateBlock(const std::vector<double>& residuals,
+                                          const double max_residual,
+                                          const size_t num_remaining_residuals,
+                                          const Support& best_support,
+                                          Support* support) {
+  for (const auto residual : residuals) {
+    if (residual <= max_residual) {
+      support->num_inliers += 1;
+      support->residual_sum += residual;
+    }
+  }
+
+  // Even if all remaining residuals are inliers, the support cannot reach the
+  // number of inliers of the best support.
+  return support->num_inliers + num_remaining_residuals >=
+         best_support.num_inliers;
+}
+
 bool InlierSupportMeasurer::Compare(const Support& support1,
                                     const Support& support2) {
   if (support1.num_inliers > support2.num_inliers) {
@@ -77,6 +95,23 @@ MEstimatorSupportMeasurer::Support MEstimatorSupportMeasurer::Evaluate(
   return support;
 }
 
+bool MEstimatorSupportMeasurer::EvaluateBlock(
+    const std::vector<double>& residuals, const double max_residual,
+    const size_t num_remaining_residuals, const Support& best_support,
+    Support* support) {
+  for (const auto residual : residuals) {
+    if (residual <= max_residual) {
+      support->num_inliers += 1;
+      support->score += residual;
+    } else {
+      support->score += max_residual;
+    }
+  }
+
+  // The remaining residuals can only increase the score.
+  return support->score < best_support.score;
+}
+
 bool MEstimatorSupportMeasurer::Compare(const Support& support1,
                                         const Support& support2) {
   return support1.score < support2.score;
@@ -54,6 +54,15 @@ struct InlierSupportMeasurer {
   Support Evaluate(const std::vector<double>& residuals,
                    const double max_residual);
 
+  // Add the support of the next block of residuals to the support of the
+  // previous blocks, which must be initialized with the support of no
+  // residuals. Returns false, if the support cannot become better than the
+  // best support anymore, given the number of residuals after this block.
+  bool EvaluateBlock(const std::vector<double>& residuals,
+                     const double max_residual,
+                     const size_t num_remaining_residuals,
+                     const Support& best_support, Support* support);
+
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
 };
@@ -73,6 +82,15 @@ struct MEstimatorSupportMeasurer {
   Support Evaluate(const std::vector<double>& residuals,
                    const double max_residual);
 
+  // Add the support of the next block of residuals to the support of the
+  // previous blocks, which must be initialized with the support of no
+  // residuals. Returns false, if the score already exceeds the score of the
+  // best support, which assumes non-negative residuals.
+  bool EvaluateBlock(const std::vector<double>& residuals,
+                     const double max_residual,
+                     const size_t num_remaining_residuals,
+                     const Support& best_support, Support* support);
+
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
 };
@@ -90,3 +90,50 @@ BOOST_AUTO_TEST_CASE(TestMEstimatorSupportMeasurer) {
   BOOST_CHECK(!measurer.Compare(support1, support2));
   BOOST_CHECK(measurer.Compare(support2, support1));
 }
+
+BOOST_AUTO_TEST_CASE(TestInlierSupportMeasuremerEvaluateBlock) {
+  InlierSupportMeasurer measurer;
+  const std::vector<double> residuals = {0.0, 0.5, 2.0, 3.0};
+  InlierSupportMeasurer::Support best_support;
+  InlierSupportMeasurer::Support support =
+      measurer.Evaluate(std::vector<double>(), 1.0);
+  BOOST_CHECK_EQUAL(support.num_inliers, 0);
+  BOOST_CHECK_EQUAL(support.residual_sum, 0.0);
+  BOOST_CHECK(
+      measurer.EvaluateBlock(residuals, 1.0, 4, best_support, &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 2);
+  BOOST_CHECK_EQUAL(support.residual_sum, 0.5);
+  BOOST_CHECK(
+      measurer.EvaluateBlock(residuals, 1.0, 0, best_support, &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 4);
+  BOOST_CHECK_EQUAL(support.residual_sum, 1.0);
+
+  best_support.num_inliers = 6;
+  best_support.residual_sum = 0.0;
+  support = measurer.Evaluate(std::vector<double>(), 1.0);
+  BOOST_CHECK(
+      measurer.EvaluateBlock(residuals, 1.0, 4, best_support, &support));
+  BOOST_CHECK(
+      !measurer.EvaluateBlock(residuals, 1.0, 1, best_support, &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestMEstimatorSupportMeasurerEvaluateBlock) {
+  MEstimatorSupportMeasurer measurer;
+  const std::vector<double> residuals = {0.0, 0.5, 2.0, 3.0};
+  MEstimatorSupportMeasurer::Support best_support;
+  MEstimatorSupportMeasurer::Support support =
+      measurer.Evaluate(std::vector<double>(), 1.0);
+  BOOST_CHECK_EQUAL(support.num_inliers, 0);
+  BOOST_CHECK_EQUAL(support.score, 0.0);
+  BOOST_CHECK(
+      measurer.EvaluateBlock(residuals, 1.0, 4, best_support, &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 2);
+  BOOST_CHECK_EQUAL(support.score, 2.5);
+
+  best_support.score = 4.0;
+  BOOST_CHECK(
+      !measurer.EvaluateBlock(residuals, 1.0, 0, best_support, &support));
+  BOOST_CHECK_EQUAL(support.num_inliers, 4);
+  BOOST_CHECK_EQUAL(support.score, 5.0);
+}
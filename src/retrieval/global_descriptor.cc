@@ -0,0 +1,398 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "retrieval/global_descriptor.h"
+
+#include <fstream>
+#include <numeric>
+
+#include <Eigen/Eigenvalues>
+
+#include "util/endian.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/threading.h"
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+// Find the nearest centroid and its squared distance for every row of the
+// data with matrix products over blocks of rows, see `ProductQuantizer`.
+void FindNearestCentroids(const GlobalDescriptors& data,
+                          const GlobalDescriptors& centroids,
+                          ThreadPool* thread_pool,
+                          std::vector<int>* centroid_idxs,
+                          std::vector<float>* squared_distances) {
+  const Eigen::RowVectorXf centroid_norms =
+      centroids.rowwise().squaredNorm().transpose();
+
+  centroid_idxs->resize(data.rows());
+  squared_distances->resize(data.rows());
+
+  const Eigen::Index kBlockSize = 4096;
+  const size_t num_blocks =
+      static_cast<size_t>((data.rows() + kBlockSize - 1) / kBlockSize);
+  auto FindBlock = [&](const size_t block_idx) {
+    const Eigen::Index begin = block_idx * kBlockSize;
+    const Eigen::Index block_size =
+        std::min(kBlockSize, static_cast<Eigen::Index>(data.rows() - begin));
+    const auto block = data.middleRows(begin, block_size);
+    const Eigen::MatrixXf dots = block * centroids.transpose();
+    for (Eigen::Index i = 0; i < block_size; ++i) {
+      Eigen::Index centroid_idx;
+      const float distance =
+          (centroid_norms - 2 * dots.row(i)).minCoeff(&centroid_idx);
+      (*centroid_idxs)[begin + i] = static_cast<int>(centroid_idx);
+      (*squared_distances)[begin + i] =
+          std::max(0.0f, distance + block.row(i).squaredNorm());
+    }
+  };
+
+  if (thread_pool == nullptr) {
+    for (size_t block_idx = 0; block_idx < num_blocks; ++block_idx) {
+      FindBlock(block_idx);
+    }
+  } else {
+    thread_pool->ParallelFor(0, num_blocks,
+                             [&](const size_t begin, const size_t end) {
+                               for (size_t i = begin; i < end; ++i) {
+                                 FindBlock(i);
+                               }
+                             },
+                             ThreadPool::Schedule::DYNAMIC, 1);
+  }
+}
+
+// Cluster the rows of the data with k-means, where the centroids are
+// initialized with distinct random rows.
+GlobalDescriptors ClusterKMeans(const GlobalDescriptors& data,
+                                const int num_centroids,
+                                const int num_iterations,
+                                ThreadPool* thread_pool) {
+  std::vector<int> init_idxs(data.rows());
+  std::iota(init_idxs.begin(), init_idxs.end(), 0);
+  Shuffle(num_centroids, &init_idxs);
+
+  GlobalDescriptors centroids(num_centroids, data.cols());
+  for (int k = 0; k < num_centroids; ++k) {
+    centroids.row(k) = data.row(init_idxs[k]);
+  }
+
+  std::vector<int> centroid_idxs;
+  std::vector<float> squared_distances;
+  for (int iteration = 0; iteration < num_iterations; ++iteration) {
+    FindNearestCentroids(data, centroids, thread_pool, &centroid_idxs,
+                         &squared_distances);
+
+    GlobalDescriptors sums =
+        GlobalDescriptors::Zero(num_centroids, data.cols());
+    std::vector<int> counts(num_centroids, 0);
+    for (Eigen::Index i = 0; i < data.rows(); ++i) {
+      sums.row(centroid_idxs[i]) += data.row(i);
+      counts[centroid_idxs[i]] += 1;
+    }
+
+    for (int k = 0; k < num_centroids; ++k) {
+      if (counts[k] > 0) {
+        centroids.row(k) = sums.row(k) / static_cast<float>(counts[k]);
+      } else {
+        // Move empty clusters to the row with the largest error.
+        const auto max_distance = std::max_element(squared_distances.begin(),
+                                                   squared_distances.end());
+        centroids.row(k) = data.row(max_distance - squared_distances.begin());
+        *max_distance = 0;
+      }
+    }
+  }
+
+  return centroids;
+}
+
+}  // namespace
+
+bool GlobalDescriptorOptions::Check() const {
+  CHECK_OPTION_GT(num_words, 0);
+  CHECK_OPTION_GT(num_dims, 0);
+  CHECK_OPTION_GT(num_iterations, 0);
+  return true;
+}
+
+void GlobalDescriptorModel::Train(
+    const GlobalDescriptorOptions& options,
+    const GlobalDescriptors& visual_words,
+    const std::vector<FeatureDescriptors>& training_descriptors) {
+  CHECK(options.Check());
+  CHECK_GE(visual_words.rows(), options.num_words);
+  CHECK_GE(training_descriptors.size(), 2);
+
+  ThreadPool thread_pool(options.num_threads);
+
+  words_ = ClusterKMeans(visual_words, options.num_words,
+                         options.num_iterations, &thread_pool);
+
+  // Aggregate the training images without the dimensionality reduction.
+  GlobalDescriptors data(training_descriptors.size(), words_.size());
+  thread_pool.ParallelFor(0, training_descriptors.size(),
+                          [&](const size_t begin, const size_t end) {
+                            for (size_t i = begin; i < end; ++i) {
+                              data.row(i) =
+                                  Aggregate(training_descriptors[i]);
+                            }
+                          },
+                          ThreadPool::Schedule::DYNAMIC);
+
+  mean_ = data.colwise().mean().transpose();
+  data.rowwise() -= mean_.transpose();
+
+  // The principal directions are the eigenvectors of the covariance matrix.
+  // With fewer training images than aggregated dimensions, they are instead
+  // obtained from the eigenvectors of the smaller Gram matrix of the images.
+  const bool use_gram_matrix = data.rows() < data.cols();
+  const Eigen::MatrixXd gram_or_covariance =
+      use_gram_matrix ? (data * data.transpose()).cast<double>().eval()
+                      : (data.transpose() * data).cast<double>().eval();
+  const Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> eigen_solver(
+      gram_or_covariance);
+  CHECK_EQ(eigen_solver.info(), Eigen::Success);
+
+  // The eigenvalues are sorted in ascending order.
+  const Eigen::VectorXd& eigenvalues = eigen_solver.eigenvalues();
+  const double kMinEigenvalue = 1e-8 * std::max(eigenvalues.maxCoeff(), 1.0);
+  int num_dims = 0;
+  while (num_dims < options.num_dims && num_dims < eigenvalues.size() &&
+         eigenvalues(eigenvalues.size() - 1 - num_dims) > kMinEigenvalue) {
+    num_dims += 1;
+  }
+  CHECK_GT(num_dims, 0) << "The training images are not distinct";
+
+  projection_.resize(num_dims, data.cols());
+  for (int i = 0; i < num_dims; ++i) {
+    const Eigen::Index eigen_idx = eigenvalues.size() - 1 - i;
+    const Eigen::VectorXd eigenvector = eigen_solver.eigenvectors().col(
+        eigen_idx);
+    if (use_gram_matrix) {
+      projection_.row(i) = (data.transpose() * eigenvector.cast<float>())
+                               .transpose()
+                               .normalized();
+    } else {
+      projection_.row(i) = eigenvector.cast<float>().transpose();
+    }
+  }
+}
+
+Eigen::VectorXf GlobalDescriptorModel::Compute(
+    const FeatureDescriptors& descriptors) const {
+  CHECK(IsTrained());
+  if (descriptors.rows() == 0) {
+    return Eigen::VectorXf::Zero(NumDims());
+  }
+  Eigen::VectorXf descriptor = projection_ * (Aggregate(descriptors) - mean_);
+  const float norm = descriptor.norm();
+  if (norm > 0) {
+    descriptor /= norm;
+  }
+  return descriptor;
+}
+
+Eigen::VectorXf GlobalDescriptorModel::Aggregate(
+    const FeatureDescriptors& descriptors) const {
+  CHECK_EQ(descriptors.cols(), words_.cols());
+
+  GlobalDescriptors residuals = GlobalDescriptors::Zero(words_.rows(),
+                                                        words_.cols());
+  if (descriptors.rows() > 0) {
+    const GlobalDescriptors data = descriptors.cast<float>();
+    std::vector<int> word_idxs;
+    std::vector<float> squared_distances;
+    FindNearestCentroids(data, words_, nullptr, &word_idxs, &squared_distances);
+    for (Eigen::Index i = 0; i < data.rows(); ++i) {
+      residuals.row(word_idxs[i]) += data.row(i) - words_.row(word_idxs[i]);
+    }
+  }
+
+  // The power normalization reduces the influence of bursty features, e.g.,
+  // of repetitive structures, and the intra-normalization balances the
+  // contributions of the visual words.
+  residuals = residuals.array().sign() * residuals.array().abs().sqrt();
+  for (Eigen::Index k = 0; k < residuals.rows(); ++k) {
+    const float norm = residuals.row(k).norm();
+    if (norm > 0) {
+      residuals.row(k) /= norm;
+    }
+  }
+
+  Eigen::VectorXf vector =
+      Eigen::Map<const Eigen::VectorXf>(residuals.data(), residuals.size());
+  const float norm = vector.norm();
+  if (norm > 0) {
+    vector /= norm;
+  }
+  return vector;
+}
+
+void GlobalDescriptorModel::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  auto ReadMatrix = [&file](GlobalDescriptors* matrix) {
+    const uint64_t rows = ReadBinaryLittleEndian<uint64_t>(&file);
+    const uint64_t cols = ReadBinaryLittleEndian<uint64_t>(&file);
+    matrix->resize(rows, cols);
+    for (Eigen::Index i = 0; i < matrix->size(); ++i) {
+      matrix->data()[i] = ReadBinaryLittleEndian<float>(&file);
+    }
+  };
+
+  GlobalDescriptors mean;
+  ReadMatrix(&words_);
+  ReadMatrix(&mean);
+  ReadMatrix(&projection_);
+  mean_ = mean.transpose();
+  CHECK_EQ(mean_.size(), words_.size()) << path;
+  CHECK_EQ(projection_.cols(), words_.size()) << path;
+}
+
+void GlobalDescriptorModel::Write(const std::string& path) const {
+  CHECK(IsTrained());
+
+  std::ofstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  auto WriteMatrix = [&file](const GlobalDescriptors& matrix) {
+    WriteBinaryLittleEndian<uint64_t>(&file, matrix.rows());
+    WriteBinaryLittleEndian<uint64_t>(&file, matrix.cols());
+    for (Eigen::Index i = 0; i < matrix.size(); ++i) {
+      WriteBinaryLittleEndian<float>(&file, matrix.data()[i]);
+    }
+  };
+
+  WriteMatrix(words_);
+  WriteMatrix(mean_.transpose());
+  WriteMatrix(projection_);
+}
+
+void QueryGlobalDescriptors(
+    const std::vector<int>& query_image_ids,
+    const GlobalDescriptors& query_descriptors,
+    const std::vector<int>& database_image_ids,
+    const GlobalDescriptors& database_descriptors, const int num_images,
+    const int num_threads, std::vector<std::vector<ImageScore>>* image_scores) {
+  CHECK_EQ(query_image_ids.size(), query_descriptors.rows());
+  CHECK_EQ(database_image_ids.size(), database_descriptors.rows());
+  CHECK_EQ(query_descriptors.cols(), database_descriptors.cols());
+  CHECK_GT(num_images, 0);
+
+  image_scores->clear();
+  image_scores->resize(query_image_ids.size());
+
+  // The query blocks are processed in parallel and every block iterates over
+  // all database blocks. The block sizes balance the arithmetic intensity of
+  // the matrix products with the size of the score matrix.
+  const Eigen::Index kQueryBlockSize = 256;
+  const Eigen::Index kDatabaseBlockSize = 4096;
+  const size_t num_query_blocks = static_cast<size_t>(
+      (query_descriptors.rows() + kQueryBlockSize - 1) / kQueryBlockSize);
+
+  // Compare the scores such that the heaps keep the worst score at the front.
+  const auto CompareScores = [](const ImageScore& image_score1,
+                                const ImageScore& image_score2) {
+    return image_score1.score > image_score2.score;
+  };
+
+  auto QueryBlock = [&](const size_t block_idx) {
+    const Eigen::Index query_begin = block_idx * kQueryBlockSize;
+    const Eigen::Index query_block_size = std::min(
+        kQueryBlockSize,
+        static_cast<Eigen::Index>(query_descriptors.rows() - query_begin));
+    const auto query_block =
+        query_descriptors.middleRows(query_begin, query_block_size);
+
+    GlobalDescriptors scores;
+    for (Eigen::Index database_begin = 0;
+         database_begin < database_descriptors.rows();
+         database_begin += kDatabaseBlockSize) {
+      const Eigen::Index database_block_size =
+          std::min(kDatabaseBlockSize,
+                   static_cast<Eigen::Index>(database_descriptors.rows() -
+                                             database_begin));
+      scores.noalias() =
+          query_block * database_descriptors
+                            .middleRows(database_begin, database_block_size)
+                            .transpose();
+
+      for (Eigen::Index i = 0; i < query_block_size; ++i) {
+        const int query_image_id = query_image_ids[query_begin + i];
+        auto& heap = (*image_scores)[query_begin + i];
+        for (Eigen::Index j = 0; j < database_block_size; ++j) {
+          const float score = scores(i, j);
+          if (heap.size() == static_cast<size_t>(num_images) &&
+              score <= heap.front().score) {
+            continue;
+          }
+
+          const int database_image_id =
+              database_image_ids[database_begin + j];
+          if (database_image_id == query_image_id) {
+            continue;
+          }
+
+          if (heap.size() == static_cast<size_t>(num_images)) {
+            std::pop_heap(heap.begin(), heap.end(), CompareScores);
+            heap.pop_back();
+          }
+          ImageScore image_score;
+          image_score.image_id = database_image_id;
+          image_score.score = score;
+          heap.push_back(image_score);
+          std::push_heap(heap.begin(), heap.end(), CompareScores);
+        }
+      }
+    }
+
+    for (Eigen::Index i = 0; i < query_block_size; ++i) {
+      auto& heap = (*image_scores)[query_begin + i];
+      std::sort_heap(heap.begin(), heap.end(), CompareScores);
+    }
+  };
+
+  ThreadPool thread_pool(num_threads);
+  thread_pool.ParallelFor(0, num_query_blocks,
+                          [&](const size_t begin, const size_t end) {
+                            for (size_t i = begin; i < end; ++i) {
+                              QueryBlock(i);
+                            }
+                          },
+                          ThreadPool::Schedule::DYNAMIC, 1);
+}
+
+}  // namespace retrieval
+}  // namespace colmap
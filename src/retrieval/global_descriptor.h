@@ -0,0 +1,147 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_RETRIEVAL_GLOBAL_DESCRIPTOR_H_
+#define COLMAP_SRC_RETRIEVAL_GLOBAL_DESCRIPTOR_H_
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "feature/types.h"
+#include "retrieval/utils.h"
+
+namespace colmap {
+namespace retrieval {
+
+// The global descriptors of multiple images with one row per image.
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    GlobalDescriptors;
+
+struct GlobalDescriptorOptions {
+  // Number of coarse visual words, which are clustered from the visual words
+  // of the vocabulary tree. The aggregated descriptor has 128 dimensions per
+  // coarse visual word before the dimensionality reduction.
+  int num_words = 16;
+
+  // Number of dimensions of the global descriptors after the dimensionality
+  // reduction. It is limited by the number of training images and the number
+  // of aggregated dimensions.
+  int num_dims = 256;
+
+  // Number of k-means iterations to cluster the coarse visual words.
+  int num_iterations = 10;
+
+  // The number of threads used to cluster the coarse visual words.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// Compact global image descriptor for the retrieval of image pairs by dense
+// matrix products instead of inverted file traversals. The local features of
+// an image are aggregated into a single vector of fixed dimension as in VLAD,
+// i.e., the residuals of the features to their nearest coarse visual words are
+// summed per word. The sums are power- and intra-normalized, and the vector is
+// reduced by PCA and L2-normalized, such that the inner product of two
+// descriptors is their similarity. The coarse visual words are clustered from
+// the visual words of an existing vocabulary tree, which approximate the
+// density of the feature descriptors. See:
+//
+//    Jegou, Douze, Schmid, Perez. "Aggregating local descriptors into a
+//    compact image representation". CVPR 2010.
+//
+//    Arandjelovic, Zisserman. "All about VLAD". CVPR 2013.
+class GlobalDescriptorModel {
+ public:
+  // Train the coarse visual words from the given visual words with one row
+  // per word and the dimensionality reduction from the local features of the
+  // given training images.
+  void Train(const GlobalDescriptorOptions& options,
+             const GlobalDescriptors& visual_words,
+             const std::vector<FeatureDescriptors>& training_descriptors);
+
+  inline bool IsTrained() const;
+  inline int NumWords() const;
+  inline int NumDims() const;
+
+  // Compute the global descriptor of an image from its local features. The
+  // descriptor of an image without features is zero.
+  Eigen::VectorXf Compute(const FeatureDescriptors& descriptors) const;
+
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
+ private:
+  // Aggregate the local features into the normalized VLAD vector.
+  Eigen::VectorXf Aggregate(const FeatureDescriptors& descriptors) const;
+
+  // The coarse visual words with one row per word.
+  GlobalDescriptors words_;
+
+  // The mean and the principal directions of the aggregated vectors with one
+  // row per output dimension.
+  Eigen::VectorXf mean_;
+  GlobalDescriptors projection_;
+};
+
+// Retrieve the most similar database images for every query image by the
+// inner products of their global descriptors, which are computed as matrix
+// products between blocks of query and database descriptors. Only the
+// `num_images` best scores of every query are kept while iterating over the
+// database blocks, such that the memory is independent of the number of
+// database images. The query image is not retrieved for itself. The scores
+// are sorted in descending order.
+void QueryGlobalDescriptors(const std::vector<int>& query_image_ids,
+                            const GlobalDescriptors& query_descriptors,
+                            const std::vector<int>& database_image_ids,
+                            const GlobalDescriptors& database_descriptors,
+                            const int num_images, const int num_threads,
+                            std::vector<std::vector<ImageScore>>* image_scores);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool GlobalDescriptorModel::IsTrained() const { return projection_.size() > 0; }
+
+int GlobalDescriptorModel::NumWords() const {
+  return static_cast<int>(words_.rows());
+}
+
+int GlobalDescriptorModel::NumDims() const {
+  return static_cast<int>(projection_.rows());
+}
+
+}  // namespace retrieval
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_RETRIEVAL_GLOBAL_DESCRIPTOR_H_
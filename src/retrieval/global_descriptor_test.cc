@@ -0,0 +1,225 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "retrieval/global_descriptor"
+#include "util/testing.h"
+
+#include <boost/filesystem.hpp>
+
+#include "retrieval/global_descriptor.h"
+#include "util/random.h"
+
+using namespace colmap;
+using namespace colmap::retrieval;
+
+namespace {
+
+FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features) {
+  FeatureDescriptors descriptors(num_features, 128);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = static_cast<uint8_t>(RandomInteger(0, 255));
+  }
+  return descriptors;
+}
+
+GlobalDescriptors CreateRandomGlobalDescriptors(const size_t num_images,
+                                                const int num_dims) {
+  GlobalDescriptors descriptors(num_images, num_dims);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = RandomReal(-1.0f, 1.0f);
+  }
+  descriptors.rowwise().normalize();
+  return descriptors;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestTrainAndCompute) {
+  SetPRNGSeed(0);
+
+  std::vector<FeatureDescriptors> training_descriptors;
+  for (int i = 0; i < 20; ++i) {
+    training_descriptors.push_back(CreateRandomFeatureDescriptors(50));
+  }
+
+  GlobalDescriptorOptions options;
+  options.num_words = 4;
+  options.num_dims = 8;
+  GlobalDescriptorModel model;
+  BOOST_CHECK(!model.IsTrained());
+  model.Train(options,
+              CreateRandomFeatureDescriptors(100).cast<float>(),
+              training_descriptors);
+  BOOST_CHECK(model.IsTrained());
+  BOOST_CHECK_EQUAL(model.NumWords(), 4);
+  BOOST_CHECK_EQUAL(model.NumDims(), 8);
+
+  const Eigen::VectorXf descriptor = model.Compute(training_descriptors[0]);
+  BOOST_CHECK_EQUAL(descriptor.size(), 8);
+  BOOST_CHECK_CLOSE(descriptor.norm(), 1.0f, 1e-4);
+  BOOST_CHECK_EQUAL(model.Compute(FeatureDescriptors(0, 128)),
+                    Eigen::VectorXf::Zero(8));
+
+  // The number of dimensions is limited by the number of training images.
+  options.num_dims = 100;
+  model.Train(options,
+              CreateRandomFeatureDescriptors(100).cast<float>(),
+              training_descriptors);
+  BOOST_CHECK_LT(model.NumDims(), 20);
+}
+
+BOOST_AUTO_TEST_CASE(TestSimilarImages) {
+  SetPRNGSeed(0);
+
+  std::vector<FeatureDescriptors> descriptors;
+  for (int i = 0; i < 50; ++i) {
+    descriptors.push_back(CreateRandomFeatureDescriptors(100));
+  }
+
+  GlobalDescriptorOptions options;
+  options.num_words = 8;
+  options.num_dims = 32;
+  GlobalDescriptorModel model;
+  model.Train(options, CreateRandomFeatureDescriptors(200).cast<float>(),
+              descriptors);
+
+  GlobalDescriptors database_descriptors(descriptors.size(), model.NumDims());
+  std::vector<int> database_image_ids;
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    database_descriptors.row(i) = model.Compute(descriptors[i]);
+    database_image_ids.push_back(static_cast<int>(i));
+  }
+
+  // The queries share most of their features with a database image.
+  GlobalDescriptors query_descriptors(10, model.NumDims());
+  std::vector<int> query_image_ids;
+  for (int i = 0; i < 10; ++i) {
+    FeatureDescriptors query = descriptors[5 * i];
+    query.topRows(20) = CreateRandomFeatureDescriptors(20);
+    query_descriptors.row(i) = model.Compute(query);
+    query_image_ids.push_back(-1);
+  }
+
+  std::vector<std::vector<ImageScore>> image_scores;
+  QueryGlobalDescriptors(query_image_ids, query_descriptors,
+                         database_image_ids, database_descriptors, 3, -1,
+                         &image_scores);
+  BOOST_CHECK_EQUAL(image_scores.size(), 10);
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK_EQUAL(image_scores[i].size(), 3);
+    BOOST_CHECK_EQUAL(image_scores[i][0].image_id, 5 * i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  SetPRNGSeed(0);
+
+  std::vector<FeatureDescriptors> training_descriptors;
+  for (int i = 0; i < 10; ++i) {
+    training_descriptors.push_back(CreateRandomFeatureDescriptors(50));
+  }
+
+  GlobalDescriptorOptions options;
+  options.num_words = 4;
+  GlobalDescriptorModel model;
+  model.Train(options, CreateRandomFeatureDescriptors(100).cast<float>(),
+              training_descriptors);
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_global_descriptor_%%%%-%%%%"))
+          .string();
+  model.Write(path);
+  GlobalDescriptorModel read_model;
+  read_model.Read(path);
+  boost::filesystem::remove(path);
+
+  BOOST_CHECK_EQUAL(read_model.NumWords(), model.NumWords());
+  BOOST_CHECK_EQUAL(read_model.NumDims(), model.NumDims());
+  BOOST_CHECK_EQUAL(read_model.Compute(training_descriptors[0]),
+                    model.Compute(training_descriptors[0]));
+}
+
+BOOST_AUTO_TEST_CASE(TestQueryGlobalDescriptors) {
+  SetPRNGSeed(0);
+
+  // The database spans multiple blocks of the matrix products.
+  const GlobalDescriptors query_descriptors =
+      CreateRandomGlobalDescriptors(300, 16);
+  const GlobalDescriptors database_descriptors =
+      CreateRandomGlobalDescriptors(5000, 16);
+  std::vector<int> query_image_ids;
+  for (int i = 0; i < query_descriptors.rows(); ++i) {
+    query_image_ids.push_back(i);
+  }
+  std::vector<int> database_image_ids;
+  for (int i = 0; i < database_descriptors.rows(); ++i) {
+    database_image_ids.push_back(i);
+  }
+
+  const int kNumImages = 10;
+  std::vector<std::vector<ImageScore>> image_scores;
+  QueryGlobalDescriptors(query_image_ids, query_descriptors,
+                         database_image_ids, database_descriptors, kNumImages,
+                         -1, &image_scores);
+  BOOST_CHECK_EQUAL(image_scores.size(), query_descriptors.rows());
+
+  const Eigen::MatrixXf scores =
+      query_descriptors * database_descriptors.transpose();
+  for (int i = 0; i < query_descriptors.rows(); ++i) {
+    std::vector<std::pair<float, int>> expected_scores;
+    for (int j = 0; j < database_descriptors.rows(); ++j) {
+      if (j != i) {
+        expected_scores.emplace_back(scores(i, j), j);
+      }
+    }
+    std::partial_sort(expected_scores.begin(),
+                      expected_scores.begin() + kNumImages,
+                      expected_scores.end(),
+                      std::greater<std::pair<float, int>>());
+
+    BOOST_CHECK_EQUAL(image_scores[i].size(), kNumImages);
+    for (int k = 0; k < kNumImages; ++k) {
+      BOOST_CHECK_EQUAL(image_scores[i][k].image_id,
+                        expected_scores[k].second);
+      BOOST_CHECK_CLOSE(image_scores[i][k].score, expected_scores[k].first,
+                        1e-3);
+    }
+  }
+
+  // With fewer database images, all of them except the query are retrieved.
+  QueryGlobalDescriptors(query_image_ids, query_descriptors, {0, 1, 2},
+                         database_descriptors.topRows(3), kNumImages, -1,
+                         &image_scores);
+  BOOST_CHECK_EQUAL(image_scores[0].size(), 2);
+  BOOST_CHECK_EQUAL(image_scores[3].size(), 3);
+  BOOST_CHECK_GE(image_scores[3][0].score, image_scores[3][1].score);
+  BOOST_CHECK_GE(image_scores[3][1].score, image_scores[3][2].score);
+}
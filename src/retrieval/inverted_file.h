@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <bitset>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <unordered_map>
 #include <unordered_set>
@@ -47,6 +48,7 @@
 #include "retrieval/utils.h"
 #include "util/alignment.h"
 #include "util/logging.h"
+#include "util/mapped_file.h"
 #include "util/math.h"
 
 namespace colmap {
@@ -55,6 +57,13 @@ namespace retrieval {
 // Implements an inverted file, including the ability to compute image scores
 // and matches. The template parameter is the length of the binary vectors
 // in the Hamming Embedding.
+//
+// The sorted entries are stored column-wise, such that scoring only streams
+// through the binary descriptors and the delta-coded image identifiers, while
+// the feature indices and geometries are only accessed for spatial
+// verification. Entries added after the last call to SortEntries are kept in
+// a separate buffer until they are merged into the columns. The columns can
+// also reference the entries of a memory-mapped index file, see ReadMapped.
 // This class is based on an original implementation by Torsten Sattler.
 template <int kEmbeddingDim>
 class InvertedFile {
@@ -70,13 +79,40 @@ class InvertedFile {
     USABLE = 0x03,
   };
 
+  // The header of an inverted file in the memory-mapped layout.
+  struct MappedHeader {
+    uint64_t num_entries;
+    uint64_t num_image_id_delta_bytes;
+    uint64_t num_images;
+    int32_t last_image_id;
+    float idf_weight;
+    float thresholds[kEmbeddingDim];
+    uint8_t status;
+  };
+
   InvertedFile();
 
   // The number of added entries.
   size_t NumEntries() const;
 
-  // Return all entries in the file.
-  const std::vector<EntryType>& GetEntries() const;
+  // The number of distinct images in the file at the time of the last call to
+  // SortEntries. Entries added since then are not accounted for.
+  size_t NumImages() const;
+
+  // The number of entries at the time of the last call to SortEntries.
+  size_t NumSortedEntries() const;
+
+  // Return all entries in the file with the sorted entries first.
+  std::vector<EntryType> GetEntries() const;
+
+  // Return the sorted entries of the given images.
+  void GetImageEntries(const std::unordered_set<int>& image_ids,
+                       std::vector<EntryType>* entries) const;
+
+  // Call func(image_id, num_entries) for each image in the sorted entries in
+  // ascending order of image identifiers.
+  template <typename ImageFunc>
+  void ForEachImage(ImageFunc func) const;
 
   // Whether the Hamming embedding was computed for this file.
   bool HasHammingEmbedding() const;
@@ -97,6 +133,7 @@ class InvertedFile {
 
   // Sorts the inverted file entries in ascending order of image ids. This is
   // required for efficient scoring and must be called before ScoreFeature.
+  // Entries of the same image keep the order in which they were added.
   void SortEntries();
 
   // Clear all entries in this file.
@@ -126,6 +163,17 @@ class InvertedFile {
   void ScoreFeature(const DescType& descriptor,
                     std::vector<ImageScore>* image_scores) const;
 
+  // Given a batch of binary query descriptors, performs inverted file scoring
+  // for all of them in a single pass over the entries. For every query
+  // descriptor and image with at least one vote, the score function is called
+  // as score_func(descriptor_idx, image_id, score), where the score is the
+  // same as the one computed by ScoreFeature. The Hamming distances are
+  // computed into the given scratch buffer, which can be reused across calls.
+  template <typename ScoreFunc>
+  void ScoreFeatures(
+      const std::vector<std::bitset<kEmbeddingDim>>& bin_descriptors,
+      std::vector<uint8_t>* hamming_dists, ScoreFunc score_func) const;
+
   // Get the identifiers of all indexed images in this file.
   void GetImageIds(std::unordered_set<int>* ids) const;
 
@@ -140,15 +188,53 @@ class InvertedFile {
   void Read(std::ifstream* ifs);
   void Write(std::ofstream* ofs) const;
 
+  // Read/write the inverted file in the memory-mapped layout, in which the
+  // headers of all inverted files are stored before their entries, so that
+  // reading the headers does not touch the entries. The sorted entries then
+  // reference the mapped file instead of being copied and they are only copied
+  // before the first modification. Entries that were added since the last call
+  // to SortEntries cannot be written.
+  void ReadMapped(const MappedHeader& header, const MappedFile& file,
+                  size_t* offset);
+  MappedHeader GetMappedHeader() const;
+  void WriteMappedEntries(std::ostream* stream) const;
+
  private:
+  // Append an entry to the sorted columns. The entries must be appended in
+  // ascending order of image identifiers.
+  void AppendSortedEntry(const int image_id, const int feature_idx,
+                         const uint64_t descriptor, const GeomType& geometry);
+
+  // Decode the next image identifier delta starting at the given position and
+  // advance the position to the next delta.
+  uint32_t DecodeImageIdDelta(size_t* pos) const;
+
   // Whether the inverted file is initialized.
   uint8_t status_;
 
   // The inverse document frequency weight of this inverted file.
   float idf_weight_;
 
-  // The entries of the inverted file system.
-  std::vector<EntryType> entries_;
+  // The binary signatures of the sorted entries.
+  MappableArray<uint64_t> descriptors_;
+
+  // The image identifiers of the sorted entries, each encoded as the
+  // difference to the identifier of the previous entry in a variable number of
+  // bytes. As entries of the same image are contiguous, this typically takes
+  // one byte per entry.
+  MappableArray<uint8_t> image_id_deltas_;
+
+  // The feature indices and geometries of the sorted entries.
+  MappableArray<int> feature_idxs_;
+  MappableArray<GeomType> geometries_;
+
+  // The number of distinct images and the last image identifier in the sorted
+  // entries.
+  size_t num_images_;
+  int last_image_id_;
+
+  // The entries added since the last call to SortEntries.
+  std::vector<EntryType> new_entries_;
 
   // The thresholds used for Hamming embedding.
   DescType thresholds_;
@@ -168,12 +254,14 @@ const HammingDistWeightFunctor<kEmbeddingDim>
 
 template <int kEmbeddingDim>
 InvertedFile<kEmbeddingDim>::InvertedFile()
-    : status_(UNUSABLE), idf_weight_(0.0f) {
+    : status_(UNUSABLE), idf_weight_(0.0f), num_images_(0), last_image_id_(0) {
   static_assert(kEmbeddingDim % 8 == 0,
                 "Dimensionality of projected space needs to"
                 " be a multiple of 8.");
   static_assert(kEmbeddingDim > 0,
                 "Dimensionality of projected space needs to be > 0.");
+  static_assert(kEmbeddingDim <= 64,
+                "Dimensionality of projected space needs to be <= 64.");
 
   thresholds_.resize(kEmbeddingDim);
   thresholds_.setZero();
@@ -181,13 +269,88 @@ InvertedFile<kEmbeddingDim>::InvertedFile()
 
 template <int kEmbeddingDim>
 size_t InvertedFile<kEmbeddingDim>::NumEntries() const {
-  return entries_.size();
+  return descriptors_.size() + new_entries_.size();
+}
+
+template <int kEmbeddingDim>
+size_t InvertedFile<kEmbeddingDim>::NumImages() const {
+  return num_images_;
 }
 
 template <int kEmbeddingDim>
-const std::vector<typename InvertedFile<kEmbeddingDim>::EntryType>&
+size_t InvertedFile<kEmbeddingDim>::NumSortedEntries() const {
+  return descriptors_.size();
+}
+
+template <int kEmbeddingDim>
+std::vector<typename InvertedFile<kEmbeddingDim>::EntryType>
 InvertedFile<kEmbeddingDim>::GetEntries() const {
-  return entries_;
+  std::vector<EntryType> entries;
+  entries.reserve(NumEntries());
+
+  size_t pos = 0;
+  int image_id = 0;
+  for (size_t i = 0; i < descriptors_.size(); ++i) {
+    image_id += static_cast<int>(DecodeImageIdDelta(&pos));
+    EntryType entry;
+    entry.image_id = image_id;
+    entry.feature_idx = feature_idxs_[i];
+    entry.geometry = geometries_[i];
+    entry.descriptor = std::bitset<kEmbeddingDim>(descriptors_[i]);
+    entries.push_back(entry);
+  }
+
+  entries.insert(entries.end(), new_entries_.begin(), new_entries_.end());
+
+  return entries;
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::GetImageEntries(
+    const std::unordered_set<int>& image_ids,
+    std::vector<EntryType>* entries) const {
+  entries->clear();
+
+  size_t pos = 0;
+  int image_id = 0;
+  bool is_query_image = false;
+  for (size_t i = 0; i < descriptors_.size(); ++i) {
+    const uint32_t delta = DecodeImageIdDelta(&pos);
+    image_id += static_cast<int>(delta);
+    if (i == 0 || delta > 0) {
+      is_query_image = image_ids.count(image_id) > 0;
+    }
+
+    if (is_query_image) {
+      EntryType entry;
+      entry.image_id = image_id;
+      entry.feature_idx = feature_idxs_[i];
+      entry.geometry = geometries_[i];
+      entry.descriptor = std::bitset<kEmbeddingDim>(descriptors_[i]);
+      entries->push_back(entry);
+    }
+  }
+}
+
+template <int kEmbeddingDim>
+template <typename ImageFunc>
+void InvertedFile<kEmbeddingDim>::ForEachImage(ImageFunc func) const {
+  size_t pos = 0;
+  int image_id = 0;
+  size_t num_image_entries = 0;
+  for (size_t i = 0; i < descriptors_.size(); ++i) {
+    const uint32_t delta = DecodeImageIdDelta(&pos);
+    if (i > 0 && delta > 0) {
+      func(image_id, num_image_entries);
+      num_image_entries = 0;
+    }
+    image_id += static_cast<int>(delta);
+    num_image_entries += 1;
+  }
+
+  if (num_image_entries > 0) {
+    func(image_id, num_image_entries);
+  }
 }
 
 template <int kEmbeddingDim>
@@ -217,30 +380,88 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
   entry.feature_idx = feature_idx;
   entry.geometry = geometry;
   ConvertToBinaryDescriptor(descriptor, &entry.descriptor);
-  entries_.push_back(entry);
+  new_entries_.push_back(entry);
   status_ &= ~ENTRIES_SORTED;
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::SortEntries() {
-  std::sort(entries_.begin(), entries_.end(),
-            [](const EntryType& entry1, const EntryType& entry2) {
-              return entry1.image_id < entry2.image_id;
-            });
   status_ |= ENTRIES_SORTED;
+
+  if (new_entries_.empty()) {
+    return;
+  }
+
+  std::stable_sort(new_entries_.begin(), new_entries_.end(),
+                   [](const EntryType& entry1, const EntryType& entry2) {
+                     return entry1.image_id < entry2.image_id;
+                   });
+
+  // Fast path for the common case of appending images with larger
+  // identifiers than all previously sorted images.
+  if (descriptors_.empty() ||
+      new_entries_.front().image_id >= last_image_id_) {
+    for (const auto& entry : new_entries_) {
+      AppendSortedEntry(entry.image_id, entry.feature_idx,
+                        entry.descriptor.to_ullong(), entry.geometry);
+    }
+    new_entries_.clear();
+    return;
+  }
+
+  // Otherwise, merge the sorted and the new entries into new columns.
+  InvertedFile<kEmbeddingDim> merged_file;
+  merged_file.descriptors_.reserve(NumEntries());
+  merged_file.feature_idxs_.reserve(NumEntries());
+  merged_file.geometries_.reserve(NumEntries());
+
+  size_t pos = 0;
+  int image_id = 0;
+  auto new_entry = new_entries_.begin();
+  for (size_t i = 0; i < descriptors_.size(); ++i) {
+    image_id += static_cast<int>(DecodeImageIdDelta(&pos));
+    for (; new_entry != new_entries_.end() && new_entry->image_id < image_id;
+         ++new_entry) {
+      merged_file.AppendSortedEntry(
+          new_entry->image_id, new_entry->feature_idx,
+          new_entry->descriptor.to_ullong(), new_entry->geometry);
+    }
+    merged_file.AppendSortedEntry(image_id, feature_idxs_[i], descriptors_[i],
+                                  geometries_[i]);
+  }
+
+  for (; new_entry != new_entries_.end(); ++new_entry) {
+    merged_file.AppendSortedEntry(
+        new_entry->image_id, new_entry->feature_idx,
+        new_entry->descriptor.to_ullong(), new_entry->geometry);
+  }
+
+  descriptors_.swap(merged_file.descriptors_);
+  image_id_deltas_.swap(merged_file.image_id_deltas_);
+  feature_idxs_.swap(merged_file.feature_idxs_);
+  geometries_.swap(merged_file.geometries_);
+  num_images_ = merged_file.num_images_;
+  last_image_id_ = merged_file.last_image_id_;
+  new_entries_.clear();
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ClearEntries() {
-  entries_.clear();
+  descriptors_.clear();
+  image_id_deltas_.clear();
+  feature_idxs_.clear();
+  geometries_.clear();
+  num_images_ = 0;
+  last_image_id_ = 0;
+  new_entries_.clear();
   status_ &= ~ENTRIES_SORTED;
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::Reset() {
+  ClearEntries();
   status_ = UNUSABLE;
   idf_weight_ = 0.0f;
-  entries_.clear();
   thresholds_.setZero();
 }
 
@@ -256,15 +477,15 @@ void InvertedFile<kEmbeddingDim>::ConvertToBinaryDescriptor(
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ComputeIDFWeight(const int num_total_images) {
-  if (entries_.empty()) {
+  if (NumEntries() == 0) {
     return;
   }
 
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
+  CHECK(EntriesSorted());
+  CHECK_GT(num_images_, 0);
 
   idf_weight_ = std::log(static_cast<double>(num_total_images) /
-                         static_cast<double>(image_ids.size()));
+                         static_cast<double>(num_images_));
 }
 
 template <int kEmbeddingDim>
@@ -298,67 +519,105 @@ void InvertedFile<kEmbeddingDim>::ScoreFeature(
 
   image_scores->clear();
 
+  std::vector<std::bitset<kEmbeddingDim>> bin_descriptors(1);
+  ConvertToBinaryDescriptor(descriptor, &bin_descriptors[0]);
+
+  std::vector<uint8_t> hamming_dists;
+  ScoreFeatures(bin_descriptors, &hamming_dists,
+                [image_scores](const size_t, const int image_id,
+                               const float score) {
+                  ImageScore image_score;
+                  image_score.image_id = image_id;
+                  image_score.score = score;
+                  image_scores->push_back(image_score);
+                });
+}
+
+template <int kEmbeddingDim>
+template <typename ScoreFunc>
+void InvertedFile<kEmbeddingDim>::ScoreFeatures(
+    const std::vector<std::bitset<kEmbeddingDim>>& bin_descriptors,
+    std::vector<uint8_t>* hamming_dists, ScoreFunc score_func) const {
   if (!IsUsable()) {
     return;
   }
 
-  if (entries_.size() == 0) {
+  const size_t num_entries = descriptors_.size();
+  if (num_entries == 0) {
     return;
   }
 
   const float squared_idf_weight = idf_weight_ * idf_weight_;
 
-  std::bitset<kEmbeddingDim> bin_descriptor;
-  ConvertToBinaryDescriptor(descriptor, &bin_descriptor);
-
-  ImageScore image_score;
-  image_score.image_id = entries_.front().image_id;
-  image_score.score = 0.0f;
-  int num_image_votes = 0;
-
-  // Note that this assumes that the entries are sorted using SortEntries
-  // according to their image identifiers.
-  for (const auto& entry : entries_) {
-    if (image_score.image_id < entry.image_id) {
-      if (num_image_votes > 0) {
-        // Finalizes the voting since we now know how many features from
-        // the database image match the current image feature. This is
-        // required to perform burstiness normalization (cf. Eqn. 2 in
-        // Arandjelovic, Zisserman: Scalable descriptor
-        // distinctiveness for location recognition. ACCV 2014).
-        // Notice that the weight from the descriptor matching is already
-        // accumulated in image_score.score, i.e., we only need
-        // to apply the burstiness weighting.
-        image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-        image_score.score *= squared_idf_weight;
-        image_scores->push_back(image_score);
+  if (hamming_dists->size() < num_entries) {
+    hamming_dists->resize(num_entries);
+  }
+  uint8_t* entry_hamming_dists = hamming_dists->data();
+
+  for (size_t i = 0; i < bin_descriptors.size(); ++i) {
+    // First compute the Hamming distances to all entries in a single pass over
+    // the contiguous binary signatures, which is vectorized using POPCNT.
+    ComputeHammingDistances(bin_descriptors[i].to_ullong(),
+                            descriptors_.data(), num_entries,
+                            entry_hamming_dists);
+
+    // Then accumulate the votes per image. Note that this assumes that the
+    // entries are sorted using SortEntries according to their image
+    // identifiers.
+    size_t pos = 0;
+    int image_id = 0;
+    float score = 0.0f;
+    int num_image_votes = 0;
+    for (size_t j = 0; j < num_entries; ++j) {
+      uint32_t delta = image_id_deltas_[pos];
+      if (delta < 0x80) {
+        pos += 1;
+      } else {
+        delta = DecodeImageIdDelta(&pos);
       }
 
-      image_score.image_id = entry.image_id;
-      image_score.score = 0.0f;
-      num_image_votes = 0;
-    }
-
-    const size_t hamming_dist = (bin_descriptor ^ entry.descriptor).count();
+      if (delta > 0) {
+        if (num_image_votes > 0) {
+          // Finalizes the voting since we now know how many features from
+          // the database image match the current image feature. This is
+          // required to perform burstiness normalization (cf. Eqn. 2 in
+          // Arandjelovic, Zisserman: Scalable descriptor
+          // distinctiveness for location recognition. ACCV 2014).
+          // Notice that the weight from the descriptor matching is already
+          // accumulated in score, i.e., we only need to apply the burstiness
+          // weighting.
+          score /= std::sqrt(static_cast<float>(num_image_votes));
+          score *= squared_idf_weight;
+          score_func(i, image_id, score);
+        }
+
+        image_id += static_cast<int>(delta);
+        score = 0.0f;
+        num_image_votes = 0;
+      }
 
-    if (hamming_dist <= hamming_dist_weight_functor_.kMaxHammingDistance) {
-      image_score.score += hamming_dist_weight_functor_(hamming_dist);
-      num_image_votes += 1;
+      const uint8_t hamming_dist = entry_hamming_dists[j];
+      if (hamming_dist <= hamming_dist_weight_functor_.kMaxHammingDistance) {
+        score += hamming_dist_weight_functor_(hamming_dist);
+        num_image_votes += 1;
+      }
     }
-  }
 
-  // Add the voting for the largest image_id in the entries.
-  if (num_image_votes > 0) {
-    image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-    image_score.score *= squared_idf_weight;
-    image_scores->push_back(image_score);
+    // Add the voting for the largest image_id in the entries.
+    if (num_image_votes > 0) {
+      score /= std::sqrt(static_cast<float>(num_image_votes));
+      score *= squared_idf_weight;
+      score_func(i, image_id, score);
+    }
   }
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::GetImageIds(
     std::unordered_set<int>* ids) const {
-  for (const EntryType& entry : entries_) {
+  ForEachImage(
+      [ids](const int image_id, const size_t) { ids->insert(image_id); });
+  for (const EntryType& entry : new_entries_) {
     ids->insert(entry.image_id);
   }
 }
@@ -367,15 +626,17 @@ template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ComputeImageSelfSimilarities(
     std::unordered_map<int, double>* self_similarities) const {
   const double squared_idf_weight = idf_weight_ * idf_weight_;
-  for (const auto& entry : entries_) {
-    (*self_similarities)[entry.image_id] += squared_idf_weight;
-  }
+  ForEachImage([&](const int image_id, const size_t num_image_entries) {
+    (*self_similarities)[image_id] += num_image_entries * squared_idf_weight;
+  });
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
   CHECK(ifs->is_open());
 
+  ClearEntries();
+
   ifs->read(reinterpret_cast<char*>(&status_), sizeof(uint8_t));
   ifs->read(reinterpret_cast<char*>(&idf_weight_), sizeof(float));
 
@@ -385,10 +646,16 @@ void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
 
   uint32_t num_entries = 0;
   ifs->read(reinterpret_cast<char*>(&num_entries), sizeof(uint32_t));
-  entries_.resize(num_entries);
+  new_entries_.resize(num_entries);
 
   for (uint32_t i = 0; i < num_entries; ++i) {
-    entries_[i].Read(ifs);
+    new_entries_[i].Read(ifs);
+  }
+
+  // Sorted files are stored in sorted order, so that they are directly
+  // appended to the columns.
+  if (EntriesSorted()) {
+    SortEntries();
   }
 }
 
@@ -403,12 +670,112 @@ void InvertedFile<kEmbeddingDim>::Write(std::ofstream* ofs) const {
     ofs->write(reinterpret_cast<const char*>(&thresholds_[i]), sizeof(float));
   }
 
-  const uint32_t num_entries = static_cast<uint32_t>(entries_.size());
+  const std::vector<EntryType> entries = GetEntries();
+
+  const uint32_t num_entries = static_cast<uint32_t>(entries.size());
   ofs->write(reinterpret_cast<const char*>(&num_entries), sizeof(uint32_t));
 
   for (uint32_t i = 0; i < num_entries; ++i) {
-    entries_[i].Write(ofs);
+    entries[i].Write(ofs);
+  }
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::ReadMapped(const MappedHeader& header,
+                                             const MappedFile& file,
+                                             size_t* offset) {
+  ClearEntries();
+
+  status_ = header.status;
+  idf_weight_ = header.idf_weight;
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    thresholds_[i] = header.thresholds[i];
+  }
+
+  const size_t num_entries = static_cast<size_t>(header.num_entries);
+  const size_t num_image_id_delta_bytes =
+      static_cast<size_t>(header.num_image_id_delta_bytes);
+  descriptors_.Map(file.ReadArray<uint64_t>(offset, num_entries), num_entries);
+  image_id_deltas_.Map(
+      file.ReadArray<uint8_t>(offset, num_image_id_delta_bytes),
+      num_image_id_delta_bytes);
+  feature_idxs_.Map(file.ReadArray<int>(offset, num_entries), num_entries);
+  geometries_.Map(file.ReadArray<GeomType>(offset, num_entries), num_entries);
+  num_images_ = static_cast<size_t>(header.num_images);
+  last_image_id_ = header.last_image_id;
+}
+
+template <int kEmbeddingDim>
+typename InvertedFile<kEmbeddingDim>::MappedHeader
+InvertedFile<kEmbeddingDim>::GetMappedHeader() const {
+  CHECK(new_entries_.empty()) << "Entries must be sorted before writing";
+
+  // Zero the padding bytes for reproducible files.
+  MappedHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.num_entries = descriptors_.size();
+  header.num_image_id_delta_bytes = image_id_deltas_.size();
+  header.num_images = num_images_;
+  header.last_image_id = last_image_id_;
+  header.idf_weight = idf_weight_;
+  for (int i = 0; i < kEmbeddingDim; ++i) {
+    header.thresholds[i] = thresholds_[i];
   }
+  header.status = status_;
+  return header;
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::WriteMappedEntries(
+    std::ostream* stream) const {
+  CHECK(new_entries_.empty()) << "Entries must be sorted before writing";
+  WriteMappedArray(stream, descriptors_.data(), descriptors_.size());
+  WriteMappedArray(stream, image_id_deltas_.data(), image_id_deltas_.size());
+  WriteMappedArray(stream, feature_idxs_.data(), feature_idxs_.size());
+  WriteMappedArray(stream, geometries_.data(), geometries_.size());
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::AppendSortedEntry(const int image_id,
+                                                    const int feature_idx,
+                                                    const uint64_t descriptor,
+                                                    const GeomType& geometry) {
+  uint32_t delta = static_cast<uint32_t>(image_id);
+  if (!descriptors_.empty()) {
+    CHECK_GE(image_id, last_image_id_);
+    delta = static_cast<uint32_t>(image_id - last_image_id_);
+  }
+
+  if (descriptors_.empty() || delta > 0) {
+    num_images_ += 1;
+  }
+
+  // Encode the delta with 7 bits per byte, where the most significant bit
+  // indicates whether another byte follows.
+  while (delta >= 0x80) {
+    image_id_deltas_.push_back(static_cast<uint8_t>((delta & 0x7F) | 0x80));
+    delta >>= 7;
+  }
+  image_id_deltas_.push_back(static_cast<uint8_t>(delta));
+
+  last_image_id_ = image_id;
+  descriptors_.push_back(descriptor);
+  feature_idxs_.push_back(feature_idx);
+  geometries_.push_back(geometry);
+}
+
+template <int kEmbeddingDim>
+uint32_t InvertedFile<kEmbeddingDim>::DecodeImageIdDelta(size_t* pos) const {
+  uint32_t delta = 0;
+  int shift = 0;
+  uint8_t byte = 0;
+  do {
+    byte = image_id_deltas_[*pos];
+    *pos += 1;
+    delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return delta;
 }
 
 }  // namespace retrieval
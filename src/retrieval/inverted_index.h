@@ -34,8 +34,11 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -45,6 +48,7 @@
 
 #include "retrieval/inverted_file.h"
 #include "util/alignment.h"
+#include "util/mapped_file.h"
 #include "util/random.h"
 
 namespace colmap {
@@ -64,6 +68,30 @@ class InvertedIndex {
   typedef Eigen::Matrix<float, Eigen::Dynamic, kDescDim> ProjMatrixType;
   typedef Eigen::VectorXf ProjDescType;
 
+  // Per-image sums over all entries of the image, from which the
+  // self-similarity is obtained in closed form for any number of images N:
+  //
+  //    sum_w (log(N) - log(n_w))^2
+  //      = num_entries * log(N)^2 - 2 * log(N) * sum_log + sum_squared_log,
+  //
+  // where n_w is the number of images in the inverted file of the entry. The
+  // sums are additive over disjoint sets of visual words.
+  struct ImageStatistics {
+    size_t num_entries = 0;
+    double sum_log = 0.0;
+    double sum_squared_log = 0.0;
+  };
+
+  // Scratch buffers of QueryBatch, which can be reused across calls to avoid
+  // allocating and clearing the dense score arrays for every batch. The score
+  // arrays are left zeroed after each call by resetting only the slots that
+  // received votes. A buffer must not be used by multiple threads at once.
+  struct QueryBatchBuffers {
+    std::vector<float> scores;
+    std::vector<uint8_t> has_votes;
+    std::vector<uint8_t> hamming_dists;
+  };
+
   InvertedIndex();
 
   // The number of visual words in the index.
@@ -73,9 +101,22 @@ class InvertedIndex {
   void Initialize(const int num_words);
 
   // Finalizes the inverted index by sorting each inverted file such that all
-  // entries are in ascending order of image ids.
+  // entries are in ascending order of image ids. Only inverted files with
+  // entries added since the last call are processed, so that the index can be
+  // extended incrementally with new images at a cost proportional to the size
+  // of the affected inverted files.
   void Finalize();
 
+  // Finalizes one shard of an index whose visual words are distributed over
+  // multiple shards. In contrast to Finalize, the weights are computed from
+  // the given statistics of all images in all shards, which are the sums of
+  // the statistics of the individual shards.
+  void FinalizeShard(
+      const std::unordered_map<int, ImageStatistics>& total_image_statistics);
+
+  // The statistics of all images with entries in the index.
+  const std::unordered_map<int, ImageStatistics>& GetImageStatistics() const;
+
   // Generate projection matrix for Hamming embedding.
   void GenerateHammingEmbeddingProjection();
 
@@ -96,14 +137,37 @@ class InvertedIndex {
   void Query(const DescType& descriptors, const Eigen::MatrixXi& word_ids,
              std::vector<ImageScore>* image_scores) const;
 
+  // Query one shard of the index. The image scores are not yet normalized by
+  // the self-similarity of the query image, of which the part caused by the
+  // visual words in this shard is returned. The final scores are the sums of
+  // the scores of all shards divided by the square root of the sum of the
+  // self-similarities of all shards.
+  void QueryShard(const DescType& descriptors, const Eigen::MatrixXi& word_ids,
+                  std::vector<ImageScore>* image_scores,
+                  float* self_similarity) const;
+
+  // Query the inverted file for a batch of images and return a list of images
+  // for each query image. The result is the same as calling Query for each
+  // query image, but each inverted file is traversed only once for all query
+  // features assigned to it and the votes are accumulated in dense arrays
+  // indexed by image identifiers. The arrays are taken from the given buffers
+  // or allocated for this call, if no buffers are given.
+  void QueryBatch(const std::vector<DescType>& descriptors,
+                  const std::vector<Eigen::MatrixXi>& word_ids,
+                  std::vector<std::vector<ImageScore>>* image_scores,
+                  QueryBatchBuffers* buffers = nullptr) const;
+
   void ConvertToBinaryDescriptor(
       const int word_id, const DescType& descriptor,
       std::bitset<kEmbeddingDim>* binary_descriptor) const;
 
   float GetIDFWeight(const int word_id) const;
 
+  // The number of entries in the inverted file of the visual word.
+  size_t NumEntries(const int word_id) const;
+
   void FindMatches(const int word_id, const std::unordered_set<int>& image_ids,
-                   std::vector<const EntryType*>* matches) const;
+                   std::vector<EntryType>* matches) const;
 
   // Compute the self-similarity for the image.
   float ComputeSelfSimilarity(const Eigen::MatrixXi& word_ids) const;
@@ -115,8 +179,26 @@ class InvertedIndex {
   void Read(std::ifstream* ifs);
   void Write(std::ofstream* ofs) const;
 
+  // Read/write the inverted index in the memory-mapped layout starting at the
+  // given offset of the file, see InvertedFile::ReadMapped. The index keeps a
+  // reference to the mapped file as long as it references its entries. The
+  // index must be finalized before writing.
+  void ReadMapped(const std::shared_ptr<const MappedFile>& file,
+                  size_t* offset);
+  void WriteMapped(std::ostream* stream) const;
+
  private:
-  void ComputeWeightsAndNormalizationConstants();
+  // Sort all inverted files with new entries and update the statistics of
+  // their images.
+  void SortInvertedFiles();
+
+  // Add the contribution of the sorted entries of the given inverted file to
+  // the image statistics, scaled by the given sign.
+  void UpdateImageStatistics(const InvertedFile<kEmbeddingDim>& inverted_file,
+                             const int sign);
+
+  void ComputeWeightsAndNormalizationConstants(
+      const std::unordered_map<int, ImageStatistics>& total_image_statistics);
 
   // The individual inverted indices.
   std::vector<InvertedFile<kEmbeddingDim>,
@@ -127,8 +209,17 @@ class InvertedIndex {
   // normalize the votes.
   std::unordered_map<int, float> normalization_constants_;
 
+  // For each image in the database, the statistics of its entries.
+  std::unordered_map<int, ImageStatistics> image_statistics_;
+
+  // The largest identifier of all images in the database.
+  int max_image_id_;
+
   // The projection matrix used to project SIFT descriptors.
   ProjMatrixType proj_matrix_;
+
+  // The memory-mapped file referenced by the inverted files, if any.
+  std::shared_ptr<const MappedFile> mapped_file_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -140,7 +231,8 @@ const int InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::kInvalidWordId =
     std::numeric_limits<int>::max();
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex() {
+InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::InvertedIndex()
+    : max_image_id_(-1) {
   proj_matrix_.resize(kEmbeddingDim, kDescDim);
   proj_matrix_.setIdentity();
 }
@@ -158,17 +250,32 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Initialize(
   for (auto& inverted_file : inverted_files_) {
     inverted_file.Reset();
   }
+  image_statistics_.clear();
+  max_image_id_ = -1;
+  mapped_file_.reset();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize() {
   CHECK_GT(NumVisualWords(), 0);
+  SortInvertedFiles();
+  ComputeWeightsAndNormalizationConstants(image_statistics_);
+}
 
-  for (auto& inverted_file : inverted_files_) {
-    inverted_file.SortEntries();
-  }
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::FinalizeShard(
+    const std::unordered_map<int, ImageStatistics>& total_image_statistics) {
+  CHECK_GT(NumVisualWords(), 0);
+  SortInvertedFiles();
+  ComputeWeightsAndNormalizationConstants(total_image_statistics);
+}
 
-  ComputeWeightsAndNormalizationConstants();
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+const std::unordered_map<
+    int, typename InvertedIndex<kDescType, kDescDim,
+                                kEmbeddingDim>::ImageStatistics>&
+InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::GetImageStatistics() const {
+  return image_statistics_;
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -233,22 +340,36 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ClearEntries() {
   for (auto& inverted_file : inverted_files_) {
     inverted_file.ClearEntries();
   }
+  image_statistics_.clear();
+  max_image_id_ = -1;
+  mapped_file_.reset();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     const DescType& descriptors, const Eigen::MatrixXi& word_ids,
     std::vector<ImageScore>* image_scores) const {
+  float self_similarity = 0.0f;
+  QueryShard(descriptors, word_ids, image_scores, &self_similarity);
+
+  if (self_similarity > 0.0f) {
+    const float normalization_weight = 1.0f / std::sqrt(self_similarity);
+    for (ImageScore& score : *image_scores) {
+      score.score *= normalization_weight;
+    }
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::QueryShard(
+    const DescType& descriptors, const Eigen::MatrixXi& word_ids,
+    std::vector<ImageScore>* image_scores, float* self_similarity) const {
   CHECK_EQ(descriptors.cols(), kDescDim);
 
   image_scores->clear();
 
   // Computes the self-similarity score for the query image.
-  const float self_similarity = ComputeSelfSimilarity(word_ids);
-  float normalization_weight = 1.0f;
-  if (self_similarity > 0.0f) {
-    normalization_weight = 1.0f / std::sqrt(self_similarity);
-  }
+  *self_similarity = ComputeSelfSimilarity(word_ids);
 
   std::unordered_map<int, int> score_map;
   std::vector<ImageScore> inverted_file_scores;
@@ -280,10 +401,135 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     }
   }
 
-  // Normalization.
+  // Normalization by the self-similarity of the database images.
   for (ImageScore& score : *image_scores) {
-    score.score *=
-        normalization_weight * normalization_constants_.at(score.image_id);
+    score.score *= normalization_constants_.at(score.image_id);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::QueryBatch(
+    const std::vector<DescType>& descriptors,
+    const std::vector<Eigen::MatrixXi>& word_ids,
+    std::vector<std::vector<ImageScore>>* image_scores,
+    QueryBatchBuffers* buffers) const {
+  CHECK_EQ(descriptors.size(), word_ids.size());
+
+  const size_t num_queries = descriptors.size();
+
+  image_scores->resize(num_queries);
+  for (auto& query_image_scores : *image_scores) {
+    query_image_scores.clear();
+  }
+
+  struct WordAssignment {
+    int word_id;
+    int query_idx;
+    int feature_idx;
+  };
+
+  // Collect the visual word assignments of all query features, such that all
+  // query features of the same visual word can be scored together.
+  std::vector<WordAssignment> word_assignments;
+  std::vector<std::vector<ProjDescType>> proj_descriptors(num_queries);
+  std::vector<float> normalization_weights(num_queries, 1.0f);
+  for (size_t query_idx = 0; query_idx < num_queries; ++query_idx) {
+    const auto& query_descriptors = descriptors[query_idx];
+    const auto& query_word_ids = word_ids[query_idx];
+    CHECK_EQ(query_descriptors.cols(), kDescDim);
+    CHECK_EQ(query_descriptors.rows(), query_word_ids.rows());
+
+    const float self_similarity = ComputeSelfSimilarity(query_word_ids);
+    if (self_similarity > 0.0f) {
+      normalization_weights[query_idx] = 1.0f / std::sqrt(self_similarity);
+    }
+
+    proj_descriptors[query_idx].resize(query_descriptors.rows());
+    for (typename DescType::Index i = 0; i < query_descriptors.rows(); ++i) {
+      proj_descriptors[query_idx][i] =
+          proj_matrix_ *
+          query_descriptors.row(i).transpose().template cast<float>();
+      for (Eigen::MatrixXi::Index n = 0; n < query_word_ids.cols(); ++n) {
+        const int word_id = query_word_ids(i, n);
+        if (word_id != kInvalidWordId) {
+          word_assignments.push_back({word_id, static_cast<int>(query_idx),
+                                      static_cast<int>(i)});
+        }
+      }
+    }
+  }
+
+  std::sort(word_assignments.begin(), word_assignments.end(),
+            [](const WordAssignment& assignment1,
+               const WordAssignment& assignment2) {
+              return assignment1.word_id < assignment2.word_id;
+            });
+
+  QueryBatchBuffers call_buffers;
+  if (buffers == nullptr) {
+    buffers = &call_buffers;
+  }
+
+  // Dense score arrays with one slot per query and database image, which are
+  // zero in all slots at this point.
+  const size_t num_image_slots = static_cast<size_t>(max_image_id_ + 1);
+  const size_t num_slots = num_queries * num_image_slots;
+  if (buffers->scores.size() < num_slots) {
+    buffers->scores.resize(num_slots, 0.0f);
+    buffers->has_votes.resize(num_slots, 0);
+  }
+  float* scores = buffers->scores.data();
+  uint8_t* has_votes = buffers->has_votes.data();
+
+  std::vector<std::bitset<kEmbeddingDim>> bin_descriptors;
+
+  size_t word_begin = 0;
+  while (word_begin < word_assignments.size()) {
+    const int word_id = word_assignments[word_begin].word_id;
+    size_t word_end = word_begin + 1;
+    while (word_end < word_assignments.size() &&
+           word_assignments[word_end].word_id == word_id) {
+      word_end += 1;
+    }
+
+    const auto& inverted_file = inverted_files_.at(word_id);
+
+    bin_descriptors.resize(word_end - word_begin);
+    for (size_t i = word_begin; i < word_end; ++i) {
+      const auto& assignment = word_assignments[i];
+      inverted_file.ConvertToBinaryDescriptor(
+          proj_descriptors[assignment.query_idx][assignment.feature_idx],
+          &bin_descriptors[i - word_begin]);
+    }
+
+    inverted_file.ScoreFeatures(
+        bin_descriptors, &buffers->hamming_dists,
+        [&](const size_t descriptor_idx, const int image_id,
+            const float score) {
+          const int query_idx =
+              word_assignments[word_begin + descriptor_idx].query_idx;
+          const size_t slot = query_idx * num_image_slots + image_id;
+          if (!has_votes[slot]) {
+            has_votes[slot] = 1;
+            ImageScore image_score;
+            image_score.image_id = image_id;
+            (*image_scores)[query_idx].push_back(image_score);
+          }
+          scores[slot] += score;
+        });
+
+    word_begin = word_end;
+  }
+
+  for (size_t query_idx = 0; query_idx < num_queries; ++query_idx) {
+    for (ImageScore& image_score : (*image_scores)[query_idx]) {
+      const size_t slot = query_idx * num_image_slots + image_score.image_id;
+      image_score.score = scores[slot] * normalization_weights[query_idx] *
+                          normalization_constants_.at(image_score.image_id);
+      // Reset the used slots for the next call.
+      scores[slot] = 0.0f;
+      has_votes[slot] = 0;
+    }
   }
 }
 
@@ -304,17 +550,17 @@ float InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::GetIDFWeight(
   return inverted_files_.at(word_id).IDFWeight();
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+size_t InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::NumEntries(
+    const int word_id) const {
+  return inverted_files_.at(word_id).NumEntries();
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::FindMatches(
     const int word_id, const std::unordered_set<int>& image_ids,
-    std::vector<const EntryType*>* matches) const {
-  matches->clear();
-  const auto& entries = inverted_files_.at(word_id).GetEntries();
-  for (const auto& entry : entries) {
-    if (image_ids.count(entry.image_id)) {
-      matches->emplace_back(&entry);
-    }
-  }
+    std::vector<EntryType>* matches) const {
+  inverted_files_.at(word_id).GetImageEntries(image_ids, matches);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -334,8 +580,15 @@ float InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ComputeSelfSimilarity(
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::GetImageIds(
     std::unordered_set<int>* image_ids) const {
+  // The statistics cover all sorted entries, so that only the inverted files
+  // with unsorted entries must be traversed.
+  for (const auto& image_statistics : image_statistics_) {
+    image_ids->insert(image_statistics.first);
+  }
   for (const auto& inverted_file : inverted_files_) {
-    inverted_file.GetImageIds(image_ids);
+    if (!inverted_file.EntriesSorted()) {
+      inverted_file.GetImageIds(image_ids);
+    }
   }
 }
 
@@ -364,6 +617,7 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
 
   for (auto& inverted_file : inverted_files_) {
     inverted_file.Read(ifs);
+    UpdateImageStatistics(inverted_file, 1);
   }
 
   int32_t num_images = 0;
@@ -379,6 +633,11 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
     ifs->read(reinterpret_cast<char*>(&value), sizeof(float));
     normalization_constants_[image_id] = value;
   }
+
+  max_image_id_ = -1;
+  for (const auto& image_statistics : image_statistics_) {
+    max_image_id_ = std::max(max_image_id_, image_statistics.first);
+  }
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -414,28 +673,171 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
-void InvertedIndex<kDescType, kDescDim,
-                   kEmbeddingDim>::ComputeWeightsAndNormalizationConstants() {
-  std::unordered_set<int> image_ids;
-  GetImageIds(&image_ids);
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::ReadMapped(
+    const std::shared_ptr<const MappedFile>& file, size_t* offset) {
+  const int32_t num_words = file->Read<int32_t>(offset);
+  CHECK_GT(num_words, 0);
 
-  for (auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeIDFWeight(image_ids.size());
+  Initialize(num_words);
+
+  const int32_t N_t = file->Read<int32_t>(offset);
+  CHECK_EQ(N_t, kEmbeddingDim)
+      << "The length of the binary strings should be " << kEmbeddingDim
+      << " but is " << N_t << ". The indices are not compatible!";
+
+  std::memcpy(proj_matrix_.data(),
+              file->ReadArray<float>(offset, proj_matrix_.size()),
+              proj_matrix_.size() * sizeof(float));
+
+  typedef typename InvertedFile<kEmbeddingDim>::MappedHeader MappedHeader;
+  const MappedHeader* headers =
+      file->ReadArray<MappedHeader>(offset, num_words);
+  for (int32_t i = 0; i < num_words; ++i) {
+    inverted_files_[i].ReadMapped(headers[i], *file, offset);
+  }
+
+  // The per-image data is stored explicitly, so that it is not necessary to
+  // iterate over the entries of all inverted files.
+  const size_t num_images = static_cast<size_t>(file->Read<uint64_t>(offset));
+  const int32_t* image_ids = file->ReadArray<int32_t>(offset, num_images);
+  const float* normalization_constants =
+      file->ReadArray<float>(offset, num_images);
+  const ImageStatistics* image_statistics =
+      file->ReadArray<ImageStatistics>(offset, num_images);
+
+  normalization_constants_.clear();
+  normalization_constants_.reserve(num_images);
+  image_statistics_.reserve(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    normalization_constants_[image_ids[i]] = normalization_constants[i];
+    image_statistics_[image_ids[i]] = image_statistics[i];
+    max_image_id_ = std::max(max_image_id_, image_ids[i]);
+  }
+
+  mapped_file_ = file;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::WriteMapped(
+    std::ostream* stream) const {
+  const int32_t num_words = static_cast<int32_t>(NumVisualWords());
+  CHECK_GT(num_words, 0);
+  colmap::WriteMapped(stream, num_words);
+
+  colmap::WriteMapped(stream, static_cast<int32_t>(kEmbeddingDim));
+  WriteMappedArray(stream, proj_matrix_.data(), proj_matrix_.size());
+
+  typedef typename InvertedFile<kEmbeddingDim>::MappedHeader MappedHeader;
+  std::vector<MappedHeader> headers;
+  headers.reserve(num_words);
+  for (const auto& inverted_file : inverted_files_) {
+    headers.push_back(inverted_file.GetMappedHeader());
   }
+  WriteMappedArray(stream, headers.data(), headers.size());
 
-  std::unordered_map<int, double> self_similarities(image_ids.size());
   for (const auto& inverted_file : inverted_files_) {
-    inverted_file.ComputeImageSelfSimilarities(&self_similarities);
+    inverted_file.WriteMappedEntries(stream);
   }
 
+  CHECK_EQ(normalization_constants_.size(), image_statistics_.size())
+      << "The index must be finalized before writing";
+
+  std::vector<int32_t> image_ids;
+  std::vector<float> normalization_constants;
+  std::vector<ImageStatistics> image_statistics;
+  image_ids.reserve(image_statistics_.size());
+  normalization_constants.reserve(image_statistics_.size());
+  image_statistics.reserve(image_statistics_.size());
+  for (const auto& image : image_statistics_) {
+    image_ids.push_back(image.first);
+    normalization_constants.push_back(
+        normalization_constants_.at(image.first));
+    image_statistics.push_back(image.second);
+  }
+
+  colmap::WriteMapped(stream, static_cast<uint64_t>(image_ids.size()));
+  WriteMappedArray(stream, image_ids.data(), image_ids.size());
+  WriteMappedArray(stream, normalization_constants.data(),
+                   normalization_constants.size());
+  WriteMappedArray(stream, image_statistics.data(), image_statistics.size());
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::SortInvertedFiles() {
+  for (auto& inverted_file : inverted_files_) {
+    if (inverted_file.EntriesSorted()) {
+      continue;
+    }
+
+    // The document frequency of the word changes, so replace the contributions
+    // of the previously sorted entries with the ones of all entries.
+    UpdateImageStatistics(inverted_file, -1);
+    inverted_file.SortEntries();
+    UpdateImageStatistics(inverted_file, 1);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::UpdateImageStatistics(
+    const InvertedFile<kEmbeddingDim>& inverted_file, const int sign) {
+  if (inverted_file.NumSortedEntries() == 0) {
+    return;
+  }
+
+  const double log_num_images =
+      std::log(static_cast<double>(inverted_file.NumImages()));
+  const double squared_log_num_images = log_num_images * log_num_images;
+
+  inverted_file.ForEachImage(
+      [&](const int image_id, const size_t num_image_entries) {
+        auto& image_statistics = image_statistics_[image_id];
+        const double weight = sign * static_cast<double>(num_image_entries);
+        if (sign > 0) {
+          image_statistics.num_entries += num_image_entries;
+        } else {
+          image_statistics.num_entries -= num_image_entries;
+        }
+        image_statistics.sum_log += weight * log_num_images;
+        image_statistics.sum_squared_log += weight * squared_log_num_images;
+      });
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
+    ComputeWeightsAndNormalizationConstants(
+        const std::unordered_map<int, ImageStatistics>&
+            total_image_statistics) {
+  const size_t num_images = total_image_statistics.size();
+
+  for (auto& inverted_file : inverted_files_) {
+    inverted_file.ComputeIDFWeight(num_images);
+  }
+
+  // The idf-weights of all words depend on the total number of images, but the
+  // self-similarities follow in closed form from the per-image statistics, so
+  // there is no need to iterate over the entries of all inverted files.
+  const double log_num_images = std::log(static_cast<double>(num_images));
+  const double squared_log_num_images = log_num_images * log_num_images;
+
+  // Threshold to suppress cancellation errors in the closed form, e.g., for
+  // images whose words all occur in every image of the database.
+  const double kRelativeEpsilon = 1e-12;
+
   normalization_constants_.clear();
-  normalization_constants_.reserve(image_ids.size());
-  for (const auto& self_similarity : self_similarities) {
-    if (self_similarity.second > 0.0) {
-      normalization_constants_[self_similarity.first] =
-          static_cast<float>(1.0 / std::sqrt(self_similarity.second));
+  normalization_constants_.reserve(num_images);
+  max_image_id_ = -1;
+  for (const auto& image_statistics : image_statistics_) {
+    max_image_id_ = std::max(max_image_id_, image_statistics.first);
+    const auto& stats = total_image_statistics.at(image_statistics.first);
+    const double magnitude =
+        stats.num_entries * squared_log_num_images + stats.sum_squared_log;
+    const double self_similarity =
+        magnitude - 2.0 * log_num_images * stats.sum_log;
+    if (self_similarity > kRelativeEpsilon * magnitude) {
+      normalization_constants_[image_statistics.first] =
+          static_cast<float>(1.0 / std::sqrt(self_similarity));
     } else {
-      normalization_constants_[self_similarity.first] = 0.0f;
+      normalization_constants_[image_statistics.first] = 0.0f;
     }
   }
 }
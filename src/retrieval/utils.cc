@@ -0,0 +1,62 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "retrieval/utils.h"
+
+#include <bitset>
+
+#include "util/simd.h"
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+inline uint8_t CountSetBits(const uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<uint8_t>(__builtin_popcountll(bits));
+#else
+  return static_cast<uint8_t>(std::bitset<64>(bits).count());
+#endif
+}
+
+}  // namespace
+
+COLMAP_POPCNT_CLONES void ComputeHammingDistances(const uint64_t query,
+                                                  const uint64_t* descriptors,
+                                                  const size_t num_descriptors,
+                                                  uint8_t* hamming_dists) {
+  for (size_t i = 0; i < num_descriptors; ++i) {
+    hamming_dists[i] = CountSetBits(query ^ descriptors[i]);
+  }
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -34,6 +34,8 @@
 
 #include <array>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 
 namespace colmap {
 namespace retrieval {
@@ -43,6 +45,12 @@ struct ImageScore {
   float score = 0.0f;
 };
 
+// Computes the Hamming distances between the query and each of the binary
+// signatures, each packed into a 64-bit word.
+void ComputeHammingDistances(const uint64_t query, const uint64_t* descriptors,
+                             const size_t num_descriptors,
+                             uint8_t* hamming_dists);
+
 // Implements the weighting function used to derive a voting weight from the
 // Hamming distance of two binary signatures. See Eqn. 4 in
 // Arandjelovic, Zisserman. DisLocation: Scalable descriptor distinctiveness for
@@ -32,6 +32,12 @@
 #ifndef COLMAP_SRC_RETRIEVAL_VISUAL_INDEX_H_
 #define COLMAP_SRC_RETRIEVAL_VISUAL_INDEX_H_
 
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include <boost/filesystem.hpp>
 #include <boost/heap/fibonacci_heap.hpp>
 #include <Eigen/Core>
 
@@ -43,11 +49,19 @@
 #include "util/alignment.h"
 #include "util/endian.h"
 #include "util/logging.h"
+#include "util/mapped_file.h"
 #include "util/math.h"
+#include "util/misc.h"
+#include "util/threading.h"
+#include "util/timer.h"
 
 namespace colmap {
 namespace retrieval {
 
+// The identifier and version of the memory-mapped layout of the visual index.
+const char kVisualIndexMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'V', 'I'};
+const uint32_t kVisualIndexMappedVersion = 1;
+
 // Visual index for image retrieval using a vocabulary tree with Hamming
 // embedding, based on the papers:
 //
@@ -65,6 +79,9 @@ class VisualIndex {
   typedef FeatureKeypoints GeomType;
   typedef typename InvertedIndexType::DescType DescType;
   typedef typename InvertedIndexType::EntryType EntryType;
+  typedef typename InvertedIndexType::ImageStatistics ImageStatistics;
+  typedef typename InvertedIndexType::QueryBatchBuffers QueryBatchBuffers;
+  typedef std::unordered_map<int, ImageStatistics> ImageStatisticsMap;
 
   struct IndexOptions {
     // The number of nearest neighbor visual words that each feature descriptor
@@ -74,6 +91,18 @@ class VisualIndex {
     // The number of checks in the nearest neighbor search.
     int num_checks = 256;
 
+    // Whether to assign the visual words by exhaustive instead of approximate
+    // nearest neighbor search, see FindWordIdsExhaustive.
+    bool exhaustive_quantization = false;
+
+    // The visual words can be distributed over multiple shards, e.g., to
+    // split a large database over multiple machines. A shard only stores the
+    // inverted file entries of visual words whose identifier modulo the
+    // number of shards equals the index of the shard. The options must be the
+    // same for all images added to the same index.
+    int num_shards = 1;
+    int shard_idx = 0;
+
     // The number of threads used in the index.
     int num_threads = kMaxNumThreads;
   };
@@ -89,9 +118,35 @@ class VisualIndex {
     // The number of checks in the nearest neighbor search.
     int num_checks = 256;
 
+    // Whether to assign the visual words by exhaustive instead of approximate
+    // nearest neighbor search, see FindWordIdsExhaustive.
+    bool exhaustive_quantization = false;
+
+    // The maximum number of entries of a scored inverted file. Visual words
+    // with longer inverted files occur in many images, e.g., on repetitive
+    // structures, and are skipped as stop words, since their low idf-weight
+    // contributes little to the scores at a high cost. A negative value
+    // disables the limit.
+    int max_inverted_file_size = -1;
+
+    // The maximum total number of inverted file entries scored per query
+    // image. The nearest visual words of all descriptors are scored first,
+    // followed by the second nearest visual words and so on, and the words
+    // with shorter inverted files are preferred within each rank. This bounds
+    // the cost of the multi-assignment to `num_neighbors` visual words. A
+    // negative value disables the limit.
+    int max_num_scored_entries = -1;
+
     // Whether to perform spatial verification after image retrieval.
     int num_images_after_verification = 0;
 
+    // The maximum time in seconds for the spatial verification of a query.
+    // The images are verified in the order of their retrieval rank and the
+    // remaining images keep their retrieval score once the time is exceeded,
+    // which trades verification depth for latency. A negative value disables
+    // the limit.
+    double max_verification_time = -1.0;
+
     // The number of threads used in the index.
     int num_threads = kMaxNumThreads;
   };
@@ -117,11 +172,54 @@ class VisualIndex {
     int num_threads = kMaxNumThreads;
   };
 
+  struct MiniBatchBuildOptions {
+    // The desired number of visual words. Note that the actual number of
+    // visual words might be less, if the sampler returns fewer descriptors.
+    int num_visual_words = 256 * 256;
+
+    // The number of descriptors in each mini-batch.
+    int batch_size = 100000;
+
+    // The number of mini-batches used to update the visual words.
+    int num_batches = 1000;
+
+    // The number of randomized kd-trees used to assign the descriptors of a
+    // mini-batch to their approximately nearest visual word.
+    int num_assignment_trees = 8;
+
+    // The number of descriptors used to learn the Hamming embedding.
+    int num_embedding_descriptors = 1000000;
+
+    // The target precision of the visual word search index.
+    double target_precision = 0.95;
+
+    // The number of checks in the nearest neighbor search.
+    int num_checks = 256;
+
+    // If not empty, the state of the clustering is written to this path
+    // after every checkpoint_freq mini-batches. If the file exists, the
+    // clustering resumes from the state in the file.
+    std::string checkpoint_path = "";
+    int checkpoint_freq = 10;
+
+    // The number of threads used in the index.
+    int num_threads = kMaxNumThreads;
+  };
+
+  // Returns a random sample of at most the given number of descriptors.
+  typedef std::function<DescType(const size_t num_descriptors)>
+      DescriptorSampler;
+
   VisualIndex();
   ~VisualIndex();
 
   size_t NumVisualWords() const;
 
+  // The centroids of the visual words with one row per visual word, e.g., to
+  // derive the coarse visual words of `GlobalDescriptorModel`.
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+  GetVisualWords() const;
+
   // Add image to the visual index.
   void Add(const IndexOptions& options, const int image_id,
            const GeomType& geometries, const DescType& descriptors);
@@ -138,22 +236,109 @@ class VisualIndex {
              const DescType& descriptors,
              std::vector<ImageScore>* image_scores) const;
 
+  // Query for the most similar images of a batch of query images. The result
+  // is the same as for calling Query for each image, but the inverted files
+  // are traversed only once for the whole batch. The optional buffers avoid
+  // reallocating the score arrays in repeated calls of the same thread.
+  void QueryBatch(const QueryOptions& options,
+                  const std::vector<DescType>& descriptors,
+                  std::vector<std::vector<ImageScore>>* image_scores,
+                  QueryBatchBuffers* buffers = nullptr) const;
+  void QueryBatch(const QueryOptions& options,
+                  const std::vector<GeomType>& geometries,
+                  const std::vector<DescType>& descriptors,
+                  std::vector<std::vector<ImageScore>>* image_scores,
+                  QueryBatchBuffers* buffers = nullptr) const;
+
   // Prepare the index after adding images and before querying.
   void Prepare();
 
+  // The partial image scores of a query in one shard of a sharded index.
+  struct ShardImageScores {
+    // The part of the self-similarity of the query image caused by the visual
+    // words of the shard.
+    float self_similarity = 0.0f;
+    // The unsorted scores of all images with votes in the shard.
+    std::vector<ImageScore> image_scores;
+  };
+
+  // Query and prepare one shard of an index that is sharded by visual words,
+  // see IndexOptions::num_shards. The idf-weights depend on the whole
+  // database, so each shard is prepared with the sum of the image statistics
+  // of all shards, as accumulated by AccumulateImageStatistics. The partial
+  // scores of all shards are then merged into the same scores as when
+  // querying a single index containing all visual words. Spatial
+  // verification requires all visual words of an image and is not supported.
+  const ImageStatisticsMap& GetImageStatistics() const;
+  static void AccumulateImageStatistics(
+      const ImageStatisticsMap& shard_image_statistics,
+      ImageStatisticsMap* total_image_statistics);
+  void PrepareShard(const ImageStatisticsMap& total_image_statistics);
+  void QueryShard(const QueryOptions& options, const DescType& descriptors,
+                  ShardImageScores* shard_image_scores) const;
+  static void MergeShardImageScores(
+      const QueryOptions& options,
+      const std::vector<ShardImageScores>& shard_image_scores,
+      std::vector<ImageScore>* image_scores);
+
   // Build a visual index from a set of training descriptors by quantizing the
   // descriptor space into visual words and compute their Hamming embedding.
   void Build(const BuildOptions& options, const DescType& descriptors);
 
+  // Build a visual index with mini-batch approximate k-means, where the
+  // descriptors are drawn in mini-batches from the sampler, such that the
+  // training descriptors need not fit into memory. In contrast to Build, the
+  // visual words are obtained from a flat instead of a hierarchical
+  // clustering. Each descriptor of a mini-batch moves its approximately
+  // nearest visual word towards it with a per-word learning rate of one over
+  // the number of descriptors assigned to the word so far, based on the
+  // papers:
+  //
+  //    Philbin, Chum, Isard, Sivic, Zisserman. "Object retrieval with large
+  //    vocabularies and fast spatial matching". CVPR 2007.
+  //
+  //    Sculley. "Web-scale k-means clustering". WWW 2010.
+  void BuildMiniBatch(const MiniBatchBuildOptions& options,
+                      const DescriptorSampler& sampler);
+
   // Read and write the visual index. This can be done for an index with and
-  // without indexed images.
+  // without indexed images. Read detects whether the file was written in the
+  // memory-mapped layout.
   void Read(const std::string& path);
   void Write(const std::string& path);
 
+  // Write the visual index in a layout that Read maps into memory instead of
+  // deserializing it. Only the search structure on the visual words is still
+  // deserialized, while the visual words and inverted file entries are loaded
+  // on first access and shared through the page cache by all processes that
+  // read the same file. The layout is in native byte order. The file is first
+  // written to a temporary path and then renamed, so that processes which
+  // mapped a previous version of the file are not affected.
+  void WriteMapped(const std::string& path);
+
  private:
+  // Read a visual index in the memory-mapped layout.
+  void ReadMapped(const std::string& path);
+
+  // Free the visual words, unless they are referenced in a mapped file.
+  void ReleaseVisualWords();
+
   // Quantize the descriptor space into visual words.
   void Quantize(const BuildOptions& options, const DescType& descriptors);
 
+  // Quantize the descriptor space into visual words with mini-batch k-means.
+  void QuantizeMiniBatch(const MiniBatchBuildOptions& options,
+                         const DescriptorSampler& sampler);
+
+  // Replace the visual words with the given cluster centers.
+  template <typename CenterType>
+  void SetVisualWords(const CenterType* centers_data, const size_t num_centers);
+
+  // Build the search index on the visual words and learn the Hamming
+  // embedding from the given descriptors.
+  void IndexVisualWords(const double target_precision, const int num_checks,
+                        const int num_threads, const DescType& descriptors);
+
   // Query for nearest neighbor images and return nearest neighbor visual word
   // identifiers for each descriptor.
   void QueryAndFindWordIds(const QueryOptions& options,
@@ -161,11 +346,37 @@ class VisualIndex {
                            std::vector<ImageScore>* image_scores,
                            Eigen::MatrixXi* word_ids) const;
 
+  // Invalidate the visual word assignments of the query descriptors that
+  // exceed the limits of the query cost in the options.
+  void LimitWordAssignments(const QueryOptions& options,
+                            Eigen::MatrixXi* word_ids) const;
+
+  // Sort the image scores in descending order and only keep the most similar
+  // images according to the maximum number of images in the options.
+  static void SortImageScores(const QueryOptions& options,
+                              std::vector<ImageScore>* image_scores);
+
+  // Re-rank the retrieved images using spatial verification.
+  void VerifyImageScores(const QueryOptions& options,
+                         const GeomType& geometries,
+                         const DescType& descriptors,
+                         const Eigen::MatrixXi& word_ids,
+                         std::vector<ImageScore>* image_scores) const;
+
   // Find the nearest neighbor visual words for the given descriptors.
   Eigen::MatrixXi FindWordIds(const DescType& descriptors,
                               const int num_neighbors, const int num_checks,
+                              const bool exhaustive,
                               const int num_threads) const;
 
+  // Find the exact nearest neighbor visual words by comparing against all
+  // visual words. Blocks of descriptors and visual words are compared with a
+  // dense matrix product, so the cost is proportional to the product of the
+  // number of descriptors and visual words but with high arithmetic intensity.
+  Eigen::MatrixXi FindWordIdsExhaustive(const DescType& descriptors,
+                                        const int num_neighbors,
+                                        const int num_threads) const;
+
   // The search structure on the quantized descriptor space.
   flann::AutotunedIndex<flann::L2<kDescType>> visual_word_index_;
 
@@ -180,6 +391,9 @@ class VisualIndex {
 
   // Whether the index is prepared.
   bool prepared_;
+
+  // The memory-mapped file referenced by the visual words, if any.
+  std::shared_ptr<const MappedFile> mapped_file_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -192,9 +406,7 @@ VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualIndex()
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 VisualIndex<kDescType, kDescDim, kEmbeddingDim>::~VisualIndex() {
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -202,11 +414,23 @@ size_t VisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumVisualWords() const {
   return visual_words_.rows;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::GetVisualWords() const {
+  return Eigen::Map<const Eigen::Matrix<kDescType, Eigen::Dynamic,
+                                        Eigen::Dynamic, Eigen::RowMajor>>(
+             visual_words_.ptr(), visual_words_.rows, visual_words_.cols)
+      .template cast<float>();
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
     const IndexOptions& options, const int image_id, const GeomType& geometries,
     const DescType& descriptors) {
   CHECK_EQ(geometries.size(), descriptors.rows());
+  CHECK_GT(options.num_shards, 0);
+  CHECK_GE(options.shard_idx, 0);
+  CHECK_LT(options.shard_idx, options.num_shards);
 
   // If the image is already indexed, do nothing.
   if (ImageIndexed(image_id)) {
@@ -223,7 +447,7 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
 
   const Eigen::MatrixXi word_ids =
       FindWordIds(descriptors, options.num_neighbors, options.num_checks,
-                  options.num_threads);
+                  options.exhaustive_quantization, options.num_threads);
 
   for (typename DescType::Index i = 0; i < descriptors.rows(); ++i) {
     const auto& descriptor = descriptors.row(i);
@@ -236,7 +460,8 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
 
     for (int n = 0; n < options.num_neighbors; ++n) {
       const int word_id = word_ids(i, n);
-      if (word_id != InvertedIndexType::kInvalidWordId) {
+      if (word_id != InvertedIndexType::kInvalidWordId &&
+          word_id % options.num_shards == options.shard_idx) {
         inverted_index_.AddEntry(image_id, word_id, i, descriptor, geometry);
       }
     }
@@ -268,8 +493,61 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     return;
   }
 
+  VerifyImageScores(options, geometries, descriptors, word_ids, image_scores);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryBatch(
+    const QueryOptions& options, const std::vector<DescType>& descriptors,
+    std::vector<std::vector<ImageScore>>* image_scores,
+    QueryBatchBuffers* buffers) const {
+  const std::vector<GeomType> geometries(descriptors.size());
+  QueryBatch(options, geometries, descriptors, image_scores, buffers);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryBatch(
+    const QueryOptions& options, const std::vector<GeomType>& geometries,
+    const std::vector<DescType>& descriptors,
+    std::vector<std::vector<ImageScore>>* image_scores,
+    QueryBatchBuffers* buffers) const {
+  CHECK(prepared_);
+  CHECK_EQ(geometries.size(), descriptors.size());
+
+  std::vector<Eigen::MatrixXi> word_ids(descriptors.size());
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    if (descriptors[i].rows() > 0) {
+      word_ids[i] = FindWordIds(descriptors[i], options.num_neighbors,
+                                options.num_checks,
+                                options.exhaustive_quantization,
+                                options.num_threads);
+      LimitWordAssignments(options, &word_ids[i]);
+    } else {
+      word_ids[i].resize(0, options.num_neighbors);
+    }
+  }
+
+  inverted_index_.QueryBatch(descriptors, word_ids, image_scores, buffers);
+
+  for (size_t i = 0; i < descriptors.size(); ++i) {
+    SortImageScores(options, &(*image_scores)[i]);
+    if (options.num_images_after_verification > 0) {
+      VerifyImageScores(options, geometries[i], descriptors[i], word_ids[i],
+                        &(*image_scores)[i]);
+    }
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VerifyImageScores(
+    const QueryOptions& options, const GeomType& geometries,
+    const DescType& descriptors, const Eigen::MatrixXi& word_ids,
+    std::vector<ImageScore>* image_scores) const {
   CHECK_EQ(descriptors.rows(), geometries.size());
 
+  Timer timer;
+  timer.Start();
+
   // Extract top-ranked images to verify.
   std::unordered_set<int> image_ids;
   for (const auto& image_score : *image_scores) {
@@ -288,7 +566,11 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
   std::unordered_map<int, std::unordered_map<int, OrderedMatchListType>>
       db_to_query_matches;
 
-  std::vector<const EntryType*> word_matches;
+  std::vector<EntryType> word_matches;
+
+  // The database entries referenced by the matches. The inverted files do not
+  // store their entries as records, so the matched entries are copied here.
+  std::deque<EntryType> db_entries;
 
   std::vector<EntryType> query_entries;  // Convert query features, too.
   query_entries.reserve(descriptors.rows());
@@ -327,18 +609,20 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
         for (const auto& match : word_matches) {
           const size_t hamming_dist =
-              (query_entries[i].descriptor ^ match->descriptor).count();
+              (query_entries[i].descriptor ^ match.descriptor).count();
 
           if (hamming_dist <= hamming_dist_weight_functor.kMaxHammingDistance) {
             const float dist =
                 hamming_dist_weight_functor(hamming_dist) * squared_idf_weight;
 
-            auto& feature_matches = image_matches[match->image_id];
-            const auto feature_match = feature_matches.find(match->feature_idx);
+            auto& feature_matches = image_matches[match.image_id];
+            const auto feature_match = feature_matches.find(match.feature_idx);
 
             if (feature_match == feature_matches.end() ||
                 feature_match->first < dist) {
-              feature_matches[match->feature_idx] = std::make_pair(dist, match);
+              db_entries.push_back(match);
+              feature_matches[match.feature_idx] =
+                  std::make_pair(dist, &db_entries.back());
             }
           }
         }
@@ -363,21 +647,48 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     }
   }
 
-  // Verify top-ranked images using the found matches.
-  for (auto& image_score : *image_scores) {
-    auto& query_matches = query_to_db_matches[image_score.image_id];
-    auto& db_matches = db_to_query_matches[image_score.image_id];
+  // Verify top-ranked images using the found matches. The images are verified
+  // concurrently in the order of their retrieval rank, such that only the
+  // lowest ranked images remain unverified once the time budget is exceeded.
+  // Each thread reuses the same scratch memory for all its images.
+  const auto VerifyImage = [&](ImageScore* image_score,
+                               VoteAndVerifyBuffers* buffers) {
+    if (options.max_verification_time >= 0 &&
+        timer.ElapsedSeconds() >= options.max_verification_time) {
+      return;
+    }
 
     // No matches found.
-    if (query_matches.empty()) {
-      continue;
+    const auto query_matches_it =
+        query_to_db_matches.find(image_score->image_id);
+    if (query_matches_it == query_to_db_matches.end()) {
+      return;
     }
 
+    auto& query_matches = query_matches_it->second;
+    auto& db_matches = db_to_query_matches.at(image_score->image_id);
+
     // Enforce 1-to-1 matching: Build Fibonacci heaps for the query and database
     // features, ordered by the minimum number of matches per feature. We'll
     // select these matches one at a time. For convenience, we'll also pre-sort
     // the matched feature lists by matching score.
 
+    // Sort by descending score and break ties by the feature indices instead of
+    // the addresses of the entries, such that the result is deterministic.
+    const auto SortMatchFunc =
+        [](const typename OrderedMatchListType::value_type& match1,
+           const typename OrderedMatchListType::value_type& match2) {
+          if (match1.first != match2.first) {
+            return match1.first > match2.first;
+          }
+          const auto& entries1 = match1.second;
+          const auto& entries2 = match2.second;
+          if (entries1.first->feature_idx != entries2.first->feature_idx) {
+            return entries1.first->feature_idx < entries2.first->feature_idx;
+          }
+          return entries1.second->feature_idx < entries2.second->feature_idx;
+        };
+
     typedef boost::heap::fibonacci_heap<std::pair<int, int>> FibonacciHeapType;
     FibonacciHeapType query_heap;
     FibonacciHeapType db_heap;
@@ -388,8 +699,7 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
     for (auto& match_data : query_matches) {
       std::sort(match_data.second.begin(), match_data.second.end(),
-                std::greater<std::pair<
-                    float, std::pair<const EntryType*, const EntryType*>>>());
+                SortMatchFunc);
 
       query_heap_handles[match_data.first] = query_heap.push(std::make_pair(
           -static_cast<int>(match_data.second.size()), match_data.first));
@@ -397,8 +707,7 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
     for (auto& match_data : db_matches) {
       std::sort(match_data.second.begin(), match_data.second.end(),
-                std::greater<std::pair<
-                    float, std::pair<const EntryType*, const EntryType*>>>());
+                SortMatchFunc);
 
       db_heap_handles[match_data.first] = db_heap.push(std::make_pair(
           -static_cast<int>(match_data.second.size()), match_data.first));
@@ -480,7 +789,28 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
 
     // Finally, run verification for the current image.
     VoteAndVerifyOptions vote_and_verify_options;
-    image_score.score += VoteAndVerify(vote_and_verify_options, matches);
+    image_score->score +=
+        VoteAndVerify(vote_and_verify_options, matches, buffers);
+  };
+
+  const int num_eff_threads = std::max(
+      1, std::min(GetEffectiveNumThreads(options.num_threads),
+                  static_cast<int>(image_scores->size())));
+  std::vector<VoteAndVerifyBuffers> buffers(num_eff_threads);
+  if (num_eff_threads == 1) {
+    for (auto& image_score : *image_scores) {
+      VerifyImage(&image_score, &buffers[0]);
+    }
+  } else {
+    ThreadPool thread_pool(num_eff_threads);
+    for (auto& image_score : *image_scores) {
+      thread_pool.AddTask(
+          [&](ImageScore* image_score) {
+            VerifyImage(image_score, &buffers[thread_pool.GetThreadIndex()]);
+          },
+          &image_score);
+    }
+    thread_pool.Wait();
   }
 
   // Re-rank the images using the spatial verification scores.
@@ -507,16 +837,115 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare() {
   prepared_ = true;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+const typename VisualIndex<kDescType, kDescDim,
+                           kEmbeddingDim>::ImageStatisticsMap&
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::GetImageStatistics() const {
+  return inverted_index_.GetImageStatistics();
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::AccumulateImageStatistics(
+    const ImageStatisticsMap& shard_image_statistics,
+    ImageStatisticsMap* total_image_statistics) {
+  for (const auto& image_statistics : shard_image_statistics) {
+    ImageStatistics& total_stats =
+        (*total_image_statistics)[image_statistics.first];
+    total_stats.num_entries += image_statistics.second.num_entries;
+    total_stats.sum_log += image_statistics.second.sum_log;
+    total_stats.sum_squared_log += image_statistics.second.sum_squared_log;
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::PrepareShard(
+    const ImageStatisticsMap& total_image_statistics) {
+  inverted_index_.FinalizeShard(total_image_statistics);
+  prepared_ = true;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryShard(
+    const QueryOptions& options, const DescType& descriptors,
+    ShardImageScores* shard_image_scores) const {
+  CHECK(prepared_);
+
+  shard_image_scores->self_similarity = 0.0f;
+  shard_image_scores->image_scores.clear();
+
+  if (descriptors.rows() == 0) {
+    return;
+  }
+
+  Eigen::MatrixXi word_ids =
+      FindWordIds(descriptors, options.num_neighbors, options.num_checks,
+                  options.exhaustive_quantization, options.num_threads);
+  LimitWordAssignments(options, &word_ids);
+  inverted_index_.QueryShard(descriptors, word_ids,
+                             &shard_image_scores->image_scores,
+                             &shard_image_scores->self_similarity);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::MergeShardImageScores(
+    const QueryOptions& options,
+    const std::vector<ShardImageScores>& shard_image_scores,
+    std::vector<ImageScore>* image_scores) {
+  image_scores->clear();
+
+  float self_similarity = 0.0f;
+  std::unordered_map<int, size_t> score_idxs;
+  for (const auto& shard_scores : shard_image_scores) {
+    self_similarity += shard_scores.self_similarity;
+    for (const auto& shard_score : shard_scores.image_scores) {
+      const auto score_idx =
+          score_idxs.emplace(shard_score.image_id, image_scores->size());
+      if (score_idx.second) {
+        image_scores->push_back(shard_score);
+      } else {
+        (*image_scores)[score_idx.first->second].score += shard_score.score;
+      }
+    }
+  }
+
+  if (self_similarity > 0.0f) {
+    const float normalization_weight = 1.0f / std::sqrt(self_similarity);
+    for (auto& image_score : *image_scores) {
+      image_score.score *= normalization_weight;
+    }
+  }
+
+  SortImageScores(options, image_scores);
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
     const BuildOptions& options, const DescType& descriptors) {
   // Quantize the descriptor space into visual words.
   Quantize(options, descriptors);
 
+  IndexVisualWords(options.target_precision, options.num_checks,
+                   options.num_threads, descriptors);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::BuildMiniBatch(
+    const MiniBatchBuildOptions& options, const DescriptorSampler& sampler) {
+  // Quantize the descriptor space into visual words.
+  QuantizeMiniBatch(options, sampler);
+
+  const DescType descriptors = sampler(options.num_embedding_descriptors);
+  IndexVisualWords(options.target_precision, options.num_checks,
+                   options.num_threads, descriptors);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::IndexVisualWords(
+    const double target_precision, const int num_checks, const int num_threads,
+    const DescType& descriptors) {
   // Build the search index on the visual words.
   flann::AutotunedIndexParams index_params;
-  index_params["target_precision"] =
-      static_cast<float>(options.target_precision);
+  index_params["target_precision"] = static_cast<float>(target_precision);
   visual_word_index_ =
       flann::AutotunedIndex<flann::L2<kDescType>>(index_params);
   visual_word_index_.buildIndex(visual_words_);
@@ -530,22 +959,33 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
 
   // Learn the Hamming embedding.
   const int kNumNeighbors = 1;
+  const bool kExhaustive = false;
   const Eigen::MatrixXi word_ids = FindWordIds(
-      descriptors, kNumNeighbors, options.num_checks, options.num_threads);
+      descriptors, kNumNeighbors, num_checks, kExhaustive, num_threads);
   inverted_index_.ComputeHammingEmbedding(descriptors, word_ids);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
     const std::string& path) {
+  {
+    std::ifstream file(path, std::ios::binary);
+    CHECK(file.is_open()) << path;
+    char magic[sizeof(kVisualIndexMagic)] = {0};
+    file.read(magic, sizeof(magic));
+    if (file && std::memcmp(magic, kVisualIndexMagic, sizeof(magic)) == 0) {
+      file.close();
+      ReadMapped(path);
+      return;
+    }
+  }
+
   long int file_offset = 0;
 
   // Read the visual words.
 
   {
-    if (visual_words_.ptr() != nullptr) {
-      delete[] visual_words_.ptr();
-    }
+    ReleaseVisualWords();
 
     std::ifstream file(path, std::ios::binary);
     CHECK(file.is_open()) << path;
@@ -620,6 +1060,112 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Write(
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::WriteMapped(
+    const std::string& path) {
+  CHECK_NOTNULL(visual_words_.ptr());
+
+  const std::string temp_path = path + ".tmp";
+
+  // Write the header and the visual words.
+
+  {
+    std::ofstream file(temp_path, std::ios::binary);
+    CHECK(file.is_open()) << temp_path;
+    file.write(kVisualIndexMagic, sizeof(kVisualIndexMagic));
+    colmap::WriteMapped(&file, kVisualIndexMappedVersion);
+    colmap::WriteMapped(&file, static_cast<uint32_t>(sizeof(kDescType)));
+    colmap::WriteMapped(&file, static_cast<uint32_t>(kDescDim));
+    colmap::WriteMapped(&file, static_cast<uint32_t>(kEmbeddingDim));
+    colmap::WriteMapped(&file, static_cast<uint64_t>(visual_words_.rows));
+    colmap::WriteMapped(&file, static_cast<uint64_t>(visual_words_.cols));
+    WriteMappedArray(&file, visual_words_.ptr(),
+                     visual_words_.rows * visual_words_.cols);
+  }
+
+  // Write the visual words search index.
+
+  {
+    FILE* fout = fopen(temp_path.c_str(), "ab");
+    CHECK_NOTNULL(fout);
+    visual_word_index_.saveIndex(fout);
+    fclose(fout);
+  }
+
+  // Write the inverted index. The stream is positioned at the end of the file
+  // explicitly, so that the alignment is computed relative to its beginning.
+
+  {
+    std::fstream file(temp_path,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    CHECK(file.is_open()) << temp_path;
+    file.seekp(0, std::ios::end);
+    inverted_index_.WriteMapped(&file);
+    CHECK(file.good()) << temp_path;
+  }
+
+  boost::filesystem::rename(temp_path, path);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ReadMapped(
+    const std::string& path) {
+  ReleaseVisualWords();
+
+  std::shared_ptr<const MappedFile> mapped_file =
+      std::make_shared<MappedFile>(path);
+
+  size_t offset = sizeof(kVisualIndexMagic);
+  CHECK_EQ(mapped_file->Read<uint32_t>(&offset), kVisualIndexMappedVersion)
+      << "Incompatible index file " << path;
+  CHECK_EQ(mapped_file->Read<uint32_t>(&offset), sizeof(kDescType))
+      << "Incompatible descriptor type in " << path;
+  CHECK_EQ(mapped_file->Read<uint32_t>(&offset), kDescDim)
+      << "Incompatible descriptor dimension in " << path;
+  CHECK_EQ(mapped_file->Read<uint32_t>(&offset), kEmbeddingDim)
+      << "Incompatible embedding dimension in " << path;
+
+  // Reference the visual words in the mapped file.
+
+  const uint64_t rows = mapped_file->Read<uint64_t>(&offset);
+  const uint64_t cols = mapped_file->Read<uint64_t>(&offset);
+  const kDescType* visual_words_data =
+      mapped_file->ReadArray<kDescType>(&offset, rows * cols);
+  visual_words_ = flann::Matrix<kDescType>(
+      const_cast<kDescType*>(visual_words_data), rows, cols);
+  mapped_file_ = mapped_file;
+
+  // Read the visual words search index.
+
+  visual_word_index_ =
+      flann::AutotunedIndex<flann::L2<kDescType>>(visual_words_);
+
+  {
+    FILE* fin = fopen(path.c_str(), "rb");
+    CHECK_NOTNULL(fin);
+    fseek(fin, offset, SEEK_SET);
+    visual_word_index_.loadIndex(fin);
+    offset = ftell(fin);
+    fclose(fin);
+  }
+
+  // Reference the inverted index in the mapped file.
+
+  inverted_index_.ReadMapped(mapped_file, &offset);
+
+  image_ids_.clear();
+  inverted_index_.GetImageIds(&image_ids_);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ReleaseVisualWords() {
+  if (visual_words_.ptr() != nullptr && !mapped_file_) {
+    delete[] visual_words_.ptr();
+  }
+  visual_words_ = flann::Matrix<kDescType>();
+  mapped_file_.reset();
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     const BuildOptions& options, const DescType& descriptors) {
@@ -646,7 +1192,120 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
 
   CHECK_LE(num_centers, options.num_visual_words);
 
-  const size_t visual_word_data_size = num_centers * descriptors.cols();
+  SetVisualWords(centers_data.data(), num_centers);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QuantizeMiniBatch(
+    const MiniBatchBuildOptions& options, const DescriptorSampler& sampler) {
+  CHECK_GT(options.num_visual_words, 0);
+  CHECK_GT(options.batch_size, 0);
+  CHECK_GE(options.num_batches, 0);
+  CHECK_GT(options.num_assignment_trees, 0);
+  CHECK_GT(options.checkpoint_freq, 0);
+
+  typedef Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>
+      CentersType;
+
+  CentersType centers;
+  std::vector<uint64_t> center_counts;
+  size_t num_batches = 0;
+
+  if (!options.checkpoint_path.empty() &&
+      ExistsFile(options.checkpoint_path)) {
+    std::ifstream file(options.checkpoint_path, std::ios::binary);
+    CHECK(file.is_open()) << options.checkpoint_path;
+    const uint64_t num_centers = ReadBinaryLittleEndian<uint64_t>(&file);
+    const uint64_t num_dims = ReadBinaryLittleEndian<uint64_t>(&file);
+    CHECK_EQ(num_dims, kDescDim) << options.checkpoint_path;
+    num_batches = ReadBinaryLittleEndian<uint64_t>(&file);
+    center_counts.resize(num_centers);
+    ReadBinaryLittleEndian<uint64_t>(&file, &center_counts);
+    centers.resize(num_centers, kDescDim);
+    for (Eigen::Index i = 0; i < centers.size(); ++i) {
+      centers.data()[i] = ReadBinaryLittleEndian<float>(&file);
+    }
+  } else {
+    // Initialize the visual words with randomly sampled descriptors.
+    centers = sampler(options.num_visual_words).template cast<float>();
+    CHECK_GT(centers.rows(), 0);
+    CHECK_LE(centers.rows(), options.num_visual_words);
+    center_counts.resize(centers.rows(), 0);
+  }
+
+  const auto WriteCheckpoint = [&]() {
+    const std::string temp_path = options.checkpoint_path + ".tmp";
+    {
+      std::ofstream file(temp_path, std::ios::binary);
+      CHECK(file.is_open()) << temp_path;
+      WriteBinaryLittleEndian<uint64_t>(&file, centers.rows());
+      WriteBinaryLittleEndian<uint64_t>(&file, centers.cols());
+      WriteBinaryLittleEndian<uint64_t>(&file, num_batches);
+      WriteBinaryLittleEndian<uint64_t>(&file, center_counts);
+      for (Eigen::Index i = 0; i < centers.size(); ++i) {
+        WriteBinaryLittleEndian<float>(&file, centers.data()[i]);
+      }
+    }
+    boost::filesystem::rename(temp_path, options.checkpoint_path);
+  };
+
+  flann::SearchParams search_params(options.num_checks);
+  search_params.cores = GetEffectiveNumThreads(options.num_threads);
+
+  std::vector<size_t> batch_center_idxs;
+  std::vector<float> batch_distances;
+
+  while (num_batches < static_cast<size_t>(options.num_batches)) {
+    const CentersType batch =
+        sampler(options.batch_size).template cast<float>();
+    if (batch.rows() == 0) {
+      break;
+    }
+
+    // Assign all descriptors of the mini-batch to their nearest visual word
+    // before updating the visual words.
+    {
+      const flann::Matrix<float> centers_matrix(centers.data(), centers.rows(),
+                                                centers.cols());
+      flann::Index<flann::L2<float>> centers_index(
+          centers_matrix,
+          flann::KDTreeIndexParams(options.num_assignment_trees));
+      centers_index.buildIndex();
+
+      batch_center_idxs.resize(batch.rows());
+      batch_distances.resize(batch.rows());
+      flann::Matrix<size_t> indices(batch_center_idxs.data(), batch.rows(), 1);
+      flann::Matrix<float> distances(batch_distances.data(), batch.rows(), 1);
+      const flann::Matrix<float> query(const_cast<float*>(batch.data()),
+                                       batch.rows(), batch.cols());
+      centers_index.knnSearch(query, indices, distances, 1, search_params);
+    }
+
+    for (Eigen::Index i = 0; i < batch.rows(); ++i) {
+      const size_t center_idx = batch_center_idxs[i];
+      center_counts[center_idx] += 1;
+      const float learning_rate = 1.0f / center_counts[center_idx];
+      centers.row(center_idx) +=
+          learning_rate * (batch.row(i) - centers.row(center_idx));
+    }
+
+    num_batches += 1;
+
+    if (!options.checkpoint_path.empty() &&
+        (num_batches % options.checkpoint_freq == 0 ||
+         num_batches == static_cast<size_t>(options.num_batches))) {
+      WriteCheckpoint();
+    }
+  }
+
+  SetVisualWords(centers.data(), centers.rows());
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+template <typename CenterType>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::SetVisualWords(
+    const CenterType* centers_data, const size_t num_centers) {
+  const size_t visual_word_data_size = num_centers * kDescDim;
   kDescType* visual_words_data = new kDescType[visual_word_data_size];
   for (size_t i = 0; i < visual_word_data_size; ++i) {
     if (std::is_integral<kDescType>::value) {
@@ -656,12 +1315,10 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     }
   }
 
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 
-  visual_words_ = flann::Matrix<kDescType>(visual_words_data, num_centers,
-                                           descriptors.cols());
+  visual_words_ =
+      flann::Matrix<kDescType>(visual_words_data, num_centers, kDescDim);
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -676,9 +1333,66 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryAndFindWordIds(
   }
 
   *word_ids = FindWordIds(descriptors, options.num_neighbors,
-                          options.num_checks, options.num_threads);
+                          options.num_checks, options.exhaustive_quantization,
+                          options.num_threads);
+  LimitWordAssignments(options, word_ids);
   inverted_index_.Query(descriptors, *word_ids, image_scores);
 
+  SortImageScores(options, image_scores);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::LimitWordAssignments(
+    const QueryOptions& options, Eigen::MatrixXi* word_ids) const {
+  if (options.max_inverted_file_size < 0 &&
+      options.max_num_scored_entries < 0) {
+    return;
+  }
+
+  // The assignments of the current rank with the sizes of their inverted
+  // files and the indices of their descriptors.
+  std::vector<std::pair<size_t, Eigen::Index>> assignments;
+  assignments.reserve(word_ids->rows());
+
+  size_t num_scored_entries = 0;
+  bool budget_exhausted = false;
+  for (Eigen::Index n = 0; n < word_ids->cols(); ++n) {
+    assignments.clear();
+    for (Eigen::Index i = 0; i < word_ids->rows(); ++i) {
+      int& word_id = (*word_ids)(i, n);
+      if (word_id == InvertedIndexType::kInvalidWordId) {
+        continue;
+      }
+      const size_t num_entries = inverted_index_.NumEntries(word_id);
+      if (options.max_inverted_file_size >= 0 &&
+          num_entries > static_cast<size_t>(options.max_inverted_file_size)) {
+        word_id = InvertedIndexType::kInvalidWordId;
+      } else {
+        assignments.emplace_back(num_entries, i);
+      }
+    }
+
+    if (options.max_num_scored_entries < 0) {
+      continue;
+    }
+
+    std::sort(assignments.begin(), assignments.end());
+    for (const auto& assignment : assignments) {
+      if (!budget_exhausted &&
+          num_scored_entries + assignment.first <=
+              static_cast<size_t>(options.max_num_scored_entries)) {
+        num_scored_entries += assignment.first;
+      } else {
+        budget_exhausted = true;
+        (*word_ids)(assignment.second, n) = InvertedIndexType::kInvalidWordId;
+      }
+    }
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::SortImageScores(
+    const QueryOptions& options, std::vector<ImageScore>* image_scores) {
   auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
     return score1.score > score2.score;
   };
@@ -700,12 +1414,16 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryAndFindWordIds(
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 Eigen::MatrixXi VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIds(
     const DescType& descriptors, const int num_neighbors, const int num_checks,
-    const int num_threads) const {
+    const bool exhaustive, const int num_threads) const {
   static_assert(DescType::IsRowMajor, "Descriptors must be row-major");
 
   CHECK_GT(descriptors.rows(), 0);
   CHECK_GT(num_neighbors, 0);
 
+  if (exhaustive) {
+    return FindWordIdsExhaustive(descriptors, num_neighbors, num_threads);
+  }
+
   Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
       word_ids(descriptors.rows(), num_neighbors);
   word_ids.setConstant(InvertedIndexType::kInvalidWordId);
@@ -738,6 +1456,89 @@ Eigen::MatrixXi VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIds(
   return word_ids.cast<int>();
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+Eigen::MatrixXi
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIdsExhaustive(
+    const DescType& descriptors, const int num_neighbors,
+    const int num_threads) const {
+  typedef Eigen::Matrix<float, Eigen::Dynamic, kDescDim, Eigen::RowMajor>
+      FloatDescType;
+
+  CHECK_NOTNULL(visual_words_.ptr());
+  CHECK_EQ(visual_words_.cols, kDescDim);
+
+  const Eigen::Index num_descriptors = descriptors.rows();
+  const Eigen::Index num_words = static_cast<Eigen::Index>(visual_words_.rows);
+  const Eigen::Map<const DescType> visual_words(visual_words_.ptr(), num_words,
+                                                kDescDim);
+
+  Eigen::MatrixXi word_ids(num_descriptors, num_neighbors);
+  word_ids.setConstant(InvertedIndexType::kInvalidWordId);
+
+  // The block sizes are chosen such that the distance matrix of a block fits
+  // into the cache of a single core.
+  const Eigen::Index kDescBlockSize = 256;
+  const Eigen::Index kWordBlockSize = 1024;
+
+  auto FindWordIdsBlock = [&](const Eigen::Index block_begin) {
+    const Eigen::Index block_size =
+        std::min(kDescBlockSize, num_descriptors - block_begin);
+    const FloatDescType query =
+        descriptors.middleRows(block_begin, block_size).template cast<float>();
+
+    // The squared distances of the nearest visual words in ascending order.
+    // The squared norm of the query descriptor is omitted, since it is
+    // constant for all visual words.
+    Eigen::MatrixXf nearest_dists(block_size, num_neighbors);
+    nearest_dists.setConstant(std::numeric_limits<float>::max());
+
+    FloatDescType words;
+    Eigen::MatrixXf dists;
+    for (Eigen::Index word_begin = 0; word_begin < num_words;
+         word_begin += kWordBlockSize) {
+      const Eigen::Index num_block_words =
+          std::min(kWordBlockSize, num_words - word_begin);
+      words = visual_words.middleRows(word_begin, num_block_words)
+                  .template cast<float>();
+      dists.noalias() = -2.0f * query * words.transpose();
+      dists.rowwise() += words.rowwise().squaredNorm().transpose();
+
+      for (Eigen::Index i = 0; i < block_size; ++i) {
+        const Eigen::Index desc_idx = block_begin + i;
+        for (Eigen::Index j = 0; j < num_block_words; ++j) {
+          const float dist = dists(i, j);
+          if (dist >= nearest_dists(i, num_neighbors - 1)) {
+            continue;
+          }
+          // Insert the visual word into the sorted list of nearest neighbors.
+          int k = num_neighbors - 1;
+          for (; k > 0 && nearest_dists(i, k - 1) > dist; --k) {
+            nearest_dists(i, k) = nearest_dists(i, k - 1);
+            word_ids(desc_idx, k) = word_ids(desc_idx, k - 1);
+          }
+          nearest_dists(i, k) = dist;
+          word_ids(desc_idx, k) = static_cast<int>(word_begin + j);
+        }
+      }
+    }
+  };
+
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  if (num_eff_threads == 1 || num_descriptors <= kDescBlockSize) {
+    for (Eigen::Index i = 0; i < num_descriptors; i += kDescBlockSize) {
+      FindWordIdsBlock(i);
+    }
+  } else {
+    ThreadPool thread_pool(num_eff_threads);
+    for (Eigen::Index i = 0; i < num_descriptors; i += kDescBlockSize) {
+      thread_pool.AddTask(FindWordIdsBlock, i);
+    }
+    thread_pool.Wait();
+  }
+
+  return word_ids;
+}
+
 }  // namespace retrieval
 }  // namespace colmap
 
@@ -32,6 +32,8 @@
 #define TEST_NAME "retrieval/visual_index"
 #include "util/testing.h"
 
+#include <boost/filesystem.hpp>
+
 #include "retrieval/visual_index.h"
 
 using namespace colmap;
@@ -58,6 +60,8 @@ void TestVocabTreeType() {
     build_options.branching = 5;
     visual_index.Build(build_options, descriptors);
     BOOST_CHECK_EQUAL(visual_index.NumVisualWords(), 5);
+    BOOST_CHECK_EQUAL(visual_index.GetVisualWords().rows(), 5);
+    BOOST_CHECK_EQUAL(visual_index.GetVisualWords().cols(), kDescDim);
   }
 
   {
@@ -104,6 +108,642 @@ void TestVocabTreeType() {
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestIncrementalPrepareType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 4;
+  const int kNumFeatures = 50;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+  }
+
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+
+  VisualIndexType full_visual_index;
+  full_visual_index.Build(build_options, descriptors);
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("visual_index_%%%%-%%%%-%%%%"))
+          .string();
+  full_visual_index.Write(path);
+  for (int i = 0; i < kNumImages; ++i) {
+    full_visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+  full_visual_index.Prepare();
+
+  // Index the first images, persist the index, and then append the others.
+  VisualIndexType incremental_visual_index;
+  incremental_visual_index.Read(path);
+  for (int i = 0; i < kNumImages / 2; ++i) {
+    incremental_visual_index.Add(index_options, i, keypoints,
+                                 image_descriptors[i]);
+  }
+  incremental_visual_index.Prepare();
+  incremental_visual_index.Write(path);
+  incremental_visual_index.Read(path);
+  for (int i = 0; i < kNumImages; ++i) {
+    BOOST_CHECK_EQUAL(incremental_visual_index.ImageIndexed(i),
+                      i < kNumImages / 2);
+  }
+  for (int i = kNumImages / 2; i < kNumImages; ++i) {
+    incremental_visual_index.Add(index_options, i, keypoints,
+                                 image_descriptors[i]);
+  }
+  incremental_visual_index.Prepare();
+
+  typename VisualIndexType::QueryOptions query_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> full_image_scores;
+    full_visual_index.Query(query_options, image_descriptors[i],
+                            &full_image_scores);
+    std::vector<ImageScore> incremental_image_scores;
+    incremental_visual_index.Query(query_options, image_descriptors[i],
+                                   &incremental_image_scores);
+    BOOST_CHECK_EQUAL(full_image_scores.size(),
+                      incremental_image_scores.size());
+    BOOST_CHECK_EQUAL(full_image_scores[0].image_id, i);
+    for (size_t j = 0; j < full_image_scores.size(); ++j) {
+      BOOST_CHECK_EQUAL(full_image_scores[j].image_id,
+                        incremental_image_scores[j].image_id);
+      BOOST_CHECK_CLOSE(full_image_scores[j].score,
+                        incremental_image_scores[j].score, 1e-3);
+    }
+  }
+
+  boost::filesystem::remove(path);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestExhaustiveQuantizationType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 3;
+  const int kNumFeatures = 300;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  // With more checks than visual words, the approximate search is exact.
+  typename VisualIndexType::IndexOptions index_options;
+  index_options.num_checks = 1000;
+  typename VisualIndexType::QueryOptions query_options;
+  query_options.num_checks = 1000;
+
+  typename VisualIndexType::IndexOptions exhaustive_index_options =
+      index_options;
+  exhaustive_index_options.exhaustive_quantization = true;
+  typename VisualIndexType::QueryOptions exhaustive_query_options =
+      query_options;
+  exhaustive_query_options.exhaustive_quantization = true;
+
+  VisualIndexType visual_index;
+  visual_index.Build(build_options, descriptors);
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("visual_index_%%%%-%%%%-%%%%"))
+          .string();
+  visual_index.Write(path);
+  VisualIndexType exhaustive_visual_index;
+  exhaustive_visual_index.Read(path);
+  boost::filesystem::remove(path);
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+    exhaustive_visual_index.Add(exhaustive_index_options, i, keypoints,
+                                image_descriptors[i]);
+  }
+  visual_index.Prepare();
+  exhaustive_visual_index.Prepare();
+
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> image_scores;
+    visual_index.Query(query_options, image_descriptors[i], &image_scores);
+    std::vector<ImageScore> exhaustive_image_scores;
+    exhaustive_visual_index.Query(exhaustive_query_options,
+                                  image_descriptors[i],
+                                  &exhaustive_image_scores);
+    BOOST_CHECK_EQUAL(image_scores.size(), kNumImages);
+    BOOST_CHECK_EQUAL(exhaustive_image_scores.size(), kNumImages);
+    for (size_t j = 0; j < image_scores.size(); ++j) {
+      BOOST_CHECK_EQUAL(image_scores[j].image_id,
+                        exhaustive_image_scores[j].image_id);
+      BOOST_CHECK_CLOSE(image_scores[j].score,
+                        exhaustive_image_scores[j].score, 1e-3);
+    }
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestQueryBatchType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 5;
+  const int kNumFeatures = 50;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  VisualIndexType visual_index;
+  visual_index.Build(build_options, descriptors);
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    // Use non-contiguous image identifiers.
+    visual_index.Add(index_options, 2 * i + 1, keypoints,
+                     image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  // Query image without descriptors.
+  image_descriptors.emplace_back(0, kDescDim);
+
+  typename VisualIndexType::QueryOptions query_options;
+  query_options.max_num_images = 3;
+
+  // Repeat the batch query with and without reused buffers to make sure the
+  // score buffers are reset after each call.
+  typename VisualIndexType::QueryBatchBuffers buffers;
+  for (int iter = 0; iter < 3; ++iter) {
+    std::vector<std::vector<ImageScore>> batch_image_scores;
+    visual_index.QueryBatch(query_options, image_descriptors,
+                            &batch_image_scores,
+                            iter == 0 ? nullptr : &buffers);
+    for (const float score : buffers.scores) {
+      BOOST_CHECK_EQUAL(score, 0.0f);
+    }
+    for (const uint8_t has_votes : buffers.has_votes) {
+      BOOST_CHECK_EQUAL(has_votes, 0);
+    }
+    BOOST_CHECK_EQUAL(batch_image_scores.size(), image_descriptors.size());
+    for (size_t i = 0; i < image_descriptors.size(); ++i) {
+      std::vector<ImageScore> image_scores;
+      visual_index.Query(query_options, image_descriptors[i], &image_scores);
+      BOOST_CHECK_EQUAL(image_scores.size(), batch_image_scores[i].size());
+      for (size_t j = 0; j < image_scores.size(); ++j) {
+        BOOST_CHECK_EQUAL(image_scores[j].image_id,
+                          batch_image_scores[i][j].image_id);
+        BOOST_CHECK_CLOSE(image_scores[j].score,
+                          batch_image_scores[i][j].score, 1e-3);
+      }
+    }
+    BOOST_CHECK(batch_image_scores.back().empty());
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestLimitWordAssignmentsType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 5;
+  const int kNumFeatures = 100;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  VisualIndexType visual_index;
+  visual_index.Build(build_options, descriptors);
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  typename VisualIndexType::QueryOptions query_options;
+
+  // Limits that are never reached produce the same scores.
+  typename VisualIndexType::QueryOptions unreached_query_options;
+  unreached_query_options.max_inverted_file_size = kNumImages * kNumFeatures;
+  unreached_query_options.max_num_scored_entries =
+      query_options.num_neighbors * kNumImages * kNumFeatures * kNumFeatures;
+
+  // All visual words are stop words or exceed the budget.
+  typename VisualIndexType::QueryOptions stop_word_query_options;
+  stop_word_query_options.max_inverted_file_size = 0;
+  typename VisualIndexType::QueryOptions no_budget_query_options;
+  no_budget_query_options.max_num_scored_entries = 0;
+
+  // The budget suffices for about one visual word per query descriptor.
+  typename VisualIndexType::QueryOptions budget_query_options;
+  budget_query_options.max_num_scored_entries = kNumImages * kNumFeatures;
+
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> image_scores;
+    visual_index.Query(query_options, image_descriptors[i], &image_scores);
+    BOOST_CHECK_EQUAL(image_scores.size(), kNumImages);
+    BOOST_CHECK_EQUAL(image_scores[0].image_id, i);
+
+    std::vector<ImageScore> unreached_image_scores;
+    visual_index.Query(unreached_query_options, image_descriptors[i],
+                       &unreached_image_scores);
+    BOOST_CHECK_EQUAL(unreached_image_scores.size(), image_scores.size());
+    for (size_t j = 0; j < image_scores.size(); ++j) {
+      BOOST_CHECK_EQUAL(unreached_image_scores[j].image_id,
+                        image_scores[j].image_id);
+      BOOST_CHECK_EQUAL(unreached_image_scores[j].score,
+                        image_scores[j].score);
+    }
+
+    std::vector<ImageScore> stop_word_image_scores;
+    visual_index.Query(stop_word_query_options, image_descriptors[i],
+                       &stop_word_image_scores);
+    BOOST_CHECK(stop_word_image_scores.empty());
+
+    std::vector<ImageScore> no_budget_image_scores;
+    visual_index.Query(no_budget_query_options, image_descriptors[i],
+                       &no_budget_image_scores);
+    BOOST_CHECK(no_budget_image_scores.empty());
+
+    std::vector<ImageScore> budget_image_scores;
+    visual_index.Query(budget_query_options, image_descriptors[i],
+                       &budget_image_scores);
+    BOOST_CHECK(!budget_image_scores.empty());
+    BOOST_CHECK_EQUAL(budget_image_scores[0].image_id, i);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestReadWriteMappedType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 4;
+  const int kNumFeatures = 50;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+  }
+
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+
+  VisualIndexType visual_index;
+  visual_index.Build(build_options, descriptors);
+  for (int i = 0; i < kNumImages - 1; ++i) {
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("visual_index_%%%%-%%%%-%%%%"))
+          .string();
+  const std::string mapped_path = path + ".mapped";
+  visual_index.Write(path);
+  visual_index.WriteMapped(mapped_path);
+
+  VisualIndexType read_visual_index;
+  read_visual_index.Read(path);
+  read_visual_index.Prepare();
+  VisualIndexType mapped_visual_index;
+  mapped_visual_index.Read(mapped_path);
+  mapped_visual_index.Prepare();
+  BOOST_CHECK_EQUAL(mapped_visual_index.NumVisualWords(),
+                    visual_index.NumVisualWords());
+  for (int i = 0; i < kNumImages; ++i) {
+    BOOST_CHECK_EQUAL(mapped_visual_index.ImageIndexed(i), i < kNumImages - 1);
+  }
+
+  const auto CheckEqualQueries = [&](const VisualIndexType& visual_index1,
+                                     const VisualIndexType& visual_index2) {
+    typename VisualIndexType::QueryOptions query_options;
+    query_options.num_images_after_verification = kNumImages;
+    for (int i = 0; i < kNumImages; ++i) {
+      std::vector<ImageScore> image_scores1;
+      visual_index1.Query(query_options, keypoints, image_descriptors[i],
+                          &image_scores1);
+      std::vector<ImageScore> image_scores2;
+      visual_index2.Query(query_options, keypoints, image_descriptors[i],
+                          &image_scores2);
+      BOOST_CHECK_EQUAL(image_scores1.size(), image_scores2.size());
+      for (size_t j = 0; j < image_scores1.size(); ++j) {
+        BOOST_CHECK_EQUAL(image_scores1[j].image_id, image_scores2[j].image_id);
+        BOOST_CHECK_EQUAL(image_scores1[j].score, image_scores2[j].score);
+      }
+    }
+  };
+
+  CheckEqualQueries(visual_index, mapped_visual_index);
+
+  // Extending the mapped index copies the modified entries.
+  read_visual_index.Add(index_options, kNumImages - 1, keypoints,
+                        image_descriptors.back());
+  read_visual_index.Prepare();
+  mapped_visual_index.Add(index_options, kNumImages - 1, keypoints,
+                          image_descriptors.back());
+  mapped_visual_index.Prepare();
+  CheckEqualQueries(read_visual_index, mapped_visual_index);
+
+  // Replacing the file does not affect readers of the previous file.
+  VisualIndexType other_mapped_visual_index;
+  other_mapped_visual_index.Read(mapped_path);
+  other_mapped_visual_index.Prepare();
+  mapped_visual_index.WriteMapped(mapped_path);
+  CheckEqualQueries(visual_index, other_mapped_visual_index);
+  other_mapped_visual_index.Read(mapped_path);
+  other_mapped_visual_index.Prepare();
+  CheckEqualQueries(read_visual_index, other_mapped_visual_index);
+
+  boost::filesystem::remove(path);
+  boost::filesystem::remove(mapped_path);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestParallelVerificationType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 5;
+  const int kNumFeatures = 100;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  VisualIndexType visual_index;
+  visual_index.Build(build_options, descriptors);
+
+  std::vector<typename VisualIndexType::GeomType> image_keypoints;
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  typename VisualIndexType::IndexOptions index_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    typename VisualIndexType::GeomType keypoints;
+    for (int j = 0; j < kNumFeatures; ++j) {
+      keypoints.emplace_back(RandomReal(0.0f, 1000.0f),
+                             RandomReal(0.0f, 1000.0f),
+                             RandomReal(1.0f, 5.0f), RandomReal(-1.0f, 1.0f));
+    }
+    image_keypoints.push_back(keypoints);
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    visual_index.Add(index_options, i, image_keypoints[i],
+                     image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  typename VisualIndexType::QueryOptions query_options;
+  std::vector<ImageScore> image_scores;
+  visual_index.Query(query_options, image_keypoints[0], image_descriptors[0],
+                     &image_scores);
+
+  query_options.num_images_after_verification = kNumImages;
+  query_options.num_threads = 1;
+  std::vector<ImageScore> verified_image_scores;
+  visual_index.Query(query_options, image_keypoints[0], image_descriptors[0],
+                     &verified_image_scores);
+  BOOST_CHECK_EQUAL(verified_image_scores.size(), kNumImages);
+  BOOST_CHECK_EQUAL(verified_image_scores[0].image_id, 0);
+  BOOST_CHECK_GT(verified_image_scores[0].score, image_scores[0].score);
+
+  query_options.num_threads = 4;
+  std::vector<ImageScore> parallel_image_scores;
+  visual_index.Query(query_options, image_keypoints[0], image_descriptors[0],
+                     &parallel_image_scores);
+  BOOST_CHECK_EQUAL(parallel_image_scores.size(), kNumImages);
+  for (size_t i = 0; i < verified_image_scores.size(); ++i) {
+    BOOST_CHECK_EQUAL(parallel_image_scores[i].image_id,
+                      verified_image_scores[i].image_id);
+    BOOST_CHECK_EQUAL(parallel_image_scores[i].score,
+                      verified_image_scores[i].score);
+  }
+
+  // Without any time for verification, the retrieval scores are kept.
+  query_options.max_verification_time = 0;
+  std::vector<ImageScore> unverified_image_scores;
+  visual_index.Query(query_options, image_keypoints[0], image_descriptors[0],
+                     &unverified_image_scores);
+  BOOST_CHECK_EQUAL(unverified_image_scores.size(), kNumImages);
+  for (size_t i = 0; i < image_scores.size(); ++i) {
+    BOOST_CHECK_EQUAL(unverified_image_scores[i].image_id,
+                      image_scores[i].image_id);
+    BOOST_CHECK_EQUAL(unverified_image_scores[i].score, image_scores[i].score);
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestShardedQueryType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 5;
+  const int kNumFeatures = 50;
+  const int kNumShards = 3;
+
+  typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(1000, kDescDim);
+  typename VisualIndexType::BuildOptions build_options;
+  build_options.num_visual_words = 100;
+  build_options.branching = 10;
+
+  // All shards must share the same visual words and Hamming embedding.
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("visual_index_%%%%-%%%%-%%%%"))
+          .string();
+  {
+    VisualIndexType visual_index;
+    visual_index.Build(build_options, descriptors);
+    visual_index.Write(path);
+  }
+
+  VisualIndexType visual_index;
+  visual_index.Read(path);
+  std::vector<VisualIndexType> shard_visual_indices(kNumShards);
+  for (auto& shard_visual_index : shard_visual_indices) {
+    shard_visual_index.Read(path);
+  }
+  boost::filesystem::remove(path);
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  typename VisualIndexType::IndexOptions shard_index_options;
+  shard_index_options.num_shards = kNumShards;
+  typename VisualIndexType::ImageStatisticsMap total_image_statistics;
+  for (int shard_idx = 0; shard_idx < kNumShards; ++shard_idx) {
+    shard_index_options.shard_idx = shard_idx;
+    for (int i = 0; i < kNumImages; ++i) {
+      shard_visual_indices[shard_idx].Add(shard_index_options, i, keypoints,
+                                          image_descriptors[i]);
+    }
+    shard_visual_indices[shard_idx].Prepare();
+    VisualIndexType::AccumulateImageStatistics(
+        shard_visual_indices[shard_idx].GetImageStatistics(),
+        &total_image_statistics);
+  }
+  BOOST_CHECK_EQUAL(total_image_statistics.size(), kNumImages);
+  for (auto& shard_visual_index : shard_visual_indices) {
+    shard_visual_index.PrepareShard(total_image_statistics);
+  }
+
+  typename VisualIndexType::QueryOptions query_options;
+  query_options.max_num_images = 3;
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> image_scores;
+    visual_index.Query(query_options, image_descriptors[i], &image_scores);
+
+    std::vector<typename VisualIndexType::ShardImageScores> shard_image_scores(
+        kNumShards);
+    for (int shard_idx = 0; shard_idx < kNumShards; ++shard_idx) {
+      shard_visual_indices[shard_idx].QueryShard(
+          query_options, image_descriptors[i], &shard_image_scores[shard_idx]);
+    }
+    std::vector<ImageScore> merged_image_scores;
+    VisualIndexType::MergeShardImageScores(query_options, shard_image_scores,
+                                           &merged_image_scores);
+
+    BOOST_CHECK_EQUAL(merged_image_scores.size(), image_scores.size());
+    BOOST_CHECK_EQUAL(merged_image_scores[0].image_id, i);
+    for (size_t j = 0; j < image_scores.size(); ++j) {
+      BOOST_CHECK_EQUAL(merged_image_scores[j].image_id,
+                        image_scores[j].image_id);
+      BOOST_CHECK_CLOSE(merged_image_scores[j].score, image_scores[j].score,
+                        1e-3);
+    }
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void TestMiniBatchBuildType() {
+  typedef VisualIndex<kDescType, kDescDim, kEmbeddingDim> VisualIndexType;
+
+  SetPRNGSeed(0);
+
+  const int kNumImages = 5;
+  const int kNumFeatures = 50;
+
+  const typename VisualIndexType::DescType descriptors =
+      VisualIndexType::DescType::Random(2000, kDescDim);
+  size_t num_sampled_batches = 0;
+  const auto sampler = [&](const size_t num_descriptors) {
+    num_sampled_batches += 1;
+    typename VisualIndexType::DescType batch(num_descriptors, kDescDim);
+    for (size_t i = 0; i < num_descriptors; ++i) {
+      batch.row(i) = descriptors.row(RandomInteger<int>(0, 1999));
+    }
+    return batch;
+  };
+
+  const std::string checkpoint_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("visual_index_%%%%-%%%%-%%%%"))
+          .string();
+
+  typename VisualIndexType::MiniBatchBuildOptions build_options;
+  build_options.num_visual_words = 50;
+  build_options.batch_size = 500;
+  build_options.num_batches = 5;
+  build_options.num_embedding_descriptors = 1000;
+  build_options.checkpoint_path = checkpoint_path;
+  build_options.checkpoint_freq = 2;
+
+  VisualIndexType visual_index;
+  visual_index.BuildMiniBatch(build_options, sampler);
+  BOOST_CHECK_EQUAL(visual_index.NumVisualWords(), 50);
+  // One batch for the initialization, five for the clustering, and one for
+  // the Hamming embedding.
+  BOOST_CHECK_EQUAL(num_sampled_batches, 7);
+  BOOST_CHECK(boost::filesystem::exists(checkpoint_path));
+
+  std::vector<typename VisualIndexType::DescType> image_descriptors;
+  const typename VisualIndexType::GeomType keypoints(kNumFeatures);
+  typename VisualIndexType::IndexOptions index_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    image_descriptors.push_back(
+        VisualIndexType::DescType::Random(kNumFeatures, kDescDim));
+    visual_index.Add(index_options, i, keypoints, image_descriptors[i]);
+  }
+  visual_index.Prepare();
+
+  typename VisualIndexType::QueryOptions query_options;
+  for (int i = 0; i < kNumImages; ++i) {
+    std::vector<ImageScore> image_scores;
+    visual_index.Query(query_options, image_descriptors[i], &image_scores);
+    BOOST_CHECK_EQUAL(image_scores.size(), kNumImages);
+    for (const auto& image_score : image_scores) {
+      if (image_score.image_id == i) {
+        BOOST_CHECK_GT(image_score.score, 0);
+      }
+    }
+  }
+
+  // Resuming from the checkpoint of the finished clustering only samples the
+  // descriptors for the Hamming embedding.
+  num_sampled_batches = 0;
+  VisualIndexType resumed_visual_index;
+  resumed_visual_index.BuildMiniBatch(build_options, sampler);
+  BOOST_CHECK_EQUAL(resumed_visual_index.NumVisualWords(), 50);
+  BOOST_CHECK_EQUAL(num_sampled_batches, 1);
+
+  // Resuming with more batches continues the clustering.
+  num_sampled_batches = 0;
+  build_options.num_batches = 7;
+  resumed_visual_index.BuildMiniBatch(build_options, sampler);
+  BOOST_CHECK_EQUAL(num_sampled_batches, 3);
+
+  boost::filesystem::remove(checkpoint_path);
+}
+
 BOOST_AUTO_TEST_CASE(TestVocabTree) {
   TestVocabTreeType<uint8_t, 128, 64>();
   TestVocabTreeType<uint8_t, 64, 64>();
@@ -112,3 +752,43 @@ BOOST_AUTO_TEST_CASE(TestVocabTree) {
   TestVocabTreeType<float, 32, 16>();
   TestVocabTreeType<double, 32, 16>();
 }
+
+BOOST_AUTO_TEST_CASE(TestIncrementalPrepare) {
+  TestIncrementalPrepareType<uint8_t, 128, 64>();
+  TestIncrementalPrepareType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestExhaustiveQuantization) {
+  TestExhaustiveQuantizationType<uint8_t, 128, 64>();
+  TestExhaustiveQuantizationType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestQueryBatch) {
+  TestQueryBatchType<uint8_t, 128, 64>();
+  TestQueryBatchType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestLimitWordAssignments) {
+  TestLimitWordAssignmentsType<uint8_t, 128, 64>();
+  TestLimitWordAssignmentsType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWriteMapped) {
+  TestReadWriteMappedType<uint8_t, 128, 64>();
+  TestReadWriteMappedType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelVerification) {
+  TestParallelVerificationType<uint8_t, 128, 64>();
+  TestParallelVerificationType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedQuery) {
+  TestShardedQueryType<uint8_t, 128, 64>();
+  TestShardedQueryType<float, 32, 16>();
+}
+
+BOOST_AUTO_TEST_CASE(TestMiniBatchBuild) {
+  TestMiniBatchBuildType<uint8_t, 128, 64>();
+  TestMiniBatchBuildType<float, 32, 16>();
+}
@@ -31,8 +31,8 @@
 
 #include "retrieval/vote_and_verify.h"
 
+#include <algorithm>
 #include <array>
-#include <unordered_map>
 
 #include "estimators/affine_transform.h"
 #include "optim/ransac.h"
@@ -43,6 +43,9 @@ namespace colmap {
 namespace retrieval {
 namespace {
 
+// Number of levels of the multi-resolution voting histogram.
+const int kNumLevels = 6;
+
 // Affine transformation from left to right and from left to right image.
 struct TwoWayTransform {
   TwoWayTransform()
@@ -153,13 +156,13 @@ size_t ComputeEffectiveInlierCount(
     const TwoWayTransform& tform,
     const std::vector<FeatureGeometryMatch>& matches,
     const float max_transfer_error, const float max_scale_error,
-    const int num_bins) {
+    const int num_bins, std::vector<std::pair<float, float>>* inlier_coords,
+    Eigen::MatrixXi* counter) {
   CHECK_GT(max_transfer_error, 0);
   CHECK_GT(max_scale_error, 0);
   CHECK_GT(num_bins, 0);
 
-  std::vector<std::pair<float, float>> inlier_coords;
-  inlier_coords.reserve(matches.size());
+  inlier_coords->clear();
 
   float min_x = std::numeric_limits<float>::max();
   float min_y = std::numeric_limits<float>::max();
@@ -172,7 +175,7 @@ size_t ComputeEffectiveInlierCount(
               max_scale_error &&
           ComputeTransferError(match.geometry1, geometry2, tform) <=
               max_transfer_error) {
-        inlier_coords.emplace_back(match.geometry1.x, match.geometry1.y);
+        inlier_coords->emplace_back(match.geometry1.x, match.geometry1.y);
         min_x = std::min(min_x, match.geometry1.x);
         min_y = std::min(min_y, match.geometry1.y);
         max_x = std::max(max_x, match.geometry1.x);
@@ -182,31 +185,71 @@ size_t ComputeEffectiveInlierCount(
     }
   }
 
-  if (inlier_coords.empty()) {
+  if (inlier_coords->empty()) {
     return 0;
   }
 
   const float scale_x = num_bins / (max_x - min_x);
   const float scale_y = num_bins / (max_y - min_y);
 
-  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic> counter(num_bins,
-                                                             num_bins);
-  counter.setZero();
+  counter->resize(num_bins, num_bins);
+  counter->setZero();
 
-  for (const auto& coord : inlier_coords) {
+  for (const auto& coord : *inlier_coords) {
     const int c_x = (coord.first - min_x) * scale_x;
     const int c_y = (coord.second - min_y) * scale_y;
-    counter(std::max(0, std::min(num_bins - 1, c_x)),
-            std::max(0, std::min(num_bins - 1, c_y))) = 1;
+    (*counter)(std::max(0, std::min(num_bins - 1, c_x)),
+               std::max(0, std::min(num_bins - 1, c_y))) = 1;
   }
 
-  return counter.sum();
+  return counter->sum();
 }
 
 }  // namespace
 
+struct VoteAndVerifyBuffers::Data {
+  // The transformation of each vote.
+  std::vector<FeatureGeometryTransform> tforms;
+
+  // The bin index of each vote in each level of the voting histogram, with
+  // kNumLevels consecutive indices per vote.
+  std::vector<uint64_t> vote_bin_idxs;
+
+  // The bin indices of all votes in the finest level together with the vote
+  // index and in the coarser levels, all in ascending order, such that the
+  // votes of each occupied bin are contiguous.
+  std::vector<std::pair<uint64_t, size_t>> finest_bin_votes;
+  std::array<std::vector<uint64_t>, kNumLevels> sorted_bin_idxs;
+
+  // The occupied bins in the finest level and the index of their first vote.
+  std::vector<VotingBin> bins;
+  std::vector<size_t> bin_vote_idxs;
+
+  std::vector<std::pair<int, float>> bin_scores;
+  std::vector<std::pair<int, int>> inlier_idxs;
+  std::vector<Eigen::Vector2d> inlier_points1;
+  std::vector<Eigen::Vector2d> inlier_points2;
+  std::vector<std::pair<float, float>> inlier_coords;
+  Eigen::MatrixXi counter;
+};
+
+VoteAndVerifyBuffers::VoteAndVerifyBuffers() : data_(new Data()) {}
+
+VoteAndVerifyBuffers::~VoteAndVerifyBuffers() {}
+
+VoteAndVerifyBuffers::Data* VoteAndVerifyBuffers::GetData() {
+  return data_.get();
+}
+
 int VoteAndVerify(const VoteAndVerifyOptions& options,
                   const std::vector<FeatureGeometryMatch>& matches) {
+  VoteAndVerifyBuffers buffers;
+  return VoteAndVerify(options, matches, &buffers);
+}
+
+int VoteAndVerify(const VoteAndVerifyOptions& options,
+                  const std::vector<FeatureGeometryMatch>& matches,
+                  VoteAndVerifyBuffers* buffers) {
   CHECK_GT(options.num_transformations, 0);
   CHECK_GT(options.num_trans_bins, 0);
   CHECK_EQ(options.num_trans_bins % 2, 0);
@@ -218,11 +261,14 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
   CHECK_GT(options.min_num_votes, 0);
   CHECK_GE(options.confidence, 0);
   CHECK_LE(options.confidence, 1);
+  CHECK_NOTNULL(buffers);
 
   if (matches.size() < AffineTransformEstimator::kMinNumSamples) {
     return 0;
   }
 
+  VoteAndVerifyBuffers::Data& data = *buffers->GetData();
+
   const float max_trans = options.max_image_size;
   const float kMaxScale = 10.0f;
   const float max_log_scale = std::log2(kMaxScale);
@@ -235,9 +281,12 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
   // Fill the multi-resolution voting histogram.
   //////////////////////////////////////////////////////////////////////////////
 
-  const int kNumLevels = 6;
-  std::array<std::unordered_map<size_t, VotingBin>, kNumLevels> bins;
-  std::unordered_map<size_t, Eigen::Vector4i> coords;
+  // Instead of hashing the votes into the bins, the bin indices of all votes
+  // are sorted, such that the occupied bins are found without allocating
+  // memory once the buffers are large enough.
+
+  data.tforms.clear();
+  data.vote_bin_idxs.clear();
 
   for (const auto& match : matches) {
     for (const auto& geometry2 : match.geometries2) {
@@ -273,48 +322,71 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
                       (n_s + options.num_scale_bins *
                                  (n_x + options.num_trans_bins * n_y));
 
-        if (level == 0) {
-          coords[index] = Eigen::Vector4i(n_a, n_s, n_x, n_y);
-        }
-
-        bins[level][index].Vote(T);
+        data.vote_bin_idxs.push_back(index);
 
         n_x >>= 1;
         n_y >>= 1;
         n_s >>= 1;
         n_a >>= 1;
       }
+
+      data.tforms.push_back(T);
+    }
+  }
+
+  const size_t num_votes = data.tforms.size();
+
+  data.finest_bin_votes.resize(num_votes);
+  for (int level = 1; level < kNumLevels; ++level) {
+    data.sorted_bin_idxs[level].resize(num_votes);
+  }
+  for (size_t i = 0; i < num_votes; ++i) {
+    const uint64_t* bin_idxs = &data.vote_bin_idxs[i * kNumLevels];
+    data.finest_bin_votes[i] = std::make_pair(bin_idxs[0], i);
+    for (int level = 1; level < kNumLevels; ++level) {
+      data.sorted_bin_idxs[level][i] = bin_idxs[level];
     }
   }
 
+  // Votes of the same bin keep their order, such that the mean transformation
+  // is accumulated in the same order as the matches.
+  std::sort(data.finest_bin_votes.begin(), data.finest_bin_votes.end());
+  for (int level = 1; level < kNumLevels; ++level) {
+    std::sort(data.sorted_bin_idxs[level].begin(),
+              data.sorted_bin_idxs[level].end());
+  }
+
+  data.bins.clear();
+  data.bin_vote_idxs.clear();
+  for (size_t i = 0; i < num_votes; ++i) {
+    if (i == 0 ||
+        data.finest_bin_votes[i].first != data.finest_bin_votes[i - 1].first) {
+      data.bins.emplace_back();
+      data.bin_vote_idxs.push_back(data.finest_bin_votes[i].second);
+    }
+    data.bins.back().Vote(data.tforms[data.finest_bin_votes[i].second]);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // Compute the multi-resolution scores for all occupied bins.
   //////////////////////////////////////////////////////////////////////////////
 
-  std::vector<std::pair<int, float>> bin_scores;
-  for (const auto& bin : bins[0]) {
-    if (bin.second.GetNumVotes() >=
-        static_cast<size_t>(options.min_num_votes)) {
-      const auto coord = coords.at(bin.first);
-      int n_a = coord(0);
-      int n_s = coord(1);
-      int n_x = coord(2);
-      int n_y = coord(3);
-      float score = bin.second.GetNumVotes();
+  data.bin_scores.clear();
+  for (size_t i = 0; i < data.bins.size(); ++i) {
+    const auto& bin = data.bins[i];
+    if (bin.GetNumVotes() >= static_cast<size_t>(options.min_num_votes)) {
+      const uint64_t* bin_idxs =
+          &data.vote_bin_idxs[data.bin_vote_idxs[i] * kNumLevels];
+      float score = bin.GetNumVotes();
       float level_weight = 0.5f;
       for (int level = 1; level < kNumLevels; ++level) {
-        n_x >>= 1;
-        n_y >>= 1;
-        n_s >>= 1;
-        n_a >>= 1;
-        const uint64_t index =
-            n_a + options.num_angle_bins *
-                      (n_s + options.num_scale_bins *
-                                 (n_x + options.num_trans_bins * n_y));
-        score += bins[level][index].GetNumVotes() * level_weight;
+        const auto& level_bin_idxs = data.sorted_bin_idxs[level];
+        const auto level_bin = std::equal_range(
+            level_bin_idxs.begin(), level_bin_idxs.end(), bin_idxs[level]);
+        score += (level_bin.second - level_bin.first) * level_weight;
         level_weight *= 0.5f;
       }
-      bin_scores.emplace_back(bin.first, score);
+      data.bin_scores.emplace_back(static_cast<int>(i), score);
     }
   }
 
@@ -322,11 +394,13 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
   // Extract the top transformations.
   //////////////////////////////////////////////////////////////////////////////
 
-  const size_t num_transformations = std::min(
-      static_cast<size_t>(options.num_transformations), bin_scores.size());
+  const size_t num_transformations =
+      std::min(static_cast<size_t>(options.num_transformations),
+               data.bin_scores.size());
 
-  std::partial_sort(bin_scores.begin(),
-                    bin_scores.begin() + num_transformations, bin_scores.end(),
+  std::partial_sort(data.bin_scores.begin(),
+                    data.bin_scores.begin() + num_transformations,
+                    data.bin_scores.end(),
                     [](const std::pair<int, float>& score1,
                        const std::pair<int, float>& score2) {
                       return score1.second > score2.second;
@@ -340,12 +414,12 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
   size_t best_num_inliers = 0;
   TwoWayTransform best_tform;
 
-  std::vector<std::pair<int, int>> inlier_idxs;
-  std::vector<Eigen::Vector2d> inlier_points1;
-  std::vector<Eigen::Vector2d> inlier_points2;
+  auto& inlier_idxs = data.inlier_idxs;
+  auto& inlier_points1 = data.inlier_points1;
+  auto& inlier_points2 = data.inlier_points2;
 
   for (size_t i = 0; i < num_transformations && i < max_num_trials; ++i) {
-    const auto& bin = bins[0].at(bin_scores.at(i).first);
+    const auto& bin = data.bins.at(data.bin_scores.at(i).first);
     const auto tform = TwoWayTransform(bin.GetTransformation());
     ComputeInliers(tform, matches, options.max_transfer_error,
                    options.max_scale_error, &inlier_idxs);
@@ -410,9 +484,9 @@ int VoteAndVerify(const VoteAndVerifyOptions& options,
   }
 
   const size_t kNumBins = 64;
-  return ComputeEffectiveInlierCount(best_tform, matches,
-                                     options.max_transfer_error,
-                                     options.max_scale_error, kNumBins);
+  return ComputeEffectiveInlierCount(
+      best_tform, matches, options.max_transfer_error, options.max_scale_error,
+      kNumBins, &data.inlier_coords, &data.counter);
 }
 
 }  // namespace retrieval
@@ -32,6 +32,9 @@
 #ifndef COLMAP_SRC_RETRIEVAL_VOTE_AND_VERIFY_H_
 #define COLMAP_SRC_RETRIEVAL_VOTE_AND_VERIFY_H_
 
+#include <memory>
+#include <vector>
+
 #include "retrieval/geometry.h"
 
 namespace colmap {
@@ -72,6 +75,27 @@ struct VoteAndVerifyOptions {
 int VoteAndVerify(const VoteAndVerifyOptions& options,
                   const std::vector<FeatureGeometryMatch>& matches);
 
+// Scratch memory of VoteAndVerify that can be reused across calls. The buffers
+// only grow to the largest size required so far, such that the verification
+// of many images with the same buffers does not repeatedly allocate memory.
+// The buffers must not be used by multiple threads at the same time.
+class VoteAndVerifyBuffers {
+ public:
+  VoteAndVerifyBuffers();
+  ~VoteAndVerifyBuffers();
+
+  struct Data;
+  Data* GetData();
+
+ private:
+  std::unique_ptr<Data> data_;
+};
+
+// Same as above but using the given scratch memory.
+int VoteAndVerify(const VoteAndVerifyOptions& options,
+                  const std::vector<FeatureGeometryMatch>& matches,
+                  VoteAndVerifyBuffers* buffers);
+
 }  // namespace retrieval
 }  // namespace colmap
 
@@ -0,0 +1,107 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "retrieval/vote_and_verify"
+#include "util/testing.h"
+
+#include "retrieval/vote_and_verify.h"
+#include "util/random.h"
+
+using namespace colmap;
+using namespace colmap::retrieval;
+
+std::vector<FeatureGeometryMatch> GenerateMatches(const int num_inliers,
+                                                  const int num_outliers) {
+  const float kScale = 1.5f;
+  const float kAngle = 0.5f;
+  const float kTx = 100.0f;
+  const float kTy = -50.0f;
+
+  std::vector<FeatureGeometryMatch> matches;
+  for (int i = 0; i < num_inliers + num_outliers; ++i) {
+    FeatureGeometryMatch match;
+    match.geometry1.x = RandomReal(0.0f, 1000.0f);
+    match.geometry1.y = RandomReal(0.0f, 1000.0f);
+    match.geometry1.scale = RandomReal(1.0f, 5.0f);
+    match.geometry1.orientation = RandomReal(-1.0f, 1.0f);
+    FeatureGeometry geometry2;
+    if (i < num_inliers) {
+      geometry2.x = kScale * (std::cos(kAngle) * match.geometry1.x -
+                              std::sin(kAngle) * match.geometry1.y) +
+                    kTx;
+      geometry2.y = kScale * (std::sin(kAngle) * match.geometry1.x +
+                              std::cos(kAngle) * match.geometry1.y) +
+                    kTy;
+      geometry2.scale = kScale * match.geometry1.scale;
+      geometry2.orientation = match.geometry1.orientation + kAngle;
+    } else {
+      geometry2.x = RandomReal(0.0f, 1000.0f);
+      geometry2.y = RandomReal(0.0f, 1000.0f);
+      geometry2.scale = RandomReal(1.0f, 5.0f);
+      geometry2.orientation = RandomReal(-1.0f, 1.0f);
+    }
+    match.geometries2.push_back(geometry2);
+    matches.push_back(match);
+  }
+
+  return matches;
+}
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  VoteAndVerifyOptions options;
+  BOOST_CHECK_EQUAL(VoteAndVerify(options, {}), 0);
+  VoteAndVerifyBuffers buffers;
+  BOOST_CHECK_EQUAL(VoteAndVerify(options, {}, &buffers), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestInliers) {
+  SetPRNGSeed(0);
+
+  VoteAndVerifyOptions options;
+  const auto inlier_matches = GenerateMatches(100, 0);
+  const int num_inliers = VoteAndVerify(options, inlier_matches);
+  BOOST_CHECK_GT(num_inliers, 50);
+
+  const auto outlier_matches = GenerateMatches(0, 100);
+  BOOST_CHECK_LT(VoteAndVerify(options, outlier_matches), num_inliers);
+}
+
+BOOST_AUTO_TEST_CASE(TestReuseBuffers) {
+  SetPRNGSeed(0);
+
+  VoteAndVerifyOptions options;
+  VoteAndVerifyBuffers buffers;
+  for (int i = 0; i < 10; ++i) {
+    const auto matches = GenerateMatches(RandomInteger(0, 100), 100);
+    BOOST_CHECK_EQUAL(VoteAndVerify(options, matches, &buffers),
+                      VoteAndVerify(options, matches));
+  }
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "sfm/global_mapper.h"
+
+#include "base/database.h"
+#include "base/pose.h"
+#include "estimators/two_view_geometry.h"
+#include "util/math.h"
+#include "util/misc.h"
+#include "util/random.h"
+#include "util/threading.h"
+
+namespace colmap {
+
+bool GlobalMapper::Options::Check() const {
+  CHECK_OPTION_GT(min_num_inliers, 0);
+  CHECK_OPTION_GT(max_error, 0.0);
+  CHECK_OPTION_GE(min_tri_angle, 0.0);
+  CHECK_OPTION_GE(num_threads, -1);
+  CHECK_OPTION(rotation_averaging.Check());
+  CHECK_OPTION(translation_averaging.Check());
+  return true;
+}
+
+GlobalMapper::GlobalMapper(const DatabaseCache* database_cache)
+    : database_cache_(database_cache) {}
+
+size_t GlobalMapper::RegisterImages(const Options& options,
+                                    Reconstruction* reconstruction) {
+  CHECK(options.Check());
+  CHECK_NOTNULL(reconstruction);
+  CHECK_EQ(reconstruction->NumRegImages(), 0);
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Vector4d> rel_qvecs;
+  std::vector<Eigen::Vector3d> rel_tvecs;
+  std::vector<int> num_inliers;
+  std::vector<double> tri_angles;
+  EstimateRelativePoses(options, &image_pairs, &rel_qvecs, &rel_tvecs,
+                        &num_inliers, &tri_angles);
+
+  // Average the rotations of the image pairs with a valid relative pose.
+  std::vector<size_t> rot_pair_idxs;
+  std::vector<std::pair<image_t, image_t>> rot_image_pairs;
+  std::vector<Eigen::Vector4d> rot_rel_qvecs;
+  std::vector<double> rot_weights;
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    if (num_inliers[i] >= options.min_num_inliers) {
+      rot_pair_idxs.push_back(i);
+      rot_image_pairs.push_back(image_pairs[i]);
+      rot_rel_qvecs.push_back(rel_qvecs[i]);
+      rot_weights.push_back(num_inliers[i]);
+    }
+  }
+
+  EIGEN_STL_UMAP(image_t, Eigen::Vector4d) qvecs;
+  std::vector<char> rot_inlier_mask;
+  if (!AverageRotations(options.rotation_averaging, rot_image_pairs,
+                        rot_rel_qvecs, rot_weights, &qvecs,
+                        &rot_inlier_mask)) {
+    return 0;
+  }
+
+  // Average the translations of the image pairs with a consistent relative
+  // rotation and a sufficient baseline.
+  std::vector<std::pair<image_t, image_t>> trans_image_pairs;
+  std::vector<Eigen::Vector3d> trans_rel_tvecs;
+  for (size_t i = 0; i < rot_pair_idxs.size(); ++i) {
+    const size_t pair_idx = rot_pair_idxs[i];
+    if (rot_inlier_mask[i] &&
+        tri_angles[pair_idx] >= DegToRad(options.min_tri_angle)) {
+      trans_image_pairs.push_back(image_pairs[pair_idx]);
+      trans_rel_tvecs.push_back(rel_tvecs[pair_idx]);
+    }
+  }
+
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  std::vector<char> trans_inlier_mask;
+  if (!AverageTranslations(options.translation_averaging, trans_image_pairs,
+                           trans_rel_tvecs, qvecs, &proj_centers,
+                           &trans_inlier_mask)) {
+    return 0;
+  }
+
+  // Register the images with both an estimated rotation and translation.
+  reconstruction->Load(*database_cache_);
+
+  std::vector<image_t> reg_image_ids;
+  reg_image_ids.reserve(proj_centers.size());
+  for (const auto& proj_center : proj_centers) {
+    reg_image_ids.push_back(proj_center.first);
+  }
+  std::sort(reg_image_ids.begin(), reg_image_ids.end());
+
+  for (const image_t image_id : reg_image_ids) {
+    class Image& image = reconstruction->Image(image_id);
+    image.Qvec() = qvecs.at(image_id);
+    image.Tvec() =
+        -QuaternionRotatePoint(image.Qvec(), proj_centers.at(image_id));
+    reconstruction->RegisterImage(image_id);
+  }
+
+  return reg_image_ids.size();
+}
+
+void GlobalMapper::EstimateRelativePoses(
+    const Options& options,
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<Eigen::Vector4d>* rel_qvecs,
+    std::vector<Eigen::Vector3d>* rel_tvecs, std::vector<int>* num_inliers,
+    std::vector<double>* tri_angles) const {
+  const CorrespondenceGraph& correspondence_graph =
+      database_cache_->CorrespondenceGraph();
+
+  // Sort the image pairs for a deterministic order of the image pairs.
+  std::vector<image_pair_t> pair_ids;
+  for (const auto& num_corrs :
+       correspondence_graph.NumCorrespondencesBetweenImages()) {
+    if (num_corrs.second >=
+        static_cast<point2D_t>(options.min_num_inliers)) {
+      pair_ids.push_back(num_corrs.first);
+    }
+  }
+  std::sort(pair_ids.begin(), pair_ids.end());
+
+  image_pairs->resize(pair_ids.size());
+  rel_qvecs->resize(pair_ids.size());
+  rel_tvecs->resize(pair_ids.size());
+  num_inliers->resize(pair_ids.size());
+  tri_angles->resize(pair_ids.size());
+
+  TwoViewGeometry::Options two_view_geometry_options;
+  two_view_geometry_options.min_num_inliers =
+      static_cast<size_t>(options.min_num_inliers);
+  two_view_geometry_options.ransac_options.min_num_trials = 30;
+  two_view_geometry_options.ransac_options.max_error = options.max_error;
+
+  const auto ExtractPoints = [](const class Image& image) {
+    std::vector<Eigen::Vector2d> points;
+    points.reserve(image.NumPoints2D());
+    for (const auto& point : image.Points2D()) {
+      points.push_back(point.XY());
+    }
+    return points;
+  };
+
+  const auto EstimateRelativePose = [&](const size_t pair_idx) {
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(pair_ids[pair_idx], &image_id1, &image_id2);
+    (*image_pairs)[pair_idx] = std::make_pair(image_id1, image_id2);
+    (*num_inliers)[pair_idx] = 0;
+
+    const class Image& image1 = database_cache_->Image(image_id1);
+    const class Camera& camera1 = database_cache_->Camera(image1.CameraId());
+    const class Image& image2 = database_cache_->Image(image_id2);
+    const class Camera& camera2 = database_cache_->Camera(image2.CameraId());
+
+    const FeatureMatches matches =
+        correspondence_graph.FindCorrespondencesBetweenImages(image_id1,
+                                                              image_id2);
+    const std::vector<Eigen::Vector2d> points1 = ExtractPoints(image1);
+    const std::vector<Eigen::Vector2d> points2 = ExtractPoints(image2);
+
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.EstimateCalibrated(camera1, points1, camera2, points2,
+                                         matches, two_view_geometry_options);
+    if (!two_view_geometry.EstimateRelativePose(camera1, points1, camera2,
+                                                points2)) {
+      return;
+    }
+
+    (*rel_qvecs)[pair_idx] = two_view_geometry.qvec;
+    (*rel_tvecs)[pair_idx] = two_view_geometry.tvec;
+    (*num_inliers)[pair_idx] =
+        static_cast<int>(two_view_geometry.inlier_matches.size());
+    (*tri_angles)[pair_idx] = two_view_geometry.tri_angle;
+  };
+
+  // Each pair is estimated with its own PRNG seed, so the relative poses do
+  // not depend on the assignment of the pairs to threads.
+  const unsigned seed = RandomPRNGSeed();
+  ThreadPool thread_pool(GetEffectiveNumThreads(options.num_threads));
+  for (size_t pair_idx = 0; pair_idx < pair_ids.size(); ++pair_idx) {
+    thread_pool.AddTask([&, pair_idx]() {
+      const image_pair_t pair_id = pair_ids[pair_idx];
+      ScopedPRNGSeed scoped_prng_seed(
+          seed ^ static_cast<unsigned>(pair_id * 2654435761u) ^
+          static_cast<unsigned>(pair_id >> 32));
+      EstimateRelativePose(pair_idx);
+    });
+  }
+  thread_pool.Wait();
+}
+
+}  // namespace colmap
@@ -0,0 +1,105 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_SFM_GLOBAL_MAPPER_H_
+#define COLMAP_SRC_SFM_GLOBAL_MAPPER_H_
+
+#include "base/database_cache.h"
+#include "base/reconstruction.h"
+#include "estimators/motion_averaging.h"
+
+namespace colmap {
+
+// Class that registers all images of the scene at once by averaging the
+// relative poses of the image pairs instead of registering the images one at
+// a time. This scales much better than incremental mapping to large scenes
+// with many well-connected images. The registered images are typically
+// triangulated and refined using the incremental mapper. Example usage:
+//
+//  GlobalMapper global_mapper(&database_cache);
+//  global_mapper.RegisterImages(options, &reconstruction);
+//  IncrementalMapper mapper(&database_cache);
+//  mapper.BeginReconstruction(&reconstruction);
+//  for (const auto image_id : reconstruction.RegImageIds()) {
+//    mapper.TriangulateImage(tri_options, image_id);
+//  }
+//  mapper.AdjustGlobalBundle(...);
+//  mapper.EndReconstruction(false);
+//
+class GlobalMapper {
+ public:
+  struct Options {
+    // Minimum number of inliers of the relative pose of an image pair.
+    int min_num_inliers = 30;
+
+    // Maximum error in pixels for the relative pose estimation.
+    double max_error = 4.0;
+
+    // Minimum triangulation angle in degrees of an image pair to use its
+    // relative translation. Image pairs with smaller baselines only constrain
+    // the rotations, since their translation direction is unreliable.
+    double min_tri_angle = 1.0;
+
+    // Number of threads for the relative pose estimation.
+    int num_threads = -1;
+
+    RotationAveragingOptions rotation_averaging;
+    TranslationAveragingOptions translation_averaging;
+
+    bool Check() const;
+  };
+
+  // Create global mapper. The database cache must live for the entire
+  // life-time of the global mapper.
+  explicit GlobalMapper(const DatabaseCache* database_cache);
+
+  // Estimate the poses of the images and register them in the reconstruction,
+  // which must not have any registered images yet. The reconstruction is
+  // loaded from the database cache. Returns the number of registered images.
+  size_t RegisterImages(const Options& options, Reconstruction* reconstruction);
+
+ private:
+  // Estimate the relative poses of all image pairs with enough correspondences
+  // from their calibrated two-view geometry.
+  void EstimateRelativePoses(
+      const Options& options,
+      std::vector<std::pair<image_t, image_t>>* image_pairs,
+      std::vector<Eigen::Vector4d>* rel_qvecs,
+      std::vector<Eigen::Vector3d>* rel_tvecs,
+      std::vector<int>* num_inliers, std::vector<double>* tri_angles) const;
+
+  // Class that holds all necessary data from database in memory.
+  const DatabaseCache* database_cache_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_SFM_GLOBAL_MAPPER_H_
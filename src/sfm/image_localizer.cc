@@ -0,0 +1,277 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "sfm/image_localizer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+
+#include "base/pose.h"
+#include "estimators/pose.h"
+#include "feature/utils.h"
+#include "util/endian.h"
+#include "util/misc.h"
+
+namespace colmap {
+
+bool ImageLocalizer::Options::Check() const {
+  CHECK_OPTION_GT(max_ratio, 0.0);
+  CHECK_OPTION_GT(max_distance, 0.0);
+  CHECK_OPTION_GT(abs_pose_max_error, 0.0);
+  CHECK_OPTION_GE(abs_pose_min_num_inliers, 0);
+  CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0.0);
+  CHECK_OPTION_LE(abs_pose_min_inlier_ratio, 1.0);
+  CHECK_OPTION_GT(min_focal_length_ratio, 0.0);
+  CHECK_OPTION_LE(min_focal_length_ratio, max_focal_length_ratio);
+  return true;
+}
+
+ImageLocalizer::ImageLocalizer() {}
+
+void ImageLocalizer::Build(const Reconstruction& reconstruction,
+                           const Database& database) {
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(reconstruction.NumPoints3D());
+  for (const auto& point3D : reconstruction.Points3D()) {
+    point3D_ids.push_back(point3D.first);
+  }
+  std::sort(point3D_ids.begin(), point3D_ids.end());
+
+  std::unordered_map<point3D_t, size_t> point3D_idxs;
+  point3D_idxs.reserve(point3D_ids.size());
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    point3D_idxs.emplace(point3D_ids[i], i);
+  }
+
+  // Sum up the descriptors of all observations of each 3D point. The images
+  // are read one after another, so only their features must fit into memory.
+  Eigen::Matrix<uint32_t, Eigen::Dynamic, 128, Eigen::RowMajor> sums =
+      Eigen::Matrix<uint32_t, Eigen::Dynamic, 128, Eigen::RowMajor>::Zero(
+          point3D_ids.size(), 128);
+  std::vector<uint32_t> num_observations(point3D_ids.size(), 0);
+
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    const Image& image = reconstruction.Image(image_id);
+    if (image.NumPoints3D() == 0) {
+      continue;
+    }
+
+    const FeatureDescriptors descriptors = database.ReadDescriptors(image_id);
+    if (static_cast<size_t>(descriptors.rows()) != image.NumPoints2D()) {
+      std::cout << StringPrintf(
+                       "WARNING: Skipping image %s with mismatching features",
+                       image.Name().c_str())
+                << std::endl;
+      continue;
+    }
+
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (point2D.HasPoint3D()) {
+        const size_t idx = point3D_idxs.at(point2D.Point3DId());
+        sums.row(idx) += descriptors.row(point2D_idx).cast<uint32_t>();
+        num_observations[idx] += 1;
+      }
+    }
+  }
+
+  point3D_ids_.clear();
+  xyzs_.clear();
+  point3D_ids_.reserve(point3D_ids.size());
+  xyzs_.reserve(point3D_ids.size());
+
+  FeatureDescriptors descriptors(point3D_ids.size(), 128);
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    if (num_observations[i] == 0) {
+      continue;
+    }
+    const Eigen::Index row = static_cast<Eigen::Index>(point3D_ids_.size());
+    for (int col = 0; col < 128; ++col) {
+      descriptors(row, col) = static_cast<uint8_t>(
+          (sums(i, col) + num_observations[i] / 2) / num_observations[i]);
+    }
+    point3D_ids_.push_back(point3D_ids[i]);
+    xyzs_.push_back(reconstruction.Point3D(point3D_ids[i]).XYZ());
+  }
+
+  descriptors.conservativeResize(point3D_ids_.size(), 128);
+  BuildIndex(descriptors);
+}
+
+void ImageLocalizer::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  const size_t num_points3D = ReadBinaryLittleEndian<uint64_t>(&file);
+
+  point3D_ids_.resize(num_points3D);
+  xyzs_.resize(num_points3D);
+  FeatureDescriptors descriptors(num_points3D, 128);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    point3D_ids_[i] = ReadBinaryLittleEndian<point3D_t>(&file);
+    xyzs_[i](0) = ReadBinaryLittleEndian<double>(&file);
+    xyzs_[i](1) = ReadBinaryLittleEndian<double>(&file);
+    xyzs_[i](2) = ReadBinaryLittleEndian<double>(&file);
+    file.read(reinterpret_cast<char*>(descriptors.row(i).data()), 128);
+  }
+
+  CHECK(file.good()) << path;
+
+  BuildIndex(descriptors);
+}
+
+void ImageLocalizer::Write(const std::string& path) const {
+  CHECK(index_);
+
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  const FeatureDescriptors& descriptors = index_->Descriptors();
+
+  WriteBinaryLittleEndian<uint64_t>(&file, point3D_ids_.size());
+  for (size_t i = 0; i < point3D_ids_.size(); ++i) {
+    WriteBinaryLittleEndian<point3D_t>(&file, point3D_ids_[i]);
+    WriteBinaryLittleEndian<double>(&file, xyzs_[i](0));
+    WriteBinaryLittleEndian<double>(&file, xyzs_[i](1));
+    WriteBinaryLittleEndian<double>(&file, xyzs_[i](2));
+    file.write(reinterpret_cast<const char*>(descriptors.row(i).data()), 128);
+  }
+}
+
+size_t ImageLocalizer::NumPoints3D() const { return point3D_ids_.size(); }
+
+bool ImageLocalizer::Localize(
+    const Options& options, const FeatureKeypoints& keypoints,
+    const FeatureDescriptors& descriptors, Camera* camera,
+    Eigen::Vector4d* qvec, Eigen::Vector3d* tvec,
+    std::vector<std::pair<point2D_t, point3D_t>>* inlier_corrs) const {
+  CHECK(options.Check());
+  CHECK(index_);
+  CHECK_NOTNULL(camera);
+  CHECK_NOTNULL(qvec);
+  CHECK_NOTNULL(tvec);
+  CHECK_NOTNULL(inlier_corrs);
+  CHECK_EQ(keypoints.size(), static_cast<size_t>(descriptors.rows()));
+
+  inlier_corrs->clear();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // 2D-3D matching
+  //////////////////////////////////////////////////////////////////////////////
+
+  SiftMatchingOptions match_options;
+  match_options.max_ratio = options.max_ratio;
+  match_options.max_distance = options.max_distance;
+  match_options.cross_check = options.cross_check;
+
+  FeatureMatches matches;
+  MatchSiftFeaturesCPUFLANN(match_options, SiftDescriptorIndex(descriptors),
+                            *index_, &matches);
+
+  std::cout << "  => Matched points: " << matches.size() << std::endl;
+
+  if (matches.size() <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  points2D.reserve(matches.size());
+  points3D.reserve(matches.size());
+  for (const auto& match : matches) {
+    const FeatureKeypoint& keypoint = keypoints[match.point2D_idx1];
+    points2D.emplace_back(keypoint.x, keypoint.y);
+    points3D.push_back(xyzs_[match.point2D_idx2]);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Absolute pose estimation
+  //////////////////////////////////////////////////////////////////////////////
+
+  AbsolutePoseEstimationOptions abs_pose_options;
+  abs_pose_options.num_threads = options.num_threads;
+  abs_pose_options.num_focal_length_samples = 30;
+  abs_pose_options.min_focal_length_ratio = options.min_focal_length_ratio;
+  abs_pose_options.max_focal_length_ratio = options.max_focal_length_ratio;
+  abs_pose_options.ransac_options.max_error = options.abs_pose_max_error;
+  abs_pose_options.ransac_options.min_inlier_ratio =
+      options.abs_pose_min_inlier_ratio;
+  // Use high confidence to avoid preemptive termination of P3P RANSAC
+  // - too early termination may lead to bad localization.
+  abs_pose_options.ransac_options.min_num_trials = 100;
+  abs_pose_options.ransac_options.max_num_trials = 10000;
+  abs_pose_options.ransac_options.confidence = 0.99999;
+  abs_pose_options.estimate_focal_length =
+      options.abs_pose_refine_focal_length && !camera->HasPriorFocalLength();
+
+  AbsolutePoseRefinementOptions abs_pose_refinement_options;
+  abs_pose_refinement_options.refine_focal_length =
+      options.abs_pose_refine_focal_length;
+  abs_pose_refinement_options.refine_extra_params =
+      options.abs_pose_refine_extra_params;
+
+  size_t num_inliers;
+  std::vector<char> inlier_mask;
+  if (!EstimateAbsolutePose(abs_pose_options, points2D, points3D, qvec, tvec,
+                            camera, &num_inliers, &inlier_mask)) {
+    return false;
+  }
+
+  std::cout << "  => Inliers: " << num_inliers << std::endl;
+
+  if (num_inliers < static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return false;
+  }
+
+  if (!RefineAbsolutePose(abs_pose_refinement_options, inlier_mask, points2D,
+                          points3D, qvec, tvec, camera)) {
+    return false;
+  }
+
+  inlier_corrs->reserve(num_inliers);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    if (inlier_mask[i]) {
+      inlier_corrs->emplace_back(matches[i].point2D_idx1,
+                                 point3D_ids_[matches[i].point2D_idx2]);
+    }
+  }
+
+  return true;
+}
+
+void ImageLocalizer::BuildIndex(const FeatureDescriptors& descriptors) {
+  index_.reset(new SiftDescriptorIndex(descriptors));
+}
+
+}  // namespace colmap
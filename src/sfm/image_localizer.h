@@ -0,0 +1,116 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_SFM_IMAGE_LOCALIZER_H_
+#define COLMAP_SRC_SFM_IMAGE_LOCALIZER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/database.h"
+#include "base/reconstruction.h"
+#include "feature/sift.h"
+#include "util/types.h"
+
+namespace colmap {
+
+// Localize images against an existing reconstruction by directly matching
+// their features to the 3D points of the reconstruction. Each 3D point is
+// represented by the mean descriptor of its observations, which are indexed
+// once, so that localizing an image neither requires the matches between the
+// images nor the correspondence graph of the reconstruction.
+class ImageLocalizer {
+ public:
+  struct Options {
+    // Feature matching between the image and the point descriptors.
+    double max_ratio = 0.8;
+    double max_distance = 0.7;
+    bool cross_check = true;
+
+    // Maximum reprojection error in absolute pose estimation.
+    double abs_pose_max_error = 12.0;
+
+    // Minimum number of inliers for absolute pose estimation.
+    int abs_pose_min_num_inliers = 30;
+
+    // Minimum inlier ratio for absolute pose estimation.
+    double abs_pose_min_inlier_ratio = 0.25;
+
+    // Whether to estimate the focal length and extra parameters of the camera.
+    // The focal length is only estimated if there is no prior for it.
+    bool abs_pose_refine_focal_length = true;
+    bool abs_pose_refine_extra_params = true;
+
+    // The range of focal lengths to sample in the estimation relative to the
+    // focal length of the given camera.
+    double min_focal_length_ratio = 0.1;
+    double max_focal_length_ratio = 10.0;
+
+    // Number of threads for absolute pose estimation.
+    int num_threads = -1;
+
+    bool Check() const;
+  };
+
+  ImageLocalizer();
+
+  // Build the index from the descriptors of the observations of all 3D points
+  // in the reconstruction, which are read from the database.
+  void Build(const Reconstruction& reconstruction, const Database& database);
+
+  // Read/write the indexed 3D points and their descriptors from/to a binary
+  // file, so that the index can be built once for a reconstruction.
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
+  size_t NumPoints3D() const;
+
+  // Estimate the pose of an image from its features. The camera parameters
+  // are refined according to the options. Returns the inlier correspondences
+  // between the image points and the 3D points on success.
+  bool Localize(const Options& options, const FeatureKeypoints& keypoints,
+                const FeatureDescriptors& descriptors, Camera* camera,
+                Eigen::Vector4d* qvec, Eigen::Vector3d* tvec,
+                std::vector<std::pair<point2D_t, point3D_t>>* inlier_corrs)
+      const;
+
+ private:
+  void BuildIndex(const FeatureDescriptors& descriptors);
+
+  std::vector<point3D_t> point3D_ids_;
+  std::vector<Eigen::Vector3d> xyzs_;
+  std::unique_ptr<SiftDescriptorIndex> index_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_SFM_IMAGE_LOCALIZER_H_
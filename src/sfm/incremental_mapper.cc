@@ -31,45 +31,184 @@
 
 #include "sfm/incremental_mapper.h"
 
+#include <algorithm>
 #include <array>
 #include <fstream>
 
+#include <Eigen/Eigenvalues>
+
+#include "base/gps.h"
 #include "base/projection.h"
+#include "base/similarity_transform.h"
 #include "base/triangulation.h"
+#include "base/visibility_pyramid.h"
 #include "estimators/pose.h"
 #include "util/bitmap.h"
 #include "util/misc.h"
+#include "util/random.h"
+#include "util/trace.h"
+#include "util/threading.h"
 
 namespace colmap {
 namespace {
 
-void SortAndAppendNextImages(std::vector<std::pair<image_t, float>> image_ranks,
-                             std::vector<image_t>* sorted_images_ids) {
-  std::sort(image_ranks.begin(), image_ranks.end(),
-            [](const std::pair<image_t, float>& image1,
-               const std::pair<image_t, float>& image2) {
-              return image1.second > image2.second;
-            });
+// The PRNG seed of the estimation for an image pair, which is derived from the
+// seed of the pass, such that the estimation does not depend on the thread
+// that executes it and the result is the same for any number of threads.
+unsigned ImagePairPRNGSeed(const unsigned seed, const image_pair_t pair_id) {
+  return seed ^ static_cast<unsigned>(pair_id * 2654435761u) ^
+         static_cast<unsigned>(pair_id >> 32);
+}
 
-  sorted_images_ids->reserve(sorted_images_ids->size() + image_ranks.size());
-  for (const auto& image : image_ranks) {
-    sorted_images_ids->push_back(image.first);
+float RankNextImage(
+    const IncrementalMapper::Options::ImageSelectionMethod selection_method,
+    const Image& image) {
+  switch (selection_method) {
+    case IncrementalMapper::Options::ImageSelectionMethod::
+        MAX_VISIBLE_POINTS_NUM:
+      return static_cast<float>(image.NumVisiblePoints3D());
+    case IncrementalMapper::Options::ImageSelectionMethod::
+        MAX_VISIBLE_POINTS_RATIO:
+      return static_cast<float>(image.NumVisiblePoints3D()) /
+             static_cast<float>(image.NumObservations());
+    case IncrementalMapper::Options::ImageSelectionMethod::MIN_UNCERTAINTY:
+      return static_cast<float>(image.Point3DVisibilityScore());
   }
-
-  image_ranks.clear();
+  return 0.0f;
 }
 
-float RankNextImageMaxVisiblePointsNum(const Image& image) {
-  return static_cast<float>(image.NumVisiblePoints3D());
+// Select a subset of the 3D points observed by the given images, such that
+// each image observes at most the given number of selected points. The points
+// of an image are selected greedily by their track length as long as they
+// increase the coverage of the image in the visibility pyramid and the
+// remaining budget is filled with the longest tracks.
+std::unordered_set<point3D_t> SelectGlobalBundlePoints3D(
+    const Reconstruction& reconstruction, const std::vector<image_t>& image_ids,
+    const size_t max_num_points_per_image) {
+  std::unordered_set<point3D_t> point3D_ids;
+
+  std::vector<std::pair<size_t, point2D_t>> candidates;
+  for (const image_t image_id : image_ids) {
+    const Image& image = reconstruction.Image(image_id);
+    const Camera& camera = reconstruction.Camera(image.CameraId());
+
+    VisibilityPyramid visibility_pyramid(
+        Image::kNumPoint3DVisibilityPyramidLevels, camera.Width(),
+        camera.Height());
+
+    size_t num_selected = 0;
+    candidates.clear();
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (!point2D.HasPoint3D()) {
+        continue;
+      }
+      if (point3D_ids.count(point2D.Point3DId()) > 0) {
+        // Points selected by previous images also constrain this image.
+        visibility_pyramid.SetPoint(point2D.X(), point2D.Y());
+        num_selected += 1;
+      } else {
+        candidates.emplace_back(
+            reconstruction.Point3D(point2D.Point3DId()).Track().Length(),
+            point2D_idx);
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<size_t, point2D_t>& candidate1,
+                 const std::pair<size_t, point2D_t>& candidate2) {
+                return candidate1.first > candidate2.first;
+              });
+
+    std::vector<bool> remaining(candidates.size(), true);
+    for (size_t i = 0; i < candidates.size() &&
+                       num_selected < max_num_points_per_image &&
+                       visibility_pyramid.Score() <
+                           visibility_pyramid.MaxScore();
+         ++i) {
+      const Point2D& point2D = image.Point2D(candidates[i].second);
+      const size_t prev_score = visibility_pyramid.Score();
+      visibility_pyramid.SetPoint(point2D.X(), point2D.Y());
+      if (visibility_pyramid.Score() > prev_score) {
+        point3D_ids.insert(point2D.Point3DId());
+        num_selected += 1;
+        remaining[i] = false;
+      } else {
+        visibility_pyramid.ResetPoint(point2D.X(), point2D.Y());
+      }
+    }
+
+    for (size_t i = 0;
+         i < candidates.size() && num_selected < max_num_points_per_image;
+         ++i) {
+      if (remaining[i]) {
+        point3D_ids.insert(image.Point2D(candidates[i].second).Point3DId());
+        num_selected += 1;
+      }
+    }
+  }
+
+  return point3D_ids;
 }
 
-float RankNextImageMaxVisiblePointsRatio(const Image& image) {
-  return static_cast<float>(image.NumVisiblePoints3D()) /
-         static_cast<float>(image.NumObservations());
+// Refine the 3D points that were not part of the point subset of a previous
+// adjustment, while keeping all poses and cameras constant.
+bool AdjustRemainingPoints3D(const BundleAdjustmentOptions& ba_options,
+                             const std::vector<image_t>& image_ids,
+                             const std::unordered_set<point3D_t>& point3D_ids,
+                             Reconstruction* reconstruction) {
+  BundleAdjustmentConfig ba_config;
+  for (const image_t image_id : image_ids) {
+    ba_config.AddImage(image_id);
+    ba_config.SetConstantPose(image_id);
+    ba_config.SetConstantCamera(reconstruction->Image(image_id).CameraId());
+  }
+
+  std::unordered_set<point3D_t> remaining_point3D_ids;
+  remaining_point3D_ids.reserve(reconstruction->NumPoints3D() -
+                                point3D_ids.size());
+  for (const auto& point3D : reconstruction->Points3D()) {
+    if (point3D_ids.count(point3D.first) == 0) {
+      remaining_point3D_ids.insert(point3D.first);
+    }
+  }
+
+  if (remaining_point3D_ids.empty()) {
+    return true;
+  }
+
+  ba_config.SetPointSubset(remaining_point3D_ids);
+
+  BundleAdjuster bundle_adjuster(ba_options, ba_config);
+  return bundle_adjuster.Solve(reconstruction);
 }
 
-float RankNextImageMinUncertainty(const Image& image) {
-  return static_cast<float>(image.Point3DVisibilityScore());
+// Whether the positions are spread in at least two dimensions, such that they
+// determine the rotation of a similarity transformation.
+bool ArePositionsNonCollinear(const std::vector<Eigen::Vector3d>& positions) {
+  if (positions.size() < 3) {
+    return false;
+  }
+
+  Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+  for (const auto& position : positions) {
+    mean += position;
+  }
+  mean /= positions.size();
+
+  Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+  for (const auto& position : positions) {
+    covariance += (position - mean) * (position - mean).transpose();
+  }
+
+  // The ratio of the second largest to the largest standard deviation.
+  const double kMinSpreadRatio = 0.1;
+  const Eigen::Vector3d eigenvalues =
+      Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(
+          covariance, Eigen::EigenvaluesOnly)
+          .eigenvalues();
+  return eigenvalues(1) > kMinSpreadRatio * kMinSpreadRatio * eigenvalues(2);
 }
 
 }  // namespace
@@ -81,6 +220,7 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_LE(init_max_forward_motion, 1.0);
   CHECK_OPTION_GE(init_min_tri_angle, 0.0);
   CHECK_OPTION_GE(init_max_reg_trials, 1);
+  CHECK_OPTION_GE(init_num_candidate_pairs, 1);
   CHECK_OPTION_GT(abs_pose_max_error, 0.0);
   CHECK_OPTION_GT(abs_pose_min_num_inliers, 0);
   CHECK_OPTION_GE(abs_pose_min_inlier_ratio, 0.0);
@@ -93,16 +233,78 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GE(filter_max_reproj_error, 0.0);
   CHECK_OPTION_GE(filter_min_tri_angle, 0.0);
   CHECK_OPTION_GE(max_reg_trials, 1);
+  CHECK_OPTION_GE(prior_position_min_num_images, 3);
+  CHECK_OPTION_GT(prior_position_max_error, 0.0);
+  return true;
+}
+
+ImageClaims::ImageClaims(const std::vector<image_t>& image_ids,
+                         const size_t max_model_overlap)
+    : max_model_overlap_(max_model_overlap), num_claimed_images_(0) {
+  num_claims_.reserve(image_ids.size());
+  for (const image_t image_id : image_ids) {
+    num_claims_[image_id].store(0);
+  }
+}
+
+bool ImageClaims::Claim(const image_t image_id, const size_t num_shared_images,
+                        bool* shared) {
+  std::atomic<size_t>& num_claims = num_claims_.at(image_id);
+  size_t prev_num_claims = num_claims.load();
+  do {
+    if (prev_num_claims > 0 && num_shared_images >= max_model_overlap_) {
+      return false;
+    }
+  } while (!num_claims.compare_exchange_weak(prev_num_claims,
+                                             prev_num_claims + 1));
+  if (prev_num_claims == 0) {
+    num_claimed_images_ += 1;
+  }
+  *shared = prev_num_claims > 0;
   return true;
 }
 
+bool ImageClaims::ClaimExclusive(const image_t image_id) {
+  size_t prev_num_claims = 0;
+  if (!num_claims_.at(image_id).compare_exchange_strong(prev_num_claims, 1)) {
+    return false;
+  }
+  num_claimed_images_ += 1;
+  return true;
+}
+
+bool ImageClaims::Release(const image_t image_id) {
+  const size_t prev_num_claims = num_claims_.at(image_id).fetch_sub(1);
+  CHECK_GT(prev_num_claims, 0);
+  if (prev_num_claims == 1) {
+    num_claimed_images_ -= 1;
+  }
+  return prev_num_claims > 1;
+}
+
+size_t ImageClaims::NumClaims(const image_t image_id) const {
+  return num_claims_.at(image_id).load();
+}
+
+size_t ImageClaims::NumClaimedImages() const {
+  return num_claimed_images_.load();
+}
+
 IncrementalMapper::IncrementalMapper(const DatabaseCache* database_cache)
+    : IncrementalMapper(database_cache, nullptr) {}
+
+IncrementalMapper::IncrementalMapper(const DatabaseCache* database_cache,
+                                     ImageClaims* image_claims)
     : database_cache_(database_cache),
       reconstruction_(nullptr),
       triangulator_(nullptr),
       num_total_reg_images_(0),
       num_shared_reg_images_(0),
-      prev_init_image_pair_id_(kInvalidImagePairId) {}
+      prev_init_image_pair_id_(kInvalidImagePairId),
+      image_claims_(image_claims),
+      num_reg_image_events_(0),
+      prior_positions_aligned_(false),
+      next_image_ranks_valid_(false) {}
 
 void IncrementalMapper::BeginReconstruction(Reconstruction* reconstruction) {
   CHECK(reconstruction_ == nullptr);
@@ -111,22 +313,56 @@ void IncrementalMapper::BeginReconstruction(Reconstruction* reconstruction) {
   reconstruction_->SetUp(&database_cache_->CorrespondenceGraph());
   triangulator_.reset(new IncrementalTriangulator(
       &database_cache_->CorrespondenceGraph(), reconstruction));
+  local_bundle_adjuster_.reset();
+  global_bundle_adjuster_.reset();
 
   num_shared_reg_images_ = 0;
   num_reg_images_per_camera_.clear();
   for (const image_t image_id : reconstruction_->RegImageIds()) {
-    RegisterImageEvent(image_id);
+    CHECK(RegisterImageEvent(image_id))
+        << "Existing image exceeds the maximum overlap with other models";
   }
 
   existing_image_ids_ =
       std::unordered_set<image_t>(reconstruction->RegImageIds().begin(),
                                   reconstruction->RegImageIds().end());
 
+  prior_positions_.clear();
+  prior_positions_aligned_ = false;
+
   prev_init_image_pair_id_ = kInvalidImagePairId;
   prev_init_two_view_geometry_ = TwoViewGeometry();
 
   filtered_images_.clear();
   num_reg_trials_.clear();
+
+  next_image_ranks_valid_ = false;
+  next_image_modified_ids_.clear();
+}
+
+void IncrementalMapper::ResumeReconstruction(Reconstruction* reconstruction,
+                                             const State& state) {
+  CHECK(image_claims_ == nullptr);
+
+  init_num_reg_trials_ = state.init_num_reg_trials;
+  init_image_pairs_ = state.init_image_pairs;
+
+  num_registrations_ = state.num_registrations;
+  num_total_reg_images_ = 0;
+  for (const auto& num_registrations : num_registrations_) {
+    if (num_registrations.second > 0) {
+      num_total_reg_images_ += 1;
+    }
+  }
+
+  BeginReconstruction(reconstruction);
+
+  if (!state.existing_image_ids.empty() || !state.filtered_images.empty() ||
+      !state.num_reg_trials.empty()) {
+    existing_image_ids_ = state.existing_image_ids;
+    filtered_images_ = state.filtered_images;
+    num_reg_trials_ = state.num_reg_trials;
+  }
 }
 
 void IncrementalMapper::EndReconstruction(const bool discard) {
@@ -141,11 +377,18 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
   reconstruction_->TearDown();
   reconstruction_ = nullptr;
   triangulator_.reset();
+  local_bundle_adjuster_.reset();
+  global_bundle_adjuster_.reset();
+
+  next_image_ranks_valid_ = false;
+  next_image_modified_ids_.clear();
 }
 
 bool IncrementalMapper::FindInitialImagePair(const Options& options,
                                              image_t* image_id1,
                                              image_t* image_id2) {
+  const TraceSpan trace_span("mapper/find_initial_pair");
+
   CHECK(options.Check());
 
   std::vector<image_t> image_ids1;
@@ -166,30 +409,134 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
     image_ids1 = FindFirstInitialImage(options);
   }
 
-  // Try to find good initial pair.
-  for (size_t i1 = 0; i1 < image_ids1.size(); ++i1) {
-    *image_id1 = image_ids1[i1];
+  // Try to find good initial pair. The candidate pairs are evaluated in
+  // batches of init_num_candidate_pairs in their order of preference and the
+  // search stops after the first batch with a pair that satisfies all
+  // thresholds. The pairs of a batch are estimated in parallel, each with its
+  // own PRNG seed, so the selected pair does not depend on the number of
+  // threads.
+  const int num_threads = GetEffectiveNumThreads(options.num_threads);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_threads > 1 && options.init_num_candidate_pairs > 1) {
+    thread_pool.reset(new ThreadPool(
+        std::min(num_threads, options.init_num_candidate_pairs)));
+  }
+
+  const unsigned seed = RandomPRNGSeed();
+
+  struct InitialImagePair {
+    image_t image_id1;
+    image_t image_id2;
+    bool success;
+    TwoViewGeometry two_view_geometry;
+  };
 
-    const std::vector<image_t> image_ids2 =
-        FindSecondInitialImage(options, *image_id1);
+  const CorrespondenceGraph& correspondence_graph =
+      database_cache_->CorrespondenceGraph();
+
+  std::vector<InitialImagePair> candidates;
+  std::vector<image_t> image_ids2;
+  size_t i1 = 0;
+  size_t i2 = 0;
+  while (true) {
+    candidates.clear();
+    while (candidates.size() <
+           static_cast<size_t>(options.init_num_candidate_pairs)) {
+      if (i2 >= image_ids2.size()) {
+        if (i1 >= image_ids1.size()) {
+          break;
+        }
+        *image_id1 = image_ids1[i1];
+        image_ids2 = FindSecondInitialImage(options, *image_id1);
+        i1 += 1;
+        i2 = 0;
+        continue;
+      }
 
-    for (size_t i2 = 0; i2 < image_ids2.size(); ++i2) {
       *image_id2 = image_ids2[i2];
+      i2 += 1;
 
+      // Try every pair only once.
       const image_pair_t pair_id =
           Database::ImagePairToPairId(*image_id1, *image_id2);
-
-      // Try every pair only once.
-      if (init_image_pairs_.count(pair_id) > 0) {
+      if (init_image_pairs_.count(pair_id) > 0 ||
+          std::any_of(candidates.begin(), candidates.end(),
+                      [pair_id](const InitialImagePair& candidate) {
+                        return Database::ImagePairToPairId(
+                                   candidate.image_id1, candidate.image_id2) ==
+                               pair_id;
+                      })) {
         continue;
       }
 
-      init_image_pairs_.insert(pair_id);
+      InitialImagePair candidate;
+      candidate.image_id1 = *image_id1;
+      candidate.image_id2 = *image_id2;
+      candidate.success = false;
+      candidates.push_back(candidate);
+    }
+
+    if (candidates.empty()) {
+      break;
+    }
 
-      if (EstimateInitialTwoViewGeometry(options, *image_id1, *image_id2)) {
-        return true;
+    auto EstimateCandidate = [&](InitialImagePair* candidate) {
+      ScopedPRNGSeed scoped_prng_seed(ImagePairPRNGSeed(
+          seed, Database::ImagePairToPairId(candidate->image_id1,
+                                            candidate->image_id2)));
+      candidate->success = EstimateInitialTwoViewGeometry(
+          options, candidate->image_id1, candidate->image_id2,
+          &candidate->two_view_geometry);
+    };
+
+    if (thread_pool && candidates.size() > 1) {
+      std::vector<std::future<void>> futures;
+      futures.reserve(candidates.size());
+      for (auto& candidate : candidates) {
+        futures.push_back(thread_pool->AddTask(EstimateCandidate, &candidate));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    } else {
+      for (auto& candidate : candidates) {
+        EstimateCandidate(&candidate);
       }
     }
+
+    // Among the successful pairs, prefer many inliers, a wide baseline, and
+    // many observations of both images, which predict how well the model can
+    // grow from the pair. The pairs are only marked as tried if they failed or
+    // are selected, so that other good pairs remain for later models.
+    const InitialImagePair* best_candidate = nullptr;
+    double best_score = 0;
+    for (const auto& candidate : candidates) {
+      if (!candidate.success) {
+        init_image_pairs_.insert(Database::ImagePairToPairId(
+            candidate.image_id1, candidate.image_id2));
+        continue;
+      }
+      const double score =
+          candidate.two_view_geometry.inlier_matches.size() *
+          candidate.two_view_geometry.tri_angle *
+          (correspondence_graph.NumObservationsForImage(candidate.image_id1) +
+           correspondence_graph.NumObservationsForImage(candidate.image_id2));
+      if (best_candidate == nullptr || score > best_score) {
+        best_candidate = &candidate;
+        best_score = score;
+      }
+    }
+
+    if (best_candidate != nullptr) {
+      *image_id1 = best_candidate->image_id1;
+      *image_id2 = best_candidate->image_id2;
+      const image_pair_t pair_id =
+          Database::ImagePairToPairId(*image_id1, *image_id2);
+      init_image_pairs_.insert(pair_id);
+      prev_init_image_pair_id_ = pair_id;
+      prev_init_two_view_geometry_ = best_candidate->two_view_geometry;
+      return true;
+    }
   }
 
   // No suitable pair found in entire dataset.
@@ -200,57 +547,50 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
 }
 
 std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
+  const TraceSpan trace_span("mapper/find_next_images");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK(options.Check());
 
-  std::function<float(const Image&)> rank_image_func;
-  switch (options.image_selection_method) {
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_NUM:
-      rank_image_func = RankNextImageMaxVisiblePointsNum;
-      break;
-    case Options::ImageSelectionMethod::MAX_VISIBLE_POINTS_RATIO:
-      rank_image_func = RankNextImageMaxVisiblePointsRatio;
-      break;
-    case Options::ImageSelectionMethod::MIN_UNCERTAINTY:
-      rank_image_func = RankNextImageMinUncertainty;
-      break;
-  }
-
-  std::vector<std::pair<image_t, float>> image_ranks;
-  std::vector<std::pair<image_t, float>> other_image_ranks;
-
-  // Append images that have not failed to register before.
-  for (const auto& image : reconstruction_->Images()) {
-    // Skip images that are already registered.
-    if (image.second.IsRegistered()) {
-      continue;
+  // The candidates are maintained incrementally, such that only the images
+  // with modified visibility, registration, or registration trials must be
+  // re-ranked. All images are ranked initially and if the options change.
+  if (!next_image_ranks_valid_ ||
+      next_image_selection_method_ != options.image_selection_method ||
+      next_image_min_num_inliers_ != options.abs_pose_min_num_inliers ||
+      next_image_max_reg_trials_ != options.max_reg_trials) {
+    next_image_ranks_.clear();
+    next_other_image_ranks_.clear();
+    next_image_rank_entries_.clear();
+    next_image_ranks_valid_ = true;
+    next_image_selection_method_ = options.image_selection_method;
+    next_image_min_num_inliers_ = options.abs_pose_min_num_inliers;
+    next_image_max_reg_trials_ = options.max_reg_trials;
+    for (const auto& image : reconstruction_->Images()) {
+      UpdateNextImageRank(options, image.first);
     }
-
-    // Only consider images with a sufficient number of visible points.
-    if (image.second.NumVisiblePoints3D() <
-        static_cast<size_t>(options.abs_pose_min_num_inliers)) {
-      continue;
-    }
-
-    // Only try registration for a certain maximum number of times.
-    const size_t num_reg_trials = num_reg_trials_[image.first];
-    if (num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
-      continue;
+  } else {
+    for (const image_t image_id : next_image_modified_ids_) {
+      UpdateNextImageRank(options, image_id);
     }
-
-    // If image has been filtered or failed to register, place it in the
-    // second bucket and prefer images that have not been tried before.
-    const float rank = rank_image_func(image.second);
-    if (filtered_images_.count(image.first) == 0 && num_reg_trials == 0) {
-      image_ranks.emplace_back(image.first, rank);
-    } else {
-      other_image_ranks.emplace_back(image.first, rank);
+    for (const image_t image_id :
+         reconstruction_->ModifiedVisibilityImageIds()) {
+      UpdateNextImageRank(options, image_id);
     }
   }
 
+  next_image_modified_ids_.clear();
+  reconstruction_->ClearModifiedVisibilityImageIds();
+
+  // Prefer images that have not been filtered or failed to register before.
   std::vector<image_t> ranked_images_ids;
-  SortAndAppendNextImages(image_ranks, &ranked_images_ids);
-  SortAndAppendNextImages(other_image_ranks, &ranked_images_ids);
+  ranked_images_ids.reserve(next_image_rank_entries_.size());
+  for (const auto& image_rank : next_image_ranks_) {
+    ranked_images_ids.push_back(image_rank.second);
+  }
+  for (const auto& image_rank : next_other_image_ranks_) {
+    ranked_images_ids.push_back(image_rank.second);
+  }
 
   return ranked_images_ids;
 }
@@ -258,6 +598,8 @@ std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
 bool IncrementalMapper::RegisterInitialImagePair(const Options& options,
                                                  const image_t image_id1,
                                                  const image_t image_id2) {
+  const TraceSpan trace_span("mapper/register_initial");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK_EQ(reconstruction_->NumRegImages(), 0);
 
@@ -267,6 +609,8 @@ bool IncrementalMapper::RegisterInitialImagePair(const Options& options,
   init_num_reg_trials_[image_id2] += 1;
   num_reg_trials_[image_id1] += 1;
   num_reg_trials_[image_id2] += 1;
+  next_image_modified_ids_.insert(image_id1);
+  next_image_modified_ids_.insert(image_id2);
 
   const image_pair_t pair_id =
       Database::ImagePairToPairId(image_id1, image_id2);
@@ -300,10 +644,17 @@ bool IncrementalMapper::RegisterInitialImagePair(const Options& options,
   // Update Reconstruction
   //////////////////////////////////////////////////////////////////////////////
 
+  // Concurrently reconstructed models must not start from the same images.
+  const bool kExclusive = true;
+  if (!RegisterImageEvent(image_id1, kExclusive)) {
+    return false;
+  }
+  if (!RegisterImageEvent(image_id2, kExclusive)) {
+    DeRegisterImageEvent(image_id1);
+    return false;
+  }
   reconstruction_->RegisterImage(image_id1);
   reconstruction_->RegisterImage(image_id2);
-  RegisterImageEvent(image_id1);
-  RegisterImageEvent(image_id2);
 
   const CorrespondenceGraph& correspondence_graph =
       database_cache_->CorrespondenceGraph();
@@ -343,17 +694,77 @@ bool IncrementalMapper::RegisterInitialImagePair(const Options& options,
 
 bool IncrementalMapper::RegisterNextImage(const Options& options,
                                           const image_t image_id) {
+  const TraceSpan trace_span("mapper/register");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK_GE(reconstruction_->NumRegImages(), 2);
 
   CHECK(options.Check());
 
-  Image& image = reconstruction_->Image(image_id);
-  Camera& camera = reconstruction_->Camera(image.CameraId());
-
-  CHECK(!image.IsRegistered()) << "Image cannot be registered multiple times";
+  CHECK(!reconstruction_->Image(image_id).IsRegistered())
+      << "Image cannot be registered multiple times";
 
   num_reg_trials_[image_id] += 1;
+  next_image_modified_ids_.insert(image_id);
+
+  NextImagePose pose;
+  if (!EstimateNextImagePose(options, image_id, &pose)) {
+    return false;
+  }
+
+  return RegisterNextImagePose(pose);
+}
+
+bool IncrementalMapper::RegisterNextImage(const Options& options,
+                                          const NextImagePose& pose) {
+  const TraceSpan trace_span("mapper/register");
+
+  CHECK_NOTNULL(reconstruction_);
+  CHECK_GE(reconstruction_->NumRegImages(), 2);
+
+  CHECK(options.Check());
+
+  CHECK(!reconstruction_->Image(pose.image_id).IsRegistered())
+      << "Image cannot be registered multiple times";
+
+  num_reg_trials_[pose.image_id] += 1;
+  next_image_modified_ids_.insert(pose.image_id);
+
+  // The estimate is final, if no images were registered since.
+  if (pose.num_reg_image_events == num_reg_image_events_) {
+    return pose.success && RegisterNextImagePose(pose);
+  }
+
+  if (pose.success) {
+    NextImagePose validated_pose = pose;
+    if (ValidateNextImagePose(options, &validated_pose)) {
+      return RegisterNextImagePose(validated_pose);
+    }
+  }
+
+  // The estimate is outdated, so estimate the pose against the current model.
+  NextImagePose current_pose;
+  if (!EstimateNextImagePose(options, pose.image_id, &current_pose)) {
+    return false;
+  }
+
+  return RegisterNextImagePose(current_pose);
+}
+
+bool IncrementalMapper::EstimateNextImagePose(const Options& options,
+                                              const image_t image_id,
+                                              NextImagePose* pose) const {
+  CHECK_NOTNULL(reconstruction_);
+  CHECK(options.Check());
+
+  pose->image_id = image_id;
+  pose->success = false;
+  pose->num_reg_image_events = num_reg_image_events_;
+  pose->tri_corrs.clear();
+  pose->inlier_mask.clear();
+
+  const Image& image = reconstruction_->Image(image_id);
+  Camera camera = reconstruction_->Camera(image.CameraId());
 
   // Check if enough 2D-3D correspondences.
   if (image.NumVisiblePoints3D() <
@@ -365,24 +776,29 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // Search for 2D-3D correspondences
   //////////////////////////////////////////////////////////////////////////////
 
-  const int kCorrTransitivity = 1;
-
-  std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+  std::vector<std::pair<point2D_t, point3D_t>>& tri_corrs = pose->tri_corrs;
   std::vector<Eigen::Vector2d> tri_points2D;
   std::vector<Eigen::Vector3d> tri_points3D;
+  tri_corrs.reserve(image.NumVisiblePoints3D());
+  tri_points2D.reserve(image.NumVisiblePoints3D());
+  tri_points3D.reserve(image.NumVisiblePoints3D());
 
-  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-       ++point2D_idx) {
-    const Point2D& point2D = image.Point2D(point2D_idx);
-    const CorrespondenceGraph& correspondence_graph =
-        database_cache_->CorrespondenceGraph();
-    const std::vector<CorrespondenceGraph::Correspondence> corrs =
-        correspondence_graph.FindTransitiveCorrespondences(
-            image_id, point2D_idx, kCorrTransitivity);
+  // Only the image points with a triangulated correspondence can have 2D-3D
+  // correspondences. They are maintained by the reconstruction, so that the
+  // remaining image points need not be visited. The points are sorted to
+  // collect the correspondences in a deterministic order.
+  std::vector<point2D_t> visible_point2D_idxs = image.VisiblePoints2D();
+  std::sort(visible_point2D_idxs.begin(), visible_point2D_idxs.end());
 
-    std::unordered_set<point3D_t> point3D_ids;
+  const CorrespondenceGraph& correspondence_graph =
+      database_cache_->CorrespondenceGraph();
 
-    for (const auto corr : corrs) {
+  for (const point2D_t point2D_idx : visible_point2D_idxs) {
+    const Point2D& point2D = image.Point2D(point2D_idx);
+    const size_t num_point_tri_corrs = tri_corrs.size();
+
+    for (const auto& corr :
+         correspondence_graph.FindCorrespondences(image_id, point2D_idx)) {
       const Image& corr_image = reconstruction_->Image(corr.image_id);
       if (!corr_image.IsRegistered()) {
         continue;
@@ -393,8 +809,14 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
         continue;
       }
 
-      // Avoid duplicate correspondences.
-      if (point3D_ids.count(corr_point2D.Point3DId()) > 0) {
+      // Avoid duplicate correspondences. An image point only has a few
+      // correspondences, so a linear search is cheaper than a hash set.
+      const point3D_t point3D_id = corr_point2D.Point3DId();
+      if (std::any_of(tri_corrs.begin() + num_point_tri_corrs, tri_corrs.end(),
+                      [point3D_id](
+                          const std::pair<point2D_t, point3D_t>& tri_corr) {
+                        return tri_corr.second == point3D_id;
+                      })) {
         continue;
       }
 
@@ -408,11 +830,9 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
         continue;
       }
 
-      const Point3D& point3D =
-          reconstruction_->Point3D(corr_point2D.Point3DId());
+      const Point3D& point3D = reconstruction_->Point3D(point3D_id);
 
-      tri_corrs.emplace_back(point2D_idx, corr_point2D.Point3DId());
-      point3D_ids.insert(corr_point2D.Point3DId());
+      tri_corrs.emplace_back(point2D_idx, point3D_id);
       tri_points2D.push_back(point2D.XY());
       tri_points3D.push_back(point3D.XYZ());
     }
@@ -426,6 +846,37 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     return false;
   }
 
+  // Order the correspondences by the track length of their 3D points for
+  // progressive sampling. The sort is stable to keep the order deterministic.
+  if (options.abs_pose_progressive_sampling) {
+    std::vector<size_t> track_lengths(tri_corrs.size());
+    std::vector<size_t> order(tri_corrs.size());
+    for (size_t i = 0; i < tri_corrs.size(); ++i) {
+      track_lengths[i] =
+          reconstruction_->Point3D(tri_corrs[i].second).Track().Length();
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&track_lengths](const size_t idx1, const size_t idx2) {
+                       return track_lengths[idx1] > track_lengths[idx2];
+                     });
+
+    std::vector<std::pair<point2D_t, point3D_t>> ordered_tri_corrs;
+    std::vector<Eigen::Vector2d> ordered_tri_points2D;
+    std::vector<Eigen::Vector3d> ordered_tri_points3D;
+    ordered_tri_corrs.reserve(order.size());
+    ordered_tri_points2D.reserve(order.size());
+    ordered_tri_points3D.reserve(order.size());
+    for (const size_t idx : order) {
+      ordered_tri_corrs.push_back(tri_corrs[idx]);
+      ordered_tri_points2D.push_back(tri_points2D[idx]);
+      ordered_tri_points3D.push_back(tri_points3D[idx]);
+    }
+    tri_corrs = std::move(ordered_tri_corrs);
+    tri_points2D = std::move(ordered_tri_points2D);
+    tri_points3D = std::move(ordered_tri_points3D);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // 2D-3D estimation
   //////////////////////////////////////////////////////////////////////////////
@@ -437,6 +888,7 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
 
   AbsolutePoseEstimationOptions abs_pose_options;
   abs_pose_options.num_threads = options.num_threads;
+  abs_pose_options.progressive_sampling = options.abs_pose_progressive_sampling;
   abs_pose_options.num_focal_length_samples = 30;
   abs_pose_options.min_focal_length_ratio = options.min_focal_length_ratio;
   abs_pose_options.max_focal_length_ratio = options.max_focal_length_ratio;
@@ -450,7 +902,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   abs_pose_options.ransac_options.confidence = 0.99999;
 
   AbsolutePoseRefinementOptions abs_pose_refinement_options;
-  if (num_reg_images_per_camera_[image.CameraId()] > 0) {
+  pose->refined_camera = true;
+  if (NumRegImagesForCamera(image.CameraId()) > 0) {
     // Camera already refined from another image with the same camera.
     if (camera.HasBogusParams(options.min_focal_length_ratio,
                               options.max_focal_length_ratio,
@@ -465,6 +918,7 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
       abs_pose_options.estimate_focal_length = false;
       abs_pose_refinement_options.refine_focal_length = false;
       abs_pose_refinement_options.refine_extra_params = false;
+      pose->refined_camera = false;
     }
   } else {
     // Camera not refined before. Note that the camera parameters might have
@@ -486,11 +940,9 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   }
 
   size_t num_inliers;
-  std::vector<char> inlier_mask;
-
   if (!EstimateAbsolutePose(abs_pose_options, tri_points2D, tri_points3D,
-                            &image.Qvec(), &image.Tvec(), &camera, &num_inliers,
-                            &inlier_mask)) {
+                            &pose->qvec, &pose->tvec, &camera, &num_inliers,
+                            &pose->inlier_mask)) {
     return false;
   }
 
@@ -502,25 +954,81 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // Pose refinement
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!RefineAbsolutePose(abs_pose_refinement_options, inlier_mask,
-                          tri_points2D, tri_points3D, &image.Qvec(),
-                          &image.Tvec(), &camera)) {
+  if (!RefineAbsolutePose(abs_pose_refinement_options, pose->inlier_mask,
+                          tri_points2D, tri_points3D, &pose->qvec, &pose->tvec,
+                          &camera)) {
     return false;
   }
 
+  pose->camera_params = camera.Params();
+  pose->success = true;
+
+  return true;
+}
+
+bool IncrementalMapper::ValidateNextImagePose(const Options& options,
+                                              NextImagePose* pose) const {
+  const Image& image = reconstruction_->Image(pose->image_id);
+
+  // The camera parameters must not be changed once they are refined from
+  // another registered image.
+  Camera camera = reconstruction_->Camera(image.CameraId());
+  if (pose->refined_camera) {
+    if (NumRegImagesForCamera(image.CameraId()) > 0) {
+      return false;
+    }
+    camera.SetParams(pose->camera_params);
+  }
+
+  // Only keep the inliers whose 3D points still exist and are consistent with
+  // the pose after the reconstruction changed.
+  const double max_squared_error =
+      options.abs_pose_max_error * options.abs_pose_max_error;
+  size_t num_inliers = 0;
+  for (size_t i = 0; i < pose->inlier_mask.size(); ++i) {
+    if (!pose->inlier_mask[i]) {
+      continue;
+    }
+    const point3D_t point3D_id = pose->tri_corrs[i].second;
+    if (!reconstruction_->ExistsPoint3D(point3D_id) ||
+        CalculateSquaredReprojectionError(
+            image.Point2D(pose->tri_corrs[i].first).XY(),
+            reconstruction_->Point3D(point3D_id).XYZ(), pose->qvec,
+            pose->tvec, camera) > max_squared_error) {
+      pose->inlier_mask[i] = false;
+      continue;
+    }
+    num_inliers += 1;
+  }
+
+  return num_inliers >= static_cast<size_t>(options.abs_pose_min_num_inliers);
+}
+
+bool IncrementalMapper::RegisterNextImagePose(const NextImagePose& pose) {
+  const image_t image_id = pose.image_id;
+  Image& image = reconstruction_->Image(image_id);
+
   //////////////////////////////////////////////////////////////////////////////
   // Continue tracks
   //////////////////////////////////////////////////////////////////////////////
 
+  if (!RegisterImageEvent(image_id)) {
+    return false;
+  }
+
+  image.Qvec() = pose.qvec;
+  image.Tvec() = pose.tvec;
+  if (pose.refined_camera) {
+    reconstruction_->Camera(image.CameraId()).SetParams(pose.camera_params);
+  }
   reconstruction_->RegisterImage(image_id);
-  RegisterImageEvent(image_id);
 
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
-      const point2D_t point2D_idx = tri_corrs[i].first;
+  for (size_t i = 0; i < pose.inlier_mask.size(); ++i) {
+    if (pose.inlier_mask[i]) {
+      const point2D_t point2D_idx = pose.tri_corrs[i].first;
       const Point2D& point2D = image.Point2D(point2D_idx);
       if (!point2D.HasPoint3D()) {
-        const point3D_t point3D_id = tri_corrs[i].second;
+        const point3D_t point3D_id = pose.tri_corrs[i].second;
         const TrackElement track_el(image_id, point2D_idx);
         reconstruction_->AddObservation(point3D_id, track_el);
         triangulator_->AddModifiedPoint3D(point3D_id);
@@ -534,24 +1042,40 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
 size_t IncrementalMapper::TriangulateImage(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id) {
+  const TraceSpan trace_span("mapper/triangulate");
+
   CHECK_NOTNULL(reconstruction_);
   return triangulator_->TriangulateImage(tri_options, image_id);
 }
 
+size_t IncrementalMapper::TriangulateAllImages(
+    const IncrementalTriangulator::Options& tri_options) {
+  const TraceSpan trace_span("mapper/triangulate_all");
+
+  CHECK_NOTNULL(reconstruction_);
+  return triangulator_->TriangulateAllImages(tri_options);
+}
+
 size_t IncrementalMapper::Retriangulate(
     const IncrementalTriangulator::Options& tri_options) {
+  const TraceSpan trace_span("mapper/retriangulate");
+
   CHECK_NOTNULL(reconstruction_);
   return triangulator_->Retriangulate(tri_options);
 }
 
 size_t IncrementalMapper::CompleteTracks(
     const IncrementalTriangulator::Options& tri_options) {
+  const TraceSpan trace_span("mapper/complete_tracks");
+
   CHECK_NOTNULL(reconstruction_);
   return triangulator_->CompleteAllTracks(tri_options);
 }
 
 size_t IncrementalMapper::MergeTracks(
     const IncrementalTriangulator::Options& tri_options) {
+  const TraceSpan trace_span("mapper/merge_tracks");
+
   CHECK_NOTNULL(reconstruction_);
   return triangulator_->MergeAllTracks(tri_options);
 }
@@ -561,6 +1085,8 @@ IncrementalMapper::AdjustLocalBundle(
     const Options& options, const BundleAdjustmentOptions& ba_options,
     const IncrementalTriangulator::Options& tri_options, const image_t image_id,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  const TraceSpan trace_span("mapper/local_ba");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK(options.Check());
 
@@ -602,11 +1128,13 @@ IncrementalMapper::AdjustLocalBundle(
       }
     }
 
-    // Fix 7 DOF to avoid scale/rotation/translation drift in bundle adjustment.
-    if (local_bundle.size() == 1) {
+    // Fix 7 DOF to avoid scale/rotation/translation drift in bundle adjustment,
+    // unless the position priors of the images fix them.
+    const bool has_prior_gauge = SetPositionPriors(options, &ba_config);
+    if (!has_prior_gauge && local_bundle.size() == 1) {
       ba_config.SetConstantPose(local_bundle[0]);
       ba_config.SetConstantTvec(image_id, {0});
-    } else if (local_bundle.size() > 1) {
+    } else if (!has_prior_gauge && local_bundle.size() > 1) {
       const image_t image_id1 = local_bundle[local_bundle.size() - 1];
       const image_t image_id2 = local_bundle[local_bundle.size() - 2];
       ba_config.SetConstantPose(image_id1);
@@ -631,12 +1159,22 @@ IncrementalMapper::AdjustLocalBundle(
       }
     }
 
-    // Adjust the local bundle.
-    BundleAdjuster bundle_adjuster(ba_options, ba_config);
-    bundle_adjuster.Solve(reconstruction_);
-
-    report.num_adjusted_observations =
-        bundle_adjuster.Summary().num_residuals / 2;
+    // Adjust the local bundle. The reused problem does not support priors.
+    if (options.local_ba_reuse_problem && ba_config.NumPositionPriors() == 0) {
+      // The options of the first local bundle adjustment are used for all
+      // subsequent ones of the same reconstruction.
+      if (!local_bundle_adjuster_) {
+        local_bundle_adjuster_.reset(new IncrementalBundleAdjuster(ba_options));
+      }
+      local_bundle_adjuster_->Solve(ba_config, reconstruction_);
+      report.num_adjusted_observations =
+          local_bundle_adjuster_->Summary().num_residuals / 2;
+    } else {
+      BundleAdjuster bundle_adjuster(ba_options, ba_config);
+      bundle_adjuster.Solve(reconstruction_);
+      report.num_adjusted_observations =
+          bundle_adjuster.Summary().num_residuals / 2;
+    }
 
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
@@ -670,6 +1208,8 @@ IncrementalMapper::AdjustLocalBundle(
 
 bool IncrementalMapper::AdjustGlobalBundle(
     const Options& options, const BundleAdjustmentOptions& ba_options) {
+  const TraceSpan trace_span("mapper/global_ba");
+
   CHECK_NOTNULL(reconstruction_);
 
   const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
@@ -681,6 +1221,8 @@ bool IncrementalMapper::AdjustGlobalBundle(
   // Avoid degeneracies in bundle adjustment.
   reconstruction_->FilterObservationsWithNegativeDepth();
 
+  AlignToPriorPositions(options);
+
   // Configure bundle adjustment.
   BundleAdjustmentConfig ba_config;
   for (const image_t image_id : reg_image_ids) {
@@ -696,29 +1238,67 @@ bool IncrementalMapper::AdjustGlobalBundle(
     }
   }
 
-  // Fix 7-DOFs of the bundle adjustment problem.
-  ba_config.SetConstantPose(reg_image_ids[0]);
-  if (!options.fix_existing_images ||
-      !existing_image_ids_.count(reg_image_ids[1])) {
-    ba_config.SetConstantTvec(reg_image_ids[1], {0});
+  // Fix 7-DOFs of the bundle adjustment problem, unless the position priors
+  // of the images fix them.
+  if (!SetPositionPriors(options, &ba_config)) {
+    ba_config.SetConstantPose(reg_image_ids[0]);
+    if (!options.fix_existing_images ||
+        !existing_image_ids_.count(reg_image_ids[1])) {
+      ba_config.SetConstantTvec(reg_image_ids[1], {0});
+    }
   }
 
-  // Run bundle adjustment.
-  BundleAdjuster bundle_adjuster(ba_options, ba_config);
-  if (!bundle_adjuster.Solve(reconstruction_)) {
-    return false;
+  // Only optimize over a subset of the points, if option specified.
+  if (options.global_ba_max_num_points_per_image > 0) {
+    ba_config.SetPointSubset(SelectGlobalBundlePoints3D(
+        *reconstruction_, reg_image_ids,
+        static_cast<size_t>(options.global_ba_max_num_points_per_image)));
+  }
+
+  // Run bundle adjustment. The reused problem does not support priors.
+  if (options.global_ba_reuse_problem && !ba_config.HasPointSubset() &&
+      ba_config.NumPositionPriors() == 0) {
+    // The structural options of the first global bundle adjustment are used
+    // for all subsequent ones of the same reconstruction, while the solver
+    // options may change between calls.
+    if (!global_bundle_adjuster_) {
+      const bool kWarmStart = true;
+      global_bundle_adjuster_.reset(
+          new IncrementalBundleAdjuster(ba_options, kWarmStart));
+    } else {
+      global_bundle_adjuster_->SetSolverOptions(ba_options.solver_options);
+    }
+    if (!global_bundle_adjuster_->Solve(ba_config, reconstruction_)) {
+      return false;
+    }
+  } else {
+    BundleAdjuster bundle_adjuster(ba_options, ba_config);
+    if (!bundle_adjuster.Solve(reconstruction_)) {
+      return false;
+    }
+  }
+
+  // Refine the remaining points with respect to the adjusted cameras.
+  if (ba_config.HasPointSubset()) {
+    AdjustRemainingPoints3D(ba_options, reg_image_ids, ba_config.PointSubset(),
+                            reconstruction_);
   }
 
   // Normalize scene for numerical stability and
-  // to avoid large scale changes in viewer.
-  reconstruction_->Normalize();
+  // to avoid large scale changes in viewer. A reconstruction that is aligned
+  // to the position priors must stay in their frame.
+  if (!prior_positions_aligned_) {
+    reconstruction_->Normalize();
+  }
 
   return true;
 }
 
 bool IncrementalMapper::AdjustParallelGlobalBundle(
-    const BundleAdjustmentOptions& ba_options,
+    const Options& options, const BundleAdjustmentOptions& ba_options,
     const ParallelBundleAdjuster::Options& parallel_ba_options) {
+  const TraceSpan trace_span("mapper/global_ba");
+
   CHECK_NOTNULL(reconstruction_);
 
   const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
@@ -735,6 +1315,17 @@ bool IncrementalMapper::AdjustParallelGlobalBundle(
     ba_config.AddImage(image_id);
   }
 
+  // Fix the existing images, if option specified.
+  if (options.fix_existing_images) {
+    for (const image_t image_id : reg_image_ids) {
+      if (existing_image_ids_.count(image_id)) {
+        ba_config.SetConstantPose(image_id);
+        ba_config.SetConstantCamera(
+            reconstruction_->Image(image_id).CameraId());
+      }
+    }
+  }
+
   // Run bundle adjustment.
   ParallelBundleAdjuster bundle_adjuster(parallel_ba_options, ba_options,
                                          ba_config);
@@ -743,13 +1334,85 @@ bool IncrementalMapper::AdjustParallelGlobalBundle(
   }
 
   // Normalize scene for numerical stability and
-  // to avoid large scale changes in viewer.
-  reconstruction_->Normalize();
+  // to avoid large scale changes in viewer. A reconstruction that is aligned
+  // to the position priors must stay in their frame.
+  if (!prior_positions_aligned_) {
+    reconstruction_->Normalize();
+  }
+
+  return true;
+}
+
+bool IncrementalMapper::AdjustPartitionedGlobalBundle(
+    const Options& options, const BundleAdjustmentOptions& ba_options,
+    const PartitionedBundleAdjuster::Options& partitioned_ba_options) {
+  const TraceSpan trace_span("mapper/global_ba");
+
+  CHECK_NOTNULL(reconstruction_);
+
+  const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
+
+  CHECK_GE(reg_image_ids.size(), 2)
+      << "At least two images must be registered for global bundle-adjustment";
+
+  // Avoid degeneracies in bundle adjustment.
+  reconstruction_->FilterObservationsWithNegativeDepth();
+
+  // Configure bundle adjustment.
+  BundleAdjustmentConfig ba_config;
+  for (const image_t image_id : reg_image_ids) {
+    ba_config.AddImage(image_id);
+  }
+
+  // Fix the existing images, if option specified.
+  if (options.fix_existing_images) {
+    for (const image_t image_id : reg_image_ids) {
+      if (existing_image_ids_.count(image_id)) {
+        ba_config.SetConstantPose(image_id);
+      }
+    }
+  }
+
+  // Fix 7-DOFs of the bundle adjustment problem.
+  ba_config.SetConstantPose(reg_image_ids[0]);
+  if (!options.fix_existing_images ||
+      !existing_image_ids_.count(reg_image_ids[1])) {
+    ba_config.SetConstantTvec(reg_image_ids[1], {0});
+  }
+
+  // Only optimize over a subset of the points, if option specified.
+  if (options.global_ba_max_num_points_per_image > 0) {
+    ba_config.SetPointSubset(SelectGlobalBundlePoints3D(
+        *reconstruction_, reg_image_ids,
+        static_cast<size_t>(options.global_ba_max_num_points_per_image)));
+  }
+
+  // Run bundle adjustment.
+  PartitionedBundleAdjuster bundle_adjuster(partitioned_ba_options, ba_options,
+                                            ba_config);
+  if (!bundle_adjuster.Solve(reconstruction_)) {
+    return false;
+  }
+
+  // Refine the remaining points with respect to the adjusted cameras.
+  if (ba_config.HasPointSubset()) {
+    AdjustRemainingPoints3D(ba_options, reg_image_ids, ba_config.PointSubset(),
+                            reconstruction_);
+  }
+
+  // Normalize scene for numerical stability and
+  // to avoid large scale changes in viewer. A reconstruction that is aligned
+  // to the position priors must stay in their frame.
+  if (!prior_positions_aligned_) {
+    reconstruction_->Normalize();
+  }
 
   return true;
 }
 
 size_t IncrementalMapper::FilterImages(const Options& options) {
+  const TraceSpan trace_span("mapper/filter");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK(options.Check());
 
@@ -768,12 +1431,15 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
   for (const image_t image_id : image_ids) {
     DeRegisterImageEvent(image_id);
     filtered_images_.insert(image_id);
+    next_image_modified_ids_.insert(image_id);
   }
 
   return image_ids.size();
 }
 
 size_t IncrementalMapper::FilterPoints(const Options& options) {
+  const TraceSpan trace_span("mapper/filter");
+
   CHECK_NOTNULL(reconstruction_);
   CHECK(options.Check());
   return reconstruction_->FilterAllPoints3D(options.filter_max_reproj_error,
@@ -786,6 +1452,9 @@ const Reconstruction& IncrementalMapper::GetReconstruction() const {
 }
 
 size_t IncrementalMapper::NumTotalRegImages() const {
+  if (image_claims_ != nullptr) {
+    return image_claims_->NumClaimedImages();
+  }
   return num_total_reg_images_;
 }
 
@@ -793,6 +1462,35 @@ size_t IncrementalMapper::NumSharedRegImages() const {
   return num_shared_reg_images_;
 }
 
+bool IncrementalMapper::IsAlignedToPriorPositions() const {
+  return prior_positions_aligned_;
+}
+
+IncrementalMapper::State IncrementalMapper::GetState() const {
+  State state;
+  state.init_num_reg_trials = init_num_reg_trials_;
+  state.init_image_pairs = init_image_pairs_;
+  state.num_registrations = num_registrations_;
+
+  if (reconstruction_ != nullptr) {
+    // The registrations in the current reconstruction are restored from the
+    // resumed reconstruction.
+    for (const image_t image_id : reconstruction_->RegImageIds()) {
+      const auto num_registrations_it = state.num_registrations.find(image_id);
+      if (num_registrations_it != state.num_registrations.end() &&
+          num_registrations_it->second > 0) {
+        num_registrations_it->second -= 1;
+      }
+    }
+
+    state.existing_image_ids = existing_image_ids_;
+    state.filtered_images = filtered_images_;
+    state.num_reg_trials = num_reg_trials_;
+  }
+
+  return state;
+}
+
 const std::unordered_set<point3D_t>& IncrementalMapper::GetModifiedPoints3D() {
   return triangulator_->GetModifiedPoints3D();
 }
@@ -831,8 +1529,7 @@ std::vector<image_t> IncrementalMapper::FindFirstInitialImage(
 
     // Only use images for initialization that are not registered in any
     // of the other reconstructions.
-    if (num_registrations_.count(image.first) > 0 &&
-        num_registrations_.at(image.first) > 0) {
+    if (NumRegistrations(image.first) > 0) {
       continue;
     }
 
@@ -884,8 +1581,7 @@ std::vector<image_t> IncrementalMapper::FindSecondInitialImage(
        ++point2D_idx) {
     for (const auto& corr :
          correspondence_graph.FindCorrespondences(image_id1, point2D_idx)) {
-      if (num_registrations_.count(corr.image_id) == 0 ||
-          num_registrations_.at(corr.image_id) == 0) {
+      if (NumRegistrations(corr.image_id) == 0) {
         num_correspondences[corr.image_id] += 1;
       }
     }
@@ -950,24 +1646,10 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   CHECK(image.IsRegistered());
 
   // Extract all images that have at least one 3D point with the query image
-  // in common, and simultaneously count the number of common 3D points.
+  // in common, together with the number of common observations.
 
-  std::unordered_map<image_t, size_t> shared_observations;
-
-  std::unordered_set<point3D_t> point3D_ids;
-  point3D_ids.reserve(image.NumPoints3D());
-
-  for (const Point2D& point2D : image.Points2D()) {
-    if (point2D.HasPoint3D()) {
-      point3D_ids.insert(point2D.Point3DId());
-      const Point3D& point3D = reconstruction_->Point3D(point2D.Point3DId());
-      for (const TrackElement& track_el : point3D.Track().Elements()) {
-        if (track_el.image_id != image_id) {
-          shared_observations[track_el.image_id] += 1;
-        }
-      }
-    }
-  }
+  const std::unordered_map<image_t, size_t>& shared_observations =
+      reconstruction_->CovisibleImages(image_id);
 
   // Sort overlapping images according to number of shared observations.
 
@@ -1023,8 +1705,9 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   }};
 
   const Eigen::Vector3d proj_center = image.ProjectionCenter();
+  // The 3D points of the query image, collected once for the triangulation
+  // angles to all overlapping images.
   std::vector<Eigen::Vector3d> shared_points3D;
-  shared_points3D.reserve(image.NumPoints3D());
   std::vector<double> tri_angles(overlapping_images.size(), -1.0);
   std::vector<char> used_overlapping_images(overlapping_images.size(), false);
 
@@ -1053,12 +1736,13 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
       // iterations, reuse the previously computed value.
       double& tri_angle = tri_angles[overlapping_image_idx];
       if (tri_angle < 0.0) {
-        // Collect the commonly observed 3D points.
-        shared_points3D.clear();
-        for (const Point2D& point2D : image.Points2D()) {
-          if (point2D.HasPoint3D() && point3D_ids.count(point2D.Point3DId())) {
-            shared_points3D.push_back(
-                reconstruction_->Point3D(point2D.Point3DId()).XYZ());
+        if (shared_points3D.empty()) {
+          shared_points3D.reserve(image.NumPoints3D());
+          for (const Point2D& point2D : image.Points2D()) {
+            if (point2D.HasPoint3D()) {
+              shared_points3D.push_back(
+                  reconstruction_->Point3D(point2D.Point3DId()).XYZ());
+            }
           }
         }
 
@@ -1111,37 +1795,137 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   return local_bundle_image_ids;
 }
 
-void IncrementalMapper::RegisterImageEvent(const image_t image_id) {
+bool IncrementalMapper::RegisterImageEvent(const image_t image_id,
+                                           const bool exclusive) {
+  bool shared = false;
+  if (image_claims_ == nullptr) {
+    size_t& num_regs_for_image = num_registrations_[image_id];
+    num_regs_for_image += 1;
+    if (num_regs_for_image == 1) {
+      num_total_reg_images_ += 1;
+    } else if (num_regs_for_image > 1) {
+      shared = true;
+    }
+  } else if (exclusive) {
+    if (!image_claims_->ClaimExclusive(image_id)) {
+      return false;
+    }
+  } else if (!image_claims_->Claim(image_id, num_shared_reg_images_,
+                                   &shared)) {
+    return false;
+  }
+
+  if (shared) {
+    num_shared_reg_images_ += 1;
+  }
+
+  num_reg_image_events_ += 1;
+  next_image_modified_ids_.insert(image_id);
+
   const Image& image = reconstruction_->Image(image_id);
   size_t& num_reg_images_for_camera =
       num_reg_images_per_camera_[image.CameraId()];
   num_reg_images_for_camera += 1;
 
-  size_t& num_regs_for_image = num_registrations_[image_id];
-  num_regs_for_image += 1;
-  if (num_regs_for_image == 1) {
-    num_total_reg_images_ += 1;
-  } else if (num_regs_for_image > 1) {
-    num_shared_reg_images_ += 1;
-  }
+  return true;
 }
 
 void IncrementalMapper::DeRegisterImageEvent(const image_t image_id) {
+  num_reg_image_events_ += 1;
+  next_image_modified_ids_.insert(image_id);
+
   const Image& image = reconstruction_->Image(image_id);
   size_t& num_reg_images_for_camera =
       num_reg_images_per_camera_.at(image.CameraId());
   CHECK_GT(num_reg_images_for_camera, 0);
   num_reg_images_for_camera -= 1;
 
-  size_t& num_regs_for_image = num_registrations_[image_id];
-  num_regs_for_image -= 1;
-  if (num_regs_for_image == 0) {
-    num_total_reg_images_ -= 1;
-  } else if (num_regs_for_image > 0) {
+  bool shared = false;
+  if (image_claims_ == nullptr) {
+    size_t& num_regs_for_image = num_registrations_[image_id];
+    num_regs_for_image -= 1;
+    if (num_regs_for_image == 0) {
+      num_total_reg_images_ -= 1;
+    } else if (num_regs_for_image > 0) {
+      shared = true;
+    }
+  } else {
+    shared = image_claims_->Release(image_id);
+  }
+
+  if (shared) {
     num_shared_reg_images_ -= 1;
   }
 }
 
+size_t IncrementalMapper::NumRegImagesForCamera(
+    const camera_t camera_id) const {
+  const auto num_reg_images_it = num_reg_images_per_camera_.find(camera_id);
+  if (num_reg_images_it == num_reg_images_per_camera_.end()) {
+    return 0;
+  }
+  return num_reg_images_it->second;
+}
+
+size_t IncrementalMapper::NumRegistrations(const image_t image_id) const {
+  if (image_claims_ != nullptr) {
+    return image_claims_->NumClaims(image_id);
+  }
+  const auto num_registrations_it = num_registrations_.find(image_id);
+  if (num_registrations_it == num_registrations_.end()) {
+    return 0;
+  }
+  return num_registrations_it->second;
+}
+
+void IncrementalMapper::UpdateNextImageRank(const Options& options,
+                                            const image_t image_id) {
+  const auto entry_it = next_image_rank_entries_.find(image_id);
+  if (entry_it != next_image_rank_entries_.end()) {
+    const auto image_rank = std::make_pair(entry_it->second.first, image_id);
+    if (entry_it->second.second) {
+      next_other_image_ranks_.erase(image_rank);
+    } else {
+      next_image_ranks_.erase(image_rank);
+    }
+    next_image_rank_entries_.erase(entry_it);
+  }
+
+  const Image& image = reconstruction_->Image(image_id);
+
+  // Skip images that are already registered.
+  if (image.IsRegistered()) {
+    return;
+  }
+
+  // Only consider images with a sufficient number of visible points.
+  if (image.NumVisiblePoints3D() <
+      static_cast<size_t>(options.abs_pose_min_num_inliers)) {
+    return;
+  }
+
+  // Only try registration for a certain maximum number of times.
+  const auto num_reg_trials_it = num_reg_trials_.find(image_id);
+  const size_t num_reg_trials = num_reg_trials_it == num_reg_trials_.end()
+                                    ? 0
+                                    : num_reg_trials_it->second;
+  if (num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
+    return;
+  }
+
+  // If image has been filtered or failed to register, place it in the
+  // second bucket and prefer images that have not been tried before.
+  const float rank = RankNextImage(options.image_selection_method, image);
+  const bool is_other =
+      filtered_images_.count(image_id) > 0 || num_reg_trials > 0;
+  if (is_other) {
+    next_other_image_ranks_.emplace(rank, image_id);
+  } else {
+    next_image_ranks_.emplace(rank, image_id);
+  }
+  next_image_rank_entries_.emplace(image_id, std::make_pair(rank, is_other));
+}
+
 bool IncrementalMapper::EstimateInitialTwoViewGeometry(
     const Options& options, const image_t image_id1, const image_t image_id2) {
   const image_pair_t image_pair_id =
@@ -1151,6 +1935,20 @@ bool IncrementalMapper::EstimateInitialTwoViewGeometry(
     return true;
   }
 
+  TwoViewGeometry two_view_geometry;
+  if (EstimateInitialTwoViewGeometry(options, image_id1, image_id2,
+                                     &two_view_geometry)) {
+    prev_init_image_pair_id_ = image_pair_id;
+    prev_init_two_view_geometry_ = two_view_geometry;
+    return true;
+  }
+
+  return false;
+}
+
+bool IncrementalMapper::EstimateInitialTwoViewGeometry(
+    const Options& options, const image_t image_id1, const image_t image_id2,
+    TwoViewGeometry* two_view_geometry) const {
   const Image& image1 = database_cache_->Image(image_id1);
   const Camera& camera1 = database_cache_->Camera(image1.CameraId());
 
@@ -1175,28 +1973,140 @@ bool IncrementalMapper::EstimateInitialTwoViewGeometry(
     points2.push_back(point.XY());
   }
 
-  TwoViewGeometry two_view_geometry;
+  const auto IsValidInitialTwoViewGeometry = [&]() {
+    return static_cast<int>(two_view_geometry->inlier_matches.size()) >=
+               options.init_min_num_inliers &&
+           std::abs(two_view_geometry->tvec.z()) <
+               options.init_max_forward_motion &&
+           two_view_geometry->tri_angle > DegToRad(options.init_min_tri_angle);
+  };
+
+  // The geometry verified during matching only requires to recover the
+  // relative pose, which is much cheaper than estimating it again.
+  if (options.init_reuse_two_view_geometry &&
+      database_cache_->FindTwoViewGeometry(image_id1, image_id2,
+                                           two_view_geometry)) {
+    two_view_geometry->inlier_matches = matches;
+    if (two_view_geometry->EstimateRelativePose(camera1, points1, camera2,
+                                                points2) &&
+        IsValidInitialTwoViewGeometry()) {
+      return true;
+    }
+    *two_view_geometry = TwoViewGeometry();
+  }
+
   TwoViewGeometry::Options two_view_geometry_options;
   two_view_geometry_options.ransac_options.min_num_trials = 30;
   two_view_geometry_options.ransac_options.max_error = options.init_max_error;
-  two_view_geometry.EstimateCalibrated(camera1, points1, camera2, points2,
-                                       matches, two_view_geometry_options);
+  two_view_geometry->EstimateCalibrated(camera1, points1, camera2, points2,
+                                        matches, two_view_geometry_options);
 
-  if (!two_view_geometry.EstimateRelativePose(camera1, points1, camera2,
-                                              points2)) {
+  if (!two_view_geometry->EstimateRelativePose(camera1, points1, camera2,
+                                               points2)) {
     return false;
   }
 
-  if (static_cast<int>(two_view_geometry.inlier_matches.size()) >=
-          options.init_min_num_inliers &&
-      std::abs(two_view_geometry.tvec.z()) < options.init_max_forward_motion &&
-      two_view_geometry.tri_angle > DegToRad(options.init_min_tri_angle)) {
-    prev_init_image_pair_id_ = image_pair_id;
-    prev_init_two_view_geometry_ = two_view_geometry;
+  return IsValidInitialTwoViewGeometry();
+}
+
+bool IncrementalMapper::AlignToPriorPositions(const Options& options) {
+  if (!options.use_prior_position) {
+    return false;
+  }
+
+  if (prior_positions_aligned_) {
     return true;
   }
 
-  return false;
+  if (prior_positions_.empty()) {
+    std::vector<image_t> image_ids;
+    std::vector<Eigen::Vector3d> positions;
+    for (const auto& image : reconstruction_->Images()) {
+      if (image.second.HasTvecPrior()) {
+        image_ids.push_back(image.first);
+        positions.push_back(image.second.TvecPrior());
+      }
+    }
+
+    if (image_ids.empty()) {
+      return false;
+    }
+
+    if (options.prior_position_is_gps) {
+      // Center the local frame at the image with the smallest identifier,
+      // such that the frame does not depend on the order of the images.
+      const size_t ref_idx =
+          std::min_element(image_ids.begin(), image_ids.end()) -
+          image_ids.begin();
+      GPSTransform gps_transform(GPSTransform::WGS84);
+      positions = gps_transform.EllToENU(positions, positions[ref_idx](0),
+                                         positions[ref_idx](1));
+    }
+
+    prior_positions_.reserve(image_ids.size());
+    for (size_t i = 0; i < image_ids.size(); ++i) {
+      prior_positions_.emplace(image_ids[i], positions[i]);
+    }
+  }
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> dst;
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    const auto prior_position = prior_positions_.find(image_id);
+    if (prior_position != prior_positions_.end()) {
+      src.push_back(reconstruction_->Image(image_id).ProjectionCenter());
+      dst.push_back(prior_position->second);
+    }
+  }
+
+  if (dst.size() <
+          static_cast<size_t>(options.prior_position_min_num_images) ||
+      !ArePositionsNonCollinear(dst)) {
+    return false;
+  }
+
+  RANSACOptions ransac_options;
+  ransac_options.max_error = options.prior_position_max_error;
+  Eigen::Matrix3x4d tform;
+  if (!EstimateSimilarityTransformRobust(
+          src, dst, ransac_options,
+          static_cast<size_t>(options.prior_position_min_num_images), 0,
+          &tform)) {
+    return false;
+  }
+
+  reconstruction_->Transform(SimilarityTransform3(tform));
+
+  // The reused problems hold the constant poses in the previous frame.
+  local_bundle_adjuster_.reset();
+  global_bundle_adjuster_.reset();
+
+  prior_positions_aligned_ = true;
+
+  return true;
+}
+
+bool IncrementalMapper::SetPositionPriors(
+    const Options& options, BundleAdjustmentConfig* ba_config) const {
+  if (!options.use_prior_position || !prior_positions_aligned_) {
+    return false;
+  }
+
+  std::vector<Eigen::Vector3d> positions;
+  for (const image_t image_id : ba_config->Images()) {
+    if (ba_config->HasConstantPose(image_id)) {
+      continue;
+    }
+    const auto prior_position = prior_positions_.find(image_id);
+    if (prior_position != prior_positions_.end()) {
+      ba_config->SetPositionPrior(image_id, prior_position->second);
+      positions.push_back(prior_position->second);
+    }
+  }
+
+  return positions.size() >=
+             static_cast<size_t>(options.prior_position_min_num_images) &&
+         ArePositionsNonCollinear(positions);
 }
 
 }  // namespace colmap
@@ -32,6 +32,9 @@
 #ifndef COLMAP_SRC_SFM_INCREMENTAL_MAPPER_H_
 #define COLMAP_SRC_SFM_INCREMENTAL_MAPPER_H_
 
+#include <atomic>
+#include <set>
+
 #include "base/database.h"
 #include "base/database_cache.h"
 #include "base/reconstruction.h"
@@ -41,6 +44,40 @@
 
 namespace colmap {
 
+// Thread-safe registry of the images that are registered in concurrently
+// reconstructed models. An image can be claimed by multiple models, but a model
+// may share at most `max_model_overlap` images with other models.
+class ImageClaims {
+ public:
+  ImageClaims(const std::vector<image_t>& image_ids,
+              const size_t max_model_overlap);
+
+  // Claim an image for a model that already shares the given number of images
+  // with other models. Fails if the image is claimed by another model and the
+  // model cannot share any more images. Otherwise, `shared` is set to whether
+  // the image is also claimed by another model.
+  bool Claim(const image_t image_id, const size_t num_shared_images,
+             bool* shared);
+
+  // Claim an image only if it is not claimed by any other model.
+  bool ClaimExclusive(const image_t image_id);
+
+  // Release the claim of a model and return whether the image is still claimed
+  // by another model.
+  bool Release(const image_t image_id);
+
+  // The number of models that claimed the image.
+  size_t NumClaims(const image_t image_id) const;
+
+  // The number of images that are claimed by at least one model.
+  size_t NumClaimedImages() const;
+
+ private:
+  const size_t max_model_overlap_;
+  std::unordered_map<image_t, std::atomic<size_t>> num_claims_;
+  std::atomic<size_t> num_claimed_images_;
+};
+
 // Class that provides all functionality for the incremental reconstruction
 // procedure. Example usage:
 //
@@ -80,6 +117,17 @@ class IncrementalMapper {
     // Maximum number of trials to use an image for initialization.
     int init_max_reg_trials = 2;
 
+    // Number of candidate initial image pairs that are estimated together, in
+    // parallel if multiple threads are used. The best of the accepted pairs in
+    // the first batch with an accepted pair is selected. The selection thus
+    // depends on this option but not on the number of threads.
+    int init_num_candidate_pairs = 8;
+
+    // Whether to recover the relative pose of a candidate initial image pair
+    // from the two-view geometry verified during matching, before estimating
+    // the geometry again if the recovered pose is not accepted.
+    bool init_reuse_two_view_geometry = true;
+
     // Maximum reprojection error in absolute pose estimation.
     double abs_pose_max_error = 12.0;
 
@@ -89,6 +137,12 @@ class IncrementalMapper {
     // Minimum inlier ratio in absolute pose estimation.
     double abs_pose_min_inlier_ratio = 0.25;
 
+    // Whether to draw the samples of absolute pose estimation with PROSAC,
+    // where the 2D-3D correspondences are ordered by the track length of their
+    // 3D points, since points observed in more images are less likely to be
+    // outliers. Otherwise, the samples are drawn uniformly.
+    bool abs_pose_progressive_sampling = true;
+
     // Whether to estimate the focal length in absolute pose estimation.
     bool abs_pose_refine_focal_length = true;
 
@@ -101,6 +155,15 @@ class IncrementalMapper {
     // Minimum triangulation for images to be chosen in local bundle adjustment.
     double local_ba_min_tri_angle = 6;
 
+    // Whether to keep the bundle adjustment problem between local bundle
+    // adjustments and only update the residuals of changed observations.
+    bool local_ba_reuse_problem = false;
+
+    // Whether to keep the bundle adjustment problem, its elimination ordering,
+    // and the trust region radius between global bundle adjustments. The
+    // problem is not reused, if only a subset of the points is adjusted.
+    bool global_ba_reuse_problem = false;
+
     // Thresholds for bogus camera parameters. Images with bogus camera
     // parameters are filtered and ignored in triangulation.
     double min_focal_length_ratio = 0.1;  // Opening angle of ~130deg
@@ -119,6 +182,33 @@ class IncrementalMapper {
     // If reconstruction is provided as input, fix the existing image poses.
     bool fix_existing_images = false;
 
+    // Maximum number of 3D points per image in global bundle adjustment. The
+    // points are chosen to cover the images uniformly and the remaining points
+    // are refined afterwards with constant cameras. Non-positive values use
+    // all points. Not supported by the parallel global bundle adjustment.
+    int global_ba_max_num_points_per_image = -1;
+
+    // Whether to constrain the positions of the images by their position
+    // priors in bundle adjustment, e.g. from GPS. Once enough registered images
+    // have priors, the reconstruction is aligned to the priors, which then fix
+    // the gauge of local and global bundle adjustment instead of constant
+    // poses and bound the drift of the reconstruction. The priors are not used
+    // by the parallel and partitioned global bundle adjustment.
+    bool use_prior_position = false;
+
+    // Whether the position priors are GPS coordinates in degrees, which are
+    // converted to a local East-North-Up frame in meters, or Cartesian.
+    bool prior_position_is_gps = true;
+
+    // Minimum number of images with position priors to align the
+    // reconstruction to the priors and to fix the gauge of a bundle adjustment
+    // by the priors.
+    int prior_position_min_num_images = 3;
+
+    // Maximum distance of an image to its prior position to be an inlier in
+    // the alignment of the reconstruction to the priors.
+    double prior_position_max_error = 10.0;
+
     // Number of threads.
     int num_threads = -1;
 
@@ -141,15 +231,65 @@ class IncrementalMapper {
     size_t num_adjusted_observations = 0;
   };
 
+  // Pose of a next image estimated against the current reconstruction by
+  // `EstimateNextImagePose`, which can be registered later.
+  struct NextImagePose {
+    image_t image_id = kInvalidImageId;
+    bool success = false;
+    Eigen::Vector4d qvec = ComposeIdentityQuaternion();
+    Eigen::Vector3d tvec = Eigen::Vector3d::Zero();
+    // Whether the camera parameters were estimated for the image, in which
+    // case they are set to `camera_params` on registration.
+    bool refined_camera = false;
+    std::vector<double> camera_params;
+    // The 2D-3D correspondences and their inliers in the pose estimation.
+    std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+    std::vector<char> inlier_mask;
+    // The number of image registrations in the reconstruction at the time of
+    // the estimation, used to detect outdated estimates.
+    size_t num_reg_image_events = 0;
+  };
+
+  // The state of the mapper that is not stored in its reconstructions, which
+  // is checkpointed to resume an interrupted reconstruction.
+  struct State {
+    // The images and image pairs that have been tried for initialization.
+    std::unordered_map<image_t, size_t> init_num_reg_trials;
+    std::unordered_set<image_pair_t> init_image_pairs;
+
+    // The number of finished reconstructions in which images are registered.
+    std::unordered_map<image_t, size_t> num_registrations;
+
+    // The existing images, the filtered images, and the number of
+    // registration trials of the images in the current reconstruction.
+    std::unordered_set<image_t> existing_image_ids;
+    std::unordered_set<image_t> filtered_images;
+    std::unordered_map<image_t, size_t> num_reg_trials;
+  };
+
   // Create incremental mapper. The database cache must live for the entire
   // life-time of the incremental mapper.
   explicit IncrementalMapper(const DatabaseCache* database_cache);
 
+  // Create incremental mapper that shares the registered images with other
+  // mappers reconstructing models concurrently from the same database cache.
+  // The image claims must live for the entire life-time of the mapper.
+  IncrementalMapper(const DatabaseCache* database_cache,
+                    ImageClaims* image_claims);
+
   // Prepare the mapper for a new reconstruction, which might have existing
   // registered images (in which case `RegisterNextImage` must be called) or
   // which is empty (in which case `RegisterInitialImagePair` must be called).
   void BeginReconstruction(Reconstruction* reconstruction);
 
+  // Restore the state of a previous mapper and continue its current
+  // reconstruction, which must contain the registered images of the previous
+  // mapper's reconstruction at the time of `GetState`. If the previous mapper
+  // had no current reconstruction, the given reconstruction is begun as usual.
+  // This is not supported for mappers with shared image claims.
+  void ResumeReconstruction(Reconstruction* reconstruction,
+                            const State& state);
+
   // Cleanup the mapper after the current reconstruction is done. If the
   // model is discarded, the number of total and shared registered images will
   // be updated accordingly.
@@ -174,10 +314,26 @@ class IncrementalMapper {
   // a previous call to `RegisterInitialImagePair` was successful.
   bool RegisterNextImage(const Options& options, const image_t image_id);
 
+  // Estimate the pose of a next image without modifying the reconstruction.
+  // Multiple poses can be estimated concurrently, as long as the mapper and
+  // reconstruction are not modified at the same time.
+  bool EstimateNextImagePose(const Options& options, const image_t image_id,
+                             NextImagePose* pose) const;
+
+  // Attempt to register image with a previously estimated pose. If other
+  // images were registered since the estimation, the pose is validated against
+  // the current 3D points and re-estimated if it is no longer consistent.
+  bool RegisterNextImage(const Options& options, const NextImagePose& pose);
+
   // Triangulate observations of image.
   size_t TriangulateImage(const IncrementalTriangulator::Options& tri_options,
                           const image_t image_id);
 
+  // Triangulate observations of all registered images at once, e.g., to
+  // triangulate a model with known poses.
+  size_t TriangulateAllImages(
+      const IncrementalTriangulator::Options& tri_options);
+
   // Retriangulate image pairs that should have common observations according to
   // the scene graph but don't due to drift, etc. To handle drift, the employed
   // reprojection error thresholds should be relatively large. If the thresholds
@@ -206,13 +362,21 @@ class IncrementalMapper {
       const IncrementalTriangulator::Options& tri_options,
       const image_t image_id, const std::unordered_set<point3D_t>& point3D_ids);
 
-  // Global bundle adjustment using Ceres Solver or PBA.
+  // Global bundle adjustment using Ceres Solver or PBA. Since PBA cannot fix
+  // the extrinsics of an image alone, the existing images are fixed together
+  // with their intrinsics in the parallel adjustment.
   bool AdjustGlobalBundle(const Options& options,
                           const BundleAdjustmentOptions& ba_options);
   bool AdjustParallelGlobalBundle(
-      const BundleAdjustmentOptions& ba_options,
+      const Options& options, const BundleAdjustmentOptions& ba_options,
       const ParallelBundleAdjuster::Options& parallel_ba_options);
 
+  // Global bundle adjustment over overlapping partitions of the registered
+  // images, for reconstructions that are too large to be adjusted at once.
+  bool AdjustPartitionedGlobalBundle(
+      const Options& options, const BundleAdjustmentOptions& ba_options,
+      const PartitionedBundleAdjuster::Options& partitioned_ba_options);
+
   // Filter images and point observations.
   size_t FilterImages(const Options& options);
   size_t FilterPoints(const Options& options);
@@ -226,6 +390,13 @@ class IncrementalMapper {
   // previous reconstructions.
   size_t NumSharedRegImages() const;
 
+  // Whether the reconstruction is aligned to the position priors of its
+  // images, which then constrain its bundle adjustments.
+  bool IsAlignedToPriorPositions() const;
+
+  // Get the state of the mapper to resume it with `ResumeReconstruction`.
+  State GetState() const;
+
   // Get changed 3D points, since the last call to `ClearModifiedPoints3D`.
   const std::unordered_set<point3D_t>& GetModifiedPoints3D();
 
@@ -252,14 +423,53 @@ class IncrementalMapper {
                                        const image_t image_id) const;
 
   // Register / De-register image in current reconstruction and update
-  // the number of shared images between all reconstructions.
-  void RegisterImageEvent(const image_t image_id);
+  // the number of shared images between all reconstructions. With shared image
+  // claims, the registration fails if the image is claimed by another
+  // reconstruction and the current reconstruction cannot share more images, or
+  // if `exclusive` and the image is claimed by another reconstruction.
+  bool RegisterImageEvent(const image_t image_id, const bool exclusive = false);
   void DeRegisterImageEvent(const image_t image_id);
 
+  // The number of reconstructions in which the image is registered.
+  size_t NumRegistrations(const image_t image_id) const;
+
+  // The number of registered images of the camera in current reconstruction.
+  size_t NumRegImagesForCamera(const camera_t camera_id) const;
+
+  // Keep the inliers of a previously estimated pose that are consistent with
+  // the current reconstruction and return whether enough inliers remain.
+  bool ValidateNextImagePose(const Options& options, NextImagePose* pose) const;
+
+  // Register the image with an estimated pose and continue its tracks.
+  bool RegisterNextImagePose(const NextImagePose& pose);
+
+  // Update the rank of an image in the candidates of `FindNextImages`.
+  void UpdateNextImageRank(const Options& options, const image_t image_id);
+
+  // Estimate the two-view geometry of an initial image pair and cache it for a
+  // subsequent call to `RegisterInitialImagePair`.
   bool EstimateInitialTwoViewGeometry(const Options& options,
                                       const image_t image_id1,
                                       const image_t image_id2);
 
+  // Estimate the two-view geometry of a candidate initial image pair and
+  // return whether it satisfies the initialization thresholds. This function
+  // does not modify the mapper and can be called concurrently.
+  bool EstimateInitialTwoViewGeometry(const Options& options,
+                                      const image_t image_id1,
+                                      const image_t image_id2,
+                                      TwoViewGeometry* two_view_geometry) const;
+
+  // Align the reconstruction to the position priors of its registered images,
+  // if enabled and not yet aligned, and return whether it is aligned.
+  bool AlignToPriorPositions(const Options& options);
+
+  // Constrain the variable poses of the configured images by their position
+  // priors, if the reconstruction is aligned to them, and return whether the
+  // priors fix the gauge of the bundle adjustment.
+  bool SetPositionPriors(const Options& options,
+                         BundleAdjustmentConfig* ba_config) const;
+
   // Class that holds all necessary data from database in memory.
   const DatabaseCache* database_cache_;
 
@@ -269,6 +479,14 @@ class IncrementalMapper {
   // Class that is responsible for incremental triangulation.
   std::unique_ptr<IncrementalTriangulator> triangulator_;
 
+  // Bundle adjuster that is reused by all local bundle adjustments of the
+  // current reconstruction, if enabled.
+  std::unique_ptr<IncrementalBundleAdjuster> local_bundle_adjuster_;
+
+  // Bundle adjuster that is reused by all global bundle adjustments of the
+  // current reconstruction, if enabled.
+  std::unique_ptr<IncrementalBundleAdjuster> global_bundle_adjuster_;
+
   // Number of images that are registered in at least on reconstruction.
   size_t num_total_reg_images_;
 
@@ -292,8 +510,14 @@ class IncrementalMapper {
   // images share intrinsics.
   std::unordered_map<camera_t, size_t> num_reg_images_per_camera_;
 
-  // The number of reconstructions in which images are registered.
+  // The number of reconstructions in which images are registered. If the
+  // mapper shares image claims with other mappers, the claims are used instead.
   std::unordered_map<image_t, size_t> num_registrations_;
+  ImageClaims* image_claims_;
+
+  // The number of image registrations and de-registrations, which changes
+  // whenever the model of a previously estimated next image pose changed.
+  size_t num_reg_image_events_;
 
   // Images that have been filtered in current reconstruction.
   std::unordered_set<image_t> filtered_images_;
@@ -302,10 +526,44 @@ class IncrementalMapper {
   // an upper bound to the number of trials to register an image.
   std::unordered_map<image_t, size_t> num_reg_trials_;
 
+  // The position priors of the images in the frame of the priors, i.e., in a
+  // local East-North-Up frame for GPS priors, and whether the reconstruction
+  // is aligned to them.
+  std::unordered_map<image_t, Eigen::Vector3d> prior_positions_;
+  bool prior_positions_aligned_;
+
   // Images that were registered before beginning the reconstruction.
   // This image list will be non-empty, if the reconstruction is continued from
   // an existing reconstruction.
   std::unordered_set<image_t> existing_image_ids_;
+
+  // Ranked candidates of `FindNextImages` in descending order of their rank
+  // and ascending order of their identifier for equal ranks. Images that have
+  // been filtered or failed to register before are ranked separately.
+  struct NextImageRankCompare {
+    bool operator()(const std::pair<float, image_t>& image1,
+                    const std::pair<float, image_t>& image2) const {
+      return image1.first > image2.first ||
+             (image1.first == image2.first && image1.second < image2.second);
+    }
+  };
+  typedef std::set<std::pair<float, image_t>, NextImageRankCompare>
+      NextImageRanks;
+  NextImageRanks next_image_ranks_;
+  NextImageRanks next_other_image_ranks_;
+
+  // The rank of the candidates and whether they are in the second bucket.
+  std::unordered_map<image_t, std::pair<float, bool>> next_image_rank_entries_;
+
+  // Images that must be re-ranked in the next call to `FindNextImages`, in
+  // addition to the images with modified visibility in the reconstruction.
+  std::unordered_set<image_t> next_image_modified_ids_;
+
+  // Whether the candidates are set up and the options of their ranking.
+  bool next_image_ranks_valid_;
+  Options::ImageSelectionMethod next_image_selection_method_;
+  int next_image_min_num_inliers_;
+  int next_image_max_reg_trials_;
 };
 
 }  // namespace colmap
@@ -0,0 +1,90 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "sfm/incremental_triangulator"
+#define TEST_NAME "sfm/incremental_mapper"
+#include "util/testing.h"
+
+#include "base/database_cache.h"
+#include "base/synthetic.h"
+#include "sfm/incremental_mapper.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestFindInitialImagePairDeterministic) {
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_images = 20;
+  synthetic_options.num_points3D = 500;
+  synthetic_options.mean_track_length = 10;
+  synthetic_options.point2D_stddev = 0.5;
+  synthetic_options.match_outlier_ratio = 0.2;
+  Reconstruction gt_reconstruction;
+  Database database(":memory:");
+  SynthesizeDataset(synthetic_options, &gt_reconstruction, &database);
+
+  DatabaseCache database_cache;
+  database_cache.Load(database, 0, true, {});
+
+  // Find the initial pair from scratch with different numbers of threads and
+  // check that the selected pair and its geometry are the same, i.e., that
+  // they do not depend on the assignment of the estimations to threads.
+  std::vector<image_t> image_ids1;
+  std::vector<image_t> image_ids2;
+  std::vector<size_t> num_points3D;
+  for (const int num_threads : {1, 2, 4}) {
+    IncrementalMapper::Options options;
+    options.init_min_tri_angle = 4;
+    options.init_reuse_two_view_geometry = false;
+    options.num_threads = num_threads;
+
+    Reconstruction reconstruction;
+    IncrementalMapper mapper(&database_cache);
+    mapper.BeginReconstruction(&reconstruction);
+
+    SetPRNGSeed(0);
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    BOOST_CHECK(mapper.FindInitialImagePair(options, &image_id1, &image_id2));
+    BOOST_CHECK(mapper.RegisterInitialImagePair(options, image_id1, image_id2));
+
+    image_ids1.push_back(image_id1);
+    image_ids2.push_back(image_id2);
+    num_points3D.push_back(reconstruction.NumPoints3D());
+
+    mapper.EndReconstruction(true);
+  }
+
+  for (size_t i = 1; i < image_ids1.size(); ++i) {
+    BOOST_CHECK_EQUAL(image_ids1[i], image_ids1[0]);
+    BOOST_CHECK_EQUAL(image_ids2[i], image_ids2[0]);
+    BOOST_CHECK_EQUAL(num_points3D[i], num_points3D[0]);
+  }
+}
@@ -31,11 +31,47 @@
 
 #include "sfm/incremental_triangulator.h"
 
+#include <limits>
+#include <numeric>
+
 #include "base/projection.h"
-#include "estimators/triangulation.h"
 #include "util/misc.h"
+#include "util/random.h"
+#include "util/threading.h"
 
 namespace colmap {
+namespace {
+
+// Call `func(begin, end)` for contiguous ranges of the items [0, num_items).
+// The ranges are dynamically distributed in a few chunks per thread, since the
+// work per item is usually too small to be scheduled as a separate task. Multi-
+// threading is only used for at least `min_num_items_for_multi_threading`.
+template <typename Func>
+void ParallelForRanges(const size_t num_items, const int num_threads,
+                       const size_t min_num_items_for_multi_threading,
+                       const Func& func) {
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  if (num_eff_threads == 1 || num_items < min_num_items_for_multi_threading) {
+    func(0, num_items);
+    return;
+  }
+
+  ParallelFor(num_eff_threads, 0, num_items, func,
+              ThreadPool::Schedule::DYNAMIC);
+}
+
+// The minimum number of independent estimations to use multi-threading.
+const size_t kMinNumItemsForMultiThreading = 100;
+
+// The PRNG seed of the estimation for an observation, which is derived from
+// the seed of the pass, such that the estimation does not depend on the thread
+// that executes it and the result is the same for any number of threads.
+unsigned ObservationPRNGSeed(const unsigned seed, const image_t image_id,
+                             const point2D_t point2D_idx) {
+  return seed ^ (image_id * 2654435761u) ^ point2D_idx;
+}
+
+}  // namespace
 
 bool IncrementalTriangulator::Options::Check() const {
   CHECK_OPTION_GE(max_transitivity, 0);
@@ -84,31 +120,93 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
   ref_corr_data.image = &image;
   ref_corr_data.camera = &camera;
 
-  // Container for correspondences from reference observation to other images.
-  std::vector<CorrData> corrs_data;
-
-  // Try to triangulate all image observations.
+  // Find the correspondences of all image observations. The reference
+  // correspondence is appended as the last element, which neither changes the
+  // result of `Continue` nor of `Create`.
+  size_t num_observations = 0;
+  std::vector<size_t> create_idxs;
   for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
        ++point2D_idx) {
+    if (observations_data_.size() <= num_observations) {
+      observations_data_.emplace_back();
+    }
+    ObservationData& observation_data = observations_data_[num_observations];
+
     const size_t num_triangulated =
         Find(options, image_id, point2D_idx,
-             static_cast<size_t>(options.max_transitivity), &corrs_data);
-    if (corrs_data.empty()) {
+             static_cast<size_t>(options.max_transitivity),
+             &observation_data.corrs_data);
+    if (observation_data.corrs_data.empty()) {
       continue;
     }
 
     const Point2D& point2D = image.Point2D(point2D_idx);
     ref_corr_data.point2D_idx = point2D_idx;
     ref_corr_data.point2D = &point2D;
+    observation_data.corrs_data.push_back(ref_corr_data);
+
+    observation_data.point2D_idx = point2D_idx;
+    observation_data.num_triangulated =
+        num_triangulated + (point2D.HasPoint3D() ? 1 : 0);
+    observation_data.create = num_triangulated == 0;
+    if (observation_data.create) {
+      create_idxs.push_back(num_observations);
+    }
+
+    num_observations += 1;
+  }
+
+  // Estimate the new 3D points of observations without triangulated
+  // correspondences. The estimation does not modify the reconstruction and
+  // the estimated points are only added in the sequential pass below.
+  const unsigned seed = RandomPRNGSeed();
+  ParallelForRanges(
+      create_idxs.size(), options.num_threads, kMinNumItemsForMultiThreading,
+      [this, &options, &create_idxs, image_id, seed](const size_t begin,
+                                                     const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          ObservationData& observation_data =
+              observations_data_[create_idxs[i]];
+          ScopedPRNGSeed scoped_prng_seed(ObservationPRNGSeed(
+              seed, image_id, observation_data.point2D_idx));
+          EstimateCreate(options, observation_data.corrs_data,
+                         &observation_data.create_data);
+        }
+      });
+
+  // Try to triangulate all image observations in order.
+  for (size_t i = 0; i < num_observations; ++i) {
+    ObservationData& observation_data = observations_data_[i];
+    std::vector<CorrData>& corrs_data = observation_data.corrs_data;
+
+    size_t num_triangulated = 0;
+    for (const CorrData& corr_data : corrs_data) {
+      if (corr_data.point2D->HasPoint3D()) {
+        num_triangulated += 1;
+      }
+    }
+
+    // The estimated 3D point is only valid if none of the correspondences was
+    // triangulated by a previous observation, since tracks only grow here.
+    if (observation_data.create &&
+        num_triangulated == observation_data.num_triangulated) {
+      if (observation_data.create_data.success) {
+        num_tris += AddCreate(options, observation_data.create_data);
+      }
+      continue;
+    }
+
+    const CorrData& observation_corr_data = corrs_data.back();
+    if (observation_corr_data.point2D->HasPoint3D()) {
+      num_triangulated -= 1;
+    }
 
     if (num_triangulated == 0) {
-      corrs_data.push_back(ref_corr_data);
       num_tris += Create(options, corrs_data);
     } else {
       // Continue correspondences to existing 3D points.
-      num_tris += Continue(options, ref_corr_data, corrs_data);
+      num_tris += Continue(options, observation_corr_data, corrs_data);
       // Create points from correspondences that are not continued.
-      corrs_data.push_back(ref_corr_data);
       num_tris += Create(options, corrs_data);
     }
   }
@@ -116,6 +214,208 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
   return num_tris;
 }
 
+size_t IncrementalTriangulator::TriangulateAllImages(const Options& options) {
+  CHECK(options.Check());
+
+  // The number of images whose correspondences are found in parallel before
+  // they are joined, to bound the memory of the found correspondences.
+  const size_t kImageBatchSize = 1000;
+  // The number of tracks that are estimated in parallel before they are
+  // added to the reconstruction, to bound the memory of the estimations.
+  const size_t kTrackBatchSize = 100000;
+
+  ClearCaches();
+  CacheCameraBogusParams(options);
+
+  // Index the observations of the registered images with valid cameras
+  // consecutively.
+  std::vector<image_t> image_ids;
+  std::unordered_map<image_t, size_t> image_offsets;
+  size_t num_observations = 0;
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    const Image& image = reconstruction_->Image(image_id);
+    if (HasCameraBogusParams(options,
+                             reconstruction_->Camera(image.CameraId()))) {
+      continue;
+    }
+    image_ids.push_back(image_id);
+    image_offsets.emplace(image_id, num_observations);
+    num_observations += image.NumPoints2D();
+  }
+
+  // Join the corresponding observations in a union-find forest, whose trees
+  // are the tracks. Each correspondence is found from the image with the
+  // smaller identifier, since the correspondence graph is symmetric.
+  std::vector<size_t> parents(num_observations);
+  std::iota(parents.begin(), parents.end(), 0);
+  const auto FindRoot = [&parents](size_t idx) {
+    while (parents[idx] != idx) {
+      parents[idx] = parents[parents[idx]];
+      idx = parents[idx];
+    }
+    return idx;
+  };
+
+  std::vector<std::vector<std::pair<size_t, size_t>>> batch_corrs(
+      kImageBatchSize);
+  for (size_t batch_begin = 0; batch_begin < image_ids.size();
+       batch_begin += kImageBatchSize) {
+    const size_t batch_size =
+        std::min(kImageBatchSize, image_ids.size() - batch_begin);
+    ParallelForRanges(
+        batch_size, options.num_threads, 1,
+        [&](const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const image_t image_id = image_ids[batch_begin + i];
+            const Image& image = reconstruction_->Image(image_id);
+            const size_t image_offset = image_offsets.at(image_id);
+            std::vector<std::pair<size_t, size_t>>& corrs = batch_corrs[i];
+            corrs.clear();
+            for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+                 ++point2D_idx) {
+              if (image.Point2D(point2D_idx).HasPoint3D()) {
+                continue;
+              }
+              for (const auto& corr : correspondence_graph_->FindCorrespondences(
+                       image_id, point2D_idx)) {
+                if (corr.image_id <= image_id) {
+                  continue;
+                }
+                const auto corr_offset_it = image_offsets.find(corr.image_id);
+                if (corr_offset_it == image_offsets.end() ||
+                    reconstruction_->Image(corr.image_id)
+                        .Point2D(corr.point2D_idx)
+                        .HasPoint3D()) {
+                  continue;
+                }
+                corrs.emplace_back(image_offset + point2D_idx,
+                                   corr_offset_it->second + corr.point2D_idx);
+              }
+            }
+          }
+        });
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      for (const auto& corr : batch_corrs[i]) {
+        const size_t root1 = FindRoot(corr.first);
+        const size_t root2 = FindRoot(corr.second);
+        if (root1 != root2) {
+          parents[std::max(root1, root2)] = std::min(root1, root2);
+        }
+      }
+    }
+  }
+
+  batch_corrs.clear();
+  batch_corrs.shrink_to_fit();
+
+  // Group the observations by their track, where the observations of each
+  // track are consecutive in `track_obs` starting at `track_begins`.
+  std::vector<size_t> track_begins(num_observations + 1, 0);
+  for (size_t idx = 0; idx < num_observations; ++idx) {
+    parents[idx] = FindRoot(idx);
+    track_begins[parents[idx] + 1] += 1;
+  }
+  std::partial_sum(track_begins.begin(), track_begins.end(),
+                   track_begins.begin());
+
+  std::vector<std::pair<image_t, point2D_t>> track_obs(num_observations);
+  {
+    std::vector<size_t> track_ends(track_begins.begin(),
+                                   track_begins.end() - 1);
+    for (const image_t image_id : image_ids) {
+      const size_t image_offset = image_offsets.at(image_id);
+      const point2D_t num_points2D =
+          reconstruction_->Image(image_id).NumPoints2D();
+      for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+           ++point2D_idx) {
+        const size_t root = parents[image_offset + point2D_idx];
+        track_obs[track_ends[root]++] = std::make_pair(image_id, point2D_idx);
+      }
+    }
+  }
+
+  parents.clear();
+  parents.shrink_to_fit();
+
+  std::vector<size_t> track_roots;
+  for (size_t root = 0; root < num_observations; ++root) {
+    if (track_begins[root + 1] - track_begins[root] >= 2) {
+      track_roots.push_back(root);
+    }
+  }
+
+  // Estimate the tracks in parallel and add them to the reconstruction in a
+  // sequential pass, which only recursively creates further 3D points from
+  // the outliers of a track.
+  size_t num_tris = 0;
+  const unsigned seed = RandomPRNGSeed();
+  std::vector<CreateData> create_data(
+      std::min(kTrackBatchSize, track_roots.size()));
+  for (size_t batch_begin = 0; batch_begin < track_roots.size();
+       batch_begin += kTrackBatchSize) {
+    const size_t batch_size =
+        std::min(kTrackBatchSize, track_roots.size() - batch_begin);
+    ParallelForRanges(
+        batch_size, options.num_threads, kMinNumItemsForMultiThreading,
+        [&](const size_t begin, const size_t end) {
+          std::vector<CorrData> corrs_data;
+          std::unordered_set<image_t> inlier_image_ids;
+          for (size_t i = begin; i < end; ++i) {
+            const size_t root = track_roots[batch_begin + i];
+            corrs_data.clear();
+            for (size_t j = track_begins[root]; j < track_begins[root + 1];
+                 ++j) {
+              CorrData corr_data;
+              corr_data.image_id = track_obs[j].first;
+              corr_data.point2D_idx = track_obs[j].second;
+              corr_data.image = &reconstruction_->Image(corr_data.image_id);
+              corr_data.camera =
+                  &reconstruction_->Camera(corr_data.image->CameraId());
+              corr_data.point2D =
+                  &corr_data.image->Point2D(corr_data.point2D_idx);
+              corrs_data.push_back(corr_data);
+            }
+
+            CreateData& track_create_data = create_data[i];
+            ScopedPRNGSeed scoped_prng_seed(
+                ObservationPRNGSeed(seed, corrs_data[0].image_id,
+                                    corrs_data[0].point2D_idx));
+            if (!EstimateCreate(options, corrs_data, &track_create_data)) {
+              continue;
+            }
+
+            // Unlike the correspondences of a single observation, a track
+            // can join multiple observations of the same image, of which
+            // only the first inlier is kept.
+            inlier_image_ids.clear();
+            size_t num_inliers = 0;
+            for (size_t j = 0; j < track_create_data.inlier_mask.size(); ++j) {
+              if (!track_create_data.inlier_mask[j]) {
+                continue;
+              }
+              if (inlier_image_ids
+                      .insert(track_create_data.corrs_data[j].image_id)
+                      .second) {
+                num_inliers += 1;
+              } else {
+                track_create_data.inlier_mask[j] = false;
+              }
+            }
+            track_create_data.success = num_inliers >= 2;
+          }
+        });
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      if (create_data[i].success) {
+        num_tris += AddCreate(options, create_data[i]);
+      }
+    }
+  }
+
+  return num_tris;
+}
+
 size_t IncrementalTriangulator::CompleteImage(const Options& options,
                                               const image_t image_id) {
   CHECK(options.Check());
@@ -250,8 +550,51 @@ size_t IncrementalTriangulator::CompleteAllTracks(const Options& options) {
 
   ClearCaches();
 
-  for (const point3D_t point3D_id : reconstruction_->Point3DIds()) {
-    num_completed += Complete(options, point3D_id);
+  const std::unordered_set<point3D_t> point3D_id_set =
+      reconstruction_->Point3DIds();
+  const std::vector<point3D_t> point3D_ids(point3D_id_set.begin(),
+                                           point3D_id_set.end());
+
+  // Estimate the completions of all tracks in parallel w.r.t. the current
+  // reconstruction.
+  CacheCameraBogusParams(options);
+  std::vector<std::vector<TrackElement>> track_els(point3D_ids.size());
+  ParallelForRanges(
+      point3D_ids.size(), options.num_threads, kMinNumItemsForMultiThreading,
+      [this, &options, &point3D_ids, &track_els](const size_t begin,
+                                                 const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          EstimateComplete(options, point3D_ids[i], &track_els[i]);
+        }
+      });
+
+  // Add the completions in the serial order. Completion only adds
+  // observations, so an estimated completion equals the serial completion, if
+  // none of its observations was added to a previous track. Otherwise, the
+  // track is completed again w.r.t. the modified reconstruction.
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    bool is_valid = true;
+    for (const auto& track_el : track_els[i]) {
+      if (reconstruction_->Image(track_el.image_id)
+              .Point2D(track_el.point2D_idx)
+              .HasPoint3D()) {
+        is_valid = false;
+        break;
+      }
+    }
+
+    if (!is_valid) {
+      num_completed += Complete(options, point3D_ids[i]);
+      continue;
+    }
+
+    for (const auto& track_el : track_els[i]) {
+      reconstruction_->AddObservation(point3D_ids[i], track_el);
+    }
+    if (!track_els[i].empty()) {
+      modified_point3D_ids_.insert(point3D_ids[i]);
+    }
+    num_completed += track_els[i].size();
   }
 
   return num_completed;
@@ -279,8 +622,57 @@ size_t IncrementalTriangulator::MergeAllTracks(const Options& options) {
 
   ClearCaches();
 
-  for (const point3D_t point3D_id : reconstruction_->Point3DIds()) {
-    num_merged += Merge(options, point3D_id);
+  const std::unordered_set<point3D_t> point3D_id_set =
+      reconstruction_->Point3DIds();
+  const std::vector<point3D_t> point3D_ids(point3D_id_set.begin(),
+                                           point3D_id_set.end());
+
+  // Estimate the first merge of all 3D points in parallel w.r.t. the current
+  // reconstruction.
+  std::vector<point3D_t> merge_point3D_ids(point3D_ids.size());
+  std::vector<std::vector<point3D_t>> corr_point3D_ids(point3D_ids.size());
+  ParallelForRanges(
+      point3D_ids.size(), options.num_threads, kMinNumItemsForMultiThreading,
+      [this, &options, &point3D_ids, &merge_point3D_ids, &corr_point3D_ids](
+          const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          merge_point3D_ids[i] =
+              EstimateMerge(options, point3D_ids[i], &corr_point3D_ids[i]);
+        }
+      });
+
+  // Merge the 3D points in the serial order. Merging deletes the merged 3D
+  // points and never modifies other 3D points, so an estimated merge equals
+  // the serial merge, if all encountered 3D points still exist. Skipping the
+  // merge trials does not change the result, since a previously tried pair of
+  // unmodified 3D points is rejected again.
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    const point3D_t point3D_id = point3D_ids[i];
+    if (!reconstruction_->ExistsPoint3D(point3D_id)) {
+      continue;
+    }
+
+    bool is_valid = true;
+    for (const point3D_t corr_point3D_id : corr_point3D_ids[i]) {
+      if (!reconstruction_->ExistsPoint3D(corr_point3D_id)) {
+        is_valid = false;
+        break;
+      }
+    }
+
+    if (!is_valid) {
+      num_merged += Merge(options, point3D_id);
+      continue;
+    }
+
+    for (const point3D_t corr_point3D_id : corr_point3D_ids[i]) {
+      merge_trials_[point3D_id].insert(corr_point3D_id);
+      merge_trials_[corr_point3D_id].insert(point3D_id);
+    }
+
+    if (merge_point3D_ids[i] != kInvalidPoint3DId) {
+      num_merged += AddMerge(options, point3D_id, merge_point3D_ids[i]);
+    }
   }
 
   return num_merged;
@@ -296,6 +688,94 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
   Options re_options = options;
   re_options.continue_max_angle_error = options.re_max_angle_error;
 
+  // Estimate the new 3D points of all correspondences without triangulated
+  // observations in under-reconstructed image pairs in parallel. The checks
+  // below only become stricter as points are triangulated, so the image
+  // pairs are a superset of the retriangulated image pairs.
+  CacheCameraBogusParams(options);
+  std::vector<image_pair_t> re_pair_ids;
+  for (const auto& image_pair : reconstruction_->ImagePairs()) {
+    const double tri_ratio =
+        static_cast<double>(image_pair.second.num_tri_corrs) /
+        static_cast<double>(image_pair.second.num_total_corrs);
+    if (tri_ratio >= options.re_min_ratio) {
+      continue;
+    }
+
+    image_t image_id1;
+    image_t image_id2;
+    Database::PairIdToImagePair(image_pair.first, &image_id1, &image_id2);
+
+    const Image& image1 = reconstruction_->Image(image_id1);
+    const Image& image2 = reconstruction_->Image(image_id2);
+    if (!image1.IsRegistered() || !image2.IsRegistered() ||
+        re_num_trials_[image_pair.first] >= options.re_max_trials ||
+        HasCameraBogusParams(options,
+                             reconstruction_->Camera(image1.CameraId())) ||
+        HasCameraBogusParams(options,
+                             reconstruction_->Camera(image2.CameraId()))) {
+      continue;
+    }
+
+    re_pair_ids.push_back(image_pair.first);
+  }
+
+  std::unordered_map<image_pair_t, std::vector<CreateData>> re_create_data;
+  re_create_data.reserve(re_pair_ids.size());
+  for (const image_pair_t pair_id : re_pair_ids) {
+    re_create_data[pair_id];
+  }
+
+  const unsigned seed = RandomPRNGSeed();
+  ParallelForRanges(
+      re_pair_ids.size(), options.num_threads, 2,
+      [this, &options, &re_pair_ids, &re_create_data, seed](
+          const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          image_t image_id1;
+          image_t image_id2;
+          Database::PairIdToImagePair(re_pair_ids[i], &image_id1, &image_id2);
+
+          const Image& image1 = reconstruction_->Image(image_id1);
+          const Image& image2 = reconstruction_->Image(image_id2);
+          const Camera& camera1 = reconstruction_->Camera(image1.CameraId());
+          const Camera& camera2 = reconstruction_->Camera(image2.CameraId());
+
+          const FeatureMatches& corrs =
+              correspondence_graph_->FindCorrespondencesBetweenImages(
+                  image_id1, image_id2);
+
+          std::vector<CreateData>& create_data =
+              re_create_data.at(re_pair_ids[i]);
+          create_data.resize(corrs.size());
+          for (size_t j = 0; j < corrs.size(); ++j) {
+            const Point2D& point2D1 = image1.Point2D(corrs[j].point2D_idx1);
+            const Point2D& point2D2 = image2.Point2D(corrs[j].point2D_idx2);
+            if (point2D1.HasPoint3D() || point2D2.HasPoint3D()) {
+              continue;
+            }
+
+            CorrData corr_data1;
+            corr_data1.image_id = image_id1;
+            corr_data1.point2D_idx = corrs[j].point2D_idx1;
+            corr_data1.image = &image1;
+            corr_data1.camera = &camera1;
+            corr_data1.point2D = &point2D1;
+
+            CorrData corr_data2;
+            corr_data2.image_id = image_id2;
+            corr_data2.point2D_idx = corrs[j].point2D_idx2;
+            corr_data2.image = &image2;
+            corr_data2.camera = &camera2;
+            corr_data2.point2D = &point2D2;
+
+            ScopedPRNGSeed scoped_prng_seed(
+                ObservationPRNGSeed(seed, image_id1, corrs[j].point2D_idx1));
+            EstimateCreate(options, {corr_data1, corr_data2}, &create_data[j]);
+          }
+        }
+      });
+
   for (const auto& image_pair : reconstruction_->ImagePairs()) {
     // Only perform retriangulation for under-reconstructed image pairs.
     const double tri_ratio =
@@ -342,7 +822,11 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
         correspondence_graph_->FindCorrespondencesBetweenImages(image_id1,
                                                                 image_id2);
 
-    for (const auto& corr : corrs) {
+    const std::vector<CreateData>& create_data =
+        re_create_data.at(image_pair.first);
+
+    for (size_t corr_idx = 0; corr_idx < corrs.size(); ++corr_idx) {
+      const FeatureMatch& corr = corrs[corr_idx];
       const Point2D& point2D1 = image1.Point2D(corr.point2D_idx1);
       const Point2D& point2D2 = image2.Point2D(corr.point2D_idx2);
 
@@ -376,10 +860,13 @@ size_t IncrementalTriangulator::Retriangulate(const Options& options) {
         const std::vector<CorrData> corrs_data2 = {corr_data2};
         num_tris += Continue(re_options, corr_data1, corrs_data2);
       } else if (!point2D1.HasPoint3D() && !point2D2.HasPoint3D()) {
-        const std::vector<CorrData> corrs_data = {corr_data1, corr_data2};
         // Do not use larger triangulation threshold as this causes
         // significant drift when creating points (options vs. re_options).
-        num_tris += Create(options, corrs_data);
+        // Both observations were also not triangulated during the estimation
+        // above, so the estimated point equals the point of `Create`.
+        if (create_data[corr_idx].success) {
+          num_tris += AddCreate(options, create_data[corr_idx]);
+        }
       }
       // Else both points have a 3D point, but we do not want to
       // merge points in retriangulation.
@@ -460,8 +947,21 @@ size_t IncrementalTriangulator::Find(const Options& options,
 
 size_t IncrementalTriangulator::Create(
     const Options& options, const std::vector<CorrData>& corrs_data) {
+  CreateData create_data;
+  if (!EstimateCreate(options, corrs_data, &create_data)) {
+    return 0;
+  }
+  return AddCreate(options, create_data);
+}
+
+bool IncrementalTriangulator::EstimateCreate(
+    const Options& options, const std::vector<CorrData>& corrs_data,
+    CreateData* create_data) const {
+  create_data->success = false;
+
   // Extract correspondences without an existing triangulated observation.
-  std::vector<CorrData> create_corrs_data;
+  std::vector<CorrData>& create_corrs_data = create_data->corrs_data;
+  create_corrs_data.clear();
   create_corrs_data.reserve(corrs_data.size());
   for (const CorrData& corr_data : corrs_data) {
     if (!corr_data.point2D->HasPoint3D()) {
@@ -471,19 +971,21 @@ size_t IncrementalTriangulator::Create(
 
   if (create_corrs_data.size() < 2) {
     // Need at least two observations for triangulation.
-    return 0;
+    return false;
   } else if (options.ignore_two_view_tracks && create_corrs_data.size() == 2) {
     const CorrData& corr_data1 = create_corrs_data[0];
     if (correspondence_graph_->IsTwoViewObservation(corr_data1.image_id,
                                                     corr_data1.point2D_idx)) {
-      return 0;
+      return false;
     }
   }
 
   // Setup data for triangulation estimation.
-  std::vector<TriangulationEstimator::PointData> point_data;
+  std::vector<TriangulationEstimator::PointData>& point_data =
+      create_data->point_data;
   point_data.resize(create_corrs_data.size());
-  std::vector<TriangulationEstimator::PoseData> pose_data;
+  std::vector<TriangulationEstimator::PoseData>& pose_data =
+      create_data->pose_data;
   pose_data.resize(create_corrs_data.size());
   for (size_t i = 0; i < create_corrs_data.size(); ++i) {
     const CorrData& corr_data = create_corrs_data[i];
@@ -513,25 +1015,30 @@ size_t IncrementalTriangulator::Create(
   }
 
   // Estimate triangulation.
-  Eigen::Vector3d xyz;
-  std::vector<char> inlier_mask;
-  if (!EstimateTriangulation(tri_options, point_data, pose_data, &inlier_mask,
-                             &xyz)) {
-    return 0;
-  }
+  create_data->success =
+      EstimateTriangulation(tri_options, point_data, pose_data,
+                            &create_data->inlier_mask, &create_data->xyz);
+
+  return create_data->success;
+}
+
+size_t IncrementalTriangulator::AddCreate(const Options& options,
+                                          const CreateData& create_data) {
+  const std::vector<CorrData>& create_corrs_data = create_data.corrs_data;
 
   // Add inliers to estimated track.
   Track track;
   track.Reserve(create_corrs_data.size());
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
+  for (size_t i = 0; i < create_data.inlier_mask.size(); ++i) {
+    if (create_data.inlier_mask[i]) {
       const CorrData& corr_data = create_corrs_data[i];
       track.AddElement(corr_data.image_id, corr_data.point2D_idx);
     }
   }
 
   // Add estimated point to reconstruction.
-  const point3D_t point3D_id = reconstruction_->AddPoint3D(xyz, track);
+  const point3D_t point3D_id =
+      reconstruction_->AddPoint3D(create_data.xyz, track);
   modified_point3D_ids_.insert(point3D_id);
 
   const size_t kMinRecursiveTrackLength = 3;
@@ -591,13 +1098,10 @@ size_t IncrementalTriangulator::Merge(const Options& options,
     return 0;
   }
 
-  const double max_squared_reproj_error =
-      options.merge_max_reproj_error * options.merge_max_reproj_error;
-
   const auto& point3D = reconstruction_->Point3D(point3D_id);
 
   for (const auto& track_el : point3D.Track().Elements()) {
-    const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+    const CorrespondenceGraph::CorrespondenceRange corrs =
         correspondence_graph_->FindCorrespondences(track_el.image_id,
                                                    track_el.point2D_idx);
 
@@ -622,53 +1126,9 @@ size_t IncrementalTriangulator::Merge(const Options& options,
       merge_trials_[point3D_id].insert(corr_point2D.Point3DId());
       merge_trials_[corr_point2D.Point3DId()].insert(point3D_id);
 
-      // Weighted average of point locations, depending on track length.
-      const Eigen::Vector3d merged_xyz =
-          (point3D.Track().Length() * point3D.XYZ() +
-           corr_point3D.Track().Length() * corr_point3D.XYZ()) /
-          (point3D.Track().Length() + corr_point3D.Track().Length());
-
-      // Count number of inlier track elements of the merged track.
-      bool merge_success = true;
-      for (const Track* track : {&point3D.Track(), &corr_point3D.Track()}) {
-        for (const auto test_track_el : track->Elements()) {
-          const Image& test_image =
-              reconstruction_->Image(test_track_el.image_id);
-          const Camera& test_camera =
-              reconstruction_->Camera(test_image.CameraId());
-          const Point2D& test_point2D =
-              test_image.Point2D(test_track_el.point2D_idx);
-          if (CalculateSquaredReprojectionError(
-                  test_point2D.XY(), merged_xyz, test_image.Qvec(),
-                  test_image.Tvec(), test_camera) > max_squared_reproj_error) {
-            merge_success = false;
-            break;
-          }
-        }
-        if (!merge_success) {
-          break;
-        }
-      }
-
       // Only accept merge if all track elements are inliers.
-      if (merge_success) {
-        const size_t num_merged =
-            point3D.Track().Length() + corr_point3D.Track().Length();
-
-        const point3D_t merged_point3D_id = reconstruction_->MergePoints3D(
-            point3D_id, corr_point2D.Point3DId());
-
-        modified_point3D_ids_.erase(point3D_id);
-        modified_point3D_ids_.erase(corr_point2D.Point3DId());
-        modified_point3D_ids_.insert(merged_point3D_id);
-
-        // Merge merged 3D point and return, as the original points are deleted.
-        const size_t num_merged_recursive = Merge(options, merged_point3D_id);
-        if (num_merged_recursive > 0) {
-          return num_merged_recursive;
-        } else {
-          return num_merged;
-        }
+      if (IsMergeConsistent(options, point3D, corr_point3D)) {
+        return AddMerge(options, point3D_id, corr_point2D.Point3DId());
       }
     }
   }
@@ -676,12 +1136,120 @@ size_t IncrementalTriangulator::Merge(const Options& options,
   return 0;
 }
 
+point3D_t IncrementalTriangulator::EstimateMerge(
+    const Options& options, const point3D_t point3D_id,
+    std::vector<point3D_t>* corr_point3D_ids) const {
+  corr_point3D_ids->clear();
+
+  const auto& point3D = reconstruction_->Point3D(point3D_id);
+
+  for (const auto& track_el : point3D.Track().Elements()) {
+    const CorrespondenceGraph::CorrespondenceRange corrs =
+        correspondence_graph_->FindCorrespondences(track_el.image_id,
+                                                   track_el.point2D_idx);
+
+    for (const auto corr : corrs) {
+      const auto& image = reconstruction_->Image(corr.image_id);
+      if (!image.IsRegistered()) {
+        continue;
+      }
+
+      const Point2D& corr_point2D = image.Point2D(corr.point2D_idx);
+      if (!corr_point2D.HasPoint3D() ||
+          corr_point2D.Point3DId() == point3D_id) {
+        continue;
+      }
+
+      corr_point3D_ids->push_back(corr_point2D.Point3DId());
+
+      const Point3D& corr_point3D =
+          reconstruction_->Point3D(corr_point2D.Point3DId());
+      if (IsMergeConsistent(options, point3D, corr_point3D)) {
+        return corr_point2D.Point3DId();
+      }
+    }
+  }
+
+  return kInvalidPoint3DId;
+}
+
+bool IncrementalTriangulator::IsMergeConsistent(
+    const Options& options, const Point3D& point3D,
+    const Point3D& corr_point3D) const {
+  const double max_squared_reproj_error =
+      options.merge_max_reproj_error * options.merge_max_reproj_error;
+
+  // Weighted average of point locations, depending on track length.
+  const Eigen::Vector3d merged_xyz =
+      (point3D.Track().Length() * point3D.XYZ() +
+       corr_point3D.Track().Length() * corr_point3D.XYZ()) /
+      (point3D.Track().Length() + corr_point3D.Track().Length());
+
+  // Count number of inlier track elements of the merged track.
+  for (const Track* track : {&point3D.Track(), &corr_point3D.Track()}) {
+    for (const auto test_track_el : track->Elements()) {
+      const Image& test_image = reconstruction_->Image(test_track_el.image_id);
+      const Camera& test_camera =
+          reconstruction_->Camera(test_image.CameraId());
+      const Point2D& test_point2D =
+          test_image.Point2D(test_track_el.point2D_idx);
+      if (CalculateSquaredReprojectionError(
+              test_point2D.XY(), merged_xyz, test_image.Qvec(),
+              test_image.Tvec(), test_camera) > max_squared_reproj_error) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+size_t IncrementalTriangulator::AddMerge(const Options& options,
+                                         const point3D_t point3D_id,
+                                         const point3D_t corr_point3D_id) {
+  const size_t num_merged =
+      reconstruction_->Point3D(point3D_id).Track().Length() +
+      reconstruction_->Point3D(corr_point3D_id).Track().Length();
+
+  const point3D_t merged_point3D_id =
+      reconstruction_->MergePoints3D(point3D_id, corr_point3D_id);
+
+  modified_point3D_ids_.erase(point3D_id);
+  modified_point3D_ids_.erase(corr_point3D_id);
+  modified_point3D_ids_.insert(merged_point3D_id);
+
+  // Merge merged 3D point and return, as the original points are deleted.
+  const size_t num_merged_recursive = Merge(options, merged_point3D_id);
+  if (num_merged_recursive > 0) {
+    return num_merged_recursive;
+  } else {
+    return num_merged;
+  }
+}
+
 size_t IncrementalTriangulator::Complete(const Options& options,
                                          const point3D_t point3D_id) {
-  size_t num_completed = 0;
+  std::vector<TrackElement> track_els;
+  EstimateComplete(options, point3D_id, &track_els);
+
+  for (const auto& track_el : track_els) {
+    reconstruction_->AddObservation(point3D_id, track_el);
+  }
+
+  if (!track_els.empty()) {
+    modified_point3D_ids_.insert(point3D_id);
+  }
+
+  return track_els.size();
+}
+
+void IncrementalTriangulator::EstimateComplete(
+    const Options& options, const point3D_t point3D_id,
+    std::vector<TrackElement>* track_els) {
+  track_els->clear();
 
   if (!reconstruction_->ExistsPoint3D(point3D_id)) {
-    return num_completed;
+    return;
   }
 
   const double max_squared_reproj_error =
@@ -689,7 +1257,8 @@ size_t IncrementalTriangulator::Complete(const Options& options,
 
   const Point3D& point3D = reconstruction_->Point3D(point3D_id);
 
-  std::vector<TrackElement> queue = point3D.Track().Elements();
+  std::vector<TrackElement> queue(point3D.Track().Elements().begin(),
+                                  point3D.Track().Elements().end());
 
   const int max_transitivity = options.complete_max_transitivity;
   for (int transitivity = 0; transitivity < max_transitivity; ++transitivity) {
@@ -701,7 +1270,7 @@ size_t IncrementalTriangulator::Complete(const Options& options,
     queue.clear();
 
     for (const TrackElement queue_elem : prev_queue) {
-      const std::vector<CorrespondenceGraph::Correspondence>& corrs =
+      const CorrespondenceGraph::CorrespondenceRange corrs =
           correspondence_graph_->FindCorrespondences(queue_elem.image_id,
                                                      queue_elem.point2D_idx);
 
@@ -716,6 +1285,19 @@ size_t IncrementalTriangulator::Complete(const Options& options,
           continue;
         }
 
+        // The observations are only added to the reconstruction afterwards,
+        // so skip observations that were already added to the track.
+        const TrackElement track_el(corr.image_id, corr.point2D_idx);
+        if (std::find_if(track_els->begin(), track_els->end(),
+                         [&track_el](const TrackElement& added_track_el) {
+                           return added_track_el.image_id ==
+                                      track_el.image_id &&
+                                  added_track_el.point2D_idx ==
+                                      track_el.point2D_idx;
+                         }) != track_els->end()) {
+          continue;
+        }
+
         const Camera& camera = reconstruction_->Camera(image.CameraId());
         if (HasCameraBogusParams(options, camera)) {
           continue;
@@ -728,21 +1310,15 @@ size_t IncrementalTriangulator::Complete(const Options& options,
         }
 
         // Success, add observation to point track.
-        const TrackElement track_el(corr.image_id, corr.point2D_idx);
-        reconstruction_->AddObservation(point3D_id, track_el);
-        modified_point3D_ids_.insert(point3D_id);
+        track_els->push_back(track_el);
 
         // Recursively complete track for this new correspondence.
         if (transitivity < max_transitivity - 1) {
           queue.emplace_back(corr.image_id, corr.point2D_idx);
         }
-
-        num_completed += 1;
       }
     }
   }
-
-  return num_completed;
 }
 
 bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
@@ -759,4 +1335,10 @@ bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
   }
 }
 
+void IncrementalTriangulator::CacheCameraBogusParams(const Options& options) {
+  for (const auto& camera : reconstruction_->Cameras()) {
+    HasCameraBogusParams(options, camera.second);
+  }
+}
+
 }  // namespace colmap
@@ -34,6 +34,7 @@
 
 #include "base/database_cache.h"
 #include "base/reconstruction.h"
+#include "estimators/triangulation.h"
 #include "util/alignment.h"
 
 namespace colmap {
@@ -84,6 +85,12 @@ class IncrementalTriangulator {
     double max_focal_length_ratio = 10.0;
     double max_extra_param = 1.0;
 
+    // Number of threads to estimate new triangulations in `TriangulateImage`
+    // and `Retriangulate` and to complete and merge all tracks. The random
+    // sampling of the estimations is seeded per observation from the PRNG of
+    // the calling thread, so the results do not depend on this number.
+    int num_threads = -1;
+
     bool Check() const;
   };
 
@@ -101,6 +108,16 @@ class IncrementalTriangulator {
   // in the associated reconstruction.
   size_t TriangulateImage(const Options& options, const image_t image_id);
 
+  // Triangulate the observations of all registered images at once, which is
+  // much faster than `TriangulateImage` for many images with known poses.
+  //
+  // The tracks are the connected components of the correspondences between
+  // the not yet triangulated observations. The correspondences are found in
+  // parallel and the tracks are then estimated in parallel batches, without
+  // continuing or merging existing 3D points. Returns the number of
+  // triangulated observations.
+  size_t TriangulateAllImages(const Options& options);
+
   // Complete triangulations for image. Tries to create new tracks for not
   // yet triangulated observations and tries to complete existing tracks.
   // Returns the number of completed observations.
@@ -165,10 +182,24 @@ class IncrementalTriangulator {
               const point2D_t point2D_idx, const size_t transitivity,
               std::vector<CorrData>* corrs_data);
 
+  // Scratch data of `TriangulateImage`, defined below, since it holds vectors
+  // of `CorrData` that require the aligned vector specialization.
+  struct CreateData;
+  struct ObservationData;
+
   // Try to create a new 3D point from the given correspondences.
   size_t Create(const Options& options,
                 const std::vector<CorrData>& corrs_data);
 
+  // Set up and estimate a new 3D point from the given correspondences without
+  // modifying the reconstruction. Returns false if no 3D point was estimated.
+  bool EstimateCreate(const Options& options,
+                      const std::vector<CorrData>& corrs_data,
+                      CreateData* create_data) const;
+
+  // Add the estimated 3D point to the reconstruction.
+  size_t AddCreate(const Options& options, const CreateData& create_data);
+
   // Try to continue the 3D point with the given correspondences.
   size_t Continue(const Options& options, const CorrData& ref_corr_data,
                   const std::vector<CorrData>& corrs_data);
@@ -176,12 +207,37 @@ class IncrementalTriangulator {
   // Try to merge 3D point with any of its corresponding 3D points.
   size_t Merge(const Options& options, const point3D_t point3D_id);
 
+  // Find the first corresponding 3D point, which can be merged with the given
+  // 3D point, without modifying the reconstruction or the merge trials. All
+  // corresponding 3D points encountered up to this point are returned in
+  // `corr_point3D_ids`. Returns `kInvalidPoint3DId` if there is none.
+  point3D_t EstimateMerge(const Options& options, const point3D_t point3D_id,
+                          std::vector<point3D_t>* corr_point3D_ids) const;
+
+  // Check whether all observations of both 3D points are inliers w.r.t. their
+  // merged 3D point.
+  bool IsMergeConsistent(const Options& options, const Point3D& point3D,
+                         const Point3D& corr_point3D) const;
+
+  // Merge the two 3D points and recursively merge the merged 3D point.
+  size_t AddMerge(const Options& options, const point3D_t point3D_id,
+                  const point3D_t corr_point3D_id);
+
   // Try to transitively complete the track of a 3D point.
   size_t Complete(const Options& options, const point3D_t point3D_id);
 
+  // Find the observations that complete the track of a 3D point in the order,
+  // in which `Complete` adds them, without modifying the reconstruction.
+  void EstimateComplete(const Options& options, const point3D_t point3D_id,
+                        std::vector<TrackElement>* track_els);
+
   // Check if camera has bogus parameters and cache the result.
   bool HasCameraBogusParams(const Options& options, const Camera& camera);
 
+  // Cache the bogus parameters of all cameras, such that subsequent calls to
+  // `HasCameraBogusParams` do not modify the cache and are thread-safe.
+  void CacheCameraBogusParams(const Options& options);
+
   // Database cache for the reconstruction. Used to retrieve correspondence
   // information for triangulation.
   const CorrespondenceGraph* correspondence_graph_;
@@ -201,6 +257,10 @@ class IncrementalTriangulator {
   // Changed 3D points, i.e. if a 3D point is modified (created, continued,
   // deleted, merged, etc.). Cleared once `ModifiedPoints3D` is called.
   std::unordered_set<point3D_t> modified_point3D_ids_;
+
+  // Scratch buffers of `TriangulateImage`, which are kept between calls to
+  // avoid repeated allocations.
+  std::vector<ObservationData> observations_data_;
 };
 
 }  // namespace colmap
@@ -208,4 +268,31 @@ class IncrementalTriangulator {
 EIGEN_DEFINE_STL_VECTOR_SPECIALIZATION_CUSTOM(
     colmap::IncrementalTriangulator::CorrData)
 
+namespace colmap {
+
+// Data to create a new 3D point from a set of correspondences. The data is
+// set up and estimated without modifying the reconstruction, such that
+// multiple 3D points can be estimated in parallel.
+struct IncrementalTriangulator::CreateData {
+  std::vector<CorrData> corrs_data;
+  std::vector<TriangulationEstimator::PointData> point_data;
+  std::vector<TriangulationEstimator::PoseData> pose_data;
+  std::vector<char> inlier_mask;
+  Eigen::Vector3d xyz;
+  bool success = false;
+};
+
+// Correspondences of an observation in `TriangulateImage`.
+struct IncrementalTriangulator::ObservationData {
+  point2D_t point2D_idx;
+  // The number of triangulated correspondences including the observation.
+  size_t num_triangulated;
+  // Whether the observation creates a new 3D point in `create_data`.
+  bool create;
+  std::vector<CorrData> corrs_data;
+  CreateData create_data;
+};
+
+}  // namespace colmap
+
 #endif  // COLMAP_SRC_SFM_INCREMENTAL_TRIANGULATOR_H_
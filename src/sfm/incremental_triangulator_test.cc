@@ -0,0 +1,144 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "sfm/incremental_triangulator"
+#include "util/testing.h"
+
+#include <functional>
+
+#include "base/database_cache.h"
+#include "base/synthetic.h"
+#include "sfm/incremental_triangulator.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+// Load the images of the synthetic scene with their ground-truth poses but
+// without any 3D points.
+void SetUpReconstruction(const Reconstruction& gt_reconstruction,
+                         const DatabaseCache& database_cache,
+                         Reconstruction* reconstruction) {
+  reconstruction->Load(database_cache);
+  reconstruction->SetUp(&database_cache.CorrespondenceGraph());
+  for (const image_t image_id : gt_reconstruction.RegImageIds()) {
+    Image& image = reconstruction->Image(image_id);
+    image.SetQvec(gt_reconstruction.Image(image_id).Qvec());
+    image.SetTvec(gt_reconstruction.Image(image_id).Tvec());
+    reconstruction->RegisterImage(image_id);
+  }
+}
+
+void CheckEqualPoints3D(const Reconstruction& reconstruction1,
+                        const Reconstruction& reconstruction2) {
+  BOOST_CHECK_GT(reconstruction1.NumPoints3D(), 0);
+  BOOST_CHECK_EQUAL(reconstruction1.NumPoints3D(),
+                    reconstruction2.NumPoints3D());
+  for (const auto& point3D : reconstruction1.Points3D()) {
+    BOOST_CHECK(reconstruction2.ExistsPoint3D(point3D.first));
+    if (!reconstruction2.ExistsPoint3D(point3D.first)) {
+      continue;
+    }
+    const Point3D& other_point3D = reconstruction2.Point3D(point3D.first);
+    BOOST_CHECK_EQUAL(point3D.second.XYZ(), other_point3D.XYZ());
+    BOOST_CHECK_EQUAL(point3D.second.Track().Length(),
+                      other_point3D.Track().Length());
+  }
+}
+
+// Triangulate a noisy synthetic scene with known poses from scratch with
+// different numbers of threads and check that the results are the same, i.e.,
+// that they do not depend on the assignment of the estimations to threads.
+void CheckTriangulationDeterministic(
+    const std::function<void(const IncrementalTriangulator::Options&,
+                             const std::vector<image_t>&,
+                             IncrementalTriangulator*)>& triangulate) {
+  SyntheticDatasetOptions synthetic_options;
+  synthetic_options.num_images = 20;
+  synthetic_options.num_points3D = 2000;
+  synthetic_options.mean_track_length = 20;
+  synthetic_options.point2D_stddev = 0.5;
+  synthetic_options.match_outlier_ratio = 0.3;
+  Reconstruction gt_reconstruction;
+  Database database(":memory:");
+  SynthesizeDataset(synthetic_options, &gt_reconstruction, &database);
+
+  DatabaseCache database_cache;
+  database_cache.Load(database, 0, true, {});
+
+  std::vector<Reconstruction> reconstructions(3);
+  const std::vector<int> num_threads = {1, 2, 4};
+  for (size_t i = 0; i < reconstructions.size(); ++i) {
+    SetUpReconstruction(gt_reconstruction, database_cache,
+                        &reconstructions[i]);
+    IncrementalTriangulator triangulator(&database_cache.CorrespondenceGraph(),
+                                         &reconstructions[i]);
+    IncrementalTriangulator::Options options;
+    options.num_threads = num_threads[i];
+    SetPRNGSeed(0);
+    triangulate(options, gt_reconstruction.RegImageIds(), &triangulator);
+  }
+
+  CheckEqualPoints3D(reconstructions[0], reconstructions[1]);
+  CheckEqualPoints3D(reconstructions[0], reconstructions[2]);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestTriangulateImageDeterministic) {
+  CheckTriangulationDeterministic(
+      [](const IncrementalTriangulator::Options& options,
+         const std::vector<image_t>& image_ids,
+         IncrementalTriangulator* triangulator) {
+        for (const image_t image_id : image_ids) {
+          triangulator->TriangulateImage(options, image_id);
+        }
+      });
+}
+
+BOOST_AUTO_TEST_CASE(TestRetriangulateDeterministic) {
+  CheckTriangulationDeterministic(
+      [](const IncrementalTriangulator::Options& options,
+         const std::vector<image_t>&, IncrementalTriangulator* triangulator) {
+        // All image pairs are under-reconstructed without any 3D points.
+        BOOST_CHECK_GT(triangulator->Retriangulate(options), 0);
+        triangulator->CompleteAllTracks(options);
+        triangulator->MergeAllTracks(options);
+      });
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangulateAllImagesDeterministic) {
+  CheckTriangulationDeterministic(
+      [](const IncrementalTriangulator::Options& options,
+         const std::vector<image_t>&, IncrementalTriangulator* triangulator) {
+        BOOST_CHECK_GT(triangulator->TriangulateAllImages(options), 0);
+      });
+}
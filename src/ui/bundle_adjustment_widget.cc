@@ -69,6 +69,9 @@ BundleAdjustmentWidget::BundleAdjustmentWidget(MainWindow* main_window,
                 "refine_extra_params");
   AddOptionBool(&options->bundle_adjustment->refine_extrinsics,
                 "refine_extrinsics");
+  AddOptionBool(&options->bundle_adjustment->use_gpu, "use_gpu");
+  AddOptionBool(&options->bundle_adjustment->use_mixed_precision,
+                "use_mixed_precision");
 
   QPushButton* run_button = new QPushButton(tr("Run"), this);
   grid_layout_->addWidget(run_button, grid_layout_->rowCount(), 1);
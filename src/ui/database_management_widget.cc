@@ -157,22 +157,22 @@ void MatchesTab::Reload(const std::vector<Image>& images,
                         const image_t image_id) {
   matches_.clear();
 
-  // Find all matched images
-
+  std::unordered_map<image_t, const Image*> images_by_id;
   for (const auto& image : images) {
-    if (image.ImageId() == image_id) {
-      image_ = &image;
-      continue;
-    }
+    images_by_id.emplace(image.ImageId(), &image);
+  }
 
-    if (database_->ExistsMatches(image_id, image.ImageId())) {
-      const auto matches = database_->ReadMatches(image_id, image.ImageId());
+  image_ = images_by_id.at(image_id);
 
-      if (matches.size() > 0) {
-        matches_.emplace_back(&image, matches);
-      }
-    }
-  }
+  // Find all matched images.
+
+  database_->ReadImageMatches(
+      image_id, [&](const image_t other_image_id, FeatureMatches* matches) {
+        const auto image = images_by_id.find(other_image_id);
+        if (image != images_by_id.end()) {
+          matches_.emplace_back(image->second, std::move(*matches));
+        }
+      });
 
   FillTable();
 }
@@ -193,24 +193,25 @@ void TwoViewGeometriesTab::Reload(const std::vector<Image>& images,
   matches_.clear();
   configs_.clear();
 
-  // Find all matched images.
-
+  std::unordered_map<image_t, const Image*> images_by_id;
   for (const auto& image : images) {
-    if (image.ImageId() == image_id) {
-      image_ = &image;
-      continue;
-    }
+    images_by_id.emplace(image.ImageId(), &image);
+  }
 
-    if (database_->ExistsInlierMatches(image_id, image.ImageId())) {
-      const auto two_view_geometry =
-          database_->ReadTwoViewGeometry(image_id, image.ImageId());
+  image_ = images_by_id.at(image_id);
 
-      if (two_view_geometry.inlier_matches.size() > 0) {
-        matches_.emplace_back(&image, two_view_geometry.inlier_matches);
-        configs_.push_back(two_view_geometry.config);
-      }
-    }
-  }
+  // Find all matched images.
+
+  database_->ReadImageTwoViewGeometries(
+      image_id,
+      [&](const image_t other_image_id, TwoViewGeometry* two_view_geometry) {
+        const auto image = images_by_id.find(other_image_id);
+        if (image != images_by_id.end()) {
+          matches_.emplace_back(image->second,
+                                std::move(two_view_geometry->inlier_matches));
+          configs_.push_back(two_view_geometry->config);
+        }
+      });
 
   FillTable();
 }
@@ -259,132 +260,321 @@ void OverlappingImagesWidget::closeEvent(QCloseEvent*) {
   parent_->setEnabled(true);
 }
 
-CameraTab::CameraTab(QWidget* parent, Database* database)
-    : QWidget(parent), database_(database) {
-  QGridLayout* grid = new QGridLayout(this);
-
-  info_label_ = new QLabel(this);
-  grid->addWidget(info_label_, 0, 0);
+const int DatabaseTableModel::kNumRowsPerFetch = 1000;
 
-  QPushButton* add_camera_button = new QPushButton(tr("Add camera"), this);
-  connect(add_camera_button, &QPushButton::released, this, &CameraTab::Add);
-  grid->addWidget(add_camera_button, 0, 1, Qt::AlignRight);
+DatabaseTableModel::DatabaseTableModel(QWidget* parent, Database* database,
+                                       const QStringList& header)
+    : QAbstractTableModel(parent),
+      parent_(parent),
+      database_(database),
+      header_(header),
+      num_rows_(0),
+      num_fetched_rows_(0) {}
 
-  QPushButton* set_model_button = new QPushButton(tr("Set model"), this);
-  connect(set_model_button, &QPushButton::released, this, &CameraTab::SetModel);
-  grid->addWidget(set_model_button, 0, 2, Qt::AlignRight);
+int DatabaseTableModel::rowCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : num_fetched_rows_;
+}
 
-  table_widget_ = new QTableWidget(this);
-  table_widget_->setColumnCount(6);
+int DatabaseTableModel::columnCount(const QModelIndex& parent) const {
+  return parent.isValid() ? 0 : header_.size();
+}
 
-  QStringList table_header;
-  table_header << "camera_id"
-               << "model"
-               << "width"
-               << "height"
-               << "params"
-               << "prior_focal_length";
-  table_widget_->setHorizontalHeaderLabels(table_header);
+QVariant DatabaseTableModel::headerData(int section,
+                                        Qt::Orientation orientation,
+                                        int role) const {
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal ||
+      section < 0 || section >= header_.size()) {
+    return QVariant();
+  }
+  return header_[section];
+}
 
-  table_widget_->setShowGrid(true);
-  table_widget_->setSelectionBehavior(QAbstractItemView::SelectRows);
-  table_widget_->horizontalHeader()->setStretchLastSection(true);
-  table_widget_->verticalHeader()->setVisible(false);
-  table_widget_->verticalHeader()->setDefaultSectionSize(20);
+bool DatabaseTableModel::canFetchMore(const QModelIndex& parent) const {
+  return !parent.isValid() && num_fetched_rows_ < num_rows_;
+}
 
-  connect(table_widget_, &QTableWidget::itemChanged, this,
-          &CameraTab::itemChanged);
+void DatabaseTableModel::fetchMore(const QModelIndex& parent) {
+  if (parent.isValid()) {
+    return;
+  }
 
-  grid->addWidget(table_widget_, 1, 0, 1, 3);
+  const int num_new_rows =
+      std::min(kNumRowsPerFetch, num_rows_ - num_fetched_rows_);
+  if (num_new_rows <= 0) {
+    return;
+  }
 
-  grid->setColumnStretch(0, 1);
+  beginInsertRows(QModelIndex(), num_fetched_rows_,
+                  num_fetched_rows_ + num_new_rows - 1);
+  num_fetched_rows_ += num_new_rows;
+  endInsertRows();
 }
 
-void CameraTab::Reload() {
-  QString info;
-  info += QString("Cameras: ") + QString::number(database_->NumCameras());
-  info_label_->setText(info);
+void DatabaseTableModel::FetchAll() {
+  while (canFetchMore(QModelIndex())) {
+    fetchMore(QModelIndex());
+  }
+}
 
-  cameras_ = database_->ReadAllCameras();
+void DatabaseTableModel::SetNumRows(const size_t num_rows) {
+  num_rows_ = static_cast<int>(num_rows);
+  num_fetched_rows_ = 0;
+}
 
-  // Make sure, itemChanged is not invoked, while setting up the table.
-  table_widget_->blockSignals(true);
+CameraTableModel::CameraTableModel(QWidget* parent, Database* database)
+    : DatabaseTableModel(parent, database,
+                         QStringList() << "camera_id"
+                                       << "model"
+                                       << "width"
+                                       << "height"
+                                       << "params"
+                                       << "prior_focal_length") {}
 
-  table_widget_->clearContents();
-  table_widget_->setRowCount(cameras_.size());
+void CameraTableModel::Reload() {
+  beginResetModel();
 
+  cameras_ = database_->ReadAllCameras();
   std::sort(cameras_.begin(), cameras_.end(),
             [](const Camera& camera1, const Camera& camera2) {
               return camera1.CameraId() < camera2.CameraId();
             });
+  SetNumRows(cameras_.size());
 
-  for (size_t i = 0; i < cameras_.size(); ++i) {
-    const Camera& camera = cameras_[i];
-    QTableWidgetItem* id_item =
-        new QTableWidgetItem(QString::number(camera.CameraId()));
-    id_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 0, id_item);
-
-    QTableWidgetItem* model_item =
-        new QTableWidgetItem(QString::fromStdString(camera.ModelName()));
-    model_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 1, model_item);
-
-    table_widget_->setItem(
-        i, 2, new QTableWidgetItem(QString::number(camera.Width())));
-    table_widget_->setItem(
-        i, 3, new QTableWidgetItem(QString::number(camera.Height())));
-
-    table_widget_->setItem(i, 4,
-                           new QTableWidgetItem(QString::fromStdString(
-                               VectorToCSV(camera.Params()))));
-    table_widget_->setItem(
-        i, 5,
-        new QTableWidgetItem(QString::number(camera.HasPriorFocalLength())));
-  }
-  table_widget_->resizeColumnsToContents();
-
-  table_widget_->blockSignals(false);
+  endResetModel();
 }
 
-void CameraTab::Clear() {
+void CameraTableModel::Clear() {
+  beginResetModel();
   cameras_.clear();
-  table_widget_->clearContents();
+  SetNumRows(0);
+  endResetModel();
 }
 
-void CameraTab::itemChanged(QTableWidgetItem* item) {
-  Camera& camera = cameras_.at(item->row());
-  const std::vector<double> prev_params = camera.Params();
+Camera& CameraTableModel::CameraAt(const int row) { return cameras_.at(row); }
+
+QVariant CameraTableModel::data(const QModelIndex& index, int role) const {
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+    return QVariant();
+  }
+
+  const Camera& camera = cameras_.at(index.row());
+  switch (index.column()) {
+    case 0:
+      return QString::number(camera.CameraId());
+    case 1:
+      return QString::fromStdString(camera.ModelName());
+    case 2:
+      return QString::number(camera.Width());
+    case 3:
+      return QString::number(camera.Height());
+    case 4:
+      return QString::fromStdString(VectorToCSV(camera.Params()));
+    case 5:
+      return QString::number(camera.HasPriorFocalLength());
+    default:
+      return QVariant();
+  }
+}
 
-  switch (item->column()) {
+bool CameraTableModel::setData(const QModelIndex& index, const QVariant& value,
+                               int role) {
+  if (!index.isValid() || role != Qt::EditRole) {
+    return false;
+  }
+
+  Camera& camera = cameras_.at(index.row());
+
+  switch (index.column()) {
     // case 0: never change the camera ID
     // case 1: never change the camera model
     case 2:
-      camera.SetWidth(static_cast<size_t>(item->data(Qt::DisplayRole).toInt()));
+      camera.SetWidth(static_cast<size_t>(value.toInt()));
       break;
     case 3:
-      camera.SetHeight(
-          static_cast<size_t>(item->data(Qt::DisplayRole).toInt()));
+      camera.SetHeight(static_cast<size_t>(value.toInt()));
       break;
     case 4:
-      if (!camera.SetParamsFromString(item->text().toUtf8().constData())) {
-        QMessageBox::critical(this, "", tr("Invalid camera parameters."));
-        table_widget_->blockSignals(true);
-        item->setText(QString::fromStdString(VectorToCSV(prev_params)));
-        table_widget_->blockSignals(false);
+      if (!camera.SetParamsFromString(value.toString().toUtf8().constData())) {
+        QMessageBox::critical(parent_, "", tr("Invalid camera parameters."));
+        return false;
       }
       break;
     case 5:
-      camera.SetPriorFocalLength(
-          static_cast<bool>(item->data(Qt::DisplayRole).toInt()));
+      camera.SetPriorFocalLength(static_cast<bool>(value.toInt()));
       break;
     default:
-      break;
+      return false;
   }
 
   database_->UpdateCamera(camera);
+
+  emit dataChanged(index, index);
+
+  return true;
+}
+
+Qt::ItemFlags CameraTableModel::flags(const QModelIndex& index) const {
+  if (index.column() <= 1) {
+    return Qt::ItemIsSelectable;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEditable | Qt::ItemIsEnabled;
 }
 
+ImageTableModel::ImageTableModel(QWidget* parent, Database* database)
+    : DatabaseTableModel(parent, database,
+                         QStringList() << "image_id"
+                                       << "name"
+                                       << "camera_id"
+                                       << "qw"
+                                       << "qx"
+                                       << "qy"
+                                       << "qz"
+                                       << "tx"
+                                       << "ty"
+                                       << "tz") {}
+
+void ImageTableModel::Reload() {
+  beginResetModel();
+  images_ = database_->ReadAllImages();
+  SetNumRows(images_.size());
+  endResetModel();
+}
+
+void ImageTableModel::Clear() {
+  beginResetModel();
+  images_.clear();
+  SetNumRows(0);
+  endResetModel();
+}
+
+const std::vector<Image>& ImageTableModel::Images() const { return images_; }
+
+Image& ImageTableModel::ImageAt(const int row) { return images_.at(row); }
+
+void ImageTableModel::UpdateRow(const int row) {
+  emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+}
+
+QVariant ImageTableModel::data(const QModelIndex& index, int role) const {
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole)) {
+    return QVariant();
+  }
+
+  const Image& image = images_.at(index.row());
+  switch (index.column()) {
+    case 0:
+      return QString::number(image.ImageId());
+    case 1:
+      return QString::fromStdString(image.Name());
+    case 2:
+      return QString::number(image.CameraId());
+    case 3:
+    case 4:
+    case 5:
+    case 6:
+      return QString::number(image.QvecPrior(index.column() - 3));
+    case 7:
+    case 8:
+    case 9:
+      return QString::number(image.TvecPrior(index.column() - 7));
+    default:
+      return QVariant();
+  }
+}
+
+bool ImageTableModel::setData(const QModelIndex& index, const QVariant& value,
+                              int role) {
+  if (!index.isValid() || role != Qt::EditRole) {
+    return false;
+  }
+
+  Image& image = images_.at(index.row());
+  camera_t camera_id = kInvalidCameraId;
+
+  switch (index.column()) {
+    // case 0: never change the image ID
+    case 1:
+      image.SetName(value.toString().toUtf8().constData());
+      break;
+    case 2:
+      camera_id = static_cast<camera_t>(value.toInt());
+      if (!database_->ExistsCamera(camera_id)) {
+        QMessageBox::critical(parent_, "", tr("camera_id does not exist."));
+        return false;
+      }
+      image.SetCameraId(camera_id);
+      break;
+    case 3:
+    case 4:
+    case 5:
+    case 6:
+      image.QvecPrior(index.column() - 3) = value.toReal();
+      break;
+    case 7:
+    case 8:
+    case 9:
+      image.TvecPrior(index.column() - 7) = value.toReal();
+      break;
+    default:
+      return false;
+  }
+
+  database_->UpdateImage(image);
+
+  emit dataChanged(index, index);
+
+  return true;
+}
+
+Qt::ItemFlags ImageTableModel::flags(const QModelIndex& index) const {
+  if (index.column() == 0) {
+    return Qt::ItemIsSelectable;
+  }
+  return Qt::ItemIsSelectable | Qt::ItemIsEditable | Qt::ItemIsEnabled;
+}
+
+CameraTab::CameraTab(QWidget* parent, Database* database)
+    : QWidget(parent), database_(database) {
+  QGridLayout* grid = new QGridLayout(this);
+
+  info_label_ = new QLabel(this);
+  grid->addWidget(info_label_, 0, 0);
+
+  QPushButton* add_camera_button = new QPushButton(tr("Add camera"), this);
+  connect(add_camera_button, &QPushButton::released, this, &CameraTab::Add);
+  grid->addWidget(add_camera_button, 0, 1, Qt::AlignRight);
+
+  QPushButton* set_model_button = new QPushButton(tr("Set model"), this);
+  connect(set_model_button, &QPushButton::released, this, &CameraTab::SetModel);
+  grid->addWidget(set_model_button, 0, 2, Qt::AlignRight);
+
+  table_model_ = new CameraTableModel(this, database_);
+
+  table_view_ = new QTableView(this);
+  table_view_->setModel(table_model_);
+
+  table_view_->setShowGrid(true);
+  table_view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  table_view_->horizontalHeader()->setStretchLastSection(true);
+  table_view_->verticalHeader()->setVisible(false);
+  table_view_->verticalHeader()->setDefaultSectionSize(20);
+
+  grid->addWidget(table_view_, 1, 0, 1, 3);
+
+  grid->setColumnStretch(0, 1);
+}
+
+void CameraTab::Reload() {
+  QString info;
+  info += QString("Cameras: ") + QString::number(database_->NumCameras());
+  info_label_->setText(info);
+
+  table_model_->Reload();
+  table_view_->resizeColumnsToContents();
+}
+
+void CameraTab::Clear() { table_model_->Clear(); }
+
 void CameraTab::Add() {
   QStringList camera_models;
 #define CAMERA_MODEL_CASE(CameraModel) \
@@ -412,11 +602,12 @@ void CameraTab::Add() {
   Reload();
 
   // Highlight new camera
-  table_widget_->selectRow(cameras_.size() - 1);
+  table_model_->FetchAll();
+  table_view_->selectRow(table_model_->rowCount() - 1);
 }
 
 void CameraTab::SetModel() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No camera selected."));
@@ -436,20 +627,14 @@ void CameraTab::SetModel() {
     return;
   }
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
   for (QModelIndex& index : select->selectedRows()) {
-    std::cout << index.row() << std::endl;
-    auto& camera = cameras_.at(index.row());
+    auto& camera = table_model_->CameraAt(index.row());
     camera.InitializeWithName(camera_model.toUtf8().constData(),
                               camera.MeanFocalLength(), camera.Width(),
                               camera.Height());
     database_->UpdateCamera(camera);
   }
 
-  table_widget_->blockSignals(false);
-
   Reload();
 }
 
@@ -485,32 +670,18 @@ ImageTab::ImageTab(QWidget* parent, CameraTab* camera_tab,
           &ImageTab::ShowMatches);
   grid->addWidget(overlapping_images_button, 0, 4, Qt::AlignRight);
 
-  table_widget_ = new QTableWidget(this);
-  table_widget_->setColumnCount(10);
-
-  QStringList table_header;
-  table_header << "image_id"
-               << "name"
-               << "camera_id"
-               << "qw"
-               << "qx"
-               << "qy"
-               << "qz"
-               << "tx"
-               << "ty"
-               << "tz";
-  table_widget_->setHorizontalHeaderLabels(table_header);
+  table_model_ = new ImageTableModel(this, database_);
 
-  table_widget_->setShowGrid(true);
-  table_widget_->setSelectionBehavior(QAbstractItemView::SelectRows);
-  table_widget_->horizontalHeader()->setStretchLastSection(true);
-  table_widget_->verticalHeader()->setVisible(false);
-  table_widget_->verticalHeader()->setDefaultSectionSize(20);
+  table_view_ = new QTableView(this);
+  table_view_->setModel(table_model_);
 
-  connect(table_widget_, &QTableWidget::itemChanged, this,
-          &ImageTab::itemChanged);
+  table_view_->setShowGrid(true);
+  table_view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  table_view_->horizontalHeader()->setStretchLastSection(true);
+  table_view_->verticalHeader()->setVisible(false);
+  table_view_->verticalHeader()->setDefaultSectionSize(20);
 
-  grid->addWidget(table_widget_, 1, 0, 1, 5);
+  grid->addWidget(table_view_, 1, 0, 1, 5);
 
   grid->setColumnStretch(0, 3);
 
@@ -526,99 +697,14 @@ void ImageTab::Reload() {
   info += QString("Features: ") + QString::number(database_->NumKeypoints());
   info_label_->setText(info);
 
-  images_ = database_->ReadAllImages();
-
-  // Make sure, itemChanged is not invoked, while setting up the table
-  table_widget_->blockSignals(true);
-
-  table_widget_->clearContents();
-  table_widget_->setRowCount(images_.size());
-
-  for (size_t i = 0; i < images_.size(); ++i) {
-    const auto& image = images_[i];
-    QTableWidgetItem* id_item =
-        new QTableWidgetItem(QString::number(image.ImageId()));
-    id_item->setFlags(Qt::ItemIsSelectable);
-    table_widget_->setItem(i, 0, id_item);
-    table_widget_->setItem(
-        i, 1, new QTableWidgetItem(QString::fromStdString(image.Name())));
-    table_widget_->setItem(
-        i, 2, new QTableWidgetItem(QString::number(image.CameraId())));
-    table_widget_->setItem(
-        i, 3, new QTableWidgetItem(QString::number(image.QvecPrior(0))));
-    table_widget_->setItem(
-        i, 4, new QTableWidgetItem(QString::number(image.QvecPrior(1))));
-    table_widget_->setItem(
-        i, 5, new QTableWidgetItem(QString::number(image.QvecPrior(2))));
-    table_widget_->setItem(
-        i, 6, new QTableWidgetItem(QString::number(image.QvecPrior(3))));
-    table_widget_->setItem(
-        i, 7, new QTableWidgetItem(QString::number(image.TvecPrior(0))));
-    table_widget_->setItem(
-        i, 8, new QTableWidgetItem(QString::number(image.TvecPrior(1))));
-    table_widget_->setItem(
-        i, 9, new QTableWidgetItem(QString::number(image.TvecPrior(2))));
-  }
-  table_widget_->resizeColumnsToContents();
-
-  table_widget_->blockSignals(false);
+  table_model_->Reload();
+  table_view_->resizeColumnsToContents();
 }
 
-void ImageTab::Clear() {
-  images_.clear();
-  table_widget_->clearContents();
-}
-
-void ImageTab::itemChanged(QTableWidgetItem* item) {
-  Image& image = images_.at(item->row());
-  camera_t camera_id = kInvalidCameraId;
-
-  switch (item->column()) {
-    // case 0: never change the image ID
-    case 1:
-      image.SetName(item->text().toUtf8().constData());
-      break;
-    case 2:
-      camera_id = static_cast<camera_t>(item->data(Qt::DisplayRole).toInt());
-      if (!database_->ExistsCamera(camera_id)) {
-        QMessageBox::critical(this, "", tr("camera_id does not exist."));
-        table_widget_->blockSignals(true);
-        item->setText(QString::number(image.CameraId()));
-        table_widget_->blockSignals(false);
-      } else {
-        image.SetCameraId(camera_id);
-      }
-      break;
-    case 3:
-      image.QvecPrior(0) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 4:
-      image.QvecPrior(1) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 5:
-      image.QvecPrior(2) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 6:
-      image.QvecPrior(3) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 7:
-      image.TvecPrior(0) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 8:
-      image.TvecPrior(1) = item->data(Qt::DisplayRole).toReal();
-      break;
-    case 9:
-      image.TvecPrior(2) = item->data(Qt::DisplayRole).toReal();
-      break;
-    default:
-      break;
-  }
-
-  database_->UpdateImage(image);
-}
+void ImageTab::Clear() { table_model_->Clear(); }
 
 void ImageTab::ShowImage() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -630,7 +716,8 @@ void ImageTab::ShowImage() {
     return;
   }
 
-  const auto& image = images_[select->selectedRows().begin()->row()];
+  const auto& image =
+      table_model_->ImageAt(select->selectedRows().begin()->row());
 
   const auto keypoints = database_->ReadKeypoints(image.ImageId());
   const std::vector<char> tri_mask(keypoints.size(), false);
@@ -642,7 +729,7 @@ void ImageTab::ShowImage() {
 }
 
 void ImageTab::ShowMatches() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -654,15 +741,17 @@ void ImageTab::ShowMatches() {
     return;
   }
 
-  const auto& image = images_[select->selectedRows().begin()->row()];
+  const auto& image =
+      table_model_->ImageAt(select->selectedRows().begin()->row());
 
-  overlapping_images_widget_->ShowMatches(images_, image.ImageId());
+  overlapping_images_widget_->ShowMatches(table_model_->Images(),
+                                          image.ImageId());
   overlapping_images_widget_->show();
   overlapping_images_widget_->raise();
 }
 
 void ImageTab::SetCamera() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -681,22 +770,16 @@ void ImageTab::SetCamera() {
     return;
   }
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
   for (QModelIndex& index : select->selectedRows()) {
-    table_widget_->setItem(index.row(), 2,
-                           new QTableWidgetItem(QString::number(camera_id)));
-    auto& image = images_[index.row()];
+    auto& image = table_model_->ImageAt(index.row());
     image.SetCameraId(camera_id);
     database_->UpdateImage(image);
+    table_model_->UpdateRow(index.row());
   }
-
-  table_widget_->blockSignals(false);
 }
 
 void ImageTab::SplitCamera() {
-  QItemSelectionModel* select = table_widget_->selectionModel();
+  QItemSelectionModel* select = table_view_->selectionModel();
 
   if (!select->hasSelection()) {
     QMessageBox::critical(this, "", tr("No image selected."));
@@ -717,20 +800,13 @@ void ImageTab::SplitCamera() {
 
   const auto camera = database_->ReadCamera(camera_id);
 
-  // Make sure, itemChanged is not invoked, while updating up the table
-  table_widget_->blockSignals(true);
-
   for (QModelIndex& index : select->selectedRows()) {
-    auto& image = images_[index.row()];
+    auto& image = table_model_->ImageAt(index.row());
     image.SetCameraId(database_->WriteCamera(camera));
     database_->UpdateImage(image);
-    table_widget_->setItem(
-        index.row(), 2,
-        new QTableWidgetItem(QString::number(image.CameraId())));
+    table_model_->UpdateRow(index.row());
   }
 
-  table_widget_->blockSignals(false);
-
   camera_tab_->Reload();
 }
 
@@ -111,6 +111,83 @@ class OverlappingImagesWidget : public QWidget {
 // Images, Cameras
 ////////////////////////////////////////////////////////////////////////////////
 
+// Base class for table models of database entries. The rows are added
+// incrementally as the view is scrolled, such that the views only create the
+// visible rows and stay responsive for databases with many entries.
+class DatabaseTableModel : public QAbstractTableModel {
+ public:
+  DatabaseTableModel(QWidget* parent, Database* database,
+                     const QStringList& header);
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+  bool canFetchMore(const QModelIndex& parent) const override;
+  void fetchMore(const QModelIndex& parent) override;
+
+  // Add all remaining rows, e.g., to select the last row.
+  void FetchAll();
+
+ protected:
+  // Set the number of entries and remove all fetched rows. Must be called
+  // between `beginResetModel` and `endResetModel`.
+  void SetNumRows(const size_t num_rows);
+
+  QWidget* parent_;
+  Database* database_;
+
+ private:
+  static const int kNumRowsPerFetch;
+
+  const QStringList header_;
+  int num_rows_;
+  int num_fetched_rows_;
+};
+
+class CameraTableModel : public DatabaseTableModel {
+ public:
+  CameraTableModel(QWidget* parent, Database* database);
+
+  void Reload();
+  void Clear();
+
+  Camera& CameraAt(const int row);
+
+  QVariant data(const QModelIndex& index,
+                int role = Qt::DisplayRole) const override;
+  bool setData(const QModelIndex& index, const QVariant& value,
+               int role = Qt::EditRole) override;
+  Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+ private:
+  std::vector<Camera> cameras_;
+};
+
+class ImageTableModel : public DatabaseTableModel {
+ public:
+  ImageTableModel(QWidget* parent, Database* database);
+
+  void Reload();
+  void Clear();
+
+  const std::vector<Image>& Images() const;
+  Image& ImageAt(const int row);
+
+  // Notify the views that the image in the given row was modified.
+  void UpdateRow(const int row);
+
+  QVariant data(const QModelIndex& index,
+                int role = Qt::DisplayRole) const override;
+  bool setData(const QModelIndex& index, const QVariant& value,
+               int role = Qt::EditRole) override;
+  Qt::ItemFlags flags(const QModelIndex& index) const override;
+
+ private:
+  std::vector<Image> images_;
+};
+
 class CameraTab : public QWidget {
  public:
   CameraTab(QWidget* parent, Database* database);
@@ -119,15 +196,13 @@ class CameraTab : public QWidget {
   void Clear();
 
  private:
-  void itemChanged(QTableWidgetItem* item);
   void Add();
   void SetModel();
 
   Database* database_;
 
-  std::vector<Camera> cameras_;
-
-  QTableWidget* table_widget_;
+  CameraTableModel* table_model_;
+  QTableView* table_view_;
   QLabel* info_label_;
 };
 
@@ -140,8 +215,6 @@ class ImageTab : public QWidget {
   void Clear();
 
  private:
-  void itemChanged(QTableWidgetItem* item);
-
   void ShowImage();
   void ShowMatches();
   void SetCamera();
@@ -152,9 +225,8 @@ class ImageTab : public QWidget {
   OptionManager* options_;
   Database* database_;
 
-  std::vector<Image> images_;
-
-  QTableWidget* table_widget_;
+  ImageTableModel* table_model_;
+  QTableView* table_view_;
   QLabel* info_label_;
 
   OverlappingImagesWidget* overlapping_images_widget_;
@@ -56,6 +56,10 @@ class StereoOptionsTab : public OptionsWidget {
     AddOptionInt(&options->patch_match_stereo->max_image_size, "max_image_size",
                  -1);
     AddOptionText(&options->patch_match_stereo->gpu_index, "gpu_index");
+    AddOptionInt(&options->patch_match_stereo->num_problems_per_gpu,
+                 "num_problems_per_gpu", 1);
+    AddOptionBool(&options->patch_match_stereo->half_precision,
+                  "half_precision");
     AddOptionDouble(&options->patch_match_stereo->depth_min, "depth_min", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_max, "depth_max", -1);
     AddOptionInt(&options->patch_match_stereo->window_radius, "window_radius");
@@ -71,12 +75,18 @@ class StereoOptionsTab : public OptionsWidget {
                     "incident_angle_sigma");
     AddOptionInt(&options->patch_match_stereo->num_iterations,
                  "num_iterations");
+    AddOptionInt(&options->patch_match_stereo->num_pyramid_levels,
+                 "num_pyramid_levels", 1);
+    AddOptionInt(&options->patch_match_stereo->pyramid_num_iterations,
+                 "pyramid_num_iterations", 1);
     AddOptionBool(&options->patch_match_stereo->geom_consistency,
                   "geom_consistency");
     AddOptionDouble(&options->patch_match_stereo->geom_consistency_regularizer,
                     "geom_consistency_regularizer");
     AddOptionDouble(&options->patch_match_stereo->geom_consistency_max_cost,
                     "geom_consistency_max_cost");
+    AddOptionBool(&options->patch_match_stereo->interleave_passes,
+                  "interleave_passes");
     AddOptionBool(&options->patch_match_stereo->filter, "filter");
     AddOptionDouble(&options->patch_match_stereo->filter_min_ncc,
                     "filter_min_ncc");
@@ -91,8 +101,14 @@ class StereoOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->patch_match_stereo->cache_size,
                     "cache_size [gigabytes]", 0,
                     std::numeric_limits<double>::max(), 0.1, 1);
+    AddOptionInt(&options->patch_match_stereo->num_prefetch_problems,
+                 "num_prefetch_problems", 0);
     AddOptionBool(&options->patch_match_stereo->write_consistency_graph,
                   "write_consistency_graph");
+    AddOptionBool(&options->patch_match_stereo->write_compressed_maps,
+                  "write_compressed_maps");
+    AddOptionBool(&options->patch_match_stereo->write_half_precision_maps,
+                  "write_half_precision_maps");
   }
 };
 
@@ -116,6 +132,12 @@ class FusionOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->stereo_fusion->cache_size,
                     "cache_size [gigabytes]", 0,
                     std::numeric_limits<double>::max(), 0.1, 1);
+    AddOptionInt(&options->stereo_fusion->num_threads, "num_threads", -1);
+    AddOptionBool(&options->stereo_fusion->use_gpu, "use_gpu");
+    AddOptionInt(&options->stereo_fusion->gpu_index, "gpu_index", -1);
+    AddOptionDouble(&options->stereo_fusion->gpu_cache_size,
+                    "gpu_cache_size [gigabytes]", 0,
+                    std::numeric_limits<double>::max(), 0.1, 1);
   }
 };
 
@@ -129,6 +151,10 @@ class MeshingOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->poisson_meshing->color, "color", 0);
     AddOptionDouble(&options->poisson_meshing->trim, "trim", 0);
     AddOptionInt(&options->poisson_meshing->num_threads, "num_threads", -1);
+    AddOptionInt(&options->poisson_meshing->max_tile_points,
+                 "max_tile_points", 0);
+    AddOptionDouble(&options->poisson_meshing->tile_overlap, "tile_overlap",
+                    0);
 
     AddSection("Delaunay Meshing");
     AddOptionDouble(&options->delaunay_meshing->max_proj_dist, "max_proj_dist",
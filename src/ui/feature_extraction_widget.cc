@@ -104,6 +104,9 @@ SIFTExtractionWidget::SIFTExtractionWidget(QWidget* parent,
   AddOptionInt(&options->sift_extraction->num_threads, "num_threads", -1);
   AddOptionBool(&options->sift_extraction->use_gpu, "use_gpu");
   AddOptionText(&options->sift_extraction->gpu_index, "gpu_index");
+  AddOptionInt(&options->sift_extraction->gpu_batch_size, "gpu_batch_size", 1);
+  AddOptionDirPath(&options->sift_extraction->feature_cache_path,
+                   "feature_cache_path");
 }
 
 void SIFTExtractionWidget::Run() {
@@ -132,6 +132,19 @@ void FeatureMatchingTab::CreateGeneralOptions() {
                                  "multiple_models");
   options_widget_->AddOptionBool(&options_->sift_matching->guided_matching,
                                  "guided_matching");
+  options_widget_->AddOptionBool(
+      &options_->sift_matching->early_exit_verification,
+      "early_exit_verification");
+  options_widget_->AddOptionBool(
+      &options_->sift_matching->progressive_sampling, "progressive_sampling");
+  options_widget_->AddOptionBool(&options_->sift_matching->compress_matches,
+                                 "compress_matches");
+  options_widget_->AddOptionBool(&options_->sift_matching->cpu_cache_indices,
+                                 "cpu_cache_indices");
+  options_widget_->AddOptionBool(&options_->sift_matching->binary_matching,
+                                 "binary_matching");
+  options_widget_->AddOptionFilePath(
+      &options_->sift_matching->feature_store_path, "feature_store_path");
 
   options_widget_->AddSpacer();
 
@@ -175,6 +188,9 @@ SequentialMatchingTab::SequentialMatchingTab(QWidget* parent,
   options_widget_->AddOptionInt(
       &options_->sequential_matching->loop_detection_period,
       "loop_detection_period");
+  options_widget_->AddOptionDouble(
+      &options_->sequential_matching->loop_detection_keyframe_overlap,
+      "loop_detection_keyframe_overlap", 0, 1);
   options_widget_->AddOptionInt(
       &options_->sequential_matching->loop_detection_num_images,
       "loop_detection_num_images");
@@ -225,10 +241,28 @@ VocabTreeMatchingTab::VocabTreeMatchingTab(QWidget* parent,
   options_widget_->AddOptionInt(
       &options_->vocab_tree_matching->num_images_after_verification,
       "num_images_after_verification", 0);
+  options_widget_->AddOptionDouble(
+      &options_->vocab_tree_matching->max_verification_time,
+      "max_verification_time", -1);
+  options_widget_->AddOptionInt(
+      &options_->vocab_tree_matching->max_inverted_file_size,
+      "max_inverted_file_size", -1);
+  options_widget_->AddOptionInt(
+      &options_->vocab_tree_matching->max_num_scored_entries,
+      "max_num_scored_entries", -1);
   options_widget_->AddOptionInt(
       &options_->vocab_tree_matching->max_num_features, "max_num_features", -1);
+  options_widget_->AddOptionBool(
+      &options_->vocab_tree_matching->exhaustive_quantization,
+      "exhaustive_quantization");
+  options_widget_->AddOptionBool(
+      &options_->vocab_tree_matching->use_global_descriptors,
+      "use_global_descriptors");
   options_widget_->AddOptionFilePath(
       &options_->vocab_tree_matching->vocab_tree_path, "vocab_tree_path");
+  options_widget_->AddOptionFilePath(
+      &options_->vocab_tree_matching->vocab_tree_index_path,
+      "vocab_tree_index_path");
 
   CreateGeneralOptions();
 }
@@ -236,7 +270,8 @@ VocabTreeMatchingTab::VocabTreeMatchingTab(QWidget* parent,
 void VocabTreeMatchingTab::Run() {
   options_widget_->WriteOptions();
 
-  if (!ExistsFile(options_->vocab_tree_matching->vocab_tree_path)) {
+  if (!options_->vocab_tree_matching->use_global_descriptors &&
+      !ExistsFile(options_->vocab_tree_matching->vocab_tree_path)) {
     QMessageBox::critical(this, "", tr("Invalid vocabulary tree path."));
     return;
   }
@@ -252,6 +287,8 @@ SpatialMatchingTab::SpatialMatchingTab(QWidget* parent, OptionManager* options)
   options_widget_->AddOptionBool(&options_->spatial_matching->is_gps, "is_gps");
   options_widget_->AddOptionBool(&options_->spatial_matching->ignore_z,
                                  "ignore_z");
+  options_widget_->AddOptionBool(&options_->spatial_matching->use_enu,
+                                 "use_enu");
   options_widget_->AddOptionInt(&options_->spatial_matching->max_num_neighbors,
                                 "max_num_neighbors");
   options_widget_->AddOptionDouble(&options_->spatial_matching->max_distance,
@@ -276,6 +313,9 @@ TransitiveMatchingTab::TransitiveMatchingTab(QWidget* parent,
                                 "batch_size");
   options_widget_->AddOptionInt(&options->transitive_matching->num_iterations,
                                 "num_iterations");
+  options_widget_->AddOptionInt(
+      &options->transitive_matching->max_num_candidates, "max_num_candidates",
+      -1);
 
   CreateGeneralOptions();
 }
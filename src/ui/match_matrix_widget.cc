@@ -33,12 +33,34 @@
 
 namespace colmap {
 
+const size_t MatchMatrixWidget::kMaxMatrixSize = 2048;
+
 MatchMatrixWidget::MatchMatrixWidget(QWidget* parent, OptionManager* options)
-    : ImageViewerWidget(parent), options_(options) {
+    : ImageViewerWidget(parent),
+      options_(options),
+      thread_control_widget_(new ThreadControlWidget(parent)),
+      show_action_(new QAction(this)) {
   setWindowTitle("Match matrix");
+
+  connect(show_action_, &QAction::triggered, this,
+          [this]() {
+            if (match_matrix_.Width() == 0) {
+              return;
+            }
+            ShowBitmap(match_matrix_);
+            match_matrix_.Deallocate();
+          },
+          Qt::QueuedConnection);
 }
 
 void MatchMatrixWidget::Show() {
+  thread_control_widget_->StartFunction("Computing match matrix...", [this]() {
+    ComputeMatchMatrix();
+    show_action_->trigger();
+  });
+}
+
+void MatchMatrixWidget::ComputeMatchMatrix() {
   Database database(*options_->database_path);
 
   if (database.NumImages() == 0) {
@@ -52,38 +74,59 @@ void MatchMatrixWidget::Show() {
               return image1.Name() < image2.Name();
             });
 
-  // Allocate the match matrix image.
-  Bitmap match_matrix;
-  match_matrix.Allocate(images.size(), images.size(), true);
-  match_matrix.Fill(BitmapColor<uint8_t>(255));
-
-  // Map image identifiers to match matrix locations.
+  // Map image identifiers to match matrix locations, where multiple images
+  // share a location if there are more images than the maximum matrix size.
+  const size_t num_images_per_pixel =
+      (images.size() + kMaxMatrixSize - 1) / kMaxMatrixSize;
+  const size_t matrix_size =
+      (images.size() + num_images_per_pixel - 1) / num_images_per_pixel;
   std::unordered_map<image_t, size_t> image_id_to_idx;
+  image_id_to_idx.reserve(images.size());
   for (size_t idx = 0; idx < images.size(); ++idx) {
-    image_id_to_idx.emplace(images[idx].ImageId(), idx);
+    image_id_to_idx.emplace(images[idx].ImageId(), idx / num_images_per_pixel);
   }
 
+  images.clear();
+  images.shrink_to_fit();
+
   std::vector<std::pair<image_t, image_t>> image_pairs;
   std::vector<int> num_inliers;
   database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
 
+  database.Close();
+
+  // Accumulate the maximum number of inliers per location.
+  std::vector<int> max_num_inliers(matrix_size * matrix_size, -1);
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    const size_t idx1 = image_id_to_idx.at(image_pairs[i].first);
+    const size_t idx2 = image_id_to_idx.at(image_pairs[i].second);
+    int& value1 = max_num_inliers[idx1 * matrix_size + idx2];
+    int& value2 = max_num_inliers[idx2 * matrix_size + idx1];
+    value1 = std::max(value1, num_inliers[i]);
+    value2 = std::max(value2, num_inliers[i]);
+  }
+
   // Fill the match matrix.
+  match_matrix_.Allocate(matrix_size, matrix_size, true);
+  match_matrix_.Fill(BitmapColor<uint8_t>(255));
+
   if (!num_inliers.empty()) {
     const double max_value =
         std::log1p(*std::max_element(num_inliers.begin(), num_inliers.end()));
-    for (size_t i = 0; i < image_pairs.size(); ++i) {
-      const double value = std::log1p(num_inliers[i]) / max_value;
-      const size_t idx1 = image_id_to_idx.at(image_pairs[i].first);
-      const size_t idx2 = image_id_to_idx.at(image_pairs[i].second);
-      const BitmapColor<float> color(255 * JetColormap::Red(value),
-                                     255 * JetColormap::Green(value),
-                                     255 * JetColormap::Blue(value));
-      match_matrix.SetPixel(idx1, idx2, color.Cast<uint8_t>());
-      match_matrix.SetPixel(idx2, idx1, color.Cast<uint8_t>());
+    for (size_t y = 0; y < matrix_size; ++y) {
+      for (size_t x = 0; x < matrix_size; ++x) {
+        const int num_pair_inliers = max_num_inliers[y * matrix_size + x];
+        if (num_pair_inliers < 0) {
+          continue;
+        }
+        const double value = std::log1p(num_pair_inliers) / max_value;
+        const BitmapColor<float> color(255 * JetColormap::Red(value),
+                                       255 * JetColormap::Green(value),
+                                       255 * JetColormap::Blue(value));
+        match_matrix_.SetPixel(x, y, color.Cast<uint8_t>());
+      }
     }
   }
-
-  ShowBitmap(match_matrix);
 }
 
 }  // namespace colmap
@@ -33,11 +33,14 @@
 #define COLMAP_SRC_UI_MATCH_MATRIX_WIDGET_H_
 
 #include "ui/image_viewer_widget.h"
+#include "ui/thread_control_widget.h"
 #include "util/option_manager.h"
 
 namespace colmap {
 
-// Widget to visualize match matrix.
+// Widget to visualize match matrix. The matrix is computed in a background
+// thread and, for large databases, downsampled such that each pixel shows the
+// maximum number of inliers of a block of image pairs.
 class MatchMatrixWidget : public ImageViewerWidget {
  public:
   MatchMatrixWidget(QWidget* parent, OptionManager* options);
@@ -45,7 +48,15 @@ class MatchMatrixWidget : public ImageViewerWidget {
   void Show();
 
  private:
+  // Maximum width and height of the match matrix image.
+  static const size_t kMaxMatrixSize;
+
+  void ComputeMatchMatrix();
+
   OptionManager* options_;
+  ThreadControlWidget* thread_control_widget_;
+  QAction* show_action_;
+  Bitmap match_matrix_;
 };
 
 }  // namespace colmap
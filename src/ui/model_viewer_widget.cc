@@ -247,7 +247,7 @@ void ModelViewerWidget::paintGL() {
   }
 
   // Points
-  point_painter_.Render(pmv_matrix, point_size_);
+  point_painter_.Render(pmv_matrix, width(), height(), point_size_);
   point_connection_painter_.Render(pmv_matrix, width(), height(), 1);
 
   // Images
@@ -468,7 +468,8 @@ void ModelViewerWidget::SelectObject(const int x, const int y) {
   // Render in selection mode, with larger points to improve selection accuracy.
   const QMatrix4x4 pmv_matrix = projection_matrix_ * model_view_matrix_;
   image_triangle_painter_.Render(pmv_matrix);
-  point_painter_.Render(pmv_matrix, 2 * point_size_);
+  point_painter_.Render(pmv_matrix, width(), height(), 2 * point_size_,
+                        false);
 
   const int scaled_x = devicePixelRatio() * x;
   const int scaled_y = devicePixelRatio() * (height() - y - 1);
@@ -741,82 +742,56 @@ void ModelViewerWidget::UploadCoordinateGridData() {
 void ModelViewerWidget::UploadPointData(const bool selection_mode) {
   makeCurrent();
 
-  std::vector<PointPainter::Data> data;
-
-  // Assume we want to display the majority of points
-  data.reserve(points3D.size());
+  // The points are stored by their slot, such that the painter only transfers
+  // the points that changed since the last upload. Free slots and filtered
+  // points keep a zero alpha and are not rendered.
+  std::vector<PointPainter::Data> data(points3D.num_slots());
 
   const size_t min_track_len =
       static_cast<size_t>(options_->render->min_track_len);
 
-  if (selected_image_id_ == kInvalidImageId &&
-      images.count(selected_image_id_) == 0) {
-    for (const auto& point3D : points3D) {
-      if (point3D.second.Error() <= options_->render->max_error &&
-          point3D.second.Track().Length() >= min_track_len) {
-        PointPainter::Data painter_point;
-
-        painter_point.x = static_cast<float>(point3D.second.XYZ(0));
-        painter_point.y = static_cast<float>(point3D.second.XYZ(1));
-        painter_point.z = static_cast<float>(point3D.second.XYZ(2));
-
-        Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-
-        } else if (point3D.first == selected_point3D_id_) {
-          color = kSelectedPointColor;
-        } else {
-          color = point_colormap_->ComputeColor(point3D.first, point3D.second);
-        }
-
-        painter_point.r = color(0);
-        painter_point.g = color(1);
-        painter_point.b = color(2);
-        painter_point.a = color(3);
+  const Image* selected_image = nullptr;
+  if (selected_image_id_ != kInvalidImageId &&
+      images.count(selected_image_id_) > 0) {
+    selected_image = &images.at(selected_image_id_);
+  }
 
-        data.push_back(painter_point);
-      }
+  for (size_t slot_idx = 0; slot_idx < points3D.num_slots(); ++slot_idx) {
+    const auto* point3D = points3D.slot(slot_idx);
+    if (point3D == nullptr ||
+        point3D->second.Error() > options_->render->max_error ||
+        point3D->second.Track().Length() < min_track_len) {
+      continue;
     }
-  } else {  // Image selected
-    const auto& selected_image = images[selected_image_id_];
-    for (const auto& point3D : points3D) {
-      if (point3D.second.Error() <= options_->render->max_error &&
-          point3D.second.Track().Length() >= min_track_len) {
-        PointPainter::Data painter_point;
-
-        painter_point.x = static_cast<float>(point3D.second.XYZ(0));
-        painter_point.y = static_cast<float>(point3D.second.XYZ(1));
-        painter_point.z = static_cast<float>(point3D.second.XYZ(2));
-
-        Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-        } else if (selected_image.HasPoint3D(point3D.first)) {
-          color = kSelectedImagePlaneColor;
-        } else if (point3D.first == selected_point3D_id_) {
-          color = kSelectedPointColor;
-        } else {
-          color = point_colormap_->ComputeColor(point3D.first, point3D.second);
-        }
 
-        painter_point.r = color(0);
-        painter_point.g = color(1);
-        painter_point.b = color(2);
-        painter_point.a = color(3);
+    PointPainter::Data& painter_point = data[slot_idx];
 
-        data.push_back(painter_point);
-      }
+    painter_point.x = static_cast<float>(point3D->second.XYZ(0));
+    painter_point.y = static_cast<float>(point3D->second.XYZ(1));
+    painter_point.z = static_cast<float>(point3D->second.XYZ(2));
+
+    Eigen::Vector4f color;
+    if (selection_mode) {
+      const size_t index = selection_buffer_.size();
+      selection_buffer_.push_back(
+          std::make_pair(point3D->first, SELECTION_BUFFER_POINT_IDX));
+      color = IndexToRGB(index);
+    } else if (selected_image != nullptr &&
+               selected_image->HasPoint3D(point3D->first)) {
+      color = kSelectedImagePlaneColor;
+    } else if (point3D->first == selected_point3D_id_) {
+      color = kSelectedPointColor;
+    } else {
+      color = point_colormap_->ComputeColor(point3D->first, point3D->second);
     }
+
+    painter_point.r = color(0);
+    painter_point.g = color(1);
+    painter_point.b = color(2);
+    painter_point.a = color(3);
   }
 
-  point_painter_.Upload(data);
+  point_painter_.Upload(std::move(data));
 }
 
 void ModelViewerWidget::UploadPointConnectionData() {
@@ -31,11 +31,18 @@
 
 #include "ui/point_painter.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <QOpenGLFunctions_3_2_Core>
+
 #include "util/opengl_utils.h"
 
 namespace colmap {
 
-PointPainter::PointPainter() : num_geoms_(0) {}
+const size_t PointPainter::kChunkSize;
+
+PointPainter::PointPainter() : capacity_(0) {}
 
 PointPainter::~PointPainter() {
   vao_.destroy();
@@ -60,60 +67,201 @@ void PointPainter::Setup() {
   vao_.create();
   vbo_.create();
 
+  data_.clear();
+  chunks_.clear();
+  capacity_ = 0;
+
 #if DEBUG
   glDebugLog();
 #endif
 }
 
-void PointPainter::Upload(const std::vector<PointPainter::Data>& data) {
-  num_geoms_ = data.size();
-  if (num_geoms_ == 0) {
-    return;
-  }
+void PointPainter::Upload(std::vector<PointPainter::Data> data) {
+  // Maximum number of unmodified points between two modified points that are
+  // transferred together, to reduce the number of transfers.
+  const size_t kMaxNumUnmodifiedPoints = 64;
+
+  const size_t num_prev_points = data_.size();
+  std::vector<bool> modified_chunks((data.size() + kChunkSize - 1) / kChunkSize,
+                                    false);
 
   vao_.bind();
   vbo_.bind();
 
-  // Upload data array to GPU
-  vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-  vbo_.allocate(data.data(),
-                static_cast<int>(data.size() * sizeof(PointPainter::Data)));
+  if (data.size() > capacity_) {
+    // Grow the buffer geometrically, such that a growing reconstruction does
+    // not reallocate the buffer on every upload.
+    capacity_ = std::max(data.size(), 2 * capacity_);
+    vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    vbo_.allocate(static_cast<int>(capacity_ * sizeof(PointPainter::Data)));
+    vbo_.write(0, data.data(),
+               static_cast<int>(data.size() * sizeof(PointPainter::Data)));
+    modified_chunks.assign(modified_chunks.size(), true);
+  } else {
+    const auto IsModified = [&](const size_t idx) {
+      return idx >= num_prev_points ||
+             std::memcmp(&data[idx], &data_[idx],
+                         sizeof(PointPainter::Data)) != 0;
+    };
 
-  // in_position
-  shader_program_.enableAttributeArray("a_position");
-  shader_program_.setAttributeBuffer("a_position", GL_FLOAT, 0, 3,
-                                     sizeof(PointPainter::Data));
+    size_t begin = 0;
+    while (begin < data.size()) {
+      if (!IsModified(begin)) {
+        begin += 1;
+        continue;
+      }
 
-  // in_color
-  shader_program_.enableAttributeArray("a_color");
-  shader_program_.setAttributeBuffer("a_color", GL_FLOAT, 3 * sizeof(GLfloat),
-                                     4, sizeof(PointPainter::Data));
+      size_t last_modified = begin;
+      for (size_t idx = begin + 1; idx < data.size() &&
+                                   idx - last_modified <= kMaxNumUnmodifiedPoints;
+           ++idx) {
+        if (IsModified(idx)) {
+          last_modified = idx;
+        }
+      }
+
+      vbo_.write(static_cast<int>(begin * sizeof(PointPainter::Data)),
+                 &data[begin],
+                 static_cast<int>((last_modified - begin + 1) *
+                                  sizeof(PointPainter::Data)));
+
+      for (size_t chunk_idx = begin / kChunkSize;
+           chunk_idx <= last_modified / kChunkSize; ++chunk_idx) {
+        modified_chunks[chunk_idx] = true;
+      }
+
+      begin = last_modified + 1;
+    }
+
+    // The last chunk may have lost points that were removed from the end.
+    if (data.size() < num_prev_points && !modified_chunks.empty()) {
+      modified_chunks.back() = true;
+    }
+  }
 
   // Make sure they are not changed from the outside
   vbo_.release();
   vao_.release();
 
+  data_ = std::move(data);
+  chunks_.resize(modified_chunks.size());
+  for (size_t chunk_idx = 0; chunk_idx < chunks_.size(); ++chunk_idx) {
+    if (modified_chunks[chunk_idx]) {
+      UpdateChunk(chunk_idx);
+    }
+  }
+
 #if DEBUG
   glDebugLog();
 #endif
 }
 
-void PointPainter::Render(const QMatrix4x4& pmv_matrix,
-                          const float point_size) {
-  if (num_geoms_ == 0) {
+void PointPainter::Render(const QMatrix4x4& pmv_matrix, const int width,
+                          const int height, const float point_size,
+                          const bool level_of_detail) {
+  // Number of rendered points per point-sized area of the viewport that is
+  // covered by a chunk.
+  const float kLevelOfDetailDensity = 4.0f;
+
+  if (data_.empty()) {
     return;
   }
 
+  // The chunks to render per level of detail, where the points of level i are
+  // rendered with a stride of 2^i.
+  size_t num_levels = 1;
+  while ((size_t(1) << (num_levels - 1)) < kChunkSize) {
+    num_levels += 1;
+  }
+  std::vector<std::vector<GLint>> firsts(num_levels);
+  std::vector<std::vector<GLsizei>> counts(num_levels);
+
+  const float num_points_per_pixel =
+      kLevelOfDetailDensity / std::max(1.0f, point_size * point_size);
+
+  for (size_t chunk_idx = 0; chunk_idx < chunks_.size(); ++chunk_idx) {
+    const Chunk& chunk = chunks_[chunk_idx];
+    if (chunk.num_visible_points == 0) {
+      continue;
+    }
+
+    // Cull the chunk, if all corners of its bounding box are outside of the
+    // same clipping plane, and determine its extent in the viewport.
+    int outside_mask = 0x3F;
+    bool is_behind_camera = false;
+    float min_x = 1.0f;
+    float max_x = -1.0f;
+    float min_y = 1.0f;
+    float max_y = -1.0f;
+    for (int i = 0; i < 8; ++i) {
+      const QVector4D corner = pmv_matrix.map(QVector4D(
+          (i & 1) ? chunk.max_bound.x() : chunk.min_bound.x(),
+          (i & 2) ? chunk.max_bound.y() : chunk.min_bound.y(),
+          (i & 4) ? chunk.max_bound.z() : chunk.min_bound.z(), 1.0f));
+      int corner_mask = 0;
+      corner_mask |= (corner.x() < -corner.w()) ? 0x01 : 0;
+      corner_mask |= (corner.x() > corner.w()) ? 0x02 : 0;
+      corner_mask |= (corner.y() < -corner.w()) ? 0x04 : 0;
+      corner_mask |= (corner.y() > corner.w()) ? 0x08 : 0;
+      corner_mask |= (corner.z() < -corner.w()) ? 0x10 : 0;
+      corner_mask |= (corner.z() > corner.w()) ? 0x20 : 0;
+      outside_mask &= corner_mask;
+      if (corner.w() <= 0) {
+        is_behind_camera = true;
+      } else {
+        min_x = std::min(min_x, corner.x() / corner.w());
+        max_x = std::max(max_x, corner.x() / corner.w());
+        min_y = std::min(min_y, corner.y() / corner.w());
+        max_y = std::max(max_y, corner.y() / corner.w());
+      }
+    }
+
+    if (outside_mask != 0) {
+      continue;
+    }
+
+    size_t level = 0;
+    if (level_of_detail && !is_behind_camera) {
+      const float area =
+          0.25f * width * height *
+          std::max(0.0f, std::min(max_x, 1.0f) - std::max(min_x, -1.0f)) *
+          std::max(0.0f, std::min(max_y, 1.0f) - std::max(min_y, -1.0f));
+      const float num_required_points = num_points_per_pixel * area;
+      while (level + 1 < num_levels &&
+             (chunk.num_visible_points >> (level + 1)) >= num_required_points) {
+        level += 1;
+      }
+    }
+
+    const size_t begin = chunk_idx * kChunkSize;
+    const size_t num_points = std::min(kChunkSize, data_.size() - begin);
+    firsts[level].push_back(static_cast<GLint>(begin >> level));
+    counts[level].push_back(
+        static_cast<GLsizei>((num_points + (size_t(1) << level) - 1) >> level));
+  }
+
   shader_program_.bind();
   vao_.bind();
+  vbo_.bind();
 
   shader_program_.setUniformValue("u_pmv_matrix", pmv_matrix);
   shader_program_.setUniformValue("u_point_size", point_size);
 
-  QOpenGLFunctions* gl_funcs = QOpenGLContext::currentContext()->functions();
-  gl_funcs->glDrawArrays(GL_POINTS, 0, (GLsizei)num_geoms_);
+  QOpenGLFunctions_3_2_Core* gl_funcs =
+      QOpenGLContext::currentContext()
+          ->versionFunctions<QOpenGLFunctions_3_2_Core>();
+  for (size_t level = 0; level < num_levels; ++level) {
+    if (firsts[level].empty()) {
+      continue;
+    }
+    SetAttributeBuffers(size_t(1) << level);
+    gl_funcs->glMultiDrawArrays(GL_POINTS, firsts[level].data(),
+                                counts[level].data(),
+                                static_cast<GLsizei>(firsts[level].size()));
+  }
 
   // Make sure the VAO is not changed from the outside
+  vbo_.release();
   vao_.release();
 
 #if DEBUG
@@ -121,4 +269,45 @@ void PointPainter::Render(const QMatrix4x4& pmv_matrix,
 #endif
 }
 
+void PointPainter::UpdateChunk(const size_t chunk_idx) {
+  Chunk& chunk = chunks_[chunk_idx];
+  chunk = Chunk();
+
+  const size_t begin = chunk_idx * kChunkSize;
+  const size_t end = std::min(begin + kChunkSize, data_.size());
+  for (size_t idx = begin; idx < end; ++idx) {
+    const PointPainter::Data& point = data_[idx];
+    if (point.a == 0) {
+      continue;
+    }
+
+    if (chunk.num_visible_points == 0) {
+      chunk.min_bound = QVector3D(point.x, point.y, point.z);
+      chunk.max_bound = chunk.min_bound;
+    } else {
+      chunk.min_bound.setX(std::min(chunk.min_bound.x(), point.x));
+      chunk.min_bound.setY(std::min(chunk.min_bound.y(), point.y));
+      chunk.min_bound.setZ(std::min(chunk.min_bound.z(), point.z));
+      chunk.max_bound.setX(std::max(chunk.max_bound.x(), point.x));
+      chunk.max_bound.setY(std::max(chunk.max_bound.y(), point.y));
+      chunk.max_bound.setZ(std::max(chunk.max_bound.z(), point.z));
+    }
+
+    chunk.num_visible_points += 1;
+  }
+}
+
+void PointPainter::SetAttributeBuffers(const size_t stride) {
+  const int stride_size = static_cast<int>(stride * sizeof(PointPainter::Data));
+
+  // in_position
+  shader_program_.enableAttributeArray("a_position");
+  shader_program_.setAttributeBuffer("a_position", GL_FLOAT, 0, 3, stride_size);
+
+  // in_color
+  shader_program_.enableAttributeArray("a_color");
+  shader_program_.setAttributeBuffer("a_color", GL_FLOAT, 3 * sizeof(GLfloat),
+                                     4, stride_size);
+}
+
 }  // namespace colmap
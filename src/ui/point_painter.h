@@ -32,6 +32,8 @@
 #ifndef COLMAP_SRC_UI_POINT_PAINTER_H_
 #define COLMAP_SRC_UI_POINT_PAINTER_H_
 
+#include <vector>
+
 #include <QtCore>
 #include <QtOpenGL>
 
@@ -53,15 +55,41 @@ class PointPainter {
   };
 
   void Setup();
-  void Upload(const std::vector<PointPainter::Data>& data);
-  void Render(const QMatrix4x4& pmv_matrix, const float point_size);
+
+  // Upload the points to the GPU. Only the ranges of points that differ from
+  // the previous upload are transferred, so callers should keep the index of
+  // a point stable across uploads. Points with zero alpha are not rendered.
+  void Upload(std::vector<PointPainter::Data> data);
+
+  // Render the points. Chunks of points outside of the view frustum are
+  // culled and, if level of detail is enabled, chunks that cover only few
+  // pixels are rendered with a subset of their points.
+  void Render(const QMatrix4x4& pmv_matrix, const int width, const int height,
+              const float point_size, const bool level_of_detail = true);
 
  private:
+  // Number of consecutive points that are culled and subsampled together. Must
+  // be a power of two, since subsampled chunks are rendered with strides.
+  static const size_t kChunkSize = 1024;
+
+  // Bounding box of the visible points in a chunk.
+  struct Chunk {
+    QVector3D min_bound;
+    QVector3D max_bound;
+    size_t num_visible_points = 0;
+  };
+
+  void UpdateChunk(const size_t chunk_idx);
+  void SetAttributeBuffers(const size_t stride);
+
   QOpenGLShaderProgram shader_program_;
   QOpenGLVertexArrayObject vao_;
   QOpenGLBuffer vbo_;
 
-  size_t num_geoms_;
+  // Copy of the uploaded points to determine the modified ranges.
+  std::vector<PointPainter::Data> data_;
+  std::vector<Chunk> chunks_;
+  size_t capacity_;
 };
 
 }  // namespace colmap
@@ -41,6 +41,7 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionBool(&options->mapper->multiple_models, "multiple_models");
   AddOptionInt(&options->mapper->max_num_models, "max_num_models");
   AddOptionInt(&options->mapper->max_model_overlap, "max_model_overlap");
+  AddOptionInt(&options->mapper->num_parallel_models, "num_parallel_models");
   AddOptionInt(&options->mapper->min_model_size, "min_model_size");
   AddOptionBool(&options->mapper->extract_colors, "extract_colors");
   AddOptionInt(&options->mapper->num_threads, "num_threads", -1);
@@ -49,6 +50,10 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionDirPath(&options->mapper->snapshot_path, "snapshot_path");
   AddOptionInt(&options->mapper->snapshot_images_freq, "snapshot_images_freq",
                0);
+  AddOptionBool(&options->mapper->snapshot_journal, "snapshot_journal");
+  AddOptionDirPath(&options->mapper->checkpoint_path, "checkpoint_path");
+  AddOptionInt(&options->mapper->checkpoint_images_freq,
+               "checkpoint_images_freq");
 }
 
 MapperTriangulationOptionsWidget::MapperTriangulationOptionsWidget(
@@ -85,7 +90,11 @@ MapperRegistrationOptionsWidget::MapperRegistrationOptionsWidget(
                "abs_pose_min_num_inliers");
   AddOptionDouble(&options->mapper->mapper.abs_pose_min_inlier_ratio,
                   "abs_pose_min_inlier_ratio");
+  AddOptionBool(&options->mapper->mapper.abs_pose_progressive_sampling,
+                "abs_pose_progressive_sampling");
   AddOptionInt(&options->mapper->mapper.max_reg_trials, "max_reg_trials", 1);
+  AddOptionInt(&options->mapper->num_speculative_images,
+               "num_speculative_images", 1);
 }
 
 MapperInitializationOptionsWidget::MapperInitializationOptionsWidget(
@@ -103,6 +112,10 @@ MapperInitializationOptionsWidget::MapperInitializationOptionsWidget(
                   "init_min_tri_angle [deg]");
   AddOptionInt(&options->mapper->mapper.init_max_reg_trials,
                   "init_max_reg_trials", 1);
+  AddOptionInt(&options->mapper->mapper.init_num_candidate_pairs,
+               "init_num_candidate_pairs", 1);
+  AddOptionBool(&options->mapper->mapper.init_reuse_two_view_geometry,
+                "init_reuse_two_view_geometry");
 }
 
 MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
@@ -126,12 +139,13 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
                1);
   AddOptionDouble(&options->mapper->ba_local_max_refinement_change,
                   "max_refinement_change", 0, 1, 1e-6, 6);
+  AddOptionBool(&options->mapper->ba_local_reuse_problem, "reuse_problem");
 
   AddSpacer();
 
   AddSection("Global Bundle Adjustment");
   AddOptionBool(&options->mapper->ba_global_use_pba,
-                "use_pba\n(requires SIMPLE_RADIAL)");
+                "use_pba\n(requires SIMPLE_RADIAL\nor SIMPLE_PINHOLE)");
   AddOptionDouble(&options->mapper->ba_global_images_ratio, "images_ratio");
   AddOptionInt(&options->mapper->ba_global_images_freq, "images_freq");
   AddOptionDouble(&options->mapper->ba_global_points_ratio, "points_ratio");
@@ -139,6 +153,15 @@ MapperBundleAdjustmentOptionsWidget::MapperBundleAdjustmentOptionsWidget(
   AddOptionInt(&options->mapper->ba_global_max_num_iterations,
                "max_num_iterations");
   AddOptionInt(&options->mapper->ba_global_pba_gpu_index, "pba_gpu_index", -1);
+  AddOptionInt(&options->mapper->ba_global_pba_min_num_observations,
+               "pba_min_num_observations", -1);
+  AddOptionInt(&options->mapper->ba_global_partition_max_num_images,
+               "partition_max_num_images", -1);
+  AddOptionInt(&options->mapper->ba_global_partition_image_overlap,
+               "partition_image_overlap");
+  AddOptionInt(&options->mapper->ba_global_max_num_points_per_image,
+               "max_num_points_per_image", -1);
+  AddOptionBool(&options->mapper->ba_global_reuse_problem, "reuse_problem");
   AddOptionInt(&options->mapper->ba_global_max_refinements, "max_refinements",
                1);
   AddOptionDouble(&options->mapper->ba_global_max_refinement_change,
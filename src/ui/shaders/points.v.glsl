@@ -8,7 +8,12 @@ in vec4 a_color;
 out vec4 v_color;
 
 void main(void) {
-  gl_Position = u_pmv_matrix * vec4(a_position, 1);
+  if (a_color.a == 0.0) {
+    // Hidden points are moved outside of the clipping volume.
+    gl_Position = vec4(0, 0, 2, 1);
+  } else {
+    gl_Position = u_pmv_matrix * vec4(a_position, 1);
+  }
   gl_PointSize = u_point_size;
   v_color = a_color;
 }
@@ -0,0 +1,282 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "util/benchmark.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/version.h"
+
+namespace colmap {
+namespace {
+
+std::vector<std::pair<std::string, BenchmarkFunc>>& GetRegisteredBenchmarks() {
+  static std::vector<std::pair<std::string, BenchmarkFunc>> benchmarks;
+  return benchmarks;
+}
+
+std::string EscapeJSONString(const std::string& str) {
+  std::string escaped;
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += StringPrintf("\\u%04x", static_cast<int>(c));
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string FormatThroughput(const double value, const std::string& unit) {
+  if (value >= 1e9) {
+    return StringPrintf("%.2fG%s/s", value / 1e9, unit.c_str());
+  } else if (value >= 1e6) {
+    return StringPrintf("%.2fM%s/s", value / 1e6, unit.c_str());
+  } else if (value >= 1e3) {
+    return StringPrintf("%.2fk%s/s", value / 1e3, unit.c_str());
+  } else {
+    return StringPrintf("%.2f%s/s", value, unit.c_str());
+  }
+}
+
+void PrintBenchmarkResult(const BenchmarkResult& result) {
+  std::string throughput;
+  if (result.items_per_second > 0) {
+    throughput += FormatThroughput(result.items_per_second, " items");
+  }
+  if (result.bytes_per_second > 0) {
+    if (!throughput.empty()) {
+      throughput += ", ";
+    }
+    throughput += FormatThroughput(result.bytes_per_second, "B");
+  }
+  std::cout << StringPrintf("%-48s %10d %14.3f %10.1f  %s",
+                            result.name.c_str(),
+                            static_cast<int>(result.num_iterations),
+                            result.seconds_per_iteration * 1e6,
+                            result.peak_memory_bytes / (1024.0 * 1024.0),
+                            throughput.c_str())
+            << std::endl;
+}
+
+}  // namespace
+
+BenchmarkState::BenchmarkState(const size_t num_iterations)
+    : num_iterations_(num_iterations),
+      num_remaining_iterations_(num_iterations),
+      num_items_processed_(0),
+      num_bytes_processed_(0),
+      started_(false) {}
+
+bool BenchmarkState::KeepRunning() {
+  if (!started_) {
+    started_ = true;
+    timer_.Start();
+  }
+  if (num_remaining_iterations_ == 0) {
+    timer_.Pause();
+    return false;
+  }
+  num_remaining_iterations_ -= 1;
+  return true;
+}
+
+void BenchmarkState::PauseTiming() { timer_.Pause(); }
+
+void BenchmarkState::ResumeTiming() { timer_.Resume(); }
+
+void BenchmarkState::SetItemsProcessed(const size_t num_items) {
+  num_items_processed_ = num_items;
+}
+
+void BenchmarkState::SetBytesProcessed(const size_t num_bytes) {
+  num_bytes_processed_ = num_bytes;
+}
+
+size_t BenchmarkState::NumIterations() const { return num_iterations_; }
+
+size_t BenchmarkState::NumItemsProcessed() const {
+  return num_items_processed_;
+}
+
+size_t BenchmarkState::NumBytesProcessed() const {
+  return num_bytes_processed_;
+}
+
+double BenchmarkState::ElapsedSeconds() const {
+  return timer_.ElapsedSeconds();
+}
+
+int RegisterBenchmark(const std::string& name, const BenchmarkFunc& func) {
+  GetRegisteredBenchmarks().emplace_back(name, func);
+  return static_cast<int>(GetRegisteredBenchmarks().size());
+}
+
+BenchmarkResult RunBenchmark(const std::string& name, const BenchmarkFunc& func,
+                             const double min_time) {
+  const size_t kMaxNumIterations = 1000000000;
+
+  size_t num_iterations = 1;
+  while (true) {
+    BenchmarkState state(num_iterations);
+    func(&state);
+    const double elapsed_seconds = state.ElapsedSeconds();
+
+    if (elapsed_seconds >= min_time || num_iterations >= kMaxNumIterations) {
+      BenchmarkResult result;
+      result.name = name;
+      result.num_iterations = num_iterations;
+      result.seconds_per_iteration = elapsed_seconds / num_iterations;
+      if (elapsed_seconds > 0) {
+        result.items_per_second = state.NumItemsProcessed() / elapsed_seconds;
+        result.bytes_per_second = state.NumBytesProcessed() / elapsed_seconds;
+      }
+      result.peak_memory_bytes = GetPeakMemoryUsage();
+      return result;
+    }
+
+    // Overshoot the estimated number of iterations slightly, so that the
+    // next run likely reaches the minimum time, but grow at most by 10x
+    // to limit the impact of noisy measurements of short runs.
+    const double growth =
+        elapsed_seconds > 0 ? 1.4 * min_time / elapsed_seconds : 10;
+    num_iterations = std::min(
+        kMaxNumIterations,
+        std::max(num_iterations + 1,
+                 static_cast<size_t>(num_iterations * std::min(growth, 10.0))));
+  }
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options) {
+  CHECK_GT(options.min_time, 0);
+
+  std::cout << StringPrintf("%-48s %10s %14s %10s  %s", "Benchmark",
+                            "Iterations", "Time [us]", "Peak [MB]",
+                            "Throughput")
+            << std::endl;
+  std::cout << std::string(100, '-') << std::endl;
+
+  std::vector<BenchmarkResult> results;
+  for (const auto& benchmark : GetRegisteredBenchmarks()) {
+    if (benchmark.first.find(options.filter) == std::string::npos) {
+      continue;
+    }
+    results.push_back(
+        RunBenchmark(benchmark.first, benchmark.second, options.min_time));
+    PrintBenchmarkResult(results.back());
+  }
+
+  if (!options.output_path.empty()) {
+    WriteBenchmarkResults(options.output_path, results);
+  }
+
+  return results;
+}
+
+void WriteBenchmarkResults(const std::string& path,
+                           const std::vector<BenchmarkResult>& results) {
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  const std::time_t time = std::time(nullptr);
+  char date[64];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&time));
+
+  file << "{\"context\":{\"date\":\"" << date << "\",\"version\":\""
+       << EscapeJSONString(GetVersionInfo()) << "\",\"build\":\""
+       << EscapeJSONString(GetBuildInfo())
+       << "\",\"num_cpus\":" << std::thread::hardware_concurrency()
+       << "},\"benchmarks\":[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    if (i > 0) {
+      file << ",";
+    }
+    file << "\n{\"name\":\"" << EscapeJSONString(result.name)
+         << "\",\"iterations\":" << result.num_iterations
+         << ",\"seconds_per_iteration\":"
+         << StringPrintf("%.9g", result.seconds_per_iteration)
+         << ",\"items_per_second\":"
+         << StringPrintf("%.9g", result.items_per_second)
+         << ",\"bytes_per_second\":"
+         << StringPrintf("%.9g", result.bytes_per_second)
+         << ",\"peak_memory_bytes\":" << result.peak_memory_bytes << "}";
+  }
+  file << "\n]}" << std::endl;
+}
+
+int RunBenchmarksMain(int argc, char** argv) {
+  InitializeGlog(argv);
+
+  BenchmarkOptions options;
+
+  namespace po = boost::program_options;
+  po::options_description desc("Options");
+  desc.add_options()("help,h", "Print the available options")(
+      "filter", po::value<std::string>(&options.filter),
+      "Only run benchmarks whose name contains this string")(
+      "min_time", po::value<double>(&options.min_time),
+      "Minimum time in seconds of each benchmark")(
+      "output_path", po::value<std::string>(&options.output_path),
+      "Path of the JSON file with the results");
+
+  try {
+    po::variables_map vmap;
+    po::store(po::parse_command_line(argc, argv, desc), vmap);
+    if (vmap.count("help")) {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    po::notify(vmap);
+  } catch (std::exception& exc) {
+    std::cerr << "ERROR: Failed to parse options - " << exc.what() << "."
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  RunBenchmarks(options);
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace colmap
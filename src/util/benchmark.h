@@ -0,0 +1,147 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_UTIL_BENCHMARK_H_
+#define COLMAP_SRC_UTIL_BENCHMARK_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "util/timer.h"
+
+namespace colmap {
+
+// Minimal harness for performance benchmarks, e.g.:
+//
+//    COLMAP_BENCHMARK(BenchmarkSomething) {
+//      const std::vector<double> data = ...;  // Setup is not timed.
+//      while (state->KeepRunning()) {
+//        DoSomething(data);
+//      }
+//      state->SetItemsProcessed(state->NumIterations() * data.size());
+//    }
+//
+//    COLMAP_BENCHMARK_MAIN()
+//
+// The number of iterations of each benchmark is increased until the timed
+// loop takes at least the minimum time. The results can be written as JSON,
+// such that the results of different builds or machines can be compared.
+class BenchmarkState {
+ public:
+  explicit BenchmarkState(const size_t num_iterations);
+
+  // Returns true until the loop ran for the given number of iterations. The
+  // timer starts with the first call and stops when returning false.
+  bool KeepRunning();
+
+  // Exclude a part of an iteration from the timing.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // The number of processed items or bytes over all iterations, from which
+  // the throughput is computed.
+  void SetItemsProcessed(const size_t num_items);
+  void SetBytesProcessed(const size_t num_bytes);
+
+  size_t NumIterations() const;
+  size_t NumItemsProcessed() const;
+  size_t NumBytesProcessed() const;
+  double ElapsedSeconds() const;
+
+ private:
+  const size_t num_iterations_;
+  size_t num_remaining_iterations_;
+  size_t num_items_processed_;
+  size_t num_bytes_processed_;
+  bool started_;
+  Timer timer_;
+};
+
+struct BenchmarkOptions {
+  // Only run the benchmarks whose name contains the filter string.
+  std::string filter = "";
+
+  // The minimum time in seconds of the timed loop of each benchmark.
+  double min_time = 0.5;
+
+  // Optional path of the JSON file with the results.
+  std::string output_path = "";
+};
+
+struct BenchmarkResult {
+  std::string name;
+  size_t num_iterations = 0;
+  double seconds_per_iteration = 0;
+  // Zero, if the benchmark did not report the number of items or bytes.
+  double items_per_second = 0;
+  double bytes_per_second = 0;
+  // Peak resident memory of the process after the benchmark, which includes
+  // all previously run benchmarks.
+  size_t peak_memory_bytes = 0;
+};
+
+typedef std::function<void(BenchmarkState*)> BenchmarkFunc;
+
+// Register a benchmark to be run by RunBenchmarks. Returns a dummy value, so
+// that it can be used to initialize static variables.
+int RegisterBenchmark(const std::string& name, const BenchmarkFunc& func);
+
+// Run a single benchmark function with increasing number of iterations.
+BenchmarkResult RunBenchmark(const std::string& name, const BenchmarkFunc& func,
+                             const double min_time);
+
+// Run all registered benchmarks matching the filter, print the results, and
+// optionally write them to the output path.
+std::vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options);
+
+// Write the results with information about the build and the machine.
+void WriteBenchmarkResults(const std::string& path,
+                           const std::vector<BenchmarkResult>& results);
+
+// Parse the benchmark options from the command-line and run the benchmarks.
+int RunBenchmarksMain(int argc, char** argv);
+
+}  // namespace colmap
+
+#define COLMAP_BENCHMARK(name)                      \
+  static void name(colmap::BenchmarkState* state); \
+  static const int name##_registered =             \
+      colmap::RegisterBenchmark(#name, name);      \
+  static void name(colmap::BenchmarkState* state)
+
+#define COLMAP_BENCHMARK_MAIN()                    \
+  int main(int argc, char** argv) {                \
+    return colmap::RunBenchmarksMain(argc, argv); \
+  }
+
+#endif  // COLMAP_SRC_UTIL_BENCHMARK_H_
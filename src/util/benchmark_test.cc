@@ -0,0 +1,112 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "util/benchmark"
+#include "util/testing.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+
+#include "util/benchmark.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestBenchmarkState) {
+  BenchmarkState state(3);
+  BOOST_CHECK_EQUAL(state.NumIterations(), 3);
+  size_t num_iterations = 0;
+  while (state.KeepRunning()) {
+    num_iterations += 1;
+  }
+  BOOST_CHECK_EQUAL(num_iterations, 3);
+  BOOST_CHECK(!state.KeepRunning());
+  state.SetItemsProcessed(30);
+  state.SetBytesProcessed(60);
+  BOOST_CHECK_EQUAL(state.NumItemsProcessed(), 30);
+  BOOST_CHECK_EQUAL(state.NumBytesProcessed(), 60);
+  BOOST_CHECK_GE(state.ElapsedSeconds(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRunBenchmark) {
+  size_t num_calls = 0;
+  const BenchmarkResult result = RunBenchmark(
+      "test",
+      [&num_calls](BenchmarkState* state) {
+        num_calls += 1;
+        volatile double sum = 0;
+        while (state->KeepRunning()) {
+          for (int i = 0; i < 1000; ++i) {
+            sum = sum + i;
+          }
+        }
+        state->SetItemsProcessed(state->NumIterations() * 1000);
+      },
+      0.01);
+  BOOST_CHECK_EQUAL(result.name, "test");
+  BOOST_CHECK_GT(num_calls, 1);
+  BOOST_CHECK_GT(result.num_iterations, 1);
+  BOOST_CHECK_GT(result.seconds_per_iteration, 0);
+  BOOST_CHECK_GT(result.items_per_second, 0);
+  BOOST_CHECK_EQUAL(result.bytes_per_second, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteBenchmarkResults) {
+  BenchmarkResult result;
+  result.name = "test\"quoted\"";
+  result.num_iterations = 10;
+  result.seconds_per_iteration = 0.5;
+  result.items_per_second = 2;
+  result.peak_memory_bytes = 1024;
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_benchmark_%%%%-%%%%.json"))
+          .string();
+  WriteBenchmarkResults(path, {result});
+
+  std::ifstream file(path);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string content = buffer.str();
+  boost::filesystem::remove(path);
+
+  BOOST_CHECK_EQUAL(content.find("{\"context\":{\"date\":"), 0);
+  BOOST_CHECK_NE(content.find("{\"name\":\"test\\\"quoted\\\"\","
+                              "\"iterations\":10,"
+                              "\"seconds_per_iteration\":0.5,"
+                              "\"items_per_second\":2,"
+                              "\"bytes_per_second\":0,"
+                              "\"peak_memory_bytes\":1024}"),
+                 std::string::npos);
+}
@@ -31,6 +31,7 @@
 
 #include "util/bitmap.h"
 
+#include <cstring>
 #include <regex>
 #include <unordered_map>
 
@@ -41,6 +42,150 @@
 #include "util/misc.h"
 
 namespace colmap {
+namespace {
+
+// Convert a 24-bit RGB to an 8-bit grey bitmap directly on the scanlines,
+// using the same Rec. 709 luma weights as FreeImage_ConvertToGreyscale.
+FIBITMAP* ConvertRGBToGrey(FIBITMAP* rgb_data) {
+  const int width = FreeImage_GetWidth(rgb_data);
+  const int height = FreeImage_GetHeight(rgb_data);
+  FIBITMAP* grey_data = FreeImage_Allocate(width, height, 8);
+  if (grey_data == nullptr) {
+    return nullptr;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* rgb_line = FreeImage_GetScanLine(rgb_data, y);
+    uint8_t* grey_line = FreeImage_GetScanLine(grey_data, y);
+    for (int x = 0; x < width; ++x) {
+      const uint8_t* rgb = rgb_line + 3 * x;
+      grey_line[x] = static_cast<uint8_t>(
+          0.2126f * rgb[FI_RGBA_RED] + 0.7152f * rgb[FI_RGBA_GREEN] +
+          0.0722f * rgb[FI_RGBA_BLUE] + 0.5f);
+    }
+  }
+
+  FreeImage_CloneMetadata(grey_data, rgb_data);
+
+  return grey_data;
+}
+
+// Convert an 8-bit grey to a 24-bit RGB bitmap directly on the scanlines.
+FIBITMAP* ConvertGreyToRGB(FIBITMAP* grey_data) {
+  const int width = FreeImage_GetWidth(grey_data);
+  const int height = FreeImage_GetHeight(grey_data);
+  FIBITMAP* rgb_data = FreeImage_Allocate(width, height, 24);
+  if (rgb_data == nullptr) {
+    return nullptr;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* grey_line = FreeImage_GetScanLine(grey_data, y);
+    uint8_t* rgb_line = FreeImage_GetScanLine(rgb_data, y);
+    for (int x = 0; x < width; ++x) {
+      rgb_line[3 * x] = grey_line[x];
+      rgb_line[3 * x + 1] = grey_line[x];
+      rgb_line[3 * x + 2] = grey_line[x];
+    }
+  }
+
+  FreeImage_CloneMetadata(rgb_data, grey_data);
+
+  return rgb_data;
+}
+
+// Weights of the source pixels covered by each pixel of the downsized image,
+// where the source pixels of the i-th pixel start at offsets[i] and their
+// weights are stored in weights[i * num_taps, (i + 1) * num_taps).
+struct AreaFilter {
+  int num_taps = 0;
+  std::vector<int> offsets;
+  std::vector<float> weights;
+};
+
+AreaFilter ComputeAreaFilter(const int size, const int new_size) {
+  const double scale = static_cast<double>(size) / new_size;
+
+  AreaFilter filter;
+  for (int i = 0; i < new_size; ++i) {
+    filter.num_taps =
+        std::max(filter.num_taps,
+                 static_cast<int>(std::ceil((i + 1) * scale) -
+                                  std::floor(i * scale)));
+  }
+  filter.num_taps = std::min(size, filter.num_taps);
+  filter.offsets.resize(new_size);
+  filter.weights.resize(new_size * filter.num_taps);
+
+  for (int i = 0; i < new_size; ++i) {
+    const double begin = i * scale;
+    const double end = (i + 1) * scale;
+    const int offset = std::min(static_cast<int>(std::floor(begin)),
+                                size - filter.num_taps);
+    filter.offsets[i] = offset;
+    for (int t = 0; t < filter.num_taps; ++t) {
+      const double overlap = std::min(end, offset + t + 1.0) -
+                             std::max(begin, static_cast<double>(offset + t));
+      filter.weights[i * filter.num_taps + t] =
+          static_cast<float>(std::max(0.0, overlap) / scale);
+    }
+  }
+
+  return filter;
+}
+
+// Downsize the image with separable area filters, where each source line is
+// filtered horizontally and then accumulated vertically into the new line.
+template <int kChannels>
+void DownsizeArea(const Bitmap& bitmap, Bitmap* downsized) {
+  const int new_width = downsized->Width();
+  const int new_height = downsized->Height();
+  const AreaFilter filter_x = ComputeAreaFilter(bitmap.Width(), new_width);
+  const AreaFilter filter_y = ComputeAreaFilter(bitmap.Height(), new_height);
+
+  std::vector<float> new_line_sum(kChannels * new_width);
+  for (int y = 0; y < new_height; ++y) {
+    std::fill(new_line_sum.begin(), new_line_sum.end(), 0.0f);
+
+    for (int ty = 0; ty < filter_y.num_taps; ++ty) {
+      const float weight_y = filter_y.weights[y * filter_y.num_taps + ty];
+      if (weight_y == 0.0f) {
+        continue;
+      }
+
+      const uint8_t* line = bitmap.GetScanline(filter_y.offsets[y] + ty);
+      for (int x = 0; x < new_width; ++x) {
+        const uint8_t* pixels = line + kChannels * filter_x.offsets[x];
+        const float* weights_x = &filter_x.weights[x * filter_x.num_taps];
+        float sum[kChannels] = {0};
+        for (int tx = 0; tx < filter_x.num_taps; ++tx) {
+          for (int c = 0; c < kChannels; ++c) {
+            sum[c] += weights_x[tx] * pixels[kChannels * tx + c];
+          }
+        }
+        for (int c = 0; c < kChannels; ++c) {
+          new_line_sum[kChannels * x + c] += weight_y * sum[c];
+        }
+      }
+    }
+
+    uint8_t* new_line = downsized->GetScanline(y);
+    for (int i = 0; i < kChannels * new_width; ++i) {
+      new_line[i] =
+          static_cast<uint8_t>(std::min(255.0f, new_line_sum[i] + 0.5f));
+    }
+  }
+}
+
+// Wrap the encoded contents of an image file for reading by FreeImage, which
+// does not modify the data of a read-only memory stream.
+FIMEMORY* OpenMemory(const std::string& data) {
+  return FreeImage_OpenMemory(
+      reinterpret_cast<BYTE*>(const_cast<char*>(data.data())),
+      static_cast<DWORD>(data.size()));
+}
+
+}  // namespace
 
 Bitmap::Bitmap()
     : data_(nullptr, &FreeImage_Unload), width_(0), height_(0), channels_(0) {}
@@ -122,16 +267,7 @@ std::vector<uint8_t> Bitmap::ConvertToRawBits() const {
 
 std::vector<uint8_t> Bitmap::ConvertToRowMajorArray() const {
   std::vector<uint8_t> array(width_ * height_ * channels_);
-  size_t i = 0;
-  for (int y = 0; y < height_; ++y) {
-    const uint8_t* line = FreeImage_GetScanLine(data_.get(), height_ - 1 - y);
-    for (int x = 0; x < width_; ++x) {
-      for (int d = 0; d < channels_; ++d) {
-        array[i] = line[x * channels_ + d];
-        i += 1;
-      }
-    }
-  }
+  CopyToRowMajorArray(array.data(), width_ * channels_);
   return array;
 }
 
@@ -151,6 +287,16 @@ std::vector<uint8_t> Bitmap::ConvertToColMajorArray() const {
   return array;
 }
 
+void Bitmap::CopyToRowMajorArray(uint8_t* data, const size_t pitch) const {
+  CHECK_NOTNULL(data);
+  const size_t line_size = static_cast<size_t>(width_) * channels_;
+  CHECK_GE(pitch, line_size);
+  for (int y = 0; y < height_; ++y) {
+    const uint8_t* line = FreeImage_GetScanLine(data_.get(), height_ - 1 - y);
+    memcpy(data + y * pitch, line, line_size);
+  }
+}
+
 bool Bitmap::GetPixel(const int x, const int y,
                       BitmapColor<uint8_t>* color) const {
   if (x < 0 || x >= width_ || y < 0 || y >= height_) {
@@ -199,6 +345,12 @@ const uint8_t* Bitmap::GetScanline(const int y) const {
   return FreeImage_GetScanLine(data_.get(), height_ - 1 - y);
 }
 
+uint8_t* Bitmap::GetScanline(const int y) {
+  CHECK_GE(y, 0);
+  CHECK_LT(y, height_);
+  return FreeImage_GetScanLine(data_.get(), height_ - 1 - y);
+}
+
 void Bitmap::Fill(const BitmapColor<uint8_t>& color) {
   for (int y = 0; y < height_; ++y) {
     uint8_t* line = FreeImage_GetScanLine(data_.get(), height_ - 1 - y);
@@ -404,7 +556,8 @@ bool Bitmap::ExifAltitude(double* altitude) const {
   return false;
 }
 
-bool Bitmap::Read(const std::string& path, const bool as_rgb) {
+bool Bitmap::Read(const std::string& path, const bool as_rgb,
+                  const int max_size) {
   if (!ExistsFile(path)) {
     return false;
   }
@@ -415,7 +568,39 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
     return false;
   }
 
-  FIBITMAP* fi_bitmap = FreeImage_Load(format, path.c_str());
+  // The JPEG plugin of FreeImage interprets the upper 16 bits of the flags as
+  // the requested size of the image and chooses the DCT scaling accordingly.
+  int flags = 0;
+  if (format == FIF_JPEG && max_size > 0 && max_size <= 0xFFFF) {
+    flags = max_size << 16;
+  }
+
+  return SetLoadedPtr(FreeImage_Load(format, path.c_str(), flags), as_rgb);
+}
+
+bool Bitmap::ReadFromMemory(const std::string& data, const bool as_rgb,
+                            const int max_size) {
+  FIMEMORY* memory = OpenMemory(data);
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileTypeFromMemory(memory, 0);
+
+  if (format == FIF_UNKNOWN) {
+    FreeImage_CloseMemory(memory);
+    return false;
+  }
+
+  int flags = 0;
+  if (format == FIF_JPEG && max_size > 0 && max_size <= 0xFFFF) {
+    flags = max_size << 16;
+  }
+
+  FIBITMAP* fi_bitmap = FreeImage_LoadFromMemory(format, memory, flags);
+  FreeImage_CloseMemory(memory);
+
+  return SetLoadedPtr(fi_bitmap, as_rgb);
+}
+
+bool Bitmap::SetLoadedPtr(FIBITMAP* fi_bitmap, const bool as_rgb) {
   if (fi_bitmap == nullptr) {
     return false;
   }
@@ -426,7 +611,9 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
     FIBITMAP* converted_bitmap = FreeImage_ConvertTo24Bits(fi_bitmap);
     data_ = FIBitmapPtr(converted_bitmap, &FreeImage_Unload);
   } else if (!IsPtrGrey(data_.get()) && !as_rgb) {
-    FIBITMAP* converted_bitmap = FreeImage_ConvertToGreyscale(fi_bitmap);
+    FIBITMAP* converted_bitmap = IsPtrRGB(fi_bitmap)
+                                     ? ConvertRGBToGrey(fi_bitmap)
+                                     : FreeImage_ConvertToGreyscale(fi_bitmap);
     data_ = FIBitmapPtr(converted_bitmap, &FreeImage_Unload);
   }
 
@@ -442,6 +629,66 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
   return true;
 }
 
+bool Bitmap::ReadHeader(const std::string& path) {
+#ifdef FIF_LOAD_NOPIXELS
+  if (!ExistsFile(path)) {
+    return false;
+  }
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path.c_str(), 0);
+
+  if (format == FIF_UNKNOWN) {
+    return false;
+  }
+
+  FIBITMAP* fi_bitmap =
+      FreeImage_Load(format, path.c_str(), FIF_LOAD_NOPIXELS);
+  if (fi_bitmap == nullptr) {
+    return false;
+  }
+
+  data_ = FIBitmapPtr(fi_bitmap, &FreeImage_Unload);
+  width_ = FreeImage_GetWidth(fi_bitmap);
+  height_ = FreeImage_GetHeight(fi_bitmap);
+  channels_ = IsPtrRGB(fi_bitmap) ? 3 : 1;
+
+  return true;
+#else
+  // Older versions of FreeImage cannot skip decoding the pixels.
+  return Read(path, /*as_rgb*/ false);
+#endif
+}
+
+bool Bitmap::ReadHeaderFromMemory(const std::string& data) {
+#ifdef FIF_LOAD_NOPIXELS
+  FIMEMORY* memory = OpenMemory(data);
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileTypeFromMemory(memory, 0);
+
+  if (format == FIF_UNKNOWN) {
+    FreeImage_CloseMemory(memory);
+    return false;
+  }
+
+  FIBITMAP* fi_bitmap =
+      FreeImage_LoadFromMemory(format, memory, FIF_LOAD_NOPIXELS);
+  FreeImage_CloseMemory(memory);
+  if (fi_bitmap == nullptr) {
+    return false;
+  }
+
+  data_ = FIBitmapPtr(fi_bitmap, &FreeImage_Unload);
+  width_ = FreeImage_GetWidth(fi_bitmap);
+  height_ = FreeImage_GetHeight(fi_bitmap);
+  channels_ = IsPtrRGB(fi_bitmap) ? 3 : 1;
+
+  return true;
+#else
+  // Older versions of FreeImage cannot skip decoding the pixels.
+  return ReadFromMemory(data, /*as_rgb*/ false);
+#endif
+}
+
 bool Bitmap::Write(const std::string& path, const FREE_IMAGE_FORMAT format,
                    const int flags) const {
   FREE_IMAGE_FORMAT save_format;
@@ -505,11 +752,35 @@ void Bitmap::Rescale(const int new_width, const int new_height,
   SetPtr(FreeImage_Rescale(data_.get(), new_width, new_height, filter));
 }
 
+void Bitmap::Downsize(const int new_width, const int new_height) {
+  CHECK_GT(new_width, 0);
+  CHECK_GT(new_height, 0);
+  CHECK_LE(new_width, width_);
+  CHECK_LE(new_height, height_);
+
+  if (new_width == width_ && new_height == height_) {
+    return;
+  }
+
+  Bitmap downsized;
+  CHECK(downsized.Allocate(new_width, new_height, IsRGB()));
+  if (IsRGB()) {
+    DownsizeArea<3>(*this, &downsized);
+  } else {
+    DownsizeArea<1>(*this, &downsized);
+  }
+
+  CloneMetadata(&downsized);
+  *this = std::move(downsized);
+}
+
 Bitmap Bitmap::Clone() const { return Bitmap(FreeImage_Clone(data_.get())); }
 
 Bitmap Bitmap::CloneAsGrey() const {
   if (IsGrey()) {
     return Clone();
+  } else if (IsRGB()) {
+    return Bitmap(ConvertRGBToGrey(data_.get()));
   } else {
     return Bitmap(FreeImage_ConvertToGreyscale(data_.get()));
   }
@@ -518,6 +789,8 @@ Bitmap Bitmap::CloneAsGrey() const {
 Bitmap Bitmap::CloneAsRGB() const {
   if (IsRGB()) {
     return Clone();
+  } else if (IsGrey()) {
+    return Bitmap(ConvertGreyToRGB(data_.get()));
   } else {
     return Bitmap(FreeImage_ConvertTo24Bits(data_.get()));
   }
@@ -125,13 +125,25 @@ class Bitmap {
   std::vector<uint8_t> ConvertToRowMajorArray() const;
   std::vector<uint8_t> ConvertToColMajorArray() const;
 
+  // Copy the pixel data as a row-major array to the given memory, in which
+  // consecutive rows start `pitch` bytes apart. In contrast to the conversion
+  // functions above, this writes directly into the final destination, e.g. a
+  // padded or pinned buffer shared by multiple images, without allocating an
+  // intermediate array.
+  void CopyToRowMajorArray(uint8_t* data, const size_t pitch) const;
+
   // Manipulate individual pixels. For grayscale images, only the red element
   // of the RGB color is used.
   bool GetPixel(const int x, const int y, BitmapColor<uint8_t>* color) const;
   bool SetPixel(const int x, const int y, const BitmapColor<uint8_t>& color);
 
-  // Get pointer to y-th scanline, where the 0-th scanline is at the top.
+  // Get pointer to y-th scanline, where the 0-th scanline is at the top. The
+  // scanlines provide a strided view of the pixel data without copying, where
+  // each scanline holds `Width() * Channels()` values. Note that FreeImage
+  // stores the scanlines bottom-up, so that successive scanlines are not
+  // necessarily contiguous in memory.
   const uint8_t* GetScanline(const int y) const;
+  uint8_t* GetScanline(const int y);
 
   // Fill entire bitmap with uniform color. For grayscale images, the first
   // element of the vector is used.
@@ -150,8 +162,26 @@ class Bitmap {
   bool ExifLongitude(double* longitude) const;
   bool ExifAltitude(double* altitude) const;
 
-  // Read bitmap at given path and convert to grey- or colorscale.
-  bool Read(const std::string& path, const bool as_rgb = true);
+  // Read bitmap at given path and convert to grey- or colorscale. If a
+  // positive maximum size is given, JPEG images are decoded directly at the
+  // smallest DCT scale (1/2, 1/4, or 1/8), for which the larger image
+  // dimension is not smaller than the maximum size. This avoids decoding the
+  // full resolution of large images that are down-sampled afterwards anyway.
+  // Other image formats are always decoded at their full resolution.
+  bool Read(const std::string& path, const bool as_rgb = true,
+            const int max_size = -1);
+
+  // Read only the dimensions and the metadata (e.g., EXIF) of the bitmap at
+  // the given path without decoding the pixel data, if supported by the
+  // installed FreeImage version. The pixels of the bitmap must not be
+  // accessed after this call, only its dimensions and Exif* methods.
+  bool ReadHeader(const std::string& path);
+
+  // Equivalent to `Read` and `ReadHeader` for the encoded contents of an image
+  // file in memory, e.g., if the file was read ahead from remote storage.
+  bool ReadFromMemory(const std::string& data, const bool as_rgb = true,
+                      const int max_size = -1);
+  bool ReadHeaderFromMemory(const std::string& data);
 
   // Write image to file. Flags can be used to set e.g. the JPEG quality.
   // Consult the FreeImage documentation for all available flags.
@@ -166,7 +196,13 @@ class Bitmap {
   void Rescale(const int new_width, const int new_height,
                const FREE_IMAGE_FILTER filter = FILTER_BILINEAR);
 
-  // Clone the image to a new bitmap object.
+  // Downsize image to the new dimensions, which must not be larger than the
+  // current dimensions. Each new pixel is the average of the source pixels in
+  // the area it covers, which avoids aliasing and is faster than `Rescale`.
+  void Downsize(const int new_width, const int new_height);
+
+  // Clone the image to a new bitmap object. The conversions between grey and
+  // RGB operate directly on the scanlines for 8-bit grey and 24-bit RGB images.
   Bitmap Clone() const;
   Bitmap CloneAsGrey() const;
   Bitmap CloneAsRGB() const;
@@ -183,6 +219,9 @@ class Bitmap {
 
   void SetPtr(FIBITMAP* data);
 
+  // Take ownership of a loaded bitmap and convert it to grey- or colorscale.
+  bool SetLoadedPtr(FIBITMAP* fi_bitmap, const bool as_rgb);
+
   static bool IsPtrGrey(FIBITMAP* data);
   static bool IsPtrRGB(FIBITMAP* data);
   static bool IsPtrSupported(FIBITMAP* data);
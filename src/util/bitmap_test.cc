@@ -156,6 +156,23 @@ BOOST_AUTO_TEST_CASE(TestConvertToRowMajorArrayGrey) {
   BOOST_CHECK_EQUAL(array[3], 3);
 }
 
+BOOST_AUTO_TEST_CASE(TestCopyToRowMajorArray) {
+  Bitmap bitmap;
+  bitmap.Allocate(2, 2, false);
+  bitmap.SetPixel(0, 0, BitmapColor<uint8_t>(0, 0, 0));
+  bitmap.SetPixel(0, 1, BitmapColor<uint8_t>(1, 0, 0));
+  bitmap.SetPixel(1, 0, BitmapColor<uint8_t>(2, 0, 0));
+  bitmap.SetPixel(1, 1, BitmapColor<uint8_t>(3, 0, 0));
+  std::vector<uint8_t> array(6, 255);
+  bitmap.CopyToRowMajorArray(array.data(), 3);
+  BOOST_CHECK_EQUAL(array[0], 0);
+  BOOST_CHECK_EQUAL(array[1], 2);
+  BOOST_CHECK_EQUAL(array[2], 255);
+  BOOST_CHECK_EQUAL(array[3], 1);
+  BOOST_CHECK_EQUAL(array[4], 3);
+  BOOST_CHECK_EQUAL(array[5], 255);
+}
+
 BOOST_AUTO_TEST_CASE(TestConvertToColMajorArrayRGB) {
   Bitmap bitmap;
   bitmap.Allocate(2, 2, true);
@@ -356,6 +373,46 @@ BOOST_AUTO_TEST_CASE(TestRescaleGrey) {
   BOOST_CHECK_EQUAL(bitmap2.Channels(), 1);
 }
 
+BOOST_AUTO_TEST_CASE(TestDownsizeGrey) {
+  Bitmap bitmap;
+  bitmap.Allocate(4, 3, false);
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(10 * x + 60 * y));
+    }
+  }
+  bitmap.Downsize(2, 2);
+  BOOST_CHECK_EQUAL(bitmap.Width(), 2);
+  BOOST_CHECK_EQUAL(bitmap.Height(), 2);
+  BOOST_CHECK_EQUAL(bitmap.Channels(), 1);
+  BitmapColor<uint8_t> color;
+  BOOST_CHECK(bitmap.GetPixel(0, 0, &color));
+  BOOST_CHECK_EQUAL(color.r, 25);
+  BOOST_CHECK(bitmap.GetPixel(1, 0, &color));
+  BOOST_CHECK_EQUAL(color.r, 45);
+  BOOST_CHECK(bitmap.GetPixel(0, 1, &color));
+  BOOST_CHECK_EQUAL(color.r, 105);
+  BOOST_CHECK(bitmap.GetPixel(1, 1, &color));
+  BOOST_CHECK_EQUAL(color.r, 125);
+}
+
+BOOST_AUTO_TEST_CASE(TestDownsizeRGB) {
+  Bitmap bitmap;
+  bitmap.Allocate(100, 100, true);
+  bitmap.Fill(BitmapColor<uint8_t>(10, 20, 30));
+  bitmap.Downsize(33, 50);
+  BOOST_CHECK_EQUAL(bitmap.Width(), 33);
+  BOOST_CHECK_EQUAL(bitmap.Height(), 50);
+  BOOST_CHECK_EQUAL(bitmap.Channels(), 3);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      BitmapColor<uint8_t> color;
+      BOOST_CHECK(bitmap.GetPixel(x, y, &color));
+      BOOST_CHECK_EQUAL(color, BitmapColor<uint8_t>(10, 20, 30));
+    }
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestClone) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, true);
@@ -369,19 +426,27 @@ BOOST_AUTO_TEST_CASE(TestClone) {
 BOOST_AUTO_TEST_CASE(TestCloneAsRGB) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, false);
+  bitmap.SetPixel(0, 0, BitmapColor<uint8_t>(100));
   const Bitmap cloned_bitmap = bitmap.CloneAsRGB();
   BOOST_CHECK_EQUAL(cloned_bitmap.Width(), 100);
   BOOST_CHECK_EQUAL(cloned_bitmap.Height(), 100);
   BOOST_CHECK_EQUAL(cloned_bitmap.Channels(), 3);
   BOOST_CHECK_NE(bitmap.Data(), cloned_bitmap.Data());
+  BitmapColor<uint8_t> color;
+  BOOST_CHECK(cloned_bitmap.GetPixel(0, 0, &color));
+  BOOST_CHECK_EQUAL(color, BitmapColor<uint8_t>(100, 100, 100));
 }
 
 BOOST_AUTO_TEST_CASE(TestCloneAsGrey) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, true);
+  bitmap.SetPixel(0, 0, BitmapColor<uint8_t>(100, 50, 200));
   const Bitmap cloned_bitmap = bitmap.CloneAsGrey();
   BOOST_CHECK_EQUAL(cloned_bitmap.Width(), 100);
   BOOST_CHECK_EQUAL(cloned_bitmap.Height(), 100);
   BOOST_CHECK_EQUAL(cloned_bitmap.Channels(), 1);
   BOOST_CHECK_NE(bitmap.Data(), cloned_bitmap.Data());
+  BitmapColor<uint8_t> color;
+  BOOST_CHECK(cloned_bitmap.GetPixel(0, 0, &color));
+  BOOST_CHECK_EQUAL(color.r, 71);
 }
@@ -32,11 +32,20 @@
 #ifndef COLMAP_SRC_UTIL_CACHE_H_
 #define COLMAP_SRC_UTIL_CACHE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include "util/logging.h"
+#include "util/threading.h"
 
 namespace colmap {
 
@@ -67,6 +76,9 @@ class LRUCache {
   // Pop least recently used element from cache.
   virtual void Pop();
 
+  // Remove the element with the given key from the cache, if it exists.
+  virtual void Erase(const key_t& key);
+
   // Clear all elements from cache.
   virtual void Clear();
 
@@ -104,6 +116,7 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
 
   void Set(const key_t& key, value_t&& value) override;
   void Pop() override;
+  void Erase(const key_t& key) override;
   void Clear() override;
 
  private:
@@ -119,6 +132,108 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
   std::unordered_map<key_t, size_t> elems_num_bytes_;
 };
 
+// Thread-safe Least Recently Used cache implementation, which partitions the
+// keys into independently locked shards, so that threads accessing different
+// shards do not contend. The values are shared with the callers, and elements
+// whose value is still in use by a caller are pinned, i.e. they are not
+// evicted until the caller releases the value. The cache can therefore exceed
+// its limits while all of its elements are pinned. Concurrent requests for the
+// same missing key compute the value only once, while the other requests wait
+// for the result. The getter function is called without holding any lock of
+// the cache and must be thread-safe.
+template <typename key_t, typename value_t>
+class ShardedLRUCache {
+ public:
+  typedef std::shared_ptr<const value_t> value_ptr_t;
+
+  // Cache that is constrained by the number of its elements.
+  ShardedLRUCache(const size_t max_num_elems, const size_t num_shards,
+                  const std::function<value_t(const key_t&)>& getter_func);
+
+  // Cache that is additionally constrained by the memory of its elements, as
+  // computed by the given function when a value is inserted.
+  ShardedLRUCache(const size_t max_num_elems, const size_t max_num_bytes,
+                  const size_t num_shards,
+                  const std::function<value_t(const key_t&)>& getter_func,
+                  const std::function<size_t(const value_t&)>& num_bytes_func);
+
+  // The number of elements in the cache.
+  size_t NumElems() const;
+  size_t MaxNumElems() const;
+  size_t NumShards() const;
+
+  // The memory of the elements in the cache, which is zero if the cache is
+  // only constrained by the number of its elements.
+  size_t NumBytes() const;
+  size_t MaxNumBytes() const;
+
+  // Check whether the element with the given key exists.
+  bool Exists(const key_t& key) const;
+
+  // Get the value of an element either from the cache or compute the new value.
+  value_ptr_t Get(const key_t& key);
+
+  // Get the value of an element asynchronously. A missing value is computed as
+  // a task of the given thread pool, or in the calling thread if no thread
+  // pool is given. The cache must outlive all tasks it added to the pool.
+  std::shared_future<value_ptr_t> GetAsync(const key_t& key,
+                                           ThreadPool* thread_pool = nullptr);
+
+  // Clear all elements from cache, including pinned elements.
+  void Clear();
+
+  // The number of requests served from the cache, the number of requests that
+  // computed a new value, and the number of requests that waited for another
+  // request to compute the same value.
+  size_t NumHits() const;
+  size_t NumMisses() const;
+  size_t NumWaits() const;
+
+  // The fraction of all requests that were served from the cache.
+  double HitRatio() const;
+
+ private:
+  struct Elem {
+    key_t key;
+    value_ptr_t value;
+    size_t num_bytes;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    // The elements ordered from the most to the least recently used.
+    std::list<Elem> elems;
+    std::unordered_map<key_t, typename std::list<Elem>::iterator> elems_map;
+    size_t num_bytes = 0;
+    std::unordered_map<key_t, std::shared_future<value_ptr_t>> pending;
+  };
+
+  Shard& GetShard(const key_t& key);
+  const Shard& GetShard(const key_t& key) const;
+
+  // Return the cached value and mark it as most recently used, or null.
+  value_ptr_t Find(Shard* shard, const key_t& key);
+
+  // Compute a missing value, fulfill its pending promise, and insert it.
+  value_ptr_t Load(const key_t& key, std::promise<value_ptr_t>* promise);
+
+  // Insert a new value and evict the least recently used unpinned elements
+  // while the shard exceeds its limits.
+  void Insert(Shard* shard, const key_t& key, const value_ptr_t& value);
+
+  const size_t max_num_elems_;
+  const size_t max_num_bytes_;
+  size_t max_num_shard_elems_;
+  size_t max_num_shard_bytes_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  const std::function<value_t(const key_t&)> getter_func_;
+  const std::function<size_t(const value_t&)> num_bytes_func_;
+
+  std::atomic<size_t> num_hits_;
+  std::atomic<size_t> num_misses_;
+  std::atomic<size_t> num_waits_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -188,6 +303,15 @@ void LRUCache<key_t, value_t>::Pop() {
   }
 }
 
+template <typename key_t, typename value_t>
+void LRUCache<key_t, value_t>::Erase(const key_t& key) {
+  const auto it = elems_map_.find(key);
+  if (it != elems_map_.end()) {
+    elems_list_.erase(it->second);
+    elems_map_.erase(it);
+  }
+}
+
 template <typename key_t, typename value_t>
 void LRUCache<key_t, value_t>::Clear() {
   elems_list_.clear();
@@ -247,6 +371,17 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Pop() {
   }
 }
 
+template <typename key_t, typename value_t>
+void MemoryConstrainedLRUCache<key_t, value_t>::Erase(const key_t& key) {
+  const auto it = elems_num_bytes_.find(key);
+  if (it != elems_num_bytes_.end()) {
+    num_bytes_ -= it->second;
+    CHECK_GE(num_bytes_, 0);
+    elems_num_bytes_.erase(it);
+    LRUCache<key_t, value_t>::Erase(key);
+  }
+}
+
 template <typename key_t, typename value_t>
 void MemoryConstrainedLRUCache<key_t, value_t>::UpdateNumBytes(
     const key_t& key) {
@@ -268,6 +403,273 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Clear() {
   elems_num_bytes_.clear();
 }
 
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::ShardedLRUCache(
+    const size_t max_num_elems, const size_t num_shards,
+    const std::function<value_t(const key_t&)>& getter_func)
+    : ShardedLRUCache(max_num_elems, std::numeric_limits<size_t>::max(),
+                      num_shards, getter_func, nullptr) {}
+
+template <typename key_t, typename value_t>
+ShardedLRUCache<key_t, value_t>::ShardedLRUCache(
+    const size_t max_num_elems, const size_t max_num_bytes,
+    const size_t num_shards,
+    const std::function<value_t(const key_t&)>& getter_func,
+    const std::function<size_t(const value_t&)>& num_bytes_func)
+    : max_num_elems_(max_num_elems),
+      max_num_bytes_(max_num_bytes),
+      getter_func_(getter_func),
+      num_bytes_func_(num_bytes_func),
+      num_hits_(0),
+      num_misses_(0),
+      num_waits_(0) {
+  CHECK(getter_func);
+  CHECK_GT(max_num_elems, 0);
+  CHECK_GT(max_num_bytes, 0);
+  CHECK_GT(num_shards, 0);
+  // Never use more shards than elements, since every shard holds at least one.
+  const size_t effective_num_shards = std::min(num_shards, max_num_elems);
+  max_num_shard_elems_ =
+      (max_num_elems + effective_num_shards - 1) / effective_num_shards;
+  max_num_shard_bytes_ =
+      num_bytes_func ? (max_num_bytes + effective_num_shards - 1) /
+                           effective_num_shards
+                     : max_num_bytes;
+  shards_.reserve(effective_num_shards);
+  for (size_t i = 0; i < effective_num_shards; ++i) {
+    shards_.emplace_back(new Shard());
+  }
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumElems() const {
+  size_t num_elems = 0;
+  for (const auto& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    num_elems += shard->elems.size();
+  }
+  return num_elems;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::MaxNumElems() const {
+  return max_num_elems_;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumShards() const {
+  return shards_.size();
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumBytes() const {
+  size_t num_bytes = 0;
+  for (const auto& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    num_bytes += shard->num_bytes;
+  }
+  return num_bytes;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::MaxNumBytes() const {
+  return max_num_bytes_;
+}
+
+template <typename key_t, typename value_t>
+bool ShardedLRUCache<key_t, value_t>::Exists(const key_t& key) const {
+  const Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  return shard.elems_map.count(key) > 0;
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::value_ptr_t
+ShardedLRUCache<key_t, value_t>::Get(const key_t& key) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+
+  value_ptr_t value = Find(&shard, key);
+  if (value) {
+    num_hits_ += 1;
+    return value;
+  }
+
+  const auto pending_it = shard.pending.find(key);
+  if (pending_it != shard.pending.end()) {
+    num_waits_ += 1;
+    const std::shared_future<value_ptr_t> future = pending_it->second;
+    lock.unlock();
+    return future.get();
+  }
+
+  num_misses_ += 1;
+
+  std::promise<value_ptr_t> promise;
+  shard.pending.emplace(key, promise.get_future().share());
+  lock.unlock();
+
+  return Load(key, &promise);
+}
+
+template <typename key_t, typename value_t>
+std::shared_future<typename ShardedLRUCache<key_t, value_t>::value_ptr_t>
+ShardedLRUCache<key_t, value_t>::GetAsync(const key_t& key,
+                                          ThreadPool* thread_pool) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+
+  value_ptr_t value = Find(&shard, key);
+  if (value) {
+    num_hits_ += 1;
+    std::promise<value_ptr_t> promise;
+    promise.set_value(std::move(value));
+    return promise.get_future().share();
+  }
+
+  const auto pending_it = shard.pending.find(key);
+  if (pending_it != shard.pending.end()) {
+    num_waits_ += 1;
+    return pending_it->second;
+  }
+
+  num_misses_ += 1;
+
+  auto promise = std::make_shared<std::promise<value_ptr_t>>();
+  const std::shared_future<value_ptr_t> future = promise->get_future().share();
+  shard.pending.emplace(key, future);
+  lock.unlock();
+
+  // The exceptions of the getter function are passed on through the future.
+  const auto LoadTask = [this, key, promise]() {
+    try {
+      Load(key, promise.get());
+    } catch (...) {
+    }
+  };
+
+  if (thread_pool == nullptr) {
+    LoadTask();
+  } else {
+    thread_pool->AddTask(LoadTask);
+  }
+
+  return future;
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Clear() {
+  for (auto& shard : shards_) {
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    shard->elems.clear();
+    shard->elems_map.clear();
+    shard->num_bytes = 0;
+  }
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumHits() const {
+  return num_hits_;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumMisses() const {
+  return num_misses_;
+}
+
+template <typename key_t, typename value_t>
+size_t ShardedLRUCache<key_t, value_t>::NumWaits() const {
+  return num_waits_;
+}
+
+template <typename key_t, typename value_t>
+double ShardedLRUCache<key_t, value_t>::HitRatio() const {
+  const size_t num_hits = num_hits_;
+  const size_t num_requests = num_hits + num_misses_ + num_waits_;
+  return num_requests > 0 ? static_cast<double>(num_hits) / num_requests : 0;
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::GetShard(const key_t& key) {
+  return *shards_[std::hash<key_t>()(key) % shards_.size()];
+}
+
+template <typename key_t, typename value_t>
+const typename ShardedLRUCache<key_t, value_t>::Shard&
+ShardedLRUCache<key_t, value_t>::GetShard(const key_t& key) const {
+  return *shards_[std::hash<key_t>()(key) % shards_.size()];
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::value_ptr_t
+ShardedLRUCache<key_t, value_t>::Find(Shard* shard, const key_t& key) {
+  const auto it = shard->elems_map.find(key);
+  if (it == shard->elems_map.end()) {
+    return nullptr;
+  }
+  shard->elems.splice(shard->elems.begin(), shard->elems, it->second);
+  return it->second->value;
+}
+
+template <typename key_t, typename value_t>
+typename ShardedLRUCache<key_t, value_t>::value_ptr_t
+ShardedLRUCache<key_t, value_t>::Load(const key_t& key,
+                                      std::promise<value_ptr_t>* promise) {
+  Shard& shard = GetShard(key);
+
+  value_ptr_t value;
+  try {
+    value = std::make_shared<const value_t>(getter_func_(key));
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    shard.pending.erase(key);
+    throw;
+  }
+
+  promise->set_value(value);
+
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  Insert(&shard, key, value);
+  shard.pending.erase(key);
+
+  return value;
+}
+
+template <typename key_t, typename value_t>
+void ShardedLRUCache<key_t, value_t>::Insert(Shard* shard, const key_t& key,
+                                             const value_ptr_t& value) {
+  const size_t num_bytes = num_bytes_func_ ? num_bytes_func_(*value) : 0;
+
+  const auto it = shard->elems_map.find(key);
+  if (it != shard->elems_map.end()) {
+    shard->num_bytes -= it->second->num_bytes;
+    shard->elems.erase(it->second);
+    shard->elems_map.erase(it);
+  }
+
+  shard->elems.push_front(Elem{key, value, num_bytes});
+  shard->elems_map.emplace(key, shard->elems.begin());
+  shard->num_bytes += num_bytes;
+
+  // The value of an element is pinned if it is referenced outside the cache.
+  // New references are only handed out under the lock of the shard, so an
+  // unpinned element cannot become pinned while it is evicted.
+  auto elem_it = shard->elems.end();
+  while ((shard->elems.size() > max_num_shard_elems_ ||
+          shard->num_bytes > max_num_shard_bytes_) &&
+         elem_it != shard->elems.begin()) {
+    --elem_it;
+    if (elem_it->value.use_count() > 1) {
+      continue;
+    }
+    shard->num_bytes -= elem_it->num_bytes;
+    shard->elems_map.erase(elem_it->key);
+    elem_it = shard->elems.erase(elem_it);
+  }
+}
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_UTIL_CACHE_H_
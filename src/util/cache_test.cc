@@ -32,6 +32,11 @@
 #define TEST_NAME "util/cache"
 #include "util/testing.h"
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
 #include "util/cache.h"
 
 using namespace colmap;
@@ -150,6 +155,26 @@ BOOST_AUTO_TEST_CASE(TestLRUCachePop) {
   BOOST_CHECK_EQUAL(cache.NumElems(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestLRUCacheErase) {
+  LRUCache<int, int> cache(5, [](const int key) { return key; });
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(cache.Get(i), i);
+  }
+
+  cache.Erase(2);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 4);
+  BOOST_CHECK(!cache.Exists(2));
+  cache.Erase(2);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 4);
+
+  // The erased element is recomputed without evicting another element.
+  BOOST_CHECK_EQUAL(cache.Get(2), 2);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 5);
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK(cache.Exists(i));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestLRUCacheClear) {
   LRUCache<int, int> cache(5, [](const int key) { return key; });
   BOOST_CHECK_EQUAL(cache.NumElems(), 0);
@@ -239,6 +264,26 @@ BOOST_AUTO_TEST_CASE(TestMemoryConstrainedLRUCacheClear) {
   BOOST_CHECK(cache.Exists(1));
 }
 
+BOOST_AUTO_TEST_CASE(TestMemoryConstrainedLRUCacheErase) {
+  MemoryConstrainedLRUCache<int, SizedElem> cache(
+      10, [](const int key) { return SizedElem(key); });
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(cache.Get(i).NumBytes(), i);
+  }
+
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 10);
+  cache.Erase(3);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 4);
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 7);
+  BOOST_CHECK(!cache.Exists(3));
+  cache.Erase(3);
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 7);
+
+  BOOST_CHECK_EQUAL(cache.Get(3).NumBytes(), 3);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 5);
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 10);
+}
+
 BOOST_AUTO_TEST_CASE(TestMemoryConstrainedLRUCacheUpdateNumBytes) {
   MemoryConstrainedLRUCache<int, SizedElem> cache(
       50, [](const int key) { return SizedElem(key); });
@@ -271,3 +316,144 @@ BOOST_AUTO_TEST_CASE(TestMemoryConstrainedLRUCacheUpdateNumBytes) {
   BOOST_CHECK_EQUAL(cache.Get(2).NumBytes(), 2);
   BOOST_CHECK_EQUAL(cache.NumBytes(), 2);
 }
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheEmpty) {
+  ShardedLRUCache<int, int> cache(5, 2, [](const int key) { return key; });
+  BOOST_CHECK_EQUAL(cache.NumElems(), 0);
+  BOOST_CHECK_EQUAL(cache.MaxNumElems(), 5);
+  BOOST_CHECK_EQUAL(cache.NumShards(), 2);
+  BOOST_CHECK_EQUAL(cache.NumHits(), 0);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 0);
+  BOOST_CHECK_EQUAL(cache.NumWaits(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheGet) {
+  ShardedLRUCache<int, int> cache(5, 1, [](const int key) { return key; });
+  BOOST_CHECK_EQUAL(cache.NumElems(), 0);
+  for (int i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(*cache.Get(i), i);
+    BOOST_CHECK_EQUAL(cache.NumElems(), i + 1);
+    BOOST_CHECK(cache.Exists(i));
+  }
+
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 5);
+
+  const auto value0 = cache.Get(0);
+  BOOST_CHECK_EQUAL(*value0, 0);
+  BOOST_CHECK_EQUAL(cache.NumHits(), 1);
+
+  // Evicts the least recently used element, while the value stays valid.
+  BOOST_CHECK_EQUAL(*cache.Get(5), 5);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 5);
+  BOOST_CHECK(cache.Exists(0));
+  BOOST_CHECK(!cache.Exists(1));
+  BOOST_CHECK_EQUAL(*value0, 0);
+
+  cache.Clear();
+  BOOST_CHECK_EQUAL(cache.NumElems(), 0);
+  BOOST_CHECK_EQUAL(*value0, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheShards) {
+  ShardedLRUCache<int, int> cache(8, 4, [](const int key) { return key; });
+  BOOST_CHECK_EQUAL(cache.NumShards(), 4);
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(*cache.Get(i), i);
+  }
+  BOOST_CHECK_EQUAL(cache.NumElems(), 8);
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK(cache.Exists(i));
+  }
+
+  ShardedLRUCache<int, int> small_cache(2, 4,
+                                        [](const int key) { return key; });
+  BOOST_CHECK_EQUAL(small_cache.NumShards(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheConcurrentGet) {
+  std::atomic<int> num_getter_calls(0);
+  ShardedLRUCache<int, int> cache(10, 4, [&num_getter_calls](const int key) {
+    num_getter_calls += 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return key;
+  });
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&cache]() { BOOST_CHECK_EQUAL(*cache.Get(1), 1); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  BOOST_CHECK_EQUAL(num_getter_calls, 1);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 1);
+  BOOST_CHECK_EQUAL(cache.NumHits() + cache.NumWaits(), 7);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCachePinning) {
+  ShardedLRUCache<int, int> cache(2, 1, [](const int key) { return key; });
+  const auto value0 = cache.Get(0);
+  BOOST_CHECK_EQUAL(*cache.Get(1), 1);
+  // The least recently used element is pinned, so the next one is evicted.
+  BOOST_CHECK_EQUAL(*cache.Get(2), 2);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 2);
+  BOOST_CHECK(cache.Exists(0));
+  BOOST_CHECK(!cache.Exists(1));
+  BOOST_CHECK(cache.Exists(2));
+  // All elements are pinned, so the cache exceeds its limit.
+  const auto value2 = cache.Get(2);
+  const auto value3 = cache.Get(3);
+  BOOST_CHECK_EQUAL(cache.NumElems(), 3);
+  BOOST_CHECK_EQUAL(*value0, 0);
+  BOOST_CHECK_EQUAL(*value2, 2);
+  BOOST_CHECK_EQUAL(*value3, 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheMaxNumBytes) {
+  ShardedLRUCache<int, std::vector<char>> cache(
+      10, 10, 1, [](const int key) { return std::vector<char>(key); },
+      [](const std::vector<char>& value) { return value.size(); });
+  BOOST_CHECK_EQUAL(cache.MaxNumBytes(), 10);
+  BOOST_CHECK_EQUAL(cache.Get(4)->size(), 4);
+  BOOST_CHECK_EQUAL(cache.Get(5)->size(), 5);
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 9);
+  BOOST_CHECK_EQUAL(cache.Get(3)->size(), 3);
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 8);
+  BOOST_CHECK(!cache.Exists(4));
+  BOOST_CHECK(cache.Exists(5));
+  BOOST_CHECK(cache.Exists(3));
+  cache.Clear();
+  BOOST_CHECK_EQUAL(cache.NumBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestShardedLRUCacheGetAsync) {
+  std::atomic<int> num_getter_calls(0);
+  ShardedLRUCache<int, int> cache(10, 4, [&num_getter_calls](const int key) {
+    num_getter_calls += 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (key < 0) {
+      throw std::invalid_argument("Negative key");
+    }
+    return key;
+  });
+
+  ThreadPool thread_pool(2);
+  const auto future1 = cache.GetAsync(1, &thread_pool);
+  const auto future2 = cache.GetAsync(1, &thread_pool);
+  BOOST_CHECK_EQUAL(*cache.Get(1), 1);
+  BOOST_CHECK_EQUAL(*future1.get(), 1);
+  BOOST_CHECK_EQUAL(*future2.get(), 1);
+  BOOST_CHECK_EQUAL(*cache.GetAsync(1).get(), 1);
+  BOOST_CHECK_EQUAL(*cache.GetAsync(2).get(), 2);
+  BOOST_CHECK_THROW(cache.GetAsync(-1, &thread_pool).get(),
+                    std::invalid_argument);
+  BOOST_CHECK(!cache.Exists(-1));
+
+  BOOST_CHECK_EQUAL(num_getter_calls, 3);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 3);
+  BOOST_CHECK_EQUAL(cache.NumHits(), 1);
+  BOOST_CHECK_EQUAL(cache.NumWaits(), 2);
+  BOOST_CHECK_EQUAL(cache.HitRatio(), 1.0 / 6.0);
+}
@@ -32,17 +32,21 @@
 #ifndef COLMAP_SRC_UTIL_CAMERA_SPECS_H_
 #define COLMAP_SRC_UTIL_CAMERA_SPECS_H_
 
-#include <string>
-#include <unordered_map>
-#include <vector>
+#include <cstddef>
 
 namespace colmap {
 
-// { make1 : ({ model1 : sensor-width in mm }, ...), ... }
-typedef std::vector<std::pair<std::string, float>> camera_make_specs_t;
-typedef std::unordered_map<std::string, camera_make_specs_t> camera_specs_t;
+// Sensor width in mm of a camera model with lower case make and model names.
+struct CameraSpec {
+  const char* make;
+  const char* model;
+  float sensor_width;
+};
 
-camera_specs_t InitializeCameraSpecs();
+// The specs are a constant array sorted by make, such that they are part of
+// the binary instead of being constructed at program startup.
+extern const CameraSpec kCameraSpecs[];
+extern const size_t kNumCameraSpecs;
 
 }  // namespace colmap
 
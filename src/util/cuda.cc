@@ -84,4 +84,11 @@ void SetBestCudaDevice(const int gpu_index) {
   CUDA_SAFE_CALL(cudaSetDevice(selected_gpu_index));
 }
 
+void InitializeCudaDevice(const int gpu_index) {
+  CHECK_GE(gpu_index, 0);
+  CHECK_LT(gpu_index, GetNumCudaDevices()) << "Invalid CUDA GPU selected";
+  CUDA_SAFE_CALL(cudaSetDevice(gpu_index));
+  CUDA_SAFE_CALL(cudaFree(nullptr));
+}
+
 }  // namespace colmap
@@ -38,6 +38,11 @@ int GetNumCudaDevices();
 
 void SetBestCudaDevice(const int gpu_index);
 
+// Make the given CUDA device current in the calling thread and create its
+// primary context, which is otherwise created lazily by the first CUDA call.
+// Multiple threads can initialize different devices concurrently.
+void InitializeCudaDevice(const int gpu_index);
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_UTIL_CUDA_H_
@@ -31,9 +31,95 @@
 
 #include "util/cudacc.h"
 
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 #include "util/logging.h"
 
 namespace colmap {
+namespace {
+
+class CudaMemoryCache {
+ public:
+  ~CudaMemoryCache() {
+    // Do not check for errors, since the Cuda runtime may already be shut down
+    // when the cache of the main thread is destroyed.
+    for (const auto& allocation : allocations_) {
+      cudaFree(allocation.first);
+    }
+  }
+
+  void Allocate(void** ptr, size_t* pitch, const size_t width,
+                const size_t height) {
+    int device;
+    CUDA_SAFE_CALL(cudaGetDevice(&device));
+
+    const Key key(device, width, height);
+    auto& free_ptrs = free_ptrs_[key];
+    if (!free_ptrs.empty()) {
+      *ptr = free_ptrs.back();
+      free_ptrs.pop_back();
+      *pitch = allocations_.at(*ptr).pitch;
+      return;
+    }
+
+    const cudaError_t error = cudaMallocPitch(ptr, pitch, width, height);
+    if (error == cudaErrorMemoryAllocation) {
+      // Reset the error and retry after releasing the unused memory.
+      cudaGetLastError();
+      FreeUnused();
+      CUDA_SAFE_CALL(cudaMallocPitch(ptr, pitch, width, height));
+    } else {
+      CUDA_SAFE_CALL(error);
+    }
+
+    if (*ptr == nullptr) {
+      return;
+    }
+
+    Allocation allocation;
+    allocation.key = key;
+    allocation.pitch = *pitch;
+    allocations_.emplace(*ptr, allocation);
+  }
+
+  bool Free(void* ptr) {
+    const auto allocation = allocations_.find(ptr);
+    if (allocation == allocations_.end()) {
+      return false;
+    }
+    free_ptrs_[allocation->second.key].push_back(ptr);
+    return true;
+  }
+
+  void FreeUnused() {
+    for (auto& free_ptrs : free_ptrs_) {
+      for (void* ptr : free_ptrs.second) {
+        CUDA_SAFE_CALL(cudaFree(ptr));
+        allocations_.erase(ptr);
+      }
+    }
+    free_ptrs_.clear();
+  }
+
+ private:
+  // The device and the width in bytes and height of an allocation.
+  typedef std::tuple<int, size_t, size_t> Key;
+
+  struct Allocation {
+    Key key;
+    size_t pitch;
+  };
+
+  std::unordered_map<void*, Allocation> allocations_;
+  std::map<Key, std::vector<void*>> free_ptrs_;
+};
+
+thread_local CudaMemoryCache memory_cache;
+
+}  // namespace
 
 CudaTimer::CudaTimer() {
   CUDA_SAFE_CALL(cudaEventCreate(&start_));
@@ -76,8 +162,8 @@ void CudaCheck(const char* file, const int line) {
 }
 
 void CudaSyncAndCheck(const char* file, const int line) {
-  // Synchronizes the default stream which is a nullptr.
-  const cudaError error = cudaStreamSynchronize(nullptr);
+  // Synchronizes the default stream of the calling thread.
+  const cudaError error = cudaStreamSynchronize(cudaStreamPerThread);
   if (cudaSuccess != error) {
     std::cerr << StringPrintf("CUDA error at %s:%i - %s", file, line,
                               cudaGetErrorString(error))
@@ -91,4 +177,17 @@ void CudaSyncAndCheck(const char* file, const int line) {
   }
 }
 
+void CudaMallocPitchCached(void** ptr, size_t* pitch, const size_t width,
+                           const size_t height) {
+  memory_cache.Allocate(ptr, pitch, width, height);
+}
+
+void CudaFreeCached(void* ptr) {
+  if (ptr != nullptr && !memory_cache.Free(ptr)) {
+    CUDA_SAFE_CALL(cudaFree(ptr));
+  }
+}
+
+void CudaFreeCachedMemory() { memory_cache.FreeUnused(); }
+
 }  // namespace colmap
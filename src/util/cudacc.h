@@ -61,6 +61,19 @@ void CudaSafeCall(const cudaError_t error, const std::string& file,
 void CudaCheck(const char* file, const int line);
 void CudaSyncAndCheck(const char* file, const int line);
 
+// Allocate pitched memory on the current device. Released memory is kept in a
+// cache of the calling thread and reused for later allocations of the same
+// size, since freeing device memory implicitly synchronizes the device and
+// would stall the kernels of all other threads. Memory must be released in
+// the thread that allocated it, so that its reuse is ordered by the default
+// stream of the thread.
+void CudaMallocPitchCached(void** ptr, size_t* pitch, const size_t width,
+                           const size_t height);
+void CudaFreeCached(void* ptr);
+
+// Free the cached device memory of the calling thread.
+void CudaFreeCachedMemory();
+
 }  // namespace colmap
 
 #endif  // COLMAP_SRC_UTIL_CUDACC_H_
@@ -0,0 +1,88 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#include "util/mapped_file.h"
+
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace colmap {
+
+MappedFile::MappedFile(const std::string& path)
+    : path_(path), data_(nullptr), size_(0) {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "Failed to open " << path;
+
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Failed to stat " << path;
+  size_ = static_cast<size_t>(file_stat.st_size);
+
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    CHECK(data != MAP_FAILED) << "Failed to map " << path;
+    data_ = static_cast<const char*>(data);
+  }
+
+  // The mapping keeps a reference to the file.
+  close(fd);
+#else
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  CHECK(file.is_open()) << path;
+  size_ = static_cast<size_t>(file.tellg());
+  buffer_.resize(size_);
+  file.seekg(0, std::ios::beg);
+  file.read(buffer_.data(), size_);
+  data_ = buffer_.data();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+#endif
+}
+
+const std::string& MappedFile::Path() const { return path_; }
+
+const char* MappedFile::Data() const { return data_; }
+
+size_t MappedFile::Size() const { return size_; }
+
+}  // namespace colmap
@@ -0,0 +1,247 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_UTIL_MAPPED_FILE_H_
+#define COLMAP_SRC_UTIL_MAPPED_FILE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util/logging.h"
+
+namespace colmap {
+
+// The alignment in bytes of all arrays in memory-mapped files, which is
+// sufficient for all arithmetic types.
+const size_t kMappedFileAlignment = 8;
+
+// Read-only view of a file in memory. On POSIX systems, the file is mapped into
+// memory, such that its pages are only loaded on first access and are shared
+// through the page cache by all processes that map the same file. On other
+// systems, the file is fully read into memory. The data is stored in native
+// byte order without any conversion.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const std::string& Path() const;
+  const char* Data() const;
+  size_t Size() const;
+
+  // Return a pointer to an array of elements at the given offset, which is
+  // first aligned to kMappedFileAlignment, and advance the offset past the
+  // array. The memory is not accessed by this function.
+  template <typename T>
+  const T* ReadArray(size_t* offset, const size_t num_elements = 1) const;
+
+  // Return the value of a single element, see ReadArray.
+  template <typename T>
+  T Read(size_t* offset) const;
+
+ private:
+  std::string path_;
+  const char* data_;
+  size_t size_;
+  // Only used on systems without support for memory-mapping.
+  std::vector<char> buffer_;
+};
+
+// Write an array of elements in native byte order to a stream, such that it
+// can be read with MappedFile::ReadArray. The position of the stream relative
+// to the beginning of the file is first padded to kMappedFileAlignment.
+template <typename T>
+void WriteMappedArray(std::ostream* stream, const T* data,
+                      const size_t num_elements);
+
+// Write a single element, see WriteMappedArray.
+template <typename T>
+void WriteMapped(std::ostream* stream, const T& data);
+
+// Array that either owns its elements or references read-only elements of a
+// file mapped into memory. The referenced elements are copied into owned
+// memory before the first modification, so the array can be mutated
+// independently of the mapped file.
+template <typename T>
+class MappableArray {
+ public:
+  MappableArray();
+
+  size_t size() const;
+  bool empty() const;
+  const T* data() const;
+  const T& operator[](const size_t idx) const;
+
+  // Reference the elements of a mapped file, which must outlive the array or
+  // the next modification of the array.
+  void Map(const T* data, const size_t size);
+
+  // Whether the array references the elements of a mapped file.
+  bool IsMapped() const;
+
+  void reserve(const size_t size);
+  void push_back(const T& value);
+  void clear();
+  void swap(MappableArray<T>& other);
+
+ private:
+  // Copy the mapped elements into owned memory.
+  void Own();
+
+  std::vector<T> values_;
+  const T* mapped_data_;
+  size_t mapped_size_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+const T* MappedFile::ReadArray(size_t* offset,
+                               const size_t num_elements) const {
+  static_assert(alignof(T) <= kMappedFileAlignment,
+                "Alignment of type is not supported");
+  const size_t begin = (*offset + kMappedFileAlignment - 1) /
+                       kMappedFileAlignment * kMappedFileAlignment;
+  const size_t end = begin + num_elements * sizeof(T);
+  CHECK_LE(end, size_) << "Unexpected end of file " << path_;
+  *offset = end;
+  return reinterpret_cast<const T*>(data_ + begin);
+}
+
+template <typename T>
+T MappedFile::Read(size_t* offset) const {
+  T value;
+  std::memcpy(&value, ReadArray<T>(offset), sizeof(T));
+  return value;
+}
+
+template <typename T>
+void WriteMappedArray(std::ostream* stream, const T* data,
+                      const size_t num_elements) {
+  static_assert(alignof(T) <= kMappedFileAlignment,
+                "Alignment of type is not supported");
+  const size_t num_padding_bytes =
+      (kMappedFileAlignment -
+       static_cast<size_t>(stream->tellp()) % kMappedFileAlignment) %
+      kMappedFileAlignment;
+  const char kPadding[kMappedFileAlignment] = {0};
+  stream->write(kPadding, num_padding_bytes);
+  stream->write(reinterpret_cast<const char*>(data), num_elements * sizeof(T));
+}
+
+template <typename T>
+void WriteMapped(std::ostream* stream, const T& data) {
+  WriteMappedArray(stream, &data, 1);
+}
+
+template <typename T>
+MappableArray<T>::MappableArray() : mapped_data_(nullptr), mapped_size_(0) {}
+
+template <typename T>
+size_t MappableArray<T>::size() const {
+  return mapped_data_ == nullptr ? values_.size() : mapped_size_;
+}
+
+template <typename T>
+bool MappableArray<T>::empty() const {
+  return size() == 0;
+}
+
+template <typename T>
+const T* MappableArray<T>::data() const {
+  return mapped_data_ == nullptr ? values_.data() : mapped_data_;
+}
+
+template <typename T>
+const T& MappableArray<T>::operator[](const size_t idx) const {
+  return data()[idx];
+}
+
+template <typename T>
+void MappableArray<T>::Map(const T* data, const size_t size) {
+  values_.clear();
+  values_.shrink_to_fit();
+  mapped_data_ = data;
+  mapped_size_ = size;
+}
+
+template <typename T>
+bool MappableArray<T>::IsMapped() const {
+  return mapped_data_ != nullptr;
+}
+
+template <typename T>
+void MappableArray<T>::reserve(const size_t size) {
+  Own();
+  values_.reserve(size);
+}
+
+template <typename T>
+void MappableArray<T>::push_back(const T& value) {
+  Own();
+  values_.push_back(value);
+}
+
+template <typename T>
+void MappableArray<T>::clear() {
+  values_.clear();
+  mapped_data_ = nullptr;
+  mapped_size_ = 0;
+}
+
+template <typename T>
+void MappableArray<T>::swap(MappableArray<T>& other) {
+  values_.swap(other.values_);
+  std::swap(mapped_data_, other.mapped_data_);
+  std::swap(mapped_size_, other.mapped_size_);
+}
+
+template <typename T>
+void MappableArray<T>::Own() {
+  if (mapped_data_ != nullptr) {
+    values_.assign(mapped_data_, mapped_data_ + mapped_size_);
+    mapped_data_ = nullptr;
+    mapped_size_ = 0;
+  }
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_MAPPED_FILE_H_
@@ -0,0 +1,117 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "util/mapped_file"
+#include "util/testing.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "util/mapped_file.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestReadWrite) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_mapped_file_%%%%-%%%%"))
+          .string();
+
+  const std::vector<uint64_t> values = {1, 2, 3};
+  {
+    std::ofstream file(path, std::ios::binary);
+    WriteMapped<uint8_t>(&file, 42);
+    WriteMapped<float>(&file, 1.5f);
+    WriteMappedArray(&file, values.data(), values.size());
+    WriteMapped<uint8_t>(&file, 7);
+  }
+
+  {
+    MappedFile file(path);
+    BOOST_CHECK_EQUAL(file.Path(), path);
+    BOOST_CHECK_EQUAL(file.Size(), 41);
+
+    size_t offset = 0;
+    BOOST_CHECK_EQUAL(file.Read<uint8_t>(&offset), 42);
+    BOOST_CHECK_EQUAL(offset, 1);
+    BOOST_CHECK_EQUAL(file.Read<float>(&offset), 1.5f);
+    BOOST_CHECK_EQUAL(offset, 12);
+    const uint64_t* mapped_values =
+        file.ReadArray<uint64_t>(&offset, values.size());
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(mapped_values) %
+                          kMappedFileAlignment,
+                      0);
+    for (size_t i = 0; i < values.size(); ++i) {
+      BOOST_CHECK_EQUAL(mapped_values[i], values[i]);
+    }
+    BOOST_CHECK_EQUAL(file.Read<uint8_t>(&offset), 7);
+    BOOST_CHECK_EQUAL(offset, file.Size());
+  }
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestMappableArray) {
+  const std::vector<int> values = {1, 2, 3};
+
+  MappableArray<int> array;
+  BOOST_CHECK(array.empty());
+  BOOST_CHECK(!array.IsMapped());
+
+  array.Map(values.data(), values.size());
+  BOOST_CHECK(array.IsMapped());
+  BOOST_CHECK_EQUAL(array.data(), values.data());
+  BOOST_CHECK_EQUAL(array.size(), 3);
+  BOOST_CHECK_EQUAL(array[2], 3);
+
+  array.push_back(4);
+  BOOST_CHECK(!array.IsMapped());
+  BOOST_CHECK_NE(array.data(), values.data());
+  BOOST_CHECK_EQUAL(array.size(), 4);
+  for (size_t i = 0; i < values.size(); ++i) {
+    BOOST_CHECK_EQUAL(array[i], values[i]);
+  }
+  BOOST_CHECK_EQUAL(array[3], 4);
+  BOOST_CHECK_EQUAL(values.size(), 3);
+
+  MappableArray<int> other;
+  other.Map(values.data(), values.size());
+  array.swap(other);
+  BOOST_CHECK(array.IsMapped());
+  BOOST_CHECK_EQUAL(array.size(), 3);
+  BOOST_CHECK(!other.IsMapped());
+  BOOST_CHECK_EQUAL(other.size(), 4);
+
+  array.clear();
+  BOOST_CHECK(array.empty());
+  BOOST_CHECK(!array.IsMapped());
+}
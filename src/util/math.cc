@@ -31,6 +31,8 @@
 
 #include "util/math.h"
 
+#include <cstring>
+
 namespace colmap {
 
 size_t NChooseK(const size_t n, const size_t k) {
@@ -41,4 +43,67 @@ size_t NChooseK(const size_t n, const size_t k) {
   return (n * NChooseK(n - 1, k - 1)) / k;
 }
 
+uint16_t FloatToHalf(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+
+  uint16_t half;
+  if (bits >= (127u + 16u) << 23) {
+    // Infinity or NaN, which are kept as quiet NaN.
+    half = bits > (255u << 23) ? 0x7e00 : 0x7c00;
+  } else if (bits < (113u << 23)) {
+    // Subnormal or zero, where the addition with the magic number aligns the
+    // mantissa and rounds it to nearest even.
+    const uint32_t kMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+    float magic;
+    std::memcpy(&magic, &kMagicBits, sizeof(magic));
+    float abs_value;
+    std::memcpy(&abs_value, &bits, sizeof(abs_value));
+    abs_value += magic;
+    std::memcpy(&bits, &abs_value, sizeof(bits));
+    half = static_cast<uint16_t>(bits - kMagicBits);
+  } else {
+    // Normalized number with rebiased exponent and mantissa rounded to nearest
+    // even.
+    const uint32_t mantissa_odd = (bits >> 13) & 1u;
+    bits -= (127u - 15u) << 23;
+    bits += 0xfffu + mantissa_odd;
+    half = static_cast<uint16_t>(bits >> 13);
+  }
+
+  return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloat(const uint16_t value) {
+  const uint32_t kExponentMask = 0x7c00u << 13;
+
+  uint32_t bits = (value & 0x7fffu) << 13;
+  const uint32_t exponent = bits & kExponentMask;
+  bits += (127u - 15u) << 23;
+
+  if (exponent == kExponentMask) {
+    // Infinity or NaN.
+    bits += (128u - 16u) << 23;
+  } else if (exponent == 0) {
+    // Subnormal or zero, which is renormalized.
+    const uint32_t kMagicBits = 113u << 23;
+    float magic;
+    std::memcpy(&magic, &kMagicBits, sizeof(magic));
+    bits += 1u << 23;
+    float renormalized;
+    std::memcpy(&renormalized, &bits, sizeof(renormalized));
+    renormalized -= magic;
+    std::memcpy(&bits, &renormalized, sizeof(bits));
+  }
+
+  bits |= static_cast<uint32_t>(value & 0x8000u) << 16;
+
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
 }  // namespace colmap
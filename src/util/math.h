@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <cmath>
 #include <complex>
+#include <cstdint>
 #include <limits>
 #include <list>
 #include <stdexcept>
@@ -131,6 +132,12 @@ T2 TruncateCast(const T1 value);
 template <typename T>
 T Percentile(const std::vector<T>& elems, const double p);
 
+// Convert between single precision and IEEE-754 half precision floats, which
+// are stored as their bit pattern. Values are rounded to the nearest half
+// precision float with ties to even, values out of range become infinite.
+uint16_t FloatToHalf(const float value);
+float HalfToFloat(const uint16_t value);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
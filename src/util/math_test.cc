@@ -223,3 +223,37 @@ BOOST_AUTO_TEST_CASE(TestTruncateCast) {
   BOOST_CHECK_EQUAL((TruncateCast<int, uint16_t>(-1)), 0);
   BOOST_CHECK_EQUAL((TruncateCast<int, uint16_t>(65536)), 65535);
 }
+
+BOOST_AUTO_TEST_CASE(TestFloatToHalf) {
+  BOOST_CHECK_EQUAL(FloatToHalf(0.0f), 0x0000);
+  BOOST_CHECK_EQUAL(FloatToHalf(-0.0f), 0x8000);
+  BOOST_CHECK_EQUAL(FloatToHalf(1.0f), 0x3c00);
+  BOOST_CHECK_EQUAL(FloatToHalf(-2.0f), 0xc000);
+  BOOST_CHECK_EQUAL(FloatToHalf(65504.0f), 0x7bff);
+  BOOST_CHECK_EQUAL(FloatToHalf(65520.0f), 0x7c00);
+  BOOST_CHECK_EQUAL(FloatToHalf(std::numeric_limits<float>::infinity()),
+                    0x7c00);
+  BOOST_CHECK_EQUAL(FloatToHalf(std::numeric_limits<float>::quiet_NaN()),
+                    0x7e00);
+  BOOST_CHECK_EQUAL(FloatToHalf(std::pow(2.0f, -24.0f)), 0x0001);
+  BOOST_CHECK_EQUAL(FloatToHalf(std::pow(2.0f, -26.0f)), 0x0000);
+  // Ties are rounded to even.
+  BOOST_CHECK_EQUAL(FloatToHalf(1.0f + std::pow(2.0f, -11.0f)), 0x3c00);
+  BOOST_CHECK_EQUAL(FloatToHalf(1.0f + 3.0f * std::pow(2.0f, -11.0f)),
+                    0x3c02);
+}
+
+BOOST_AUTO_TEST_CASE(TestHalfToFloat) {
+  BOOST_CHECK_EQUAL(HalfToFloat(0x0000), 0.0f);
+  BOOST_CHECK_EQUAL(HalfToFloat(0x3c00), 1.0f);
+  BOOST_CHECK_EQUAL(HalfToFloat(0xc000), -2.0f);
+  BOOST_CHECK_EQUAL(HalfToFloat(0x7bff), 65504.0f);
+  BOOST_CHECK_EQUAL(HalfToFloat(0x0001), std::pow(2.0f, -24.0f));
+  BOOST_CHECK(IsInf(HalfToFloat(0x7c00)));
+  BOOST_CHECK(IsNaN(HalfToFloat(0x7e00)));
+  for (uint32_t half = 0; half < 0x10000; ++half) {
+    if ((half & 0x7c00) != 0x7c00) {
+      BOOST_CHECK_EQUAL(FloatToHalf(HalfToFloat(half)), half);
+    }
+  }
+}
@@ -0,0 +1,426 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "util/metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/string.h"
+
+namespace colmap {
+namespace {
+
+enum class MetricType { COUNTER, GAUGE, HISTOGRAM };
+
+struct Metric {
+  MetricType type;
+  std::string help;
+  std::unique_ptr<MetricCounter> counter;
+  std::unique_ptr<MetricGauge> gauge;
+  std::unique_ptr<MetricHistogram> histogram;
+};
+
+struct MetricsRegistry {
+  MetricsRegistry() : start_time(std::chrono::steady_clock::now()) {}
+  const std::chrono::steady_clock::time_point start_time;
+  std::mutex mutex;
+  // Ordered by name for deterministic output.
+  std::map<std::string, Metric> metrics;
+
+  // State of the periodic export.
+  std::mutex export_mutex;
+  std::condition_variable export_condition;
+  std::thread export_thread;
+  bool stop_export = false;
+  bool exit_handler_registered = false;
+};
+
+// The registry is intentionally never destroyed, since other threads might
+// still update metrics while the static objects are destroyed at exit.
+MetricsRegistry& GetMetricsRegistry() {
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return *registry;
+}
+
+// Must be called while holding the lock of the registry.
+Metric& GetOrRegisterMetric(MetricsRegistry* registry, const std::string& name,
+                            const std::string& help, const MetricType type) {
+  CHECK(!name.empty());
+  auto it = registry->metrics.find(name);
+  if (it == registry->metrics.end()) {
+    it = registry->metrics.emplace(name, Metric()).first;
+    it->second.type = type;
+    it->second.help = help;
+  }
+  CHECK(it->second.type == type)
+      << "Metric " << name << " registered with a different type";
+  return it->second;
+}
+
+std::string EscapeJSONString(const std::string& str) {
+  std::string escaped;
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += StringPrintf("\\u%04x", static_cast<int>(c));
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+std::string FormatJSONNumber(const double value) {
+  if (!std::isfinite(value)) {
+    return "null";
+  }
+  return StringPrintf("%.10g", value);
+}
+
+std::string FormatPrometheusNumber(const double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  } else if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  return StringPrintf("%.10g", value);
+}
+
+double GetUptimeSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       GetMetricsRegistry().start_time)
+      .count();
+}
+
+double GetUnixTimestamp() {
+  return std::chrono::duration<double>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+// Write to a temporary file and then rename it, so that readers polling the
+// file never see a partially written version.
+template <typename write_func_t>
+void WriteFileAtomically(const std::string& path,
+                         const write_func_t& write_func) {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    CHECK(file.is_open()) << tmp_path;
+    write_func(file);
+  }
+  CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0) << path;
+}
+
+void WriteMetrics(const std::string& path) {
+  if (HasFileExtension(path, ".prom")) {
+    WriteMetricsPrometheus(path);
+  } else {
+    WriteMetricsJSON(path);
+  }
+}
+
+void StopExportingMetricsAtExit() {
+  StopExportingMetrics();
+}
+
+}  // namespace
+
+MetricCounter::MetricCounter() : value_(0) {}
+
+void MetricCounter::Increment(const int64_t count) {
+  value_.fetch_add(count, std::memory_order_relaxed);
+}
+
+int64_t MetricCounter::Value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+void MetricCounter::Reset() { value_ = 0; }
+
+MetricGauge::MetricGauge() : value_(0) {}
+
+void MetricGauge::Set(const double value) {
+  value_.store(value, std::memory_order_relaxed);
+}
+
+void MetricGauge::Add(const double value) {
+  double current_value = value_.load(std::memory_order_relaxed);
+  while (!value_.compare_exchange_weak(current_value, current_value + value,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+double MetricGauge::Value() const {
+  return value_.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double>& bucket_bounds)
+    : bucket_bounds_(bucket_bounds),
+      bucket_counts_(bucket_bounds.size() + 1, 0),
+      count_(0),
+      sum_(0) {
+  CHECK(std::is_sorted(bucket_bounds_.begin(), bucket_bounds_.end()));
+}
+
+void MetricHistogram::Observe(const double value) {
+  const size_t bucket_idx =
+      std::lower_bound(bucket_bounds_.begin(), bucket_bounds_.end(), value) -
+      bucket_bounds_.begin();
+  std::unique_lock<std::mutex> lock(mutex_);
+  bucket_counts_[bucket_idx] += 1;
+  count_ += 1;
+  sum_ += value;
+}
+
+void MetricHistogram::Reset() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::fill(bucket_counts_.begin(), bucket_counts_.end(), 0);
+  count_ = 0;
+  sum_ = 0;
+}
+
+const std::vector<double>& MetricHistogram::BucketBounds() const {
+  return bucket_bounds_;
+}
+
+std::vector<int64_t> MetricHistogram::BucketCounts() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return bucket_counts_;
+}
+
+int64_t MetricHistogram::Count() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return count_;
+}
+
+double MetricHistogram::Sum() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return sum_;
+}
+
+MetricCounter& GetMetricCounter(const std::string& name,
+                                const std::string& help) {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  Metric& metric =
+      GetOrRegisterMetric(&registry, name, help, MetricType::COUNTER);
+  if (!metric.counter) {
+    metric.counter.reset(new MetricCounter());
+  }
+  return *metric.counter;
+}
+
+MetricGauge& GetMetricGauge(const std::string& name, const std::string& help) {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  Metric& metric =
+      GetOrRegisterMetric(&registry, name, help, MetricType::GAUGE);
+  if (!metric.gauge) {
+    metric.gauge.reset(new MetricGauge());
+  }
+  return *metric.gauge;
+}
+
+MetricHistogram& GetMetricHistogram(const std::string& name,
+                                    const std::string& help,
+                                    const std::vector<double>& bucket_bounds) {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  Metric& metric =
+      GetOrRegisterMetric(&registry, name, help, MetricType::HISTOGRAM);
+  if (!metric.histogram) {
+    metric.histogram.reset(new MetricHistogram(bucket_bounds));
+  }
+  return *metric.histogram;
+}
+
+std::vector<double> GetDefaultDurationBuckets() {
+  return {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 50, 100, 500};
+}
+
+void WriteMetricsJSON(const std::string& path) {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  WriteFileAtomically(path, [&registry](std::ofstream& file) {
+    file << "{\"timestamp\":" << FormatJSONNumber(GetUnixTimestamp())
+         << ",\"uptime\":" << FormatJSONNumber(GetUptimeSeconds())
+         << ",\"metrics\":{";
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    bool first = true;
+    for (const auto& name_and_metric : registry.metrics) {
+      const Metric& metric = name_and_metric.second;
+      if (!first) {
+        file << ",";
+      }
+      first = false;
+      file << "\n\"" << EscapeJSONString(name_and_metric.first)
+           << "\":{\"help\":\"" << EscapeJSONString(metric.help) << "\",";
+      switch (metric.type) {
+        case MetricType::COUNTER:
+          file << "\"type\":\"counter\",\"value\":" << metric.counter->Value();
+          break;
+        case MetricType::GAUGE:
+          file << "\"type\":\"gauge\",\"value\":"
+               << FormatJSONNumber(metric.gauge->Value());
+          break;
+        case MetricType::HISTOGRAM: {
+          const std::vector<int64_t> counts = metric.histogram->BucketCounts();
+          const std::vector<double>& bounds = metric.histogram->BucketBounds();
+          file << "\"type\":\"histogram\",\"count\":"
+               << metric.histogram->Count()
+               << ",\"sum\":" << FormatJSONNumber(metric.histogram->Sum())
+               << ",\"buckets\":[";
+          for (size_t i = 0; i < counts.size(); ++i) {
+            if (i > 0) {
+              file << ",";
+            }
+            file << "{\"le\":"
+                 << (i < bounds.size() ? FormatJSONNumber(bounds[i])
+                                       : std::string("null"))
+                 << ",\"count\":" << counts[i] << "}";
+          }
+          file << "]";
+          break;
+        }
+      }
+      file << "}";
+    }
+    file << "\n}}" << std::endl;
+  });
+}
+
+void WriteMetricsPrometheus(const std::string& path) {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  WriteFileAtomically(path, [&registry](std::ofstream& file) {
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    for (const auto& name_and_metric : registry.metrics) {
+      const std::string& name = name_and_metric.first;
+      const Metric& metric = name_and_metric.second;
+      if (!metric.help.empty()) {
+        file << "# HELP " << name << " " << metric.help << "\n";
+      }
+      switch (metric.type) {
+        case MetricType::COUNTER:
+          file << "# TYPE " << name << " counter\n";
+          file << name << " " << metric.counter->Value() << "\n";
+          break;
+        case MetricType::GAUGE:
+          file << "# TYPE " << name << " gauge\n";
+          file << name << " " << FormatPrometheusNumber(metric.gauge->Value())
+               << "\n";
+          break;
+        case MetricType::HISTOGRAM: {
+          // Prometheus expects cumulative bucket counts.
+          const std::vector<int64_t> counts = metric.histogram->BucketCounts();
+          const std::vector<double>& bounds = metric.histogram->BucketBounds();
+          file << "# TYPE " << name << " histogram\n";
+          int64_t cumulative_count = 0;
+          for (size_t i = 0; i < counts.size(); ++i) {
+            cumulative_count += counts[i];
+            file << name << "_bucket{le=\""
+                 << (i < bounds.size() ? FormatPrometheusNumber(bounds[i])
+                                       : std::string("+Inf"))
+                 << "\"} " << cumulative_count << "\n";
+          }
+          file << name << "_sum "
+               << FormatPrometheusNumber(metric.histogram->Sum()) << "\n";
+          file << name << "_count " << cumulative_count << "\n";
+          break;
+        }
+      }
+    }
+    file.flush();
+  });
+}
+
+void ExportMetricsPeriodically(const std::string& path,
+                               const double interval_seconds) {
+  if (path.empty()) {
+    return;
+  }
+
+  CHECK_GT(interval_seconds, 0);
+
+  StopExportingMetrics();
+
+  MetricsRegistry& registry = GetMetricsRegistry();
+  std::unique_lock<std::mutex> lock(registry.export_mutex);
+  if (!registry.exit_handler_registered) {
+    std::atexit(&StopExportingMetricsAtExit);
+    registry.exit_handler_registered = true;
+  }
+
+  registry.stop_export = false;
+  registry.export_thread = std::thread([path, interval_seconds, &registry]() {
+    const std::chrono::duration<double> interval(interval_seconds);
+    std::unique_lock<std::mutex> lock(registry.export_mutex);
+    while (true) {
+      lock.unlock();
+      WriteMetrics(path);
+      lock.lock();
+      if (registry.stop_export) {
+        break;
+      }
+      // If the export is stopped while waiting, the final state is written
+      // in the next iteration before exiting.
+      registry.export_condition.wait_for(
+          lock, interval, [&registry]() { return registry.stop_export; });
+    }
+  });
+}
+
+void StopExportingMetrics() {
+  MetricsRegistry& registry = GetMetricsRegistry();
+  {
+    std::unique_lock<std::mutex> lock(registry.export_mutex);
+    registry.stop_export = true;
+  }
+  registry.export_condition.notify_all();
+  if (registry.export_thread.joinable()) {
+    registry.export_thread.join();
+  }
+}
+
+}  // namespace colmap
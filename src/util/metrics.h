@@ -0,0 +1,139 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_UTIL_METRICS_H_
+#define COLMAP_SRC_UTIL_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Process-wide registry of named counters, gauges, and histograms, which can
+// be exported in machine-readable form while a command is running, e.g.:
+//
+//    static MetricCounter& num_images = GetMetricCounter(
+//        "mapper_registered_images_total", "Number of registered images");
+//    num_images.Increment();
+//
+//    ExportMetricsPeriodically("metrics.prom", 10);
+//
+// The metrics are registered on first use and live until the program exits,
+// so references to them can be cached in static variables. Updating a metric
+// is lock-free, except for histograms, which lock a mutex per observation.
+// Metric names should follow the Prometheus naming conventions.
+
+// Monotonically increasing count of events.
+class MetricCounter {
+ public:
+  MetricCounter();
+  void Increment(const int64_t count = 1);
+  int64_t Value() const;
+  void Reset();
+
+ private:
+  std::atomic<int64_t> value_;
+};
+
+// Current value of a quantity that can go up and down.
+class MetricGauge {
+ public:
+  MetricGauge();
+  void Set(const double value);
+  void Add(const double value);
+  double Value() const;
+
+ private:
+  std::atomic<double> value_;
+};
+
+// Distribution of observed values in buckets with the given upper bounds.
+class MetricHistogram {
+ public:
+  explicit MetricHistogram(const std::vector<double>& bucket_bounds);
+
+  void Observe(const double value);
+  void Reset();
+
+  // The upper bounds of the buckets in increasing order and the number of
+  // observations per bucket, which is not cumulative. The last count is for
+  // the values larger than all bounds.
+  const std::vector<double>& BucketBounds() const;
+  std::vector<int64_t> BucketCounts() const;
+  int64_t Count() const;
+  double Sum() const;
+
+ private:
+  const std::vector<double> bucket_bounds_;
+  mutable std::mutex mutex_;
+  std::vector<int64_t> bucket_counts_;
+  int64_t count_;
+  double sum_;
+};
+
+// Get the metric with the given name or register it on first use. A name can
+// only be used for one type of metric. The help text and bucket bounds of the
+// first registration are kept.
+MetricCounter& GetMetricCounter(const std::string& name,
+                                const std::string& help);
+MetricGauge& GetMetricGauge(const std::string& name, const std::string& help);
+MetricHistogram& GetMetricHistogram(const std::string& name,
+                                    const std::string& help,
+                                    const std::vector<double>& bucket_bounds);
+
+// Default histogram bounds in seconds for the durations of operations that
+// take between a millisecond and a few minutes.
+std::vector<double> GetDefaultDurationBuckets();
+
+// Write the current value of all metrics as a JSON object or in the
+// Prometheus text exposition format.
+void WriteMetricsJSON(const std::string& path);
+void WriteMetricsPrometheus(const std::string& path);
+
+// Write the metrics to the given path every interval seconds from a
+// background thread and once more when the program exits. The Prometheus text
+// format is used if the path has the extension ".prom", so that the file can
+// be served by the textfile collector of the Prometheus node exporter, and
+// JSON otherwise. The file is replaced atomically, such that readers never
+// see partially written files. Does nothing for an empty path.
+void ExportMetricsPeriodically(const std::string& path,
+                               const double interval_seconds);
+
+// Stop the periodic export started by ExportMetricsPeriodically.
+void StopExportingMetrics();
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_METRICS_H_
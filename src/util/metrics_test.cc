@@ -0,0 +1,194 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "util/metrics"
+#include "util/testing.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "util/metrics.h"
+
+using namespace colmap;
+
+namespace {
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+std::string GetTempPath(const std::string& pattern) {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path(pattern))
+      .string();
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestCounter) {
+  MetricCounter& counter = GetMetricCounter("test_counter_total", "Counter");
+  counter.Reset();
+  BOOST_CHECK_EQUAL(counter.Value(), 0);
+  counter.Increment();
+  counter.Increment(5);
+  BOOST_CHECK_EQUAL(counter.Value(), 6);
+  BOOST_CHECK_EQUAL(&GetMetricCounter("test_counter_total", ""), &counter);
+  BOOST_CHECK_EQUAL(GetMetricCounter("test_counter_total", "").Value(), 6);
+}
+
+BOOST_AUTO_TEST_CASE(TestCounterMultipleThreads) {
+  MetricCounter& counter =
+      GetMetricCounter("test_threads_counter_total", "Counter");
+  counter.Reset();
+  MetricGauge& gauge = GetMetricGauge("test_threads_gauge", "Gauge");
+  gauge.Set(0);
+
+  const int kNumThreads = 4;
+  const int kNumIncrements = 1000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&counter, &gauge]() {
+      for (int j = 0; j < kNumIncrements; ++j) {
+        counter.Increment();
+        gauge.Add(0.5);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  BOOST_CHECK_EQUAL(counter.Value(), kNumThreads * kNumIncrements);
+  BOOST_CHECK_EQUAL(gauge.Value(), 0.5 * kNumThreads * kNumIncrements);
+}
+
+BOOST_AUTO_TEST_CASE(TestGauge) {
+  MetricGauge& gauge = GetMetricGauge("test_gauge", "Gauge");
+  gauge.Set(2.5);
+  BOOST_CHECK_EQUAL(gauge.Value(), 2.5);
+  gauge.Add(-1);
+  BOOST_CHECK_EQUAL(gauge.Value(), 1.5);
+}
+
+BOOST_AUTO_TEST_CASE(TestHistogram) {
+  MetricHistogram& histogram =
+      GetMetricHistogram("test_histogram", "Histogram", {1, 2, 4});
+  histogram.Reset();
+  histogram.Observe(0.5);
+  histogram.Observe(1);
+  histogram.Observe(3);
+  histogram.Observe(10);
+  BOOST_CHECK_EQUAL(histogram.Count(), 4);
+  BOOST_CHECK_EQUAL(histogram.Sum(), 14.5);
+  const std::vector<int64_t> counts = histogram.BucketCounts();
+  BOOST_CHECK_EQUAL(counts.size(), 4);
+  BOOST_CHECK_EQUAL(counts[0], 2);
+  BOOST_CHECK_EQUAL(counts[1], 0);
+  BOOST_CHECK_EQUAL(counts[2], 1);
+  BOOST_CHECK_EQUAL(counts[3], 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteMetricsPrometheus) {
+  GetMetricCounter("test_prom_counter_total", "Some counter").Increment(3);
+  GetMetricGauge("test_prom_gauge", "Some gauge").Set(0.25);
+  MetricHistogram& histogram =
+      GetMetricHistogram("test_prom_histogram", "Some histogram", {1, 2});
+  histogram.Observe(0.5);
+  histogram.Observe(1.5);
+  histogram.Observe(5);
+
+  const std::string path = GetTempPath("colmap_metrics_%%%%-%%%%.prom");
+  WriteMetricsPrometheus(path);
+  const std::string content = ReadFile(path);
+  boost::filesystem::remove(path);
+
+  BOOST_CHECK_NE(content.find("# HELP test_prom_counter_total Some counter\n"
+                              "# TYPE test_prom_counter_total counter\n"
+                              "test_prom_counter_total 3\n"),
+                 std::string::npos);
+  BOOST_CHECK_NE(content.find("# TYPE test_prom_gauge gauge\n"
+                              "test_prom_gauge 0.25\n"),
+                 std::string::npos);
+  BOOST_CHECK_NE(content.find("test_prom_histogram_bucket{le=\"1\"} 1\n"
+                              "test_prom_histogram_bucket{le=\"2\"} 2\n"
+                              "test_prom_histogram_bucket{le=\"+Inf\"} 3\n"
+                              "test_prom_histogram_sum 7\n"
+                              "test_prom_histogram_count 3\n"),
+                 std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteMetricsJSON) {
+  GetMetricCounter("test_json_counter_total", "Counter \"quoted\"")
+      .Increment(7);
+  GetMetricGauge("test_json_gauge", "").Set(-1.5);
+
+  const std::string path = GetTempPath("colmap_metrics_%%%%-%%%%.json");
+  WriteMetricsJSON(path);
+  const std::string content = ReadFile(path);
+  boost::filesystem::remove(path);
+
+  BOOST_CHECK_EQUAL(content.find("{\"timestamp\":"), 0);
+  BOOST_CHECK_NE(content.find("\"test_json_counter_total\":{\"help\":"
+                              "\"Counter \\\"quoted\\\"\",\"type\":"
+                              "\"counter\",\"value\":7}"),
+                 std::string::npos);
+  BOOST_CHECK_NE(content.find("\"test_json_gauge\":{\"help\":\"\",\"type\":"
+                              "\"gauge\",\"value\":-1.5}"),
+                 std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(TestExportMetricsPeriodically) {
+  MetricCounter& counter =
+      GetMetricCounter("test_export_counter_total", "Counter");
+  counter.Reset();
+
+  const std::string path = GetTempPath("colmap_metrics_%%%%-%%%%.json");
+  ExportMetricsPeriodically(path, 0.01);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  BOOST_CHECK(boost::filesystem::exists(path));
+
+  // The final state is written when the export is stopped.
+  counter.Increment(42);
+  StopExportingMetrics();
+  BOOST_CHECK_NE(ReadFile(path).find("\"test_export_counter_total\":{\"help\":"
+                                     "\"Counter\",\"type\":\"counter\","
+                                     "\"value\":42}"),
+                 std::string::npos);
+  BOOST_CHECK(!boost::filesystem::exists(path + ".tmp"));
+  boost::filesystem::remove(path);
+}
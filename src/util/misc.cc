@@ -33,6 +33,11 @@
 
 #include <cstdarg>
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
 #include <boost/algorithm/string.hpp>
 
 namespace colmap {
@@ -207,6 +212,37 @@ size_t GetFileSize(const std::string& path) {
   return file.tellg();
 }
 
+size_t GetPeakMemoryUsage() {
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  // Reported in bytes on macOS.
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // Reported in kilobytes on Linux and BSD.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+size_t GetAvailableMemory() {
+#if !defined(_WIN32) && defined(_SC_AVPHYS_PAGES)
+  const long num_pages = sysconf(_SC_AVPHYS_PAGES);
+  const long page_size = sysconf(_SC_PAGESIZE);
+  if (num_pages < 0 || page_size < 0) {
+    return 0;
+  }
+  return static_cast<size_t>(num_pages) * static_cast<size_t>(page_size);
+#else
+  return 0;
+#endif
+}
+
 void PrintHeading1(const std::string& heading) {
   std::cout << std::endl << std::string(78, '=') << std::endl;
   std::cout << heading << std::endl;
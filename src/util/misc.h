@@ -102,6 +102,14 @@ std::vector<std::string> GetRecursiveDirList(const std::string& path);
 // Get the size in bytes of a file.
 size_t GetFileSize(const std::string& path);
 
+// Get the peak resident memory usage in bytes of the current process. Returns
+// zero, if the memory usage cannot be determined on the current platform.
+size_t GetPeakMemoryUsage();
+
+// Get the available physical memory in bytes. Returns zero, if the available
+// memory cannot be determined on the current platform.
+size_t GetAvailableMemory();
+
 // Print first-order heading with over- and underscores to `std::cout`.
 void PrintHeading1(const std::string& heading);
 
@@ -0,0 +1,513 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "util/octree_tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <unordered_set>
+
+#include <boost/filesystem.hpp>
+
+#include "util/endian.h"
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/string.h"
+#include "util/threading.h"
+
+namespace colmap {
+namespace {
+
+// Maximum number of levels of the octree below a chunk, which limits the
+// subdivision of many points at the same position.
+const int kMaxNumNodeLevels = 16;
+
+// Maximum absolute chunk key, which limits the number of levels above the
+// chunks for far away outliers.
+const int kMaxChunkKey = 1 << 20;
+
+int ComputeChildIdx(const PlyPoint& point,
+                    const std::array<double, 3>& center) {
+  return (point.x >= center[0] ? 1 : 0) | (point.y >= center[1] ? 2 : 0) |
+         (point.z >= center[2] ? 4 : 0);
+}
+
+// Keep the first point in every cell of a grid over the cube of a node.
+std::vector<PlyPoint> SubsamplePoints(const std::vector<PlyPoint>& points,
+                                      const std::array<double, 3>& min_bound,
+                                      const double size, const int grid_size) {
+  const double scale = grid_size / size;
+  const auto ComputeCell = [&](const float coord, const int axis) {
+    const int cell = static_cast<int>((coord - min_bound[axis]) * scale);
+    return static_cast<uint64_t>(std::min(std::max(cell, 0), grid_size - 1));
+  };
+
+  std::unordered_set<uint64_t> occupied_cells;
+  std::vector<PlyPoint> sampled_points;
+  for (const auto& point : points) {
+    const uint64_t cell =
+        (ComputeCell(point.x, 0) * grid_size + ComputeCell(point.y, 1)) *
+            grid_size +
+        ComputeCell(point.z, 2);
+    if (occupied_cells.insert(cell).second) {
+      sampled_points.push_back(point);
+    }
+  }
+
+  return sampled_points;
+}
+
+void WriteTilesetNode(const std::string& name, const double min_bound[3],
+                      const double size, const double geometric_error,
+                      std::ostream* stream) {
+  const double half_size = size / 2;
+  *stream << "{\"boundingVolume\":{\"box\":[" << min_bound[0] + half_size
+          << "," << min_bound[1] + half_size << "," << min_bound[2] + half_size
+          << "," << half_size << ",0,0,0," << half_size << ",0,0,0,"
+          << half_size << "]},\"geometricError\":" << geometric_error
+          << ",\"content\":{\"uri\":\"" << name << ".pnts\"}";
+}
+
+}  // namespace
+
+bool OctreeTilesOptions::Check() const {
+  CHECK_OPTION_GT(max_num_points_per_node, 0);
+  CHECK_OPTION_GT(lod_grid_size, 0);
+  CHECK_OPTION_GE(num_chunk_levels, 0);
+  CHECK_OPTION_LE(num_chunk_levels, 10);
+  CHECK_OPTION_GT(max_num_buffered_points, 0);
+  return true;
+}
+
+OctreeTilesWriter::OctreeTilesWriter(const OctreeTilesOptions& options,
+                                     const std::string& path)
+    : options_(options),
+      path_(path),
+      is_open_(true),
+      num_points_(0),
+      chunk_size_(0) {
+  CHECK(options_.Check());
+  CreateDirIfNotExists(path_);
+  buffer_.reserve(options_.max_num_buffered_points);
+}
+
+OctreeTilesWriter::~OctreeTilesWriter() { Close(); }
+
+void OctreeTilesWriter::Write(const PlyPoint& point) {
+  CHECK(is_open_) << path_;
+
+  if (!std::isfinite(point.x) || !std::isfinite(point.y) ||
+      !std::isfinite(point.z)) {
+    return;
+  }
+
+  buffer_.push_back(point);
+  num_points_ += 1;
+  if (buffer_.size() >= static_cast<size_t>(options_.max_num_buffered_points)) {
+    Flush();
+  }
+}
+
+size_t OctreeTilesWriter::NumPoints() const { return num_points_; }
+
+void OctreeTilesWriter::Flush() {
+  if (buffer_.empty()) {
+    return;
+  }
+
+  // The chunk grid is fixed by the first flushed points, such that the
+  // points can be distributed without knowing the extent of the point cloud.
+  if (chunk_size_ == 0) {
+    std::array<double, 3> max_bound;
+    for (int i = 0; i < 3; ++i) {
+      origin_[i] = std::numeric_limits<double>::max();
+      max_bound[i] = std::numeric_limits<double>::lowest();
+    }
+    for (const auto& point : buffer_) {
+      const double coords[3] = {point.x, point.y, point.z};
+      for (int i = 0; i < 3; ++i) {
+        origin_[i] = std::min(origin_[i], coords[i]);
+        max_bound[i] = std::max(max_bound[i], coords[i]);
+      }
+    }
+
+    double extent = 0;
+    for (int i = 0; i < 3; ++i) {
+      extent = std::max(extent, max_bound[i] - origin_[i]);
+    }
+    chunk_size_ = extent > 0 ? extent / (1 << options_.num_chunk_levels) : 1;
+  }
+
+  std::map<ChunkKey, std::vector<PlyPoint>> chunk_points;
+  for (const auto& point : buffer_) {
+    chunk_points[ComputeChunkKey(point)].push_back(point);
+  }
+  buffer_.clear();
+
+  for (const auto& points : chunk_points) {
+    Chunk& chunk = chunks_[points.first];
+    if (chunk.path.empty()) {
+      chunk.path = JoinPaths(
+          path_, StringPrintf("chunk%d.tmp", static_cast<int>(chunks_.size())));
+    }
+    std::ofstream file(chunk.path, std::ios::binary | std::ios::app);
+    CHECK(file.is_open()) << chunk.path;
+    file.write(reinterpret_cast<const char*>(points.second.data()),
+               points.second.size() * sizeof(PlyPoint));
+    CHECK(file.good()) << chunk.path;
+    chunk.num_points += points.second.size();
+  }
+}
+
+OctreeTilesWriter::ChunkKey OctreeTilesWriter::ComputeChunkKey(
+    const PlyPoint& point) const {
+  const double coords[3] = {point.x, point.y, point.z};
+  ChunkKey key;
+  for (int i = 0; i < 3; ++i) {
+    const double cell = std::floor((coords[i] - origin_[i]) / chunk_size_);
+    key[i] = static_cast<int>(
+        std::min<double>(std::max<double>(cell, -kMaxChunkKey), kMaxChunkKey));
+  }
+  return key;
+}
+
+void OctreeTilesWriter::Close() {
+  if (!is_open_) {
+    return;
+  }
+
+  is_open_ = false;
+
+  Flush();
+
+  if (chunks_.empty()) {
+    WriteTileset(Node());
+    return;
+  }
+
+  // The root is the smallest cube of chunks with a power of two size, which
+  // contains all chunks.
+  ChunkKey min_key = chunks_.begin()->first;
+  ChunkKey max_key = min_key;
+  for (const auto& chunk : chunks_) {
+    for (int i = 0; i < 3; ++i) {
+      min_key[i] = std::min(min_key[i], chunk.first[i]);
+      max_key[i] = std::max(max_key[i], chunk.first[i]);
+    }
+  }
+
+  int num_levels = 0;
+  for (int i = 0; i < 3; ++i) {
+    while ((1 << num_levels) <= max_key[i] - min_key[i]) {
+      num_levels += 1;
+    }
+  }
+
+  std::vector<std::set<ChunkKey>> level_keys(num_levels + 1);
+  std::map<ChunkKey, std::pair<Node, std::vector<PlyPoint>>> chunk_nodes;
+  std::vector<std::pair<const Chunk*, std::pair<Node, std::vector<PlyPoint>>*>>
+      chunk_tasks;
+  for (const auto& chunk : chunks_) {
+    ChunkKey key;
+    for (int i = 0; i < 3; ++i) {
+      key[i] = chunk.first[i] - min_key[i];
+    }
+
+    for (int level = 0; level <= num_levels; ++level) {
+      level_keys[level].insert(
+          ChunkKey{{key[0] >> level, key[1] >> level, key[2] >> level}});
+    }
+
+    auto& chunk_node = chunk_nodes[key];
+    Node& node = chunk_node.first;
+    node.name = "r";
+    for (int level = num_levels - 1; level >= 0; --level) {
+      node.name += std::to_string(((key[0] >> level) & 1) |
+                                  (((key[1] >> level) & 1) << 1) |
+                                  (((key[2] >> level) & 1) << 2));
+    }
+    for (int i = 0; i < 3; ++i) {
+      node.min_bound[i] = origin_[i] + chunk.first[i] * chunk_size_;
+    }
+    node.size = chunk_size_;
+
+    chunk_tasks.emplace_back(&chunk.second, &chunk_node);
+  }
+
+  // The chunks are independent and tiled in parallel, while the few nodes
+  // above the chunks are built from the roots of the chunks afterwards.
+  ThreadPool thread_pool(options_.num_threads);
+  for (const auto& chunk_task : chunk_tasks) {
+    thread_pool.AddTask([this, chunk_task]() {
+      const Chunk& chunk = *chunk_task.first;
+      std::vector<PlyPoint> points(chunk.num_points);
+      {
+        std::ifstream file(chunk.path, std::ios::binary);
+        CHECK(file.is_open()) << chunk.path;
+        file.read(reinterpret_cast<char*>(points.data()),
+                  points.size() * sizeof(PlyPoint));
+        CHECK(file.good()) << chunk.path;
+      }
+      boost::filesystem::remove(chunk.path);
+      auto& chunk_node = *chunk_task.second;
+      chunk_node.second = BuildNode(std::move(points), 0, &chunk_node.first);
+    });
+  }
+
+  thread_pool.Wait();
+
+  Node root;
+  root.name = "r";
+  for (int i = 0; i < 3; ++i) {
+    root.min_bound[i] = origin_[i] + min_key[i] * chunk_size_;
+  }
+  root.size = chunk_size_ * (1 << num_levels);
+  BuildTopNode(level_keys, ChunkKey{{0, 0, 0}}, num_levels, &chunk_nodes,
+               &root);
+
+  WriteTileset(root);
+}
+
+std::vector<PlyPoint> OctreeTilesWriter::BuildNode(std::vector<PlyPoint> points,
+                                                   const int level,
+                                                   Node* node) const {
+  if (points.size() <=
+          static_cast<size_t>(options_.max_num_points_per_node) ||
+      level >= kMaxNumNodeLevels) {
+    node->geometric_error = 0;
+    WriteTile(*node, points);
+    return points;
+  }
+
+  const double child_size = node->size / 2;
+  const std::array<double, 3> center = {{node->min_bound[0] + child_size,
+                                         node->min_bound[1] + child_size,
+                                         node->min_bound[2] + child_size}};
+
+  std::vector<std::vector<PlyPoint>> child_points(8);
+  for (const auto& point : points) {
+    child_points[ComputeChildIdx(point, center)].push_back(point);
+  }
+  points.clear();
+  points.shrink_to_fit();
+
+  std::vector<PlyPoint> children_points;
+  for (int child_idx = 0; child_idx < 8; ++child_idx) {
+    if (child_points[child_idx].empty()) {
+      continue;
+    }
+
+    Node child;
+    child.name = node->name + std::to_string(child_idx);
+    for (int i = 0; i < 3; ++i) {
+      child.min_bound[i] = ((child_idx >> i) & 1) ? center[i]
+                                                  : node->min_bound[i];
+    }
+    child.size = child_size;
+
+    const std::vector<PlyPoint> sampled_points =
+        BuildNode(std::move(child_points[child_idx]), level + 1, &child);
+    children_points.insert(children_points.end(), sampled_points.begin(),
+                           sampled_points.end());
+    node->children.push_back(std::move(child));
+  }
+
+  std::vector<PlyPoint> sampled_points = SubsamplePoints(
+      children_points, node->min_bound, node->size, options_.lod_grid_size);
+  node->geometric_error = node->size / options_.lod_grid_size;
+  WriteTile(*node, sampled_points);
+  return sampled_points;
+}
+
+std::vector<PlyPoint> OctreeTilesWriter::BuildTopNode(
+    const std::vector<std::set<ChunkKey>>& level_keys, const ChunkKey& key,
+    const int level,
+    std::map<ChunkKey, std::pair<Node, std::vector<PlyPoint>>>* chunk_nodes,
+    Node* node) const {
+  if (level == 0) {
+    auto& chunk_node = chunk_nodes->at(key);
+    *node = std::move(chunk_node.first);
+    return std::move(chunk_node.second);
+  }
+
+  const double child_size = node->size / 2;
+
+  std::vector<PlyPoint> children_points;
+  for (int child_idx = 0; child_idx < 8; ++child_idx) {
+    ChunkKey child_key;
+    for (int i = 0; i < 3; ++i) {
+      child_key[i] = 2 * key[i] + ((child_idx >> i) & 1);
+    }
+    if (level_keys[level - 1].count(child_key) == 0) {
+      continue;
+    }
+
+    Node child;
+    child.name = node->name + std::to_string(child_idx);
+    for (int i = 0; i < 3; ++i) {
+      child.min_bound[i] =
+          node->min_bound[i] + ((child_idx >> i) & 1) * child_size;
+    }
+    child.size = child_size;
+
+    const std::vector<PlyPoint> sampled_points = BuildTopNode(
+        level_keys, child_key, level - 1, chunk_nodes, &child);
+    children_points.insert(children_points.end(), sampled_points.begin(),
+                           sampled_points.end());
+    node->children.push_back(std::move(child));
+  }
+
+  std::vector<PlyPoint> sampled_points = SubsamplePoints(
+      children_points, node->min_bound, node->size, options_.lod_grid_size);
+  node->geometric_error = node->size / options_.lod_grid_size;
+  WriteTile(*node, sampled_points);
+  return sampled_points;
+}
+
+void OctreeTilesWriter::WriteTile(const Node& node,
+                                  const std::vector<PlyPoint>& points) const {
+  const std::string path = JoinPaths(path_, node.name + ".pnts");
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  // The positions are stored relative to the center of the node in single
+  // precision, followed by the normals and the colors.
+  const double half_size = node.size / 2;
+  const double center[3] = {node.min_bound[0] + half_size,
+                            node.min_bound[1] + half_size,
+                            node.min_bound[2] + half_size};
+
+  const size_t num_points = points.size();
+  std::ostringstream feature_table;
+  feature_table << std::setprecision(17) << "{\"POINTS_LENGTH\":" << num_points
+                << ",\"RTC_CENTER\":[" << center[0] << "," << center[1] << ","
+                << center[2] << "],\"POSITION\":{\"byteOffset\":0}";
+  size_t binary_size = 12 * num_points;
+  if (options_.write_normal) {
+    feature_table << ",\"NORMAL\":{\"byteOffset\":" << binary_size << "}";
+    binary_size += 12 * num_points;
+  }
+  feature_table << ",\"RGB\":{\"byteOffset\":" << binary_size << "}}";
+  binary_size += 3 * num_points;
+
+  // The feature table and its binary body must be aligned to 8 bytes.
+  const size_t kHeaderSize = 28;
+  std::string feature_table_json = feature_table.str();
+  while ((kHeaderSize + feature_table_json.size()) % 8 != 0) {
+    feature_table_json += ' ';
+  }
+  const size_t binary_padding = (8 - binary_size % 8) % 8;
+
+  file.write("pnts", 4);
+  WriteBinaryLittleEndian<uint32_t>(&file, 1);
+  WriteBinaryLittleEndian<uint32_t>(
+      &file, static_cast<uint32_t>(kHeaderSize + feature_table_json.size() +
+                                   binary_size + binary_padding));
+  WriteBinaryLittleEndian<uint32_t>(
+      &file, static_cast<uint32_t>(feature_table_json.size()));
+  WriteBinaryLittleEndian<uint32_t>(
+      &file, static_cast<uint32_t>(binary_size + binary_padding));
+  WriteBinaryLittleEndian<uint32_t>(&file, 0);
+  WriteBinaryLittleEndian<uint32_t>(&file, 0);
+  file.write(feature_table_json.data(), feature_table_json.size());
+
+  for (const auto& point : points) {
+    WriteBinaryLittleEndian<float>(&file, point.x - center[0]);
+    WriteBinaryLittleEndian<float>(&file, point.y - center[1]);
+    WriteBinaryLittleEndian<float>(&file, point.z - center[2]);
+  }
+  if (options_.write_normal) {
+    for (const auto& point : points) {
+      WriteBinaryLittleEndian<float>(&file, point.nx);
+      WriteBinaryLittleEndian<float>(&file, point.ny);
+      WriteBinaryLittleEndian<float>(&file, point.nz);
+    }
+  }
+  for (const auto& point : points) {
+    WriteBinaryLittleEndian<uint8_t>(&file, point.r);
+    WriteBinaryLittleEndian<uint8_t>(&file, point.g);
+    WriteBinaryLittleEndian<uint8_t>(&file, point.b);
+  }
+  for (size_t i = 0; i < binary_padding; ++i) {
+    WriteBinaryLittleEndian<uint8_t>(&file, 0);
+  }
+
+  CHECK(file.good()) << path;
+}
+
+void OctreeTilesWriter::WriteTileset(const Node& root) const {
+  const std::string path = JoinPaths(path_, "tileset.json");
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  file << std::setprecision(17);
+  file << "{\"asset\":{\"version\":\"1.0\",\"generator\":\"COLMAP\"},"
+       << "\"geometricError\":" << root.size << ",\"root\":";
+
+  if (root.name.empty()) {
+    file << "{\"boundingVolume\":{\"box\":[0,0,0,0,0,0,0,0,0,0,0,0]},"
+         << "\"geometricError\":0,\"refine\":\"REPLACE\"}}" << std::endl;
+    return;
+  }
+
+  // Write the nodes in depth-first order without recursion, since the octree
+  // of a dense point cloud can be deep.
+  std::vector<std::pair<const Node*, size_t>> stack;
+  stack.emplace_back(&root, 0);
+  WriteTilesetNode(root.name, root.min_bound.data(), root.size,
+                   root.geometric_error, &file);
+  file << ",\"refine\":\"REPLACE\"";
+  while (!stack.empty()) {
+    const Node* node = stack.back().first;
+    const size_t child_idx = stack.back().second;
+    if (child_idx == node->children.size()) {
+      if (!node->children.empty()) {
+        file << "]";
+      }
+      file << "}";
+      stack.pop_back();
+      continue;
+    }
+
+    file << (child_idx == 0 ? ",\"children\":[" : ",");
+    const Node& child = node->children[child_idx];
+    WriteTilesetNode(child.name, child.min_bound.data(), child.size,
+                     child.geometric_error, &file);
+    stack.back().second += 1;
+    stack.emplace_back(&child, 0);
+  }
+  file << "}" << std::endl;
+}
+
+}  // namespace colmap
@@ -0,0 +1,143 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef COLMAP_SRC_UTIL_OCTREE_TILES_H_
+#define COLMAP_SRC_UTIL_OCTREE_TILES_H_
+
+#include <array>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "util/ply.h"
+
+namespace colmap {
+
+struct OctreeTilesOptions {
+  // Maximum number of points in a leaf node, before it is subdivided.
+  int max_num_points_per_node = 20000;
+
+  // Number of cells per axis of the grid in which the points of an inner node
+  // are subsampled from its children as its level of detail.
+  int lod_grid_size = 64;
+
+  // The points are first distributed into the chunks of a uniform grid, whose
+  // cell size is the extent of the first buffered points divided by two to
+  // the power of this number. The chunks are then tiled in parallel.
+  int num_chunk_levels = 4;
+
+  // Maximum number of points that are buffered in memory before they are
+  // appended to the chunk files on disk.
+  int max_num_buffered_points = 1 << 20;
+
+  // Whether to write the normals of the points.
+  bool write_normal = true;
+
+  // The number of threads used to tile the chunks.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// Write a point cloud incrementally as a hierarchy of tiles in the 3D Tiles
+// format, such that viewers can stream the point cloud with increasing level
+// of detail. The output directory contains the tileset in "tileset.json" and
+// one point cloud tile "r<child indices>.pnts" per octree node. Leaf nodes
+// contain all of their points and inner nodes contain a subsample of the
+// points of their children, which they replace when refined.
+//
+// The points are streamed in a single pass into chunk files on disk, so that
+// the point cloud does not need to be kept in memory. When the writer is
+// closed, the octrees of the chunks are built in parallel and the chunk files
+// are removed. Each chunk must fit into memory.
+class OctreeTilesWriter {
+ public:
+  OctreeTilesWriter(const OctreeTilesOptions& options, const std::string& path);
+  ~OctreeTilesWriter();
+
+  void Write(const PlyPoint& point);
+
+  size_t NumPoints() const;
+
+  // Build the octree and write the tiles and the tileset.
+  void Close();
+
+ private:
+  typedef std::array<int, 3> ChunkKey;
+
+  struct Node {
+    std::string name;
+    std::array<double, 3> min_bound;
+    double size = 0;
+    double geometric_error = 0;
+    std::vector<Node> children;
+  };
+
+  struct Chunk {
+    std::string path;
+    size_t num_points = 0;
+  };
+
+  // Append the buffered points to the files of their chunks.
+  void Flush();
+
+  ChunkKey ComputeChunkKey(const PlyPoint& point) const;
+
+  // Recursively subdivide the points of a node and write its tile. Returns
+  // the points of its tile, from which its parent is subsampled.
+  std::vector<PlyPoint> BuildNode(std::vector<PlyPoint> points, int level,
+                                  Node* node) const;
+
+  // Recursively build the nodes above the chunks, where the nodes of a level
+  // are identified by their chunk keys relative to the root shifted by the
+  // level. The nodes at level zero are the already built roots of the chunks.
+  std::vector<PlyPoint> BuildTopNode(
+      const std::vector<std::set<ChunkKey>>& level_keys, const ChunkKey& key,
+      int level,
+      std::map<ChunkKey, std::pair<Node, std::vector<PlyPoint>>>* chunk_nodes,
+      Node* node) const;
+
+  void WriteTile(const Node& node, const std::vector<PlyPoint>& points) const;
+  void WriteTileset(const Node& root) const;
+
+  const OctreeTilesOptions options_;
+  const std::string path_;
+  bool is_open_;
+  size_t num_points_;
+  std::vector<PlyPoint> buffer_;
+  std::array<double, 3> origin_;
+  double chunk_size_;
+  std::map<ChunkKey, Chunk> chunks_;
+};
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_OCTREE_TILES_H_
@@ -0,0 +1,179 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "util/octree_tiles"
+#include "util/testing.h"
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include "util/misc.h"
+#include "util/octree_tiles.h"
+#include "util/random.h"
+
+using namespace colmap;
+
+namespace {
+
+std::string CreateTestDir() {
+  return (boost::filesystem::temp_directory_path() /
+          boost::filesystem::unique_path("colmap_octree_tiles_%%%%-%%%%"))
+      .string();
+}
+
+// Read the number of points and the first position of a point cloud tile.
+size_t ReadTile(const std::string& path, Eigen::Vector3d* first_point) {
+  std::ifstream file(path, std::ios::binary);
+  BOOST_CHECK(file.is_open());
+
+  char magic[4];
+  file.read(magic, 4);
+  BOOST_CHECK_EQUAL(std::string(magic, 4), "pnts");
+  uint32_t header[6];
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  BOOST_CHECK_EQUAL(header[0], 1);
+  BOOST_CHECK_EQUAL(header[1], GetFileSize(path));
+  BOOST_CHECK_EQUAL((28 + header[2]) % 8, 0);
+  BOOST_CHECK_EQUAL(header[3] % 8, 0);
+
+  std::string json(header[2], ' ');
+  file.read(&json[0], json.size());
+  const size_t num_points =
+      std::stoul(json.substr(json.find("\"POINTS_LENGTH\":") + 16));
+  if (num_points > 0 && first_point != nullptr) {
+    float position[3];
+    file.read(reinterpret_cast<char*>(position), sizeof(position));
+    size_t pos = json.find("\"RTC_CENTER\":[") + 14;
+    for (int i = 0; i < 3; ++i) {
+      size_t num_chars = 0;
+      (*first_point)(i) = std::stod(json.substr(pos), &num_chars) + position[i];
+      pos += num_chars + 1;
+    }
+  }
+
+  return num_points;
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  const std::string path = CreateTestDir();
+  {
+    OctreeTilesWriter writer(OctreeTilesOptions(), path);
+    BOOST_CHECK_EQUAL(writer.NumPoints(), 0);
+  }
+  BOOST_CHECK(ExistsFile(JoinPaths(path, "tileset.json")));
+  BOOST_CHECK_EQUAL(GetFileList(path).size(), 1);
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestSinglePoint) {
+  const std::string path = CreateTestDir();
+  PlyPoint point;
+  point.x = 1000.25f;
+  point.y = -2.5f;
+  point.z = 3.0f;
+  {
+    OctreeTilesWriter writer(OctreeTilesOptions(), path);
+    writer.Write(point);
+    BOOST_CHECK_EQUAL(writer.NumPoints(), 1);
+  }
+  BOOST_CHECK_EQUAL(GetFileList(path).size(), 2);
+  Eigen::Vector3d first_point;
+  BOOST_CHECK_EQUAL(ReadTile(JoinPaths(path, "r.pnts"), &first_point), 1);
+  BOOST_CHECK_CLOSE(first_point(0), point.x, 1e-6);
+  BOOST_CHECK_CLOSE(first_point(1), point.y, 1e-6);
+  BOOST_CHECK_CLOSE(first_point(2), point.z, 1e-6);
+  boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestHierarchy) {
+  SetPRNGSeed(0);
+
+  OctreeTilesOptions options;
+  options.max_num_points_per_node = 500;
+  options.lod_grid_size = 8;
+  options.num_chunk_levels = 2;
+  options.max_num_buffered_points = 1000;
+
+  const std::string path = CreateTestDir();
+  const size_t kNumPoints = 10000;
+  {
+    OctreeTilesWriter writer(options, path);
+    for (size_t i = 0; i < kNumPoints; ++i) {
+      PlyPoint point;
+      point.x = RandomReal(-10.0f, 10.0f);
+      point.y = RandomReal(-10.0f, 10.0f);
+      // The later points exceed the extent of the first buffered points.
+      point.z = RandomReal(0.0f, i < 1000 ? 1.0f : 5.0f);
+      writer.Write(point);
+    }
+    BOOST_CHECK_EQUAL(writer.NumPoints(), kNumPoints);
+  }
+
+  std::vector<std::string> names;
+  for (const auto& file_path : GetFileList(path)) {
+    const std::string file_name = GetPathBaseName(file_path);
+    if (file_name != "tileset.json") {
+      BOOST_CHECK(HasFileExtension(file_name, ".pnts"));
+      names.push_back(file_name.substr(0, file_name.size() - 5));
+    }
+  }
+
+  const std::string tileset = ReadTextFileLines(
+      JoinPaths(path, "tileset.json")).front();
+  BOOST_CHECK_NE(tileset.find("\"refine\":\"REPLACE\""), std::string::npos);
+
+  // The leaf nodes contain all points and the inner nodes their subsample.
+  size_t num_leaf_points = 0;
+  for (const auto& name : names) {
+    BOOST_CHECK_NE(tileset.find("\"" + name + ".pnts\""), std::string::npos);
+    const size_t num_points =
+        ReadTile(JoinPaths(path, name + ".pnts"), nullptr);
+    BOOST_CHECK_GT(num_points, 0);
+    const bool is_leaf =
+        std::none_of(names.begin(), names.end(), [&](const std::string& other) {
+          return other.size() == name.size() + 1 &&
+                 other.compare(0, name.size(), name) == 0;
+        });
+    if (is_leaf) {
+      BOOST_CHECK_LE(num_points, options.max_num_points_per_node);
+      num_leaf_points += num_points;
+    } else {
+      BOOST_CHECK_LE(num_points, 8 * 8 * 8);
+    }
+  }
+
+  BOOST_CHECK_EQUAL(num_leaf_points, kNumPoints);
+  BOOST_CHECK(ExistsFile(JoinPaths(path, "r.pnts")));
+
+  boost::filesystem::remove_all(path);
+}
@@ -44,8 +44,11 @@
 #include "mvs/patch_match.h"
 #include "optim/bundle_adjustment.h"
 #include "ui/render_options.h"
+#include "util/metrics.h"
 #include "util/misc.h"
 #include "util/random.h"
+#include "util/threading.h"
+#include "util/trace.h"
 #include "util/version.h"
 
 namespace config = boost::program_options;
@@ -56,6 +59,11 @@ OptionManager::OptionManager(bool add_project_options) {
   project_path.reset(new std::string());
   database_path.reset(new std::string());
   image_path.reset(new std::string());
+  trace_path.reset(new std::string());
+  metrics_path.reset(new std::string());
+  metrics_interval.reset(new double(10));
+  memory_budget.reset(new double(-1));
+  numa_thread_pinning.reset(new bool(false));
 
   image_reader.reset(new ImageReaderOptions());
   sift_extraction.reset(new SiftExtractionOptions());
@@ -197,6 +205,12 @@ void OptionManager::AddLogOptions() {
 
   AddAndRegisterDefaultOption("log_to_stderr", &FLAGS_logtostderr);
   AddAndRegisterDefaultOption("log_level", &FLAGS_v);
+  AddAndRegisterDefaultOption("trace_path", trace_path.get());
+  AddAndRegisterDefaultOption("metrics_path", metrics_path.get());
+  AddAndRegisterDefaultOption("metrics_interval", metrics_interval.get());
+  AddAndRegisterDefaultOption("memory_budget", memory_budget.get());
+  AddAndRegisterDefaultOption("numa_thread_pinning",
+                              numa_thread_pinning.get());
 }
 
 void OptionManager::AddRandomOptions() {
@@ -248,6 +262,8 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   AddAndRegisterDefaultOption("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  AddAndRegisterDefaultOption("ImageReader.num_prefetch_images",
+                              &image_reader->num_prefetch_images);
 
   AddAndRegisterDefaultOption("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
@@ -255,6 +271,10 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->use_gpu);
   AddAndRegisterDefaultOption("SiftExtraction.gpu_index",
                               &sift_extraction->gpu_index);
+  AddAndRegisterDefaultOption("SiftExtraction.max_writer_batch_size",
+                              &sift_extraction->max_writer_batch_size);
+  AddAndRegisterDefaultOption("SiftExtraction.max_writer_batch_delay_ms",
+                              &sift_extraction->max_writer_batch_delay_ms);
   AddAndRegisterDefaultOption("SiftExtraction.max_image_size",
                               &sift_extraction->max_image_size);
   AddAndRegisterDefaultOption("SiftExtraction.max_num_features",
@@ -283,6 +303,14 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->dsp_max_scale);
   AddAndRegisterDefaultOption("SiftExtraction.dsp_num_scales",
                               &sift_extraction->dsp_num_scales);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_size",
+                              &sift_extraction->tile_size);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_overlap",
+                              &sift_extraction->tile_overlap);
+  AddAndRegisterDefaultOption("SiftExtraction.gpu_batch_size",
+                              &sift_extraction->gpu_batch_size);
+  AddAndRegisterDefaultOption("SiftExtraction.feature_cache_path",
+                              &sift_extraction->feature_cache_path);
 }
 
 void OptionManager::AddMatchingOptions() {
@@ -318,6 +346,18 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->multiple_models);
   AddAndRegisterDefaultOption("SiftMatching.guided_matching",
                               &sift_matching->guided_matching);
+  AddAndRegisterDefaultOption("SiftMatching.early_exit_verification",
+                              &sift_matching->early_exit_verification);
+  AddAndRegisterDefaultOption("SiftMatching.progressive_sampling",
+                              &sift_matching->progressive_sampling);
+  AddAndRegisterDefaultOption("SiftMatching.compress_matches",
+                              &sift_matching->compress_matches);
+  AddAndRegisterDefaultOption("SiftMatching.cpu_cache_indices",
+                              &sift_matching->cpu_cache_indices);
+  AddAndRegisterDefaultOption("SiftMatching.binary_matching",
+                              &sift_matching->binary_matching);
+  AddAndRegisterDefaultOption("SiftMatching.feature_store_path",
+                              &sift_matching->feature_store_path);
 }
 
 void OptionManager::AddExhaustiveMatchingOptions() {
@@ -330,6 +370,19 @@ void OptionManager::AddExhaustiveMatchingOptions() {
 
   AddAndRegisterDefaultOption("ExhaustiveMatching.block_size",
                               &exhaustive_matching->block_size);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.rig_config_path",
+                              &exhaustive_matching->rig_config_path);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.rig_max_rotation",
+                              &exhaustive_matching->rig_max_rotation);
+  AddAndRegisterDefaultOption(
+      "ExhaustiveMatching.rig_skip_intra_snapshot_pairs",
+      &exhaustive_matching->rig_skip_intra_snapshot_pairs);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.new_image_list_path",
+                              &exhaustive_matching->new_image_list_path);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.new_vs_new",
+                              &exhaustive_matching->new_vs_new);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.skip_image_list_path",
+                              &exhaustive_matching->skip_image_list_path);
 }
 
 void OptionManager::AddSequentialMatchingOptions() {
@@ -348,6 +401,9 @@ void OptionManager::AddSequentialMatchingOptions() {
                               &sequential_matching->loop_detection);
   AddAndRegisterDefaultOption("SequentialMatching.loop_detection_period",
                               &sequential_matching->loop_detection_period);
+  AddAndRegisterDefaultOption(
+      "SequentialMatching.loop_detection_keyframe_overlap",
+      &sequential_matching->loop_detection_keyframe_overlap);
   AddAndRegisterDefaultOption("SequentialMatching.loop_detection_num_images",
                               &sequential_matching->loop_detection_num_images);
   AddAndRegisterDefaultOption(
@@ -363,6 +419,15 @@ void OptionManager::AddSequentialMatchingOptions() {
       &sequential_matching->loop_detection_max_num_features);
   AddAndRegisterDefaultOption("SequentialMatching.vocab_tree_path",
                               &sequential_matching->vocab_tree_path);
+  AddAndRegisterDefaultOption("SequentialMatching.rig_config_path",
+                              &sequential_matching->rig_config_path);
+  AddAndRegisterDefaultOption("SequentialMatching.rig_max_rotation",
+                              &sequential_matching->rig_max_rotation);
+  AddAndRegisterDefaultOption(
+      "SequentialMatching.rig_skip_intra_snapshot_pairs",
+      &sequential_matching->rig_skip_intra_snapshot_pairs);
+  AddAndRegisterDefaultOption("SequentialMatching.skip_image_list_path",
+                              &sequential_matching->skip_image_list_path);
 }
 
 void OptionManager::AddVocabTreeMatchingOptions() {
@@ -382,12 +447,28 @@ void OptionManager::AddVocabTreeMatchingOptions() {
   AddAndRegisterDefaultOption(
       "VocabTreeMatching.num_images_after_verification",
       &vocab_tree_matching->num_images_after_verification);
+  AddAndRegisterDefaultOption("VocabTreeMatching.max_verification_time",
+                              &vocab_tree_matching->max_verification_time);
+  AddAndRegisterDefaultOption("VocabTreeMatching.max_inverted_file_size",
+                              &vocab_tree_matching->max_inverted_file_size);
+  AddAndRegisterDefaultOption("VocabTreeMatching.max_num_scored_entries",
+                              &vocab_tree_matching->max_num_scored_entries);
   AddAndRegisterDefaultOption("VocabTreeMatching.max_num_features",
                               &vocab_tree_matching->max_num_features);
+  AddAndRegisterDefaultOption("VocabTreeMatching.exhaustive_quantization",
+                              &vocab_tree_matching->exhaustive_quantization);
+  AddAndRegisterDefaultOption("VocabTreeMatching.use_global_descriptors",
+                              &vocab_tree_matching->use_global_descriptors);
   AddAndRegisterDefaultOption("VocabTreeMatching.vocab_tree_path",
                               &vocab_tree_matching->vocab_tree_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.vocab_tree_index_path",
+                              &vocab_tree_matching->vocab_tree_index_path);
   AddAndRegisterDefaultOption("VocabTreeMatching.match_list_path",
                               &vocab_tree_matching->match_list_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.new_image_list_path",
+                              &vocab_tree_matching->new_image_list_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.new_vs_new",
+                              &vocab_tree_matching->new_vs_new);
 }
 
 void OptionManager::AddSpatialMatchingOptions() {
@@ -402,10 +483,16 @@ void OptionManager::AddSpatialMatchingOptions() {
                               &spatial_matching->is_gps);
   AddAndRegisterDefaultOption("SpatialMatching.ignore_z",
                               &spatial_matching->ignore_z);
+  AddAndRegisterDefaultOption("SpatialMatching.use_enu",
+                              &spatial_matching->use_enu);
   AddAndRegisterDefaultOption("SpatialMatching.max_num_neighbors",
                               &spatial_matching->max_num_neighbors);
   AddAndRegisterDefaultOption("SpatialMatching.max_distance",
                               &spatial_matching->max_distance);
+  AddAndRegisterDefaultOption("SpatialMatching.new_image_list_path",
+                              &spatial_matching->new_image_list_path);
+  AddAndRegisterDefaultOption("SpatialMatching.new_vs_new",
+                              &spatial_matching->new_vs_new);
 }
 
 void OptionManager::AddTransitiveMatchingOptions() {
@@ -420,6 +507,8 @@ void OptionManager::AddTransitiveMatchingOptions() {
                               &transitive_matching->batch_size);
   AddAndRegisterDefaultOption("TransitiveMatching.num_iterations",
                               &transitive_matching->num_iterations);
+  AddAndRegisterDefaultOption("TransitiveMatching.max_num_candidates",
+                              &transitive_matching->max_num_candidates);
 }
 
 void OptionManager::AddImagePairsMatchingOptions() {
@@ -463,6 +552,10 @@ void OptionManager::AddBundleAdjustmentOptions() {
                               &bundle_adjustment->refine_extra_params);
   AddAndRegisterDefaultOption("BundleAdjustment.refine_extrinsics",
                               &bundle_adjustment->refine_extrinsics);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_gpu",
+                              &bundle_adjustment->use_gpu);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_mixed_precision",
+                              &bundle_adjustment->use_mixed_precision);
 }
 
 void OptionManager::AddMapperOptions() {
@@ -480,6 +573,10 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption("Mapper.max_num_models", &mapper->max_num_models);
   AddAndRegisterDefaultOption("Mapper.max_model_overlap",
                               &mapper->max_model_overlap);
+  AddAndRegisterDefaultOption("Mapper.num_parallel_models",
+                              &mapper->num_parallel_models);
+  AddAndRegisterDefaultOption("Mapper.num_speculative_images",
+                              &mapper->num_speculative_images);
   AddAndRegisterDefaultOption("Mapper.min_model_size", &mapper->min_model_size);
   AddAndRegisterDefaultOption("Mapper.init_image_id1", &mapper->init_image_id1);
   AddAndRegisterDefaultOption("Mapper.init_image_id2", &mapper->init_image_id2);
@@ -502,14 +599,28 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption(
       "Mapper.ba_min_num_residuals_for_multi_threading",
       &mapper->ba_min_num_residuals_for_multi_threading);
+  AddAndRegisterDefaultOption("Mapper.ba_prior_position_std",
+                              &mapper->ba_prior_position_std);
   AddAndRegisterDefaultOption("Mapper.ba_local_num_images",
                               &mapper->ba_local_num_images);
   AddAndRegisterDefaultOption("Mapper.ba_local_max_num_iterations",
                               &mapper->ba_local_max_num_iterations);
+  AddAndRegisterDefaultOption("Mapper.ba_local_reuse_problem",
+                              &mapper->ba_local_reuse_problem);
   AddAndRegisterDefaultOption("Mapper.ba_global_use_pba",
                               &mapper->ba_global_use_pba);
   AddAndRegisterDefaultOption("Mapper.ba_global_pba_gpu_index",
                               &mapper->ba_global_pba_gpu_index);
+  AddAndRegisterDefaultOption("Mapper.ba_global_pba_min_num_observations",
+                              &mapper->ba_global_pba_min_num_observations);
+  AddAndRegisterDefaultOption("Mapper.ba_global_partition_max_num_images",
+                              &mapper->ba_global_partition_max_num_images);
+  AddAndRegisterDefaultOption("Mapper.ba_global_partition_image_overlap",
+                              &mapper->ba_global_partition_image_overlap);
+  AddAndRegisterDefaultOption("Mapper.ba_global_max_num_points_per_image",
+                              &mapper->ba_global_max_num_points_per_image);
+  AddAndRegisterDefaultOption("Mapper.ba_global_reuse_problem",
+                              &mapper->ba_global_reuse_problem);
   AddAndRegisterDefaultOption("Mapper.ba_global_images_ratio",
                               &mapper->ba_global_images_ratio);
   AddAndRegisterDefaultOption("Mapper.ba_global_points_ratio",
@@ -518,6 +629,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_global_images_freq);
   AddAndRegisterDefaultOption("Mapper.ba_global_points_freq",
                               &mapper->ba_global_points_freq);
+  AddAndRegisterDefaultOption("Mapper.ba_global_prior_freq_factor",
+                              &mapper->ba_global_prior_freq_factor);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_num_iterations",
                               &mapper->ba_global_max_num_iterations);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_refinements",
@@ -531,6 +644,12 @@ void OptionManager::AddMapperOptions() {
   AddAndRegisterDefaultOption("Mapper.snapshot_path", &mapper->snapshot_path);
   AddAndRegisterDefaultOption("Mapper.snapshot_images_freq",
                               &mapper->snapshot_images_freq);
+  AddAndRegisterDefaultOption("Mapper.snapshot_journal",
+                              &mapper->snapshot_journal);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_path",
+                              &mapper->checkpoint_path);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_images_freq",
+                              &mapper->checkpoint_images_freq);
   AddAndRegisterDefaultOption("Mapper.fix_existing_images",
                               &mapper->fix_existing_images);
 
@@ -545,12 +664,18 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.init_min_tri_angle);
   AddAndRegisterDefaultOption("Mapper.init_max_reg_trials",
                               &mapper->mapper.init_max_reg_trials);
+  AddAndRegisterDefaultOption("Mapper.init_num_candidate_pairs",
+                              &mapper->mapper.init_num_candidate_pairs);
+  AddAndRegisterDefaultOption("Mapper.init_reuse_two_view_geometry",
+                              &mapper->mapper.init_reuse_two_view_geometry);
   AddAndRegisterDefaultOption("Mapper.abs_pose_max_error",
                               &mapper->mapper.abs_pose_max_error);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_num_inliers",
                               &mapper->mapper.abs_pose_min_num_inliers);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_inlier_ratio",
                               &mapper->mapper.abs_pose_min_inlier_ratio);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_progressive_sampling",
+                              &mapper->mapper.abs_pose_progressive_sampling);
   AddAndRegisterDefaultOption("Mapper.filter_max_reproj_error",
                               &mapper->mapper.filter_max_reproj_error);
   AddAndRegisterDefaultOption("Mapper.filter_min_tri_angle",
@@ -559,6 +684,14 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.max_reg_trials);
   AddAndRegisterDefaultOption("Mapper.local_ba_min_tri_angle",
                               &mapper->mapper.local_ba_min_tri_angle);
+  AddAndRegisterDefaultOption("Mapper.use_prior_position",
+                              &mapper->mapper.use_prior_position);
+  AddAndRegisterDefaultOption("Mapper.prior_position_is_gps",
+                              &mapper->mapper.prior_position_is_gps);
+  AddAndRegisterDefaultOption("Mapper.prior_position_min_num_images",
+                              &mapper->mapper.prior_position_min_num_images);
+  AddAndRegisterDefaultOption("Mapper.prior_position_max_error",
+                              &mapper->mapper.prior_position_max_error);
 
   // IncrementalTriangulator.
   AddAndRegisterDefaultOption("Mapper.tri_max_transitivity",
@@ -595,6 +728,14 @@ void OptionManager::AddPatchMatchStereoOptions() {
                               &patch_match_stereo->max_image_size);
   AddAndRegisterDefaultOption("PatchMatchStereo.gpu_index",
                               &patch_match_stereo->gpu_index);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_problems_per_gpu",
+                              &patch_match_stereo->num_problems_per_gpu);
+  AddAndRegisterDefaultOption("PatchMatchStereo.tile_size",
+                              &patch_match_stereo->tile_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.tile_overlap",
+                              &patch_match_stereo->tile_overlap);
+  AddAndRegisterDefaultOption("PatchMatchStereo.half_precision",
+                              &patch_match_stereo->half_precision);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_min",
                               &patch_match_stereo->depth_min);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_max",
@@ -617,6 +758,10 @@ void OptionManager::AddPatchMatchStereoOptions() {
                               &patch_match_stereo->incident_angle_sigma);
   AddAndRegisterDefaultOption("PatchMatchStereo.num_iterations",
                               &patch_match_stereo->num_iterations);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_pyramid_levels",
+                              &patch_match_stereo->num_pyramid_levels);
+  AddAndRegisterDefaultOption("PatchMatchStereo.pyramid_num_iterations",
+                              &patch_match_stereo->pyramid_num_iterations);
   AddAndRegisterDefaultOption("PatchMatchStereo.geom_consistency",
                               &patch_match_stereo->geom_consistency);
   AddAndRegisterDefaultOption(
@@ -624,6 +769,8 @@ void OptionManager::AddPatchMatchStereoOptions() {
       &patch_match_stereo->geom_consistency_regularizer);
   AddAndRegisterDefaultOption("PatchMatchStereo.geom_consistency_max_cost",
                               &patch_match_stereo->geom_consistency_max_cost);
+  AddAndRegisterDefaultOption("PatchMatchStereo.interleave_passes",
+                              &patch_match_stereo->interleave_passes);
   AddAndRegisterDefaultOption("PatchMatchStereo.filter",
                               &patch_match_stereo->filter);
   AddAndRegisterDefaultOption("PatchMatchStereo.filter_min_ncc",
@@ -638,8 +785,18 @@ void OptionManager::AddPatchMatchStereoOptions() {
       &patch_match_stereo->filter_geom_consistency_max_cost);
   AddAndRegisterDefaultOption("PatchMatchStereo.cache_size",
                               &patch_match_stereo->cache_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_prefetch_problems",
+                              &patch_match_stereo->num_prefetch_problems);
   AddAndRegisterDefaultOption("PatchMatchStereo.write_consistency_graph",
                               &patch_match_stereo->write_consistency_graph);
+  AddAndRegisterDefaultOption("PatchMatchStereo.write_compressed_maps",
+                              &patch_match_stereo->write_compressed_maps);
+  AddAndRegisterDefaultOption("PatchMatchStereo.write_half_precision_maps",
+                              &patch_match_stereo->write_half_precision_maps);
+  AddAndRegisterDefaultOption("PatchMatchStereo.distributed",
+                              &patch_match_stereo->distributed);
+  AddAndRegisterDefaultOption("PatchMatchStereo.distributed_claim_timeout",
+                              &patch_match_stereo->distributed_claim_timeout);
 }
 
 void OptionManager::AddStereoFusionOptions() {
@@ -666,6 +823,13 @@ void OptionManager::AddStereoFusionOptions() {
                               &stereo_fusion->check_num_images);
   AddAndRegisterDefaultOption("StereoFusion.cache_size",
                               &stereo_fusion->cache_size);
+  AddAndRegisterDefaultOption("StereoFusion.num_threads",
+                              &stereo_fusion->num_threads);
+  AddAndRegisterDefaultOption("StereoFusion.use_gpu", &stereo_fusion->use_gpu);
+  AddAndRegisterDefaultOption("StereoFusion.gpu_index",
+                              &stereo_fusion->gpu_index);
+  AddAndRegisterDefaultOption("StereoFusion.gpu_cache_size",
+                              &stereo_fusion->gpu_cache_size);
 }
 
 void OptionManager::AddPoissonMeshingOptions() {
@@ -681,6 +845,10 @@ void OptionManager::AddPoissonMeshingOptions() {
   AddAndRegisterDefaultOption("PoissonMeshing.trim", &poisson_meshing->trim);
   AddAndRegisterDefaultOption("PoissonMeshing.num_threads",
                               &poisson_meshing->num_threads);
+  AddAndRegisterDefaultOption("PoissonMeshing.max_tile_points",
+                              &poisson_meshing->max_tile_points);
+  AddAndRegisterDefaultOption("PoissonMeshing.tile_overlap",
+                              &poisson_meshing->tile_overlap);
 }
 
 void OptionManager::AddDelaunayMeshingOptions() {
@@ -762,7 +930,12 @@ void OptionManager::ResetOptions(const bool reset_paths) {
     *project_path = "";
     *database_path = "";
     *image_path = "";
+    *trace_path = "";
+    *metrics_path = "";
   }
+  *metrics_interval = 10;
+  *memory_budget = -1;
+  *numa_thread_pinning = false;
   *image_reader = ImageReaderOptions();
   *sift_extraction = SiftExtractionOptions();
   *sift_matching = SiftMatchingOptions();
@@ -818,6 +991,70 @@ bool OptionManager::Check() {
   return success;
 }
 
+void OptionManager::ApplyMemoryBudget() {
+  const double kGigaBytes = 1024.0 * 1024.0 * 1024.0;
+
+  double budget = *memory_budget;
+  if (budget == 0) {
+    budget = GetAvailableMemory() / kGigaBytes;
+  }
+
+  if (budget <= 0) {
+    return;
+  }
+
+  const double cache_budget = 0.5 * budget;
+
+  std::cout << StringPrintf("Memory budget: %.2f GB", budget) << std::endl;
+
+  if (added_exhaustive_match_options_) {
+    // The feature matcher caches the keypoints and descriptors of five blocks
+    // of images with up to the maximum number of features per image.
+    const double image_size =
+        sift_extraction->max_num_features *
+        (sizeof(FeatureKeypoint) + sizeof(FeatureDescriptors::Scalar) * 128) /
+        kGigaBytes;
+    const int max_block_size =
+        std::max(2, static_cast<int>(cache_budget / (5 * image_size)));
+    exhaustive_matching->block_size =
+        std::min(exhaustive_matching->block_size, max_block_size);
+    std::cout << StringPrintf("  ExhaustiveMatching.block_size: %d",
+                              exhaustive_matching->block_size)
+              << std::endl;
+  }
+
+  // The automatic reconstruction fuses the depth maps of a reconstruction
+  // while PatchMatch stereo runs on the next one, so that both caches must
+  // share the budget. Their sizes are scaled by the same factor, such that
+  // their sum does not exceed the budget.
+  double dense_cache_size = 0;
+  if (added_patch_match_stereo_options_) {
+    dense_cache_size += patch_match_stereo->cache_size;
+  }
+  if (added_stereo_fusion_options_) {
+    dense_cache_size += stereo_fusion->cache_size;
+  }
+
+  const double dense_cache_scale =
+      dense_cache_size > cache_budget ? cache_budget / dense_cache_size : 1.0;
+
+  const auto LimitCacheSize = [&](const std::string& name,
+                                  double* cache_size) {
+    *cache_size *= dense_cache_scale;
+    std::cout << StringPrintf("  %s: %.2f GB", name.c_str(), *cache_size)
+              << std::endl;
+  };
+
+  if (added_patch_match_stereo_options_) {
+    LimitCacheSize("PatchMatchStereo.cache_size",
+                   &patch_match_stereo->cache_size);
+  }
+
+  if (added_stereo_fusion_options_) {
+    LimitCacheSize("StereoFusion.cache_size", &stereo_fusion->cache_size);
+  }
+}
+
 void OptionManager::Parse(const int argc, char** argv) {
   config::variables_map vmap;
 
@@ -861,6 +1098,12 @@ void OptionManager::Parse(const int argc, char** argv) {
     std::cerr << "ERROR: Invalid options provided." << std::endl;
     exit(EXIT_FAILURE);
   }
+
+  ApplyMemoryBudget();
+  SetNumaThreadPinning(*numa_thread_pinning);
+
+  EnableTracingUntilExit(*trace_path);
+  ExportMetricsPeriodically(*metrics_path, *metrics_interval);
 }
 
 bool OptionManager::Read(const std::string& path) {
@@ -112,6 +112,13 @@ class OptionManager {
 
   bool Check();
 
+  // Limit the cache sizes of the added options to the memory budget and print
+  // the effective limits. Half of the budget is reserved for the working
+  // memory of the stages besides their caches. Feature matching runs on its
+  // own and can use the full cache budget, while the caches of PatchMatch
+  // stereo and stereo fusion, which can run at the same time, share it.
+  void ApplyMemoryBudget();
+
   void Parse(const int argc, char** argv);
   bool Read(const std::string& path);
   bool ReRead(const std::string& path);
@@ -121,6 +128,25 @@ class OptionManager {
   std::shared_ptr<std::string> database_path;
   std::shared_ptr<std::string> image_path;
 
+  // Path of the Chrome trace of the time spent in the different steps of a
+  // command, which is written when the command finishes, see util/trace.h.
+  std::shared_ptr<std::string> trace_path;
+
+  // Path of the metrics of the progress of a command, which are written every
+  // metrics_interval seconds while the command runs, see util/metrics.h.
+  std::shared_ptr<std::string> metrics_path;
+  std::shared_ptr<double> metrics_interval;
+
+  // Memory budget in GB of a command, which limits the in-memory caches of
+  // the stages that are used by the command, see `ApplyMemoryBudget`. A value
+  // of zero uses the available physical memory and a negative value disables
+  // the limits.
+  std::shared_ptr<double> memory_budget;
+
+  // Whether to pin the threads of a command to the NUMA nodes of the machine,
+  // see `SetNumaThreadPinning`.
+  std::shared_ptr<bool> numa_thread_pinning;
+
   std::shared_ptr<ImageReaderOptions> image_reader;
   std::shared_ptr<SiftExtractionOptions> sift_extraction;
 
@@ -0,0 +1,98 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+
+#define TEST_NAME "util/option_manager"
+#include "util/testing.h"
+
+#include "feature/matching.h"
+#include "feature/sift.h"
+#include "mvs/fusion.h"
+#include "mvs/patch_match.h"
+#include "util/option_manager.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestMemoryBudgetDisabled) {
+  OptionManager options;
+  options.AddAllOptions();
+  const double patch_match_cache_size = options.patch_match_stereo->cache_size;
+  const double fusion_cache_size = options.stereo_fusion->cache_size;
+  const int block_size = options.exhaustive_matching->block_size;
+  *options.memory_budget = -1;
+  options.ApplyMemoryBudget();
+  BOOST_CHECK_EQUAL(options.patch_match_stereo->cache_size,
+                    patch_match_cache_size);
+  BOOST_CHECK_EQUAL(options.stereo_fusion->cache_size, fusion_cache_size);
+  BOOST_CHECK_EQUAL(options.exhaustive_matching->block_size, block_size);
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryBudgetConcurrentStages) {
+  for (const double memory_budget : {0.5, 4.0, 16.0, 100.0}) {
+    OptionManager options;
+    options.AddAllOptions();
+    options.patch_match_stereo->cache_size = 32;
+    options.stereo_fusion->cache_size = 16;
+    *options.memory_budget = memory_budget;
+    options.ApplyMemoryBudget();
+
+    // PatchMatch stereo and stereo fusion run at the same time, so that the
+    // sum of their caches must fit into the cache half of the budget.
+    const double cache_budget = 0.5 * memory_budget;
+    BOOST_CHECK_LE(options.patch_match_stereo->cache_size +
+                       options.stereo_fusion->cache_size,
+                   cache_budget + 1e-6);
+    BOOST_CHECK_GT(options.patch_match_stereo->cache_size, 0);
+    BOOST_CHECK_GT(options.stereo_fusion->cache_size, 0);
+    BOOST_CHECK_CLOSE(options.patch_match_stereo->cache_size,
+                      2 * options.stereo_fusion->cache_size, 1e-6);
+    if (cache_budget >= 48) {
+      BOOST_CHECK_EQUAL(options.patch_match_stereo->cache_size, 32);
+      BOOST_CHECK_EQUAL(options.stereo_fusion->cache_size, 16);
+    }
+
+    // Feature matching runs on its own and caches five blocks of images.
+    const double kGigaBytes = 1024.0 * 1024.0 * 1024.0;
+    const double image_size =
+        options.sift_extraction->max_num_features *
+        (sizeof(FeatureKeypoint) + sizeof(FeatureDescriptors::Scalar) * 128) /
+        kGigaBytes;
+    BOOST_CHECK_LE(5 * options.exhaustive_matching->block_size * image_size,
+                   std::max(cache_budget, 5 * 2 * image_size));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryBudgetSingleStage) {
+  OptionManager options;
+  options.AddStereoFusionOptions();
+  options.stereo_fusion->cache_size = 32;
+  *options.memory_budget = 16;
+  options.ApplyMemoryBudget();
+  BOOST_CHECK_EQUAL(options.stereo_fusion->cache_size, 8);
+}
@@ -31,14 +31,57 @@
 
 #include "util/ply.h"
 
+#include <cstring>
 #include <fstream>
+#include <iomanip>
 
 #include <Eigen/Core>
 
 #include "util/logging.h"
+#include "util/mapped_file.h"
 #include "util/misc.h"
 
 namespace colmap {
+namespace {
+
+// The number of vertices that are read or written at once in binary files.
+const size_t kNumChunkVertices = 1 << 16;
+
+template <typename T>
+T DecodeBinaryPly(const char* data, const bool is_little_endian) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return is_little_endian ? LittleEndianToNative(value)
+                          : BigEndianToNative(value);
+}
+
+template <typename T>
+void EncodeBinaryLittleEndian(const T value, std::vector<char>* buffer) {
+  const T little_endian_value = NativeToLittleEndian(value);
+  const char* data = reinterpret_cast<const char*>(&little_endian_value);
+  buffer->insert(buffer->end(), data, data + sizeof(T));
+}
+
+void EncodeBinaryPlyPoint(const PlyPoint& point, const bool write_normal,
+                          const bool write_rgb, std::vector<char>* buffer) {
+  EncodeBinaryLittleEndian<float>(point.x, buffer);
+  EncodeBinaryLittleEndian<float>(point.y, buffer);
+  EncodeBinaryLittleEndian<float>(point.z, buffer);
+
+  if (write_normal) {
+    EncodeBinaryLittleEndian<float>(point.nx, buffer);
+    EncodeBinaryLittleEndian<float>(point.ny, buffer);
+    EncodeBinaryLittleEndian<float>(point.nz, buffer);
+  }
+
+  if (write_rgb) {
+    EncodeBinaryLittleEndian<uint8_t>(point.r, buffer);
+    EncodeBinaryLittleEndian<uint8_t>(point.g, buffer);
+    EncodeBinaryLittleEndian<uint8_t>(point.b, buffer);
+  }
+}
+
+}  // namespace
 
 std::vector<PlyPoint> ReadPly(const std::string& path) {
   std::ifstream file(path, std::ios::binary);
@@ -180,70 +223,43 @@ std::vector<PlyPoint> ReadPly(const std::string& path) {
   CHECK(X_index != -1 && Y_index != -1 && Z_index)
       << "Invalid PLY file format: x, y, z properties missing";
 
-  points.reserve(num_vertices);
-
   if (is_binary) {
-    std::vector<char> buffer(num_bytes_per_line);
+    // Decode the vertices directly from the mapped file, which is much faster
+    // than reading each of them through the stream.
+    const size_t data_offset = static_cast<size_t>(file.tellg());
+    file.close();
+
+    const MappedFile mapped_file(path);
+    CHECK_LE(data_offset + num_vertices * num_bytes_per_line,
+             mapped_file.Size())
+        << "Unexpected end of file " << path;
+
+    points.resize(num_vertices);
+
+    const char* data = mapped_file.Data() + data_offset;
     for (size_t i = 0; i < num_vertices; ++i) {
-      file.read(buffer.data(), num_bytes_per_line);
+      PlyPoint& point = points[i];
 
-      PlyPoint point;
+      point.x = DecodeBinaryPly<float>(data + X_byte_pos, is_little_endian);
+      point.y = DecodeBinaryPly<float>(data + Y_byte_pos, is_little_endian);
+      point.z = DecodeBinaryPly<float>(data + Z_byte_pos, is_little_endian);
 
-      if (is_little_endian) {
-        point.x = LittleEndianToNative(
-            *reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y = LittleEndianToNative(
-            *reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z = LittleEndianToNative(
-            *reinterpret_cast<float*>(&buffer[Z_byte_pos]));
-
-        if (!is_normal_missing) {
-          point.nx = LittleEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = LittleEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = LittleEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
-        }
-
-        if (!is_rgb_missing) {
-          point.r = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
-        }
-      } else {
-        point.x =
-            BigEndianToNative(*reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y =
-            BigEndianToNative(*reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z =
-            BigEndianToNative(*reinterpret_cast<float*>(&buffer[Z_byte_pos]));
-
-        if (!is_normal_missing) {
-          point.nx = BigEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = BigEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = BigEndianToNative(
-              *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
-        }
-
-        if (!is_rgb_missing) {
-          point.r = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
-        }
+      if (!is_normal_missing) {
+        point.nx = DecodeBinaryPly<float>(data + NX_byte_pos, is_little_endian);
+        point.ny = DecodeBinaryPly<float>(data + NY_byte_pos, is_little_endian);
+        point.nz = DecodeBinaryPly<float>(data + NZ_byte_pos, is_little_endian);
       }
 
-      points.push_back(point);
+      if (!is_rgb_missing) {
+        point.r = static_cast<uint8_t>(data[R_byte_pos]);
+        point.g = static_cast<uint8_t>(data[G_byte_pos]);
+        point.b = static_cast<uint8_t>(data[B_byte_pos]);
+      }
+
+      data += num_bytes_per_line;
     }
   } else {
+    points.reserve(num_vertices);
     while (std::getline(file, line)) {
       StringTrim(&line);
       std::stringstream line_stream(line);
@@ -360,28 +376,292 @@ void WriteBinaryPlyPoints(const std::string& path,
                            std::ios::out | std::ios::binary | std::ios::app);
   CHECK(binary_file.is_open()) << path;
 
-  for (const auto& point : points) {
-    WriteBinaryLittleEndian<float>(&binary_file, point.x);
-    WriteBinaryLittleEndian<float>(&binary_file, point.y);
-    WriteBinaryLittleEndian<float>(&binary_file, point.z);
+  // Encode the points in chunks to avoid writing them field by field.
+  std::vector<char> buffer;
+  for (size_t i = 0; i < points.size(); ++i) {
+    EncodeBinaryPlyPoint(points[i], write_normal, write_rgb, &buffer);
+    if ((i + 1) % kNumChunkVertices == 0 || i + 1 == points.size()) {
+      binary_file.write(buffer.data(), buffer.size());
+      buffer.clear();
+    }
+  }
 
-    if (write_normal) {
-      WriteBinaryLittleEndian<float>(&binary_file, point.nx);
-      WriteBinaryLittleEndian<float>(&binary_file, point.ny);
-      WriteBinaryLittleEndian<float>(&binary_file, point.nz);
+  binary_file.close();
+}
+
+BinaryPlyPointWriter::BinaryPlyPointWriter(const std::string& path,
+                                           const bool write_normal,
+                                           const bool write_rgb)
+    : path_(path),
+      write_normal_(write_normal),
+      write_rgb_(write_rgb),
+      num_points_(0) {
+  file_.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+  CHECK(file_.is_open()) << path;
+
+  file_ << "ply" << std::endl;
+  file_ << "format binary_little_endian 1.0" << std::endl;
+  file_ << "element vertex ";
+  num_points_pos_ = file_.tellp();
+  file_ << std::setw(20) << std::setfill('0') << 0 << std::endl;
+
+  file_ << "property float x" << std::endl;
+  file_ << "property float y" << std::endl;
+  file_ << "property float z" << std::endl;
+
+  if (write_normal_) {
+    file_ << "property float nx" << std::endl;
+    file_ << "property float ny" << std::endl;
+    file_ << "property float nz" << std::endl;
+  }
+
+  if (write_rgb_) {
+    file_ << "property uchar red" << std::endl;
+    file_ << "property uchar green" << std::endl;
+    file_ << "property uchar blue" << std::endl;
+  }
+
+  file_ << "end_header" << std::endl;
+}
+
+BinaryPlyPointWriter::~BinaryPlyPointWriter() { Close(); }
+
+void BinaryPlyPointWriter::Write(const PlyPoint& point) {
+  CHECK(file_.is_open()) << path_;
+
+  EncodeBinaryPlyPoint(point, write_normal_, write_rgb_, &buffer_);
+
+  num_points_ += 1;
+  if (num_points_ % kNumChunkVertices == 0) {
+    Flush();
+  }
+}
+
+size_t BinaryPlyPointWriter::NumPoints() const { return num_points_; }
+
+void BinaryPlyPointWriter::Flush() {
+  file_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void BinaryPlyPointWriter::Close() {
+  if (!file_.is_open()) {
+    return;
+  }
+
+  Flush();
+
+  file_.seekp(num_points_pos_);
+  file_ << std::setw(20) << std::setfill('0') << num_points_;
+  CHECK(file_.good()) << path_;
+  file_.close();
+}
+
+PlyMesh ReadPlyMesh(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  CHECK(file.is_open()) << path;
+
+  PlyMesh mesh;
+
+  std::string line;
+
+  // The index of the vertex property for ASCII PLY files.
+  int X_index = -1;
+  int Y_index = -1;
+  int Z_index = -1;
+  int R_index = -1;
+  int G_index = -1;
+  int B_index = -1;
+
+  // The position in number of bytes of the vertex property for binary files.
+  int X_byte_pos = -1;
+  int Y_byte_pos = -1;
+  int Z_byte_pos = -1;
+  int R_byte_pos = -1;
+  int G_byte_pos = -1;
+  int B_byte_pos = -1;
+
+  std::string element;
+  bool is_binary = false;
+  bool is_little_endian = false;
+  size_t num_bytes_per_vertex = 0;
+  size_t num_vertices = 0;
+  size_t num_faces = 0;
+
+  int index = 0;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty()) {
+      continue;
     }
 
-    if (write_rgb) {
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.r);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.g);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.b);
+    if (line == "end_header") {
+      break;
+    }
+
+    if (line == "format ascii 1.0") {
+      is_binary = false;
+    } else if (line == "format binary_little_endian 1.0") {
+      is_binary = true;
+      is_little_endian = true;
+    } else if (line == "format binary_big_endian 1.0") {
+      is_binary = true;
+      is_little_endian = false;
+    }
+
+    const std::vector<std::string> line_elems = StringSplit(line, " ");
+
+    if (line_elems.size() >= 3 && line_elems[0] == "element") {
+      element = line_elems[1];
+      if (element == "vertex") {
+        num_vertices = std::stoll(line_elems[2]);
+      } else if (element == "face") {
+        num_faces = std::stoll(line_elems[2]);
+      } else if (std::stoll(line_elems[2]) > 0) {
+        LOG(FATAL) << "Only vertex and face elements supported";
+      }
+    }
+
+    if (line_elems.size() < 3 || line_elems[0] != "property") {
+      continue;
+    }
+
+    if (element == "face") {
+      CHECK(line_elems.size() == 5 && line_elems[1] == "list" &&
+            line_elems[2] == "uchar" &&
+            (line_elems[3] == "int" || line_elems[3] == "uint"))
+          << "PLY import only supports faces as lists of uchar and int";
+      continue;
+    }
+
+    if (element != "vertex") {
+      continue;
+    }
+
+    const std::string& type = line_elems[1];
+    const std::string& name = line_elems[2];
+
+    if (type == "float" || type == "float32") {
+      if (name == "x") {
+        X_index = index;
+        X_byte_pos = num_bytes_per_vertex;
+      } else if (name == "y") {
+        Y_index = index;
+        Y_byte_pos = num_bytes_per_vertex;
+      } else if (name == "z") {
+        Z_index = index;
+        Z_byte_pos = num_bytes_per_vertex;
+      }
+      num_bytes_per_vertex += 4;
+    } else if (type == "uchar") {
+      if (name == "r" || name == "red" || name == "diffuse_red") {
+        R_index = index;
+        R_byte_pos = num_bytes_per_vertex;
+      } else if (name == "g" || name == "green" || name == "diffuse_green") {
+        G_index = index;
+        G_byte_pos = num_bytes_per_vertex;
+      } else if (name == "b" || name == "blue" || name == "diffuse_blue") {
+        B_index = index;
+        B_byte_pos = num_bytes_per_vertex;
+      }
+      num_bytes_per_vertex += 1;
+    } else {
+      LOG(FATAL) << "PLY import only supports the float and uchar data types";
     }
+
+    index += 1;
   }
 
-  binary_file.close();
+  const bool is_rgb_missing =
+      (R_index == -1) || (G_index == -1) || (B_index == -1);
+
+  CHECK(X_index != -1 && Y_index != -1 && Z_index != -1)
+      << "Invalid PLY file format: x, y, z properties missing";
+
+  mesh.vertices.reserve(num_vertices);
+  mesh.faces.reserve(num_faces);
+
+  // Triangulate polygonal faces as fans around their first vertex.
+  std::vector<size_t> polygon;
+  const auto AddPolygon = [&mesh, &polygon]() {
+    for (size_t i = 2; i < polygon.size(); ++i) {
+      CHECK_LT(polygon[i - 1], mesh.vertices.size());
+      CHECK_LT(polygon[i], mesh.vertices.size());
+      mesh.faces.emplace_back(polygon[0], polygon[i - 1], polygon[i]);
+    }
+  };
+
+  if (is_binary) {
+    std::vector<char> buffer(num_bytes_per_vertex);
+    for (size_t i = 0; i < num_vertices; ++i) {
+      file.read(buffer.data(), num_bytes_per_vertex);
+
+      PlyMeshVertex vertex;
+      vertex.x = DecodeBinaryPly<float>(&buffer[X_byte_pos], is_little_endian);
+      vertex.y = DecodeBinaryPly<float>(&buffer[Y_byte_pos], is_little_endian);
+      vertex.z = DecodeBinaryPly<float>(&buffer[Z_byte_pos], is_little_endian);
+
+      if (!is_rgb_missing) {
+        vertex.r = static_cast<uint8_t>(buffer[R_byte_pos]);
+        vertex.g = static_cast<uint8_t>(buffer[G_byte_pos]);
+        vertex.b = static_cast<uint8_t>(buffer[B_byte_pos]);
+      }
+
+      mesh.vertices.push_back(vertex);
+    }
+
+    for (size_t i = 0; i < num_faces; ++i) {
+      const uint8_t num_face_vertices = ReadBinaryLittleEndian<uint8_t>(&file);
+      polygon.resize(num_face_vertices);
+      for (uint8_t j = 0; j < num_face_vertices; ++j) {
+        char data[sizeof(int32_t)];
+        file.read(data, sizeof(int32_t));
+        polygon[j] = DecodeBinaryPly<int32_t>(data, is_little_endian);
+      }
+      AddPolygon();
+    }
+
+    CHECK(file.good()) << path;
+  } else {
+    for (size_t i = 0; i < num_vertices; ++i) {
+      std::getline(file, line);
+      StringTrim(&line);
+      const std::vector<std::string> items = StringSplit(line, " ");
+
+      PlyMeshVertex vertex;
+      vertex.x = std::stold(items.at(X_index));
+      vertex.y = std::stold(items.at(Y_index));
+      vertex.z = std::stold(items.at(Z_index));
+
+      if (!is_rgb_missing) {
+        vertex.r = std::stoi(items.at(R_index));
+        vertex.g = std::stoi(items.at(G_index));
+        vertex.b = std::stoi(items.at(B_index));
+      }
+
+      mesh.vertices.push_back(vertex);
+    }
+
+    for (size_t i = 0; i < num_faces; ++i) {
+      std::getline(file, line);
+      StringTrim(&line);
+      const std::vector<std::string> items = StringSplit(line, " ");
+
+      const size_t num_face_vertices = std::stoll(items.at(0));
+      polygon.resize(num_face_vertices);
+      for (size_t j = 0; j < num_face_vertices; ++j) {
+        polygon[j] = std::stoll(items.at(j + 1));
+      }
+      AddPolygon();
+    }
+  }
+
+  return mesh;
 }
 
-void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh) {
+void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh,
+                      const bool write_rgb) {
   std::fstream file(path, std::ios::out);
   CHECK(file.is_open());
 
@@ -391,12 +671,22 @@ void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh) {
   file << "property float x" << std::endl;
   file << "property float y" << std::endl;
   file << "property float z" << std::endl;
+  if (write_rgb) {
+    file << "property uchar red" << std::endl;
+    file << "property uchar green" << std::endl;
+    file << "property uchar blue" << std::endl;
+  }
   file << "element face " << mesh.faces.size() << std::endl;
   file << "property list uchar int vertex_index" << std::endl;
   file << "end_header" << std::endl;
 
   for (const auto& vertex : mesh.vertices) {
-    file << vertex.x << " " << vertex.y << " " << vertex.z << std::endl;
+    file << vertex.x << " " << vertex.y << " " << vertex.z;
+    if (write_rgb) {
+      file << " " << static_cast<int>(vertex.r) << " "
+           << static_cast<int>(vertex.g) << " " << static_cast<int>(vertex.b);
+    }
+    file << std::endl;
   }
 
   for (const auto& face : mesh.faces) {
@@ -406,7 +696,8 @@ void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh) {
   }
 }
 
-void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh) {
+void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh,
+                        const bool write_rgb) {
   std::fstream text_file(path, std::ios::out);
   CHECK(text_file.is_open());
 
@@ -416,6 +707,11 @@ void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh) {
   text_file << "property float x" << std::endl;
   text_file << "property float y" << std::endl;
   text_file << "property float z" << std::endl;
+  if (write_rgb) {
+    text_file << "property uchar red" << std::endl;
+    text_file << "property uchar green" << std::endl;
+    text_file << "property uchar blue" << std::endl;
+  }
   text_file << "element face " << mesh.faces.size() << std::endl;
   text_file << "property list uchar int vertex_index" << std::endl;
   text_file << "end_header" << std::endl;
@@ -429,6 +725,11 @@ void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh) {
     WriteBinaryLittleEndian<float>(&binary_file, vertex.x);
     WriteBinaryLittleEndian<float>(&binary_file, vertex.y);
     WriteBinaryLittleEndian<float>(&binary_file, vertex.z);
+    if (write_rgb) {
+      WriteBinaryLittleEndian<uint8_t>(&binary_file, vertex.r);
+      WriteBinaryLittleEndian<uint8_t>(&binary_file, vertex.g);
+      WriteBinaryLittleEndian<uint8_t>(&binary_file, vertex.b);
+    }
   }
 
   for (const auto& face : mesh.faces) {
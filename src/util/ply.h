@@ -32,6 +32,7 @@
 #ifndef COLMAP_SRC_UTIL_PLY_H_
 #define COLMAP_SRC_UTIL_PLY_H_
 
+#include <fstream>
 #include <string>
 #include <vector>
 
@@ -59,6 +60,9 @@ struct PlyMeshVertex {
   float x = 0.0f;
   float y = 0.0f;
   float z = 0.0f;
+  uint8_t r = 0;
+  uint8_t g = 0;
+  uint8_t b = 0;
 };
 
 struct PlyMeshFace {
@@ -92,9 +96,43 @@ void WriteBinaryPlyPoints(const std::string& path,
                           const bool write_normal = true,
                           const bool write_rgb = true);
 
+// Write PLY point cloud incrementally to a binary file, so that the points do
+// not need to be kept in memory. The number of points in the header is written
+// with a fixed width and updated, when the writer is closed.
+class BinaryPlyPointWriter {
+ public:
+  BinaryPlyPointWriter(const std::string& path, const bool write_normal = true,
+                       const bool write_rgb = true);
+  ~BinaryPlyPointWriter();
+
+  void Write(const PlyPoint& point);
+
+  size_t NumPoints() const;
+
+  // Write the final number of points to the header and close the file.
+  void Close();
+
+ private:
+  // Write the buffered points to the file.
+  void Flush();
+
+  const std::string path_;
+  const bool write_normal_;
+  const bool write_rgb_;
+  std::fstream file_;
+  std::vector<char> buffer_;
+  std::streampos num_points_pos_;
+  size_t num_points_;
+};
+
+// Read PLY mesh from text or binary file. Polygonal faces are triangulated.
+PlyMesh ReadPlyMesh(const std::string& path);
+
 // Write PLY mesh to text or binary file.
-void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh);
-void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh);
+void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh,
+                      const bool write_rgb = false);
+void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh,
+                        const bool write_rgb = false);
 
 }  // namespace colmap
 
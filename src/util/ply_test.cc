@@ -0,0 +1,247 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "util/ply"
+#include "util/testing.h"
+
+#include <boost/filesystem.hpp>
+
+#include "util/ply.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestBinaryPlyPointWriter) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_ply_%%%%-%%%%.ply"))
+          .string();
+
+  std::vector<PlyPoint> points(3);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[i].x = i;
+    points[i].y = i + 0.5f;
+    points[i].z = -1.0f * i;
+    points[i].nz = 1.0f;
+    points[i].r = i;
+    points[i].g = 2 * i;
+    points[i].b = 255;
+  }
+
+  {
+    BinaryPlyPointWriter writer(path);
+    BOOST_CHECK_EQUAL(writer.NumPoints(), 0);
+    for (const auto& point : points) {
+      writer.Write(point);
+    }
+    BOOST_CHECK_EQUAL(writer.NumPoints(), points.size());
+  }
+
+  const auto read_points = ReadPly(path);
+  BOOST_CHECK_EQUAL(read_points.size(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    BOOST_CHECK_EQUAL(read_points[i].x, points[i].x);
+    BOOST_CHECK_EQUAL(read_points[i].y, points[i].y);
+    BOOST_CHECK_EQUAL(read_points[i].z, points[i].z);
+    BOOST_CHECK_EQUAL(read_points[i].nx, points[i].nx);
+    BOOST_CHECK_EQUAL(read_points[i].ny, points[i].ny);
+    BOOST_CHECK_EQUAL(read_points[i].nz, points[i].nz);
+    BOOST_CHECK_EQUAL(read_points[i].r, points[i].r);
+    BOOST_CHECK_EQUAL(read_points[i].g, points[i].g);
+    BOOST_CHECK_EQUAL(read_points[i].b, points[i].b);
+  }
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryPlyPointWriterEmpty) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_ply_%%%%-%%%%.ply"))
+          .string();
+
+  BinaryPlyPointWriter writer(path, false, false);
+  writer.Close();
+  writer.Close();
+
+  BOOST_CHECK(ReadPly(path).empty());
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWritePlyMesh) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_ply_%%%%-%%%%.ply"))
+          .string();
+
+  PlyMesh mesh;
+  for (size_t i = 0; i < 4; ++i) {
+    mesh.vertices.emplace_back(i, i + 0.5f, -1.0f * i);
+    mesh.vertices.back().r = i;
+    mesh.vertices.back().g = 2 * i;
+    mesh.vertices.back().b = 255;
+  }
+  mesh.faces.emplace_back(0, 1, 2);
+  mesh.faces.emplace_back(0, 2, 3);
+
+  for (const bool binary : {false, true}) {
+    for (const bool write_rgb : {false, true}) {
+      if (binary) {
+        WriteBinaryPlyMesh(path, mesh, write_rgb);
+      } else {
+        WriteTextPlyMesh(path, mesh, write_rgb);
+      }
+
+      const PlyMesh read_mesh = ReadPlyMesh(path);
+      BOOST_CHECK_EQUAL(read_mesh.vertices.size(), mesh.vertices.size());
+      for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+        BOOST_CHECK_EQUAL(read_mesh.vertices[i].x, mesh.vertices[i].x);
+        BOOST_CHECK_EQUAL(read_mesh.vertices[i].y, mesh.vertices[i].y);
+        BOOST_CHECK_EQUAL(read_mesh.vertices[i].z, mesh.vertices[i].z);
+        if (write_rgb) {
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].r, mesh.vertices[i].r);
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].g, mesh.vertices[i].g);
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].b, mesh.vertices[i].b);
+        } else {
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].r, 0);
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].g, 0);
+          BOOST_CHECK_EQUAL(read_mesh.vertices[i].b, 0);
+        }
+      }
+
+      BOOST_CHECK_EQUAL(read_mesh.faces.size(), mesh.faces.size());
+      for (size_t i = 0; i < mesh.faces.size(); ++i) {
+        BOOST_CHECK_EQUAL(read_mesh.faces[i].vertex_idx1,
+                          mesh.faces[i].vertex_idx1);
+        BOOST_CHECK_EQUAL(read_mesh.faces[i].vertex_idx2,
+                          mesh.faces[i].vertex_idx2);
+        BOOST_CHECK_EQUAL(read_mesh.faces[i].vertex_idx3,
+                          mesh.faces[i].vertex_idx3);
+      }
+    }
+  }
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadPlyMeshPolygon) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_ply_%%%%-%%%%.ply"))
+          .string();
+
+  {
+    std::ofstream file(path);
+    file << "ply" << std::endl;
+    file << "format ascii 1.0" << std::endl;
+    file << "element vertex 4" << std::endl;
+    file << "property float x" << std::endl;
+    file << "property float y" << std::endl;
+    file << "property float z" << std::endl;
+    file << "property float value" << std::endl;
+    file << "element face 1" << std::endl;
+    file << "property list uchar int vertex_indices" << std::endl;
+    file << "end_header" << std::endl;
+    file << "0 0 0 1" << std::endl;
+    file << "1 0 0 2" << std::endl;
+    file << "1 1 0 3" << std::endl;
+    file << "0 1 0 4" << std::endl;
+    file << "4 0 1 2 3" << std::endl;
+  }
+
+  const PlyMesh mesh = ReadPlyMesh(path);
+  BOOST_CHECK_EQUAL(mesh.vertices.size(), 4);
+  BOOST_CHECK_EQUAL(mesh.vertices[2].x, 1);
+  BOOST_CHECK_EQUAL(mesh.vertices[2].y, 1);
+  BOOST_CHECK_EQUAL(mesh.vertices[2].z, 0);
+  BOOST_CHECK_EQUAL(mesh.faces.size(), 2);
+  BOOST_CHECK_EQUAL(mesh.faces[0].vertex_idx1, 0);
+  BOOST_CHECK_EQUAL(mesh.faces[0].vertex_idx2, 1);
+  BOOST_CHECK_EQUAL(mesh.faces[0].vertex_idx3, 2);
+  BOOST_CHECK_EQUAL(mesh.faces[1].vertex_idx1, 0);
+  BOOST_CHECK_EQUAL(mesh.faces[1].vertex_idx2, 2);
+  BOOST_CHECK_EQUAL(mesh.faces[1].vertex_idx3, 3);
+
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(TestReadWriteBinaryPlyPointsChunks) {
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_ply_%%%%-%%%%.ply"))
+          .string();
+
+  // Use more points than are read and written at once.
+  std::vector<PlyPoint> points(200000);
+  for (size_t i = 0; i < points.size(); ++i) {
+    points[i].x = i;
+    points[i].y = -0.5f * i;
+    points[i].z = 1.0f;
+    points[i].nx = 1.0f;
+    points[i].r = i % 256;
+    points[i].g = 255 - i % 256;
+    points[i].b = 7;
+  }
+
+  for (const bool write_normal : {false, true}) {
+    for (const bool write_rgb : {false, true}) {
+      WriteBinaryPlyPoints(path, points, write_normal, write_rgb);
+      const auto read_points = ReadPly(path);
+      BOOST_CHECK_EQUAL(read_points.size(), points.size());
+      for (size_t i = 0; i < points.size(); ++i) {
+        BOOST_CHECK_EQUAL(read_points[i].x, points[i].x);
+        BOOST_CHECK_EQUAL(read_points[i].y, points[i].y);
+        BOOST_CHECK_EQUAL(read_points[i].z, points[i].z);
+        BOOST_CHECK_EQUAL(read_points[i].nx, write_normal ? 1.0f : 0.0f);
+        BOOST_CHECK_EQUAL(read_points[i].r, write_rgb ? points[i].r : 0);
+        BOOST_CHECK_EQUAL(read_points[i].g, write_rgb ? points[i].g : 0);
+        BOOST_CHECK_EQUAL(read_points[i].b, write_rgb ? points[i].b : 0);
+      }
+    }
+  }
+
+  {
+    BinaryPlyPointWriter writer(path);
+    for (const auto& point : points) {
+      writer.Write(point);
+    }
+  }
+
+  const auto read_points = ReadPly(path);
+  BOOST_CHECK_EQUAL(read_points.size(), points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    BOOST_CHECK_EQUAL(read_points[i].x, points[i].x);
+    BOOST_CHECK_EQUAL(read_points[i].y, points[i].y);
+    BOOST_CHECK_EQUAL(read_points[i].r, points[i].r);
+  }
+
+  boost::filesystem::remove(path);
+}
@@ -31,6 +31,8 @@
 
 #include "util/random.h"
 
+#include <limits>
+
 namespace colmap {
 
 thread_local std::mt19937* PRNG = nullptr;
@@ -49,4 +51,15 @@ void SetPRNGSeed(unsigned seed) {
   srand(seed);
 }
 
+ScopedPRNGSeed::ScopedPRNGSeed(const unsigned seed)
+    : prng_(seed), prev_prng_(PRNG) {
+  PRNG = &prng_;
+}
+
+ScopedPRNGSeed::~ScopedPRNGSeed() { PRNG = prev_prng_; }
+
+unsigned RandomPRNGSeed() {
+  return RandomInteger<unsigned>(0, std::numeric_limits<unsigned>::max());
+}
+
 }  // namespace colmap
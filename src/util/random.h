@@ -51,6 +51,26 @@ static int kDefaultPRNGSeed = 0;
 //               is used as the seed.
 void SetPRNGSeed(unsigned seed = kDefaultPRNGSeed);
 
+// Replace the PRNG of the current thread with a PRNG of the given seed for the
+// lifetime of this object and restore the previous PRNG afterwards. This makes
+// randomized computations in parallel tasks deterministic, independent of the
+// worker thread that executes them and of its previous tasks.
+class ScopedPRNGSeed {
+ public:
+  explicit ScopedPRNGSeed(unsigned seed);
+  ~ScopedPRNGSeed();
+
+ private:
+  std::mt19937 prng_;
+  std::mt19937* prev_prng_;
+};
+
+// Draw the seed of a pass of randomized estimations in parallel tasks from the
+// PRNG of the calling thread. Each task derives its own seed from it for a
+// `ScopedPRNGSeed`, such that the results respect the seed of the calling
+// thread but do not depend on the number of threads.
+unsigned RandomPRNGSeed();
+
 // Generate uniformly distributed random integer number.
 //
 // This implementation is unbiased and thread-safe in contrast to `rand()`.
@@ -74,6 +74,35 @@ BOOST_AUTO_TEST_CASE(TestRepeatability) {
   BOOST_CHECK(!all_equal);
 }
 
+BOOST_AUTO_TEST_CASE(TestScopedPRNGSeed) {
+  SetPRNGSeed(0);
+  std::mt19937* prng = PRNG;
+  const int number1 = RandomInteger(0, 10000);
+  std::vector<int> numbers1;
+  {
+    ScopedPRNGSeed scoped_prng_seed(1);
+    BOOST_CHECK(PRNG != prng);
+    for (size_t i = 0; i < 100; ++i) {
+      numbers1.push_back(RandomInteger(0, 10000));
+    }
+  }
+  BOOST_CHECK(PRNG == prng);
+  const int number2 = RandomInteger(0, 10000);
+
+  // The scoped PRNG neither depends on nor advances the previous PRNG.
+  SetPRNGSeed(0);
+  BOOST_CHECK_EQUAL(RandomInteger(0, 10000), number1);
+  BOOST_CHECK_EQUAL(RandomInteger(0, 10000), number2);
+
+  SetPRNGSeed(1);
+  std::vector<int> numbers2;
+  for (size_t i = 0; i < 100; ++i) {
+    numbers2.push_back(RandomInteger(0, 10000));
+  }
+  BOOST_CHECK_EQUAL_COLLECTIONS(numbers1.begin(), numbers1.end(),
+                                numbers2.begin(), numbers2.end());
+}
+
 BOOST_AUTO_TEST_CASE(TestRandomInteger) {
   SetPRNGSeed();
   for (size_t i = 0; i < 1000; ++i) {
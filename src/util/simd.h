@@ -0,0 +1,61 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_UTIL_SIMD_H_
+#define COLMAP_SRC_UTIL_SIMD_H_
+
+// Compile the annotated function for multiple instruction sets and select the
+// fastest supported one at load time. This allows the compiler to vectorize
+// tight loops with AVX2/FMA or AVX-512 instructions without raising the
+// minimum instruction set of the binary. The loops of such functions should
+// be written without branches and on raw pointers, such that they can be
+// auto-vectorized in the first place.
+#if defined(SIMD_ENABLED) && defined(__GNUC__) && !defined(__clang__) && \
+    defined(__x86_64__) && defined(__linux__)
+#define COLMAP_SIMD_CLONES                                                   \
+  __attribute__((target_clones("arch=skylake-avx512", "arch=haswell", \
+                               "default")))
+#else
+#define COLMAP_SIMD_CLONES
+#endif
+
+// Same as COLMAP_SIMD_CLONES but for loops dominated by population counts.
+// The clones are dispatched on the POPCNT CPU feature rather than on the CPU
+// model, such that virtualized or unknown processors also use the instruction.
+#if defined(SIMD_ENABLED) && defined(__GNUC__) && !defined(__clang__) && \
+    defined(__x86_64__) && defined(__linux__)
+#define COLMAP_POPCNT_CLONES \
+  __attribute__((target_clones("popcnt", "default")))
+#else
+#define COLMAP_POPCNT_CLONES COLMAP_SIMD_CLONES
+#endif
+
+#endif  // COLMAP_SRC_UTIL_SIMD_H_
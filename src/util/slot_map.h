@@ -0,0 +1,425 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_UTIL_SLOT_MAP_H_
+#define COLMAP_SRC_UTIL_SLOT_MAP_H_
+
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "util/alignment.h"
+#include "util/logging.h"
+
+namespace colmap {
+
+// Map with a subset of the interface of std::unordered_map, which stores its
+// elements in contiguous blocks of slots instead of individually allocated hash
+// map nodes. Iterating over all elements is therefore cache friendly and the
+// elements are visited in the order of their slots. References to elements
+// remain valid until they are erased, and the slots of erased elements are
+// reused for new elements. Iterators are invalidated by insertion and erasure.
+template <typename key_t, typename value_t>
+class SlotMap {
+ public:
+  typedef key_t key_type;
+  typedef value_t mapped_type;
+  typedef std::pair<key_t, value_t> value_type;
+
+  template <bool kIsConst>
+  class Iterator;
+  typedef Iterator<false> iterator;
+  typedef Iterator<true> const_iterator;
+
+  SlotMap();
+  SlotMap(const SlotMap& other);
+  SlotMap(SlotMap&& other) = default;
+  SlotMap& operator=(const SlotMap& other);
+  SlotMap& operator=(SlotMap&& other) = default;
+
+  size_t size() const;
+  bool empty() const;
+
+  // Reserve the slots and the index for the given number of elements.
+  void reserve(const size_t num_elems);
+  void clear();
+
+  size_t count(const key_t& key) const;
+  iterator find(const key_t& key);
+  const_iterator find(const key_t& key) const;
+  value_t& at(const key_t& key);
+  const value_t& at(const key_t& key) const;
+  value_t& operator[](const key_t& key);
+
+  std::pair<iterator, bool> emplace(const key_t& key, const value_t& value);
+  size_t erase(const key_t& key);
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // The number of slots including the free slots, and the element in a slot
+  // or null if the slot is free. The slots partition the elements, e.g., to
+  // process them in parallel.
+  size_t num_slots() const;
+  value_type* slot(const size_t slot_idx);
+  const value_type* slot(const size_t slot_idx) const;
+
+  template <bool kIsConst>
+  class Iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef typename SlotMap::value_type value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef typename std::conditional<kIsConst, const value_type*,
+                                      value_type*>::type pointer;
+    typedef typename std::conditional<kIsConst, const value_type&,
+                                      value_type&>::type reference;
+    typedef typename std::conditional<kIsConst, const SlotMap*, SlotMap*>::type
+        map_pointer;
+
+    Iterator(map_pointer map, const size_t slot_idx);
+    // Conversion from a mutable to a constant iterator.
+    Iterator(const Iterator<false>& other);
+
+    reference operator*() const;
+    pointer operator->() const;
+    Iterator& operator++();
+    Iterator operator++(int);
+    bool operator==(const Iterator& other) const;
+    bool operator!=(const Iterator& other) const;
+
+   private:
+    friend class SlotMap;
+    friend class Iterator<true>;
+
+    // Advance to the next occupied slot, starting at the current slot.
+    void SkipFreeSlots();
+
+    map_pointer map_;
+    size_t slot_idx_;
+  };
+
+ private:
+  // The number of slots per block as a power of two. The slots of a block are
+  // allocated at once and never reallocated.
+  static const size_t kBlockSizeLog2 = 10;
+  static const size_t kBlockSize = 1 << kBlockSizeLog2;
+
+  typedef std::vector<value_type, EIGEN_ALIGNED_ALLOCATOR<value_type>> Block;
+
+  value_type& Slot(const size_t slot_idx);
+  const value_type& Slot(const size_t slot_idx) const;
+
+  // Return the index of a free slot, which is either an erased or a new slot.
+  size_t AllocateSlot();
+
+  std::vector<Block> blocks_;
+  std::vector<bool> occupied_slots_;
+  std::vector<size_t> free_slot_idxs_;
+  std::unordered_map<key_t, size_t> slot_idxs_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename key_t, typename value_t>
+SlotMap<key_t, value_t>::SlotMap() {}
+
+template <typename key_t, typename value_t>
+SlotMap<key_t, value_t>::SlotMap(const SlotMap& other) {
+  *this = other;
+}
+
+template <typename key_t, typename value_t>
+SlotMap<key_t, value_t>& SlotMap<key_t, value_t>::operator=(
+    const SlotMap& other) {
+  if (this == &other) {
+    return *this;
+  }
+  // Copy the elements block by block, such that the capacity of each block is
+  // preserved and later insertions do not reallocate any block.
+  blocks_.clear();
+  blocks_.reserve(other.blocks_.size());
+  for (const auto& block : other.blocks_) {
+    blocks_.emplace_back();
+    blocks_.back().reserve(kBlockSize);
+    blocks_.back().insert(blocks_.back().end(), block.begin(), block.end());
+  }
+  occupied_slots_ = other.occupied_slots_;
+  free_slot_idxs_ = other.free_slot_idxs_;
+  slot_idxs_ = other.slot_idxs_;
+  return *this;
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::size() const {
+  return slot_idxs_.size();
+}
+
+template <typename key_t, typename value_t>
+bool SlotMap<key_t, value_t>::empty() const {
+  return slot_idxs_.empty();
+}
+
+template <typename key_t, typename value_t>
+void SlotMap<key_t, value_t>::reserve(const size_t num_elems) {
+  slot_idxs_.reserve(num_elems);
+  occupied_slots_.reserve(num_elems);
+  blocks_.reserve((num_elems + kBlockSize - 1) >> kBlockSizeLog2);
+}
+
+template <typename key_t, typename value_t>
+void SlotMap<key_t, value_t>::clear() {
+  blocks_.clear();
+  occupied_slots_.clear();
+  free_slot_idxs_.clear();
+  slot_idxs_.clear();
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::count(const key_t& key) const {
+  return slot_idxs_.count(key);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::find(
+    const key_t& key) {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return end();
+  }
+  return iterator(this, it->second);
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator SlotMap<key_t, value_t>::find(
+    const key_t& key) const {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return end();
+  }
+  return const_iterator(this, it->second);
+}
+
+template <typename key_t, typename value_t>
+value_t& SlotMap<key_t, value_t>::at(const key_t& key) {
+  return Slot(slot_idxs_.at(key)).second;
+}
+
+template <typename key_t, typename value_t>
+const value_t& SlotMap<key_t, value_t>::at(const key_t& key) const {
+  return Slot(slot_idxs_.at(key)).second;
+}
+
+template <typename key_t, typename value_t>
+value_t& SlotMap<key_t, value_t>::operator[](const key_t& key) {
+  return emplace(key, value_t()).first->second;
+}
+
+template <typename key_t, typename value_t>
+std::pair<typename SlotMap<key_t, value_t>::iterator, bool>
+SlotMap<key_t, value_t>::emplace(const key_t& key, const value_t& value) {
+  const auto it = slot_idxs_.find(key);
+  if (it != slot_idxs_.end()) {
+    return std::make_pair(iterator(this, it->second), false);
+  }
+  const size_t slot_idx = AllocateSlot();
+  value_type& slot = Slot(slot_idx);
+  slot.first = key;
+  slot.second = value;
+  slot_idxs_.emplace(key, slot_idx);
+  return std::make_pair(iterator(this, slot_idx), true);
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::erase(const key_t& key) {
+  const auto it = slot_idxs_.find(key);
+  if (it == slot_idxs_.end()) {
+    return 0;
+  }
+  const size_t slot_idx = it->second;
+  // Release the resources of the erased element.
+  Slot(slot_idx) = value_type();
+  occupied_slots_[slot_idx] = false;
+  free_slot_idxs_.push_back(slot_idx);
+  slot_idxs_.erase(it);
+  return 1;
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::begin() {
+  iterator it(this, 0);
+  it.SkipFreeSlots();
+  return it;
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::iterator SlotMap<key_t, value_t>::end() {
+  return iterator(this, occupied_slots_.size());
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator
+SlotMap<key_t, value_t>::begin() const {
+  const_iterator it(this, 0);
+  it.SkipFreeSlots();
+  return it;
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::const_iterator SlotMap<key_t, value_t>::end()
+    const {
+  return const_iterator(this, occupied_slots_.size());
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::num_slots() const {
+  return occupied_slots_.size();
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::value_type* SlotMap<key_t, value_t>::slot(
+    const size_t slot_idx) {
+  return occupied_slots_[slot_idx] ? &Slot(slot_idx) : nullptr;
+}
+
+template <typename key_t, typename value_t>
+const typename SlotMap<key_t, value_t>::value_type*
+SlotMap<key_t, value_t>::slot(const size_t slot_idx) const {
+  return occupied_slots_[slot_idx] ? &Slot(slot_idx) : nullptr;
+}
+
+template <typename key_t, typename value_t>
+typename SlotMap<key_t, value_t>::value_type& SlotMap<key_t, value_t>::Slot(
+    const size_t slot_idx) {
+  return blocks_[slot_idx >> kBlockSizeLog2][slot_idx & (kBlockSize - 1)];
+}
+
+template <typename key_t, typename value_t>
+const typename SlotMap<key_t, value_t>::value_type&
+SlotMap<key_t, value_t>::Slot(const size_t slot_idx) const {
+  return blocks_[slot_idx >> kBlockSizeLog2][slot_idx & (kBlockSize - 1)];
+}
+
+template <typename key_t, typename value_t>
+size_t SlotMap<key_t, value_t>::AllocateSlot() {
+  if (!free_slot_idxs_.empty()) {
+    const size_t slot_idx = free_slot_idxs_.back();
+    free_slot_idxs_.pop_back();
+    occupied_slots_[slot_idx] = true;
+    return slot_idx;
+  }
+
+  if (blocks_.empty() || blocks_.back().size() == kBlockSize) {
+    blocks_.emplace_back();
+    blocks_.back().reserve(kBlockSize);
+  }
+
+  blocks_.back().emplace_back();
+  occupied_slots_.push_back(true);
+  return occupied_slots_.size() - 1;
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+SlotMap<key_t, value_t>::Iterator<kIsConst>::Iterator(map_pointer map,
+                                                      const size_t slot_idx)
+    : map_(map), slot_idx_(slot_idx) {}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+SlotMap<key_t, value_t>::Iterator<kIsConst>::Iterator(
+    const Iterator<false>& other)
+    : map_(other.map_), slot_idx_(other.slot_idx_) {}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+typename SlotMap<key_t, value_t>::template Iterator<kIsConst>::reference
+    SlotMap<key_t, value_t>::Iterator<kIsConst>::operator*() const {
+  return map_->Slot(slot_idx_);
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+typename SlotMap<key_t, value_t>::template Iterator<kIsConst>::pointer
+    SlotMap<key_t, value_t>::Iterator<kIsConst>::operator->() const {
+  return &map_->Slot(slot_idx_);
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+typename SlotMap<key_t, value_t>::template Iterator<kIsConst>&
+    SlotMap<key_t, value_t>::Iterator<kIsConst>::operator++() {
+  ++slot_idx_;
+  SkipFreeSlots();
+  return *this;
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+typename SlotMap<key_t, value_t>::template Iterator<kIsConst>
+    SlotMap<key_t, value_t>::Iterator<kIsConst>::operator++(int) {
+  Iterator it = *this;
+  ++(*this);
+  return it;
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+bool SlotMap<key_t, value_t>::Iterator<kIsConst>::operator==(
+    const Iterator& other) const {
+  return slot_idx_ == other.slot_idx_;
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+bool SlotMap<key_t, value_t>::Iterator<kIsConst>::operator!=(
+    const Iterator& other) const {
+  return slot_idx_ != other.slot_idx_;
+}
+
+template <typename key_t, typename value_t>
+template <bool kIsConst>
+void SlotMap<key_t, value_t>::Iterator<kIsConst>::SkipFreeSlots() {
+  while (slot_idx_ < map_->occupied_slots_.size() &&
+         !map_->occupied_slots_[slot_idx_]) {
+    ++slot_idx_;
+  }
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_SLOT_MAP_H_
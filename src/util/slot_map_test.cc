@@ -0,0 +1,195 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "util/slot_map"
+#include "util/testing.h"
+
+#include "util/slot_map.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  SlotMap<int, int> map;
+  BOOST_CHECK_EQUAL(map.size(), 0);
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(map.begin() == map.end());
+  BOOST_CHECK(map.find(0) == map.end());
+  BOOST_CHECK_EQUAL(map.count(0), 0);
+  BOOST_CHECK_EQUAL(map.erase(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestEmplaceAndFind) {
+  SlotMap<int, int> map;
+  BOOST_CHECK(map.emplace(3, 30).second);
+  BOOST_CHECK(map.emplace(1, 10).second);
+  BOOST_CHECK(!map.emplace(3, 31).second);
+  map[2] = 20;
+  BOOST_CHECK_EQUAL(map.size(), 3);
+  BOOST_CHECK(!map.empty());
+  BOOST_CHECK_EQUAL(map.at(1), 10);
+  BOOST_CHECK_EQUAL(map.at(2), 20);
+  BOOST_CHECK_EQUAL(map.at(3), 30);
+  BOOST_CHECK_EQUAL(map.count(2), 1);
+  BOOST_CHECK_EQUAL(map.find(2)->first, 2);
+  BOOST_CHECK_EQUAL(map.find(2)->second, 20);
+  BOOST_CHECK(map.find(4) == map.end());
+  BOOST_CHECK_THROW(map.at(4), std::out_of_range);
+
+  // The elements are visited in the order of insertion.
+  std::vector<int> keys;
+  for (const auto& elem : map) {
+    keys.push_back(elem.first);
+  }
+  BOOST_CHECK_EQUAL(keys.size(), 3);
+  BOOST_CHECK_EQUAL(keys[0], 3);
+  BOOST_CHECK_EQUAL(keys[1], 1);
+  BOOST_CHECK_EQUAL(keys[2], 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestErase) {
+  SlotMap<int, std::vector<int>> map;
+  map[1] = {1};
+  map[2] = {2, 2};
+  map[3] = {3, 3, 3};
+  BOOST_CHECK_EQUAL(map.erase(2), 1);
+  BOOST_CHECK_EQUAL(map.erase(2), 0);
+  BOOST_CHECK_EQUAL(map.size(), 2);
+  BOOST_CHECK_EQUAL(map.count(2), 0);
+
+  std::vector<int> keys;
+  for (const auto& elem : map) {
+    keys.push_back(elem.first);
+  }
+  BOOST_CHECK_EQUAL(keys.size(), 2);
+  BOOST_CHECK_EQUAL(keys[0], 1);
+  BOOST_CHECK_EQUAL(keys[1], 3);
+
+  // The slot of the erased element is reused with a clean value.
+  BOOST_CHECK(map[4].empty());
+  keys.clear();
+  for (const auto& elem : map) {
+    keys.push_back(elem.first);
+  }
+  BOOST_CHECK_EQUAL(keys.size(), 3);
+  BOOST_CHECK_EQUAL(keys[1], 4);
+
+  BOOST_CHECK_EQUAL(map.erase(1), 1);
+  BOOST_CHECK_EQUAL(map.erase(3), 1);
+  BOOST_CHECK_EQUAL(map.erase(4), 1);
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(map.begin() == map.end());
+
+  map[5] = {5};
+  map.clear();
+  BOOST_CHECK(map.empty());
+  BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(TestStableReferences) {
+  SlotMap<int, int> map;
+  map.reserve(10);
+  int& value = map[0];
+  value = -1;
+  for (int i = 1; i < 10000; ++i) {
+    map[i] = i;
+  }
+  BOOST_CHECK_EQUAL(&value, &map.at(0));
+  BOOST_CHECK_EQUAL(value, -1);
+  for (int i = 1; i < 10000; i += 2) {
+    map.erase(i);
+  }
+  BOOST_CHECK_EQUAL(&value, &map.at(0));
+  BOOST_CHECK_EQUAL(map.size(), 5000);
+
+  int sum = 0;
+  for (auto& elem : map) {
+    elem.second += 1;
+    sum += elem.second;
+  }
+  BOOST_CHECK_EQUAL(sum, 4999 * 5000 + 4999);
+}
+
+BOOST_AUTO_TEST_CASE(TestCopy) {
+  SlotMap<int, int> map;
+  for (int i = 0; i < 3000; ++i) {
+    map[i] = i;
+  }
+  map.erase(5);
+
+  SlotMap<int, int> map_copy(map);
+  BOOST_CHECK_EQUAL(map_copy.size(), map.size());
+  BOOST_CHECK_EQUAL(map_copy.count(5), 0);
+  BOOST_CHECK_EQUAL(map_copy.at(2999), 2999);
+
+  // Insertions into the copy do not invalidate its references.
+  int& value = map_copy.at(2999);
+  for (int i = 3000; i < 5000; ++i) {
+    map_copy[i] = i;
+  }
+  BOOST_CHECK_EQUAL(&value, &map_copy.at(2999));
+  BOOST_CHECK_EQUAL(map.size(), 2999);
+
+  const SlotMap<int, int>& const_map = map_copy;
+  size_t num_elems = 0;
+  for (SlotMap<int, int>::const_iterator it = const_map.begin();
+       it != const_map.end(); ++it) {
+    num_elems += 1;
+  }
+  BOOST_CHECK_EQUAL(num_elems, 4999);
+}
+
+BOOST_AUTO_TEST_CASE(TestSlots) {
+  SlotMap<int, int> map;
+  BOOST_CHECK_EQUAL(map.num_slots(), 0);
+  for (int i = 0; i < 10; ++i) {
+    map[i] = i;
+  }
+  map.erase(3);
+  BOOST_CHECK_EQUAL(map.num_slots(), 10);
+
+  size_t num_elems = 0;
+  int sum = 0;
+  for (size_t slot_idx = 0; slot_idx < map.num_slots(); ++slot_idx) {
+    const auto* elem = map.slot(slot_idx);
+    if (elem != nullptr) {
+      BOOST_CHECK_EQUAL(elem->first, elem->second);
+      num_elems += 1;
+      sum += elem->second;
+    }
+  }
+  BOOST_CHECK_EQUAL(num_elems, 9);
+  BOOST_CHECK_EQUAL(sum, 45 - 3);
+
+  // Erased slots are reused.
+  map[10] = 10;
+  BOOST_CHECK_EQUAL(map.num_slots(), 10);
+}
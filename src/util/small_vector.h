@@ -0,0 +1,489 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#ifndef COLMAP_SRC_UTIL_SMALL_VECTOR_H_
+#define COLMAP_SRC_UTIL_SMALL_VECTOR_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "util/logging.h"
+
+namespace colmap {
+
+// Vector with a subset of the interface of std::vector, which stores up to
+// `kNumInlineElems` elements inline without any heap allocation. Larger
+// vectors allocate their elements on the heap and grow like std::vector. The
+// elements must be trivially copyable, since they are relocated with memcpy.
+// Iterators are plain pointers and are invalidated by any modification that
+// changes the capacity, as well as by moving the vector while it is inline.
+template <typename value_t, size_t kNumInlineElems>
+class SmallVector {
+ public:
+  static_assert(std::is_trivially_copyable<value_t>::value,
+                "Elements must be trivially copyable");
+  static_assert(kNumInlineElems > 0, "Inline capacity must be positive");
+
+  typedef value_t value_type;
+  typedef value_t* iterator;
+  typedef const value_t* const_iterator;
+
+  SmallVector();
+  SmallVector(const size_t num_elems, const value_t& value = value_t());
+  SmallVector(std::initializer_list<value_t> elems);
+  template <typename InputIt,
+            typename = typename std::iterator_traits<InputIt>::value_type>
+  SmallVector(InputIt first, InputIt last);
+  SmallVector(const SmallVector& other);
+  SmallVector(SmallVector&& other) noexcept;
+  ~SmallVector();
+
+  SmallVector& operator=(const SmallVector& other);
+  SmallVector& operator=(SmallVector&& other) noexcept;
+
+  size_t size() const;
+  bool empty() const;
+
+  // The capacity is `kNumInlineElems` as long as the elements are inline.
+  size_t capacity() const;
+  void reserve(const size_t num_elems);
+
+  // Move the elements back inline if they fit, or otherwise reallocate them
+  // on the heap with the exact capacity.
+  void shrink_to_fit();
+
+  value_t* data();
+  const value_t* data() const;
+
+  iterator begin();
+  iterator end();
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  value_t& operator[](const size_t idx);
+  const value_t& operator[](const size_t idx) const;
+  value_t& at(const size_t idx);
+  const value_t& at(const size_t idx) const;
+  value_t& front();
+  const value_t& front() const;
+  value_t& back();
+  const value_t& back() const;
+
+  void clear();
+  void resize(const size_t num_elems, const value_t& value = value_t());
+  void push_back(const value_t& value);
+  template <typename... args_t>
+  void emplace_back(args_t&&... args);
+  void pop_back();
+
+  template <typename InputIt>
+  void assign(InputIt first, InputIt last);
+  template <typename InputIt>
+  iterator insert(const_iterator pos, InputIt first, InputIt last);
+  iterator erase(const_iterator pos);
+  iterator erase(const_iterator first, const_iterator last);
+
+  bool operator==(const SmallVector& other) const;
+  bool operator!=(const SmallVector& other) const;
+
+ private:
+  bool IsInline() const;
+  void Reallocate(const size_t capacity);
+  void Grow(const size_t min_capacity);
+
+  uint32_t size_;
+  uint32_t capacity_;
+  // The inline elements or the pointer to the heap elements, depending on
+  // whether the capacity exceeds the inline capacity.
+  union {
+    typename std::aligned_storage<sizeof(value_t) * kNumInlineElems,
+                                  alignof(value_t)>::type inline_elems_;
+    value_t* heap_elems_;
+  };
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::SmallVector()
+    : size_(0), capacity_(kNumInlineElems) {}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::SmallVector(const size_t num_elems,
+                                                   const value_t& value)
+    : SmallVector() {
+  resize(num_elems, value);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::SmallVector(
+    std::initializer_list<value_t> elems)
+    : SmallVector() {
+  assign(elems.begin(), elems.end());
+}
+
+template <typename value_t, size_t kNumInlineElems>
+template <typename InputIt, typename>
+SmallVector<value_t, kNumInlineElems>::SmallVector(InputIt first,
+                                                   InputIt last)
+    : SmallVector() {
+  assign(first, last);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::SmallVector(const SmallVector& other)
+    : SmallVector() {
+  *this = other;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::SmallVector(
+    SmallVector&& other) noexcept
+    : SmallVector() {
+  *this = std::move(other);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>::~SmallVector() {
+  if (!IsInline()) {
+    ::operator delete(heap_elems_);
+  }
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>&
+SmallVector<value_t, kNumInlineElems>::operator=(const SmallVector& other) {
+  if (this != &other) {
+    assign(other.begin(), other.end());
+  }
+  return *this;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+SmallVector<value_t, kNumInlineElems>&
+SmallVector<value_t, kNumInlineElems>::operator=(
+    SmallVector&& other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+  if (!IsInline()) {
+    ::operator delete(heap_elems_);
+  }
+  size_ = other.size_;
+  capacity_ = other.capacity_;
+  if (other.IsInline()) {
+    std::memcpy(&inline_elems_, &other.inline_elems_,
+                other.size_ * sizeof(value_t));
+  } else {
+    heap_elems_ = other.heap_elems_;
+    other.capacity_ = kNumInlineElems;
+  }
+  other.size_ = 0;
+  return *this;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+size_t SmallVector<value_t, kNumInlineElems>::size() const {
+  return size_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+bool SmallVector<value_t, kNumInlineElems>::empty() const {
+  return size_ == 0;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+size_t SmallVector<value_t, kNumInlineElems>::capacity() const {
+  return capacity_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::reserve(const size_t num_elems) {
+  if (num_elems > capacity_) {
+    Reallocate(num_elems);
+  }
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::shrink_to_fit() {
+  if (!IsInline() && size_ < capacity_) {
+    Reallocate(std::max(static_cast<size_t>(size_), kNumInlineElems));
+  }
+}
+
+template <typename value_t, size_t kNumInlineElems>
+value_t* SmallVector<value_t, kNumInlineElems>::data() {
+  return IsInline() ? reinterpret_cast<value_t*>(&inline_elems_)
+                    : heap_elems_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+const value_t* SmallVector<value_t, kNumInlineElems>::data() const {
+  return IsInline() ? reinterpret_cast<const value_t*>(&inline_elems_)
+                    : heap_elems_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::iterator
+SmallVector<value_t, kNumInlineElems>::begin() {
+  return data();
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::iterator
+SmallVector<value_t, kNumInlineElems>::end() {
+  return data() + size_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::const_iterator
+SmallVector<value_t, kNumInlineElems>::begin() const {
+  return data();
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::const_iterator
+SmallVector<value_t, kNumInlineElems>::end() const {
+  return data() + size_;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+value_t& SmallVector<value_t, kNumInlineElems>::operator[](const size_t idx) {
+  return data()[idx];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+const value_t& SmallVector<value_t, kNumInlineElems>::operator[](
+    const size_t idx) const {
+  return data()[idx];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+value_t& SmallVector<value_t, kNumInlineElems>::at(const size_t idx) {
+  CHECK_LT(idx, size_);
+  return data()[idx];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+const value_t& SmallVector<value_t, kNumInlineElems>::at(
+    const size_t idx) const {
+  CHECK_LT(idx, size_);
+  return data()[idx];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+value_t& SmallVector<value_t, kNumInlineElems>::front() {
+  return data()[0];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+const value_t& SmallVector<value_t, kNumInlineElems>::front() const {
+  return data()[0];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+value_t& SmallVector<value_t, kNumInlineElems>::back() {
+  return data()[size_ - 1];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+const value_t& SmallVector<value_t, kNumInlineElems>::back() const {
+  return data()[size_ - 1];
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::clear() {
+  size_ = 0;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::resize(const size_t num_elems,
+                                                   const value_t& value) {
+  if (num_elems > capacity_) {
+    Grow(num_elems);
+  }
+  value_t* elems = data();
+  for (size_t i = size_; i < num_elems; ++i) {
+    new (elems + i) value_t(value);
+  }
+  size_ = static_cast<uint32_t>(num_elems);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::push_back(const value_t& value) {
+  if (size_ == capacity_) {
+    // The value might be an element of this vector.
+    const value_t value_copy = value;
+    Grow(size_ + 1);
+    new (data() + size_) value_t(value_copy);
+  } else {
+    new (data() + size_) value_t(value);
+  }
+  size_ += 1;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+template <typename... args_t>
+void SmallVector<value_t, kNumInlineElems>::emplace_back(args_t&&... args) {
+  push_back(value_t(std::forward<args_t>(args)...));
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::pop_back() {
+  size_ -= 1;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+template <typename InputIt>
+void SmallVector<value_t, kNumInlineElems>::assign(InputIt first,
+                                                   InputIt last) {
+  clear();
+  insert(end(), first, last);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+template <typename InputIt>
+typename SmallVector<value_t, kNumInlineElems>::iterator
+SmallVector<value_t, kNumInlineElems>::insert(const_iterator pos,
+                                              InputIt first, InputIt last) {
+  const size_t idx = pos - data();
+  const size_t num_elems = std::distance(first, last);
+  if (num_elems == 0) {
+    return data() + idx;
+  }
+  if (size_ + num_elems > capacity_) {
+    // The inserted range might be part of this vector, so the old elements are
+    // only released after the range is copied into the new elements.
+    const size_t new_capacity = std::max(static_cast<size_t>(size_) + num_elems,
+                                         2 * static_cast<size_t>(capacity_));
+    value_t* old_elems = data();
+    value_t* new_elems =
+        static_cast<value_t*>(::operator new(new_capacity * sizeof(value_t)));
+    std::memcpy(new_elems, old_elems, idx * sizeof(value_t));
+    std::copy(first, last, new_elems + idx);
+    std::memcpy(new_elems + idx + num_elems, old_elems + idx,
+                (size_ - idx) * sizeof(value_t));
+    if (!IsInline()) {
+      ::operator delete(old_elems);
+    }
+    heap_elems_ = new_elems;
+    capacity_ = static_cast<uint32_t>(new_capacity);
+    size_ += static_cast<uint32_t>(num_elems);
+    return new_elems + idx;
+  }
+  // Append the range first, which leaves it intact if it is part of this
+  // vector, and then rotate it into place.
+  value_t* elems = data();
+  std::copy(first, last, elems + size_);
+  std::rotate(elems + idx, elems + size_, elems + size_ + num_elems);
+  size_ += static_cast<uint32_t>(num_elems);
+  return elems + idx;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::iterator
+SmallVector<value_t, kNumInlineElems>::erase(const_iterator pos) {
+  return erase(pos, pos + 1);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+typename SmallVector<value_t, kNumInlineElems>::iterator
+SmallVector<value_t, kNumInlineElems>::erase(const_iterator first,
+                                             const_iterator last) {
+  value_t* elems = data();
+  const size_t first_idx = first - elems;
+  const size_t last_idx = last - elems;
+  std::memmove(elems + first_idx, elems + last_idx,
+               (size_ - last_idx) * sizeof(value_t));
+  size_ -= static_cast<uint32_t>(last_idx - first_idx);
+  return elems + first_idx;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+bool SmallVector<value_t, kNumInlineElems>::operator==(
+    const SmallVector& other) const {
+  return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+}
+
+template <typename value_t, size_t kNumInlineElems>
+bool SmallVector<value_t, kNumInlineElems>::operator!=(
+    const SmallVector& other) const {
+  return !(*this == other);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+bool SmallVector<value_t, kNumInlineElems>::IsInline() const {
+  return capacity_ == kNumInlineElems;
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::Reallocate(const size_t capacity) {
+  CHECK_GE(capacity, size_);
+  CHECK_GE(capacity, kNumInlineElems);
+  if (capacity == capacity_) {
+    return;
+  }
+  value_t* old_elems = data();
+  const bool was_inline = IsInline();
+  if (capacity == kNumInlineElems) {
+    // Copy the heap elements into the inline storage, which shares its memory
+    // with the heap pointer.
+    value_t* heap_elems = heap_elems_;
+    std::memcpy(&inline_elems_, heap_elems, size_ * sizeof(value_t));
+    ::operator delete(heap_elems);
+  } else {
+    value_t* new_elems =
+        static_cast<value_t*>(::operator new(capacity * sizeof(value_t)));
+    std::memcpy(new_elems, old_elems, size_ * sizeof(value_t));
+    if (!was_inline) {
+      ::operator delete(old_elems);
+    }
+    heap_elems_ = new_elems;
+  }
+  capacity_ = static_cast<uint32_t>(capacity);
+}
+
+template <typename value_t, size_t kNumInlineElems>
+void SmallVector<value_t, kNumInlineElems>::Grow(const size_t min_capacity) {
+  Reallocate(std::max(min_capacity, 2 * static_cast<size_t>(capacity_)));
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_SMALL_VECTOR_H_
@@ -0,0 +1,120 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+#define TEST_NAME "util/small_vector"
+#include "util/testing.h"
+
+#include <vector>
+
+#include "util/small_vector.h"
+
+using namespace colmap;
+
+typedef SmallVector<int, 2> IntVector;
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  IntVector vector;
+  BOOST_CHECK_EQUAL(vector.size(), 0);
+  BOOST_CHECK(vector.empty());
+  BOOST_CHECK_EQUAL(vector.capacity(), 2);
+  BOOST_CHECK(vector.begin() == vector.end());
+}
+
+BOOST_AUTO_TEST_CASE(TestPushBack) {
+  IntVector vector;
+  vector.push_back(0);
+  vector.emplace_back(1);
+  BOOST_CHECK_EQUAL(vector.size(), 2);
+  BOOST_CHECK_EQUAL(vector.capacity(), 2);
+  vector.push_back(vector[0]);
+  BOOST_CHECK_EQUAL(vector.size(), 3);
+  BOOST_CHECK_EQUAL(vector.capacity(), 4);
+  BOOST_CHECK_EQUAL(vector[0], 0);
+  BOOST_CHECK_EQUAL(vector[1], 1);
+  BOOST_CHECK_EQUAL(vector[2], 0);
+  BOOST_CHECK_EQUAL(vector.front(), 0);
+  BOOST_CHECK_EQUAL(vector.back(), 0);
+  vector.pop_back();
+  BOOST_CHECK_EQUAL(vector.back(), 1);
+  vector.clear();
+  BOOST_CHECK(vector.empty());
+  BOOST_CHECK_EQUAL(vector.capacity(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestReserve) {
+  IntVector vector;
+  vector.reserve(1);
+  BOOST_CHECK_EQUAL(vector.capacity(), 2);
+  vector.reserve(5);
+  BOOST_CHECK_EQUAL(vector.capacity(), 5);
+  vector.resize(3, 7);
+  BOOST_CHECK_EQUAL(vector.size(), 3);
+  BOOST_CHECK_EQUAL(vector[2], 7);
+  vector.shrink_to_fit();
+  BOOST_CHECK_EQUAL(vector.capacity(), 3);
+  vector.resize(1);
+  vector.shrink_to_fit();
+  BOOST_CHECK_EQUAL(vector.capacity(), 2);
+  BOOST_CHECK_EQUAL(vector[0], 7);
+}
+
+BOOST_AUTO_TEST_CASE(TestInsertAndErase) {
+  IntVector vector = {0, 1, 2};
+  vector.insert(vector.begin() + 1, vector.begin(), vector.end());
+  BOOST_CHECK(vector == IntVector({0, 0, 1, 2, 1, 2}));
+  vector.erase(vector.begin());
+  BOOST_CHECK(vector == IntVector({0, 1, 2, 1, 2}));
+  vector.erase(vector.begin() + 1, vector.begin() + 3);
+  BOOST_CHECK(vector == IntVector({0, 1, 2}));
+  const std::vector<int> other = {3, 4};
+  vector.insert(vector.end(), other.begin(), other.end());
+  BOOST_CHECK(vector == IntVector({0, 1, 2, 3, 4}));
+  vector.assign(other.begin(), other.end());
+  BOOST_CHECK(vector == IntVector({3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(TestCopyAndMove) {
+  for (const size_t size : {1, 2, 5}) {
+    IntVector vector;
+    for (size_t i = 0; i < size; ++i) {
+      vector.push_back(static_cast<int>(i));
+    }
+    IntVector copy = vector;
+    BOOST_CHECK(copy == vector);
+    IntVector moved = std::move(copy);
+    BOOST_CHECK(moved == vector);
+    BOOST_CHECK(copy.empty());
+    copy = vector;
+    moved = std::move(copy);
+    BOOST_CHECK(moved == vector);
+    BOOST_CHECK(moved != IntVector());
+  }
+}
@@ -31,6 +31,14 @@
 
 #include "util/threading.h"
 
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #include "util/logging.h"
 
 namespace colmap {
@@ -173,6 +181,10 @@ bool Thread::CheckValidSetup() {
 }
 
 void Thread::RunFunc() {
+  if (IsNumaThreadPinningEnabled()) {
+    static std::atomic<int> next_node_idx(0);
+    PinThreadToNumaNode(next_node_idx++ % GetNumaNodeCores().size());
+  }
   Callback(STARTED_CALLBACK);
   Run();
   {
@@ -183,9 +195,77 @@ void Thread::RunFunc() {
   Callback(FINISHED_CALLBACK);
 }
 
+namespace {
+
+// The thread pool and worker index of the current thread.
+thread_local ThreadPool* current_thread_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+std::atomic<bool> numa_thread_pinning(false);
+
+// Parse a list of cores in the format of the kernel, e.g., "0-3,8,10-11".
+std::vector<int> ParseCoreList(const std::string& core_list) {
+  std::vector<int> cores;
+  std::stringstream stream(core_list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    const size_t sep_pos = range.find('-');
+    try {
+      const int first = std::stoi(range.substr(0, sep_pos));
+      const int last = sep_pos == std::string::npos
+                           ? first
+                           : std::stoi(range.substr(sep_pos + 1));
+      for (int core = first; core <= last; ++core) {
+        cores.push_back(core);
+      }
+    } catch (const std::exception&) {
+      continue;
+    }
+  }
+  return cores;
+}
+
+std::vector<std::vector<int>> ReadNumaNodeCores() {
+  std::vector<std::vector<int>> node_cores;
+#ifdef __linux__
+  while (true) {
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node_cores.size()) + "/cpulist");
+    if (!file.is_open()) {
+      break;
+    }
+    std::string core_list;
+    std::getline(file, core_list);
+    node_cores.push_back(ParseCoreList(core_list));
+  }
+#endif
+
+  // Nodes without cores only provide memory and are not used for pinning.
+  node_cores.erase(std::remove_if(node_cores.begin(), node_cores.end(),
+                                  [](const std::vector<int>& cores) {
+                                    return cores.empty();
+                                  }),
+                   node_cores.end());
+
+  if (node_cores.empty()) {
+    node_cores.emplace_back(GetEffectiveNumThreads(-1));
+    for (size_t core = 0; core < node_cores[0].size(); ++core) {
+      node_cores[0][core] = static_cast<int>(core);
+    }
+  }
+
+  return node_cores;
+}
+
+}  // namespace
+
 ThreadPool::ThreadPool(const int num_threads)
-    : stopped_(false), num_active_workers_(0) {
+    : stopped_(false), num_queued_tasks_(0), num_unfinished_tasks_(0) {
   const int num_effective_threads = GetEffectiveNumThreads(num_threads);
+  worker_queues_.reserve(num_effective_threads);
+  for (int index = 0; index < num_effective_threads; ++index) {
+    worker_queues_.emplace_back(new TaskQueue());
+  }
   for (int index = 0; index < num_effective_threads; ++index) {
     std::function<void(void)> worker =
         std::bind(&ThreadPool::WorkerFunc, this, index);
@@ -205,8 +285,21 @@ void ThreadPool::Stop() {
 
     stopped_ = true;
 
-    std::queue<std::function<void()>> empty_tasks;
-    std::swap(tasks_, empty_tasks);
+    // Discard all pending tasks, whose futures become invalid.
+    const auto ClearQueue = [this](TaskQueue* queue) {
+      std::unique_lock<std::mutex> queue_lock(queue->mutex);
+      for (auto& tasks : queue->tasks) {
+        num_queued_tasks_ -= static_cast<int>(tasks.size());
+        num_unfinished_tasks_ -= static_cast<int>(tasks.size());
+        tasks.clear();
+      }
+      queue->num_tasks = 0;
+    };
+
+    ClearQueue(&shared_queue_);
+    for (auto& queue : worker_queues_) {
+      ClearQueue(queue.get());
+    }
   }
 
   task_condition_.notify_all();
@@ -220,9 +313,101 @@ void ThreadPool::Stop() {
 
 void ThreadPool::Wait() {
   std::unique_lock<std::mutex> lock(mutex_);
-  if (!tasks_.empty() || num_active_workers_ > 0) {
-    finished_condition_.wait(
-        lock, [this]() { return tasks_.empty() && num_active_workers_ == 0; });
+  finished_condition_.wait(lock,
+                           [this]() { return num_unfinished_tasks_ == 0; });
+}
+
+bool ThreadPool::Wait(const double timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return finished_condition_.wait_for(
+      lock, std::chrono::duration<double>(timeout),
+      [this]() { return num_unfinished_tasks_ == 0; });
+}
+
+void ThreadPool::PushTask(const TaskPriority priority, Task task) {
+  const int worker_index = CurrentWorkerIndex();
+  TaskQueue* queue = worker_index >= 0
+                         ? worker_queues_[worker_index].get()
+                         : &shared_queue_;
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopped_) {
+      throw std::runtime_error("Cannot add task to stopped thread pool.");
+    }
+
+    {
+      std::unique_lock<std::mutex> queue_lock(queue->mutex);
+      queue->tasks[static_cast<int>(priority)].push_back(std::move(task));
+      queue->num_tasks += 1;
+    }
+
+    num_queued_tasks_ += 1;
+    num_unfinished_tasks_ += 1;
+  }
+
+  task_condition_.notify_one();
+}
+
+bool ThreadPool::PopTask(const int index, Task* task) {
+  const int num_workers = static_cast<int>(worker_queues_.size());
+
+  const auto PopFromQueue = [task](TaskQueue* queue, const int priority,
+                                   const bool from_back) {
+    if (queue->num_tasks == 0) {
+      return false;
+    }
+    std::unique_lock<std::mutex> queue_lock(queue->mutex);
+    auto& tasks = queue->tasks[priority];
+    if (tasks.empty()) {
+      return false;
+    }
+    if (from_back) {
+      *task = std::move(tasks.back());
+      tasks.pop_back();
+    } else {
+      *task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    queue->num_tasks -= 1;
+    return true;
+  };
+
+  for (int priority = kNumTaskPriorities - 1; priority >= 0; --priority) {
+    if (PopFromQueue(worker_queues_[index].get(), priority, true) ||
+        PopFromQueue(&shared_queue_, priority, false)) {
+      num_queued_tasks_ -= 1;
+      return true;
+    }
+    for (int i = 1; i < num_workers; ++i) {
+      const int victim_index = (index + i) % num_workers;
+      if (PopFromQueue(worker_queues_[victim_index].get(), priority, false)) {
+        num_queued_tasks_ -= 1;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool ThreadPool::RunPendingTask(const int index) {
+  Task task;
+  if (!PopTask(index, &task)) {
+    return false;
+  }
+  RunTask(&task);
+  return true;
+}
+
+void ThreadPool::RunTask(Task* task) {
+  (*task)();
+
+  if (--num_unfinished_tasks_ == 0) {
+    // Acquire the lock to not miss a waiting thread between the check of its
+    // condition and the start of its wait.
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_condition_.notify_all();
   }
 }
 
@@ -232,29 +417,31 @@ void ThreadPool::WorkerFunc(const int index) {
     thread_id_to_index_.emplace(GetThreadId(), index);
   }
 
-  while (true) {
-    std::function<void()> task;
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      task_condition_.wait(lock,
-                           [this] { return stopped_ || !tasks_.empty(); });
-      if (stopped_ && tasks_.empty()) {
-        return;
-      }
-      task = std::move(tasks_.front());
-      tasks_.pop();
-      num_active_workers_ += 1;
-    }
+  current_thread_pool = this;
+  current_worker_index = index;
 
-    task();
+  if (IsNumaThreadPinningEnabled()) {
+    // Neighboring workers are placed on the same node, as they usually
+    // process neighboring chunks of a static `ParallelFor`.
+    PinThreadToNumaNode(static_cast<int>(index * GetNumaNodeCores().size() /
+                                         worker_queues_.size()));
+  }
 
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      num_active_workers_ -= 1;
+  while (true) {
+    if (RunPendingTask(index)) {
+      continue;
     }
 
-    finished_condition_.notify_all();
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_condition_.wait(
+        lock, [this] { return stopped_ || num_queued_tasks_ > 0; });
+    if (stopped_ && num_queued_tasks_ == 0) {
+      break;
+    }
   }
+
+  current_thread_pool = nullptr;
+  current_worker_index = -1;
 }
 
 std::thread::id ThreadPool::GetThreadId() const {
@@ -266,6 +453,12 @@ int ThreadPool::GetThreadIndex() {
   return thread_id_to_index_.at(GetThreadId());
 }
 
+ThreadPool* ThreadPool::CurrentThreadPool() { return current_thread_pool; }
+
+int ThreadPool::CurrentWorkerIndex() const {
+  return current_thread_pool == this ? current_worker_index : -1;
+}
+
 int GetEffectiveNumThreads(const int num_threads) {
   int num_effective_threads = num_threads;
   if (num_threads <= 0) {
@@ -279,4 +472,34 @@ int GetEffectiveNumThreads(const int num_threads) {
   return num_effective_threads;
 }
 
+const std::vector<std::vector<int>>& GetNumaNodeCores() {
+  static const std::vector<std::vector<int>> node_cores = ReadNumaNodeCores();
+  return node_cores;
+}
+
+void SetNumaThreadPinning(const bool enabled) { numa_thread_pinning = enabled; }
+
+bool IsNumaThreadPinningEnabled() { return numa_thread_pinning; }
+
+bool PinThreadToNumaNode(const int node_idx) {
+  const auto& node_cores = GetNumaNodeCores();
+  if (node_idx < 0 || node_idx >= static_cast<int>(node_cores.size())) {
+    return false;
+  }
+
+#ifdef __linux__
+  cpu_set_t core_set;
+  CPU_ZERO(&core_set);
+  for (const int core : node_cores[node_idx]) {
+    if (core < CPU_SETSIZE) {
+      CPU_SET(core, &core_set);
+    }
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(core_set),
+                                &core_set) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace colmap
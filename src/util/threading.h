@@ -32,13 +32,19 @@
 #ifndef COLMAP_SRC_UTIL_THREADING_
 #define COLMAP_SRC_UTIL_THREADING_
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <climits>
+#include <deque>
 #include <functional>
 #include <future>
 #include <list>
+#include <memory>
 #include <queue>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "util/timer.h"
 
@@ -205,10 +211,37 @@ class Thread {
 //    }
 //    thread_pool.Wait();
 //
+// Every worker has its own task queue. Tasks added from within a worker are
+// pushed to the queue of the worker, which processes its queue in LIFO order,
+// while tasks added from other threads are pushed to a shared queue. Idle
+// workers steal the oldest tasks from the queues of the other workers. Tasks
+// can add and wait for subtasks through `WaitForTask`, during which the
+// waiting worker executes other pending tasks instead of blocking the pool:
+//
+//    thread_pool.AddTask([&thread_pool]() {
+//      auto future = thread_pool.AddTask([]() { /* Do some work */ });
+//      /* Do some other work */
+//      thread_pool.WaitForTask(future);
+//    });
+//
+//    thread_pool.ParallelFor(0, 100, [](const size_t begin, const size_t end) {
+//      for (size_t i = begin; i < end; ++i) { /* Do some work */ }
+//    });
+//
 class ThreadPool {
  public:
   static const int kMaxNumThreads = -1;
 
+  // Pending tasks with higher priority are executed first.
+  enum class TaskPriority { LOW = 0, NORMAL = 1, HIGH = 2 };
+
+  // The partitioning of the iterations in `ParallelFor`. With static
+  // scheduling, every chunk of iterations is a separate task and the chunks
+  // are by default distributed evenly over the threads. With dynamic
+  // scheduling, every thread repeatedly takes the next chunk of iterations,
+  // which balances the load if the cost of the iterations varies.
+  enum class Schedule { STATIC, DYNAMIC };
+
   explicit ThreadPool(const int num_threads = kMaxNumThreads);
   ~ThreadPool();
 
@@ -219,12 +252,40 @@ class ThreadPool {
   auto AddTask(func_t&& f, args_t&&... args)
       -> std::future<typename std::result_of<func_t(args_t...)>::type>;
 
+  // Add new task with the given priority to the thread pool.
+  template <class func_t, class... args_t>
+  auto AddTaskWithPriority(const TaskPriority priority, func_t&& f,
+                           args_t&&... args)
+      -> std::future<typename std::result_of<func_t(args_t...)>::type>;
+
+  // Call func(chunk_begin, chunk_end) for chunks of the iterations in the
+  // range [begin, end) in parallel and wait until all chunks are processed.
+  // By default, the chunk size is chosen automatically. Can be called from
+  // within a task of the same thread pool for nested parallelism.
+  template <typename func_t>
+  void ParallelFor(const size_t begin, const size_t end, const func_t& func,
+                   const Schedule schedule = Schedule::STATIC,
+                   const size_t chunk_size = 0);
+
+  // Wait until the task of the given future finished. If called from within
+  // a task of this thread pool, the worker executes other pending tasks in
+  // the meantime. Note that the waiting task may therefore be interleaved
+  // with other tasks on the same thread, so it must not rely on per-thread
+  // state indexed by `GetThreadIndex` across the call.
+  template <typename T>
+  void WaitForTask(const std::future<T>& future);
+
   // Stop the execution of all workers.
   void Stop();
 
-  // Wait until tasks are finished.
+  // Wait until tasks are finished. Must not be called from within a task of
+  // the same thread pool, use `WaitForTask` instead.
   void Wait();
 
+  // Wait until tasks are finished or the timeout in seconds elapsed.
+  // Returns true if all tasks are finished.
+  bool Wait(const double timeout);
+
   // Get the unique identifier of the current thread.
   std::thread::id GetThreadId() const;
 
@@ -233,22 +294,123 @@ class ThreadPool {
   // In other words, there are the thread indices 0, ..., N-1.
   int GetThreadIndex();
 
+  // Get the thread pool of which the current thread is a worker or null if
+  // the current thread is not a worker of any thread pool.
+  static ThreadPool* CurrentThreadPool();
+
  private:
+  // Type-erased task, which can be moved but not copied, such that a
+  // `std::packaged_task` can be stored directly without a shared pointer.
+  class Task {
+   public:
+    Task() {}
+
+    template <typename func_t>
+    explicit Task(func_t&& func)
+        : impl_(new Impl<typename std::decay<func_t>::type>(
+              std::forward<func_t>(func))) {}
+
+    void operator()() { impl_->Run(); }
+
+   private:
+    struct ImplBase {
+      virtual ~ImplBase() = default;
+      virtual void Run() = 0;
+    };
+
+    template <typename func_t>
+    struct Impl : public ImplBase {
+      template <typename arg_t>
+      explicit Impl(arg_t&& func) : func(std::forward<arg_t>(func)) {}
+      void Run() override { func(); }
+      func_t func;
+    };
+
+    std::unique_ptr<ImplBase> impl_;
+  };
+
+  static const int kNumTaskPriorities = 3;
+
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks[kNumTaskPriorities];
+    std::atomic<int> num_tasks{0};
+  };
+
   void WorkerFunc(const int index);
 
+  // Push the task to the queue of the current worker or to the shared queue.
+  void PushTask(const TaskPriority priority, Task task);
+
+  // Pop the next task for the worker with the given index in the order of
+  // the priorities, first from its own queue, then from the shared queue,
+  // and finally from the queues of the other workers.
+  bool PopTask(const int index, Task* task);
+  bool RunPendingTask(const int index);
+  void RunTask(Task* task);
+
+  // Index of the current thread if it is a worker of this pool, else -1.
+  int CurrentWorkerIndex() const;
+
   std::vector<std::thread> workers_;
-  std::queue<std::function<void()>> tasks_;
+  std::vector<std::unique_ptr<TaskQueue>> worker_queues_;
+  TaskQueue shared_queue_;
 
   std::mutex mutex_;
   std::condition_variable task_condition_;
   std::condition_variable finished_condition_;
 
   bool stopped_;
-  int num_active_workers_;
+  std::atomic<int> num_queued_tasks_;
+  std::atomic<int> num_unfinished_tasks_;
 
   std::unordered_map<std::thread::id, int> thread_id_to_index_;
 };
 
+namespace internal {
+
+// Lock-free multi-producer multi-consumer queue with a fixed capacity. The jobs
+// are stored in a ring buffer, in which every cell has a sequence number that
+// tells producers and consumers whether the cell can be written or read in
+// the current round over the ring, see D. Vyukov, "Bounded MPMC queue". The
+// capacity must be at least two.
+template <typename T>
+class RingBufferQueue {
+ public:
+  explicit RingBufferQueue(const size_t capacity);
+
+  // Push or pop a job without waiting. Returns false if the queue is full or
+  // empty, respectively.
+  bool TryPush(T&& data);
+  bool TryPop(T* data);
+
+  // Check whether a job could be pushed or popped. The result can already be
+  // outdated, if other threads push or pop at the same time.
+  bool CanPush() const;
+  bool CanPop() const;
+
+  // The number of pushed and not popped jobs.
+  size_t Size() const;
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  const size_t capacity_;
+  std::unique_ptr<Cell[]> cells_;
+
+  // Producers and consumers modify their position on separate cache lines.
+  char padding1_[64];
+  std::atomic<size_t> push_pos_;
+  char padding2_[64];
+  std::atomic<size_t> pop_pos_;
+  char padding3_[64];
+};
+
+}  // namespace internal
+
 // A job queue class for the producer-consumer paradigm.
 //
 //    JobQueue<int> job_queue;
@@ -270,6 +432,10 @@ class ThreadPool {
 //    producer_thread.join();
 //    consumer_thread.join();
 //
+// Queues with a maximum of two or more jobs are lock-free, see
+// `internal::RingBufferQueue`. Waiting push and pop calls first spin for a
+// short time, before they are parked until the queue changes. The jobs are
+// moved into and out of the queue, such that move-only types can be queued.
 template <typename T>
 class JobQueue {
  public:
@@ -277,6 +443,7 @@ class JobQueue {
    public:
     Job() : valid_(false) {}
     explicit Job(const T& data) : data_(data), valid_(true) {}
+    explicit Job(T&& data) : data_(std::move(data)), valid_(true) {}
 
     // Check whether the data is valid.
     bool IsValid() const { return valid_; }
@@ -290,6 +457,9 @@ class JobQueue {
     bool valid_;
   };
 
+  // Queues with more jobs use a mutex instead of a preallocated ring buffer.
+  static const size_t kMaxNumRingBufferJobs = 1 << 16;
+
   JobQueue();
   explicit JobQueue(const size_t max_num_jobs);
   ~JobQueue();
@@ -299,10 +469,23 @@ class JobQueue {
 
   // Push a new job to the queue. Waits if the number of jobs is exceeded.
   bool Push(const T& data);
+  bool Push(T&& data);
+
+  // Push multiple jobs in their order. Waits whenever the number of jobs is
+  // exceeded and returns false if the queue is stopped in the meantime.
+  bool PushBatch(std::vector<T> data);
 
   // Pop a job from the queue. Waits if there is no job in the queue.
   Job Pop();
 
+  // Pop a job from the queue without waiting. Returns an invalid job if there
+  // is no job in the queue or the queue is stopped.
+  Job TryPop();
+
+  // Pop up to the given number of jobs without waiting and append them to the
+  // given list. Returns the number of popped jobs.
+  size_t TryPopBatch(const size_t max_num_jobs, std::vector<T>* data);
+
   // Wait for all jobs to be popped and then stop the queue.
   void Wait();
 
@@ -313,19 +496,61 @@ class JobQueue {
   void Clear();
 
  private:
+  // Push or pop a single job without waiting.
+  bool TryPushJob(T&& data);
+  bool TryPopJob(T* data);
+
+  // Spin and then park the calling thread until the condition is true.
+  template <typename condition_t>
+  void WaitFor(const condition_t& condition);
+
+  // Wake up the parked threads after the queue has changed.
+  void NotifyParked();
+
   size_t max_num_jobs_;
   std::atomic<bool> stop_;
+  std::unique_ptr<internal::RingBufferQueue<T>> ring_buffer_jobs_;
   std::queue<T> jobs_;
+  std::mutex jobs_mutex_;
+  std::atomic<int> num_parked_;
   std::mutex mutex_;
-  std::condition_variable push_condition_;
-  std::condition_variable pop_condition_;
-  std::condition_variable empty_condition_;
+  std::condition_variable condition_;
 };
 
 // Return the number of logical CPU cores if num_threads <= 0,
 // otherwise return the input value of num_threads.
 int GetEffectiveNumThreads(const int num_threads);
 
+// Return the logical CPU cores of every NUMA node of the machine, as reported
+// by the kernel on Linux. If the topology is unknown, all cores are reported
+// as a single node.
+const std::vector<std::vector<int>>& GetNumaNodeCores();
+
+// Enable or disable the pinning of new threads to NUMA nodes. If enabled, the
+// workers of a `ThreadPool` are distributed in contiguous blocks and every
+// `Thread` round-robin over the NUMA nodes, and they only run on the cores of
+// their node. The threads then no longer migrate between sockets and the
+// memory they touch first, e.g., per-worker buffers that are allocated in
+// the tasks, resides on their node. Pinning is only supported on Linux.
+void SetNumaThreadPinning(const bool enabled);
+bool IsNumaThreadPinningEnabled();
+
+// Restrict the calling thread to the cores of the given NUMA node. Returns
+// false if the node does not exist or pinning is not supported.
+bool PinThreadToNumaNode(const int node_idx);
+
+// Call func(chunk_begin, chunk_end) for chunks of the iterations in the range
+// [begin, end) using the given number of threads, see
+// `ThreadPool::ParallelFor`. If called from within a task of a thread pool
+// with enough workers, the iterations are processed by that thread pool,
+// otherwise by a temporary thread pool.
+template <typename func_t>
+void ParallelFor(
+    const int num_threads, const size_t begin, const size_t end,
+    const func_t& func,
+    const ThreadPool::Schedule schedule = ThreadPool::Schedule::STATIC,
+    const size_t chunk_size = 0);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -335,32 +560,232 @@ size_t ThreadPool::NumThreads() const { return workers_.size(); }
 template <class func_t, class... args_t>
 auto ThreadPool::AddTask(func_t&& f, args_t&&... args)
     -> std::future<typename std::result_of<func_t(args_t...)>::type> {
+  return AddTaskWithPriority(TaskPriority::NORMAL, std::forward<func_t>(f),
+                             std::forward<args_t>(args)...);
+}
+
+template <class func_t, class... args_t>
+auto ThreadPool::AddTaskWithPriority(const TaskPriority priority, func_t&& f,
+                                     args_t&&... args)
+    -> std::future<typename std::result_of<func_t(args_t...)>::type> {
   typedef typename std::result_of<func_t(args_t...)>::type return_t;
 
-  auto task = std::make_shared<std::packaged_task<return_t()>>(
+  std::packaged_task<return_t()> task(
       std::bind(std::forward<func_t>(f), std::forward<args_t>(args)...));
 
-  std::future<return_t> result = task->get_future();
+  std::future<return_t> result = task.get_future();
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (stopped_) {
-      throw std::runtime_error("Cannot add task to stopped thread pool.");
+  PushTask(priority, Task(std::move(task)));
+
+  return result;
+}
+
+template <typename func_t>
+void ThreadPool::ParallelFor(const size_t begin, const size_t end,
+                             const func_t& func, const Schedule schedule,
+                             const size_t chunk_size) {
+  if (begin >= end) {
+    return;
+  }
+
+  const size_t num_items = end - begin;
+  const size_t num_threads = std::max<size_t>(1, NumThreads());
+
+  std::vector<std::future<void>> futures;
+
+  if (schedule == Schedule::STATIC) {
+    const size_t num_items_per_chunk =
+        chunk_size > 0 ? chunk_size
+                       : (num_items + num_threads - 1) / num_threads;
+    futures.reserve((num_items + num_items_per_chunk - 1) /
+                    num_items_per_chunk);
+    for (size_t chunk_begin = begin; chunk_begin < end;
+         chunk_begin += num_items_per_chunk) {
+      const size_t chunk_end =
+          chunk_begin + std::min(num_items_per_chunk, end - chunk_begin);
+      futures.push_back(AddTask(
+          [&func, chunk_begin, chunk_end]() { func(chunk_begin, chunk_end); }));
+    }
+  } else {
+    // Use multiple chunks per thread to balance the load between the threads.
+    const size_t kNumChunksPerThread = 4;
+    const size_t num_items_per_chunk =
+        chunk_size > 0 ? chunk_size
+                       : std::max<size_t>(1, num_items / (kNumChunksPerThread *
+                                                          num_threads));
+    const size_t num_chunks =
+        (num_items + num_items_per_chunk - 1) / num_items_per_chunk;
+
+    std::atomic<size_t> next_chunk(0);
+    const auto ProcessChunks = [&]() {
+      while (true) {
+        const size_t chunk_idx = next_chunk++;
+        if (chunk_idx >= num_chunks) {
+          break;
+        }
+        const size_t chunk_begin = begin + chunk_idx * num_items_per_chunk;
+        const size_t chunk_end =
+            chunk_begin + std::min(num_items_per_chunk, end - chunk_begin);
+        func(chunk_begin, chunk_end);
+      }
+    };
+
+    const size_t num_tasks = std::min(num_threads, num_chunks);
+    futures.reserve(num_tasks);
+    for (size_t i = 0; i < num_tasks; ++i) {
+      futures.push_back(AddTask(ProcessChunks));
     }
-    tasks_.emplace([task]() { (*task)(); });
   }
 
-  task_condition_.notify_one();
+  // All tasks reference local state, so wait for all of them to finish before
+  // propagating any exceptions.
+  for (const auto& future : futures) {
+    WaitForTask(future);
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
 
-  return result;
+template <typename T>
+void ThreadPool::WaitForTask(const std::future<T>& future) {
+  const int index = CurrentWorkerIndex();
+  if (index < 0) {
+    future.wait();
+    return;
+  }
+
+  while (future.wait_for(std::chrono::seconds(0)) !=
+         std::future_status::ready) {
+    if (!RunPendingTask(index)) {
+      future.wait_for(std::chrono::microseconds(100));
+    }
+  }
 }
 
+template <typename func_t>
+void ParallelFor(const int num_threads, const size_t begin, const size_t end,
+                 const func_t& func, const ThreadPool::Schedule schedule,
+                 const size_t chunk_size) {
+  if (begin >= end) {
+    return;
+  }
+
+  const size_t num_chunks =
+      chunk_size > 0 ? (end - begin + chunk_size - 1) / chunk_size
+                     : end - begin;
+  const size_t num_eff_threads =
+      std::min<size_t>(GetEffectiveNumThreads(num_threads), num_chunks);
+  if (num_eff_threads <= 1) {
+    func(begin, end);
+    return;
+  }
+
+  ThreadPool* current_thread_pool = ThreadPool::CurrentThreadPool();
+  if (current_thread_pool != nullptr &&
+      current_thread_pool->NumThreads() >= num_eff_threads) {
+    current_thread_pool->ParallelFor(begin, end, func, schedule, chunk_size);
+    return;
+  }
+
+  ThreadPool thread_pool(static_cast<int>(num_eff_threads));
+  thread_pool.ParallelFor(begin, end, func, schedule, chunk_size);
+}
+
+namespace internal {
+
+template <typename T>
+RingBufferQueue<T>::RingBufferQueue(const size_t capacity)
+    : capacity_(capacity),
+      cells_(new Cell[capacity]),
+      push_pos_(0),
+      pop_pos_(0) {
+  for (size_t i = 0; i < capacity_; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool RingBufferQueue<T>::TryPush(T&& data) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos % capacity_];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      if (push_pos_.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+        cell.data = std::move(data);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos) {
+      // The cell still holds the job of the previous round.
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool RingBufferQueue<T>::TryPop(T* data) {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos % capacity_];
+    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence == pos + 1) {
+      if (pop_pos_.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+        *data = std::move(cell.data);
+        cell.sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos + 1) {
+      // The cell is not yet written in the current round.
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool RingBufferQueue<T>::CanPush() const {
+  const size_t pos = push_pos_.load();
+  return cells_[pos % capacity_].sequence.load() == pos;
+}
+
+template <typename T>
+bool RingBufferQueue<T>::CanPop() const {
+  const size_t pos = pop_pos_.load();
+  return cells_[pos % capacity_].sequence.load() == pos + 1;
+}
+
+template <typename T>
+size_t RingBufferQueue<T>::Size() const {
+  // Load the pop position first, so that the size cannot be negative.
+  const size_t pop_pos = pop_pos_.load();
+  const size_t push_pos = push_pos_.load();
+  return std::min(push_pos - pop_pos, capacity_);
+}
+
+}  // namespace internal
+
+template <typename T>
+const size_t JobQueue<T>::kMaxNumRingBufferJobs;
+
 template <typename T>
 JobQueue<T>::JobQueue() : JobQueue(std::numeric_limits<size_t>::max()) {}
 
 template <typename T>
 JobQueue<T>::JobQueue(const size_t max_num_jobs)
-    : max_num_jobs_(max_num_jobs), stop_(false) {}
+    : max_num_jobs_(max_num_jobs), stop_(false), num_parked_(0) {
+  // With a single cell, the sequence number of a written cell would equal the
+  // sequence number of the cell in the next round.
+  if (max_num_jobs_ > 1 && max_num_jobs_ <= kMaxNumRingBufferJobs) {
+    ring_buffer_jobs_.reset(new internal::RingBufferQueue<T>(max_num_jobs_));
+  }
+}
 
 template <typename T>
 JobQueue<T>::~JobQueue() {
@@ -369,64 +794,172 @@ JobQueue<T>::~JobQueue() {
 
 template <typename T>
 size_t JobQueue<T>::Size() {
-  std::unique_lock<std::mutex> lock(mutex_);
+  if (ring_buffer_jobs_) {
+    return ring_buffer_jobs_->Size();
+  }
+  std::unique_lock<std::mutex> lock(jobs_mutex_);
   return jobs_.size();
 }
 
 template <typename T>
 bool JobQueue<T>::Push(const T& data) {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.size() >= max_num_jobs_ && !stop_) {
-    pop_condition_.wait(lock);
+  T data_copy = data;
+  return Push(std::move(data_copy));
+}
+
+template <typename T>
+bool JobQueue<T>::Push(T&& data) {
+  while (!stop_) {
+    if (TryPushJob(std::move(data))) {
+      NotifyParked();
+      return true;
+    }
+    WaitFor([this]() {
+      return stop_ ||
+             (ring_buffer_jobs_ ? ring_buffer_jobs_->CanPush()
+                                : Size() < max_num_jobs_);
+    });
   }
-  if (stop_) {
-    return false;
-  } else {
-    jobs_.push(data);
-    push_condition_.notify_one();
-    return true;
+  return false;
+}
+
+template <typename T>
+bool JobQueue<T>::PushBatch(std::vector<T> data) {
+  size_t num_pushed = 0;
+  while (!stop_ && num_pushed < data.size()) {
+    while (num_pushed < data.size() &&
+           TryPushJob(std::move(data[num_pushed]))) {
+      num_pushed += 1;
+    }
+    NotifyParked();
+    if (num_pushed < data.size()) {
+      WaitFor([this]() {
+        return stop_ ||
+               (ring_buffer_jobs_ ? ring_buffer_jobs_->CanPush()
+                                  : Size() < max_num_jobs_);
+      });
+    }
   }
+  return num_pushed == data.size();
 }
 
 template <typename T>
 typename JobQueue<T>::Job JobQueue<T>::Pop() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.empty() && !stop_) {
-    push_condition_.wait(lock);
+  T data;
+  while (!stop_) {
+    if (TryPopJob(&data)) {
+      NotifyParked();
+      return Job(std::move(data));
+    }
+    WaitFor([this]() {
+      return stop_ ||
+             (ring_buffer_jobs_ ? ring_buffer_jobs_->CanPop() : Size() > 0);
+    });
   }
-  if (stop_) {
+  return Job();
+}
+
+template <typename T>
+typename JobQueue<T>::Job JobQueue<T>::TryPop() {
+  T data;
+  if (stop_ || !TryPopJob(&data)) {
     return Job();
-  } else {
-    const T data = jobs_.front();
-    jobs_.pop();
-    pop_condition_.notify_one();
-    if (jobs_.empty()) {
-      empty_condition_.notify_all();
-    }
-    return Job(data);
   }
+  NotifyParked();
+  return Job(std::move(data));
 }
 
 template <typename T>
-void JobQueue<T>::Wait() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  while (!jobs_.empty()) {
-    empty_condition_.wait(lock);
+size_t JobQueue<T>::TryPopBatch(const size_t max_num_jobs,
+                                std::vector<T>* data) {
+  size_t num_popped = 0;
+  T job_data;
+  while (!stop_ && num_popped < max_num_jobs && TryPopJob(&job_data)) {
+    data->push_back(std::move(job_data));
+    num_popped += 1;
   }
+  if (num_popped > 0) {
+    NotifyParked();
+  }
+  return num_popped;
+}
+
+template <typename T>
+void JobQueue<T>::Wait() {
+  WaitFor([this]() { return Size() == 0; });
 }
 
 template <typename T>
 void JobQueue<T>::Stop() {
   stop_ = true;
-  push_condition_.notify_all();
-  pop_condition_.notify_all();
+  NotifyParked();
 }
 
 template <typename T>
 void JobQueue<T>::Clear() {
+  T data;
+  while (TryPopJob(&data)) {
+  }
+  NotifyParked();
+}
+
+template <typename T>
+bool JobQueue<T>::TryPushJob(T&& data) {
+  if (ring_buffer_jobs_) {
+    return ring_buffer_jobs_->TryPush(std::move(data));
+  }
+  std::unique_lock<std::mutex> lock(jobs_mutex_);
+  if (jobs_.size() >= max_num_jobs_) {
+    return false;
+  }
+  jobs_.push(std::move(data));
+  return true;
+}
+
+template <typename T>
+bool JobQueue<T>::TryPopJob(T* data) {
+  if (ring_buffer_jobs_) {
+    return ring_buffer_jobs_->TryPop(data);
+  }
+  std::unique_lock<std::mutex> lock(jobs_mutex_);
+  if (jobs_.empty()) {
+    return false;
+  }
+  *data = std::move(jobs_.front());
+  jobs_.pop();
+  return true;
+}
+
+template <typename T>
+template <typename condition_t>
+void JobQueue<T>::WaitFor(const condition_t& condition) {
+  // Most waits in a busy pipeline are short, so spinning avoids the latency
+  // of parking and waking up the thread.
+  const int kNumSpins = 64;
+  for (int i = 0; i < kNumSpins; ++i) {
+    if (condition()) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
   std::unique_lock<std::mutex> lock(mutex_);
-  std::queue<T> empty_jobs;
-  std::swap(jobs_, empty_jobs);
+  num_parked_ += 1;
+  // Pairs with the fence in NotifyParked, such that either the condition
+  // observes the change of the queue or the notifier observes the parked
+  // thread.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  condition_.wait(lock, condition);
+  num_parked_ -= 1;
+}
+
+template <typename T>
+void JobQueue<T>::NotifyParked() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_parked_ > 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.notify_all();
+  }
 }
 
 }  // namespace colmap
@@ -638,6 +638,171 @@ BOOST_AUTO_TEST_CASE(TestThreadPoolGetThreadIndex) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestThreadPoolWaitTimeout) {
+  ThreadPool pool(1);
+
+  std::atomic<bool> finished(false);
+  pool.AddTask([&finished]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    finished = true;
+  });
+
+  BOOST_CHECK(!pool.Wait(0.01));
+  BOOST_CHECK(!finished);
+  BOOST_CHECK(pool.Wait(10.0));
+  BOOST_CHECK(finished);
+  BOOST_CHECK(pool.Wait(0.0));
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolTaskPriority) {
+  ThreadPool pool(1);
+
+  std::promise<void> blocker;
+  std::shared_future<void> blocked = blocker.get_future().share();
+  pool.AddTask([blocked]() { blocked.wait(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::vector<int> order;
+  std::function<void(int)> Func = [&order](const int num) {
+    order.push_back(num);
+  };
+
+  pool.AddTaskWithPriority(ThreadPool::TaskPriority::LOW, Func, 0);
+  pool.AddTaskWithPriority(ThreadPool::TaskPriority::NORMAL, Func, 1);
+  pool.AddTaskWithPriority(ThreadPool::TaskPriority::HIGH, Func, 2);
+  pool.AddTask(Func, 3);
+  pool.AddTaskWithPriority(ThreadPool::TaskPriority::HIGH, Func, 4);
+
+  blocker.set_value();
+  pool.Wait();
+
+  BOOST_CHECK_EQUAL(order.size(), 5);
+  BOOST_CHECK_EQUAL(order[0], 2);
+  BOOST_CHECK_EQUAL(order[1], 4);
+  BOOST_CHECK_EQUAL(order[2], 1);
+  BOOST_CHECK_EQUAL(order[3], 3);
+  BOOST_CHECK_EQUAL(order[4], 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolNestedTasks) {
+  // More waiting outer tasks than workers would deadlock the pool, if the
+  // workers did not execute the subtasks while waiting for them.
+  ThreadPool pool(2);
+
+  std::atomic<int> num_subtasks(0);
+  std::function<int(int)> Func = [&](const int num) {
+    std::vector<std::future<void>> futures;
+    for (int i = 0; i < 10; ++i) {
+      futures.push_back(pool.AddTask([&num_subtasks]() { num_subtasks++; }));
+    }
+    for (const auto& future : futures) {
+      pool.WaitForTask(future);
+    }
+    return num;
+  };
+
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 8; ++i) {
+    futures.push_back(pool.AddTask(Func, i));
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(futures[i].get(), i);
+  }
+
+  BOOST_CHECK_EQUAL(num_subtasks, 80);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolParallelFor) {
+  ThreadPool pool(4);
+
+  for (const auto schedule :
+       {ThreadPool::Schedule::STATIC, ThreadPool::Schedule::DYNAMIC}) {
+    for (const size_t chunk_size : {0, 1, 7, 1000}) {
+      std::vector<std::atomic<int>> counts(103);
+      for (auto& count : counts) {
+        count = 0;
+      }
+      pool.ParallelFor(
+          3, counts.size(),
+          [&](const size_t begin, const size_t end) {
+            CHECK_LT(begin, end);
+            if (chunk_size > 0) {
+              CHECK_LE(end - begin, chunk_size);
+            }
+            for (size_t i = begin; i < end; ++i) {
+              counts[i]++;
+            }
+          },
+          schedule, chunk_size);
+      for (size_t i = 0; i < counts.size(); ++i) {
+        BOOST_CHECK_EQUAL(counts[i], i < 3 ? 0 : 1);
+      }
+    }
+  }
+
+  pool.ParallelFor(5, 5, [](const size_t, const size_t) { CHECK(false); });
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolNestedParallelFor) {
+  ThreadPool pool(2);
+
+  std::vector<std::atomic<int>> counts(100);
+  for (auto& count : counts) {
+    count = 0;
+  }
+
+  pool.ParallelFor(
+      0, 10,
+      [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          pool.ParallelFor(i * 10, (i + 1) * 10,
+                           [&](const size_t begin, const size_t end) {
+                             for (size_t j = begin; j < end; ++j) {
+                               counts[j]++;
+                             }
+                           },
+                           ThreadPool::Schedule::DYNAMIC, 1);
+        }
+      },
+      ThreadPool::Schedule::STATIC, 1);
+
+  for (const auto& count : counts) {
+    BOOST_CHECK_EQUAL(count, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelFor) {
+  for (const int num_threads : {1, 4, -1}) {
+    std::vector<std::atomic<int>> counts(100);
+    for (auto& count : counts) {
+      count = 0;
+    }
+    ParallelFor(num_threads, 0, counts.size(),
+                [&](const size_t begin, const size_t end) {
+                  for (size_t i = begin; i < end; ++i) {
+                    counts[i]++;
+                  }
+                });
+    for (const auto& count : counts) {
+      BOOST_CHECK_EQUAL(count, 1);
+    }
+  }
+
+  // Nested calls reuse the thread pool of the current thread.
+  ThreadPool pool(4);
+  std::atomic<int> num_items(0);
+  pool.AddTask([&]() {
+        ParallelFor(4, 0, 100, [&](const size_t begin, const size_t end) {
+          CHECK(ThreadPool::CurrentThreadPool() == &pool);
+          num_items += static_cast<int>(end - begin);
+        });
+      })
+      .get();
+  BOOST_CHECK_EQUAL(num_items, 100);
+  BOOST_CHECK(ThreadPool::CurrentThreadPool() == nullptr);
+}
+
 BOOST_AUTO_TEST_CASE(TestJobQueueSingleProducerSingleConsumer) {
   JobQueue<int> job_queue;
 
@@ -860,6 +1025,28 @@ BOOST_AUTO_TEST_CASE(TestJobQueueStopConsumer) {
   BOOST_CHECK(!job_queue.Pop().IsValid());
 }
 
+BOOST_AUTO_TEST_CASE(TestJobQueueTryPop) {
+  JobQueue<int> job_queue(2);
+
+  BOOST_CHECK(!job_queue.TryPop().IsValid());
+
+  BOOST_CHECK(job_queue.Push(0));
+  BOOST_CHECK(job_queue.Push(1));
+
+  const auto job1 = job_queue.TryPop();
+  BOOST_CHECK(job1.IsValid());
+  BOOST_CHECK_EQUAL(job1.Data(), 0);
+  const auto job2 = job_queue.TryPop();
+  BOOST_CHECK(job2.IsValid());
+  BOOST_CHECK_EQUAL(job2.Data(), 1);
+  BOOST_CHECK(!job_queue.TryPop().IsValid());
+  BOOST_CHECK_EQUAL(job_queue.Size(), 0);
+
+  BOOST_CHECK(job_queue.Push(2));
+  job_queue.Stop();
+  BOOST_CHECK(!job_queue.TryPop().IsValid());
+}
+
 BOOST_AUTO_TEST_CASE(TestJobQueueClear) {
   JobQueue<int> job_queue(1);
 
@@ -870,6 +1057,99 @@ BOOST_AUTO_TEST_CASE(TestJobQueueClear) {
   BOOST_CHECK_EQUAL(job_queue.Size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(TestJobQueueMoveOnly) {
+  JobQueue<std::unique_ptr<int>> job_queue(2);
+
+  BOOST_CHECK(job_queue.Push(std::unique_ptr<int>(new int(0))));
+  std::unique_ptr<int> data(new int(1));
+  BOOST_CHECK(job_queue.Push(std::move(data)));
+  BOOST_CHECK(!data);
+
+  auto job1 = job_queue.Pop();
+  BOOST_CHECK(job1.IsValid());
+  BOOST_CHECK_EQUAL(*job1.Data(), 0);
+  auto job2 = job_queue.TryPop();
+  BOOST_CHECK(job2.IsValid());
+  BOOST_CHECK_EQUAL(*job2.Data(), 1);
+  BOOST_CHECK_EQUAL(job_queue.Size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueBatch) {
+  for (const size_t max_num_jobs :
+       {size_t(3), JobQueue<int>::kMaxNumRingBufferJobs + 1}) {
+    JobQueue<int> job_queue(max_num_jobs);
+
+    std::thread producer_thread([&job_queue]() {
+      CHECK(job_queue.PushBatch({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    });
+
+    std::vector<int> data;
+    while (data.size() < 10) {
+      if (job_queue.TryPopBatch(4, &data) == 0) {
+        const auto job = job_queue.Pop();
+        CHECK(job.IsValid());
+        data.push_back(job.Data());
+      }
+    }
+
+    producer_thread.join();
+
+    BOOST_CHECK_EQUAL(job_queue.Size(), 0);
+    BOOST_CHECK_EQUAL(job_queue.TryPopBatch(4, &data), 0);
+    BOOST_CHECK_EQUAL(data.size(), 10);
+    for (int i = 0; i < 10; ++i) {
+      BOOST_CHECK_EQUAL(data[i], i);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestJobQueueManyProducersManyConsumers) {
+  const int kNumThreads = 4;
+  const int kNumJobsPerThread = 10000;
+
+  for (const size_t max_num_jobs :
+       {size_t(1), size_t(7), std::numeric_limits<size_t>::max()}) {
+    JobQueue<int> job_queue(max_num_jobs);
+
+    std::vector<std::thread> producer_threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+      producer_threads.emplace_back([&job_queue]() {
+        for (int j = 0; j < kNumJobsPerThread; ++j) {
+          CHECK(job_queue.Push(j));
+        }
+      });
+    }
+
+    std::vector<long long> sums(kNumThreads, 0);
+    std::vector<std::thread> consumer_threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+      consumer_threads.emplace_back([&job_queue, &sums, i]() {
+        for (int j = 0; j < kNumJobsPerThread; ++j) {
+          const auto job = job_queue.Pop();
+          CHECK(job.IsValid());
+          sums[i] += job.Data();
+        }
+      });
+    }
+
+    for (auto& thread : producer_threads) {
+      thread.join();
+    }
+    for (auto& thread : consumer_threads) {
+      thread.join();
+    }
+
+    long long sum = 0;
+    for (const long long thread_sum : sums) {
+      sum += thread_sum;
+    }
+    BOOST_CHECK_EQUAL(sum, static_cast<long long>(kNumThreads) *
+                               kNumJobsPerThread * (kNumJobsPerThread - 1) /
+                               2);
+    BOOST_CHECK_EQUAL(job_queue.Size(), 0);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestGetEffectiveNumThreads) {
   BOOST_CHECK_GT(GetEffectiveNumThreads(-2), 0);
   BOOST_CHECK_GT(GetEffectiveNumThreads(-1), 0);
@@ -878,3 +1158,40 @@ BOOST_AUTO_TEST_CASE(TestGetEffectiveNumThreads) {
   BOOST_CHECK_EQUAL(GetEffectiveNumThreads(2), 2);
   BOOST_CHECK_EQUAL(GetEffectiveNumThreads(3), 3);
 }
+
+BOOST_AUTO_TEST_CASE(TestGetNumaNodeCores) {
+  const auto& node_cores = GetNumaNodeCores();
+  BOOST_CHECK_GT(node_cores.size(), 0);
+  for (const auto& cores : node_cores) {
+    BOOST_CHECK_GT(cores.size(), 0);
+    for (const int core : cores) {
+      BOOST_CHECK_GE(core, 0);
+    }
+  }
+  BOOST_CHECK(!PinThreadToNumaNode(-1));
+  BOOST_CHECK(!PinThreadToNumaNode(static_cast<int>(node_cores.size())));
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPoolNumaThreadPinning) {
+  BOOST_CHECK(!IsNumaThreadPinningEnabled());
+  SetNumaThreadPinning(true);
+  BOOST_CHECK(IsNumaThreadPinningEnabled());
+
+  std::vector<int> results(100, 0);
+  {
+    ThreadPool pool(4);
+    pool.ParallelFor(0, results.size(), [&](const size_t begin,
+                                            const size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        results[i] = static_cast<int>(i);
+      }
+    });
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    BOOST_CHECK_EQUAL(results[i], i);
+  }
+
+  SetNumaThreadPinning(false);
+  BOOST_CHECK(!IsNumaThreadPinningEnabled());
+}
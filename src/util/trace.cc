@@ -0,0 +1,281 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#include "util/trace.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "util/logging.h"
+#include "util/misc.h"
+#include "util/string.h"
+
+namespace colmap {
+namespace internal {
+
+std::atomic<bool> tracing_enabled(false);
+
+}  // namespace internal
+
+namespace {
+
+struct TraceBuffer {
+  explicit TraceBuffer(const int thread_idx) : thread_idx(thread_idx) {}
+  const int thread_idx;
+  // Only contended while the events are collected.
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+};
+
+struct TraceRegistry {
+  TraceRegistry() : start_time(std::chrono::steady_clock::now()) {}
+  const std::chrono::steady_clock::time_point start_time;
+  std::mutex mutex;
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::string exit_path;
+};
+
+// The registry is intentionally never destroyed, since threads might still
+// record spans while the static objects are destroyed at exit.
+TraceRegistry& GetTraceRegistry() {
+  static TraceRegistry* registry = new TraceRegistry();
+  return *registry;
+}
+
+thread_local TraceBuffer* thread_trace_buffer = nullptr;
+
+TraceBuffer* GetThreadTraceBuffer() {
+  if (thread_trace_buffer == nullptr) {
+    TraceRegistry& registry = GetTraceRegistry();
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    registry.buffers.emplace_back(
+        new TraceBuffer(static_cast<int>(registry.buffers.size())));
+    thread_trace_buffer = registry.buffers.back().get();
+  }
+  return thread_trace_buffer;
+}
+
+std::string EscapeJSONString(const char* str) {
+  std::string escaped;
+  for (const char* c = str; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      escaped += '\\';
+      escaped += *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      escaped += StringPrintf("\\u%04x", static_cast<int>(*c));
+    } else {
+      escaped += *c;
+    }
+  }
+  return escaped;
+}
+
+struct TraceStatistics {
+  size_t num_calls = 0;
+  int64_t total = 0;
+  int64_t max = 0;
+  int64_t begin = std::numeric_limits<int64_t>::max();
+  int64_t end = 0;
+
+  void Add(const TraceEvent& event) {
+    num_calls += 1;
+    total += event.duration;
+    max = std::max(max, event.duration);
+    begin = std::min(begin, event.begin);
+    end = std::max(end, event.begin + event.duration);
+  }
+};
+
+void PrintTraceStatistics(const std::string& name,
+                          const TraceStatistics& statistics) {
+  std::cout << StringPrintf(
+                   "%-36s %8d %11.3f %11.3f %11.3f %11.3f", name.c_str(),
+                   static_cast<int>(statistics.num_calls),
+                   statistics.total * 1e-6,
+                   (statistics.end - statistics.begin) * 1e-6,
+                   statistics.total * 1e-3 / statistics.num_calls,
+                   statistics.max * 1e-3)
+            << std::endl;
+}
+
+void WriteTraceAtExit() {
+  DisableTracing();
+  const std::string& path = GetTraceRegistry().exit_path;
+  std::cout << std::endl;
+  std::cout << "Writing trace to " << path << std::endl;
+  WriteChromeTrace(path);
+  PrintTraceSummary();
+}
+
+}  // namespace
+
+namespace internal {
+
+int64_t GetTraceTime() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - GetTraceRegistry().start_time)
+      .count();
+}
+
+void RecordTraceEvent(const char* name, const int64_t begin) {
+  TraceBuffer* buffer = GetThreadTraceBuffer();
+  TraceEvent event;
+  event.name = name;
+  event.thread_idx = buffer->thread_idx;
+  event.begin = begin;
+  event.duration = GetTraceTime() - begin;
+  std::unique_lock<std::mutex> lock(buffer->mutex);
+  buffer->events.push_back(event);
+}
+
+}  // namespace internal
+
+void EnableTracing() {
+  // Initialize the start time before the first span is recorded.
+  GetTraceRegistry();
+  internal::tracing_enabled = true;
+}
+
+void DisableTracing() { internal::tracing_enabled = false; }
+
+void EnableTracingUntilExit(const std::string& path) {
+  if (path.empty()) {
+    return;
+  }
+
+  TraceRegistry& registry = GetTraceRegistry();
+  {
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    if (registry.exit_path.empty()) {
+      std::atexit(&WriteTraceAtExit);
+    }
+    registry.exit_path = path;
+  }
+
+  EnableTracing();
+}
+
+std::vector<TraceEvent> GetTraceEvents() {
+  TraceRegistry& registry = GetTraceRegistry();
+  std::vector<TraceEvent> events;
+  {
+    std::unique_lock<std::mutex> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+      std::unique_lock<std::mutex> buffer_lock(buffer->mutex);
+      events.insert(events.end(), buffer->events.begin(),
+                    buffer->events.end());
+    }
+  }
+
+  std::sort(events.begin(), events.end(),
+            [](const TraceEvent& event1, const TraceEvent& event2) {
+              return event1.begin < event2.begin;
+            });
+
+  return events;
+}
+
+void ClearTraceEvents() {
+  TraceRegistry& registry = GetTraceRegistry();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  for (const auto& buffer : registry.buffers) {
+    std::unique_lock<std::mutex> buffer_lock(buffer->mutex);
+    buffer->events.clear();
+  }
+}
+
+void WriteChromeTrace(const std::string& path) {
+  std::ofstream file(path, std::ios::trunc);
+  CHECK(file.is_open()) << path;
+
+  const std::vector<TraceEvent> events = GetTraceEvents();
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent& event = events[i];
+    if (i > 0) {
+      file << ",";
+    }
+    file << "\n{\"name\":\"" << EscapeJSONString(event.name)
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread_idx
+         << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << "}";
+  }
+  file << "\n]}" << std::endl;
+}
+
+void PrintTraceSummary() {
+  const std::vector<TraceEvent> events = GetTraceEvents();
+
+  std::map<std::string, TraceStatistics> phase_statistics;
+  std::map<std::string, std::map<std::string, TraceStatistics>>
+      span_statistics;
+  for (const auto& event : events) {
+    const std::string name = event.name;
+    const std::string phase = name.substr(0, name.find('/'));
+    phase_statistics[phase].Add(event);
+    span_statistics[phase][name].Add(event);
+  }
+
+  // Sort the phases and the spans of each phase by their total time.
+  const auto SortByTotalTime =
+      [](const std::map<std::string, TraceStatistics>& statistics) {
+        std::vector<std::pair<std::string, TraceStatistics>> sorted(
+            statistics.begin(), statistics.end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const std::pair<std::string, TraceStatistics>& stat1,
+                     const std::pair<std::string, TraceStatistics>& stat2) {
+                    return stat1.second.total > stat2.second.total;
+                  });
+        return sorted;
+      };
+
+  PrintHeading1("Trace summary");
+  std::cout << StringPrintf("%-36s %8s %11s %11s %11s %11s", "Span", "Calls",
+                            "Total [s]", "Wall [s]", "Mean [ms]", "Max [ms]")
+            << std::endl;
+  for (const auto& phase : SortByTotalTime(phase_statistics)) {
+    PrintTraceStatistics(phase.first, phase.second);
+    for (const auto& span : SortByTotalTime(span_statistics[phase.first])) {
+      if (span.first != phase.first) {
+        PrintTraceStatistics("  " + span.first, span.second);
+      }
+    }
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,129 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#ifndef COLMAP_SRC_UTIL_TRACE_H_
+#define COLMAP_SRC_UTIL_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace colmap {
+
+// Lightweight tracing of the time spent in scoped spans, e.g.:
+//
+//    EnableTracing();
+//    {
+//      TraceSpan span("mapper/register");
+//      // Do some work...
+//    }
+//    WriteChromeTrace("trace.json");
+//    PrintTraceSummary();
+//
+// Every thread records its spans into its own buffer, so that concurrent
+// spans do not contend with each other. If tracing is disabled, a span only
+// checks a single flag. Span names must outlive the trace and are usually
+// string literals of the form "phase/step", where the phase is used to
+// aggregate the spans in the summary.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name);
+  ~TraceSpan();
+
+ private:
+  const char* name_;
+  int64_t begin_;
+};
+
+// A finished span with its begin time since the start of the process and its
+// duration in microseconds.
+struct TraceEvent {
+  const char* name = nullptr;
+  int thread_idx = 0;
+  int64_t begin = 0;
+  int64_t duration = 0;
+};
+
+// Enable or disable the recording of spans in all threads.
+void EnableTracing();
+void DisableTracing();
+inline bool IsTracingEnabled();
+
+// Enable tracing and, when the program exits, write the Chrome trace to the
+// given path and print the summary. Does nothing for an empty path.
+void EnableTracingUntilExit(const std::string& path);
+
+// Get a copy of the events recorded in all threads ordered by begin time.
+std::vector<TraceEvent> GetTraceEvents();
+
+// Discard all recorded events.
+void ClearTraceEvents();
+
+// Write the recorded events in the Chrome trace event format, which can be
+// opened in chrome://tracing or https://ui.perfetto.dev.
+void WriteChromeTrace(const std::string& path);
+
+// Print the number of calls and the total, mean, and maximum time per span
+// and per phase of the spans.
+void PrintTraceSummary();
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+namespace internal {
+
+extern std::atomic<bool> tracing_enabled;
+
+int64_t GetTraceTime();
+void RecordTraceEvent(const char* name, const int64_t begin);
+
+}  // namespace internal
+
+bool IsTracingEnabled() {
+  return internal::tracing_enabled.load(std::memory_order_relaxed);
+}
+
+inline TraceSpan::TraceSpan(const char* name)
+    : name_(name), begin_(IsTracingEnabled() ? internal::GetTraceTime() : -1) {}
+
+inline TraceSpan::~TraceSpan() {
+  if (begin_ >= 0) {
+    internal::RecordTraceEvent(name_, begin_);
+  }
+}
+
+}  // namespace colmap
+
+#endif  // COLMAP_SRC_UTIL_TRACE_H_
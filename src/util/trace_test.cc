@@ -0,0 +1,148 @@
+// Copyright (c) 2018, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+// Author: Johannes L. Schoenberger (jsch-at-demuc-dot-de)
+
+
+#define TEST_NAME "util/trace"
+#include "util/testing.h"
+
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "util/trace.h"
+
+using namespace colmap;
+
+BOOST_AUTO_TEST_CASE(TestDisabled) {
+  DisableTracing();
+  ClearTraceEvents();
+  BOOST_CHECK(!IsTracingEnabled());
+  { TraceSpan span("test/disabled"); }
+  BOOST_CHECK_EQUAL(GetTraceEvents().size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestNestedSpans) {
+  ClearTraceEvents();
+  EnableTracing();
+  BOOST_CHECK(IsTracingEnabled());
+  {
+    TraceSpan outer_span("test/outer");
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    {
+      TraceSpan inner_span("test/inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  DisableTracing();
+  { TraceSpan span("test/disabled"); }
+
+  const auto events = GetTraceEvents();
+  BOOST_CHECK_EQUAL(events.size(), 2);
+  BOOST_CHECK_EQUAL(std::string(events[0].name), "test/outer");
+  BOOST_CHECK_EQUAL(std::string(events[1].name), "test/inner");
+  BOOST_CHECK_LE(events[0].begin, events[1].begin);
+  BOOST_CHECK_GE(events[1].duration, 10000);
+  BOOST_CHECK_GE(events[0].duration, events[1].duration + 10000);
+  BOOST_CHECK_GE(events[0].begin + events[0].duration,
+                 events[1].begin + events[1].duration);
+  BOOST_CHECK_EQUAL(events[0].thread_idx, events[1].thread_idx);
+
+  ClearTraceEvents();
+  BOOST_CHECK_EQUAL(GetTraceEvents().size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMultipleThreads) {
+  ClearTraceEvents();
+  EnableTracing();
+
+  const int kNumThreads = 4;
+  const int kNumSpans = 100;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < kNumSpans; ++j) {
+        TraceSpan span("test/thread");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  DisableTracing();
+
+  const auto events = GetTraceEvents();
+  BOOST_CHECK_EQUAL(events.size(), kNumThreads * kNumSpans);
+  std::set<int> thread_idxs;
+  for (size_t i = 0; i < events.size(); ++i) {
+    thread_idxs.insert(events[i].thread_idx);
+    if (i > 0) {
+      BOOST_CHECK_LE(events[i - 1].begin, events[i].begin);
+    }
+  }
+  BOOST_CHECK_EQUAL(thread_idxs.size(), kNumThreads);
+
+  ClearTraceEvents();
+}
+
+BOOST_AUTO_TEST_CASE(TestWriteChromeTrace) {
+  ClearTraceEvents();
+  EnableTracing();
+  { TraceSpan span("test/\"quoted\""); }
+  { TraceSpan span("test/write"); }
+  DisableTracing();
+
+  const std::string path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path("colmap_trace_%%%%-%%%%.json"))
+          .string();
+  WriteChromeTrace(path);
+
+  std::ifstream file(path);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  const std::string trace = buffer.str();
+  BOOST_CHECK_EQUAL(trace.find("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["),
+                    0);
+  BOOST_CHECK_NE(trace.find("\"name\":\"test/\\\"quoted\\\"\""),
+                 std::string::npos);
+  BOOST_CHECK_NE(trace.find("\"name\":\"test/write\",\"ph\":\"X\""),
+                 std::string::npos);
+  BOOST_CHECK_NE(trace.find("\n]}"), std::string::npos);
+
+  PrintTraceSummary();
+
+  boost::filesystem::remove(path);
+  ClearTraceEvents();
+}